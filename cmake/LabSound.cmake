@@ -7,7 +7,11 @@
 # Will create a target named LabSound
 
 # backend selection
-if (IOS)
+if (EMSCRIPTEN)
+    # browsers are served by the Web Audio backend, built below
+    option(LABSOUND_USE_MINIAUDIO "Use miniaudio" OFF)
+    option(LABSOUND_USE_RTAUDIO "Use RtAudio" OFF)
+elseif (IOS)
     option(LABSOUND_USE_MINIAUDIO "Use miniaudio" ON)
     option(LABSOUND_USE_RTAUDIO "Use RtAudio" OFF)
 elseif (APPLE)
@@ -28,11 +32,13 @@ endif()
 
 if (LABSOUND_USE_MINIAUDIO AND LABSOUND_USE_RTAUDIO)
     message(FATAL, " Specify only one backend")
-elseif(NOT LABSOUND_USE_MINIAUDIO AND NOT LABSOUND_USE_RTAUDIO)
+elseif(NOT LABSOUND_USE_MINIAUDIO AND NOT LABSOUND_USE_RTAUDIO AND NOT EMSCRIPTEN)
     message(FATAL, " Specify at least one backend")
 endif()
 
-if (LABSOUND_USE_MINIAUDIO)
+if (EMSCRIPTEN)
+    message(STATUS "Using Web Audio backend")
+elseif (LABSOUND_USE_MINIAUDIO)
     message(STATUS "Using miniaudio backend")
 elseif (LABSOUND_USE_RTAUDIO)
     message(STATUS "Using RtAudio backend")
@@ -57,18 +63,14 @@ file(GLOB labsnd_extended   "${LABSOUND_ROOT}/src/extended/*")
 file(GLOB labsnd_int_h      "${LABSOUND_ROOT}/src/internal/*")
 file(GLOB labsnd_int_src    "${LABSOUND_ROOT}/src/internal/src/*")
 
-# FFT
-if (IOS)
-    set(labsnd_fft_src "${LABSOUND_ROOT}/src/internal/FFTFrameAppleAccelerate.cpp")
+# FFT: Accelerate on Apple platforms, and Ooura's FFT elsewhere, unless KissFFT is requested
+option(LABSOUND_USE_KISS_FFT "Use KissFFT rather than the platform's default FFT" OFF)
+if (LABSOUND_USE_KISS_FFT)
+    file(GLOB labsnd_fft_src "${LABSOUND_ROOT}/third_party/kissfft/src/*")
 elseif (APPLE)
     set(labsnd_fft_src "${LABSOUND_ROOT}/src/internal/FFTFrameAppleAccelerate.cpp")
-elseif (WIN32)
-    file(GLOB labsnd_fft_src "${LABSOUND_ROOT}/third_party/kissfft/src/*")
-elseif (UNIX)
-    file(GLOB labsnd_fft_src "${LABSOUND_ROOT}/third_party/kissfft/src/*")
 endif()
 
-# TODO ooura or kissfft? benchmark and choose. Then benchmark vs FFTFrameAppleAccelerate
 set(ooura_src
     "${LABSOUND_ROOT}/third_party/ooura/src/fftsg.cpp"
     "${LABSOUND_ROOT}/third_party/ooura/fftsg.h")
@@ -82,8 +84,43 @@ add_library(LabSound STATIC
     ${ooura_src}
  )
 
+if (LABSOUND_USE_KISS_FFT)
+    target_compile_definitions(LabSound PRIVATE USE_KISS_FFT=1)
+endif()
+
+# Profiling times nodes' processing for their statistics, in sampled quanta; turned off,
+# the timing is compiled out
+option(LABSOUND_ENABLE_PROFILING "Time nodes' processing, for the profiling statistics" ON)
+if (NOT LABSOUND_ENABLE_PROFILING)
+    target_compile_definitions(LabSound PUBLIC LABSOUND_PROFILING=0)
+endif()
+
+# wasm SIMD128 for VectorMath and the kernels written over Lanes4; every browser that
+# supports audio worklets supports it
+if (EMSCRIPTEN)
+    option(LABSOUND_WASM_SIMD "Compile with wasm SIMD128" ON)
+    if (LABSOUND_WASM_SIMD)
+        target_compile_options(LabSound PRIVATE -msimd128)
+    endif()
+    target_compile_options(LabSound PUBLIC -pthread)
+endif()
+
+# SOFA HRTF files are HDF5 files, and are read with an installed libmysofa
+option(LABSOUND_USE_LIBMYSOFA "Read SOFA HRTF files with libmysofa" OFF)
+if (LABSOUND_USE_LIBMYSOFA)
+    find_path(MYSOFA_INCLUDE_DIR mysofa.h)
+    find_library(MYSOFA_LIBRARY mysofa)
+    if (MYSOFA_INCLUDE_DIR AND MYSOFA_LIBRARY)
+        target_compile_definitions(LabSound PRIVATE LABSOUND_HAVE_LIBMYSOFA=1)
+        target_include_directories(LabSound PRIVATE ${MYSOFA_INCLUDE_DIR})
+        target_link_libraries(LabSound PRIVATE ${MYSOFA_LIBRARY})
+    else()
+        message(WARNING "libmysofa was not found, so SOFA files can't be read")
+    endif()
+endif()
+
  #--- CONFIGURE RTAUDIO
-if (NOT IOS)
+if (NOT IOS AND NOT EMSCRIPTEN)
     add_library(LabSoundRtAudio STATIC
         "${LABSOUND_ROOT}/src/backends/RtAudio/AudioDevice_RtAudio.cpp"
         "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_RtAudio.h"
@@ -106,6 +143,49 @@ if (NOT IOS)
         endif()
     endif()
 
+endif()
+
+ #--- CONFIGURE JACK
+if (LABSOUND_JACK AND UNIX AND NOT APPLE)
+    add_library(LabSoundJack STATIC
+        "${LABSOUND_ROOT}/src/backends/jack/AudioDevice_Jack.cpp"
+        "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_Jack.h"
+    )
+    target_link_libraries(LabSoundJack PRIVATE jack)
+endif()
+
+ #--- CONFIGURE CORE AUDIO
+if (APPLE AND NOT IOS)
+    add_library(LabSoundCoreAudio STATIC
+        "${LABSOUND_ROOT}/src/backends/coreaudio/AudioDevice_CoreAudio.cpp"
+        "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_CoreAudio.h"
+    )
+    target_link_libraries(LabSoundCoreAudio PUBLIC
+        "-framework AudioToolbox"
+        "-framework AudioUnit"
+        "-framework CoreAudio"
+        "-framework CoreFoundation")
+endif()
+
+ #--- CONFIGURE AAUDIO
+if (ANDROID)
+    add_library(LabSoundAAudio STATIC
+        "${LABSOUND_ROOT}/src/backends/aaudio/AudioDevice_AAudio.cpp"
+        "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_AAudio.h"
+    )
+    # AAudio arrived with API level 26
+    target_link_libraries(LabSoundAAudio PRIVATE aaudio)
+endif()
+
+ #--- CONFIGURE WEB AUDIO
+if (EMSCRIPTEN)
+    add_library(LabSoundWebAudio STATIC
+        "${LABSOUND_ROOT}/src/backends/webaudio/AudioDevice_WebAudio.cpp"
+        "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_WebAudio.h"
+    )
+    # the worklet shares the module's memory, so it must be a SharedArrayBuffer
+    target_compile_options(LabSoundWebAudio PUBLIC -pthread)
+    target_link_options(LabSoundWebAudio PUBLIC -pthread -sAUDIO_WORKLET=1 -sWASM_WORKERS=1)
 endif()
 
  #--- CONFIGURE MINIAUDIO
@@ -173,7 +253,6 @@ function (configureProj proj)
     elseif(APPLE)
     elseif(ANDROID)
         target_compile_options(${proj} PRIVATE -fPIC)
-        target_compile_definitions(${proj} PRIVATE USE_KISS_FFT=1)
         target_link_libraries(${proj} PRIVATE OpenSLES)
         if(LABSOUND_JACK)
             target_link_libraries(${proj} PRIVATE jack)
@@ -190,7 +269,6 @@ function (configureProj proj)
     elseif(UNIX)
         target_link_libraries(${proj} PRIVATE pthread)
         target_compile_options(${proj} PRIVATE -fPIC)
-        target_compile_definitions(${proj} PRIVATE USE_KISS_FFT=1)
         if(LABSOUND_JACK)
             target_link_libraries(${proj} PRIVATE jack)
         endif()
@@ -218,7 +296,40 @@ target_include_directories(LabSound PRIVATE
 #    ${PROJECT_BINARY_DIR}/third_party/libsamplerate
 )
 
-if (NOT IOS)
+if (TARGET LabSoundCoreAudio)
+    target_include_directories(LabSoundCoreAudio PUBLIC
+        $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+        $<INSTALL_INTERFACE:include>
+    )
+    target_include_directories(LabSoundCoreAudio PRIVATE
+        ${LABSOUND_ROOT}/src
+        ${LABSOUND_ROOT}/src/internal
+        ${LABSOUND_ROOT}/third_party)
+endif()
+
+if (TARGET LabSoundAAudio)
+    target_include_directories(LabSoundAAudio PUBLIC
+        $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+        $<INSTALL_INTERFACE:include>
+    )
+    target_include_directories(LabSoundAAudio PRIVATE
+        ${LABSOUND_ROOT}/src
+        ${LABSOUND_ROOT}/src/internal
+        ${LABSOUND_ROOT}/third_party)
+endif()
+
+if (TARGET LabSoundWebAudio)
+    target_include_directories(LabSoundWebAudio PUBLIC
+        $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+        $<INSTALL_INTERFACE:include>
+    )
+    target_include_directories(LabSoundWebAudio PRIVATE
+        ${LABSOUND_ROOT}/src
+        ${LABSOUND_ROOT}/src/internal
+        ${LABSOUND_ROOT}/third_party)
+endif()
+
+if (TARGET LabSoundRtAudio)
     target_include_directories(LabSoundRtAudio PUBLIC
         $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>  
         $<INSTALL_INTERFACE:include>
@@ -230,6 +341,17 @@ if (NOT IOS)
         ${LABSOUND_ROOT}/third_party/libnyquist/include)
 endif()
 
+if (TARGET LabSoundJack)
+    target_include_directories(LabSoundJack PUBLIC
+        $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+        $<INSTALL_INTERFACE:include>
+    )
+    target_include_directories(LabSoundJack PRIVATE
+        ${LABSOUND_ROOT}/src
+        ${LABSOUND_ROOT}/src/internal
+        ${LABSOUND_ROOT}/third_party)
+endif()
+
 target_include_directories(LabSoundMiniAudio PUBLIC
     $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>  
     $<INSTALL_INTERFACE:include>
@@ -249,6 +371,9 @@ endif()
 
 if (LINUX)
     set(LABSOUND_PLATFORM_LINK_LIBRARIES PRIVATE dl)
+elseif (WIN32)
+    # the network nodes' sockets
+    set(LABSOUND_PLATFORM_LINK_LIBRARIES PRIVATE ws2_32)
 endif()
 
 target_link_libraries(LabSound
@@ -258,9 +383,21 @@ target_link_libraries(LabSound
 
 configureProj(LabSound)
 configureProj(LabSoundMiniAudio)
-if (NOT IOS)
+if (TARGET LabSoundRtAudio)
     configureProj(LabSoundRtAudio)
 endif()
+if (TARGET LabSoundWebAudio)
+    configureProj(LabSoundWebAudio)
+endif()
+if (TARGET LabSoundAAudio)
+    configureProj(LabSoundAAudio)
+endif()
+if (TARGET LabSoundCoreAudio)
+    configureProj(LabSoundCoreAudio)
+endif()
+if (TARGET LabSoundJack)
+    configureProj(LabSoundJack)
+endif()
     
 install(FILES "${LABSOUND_ROOT}/include/LabSound/LabSound.h"
     DESTINATION include/LabSound)
@@ -272,6 +409,22 @@ install(FILES
     "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_Miniaudio.h"
     "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_RtAudio.h"
    DESTINATION include/LabSound/backends)
+if (TARGET LabSoundJack)
+    install(FILES "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_Jack.h"
+        DESTINATION include/LabSound/backends)
+endif()
+if (TARGET LabSoundCoreAudio)
+    install(FILES "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_CoreAudio.h"
+        DESTINATION include/LabSound/backends)
+endif()
+if (TARGET LabSoundAAudio)
+    install(FILES "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_AAudio.h"
+        DESTINATION include/LabSound/backends)
+endif()
+if (TARGET LabSoundWebAudio)
+    install(FILES "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_WebAudio.h"
+        DESTINATION include/LabSound/backends)
+endif()
 
 install(DIRECTORY
     assets/hrtf
@@ -296,6 +449,15 @@ source_group(third_party\\rtaudio FILES ${third_rtaudio})
 
 add_library(LabSound::LabSound ALIAS LabSound)
 add_library(LabSoundMiniAudio::LabSoundMiniAudio ALIAS LabSoundMiniAudio)
-if (NOT IOS)
+if (TARGET LabSoundRtAudio)
     add_library(LabSoundRtAudio::LabSoundRtAudio ALIAS LabSoundRtAudio)
 endif()
+if (TARGET LabSoundCoreAudio)
+    add_library(LabSoundCoreAudio::LabSoundCoreAudio ALIAS LabSoundCoreAudio)
+endif()
+if (TARGET LabSoundAAudio)
+    add_library(LabSoundAAudio::LabSoundAAudio ALIAS LabSoundAAudio)
+endif()
+if (TARGET LabSoundWebAudio)
+    add_library(LabSoundWebAudio::LabSoundWebAudio ALIAS LabSoundWebAudio)
+endif()
@@ -96,3 +96,38 @@ set_property(TARGET LabSoundExample PROPERTY FOLDER "examples")
 install(TARGETS LabSoundExample
     BUNDLE DESTINATION bin
     RUNTIME DESTINATION bin)
+
+#--- HRTF database compiler
+add_executable(LabSoundHRTFCompiler "${LABSOUND_ROOT}/examples/src/HRTFCompiler.cpp")
+target_link_libraries(LabSoundHRTFCompiler LabSound)
+if (APPLE)
+    target_link_libraries(LabSoundHRTFCompiler ${DARWIN_LIBS})
+elseif (UNIX)
+    target_link_libraries(LabSoundHRTFCompiler pthread)
+endif()
+set_target_properties(LabSoundHRTFCompiler PROPERTIES
+                      RUNTIME_OUTPUT_DIRECTORY bin)
+set_property(TARGET LabSoundHRTFCompiler PROPERTY FOLDER "examples")
+
+install(TARGETS LabSoundHRTFCompiler
+    RUNTIME DESTINATION bin)
+
+#--- benchmarks of the nodes and DSP kernels
+add_executable(LabSoundBench "${LABSOUND_ROOT}/examples/src/Bench.cpp")
+target_link_libraries(LabSoundBench LabSound)
+# the kernels are measured through the library's internal headers
+target_include_directories(LabSoundBench PRIVATE
+    ${LABSOUND_ROOT}/src
+    ${LABSOUND_ROOT}/src/internal
+    ${LABSOUND_ROOT}/third_party)
+if (APPLE)
+    target_link_libraries(LabSoundBench ${DARWIN_LIBS})
+elseif (UNIX)
+    target_link_libraries(LabSoundBench pthread)
+endif()
+set_target_properties(LabSoundBench PROPERTIES
+                      RUNTIME_OUTPUT_DIRECTORY bin)
+set_property(TARGET LabSoundBench PROPERTY FOLDER "examples")
+
+install(TARGETS LabSoundBench
+    RUNTIME DESTINATION bin)
@@ -0,0 +1,568 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+// Measures every node the NodeRegistry can create, and the DSP kernels beneath them,
+// rendering offline as fast as they can, and prints the cost of each in nanoseconds per
+// sample, that is per frame per channel.
+//
+//     LabSoundBench [--filter <text>] [--hrtf <search path>] [--seconds <per measurement>]
+//                   [--graphs <most nodes>]
+//
+// Nodes are measured in a graph of their own, fed by a looping noise source of the same
+// channel count, at each channel count and render quantum size. The cost of the source
+// and the destination is measured first, on the "(source)" line, and is included in every
+// node's figure. HRTFPanner is measured only when a search path for the HRTF database is
+// given.
+//
+// With --graphs, synthetic graphs of each topology are rendered instead, at sizes from ten
+// nodes up to the most given, to show how the engine scales: wide fan-in mixes, deep
+// chains, FM matrices, many panners, and heavy automation. For each, the mean and 99th
+// percentile time of a quantum are printed, split into the nodes' own processing and the
+// remainder, which is the cost of traversing the graph, along with the memory the graph
+// took and how many times faster than real time it rendered.
+
+#include "LabSound/LabSound.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Biquad.h"
+#include "internal/DynamicsCompressorKernel.h"
+#include "internal/FFTConvolver.h"
+#include "internal/FFTFrame.h"
+#include "internal/HRTFPanner.h"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+  #include <unistd.h>
+#endif
+
+using namespace lab;
+
+namespace
+{
+    const float SampleRate = 48000.f;
+    const int ChannelCounts[] = {1, 2, 6};
+    const int QuantumSizes[] = {128, 512};
+
+    double g_seconds = 0.25;
+    std::string g_filter;
+
+    bool selected(const std::string & name)
+    {
+        return g_filter.empty() || name.find(g_filter) != std::string::npos;
+    }
+
+    // Runs fn, which processes samplesPerRun samples, until g_seconds have passed, after a
+    // run to warm the caches, and returns nanoseconds per sample
+    double measure(const std::function<void()> & fn, double samplesPerRun)
+    {
+        using Clock = std::chrono::steady_clock;
+        fn();
+
+        uint64_t runs = 0;
+        const Clock::time_point start = Clock::now();
+        Clock::time_point now = start;
+        do
+        {
+            for (int i = 0; i < 16; ++i)
+                fn();
+            runs += 16;
+            now = Clock::now();
+        } while (std::chrono::duration<double>(now - start).count() < g_seconds);
+
+        const double ns = std::chrono::duration<double, std::nano>(now - start).count();
+        return ns / (double(runs) * samplesPerRun);
+    }
+
+    void report(const std::string & name, int channels, int frames, double nsPerSample)
+    {
+        printf("%-34s %3d ch %5d fr %10.3f ns/sample\n", name.c_str(), channels, frames, nsPerSample);
+        fflush(stdout);
+    }
+
+    void fillNoise(float * data, int count, uint32_t seed)
+    {
+        std::minstd_rand random(seed);
+        std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+        for (int i = 0; i < count; ++i)
+            data[i] = uniform(random);
+    }
+
+    // An offline context with a destination of the given channels, its quantum set before
+    // any node is made
+    struct OfflineGraph
+    {
+        std::shared_ptr<AudioContext> context;
+        std::shared_ptr<AudioDevice_Null> device;
+        std::shared_ptr<AudioDestinationNode> destination;
+
+        OfflineGraph(int channels, int quantum)
+        {
+            AudioStreamConfig inputConfig;
+            AudioStreamConfig outputConfig;
+            outputConfig.device_index = 0;
+            outputConfig.desired_channels = channels;
+            outputConfig.desired_samplerate = SampleRate;
+
+            context = std::make_shared<AudioContext>(true, false);
+            context->setRenderQuantumSize(quantum);
+            device = std::make_shared<AudioDevice_Null>(inputConfig, outputConfig);
+            destination = std::make_shared<AudioDestinationNode>(*context, device);
+            device->setDestinationNode(destination);
+            context->setDestinationNode(destination);
+        }
+
+        ~OfflineGraph()
+        {
+            // the device, context, and destination are circularly referenced
+            destination.reset();
+            device->setDestinationNode(destination);
+            context->setDestinationNode(destination);
+        }
+
+        void render(uint64_t frames)
+        {
+            destination->offlineRender(frames, 0, [](const AudioBus &, int, uint64_t) { return true; });
+        }
+    };
+
+    // a second of noise
+    std::shared_ptr<AudioBus> makeNoise(int channels)
+    {
+        std::shared_ptr<AudioBus> noise = std::make_shared<AudioBus>(channels, static_cast<int>(SampleRate));
+        noise->setSampleRate(SampleRate);
+        for (int c = 0; c < channels; ++c)
+            fillNoise(noise->channel(c)->mutableData(), noise->length(), 1 + c);
+        return noise;
+    }
+
+    std::shared_ptr<SampledAudioNode> makeNoiseSource(AudioContext & ac, int channels)
+    {
+        std::shared_ptr<SampledAudioNode> source = std::make_shared<SampledAudioNode>(ac);
+        source->setBus(makeNoise(channels));
+        source->schedule(0.f, -1);
+        return source;
+    }
+
+    // Renders a graph of the named node, or of the noise source alone if name is empty
+    void benchNode(const std::string & name, int channels, int quantum)
+    {
+        OfflineGraph graph(channels, quantum);
+        AudioContext & ac = *graph.context;
+
+        std::shared_ptr<SampledAudioNode> source = makeNoiseSource(ac, channels);
+        std::shared_ptr<AudioNode> node;
+        if (!name.empty())
+        {
+            node.reset(NodeRegistry::Instance().Create(name, ac));
+            if (!node)
+                return;
+
+            if (auto sampled = std::dynamic_pointer_cast<SampledAudioNode>(node))
+            {
+                sampled->setBus(makeNoise(channels));
+                sampled->schedule(0.f, -1);
+            }
+            else if (auto scheduled = std::dynamic_pointer_cast<AudioScheduledSourceNode>(node))
+                scheduled->start(0.f);
+
+            if (node->numberOfInputs() > 0)
+                ac.connect(node, source);
+            if (node->numberOfOutputs() > 0)
+                ac.connect(graph.destination, node);
+            else
+                ac.addAutomaticPullNode(node);
+        }
+        else
+            ac.connect(graph.destination, source);
+
+        ac.startOfflineRendering();
+        const uint64_t frames = uint64_t(quantum) * 16;
+        const double ns = measure([&]() { graph.render(frames); }, double(frames) * channels);
+        report(name.empty() ? "(source)" : name, channels, quantum, ns);
+    }
+
+    void benchNodes()
+    {
+        std::vector<std::string> names = NodeRegistry::Instance().Names();
+        for (int quantum : QuantumSizes)
+            for (int channels : ChannelCounts)
+            {
+                if (selected("(source)"))
+                    benchNode({}, channels, quantum);
+                for (const std::string & name : names)
+                    if (selected(name))
+                        benchNode(name, channels, quantum);
+            }
+    }
+
+    void benchVectorMath()
+    {
+        for (int frames : QuantumSizes)
+        {
+            std::vector<float> a(frames), b(frames), d(frames);
+            fillNoise(a.data(), frames, 1);
+            fillNoise(b.data(), frames, 2);
+            const float k = 0.5f;
+            const float lo = -0.5f, hi = 0.5f;
+            float m = 0.f;
+
+            struct Kernel
+            {
+                const char * name;
+                std::function<void()> fn;
+            };
+            const Kernel kernels[] = {
+                {"VectorMath::vsmul", [&]() { VectorMath::vsmul(a.data(), 1, &k, d.data(), 1, frames); }},
+                {"VectorMath::vsma", [&]() { VectorMath::vsma(a.data(), 1, &k, d.data(), 1, frames); }},
+                {"VectorMath::vadd", [&]() { VectorMath::vadd(a.data(), 1, b.data(), 1, d.data(), 1, frames); }},
+                {"VectorMath::vmul", [&]() { VectorMath::vmul(a.data(), 1, b.data(), 1, d.data(), 1, frames); }},
+                {"VectorMath::vmadd", [&]() { VectorMath::vmadd(a.data(), 1, b.data(), 1, d.data(), 1, frames); }},
+                {"VectorMath::vclip", [&]() { VectorMath::vclip(a.data(), 1, &lo, &hi, d.data(), 1, frames); }},
+                {"VectorMath::vmaxmgv", [&]() { VectorMath::vmaxmgv(a.data(), 1, &m, frames); }},
+                {"VectorMath::vsvesq", [&]() { VectorMath::vsvesq(a.data(), 1, &m, frames); }},
+                {"VectorMath::vtanh", [&]() { VectorMath::vtanh(a.data(), 2.f, d.data(), frames); }},
+            };
+            for (const Kernel & kernel : kernels)
+                if (selected(kernel.name))
+                    report(kernel.name, 1, frames, measure(kernel.fn, frames));
+        }
+    }
+
+    void benchBiquad()
+    {
+        if (!selected("Biquad"))
+            return;
+
+        for (int frames : QuantumSizes)
+        {
+            std::vector<float> source(frames), destination(frames);
+            fillNoise(source.data(), frames, 1);
+            Biquad biquad;
+            biquad.setLowpassParams(0.1, 0.7);
+            report("Biquad (lowpass)", 1, frames, measure([&]() { biquad.process(source.data(), destination.data(), frames); }, frames));
+        }
+    }
+
+    void benchFFT()
+    {
+        for (int fftSize : {256, 1024, 4096})
+        {
+            std::vector<float> data(fftSize), result(fftSize);
+            fillNoise(data.data(), fftSize, 1);
+
+            if (selected("FFTFrame"))
+            {
+                FFTFrame frame(fftSize);
+                report("FFTFrame (forward and inverse)", 1, fftSize, measure([&]()
+                {
+                    frame.computeForwardFFT(data.data());
+                    frame.computeInverseFFT(result.data());
+                }, fftSize));
+            }
+
+            if (selected("FFTConvolver"))
+            {
+                // a kernel of half the FFT, convolved a half FFT at a time
+                std::vector<float> impulse(fftSize / 2);
+                fillNoise(impulse.data(), fftSize / 2, 2);
+                FFTFrame kernel(fftSize);
+                kernel.doPaddedFFT(impulse.data(), fftSize / 2);
+
+                FFTConvolver convolver(fftSize);
+                const int frames = fftSize / 2;
+                report("FFTConvolver", 1, frames, measure([&]() { convolver.process(&kernel, data.data(), result.data(), frames); }, frames));
+            }
+        }
+    }
+
+    void benchDynamicsCompressorKernel()
+    {
+        if (!selected("DynamicsCompressorKernel"))
+            return;
+
+        for (int quantum : QuantumSizes)
+            for (int channels : ChannelCounts)
+            {
+                OfflineGraph graph(channels, quantum);
+                ContextRenderLock r(graph.context.get(), "LabSoundBench");
+
+                std::vector<std::vector<float>> buffers(channels, std::vector<float>(quantum));
+                std::vector<std::vector<float>> results(channels, std::vector<float>(quantum));
+                std::vector<const float *> sources(channels);
+                std::vector<float *> destinations(channels);
+                for (int c = 0; c < channels; ++c)
+                {
+                    fillNoise(buffers[c].data(), quantum, 1 + c);
+                    sources[c] = buffers[c].data();
+                    destinations[c] = results[c].data();
+                }
+
+                DynamicsCompressorKernel kernel(channels);
+                report("DynamicsCompressorKernel", channels, quantum, measure([&]()
+                {
+                    kernel.process(r, sources.data(), destinations.data(), channels, nullptr, 0, quantum,
+                                   -24.f, 30.f, 12.f, 0.003f, 0.25f, 0.006f, 0.f, 1.f,
+                                   0.09f, 0.16f, 0.42f, 0.98f);
+                }, double(quantum) * channels));
+            }
+    }
+
+    void benchHRTFPanner(const std::string & searchPath)
+    {
+        if (searchPath.empty() || !selected("HRTFPanner"))
+            return;
+
+        for (int quantum : QuantumSizes)
+        {
+            OfflineGraph graph(2, quantum);
+            if (!graph.context->loadHrtfDatabase(searchPath))
+            {
+                printf("could not load the HRTF database in %s\n", searchPath.c_str());
+                return;
+            }
+
+            AudioBus input(1, quantum);
+            AudioBus output(2, quantum);
+            fillNoise(input.channel(0)->mutableData(), quantum, 1);
+
+            ContextRenderLock r(graph.context.get(), "LabSoundBench");
+            HRTFPanner panner(SampleRate);
+            double azimuth = 0;
+            report("HRTFPanner (moving)", 1, quantum, measure([&]()
+            {
+                azimuth = azimuth < 180 ? azimuth + 1 : -180;
+                panner.pan(r, azimuth, 0, input, output, 0, quantum);
+            }, quantum));
+        }
+    }
+}
+
+namespace
+{
+    struct Topology
+    {
+        std::vector<std::shared_ptr<AudioNode>> nodes;
+        std::vector<AudioContext::NodeConnection> connections;
+        std::vector<AudioContext::ParamConnection> params;
+
+        std::shared_ptr<OscillatorNode> oscillator(AudioContext & ac, float frequency)
+        {
+            std::shared_ptr<OscillatorNode> node = std::make_shared<OscillatorNode>(ac);
+            node->frequency()->setValue(frequency);
+            node->start(0.f);
+            nodes.push_back(node);
+            return node;
+        }
+
+        std::shared_ptr<GainNode> gain(AudioContext & ac, float value)
+        {
+            std::shared_ptr<GainNode> node = std::make_shared<GainNode>(ac);
+            node->gain()->setValue(value);
+            nodes.push_back(node);
+            return node;
+        }
+    };
+
+    // every oscillator into one gain
+    void buildFanIn(AudioContext & ac, std::shared_ptr<AudioNode> destination, int count, Topology & t)
+    {
+        std::shared_ptr<GainNode> mix = t.gain(ac, 1.f / count);
+        for (int i = 1; i < count; ++i)
+            t.connections.push_back({mix, t.oscillator(ac, 100.f + i)});
+        t.connections.push_back({destination, mix});
+    }
+
+    // an oscillator through a series of gains
+    void buildChain(AudioContext & ac, std::shared_ptr<AudioNode> destination, int count, Topology & t)
+    {
+        std::shared_ptr<AudioNode> previous = t.oscillator(ac, 440.f);
+        for (int i = 1; i < count; ++i)
+        {
+            std::shared_ptr<GainNode> stage = t.gain(ac, 0.999f);
+            t.connections.push_back({stage, previous});
+            previous = stage;
+        }
+        t.connections.push_back({destination, previous});
+    }
+
+    // a grid of oscillators, each row modulating the frequencies of the next, the last
+    // row heard
+    void buildFMMatrix(AudioContext & ac, std::shared_ptr<AudioNode> destination, int count, Topology & t)
+    {
+        const int columns = std::max(1, static_cast<int>(std::sqrt(double(count))));
+        const int rows = std::max(1, count / columns);
+        std::vector<std::shared_ptr<OscillatorNode>> previous;
+        for (int r = 0; r < rows; ++r)
+        {
+            std::vector<std::shared_ptr<OscillatorNode>> row;
+            for (int c = 0; c < columns; ++c)
+            {
+                std::shared_ptr<OscillatorNode> carrier = t.oscillator(ac, 110.f * (1 + c % 8));
+                if (!previous.empty())
+                {
+                    t.params.push_back({carrier->frequency(), previous[c], 0});
+                    t.params.push_back({carrier->frequency(), previous[(c + 1) % columns], 0});
+                }
+                row.push_back(carrier);
+            }
+            previous = std::move(row);
+        }
+        for (const std::shared_ptr<OscillatorNode> & carrier : previous)
+            t.connections.push_back({destination, carrier});
+    }
+
+    // oscillators, each through a panner placed around the listener
+    void buildPanners(AudioContext & ac, std::shared_ptr<AudioNode> destination, int count, Topology & t)
+    {
+        for (int i = 0; i < count / 2; ++i)
+        {
+            std::shared_ptr<PannerNode> panner = std::make_shared<PannerNode>(ac);
+            const float angle = 6.2831853f * i / (count / 2);
+            panner->setPosition(10.f * std::cos(angle), 0.f, 10.f * std::sin(angle));
+            t.nodes.push_back(panner);
+            t.connections.push_back({panner, t.oscillator(ac, 100.f + i)});
+            t.connections.push_back({destination, panner});
+        }
+    }
+
+    // oscillators through gains, every frequency and gain automated
+    void buildAutomation(AudioContext & ac, std::shared_ptr<AudioNode> destination, int count, Topology & t)
+    {
+        std::vector<float> curve(64);
+        for (size_t i = 0; i < curve.size(); ++i)
+            curve[i] = 0.5f + 0.5f * std::sin(0.1f * i);
+        AudioParamTimeline::ValueCurve shared = std::make_shared<const std::vector<float>>(curve);
+
+        for (int i = 0; i < count / 2; ++i)
+        {
+            std::shared_ptr<OscillatorNode> oscillator = t.oscillator(ac, 220.f);
+            oscillator->frequency()->setValueAtTime(220.f, 0.f);
+            oscillator->frequency()->exponentialRampToValueAtTime(880.f, 60.f);
+            std::shared_ptr<GainNode> gain = t.gain(ac, 0.f);
+            gain->gain()->setValueCurveAtTime(shared, 0.f, 60.f);
+            t.connections.push_back({gain, oscillator});
+            t.connections.push_back({destination, gain});
+        }
+    }
+
+    size_t residentBytes()
+    {
+#if defined(__linux__)
+        FILE * statm = fopen("/proc/self/statm", "r");
+        if (!statm)
+            return 0;
+        unsigned long size = 0, resident = 0;
+        const int read = fscanf(statm, "%lu %lu", &size, &resident);
+        fclose(statm);
+        return read == 2 ? size_t(resident) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    void benchTopology(const char * name, void (*build)(AudioContext &, std::shared_ptr<AudioNode>, int, Topology &), int count)
+    {
+        const int quantum = AudioNode::ProcessingSizeInFrames;
+        const int quanta = 256;
+        const size_t residentBefore = residentBytes();
+
+        OfflineGraph graph(2, quantum);
+        AudioContext & ac = *graph.context;
+        Topology t;
+        build(ac, graph.destination, count, t);
+        ac.connect(t.connections, t.params);
+        ac.startOfflineRendering();
+
+        // the first quanta apply the connections, and fill the caches
+        graph.render(uint64_t(quantum) * 16);
+
+        const auto start = std::chrono::steady_clock::now();
+        graph.render(uint64_t(quantum) * quanta);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const size_t residentAfter = residentBytes();
+
+        const ProfileStats render = graph.destination->renderTimeStats(quanta);
+        double dsp = 0;
+        for (const std::shared_ptr<AudioNode> & node : t.nodes)
+            dsp += node->selfTimeStats(quanta).mean;
+
+        char memory[32] = "-";
+        if (residentBefore && residentAfter)
+            snprintf(memory, sizeof(memory), "%.1f MB", (double(residentAfter) - double(residentBefore)) / (1024. * 1024.));
+
+        printf("%-12s %6d nodes %10.1f us/quantum (p99 %10.1f) dsp %10.1f traversal %10.1f  %10s  %8.2fx realtime\n",
+               name, static_cast<int>(t.nodes.size()), render.mean, render.p99, dsp, std::max(0.0, render.mean - dsp),
+               memory, (double(quantum) * quanta / SampleRate) / seconds);
+        fflush(stdout);
+    }
+
+    void benchTopologies(int mostNodes)
+    {
+        struct Kind
+        {
+            const char * name;
+            void (*build)(AudioContext &, std::shared_ptr<AudioNode>, int, Topology &);
+        };
+        const Kind kinds[] = {
+            {"fan-in", buildFanIn},
+            {"chain", buildChain},
+            {"fm-matrix", buildFMMatrix},
+            {"panners", buildPanners},
+            {"automation", buildAutomation},
+        };
+
+        for (const Kind & kind : kinds)
+        {
+            if (!selected(kind.name))
+                continue;
+            for (int count : {10, 100, 1000, 10000, 50000})
+                if (count <= mostNodes)
+                    benchTopology(kind.name, kind.build, count);
+        }
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::string hrtfPath;
+    int graphNodes = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            g_filter = argv[++i];
+        else if (arg == "--hrtf" && i + 1 < argc)
+            hrtfPath = argv[++i];
+        else if (arg == "--seconds" && i + 1 < argc)
+            g_seconds = atof(argv[++i]);
+        else if (arg == "--graphs" && i + 1 < argc)
+            graphNodes = atoi(argv[++i]);
+        else
+        {
+            printf("usage: %s [--filter <text>] [--hrtf <search path>] [--seconds <per measurement>] [--graphs <most nodes>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (graphNodes > 0)
+    {
+        benchTopologies(graphNodes);
+        return 0;
+    }
+
+    benchVectorMath();
+    benchBiquad();
+    benchFFT();
+    benchDynamicsCompressorKernel();
+    benchHRTFPanner(hrtfPath);
+    benchNodes();
+    return 0;
+}
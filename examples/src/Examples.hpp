@@ -939,13 +939,7 @@ struct ex_misc : public labsound_example
         
         _nodes.push_back(pingping->output);
         _nodes.push_back(pingping->input);
-        _nodes.push_back(pingping->leftDelay);
-        _nodes.push_back(pingping->rightDelay);
-        _nodes.push_back(pingping->splitterGain);
-        _nodes.push_back(pingping->wetGain);
-        _nodes.push_back(pingping->feedbackGain);
-        _nodes.push_back(pingping->merger);
-        _nodes.push_back(pingping->splitter);
+        _nodes.push_back(pingping->delay);
 
         Wait(10000);
     }
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+// Compiles the HRTF database in a directory of IRCAM impulse responses for a sample rate,
+// so that AudioContext::loadHrtfDatabase can map it rather than build it at startup.
+//
+//     LabSoundHRTFCompiler <search path> <sample rate> [output file]
+//
+// Without an output file, the database is written into the search path under the name
+// loadHrtfDatabase looks for.
+
+#include "LabSound/LabSound.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3 || argc > 4)
+    {
+        printf("usage: %s <search path> <sample rate> [output file]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string searchPath = argv[1];
+    const float sampleRate = static_cast<float>(atof(argv[2]));
+    if (sampleRate <= 0)
+    {
+        printf("%s is not a sample rate\n", argv[2]);
+        return 1;
+    }
+
+    const std::string output = argc == 4 ? std::string(argv[3]) : searchPath + "/" + lab::AudioContext::compiledHrtfDatabaseName(sampleRate);
+    if (!lab::AudioContext::compileHrtfDatabase(searchPath, sampleRate, output))
+    {
+        printf("could not compile the HRTF database in %s\n", searchPath.c_str());
+        return 1;
+    }
+
+    printf("wrote %s\n", output.c_str());
+    return 0;
+}
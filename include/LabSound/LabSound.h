@@ -12,6 +12,7 @@
 #include "LabSound/core/AudioBasicProcessorNode.h"
 #include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioDevice_External.h"
 #include "LabSound/core/AudioHardwareInputNode.h"
 #include "LabSound/core/AudioListener.h"
 #include "LabSound/core/AudioNodeInput.h"
@@ -25,34 +26,73 @@
 #include "LabSound/core/DelayNode.h"
 #include "LabSound/core/DynamicsCompressorNode.h"
 #include "LabSound/core/GainNode.h"
+#include "LabSound/core/IIRFilterNode.h"
+#include "LabSound/core/MemoryAccounting.h"
+#include "LabSound/core/ModulationBus.h"
 #include "LabSound/core/OscillatorNode.h"
 #include "LabSound/core/PannerNode.h"
+#include "LabSound/core/RenderClock.h"
+#include "LabSound/core/RenderTrace.h"
 #include "LabSound/core/SampledAudioNode.h"
+#include "LabSound/core/SampleStorage.h"
+#include "LabSound/core/SpatialScene.h"
+#include "LabSound/core/StartupTiming.h"
 #include "LabSound/core/StereoPannerNode.h"
 #include "LabSound/core/WaveShaperNode.h"
 #include "LabSound/core/ConstantSourceNode.h"
 // LabSound Extended Public API
 #include "LabSound/extended/ADSRNode.h"
+#include "LabSound/extended/AmbisonicDecoderNode.h"
+#include "LabSound/extended/AudioAssetCache.h"
 #include "LabSound/extended/AudioFileReader.h"
 #include "LabSound/extended/BPMDelayNode.h"
+#include "LabSound/extended/BatchAnalysis.h"
+#include "LabSound/extended/BlockProcessorNode.h"
 #include "LabSound/extended/ClipNode.h"
 #include "LabSound/extended/DiodeNode.h"
+#include "LabSound/extended/EarlyReflectionsNode.h"
+#include "LabSound/extended/EqualizerNode.h"
+#include "LabSound/extended/ExternalSinkNode.h"
+#include "LabSound/extended/ExternalSourceNode.h"
+#include "LabSound/extended/FDNReverbNode.h"
 #include "LabSound/extended/FunctionNode.h"
+#include "LabSound/extended/FrozenSubgraph.h"
 #include "LabSound/extended/GranulationNode.h"
+#include "LabSound/extended/GraphAnalysis.h"
+#include "LabSound/extended/GraphSerialization.h"
+#include "LabSound/extended/HRTFMixerNode.h"
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/extended/LimiterNode.h"
+#include "LabSound/extended/LoadGovernor.h"
+#include "LabSound/extended/LoudnessMeterNode.h"
+#include "LabSound/extended/MetricsRegistry.h"
+#include "LabSound/extended/MixerNode.h"
+#include "LabSound/extended/NetworkSinkNode.h"
+#include "LabSound/extended/NetworkSourceNode.h"
 #include "LabSound/extended/NoiseNode.h"
-//#include "LabSound/extended/PdNode.h"
+#include "LabSound/extended/OfflineRenderer.h"
+#include "LabSound/extended/PdNode.h"
 #include "LabSound/extended/PeakCompNode.h"
 #include "LabSound/extended/PingPongDelayNode.h"
+#include "LabSound/extended/PolyBLEPBankNode.h"
 #include "LabSound/extended/PolyBLEPNode.h"
 #include "LabSound/extended/PowerMonitorNode.h"
 #include "LabSound/extended/PWMNode.h"
 #include "LabSound/extended/RealtimeAnalyser.h"
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/RecorderNode.h"
+#include "LabSound/extended/RenderAheadNode.h"
+#include "LabSound/extended/RenderCache.h"
+#include "LabSound/extended/RenderServer.h"
 #include "LabSound/extended/SfxrNode.h"
 #include "LabSound/extended/SpatializationNode.h"
+#include "LabSound/extended/SpatialLOD.h"
 #include "LabSound/extended/SpectralMonitorNode.h"
+#include "LabSound/extended/SpectralProcessorNode.h"
+#include "LabSound/extended/StemRecorder.h"
+#include "LabSound/extended/StreamingAudioNode.h"
 #include "LabSound/extended/SupersawNode.h"
+#include "LabSound/extended/VoicePool.h"
 
 #endif
 
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef labsound_audiodevice_aaudio_hpp
+#define labsound_audiodevice_aaudio_hpp
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AAudioStreamStruct;
+
+namespace lab
+{
+
+// AudioDevice_AAudio runs the graph in the data callback of an Android AAudio output
+// stream, opened for low latency and exclusive sharing, so that the device can take the
+// MMAP path straight to the hardware's buffer where it has one. The stream's buffer is
+// kept to two bursts, or to the output config's periods, and the callback is asked for
+// the config's period_frames when given, otherwise the device calls back once per burst.
+// When a callback is a multiple of the render quantum, the graph renders straight into
+// it; otherwise a quantum is buffered between callbacks, so a context whose render quantum
+// divides framesPerBurst() avoids the extra quantum of latency.
+//
+// Input, if requested, is a second stream, read without blocking from the output's
+// callback, so that both run on the output's clock. Opening it needs the RECORD_AUDIO
+// permission. A device index of zero is the default device, and a positive one the id of
+// an android.media.AudioDeviceInfo. When a stream is disconnected, as when headphones
+// are unplugged, the device reopens itself on the new default route.
+//
+// AAudio needs API level 26; exclusive MMAP streams need 27 and a device that has them.
+class AudioDevice_AAudio : public AudioDevice
+{
+public:
+    AudioDevice_AAudio(const AudioStreamConfig & inputConfig, const AudioStreamConfig & outputConfig);
+    virtual ~AudioDevice_AAudio();
+
+    float authoritativeDeviceSampleRateAtRuntime {0.f};
+
+    // AudioDevice Interface
+    virtual void start() override final;
+    virtual void stop() override final;
+    virtual bool isRunning() const override final;
+    virtual void backendReinitialize() override final;
+    virtual double roundTripLatency() const override final;
+
+    // The output stream's burst, zero until it is open
+    int framesPerBurst() const { return _framesPerBurst; }
+
+    // True if the output was granted exclusive sharing, and so likely runs on MMAP
+    bool isExclusive() const { return _exclusive; }
+
+    // There is a single device, the default route, probed by opening streams on it;
+    // input channels are only reported with the RECORD_AUDIO permission.
+    static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
+
+    // Called by the stream from its callback thread
+    int render(float * output, int numberOfFrames);
+    void streamError(int error);
+
+private:
+    void open();
+    void close();
+    void renderQuantum();
+
+    AAudioStreamStruct * _outputStream = nullptr;
+    AAudioStreamStruct * _inputStream = nullptr;
+    bool _isRunning = false;
+    bool _exclusive = false;
+    int _framesPerBurst = 0;
+    int _outputChannelCount = 0;
+    int _inputChannelCount = 0;
+
+    // the output config's period and periods, as given; the config reports those granted
+    uint32_t _requestedPeriodFrames = 0;
+    uint32_t _requestedPeriods = 0;
+
+    // the device is reopened on a thread of its own once a stream is disconnected, as
+    // a stream can't be closed from its own callbacks
+    std::mutex _streamLock;
+    std::thread _restartThread;
+    std::atomic<bool> _restartPending {false};
+
+    SamplingInfo samplingInfo;
+    int _renderQuantum = AudioNode::ProcessingSizeInFrames;
+    AudioBus * _renderBus = nullptr;
+    AudioBus * _inputBus = nullptr;
+    int _fill = 0;  // frames of the staged quantum exchanged so far
+    int32_t _xrunCount = 0;  // as the output stream last reported it
+    bool _drainInput = true;
+
+    int _maxFrames = 0;                // the most frames a callback is handled in at once
+    std::vector<float> _inputScratch;  // interleaved, read from the input stream
+    std::vector<const float *> _outputChannels;
+    std::vector<float *> _inputChannels;
+};
+
+}  // namespace lab
+
+#endif  // labsound_audiodevice_aaudio_hpp
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef labsound_audiodevice_coreaudio_hpp
+#define labsound_audiodevice_coreaudio_hpp
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include <vector>
+
+struct ComponentInstanceRecord;
+struct AudioBufferList;
+
+namespace lab
+{
+
+// AudioDevice_CoreAudio runs the graph on macOS in the IO proc of an AUHAL output unit,
+// so that nothing is buffered between the hardware's thread and the graph; the unit's
+// format is the device's own rate, non-interleaved, so the graph renders straight into
+// the unit's buffers. Callbacks may be of any size. When one is a multiple of the render
+// quantum the graph renders in place; otherwise a quantum is buffered between callbacks.
+//
+// The device's buffer is the output config's period_frames, or else the context's render
+// quantum, set when the device starts, so a 64 frame quantum runs on 64 frame buffers.
+// The rate is changed to desired_samplerate if the device supports it, and an exclusive
+// config takes the device in hog mode. Input, if requested, is taken from the output
+// device, when it has input channels, through the same unit; for a separate input device,
+// use an aggregate device, or miniaudio's independent_clock. The unit's os_workgroup is
+// the render workgroup, which the context's render threads join.
+class AudioDevice_CoreAudio : public AudioDevice
+{
+public:
+    AudioDevice_CoreAudio(const AudioStreamConfig & inputConfig, const AudioStreamConfig & outputConfig);
+    virtual ~AudioDevice_CoreAudio();
+
+    float authoritativeDeviceSampleRateAtRuntime {0.f};
+
+    // AudioDevice Interface
+    virtual void start() override final;
+    virtual void stop() override final;
+    virtual bool isRunning() const override final;
+    virtual void backendReinitialize() override final;
+    virtual double roundTripLatency() const override final;
+    virtual void * renderWorkgroup() const override final;
+
+    // The devices, indexed as listed; a device with both inputs and outputs is listed once
+    static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
+
+    // Called by the unit from the device's IO thread
+    int render(uint32_t numberOfFrames, AudioBufferList * ioData, const void * timeStamp);
+
+private:
+    void open();
+    void close();
+    void setBufferFrames(uint32_t frames);
+    void renderQuantum(AudioBus * input, AudioBus * output);
+
+    ComponentInstanceRecord * _unit = nullptr;
+    uint32_t _deviceId = 0;
+    bool _isRunning = false;
+    uint32_t _bufferFrames = 0;
+    uint32_t _requestedPeriodFrames = 0;
+    bool _requestedExclusive = false;
+    bool _hogging = false;  // the device is held in hog mode by this process
+
+    SamplingInfo samplingInfo;
+    int _renderQuantum = AudioNode::ProcessingSizeInFrames;
+
+    // direct rendering points these at the unit's buffers
+    AudioBus * _deviceOutputBus = nullptr;
+    AudioBus * _deviceInputBus = nullptr;
+
+    // buffered rendering stages a quantum in these
+    AudioBus * _renderBus = nullptr;
+    AudioBus * _inputBus = nullptr;
+    int _fill = 0;
+
+    // the input is pulled from the unit into these, a callback's worth at a time
+    std::vector<float> _inputScratch;
+    std::vector<uint8_t> _inputList;
+};
+
+}  // namespace lab
+
+#endif  // labsound_audiodevice_coreaudio_hpp
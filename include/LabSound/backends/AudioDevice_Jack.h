@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef labsound_audiodevice_jack_hpp
+#define labsound_audiodevice_jack_hpp
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include <vector>
+
+typedef struct _jack_client jack_client_t;
+typedef struct _jack_port jack_port_t;
+
+namespace lab
+{
+
+// AudioDevice_Jack runs the graph as a JACK client, in the server's process callback,
+// with a port for each input and output channel. PipeWire serves JACK clients natively
+// through its libjack, so the same backend runs on PipeWire systems.
+//
+// The server decides the sample rate and period; the configs' desired_samplerate is
+// replaced by the server's, and an output period_frames, if given, asks the server to
+// change its buffer size. When the period is a multiple of the render quantum, the graph
+// reads and writes the port buffers directly; otherwise a quantum is buffered between
+// callbacks. The output ports are connected to the physical playback ports, and the
+// physical capture ports to the input ports, when the device starts.
+class AudioDevice_Jack : public AudioDevice
+{
+    jack_client_t * _client = nullptr;
+    std::vector<jack_port_t *> _outputPorts;
+    std::vector<jack_port_t *> _inputPorts;
+    bool _isRunning = false;
+
+    SamplingInfo samplingInfo;
+    int _renderQuantum = AudioNode::ProcessingSizeInFrames;
+
+    // direct rendering points these at the port buffers
+    AudioBus * _deviceOutputBus = nullptr;
+    AudioBus * _deviceInputBus = nullptr;
+
+    // buffered rendering stages a quantum in these
+    AudioBus * _renderBus = nullptr;
+    AudioBus * _inputBus = nullptr;
+    int _fill = 0;
+    bool _direct = true;
+
+    std::vector<float *> _outputBuffers;
+    std::vector<float *> _inputBuffers;
+
+    void open();
+    void close();
+    void connectPhysicalPorts();
+    void renderQuantum(AudioBus * input, AudioBus * output);
+
+public:
+    AudioDevice_Jack(
+        const AudioStreamConfig & inputConfig,
+        const AudioStreamConfig & outputConfig);
+    virtual ~AudioDevice_Jack();
+
+    float authoritativeDeviceSampleRateAtRuntime {0.f};
+
+    // AudioDevice Interface
+    int render(int numberOfFrames);
+    virtual void start() override final;
+    virtual void stop() override final;
+    virtual bool isRunning() const override final;
+    virtual void backendReinitialize() override final;
+    virtual double roundTripLatency() const override final;
+
+    // There is a single device, the server, whose channels are its physical ports.
+    // The list is empty if no server is running.
+    static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
+};
+
+}  // namespace lab
+
+#endif  // labsound_audiodevice_jack_hpp
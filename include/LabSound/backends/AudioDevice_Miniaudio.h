@@ -9,20 +9,59 @@
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/ConcurrentQueue.h"
 
+#include <atomic>
+#include <functional>
+#include <vector>
+
+struct ma_context;
 struct ma_device;
 
 namespace lab {
 
+class DeviceResampler;
+class DriftCompensator;
+
 class AudioDevice_Miniaudio : public AudioDevice
 {
     AudioBus * _renderBus = nullptr;
     AudioBus * _inputBus = nullptr;
     ma_device* _device = nullptr;
+    ma_context * _context = nullptr;  // of the api the config asked for
+    bool _initialized = false;
+
+    // the configs as given, which devices are opened with; _outConfig and _inConfig
+    // report what the open device negotiated
+    AudioStreamConfig _requestedOutConfig;
+    AudioStreamConfig _requestedInConfig;
+
+    // while devices are switched, the device whose callbacks render the graph, the one
+    // taking over from it, and whether either is rendering
+    std::atomic<ma_device *> _renderingDevice{nullptr};
+    std::atomic<ma_device *> _nextDevice{nullptr};
+    std::atomic<bool> _inRender{false};
+
+    // converts a fixed rate graph to the rate of the device rendering, and of the one
+    // taking over from it
+    DeviceResampler * _resampler = nullptr;
+    DeviceResampler * _nextResampler = nullptr;
+
+    // an input on a clock of its own, and the ring that carries it to the output's
+    ma_device * _captureDevice = nullptr;
+    DriftCompensator * _drift = nullptr;
     SamplingInfo samplingInfo;
 
     lab::RingBufferT<float> * _ring = nullptr;
     float * _scratch = nullptr;
     int _remainder = 0;
+    int _renderQuantum = AudioNode::ProcessingSizeInFrames;
+
+    // channel pointers handed to the interleave and deinterleave stage
+    std::vector<const float *> _outputChannels;
+    std::vector<float *> _inputChannels;
+
+    void renderQuantum();
+    DeviceResampler * makeResampler(ma_device * device);
+    void reportNegotiated(ma_device * device);
 
 public:
 
@@ -41,12 +80,33 @@ public:
 
     // AudioDevice Interface
     void render(int numberOfFrames, void * outputBuffer, void * inputBuffer);
+
+    // Takes input from a capture device's callback, when the input has a clock of its own
+    void capture(int numberOfFrames, const void * inputBuffer);
+
+    // Renders into a device's buffers from its callback, if it is the device rendering
+    void deviceCallback(ma_device * device, int numberOfFrames, void * outputBuffer, void * inputBuffer);
     virtual void start() override final;
     virtual void stop() override final;
     virtual bool isRunning() const override final;
     virtual void backendReinitialize() override final;
+    virtual double roundTripLatency() const override final;
+    virtual void * renderWorkgroup() const override final;
 
+    // Returns the devices. They are enumerated once, in the background when the first device
+    // is opened, and again when the system reports a change, so the list is usually ready;
+    // if an enumeration is in flight, it is waited for.
     static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
+
+    // Enumerates the devices again in the background, as after one is connected
+    static void RefreshAudioDeviceList();
+
+    // Makes miniaudio's context, and begins enumerating the devices, on the job system, so
+    // that opening the first device needn't wait to make the context
+    static void Prewarm();
+
+    // Called on a job thread whenever a new device list is ready
+    static void SetAudioDeviceListChangedCallback(std::function<void()> callback);
 };
 
 }  // namespace lab
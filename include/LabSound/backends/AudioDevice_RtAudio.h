@@ -10,6 +10,8 @@
 #include "LabSound/core/AudioDevice.h"
 #include "LabSound/core/AudioNode.h"
 
+#include <vector>
+
 class RtAudio;
 
 namespace lab
@@ -20,6 +22,11 @@ class AudioDevice_RtAudio : public AudioDevice
     std::unique_ptr<AudioBus> _renderBus;
     std::unique_ptr<AudioBus> _inputBus;
     SamplingInfo samplingInfo;
+    uint32_t _bufferFrames = AudioNode::ProcessingSizeInFrames;  // the stream's buffer size, one render quantum
+
+    // channel pointers handed to the interleave and deinterleave stage
+    std::vector<const float *> _outputChannels;
+    std::vector<float *> _inputChannels;
 
     void createContext();
 
@@ -37,8 +44,11 @@ public:
     virtual void stop() override final;
     virtual bool isRunning() const override final;
     virtual void backendReinitialize() override final;
-    
-    static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
+    virtual double roundTripLatency() const override final;
+
+    // The devices of the api; a device's index is only meaningful on the api that listed
+    // it, so a device opened from the list should be configured with the same api
+    static std::vector<AudioDeviceInfo> MakeAudioDeviceList(AudioApi api = AudioApi::Default);
 };
 
 }  // namespace lab
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef labsound_audiodevice_webaudio_hpp
+#define labsound_audiodevice_webaudio_hpp
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+// AudioDevice_WebAudio plays the graph in a browser, for builds made with Emscripten. An
+// AudioWorkletNode, running the module's wasm on the browser's audio thread, is fed from a
+// lock-free ring in the module's memory, a SharedArrayBuffer; the graph renders into the
+// ring on a thread of its own, a quantum at a time, keeping it a few quanta ahead. The
+// worklet's callback only copies, so that the graph's work never runs on the audio thread,
+// where it would have to finish within each 128 frame quantum. Input, if requested, comes
+// back through a second ring, from whatever the application connects to the node's input,
+// such as a getUserMedia stream, using the node handle.
+//
+// Build with -pthread, and link with -sAUDIO_WORKLET=1 -sWASM_WORKERS=1; the page must be
+// served cross origin isolated for the shared memory. The worklet is set up asynchronously,
+// so the device is ready once the browser's main loop has run; start() may be called before
+// then. Browsers only let an audio context start in response to a user's gesture, so
+// start() should be called, or called again, from a gesture's handler.
+class AudioDevice_WebAudio : public AudioDevice
+{
+public:
+    AudioDevice_WebAudio(const AudioStreamConfig & inputConfig, const AudioStreamConfig & outputConfig);
+    virtual ~AudioDevice_WebAudio();
+
+    float authoritativeDeviceSampleRateAtRuntime {0.f};
+
+    // AudioDevice Interface
+    virtual void start() override final;
+    virtual void stop() override final;
+    virtual bool isRunning() const override final;
+    virtual void backendReinitialize() override final;
+    virtual double roundTripLatency() const override final;
+
+    // The Emscripten handles of the audio context and the worklet node, zero until made
+    int audioContextHandle() const { return _context; }
+    int audioNodeHandle() const { return _node.load(std::memory_order_acquire); }
+
+    // There is a single device, the browser's default output, at the browser's rate
+    static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
+
+    // Called by the worklet from the browser's audio thread, with planar buffers of each
+    // channel's frames in turn; either may be null. Not for use otherwise.
+    bool process(const float * input, int inputChannels, float * output, int outputChannels, int frames);
+
+    // Called once the worklet node is made, from the browser's main thread
+    void workletReady(int node);
+
+private:
+    void renderLoop();
+    void renderQuantum();
+
+    int _context = 0;
+    std::atomic<int> _node {0};
+    std::vector<uint8_t> _workletStack;
+
+    std::atomic<bool> _wantRunning {false};
+    std::atomic<bool> _renderThreadShouldRun {false};
+    std::thread _renderThread;
+
+    // the worklet checks that the device isn't closing as it enters process, and the
+    // destructor waits for it to leave
+    std::atomic<bool> _closing {false};
+    std::atomic<bool> _inProcess {false};
+
+    // frames rendered for the worklet, and captured from it
+    std::unique_ptr<AudioRingBuffer> _outputRing;
+    std::unique_ptr<AudioRingBuffer> _inputRing;
+    std::atomic<uint32_t> _consumed {0};  // bumped, and notified, as the worklet takes frames
+    int _leadFrames = 0;                  // kept rendered ahead of the worklet
+
+    SamplingInfo samplingInfo;
+    int _renderQuantum = AudioNode::ProcessingSizeInFrames;
+    AudioBus * _renderBus = nullptr;
+    AudioBus * _inputBus = nullptr;
+    std::vector<float *> _outputChannels;
+    std::vector<float *> _inputChannels;
+};
+
+}  // namespace lab
+
+#endif  // labsound_audiodevice_webaudio_hpp
@@ -56,6 +56,10 @@ public:
     void setSmoothingTimeConstant(double k);
     double smoothingTimeConstant() const;
 
+    // The get functions read the latest analysis published by the audio thread, which
+    // analyses only when asked to by an earlier call, so they neither lock nor run an FFT.
+    // They are to be called from one thread.
+
     // frequency bins, reported in db
     void getFloatFrequencyData(std::vector<float> & array);
 
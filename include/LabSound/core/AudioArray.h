@@ -4,6 +4,9 @@
 #ifndef AudioArray_h
 #define AudioArray_h
 
+#include "LabSound/core/AudioMemoryPool.h"
+#include "LabSound/core/MemoryAccounting.h"
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h> // for memset
@@ -11,24 +14,44 @@
 namespace lab
 {
 
+// An array of samples drawn from the AudioMemoryPool, so aligned to AudioMemoryPool::Alignment.
+// Its storage is padded to a whole number of alignments, the width of the widest vector a
+// kernel may load, and the padding is always zero, so a kernel may run over paddedSize()
+// elements in whole aligned vectors without a scalar tail, as long as what it writes into
+// the padding is zero.
 template <typename T>
 class AudioArray
 {
-    T * _allocation = nullptr;
     T * _data = nullptr;
     int _size = 0;
+    int _paddedSize = 0;
     T _safety;
+    std::shared_ptr<MemoryOwner> _memory;  // charged for _data
+
+    void release()
+    {
+        AudioMemoryPool::deallocate(_data, sizeof(T) * _paddedSize);
+        if (_memory)
+            _memory->charge(-static_cast<int64_t>(sizeof(T) * _paddedSize));
+        _memory.reset();
+        _data = nullptr;
+        _size = 0;
+        _paddedSize = 0;
+    }
 
 public:
+    // the element count storage is padded to a multiple of
+    static constexpr int Padding = AudioMemoryPool::Alignment > sizeof(T) ? int(AudioMemoryPool::Alignment / sizeof(T)) : 1;
+
+    static int paddedSizeFor(int n) { return (n + Padding - 1) / Padding * Padding; }
+
     explicit AudioArray()
-    : _allocation(nullptr)
-    , _data(nullptr)
+    : _data(nullptr)
     , _size(0)
     , _safety(0) {}
     
     explicit AudioArray(int n)
-    : _allocation(nullptr)
-    , _data(nullptr)
+    : _data(nullptr)
     , _size(0)
     , _safety(0)
     {
@@ -37,29 +60,35 @@ public:
 
     ~AudioArray()
     {
-        free(_allocation);
+        release();
     }
 
-    // allocation will realloc if necessary.
-    // the buffer will be zeroed whether reallocated or not
+    static void * operator new(size_t size)
+    {
+        void * p = AudioMemoryPool::allocate(size);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void operator delete(void * p, size_t size) { AudioMemoryPool::deallocate(p, size); }
+
+    // allocation will reallocate if necessary, from the AudioMemoryPool, which
+    // hands out zeroed memory; an array already of size n is left as it is
     //
     void allocate(int n)
     {
-        const uintptr_t alignment = 0x10;
-        const uintptr_t mask = ~0xf;
-        size_t initialSize = sizeof(T) * n + alignment;
         if (_size != n) {
-            free(_allocation);
+            release();
 
             if (n > 0) {
-                _allocation = static_cast<T*>(calloc(initialSize, 1));
-                _data = (T*)((((intptr_t)_allocation) + (alignment-1)) & mask);
-                _size = n;
-            }
-            else {
-                _allocation = nullptr;
-                _data = nullptr;
-                _size = 0;
+                const int padded = paddedSizeFor(n);
+                _data = static_cast<T*>(AudioMemoryPool::allocate(sizeof(T) * padded));
+                if (_data) {
+                    _size = n;
+                    _paddedSize = padded;
+                    _memory = MemoryAccounting::charge(static_cast<int64_t>(sizeof(T) * padded));
+                }
             }
         }
     }
@@ -70,6 +99,9 @@ public:
     // size in samples, not bytes
     int size() const { return _size; }
 
+    // size rounded up to a multiple of Padding; the samples past size() are zero
+    int paddedSize() const { return _paddedSize; }
+
     T & operator[](size_t i) {
         if (_data)
             return _data[i];
@@ -79,7 +111,7 @@ public:
     void zero()
     {
         if (_data)
-            memset(_data, 0, sizeof(T) * size());
+            memset(_data, 0, sizeof(T) * _paddedSize);
     }
 
     void zeroRange(unsigned start, unsigned end)
@@ -27,6 +27,9 @@ class AudioBasicInspectorNode : public AudioNode
 public:
     AudioBasicInspectorNode(AudioContext & ac, AudioNodeDescriptor const & desc);
     virtual ~AudioBasicInspectorNode() = default;
+
+    // inspectors observe every quantum, including silent ones, so they never go dormant
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; }
 };
 
 }  // namespace lab
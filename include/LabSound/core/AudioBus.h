@@ -25,20 +25,65 @@ class AudioBus
     AudioBus(const AudioBus &);  // noncopyable
 
 public:
-    // Can define non-standard layouts here:
+    // Speaker layouts say which speaker each channel of a bus feeds, for up and down
+    // mixing. A bus with LayoutCanonical has the standard layout for its number of
+    // channels, if there is one; a bus with a channel count without one mixes discretely.
+    // Other layouts are registered with registerLayout(), and mix as fast as these.
     enum
     {
-        LayoutCanonical = 0
+        LayoutCanonical = 0,
+        LayoutMono,    // C
+        LayoutStereo,  // L R
+        LayoutQuad,    // L R SL SR
+        Layout5_0,     // L R C SL SR
+        Layout5_1,     // L R C LFE SL SR
+        Layout7_1,     // L R C LFE SL SR BL BR
+        Layout7_1_4    // L R C LFE SL SR BL BR TFL TFR TBL TBR
     };
 
+    // Returns the id of a layout with a channel at each of the given positions, in order,
+    // registering it if it hasn't been. Throws std::invalid_argument if a position is
+    // repeated. Not to be called on the audio thread.
+    static int registerLayout(const Channel * positions, int count);
+
     // allocate indicates whether or not to initially have the AudioChannels created with managed storage.
-    // Normal usage is to pass true here, in which case the AudioChannels will memory-manage their own storage.
+    // Normal usage is to pass true here, in which case the bus allocates one planar block for all of its
+    // channels, each channel's frames following the last's, aligned to AudioMemoryPool::Alignment.
     // If allocate is false then setChannelMemory() has to be called later on for each channel before the AudioBus is useable...
     AudioBus(int numberOfChannels, int length, bool allocate = true);
+    ~AudioBus();
+
+    // busses are created and destroyed on the audio thread, so they come from the pool
+    static void * operator new(size_t size)
+    {
+        void * p = AudioMemoryPool::allocate(size);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void operator delete(void * p, size_t size) { AudioMemoryPool::deallocate(p, size); }
 
     // Tells the given channel to use an externally allocated buffer.
     void setChannelMemory(int channelIndex, float * storage, int length);
 
+    // The planar block holding every channel, channelStride() floats apart, so that
+    // processing many channels can stream through memory linearly; nullptr if the bus
+    // wasn't allocated, a channel has been given other memory, or a channel is aliasing
+    // another's samples.
+    float * planarData();
+    const float * planarData() const;
+    int channelStride() const { return m_channelStride; }
+
+    // Copy frames to or from interleaved memory holding numberOfChannels() samples a frame.
+    void copyToInterleaved(float * destination, int frames) const;
+    void copyFromInterleaved(const float * source, int frames);
+
+    // A layout with a different number of channels than the bus is ignored, and the bus
+    // mixes as if it had LayoutCanonical.
+    void setLayout(int layout) { m_layout = layout; }
+    int layout() const { return m_layout; }
+
     // Channels
     int numberOfChannels() const { return static_cast<int>(m_channels.size()); }
     void setNumberOfChannels(ContextRenderLock&, int c);
@@ -86,6 +131,7 @@ public:
     void scale(float scale);
 
     void reset() { m_isFirstTime = true; }  // for de-zippering
+    void setFirstTime(bool firstTime) { m_isFirstTime = firstTime; }
 
     // Assuming sourceBus has the same topology, copies sample data from each channel of sourceBus to our corresponding channel.
     void copyFrom(const AudioBus & sourceBus, ChannelInterpretation = ChannelInterpretation::Speakers);
@@ -128,25 +174,41 @@ public:
     // Creates a new AudioBus by cloning an existing one
     static std::unique_ptr<AudioBus> createByCloning(const AudioBus * sourceBus);
 
+    // Creates a new AudioBus whose channels are the given externally owned memory, without
+    // copying it. The memory must outlive the bus, and is written to by anything that writes
+    // to the bus. Memory aligned to AudioMemoryPool::Alignment is processed fastest.
+    static std::unique_ptr<AudioBus> createByWrapping(float * const * channels, int numberOfChannels, int length, float sampleRate);
+
 protected:
 
     AudioBus() = default;
 
+    // the registered layout the bus mixes with, or zero if it has none
+    int speakerLayout() const;
+
     void speakersCopyFrom(const AudioBus &);
     void discreteCopyFrom(const AudioBus &);
     void speakersSumFrom(const AudioBus &);
     void discreteSumFrom(const AudioBus &);
-    void speakersSumFrom5_1_ToMono(const AudioBus &);
-    void speakersSumFrom7_1_ToMono(const AudioBus &);
+
+    // allocates the planar block for the channels, keeping the frames of the first
+    // preserveChannels, and points the channels at it
+    void allocatePlanar(int numberOfChannels, int preserveChannels);
 
     std::unique_ptr<AudioFloatArray> m_dezipperGainValues;
-    std::vector<std::unique_ptr<AudioChannel>> m_channels;
+    std::vector<std::unique_ptr<AudioChannel>, AudioMemoryAllocator<std::unique_ptr<AudioChannel>>> m_channels;
 
     bool m_isFirstTime = true;
     float m_sampleRate = 0.0f;
     float m_busGain = 1.0f;
     int m_layout = LayoutCanonical;
     int m_length = 0;
+
+    float * m_block = nullptr;
+    size_t m_blockBytes = 0;
+    std::shared_ptr<MemoryOwner> m_memory;  // charged for m_block
+    int m_channelStride = 0;
+    bool m_planar = false;
 };
 
 }  // lab
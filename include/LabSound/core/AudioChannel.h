@@ -49,27 +49,59 @@ public:
     void set(float * storage, int length)
     {
         m_memBuffer.reset();  // clean up managed storage
+        m_alias = nullptr;
         m_rawPointer = storage;
         m_length = length;
         m_silent = false;
+        m_constant = false;
     }
 
+    // channels are created and destroyed on the audio thread, so they come from the pool
+    static void * operator new(size_t size)
+    {
+        void * p = AudioMemoryPool::allocate(size);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void operator delete(void * p, size_t size) { AudioMemoryPool::deallocate(p, size); }
+
     // How many sample-frames do we contain?
     int length() const { return m_length; }
 
+    // The frames data() may be read to in whole vectors. A channel holding its own samples is
+    // padded with zeroes to a multiple of AudioFloatArray::Padding; a channel referring to
+    // external memory, or aliasing another channel, or resized smaller, isn't padded.
+    int paddedLength() const
+    {
+        if (m_memBuffer && !m_alias && !m_rawPointer && m_length == m_memBuffer->size())
+            return m_memBuffer->paddedSize();
+        return m_length;
+    }
+
     // resizeSmaller() can only be called with a new length <= the current length.
     // The data stored in the bus will remain undisturbed.
     void resizeSmaller(int newLength);
 
-    // Direct access to PCM sample data. Non-const accessor clears silent flag.
+    // Direct access to PCM sample data. Non-const accessor clears silent flag,
+    // and copies the samples of an aliased channel into the channel's own memory.
     float * mutableData()
     {
         clearSilentFlag();
-        return const_cast<float *>(data());
+        if (m_alias)
+            unalias();
+        float * samples = const_cast<float *>(data());
+        m_constant = false;
+        return samples;
     }
 
     const float * data() const
     {
+        if (m_constant && !m_constantWritten)
+            writeConstant();
+        if (m_alias)
+            return m_alias;
         if (m_rawPointer)
             return m_rawPointer;
         if (m_memBuffer)
@@ -77,9 +109,28 @@ public:
         return nullptr;
     }
 
+    // Makes data() read the source channel's samples, without copying them, until the
+    // channel is next written to, when they are copied first. The source's samples must
+    // not change while the channel refers to them; within a render quantum, another
+    // node's rendered output doesn't.
+    void alias(const AudioChannel * sourceChannel);
+    bool isAliased() const { return m_alias != nullptr; }
+
+    // Makes every frame of the channel hold value, without writing the samples until
+    // data() or mutableData() is next called. Consumers that check isConstant() can use
+    // constantValue() instead, so that a control signal passed from node to node is
+    // never written out at all.
+    void setConstant(float value);
+
+    // True if every frame holds constantValue(), as a silent channel does
+    bool isConstant() const { return m_constant || m_silent; }
+    float constantValue() const { return m_constant ? m_constantValue : 0.f; }
+
     // Zeroes out all sample values in buffer.
     void zero()
     {
+        m_alias = nullptr;
+        m_constant = false;
         if (m_silent) return;
 
         m_silent = true;
@@ -122,10 +173,17 @@ public:
     float maxAbsValue() const;
 
 private:
+    void unalias();
+    void writeConstant() const;
+
     int m_length = 0;
+    const float * m_alias = nullptr;
     float * m_rawPointer = nullptr;
     std::unique_ptr<AudioFloatArray> m_memBuffer;
     bool m_silent = true;
+    bool m_constant = false;
+    mutable bool m_constantWritten = false;
+    float m_constantValue = 0.f;
 };
 
 }  // lab
@@ -7,6 +7,8 @@
 #define lab_audio_context_h
 
 #include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/core/RenderClock.h"
+#include "LabSound/core/ThreadScheduling.h"
 
 #include <atomic>
 #include <condition_variable>
@@ -16,6 +18,7 @@
 #include <set>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace lab {
@@ -26,11 +29,66 @@ class AudioListener;
 class AudioNode;
 class AudioNodeInput;
 class AudioNodeOutput;
+class AudioParam;
+class AudioSetting;
 class AudioDestinationNode;
 class AudioScheduledSourceNode;
 class ContextGraphLock;
 class ContextRenderLock;
 class HRTFDatabaseLoader;
+class ModulationBus;
+class SpatialScene;
+
+// The kinds of event the audio thread signals about a node. Each is delivered to the
+// node's handler for it when events are dispatched.
+enum class AudioEventKind : int
+{
+    Ended = 0  // the node's scheduler reached its end; calls the onEnded handler
+};
+
+enum class AudioCommandKind : int;
+
+// A render capture copies audio out of the graph at the end of each render quantum, once
+// every node has rendered, without being a node in the graph itself; see StemRecorder.
+class AudioRenderCapture
+{
+public:
+    virtual ~AudioRenderCapture() = default;
+
+    // Called from the audio thread
+    virtual void capture(ContextRenderLock &, int framesToProcess) = 0;
+
+    // The outputs the capture reads, which keep their own buses rather than sharing scratch
+    // buses with the rest of the render schedule
+    virtual void capturedOutputs(std::vector<AudioNodeOutput *> & outputs) const {}
+};
+
+// What the render thread was doing when a render quantum overran the watchdog's deadline
+struct RenderStall
+{
+    double elapsed = 0;                        // seconds since the quantum began
+    uint64_t sampleFrame = 0;                  // the context's frame at the quantum
+    bool waitingForRenderLock = false;         // the quantum hadn't yet taken the render lock
+    const char * renderLockHolder = nullptr;   // the tags of the locks' holders, or null
+    const char * graphLockHolder = nullptr;
+    const char * node = nullptr;               // the name of the node processing, or null between nodes
+};
+
+// The context's counters and queue depths, as AudioContext::metrics() reads them
+struct AudioContextMetrics
+{
+    uint64_t renderStalls = 0;        // quanta the watchdog reported
+    uint64_t renderLockMisses = 0;    // quanta rendered as silence as the render lock was held
+    int scheduledNodes = 0;           // in the render schedule
+    int playingSources = 0;           // scheduled nodes that are playing, such as voices
+    size_t pendingConnections = 0;    // connections, parameter connections and graph edits queued
+    size_t pendingEvents = 0;         // node events awaiting dispatch
+    uint64_t droppedEvents = 0;       // node events dropped as the queue was full
+    uint64_t eventsDispatched = 0;    // node events
+    double eventLatencyTotal = 0;     // seconds between the events being enqueued and dispatched
+    double eventLatencyPeak = 0;      // the longest, since metrics were last read
+    uint64_t denormalQuanta = 0;      // node quanta that underflowed, while detection is on
+};
 
 class AudioContext
 {
@@ -61,7 +119,7 @@ public:
 
         int _id = 0;
         AudioContext * _ac = nullptr;
-        double _currentTime = 0;
+        std::atomic<double> _currentTime {0};  // written by the audio thread once per quantum
 
     public:
         AudioContextInterface(AudioContext * ac, int id)
@@ -75,7 +133,11 @@ public:
         // the contextId of two AudioNodeInterfaces can be compared
         // to discover if they refer to the same context.
         int contextId() const { return _id; }
-        double currentTime() const { return _currentTime; }
+        double currentTime() const { return _currentTime.load(std::memory_order_relaxed); }
+
+        // Resumes the context if it has suspended itself for silence; see setAutoSuspend().
+        // Safe from any thread, including the audio thread.
+        void wake();
     };
 
     std::weak_ptr<AudioContextInterface> audioContextInterface() { return m_audioContextInterface; }
@@ -94,30 +156,160 @@ public:
     // configuration
     bool isAutodispatchingEvents() const;
     bool isOfflineContext() const;
+
+    // Loads the HRTF impulse responses in searchPath. searchPath may instead name a database
+    // written by compileHrtfDatabase(), or an AES69 .sofa file if LabSound was built with
+    // LABSOUND_USE_LIBMYSOFA, and one in searchPath named compiledHrtfDatabaseName() for the
+    // context's sample rate is used in preference to the impulse responses. Contexts loading
+    // the same database at the same rate share it; others load their own.
     bool loadHrtfDatabase(const std::string & searchPath);
+
+    // As loadHrtfDatabase(), without waiting. completion, if given, is called with the result
+    // once the database is loaded, on the loading thread, or at once if it already was. HRTF
+    // panners are silent until then.
+    void loadHrtfDatabaseAsync(const std::string & searchPath, std::function<void(bool)> completion = {});
     std::shared_ptr<HRTFDatabaseLoader> hrtfDatabaseLoader() const;
 
+    // The elevations of a database loaded from impulse responses are made as they are first
+    // panned to, and nearby ones in the background. This limits how many are kept in memory
+    // at once, releasing the least recently used; zero, the default, keeps all that are made.
+    // Applies to the database this context loads, which other contexts may share.
+    void setHrtfResidentLimit(int elevations);
+
+    // Builds the HRTF database in searchPath for sampleRate and writes it to path, ready to be
+    // mapped and used without decoding, resampling or transforming the impulse responses.
+    // Returns true on success.
+    static bool compileHrtfDatabase(const std::string & searchPath, float sampleRate, const std::string & path);
+    static std::string compiledHrtfDatabaseName(float sampleRate);
+
+    // The context's rate, or, on a thread processing a decimated node, that fraction of it.
+    // See AudioNode::setDecimation().
     float sampleRate() const;
 
+    // The decimation of the node processing on the calling thread, and one on any other.
+    // Each node sets its own as it processes, and restores the last, which is returned.
+    static int renderDecimation();
+    static int setRenderDecimation(int decimation);
+
+    // The number of threads that render the graph, including the device's
+    // own audio thread. The default of one renders everything on the audio
+    // thread; a higher count renders independent branches of the graph
+    // concurrently on a pool of worker threads that join before the
+    // destination node sums its inputs.
+    void setRenderThreadCount(int threadCount);
+    int renderThreadCount() const;
+
+    // How the render worker threads are scheduled. Realtime priority keeps the workers to
+    // the device's deadline while the system is busy. Unless the scheduling names them,
+    // workers join the device's audio workgroup, where it has one, and are budgeted for the
+    // render quantum. Restarts the workers if there are any.
+    void setRenderThreadScheduling(const ThreadScheduling & scheduling);
+    ThreadScheduling renderThreadScheduling() const;
+
+    // The number of frames rendered per pass through the graph, a power of two
+    // between AudioNode::MinProcessingSizeInFrames and MaxProcessingSizeInFrames.
+    // Larger quanta amortize per node overhead for offline rendering, smaller
+    // ones lower the latency of live monitoring. Nodes size their buffers to
+    // the quantum when they are created, so it must be set before any nodes,
+    // including the destination node, are created.
+    void setRenderQuantumSize(int frames);
+    int renderQuantumSize() const;
+
+    // Each node of a cycle in the graph, such as a DelayNode fed back to itself through a
+    // GainNode, renders once per quantum, and the node closing the cycle reads what the
+    // others rendered the quantum before, so the audio takes at least a quantum to go
+    // around, however short its delays. With a feedback block size, a power of two
+    // smaller than the quantum, the render schedule renders each cycle that many frames
+    // at a time, while the rest of the graph renders a quantum at a time, and the audio
+    // goes around in a block plus the delays of the cycle's nodes. Combs and plucked
+    // strings can then be built from stock nodes, tuned by a DelayNode set a block short
+    // of their period. A cycle's nodes are processed once per block, so small blocks cost
+    // more. Zero, the default, renders cycles a quantum at a time. The size may be changed
+    // while rendering.
+    void setFeedbackBlockSize(int frames);
+    int feedbackBlockSize() const;
+
+    // Nodes that delay their audio, as their latencyTime reports, such as lookahead limiters
+    // and partitioned convolvers, put the paths through them behind paths that don't. With
+    // compensation, which is on by default, the render schedule delays the connections of
+    // the shorter paths wherever paths are summed, by an input or across a node's inputs,
+    // so that they line up. Parameter connections aren't delayed. A node's latency is
+    // checked every quantum, and the delays follow it.
+    void setLatencyCompensation(bool enabled);
+    bool latencyCompensation() const;
+
+    // The latency of the longest path to the destination, in seconds, which the shorter
+    // paths are delayed to match
+    double graphLatency() const;
+
+    // Every thread LabSound renders on flushes denormals to zero, where the processor can.
+    // With detection on, which is off by default, each node's processing is checked for
+    // floating point underflow, as where a feedback filter or a decaying envelope falls
+    // into the denormal range, and the quanta in which it underflowed are counted against
+    // the node, as AudioNode::denormalQuanta reports, and the context, in its metrics().
+    // That finds the nodes that would fall off a performance cliff without the flush, or on
+    // a processor without it. Detection costs a little per node processed.
+    void setDenormalDetection(bool enabled);
+    bool denormalDetection() const { return m_denormalDetection.load(std::memory_order_relaxed); }
+
     void setDestinationNode(std::shared_ptr<AudioDestinationNode> node);
     std::shared_ptr<AudioDestinationNode> destinationNode();
     std::shared_ptr<AudioListener> listener();
 
-    // Debugging/Sanity Checking
-    std::string m_graphLocker;
-    std::string m_renderLocker;
+    // The context's tempo, and the tempo-synced modulators shared by its parameters
+    std::shared_ptr<ModulationBus> modulation();
+
+    // The transforms of the panners moved together, a slot per panner
+    std::shared_ptr<SpatialScene> spatialScene();
+
+    // Debugging/Sanity Checking. The tag of each lock's holder, null while it is free.
+    std::atomic<const char *> m_graphLocker {nullptr};
+    std::atomic<const char *> m_renderLocker {nullptr};
+    std::atomic<const char *> m_renderingNode {nullptr};  // the name of the node in process()
+    std::atomic<uint64_t> m_denormalQuanta {0};           // node quanta that underflowed
+
+    // Watches the render thread. If a render quantum hasn't finished deadline seconds after it
+    // began, a RenderStall is logged from the watchdog's thread, and passed to onStall there
+    // if given, so that a glitch can be told apart as a wait for the render lock, a node slow
+    // to process, or the render thread not running. A stall is reported once per quantum. A
+    // deadline of zero stops watching.
+    void setRenderWatchdog(double deadline, std::function<void(const RenderStall &)> onStall = {});
+    uint64_t renderStallCount() const;
+
+    // The context's counters and queue depths, for monitoring. The audio thread keeps them
+    // with relaxed atomic stores, and reading them takes neither the graph nor the render
+    // lock, so any thread may poll them while the context renders. The playing source
+    // count is kept from the first call on.
+    AudioContextMetrics metrics() const;
+
+    // The render thread's heartbeat. Only lab::pull_graph should call this.
+    enum class RenderPhase : int { Idle = 0, WaitingForLock, Rendering };
+    void setRenderPhase(RenderPhase phase);
     void debugTraverse(AudioNode * root);
     void diagnose(std::shared_ptr<AudioNode>);
     void diagnosed_silence(const char*  msg);
     std::shared_ptr<AudioNode> diagnosing() const { return _diagnose; }
+    bool isDiagnosing(const AudioNode * node) const { return _diagnose.get() == node; }
+
+    // Nodes' processing is timed, for their selfTimeStats, in one quantum of every
+    // quanta, 8 by default, so that the statistics cost little to keep; 1 times every
+    // quantum, and 0 none. The destination times every quantum regardless, for
+    // renderTimeStats. Nothing is timed if LabSound is built with LABSOUND_PROFILING 0.
+    void setProfileSampling(int quanta);
+    int profileSampling() const;
+
+    // Whether nodes time the quantum being rendered. Only the audio thread should call this.
+    bool profilingThisQuantum() const { return m_profilingThisQuantum; }
 
     // Timing related
 
     // The current time, measured at the start of the render quantum currently
-    // being processed. Most useful in a Node's process routine.
+    // being processed, or of the block, while a cycle renders in feedback blocks.
+    // Most useful in a Node's process routine.
     double currentTime() const;
 
-    // The current epoch (total count of previously processed render quanta)
+    // The current epoch (total count of previously processed frames), at the
+    // start of the quantum, or of the block of a cycle rendering in feedback blocks.
     // Useful in recurrent graphs to discover if a node has already done its
     // processing for the present quanta.
     uint64_t currentSampleFrame() const;
@@ -130,6 +322,10 @@ public:
     // expected audio events and other systems.
     double predictedCurrentTime() const;
 
+    // The sample frame, time and host timestamp of the last quantum rendered, taken
+    // together, so that they agree with one another. Cheap, and safe from any thread.
+    RenderClockSnapshot clock() const;
+
     // engine
     
     void startOfflineRendering();
@@ -142,6 +338,17 @@ public:
     // if the context was suspended, resume the progression of time and processing
     // in the audio context
     void resume();
+
+    // Suspends the device, to save power, once the output has been silent for the given
+    // time with nothing due to sound: no node scheduled to start, param automation still to
+    // come, or command or connection in flight. Connecting nodes, starting a node, or sending
+    // a command resumes it, as does resume(); setting a param's value directly doesn't. Audio
+    // time stands still while the device is suspended. Zero, the default, never suspends.
+    void setAutoSuspend(double silentSeconds);
+    bool isAutoSuspended() const;
+
+    // Counts silent output towards auto-suspend. Only lab::pull_graph should call this.
+    void updateAutoSuspend(ContextRenderLock &, const AudioBus * output, int frames);
     
     // Close releases any system audio resources that it uses. It is asynchronous,
     // returning a promise object that can wait() until all AudioContext-creation-blocking
@@ -169,6 +376,22 @@ public:
     // Only an AudioDestinationNode should call this.
     void processAutomaticPullNodes(ContextRenderLock &, int framesToProcess);
 
+    // Render captures are run once every node has rendered, after the automatic pull
+    // nodes. A capture added or removed takes effect at the next render quantum, and is
+    // held by the audio thread until then.
+    void addRenderCapture(std::shared_ptr<AudioRenderCapture>);
+    void removeRenderCapture(std::shared_ptr<AudioRenderCapture>);
+
+    // Only an AudioDestinationNode should call this.
+    void processRenderCaptures(ContextRenderLock &, int framesToProcess);
+
+    // Runs every node in the compiled render schedule, in dependency order,
+    // so that the pull from the destination node finds each upstream node
+    // already rendered rather than recursing through the graph. The schedule
+    // is recompiled by handlePreRenderTasks() whenever the topology changes.
+    // Only an AudioDestinationNode should call this.
+    void processCompiledRenderSchedule(ContextRenderLock &, int framesToProcess);
+
     // graph management
     //
     void connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx = 0, int srcIdx = 0);
@@ -178,6 +401,61 @@ public:
     // completely disconnect the node from the graph
     void disconnect(std::shared_ptr<AudioNode> node, int destIdx = 0);
 
+    struct NodeConnection
+    {
+        std::shared_ptr<AudioNode> destination;
+        std::shared_ptr<AudioNode> source;
+        int destIdx = 0;
+        int srcIdx = 0;
+    };
+
+    struct ParamConnection
+    {
+        std::shared_ptr<AudioParam> param;
+        std::shared_ptr<AudioNode> driver;
+        int index = 0;
+    };
+
+    // Makes the connections as connect and connectParam would, as one GraphEdit. Every
+    // connection is checked before any is queued.
+    void connect(const std::vector<NodeConnection> & nodes, const std::vector<ParamConnection> & params);
+
+    // A batch of connections and disconnections, checked as they are made, which the audio
+    // thread applies together in a single quantum, with one recompile of the render
+    // schedule, rather than as each is dequeued. Parameter edits are applied before node
+    // edits, as they are when made one at a time. Disconnections begin their ramp out in
+    // that quantum, and finish as individual ones do. An edit that is destroyed without
+    // being committed is discarded.
+    class GraphEdit
+    {
+        friend class AudioContext;
+        struct Pending;
+
+        AudioContext * _context = nullptr;
+        std::unique_ptr<Pending> _pending;
+
+        GraphEdit(AudioContext * context, std::unique_ptr<Pending> pending);
+
+    public:
+        GraphEdit(GraphEdit &&) noexcept;
+        GraphEdit & operator=(GraphEdit &&) noexcept;
+        ~GraphEdit();
+
+        GraphEdit & connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx = 0, int srcIdx = 0);
+        GraphEdit & disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx = 0, int srcIdx = 0);
+        GraphEdit & disconnect(std::shared_ptr<AudioNode> node, int destIdx = 0);
+        GraphEdit & connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index);
+        GraphEdit & disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index);
+
+        // the edits made and not yet committed
+        size_t size() const;
+
+        // Queues the edits for the audio thread as one transaction, and leaves this empty
+        void commit();
+    };
+
+    GraphEdit beginGraphEdit();
+
     // connecting and disconnecting busses and parameters occurs asynchronously.
     // synchronizeConnections will block until there are no pending connections,
     // or until the timeout occurs.
@@ -190,6 +468,7 @@ public:
 
     // connect destinationNode's named parameter input to driver's indexed output
     void connectParam(std::shared_ptr<AudioNode> destinationNode, char const*const parameterName, std::shared_ptr<AudioNode> driver, int index);
+    void connectParam(std::shared_ptr<AudioNode> destinationNode, NameId parameter, std::shared_ptr<AudioNode> driver, int index);
 
     // disconnect a parameter from the indexed output of a node
     void disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index);
@@ -199,9 +478,35 @@ public:
     // event dispatching will be called automatically, depending on constructor
     // argument. If not automatically dispatching, it is the user's responsibility
     // to call dispatchEvents often enough to satisfy the user's needs.
+    //
+    // Events about a node are fixed size records pushed into a preallocated queue,
+    // so the audio thread may enqueue them without allocating or locking. The node's
+    // internals, and with them its handlers, are kept until the event is dispatched.
+    // If the queue is full the event is dropped, and a warning logged on dispatch.
+    void enqueueEvent(AudioNode &, AudioEventKind);
+
+    // Arbitrary functions may be queued from any thread but the audio thread, as
+    // queueing one may allocate.
     void enqueueEvent(std::function<void()> &);
     void dispatchEvents();
 
+    // commands
+    //
+    // Commands change parameters, settings and scheduling at a given context time, with
+    // sample accuracy. Any thread, such as a sequencer's, may send them at a high rate
+    // without locking; they are queued for the audio thread, which applies each in the
+    // render quantum it lands in. A parameter's values and ramps are placed on its timeline
+    // as soon as they are received, and render from the exact frame; starts and stops are
+    // scheduled for the exact frame; a setting changes at the start of the quantum, on the
+    // audio thread, calling its value changed callback there. A command whose time has
+    // passed is applied at the next quantum. Each returns false, dropping the command, if
+    // the queue is full.
+    bool sendParamValue(std::shared_ptr<AudioParam> param, float value, double time);
+    bool sendParamRamp(std::shared_ptr<AudioParam> param, float value, double time);  // linear, ending at time
+    bool sendStart(std::shared_ptr<AudioNode> node, double time);
+    bool sendStop(std::shared_ptr<AudioNode> node, double time);
+    bool sendSetting(std::shared_ptr<AudioSetting> setting, float value, double time);
+
     void appendDebugBuffer(AudioBus* bus, int channel, int count);
     void flushDebugBuffer(char const* const wavFilePath);
 
@@ -215,32 +520,52 @@ private:
 
     std::mutex m_graphLock;
     std::mutex m_renderLock;
+    std::atomic<uint64_t> m_renderLockMisses {0};  // quanta the audio callback rendered as silence
     std::mutex m_updateMutex;
-    std::condition_variable cv;
 
-    // -1 means run forever, 0 means stop, n > 0 means run this many times
-    // n > 0 will decrement to zero each time update runs.
+    // -1 means run until signaled to stop by setting 0
     std::atomic<int> updateThreadShouldRun{-1};
     std::thread graphUpdateThread;
     float graphKeepAlive{0.f};
     float lastGraphUpdateTime{0.f};
 
     std::atomic<int> _contextIsInitialized{0};
+    int m_renderQuantumSize = AudioNode::ProcessingSizeInFrames;
+    std::atomic<int> m_profileSampling{8};
+    uint64_t m_profileQuantum = 0;          // audio thread
+    bool m_profilingThisQuantum = false;    // audio thread
     bool m_isAudioThreadFinished = false;
     bool m_isOfflineContext = false;
-    bool m_automaticPullNodesNeedUpdating = false;  // indicates m_automaticPullNodes was modified.
+    std::atomic<bool> m_latencyCompensation {true};
+    std::atomic<bool> m_denormalDetection {false};
+    std::atomic<int> m_feedbackBlockSize {0};
 
     friend class NullDeviceNode; // needs to be able to call update()
+
     void update();
+    void applyAutoSuspend();     // on the update thread, which stops and starts the device
+    void wakeFromAutoSuspend();
     void updateAutomaticPullNodes();
+    void updateRenderCaptures();
+    void applyPendingConnections(ContextGraphLock &);
+    bool sendCommand(AudioCommandKind, std::shared_ptr<void> target, float value, double time);
+    void applyCommands(ContextRenderLock &);
+    void compileRenderSchedule(ContextRenderLock &);
+    void findFeedbackLoops(ContextRenderLock &);
+    void renderFeedbackLoop(ContextRenderLock &, size_t loop, int framesToProcess, int blockSize);
+    void assignScratchBuses(ContextRenderLock &, const std::unordered_map<AudioNode *, int> & index);
+    void compensateLatency(ContextRenderLock &);
     void uninitialize();
 
     std::shared_ptr<AudioDestinationNode> _destinationNode;
 
     std::shared_ptr<AudioListener> m_listener;
+    std::shared_ptr<ModulationBus> m_modulation;
+    std::shared_ptr<SpatialScene> m_spatialScene;
     std::shared_ptr<AudioNode> _diagnose;
-    std::set<std::shared_ptr<AudioNode>> m_automaticPullNodes;  // queue for added pull nodes
-    std::vector<std::shared_ptr<AudioNode>> m_renderingAutomaticPullNodes;  // vector of known pull nodes
+    // guarded by m_updateMutex, and published to the audio thread whenever they change
+    std::set<std::shared_ptr<AudioNode>> m_automaticPullNodes;
+    std::set<std::shared_ptr<AudioRenderCapture>> m_renderCaptures;
 };
 
 }  // End namespace lab
@@ -9,10 +9,13 @@
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioSourceProvider.h"
+#include "LabSound/core/RenderClock.h"
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Logging.h"
 
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <stddef.h>
 #include <stdint.h>
 #include <string>
@@ -38,13 +41,62 @@ struct AudioDeviceIndex
     bool valid;
 };
 
+// The host audio APIs a backend may be asked to open a device through, on platforms that
+// have more than one
+enum class AudioApi
+{
+    Default = 0,  // the backend's choice
+    WASAPI,
+    ASIO,
+    DirectSound,
+    CoreAudio,
+    ALSA,
+    PulseAudio,
+    JACK,
+    OSS,
+    AAudio,
+    OpenSL,
+};
 
-// Input and Output
+// Input and Output. Once a device is open, its getOutputConfig() and getInputConfig()
+// report what was negotiated, where the backend can tell: the rate, the channels, the
+// period and the periods buffered, exclusive use, and the API.
 struct AudioStreamConfig
 {
     int32_t device_index{-1};
     uint32_t desired_channels{0};
     float desired_samplerate{0};
+
+    // The size of the device's periods in frames, and how many it buffers; zero lets the
+    // backend choose. Backends that run input and output on one device take these from
+    // the output config. A period that is a multiple of the render quantum avoids
+    // buffering a partial quantum between callbacks.
+    uint32_t period_frames{0};
+    uint32_t periods{0};
+
+    // Run the graph at desired_samplerate whatever rate the hardware runs at, converting at
+    // the device with a windowed sinc resampler, so that assets and the HRTF database are
+    // prepared for one rate. Otherwise the hardware is asked for desired_samplerate, and any
+    // conversion is the backend's or the driver's. Supported by the miniaudio backend for
+    // output devices; taken from the output config.
+    bool fixed_samplerate{false};
+
+    // Open the input as a device of its own rather than together with the output, as when
+    // they are different hardware. Each then runs on its own clock, and the input is
+    // resampled to follow the output's, so that a long capture keeps a steady latency.
+    // Supported by the miniaudio backend; taken from the input config.
+    bool independent_clock{false};
+
+    // Use the device exclusively, bypassing the system's mixer: WASAPI's exclusive mode,
+    // or hog mode on Core Audio and ALSA. The hardware then runs at the stream's own rate
+    // and format. Backends fall back to sharing the device when exclusive use is refused;
+    // the AAudio backend always asks for it.
+    bool exclusive{false};
+
+    // The host API to open the device through. WASAPI's exclusive mode is available
+    // through miniaudio, and ASIO through RtAudio built with it; an API the backend can't
+    // use is logged, and the default used instead. Taken from the output config.
+    AudioApi api{AudioApi::Default};
 };
 
 //-------------------------------------------
@@ -74,6 +126,13 @@ struct SamplingInfo
     std::chrono::high_resolution_clock::time_point epoch[2];
 };
 
+// Receives each chunk rendered by AudioDestinationNode::offlineRender, holding `frames` valid
+// frames, the first of which is frame `firstFrame` of the render. Returning false stops rendering.
+using OfflineRenderSink = std::function<bool(const AudioBus & chunk, int frames, uint64_t firstFrame)>;
+
+// Receives the number of frames rendered so far, and the number requested, after each chunk.
+using OfflineRenderProgress = std::function<void(uint64_t framesRendered, uint64_t framesTotal)>;
+
 // This is a free function to consolidate and implement the required functionality to take buffers
 // from the hardware (both input and output) and begin pulling the graph until fully rendered per quanta.
 // This was formerly a function found on the removed `AudioDestinationNode` class (removed
@@ -88,8 +147,33 @@ void pull_graph(AudioContext * ctx,
                 const SamplingInfo & info,
                 AudioSourceProvider * optional_hardware_input = nullptr);
 
+// How long a device's audio callbacks take compared to the time the buffer they
+// fill lasts. A load above 100% means the callback overran and the output glitched.
+struct AudioDeviceLoadStats
+{
+    // the histogram counts callbacks by load in steps of 10%; the last bucket counts overruns
+    enum : int { HistogramBuckets = 11 };
+
+    uint64_t callbacks = 0;
+    uint64_t overruns = 0;   // callbacks that took longer than their buffer period
+    uint64_t xruns = 0;      // underflows and overflows reported by the driver, if the backend can tell
+    float loadPercent = 0;          // the most recent callback
+    float averageLoadPercent = 0;   // smoothed over about a second
+    float peakLoadPercent = 0;      // since the stats were last reset
+    uint64_t histogram[HistogramBuckets] = {};
+};
+
 class AudioDevice
 {
+    std::atomic<uint64_t> _callbacks {0};
+    std::atomic<uint64_t> _overruns {0};
+    std::atomic<uint64_t> _xruns {0};
+    std::atomic<float> _loadPercent {0};
+    std::atomic<float> _averageLoadPercent {0};
+    std::atomic<float> _peakLoadPercent {0};
+    std::atomic<uint64_t> _loadHistogram[AudioDeviceLoadStats::HistogramBuckets] = {};
+    ProfileHistory _callbackTime;
+
 protected:
     AudioStreamConfig _outConfig = {};
     AudioStreamConfig _inConfig = {};
@@ -127,11 +211,37 @@ public:
         return _inConfig; }
 
     AudioSourceProvider* sourceProvider() const { return _sourceProvider; }
-    
+
+    // Callback timing may be read from any thread while the device runs.
+    AudioDeviceLoadStats loadStats() const;
+    const ProfileHistory & callbackTimeHistory() const { return _callbackTime; }
+    void resetLoadStats();
+
+    // Called by backends, from the audio thread, when the driver reports an underflow or overflow
+    void reportXrun() { _xruns.fetch_add(1, std::memory_order_relaxed); }
+
     virtual void start() = 0;
     virtual void stop() = 0;
     virtual bool isRunning() const = 0;
     virtual void backendReinitialize() = 0;
+
+    // The time, in seconds, from a sample arriving at the input to its reaching the output,
+    // as far as the backend can tell; zero if it can't.
+    virtual double roundTripLatency() const { return 0; }
+
+    // On Apple platforms, the os_workgroup_t of the device's audio thread, which threads
+    // that render on its behalf may join; null if the backend doesn't provide one.
+    virtual void * renderWorkgroup() const { return nullptr; }
+
+    // True for a device whose host renders it from threads of its own, such as a plugin
+    // host; the context then starts no update thread, and its events are dispatched by
+    // calling AudioContext::dispatchEvents().
+    virtual bool isHostDriven() const { return false; }
+
+protected:
+    // Backends bracket each audio callback with these, from the audio thread.
+    ProfileClock::time_point beginCallback() const { return ProfileClock::now(); }
+    void endCallback(ProfileClock::time_point start, int frames, float sampleRate);
 };
 
 class AudioDevice_Null : public AudioDevice {
@@ -152,6 +262,10 @@ class AudioDestinationNode : public AudioNode {
 protected:
     AudioContext * _context;
     SamplingInfo _last_info = {};
+    RenderClock _clock;  // _last_info, for other threads
+    ProfileHistory _renderTime;
+
+    void setSamplingInfo(const SamplingInfo & info);
 
     // AudioNode interface
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
@@ -159,6 +273,9 @@ protected:
 
     // Platform specific implementation
     std::shared_ptr<AudioDevice> _platformAudioDevice;
+
+    // renders a single quantum into dst, and advances the sampling info
+    void offlineRenderQuantum(AudioBus * dst);
     
 public:
     static const char* static_name() { return "AudioDestination"; }
@@ -184,7 +301,25 @@ public:
     
     void offlineRender(AudioBus * dst, int framesToProcess);
 
+    // Renders framesToProcess frames as fast as possible, handing the result to sink in
+    // chunks of chunkFrames, which is rounded up to a whole number of render quanta. The
+    // final chunk may be partial. Returns the number of frames rendered, which is less than
+    // requested if the sink stopped the render. The context's offlineRenderCompleteCallback
+    // is invoked once rendering finishes.
+    uint64_t offlineRender(uint64_t framesToProcess, int chunkFrames,
+                           const OfflineRenderSink & sink, const OfflineRenderProgress & progress = {});
+
+    // For the audio thread, which updates it; other threads should read clock()
     const SamplingInfo & getSamplingInfo() const { return _last_info; }
+
+    // The sampling info as of the last quantum rendered, consistent from any thread
+    RenderClockSnapshot clock() const { return _clock.read(); }
+
+    // The time taken to render each of the most recent quanta; a quantum that takes
+    // longer than its own duration has missed its deadline. These may be read from
+    // any thread while the context renders.
+    const ProfileHistory & renderTimeHistory() const { return _renderTime; }
+    ProfileStats renderTimeStats(int window = ProfileHistory::Capacity) const { return _renderTime.stats(window); }
     
     
     // AudioNode interface
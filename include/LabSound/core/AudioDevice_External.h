@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_AUDIODEVICE_EXTERNAL_H
+#define LABSOUND_AUDIODEVICE_EXTERNAL_H
+
+#include "LabSound/core/AudioDevice.h"
+
+#include <atomic>
+#include <memory>
+
+namespace lab
+{
+
+// AudioDevice_External is a device clocked by its host, such as a plugin host's process
+// call or a game engine's mixer, which renders the graph into its own buffers by calling
+// render() with whatever block size it has. It starts no threads and keeps no ring; the
+// context it drives starts no update thread either, so the host calls
+// AudioContext::dispatchEvents() from one of its own threads to deliver events.
+//
+// A block that is a whole number of render quanta, arriving with nothing held back from
+// the last, is rendered straight into the host's channels and takes its input from the
+// host's channels with no added latency. A context whose render quantum is the host's
+// block size always renders so. Other blocks keep the rest of their last quantum for the
+// next call, and delay the input by up to a quantum to line it up with the graph's quanta.
+class AudioDevice_External : public AudioDevice
+{
+public:
+    AudioDevice_External(const AudioStreamConfig & inputConfig, const AudioStreamConfig & outputConfig);
+    virtual ~AudioDevice_External();
+
+    // Renders frames into the host's planar output channels, as many as the output config
+    // has, taking the input config's channels of input from inputs, which may be null.
+    // Called from the host's audio thread; a stopped device renders silence.
+    void render(int frames, const float * const * inputs, float * const * outputs);
+
+    virtual void start() override { _running = true; }
+    virtual void stop() override { _running = false; }
+    virtual bool isRunning() const override { return _running; }
+    virtual void backendReinitialize() override {}
+    virtual bool isHostDriven() const override { return true; }
+
+private:
+    void renderQuantum(AudioBus * input, AudioBus * output);
+
+    std::atomic<bool> _running {false};
+    SamplingInfo _samplingInfo;
+    int _quantum = 0;
+
+    std::unique_ptr<AudioBus> _outputWrap;  // aliases the host's channels, a quantum at a time
+    std::unique_ptr<AudioBus> _inputWrap;
+    std::unique_ptr<AudioBus> _renderBus;   // a quantum for a block's partial tail
+    std::unique_ptr<AudioBus> _inputBus;    // a quantum of input lined up from _inputHeld
+    std::unique_ptr<AudioBus> _inputHeld;   // input waiting to fill a quantum
+    int _inputHeldFrames = 0;
+    int _remainder = 0;                     // frames of _renderBus not yet handed to the host
+};
+
+}  // lab
+
+#endif  // LABSOUND_AUDIODEVICE_EXTERNAL_H
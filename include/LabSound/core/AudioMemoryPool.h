@@ -0,0 +1,69 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef AudioMemoryPool_h
+#define AudioMemoryPool_h
+
+#include <stddef.h>
+#include <new>
+
+namespace lab
+{
+
+// Storage for sample data, AudioChannels and AudioBusses is drawn from a
+// process wide arena, so that creating nodes or changing channel counts
+// while rendering does not call into the system allocator once the arena is
+// warm. The arena is carved into power of two size classes, and freed blocks
+// return to their class's free list rather than to the system. Requests
+// larger than the largest class, such as whole decoded sound files, or made
+// once the arena is exhausted, fall back to the system allocator.
+//
+// All memory handed out is zeroed and aligned to AudioMemoryPool::Alignment.
+
+class AudioMemoryPool
+{
+public:
+    static const size_t Alignment = 64;
+    static const size_t MaxPooledSize = 1024 * 1024;
+    static const size_t DefaultCapacity = 16 * 1024 * 1024;
+
+    // Sets the size of the arena, which is created on first use. Returns false,
+    // and has no effect, if the arena has already been created.
+    static bool reserve(size_t capacityInBytes);
+
+    static size_t capacity();
+    static size_t bytesInUse();  // of the arena, including memory on free lists
+
+    static void * allocate(size_t sizeInBytes);
+    static void deallocate(void * memory, size_t sizeInBytes);
+};
+
+// An allocator for standard containers that draws from the AudioMemoryPool
+template <typename T>
+struct AudioMemoryAllocator
+{
+    typedef T value_type;
+
+    AudioMemoryAllocator() = default;
+    template <typename U>
+    AudioMemoryAllocator(const AudioMemoryAllocator<U> &) {}
+
+    T * allocate(size_t n)
+    {
+        void * p = AudioMemoryPool::allocate(n * sizeof(T));
+        if (!p)
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T * p, size_t n) { AudioMemoryPool::deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const AudioMemoryAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const AudioMemoryAllocator<U> &) const { return false; }
+};
+
+}  // lab
+
+#endif  // AudioMemoryPool_h
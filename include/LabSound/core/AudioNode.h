@@ -10,9 +10,11 @@
 #include "LabSound/core/AudioNodeScheduler.h"
 #include "LabSound/core/AudioParamDescriptor.h"
 #include "LabSound/core/AudioSettingDescriptor.h"
+#include "LabSound/core/MemoryAccounting.h"
 #include "LabSound/core/Mixing.h"
 #include "LabSound/core/Profiler.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
@@ -27,6 +29,8 @@ enum PanningModel
     PANNING_NONE = 0,
     EQUALPOWER   = 1,
     HRTF         = 2,
+    AMBISONIC    = 3,
+    BINAURAL     = 4,
     _PanningModeCount
 };
 
@@ -56,6 +60,13 @@ enum OscillatorType
     CUSTOM           = 7,
     _OscillatorTypeCount
 };
+
+enum DeclickCurve
+{
+    DECLICK_LINEAR      = 0,
+    DECLICK_EQUAL_POWER = 1,
+    _DeclickCurveCount
+};
 // clang-format on
 
 class AudioContext;
@@ -65,6 +76,7 @@ class AudioParam;
 class AudioSetting;
 class ContextGraphLock;
 class ContextRenderLock;
+struct DeclickTable;
 
 // AudioNode is the basic building block for a signal processing graph.
 // It may be an audio source, an intermediate processing module, or an audio 
@@ -88,6 +100,8 @@ protected:
 
         std::vector<std::shared_ptr<AudioParam>> _params;
         std::vector<std::shared_ptr<AudioSetting>> _settings;
+        std::vector<NameId> _paramIds;      // parallel to _params
+        std::vector<NameId> _settingIds;    // parallel to _settings
 
         int m_channelCount{ 0 };
 
@@ -96,16 +110,32 @@ protected:
 
         ProfileSample graphTime;    // how much time the node spend pulling inputs
         ProfileSample totalTime;    // total time spent by the node. total-graph is the self time.
+        ProfileHistory selfTime;    // self time of each of the most recent quanta the node processed
+        std::shared_ptr<MemoryOwner> memory;  // charged for what the node allocates
 
+        int renderQuantumSize;     // frames per render quantum, fixed when the node is created
         int color = 0;
+        int scheduleMark = 0;  // used by the context while compiling the render schedule
+        uint64_t silentFrames = 0; // consecutive frames of silent input, counted while propagating silence
+        std::atomic<uint64_t> denormalQuanta {0}; // quanta that underflowed, while the context detects it
+        std::atomic<const DeclickTable *> declick; // the start and stop envelopes, set from any thread
+        int declickPosition;       // frames of the start envelope applied since the node last started
+        std::atomic<bool> bypassed {false}; // set from any thread
+        float bypassMix = 0;       // from processed, at zero, to bypassed, at one
+        std::atomic<int> decimation {1}; // set from any thread
         bool m_isInitialized {false};
     };
     std::shared_ptr<Internal> _self;
     
 public :
+    // The render quantum is the number of frames a context renders per pass
+    // through the graph. ProcessingSizeInFrames is the default; see
+    // AudioContext::setRenderQuantumSize().
     enum : int
     {
-        ProcessingSizeInFrames = 128
+        ProcessingSizeInFrames = 128,
+        MinProcessingSizeInFrames = 16,
+        MaxProcessingSizeInFrames = 4096
     };
 
     AudioNode() = delete;
@@ -119,8 +149,56 @@ public :
     ProfileSample graphTime() const { return _self->graphTime; }
     ProfileSample totalTime() const { return _self->totalTime; }
 
+    // The node's self time over the most recent quanta it processed. These may
+    // be read from any thread while the context renders.
+    const ProfileHistory & selfTimeHistory() const { return _self->selfTime; }
+    ProfileStats selfTimeStats(int window = ProfileHistory::Capacity) const { return _self->selfTime.stats(window); }
+
+    // The quanta in which the node's processing underflowed, counted while the context's
+    // denormal detection is on. See AudioContext::setDenormalDetection().
+    uint64_t denormalQuanta() const { return _self->denormalQuanta.load(std::memory_order_relaxed); }
+
     SchedulingState schedulingState() const { return _self->_scheduler.playbackState(); }
 
+    // What the node has allocated. A node made inside a MemoryOwnerScope of a node owner
+    // that no other node has claimed adopts it, and is charged for everything it allocates as
+    // it is constructed; otherwise it is charged for its outputs, and what it allocates while
+    // it processes. A node may scope its owner wherever else it allocates on its own behalf.
+    const std::shared_ptr<MemoryOwner> & memoryOwner() const { return _self->memory; }
+
+    // The render quantum size of the context the node was created in, which
+    // a node's process() may be asked to render at most.
+    int renderQuantumSize() const { return _self->renderQuantumSize; }
+
+    // A node fades in as it starts and out as it stops, over a few frames, so that
+    // starting or stopping doesn't click. A fade in longer than the rest of the quantum
+    // continues into the next; a fade out that would begin before the quantum is
+    // shortened to end at the stop. The default is 64 frames, linear; zero frames
+    // starts and stops abruptly. May be called from any thread.
+    void setDeclickEnvelope(int frames, DeclickCurve curve = DECLICK_LINEAR);
+    int declickFrames() const;
+    DeclickCurve declickCurve() const;
+
+    // A bypassed node isn't processed. Its first input is passed through to its first
+    // output, and its other outputs are silent, as are all the outputs of a node without
+    // inputs, so that bypassing an effect leaves the signal dry and bypassing a source
+    // mutes it. Bypassing and restoring fade over about 10 ms. May be called from any thread.
+    void setBypassed(bool bypassed) { _self->bypassed.store(bypassed, std::memory_order_relaxed); }
+    bool isBypassed() const { return _self->bypassed.load(std::memory_order_relaxed); }
+
+    // A decimated node renders one frame for every factor frames of the quantum, at that
+    // fraction of the context's rate, which the context's sampleRate() reports while the
+    // node processes. Slow signals, such as LFOs, envelopes and the subgraphs that shape
+    // them, then cost a fraction as much to render. Where a decimated output meets an input
+    // or a param at a higher rate, it is interpolated linearly, a decimated frame late;
+    // toward a lower rate it is point sampled, unfiltered, so decimation suits signals well
+    // below the reduced rate's Nyquist frequency. The factor is one, the default, or a power
+    // of two up to MaxProcessingSizeInFrames, and is capped to the frames rendered at once.
+    // Nodes that count the context's frames rather than read its rate, such as
+    // SampledAudioNode, shouldn't be decimated. May be called from any thread.
+    void setDecimation(int factor);
+    int decimation() const { return _self->decimation.load(std::memory_order_relaxed); }
+
     //--------------------------------------------------
     // required interface
     //
@@ -156,6 +234,13 @@ public :
     // scheduling nodes.
     virtual bool isScheduledNode() const { return false; }
 
+    // Renders the count frames of the quantum from offset, the part of it in which a
+    // scheduled node is active. processIfNecessary() silences the frames either side
+    // afterwards, and doesn't call it at all for a quantum in which the node is inactive,
+    // so a source that overrides it renders only where it sounds. The default processes
+    // the whole quantum.
+    virtual void processRange(ContextRenderLock & r, int bufferSize, int offset, int count) { process(r, bufferSize); }
+
     // No significant resources should be allocated until initialize() is called.
     // Processing may not occur until a node is initialized.
     virtual void initialize();
@@ -164,11 +249,21 @@ public :
     //--------------------------------------------------
     // rendering
     bool inputsAreSilent(ContextRenderLock &);
+
+    // True if every output connected to the inputs has already been rendered this quantum,
+    // and is silent. Unlike inputsAreSilent(), nothing is pulled.
+    bool upstreamIsSilent(ContextRenderLock &);
     void silenceOutputs(ContextRenderLock &);
     void unsilenceOutputs(ContextRenderLock &);
 
+    // Fades the outputs toward, or away from, what bypassing the node leaves
+    void blendBypass(ContextRenderLock &, int bufferSize, float target);
+
     // propagatesSilence() should return true if the node will generate silent output when given silent input. By default, AudioNode
     // will take tailTime() and latencyTime() into account when determining whether the node will propagate silence.
+    // A node with inputs that propagates silence goes dormant once its inputs have been silent for longer than its tail
+    // and latency: it is skipped, without pulling its inputs, until an input is no longer silent. Nodes that must see
+    // every quantum, such as analysers, or that keep time of their own, return false.
     virtual bool propagatesSilence(ContextRenderLock & r) const;
 
     // processIfNecessary() is called by our output(s) when the rendering graph needs this AudioNode to process.
@@ -177,6 +272,11 @@ public :
     // Called from context's audio thread.
     void processIfNecessary(ContextRenderLock & r, int bufferSize);
 
+    // Returns true if processIfNecessary() has already run for the render
+    // quantum currently being rendered, in which case the node's outputs hold
+    // this quantum's results.
+    bool isProcessedForCurrentQuantum(ContextRenderLock & r) const;
+
     //--------------------------------------------------
     // inputs and outputs
     bool isInitialized() const { return _self->m_isInitialized; }
@@ -194,6 +294,8 @@ public :
     std::shared_ptr<AudioNodeInput> input(char const* const str);
     std::shared_ptr<AudioNodeOutput> output(int index);
     std::shared_ptr<AudioNodeOutput> output(char const* const str);
+    std::shared_ptr<AudioNodeInput> input(NameId id);
+    std::shared_ptr<AudioNodeOutput> output(NameId id);
     
     //--------------------------------------------------
     // channel management
@@ -214,8 +316,7 @@ public :
 
     ChannelInterpretation channelInterpretation() const {
         return _self->m_channelInterpretation; }
-    void setChannelInterpretation(ChannelInterpretation interpretation) {
-        _self->m_channelInterpretation = interpretation; }
+    void setChannelInterpretation(ChannelInterpretation interpretation);
 
     //--------------------------------------------------
     // parameters and settings
@@ -235,6 +336,21 @@ public :
     std::shared_ptr<AudioSetting> setting(int index);
     int setting_index(char const * const str);
 
+    // Lookups by interned id compare no strings; see internName().
+    std::shared_ptr<AudioParam> param(NameId id);
+    std::shared_ptr<AudioSetting> setting(NameId id);
+    int param_index(NameId id) const;
+    int setting_index(NameId id) const;
+
+    // Sets many params at once, as when applying a preset; ids that the node doesn't have
+    // are skipped. Returns the number of params set.
+    struct ParamValue
+    {
+        NameId id;
+        float value;
+    };
+    int setParamValues(ParamValue const * values, int count);
+
     std::vector<std::shared_ptr<AudioParam>> params() const {
         return _self->_params; }
     std::vector<std::shared_ptr<AudioSetting>> settings() const {
@@ -5,8 +5,20 @@
 #ifndef AudioNodeDescriptor_h
 #define AudioNodeDescriptor_h
 
+#include <stdint.h>
+
 namespace lab {
 
+// Names of params, settings, inputs and outputs are interned to ids, so that a name may be
+// resolved once and then looked up without comparing strings. A name has the same id on
+// every node, for the life of the program. May be called from any thread. NameId is an
+// enum class so that it doesn't overload ambiguously with indices.
+enum class NameId : uint32_t { Invalid = 0 };
+
+NameId internName(char const * const);
+NameId findName(char const * const);  // NameId::Invalid if the name was never interned
+char const * internedName(NameId);    // nullptr for an invalid id
+
 struct AudioParamDescriptor;
 struct AudioSettingDescriptor;
 struct AudioNodeDescriptor
@@ -17,6 +29,8 @@ struct AudioNodeDescriptor
 
     AudioParamDescriptor const * const param(char const * const) const;
     AudioSettingDescriptor const * const setting(char const * const) const;
+    AudioParamDescriptor const * const param(NameId) const;
+    AudioSettingDescriptor const * const setting(NameId) const;
 };
 
 } // namespace
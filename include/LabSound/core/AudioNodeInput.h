@@ -8,7 +8,10 @@
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioSummingJunction.h"
 
+#include <memory>
 #include <set>
+#include <utility>
+#include <vector>
 
 namespace lab
 {
@@ -16,6 +19,8 @@ namespace lab
 class AudioNode;
 class AudioNodeOutput;
 class AudioBus;
+class CompensationDelay;
+class MixingMatrix;
 
 // An AudioNodeInput represents an input to an AudioNode and can be connected from one or more AudioNodeOutputs.
 // In the case of multiple connections, the input will act as a unity-gain summing junction, mixing all the outputs.
@@ -25,9 +30,44 @@ class AudioNodeInput : public AudioSummingJunction
     AudioNode * m_destinationNode;
     std::unique_ptr<AudioBus> m_internalSummingBus;
     std::string _name;
+    NameId _nameId = NameId::Invalid;
+    int m_processingSizeInFrames;
+    std::unique_ptr<AudioBus> m_resampledBus;  // a connection interpolated to the node's decimation
+
+    // delays for the connections of shorter paths, by output, set by the render schedule
+    std::vector<std::pair<AudioNodeOutput *, std::unique_ptr<CompensationDelay>>> m_compensation;
+
+    // How each connection is summed into the summing bus, decided when the connections,
+    // their channel counts, the compensation, or the node's channel count, mode or
+    // interpretation change, rather than every quantum
+    struct MixStep
+    {
+        enum Kind
+        {
+            Channels,  // channel by channel, the counts and layouts matching
+            Matrix,    // up or down mixed through a speaker layout matrix
+            Discrete   // channel by channel, dropping or leaving silent the rest
+        };
+
+        std::weak_ptr<AudioNodeOutput> output;
+        CompensationDelay * delay = nullptr;
+        const MixingMatrix * matrix = nullptr;
+        Kind kind = Channels;
+        int channels = 0;  // the output's, as the step was compiled
+        int layout = 0;
+    };
+    std::vector<MixStep> m_mixPlan;
+    int m_mixChannels = 1;     // the channel count the connections mix to
+    int m_mixPlanVersion = -1; // the rendering connections the plan was compiled from
+    bool m_mixPlanDirty = true;
+
+    bool mixPlanIsCurrent() const;
+    void compileMixPlan(ContextRenderLock &);
+    void mix(const MixStep &, const AudioBus & source);
 
 public:
-    explicit AudioNodeInput(AudioNode * audioNode, int processingSizeInFrames = AudioNode::ProcessingSizeInFrames);
+    // A processingSizeInFrames of zero sizes the input to the node's render quantum.
+    explicit AudioNodeInput(AudioNode * audioNode, int processingSizeInFrames = 0);
     virtual ~AudioNodeInput();
 
     // Can be called from any thread.
@@ -44,19 +84,30 @@ public:
     // It returns the bus which it rendered into, returning inPlaceBus if in-place processing was performed.
     AudioBus * pull(ContextRenderLock &, AudioBus * inPlaceBus, int bufferSize);
 
+    // Render thread. Delays each listed output's audio by its frames before it is summed, so
+    // that paths of different latencies reach the input together; other connections are
+    // summed as they are. An output keeping its delay keeps the audio already delayed.
+    void setLatencyCompensation(ContextRenderLock &, const std::vector<std::pair<AudioNodeOutput *, int>> & delays);
+
     // bus() contains the rendered audio after pull() has been called for each time quantum.
     AudioBus * bus(ContextRenderLock &);
 
+    // Any thread. The channels of a connection, or the node's channel count, mode or
+    // interpretation, changed, so that the connections' mix is decided again.
+    void channelsChanged() { m_mixPlanDirty = true; }
+
     // updateInternalBus() updates m_internalSummingBus appropriately for the number of channels.
     // This must be called when we own the context's graph lock in the audio thread at the very start or end of the render quantum.
     void updateInternalBus(ContextRenderLock &);
 
-    // The number of channels of the connection with the largest number of channels.
+    // The number of channels the connections mix to: that of the connection with the
+    // largest number of channels, or as the node's channel count mode sets it.
     // Only valid during render quantum because it is dependent on the active bus
     int numberOfChannels(ContextRenderLock &) const;
     
     const std::string& name() const { return _name; }
-    void setName(const std::string& n) { _name = n; }
+    void setName(const std::string& n) { _name = n; _nameId = internName(n.c_str()); }
+    NameId nameId() const { return _nameId; }
 };
 
 }  // namespace lab
@@ -23,8 +23,9 @@ class AudioNodeOutput
 {
 public:
     // It's OK to pass 0 for numberOfChannels in which case setNumberOfChannels() must be called later on.
-    AudioNodeOutput(AudioNode * audioNode, int numberOfChannels, int processingSizeInFrames = AudioNode::ProcessingSizeInFrames);
-    AudioNodeOutput(AudioNode * audioNode, char const*const name, int numberOfChannels, int processingSizeInFrames = AudioNode::ProcessingSizeInFrames);
+    // A processingSizeInFrames of zero sizes the output to the node's render quantum.
+    AudioNodeOutput(AudioNode * audioNode, int numberOfChannels, int processingSizeInFrames = 0);
+    AudioNodeOutput(AudioNode * audioNode, char const*const name, int numberOfChannels, int processingSizeInFrames = 0);
     virtual ~AudioNodeOutput();
 
     // Can be called from any thread.
@@ -35,9 +36,29 @@ public:
     // Called from context's audio thread.
     AudioBus * pull(ContextRenderLock &, AudioBus * inPlaceBus, int bufferSize);
 
+    // Like pull(), but sums the rendered audio into accumulator, which allows a deferred gain (see deferGain()) to be
+    // mixed straight into the accumulator instead of being written to this output's bus first.
+    void pullAndSumInto(ContextRenderLock &, AudioBus & accumulator, int bufferSize);
+
     // bus() will contain the rendered audio after pull() is called for each rendering time quantum.
     AudioBus * bus(ContextRenderLock &) const;
 
+    // True if this quantum's rendered audio is silent. Unlike bus()->isSilent(), a deferred gain is not resolved.
+    bool isSilent() const;
+
+    // A node whose output is simply a source bus scaled by a gain may call deferGain() from its process() instead of
+    // writing the output bus. An input summing several connections then mixes source * gain directly into its
+    // accumulator; any other consumer gets a bus with the gain applied, on demand, from bus(). If gainValues is not
+    // null, it holds one gain per frame, and gain is ignored. source and gainValues must stay valid for the rest of
+    // the render quantum. The deferral is cleared when the source node next processes.
+    void deferGain(AudioBus * source, const float * gainValues, float gain);
+    void clearDeferredGain() { m_deferredGainSource = nullptr; }
+    bool hasDeferredGain() const { return m_deferredGainSource != nullptr; }
+
+    // True if the only consumer of this output is an input that is summing more than one connection, which is
+    // when deferring a gain saves a pass over the data.
+    bool feedsSummingInput(ContextRenderLock &) const;
+
     // renderingFanOutCount() is the number of AudioNodeInputs that we're connected to during rendering.
     // Unlike fanOutCount() it will not change during the course of a render quantum.
     int renderingFanOutCount() const;
@@ -55,7 +76,33 @@ public:
     // updateRenderingState() is called in the audio thread at the start or end of the render quantum to handle any recent changes to the graph state.
     void updateRenderingState(ContextRenderLock &);
 
+    // Directs the next render of the source node into this output's internal bus, discarding any in-place bus
+    // supplied by a pull in a previous render quantum. Called from the audio thread before the source node processes.
+    void resetInPlaceBus() { m_inPlaceBus = nullptr; }
+
+    // Directs the next render of the source node into scratch, a bus shared with other outputs whose audio is
+    // never needed at the same time, in place of the internal bus; a scratch bus of another shape is ignored.
+    // releaseScratchBus() is called once the node has processed. Both are called from the audio thread.
+    void useScratchBus(AudioBus * scratch);
+    void releaseScratchBus();
+
+    int processingSizeInFrames() const { return m_processingSizeInFrames; }
+
+    // The decimation the source node last rendered this output at. See AudioNode::setDecimation().
+    int decimation() const { return m_decimation; }
+
+    // Called by the source node once it has rendered frames at a decimation other than one,
+    // or first returns to one, to keep the last frame, from which a reader at a higher rate
+    // interpolates into the next quantum. A deferred gain is not resolved.
+    void holdLastFrame(int frames, int decimation);
+
+    // Writes this quantum's audio into the first frames of destination as a reader rendering
+    // at the given decimation hears it, interpolated from the output's own rate. Called
+    // from the audio thread once the output has been pulled.
+    void resampleInto(ContextRenderLock &, AudioBus & destination, int frames, int decimation);
+
     const std::string& name() const { return m_name; }
+    NameId nameId() const { return m_nameId; }
 
     // Must be called within the context's graph lock.
     static void disconnectAll(ContextGraphLock &, std::shared_ptr<AudioNodeOutput>);
@@ -85,6 +132,12 @@ private:
     // It must be called with the context's graph lock.
     int paramFanOutCount();
 
+    // Causes our AudioNode to process if it hasn't already for this render quantum, without resolving a deferred gain.
+    void renderIfNecessary(ContextRenderLock &, AudioBus * inPlaceBus, int bufferSize);
+
+    // Writes a deferred gain's result into the bus
+    void resolveDeferredGain() const;
+
     // updateInternalBus() updates m_internalBus appropriately for the number of channels.
     // It is called in the constructor or in the audio thread with the context's graph lock.
     void updateInternalBus();
@@ -93,6 +146,7 @@ private:
     void propagateChannelCount(ContextRenderLock &);
 
     std::string m_name;
+    NameId m_nameId = NameId::Invalid;
 
     // m_numberOfChannels will only be changed in the audio thread.
     // The main thread sets m_desiredNumberOfChannels which will later get picked up in the audio thread
@@ -101,11 +155,22 @@ private:
 
     // m_internalBus and m_inPlaceBus must only be changed in the audio thread with the context's render lock (or constructor).
     std::unique_ptr<AudioBus> m_internalBus;
+    int m_processingSizeInFrames;
 
     // Temporary, during render quantum
     // @tofix - Should this be some kind of shared pointer? It is only valid for a single render quantum, so probably no.
     AudioBus * m_inPlaceBus;
 
+    // Set by deferGain(), and cleared when resolved or when the source node next processes
+    mutable AudioBus * m_deferredGainSource = nullptr;
+    const float * m_deferredGainValues = nullptr;
+    float m_deferredGain = 1.f;
+
+    // The decimation rendered at, and the last frame, per channel, of this quantum and the one before
+    int m_decimation = 1;
+    std::vector<float> m_lastFrame;
+    std::vector<float> m_previousFrame;
+
     std::vector<std::shared_ptr<AudioNodeInput>> m_inputs;
 
     // For the purposes of rendering, keeps track of the number of inputs and AudioParams we're connected to.
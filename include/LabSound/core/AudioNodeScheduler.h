@@ -26,6 +26,7 @@ namespace lab {
 };
 const char* schedulingStateName(SchedulingState);
 
+class AudioNode;
 class ContextRenderLock;
 
 class AudioNodeScheduler
@@ -39,14 +40,20 @@ public:
     void start(double when);
     void stop(double when);
 
-    // called when the sound is finished, or noteOff/stop time has been reached
-    void finish(ContextRenderLock&);
+    // As start and stop, at an absolute sample frame of the context rather than a time
+    // relative to the epoch the node last rendered
+    void startAtFrame(uint64_t frame);
+    void stopAtFrame(uint64_t frame);
+
+    // called when the sound is finished, or noteOff/stop time has been reached.
+    // node is the node owning the scheduler, about which the ended event is sent.
+    void finish(ContextRenderLock&, AudioNode & node);
     void reset();
 
     SchedulingState playbackState() const { return _playbackState; }
     bool hasFinished() const { return _playbackState == SchedulingState::FINISHED; }
 
-    bool update(ContextRenderLock&, int epoch_length, const char* node_name);
+    bool update(ContextRenderLock&, int epoch_length, AudioNode & node);
 
     SchedulingState _playbackState = SchedulingState::UNSCHEDULED;
 
@@ -67,6 +74,10 @@ public:
     std::function<void()> _onEnded;
 
     std::function<void(double when)> _onStart;
+
+    // called whenever the node is scheduled to start, from the thread that schedules it, so
+    // that a context that has suspended itself for silence may resume
+    std::function<void()> _onScheduled;
 };
 
 } // namespace
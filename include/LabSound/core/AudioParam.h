@@ -10,13 +10,41 @@
 #include "LabSound/core/AudioParamTimeline.h"
 #include "LabSound/core/AudioSummingJunction.h"
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 #include <sys/types.h>
 
 namespace lab
 {
 
 class AudioNodeOutput;
+class Modulator;
+
+// How a parameter's values change over a block of frames. Constant and Linear blocks are
+// described without computing any values, so that a kernel can apply them as a scalar, or
+// a scalar and a step; only an Arbitrary block's values are written out.
+struct AudioParamBlock
+{
+    enum Kind
+    {
+        Constant,
+        Linear,
+        Arbitrary
+    };
+
+    Kind kind = Constant;
+    float value = 0;                   // the first value
+    float slope = 0;                   // for Linear, the change from one frame to the next
+    const float * values = nullptr;    // for Arbitrary, a value for every frame
+
+    bool isConstant() const { return kind == Constant; }
+    float valueAt(int frame) const { return kind == Arbitrary ? values[frame] : value + slope * frame; }
+
+    // Writes count values, unless they are already there
+    void render(float * destination, int count) const;
+};
 
 
 class AudioParam : public AudioSummingJunction
@@ -52,6 +80,13 @@ public:
     // Returns true if smoothed value has already snapped exactly to value.
     bool smooth(ContextRenderLock &);
 
+    // As smooth, but a-rate: approaches the desired value frame by frame over count frames,
+    // at the same pace as smooth does a quantum at a time, so that a change made with
+    // setValue ramps without steps. The block is Constant once the value has settled, and
+    // otherwise the ramp, written to scratch. A parameter with automation or connections
+    // follows them instead, as calculateSampleAccurateBlock.
+    AudioParamBlock smoothBlock(ContextRenderLock &, float * scratch, int count);
+
     void resetSmoothedValue() { m_smoothedValue = m_value; }
     void setSmoothingConstant(double k) { m_smoothingConstant = k; }
 
@@ -62,16 +97,38 @@ public:
     AudioParam & linearRampToValueAtTime(float value, float time) { m_timeline.linearRampToValueAtTime(value, time); return *this; }
     AudioParam & exponentialRampToValueAtTime(float value, float time) { m_timeline.exponentialRampToValueAtTime(value, time); return *this; }
     AudioParam & setTargetAtTime(float target, float time, float timeConstant) { m_timeline.setTargetAtTime(target, time, timeConstant); return *this; }
-    AudioParam & setValueCurveAtTime(std::vector<float> curve, float time, float duration) { m_timeline.setValueCurveAtTime(curve, time, duration); return *this; }
+    AudioParam & setValueCurveAtTime(std::vector<float> curve, float time, float duration) { m_timeline.setValueCurveAtTime(std::make_shared<const std::vector<float>>(std::move(curve)), time, duration); return *this; }
+    AudioParam & setValueCurveAtTime(AudioParamTimeline::ValueCurve curve, float time, float duration) { m_timeline.setValueCurveAtTime(std::move(curve), time, duration); return *this; }
     AudioParam & cancelScheduledValues(float startTime) { m_timeline.cancelScheduledValues(startTime); return *this; }
 
-    bool hasSampleAccurateValues() { return m_timeline.hasValues() || numberOfConnections(); }
+    // For the audio thread; see AudioParamTimeline::trySetValueAtTime
+    bool trySetValueAtTime(float value, float time) { return m_timeline.trySetValueAtTime(value, time); }
+    bool tryLinearRampToValueAtTime(float value, float time) { return m_timeline.tryLinearRampToValueAtTime(value, time); }
+
+    // Adds a modulator's values, scaled by depth, to the parameter's, as a connection's would
+    // be, but read from the context's ModulationBus rather than pulled from a node. Modulating
+    // by a modulator already modulating the parameter changes its depth. Any thread; takes
+    // effect at the next quantum.
+    void modulate(std::shared_ptr<Modulator> modulator, float depth);
+    void removeModulation(std::shared_ptr<Modulator> modulator);
+    void removeAllModulations();
+    bool isModulated() const { return m_modulated.load(std::memory_order_acquire); }
+
+    bool hasSampleAccurateValues() { return m_timeline.hasValues() || numberOfConnections() || isModulated(); }
+
+    // the automation events scheduled on the parameter
+    std::vector<AudioParamTimeline::Event> timelineEvents() { return m_timeline.events(); }
+
+    // For the audio thread; see AudioParamTimeline::hasEventsAfter
+    bool hasEventsAfter(double time) { return m_timeline.hasEventsAfter(time); }
 
     // Calculates numberOfValues parameter values starting at the context's current time.
     // Must be called in the context's render thread.
     void calculateSampleAccurateValues(ContextRenderLock &, float * values, int numberOfValues);
 
-    AudioBus const* const bus() const;
+    // As calculateSampleAccurateValues, but describes a constant or linearly changing block
+    // instead of computing it. scratch receives the values only of an Arbitrary block.
+    AudioParamBlock calculateSampleAccurateBlock(ContextRenderLock &, float * scratch, int numberOfValues);
 
     // Connect an audio-rate signal to control this parameter.
     static void connect(ContextGraphLock & g, std::shared_ptr<AudioParam>, std::shared_ptr<AudioNodeOutput>);
@@ -83,15 +140,31 @@ private:
     void calculateFinalValues(ContextRenderLock & r, float * values, int numberOfValues, bool sampleAccurate);
     void calculateTimelineValues(ContextRenderLock & r, float * values, int numberOfValues);
 
+    struct Modulation
+    {
+        std::shared_ptr<Modulator> modulator;
+        float depth;
+    };
+    using Modulations = std::vector<Modulation>;
+
+    // Copied on write, and published to the render thread
+    std::shared_ptr<const Modulations> m_modulations;
+    std::atomic<bool> m_modulated {false};
+    void setModulations(std::shared_ptr<const Modulations> modulations);
+
     double m_value;
 
     // Smoothing (de-zippering)
     double m_smoothedValue;
     double m_smoothingConstant;
 
+    // the per frame decay equivalent to the smoothing constant over a block of m_frameDecayCount
+    double m_frameDecay = 0;
+    double m_frameDecayConstant = 0;
+    int m_frameDecayCount = 0;
+
     AudioParamTimeline m_timeline;
 
-    std::unique_ptr<AudioBus> m_internalSummingBus;
     AudioParamDescriptor const*const _desc;
 };
 
@@ -6,6 +6,7 @@
 #define AudioParamTimeline_h
 
 #include "LabSound/core/AudioContext.h"
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -16,15 +17,26 @@ class AudioParamTimeline
 {
 
 public:
-    AudioParamTimeline() {}
+    // A value curve, immutable once made, so that every event using it shares it
+    using ValueCurve = std::shared_ptr<const std::vector<float>>;
+
+    AudioParamTimeline() { m_events.reserve(ReservedEvents); }
 
     void setValueAtTime(float value, float time);
     void linearRampToValueAtTime(float value, float time);
     void exponentialRampToValueAtTime(float value, float time);
     void setTargetAtTime(float target, float time, float timeConstant);
-    void setValueCurveAtTime(std::vector<float> & curve, float time, float duration);
+    void setValueCurveAtTime(std::vector<float> & curve, float time, float duration);  // copies the curve
+    void setValueCurveAtTime(ValueCurve curve, float time, float duration);
     void cancelScheduledValues(float startTime);
 
+    // As setValueAtTime and linearRampToValueAtTime, for the audio thread. The event is
+    // only inserted if no other thread holds the timeline, and returns false otherwise.
+    // Nothing is allocated while the timeline has room for it and holds no value curve,
+    // and an event that falls inside a value curve is dropped rather than thrown.
+    bool trySetValueAtTime(float value, float time);
+    bool tryLinearRampToValueAtTime(float value, float time);
+
     // hasValue is set to true if a valid timeline value is returned.
     // otherwise defaultValue is returned.
     float valueForContextTime(ContextRenderLock &, float defaultValue, bool & hasValue);
@@ -39,6 +51,47 @@ public:
 
     bool hasValues() { return m_events.size() > 0; }
 
+    // An automation event as it was scheduled, so that a timeline can be saved and scheduled again
+    enum class EventKind
+    {
+        SetValue,
+        LinearRampToValue,
+        ExponentialRampToValue,
+        SetTarget,
+        SetValueCurve
+    };
+
+    struct Event
+    {
+        EventKind kind;
+        float value;
+        float time;
+        float timeConstant;
+        float duration;
+        ValueCurve curve;  // null unless kind is SetValueCurve
+    };
+
+    // A copy of the events the timeline holds, in time order
+    std::vector<Event> events();
+
+    // Whether an event begins, or a value curve ends, after time. For the audio thread; it is
+    // true while another thread holds the timeline, as the events can't be seen.
+    bool hasEventsAfter(double time);
+
+    enum class BlockShape
+    {
+        Constant,
+        Linear,
+        Arbitrary
+    };
+
+    // Reports whether the values valuesForTimeRange would calculate for the time range are
+    // constant, or a linear ramp, without calculating them. value is the first of them, and
+    // slope the change from one frame to the next of the ramp. Arbitrary values must be
+    // calculated by valuesForTimeRange.
+    BlockShape shapeForTimeRange(double startTime, double endTime, float defaultValue,
+                                 double sampleRate, float & value, float & slope);
+
 private:
 
     // @tofix - move to implementation file to hide from public API
@@ -57,44 +110,22 @@ private:
             LastType
         };
 
-        ParamEvent(Type type, float value, float time, float timeConstant, float duration, std::vector<float> curve)
+        ParamEvent(Type type, float value, float time, float timeConstant, float duration, ValueCurve curve)
             : m_type(type)
             , m_value(value)
             , m_time(time)
             , m_timeConstant(timeConstant)
             , m_duration(duration)
-            , m_curve(curve)
-        {
-        }
-
-        ParamEvent(const ParamEvent & rhs)
-            : m_type(rhs.m_type)
-            , m_value(rhs.m_value)
-            , m_time(rhs.m_time)
-            , m_timeConstant(rhs.m_timeConstant)
-            , m_duration(rhs.m_duration)
-            , m_curve(rhs.m_curve)
+            , m_curve(std::move(curve))
         {
         }
 
-        const ParamEvent & operator=(const ParamEvent & rhs)
-        {
-
-            m_type = rhs.m_type;
-            m_value = rhs.m_value;
-            m_time = rhs.m_time;
-            m_timeConstant = rhs.m_timeConstant;
-            m_duration = rhs.m_duration;
-            m_curve = rhs.m_curve;
-            return *this;
-        }
-
         unsigned type() const { return m_type; }
         float value() const { return m_value; }
         float time() const { return m_time; }
         float timeConstant() const { return m_timeConstant; }
         float duration() const { return m_duration; }
-        std::vector<float> & curve() { return m_curve; }
+        const ValueCurve & curve() const { return m_curve; }
 
     private:
         unsigned m_type;
@@ -102,14 +133,27 @@ private:
         float m_time;
         float m_timeConstant;
         float m_duration;
-        std::vector<float> m_curve;
+        ValueCurve m_curve;
     };
 
+    // room for the events of a few commands, so that inserting them doesn't allocate
+    enum : size_t { ReservedEvents = 8 };
+
+    static bool isValidEvent(const ParamEvent &);
     void insertEvent(const ParamEvent &);
+    bool tryInsertEvent(const ParamEvent &);
+    bool insertEventLocked(const ParamEvent &);  // false if the event overlaps a value curve
+    void pruneRenderedEvents(bool keepCurves = false);
     float valuesForTimeRangeImpl(double startTime, double endTime, float defaultValue,
                                  float * values, size_t numberOfValues, double sampleRate, double controlRate);
 
+    // sorted by time
     std::vector<ParamEvent> m_events;
+    std::mutex m_eventsMutex;
+
+    // the first event that was needed when values were last rendered, so that those
+    // before it can be pruned
+    size_t m_firstActiveEvent = 0;
 };
 
 }  // namespace lab
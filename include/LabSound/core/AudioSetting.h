@@ -40,7 +40,7 @@ private:
     float _valf = 0;
     uint32_t _vali = 0;
     bool _valb = false;
-    std::shared_ptr<AudioBus> _valBus;
+    std::shared_ptr<const AudioBus> _valBus;
 
     std::function<void()> _valueChanged;
 
@@ -74,7 +74,7 @@ public:
     bool valueBool() const { return _valb; }
     float valueFloat() const { return _valf; }
     uint32_t valueUint32() const { return _vali; }
-    std::shared_ptr<AudioBus> valueBus() const { return _valBus; }
+    std::shared_ptr<const AudioBus> valueBus() const { return _valBus; }
 
     void setBool(bool v, bool notify = true)
     {
@@ -115,15 +115,25 @@ public:
         if (notify && _valueChanged) _valueChanged();
     }
 
-    // nb: Invoking setBus will create and cache a duplicate of the supplied bus.
-    void setBus(const AudioBus * incoming, bool notify = true)
+    // A bus value is immutable once set, so settings share it rather than copy it;
+    // assigning one sample to any number of nodes holds a single copy of its data.
+    // Whoever wants to change a bus value makes a changed copy and sets that.
+    void setBus(std::shared_ptr<const AudioBus> incoming, bool notify = true)
     {
-        std::unique_ptr<AudioBus> new_bus = AudioBus::createByCloning(incoming);
-        _valBus = std::move(new_bus);
+        _valBus = std::move(incoming);
         if (notify && _valueChanged)
             _valueChanged();
     }
 
+    // nb: A bus of unknown lifetime is duplicated, and the duplicate shared.
+    void setBus(const AudioBus * incoming, bool notify = true)
+    {
+        std::shared_ptr<const AudioBus> new_bus;
+        if (incoming)
+            new_bus = AudioBus::createByCloning(incoming);
+        setBus(std::move(new_bus), notify);
+    }
+
     void setValueChanged(std::function<void()> fn) { _valueChanged = fn; }
 };
 
@@ -8,6 +8,8 @@
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/core/AudioBus.h"
 
+#include <memory>
+
 namespace lab
 {
 class AudioBus;
@@ -20,30 +22,36 @@ class AudioBus;
 // provideInput() gets called repeatedly to render time-slices of a continuous audio stream.
 class AudioSourceProvider
 {
-    AudioBus _sourceBus;
+    std::unique_ptr<AudioBus> _sourceBus;
 
 public:
     AudioSourceProvider(int channelCount)
-        : _sourceBus(channelCount, AudioNode::ProcessingSizeInFrames)
+        : _sourceBus(new AudioBus(channelCount, AudioNode::ProcessingSizeInFrames))
     {
     }
 
     virtual ~AudioSourceProvider() = default;
 
-    // every input quantum set can be called to copy from the supplied bus to the internal buffer
+    // every input quantum set can be called to copy from the supplied bus to the internal buffer.
+    // The internal buffer follows the length of the supplied bus, which is the render quantum.
     void set(AudioBus * bus)
     {
-        if (bus)
-            _sourceBus.copyFrom(*bus);
+        if (!bus)
+            return;
+
+        if (_sourceBus->length() != bus->length())
+            _sourceBus.reset(new AudioBus(_sourceBus->numberOfChannels(), bus->length()));
+
+        _sourceBus->copyFrom(*bus);
     }
 
     // every output quantum provideInput can be called to copy data retained in _sourceBus
     // to the supplied destinationBus
     virtual void provideInput(AudioBus * destinationBus, int bufferSize)
     {
-        bool isGood = destinationBus && destinationBus->length() == bufferSize && _sourceBus.length() == bufferSize;
+        bool isGood = destinationBus && destinationBus->length() == bufferSize && _sourceBus->length() == bufferSize;
         if (isGood)
-            destinationBus->copyFrom(_sourceBus);
+            destinationBus->copyFrom(*_sourceBus);
     }};
 
 }  // lab
@@ -5,7 +5,9 @@
 #ifndef AudioSummingJunction_h
 #define AudioSummingJunction_h
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace lab
@@ -62,12 +64,19 @@ public:
 
     static void handleDirtyAudioSummingJunctions(ContextRenderLock & r);
 
+    // Changes whenever any junction gains or loses a connection, however it was made
+    static uint64_t connectionGeneration();
+
     bool isConnected(std::shared_ptr<AudioNodeOutput> o) const;
 
+    // Any thread. The outputs connected at the moment, for walking a graph.
+    std::vector<std::shared_ptr<AudioNodeOutput>> connectedOutputs() const;
+
 protected:
     // m_outputs contains the AudioNodeOutputs representing current connections.
     // The rendering code should never use this directly, but instead uses m_renderingOutputs.
     std::vector<std::weak_ptr<AudioNodeOutput>> m_connectedOutputs;
+    mutable std::mutex m_junctionMutex;  // guards m_connectedOutputs
 
     // m_renderingOutputs is a copy of m_connectedOutputs which will never be modified during the graph rendering on the audio thread.
     // This is the list which is used by the rendering code.
@@ -77,6 +86,9 @@ protected:
 
     // m_renderingStateNeedUpdating indicates outputs were changed
     bool m_renderingStateNeedUpdating;
+
+    // counts the updates of m_renderingOutputs, so that what is derived from them can be kept
+    int m_renderingVersion = 0;
 };
 
 }  // namespace lab
@@ -19,6 +19,15 @@ class BiquadFilterNode : public AudioBasicProcessorNode
     BiquadFilterNodeInternal * biquad_impl;
 
 public:
+    // A biquad is the classic direct form filter. A state variable filter has the same
+    // responses, and stays stable and smooth under fast modulation of its params.
+    enum Topology
+    {
+        BIQUAD = 0,
+        STATE_VARIABLE = 1,
+        _TopologyCount
+    };
+
     BiquadFilterNode(AudioContext& ac);
     virtual ~BiquadFilterNode();
 
@@ -29,6 +38,14 @@ public:
     FilterType type() const;
     void setType(FilterType type);
 
+    Topology topology() const;
+    void setTopology(Topology topology);
+
+    // While the params are automated, the coefficients are designed once per this many
+    // frames, and interpolated between; 32 by default.
+    int controlInterval() const;
+    void setControlInterval(int frames);
+
     std::shared_ptr<AudioParam> frequency();
     std::shared_ptr<AudioParam> q();
     std::shared_ptr<AudioParam> gain();
@@ -3,10 +3,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <condition_variable>
 #include <mutex>
+#include <memory>
 #include <queue>
 
 namespace lab {
@@ -182,6 +186,128 @@ private:
 };
 
 
+// AudioRingBuffer carries planar multichannel audio from one writing thread to one reading
+// thread without locks or waiting, such as from the render thread to a recorder, or from an
+// engine's thread into the graph. Every channel is written and read together, a whole block
+// at a time, and a block is visible to the reader only once all of its channels are, so the
+// channels never drift apart. Each side keeps its index on a cache line of its own, with a
+// cached copy of the other's, so that a block moves with one atomic load and one store.
+//
+// The indices count frames from the start and are never wrapped, so that every frame of
+// the capacity is usable.
+class alignas(64) AudioRingBuffer
+{
+public:
+    AudioRingBuffer(int channels, size_t frames)
+        : _channels(channels > 0 ? channels : 1)
+        , _capacity(frames > 0 ? frames : 1)
+        , _data(new float[_capacity * static_cast<size_t>(_channels)]())
+    {
+    }
+
+    AudioRingBuffer(const AudioRingBuffer &) = delete;
+    AudioRingBuffer & operator=(const AudioRingBuffer &) = delete;
+
+    int channelCount() const { return _channels; }
+    size_t capacity() const { return _capacity; }
+
+    // Frames that can be read; only safe to call from the read thread
+    size_t availableRead() const
+    {
+        return _writeIndex.load(std::memory_order_acquire) - _readIndex.load(std::memory_order_relaxed);
+    }
+
+    // Frames that can be written; only safe to call from the write thread
+    size_t availableWrite() const
+    {
+        return _capacity - (_writeIndex.load(std::memory_order_relaxed) - _readIndex.load(std::memory_order_acquire));
+    }
+
+    // Writes frames of every channel, or nothing if they don't all fit. A null channels, or
+    // a null channel among them, writes silence. Only safe to call from the write thread.
+    bool write(const float * const * channels, size_t frames)
+    {
+        const size_t writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        if (_capacity - (writeIndex - _writerCachedRead) < frames)
+        {
+            _writerCachedRead = _readIndex.load(std::memory_order_acquire);
+            if (_capacity - (writeIndex - _writerCachedRead) < frames)
+                return false;
+        }
+
+        const size_t start = writeIndex % _capacity;
+        const size_t first = std::min(frames, _capacity - start);
+        for (int c = 0; c < _channels; ++c)
+        {
+            float * data = _data.get() + static_cast<size_t>(c) * _capacity;
+            const float * source = channels ? channels[c] : nullptr;
+            if (source)
+            {
+                std::memcpy(data + start, source, first * sizeof(float));
+                std::memcpy(data, source + first, (frames - first) * sizeof(float));
+            }
+            else
+            {
+                std::memset(data + start, 0, first * sizeof(float));
+                std::memset(data, 0, (frames - first) * sizeof(float));
+            }
+        }
+
+        _writeIndex.store(writeIndex + frames, std::memory_order_release);
+        return true;
+    }
+
+    // Reads frames of every channel, or nothing if there aren't that many. A null channels,
+    // or a null channel among them, discards what it would have received. Only safe to call
+    // from the read thread.
+    bool read(float * const * channels, size_t frames)
+    {
+        const size_t readIndex = _readIndex.load(std::memory_order_relaxed);
+        if (_readerCachedWrite - readIndex < frames)
+        {
+            _readerCachedWrite = _writeIndex.load(std::memory_order_acquire);
+            if (_readerCachedWrite - readIndex < frames)
+                return false;
+        }
+
+        const size_t start = readIndex % _capacity;
+        const size_t first = std::min(frames, _capacity - start);
+        for (int c = 0; channels && c < _channels; ++c)
+        {
+            const float * data = _data.get() + static_cast<size_t>(c) * _capacity;
+            if (float * destination = channels[c])
+            {
+                std::memcpy(destination, data + start, first * sizeof(float));
+                std::memcpy(destination + first, data, (frames - first) * sizeof(float));
+            }
+        }
+
+        _readIndex.store(readIndex + frames, std::memory_order_release);
+        return true;
+    }
+
+    // Empties the ring. Must be synchronized with both read and write threads.
+    void clear()
+    {
+        _writeIndex.store(0);
+        _readIndex.store(0);
+        _writerCachedRead = 0;
+        _readerCachedWrite = 0;
+    }
+
+private:
+    const int _channels;
+    const size_t _capacity;
+    std::unique_ptr<float[]> _data;  // channel after channel, each of capacity frames
+
+    alignas(64) std::atomic<size_t> _writeIndex {0};
+    size_t _writerCachedRead = 0;  // the read index as the writer last saw it
+
+    alignas(64) std::atomic<size_t> _readIndex {0};
+    size_t _readerCachedWrite = 0;  // the write index as the reader last saw it
+};
+
+
 template <typename Data>
 class ConcurrentQueue
 {
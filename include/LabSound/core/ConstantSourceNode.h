@@ -30,6 +30,7 @@ public:
     virtual const char * name() const override { return static_name(); }
     static AudioNodeDescriptor * desc();
     virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void processRange(ContextRenderLock &, int bufferSize, int offset, int count) override;
     virtual void reset(ContextRenderLock &) override { }
     std::shared_ptr<AudioParam> offset() { return m_offset; }
 
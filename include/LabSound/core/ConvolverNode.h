@@ -7,21 +7,33 @@
 #include "LabSound/core/AudioScheduledSourceNode.h"
 #include "LabSound/core/AudioSetting.h"
 
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace lab
 {
 
 class AudioBus;
 class AudioSetting;
-class Reverb;
-
-// private data for reverb computations
-struct sp_data;
-struct sp_conv;
-struct sp_ftbl;
-
+class PartitionedConvolver;
+
+// An impulse response is prepared as a job on the shared JobSystem: it is resampled to the
+// context's rate, normalized, and partitioned into convolvers there, and the finished set is
+// handed to the audio thread through an atomic slot, so that changing the impulse never blocks
+// rendering. The audio thread crossfades from the previous set to the new one over a few
+// render quanta, and hands the previous set back to be freed off the audio thread.
+//
+// The inaudible tail of a response is trimmed as it is prepared. Partitions of the response
+// or of the input that are silent are skipped, and once the input has been silent for
+// longer than the response, the convolver stops running until it sounds again.
+//
+// In an offline context, the whole response is convolved on the rendering thread rather
+// than with the tail on a worker, and the frequency domain products of every channel are
+// computed in one batch per quantum, by ConvolutionBatch's default backend, which a build
+// may replace with a compute backend. The output is the same as a realtime context gives
+// when its worker keeps up.
 class ConvolverNode final : public AudioScheduledSourceNode
 {
 public:
@@ -35,41 +47,63 @@ public:
     bool normalize() const;
     void setNormalize(bool new_n);
 
-    // set impulse will schedule the convolver to begin processing immediately
-    // The supplied bus is copied for use as an impulse response.
-    void setImpulse(std::shared_ptr<AudioBus> bus);
-    std::shared_ptr<AudioBus> getImpulse() const;
+    // Keeps the transformed impulse response in half precision, which halves the memory
+    // it takes and the bandwidth convolving it needs, at an error around 70 dB below the
+    // response. Off by default.
+    bool halfPrecision() const;
+    void setHalfPrecision(bool half);
+
+    // set impulse will schedule the convolver to begin processing immediately, and
+    // returns without waiting for the impulse to be prepared; the previous impulse, if
+    // any, carries on until the new one is ready.
+    // The supplied bus is shared, not copied, and is never modified; normalization
+    // is applied to the convolution kernels rather than to the bus.
+    void setImpulse(std::shared_ptr<const AudioBus> bus);
+    std::shared_ptr<const AudioBus> getImpulse() const;
     virtual void process(ContextRenderLock & r, int bufferSize) override;
     virtual void reset(ContextRenderLock &) override;
 
 protected:
-    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    // the length of the response, once its inaudible tail has been trimmed
+    virtual double tailTime(ContextRenderLock & r) const override;
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
     virtual bool propagatesSilence(ContextRenderLock & r) const override;
     double now() const { return _now; }
 
+    // the convolvers prepared for one impulse response
+    struct KernelSet;
+
     void _activateNewImpulse();
+    void _prepareImpulses();  // the preparing job's loop
+    void _collectRetired();
+    void _retireFading();
 
     double _now = 0.0;
-    float _scale = 1.f;  // normalization value
-    sp_data * _sp = nullptr;
 
     // Normalize the impulse response or not. Must default to true.
     std::shared_ptr<AudioSetting> _normalize;
     std::shared_ptr<AudioSetting> _impulseResponseClip;
-
-    struct ReverbKernel
-    {
-        ReverbKernel() = default;
-        ReverbKernel(ReverbKernel && rh) noexcept;
-        ~ReverbKernel();
-        sp_conv * conv = nullptr;
-        sp_ftbl * ft = nullptr;
-    };
-    std::vector<ReverbKernel> _kernels;  // one per impulse response channel
-    std::vector<ReverbKernel> _pending_kernels; // new kernels when an impulse has been computed
-    bool _swap_ready;
-    std::mutex _kernel_mutex;
+    std::shared_ptr<AudioSetting> _halfPrecision;
+
+    // owned by the audio thread: the set in use, and the set being faded out
+    std::unique_ptr<KernelSet> _kernels;
+    std::unique_ptr<KernelSet> _fading;
+    int _fadeFrame = 0;
+    uint64_t _silentFrames = 0;  // of input, consecutively
+
+    std::atomic<KernelSet *> _incoming {nullptr};  // from the preparing job to the audio thread
+    std::atomic<KernelSet *> _retired {nullptr};   // from the audio thread, to be freed
+    std::atomic<float> _sampleRate {0.f};           // the context's, as last rendered
+    bool _offline = false;                          // the context's, which never changes
+
+    // the latest request, guarded by _requestMutex, which the audio thread never takes
+    std::mutex _requestMutex;
+    std::shared_ptr<const AudioBus> _requestClip;
+    bool _requestNormalize = true;
+    bool _requestHalf = false;
+    uint64_t _requestSerial = 0;
+    uint64_t _preparedSerial = 0;
+    std::atomic<bool> _workerRunning {false};  // a preparing job is queued or running; written under the lock
 };
 
 }  // namespace lab
@@ -33,11 +33,24 @@ enum TempoSync
     TS_2D,
 };
 
+// A delay that has settled on a whole number of frames is a copy. Fractional and moving
+// delays are interpolated: linear is the cheapest; allpass keeps the full bandwidth of the
+// signal, and suits fixed or slowly moving delays; Lagrange, third order, is smoother than
+// linear for chorus and flanging, and needs at least a frame of delay, falling back to
+// linear below that.
 class DelayNode : public AudioBasicProcessorNode
 {
     DelayProcessor * delayProcessor();
 
 public:
+    enum InterpolationMode
+    {
+        LINEAR = 0,
+        ALLPASS = 1,
+        LAGRANGE = 2,
+        _Count = 3
+    };
+
     // default maximum delay of 100ms
     DelayNode(AudioContext & ac, double maxDelayTime = 2.0);
 
@@ -48,6 +61,9 @@ public:
     static AudioNodeDescriptor * desc();
 
     std::shared_ptr<AudioSetting> delayTime();
+
+    InterpolationMode interpolation();
+    void setInterpolation(InterpolationMode mode);
 };
 
 }  // namespace lab
@@ -19,6 +19,9 @@ class DynamicsCompressor;
 //
 // sounds like an old radio
 //
+// Input 0 is the signal to compress. If input 1 is connected, it is a sidechain whose
+// level drives the compression instead, as for ducking music under a voice.
+//
 
 class DynamicsCompressorNode : public AudioNode
 {
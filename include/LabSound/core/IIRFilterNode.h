@@ -0,0 +1,54 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef IIRFilterNode_h
+#define IIRFilterNode_h
+
+#include "LabSound/core/AudioBasicProcessorNode.h"
+
+#include <vector>
+
+namespace lab
+{
+
+// IIRFilterNode filters every channel of its input through a general infinite impulse
+// response filter, given by its feedforward (numerator) and feedback (denominator)
+// coefficients as in Web Audio. Rather than run the filter in direct form, which loses
+// precision quickly as the order grows, the node factors it into a cascade of second
+// order sections, and filters all the sections and channels in one pass, as EqualizerNode
+// does its bands.
+class IIRFilterNode : public AudioBasicProcessorNode
+{
+    class IIRFilterNodeInternal;
+    IIRFilterNodeInternal * iir_impl;
+
+public:
+    enum : int { MaxOrder = 20 };
+
+    // passes its input through until coefficients are set
+    IIRFilterNode(AudioContext & ac);
+    IIRFilterNode(AudioContext & ac, const std::vector<double> & feedforward, const std::vector<double> & feedback);
+    virtual ~IIRFilterNode();
+
+    static const char * static_name() { return "IIRFilter"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // From one to MaxOrder + 1 coefficients of each. feedback[0] must not be zero, and
+    // feedforward must not be all zeros, or std::invalid_argument is thrown. The filter
+    // restarts from rest. An unstable filter is accepted, and a warning logged.
+    void setCoefficients(const std::vector<double> & feedforward, const std::vector<double> & feedback);
+    std::vector<double> feedforward() const;
+    std::vector<double> feedback() const;
+
+    // the number of second order sections the filter was factored into
+    int numberOfSections() const;
+
+    // Get the magnitude and phase response of the filter at the given
+    // set of frequencies (in Hz). The phase response is in radians.
+    void getFrequencyResponse(const std::vector<float> & frequencyHz, std::vector<float> & magResponse, std::vector<float> & phaseResponse) const;
+};
+
+}  // namespace lab
+
+#endif  // IIRFilterNode_h
@@ -7,7 +7,9 @@
 #define LABSOUND_DEFAULT_SAMPLERATE 48000.0f
 #define LABSOUND_DEFAULT_CHANNELS (uint32_t) lab::Channels::Stereo
 
-#if (defined(__linux) || defined(__unix) || defined(__posix) || defined(__LINUX__) || defined(__linux__))
+#if defined(__EMSCRIPTEN__)
+  #define LABSOUND_PLATFORM_WASM 1
+#elif (defined(__linux) || defined(__unix) || defined(__posix) || defined(__LINUX__) || defined(__linux__))
   #define LABSOUND_PLATFORM_LINUX 1
 #elif (defined(_WIN64) || defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__))
   #define LABSOUND_PLATFORM_WINDOWS 1
@@ -39,6 +41,12 @@
   #define ARM_NEON_INTRINSICS 1
 #endif
 
+// Built with -msimd128. Emscripten also offers SSE2 through -msse2, which is translated to
+// the same instructions; should both be given, the SSE2 paths are used.
+#if defined(__wasm_simd128__) && !defined(__SSE2__)
+  #define WASM_SIMD128_INTRINSICS 1
+#endif
+
 #if defined(LABSOUND_COMPILER_VISUAL_STUDIO)
   #define _USE_MATH_DEFINES
 #endif
@@ -47,10 +55,6 @@
 #include <cmath>
 #include <math.h>
 
-#if defined(LABSOUND_PLATFORM_WINDOWS)
-  #define USE_KISS_FFT
-#endif
-
 #define LAB_PI          3.1415926535897931
 #define LAB_HALF_PI     1.5707963267948966
 #define LAB_QUARTER_PI  0.7853981633974483
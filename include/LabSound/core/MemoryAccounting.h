@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_MEMORY_ACCOUNTING_H
+#define LABSOUND_MEMORY_ACCOUNTING_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+enum class MemoryCategory : int
+{
+    Unattributed = 0,  // allocated outside any owner's scope
+    Node,
+    Asset,             // decoded sounds
+    Subsystem,         // shared tables, such as periodic waves and the HRTF database
+    _Count
+};
+
+// Something memory is charged to: a node, an asset, or a subsystem. Charges and releases are
+// relaxed atomic additions, so that any thread, the audio thread included, may make them.
+class MemoryOwner : public std::enable_shared_from_this<MemoryOwner>
+{
+    MemoryCategory _category;
+    std::string _name;
+    std::atomic<const char *> _label {nullptr};
+    std::atomic<int64_t> _bytes {0};
+    std::atomic<int64_t> _peakBytes {0};
+    std::atomic<bool> _claimed {false};
+
+public:
+    MemoryOwner(MemoryCategory category, const std::string & name)
+        : _category(category), _name(name) {}
+
+    MemoryCategory category() const { return _category; }
+
+    // The name the owner was made with, or failing that its label
+    std::string name() const;
+
+    // Names an owner made without a name, from any thread, such as a node's owner once the
+    // node's name is known. The string must outlive the owner.
+    void setLabel(const char * label) { _label.store(label, std::memory_order_relaxed); }
+
+    // A negative charge releases memory
+    void charge(int64_t bytes);
+
+    int64_t bytes() const { return _bytes.load(std::memory_order_relaxed); }
+    int64_t peakBytes() const { return _peakBytes.load(std::memory_order_relaxed); }
+
+    // True for the first caller only; a node adopts the owner it is constructed in the scope
+    // of by claiming it, so that nodes a node makes while it is constructed get their own
+    bool claim()
+    {
+        bool claimed = false;
+        return _claimed.compare_exchange_strong(claimed, true);
+    }
+};
+
+struct MemoryUsage
+{
+    std::string name;
+    MemoryCategory category = MemoryCategory::Unattributed;
+    int64_t bytes = 0;
+    int64_t peakBytes = 0;
+};
+
+// MemoryAccounting charges the sample memory LabSound allocates, for AudioBuses and
+// AudioArrays, to the owner of the innermost MemoryOwnerScope on the allocating thread,
+// and releases it from the same owner however it is freed. Owners are scoped where memory is
+// made on their behalf: each node while it is constructed, if it is made inside a scope of a
+// node owner it can adopt, and while it processes; decoded files and cached assets; periodic
+// wave tables; the HRTF database; convolver partitions; and recordings. Memory allocated
+// outside any scope is charged to an Unattributed owner.
+//
+// The totals can be read at any time, from any thread, to enforce a budget, and the owners
+// listed to find the largest.
+class MemoryAccounting
+{
+public:
+    static std::shared_ptr<MemoryOwner> createOwner(MemoryCategory category, const std::string & name);
+
+    // The process wide owner of a subsystem's memory, made on first use
+    static std::shared_ptr<MemoryOwner> subsystem(const std::string & name);
+
+    // The owner of this thread's innermost scope, or null
+    static MemoryOwner * current();
+
+    // For allocators. Charges the current owner, or the unattributed owner, and returns it,
+    // so that the memory can be released from it when it is freed.
+    static std::shared_ptr<MemoryOwner> charge(int64_t bytes);
+
+    static int64_t totalBytes();
+    static int64_t bytes(MemoryCategory category);
+
+    // Every owner that holds memory, or only those of a category, largest first
+    static std::vector<MemoryUsage> usage();
+    static std::vector<MemoryUsage> usage(MemoryCategory category);
+    static std::vector<MemoryUsage> topConsumers(int count);
+
+    // A budget of zero is none. Nothing is refused for being over budget; an application
+    // checks, and sheds what it must, such as by evicting cached assets.
+    static void setBudget(MemoryCategory category, int64_t bytes);
+    static int64_t budget(MemoryCategory category);
+    static bool isOverBudget(MemoryCategory category);
+
+private:
+    friend class MemoryOwner;
+    static void record(MemoryCategory category, int64_t bytes);
+};
+
+// Charges memory allocated on this thread to owner for the scope's lifetime. Scopes nest.
+class MemoryOwnerScope
+{
+    MemoryOwner * _previous;
+
+public:
+    explicit MemoryOwnerScope(MemoryOwner * owner);
+    explicit MemoryOwnerScope(const std::shared_ptr<MemoryOwner> & owner) : MemoryOwnerScope(owner.get()) {}
+    ~MemoryOwnerScope();
+
+    MemoryOwnerScope(const MemoryOwnerScope &) = delete;
+    MemoryOwnerScope & operator=(const MemoryOwnerScope &) = delete;
+};
+
+}  // lab
+
+#endif  // LABSOUND_MEMORY_ACCOUNTING_H
@@ -26,7 +26,11 @@ enum class Channel : int
     SurroundLeft = 4,
     SurroundRight = 5,
     BackLeft = 6,
-    BackRight = 7
+    BackRight = 7,
+    TopFrontLeft = 8,
+    TopFrontRight = 9,
+    TopBackLeft = 10,
+    TopBackRight = 11
 };
 
 namespace Channels
@@ -38,7 +42,8 @@ namespace Channels
         Quad = 4,
         Surround_5_0 = 5,
         Surround_5_1 = 6,
-        Surround_7_1 = 8
+        Surround_7_1 = 8,
+        Surround_7_1_4 = 12
     };
 };
 
@@ -0,0 +1,110 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef ModulationBus_h
+#define ModulationBus_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lab
+{
+
+class ContextRenderLock;
+
+enum class ModulationShape : int
+{
+    Sine = 0,
+    Triangle,
+    Square,
+    SawUp,
+    SawDown,
+    Ramp,       // rises from 0 to 1 over each cycle, where the others swing between -1 and 1
+};
+
+// A tempo-synced control signal, rendered once a quantum by its context's ModulationBus
+// and read by every AudioParam it modulates. Its phase follows the bus's beat, so that
+// modulators of the same period stay locked to one another and to the tempo.
+class Modulator
+{
+public:
+    ModulationShape shape() const { return m_shape; }
+    double beatsPerCycle() const { return m_beatsPerCycle; }
+    double phase() const { return m_phase; }
+
+    // Render thread. The current quantum's values.
+    const float * values() const { return m_values.data(); }
+
+private:
+    friend class ModulationBus;
+    Modulator(ModulationShape shape, double beatsPerCycle, double phase);
+
+    void render(double beat, double beatsPerFrame, int frames);
+
+    ModulationShape m_shape;
+    double m_beatsPerCycle;
+    double m_phase;
+    std::vector<float> m_values;
+};
+
+// The context's tempo, its beat position, and the modulators following it. A modulator is
+// shared by everything asking for the same shape, period and phase, so that a mix full of
+// tremolos and auto-pans at the song's tempo renders each distinct LFO once a quantum rather
+// than running an OscillatorNode per effect. AudioParam::modulate fans a modulator out to
+// any number of parameters, each at its own depth.
+//
+// The bus renders before the graph each quantum, so parameters on any render thread may
+// read its modulators. A modulator no longer held outside the bus stops rendering when the
+// next one is made.
+class ModulationBus
+{
+public:
+    explicit ModulationBus(float tempo = 120.f);
+    ~ModulationBus();
+
+    // Any thread. A tempo change takes effect at the next quantum, where the beat carries on
+    // from where it was, so modulators don't jump.
+    void setTempo(float beatsPerMinute);
+    float tempo() const { return m_tempo.load(std::memory_order_relaxed); }
+
+    // Any thread. Moves the beat, to line the modulators up with a sequencer, at the next quantum.
+    void setBeat(double beat);
+
+    // The beat the next quantum starts on
+    double beat() const { return m_beat.load(std::memory_order_relaxed); }
+
+    // Seconds per beat at the current tempo, for effects whose times follow the tempo
+    double secondsPerBeat() const { return 60.0 / tempo(); }
+
+    // Main thread. The modulator of the shape cycling every beatsPerCycle beats, starting
+    // phase cycles into its cycle on the beat; a quarter note is one beat.
+    std::shared_ptr<Modulator> lfo(ModulationShape shape, double beatsPerCycle, double phase = 0);
+
+    // A Ramp rising from 0 to 1 every beatsPerCycle beats
+    std::shared_ptr<Modulator> ramp(double beatsPerCycle, double phase = 0)
+    {
+        return lfo(ModulationShape::Ramp, beatsPerCycle, phase);
+    }
+
+    // Render thread. Renders the modulators for the quantum beginning now, and advances the beat.
+    void render(ContextRenderLock & r, int frames);
+
+private:
+    using Modulators = std::vector<std::shared_ptr<Modulator>>;
+
+    std::atomic<float> m_tempo;
+    std::atomic<double> m_beat {0};
+    std::atomic<double> m_requestedBeat {0};
+    std::atomic<bool> m_beatRequested {false};
+
+    std::mutex m_mutex;                  // guards m_modulators, on the main thread
+    Modulators m_modulators;
+    std::shared_ptr<const Modulators> m_rendering;  // published to the render thread
+};
+
+}  // namespace lab
+
+#endif  // ModulationBus_h
@@ -9,6 +9,9 @@
 #include "LabSound/core/Macros.h"
 #include "LabSound/core/PeriodicWave.h"
 
+#include <atomic>
+#include <memory>
+
 namespace lab
 {
 
@@ -39,11 +42,17 @@ public:
     static AudioNodeDescriptor * desc();
 
     virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void processRange(ContextRenderLock &, int bufferSize, int offset, int count) override;
     virtual void reset(ContextRenderLock &) override { }
 
     OscillatorType type() const;
     void setType(OscillatorType type);
 
+    // Plays the wave's tables, and sets the type to CUSTOM. Waves from PeriodicWave::shared
+    // are shared with every other oscillator playing the same wave.
+    void setPeriodicWave(std::shared_ptr<PeriodicWave> wave);
+    std::shared_ptr<PeriodicWave> periodicWave() const { return std::atomic_load(&m_periodicWave); }
+
     std::shared_ptr<AudioParam> amplitude() { return m_amplitude; }
     std::shared_ptr<AudioParam> frequency() { return m_frequency; }
     std::shared_ptr<AudioParam> detune() { return m_detune; }
@@ -60,6 +69,9 @@ public:
     AudioFloatArray m_biasValues;
     AudioFloatArray m_detuneValues;
     AudioFloatArray m_amplitudeValues;
+    AudioFloatArray m_tableIndices;  // read positions in the periodic wave's tables
+
+    std::shared_ptr<PeriodicWave> m_periodicWave;  // played when the type is CUSTOM
 };
 
 }  // namespace lab
@@ -9,6 +9,9 @@
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/FloatPoint3D.h"
 #include "LabSound/core/Macros.h"
+#include "LabSound/core/SpatialScene.h"
+
+#include <atomic>
 
 namespace lab
 {
@@ -23,14 +26,29 @@ namespace lab
 class AudioBus;
 class ConeEffect;
 class DistanceEffect;
+class DopplerDelay;
 class Panner;
 
+// Levels of detail for spatialization, from the most expensive to the least. A panner
+// given a tier renders with it in place of its panning model, so that a manager such as
+// SpatialLOD can spend HRTF processing only on the sources that benefit from it.
+enum class SpatialTier : int
+{
+    Model = 0,   // the panner's panning model; the default
+    HRTF,        // HRTF convolution once the database is loaded, and Binaural until then
+    Binaural,    // interaural time and level differences and head shadow, without convolution
+    EqualPower,
+    Virtual,     // silent, and not panned at all
+};
+
 // params: orientation[XYZ], velocity[XYZ], position[XYZ]
 // settings: distanceModel, refDistance, maxDistance, rolloffFactor,
-//           coneKInnerAngle, coneOuterAngle, panningMode
+//           coneKInnerAngle, coneOuterAngle, panningMode, ambisonicOrder, doppler
 //
 class PannerNode : public AudioNode
 {
+    friend class SpatialScene;
+
     std::shared_ptr<AudioParam> m_orientationX;
     std::shared_ptr<AudioParam> m_orientationY;
     std::shared_ptr<AudioParam> m_orientationZ;
@@ -51,6 +69,9 @@ class PannerNode : public AudioNode
     std::shared_ptr<AudioSetting> m_coneInnerAngle;
     std::shared_ptr<AudioSetting> m_coneOuterAngle;
     std::shared_ptr<AudioSetting> m_panningModel;
+    std::shared_ptr<AudioSetting> m_ambisonicOrder;
+    std::shared_ptr<AudioSetting> m_doppler;
+    std::shared_ptr<AudioSetting> m_hrtfInterpolation;
 
 public:
     enum DistanceModel
@@ -77,6 +98,43 @@ public:
     PanningModel panningModel() const;
     void setPanningModel(PanningModel m);
 
+    // In the AMBISONIC model, the panner encodes its input into a sound field of this order,
+    // from 1 to 3, with (order + 1)^2 channels in ACN order and SN3D normalization. The fields of
+    // many panners are summed by connecting them to one AmbisonicDecoderNode, which turns and
+    // decodes them together, so that each source costs only its encoding. The default is 1.
+    int ambisonicOrder() const;
+    void setAmbisonicOrder(int order);
+
+    // With doppler enabled, the input is heard through the delay of the distance it travels
+    // to the listener at the listener's speedOfSound, scaled by its dopplerFactor, and the
+    // delay changes with the velocities of the panner and the listener, so that a moving
+    // source is heard shifted in pitch at the rate dopplerRate gives. Sources are heard up
+    // to a second away. The default is disabled.
+    bool dopplerEnabled() const;
+    void setDopplerEnabled(bool enabled);
+
+    // In the HRTF model, a moving source is normally heard through both its old and new
+    // directions' responses as it crossfades between them, which doubles its convolution cost
+    // while it moves. With interpolation, the responses are blended in the frequency domain
+    // and convolved once per ear, so that a moving source costs what a still one does. The
+    // default is disabled.
+    bool hrtfInterpolation() const;
+    void setHrtfInterpolation(bool enabled);
+
+    // Any thread. A change of tier crossfades from the old tier to the new over about 20 ms.
+    // Tiers don't apply to the AMBISONIC model, whose output is a sound field.
+    SpatialTier spatialTier() const { return static_cast<SpatialTier>(m_spatialTier.load(std::memory_order_relaxed)); }
+    void setSpatialTier(SpatialTier tier) { m_spatialTier.store(static_cast<int>(tier), std::memory_order_relaxed); }
+
+    // Any thread. The distance and cone gain of the latest quantum, by which the source's
+    // audibility may be judged.
+    float audibleGain() const { return m_audibleGain.load(std::memory_order_relaxed); }
+
+    // The panner's slot in its context's SpatialScene, or -1 if it isn't in the scene. A panner
+    // in the scene takes its position, orientation and velocity from its slot, and its
+    // parameters for them are ignored.
+    int sceneSlot() const { return m_sceneSlot.load(std::memory_order_relaxed); }
+
     // Position
     void setPosition(float x, float y, float z) { setPosition(FloatPoint3D(x, y, z)); }
     void setPosition(const FloatPoint3D & position);
@@ -125,6 +183,12 @@ public:
     void setConeOuterGain(float angle);
 
     void getAzimuthElevation(ContextRenderLock & r, double * outAzimuth, double * outElevation);
+
+    // The azimuth and elevation, in degrees, at which a listener at listenerPosition, facing
+    // listenerForward with listenerUp above, hears a source at position
+    static void azimuthElevation(const FloatPoint3D & position, const FloatPoint3D & listenerPosition,
+                                 const FloatPoint3D & listenerForward, const FloatPoint3D & listenerUp,
+                                 double * outAzimuth, double * outElevation);
     float dopplerRate(ContextRenderLock & r);
 
     // Accessors for dynamically calculated gain values.
@@ -138,6 +202,10 @@ protected:
     // Returns the combined distance and cone gain attenuation.
     virtual float distanceConeGain(ContextRenderLock & r);
 
+    // The position, orientation and velocity of the quantum, from the scene if the panner is
+    // in it, and otherwise from the parameters
+    SpatialTransform sourceTransform(ContextRenderLock & r) const;
+
     // Notifies any SampledAudioNodes connected to us either directly or indirectly about our existence.
     // This is in order to handle the pitch change necessary for the doppler shift.
     // @tofix - broken?
@@ -146,9 +214,71 @@ protected:
     std::unique_ptr<Panner> m_panner;
     std::unique_ptr<DistanceEffect> m_distanceEffect;
     std::unique_ptr<ConeEffect> m_coneEffect;
+    std::unique_ptr<DopplerDelay> m_dopplerDelay;
 
     float m_lastGain = -1.0f;
     float m_sampleRate;
+
+private:
+    // The source, delayed on its way to the listener
+    AudioBus & dopplerDelayed(ContextRenderLock & r, const AudioBus & source, int bufferSize);
+
+    // Whether HRTF panning can proceed; an offline context waits for the database to load
+    bool hrtfReady(ContextRenderLock & r);
+
+    // Renders a panner that has been given a tier, or is fading out of one
+    void processTiers(ContextRenderLock & r, SpatialTier tier, const AudioBus & source, AudioBus & destination, int bufferSize);
+    Panner * tierPanner(ContextRenderLock & r, SpatialTier tier);
+
+    void cachedAzimuthElevation(const FloatPoint3D & position, const FloatPoint3D & listenerPosition,
+                                const FloatPoint3D & listenerForward, const FloatPoint3D & listenerUp,
+                                double * outAzimuth, double * outElevation);
+
+    // The azimuth and elevation, the gains, and the doppler rate are only calculated again once
+    // the geometry they depend on changes, so that a static source costs no more than its panning.
+    struct AzimuthElevationCache
+    {
+        FloatPoint3D position, listenerPosition, listenerForward, listenerUp;
+        double azimuth = 0;
+        double elevation = 0;
+        bool valid = false;
+    };
+
+    struct GainCache
+    {
+        FloatPoint3D position, orientation, listenerPosition;
+        float gain = 1.f;
+        bool valid = false;
+    };
+
+    struct DopplerCache
+    {
+        FloatPoint3D position, velocity, listenerPosition, listenerVelocity;
+        double dopplerFactor = 0;
+        double speedOfSound = 0;
+        float rate = 1.f;
+        bool valid = false;
+    };
+
+    AzimuthElevationCache m_azimuthElevationCache;
+    GainCache m_gainCache;
+    DopplerCache m_dopplerCache;
+
+    // set when a distance or cone setting changes
+    std::atomic<bool> m_gainSettingsChanged {true};
+
+    std::atomic<int> m_spatialTier {static_cast<int>(SpatialTier::Model)};
+    std::atomic<int> m_sceneSlot {-1};
+    std::atomic<float> m_audibleGain {1.f};
+
+    // the tier being rendered, and while a change of tier is being crossfaded, the tier
+    // being faded out and the frames of the fade yet to come
+    SpatialTier m_renderedTier = SpatialTier::Model;
+    SpatialTier m_fadingTier = SpatialTier::Model;
+    int m_tierFadeRemaining = 0;
+    int m_tierFadeLength = 0;
+    std::unique_ptr<AudioBus> m_tierFadeBus;
+    std::unique_ptr<Panner> m_tierPanners[3];  // HRTF, Binaural, EqualPower
 };
 
 }  // namespace lab
@@ -22,6 +22,13 @@ public:
 
     ~PeriodicWave();
 
+    // Building a wave runs an inverse FFT per pitch range, so waves are shared through a
+    // process wide cache, keyed by sample rate, waveform, and for custom waves the Fourier
+    // coefficients. A wave's tables are never modified once built, and are freed when the
+    // last user releases them. These may be called from any thread but the render thread.
+    static std::shared_ptr<PeriodicWave> shared(float sampleRate, OscillatorType basicWaveform);
+    static std::shared_ptr<PeriodicWave> shared(float sampleRate, const std::vector<float> & real, const std::vector<float> & imag);
+
     // Returns pointers to the lower and higher wavetable data for the pitch range containing
     // the given fundamental frequency. These two tables are in adjacent "pitch" ranges
     // where the higher table will have the maximum number of partials which won't alias when played back
@@ -1,11 +1,31 @@
 // SPDX-License-Identifier: BSD-2-Clause
 // Copyright (C) 2020, The LabSound Authors. All rights reserved.
 
+#pragma once
+#ifndef lab_profiler_h
+#define lab_profiler_h
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <stdint.h>
+#include <type_traits>
+
+// Defined to 0, as the CMake option LABSOUND_ENABLE_PROFILING does when off, the profile
+// scopes are compiled to nothing, and the profiles are never written.
+#ifndef LABSOUND_PROFILING
+#define LABSOUND_PROFILING 1
+#endif
 
 namespace lab
 {
 
+    // A monotonic clock; the high resolution clock is used where it is steady,
+    // as on some platforms it is an alias of the wall clock.
+    using ProfileClock = std::conditional<std::chrono::high_resolution_clock::is_steady,
+                                          std::chrono::high_resolution_clock,
+                                          std::chrono::steady_clock>::type;
+
     struct ProfileSample
     {
         ProfileSample() { zero(); }
@@ -14,13 +34,19 @@ namespace lab
         void zero() { microseconds = std::chrono::duration<float, std::micro>::zero(); finalized = true; }
     };
 
+    // Times its scope into s, unless it is inactive, when it reads no clock
     struct ProfileScope
     {
-        explicit ProfileScope(ProfileSample& s)
-        : s(&s)
+        explicit ProfileScope(ProfileSample& s, bool active = true)
         {
-            _start = std::chrono::system_clock::now();
-            s.finalized = false;
+#if LABSOUND_PROFILING
+            if (active)
+            {
+                this->s = &s;
+                _start = ProfileClock::now();
+                s.finalized = false;
+            }
+#endif
         }
 
         ~ProfileScope()
@@ -30,16 +56,131 @@ namespace lab
 
         void finalize()
         {
-            if (!s->finalized)
+            if (s && !s->finalized)
             {
-                //std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
-                s->microseconds = std::chrono::system_clock::now() - _start;
+                s->microseconds = ProfileClock::now() - _start;
                 s->finalized = true;
             }
         }
 
         ProfileSample* s = nullptr;
-        std::chrono::system_clock::time_point _start;
+        ProfileClock::time_point _start;
+    };
+
+    // Summary of the most recent samples in a ProfileHistory, in microseconds
+    struct ProfileStats
+    {
+        int count = 0;
+        float minimum = 0;
+        float mean = 0;
+        float p99 = 0;
+        float maximum = 0;
+    };
+
+    // A record of the last Capacity samples, one per render quantum. The render
+    // thread is the only writer, and neither it nor a reader ever waits on the
+    // other, so that a control thread may take a snapshot at any time without
+    // holding the render lock.
+    class ProfileHistory
+    {
+    public:
+        enum : int { Capacity = 1024 };  // must be a power of two
+
+        // called from the render thread
+        void record(float microseconds)
+        {
+            const uint64_t w = _written.load(std::memory_order_relaxed);
+            _samples[w & (Capacity - 1)].store(microseconds, std::memory_order_relaxed);
+            _written.store(w + 1, std::memory_order_release);
+        }
+
+        // the number of samples recorded since the history was created
+        uint64_t recorded() const { return _written.load(std::memory_order_acquire); }
+
+        // Copies up to window of the most recent samples, oldest first, into dst,
+        // which must have room for window samples. Returns the number copied.
+        // Samples overwritten by the render thread while copying are discarded.
+        int snapshot(float * dst, int window) const
+        {
+            window = std::max(0, std::min(window, static_cast<int>(Capacity)));
+
+            const uint64_t end = _written.load(std::memory_order_acquire);
+            uint64_t begin = end > static_cast<uint64_t>(window) ? end - window : 0;
+            for (uint64_t i = begin; i < end; ++i)
+                dst[i - begin] = _samples[i & (Capacity - 1)].load(std::memory_order_relaxed);
+
+            // the slot after the last one written may be being overwritten now
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t now = _written.load(std::memory_order_relaxed) + 1;
+            const uint64_t valid = now > Capacity ? now - Capacity : 0;
+            if (valid <= begin)
+                return static_cast<int>(end - begin);
+
+            if (valid >= end)
+                return 0;
+
+            const int stale = static_cast<int>(valid - begin);
+            std::copy(dst + stale, dst + (end - begin), dst);
+            return static_cast<int>(end - valid);
+        }
+
+        // min, mean, 99th percentile and max over the most recent window samples
+        ProfileStats stats(int window = Capacity) const
+        {
+            float samples[Capacity];
+            ProfileStats result;
+            result.count = snapshot(samples, window);
+            if (!result.count)
+                return result;
+
+            float sum = 0;
+            result.minimum = samples[0];
+            result.maximum = samples[0];
+            for (int i = 0; i < result.count; ++i)
+            {
+                sum += samples[i];
+                result.minimum = std::min(result.minimum, samples[i]);
+                result.maximum = std::max(result.maximum, samples[i]);
+            }
+            result.mean = sum / static_cast<float>(result.count);
+
+            const int rank = std::max(0, (result.count * 99 + 99) / 100 - 1);
+            std::nth_element(samples, samples + rank, samples + result.count);
+            result.p99 = samples[rank];
+            return result;
+        }
+
+    private:
+        std::atomic<float> _samples[Capacity] = {};
+        std::atomic<uint64_t> _written {0};
+    };
+
+    // Times a scope into total, and when the scope ends records the self time,
+    // total less the time spent in nested, into history.
+    struct ProfileSelfScope
+    {
+        ProfileSelfScope(ProfileSample & total, const ProfileSample & nested, ProfileHistory & history, bool active = true)
+        : _total(total, active), _nested(nested), _history(history) {}
+
+        ~ProfileSelfScope()
+        {
+            finalize();
+        }
+
+        void finalize()
+        {
+            if (_total.s && !_total.s->finalized)
+            {
+                _total.finalize();
+                _history.record(std::max(0.f, (_total.s->microseconds - _nested.microseconds).count()));
+            }
+        }
+
+        ProfileScope _total;
+        const ProfileSample & _nested;
+        ProfileHistory & _history;
     };
 
 } // lab
+
+#endif  // lab_profiler_h
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_RENDER_CLOCK_H
+#define LABSOUND_RENDER_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string.h>
+
+namespace lab
+{
+
+// The render clock at the start of a quantum
+struct RenderClockSnapshot
+{
+    uint64_t sampleFrame = 0;
+    double time = 0;  // seconds, of context time
+    float sampleRate = 0;
+
+    // when the device asked for the quantum; zero until a device has rendered one
+    std::chrono::high_resolution_clock::time_point hostTime;
+};
+
+// The render clock, published by the audio thread once per quantum and readable from any
+// thread. It is a sequence lock: a reader retries in the rare event that it overlaps a
+// publication, so that it never sees the fields of two quanta mixed, and the writer
+// neither waits nor allocates. A read costs a few loads.
+class RenderClock
+{
+public:
+    // one thread publishes
+    void publish(const RenderClockSnapshot & clock)
+    {
+        const uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        _sampleFrame.store(clock.sampleFrame, std::memory_order_relaxed);
+        _time.store(bits(clock.time), std::memory_order_relaxed);
+        _sampleRate.store(bits(static_cast<double>(clock.sampleRate)), std::memory_order_relaxed);
+        _hostTime.store(static_cast<int64_t>(clock.hostTime.time_since_epoch().count()), std::memory_order_relaxed);
+
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    RenderClockSnapshot read() const
+    {
+        RenderClockSnapshot clock;
+        for (;;)
+        {
+            const uint32_t before = _sequence.load(std::memory_order_acquire);
+            clock.sampleFrame = _sampleFrame.load(std::memory_order_relaxed);
+            clock.time = value(_time.load(std::memory_order_relaxed));
+            clock.sampleRate = static_cast<float>(value(_sampleRate.load(std::memory_order_relaxed)));
+            const int64_t hostTime = _hostTime.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!(before & 1) && _sequence.load(std::memory_order_relaxed) == before)
+            {
+                clock.hostTime = std::chrono::high_resolution_clock::time_point(std::chrono::high_resolution_clock::duration(hostTime));
+                return clock;
+            }
+        }
+    }
+
+private:
+    static uint64_t bits(double v)
+    {
+        uint64_t b;
+        memcpy(&b, &v, sizeof(b));
+        return b;
+    }
+    static double value(uint64_t b)
+    {
+        double v;
+        memcpy(&v, &b, sizeof(v));
+        return v;
+    }
+
+    std::atomic<uint32_t> _sequence {0};  // odd while a publication is in progress
+    std::atomic<uint64_t> _sampleFrame {0};
+    std::atomic<uint64_t> _time {0};
+    std::atomic<uint64_t> _sampleRate {0};
+    std::atomic<int64_t> _hostTime {0};
+};
+
+}  // lab
+
+#endif  // LABSOUND_RENDER_CLOCK_H
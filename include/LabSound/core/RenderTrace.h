@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_RENDER_TRACE_H
+#define LABSOUND_RENDER_TRACE_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+namespace lab
+{
+
+// RenderTrace records what the engine's threads do as timed events: each render quantum,
+// each node's processing, the graph edits applied at the start of a quantum, background
+// jobs, file decoding and HRTF database loading, and render stalls. Written out in the
+// Chrome trace event format, a recording opens in Perfetto or chrome://tracing, showing
+// on a timeline how the work spreads across threads, and where a quantum ran long.
+//
+// Tracing is off until started, and costs a relaxed load at each event site while off.
+// Each thread records into a buffer of its own, claimed without locking from those that
+// start() allocated, so that the audio thread neither waits nor allocates. Events past a
+// buffer's capacity, and those of threads beyond the buffers allocated, are dropped and
+// counted.
+class RenderTrace
+{
+public:
+    // Begins a recording, discarding the last. The buffers are allocated by the first
+    // start, and are kept at that size for the life of the process, since a thread may be
+    // recording into one as another start begins.
+    static void start(int eventsPerThread = 65536, int threads = 32);
+    static void stop();
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Writes the recording as Chrome trace event JSON. Stop first, so that it is complete.
+    static bool writeChromeJson(const std::string & path);
+
+    static uint64_t droppedEvents();
+
+    // Names the calling thread in the recording
+    static void nameThread(const char * name);
+
+    // Records an event without duration, such as a stall. Names and categories must
+    // outlive the recording, as string literals and node names do.
+    static void instant(const char * name, const char * category);
+
+    // Records a span, with times from now(); TraceScope is the usual way to
+    static void record(const char * name, const char * category, int64_t begin, int64_t end);
+    static int64_t now();  // nanoseconds
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Records the span of a scope, if a trace is being recorded as it begins
+class TraceScope
+{
+public:
+    TraceScope(const char * name, const char * category)
+    : _name(name), _category(category), _begin(RenderTrace::enabled() ? RenderTrace::now() : -1) {}
+
+    ~TraceScope()
+    {
+        if (_begin >= 0)
+            RenderTrace::record(_name, _category, _begin, RenderTrace::now());
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope & operator=(const TraceScope &) = delete;
+
+private:
+    const char * _name;
+    const char * _category;
+    int64_t _begin;
+};
+
+}  // lab
+
+#endif  // LABSOUND_RENDER_TRACE_H
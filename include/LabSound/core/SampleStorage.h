@@ -0,0 +1,93 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef SampleStorage_h
+#define SampleStorage_h
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+class AudioBus;
+class MappedFile;
+
+// SampleStorage holds a sound in less memory than an AudioBus, for SampledAudioNode to
+// play from. Int16 halves the size of float samples; ImaAdpcm stores four bits a sample,
+// an eighth of the size, in independently decodable blocks so that playback can start
+// anywhere. Samples are converted back to float a quantum at a time as they are played.
+//
+// Storage may also map an uncompressed file, and play its samples where they lie, still
+// interleaved, so that the file loads at once, is read from disk only as it plays, and is
+// shared with every other process playing it through the operating system's page cache.
+class SampleStorage
+{
+public:
+    enum class Format
+    {
+        Int16,
+        ImaAdpcm,
+        Float32,
+    };
+
+    // Frames in each ImaAdpcm block
+    static const int AdpcmBlockFrames = 256;
+
+    // Encodes the bus's samples, clipped to [-1, 1]
+    static std::shared_ptr<SampleStorage> create(const AudioBus & bus, Format format);
+
+    // Maps a WAV file of 16 bit integer or 32 bit float samples. Returns null if the file
+    // can't be mapped or holds another format, in which case it is to be decoded instead.
+    static std::shared_ptr<SampleStorage> map(const std::string & path);
+
+    // Maps a headerless file of little endian Int16 or Float32 frames, interleaved if there
+    // is more than one channel, starting dataOffset bytes in
+    static std::shared_ptr<SampleStorage> mapRaw(const std::string & path, Format format, int channels,
+                                                 float sampleRate, size_t dataOffset = 0);
+
+    bool isMapped() const { return m_file != nullptr; }
+
+    Format format() const { return m_format; }
+    int numberOfChannels() const { return static_cast<int>(m_channels.size()); }
+    int length() const { return m_length; }
+    float sampleRate() const { return m_sampleRate; }
+
+    // The memory held by the samples. Mapped samples are counted too, though only those
+    // played recently are likely to be resident.
+    size_t sizeInBytes() const;
+
+    // Decodes count frames of a channel, starting at frame, into destination
+    void read(int channel, int frame, int count, float * destination) const;
+
+    // Reads the pages of mapped frames in, so that playing them doesn't wait on the disk.
+    // Storage held in memory is already resident, and is left alone. Blocks while the
+    // pages are read, and so is for a background thread.
+    void prefetch(int frame, int count) const;
+
+    // Decodes the whole sound into a new bus
+    std::unique_ptr<AudioBus> createBus() const;
+
+private:
+    SampleStorage(Format format, int channels, int length, float sampleRate);
+
+    static std::shared_ptr<SampleStorage> mapFrames(const std::string & path, Format format, int channels,
+                                                    float sampleRate, uint64_t dataOffset, uint64_t frames);
+
+    // the first sample of a channel, and the samples from one frame to the next
+    const uint8_t * samples(int channel) const;
+    int stride() const { return m_file ? numberOfChannels() : 1; }
+
+    Format m_format;
+    int m_length;
+    float m_sampleRate;
+    std::vector<std::vector<uint8_t>> m_channels;  // each empty when mapped
+    std::shared_ptr<MappedFile> m_file;
+    const uint8_t * m_mapped = nullptr;            // the first frame, in m_file
+};
+
+}  // namespace lab
+
+#endif  // SampleStorage_h
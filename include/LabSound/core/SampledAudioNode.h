@@ -18,14 +18,49 @@ class AudioBus;
 class AudioParam;
 class ContextRenderLock;
 class SampledAudioNode;
-struct SRC_Resampler;
+class SampleStorage;
 
 // SampledAudioNode is intended for in-memory sounds. It provides a high degree of scheduling 
 // flexibility (can playback in rhythmically exact ways).
+//
+// The sound may be an AudioBus, or a SampleStorage holding the sound in a compact form
+// that is converted to float as it plays.
+//
+// When the sound plays at another rate than the context's, it is interpolated. Linear is
+// the cheapest; cubic is smoother for a little more, and sinc, a 16 tap windowed sinc
+// from precomputed tables, is the most accurate. A playing sound keeps only its position,
+// so voices are cheap to start at any pitch.
+//
+// With a time stretch mode, playbackRate changes the tempo alone, and detune, doppler and a
+// voice's pitch change the pitch alone. Speech is stretched by WSOLA, which keeps voices
+// clear, and Music by a phase vocoder, which keeps chords in tune. Each stretched play holds
+// a stretcher from a pool the node keeps, so once the pool has grown to the plays at once,
+// plays start without allocating.
+//
+// When a play of mapped storage is scheduled, the pages of its first second are read in on
+// a background job, so that its first quanta don't wait on the disk on the audio thread.
 
 
 class SampledAudioNode final : public AudioScheduledSourceNode
 {
+public:
+    enum InterpolationMode
+    {
+        LINEAR = 0,
+        CUBIC = 1,
+        SINC = 2,
+        _Count = 3
+    };
+
+    enum class TimeStretchMode
+    {
+        Off = 0,
+        Speech = 1,
+        Music = 2,
+        _Count = 3
+    };
+
+private:
     virtual void reset(ContextRenderLock& r) override {}
     virtual double tailTime(ContextRenderLock& r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock& r) const override { return 0; }
@@ -35,20 +70,34 @@ class SampledAudioNode final : public AudioScheduledSourceNode
     struct Internals;
     Internals* _internals;
 
-    std::shared_ptr<AudioBus> m_pendingSourceBus;   // the most recently assigned bus
-    std::shared_ptr<AudioBus> m_retainedSourceBus;  // the bus used in computation, eventually agrees with m_pendingSourceBus.
+    std::shared_ptr<const AudioBus> m_pendingSourceBus;   // the most recently assigned bus
+    std::shared_ptr<const AudioBus> m_retainedSourceBus;  // the bus used in computation, eventually agrees with m_pendingSourceBus.
+    std::shared_ptr<SampleStorage> m_pendingStorage;   // as for the buses, when playing from compact storage
+    std::shared_ptr<SampleStorage> m_retainedStorage;
     std::shared_ptr<AudioParam> m_playbackRate;
     std::shared_ptr<AudioParam> m_detune;
     std::shared_ptr<AudioParam> m_dopplerRate;
     std::shared_ptr<AudioSetting> m_sourceBus;
 
-    std::vector<std::shared_ptr<SRC_Resampler>> _resamplers;
+    std::shared_ptr<AudioSetting> m_interpolation;
+    std::shared_ptr<AudioSetting> m_timeStretch;
+
+    std::vector<std::vector<float>> _decoded; // per channel source samples, decoded or gathered for interpolation
+
+    // the length and sample rate of the most recently assigned bus or storage
+    bool pendingSource(int32_t & length, float & sampleRate) const;
+
+    // reads the start of a play of mapped storage in, ahead of the audio thread
+    void prefetch(int32_t grainStart, int32_t grainEnd, float pitch = 1.f);
 
     // totalPitchRate() returns the instantaneous pitch rate (non-time preserving).
     // It incorporates the base pitch rate, any sample-rate conversion factor from the buffer, 
-    // and any doppler shift from an associated panner node.
-    float totalPitchRate(ContextRenderLock&);
-    bool renderSample(ContextRenderLock& r, Scheduled&, size_t destinationSampleOffset, size_t frameSize);
+    // and any doppler shift from an associated panner node. Given a tempo, the base pitch
+    // rate is left out of the pitch, and the tempo is the source frames per output frame.
+    float totalPitchRate(ContextRenderLock&, float * tempo = nullptr);
+    bool renderSample(ContextRenderLock& r, Scheduled&, size_t destinationSampleOffset, size_t frameSize, float rate);
+    void renderStretched(ContextRenderLock& r, Scheduled&, size_t destinationSampleOffset, size_t frameSize,
+                         TimeStretchMode mode, float tempo, float pitch);
 
     virtual void process(ContextRenderLock&, int framesToProcess) override;
 
@@ -65,9 +114,13 @@ public:
     // recent set request in order that the interface work in a predictable way.
     // In the future, setBus and getBus could be deprecated in favor of another
     // schedule method that takes a source bus as an argument.
-    void setBus(ContextRenderLock&, std::shared_ptr<AudioBus> sourceBus); // deprecated
-    void setBus(std::shared_ptr<AudioBus> sourceBus);
-    std::shared_ptr<AudioBus> getBus() const { return m_pendingSourceBus; }
+    void setBus(ContextRenderLock&, std::shared_ptr<const AudioBus> sourceBus); // deprecated
+    void setBus(std::shared_ptr<const AudioBus> sourceBus);
+    std::shared_ptr<const AudioBus> getBus() const { return m_pendingSourceBus; }
+
+    // plays from compact storage instead of a bus. Setting either replaces the other.
+    void setStorage(std::shared_ptr<SampleStorage> storage);
+    std::shared_ptr<SampleStorage> getStorage() const { return m_pendingStorage; }
 
     // loopCount of -1 will loop forever
     // all the schedule routines will call start(0) if necessary, so that a
@@ -79,6 +132,12 @@ public:
     void schedule(float relative_when, float grainOffset, int loopCount);
     void schedule(float relative_when, float grainOffset, float grainDuration, int loopCount);
 
+    // Schedules a play of the whole sound with a gain and pitch of its own, the pitch as a
+    // multiple of the node's, so that overlapping plays of one sound, such as footsteps, can
+    // vary without a node each. At most 64 plays are kept; a play beyond them replaces the
+    // one that began earliest.
+    void scheduleVoice(float relative_when, float gain, float pitch, int loopCount = 0);
+
     // note: start is not virtual. start on the ScheduledAudioNode is relative,
     // but start here is in absolute time.
     void start(float abs_when);
@@ -93,6 +152,13 @@ public:
     std::shared_ptr<AudioParam> detune() { return m_detune; }
     std::shared_ptr<AudioParam> dopplerRate() { return m_dopplerRate; }
 
+    InterpolationMode interpolation() const;
+    void setInterpolation(InterpolationMode mode);
+
+    // Off by default, when playbackRate changes the pitch along with the tempo
+    TimeStretchMode timeStretch() const;
+    void setTimeStretch(TimeStretchMode mode);
+
     // returns the greatest sample index played back by any of the scheduled
     // instances in the most recent render quantum. A value less than zero
     // indicates nothing's playing.
@@ -0,0 +1,118 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef SpatialScene_h
+#define SpatialScene_h
+
+#include "LabSound/core/FloatPoint3D.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class ContextRenderLock;
+class PannerNode;
+
+// A source's transform, as SpatialScene::update takes them packed
+struct SpatialTransform
+{
+    FloatPoint3D position;
+    FloatPoint3D orientation;
+    FloatPoint3D velocity;
+};
+
+// The transforms of the context's moving sources, set all at once. A panner added to the
+// scene is given a slot, and from then on takes its position, orientation and velocity from
+// the scene rather than from its nine parameters, so that moving thousands of emitters a
+// frame costs one copy into the scene's arrays and one commit, rather than nine parameter
+// writes, each with its own smoothing, per emitter.
+//
+// The transforms are arrays of each coordinate indexed by slot, triple buffered: the main
+// thread edits one, commit() publishes it, and the render thread takes the latest published
+// once at the start of each quantum, so that every panner in a quantum hears the same
+// update. A panner hears its slot from the first quantum after the commit following add().
+class SpatialScene
+{
+public:
+    enum Coordinate : int
+    {
+        PositionX = 0, PositionY, PositionZ,
+        OrientationX, OrientationY, OrientationZ,
+        VelocityX, VelocityY, VelocityZ,
+        CoordinateCount
+    };
+
+    SpatialScene();
+    ~SpatialScene();
+
+    // Main thread. Binds the panner to a slot, and returns it, or the slot it already has. The
+    // slot starts from the panner's parameters. The slots of removed panners, and of panners
+    // since destroyed, are reused.
+    int add(std::shared_ptr<PannerNode> panner);
+
+    // Main thread. Returns the panner to its parameters, and frees its slot.
+    void remove(const std::shared_ptr<PannerNode> & panner);
+
+    // One more than the highest slot handed out, the length of the arrays
+    int slots() const { return static_cast<int>(m_panners.size()); }
+
+    // Main thread. The array of a coordinate, slots() long, to write the next update into. The
+    // arrays hold the transforms last committed until they are written.
+    float * edit(Coordinate coordinate);
+
+    // Main thread. Publishes the edited transforms, which the render thread takes at the start
+    // of the next quantum.
+    void commit();
+
+    // Main thread. Writes count packed transforms, to slots 0 on, then commits.
+    void update(const SpatialTransform * transforms, int count);
+
+    // Main thread. A slot's transform as last committed.
+    SpatialTransform transform(int slot) const;
+
+    // Render thread. Takes the latest committed transforms, once a quantum, before the graph renders.
+    void latch(ContextRenderLock & r);
+
+    // Render thread. The transform of the panner's slot in the quantum's transforms, if the
+    // panner is bound to it.
+    bool transform(const PannerNode * panner, int slot, SpatialTransform & out) const;
+
+private:
+    struct Frame
+    {
+        std::vector<float> values;                  // each coordinate's array of capacity slots in turn
+        std::vector<const PannerNode *> owners;     // the panner bound to each slot
+    };
+
+    // The frames are replaced, not resized, as the scene grows, so that the render thread
+    // reading the old ones is undisturbed. It reads the first frame of new ones first.
+    struct Frames
+    {
+        explicit Frames(int capacity);
+        int capacity;
+        Frame frames[3];
+        std::atomic<int> ready;                     // the frame last published, and Fresh until it is taken
+    };
+
+    static const int Fresh = 4;
+
+    Frame & writing() { return m_frames->frames[m_writing]; }
+    void grow(int capacity);
+
+    // main thread
+    std::shared_ptr<Frames> m_frames;
+    int m_writing = 0;
+    int m_published = 0;
+    std::vector<std::weak_ptr<PannerNode>> m_panners;
+
+    // render thread
+    std::shared_ptr<Frames> m_rendering;
+    int m_reading = 0;
+};
+
+}  // namespace lab
+
+#endif  // SpatialScene_h
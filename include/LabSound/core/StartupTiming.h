@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_STARTUP_TIMING_H
+#define LABSOUND_STARTUP_TIMING_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+struct StartupPhase
+{
+    std::string name;
+    double startMilliseconds = 0;     // since LabSound was loaded
+    double durationMilliseconds = 0;  // zero for a mark, such as the first quantum rendered
+};
+
+// StartupTiming records how long each of the phases of bringing up LabSound takes, on
+// whichever thread it runs: registering the node types, making the device backend's context,
+// enumerating devices, opening and starting a device, loading the HRTF database, and
+// rendering a realtime context's first quantum. Reading the phases shows where the time to
+// first audio goes, and which phases ran alongside one another. Those that needn't hold up
+// the first quantum can be started early, on the job system, with NodeRegistry::Prewarm and
+// the device backend's Prewarm.
+//
+// Recording takes no lock and doesn't allocate, so that the audio thread may mark its first
+// quantum. The first Capacity phases are kept; later ones are dropped.
+class StartupTiming
+{
+public:
+    static constexpr int Capacity = 64;
+
+    // Names must outlive the process, as string literals do
+    static void record(const char * name, int64_t begin, int64_t end);
+    static void mark(const char * name);
+    static int64_t now();  // nanoseconds, on RenderTrace's clock
+
+    // The phases recorded, in the order they began
+    static std::vector<StartupPhase> phases();
+    static std::string report();
+};
+
+// Records the span of a scope as a startup phase
+class StartupPhaseScope
+{
+public:
+    explicit StartupPhaseScope(const char * name) : _name(name), _begin(StartupTiming::now()) {}
+    ~StartupPhaseScope() { StartupTiming::record(_name, _begin, StartupTiming::now()); }
+
+    StartupPhaseScope(const StartupPhaseScope &) = delete;
+    StartupPhaseScope & operator=(const StartupPhaseScope &) = delete;
+
+private:
+    const char * _name;
+    int64_t _begin;
+};
+
+}  // lab
+
+#endif  // LABSOUND_STARTUP_TIMING_H
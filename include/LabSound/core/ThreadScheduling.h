@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_THREAD_SCHEDULING_H
+#define LABSOUND_THREAD_SCHEDULING_H
+
+#include <vector>
+
+namespace lab
+{
+
+enum class ThreadPriority
+{
+    Normal = 0,  // as the system schedules any thread
+    High,        // above normal threads, but not realtime
+    Realtime     // SCHED_FIFO on Linux, MMCSS "Pro Audio" on Windows, time constraint on Apple platforms
+};
+
+// How a thread that LabSound starts is scheduled. Realtime priority generally needs a
+// privilege, such as an rtprio limit on Linux; a request that is refused leaves the thread
+// as it was, and is logged.
+struct ThreadScheduling
+{
+    ThreadPriority priority = ThreadPriority::Normal;
+
+    // the processors the thread may run on; empty leaves it to the system. Apple platforms
+    // don't support affinity.
+    std::vector<int> cpus;
+
+    // Apple platforms: the interval, in seconds, at which a realtime thread has work, such
+    // as the render quantum, from which its time constraint is budgeted
+    double period = 0;
+
+    // Apple platforms: an os_workgroup_t for a realtime thread to join, such as the audio
+    // device's, so that the system schedules it with the device's deadline. It must outlive
+    // the thread's membership.
+    void * workgroup = nullptr;
+};
+
+// Applies scheduling to the calling thread while it lives, as far as the platform and the
+// process's privileges allow. Destroyed on the same thread, it restores the thread's priority
+// and leaves the workgroup; the affinity is kept.
+class ScopedThreadScheduling
+{
+public:
+    explicit ScopedThreadScheduling(const ThreadScheduling & scheduling);
+    ~ScopedThreadScheduling();
+
+    ScopedThreadScheduling(const ScopedThreadScheduling &) = delete;
+    ScopedThreadScheduling & operator=(const ScopedThreadScheduling &) = delete;
+
+    // false if any part of the scheduling was refused
+    bool applied() const { return _applied; }
+
+private:
+    bool _applied = true;
+    int _previousPolicy = 0;
+    int _previousPriority = 0;
+    bool _priorityChanged = false;
+    void * _handle = nullptr;     // Windows: the MMCSS task
+    void * _workgroup = nullptr;  // Apple: the workgroup joined, and its join token
+    void * _joinToken = nullptr;
+};
+
+}  // lab
+
+#endif  // LABSOUND_THREAD_SCHEDULING_H
@@ -7,7 +7,9 @@
 
 #include "LabSound/core/AudioNode.h"
 #include <atomic>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace lab {
 enum OverSampleType
@@ -15,9 +17,21 @@ enum OverSampleType
     NONE = 0,
     _2X = 1,
     _4X = 2,
+    _8X = 3,
     _OverSampleTypeCount
 };
 
+// The oversampling filters trade latency for how flat the band is and how far the
+// images of the shaped signal are attenuated
+enum class OverSampleQuality
+{
+    Low = 0,
+    Medium = 1,
+    High = 2
+};
+
+class Oversampler;
+
 class WaveShaperNode : public AudioNode
 {
 public:
@@ -29,10 +43,16 @@ public:
     virtual const char* name() const override { return static_name(); }
     static AudioNodeDescriptor * desc();
 
-    // copies the curve
+    // copies the curve, which is interpolated linearly between its points
     void setCurve(std::vector<float> & curve);
+
+    // Shapes by the polynomial c[0] + c[1] x + c[2] x^2 ..., of the input clamped to -1 to 1,
+    // evaluated directly rather than through a curve. Replaces any curve.
+    void setPolynomial(const std::vector<float> & coefficients);
     void setOversample(OverSampleType oversample) { m_oversample = oversample; }
     OverSampleType oversample() const { return m_oversample; }
+    void setOversampleQuality(OverSampleQuality quality) { m_oversampleQuality = quality; }
+    OverSampleQuality oversampleQuality() const { return m_oversampleQuality; }
 
     // AudioNode
     virtual void process(ContextRenderLock &, int bufferSize) override;
@@ -41,21 +61,27 @@ public:
 protected:
     void processCurve(const float * source, float * destination, int framesToProcess);
     virtual double tailTime(ContextRenderLock& r) const override { return 0.; }
-    virtual double latencyTime(ContextRenderLock& r) const override { return 0.; }
+    virtual double latencyTime(ContextRenderLock& r) const override;
 
     std::mutex _curveMutex;
     
-    std::vector<float> m_curve;
-    std::vector<float> m_newCurve;
+    // A curve point carries the slope to the next, so that interpolating costs one lookup
+    struct CurvePoint
+    {
+        float value;
+        float slope;
+    };
+
+    std::vector<CurvePoint> m_curve;
+    std::vector<CurvePoint> m_newCurve;
+    std::vector<float> m_polynomial;
+    std::vector<float> m_newPolynomial;
     std::atomic<int> _newCurveReady{0};
 
-    // Oversampling.
-    void * m_oversamplingArrays = nullptr;
+    // Oversampling, one oversampler per channel, rebuilt when the type or quality changes
+    std::vector<std::unique_ptr<Oversampler>> m_oversamplers;
     std::atomic<OverSampleType> m_oversample{OverSampleType::NONE};
-
-    // Use up-sampling, process at the higher sample-rate, then down-sample.
-    void processCurve2x(const float * source, float * dest, int framesToProcess);
-    void processCurve4x(const float * source, float * dest, int framesToProcess);
+    std::atomic<OverSampleQuality> m_oversampleQuality{OverSampleQuality::Medium};
 };
 
 }  // namespace lab
@@ -92,173 +92,14 @@ namespace detail
     }
 }
 
-// Reference https://github.com/spurious/snd-mirror/blob/master/clm.c
-inline void ApplyWindowFunctionInplace(const WindowFunction type, float * buffer, const int window_size)
-{
-    const float max_index = static_cast<float>(window_size) - 1.f;
-
-    switch (type)
-    {
-        case WindowFunction::rectangle:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] = 1.f;  // or * 0.5f?
-            }
-        }
-        break;
-
-        case WindowFunction::cosine:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= std::sin((static_cast<float>(LAB_PI) * i) / max_index);
-            }
-        }
-        break;
-
-        case WindowFunction::hann:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_1(max_index, i, 0.5f, 0.5f);
-            }
-        }
-        break;
-
-        case WindowFunction::hamming:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_1(max_index, i, 0.54f, 0.46f);
-            }
-        }
-        break;
-
-        case WindowFunction::blackman:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_2(max_index, i, 0.42f, 0.50f, 0.08f);
-            }
-        }
-        break;
-
-        case WindowFunction::nutall:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_3(max_index, i, 0.355768f, 0.487396f, 0.144232f, 0.012604f);
-            }
-        }
-        break;
-
-        case WindowFunction::blackman_harris:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_3(max_index, i, 0.35875f, 0.48829f, 0.14128f, 0.01168f);
-            }
-        }
-        break;
-
-        case WindowFunction::blackman_nutall:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_3(max_index, i, 0.3635819f, 0.4891775f, 0.1365995f, 0.0106411f);
-            }
-        }
-        break;
-
-        case WindowFunction::hann_poisson:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                const float alpha = 2.f;
-                const float a = 1.f - std::cos((static_cast<float>(LAB_TAU) * i) / max_index);
-                const float b = (-alpha * std::abs(max_index - 2.f * i)) / max_index;
-                buffer[i] *= 0.5f * a * exp(b);
-            }
-        }
-        break;
-
-        case WindowFunction::gaussian50:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gaussian(max_index, i, 0.50f);
-            }
-        }
-        break;
-
-        case WindowFunction::gaussian25:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gaussian(max_index, i, 0.25f);
-            }
-        }
-        break;
-
-        case WindowFunction::welch:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                const float num = i - (max_index * 0.5f);
-                const float denom = (window_size + 1.f) * 0.5f;
-                const float fract = num / denom;
-                buffer[i] *= 1.f - fract * fract;
-            }
-        }
-        break;
-
-        case WindowFunction::bartlett:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= 2.f / (window_size - 1.f) * (max_index / 2.f - std::abs(i - max_index / 2.f));
-            }
-        }
-        break;
-
-        case WindowFunction::bartlett_hann:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_2(max_index, i, 0.63f, 0.48f, 0.38f);
-            }
-        }
-        break;
-
-        case WindowFunction::parzen:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= 1.f - abs((2.f * i - window_size) / (window_size + 1.f));
-            }
-        }
-        break;
-
-        case WindowFunction::flat_top:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::gen_cosine_4(max_index, i, 1.f, 1.93f, 1.29f, 0.388f, 0.028f);
-            }
-        }
-        break;
-
-        case WindowFunction::lanczos:
-        {
-            for (int i = 0; i < window_size; ++i)
-            {
-                buffer[i] *= detail::sinc(2.f * i / max_index - 1.f);
-            }
-        }
-        break;
-    }
-}
+// Returns the window of a type and size as a table of window_size values. Tables are
+// computed once per type and size, shared by every caller, and kept for the life of the
+// process, so the pointer never dangles. The first request for a table computes it under
+// a lock; later requests only look it up.
+const float * WindowFunctionTable(const WindowFunction type, const int window_size);
+
+// Multiplies the buffer by the window of the given type and size
+void ApplyWindowFunctionInplace(const WindowFunction type, float * buffer, const int window_size);
 
 }  // namespace lab
 
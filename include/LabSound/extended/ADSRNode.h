@@ -34,6 +34,7 @@ public:
     virtual void reset(ContextRenderLock&) override;
     virtual double tailTime(ContextRenderLock& r) const override { return 0.; }
     virtual double latencyTime(ContextRenderLock& r) const override { return 0.f; }
+    virtual bool propagatesSilence(ContextRenderLock& r) const override { return false; } // the envelope keeps time
 
     // gate is a two state signal. Changing the gate signal to one means that the attack/decay segment will start
     // If oneShot is false, sustainTime is ignored, and sustain is held until gain goes to zero.
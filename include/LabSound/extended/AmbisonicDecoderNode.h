@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef AMBISONIC_DECODER_NODE_H
+#define AMBISONIC_DECODER_NODE_H
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioNode.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lab
+{
+
+class AmbisonicRotation;
+class AudioBus;
+
+// AmbisonicDecoderNode plays a sound field, such as the sum of PannerNodes in the AMBISONIC
+// panning model, to the context's AudioListener. The field, of order 1 to 3 in ACN order with
+// SN3D normalization, is turned once a quantum from the world's frame to the listener's
+// orientation, then decoded either binaurally, through a fixed set of virtual speakers that
+// are convolved with the context's HRTF database, or to a layout of real speakers, one output
+// channel each. Either way the cost of decoding doesn't depend on how many sources are mixed
+// into the field; a context usually has one decoder.
+//
+// settings: order, decoderMode
+//
+class AmbisonicDecoderNode : public AudioNode
+{
+    std::shared_ptr<AudioSetting> m_order;
+    std::shared_ptr<AudioSetting> m_decoderMode;
+
+public:
+    enum DecoderMode
+    {
+        BINAURAL = 0,
+        SPEAKERS = 1,
+    };
+
+    // A speaker's direction, in degrees, as PannerNode reports them: azimuths turn clockwise
+    // from ahead, and elevations up from the horizon
+    struct Speaker
+    {
+        float azimuth;
+        float elevation;
+    };
+
+    AmbisonicDecoderNode(AudioContext & ac);
+    virtual ~AmbisonicDecoderNode();
+
+    static const char * static_name() { return "AmbisonicDecoder"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // The order of the field that is decoded, from 1 to 3. Channels beyond the order's are
+    // ignored, and missing ones are silent. The default is 1.
+    int order() const;
+    void setOrder(int order);
+
+    DecoderMode decoderMode() const;
+    void setDecoderMode(DecoderMode mode);
+
+    // The speakers of the SPEAKERS mode, in the order of the output's channels. The default
+    // layout is stereo, at 30 degrees either side.
+    void setSpeakers(const std::vector<Speaker> & speakers);
+    std::vector<Speaker> speakers() const;
+
+    // AudioNode
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    virtual double tailTime(ContextRenderLock & r) const override;
+    virtual double latencyTime(ContextRenderLock & r) const override;
+
+private:
+    struct VirtualSpeaker;
+
+    void updateDecoder(int order, DecoderMode mode);
+
+    mutable std::mutex m_speakerMutex;
+    std::vector<Speaker> m_speakers;
+    bool m_speakersChanged = true;
+
+    // render thread state
+    std::unique_ptr<AmbisonicRotation> m_rotation;
+    std::unique_ptr<AudioBus> m_field;
+    std::vector<double> m_decoder;  // outputs by channels
+    std::vector<Speaker> m_renderSpeakers;
+    std::vector<std::unique_ptr<VirtualSpeaker>> m_virtualSpeakers;
+    int m_decodedOrder = -1;
+    DecoderMode m_decodedMode = BINAURAL;
+    int m_silentFrames = 0;
+
+    AudioFloatArray m_feed;
+    AudioFloatArray m_tempL;
+    AudioFloatArray m_tempR;
+    float m_sampleRate;
+};
+
+}  // namespace lab
+
+#endif
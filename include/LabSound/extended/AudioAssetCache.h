@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_AUDIO_ASSET_CACHE_H
+#define LABSOUND_AUDIO_ASSET_CACHE_H
+
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+namespace lab
+{
+class AudioBus;
+
+// AudioAssetCache keeps files decoded, and resampled, so that a sound loaded again, such as
+// when a scene is revisited, is handed out rather than decoded once more. An asset is
+// identified by its path, its size and modification time, so that a file that has changed
+// is decoded afresh, and by how it was asked for: mixed to mono or not, and at what rate.
+//
+// The buses handed out are shared, by the cache and everyone who asked for the asset, and
+// must not be modified. Once the cache holds more than its memory budget, it releases the
+// assets used least recently, other than those pinned, until it fits; a bus released from
+// the cache lives on while anyone else holds it. Requests for an asset being decoded wait
+// for that decode rather than starting another.
+//
+// With a disk cache directory, converted audio is also written there, and read back in
+// place of decoding and resampling the file again, by this run or a later one.
+class AudioAssetCache
+{
+public:
+    struct Settings
+    {
+        size_t memoryBudget = 256 * 1024 * 1024;  // bytes of samples
+        std::string diskCachePath;                 // an existing directory, or empty for none
+    };
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;       // decoded, or read from the disk cache
+        uint64_t diskHits = 0;
+        uint64_t evictions = 0;
+        size_t memoryUsed = 0;     // bytes of samples held
+        size_t assets = 0;
+    };
+
+    AudioAssetCache();
+    explicit AudioAssetCache(const Settings & settings);
+    ~AudioAssetCache();
+
+    AudioAssetCache(const AudioAssetCache &) = delete;
+    AudioAssetCache & operator=(const AudioAssetCache &) = delete;
+
+    // Returns the file's audio, from the cache if it holds it. A targetSampleRate of zero
+    // keeps the file's rate. Returns null if the file can't be decoded.
+    std::shared_ptr<const AudioBus> get(const std::string & path, bool mixToMono, float targetSampleRate = 0.f);
+
+    // As get, and keeps the asset whatever the budget until it is unpinned as many times
+    std::shared_ptr<const AudioBus> pin(const std::string & path, bool mixToMono, float targetSampleRate = 0.f);
+    void unpin(const std::string & path, bool mixToMono, float targetSampleRate = 0.f);
+
+    // Releases an asset, pinned or not, or everything
+    void evict(const std::string & path, bool mixToMono, float targetSampleRate = 0.f);
+    void clear();
+
+    // Evicts assets as needed to fit a new budget
+    void setMemoryBudget(size_t bytes);
+    size_t memoryBudget() const;
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        uint64_t id = 0;      // distinguishes a reloaded asset from one evicted while it loaded
+        std::shared_future<std::shared_ptr<const AudioBus>> bus;
+        bool ready = false;   // decoded; only ready entries are counted and evicted
+        size_t bytes = 0;
+        int pins = 0;
+    };
+
+    std::shared_ptr<const AudioBus> acquire(const std::string & path, bool mixToMono, float targetSampleRate, bool pinned);
+    std::shared_ptr<const AudioBus> load(const std::string & path, const std::string & key, bool mixToMono, float targetSampleRate);
+    void trim();  // the lock is held
+
+    Settings m_settings;
+    Stats m_stats;
+    uint64_t m_nextId = 1;
+    std::list<Entry> m_entries;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    mutable std::mutex m_mutex;
+};
+
+}  // lab
+
+#endif  // LABSOUND_AUDIO_ASSET_CACHE_H
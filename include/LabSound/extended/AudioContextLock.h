@@ -15,18 +15,22 @@
 
 namespace lab {
 
+// The locks record who holds them as a tag, for diagnosing contention. A tag must be a
+// string literal, or otherwise outlive the lock, so that taking a lock never allocates;
+// a released lock's tag is null.
+
 class ContextGraphLock
 {
     AudioContext * m_context = nullptr;
 
 public:
-    ContextGraphLock(AudioContext * context, const std::string & lockSuitor)
+    ContextGraphLock(AudioContext * context, const char * lockSuitor)
     {
 #if defined(DEBUG_LOCKS)
-        bool reentrant = context->m_graphLocker.size() > 1 && context->m_graphLocker.back() != '~';
-        if (reentrant)
+        const char * holder = context ? context->m_graphLocker.load(std::memory_order_relaxed) : nullptr;
+        if (holder)
         {
-            LOG_ERROR("%s cannot acquire an AudioContext ContextGraphLock. Currently held by: %s.", lockSuitor.c_str(), context->m_graphLocker.c_str());
+            LOG_ERROR("%s cannot acquire an AudioContext ContextGraphLock. Currently held by: %s.", lockSuitor, holder);
         }
 #endif
 
@@ -34,7 +38,17 @@ public:
         {
             context->m_graphLock.lock();
             m_context = context;
-            m_context->m_graphLocker = lockSuitor;
+            m_context->m_graphLocker.store(lockSuitor, std::memory_order_relaxed);
+        }
+    }
+
+    // Acquires the lock only if no one else holds it; otherwise context() is null.
+    ContextGraphLock(AudioContext * context, const char * lockSuitor, std::try_to_lock_t)
+    {
+        if (context && context->m_graphLock.try_lock())
+        {
+            m_context = context;
+            m_context->m_graphLocker.store(lockSuitor, std::memory_order_relaxed);
         }
     }
 
@@ -42,7 +56,7 @@ public:
     {
         if (m_context)
         {
-            m_context->m_graphLocker += '~';
+            m_context->m_graphLocker.store(nullptr, std::memory_order_relaxed);
             m_context->m_graphLock.unlock();
         }
     }
@@ -55,13 +69,13 @@ class ContextRenderLock
     AudioContext * m_context = nullptr;
 
 public:
-    ContextRenderLock(AudioContext * context, const std::string & lockSuitor)
+    ContextRenderLock(AudioContext * context, const char * lockSuitor)
     {
 #if defined(DEBUG_LOCKS)
-        bool reentrant = context->m_graphLocker.size() > 1 && context->m_graphLocker.back() != '~';
-        if (reentrant)
+        const char * holder = context ? context->m_renderLocker.load(std::memory_order_relaxed) : nullptr;
+        if (holder)
         {
-            LOG_ERROR("%s cannot acquire an AudioContext ContextGraphLock. Currently held by: %s.", lockSuitor.c_str(), context->m_graphLocker.c_str());
+            LOG_ERROR("%s cannot acquire an AudioContext ContextRenderLock. Currently held by: %s.", lockSuitor, holder);
         }
 #endif
 
@@ -69,15 +83,31 @@ public:
         {
             context->m_renderLock.lock();
             m_context = context;
-            m_context->m_renderLocker = lockSuitor;
+            m_context->m_renderLocker.store(lockSuitor, std::memory_order_relaxed);
+        }
+    }
+
+    // Acquires the lock only if no one else holds it; otherwise context() is null, and the
+    // context counts the miss, so that the audio callback can render silence rather than wait.
+    ContextRenderLock(AudioContext * context, const char * lockSuitor, std::try_to_lock_t)
+    {
+        if (!context)
+            return;
+
+        if (context->m_renderLock.try_lock())
+        {
+            m_context = context;
+            m_context->m_renderLocker.store(lockSuitor, std::memory_order_relaxed);
         }
+        else
+            context->m_renderLockMisses.fetch_add(1, std::memory_order_relaxed);
     }
 
     ~ContextRenderLock()
     {
         if (m_context)
         {
-            m_context->m_renderLocker += '~';
+            m_context->m_renderLocker.store(nullptr, std::memory_order_relaxed);
             m_context->m_renderLock.unlock();
         }
     }
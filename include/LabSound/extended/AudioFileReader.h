@@ -7,7 +7,12 @@
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/extended/AudioContextLock.h"
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -31,6 +36,58 @@ std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer,
 
 // Loads and decodes a raw binary memory chunk where the file extension (mp3, wav, ogg, etc) is aleady known.
 std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer, const std::string & extension, bool mixToMono);
+
+
+// AudioFileLoader decodes, and optionally resamples, files as jobs on the shared JobSystem,
+// so that loading many sounds doesn't stall the thread that asks for them.
+// Requests with a higher priority are decoded first, and equal priorities in the order
+// they were made. A request can be cancelled until its decoding starts; destroying the
+// loader cancels everything still queued and waits for the decodes in progress.
+class AudioFileLoader
+{
+public:
+    // Called when a request completes, on the job system thread that decoded it, or on the
+    // thread that cancelled it; the bus is empty if the request failed or was cancelled
+    typedef std::function<void(std::shared_ptr<AudioBus>)> Callback;
+
+    struct Load
+    {
+        uint64_t id = 0;
+        std::shared_future<std::shared_ptr<AudioBus>> bus;
+    };
+
+    // At most threadCount files are decoded at once; zero allows one per job system worker
+    explicit AudioFileLoader(int threadCount = 0);
+    ~AudioFileLoader();
+
+    // Queues a file to decode. A targetSampleRate of zero keeps the file's rate.
+    Load load(const std::string & path, bool mixToMono, float targetSampleRate = 0.f,
+              int priority = 0, Callback onLoaded = {});
+
+    // Queues an encoded buffer to decode; extension names its format (mp3, wav, ogg, etc)
+    Load load(std::vector<uint8_t> buffer, const std::string & extension, bool mixToMono, float targetSampleRate = 0.f,
+              int priority = 0, Callback onLoaded = {});
+
+    // Returns false if the request has already started decoding, or is unknown
+    bool cancel(uint64_t id);
+    void cancelAll();
+
+    // requests that have not started decoding
+    size_t queued() const;
+
+private:
+    struct Request;
+
+    Load enqueue(std::unique_ptr<Request> request, int priority);
+    void decodeJob();  // decodes requests until the queue is empty
+
+    // ordered by descending priority, then by id
+    std::map<std::pair<int, uint64_t>, std::unique_ptr<Request>> m_queue;
+    mutable std::mutex m_mutex;
+    uint64_t m_nextId = 1;
+    int m_threadCount;
+    std::atomic<int> m_jobs {0};  // decode jobs queued or running; written under m_mutex
+};
 }
 
 #endif
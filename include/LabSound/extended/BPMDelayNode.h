@@ -13,15 +13,20 @@
 
 namespace lab
 {
+// A delay of a note's length at a tempo. Synced to the context's tempo, it follows the
+// context's ModulationBus, as every tempo-synced effect in the mix may, rather than each
+// being told of tempo changes.
 class BPMDelay : public DelayNode
 {
     float tempo;
     int noteDivision;
     std::vector<float> times;
+    bool syncToContext = false;
 
+    // times are in beats, a quarter note being one
     void recomputeDelay()
     {
-        float dT = float(60.0f * noteDivision) / tempo;
+        float dT = float(60.0f * times[noteDivision]) / tempo;
         delayTime()->setFloat(dT);
     }
 
@@ -32,10 +37,16 @@ public:
     void SetTempo(float newTempo)
     {
         tempo = newTempo;
+        syncToContext = false;
         recomputeDelay();
     }
 
+    // Follows the context's tempo from the next quantum, until SetTempo is called
+    void SyncToContextTempo(bool sync) { syncToContext = sync; }
+
     void SetDelayIndex(TempoSync value);
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
 };
 }
 
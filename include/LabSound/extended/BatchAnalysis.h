@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_BATCH_ANALYSIS_H
+#define LABSOUND_BATCH_ANALYSIS_H
+
+#include <functional>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioBus;
+
+// The measurements of a file or a bus. The RMS level and sample peak are in dBFS, the
+// true peak in dBTP, and the loudnesses in LUFS, as LoudnessMeterNode measures them; all
+// are minus infinity for silence, and the integrated loudness is for anything shorter
+// than its 400 ms gating block too. The spectral statistics are of the mean of the
+// channels, found for each analysis frame and averaged over the frames weighted by
+// their energy: the centroid and spread in Hz, and the flatness, the ratio of the
+// spectrum's geometric mean to its arithmetic mean, from 0 for a tone to 1 for noise.
+struct AnalysisRecord
+{
+    std::string path;   // empty for a bus
+    bool ok = false;    // false if the file couldn't be read
+    float sampleRate = 0;
+    int channels = 0;
+    uint64_t frames = 0;
+
+    float rms = -std::numeric_limits<float>::infinity();
+    float samplePeak = -std::numeric_limits<float>::infinity();
+    float truePeak = -std::numeric_limits<float>::infinity();
+    float integratedLoudness = -std::numeric_limits<float>::infinity();
+    float maxMomentaryLoudness = -std::numeric_limits<float>::infinity();
+    float maxShortTermLoudness = -std::numeric_limits<float>::infinity();
+
+    float spectralCentroid = 0;
+    float spectralSpread = 0;
+    float spectralFlatness = 0;
+};
+
+struct BatchAnalysisSettings
+{
+    bool loudness = true;  // the loudnesses and the true peak, which cost the most
+    bool spectrum = true;
+    int fftSize = 2048;    // a power of two; frames are analysed end to end, the last zero padded
+    int threadCount = 0;   // files analysed at once; zero allows one per job system worker
+};
+
+// BatchAnalysis measures many files at once on the shared JobSystem, without an offline
+// context or a graph. Each file is passed through the analysis kernels once, a chunk at a
+// time: uncompressed WAV files are streamed from disk, so that a long one needs no more
+// memory than a short one, and other formats are decoded whole first. The loudness is
+// measured by the filters of LoudnessMeterNode, and levels and spectra by SIMD kernels.
+class BatchAnalysis
+{
+public:
+    // Called as each file's record completes, on the thread that analysed it
+    typedef std::function<void(size_t index, const AnalysisRecord & record)> Callback;
+
+    // A record per path, in order. Returns once every file has been analysed; the calling
+    // thread helps with the work meanwhile.
+    static std::vector<AnalysisRecord> analyzeFiles(const std::vector<std::string> & paths,
+                                                    const BatchAnalysisSettings & settings = {},
+                                                    Callback onRecord = {});
+
+    static AnalysisRecord analyzeFile(const std::string & path, const BatchAnalysisSettings & settings = {});
+    static AnalysisRecord analyzeBus(const AudioBus & bus, const BatchAnalysisSettings & settings = {});
+};
+
+}  // lab
+
+#endif  // LABSOUND_BATCH_ANALYSIS_H
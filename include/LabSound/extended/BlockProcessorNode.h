@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef BLOCK_PROCESSOR_NODE_H
+#define BLOCK_PROCESSOR_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioParamDescriptor.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioBus;
+
+// Everything a block processor sees of one render quantum: the summed signal at each
+// input, which is silent if nothing is connected, the busses of each output, which are
+// zeroed beforehand, and the values of each of the node's params over the quantum.
+struct ProcessBlock
+{
+    int frames = 0;
+    double time = 0;        // of the quantum's first frame, in seconds
+    float sampleRate = 0;
+
+    int numberOfInputs = 0;
+    int numberOfOutputs = 0;
+    int numberOfParams = 0;
+    const AudioBus * const * inputs = nullptr;
+    AudioBus * const * outputs = nullptr;
+    const AudioParamBlock * params = nullptr;
+};
+
+// The DSP of a BlockProcessorNode, in the manner of a Web Audio AudioWorkletProcessor. All
+// channels of all inputs and outputs are processed in one call, so that work can be shared
+// across them. The processor's members are its state: prepare() is called on the main
+// thread before the node first renders, to allocate whatever process() will need, so that
+// process() needn't allocate or lock.
+class BlockProcessor
+{
+public:
+    virtual ~BlockProcessor() = default;
+
+    // Main thread, once
+    virtual void prepare(float sampleRate, int maxFrames) {}
+
+    // Audio thread. Returning false stops the processor, and the node is silent from then on.
+    virtual bool process(ContextRenderLock & r, const ProcessBlock & block) = 0;
+
+    virtual void reset() {}
+    virtual double tailTime() const { return 0; }
+    virtual double latencyTime() const { return 0; }
+};
+
+// The descriptor of a BlockProcessorNode's params, which must outlive the params, and so
+// is held by a base that is constructed before the node's AudioNode
+struct BlockProcessorNodeStorage
+{
+    explicit BlockProcessorNodeStorage(const std::vector<AudioParamDescriptor> & params);
+
+    std::deque<std::string> names;  // a deque, so that the names don't move
+    std::vector<AudioParamDescriptor> params;  // ending with a null entry
+    AudioNodeDescriptor descriptor;
+};
+
+// BlockProcessorNode runs a BlockProcessor, with the inputs, outputs and params its layout
+// declares. To avoid the processor's virtual call as well, derive from BlockKernelNode,
+// which calls a kernel's process inline.
+class BlockProcessorNode : private BlockProcessorNodeStorage, public AudioNode
+{
+public:
+    struct Layout
+    {
+        int inputs = 1;
+        std::vector<int> outputChannels = {1};  // an output of each channel count
+        std::vector<AudioParamDescriptor> params;  // names are copied
+    };
+
+    BlockProcessorNode(AudioContext & ac);  // one input, one mono output, and silent
+    BlockProcessorNode(AudioContext & ac, const Layout & layout, std::unique_ptr<BlockProcessor> processor);
+    virtual ~BlockProcessorNode();
+
+    static const char * static_name() { return "BlockProcessor"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    BlockProcessor * processor() const { return _processor.get(); }
+
+    // false once the processor has asked to stop
+    bool isActive() const { return _active; }
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override;
+
+protected:
+    // For BlockKernelNode, which sets up its kernel rather than a processor
+    BlockProcessorNode(AudioContext & ac, const Layout & layout);
+
+    float blockSampleRate() const { return _sampleRate; }
+
+    virtual bool processBlock(ContextRenderLock & r, const ProcessBlock & block);
+    virtual void resetBlock();
+    virtual double blockTailTime() const { return _processor ? _processor->tailTime() : 0; }
+    virtual double blockLatencyTime() const { return _processor ? _processor->latencyTime() : 0; }
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override { return blockTailTime(); }
+    virtual double latencyTime(ContextRenderLock & r) const override { return blockLatencyTime(); }
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return !_active; }
+
+    void build(const Layout & layout);
+
+    std::unique_ptr<BlockProcessor> _processor;
+    float _sampleRate;
+    bool _active = true;
+
+    // preallocated for each quantum
+    std::vector<const AudioBus *> _inputBusses;
+    std::vector<AudioBus *> _outputBusses;
+    std::vector<AudioParamBlock> _paramBlocks;
+    std::vector<float> _paramValues;
+};
+
+// A BlockProcessorNode whose kernel is called directly. Kernel is any class with
+//
+//   bool process(ContextRenderLock &, const ProcessBlock &);
+//
+// and optionally the other members of BlockProcessor, which are called if present.
+template <typename Kernel>
+class BlockKernelNode : public BlockProcessorNode
+{
+public:
+    template <typename... Args>
+    BlockKernelNode(AudioContext & ac, const Layout & layout, Args &&... args)
+        : BlockProcessorNode(ac, layout)
+        , _kernel(std::forward<Args>(args)...)
+    {
+        prepareKernel(_kernel, blockSampleRate(), renderQuantumSize(), 0);
+    }
+
+    Kernel & kernel() { return _kernel; }
+
+protected:
+    virtual bool processBlock(ContextRenderLock & r, const ProcessBlock & block) override final
+    {
+        return _kernel.process(r, block);
+    }
+    virtual void resetBlock() override final { resetKernel(_kernel, 0); }
+
+private:
+    template <typename K>
+    static auto prepareKernel(K & k, float sr, int frames, int) -> decltype(k.prepare(sr, frames), void()) { k.prepare(sr, frames); }
+    template <typename K>
+    static void prepareKernel(K &, float, int, long) {}
+
+    template <typename K>
+    static auto resetKernel(K & k, int) -> decltype(k.reset(), void()) { k.reset(); }
+    template <typename K>
+    static void resetKernel(K &, long) {}
+
+    Kernel _kernel;
+};
+
+}  // lab
+
+#endif  // BLOCK_PROCESSOR_NODE_H
@@ -6,10 +6,12 @@
 
 #include "LabSound/core/AudioBasicProcessorNode.h"
 #include "LabSound/core/AudioParam.h"
+#include "LabSound/core/WaveShaperNode.h"
 
 namespace lab
 {
-// ClipNode clips a signal, using either thresholding or tanh
+// ClipNode clips a signal, using either thresholding or tanh. Either bends the signal
+// sharply enough to alias, which oversampling keeps out of the band, as for a WaveShaperNode.
 //
 // params: a, b
 // settings: mode
@@ -36,6 +38,11 @@ public:
 
     void setMode(Mode m);
 
+    void setOversample(OverSampleType oversample);
+    OverSampleType oversample() const;
+    void setOversampleQuality(OverSampleQuality quality);
+    OverSampleQuality oversampleQuality() const;
+
     // in CLIP mode, a is the min value, and b is the max value.
     // in TANH mode, a is the overall gain, and b is the input gain.
     // The higher the input gain the more severe the distortion.
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef EARLY_REFLECTIONS_NODE_H
+#define EARLY_REFLECTIONS_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/FloatPoint3D.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class EarlyReflections;
+class PannerNode;
+struct ShoeboxRoom;
+
+// EarlyReflectionsNode renders the early reflections of many sources in a box shaped room, and
+// mixes them to one stereo output, in place of a chain of DelayNode, GainNode and PannerNode
+// for every reflection of every source. Each input is a source, heard from its mirror images in
+// the walls: 6 of the first order, and 18 more of the second. Every image of every source is
+// placed, attenuated and panned in one batch each quantum, and every source is a multi-tap
+// delay line with a tap for each of its images.
+//
+// A source is placed with setPosition, or follows a PannerNode, whose position, or its slot in
+// the context's SpatialScene, it takes each quantum. The direct sound is not rendered; connect
+// the same signal to the source's PannerNode for that. The images are attenuated by the inverse
+// distance law, and panned as the equal-power panner pans.
+//
+// settings: order
+//
+class EarlyReflectionsNode : public AudioNode
+{
+    std::shared_ptr<AudioSetting> m_order;
+
+public:
+    EarlyReflectionsNode(AudioContext & ac, int numberOfInputs = 1);
+    virtual ~EarlyReflectionsNode();
+
+    static const char * static_name() { return "EarlyReflections"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // Adds n sources; inputs should be added before they are connected.
+    void addInputs(int n);
+
+    // The position of the source connected to input. Positions may be set from any thread, and
+    // take effect from the next render quantum.
+    void setPosition(int input, float x, float y, float z) { setPosition(input, FloatPoint3D(x, y, z)); }
+    void setPosition(int input, const FloatPoint3D & position);
+    FloatPoint3D position(int input) const;
+
+    // The source connected to input takes its position from panner until it is given a position,
+    // or another panner, or nullptr.
+    void follow(int input, std::shared_ptr<PannerNode> panner);
+
+    // The room's bounds. A source outside them is reflected as if it were at the nearest point
+    // inside. The default is 10 by 3 by 10 metres, with its floor at y = 0, centered on the origin.
+    void setRoom(const FloatPoint3D & minimum, const FloatPoint3D & maximum);
+
+    // The share of the energy a wall absorbs, from 0 to 1, default 0.36. The walls are numbered
+    // -x, +x, -y, +y, -z, +z; -y is the floor.
+    void setAbsorption(float absorption);
+    void setWallAbsorption(int wall, float absorption);
+
+    // 1 for the 6 first order images of each source, or 2 for 24, the default
+    int order() const;
+    void setOrder(int order);
+
+    // AudioNode
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    virtual double tailTime(ContextRenderLock & r) const override;
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+private:
+    struct Source;
+
+    void publishRoom();
+
+    std::vector<std::unique_ptr<Source>> m_sources;
+    std::unique_ptr<EarlyReflections> m_reflections;
+
+    // edited by the main thread, and published whole for the render thread
+    std::unique_ptr<ShoeboxRoom> m_room;
+    std::shared_ptr<const ShoeboxRoom> m_renderingRoom;
+
+    std::vector<FloatPoint3D> m_positions;
+    std::vector<const float *> m_inputs;
+};
+
+}  // namespace lab
+
+#endif
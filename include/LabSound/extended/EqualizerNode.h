@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef EQUALIZER_NODE_H
+#define EQUALIZER_NODE_H
+
+#include "LabSound/core/AudioBasicProcessorNode.h"
+
+#include <vector>
+
+namespace lab
+{
+
+// EqualizerNode filters every channel of its input through a cascade of biquad bands, as
+// a chain of BiquadFilterNodes would, but in a single node whose bands and channels are
+// filtered together. Changes to the bands are smoothed over a few quanta.
+//
+class EqualizerNode : public AudioBasicProcessorNode
+{
+    class EqualizerNodeInternal;
+    EqualizerNodeInternal * internalNode;
+
+public:
+    // frequency is in Hz, and gain is in dB; q and gain are used as BiquadFilterNode's are
+    // by each type of filter
+    struct Band
+    {
+        FilterType type;
+        float frequency;
+        float q;
+        float gain;
+    };
+
+    EqualizerNode(AudioContext & ac);
+    virtual ~EqualizerNode();
+
+    static const char * static_name() { return "Equalizer"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // The bands, in the order they are applied. There are none at first, and the node
+    // passes its input through.
+    void setBands(const std::vector<Band> & bands);
+    std::vector<Band> bands() const;
+
+    // Changes one of the bands; throws std::out_of_range if there is no such band
+    void setBand(int index, const Band & band);
+
+    // Get the magnitude and phase response of the bands' cascade at the given
+    // set of frequencies (in Hz). The phase response is in radians.
+    void getFrequencyResponse(const std::vector<float> & frequencyHz, std::vector<float> & magResponse, std::vector<float> & phaseResponse) const;
+};
+
+}  // namespace lab
+
+#endif
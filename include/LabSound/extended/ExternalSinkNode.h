@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef EXTERNAL_SINK_NODE_H
+#define EXTERNAL_SINK_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+// ExternalSinkNode passes its input through, and writes each quantum of it straight into
+// rings a client owns, one per channel, for the client to read from a thread of its own.
+// A quantum that doesn't fit in every ring is dropped whole, and counted, rather than
+// stalling the render thread. Input channels past the rings' count are ignored, and rings
+// past the input's are written silence. The node is the rings' only writer.
+//
+// A single AudioRingBuffer may be given instead, which publishes every channel of a
+// quantum at once, so that the client reads the channels together.
+//
+// Like a RecorderNode, the node only runs when pulled: connect it downstream, or add it to
+// the context's automatic pull nodes.
+class ExternalSinkNode : public AudioNode
+{
+public:
+    ExternalSinkNode(AudioContext & ac, std::vector<std::shared_ptr<RingBufferT<float>>> rings);
+    ExternalSinkNode(AudioContext & ac, std::shared_ptr<AudioRingBuffer> ring);
+    virtual ~ExternalSinkNode();
+
+    static const char* static_name() { return "ExternalSink"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override {}
+
+    const std::vector<std::shared_ptr<RingBufferT<float>>> & rings() const { return _rings; }
+    const std::shared_ptr<AudioRingBuffer> & ring() const { return _ring; }
+
+    // Frames dropped because the rings were full
+    uint64_t overflowFrames() const { return _overflowFrames.load(); }
+
+private:
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; } // silence is written too
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    std::vector<std::shared_ptr<RingBufferT<float>>> _rings;
+    std::shared_ptr<AudioRingBuffer> _ring;
+    std::vector<const float *> _channels;  // the ring's sources, one per channel
+    std::atomic<uint64_t> _overflowFrames {0};
+    std::vector<float> _silence;
+};
+
+}  // end namespace lab
+
+#endif
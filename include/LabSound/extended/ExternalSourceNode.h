@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef EXTERNAL_SOURCE_NODE_H
+#define EXTERNAL_SOURCE_NODE_H
+
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+// ExternalSourceNode plays audio that a client writes, from a thread of its own, into
+// rings it owns, one per channel. Each quantum is read from the rings straight into the
+// node's output, so that an engine feeding LabSound copies its audio once, into the rings,
+// rather than through a callback per channel. If the client falls behind, frames it hasn't
+// written yet play as silence, and are counted. The node is the rings' only reader.
+//
+// A single AudioRingBuffer may be given instead, which publishes every channel of a block
+// at once, so that the client needn't keep rings of its own in step.
+class ExternalSourceNode : public AudioScheduledSourceNode
+{
+public:
+    ExternalSourceNode(AudioContext & ac, std::vector<std::shared_ptr<RingBufferT<float>>> rings);
+    ExternalSourceNode(AudioContext & ac, std::shared_ptr<AudioRingBuffer> ring);
+    virtual ~ExternalSourceNode();
+
+    static const char* static_name() { return "ExternalSource"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override;
+
+    const std::vector<std::shared_ptr<RingBufferT<float>>> & rings() const { return _rings; }
+    const std::shared_ptr<AudioRingBuffer> & ring() const { return _ring; }
+
+    // Frames played as silence because the rings ran dry
+    uint64_t underrunFrames() const { return _underrunFrames.load(); }
+
+private:
+    virtual bool propagatesSilence(ContextRenderLock & r) const override;
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    std::vector<std::shared_ptr<RingBufferT<float>>> _rings;
+    std::shared_ptr<AudioRingBuffer> _ring;
+    std::vector<float *> _channels;  // the ring's destinations, one per channel
+    std::atomic<uint64_t> _underrunFrames {0};
+};
+
+}  // end namespace lab
+
+#endif
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_FDN_REVERB_NODE_H
+#define LABSOUND_FDN_REVERB_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+
+namespace lab
+{
+class FeedbackDelayNetwork;
+
+// FDNReverbNode is an algorithmic reverb, a feedback delay network of 8 or 16 lines, for
+// where a ConvolverNode costs too much: on many sends at once, or as the tier a convolution
+// reverb is shed to under load, by a LoadGovernor step that crossfades between the two. It
+// costs a fixed amount per frame whatever the decay, a small fraction of convolving with an
+// impulse response of the same length.
+//
+// The input's first two channels, or its one, feed the network, and the output is stereo.
+// The low band decays by 60 dB in decay seconds, and the band above dampingFrequency in
+// decay * damping seconds. The lines' read positions are swept by modulationDepth ms at
+// about modulationRate Hz, which keeps the tail from ringing.
+//
+// params: decay, damping, dampingFrequency, modulationDepth, modulationRate, dry, wet
+// settings: lines, size
+//
+class FDNReverbNode : public AudioNode
+{
+public:
+    FDNReverbNode(AudioContext & ac);
+    virtual ~FDNReverbNode();
+
+    static const char * static_name() { return "FDNReverb"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override;
+
+    // Seconds to fall 60 dB below dampingFrequency, default 2
+    std::shared_ptr<AudioParam> decay() const { return _decay; }
+
+    // The decay above dampingFrequency, as a share of decay, from 0.05 to 1, default 0.5
+    std::shared_ptr<AudioParam> damping() const { return _damping; }
+
+    // Hz, default 4000
+    std::shared_ptr<AudioParam> dampingFrequency() const { return _dampingFrequency; }
+
+    // The sweep of the lines' lengths, in ms up to 4, default 0.5, and its rate in Hz, default 0.5
+    std::shared_ptr<AudioParam> modulationDepth() const { return _modulationDepth; }
+    std::shared_ptr<AudioParam> modulationRate() const { return _modulationRate; }
+
+    // The gains of the input and of the reverberation, default 0 and 1, as for a send
+    std::shared_ptr<AudioParam> dry() const { return _dry; }
+    std::shared_ptr<AudioParam> wet() const { return _wet; }
+
+    // The number of delay lines, 8 or 16, default 8. Sixteen double the cost, for a denser tail.
+    std::shared_ptr<AudioSetting> lines() const { return _lines; }
+
+    // Scales the lines' lengths, which run from 20 to 80 ms at 1, from 0.25 to 4, default 1.
+    // Changing lines or size clears the reverberation.
+    std::shared_ptr<AudioSetting> size() const { return _size; }
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override;
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    std::shared_ptr<AudioParam> _decay;
+    std::shared_ptr<AudioParam> _damping;
+    std::shared_ptr<AudioParam> _dampingFrequency;
+    std::shared_ptr<AudioParam> _modulationDepth;
+    std::shared_ptr<AudioParam> _modulationRate;
+    std::shared_ptr<AudioParam> _dry;
+    std::shared_ptr<AudioParam> _wet;
+    std::shared_ptr<AudioSetting> _lines;
+    std::shared_ptr<AudioSetting> _size;
+
+    std::unique_ptr<FeedbackDelayNetwork> _network;
+};
+
+}  // namespace lab
+
+#endif  // LABSOUND_FDN_REVERB_NODE_H
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_FROZEN_SUBGRAPH_H
+#define LABSOUND_FROZEN_SUBGRAPH_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace lab
+{
+class AudioBus;
+class AudioContext;
+class AudioNode;
+class GainNode;
+class SampledAudioNode;
+
+// FrozenSubgraph renders a static signal chain once, offline, and plays the rendering in
+// its place, so that a chain that would render identically every pass costs no more than
+// sample playback ("bounce in place").
+//
+// The chain is described by a function that builds it in a given context, starts its
+// sources, and returns the node at its end. It is built live in the context the subgraph
+// belongs to, and again in an offline context when it is frozen; the offline copy takes
+// on the live chain's current param and setting values, and is rendered as a background
+// job on the shared JobSystem. Once the rendering is ready, update() swaps it in for the live chain. If any
+// param, setting or connection of the live chain changes afterwards, update() swaps the
+// live chain back in, and it stays live until it is frozen again.
+//
+// The live chain is found by walking back from its end node through the connections of
+// its inputs and params; freezing doesn't follow nodes that the chain feeds.
+class FrozenSubgraph
+{
+public:
+    using Builder = std::function<std::shared_ptr<AudioNode>(AudioContext &)>;
+
+    FrozenSubgraph(AudioContext & ac, Builder build, int channels = 2);
+    ~FrozenSubgraph();  // waits for a rendering in progress to finish
+
+    FrozenSubgraph(const FrozenSubgraph &) = delete;
+    FrozenSubgraph & operator=(const FrozenSubgraph &) = delete;
+
+    // The node to connect onward; it carries the live chain, or its rendering.
+    std::shared_ptr<AudioNode> output() const;
+
+    // The end of the live chain, through which its params may be changed.
+    std::shared_ptr<AudioNode> root() const { return _root; }
+
+    // Starts rendering the given length of the chain in the background, to be played
+    // once, or looped. Does nothing while a rendering is in progress.
+    void freeze(double seconds, bool loop = true);
+
+    // Swaps the rendering in once it is ready, or the live chain back in once it has
+    // changed. Call it regularly, from the thread that edits the graph.
+    void update();
+
+    bool isFrozen() const { return _frozen; }
+    bool isRendering() const { return _rendering.load(std::memory_order_acquire); }
+
+    // the rendering being played, if frozen
+    std::shared_ptr<const AudioBus> rendering() const { return _frozen ? _bus : nullptr; }
+
+private:
+    AudioContext * _ac;
+    Builder _build;
+    int _channels;
+
+    std::shared_ptr<AudioNode> _root;
+    std::shared_ptr<GainNode> _output;
+    std::shared_ptr<SampledAudioNode> _player;
+    std::shared_ptr<const AudioBus> _bus;
+    bool _frozen = false;
+    bool _loop = true;
+
+    // the live chain's fingerprint when the freeze began
+    uint64_t _frozenFingerprint = 0;
+
+    std::atomic<bool> _rendering {false};
+    std::mutex _renderedMutex;
+    std::shared_ptr<const AudioBus> _rendered;  // guarded by _renderedMutex
+};
+
+}  // lab
+
+#endif  // LABSOUND_FROZEN_SUBGRAPH_H
@@ -8,89 +8,30 @@
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioScheduledSourceNode.h"
 #include "LabSound/core/AudioSetting.h"
-#include <algorithm>
-#include <cmath>
+#include "LabSound/extended/Util.h"
+#include <vector>
 
 namespace lab
 {
 class GranulationNode : public AudioScheduledSourceNode
 {
-    struct grain
+    // Each grain plays a region of the source, looping if it runs off the end of it, under
+    // one cycle of the window. When the window completes, the grain respawns at a new
+    // random position, pitch, and pan, so the parameters shape the cloud as it plays.
+    // Grain state is kept in parallel arrays, sized for the most grains NumGrains allows,
+    // so that changing the density never allocates on the render thread.
+    struct GrainState
     {
-        std::shared_ptr<AudioBus> sample;
-        std::shared_ptr<AudioBus> window;
-
-        bool in_use {true};
-
-        // Values in samples
-        uint64_t grain_start {0};    // frames into the sample
-        uint64_t grain_duration {0}; // duration, seconds * samplerate
-        uint64_t grain_end {0};      // start + duration
-        uint64_t envelope_index {0};
-
-        double playback_frequency;
-        double sample_increment;
-        double sample_accurate_time;  // because of double precision, it's actually subsample-accurate
-
-        // position between 0-1, duration in seconds
-        grain(std::shared_ptr<AudioBus> _sample,
-              std::shared_ptr<AudioBus> _window,
-              const float sample_rate,
-              const double _position_offset,
-              const double _duration,
-              const double _speed)
-        : sample(_sample), window(_window)
-        {
-            grain_start = static_cast<uint64_t>(sample->length() * _position_offset);
-            grain_duration = static_cast<uint64_t>(_duration * sample_rate);
-            grain_end = std::min(static_cast<uint64_t>(sample->length()), grain_start + grain_duration);
-
-            playback_frequency = (1.0 / _duration) * _speed;
-            sample_accurate_time = static_cast<double>((playback_frequency > 0) ? grain_start : grain_end);
-            sample_increment = (playback_frequency != 0.0) ? grain_duration / (sample_rate / playback_frequency) : 0.0;
-        }
-
-        void tick(float * out_buffer, const int num_frames)
-        {
-            const float * windowSamples = window->channel(0)->data();
-
-            for (int i = 0; i < num_frames; ++i)
-            {
-                double result = 0.f;
-
-                if (in_use)
-                {
-                    sample_accurate_time += sample_increment;
-
-                    // Looping behavior
-                    if (sample_accurate_time >= grain_end)
-                    {
-                        sample_accurate_time = static_cast<double>(grain_start);
-                    }
-
-                    const uint64_t approximate_sample_index = static_cast<uint64_t>(std::floor(sample_accurate_time));
-                    const double remainder = sample_accurate_time - approximate_sample_index;
-
-                    uint64_t left = approximate_sample_index;
-                    uint64_t right = approximate_sample_index + 1;
-                    if (right >= sample->length()) right = 0;
-
-                    // interpolate sample positions (primarily for speed alterations, can be more sophisticated with this later)
-                    result = (double) ((1.0 - remainder) * sample->channel(0)->data()[left] + remainder * sample->channel(0)->data()[right]);
-                }
-
-                envelope_index++;
-
-                if (envelope_index == grain_duration)
-                {
-                    //in_use = false;
-                    envelope_index = 0;
-                }
-
-                // Apply envelope
-                out_buffer[i] += static_cast<float>(result * windowSamples[envelope_index]);
-            }
-        }
+        std::vector<double> position;        // read position in the source, in frames
+        std::vector<double> increment;       // source frames per output frame
+        std::vector<double> regionStart;     // frames into the source
+        std::vector<double> regionLength;    // frames
+        std::vector<double> phase;           // through the window, [0, 1)
+        std::vector<double> phaseIncrement;  // per output frame
+        std::vector<float> gainLeft;
+        std::vector<float> gainRight;
+
+        void resize(int count);
     };
 
     virtual bool propagatesSilence(ContextRenderLock & r) const override;
@@ -98,9 +39,16 @@ class GranulationNode : public AudioScheduledSourceNode
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
     bool RenderGranulation(ContextRenderLock &, AudioBus *, int destinationFrameOffset, int numberOfFrames);
+    void spawnGrain(int index, float sampleRate, double phase);
+    void updateWindow();
 
-    std::vector<grain> grain_pool;
-    std::shared_ptr<lab::AudioBus> window_bus;
+    GrainState grains;
+    int active_grains {0};
+    std::shared_ptr<const AudioBus> source_bus;
+    const float * window_table {nullptr};  // one cycle of the shared window table, with its end point
+    uint32_t window_type {~0u};
+    std::vector<float> grain_buffer;  // a grain's windowed samples, before they are panned into the output
+    UniformRandomGenerator rnd;
 
 public:
     GranulationNode(AudioContext & ac);
@@ -113,8 +61,8 @@ public:
     virtual void process(ContextRenderLock &, int bufferSize) override;
     virtual void reset(ContextRenderLock &) override;
 
-    bool setGrainSource(ContextRenderLock &, std::shared_ptr<AudioBus> sourceBus);
-    std::shared_ptr<AudioBus> getGrainSource() const { return grainSourceBus->valueBus(); }
+    bool setGrainSource(ContextRenderLock &, std::shared_ptr<const AudioBus> sourceBus);
+    std::shared_ptr<const AudioBus> getGrainSource() const { return grainSourceBus->valueBus(); }
 
     std::shared_ptr<AudioSetting> grainSourceBus;
     std::shared_ptr<AudioSetting> windowFunc;
@@ -123,6 +71,8 @@ public:
     std::shared_ptr<AudioParam> grainPositionMin;
     std::shared_ptr<AudioParam> grainPositionMax;
     std::shared_ptr<AudioParam> grainPlaybackFreq;
+    std::shared_ptr<AudioParam> grainPitchSpread;
+    std::shared_ptr<AudioParam> grainPanSpread;
 };
 
 }  // end namespace lab
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_GRAPH_ANALYSIS_H
+#define LABSOUND_GRAPH_ANALYSIS_H
+
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+class AudioNode;
+
+struct GraphAnalysisSettings
+{
+    int window = 128;             // recent quanta of each node's self time to average
+    float dominantShare = 0.1f;   // of the graph's total cost, at which a node is reported as dominant
+};
+
+struct GraphNodeReport
+{
+    const AudioNode * node = nullptr;  // to identify it; the analysis doesn't keep it alive
+    std::string name;
+    double cost = 0;         // mean self time per quantum, in microseconds
+    double pathCost = 0;     // of the costliest chain of dependencies ending at, and including, the node
+    int dependencies = 0;    // nodes and params' drivers it pulls from
+    bool timed = false;      // false if the node has no self time recorded, so its cost is unknown
+    bool critical = false;   // on the critical path
+    int unusedOutputs = 0;   // outputs rendered and connected to nothing
+    int duplicateOf = -1;    // an earlier node computing an identical subgraph, or -1
+};
+
+// The render graph feeding a context's destination, with each node's recent cost. Nodes are
+// listed with their dependencies first, as the render schedule runs them.
+struct GraphAnalysis
+{
+    std::vector<GraphNodeReport> nodes;
+    std::vector<int> criticalPath;   // from a source to the destination's input
+    std::vector<int> dominant;       // costliest first
+    double quantumMicroseconds = 0;  // the time each quantum lasts
+    double totalCost = 0;            // the nodes' costs summed: the time to render serially
+    double criticalPathCost = 0;     // the time to render however many threads there are
+
+    // The most the graph could be sped up by rendering on threads, if scheduling were free:
+    // the total cost over the larger of the critical path's and an equal share of the total
+    double speedup(int threads) const;
+    double maximumSpeedup() const { return criticalPathCost > 0 ? totalCost / criticalPathCost : 1.0; }
+
+    // A readable report of the above
+    std::string report() const;
+};
+
+// Walks the graph from the context's destination node through node inputs and param
+// connections, taking each node's self time from its selfTimeStats, and finds
+//
+//  - the critical path, the chain of dependencies with the greatest total cost, which bounds
+//    how fast a parallel render can be;
+//  - the dominant nodes, each costing at least the settings' share of the total;
+//  - redundant work: nodes of the same type, with the same param values and settings, whose
+//    inputs are identical subgraphs in turn, which could be rendered once and shared, and
+//    outputs rendered but connected to nothing.
+//
+// Costs are only as good as the nodes' timing, which the context samples; see
+// AudioContext::setProfileSampling. Identical subgraphs are found by structure, so two
+// sources of the same kind started at different times are reported alike, and should be
+// checked before they are merged. Safe from any thread but the audio thread.
+GraphAnalysis AnalyzeGraph(AudioContext & ac, const GraphAnalysisSettings & settings = {});
+
+}  // lab
+
+#endif  // LABSOUND_GRAPH_ANALYSIS_H
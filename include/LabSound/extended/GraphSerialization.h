@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_GRAPH_SERIALIZATION_H
+#define LABSOUND_GRAPH_SERIALIZATION_H
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+class AudioNode;
+
+// A compact binary form of a graph, for instantiating scenes quickly. It holds each node's
+// type, parameter values, automation timelines and settings, the connections among the
+// nodes, and their connections to the context's destination node.
+//
+// Names are stored once, in a table, and a node type's parameter and setting names once
+// per type, so that loading resolves each name once however many nodes share the type.
+// Values are little-endian. Bus settings, and connections to nodes outside the graph, are
+// not saved.
+enum : uint16_t { GraphFormatVersion = 1 };
+
+// Saves the nodes, and the connections among them and to ac's destination node. Every node
+// must be of a type the NodeRegistry can create.
+std::vector<uint8_t> SaveGraph(AudioContext & ac, const std::vector<std::shared_ptr<AudioNode>> & nodes);
+
+// Creates the saved nodes in ac, in the order they were saved, and queues their connections
+// together, so that the audio thread makes all of them under one acquisition of the graph
+// lock. Returns false, leaving nodes empty and nothing connected, if the data isn't a graph
+// of a version this build reads, or names a node type the NodeRegistry doesn't know.
+bool LoadGraph(AudioContext & ac, const uint8_t * data, size_t size, std::vector<std::shared_ptr<AudioNode>> & nodes);
+
+}  // lab
+
+#endif  // LABSOUND_GRAPH_SERIALIZATION_H
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef HRTF_MIXER_NODE_H
+#define HRTF_MIXER_NODE_H
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/FloatPoint3D.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class DistanceEffect;
+
+// HRTFMixerNode spatializes many sources around the context's AudioListener with the context's
+// HRTF database, and mixes them to one stereo output. Each input is a source with a position
+// of its own. Where a PannerNode in HRTF mode convolves every source it pans, the mixer sums
+// the sources heard from the same direction of the database and convolves each direction once,
+// so that a crowd of sources costs a gain and a sum each, and a convolution for each direction
+// they occupy. Sources are attenuated with distance as a PannerNode's are; they have no cones.
+//
+// settings: distanceModel, refDistance, maxDistance, rolloffFactor, azimuthGrouping
+//
+class HRTFMixerNode : public AudioNode
+{
+    std::shared_ptr<AudioSetting> m_distanceModel;
+    std::shared_ptr<AudioSetting> m_refDistance;
+    std::shared_ptr<AudioSetting> m_maxDistance;
+    std::shared_ptr<AudioSetting> m_rolloffFactor;
+    std::shared_ptr<AudioSetting> m_azimuthGrouping;
+
+public:
+    HRTFMixerNode(AudioContext & ac, int numberOfInputs = 1);
+    virtual ~HRTFMixerNode();
+
+    static const char * static_name() { return "HRTFMixer"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // Adds n sources; inputs should be added before they are connected.
+    void addInputs(int n);
+
+    // The position of the source connected to input, in the listener's space. Positions may
+    // be set from any thread, and take effect from the next render quantum.
+    void setPosition(int input, float x, float y, float z) { setPosition(input, FloatPoint3D(x, y, z)); }
+    void setPosition(int input, const FloatPoint3D & position);
+    FloatPoint3D position(int input) const;
+
+    float refDistance() const;
+    void setRefDistance(float refDistance);
+
+    float maxDistance() const;
+    void setMaxDistance(float maxDistance);
+
+    float rolloffFactor() const;
+    void setRolloffFactor(float rolloffFactor);
+
+    // How many neighbouring azimuths of the database, which are 1.875 degrees apart, share a
+    // convolution. Larger groups give fewer convolutions for coarser directions. The default is 1.
+    int azimuthGrouping() const;
+    void setAzimuthGrouping(int azimuths);
+
+    // The number of directions convolved in the last render quantum
+    int activeDirections() const { return m_activeDirectionCount.load(std::memory_order_relaxed); }
+
+    // AudioNode
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    virtual double tailTime(ContextRenderLock & r) const override;
+    virtual double latencyTime(ContextRenderLock & r) const override;
+
+private:
+    struct Source;
+    struct Direction;
+
+    Direction * acquireDirection(int key, int frames);
+
+    std::unique_ptr<DistanceEffect> m_distanceEffect;
+    std::vector<std::unique_ptr<Source>> m_sources;
+
+    // Every direction's state is kept, and reused once the direction falls silent, so that the
+    // mixer only allocates as the number of directions in use grows.
+    std::vector<std::unique_ptr<Direction>> m_directions;
+    std::vector<Direction *> m_directionByKey;
+    std::vector<Direction *> m_activeDirections;
+    std::vector<Direction *> m_freeDirections;
+    std::atomic<int> m_activeDirectionCount {0};
+
+    AudioFloatArray m_tempL;
+    AudioFloatArray m_tempR;
+    float m_sampleRate;
+};
+
+}  // namespace lab
+
+#endif
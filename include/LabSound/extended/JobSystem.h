@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_JOB_SYSTEM_H
+#define LABSOUND_JOB_SYSTEM_H
+
+#include "LabSound/core/ThreadScheduling.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+enum class JobPriority
+{
+    High = 0,    // work that rendering is waiting for, such as loading the HRTF database
+    Normal,      // decoding files and preparing impulse responses
+    Background,  // offline rendering
+    _JobPriorityCount
+};
+
+// JobSystem runs LabSound's background work on one pool of threads, so that decoding,
+// database loading, impulse response preparation and offline rendering share the cores
+// the application gives them rather than each starting threads of their own.
+//
+// Jobs run in order of priority, and in the order they were submitted within a priority.
+// A job that waits for other jobs should do so through wait(), which runs queued jobs
+// while it waits, so that a pool whose workers are all waiting still makes progress.
+//
+// The threads that render in real time, and the threads that keep a deadline on their
+// behalf, such as the background stages of partitioned convolution, are not pooled.
+class JobSystem
+{
+public:
+    struct Settings
+    {
+        int workerCount = 0;  // zero uses one thread fewer than the hardware has, and at least one
+        ThreadScheduling scheduling;
+    };
+
+    // The process's job system, started on first use
+    static JobSystem & shared();
+
+    // Sets the shared job system's settings. Returns false once it has started, as its
+    // workers can't then be changed.
+    static bool configure(const Settings & settings);
+
+    JobSystem();
+    explicit JobSystem(const Settings & settings);
+    ~JobSystem();  // runs the jobs still queued, then stops the workers
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem & operator=(const JobSystem &) = delete;
+
+    void submit(std::function<void()> job, JobPriority priority = JobPriority::Normal);
+
+    // Returns once done() returns true, running queued jobs of the given priority or more
+    // urgent on the calling thread meanwhile. done() is checked whenever a job finishes, so
+    // it should become true as a job's last act; it is called under the system's lock, and
+    // must be cheap and not block.
+    void wait(const std::function<bool()> & done, JobPriority helpWith = JobPriority::Background);
+
+    int workerCount() const { return static_cast<int>(m_workers.size()); }
+
+    // jobs that have not started
+    size_t queued() const;
+
+private:
+    void workerLoop(const ThreadScheduling & scheduling);
+    bool popJob(std::function<void()> & job, JobPriority lowest);  // the lock is held
+
+    std::deque<std::function<void()>> m_queues[static_cast<int>(JobPriority::_JobPriorityCount)];
+    std::vector<std::thread> m_workers;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;      // a job was submitted
+    std::condition_variable m_finished;  // a job finished
+    bool m_shouldExit = false;
+};
+
+}  // lab
+
+#endif  // LABSOUND_JOB_SYSTEM_H
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LIMITER_NODE_H
+#define LIMITER_NODE_H
+
+#include "LabSound/core/AudioBasicProcessorNode.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+
+namespace lab
+{
+
+// LimiterNode is a lookahead brickwall limiter, for the end of a master bus. No sample
+// leaves it louder than the ceiling.
+//
+// The input is delayed by the lookahead, so the gain can be brought down smoothly before
+// a peak arrives rather than clamped when it does. The gain is the same for every channel,
+// so the stereo image doesn't shift while limiting. The delay is reported by latencyTime.
+//
+// params: ceiling, release
+// settings: lookahead
+//
+class LimiterNode : public AudioBasicProcessorNode
+{
+    class LimiterNodeInternal;
+    LimiterNodeInternal * internalNode = nullptr;  // We do not own this!
+
+public:
+    LimiterNode(AudioContext & ac);
+    virtual ~LimiterNode();
+
+    static const char* static_name() { return "Limiter"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // The greatest level let through, in dBFS, default -1
+    std::shared_ptr<AudioParam> ceiling() const;
+
+    // The time for the gain to recover after a peak, in ms, default 100
+    std::shared_ptr<AudioParam> release() const;
+
+    // The lookahead, in ms, default 5. Changing it clears the limiter's state.
+    std::shared_ptr<AudioSetting> lookahead() const;
+};
+
+}  // namespace lab
+
+#endif
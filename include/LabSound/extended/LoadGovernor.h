@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_LOAD_GOVERNOR_H
+#define LABSOUND_LOAD_GOVERNOR_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+class AudioNode;
+class PannerNode;
+
+// LoadGovernor sheds work from a context while its render load runs high, and restores it
+// once the load has come back down.
+//
+// The work that may be shed is registered as steps, each with a priority: voices, which
+// are bypassed and so fall silent; effects, which are bypassed and so pass their input
+// through dry; panners, which drop to equal power panning; and arbitrary functions. While
+// the device's callback load is above the threshold, each update sheds one more step, the
+// lowest priority first, and among steps of equal priority the one whose node has taken
+// the longest to render. While the load has stayed below the threshold less the
+// hysteresis for a number of updates, the step shed most recently is restored. Every
+// change is reported to the listener, through the context's event queue.
+class LoadGovernor
+{
+public:
+    struct Settings
+    {
+        float thresholdPercent = 75.f;   // of each callback's buffer period
+        float hysteresisPercent = 15.f;
+        int restoreUpdates = 10;         // updates below threshold before a step is restored
+    };
+
+    struct Event
+    {
+        std::string name;
+        int priority;
+        bool shed;           // false when the step was restored
+        float loadPercent;   // the load that prompted the change
+    };
+
+    using Step = std::function<void(bool shed)>;
+
+    LoadGovernor() = default;
+    explicit LoadGovernor(const Settings & settings) : _settings(settings) {}
+
+    Settings & settings() { return _settings; }
+
+    // Lower priorities are shed first. A step whose node has been destroyed is forgotten.
+    void addVoice(std::shared_ptr<AudioNode> voice, int priority);
+    void addEffect(std::shared_ptr<AudioNode> effect, int priority);
+    void addPanner(std::shared_ptr<PannerNode> panner, int priority);
+    void addStep(const std::string & name, int priority, Step step);
+
+    // Removing a step restores it if it was shed.
+    void remove(const std::shared_ptr<AudioNode> & node);
+    void remove(const std::string & name);
+
+    // Called on the main thread when an event is dispatched.
+    void setListener(std::function<void(const Event &)> listener) { _listener = std::move(listener); }
+
+    // Main thread, regularly. Sheds or restores at most one step.
+    void update(AudioContext & ac);
+
+    // Restores every step that has been shed.
+    void restoreAll(AudioContext & ac);
+
+    int shedCount() const { return static_cast<int>(_shed.size()); }
+    float loadPercent() const { return _loadPercent; }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        int priority = 0;
+        std::weak_ptr<AudioNode> node;
+        bool hasNode = false;
+        Step step;
+        bool shed = false;
+    };
+
+    void change(AudioContext & ac, Entry & entry, bool shed);
+    void restore(Entry & entry);
+    void forgetExpired();
+
+    Settings _settings;
+    std::vector<std::shared_ptr<Entry>> _entries;
+    std::vector<std::shared_ptr<Entry>> _shed;   // in the order they were shed
+    std::function<void(const Event &)> _listener;
+    float _loadPercent = 0;
+    int _quietUpdates = 0;
+};
+
+}  // lab
+
+#endif  // LABSOUND_LOAD_GOVERNOR_H
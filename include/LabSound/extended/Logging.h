@@ -36,6 +36,13 @@ void log_set_fp(FILE *fp);
 void log_set_level(int level);
 void log_set_quiet(int enable);
 
+// With async logging enabled, a message is recorded without formatting or locking, so that
+// it may be logged from the audio thread, and written by a background thread. The format
+// must be a string literal, or otherwise outlive the program. log_flush() writes the
+// messages recorded so far. Disabled by default, and on exit.
+void log_set_async(int enable);
+void log_flush(void);
+
 void LabSoundLog(int level, const char *file, int line, const char *fmt, ...);
 void LabSoundAssertLog(const char * file, int line, const char * function, const char * assertion);
 
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef LOUDNESS_METER_NODE_H
+#define LOUDNESS_METER_NODE_H
+
+#include "LabSound/core/AudioBasicInspectorNode.h"
+
+#include <atomic>
+#include <memory>
+
+namespace lab
+{
+struct LoudnessMeter;
+
+// LoudnessMeterNode measures the loudness of its input as ITU-R BS.1770-4 and EBU R128
+// describe, and passes the input through unchanged.
+//
+// The channels are K-weighted, four at a time in SIMD lanes, and their weighted mean
+// squares are gathered into 100 ms blocks. The momentary and short term loudnesses are
+// those of the latest 400 ms and 3 s; the integrated loudness is gated, absolutely at
+// -70 LUFS and then relatively at 10 LU below, over every 400 ms block since the last
+// reset. The true peak is found by oversampling four times with the filter of
+// BS.1770-4 Annex 2. The surround channels of the bus's speaker layout are weighted by
+// +1.5 dB, and the LFE channel is left out.
+//
+// The measurements are published every 100 ms, and may be read from any thread without
+// locking. Loudness is in LUFS and the true peak in dBTP; both are minus infinity for
+// silence. Up to MaxChannels channels are metered.
+//
+// params:
+// settings:
+//
+class LoudnessMeterNode : public AudioBasicInspectorNode
+{
+public:
+    enum { MaxChannels = 16 };
+
+    LoudnessMeterNode(AudioContext & ac);
+    virtual ~LoudnessMeterNode();
+
+    static const char* static_name() { return "LoudnessMeter"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    float momentaryLoudness() const { return _momentary.load(std::memory_order_relaxed); }
+    float shortTermLoudness() const { return _shortTerm.load(std::memory_order_relaxed); }
+    float integratedLoudness() const { return _integrated.load(std::memory_order_relaxed); }
+
+    // the greatest true peak of any channel since the last reset
+    float truePeak() const { return _truePeak.load(std::memory_order_relaxed); }
+
+    // Starts the integrated loudness and the true peak over, from the next quantum on.
+    // Any thread.
+    void resetIntegration() { _resetRequested.store(true, std::memory_order_release); }
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }  // required for BasicInspector
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }  // required for BasicInspector
+
+    std::unique_ptr<LoudnessMeter> _meter;
+
+    std::atomic<float> _momentary;
+    std::atomic<float> _shortTerm;
+    std::atomic<float> _integrated;
+    std::atomic<float> _truePeak;
+    std::atomic<bool> _resetRequested {false};
+};
+
+}  // namespace lab
+
+#endif
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_METRICS_REGISTRY_H
+#define LABSOUND_METRICS_REGISTRY_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+
+// MetricsRegistry gathers counters and gauges for export to a monitoring system, in the
+// Prometheus text format for a scrape endpoint to serve, or as StatsD lines to send.
+//
+// A metric is registered once, from any thread but the audio thread, and the pointer
+// returned is kept and updated from anywhere, the audio thread included, with a relaxed
+// atomic store; an update never locks or allocates. Registering the same name and labels
+// again returns the same metric.
+//
+// Contexts added to the registry are read as each export is written, from the scraping
+// thread, through AudioContext::metrics() and the device's load statistics, which don't
+// take the graph or render lock. Their metrics are labelled context="name". A context
+// that has been destroyed is dropped from the registry.
+class MetricsRegistry
+{
+public:
+    enum class Type
+    {
+        Counter,  // only increases
+        Gauge
+    };
+
+    class Metric
+    {
+        friend class MetricsRegistry;
+
+        std::string _name;
+        std::string _help;
+        std::string _labels;  // such as context="main",bus="music"
+        Type _type;
+        std::atomic<uint64_t> _bits {0};  // the value's double
+        double _sent = 0;                 // the value at the last StatsD export, under the registry's lock
+        bool _retired = false;            // its context was removed; not exported until registered again
+
+        static uint64_t bits(double v);
+        static double value(uint64_t b);
+
+    public:
+        Metric(const std::string & name, const std::string & help, const std::string & labels, Type type)
+            : _name(name), _help(help), _labels(labels), _type(type) {}
+
+        void set(double v) { _bits.store(bits(v), std::memory_order_relaxed); }
+        void add(double v);
+        double value() const { return value(_bits.load(std::memory_order_relaxed)); }
+    };
+
+    MetricsRegistry() = default;
+    ~MetricsRegistry() = default;
+
+    MetricsRegistry(const MetricsRegistry &) = delete;
+    MetricsRegistry & operator=(const MetricsRegistry &) = delete;
+
+    // Names should be of letters, digits and underscores, and labels of name="value"
+    // pairs separated by commas. The metric lives as long as the registry.
+    Metric * counter(const std::string & name, const std::string & help, const std::string & labels = {});
+    Metric * gauge(const std::string & name, const std::string & help, const std::string & labels = {});
+
+    // Exports, for each context, its DSP load, xruns and callback overruns, render stalls,
+    // scheduled nodes and playing sources, pending connections and events, dropped events,
+    // and event dispatch latency, along with the memory held by the AudioMemoryPool.
+    void addContext(std::shared_ptr<AudioContext> context, const std::string & name);
+    void removeContext(const std::shared_ptr<AudioContext> & context);
+
+    // Every metric in the Prometheus text exposition format
+    std::string prometheus();
+
+    // Every metric as a StatsD line, a gauge's value or a counter's increase since the last
+    // call, its name given the prefix. Labels are appended as DogStatsD tags.
+    std::string statsd(const std::string & prefix = "labsound.");
+
+private:
+    struct Context
+    {
+        std::weak_ptr<AudioContext> context;
+        std::string labels;
+        Metric * dspLoad;
+        Metric * callbackLoad;
+        Metric * xruns;
+        Metric * overruns;
+        Metric * renderStalls;
+        Metric * renderLockMisses;
+        Metric * scheduledNodes;
+        Metric * playingSources;
+        Metric * pendingConnections;
+        Metric * pendingEvents;
+        Metric * droppedEvents;
+        Metric * eventsDispatched;
+        Metric * eventLatency;
+        Metric * eventLatencyPeak;
+    };
+
+    Metric * find(const std::string & name, const std::string & help, const std::string & labels, Type type);  // the lock is held
+    void removeContextLocked(const AudioContext * context);  // and those destroyed; the lock is held
+    void collect();  // the lock is held
+
+    std::deque<Metric> _metrics;  // grows without moving the metrics handed out
+    std::vector<Context> _contexts;
+    Metric * _poolBytes = nullptr;
+    std::mutex _mutex;
+};
+
+}  // lab
+
+#endif  // LABSOUND_METRICS_REGISTRY_H
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef MIXER_NODE_H
+#define MIXER_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+// MixerNode mixes many inputs to one stereo output, each through a channel strip of its own
+// with a gain, a pan, a mute and a solo. Where a strip built of a GainNode and a
+// StereoPannerNode copies its input through two buses before it is summed, the mixer reads
+// each input once, and adds it to the output through the strip's pan and gain in the same
+// pass. Mono inputs are panned, and stereo inputs balanced, with the equal power law of a
+// StereoPannerNode; inputs of more channels are mixed down to stereo first.
+//
+// While any strip is soloed, only soloed strips are heard. Changes of gain, pan, mute and
+// solo are ramped over a render quantum, so that they don't click.
+//
+// With metering on, each strip's input level, before its fader, is measured in the same pass.
+//
+// The mixer may also have sends, aux buses that each strip feeds at a level of its own, in
+// the same pass, so that many sources share one effect. Each send is a stereo output after
+// the main one, to be connected to an effect such as a ConvolverNode, whose output returns
+// to a strip of the mixer, or wherever it is wanted. A post-fader send follows its strip's
+// gain, and a pre-fader send doesn't; both follow its pan, mute and solo.
+//
+// settings: metering
+//
+class MixerNode : public AudioNode
+{
+public:
+    MixerNode(AudioContext & ac, int numberOfInputs = 1, int numberOfSends = 0);
+    virtual ~MixerNode();
+
+    static const char * static_name() { return "Mixer"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // Adds n strips; inputs should be added before they are connected.
+    void addInputs(int n);
+
+    // A strip's controls, which may be set from any thread, and take effect from the next
+    // render quantum. gain is linear, and pan from -1, left, to 1, right.
+    void setGain(int input, float gain);
+    float gain(int input) const;
+
+    void setPan(int input, float pan);
+    float pan(int input) const;
+
+    void setMute(int input, bool mute);
+    bool mute(int input) const;
+
+    void setSolo(int input, bool solo);
+    bool solo(int input) const;
+
+    static const int MaxSends = 8;
+
+    // The sends are outputs 1 to sends()
+    int sends() const { return m_sends; }
+
+    // A strip's level into a send, linear, and 0 by default. Sends are post-fader by default.
+    void setSend(int input, int send, float level);
+    float send(int input, int send) const;
+
+    void setSendPreFader(int input, int send, bool preFader);
+    bool sendPreFader(int input, int send) const;
+
+    bool metering() const;
+    void setMetering(bool metering);
+
+    // The greatest absolute sample of a strip's input since the last call, which resets it
+    float takePeak(int input);
+
+    // The RMS level of a strip's input over the last render quantum
+    float level(int input) const;
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+private:
+    struct Strip;
+
+    Strip & strip(int input) const;
+    void checkSend(int send) const;
+
+    int m_sends;
+    std::shared_ptr<AudioSetting> m_metering;
+    std::vector<std::unique_ptr<Strip>> m_strips;
+};
+
+}  // namespace lab
+
+#endif  // MIXER_NODE_H
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_NETWORK_SINK_NODE_H
+#define LABSOUND_NETWORK_SINK_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/ConcurrentQueue.h"
+#include "LabSound/extended/NetworkStream.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+class UdpSocket;
+
+// NetworkSinkNode passes its input through, and streams it to a remote listener, such as
+// a NetworkSourceNode, over UDP. The render thread writes each quantum straight from the
+// input's channels into a lock free ring; a sending thread of the node's own takes it
+// from there a packet at a time, encodes it, and sends it, so that neither encoding nor
+// the network ever holds up rendering. A quantum the ring has no room for, because the
+// sender has fallen behind, is dropped and counted.
+//
+// Input channels past the config's are ignored, and config channels past the input's are
+// sent silent. Like a RecorderNode, the node only runs when pulled: connect it downstream,
+// or add it to the context's automatic pull nodes.
+//
+// The constructor throws std::invalid_argument for a config that can't be sent, and
+// std::runtime_error if the address can't be resolved or the socket opened.
+class NetworkSinkNode : public AudioNode
+{
+public:
+    NetworkSinkNode(AudioContext & ac, const NetworkStreamConfig & config);
+    virtual ~NetworkSinkNode();
+
+    static const char* static_name() { return "NetworkSink"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override {}
+
+    const NetworkStreamConfig & config() const { return _config; }
+
+    uint64_t packetsSent() const { return _packetsSent.load(); }
+    uint64_t sendErrors() const { return _sendErrors.load(); }
+
+    // Frames dropped because the sender had fallen behind
+    uint64_t overflowFrames() const { return _overflowFrames.load(); }
+
+private:
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; } // silence is sent too
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    void senderEntry();
+    void wakeSender();  // doesn't block
+
+    NetworkStreamConfig _config;
+    std::unique_ptr<UdpSocket> _socket;
+    std::unique_ptr<AudioRingBuffer> _ring;
+    std::vector<const float *> _channels;  // the ring's sources, one per channel
+
+    std::thread _sender;
+    std::mutex _senderMutex;
+    std::condition_variable _senderWake;
+    std::atomic<bool> _quit {false};
+
+    std::atomic<uint64_t> _packetsSent {0};
+    std::atomic<uint64_t> _sendErrors {0};
+    std::atomic<uint64_t> _overflowFrames {0};
+};
+
+}  // end namespace lab
+
+#endif
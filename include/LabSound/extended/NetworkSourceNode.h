@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_NETWORK_SOURCE_NODE_H
+#define LABSOUND_NETWORK_SOURCE_NODE_H
+
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/extended/NetworkStream.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+class JitterBuffer;
+class UdpSocket;
+
+// NetworkSourceNode plays a stream received over UDP, such as a NetworkSinkNode sends or
+// a remote microphone streams as RTP. A receiving thread of the node's own decodes each
+// packet into an adaptive jitter buffer, which puts packets that arrive out of order back
+// in sequence, conceals those that never arrive, and holds the stream at a latency that
+// follows the network's jitter, between the config's minLatency and maxLatency. The render
+// thread reads each quantum from the jitter buffer's lock free ring, and never waits for
+// the network: until the latency has built up, and whenever the stream runs dry, the node
+// plays silence.
+//
+// The constructor throws std::invalid_argument for a config that can't be received, and
+// std::runtime_error if the port can't be bound.
+class NetworkSourceNode : public AudioScheduledSourceNode
+{
+public:
+    NetworkSourceNode(AudioContext & ac, const NetworkStreamConfig & config);
+    virtual ~NetworkSourceNode();
+
+    static const char* static_name() { return "NetworkSource"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override {}
+
+    const NetworkStreamConfig & config() const { return _config; }
+
+    uint64_t packetsReceived() const;
+    uint64_t packetsLost() const;     // never arrived, and were concealed
+    uint64_t packetsLate() const;     // arrived after they were given up on
+    uint64_t droppedFrames() const;   // to bring the latency back down to its target
+    uint64_t underrunFrames() const;  // played as silence because the stream ran dry
+    double jitter() const;            // the network's interarrival jitter, in seconds
+    double latency() const;           // the latency the stream is held to, in seconds
+
+private:
+    virtual bool propagatesSilence(ContextRenderLock & r) const override;
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    void receiverEntry();
+
+    NetworkStreamConfig _config;
+    int _maxPacketFrames = 0;
+    std::unique_ptr<UdpSocket> _socket;
+    std::unique_ptr<JitterBuffer> _jitterBuffer;
+    std::vector<float *> _channels;  // the jitter buffer's destinations, one per channel
+
+    std::thread _receiver;
+    std::atomic<bool> _quit {false};
+};
+
+}  // end namespace lab
+
+#endif
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_NETWORK_STREAM_H
+#define LABSOUND_NETWORK_STREAM_H
+
+#include <cstdint>
+#include <string>
+
+namespace lab
+{
+
+// How a network stream's samples are sent: interleaved PCM in network byte order, as
+// RTP's L16 and L24 formats are. Float32 sends IEEE floats the same way.
+enum class NetworkPayload : int
+{
+    Int16,
+    Int24,
+    Float32
+};
+
+// Describes a stream of audio over UDP, as RTP (RFC 3550) with a PCM payload by default.
+// Both ends must agree on the channels, payload and rate; the stream's rate is taken to be
+// the context's.
+struct NetworkStreamConfig
+{
+    // A NetworkSinkNode sends to address, a name or a numeric address, at port. A
+    // NetworkSourceNode listens on port, on the interface with address, or on every
+    // interface if it is empty.
+    std::string address;
+    uint16_t port = 0;
+
+    int channels = 2;
+    NetworkPayload payload = NetworkPayload::Int16;
+
+    // Without RTP, packets are bare payloads; the source then plays them as they arrive,
+    // and can't reorder them or notice any lost
+    bool rtp = true;
+    uint8_t payloadType = 96;  // RTP's first dynamic type; the source ignores packets of any other
+
+    // The sink's frames per packet, zero being the render quantum. For the source, the
+    // largest packet expected, zero being as many frames as MaxPacketBytes holds.
+    int packetFrames = 0;
+
+    // The source's latency follows the network's jitter within these bounds, in seconds
+    double minLatency = 0.005;
+    double maxLatency = 0.25;
+
+    // The largest payload sent or received; keep packets under 1460 bytes to avoid
+    // fragmenting them on an ethernet path
+    enum : int { MaxPacketBytes = 8192 };
+};
+
+}  // namespace lab
+
+#endif  // LABSOUND_NETWORK_STREAM_H
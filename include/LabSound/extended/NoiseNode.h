@@ -10,6 +10,9 @@
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioScheduledSourceNode.h"
 
+#include <atomic>
+#include <cstdint>
+
 namespace lab
 {
 class AudioSetting;
@@ -39,24 +42,31 @@ public:
     NoiseType type() const;
     void setType(NoiseType newType);
 
+    // Each instance is seeded differently from the ones made before it, so repeated runs of
+    // a program that makes its nodes in the same order render the same noise. Setting the
+    // seed restarts the noise from it.
+    uint32_t seed() const;
+    void setSeed(uint32_t seed);
+
 private:
     virtual bool propagatesSilence(ContextRenderLock & r) const override;
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
     std::shared_ptr<AudioSetting> _type;
+    std::shared_ptr<AudioSetting> _seed;
 
-    uint32_t whiteSeed = 1489853723;
+    // eight xorshift generators, run side by side so that white noise is made eight
+    // samples at a time
+    uint32_t _lanes[8];
+    std::atomic<bool> _reseed {true};
 
     float lastBrown = 0;
 
-    float pink0 = 0;
-    float pink1 = 0;
-    float pink2 = 0;
-    float pink3 = 0;
-    float pink4 = 0;
-    float pink5 = 0;
-    float pink6 = 0;
+    // Paul Kellet's pink filter bank: six poles and the direct path as lanes, filtered
+    // together, and the one sample delayed path
+    float _pink[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    float _pinkDelayed = 0;
 };
 }
 
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_OFFLINE_RENDERER_H
+#define LABSOUND_OFFLINE_RENDERER_H
+
+#include "LabSound/core/AudioDevice.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+
+struct OfflineRenderJob
+{
+    // An offline context whose destination node has been set, with its graph built
+    std::shared_ptr<AudioContext> context;
+
+    uint64_t framesToRender = 0;
+    int chunkFrames = 0;  // frames handed to the sink at a time; zero means one render quantum
+    OfflineRenderSink sink;
+    OfflineRenderProgress progress;
+
+    uint64_t framesRendered = 0;  // set once the job has finished
+};
+
+// Renders independent offline contexts concurrently, faster than real time, on up to
+// threadCount threads: the calling thread, and the shared JobSystem's workers. Zero uses
+// every worker. Each context is rendered start to finish by a single thread. Returns once
+// every job has finished.
+void RenderOfflineContexts(std::vector<OfflineRenderJob> & jobs, int threadCount = 0);
+
+// Returns a sink that streams the chunks it receives to a 32 bit float WAV file.
+// The header is brought up to date after every chunk, so that the file is complete even
+// if rendering is stopped early. Returns an empty sink if the file can't be created.
+OfflineRenderSink MakeWavFileSink(const std::string & path, int channelCount, float sampleRate);
+
+// A segment of a long timeline, to be rendered on its own, in another process or on
+// another machine, and stitched to its neighbours afterwards.
+//
+// A segment's context starts preroll frames before the segment, so that the tails of the
+// events before it, such as reverberation and echoes, are present when it begins; the
+// preroll is rendered and discarded. Each process builds the same graph, and schedules
+// the events of the timeline relative to contextStartFrame(). Sounds that began before
+// the preroll and are still playing, such as a bed, are the application's to start part
+// way through, as with a sample's start offset. Segments start on a render quantum, so
+// events land on the same frames as they would in a single render.
+struct RenderSegment
+{
+    int index = 0;
+    uint64_t firstFrame = 0;  // of the timeline
+    uint64_t frames = 0;
+    uint64_t preroll = 0;
+
+    uint64_t contextStartFrame() const { return firstFrame - preroll; }
+
+    // A single line describing the segment, for handing to another process, and its inverse
+    std::string toString() const;
+    static bool parse(const std::string & text, RenderSegment & segment);
+};
+
+// Splits totalFrames into segmentCount segments of about equal length, starting on render
+// quanta, each with a preroll of tailSeconds rounded up to whole quanta
+std::vector<RenderSegment> PlanRenderSegments(uint64_t totalFrames, int segmentCount, double tailSeconds,
+                                              float sampleRate, int quantum = AudioNode::ProcessingSizeInFrames);
+
+// The longest time sound may linger in the graph after its input stops: the greatest sum
+// of tail and latency times along any path to the destination. A suitable tailSeconds.
+double GraphTailTime(AudioContext & ac);
+
+// A job that renders a segment with its preroll on an offline context built for it,
+// handing only the segment's frames to sink, numbered from the start of the timeline
+OfflineRenderJob MakeSegmentRenderJob(const RenderSegment & segment, std::shared_ptr<AudioContext> context,
+                                      OfflineRenderSink sink, int chunkFrames = 0);
+
+// Joins the WAV files written by MakeWavFileSink for consecutive segments into one file.
+// Returns false if a file can't be read, or their formats differ.
+bool StitchWavSegments(const std::vector<std::string> & segmentPaths, const std::string & outputPath);
+
+}  // lab
+
+#endif  // LABSOUND_OFFLINE_RENDERER_H
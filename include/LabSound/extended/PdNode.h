@@ -1,44 +1,134 @@
 // Copyright (c) 2003-2013 Nick Porcino, All rights reserved.
 // License is MIT: http://opensource.org/licenses/MIT
 
-// PureDataNode wraps an instance of pure-data as a signal processing node
+#ifndef PD_NODE_H
+#define PD_NODE_H
 
-#pragma once
+// PdNode runs a Pure Data patch through libpd. It is built when PD is defined, and
+// libpd's z_libpd.h is on the include path.
 
 #ifdef PD
 
-#include "LabSound/core/AudioBasicProcessorNode.h"
+#include "LabSound/core/AudioNode.h"
 
-namespace pd
-{
-class PdBase;
-class PdMidiReceiver;
-class PdReceiver;
-}
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace lab
 {
+class AudioBus;
 
-class PureDataNode : public AudioBasicProcessorNode
+// An instance of libpd, with its own patches and DSP graph, which PdNodes run. Every libpd
+// call is made with the instance current and its lock held, through perform(), so that
+// nodes on different instances may render at once, as nodes of a parallel render schedule
+// do. libpd keeps its current instance per thread only when it is built with PDINSTANCE
+// and PDTHREADS; otherwise all instances share one lock, and without PDINSTANCE there can
+// be only one instance.
+//
+// Several nodes may share an instance, each on its own range of the instance's adc~ and
+// dac~ channels, so that their patches can talk to each other without crossing threads.
+// The patch runs once a quantum, when the first of its nodes renders, so the nodes of a
+// shared instance hear their inputs a quantum late.
+class PdInstance
 {
+public:
+    // inputs and outputs are the channels of the instance's adc~ and dac~
+    PdInstance(int inputs, int outputs, float sampleRate);
+    ~PdInstance();
+
+    PdInstance(const PdInstance &) = delete;
+    PdInstance & operator=(const PdInstance &) = delete;
+
+    // Runs fn with the instance current, so that fn may make any libpd call. The instance's
+    // nodes wait to render while fn runs, so it should be brief.
+    void perform(const std::function<void()> & fn);
+
+    // Opens a patch; returns false if it can't be
+    bool openPatch(const std::string & file, const std::string & directory);
+    void closePatches();
+
+    void sendBang(const std::string & receiver);
+    void sendFloat(const std::string & receiver, float value);
+
+    int inputs() const { return m_inputs; }
+    int outputs() const { return m_outputs; }
+
+    // libpd's tick, in frames; render quanta must be a multiple of it
+    static int blockSize();
+
+private:
+    friend class PdNode;
+
+    std::unique_lock<std::mutex> acquire();  // locks the instance, and makes it current
+
+    // Render thread, with the instance acquired. Copies the node's inputs in and its outputs
+    // out, running the patch's ticks for the quantum beginning at frame if it hasn't yet.
+    void render(uint64_t frame, const AudioBus * source, int firstInput, int inputCount,
+                AudioBus * destination, int firstOutput, int outputCount, int frames);
 
+    // Main thread
+    void attach(int renderQuantum);
+    void detach();
+
+    void * m_instance = nullptr;  // the t_pdinstance, or null for libpd's only instance
+    std::mutex * m_mutex = nullptr;
+    std::mutex m_ownMutex;
+    int m_inputs = 0;
+    int m_outputs = 0;
+    std::vector<void *> m_patches;
+
+    // A quantum's audio, in ticks laid out as libpd_process_raw takes them, each channel
+    // of a tick after the one before
+    std::vector<float> m_in;
+    std::vector<float> m_out;
+    std::atomic<int> m_nodes {0};
+    uint64_t m_renderedFrame = UINT64_MAX;
+};
+
+// PdNode runs its input through a PdInstance's patches, as many of libpd's ticks as fill a
+// render quantum, copying its channels straight to and from the ticks' rather than through
+// an interleaved buffer.
+class PdNode : public AudioNode
+{
 public:
-    PureDataNode(AudioContext *, float sampleRate);
-    virtual ~PureDataNode();
+    // A node with an instance of its own
+    PdNode(AudioContext & ac, int inputChannels = 2, int outputChannels = 2);
 
-    static const char* static_name() { return "PureData"; }
-    virtual const char* name() const override { return static_name(); }
+    // A node on the instance's channels from firstInput and firstOutput
+    PdNode(AudioContext & ac, std::shared_ptr<PdInstance> instance, int inputChannels, int outputChannels,
+           int firstInput = 0, int firstOutput = 0);
 
-    pd::PdBase & pd() const;
+    virtual ~PdNode();
 
-    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
-    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    static const char * static_name() { return "Pd"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    PdInstance & pd() const { return *_instance; }
+    std::shared_ptr<PdInstance> instance() const { return _instance; }
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override {}
 
 private:
-    class PureDataNodeInternal;
-    PureDataNodeInternal * data;
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override;
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; }
+
+    std::shared_ptr<PdInstance> _instance;
+    int _firstInput = 0;
+    int _firstOutput = 0;
+    int _inputChannels = 0;
+    int _outputChannels = 0;
 };
 
 }  // end namespace lab
 
-#endif
+#endif  // PD
+
+#endif  // PD_NODE_H
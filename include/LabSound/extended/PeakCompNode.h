@@ -53,6 +53,11 @@ public:
 
     // Knee smoothing (0 = hard, 1 = smooth), default 0
     std::shared_ptr<AudioParam> knee() const;
+
+    // Whether the channels share one detector, following their loudest, and are turned down
+    // together, so that the image of a stereo or surround bus holds still; otherwise each
+    // channel is compressed on its own. Default true
+    std::shared_ptr<AudioSetting> linked() const;
 };
 }
 #endif
@@ -8,15 +8,18 @@
 
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioParam.h"
-#include "LabSound/core/ChannelMergerNode.h"
-#include "LabSound/core/ChannelSplitterNode.h"
+#include "LabSound/core/DelayNode.h"
 #include "LabSound/core/GainNode.h"
-#include "LabSound/extended/BPMDelayNode.h"
 
 namespace lab
 {
 class AudioContext;
+class PingPongDelay;
 
+// A Subgraph is a composite effect between an input and an output gain, which
+// BuildSubgraph wires into the graph. A composite's stages are best fused into a node of
+// its own that keeps the signals between them in its scratch buffers, so that the effect
+// pays one node's scheduling, channel conforming and bus copies rather than one per stage.
 class Subgraph
 {
 public:
@@ -26,20 +29,21 @@ public:
     virtual ~Subgraph() {}
 };
 
+// The ping pong delay averages its input to mono, scales it by the level, and sends it to a
+// left delay line. The left line feeds a right one, which feeds back into the left through
+// the feedback gain, and the two lines are the left and right channels of the wet signal,
+// which is mixed with the dry input at the output. The delay time is a note length at the
+// tempo. The delay lines and their feedback are fused into one node, delay.
 class PingPongDelayNode : public Subgraph
 {
     float tempo;
+    TempoSync delayIndex;
 
-public:
-    std::shared_ptr<BPMDelay> leftDelay;
-    std::shared_ptr<BPMDelay> rightDelay;
-
-    std::shared_ptr<GainNode> splitterGain;
-    std::shared_ptr<GainNode> wetGain;
-    std::shared_ptr<GainNode> feedbackGain;
+    PingPongDelay * pingPong() const;
+    void recomputeDelay();
 
-    std::shared_ptr<ChannelMergerNode> merger;
-    std::shared_ptr<ChannelSplitterNode> splitter;
+public:
+    std::shared_ptr<AudioNode> delay;
 
     PingPongDelayNode(AudioContext &, float tempo);
 
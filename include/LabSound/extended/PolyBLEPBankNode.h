@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef lab_poly_blep_bank_node_h
+#define lab_poly_blep_bank_node_h
+
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/extended/PolyBLEPNode.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class AudioSetting;
+
+// PolyBLEPBankNode renders many PolyBLEP voices of one waveform in a single node, summed
+// into its output, for polyphonic virtual analog patches. Voices are lanes of the bank
+// rather than nodes, so a voice costs a few vector operations a frame. Each voice
+// has its own frequency and amplitude; amplitude changes ramp over a quantum, so
+// voices can be turned on and off without clicks. Envelopes and filters are left to the
+// graph, or the voice amplitudes can be driven from the main thread.
+//
+// The bank supports the waveforms with branch free kernels: triangle, square, rectangle,
+// sawtooth, and ramp.
+//
+// settings: type
+//
+class PolyBLEPBankNode : public AudioScheduledSourceNode
+{
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    virtual bool propagatesSilence(ContextRenderLock & r) const override;
+
+public:
+    // Voices are allocated up front
+    static constexpr int MaxVoices = 256;
+
+    PolyBLEPBankNode(AudioContext & ac);
+    virtual ~PolyBLEPBankNode();
+
+    static const char* static_name() { return "PolyBLEPBank"; }
+    virtual const char* name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    PolyBLEPType type() const;
+    void setType(PolyBLEPType type);  // throws std::out_of_range for waveforms without a kernel
+
+    // Sets a voice's frequency in Hz and amplitude; an amplitude of zero silences it.
+    // May be called from the main thread while the bank renders.
+    void setVoice(int voice, float frequency, float amplitude);
+    void setVoiceFrequency(int voice, float frequency);
+    void setVoiceAmplitude(int voice, float amplitude);
+
+private:
+    std::shared_ptr<AudioSetting> m_type;
+
+    // targets set from the main thread
+    std::vector<std::atomic<float>> m_targetFrequency;
+    std::vector<std::atomic<float>> m_targetAmplitude;
+
+    // lane state, owned by the render thread
+    std::vector<float> m_phase;
+    std::vector<float> m_increment;
+    std::vector<float> m_reciprocalIncrement;
+    std::vector<float> m_amplitude;
+    std::vector<float> m_amplitudeStep;
+    std::vector<float> m_renderTarget;  // the amplitudes the lanes are ramping to this quantum
+};
+
+}  // namespace lab
+
+#endif  // lab_poly_blep_bank_node_h
@@ -68,6 +68,7 @@ public:
     static AudioNodeDescriptor * desc();
 
     virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void processRange(ContextRenderLock &, int bufferSize, int offset, int count) override;
     virtual void reset(ContextRenderLock &) override { }
 
     PolyBLEPType type() const;
@@ -82,6 +83,7 @@ public:
     void processPolyBLEP(ContextRenderLock & r, int bufferSize, int offset, int count);
 
     AudioFloatArray m_amplitudeValues;
+    AudioFloatArray m_phaseValues;
 };
 
 }  // namespace lab
@@ -7,14 +7,23 @@
 
 #include "LabSound/core/AudioArray.h"
 #include "LabSound/extended/AudioContextLock.h"
+#include <atomic>
 #include <vector>
 
 namespace lab
 {
 
 class AudioBus;
-class FFTFrame;
-
+class SpectralAnalysis;
+
+// The audio thread analyses its input when a reader has asked for data since the last
+// analysis, and publishes the result to a triple buffer of snapshots. The get functions
+// read the latest snapshot without locking, allocating, or running an FFT, so the data
+// they return was analysed at the end of a quantum rendered after an earlier call. They
+// are to be called from one thread, usually the main thread.
+//
+// The transform is a SpectralAnalysis hopping a quantum at a time, shared with the other
+// analysers of the same tap and fft size, each of which smooths the spectrum itself.
 class RealtimeAnalyser
 {
 
@@ -38,7 +47,7 @@ public:
     double maxDecibels() const { return m_maxDecibels; }
 
     void setSmoothingTimeConstant(double k) { m_smoothingTimeConstant = k; }
-    double smoothingTimeConstant() const { return m_smoothingTimeConstant; }
+    double smoothingTimeConstant() const { return m_smoothingTimeConstant.load(); }
 
     void getFloatFrequencyData(std::vector<float> &);
     void getFloatTimeDomainData(std::vector<float> &);
@@ -49,7 +58,9 @@ public:
     void getByteFrequencyData(std::vector<uint8_t> &, bool resample);
     void getByteTimeDomainData(std::vector<uint8_t> &);
 
-    void writeInput(ContextRenderLock & r, AudioBus *, int bufferSize);
+    // tap identifies the signal written, so that analysers of one signal share a transform;
+    // see SpectralAnalysis::tapOf
+    void writeInput(ContextRenderLock & r, AudioBus *, int bufferSize, const void * tap = nullptr);
 
     static const double DefaultSmoothingTimeConstant;
     static const double DefaultMinDecibels;
@@ -61,20 +72,50 @@ public:
     static const int InputBufferSize;
 
 private:
-    // The audio thread writes the input audio here.
-    AudioFloatArray m_inputBuffer;
-    int m_writeIndex;
+    // An analysis as published to readers
+    struct Snapshot
+    {
+        AudioFloatArray magnitudes;  // fftSize / 2 smoothed magnitudes
+        AudioFloatArray timeDomain;  // the fftSize frames analysed, oldest first
+    };
+
+    // Called from writeInput; analyses the input if asked to, and publishes a snapshot
+    void publish(bool analyse);
+
+    // The reader's most recent snapshot
+    const Snapshot & latestSnapshot();
 
     int m_fftSize;
-    std::unique_ptr<FFTFrame> m_analysisFrame;
+
+    // The audio thread writes the input audio to its own analysis, or to the one it shares
+    std::shared_ptr<SpectralAnalysis> m_ownAnalysis;
+    std::shared_ptr<SpectralAnalysis> m_analysis;
+    const void * m_tap = nullptr;
+    void makeAnalysis();
+
+    // Smooths the latest spectrum into the magnitude buffer, if it is one not yet smoothed
     void doFFTAnalysis();
+    uint64_t m_smoothedHop = ~uint64_t(0);
 
     // doFFTAnalysis() stores the floating-point magnitude analysis data here.
     AudioFloatArray m_magnitudeBuffer;
     AudioFloatArray & magnitudeBuffer() { return m_magnitudeBuffer; }
 
+    // The audio thread fills the back snapshot and swaps it for the middle one, marking it
+    // fresh; the reader swaps its front snapshot for the middle one when that is fresh.
+    Snapshot m_snapshots[3];
+    int m_backSnapshot = 0;
+    int m_frontSnapshot = 1;
+    std::atomic<int> m_middleSnapshot {2};
+
+    // What readers have asked for since the last publication
+    std::atomic<int> m_requests {0};
+
+    // The reader's scratch for resampled byte data
+    std::vector<uint8_t> m_byteScratch;
+
     // A value between 0 and 1 which averages the previous version of m_magnitudeBuffer with the current analysis magnitude data.
-    double m_smoothingTimeConstant;
+    std::atomic<double> m_smoothingTimeConstant;
 
     // The range used when converting when using getByteFrequencyData().
     double m_minDecibels;
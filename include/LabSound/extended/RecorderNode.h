@@ -6,24 +6,53 @@
 
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioContext.h"
-#include <mutex>
+#include "LabSound/core/AudioDevice.h"
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace lab
 {
 
+class CaptureWriter;
+
+// The files a RecorderNode can stream to. The WAV formats become RF64 files past four
+// gigabytes; raw files are headerless interleaved 32 bit float. FLAC files are lossless,
+// up to eight channels, and are encoded in parallel on the JobSystem as they are recorded.
+enum class RecorderFileFormat
+{
+    WavFloat32 = 0,
+    WavInt16,
+    WavInt24,
+    RawFloat32,
+    FlacInt16,
+    FlacInt24,
+};
+
+// RecorderNode passes its input through, and records it while recording. The render thread
+// only copies each quantum into a fixed ring, without locking or allocating; a writer thread
+// drains the ring, either into memory, from which a recording can be taken as a bus or a
+// WAV file, or straight to a file on disk, so that a recording of any length is made in
+// bounded memory. If the writer falls more than the ring's length behind, whole quanta are
+// dropped and counted rather than stalling the render thread.
 class RecorderNode : public AudioNode
 {
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; } // silence is recorded too
 
-    bool m_recording{false};
+    // created by the first recording, and kept for the node's lifetime, since the render
+    // thread holds on to it without locking
+    std::unique_ptr<CaptureWriter> m_writer;
 
-    std::vector<std::vector<float>> m_data;  // non-interleaved
-    mutable std::recursive_mutex m_mutex;
+    // the recording the render thread tags the quanta it copies with; zero when not recording
+    std::atomic<uint32_t> m_session {0};
 
     float m_sampleRate;
 
+    CaptureWriter & writer();
+
 public:
 
     // create a recorder
@@ -41,8 +70,19 @@ public:
     virtual void process(ContextRenderLock &, int bufferSize) override;
     virtual void reset(ContextRenderLock &) override;
 
-    void startRecording() { m_recording = true; }
-    void stopRecording() { m_recording = false; }
+    // Records into memory, after anything recorded before
+    void startRecording();
+
+    // Streams to a file at path, replacing it; returns false if it can't be created
+    bool startRecordingToFile(const std::string & path, RecorderFileFormat format = RecorderFileFormat::WavFloat32);
+
+    // Stops recording. A file being streamed to is finished and closed before this returns.
+    void stopRecording();
+
+    bool isRecording() const { return m_session.load() != 0; }
+
+    // Quanta the writer could not keep up with, in frames
+    uint64_t droppedFrames() const;
 
     float recordedLengthInSeconds() const;
 
@@ -1,27 +1,32 @@
-#pragma once
-
-#include "LabSound/core/AudioNode.h"
-#include <string>
-#include <vector>
-
-namespace lab {
-
-typedef AudioNode* (*CreateNodeFn)(AudioContext&);
-typedef void (*DeleteNodeFn)(AudioNode*);
-
-class NodeRegistry
-{
-    struct Detail;
-    Detail* _detail;
-    NodeRegistry();
-    ~NodeRegistry();
-
-public:
-    static NodeRegistry& Instance();
-    bool Register(char const*const name, AudioNodeDescriptor*, CreateNodeFn, DeleteNodeFn);
-    std::vector<std::string> Names() const;
-    lab::AudioNode* Create(const std::string& n, lab::AudioContext& ac);
-    AudioNodeDescriptor const * const Descriptor(const std::string & n) const;
-};
-
-} // lab
+#pragma once
+
+#include "LabSound/core/AudioNode.h"
+#include <string>
+#include <vector>
+
+namespace lab {
+
+typedef AudioNode* (*CreateNodeFn)(AudioContext&);
+typedef void (*DeleteNodeFn)(AudioNode*);
+
+class NodeRegistry
+{
+    struct Detail;
+    Detail* _detail;
+    NodeRegistry();
+    ~NodeRegistry();
+
+public:
+    // The registry, which registers LabSound's node types on first use
+    static NodeRegistry& Instance();
+
+    // Registers the node types on the job system, so that the first use needn't wait for them
+    static void Prewarm();
+
+    bool Register(char const*const name, AudioNodeDescriptor*, CreateNodeFn, DeleteNodeFn);
+    std::vector<std::string> Names() const;
+    lab::AudioNode* Create(const std::string& n, lab::AudioContext& ac);
+    AudioNodeDescriptor const * const Descriptor(const std::string & n) const;
+};
+
+} // lab
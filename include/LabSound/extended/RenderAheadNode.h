@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_RENDER_AHEAD_NODE_H
+#define LABSOUND_RENDER_AHEAD_NODE_H
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/ThreadScheduling.h"
+
+#include <functional>
+#include <memory>
+
+namespace lab
+{
+
+// RenderAheadNode plays a graph rendered ahead of time, for sound that needn't answer to the
+// moment, such as music or a scripted cinematic. The graph lives in a context of its own,
+// which a thread of the node's renders quantum by quantum, up to aheadSeconds ahead of the
+// device, into a lock free ring of blocks; the render thread only copies the blocks out. A
+// load spike on the render thread, or on the stream's, is then absorbed by the audio
+// rendered ahead, at the cost of the graph hearing changes that much later.
+//
+// The graph is described by a function that builds it in the given context, starts its
+// sources, and returns the node at its end; a whole scene may be built this way. The
+// stream's context runs at the node's context's rate and quantum, and leads it by the
+// audio rendered ahead, so events are scheduled against streamContext()'s currentTime. Its
+// events are dispatched on the stream's thread. The stream renders only as the node plays
+// it out, and so stands still while the node isn't pulled.
+//
+// The constructor throws std::invalid_argument if there is nothing to build, or the builder
+// returns no node.
+class RenderAheadNode : public AudioNode
+{
+public:
+    using Builder = std::function<std::shared_ptr<AudioNode>(AudioContext &)>;
+
+    RenderAheadNode(AudioContext & ac, Builder build, int channels = 2, double aheadSeconds = 0.1,
+                    const ThreadScheduling & scheduling = {});
+    virtual ~RenderAheadNode();  // stops the stream, and releases its context
+
+    static const char * static_name() { return "RenderAhead"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override {}
+
+    // The context the graph renders in, through which it may be edited, and the end of the graph
+    std::shared_ptr<AudioContext> streamContext() const;
+    std::shared_ptr<AudioNode> root() const;
+
+    // The audio the ring holds, in seconds, which is how far the stream may run ahead
+    double ahead() const;
+
+    // The seconds rendered ahead at the moment
+    double buffered() const;
+
+    // Frames played as silence because the stream had fallen behind
+    uint64_t underrunFrames() const;
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; }
+
+    struct Stream;
+    std::unique_ptr<Stream> _stream;
+};
+
+}  // end namespace lab
+
+#endif
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_RENDER_CACHE_H
+#define LABSOUND_RENDER_CACHE_H
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioBus;
+class AudioContext;
+class AudioNode;
+
+// RenderKey is a 128 bit hash of everything an offline render depends on, added piece by
+// piece: the saved graph, whose bytes hold every node's type, parameter values, automation
+// timelines and settings and the connections among them, and the input assets, which the
+// saved graph leaves out, by their contents. Anything else that changes the result, such as
+// sounds scheduled by the application, or a version of the application's own, should be
+// added too, as the cache can't see it.
+class RenderKey
+{
+public:
+    RenderKey();
+
+    RenderKey & add(const void * data, size_t size);
+    RenderKey & add(const std::string & text);
+    RenderKey & add(uint64_t value);
+    RenderKey & add(double value);
+
+    // The graph as SaveGraph saves it
+    RenderKey & addGraph(AudioContext & ac, const std::vector<std::shared_ptr<AudioNode>> & nodes);
+
+    // An asset by its samples and rate, and a file by its contents, wherever it lies.
+    // Returns false, adding the failure, if the file can't be read.
+    RenderKey & addBus(const AudioBus & bus);
+    bool addFile(const std::string & path);
+
+    // 32 hex digits
+    std::string toString() const;
+
+    bool operator==(const RenderKey & other) const { return m_high == other.m_high && m_low == other.m_low && m_length == other.m_length; }
+    bool operator!=(const RenderKey & other) const { return !(*this == other); }
+
+private:
+    uint64_t m_high;
+    uint64_t m_low;
+    uint64_t m_length = 0;  // bytes added
+};
+
+// RenderCache keeps offline renders in a directory, each in a file named by its key, so that
+// a render asked for again, by this process or a later one, is read back rather than
+// rendered. Files are written under another name and renamed once complete, so that
+// processes sharing the directory never read a partial render, and the cache can be
+// cleared by deleting them.
+class RenderCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t failedStores = 0;
+    };
+
+    // An existing directory
+    explicit RenderCache(const std::string & directory);
+
+    // The render stored for key, or null
+    std::shared_ptr<AudioBus> find(const RenderKey & key);
+
+    // Returns false if the render couldn't be written
+    bool store(const RenderKey & key, const AudioBus & render);
+
+    // The first frames of context's render, read back if they are stored, otherwise rendered
+    // and stored. context is an offline context whose graph is built and whose destination
+    // node is set; frames and its sample rate are added to the key. Returns null if the
+    // render fails, or is longer than a bus can hold.
+    std::shared_ptr<AudioBus> render(const RenderKey & key, std::shared_ptr<AudioContext> context, uint64_t frames, int chunkFrames = 0);
+
+    const std::string & directory() const { return m_directory; }
+    Stats stats() const;
+
+private:
+    std::string path(const RenderKey & key) const;
+
+    std::string m_directory;
+    std::atomic<uint64_t> m_hits {0};
+    std::atomic<uint64_t> m_misses {0};
+    std::atomic<uint64_t> m_failedStores {0};
+};
+
+}  // lab
+
+#endif  // LABSOUND_RENDER_CACHE_H
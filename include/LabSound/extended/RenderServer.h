@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_RENDER_SERVER_H
+#define LABSOUND_RENDER_SERVER_H
+
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/ThreadScheduling.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+class AudioBus;
+class AudioContext;
+class AudioDevice_External;
+
+enum class StreamPacing
+{
+    Realtime,  // a block each block period, as a device would take it
+    Offline    // as fast as the server's share allows
+};
+
+struct RenderStream
+{
+    // A context whose destination node's device is an AudioDevice_External, so that it
+    // starts no threads of its own, with its graph built
+    std::shared_ptr<AudioContext> context;
+    std::shared_ptr<AudioDevice_External> device;
+
+    StreamPacing pacing = StreamPacing::Realtime;
+    int blockFrames = 0;      // frames rendered at a time; zero is the context's render quantum
+    uint64_t frames = 0;      // frames to render before the stream ends; zero is unbounded
+    uint64_t tenant = 0;      // the account the stream's time and memory are charged to
+    float weight = 1.f;       // an offline stream's share relative to other offline streams
+
+    // Receives each block; returning false ends the stream. Called on a worker.
+    OfflineRenderSink sink;
+};
+
+struct RenderAccount
+{
+    int streams = 0;
+    uint64_t blocks = 0;
+    uint64_t frames = 0;
+    double cpuSeconds = 0;        // spent rendering and in sinks
+    uint64_t missedDeadlines = 0; // realtime blocks finished after their period ended
+    int64_t memoryBytes = 0;      // the server's buffers, and whatever was attributed
+};
+
+// RenderServer renders many contexts, such as per-listener streams on a server, on one
+// pool of workers rather than a device and update thread apiece.
+//
+// Realtime paced streams are released a block period apart and rendered earliest deadline
+// first, a block's deadline being the end of its period. Offline streams fill the time the
+// realtime ones leave, in proportion to their weights, the one that has used the least
+// weighted time going next. Each stream is rendered by one worker at a time, and its
+// context's events are dispatched on that worker between blocks.
+//
+// Time and memory are accounted per stream and per tenant with a clock read and a few
+// additions per block. Memory the server can't see, such as a tenant's sample assets,
+// may be attributed to a tenant with attributeMemory().
+class RenderServer
+{
+public:
+    using StreamId = uint64_t;
+
+    struct Settings
+    {
+        int workerCount = 0;  // zero is one per hardware thread
+        ThreadScheduling scheduling;
+    };
+
+    RenderServer();
+    explicit RenderServer(const Settings & settings);
+    ~RenderServer();  // ends every stream, and stops the workers
+
+    RenderServer(const RenderServer &) = delete;
+    RenderServer & operator=(const RenderServer &) = delete;
+
+    // Starts the stream's device and schedules its first block; returns 0 if the stream has
+    // no context, device or sink
+    StreamId add(const RenderStream & stream);
+
+    // Ends a stream, waiting for a block in progress to finish
+    void remove(StreamId id);
+
+    bool isActive(StreamId id) const;
+
+    RenderAccount streamAccount(StreamId id) const;
+    RenderAccount tenantAccount(uint64_t tenant) const;
+
+    // Charges, or with a negative count refunds, memory to a tenant
+    void attributeMemory(uint64_t tenant, int64_t bytes);
+
+    int workerCount() const { return static_cast<int>(_workers.size()); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stream
+    {
+        RenderStream settings;
+        std::unique_ptr<AudioBus> bus;
+        std::vector<float *> channels;
+        Clock::duration period {};   // of a block
+        Clock::time_point release;   // when the next realtime block may start; it is due a period later
+        double virtualTime = 0;      // an offline stream's weighted time used
+        uint64_t rendered = 0;
+        bool busy = false;
+        bool ended = false;
+        RenderAccount account;
+    };
+
+    void workerLoop(const ThreadScheduling & scheduling);
+    Stream * pick(Clock::time_point now, Clock::time_point & wakeAt);  // the lock is held
+    void charge(uint64_t tenant, const RenderAccount & delta);         // the lock is held
+
+    std::map<StreamId, std::unique_ptr<Stream>> _streams;
+    std::map<uint64_t, RenderAccount> _tenants;
+    StreamId _nextId = 1;
+    double _offlineClock = 0;  // the least virtual time among offline streams when last picked
+
+    std::vector<std::thread> _workers;
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;      // a stream was added, or a block finished
+    bool _shouldExit = false;
+};
+
+}  // lab
+
+#endif  // LABSOUND_RENDER_SERVER_H
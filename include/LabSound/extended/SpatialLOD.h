@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_SPATIAL_LOD_H
+#define LABSOUND_SPATIAL_LOD_H
+
+#include "LabSound/core/PannerNode.h"
+
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+
+// SpatialLOD assigns spatialization tiers to a set of panners, so that the expensive tiers
+// go to the sources that benefit from them most.
+//
+// Each update, the sources are ranked by audibility, which is their panner's distance and
+// cone gain times a weight the application gives them, such as their loudness or
+// importance. In order of audibility, each takes the best tier that its distance allows
+// and that the remaining budget can pay for; sources too quiet to hear, or that the budget
+// runs out before, are virtualized. A source keeps its tier against a slightly more
+// audible one, so that sources of similar audibility don't trade tiers back and forth.
+// With a target load, the budget shrinks while the context's render time exceeds that
+// share of each quantum, and recovers once it doesn't.
+class SpatialLOD
+{
+public:
+    struct Settings
+    {
+        // the cost of a source at each tier, in arbitrary units, and the units to spend
+        float hrtfCost = 16.f;
+        float binauralCost = 2.f;
+        float equalPowerCost = 1.f;
+        float budget = 128.f;
+
+        // sources further from the listener than these don't get the tier
+        float hrtfDistance = 20.f;
+        float binauralDistance = 100.f;
+
+        float cullGain = 0.001f;    // sources quieter than this (-60 dB) are virtualized
+        float hysteresis = 0.25f;   // how much more audible a source must be to take a tier from another
+        float targetLoad = 0.f;     // a fraction of the quantum's duration; zero ignores the load
+    };
+
+    SpatialLOD() = default;
+    explicit SpatialLOD(const Settings & settings) : _settings(settings) {}
+
+    Settings & settings() { return _settings; }
+
+    // A panner managed here has its tier set by update(); a panner that is removed, or that
+    // has been destroyed, is forgotten. Removing a panner returns it to its panning model.
+    void add(std::shared_ptr<PannerNode> panner, float weight = 1.f);
+    void remove(const std::shared_ptr<PannerNode> & panner);
+    void setWeight(const std::shared_ptr<PannerNode> & panner, float weight);
+
+    // Main thread, regularly. Assigns the tiers.
+    void update(AudioContext & ac);
+
+    // the share of the budget in use after load adaptation, from 0 to 1
+    float budgetScale() const { return _budgetScale; }
+
+private:
+    struct Source
+    {
+        std::weak_ptr<PannerNode> panner;
+        float weight = 1.f;
+        SpatialTier tier = SpatialTier::Model;
+        float score = 0;
+        float distance = 0;
+    };
+
+    Settings _settings;
+    std::vector<Source> _sources;
+    std::vector<Source *> _ranked;
+    std::vector<float> _positions;  // x, then y, then z, of every source
+    std::vector<float> _distances;
+    float _budgetScale = 1.f;
+};
+
+}  // lab
+
+#endif  // LABSOUND_SPATIAL_LOD_H
@@ -7,7 +7,12 @@
 #define SPATIALIZATION_NODE_H
 
 #include "LabSound/core/PannerNode.h"
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace lab
 {
@@ -53,14 +58,49 @@ struct Occluder
     }
 };
 
+// Occluders attenuate a source when the line from it to the listener passes near them.
+// They're filed in a uniform grid of cubic cells cellSize across, so that finding the
+// occluders near a line visits only the cells it crosses, and setting or removing an
+// occluder updates only the cells it covers. Occluders too large for the grid to help
+// with are tested against every line. Every edit advances the revision, so that a source
+// can keep its occlusion until either the geometry or the positions change.
 class Occluders
 {
-    std::map<int, Occluder> occluders;
-
 public:
+    explicit Occluders(float cellSize = 8.f);
+
     void setOccluder(int id, float x, float y, float z, float radius);
     void removeOccluder(int id);
     float occlusion(const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos) const;
+
+    uint64_t revision() const { return m_revision; }
+
+private:
+    struct Entry
+    {
+        Occluder occluder;
+        mutable uint32_t visit = 0;  // the last query that tested it
+    };
+
+    struct CellRange
+    {
+        int x0, y0, z0, x1, y1, z1;
+        bool large;
+    };
+
+    CellRange cellsCovered(const Occluder & o) const;
+    void file(int id, const Occluder & o);
+    void unfile(int id, const Occluder & o);
+    static void attenuate(const Occluder & o, const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos, float & attenuation);
+
+    float m_cellSize;
+    std::map<int, Entry> occluders;
+    std::unordered_map<uint64_t, std::vector<int>> m_cells;
+    std::vector<int> m_large;
+
+    mutable std::mutex m_mutex;
+    mutable uint32_t m_visit = 0;
+    std::atomic<uint64_t> m_revision{0};
 };
 
 typedef std::shared_ptr<Occluders> OccludersPtr;
@@ -70,6 +110,13 @@ class SpatializationNode : public PannerNode
     virtual float distanceConeGain(ContextRenderLock & r);
     std::shared_ptr<Occluders> occluders;
 
+    // the occlusion last computed, and what it was computed from
+    const Occluders * m_cachedOccluders = nullptr;
+    uint64_t m_cachedRevision = 0;
+    FloatPoint3D m_cachedSource;
+    FloatPoint3D m_cachedListener;
+    float m_cachedOcclusion = 1.f;
+
 public:
     SpatializationNode(AudioContext & ac);
     virtual ~SpatializationNode() = default;
@@ -15,7 +15,11 @@
 namespace lab
 {
 // params:
-// settings: windowSize
+// settings: windowSize, hopSize
+//
+// Analyses its input with windowSize frames windows, overlapping unless hopSize, the frames
+// between the starts of successive windows, is zero or at least windowSize. Monitors and
+// analysers tapping the same output with the same sizes share one FFT per hop.
 class SpectralMonitorNode : public AudioBasicInspectorNode
 {
     class SpectralMonitorNodeInternal;
@@ -32,9 +36,14 @@ public:
     virtual void process(ContextRenderLock &, int bufferSize) override;
     virtual void reset(ContextRenderLock &) override;
 
+    // one magnitude per frequency bin, from DC up to but not including nyquist, of the
+    // average of the input channels. The spectrum is the latest published since the
+    // previous call, as a call asks for the spectrum of the next hop.
     void spectralMag(std::vector<float> & result);
     void windowSize(unsigned int ws);
     unsigned int windowSize() const;
+    void hopSize(unsigned int hs);
+    unsigned int hopSize() const;
 
 private:
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef SPECTRAL_PROCESSOR_NODE_H
+#define SPECTRAL_PROCESSOR_NODE_H
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioSetting.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+// One hop's spectra, a spectrum for each channel. Each has binCount = fftSize / 2 + 1
+// complex bins, from DC to nyquist, as real and imaginary arrays, unscaled: a bin holds the
+// sum of the windowed frame's samples against its frequency. They are the same on every FFT
+// backend. A processor changes them in place, and they are resynthesized.
+struct SpectralBlock
+{
+    int fftSize = 0;
+    int hopSize = 0;
+    int binCount = 0;
+    int channels = 0;
+    float sampleRate = 0;
+    uint64_t hop = 0;  // the number of hops before this one
+
+    float * const * real = nullptr;
+    float * const * imag = nullptr;
+};
+
+// The DSP of a SpectralProcessorNode, which sees the spectra of each hop, all channels at once
+class SpectralProcessor
+{
+public:
+    virtual ~SpectralProcessor() = default;
+
+    // Audio thread, before the first hop, and again whenever the sizes change, before the
+    // first hop of the new sizes. It may allocate whatever process() will need.
+    virtual void prepare(float sampleRate, int fftSize, int hopSize, int channels) {}
+
+    // Audio thread, once a hop
+    virtual void process(ContextRenderLock & r, const SpectralBlock & block) = 0;
+
+    virtual void reset() {}
+};
+
+// SpectralProcessorNode is the plumbing of a short time Fourier transform effect: it windows
+// its input every hop, transforms each channel, hands the spectra to a SpectralProcessor, or
+// to a subclass's processSpectrum, and overlap-adds their inverse transforms into its output.
+// Denoisers, spectral gates, vocoders and freezes are then only the changes they make to bins.
+//
+// The window's table is shared, and the FFT plans are made once per size, for every node. The
+// synthesis window is the analysis window normalized so that the overlapping windows' squares
+// sum to one, so that the node is transparent while its spectra are left alone, whatever the
+// window and overlap. The output is fftSize frames late.
+//
+// The node has as many output channels as its input, up to MaxChannels.
+//
+// settings: fftSize, overlap, window
+//
+class SpectralProcessorNode : public AudioNode
+{
+public:
+    SpectralProcessorNode(AudioContext & ac);  // passes its input through, fftSize frames late
+    SpectralProcessorNode(AudioContext & ac, std::unique_ptr<SpectralProcessor> processor, int fftSize = 1024, int overlap = 4);
+    virtual ~SpectralProcessorNode();
+
+    static const char * static_name() { return "SpectralProcessor"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    static const int MaxChannels = 8;
+
+    SpectralProcessor * processor() const { return _processor.get(); }
+
+    // A power of two from 32 to 32768, default 1024
+    std::shared_ptr<AudioSetting> fftSize() const { return _fftSize; }
+
+    // The number of frames each sample is in, and so fftSize / hop: 1, 2, 4, 8 or 16, default 4
+    std::shared_ptr<AudioSetting> overlap() const { return _overlap; }
+
+    // One of WindowFunction, default hann
+    std::shared_ptr<AudioSetting> window() const { return _window; }
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override;
+    virtual void reset(ContextRenderLock & r) override;
+
+protected:
+    // Audio thread. The spectra of each hop, which the processor changes by default.
+    virtual void processSpectrum(ContextRenderLock & r, const SpectralBlock & block);
+
+    // Audio thread. Called where the processor's prepare would be.
+    virtual void prepareSpectrum(float sampleRate, int fftSize, int hopSize, int channels);
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override;
+    virtual double latencyTime(ContextRenderLock & r) const override;
+
+    struct Channel;
+
+    void configure(float sampleRate, int fftSize, int hopSize, int windowType, int channels);
+    void analyseAndResynthesize(ContextRenderLock & r);
+
+    std::unique_ptr<SpectralProcessor> _processor;
+    std::shared_ptr<AudioSetting> _fftSize;
+    std::shared_ptr<AudioSetting> _overlap;
+    std::shared_ptr<AudioSetting> _window;
+
+    // as configured on the audio thread
+    float _sampleRate = 0;
+    int _size = 0;
+    int _hopSize = 0;
+    int _windowType = -1;
+    int _fill = 0;  // frames of the current hop taken in
+    uint64_t _hops = 0;
+
+    const float * _analysis = nullptr;  // the shared window table
+    AudioFloatArray _synthesis;
+    std::vector<std::unique_ptr<Channel>> _channels;
+    std::vector<float *> _real;
+    std::vector<float *> _imag;
+};
+
+}  // namespace lab
+
+#endif  // SPECTRAL_PROCESSOR_NODE_H
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_STEM_RECORDER_H
+#define LABSOUND_STEM_RECORDER_H
+
+#include "LabSound/extended/RecorderNode.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+class AudioBus;
+class AudioContext;
+class AudioNode;
+class CaptureWriter;
+
+// StemRecorder records the outputs of any nodes in a graph, side by side, as the tracks of
+// a single multichannel recording, without adding nodes to the graph or changing how it
+// renders. At the end of each render quantum, once every node has rendered, each tapped
+// output is copied into one interleaved frame of every track, so the tracks stay sample
+// aligned; the frames are handed to a writer thread as a RecorderNode's are.
+//
+// Taps may instead be recorded as stems, each to a file of its own, or, when rendering
+// offline, straight into buses allocated beforehand, so that every stem of a mix is
+// exported in one render of the graph rather than one render per stem.
+//
+// A tap records silence for any quantum in which its node wasn't rendered, because nothing
+// downstream of it was.
+class StemRecorder
+{
+public:
+    explicit StemRecorder(AudioContext & context);
+    ~StemRecorder();
+
+    StemRecorder(const StemRecorder &) = delete;
+    StemRecorder & operator=(const StemRecorder &) = delete;
+
+    // Taps a node's output, to be recorded on the next tracks; returns the first of them.
+    // A tap of zero channels records as many as the output has when recording starts.
+    // The name is the stem's file name, without extension; unnamed taps are stem1, stem2,
+    // and so on. Taps can't be changed while recording.
+    int addTap(std::shared_ptr<AudioNode> node, int outputIndex = 0, int channels = 0, const std::string & name = {});
+    void clearTaps();
+    int tapCount() const { return static_cast<int>(m_taps.size()); }
+    std::string tapName(int tap) const;
+
+    // Records every tap into memory
+    bool startRecording();
+
+    // Streams every tap to a file at path, replacing it; returns false if it can't be created
+    bool startRecordingToFile(const std::string & path, RecorderFileFormat format = RecorderFileFormat::WavFloat32);
+
+    // Streams each tap to its own file in directory, named for the tap, replacing any there;
+    // returns false, recording nothing, if one can't be created
+    bool startRecordingStems(const std::string & directory, RecorderFileFormat format = RecorderFileFormat::WavFloat32);
+
+    // Records each tap into the bus of the same index, from its first frame, on the audio
+    // thread itself; recording into a bus stops once it is full. Meant for offline
+    // rendering, where there is no deadline to keep. A bus with fewer channels than its tap
+    // records the first of them. The buses are not to be read until recording stops.
+    bool startRecordingInto(const std::vector<std::shared_ptr<AudioBus>> & buses);
+
+    // Stops recording. A file being streamed to is finished and closed before this returns.
+    void stopRecording();
+
+    bool isRecording() const;
+
+    // The tracks of the current or last recording
+    int trackCount() const { return m_trackCount; }
+
+    // Quanta the writer could not keep up with, in frames
+    uint64_t droppedFrames() const;
+
+    // Frames recorded into the buses of startRecordingInto
+    uint64_t framesRecordedInto() const;
+
+    // Takes the recording made in memory, one channel per track
+    std::unique_ptr<AudioBus> createBusFromRecording();
+
+private:
+    struct Tap
+    {
+        std::shared_ptr<AudioNode> node;
+        int outputIndex;
+        int channels;
+        std::string name;
+    };
+
+    struct Capture;
+
+    enum class Destination
+    {
+        Memory,
+        File,
+        Stems,
+        Buses,
+    };
+
+    bool start(Destination destination, const std::string & path, RecorderFileFormat format,
+               const std::vector<std::shared_ptr<AudioBus>> & buses);
+
+    AudioContext * m_context;
+    std::vector<Tap> m_taps;
+    int m_trackCount = 0;
+
+    // writers and a capture are made for each recording, since the audio thread may hold
+    // on to the last until its next quantum; there is a writer for every stem, or one for
+    // all the tracks
+    std::vector<std::shared_ptr<CaptureWriter>> m_writers;
+    std::shared_ptr<Capture> m_capture;
+    uint64_t m_busFrames = 0;  // of the last recording into buses
+};
+
+}  // lab
+
+#endif  // LABSOUND_STEM_RECORDER_H
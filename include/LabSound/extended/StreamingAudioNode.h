@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef STREAMING_AUDIO_NODE_H
+#define STREAMING_AUDIO_NODE_H
+
+#include "LabSound/core/AudioScheduledSourceNode.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lab
+{
+
+// StreamingAudioNode plays a file from disk, rather than from memory as SampledAudioNode
+// does, so that long files can be played without decoding them whole. A background thread
+// reads ahead of the play position into a fixed set of blocks, which bounds the memory a
+// voice uses to the prefetch duration; the render thread consumes the blocks without
+// locking. Files at another sample rate than the context's are converted as they are read.
+//
+// Uncompressed WAV files are streamed; see PCMFileReader for the sample formats.
+//
+class StreamingAudioNode : public AudioScheduledSourceNode
+{
+    struct Controls;
+    struct Stream;
+
+    std::shared_ptr<Controls> m_controls;
+    std::unique_ptr<Stream> m_active;   // used by the render thread
+    std::unique_ptr<Stream> m_pending;  // set by the main thread, picked up by the render thread
+    std::unique_ptr<Stream> m_retired;  // given up by the render thread, released by the main thread
+    std::mutex m_streamMutex;
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    virtual bool propagatesSilence(ContextRenderLock & r) const override;
+
+public:
+    StreamingAudioNode(AudioContext & ac);
+    virtual ~StreamingAudioNode();
+
+    static const char * static_name() { return "StreamingAudio"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    // Opens a file to stream from its start, replacing any current one, with
+    // prefetchSeconds of audio read ahead. Returns false if the file can't be streamed.
+    bool setFile(const std::string & path, double prefetchSeconds = 2.0);
+
+    // The open file's properties; zero if there is none
+    int channelCount() const;
+    float fileSampleRate() const;
+    double duration() const;
+
+    // Moves the play position. Playback resumes from there once the reader has caught
+    // up, which is usually well within a quantum or two.
+    void seek(double seconds);
+
+    // The position, in seconds in the file, of the most recently rendered frame
+    double position() const;
+
+    // When looping, playback returns to loopStart on reaching loopEnd; a loopEnd of zero
+    // is the end of the file. Changes apply to audio that hasn't been read ahead yet.
+    void setLoop(bool loop);
+    void setLoopPoints(double loopStart, double loopEnd);
+    bool loop() const;
+
+    // Quanta that found no audio read ahead, because the disk couldn't keep up
+    uint64_t underruns() const;
+};
+
+}  // namespace lab
+
+#endif
@@ -29,7 +29,8 @@ public:
     std::shared_ptr<AudioParam> frequency() const;
     std::shared_ptr<AudioParam> detune() const;
 
-    void update(ContextRenderLock & r);  // call if sawCount is changed. CBB: update automatically
+    // sawCount and detune are picked up as the node renders; this applies them immediately
+    void update(ContextRenderLock & r);
 
 private:
     virtual void process(ContextRenderLock &, int bufferSize) override;
@@ -6,6 +6,7 @@
 #define VectorMath_h
 
 #include <cstddef>
+#include <cstdint>
 
 // Defines the interface for several vector math functions whose implementation will ideally be optimized.
 
@@ -31,12 +32,31 @@ namespace VectorMath
     // For an element-by-element multiply of two float vectors.
     void vmul(const float * source1P, int sourceStride1, const float * source2P, int sourceStride2, float * destP, int destStride, int framesToProcess);
 
+    // Multiplies two float vectors element by element, and adds the products to destP.
+    void vmadd(const float * source1P, int sourceStride1, const float * source2P, int sourceStride2, float * destP, int destStride, int framesToProcess);
+
     // Multiplies two complex vectors.
     void zvmul(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess);
 
+    // Multiplies two complex vectors, and adds the products to the destination.
+    void zvmadd(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess);
+
+    // Multiplies a complex vector by a half precision one whose values are multiplied by
+    // scale2, and adds the products to the destination.
+    void zvmaddh(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P, float scale2, float * realDestP, float * imagDestP, int framesToProcess);
+
+    // Converts to and from IEEE half precision, multiplying by scale on the way. Conversion
+    // to half precision rounds to nearest, and clamps magnitudes beyond its range to its
+    // largest value.
+    void vtohalf(const float * sourceP, float scale, uint16_t * destP, int framesToProcess);
+    void vfromhalf(const uint16_t * sourceP, float scale, float * destP, int framesToProcess);
+
     // Copies elements while clipping values to the threshold inputs.
     void vclip(const float * sourceP, int sourceStride, const float * lowThresholdP, const float * highThresholdP, float * destP, int destStride, int framesToProcess);
 
+    // Computes tanh(scale * x) for each element, to within a few units in the last place.
+    void vtanh(const float * sourceP, float scale, float * destP, int framesToProcess);
+
 }  // namespace VectorMath
 
 }  // namespace lab
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LABSOUND_VOICE_POOL_H
+#define LABSOUND_VOICE_POOL_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace lab
+{
+class AudioContext;
+class AudioNode;
+class AudioScheduledSourceNode;
+class GainNode;
+class PowerMonitorNode;
+
+// VoicePool builds a fixed number of voices up front, connects them once, and hands them
+// out for notes, so that starting a note allocates nothing and doesn't wait on the
+// graph's pending connections. Voices return to the pool when their source's onEnded is
+// dispatched; when every voice is busy, one is stolen according to the policy.
+//
+// The pool sets the onEnded callback of each voice's source, so it shouldn't be replaced.
+// The pool is used from the main thread, as is the rest of the graph's interface.
+//
+class VoicePool
+{
+public:
+    struct Voice
+    {
+        std::shared_ptr<AudioScheduledSourceNode> source;  // whose ending frees the voice
+        std::shared_ptr<AudioNode> output;                 // the end of the voice's chain
+        std::vector<std::shared_ptr<AudioNode>> nodes;     // any other nodes in the chain, kept alive by the pool
+    };
+
+    typedef std::function<Voice(AudioContext &)> VoiceFactory;
+
+    enum class StealPolicy
+    {
+        None,           // claim fails if every voice is busy
+        Oldest,         // steal the voice claimed longest ago
+        Quietest,       // steal the voice with the lowest output power
+        LowestPriority, // steal the oldest of the lowest priority voices, if it is below the claim's
+    };
+
+    VoicePool(AudioContext & ac, int voiceCount, VoiceFactory factory, StealPolicy policy = StealPolicy::Oldest);
+    ~VoicePool();
+
+    VoicePool(const VoicePool &) = delete;
+    VoicePool & operator=(const VoicePool &) = delete;
+
+    // Every voice is mixed into this node, which is to be connected into the graph.
+    std::shared_ptr<GainNode> output() const { return m_output; }
+
+    // Claims a voice for a note and returns its index, or -1 if none could be had. The
+    // caller then sets up and starts the voice's source. A stolen SampledAudioNode's
+    // schedules are cleared, and a stolen source's pending stop is cancelled.
+    int claim(float priority = 0);
+
+    // Returns a voice to the pool without waiting for its source to end
+    void release(int index);
+
+    Voice & voice(int index) { return m_voices[index].voice; }
+    int voiceCount() const { return static_cast<int>(m_voices.size()); }
+    int busyCount() const;
+    bool isBusy(int index) const;
+
+    // The number of voices stolen since the pool was made
+    uint64_t steals() const { return m_steals; }
+
+    StealPolicy policy() const { return m_policy; }
+    void setPolicy(StealPolicy policy) { m_policy = policy; }
+
+private:
+    struct Slot
+    {
+        Voice voice;
+        std::shared_ptr<PowerMonitorNode> monitor;  // measures the voice's output
+        std::shared_ptr<std::atomic<uint64_t>> ended;  // counts the source's onEnded events
+        uint64_t endedAtClaim = 0;
+        uint64_t claimSerial = 0;
+        float priority = 0;
+        bool claimed = false;
+    };
+
+    void steal(Slot & slot);
+
+    AudioContext & m_context;
+    std::shared_ptr<GainNode> m_output;
+    std::vector<Slot> m_voices;
+    StealPolicy m_policy;
+    uint64_t m_serial = 0;
+    uint64_t m_steals = 0;
+};
+
+}  // lab
+
+#endif  // LABSOUND_VOICE_POOL_H
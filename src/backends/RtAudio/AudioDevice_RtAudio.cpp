@@ -4,6 +4,7 @@
 #include "LabSound/backends/AudioDevice_RtAudio.h"
 
 #include "internal/Assertions.h"
+#include "internal/SampleConversion.h"
 
 #include "LabSound/core/AudioDevice.h"
 #include "LabSound/core/AudioNode.h"
@@ -13,6 +14,8 @@
 
 #include "RtAudio.h"
 
+#include <algorithm>
+
 namespace lab
 {
 
@@ -27,15 +30,75 @@ int rt_audio_callback(
     RtAudioStreamStatus status, void * userData)
 {
     AudioDevice_RtAudio * device = reinterpret_cast<AudioDevice_RtAudio *>(userData);
+    if (status & (RTAUDIO_INPUT_OVERFLOW | RTAUDIO_OUTPUT_UNDERFLOW))
+        device->reportXrun();
+
     float * fltOutputBuffer = reinterpret_cast<float *>(outputBuffer);
     memset(fltOutputBuffer, 0, nBufferFrames * device->getOutputConfig().desired_channels * sizeof(float));
     device->render(device->sourceProvider(), nBufferFrames, fltOutputBuffer, inputBuffer);
     return 0;
 }
 
+namespace
+{
+    // RtAudio's apis, in the order of AudioApi; those it has no equivalent of are unspecified
+    const RtAudio::Api kApis[] = {
+        RtAudio::UNSPECIFIED,
+        RtAudio::WINDOWS_WASAPI,
+        RtAudio::WINDOWS_ASIO,
+        RtAudio::WINDOWS_DS,
+        RtAudio::MACOSX_CORE,
+        RtAudio::LINUX_ALSA,
+        RtAudio::LINUX_PULSE,
+        RtAudio::UNIX_JACK,
+        RtAudio::LINUX_OSS,
+        RtAudio::UNSPECIFIED,
+        RtAudio::UNSPECIFIED,
+    };
+
+    RtAudio::Api toRtApi(AudioApi api)
+    {
+        const RtAudio::Api rtApi = kApis[static_cast<int>(api)];
+        if (api == AudioApi::Default)
+            return rtApi;
+
+        std::vector<RtAudio::Api> compiled;
+        RtAudio::getCompiledApi(compiled);
+        if (rtApi == RtAudio::UNSPECIFIED || std::find(compiled.begin(), compiled.end(), rtApi) == compiled.end())
+        {
+            LOG_ERROR("[AudioDevice_RtAudio] the requested api is not compiled in, using the default");
+            return RtAudio::UNSPECIFIED;
+        }
+        return rtApi;
+    }
+
+    AudioApi fromRtApi(RtAudio::Api rtApi)
+    {
+        for (int i = 1; i < static_cast<int>(sizeof(kApis) / sizeof(kApis[0])); ++i)
+            if (kApis[i] == rtApi)
+                return static_cast<AudioApi>(i);
+        return AudioApi::Default;
+    }
+
+    // Makes the context on the api, replacing one made on another; device indices are
+    // particular to the api
+    void useApi(RtAudio::Api api)
+    {
+        if (g_rtaudio_ctx && api != RtAudio::UNSPECIFIED && g_rtaudio_ctx->getCurrentApi() != api)
+        {
+            if (g_rtaudio_ctx->isStreamOpen())
+                g_rtaudio_ctx->closeStream();
+            delete g_rtaudio_ctx;
+            g_rtaudio_ctx = nullptr;
+        }
+        if (!g_rtaudio_ctx)
+            g_rtaudio_ctx = new RtAudio(api);
+    }
+}
+
 // static
 std::vector<AudioDeviceInfo>
-AudioDevice_RtAudio::MakeAudioDeviceList() 
+AudioDevice_RtAudio::MakeAudioDeviceList(AudioApi api)
 {
     std::vector<std::string> rt_audio_apis {
         "unspecified",
@@ -49,8 +112,7 @@ AudioDevice_RtAudio::MakeAudioDeviceList()
         "windows_directsound",
         "rtaudio_dummy" };
 
-    if (!g_rtaudio_ctx)
-        g_rtaudio_ctx = new RtAudio();
+    useApi(toRtApi(api));
 
     if (g_rtaudio_ctx->getDeviceCount() <= 0)
         throw std::runtime_error("no rtaudio devices available!");
@@ -103,9 +165,8 @@ const bool kInterleaved = false;
 
 void AudioDevice_RtAudio::createContext()
 {
-    if (!g_rtaudio_ctx)
-        g_rtaudio_ctx = new RtAudio();
-    
+    useApi(toRtApi(_outConfig.api));
+
     if (g_rtaudio_ctx->getDeviceCount() < 1)
     {
         LOG_ERROR("no audio devices available");
@@ -161,12 +222,29 @@ void AudioDevice_RtAudio::createContext()
     RtAudio::StreamOptions options;
     // RTAUDIO_MINIMIZE_LATENCY tells RtAudio to use the hardware's minimum buffer size
     // which is not desirable as the minimum way be too small, and a non-power of 2.
+    // The buffer is a render quantum instead, and periods asks for fewer of them.
     //options.flags = RTAUDIO_MINIMIZE_LATENCY;
     if (!kInterleaved) options.flags |= RTAUDIO_NONINTERLEAVED;
+    options.numberOfBuffers = _outConfig.periods;
+
+    // RtAudio's WASAPI and DirectSound only share the device, and ASIO always owns it
+    const RtAudio::Api api = g_rtaudio_ctx->getCurrentApi();
+    const bool canHog = api == RtAudio::MACOSX_CORE || api == RtAudio::LINUX_ALSA || api == RtAudio::LINUX_OSS;
+    if (_outConfig.exclusive && canHog)
+        options.flags |= RTAUDIO_HOG_DEVICE;
+    else if (_outConfig.exclusive && api != RtAudio::WINDOWS_ASIO)
+        LOG_INFO("[AudioDevice_RtAudio] exclusive use is unavailable through this api, sharing the device");
+
+    // the callback threads RtAudio starts itself (ALSA, Pulse, OSS) are made realtime where
+    // the process may; otherwise they run as normal threads
+    options.flags |= RTAUDIO_SCHEDULE_REALTIME;
 
     // Note! RtAudio has a hard limit on a power of two buffer size, non-power of two sizes will result in
     // heap corruption, for example, when dac.stopStream() is invoked.
-    uint32_t bufferFrames = AudioNode::ProcessingSizeInFrames;
+    uint32_t bufferFrames = _bufferFrames;
+    if (_outConfig.period_frames && _outConfig.period_frames != _bufferFrames)
+        LOG_INFO("[AudioDevice_RtAudio] buffers are a render quantum of %u frames; %u frame periods were requested",
+                 _bufferFrames, _outConfig.period_frames);
 
     samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
 
@@ -186,6 +264,21 @@ void AudioDevice_RtAudio::createContext()
     {
         LOG_ERROR(e.getMessage().c_str());
     }
+
+    if (bufferFrames != _bufferFrames)
+        LOG_INFO("[AudioDevice_RtAudio] requested %u frames per buffer, the device uses %u", _bufferFrames, bufferFrames);
+
+    if (!g_rtaudio_ctx->isStreamOpen())
+        return;
+
+    // report what the stream was opened with
+    for (AudioStreamConfig * config : {&_outConfig, &_inConfig})
+    {
+        config->period_frames = bufferFrames;
+        config->periods = options.numberOfBuffers;
+        config->exclusive = (options.flags & RTAUDIO_HOG_DEVICE) || api == RtAudio::WINDOWS_ASIO;
+        config->api = fromRtApi(api);
+    }
 }
 
 AudioDevice_RtAudio::AudioDevice_RtAudio(
@@ -220,8 +313,25 @@ void AudioDevice_RtAudio::backendReinitialize()
 }
 
 
+double AudioDevice_RtAudio::roundTripLatency() const
+{
+    if (!g_rtaudio_ctx || !g_rtaudio_ctx->isStreamOpen() || authoritativeDeviceSampleRateAtRuntime <= 0.f)
+        return 0;
+
+    // RtAudio reports the input and output latency together, where the api knows it
+    return g_rtaudio_ctx->getStreamLatency() / static_cast<double>(authoritativeDeviceSampleRateAtRuntime);
+}
+
 void AudioDevice_RtAudio::start()
 {
+    // The stream is opened before the destination node is known, so reopen it if the
+    // destination's context renders a different quantum from the one the stream asked for.
+    if (_destinationNode && _destinationNode->renderQuantumSize() != static_cast<int>(_bufferFrames))
+    {
+        _bufferFrames = _destinationNode->renderQuantumSize();
+        backendReinitialize();
+    }
+
     ASSERT(g_rtaudio_ctx);
     ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
     try
@@ -271,6 +381,7 @@ void AudioDevice_RtAudio::render(
     AudioSourceProvider* provider,
     int numberOfFrames, void * outputBuffer, void * inputBuffer)
 {
+    const ProfileClock::time_point callbackStart = beginCallback();
     float * fltOutputBuffer = reinterpret_cast<float *>(outputBuffer);
     float * fltInputBuffer = reinterpret_cast<float *>(inputBuffer);
 
@@ -297,14 +408,11 @@ void AudioDevice_RtAudio::render(
     {
         if (kInterleaved)
         {
+            _inputChannels.resize(_inConfig.desired_channels);
             for (uint32_t i = 0; i < _inConfig.desired_channels; ++i)
-            {
-                AudioChannel * channel = _inputBus->channel(i);
-                float * src = &fltInputBuffer[i];
-                VectorMath::vclip(src, 1, &kLowThreshold, &kHighThreshold,
-                                  channel->mutableData(), _inConfig.desired_channels,
-                                  numberOfFrames);
-            }
+                _inputChannels[i] = _inputBus->channel(i)->mutableData();
+            SampleConversion::deinterleave(fltInputBuffer, SampleConversion::SampleFormat::Float32,
+                                           _inConfig.desired_channels, numberOfFrames, _inputChannels.data());
         }
         else
         {
@@ -336,13 +444,11 @@ void AudioDevice_RtAudio::render(
         // Clamp values at 0db (i.e., [-1.0, 1.0]) and also copy result to the DAC output buffer
         if (kInterleaved)
         {
+            _outputChannels.resize(_outConfig.desired_channels);
             for (uint32_t i = 0; i < _outConfig.desired_channels; ++i)
-            {
-                AudioChannel * channel = _renderBus->channel(i);
-                float * dst = &fltOutputBuffer[i];
-                VectorMath::vclip(channel->data(), 1, &kLowThreshold, &kHighThreshold, dst,
-                                  _outConfig.desired_channels, numberOfFrames);
-            }
+                _outputChannels[i] = _renderBus->channel(i)->data();
+            SampleConversion::interleave(_outputChannels.data(), _outConfig.desired_channels, numberOfFrames,
+                                         SampleConversion::SampleFormat::Float32, fltOutputBuffer);
         }
         else
         {
@@ -354,6 +460,8 @@ void AudioDevice_RtAudio::render(
             }
         }
     }
+
+    endCallback(callbackStart, numberOfFrames, authoritativeDeviceSampleRateAtRuntime);
 }
 
 }  // namespace lab
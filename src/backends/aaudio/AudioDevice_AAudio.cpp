@@ -0,0 +1,436 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/backends/AudioDevice_AAudio.h"
+
+#include "internal/Assertions.h"
+#include "internal/SampleConversion.h"
+
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include "LabSound/extended/Logging.h"
+
+#include <aaudio/AAudio.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+////////////////////////////////////////////////////
+//   Platform/backend specific static functions   //
+////////////////////////////////////////////////////
+
+namespace
+{
+    using SampleFormat = SampleConversion::SampleFormat;
+
+    aaudio_data_callback_result_t dataCallback(AAudioStream *, void * userData, void * audioData, int32_t numFrames)
+    {
+        reinterpret_cast<AudioDevice_AAudio *>(userData)->render(static_cast<float *>(audioData), numFrames);
+        return AAUDIO_CALLBACK_RESULT_CONTINUE;
+    }
+
+    void errorCallback(AAudioStream *, void * userData, aaudio_result_t error)
+    {
+        reinterpret_cast<AudioDevice_AAudio *>(userData)->streamError(error);
+    }
+
+    // Opens a float stream on the device for low latency, asking for exclusive sharing;
+    // the rate and channels may be zero to take the device's. Returns null on failure.
+    AAudioStream * openStream(aaudio_direction_t direction, int32_t deviceId, int32_t sampleRate, int32_t channels,
+                              int32_t framesPerCallback, void * device)
+    {
+        AAudioStreamBuilder * builder = nullptr;
+        aaudio_result_t result = AAudio_createStreamBuilder(&builder);
+        if (result != AAUDIO_OK)
+        {
+            LOG_ERROR("[AudioDevice_AAudio] unable to create a stream builder: %s", AAudio_convertResultToText(result));
+            return nullptr;
+        }
+
+        AAudioStreamBuilder_setDirection(builder, direction);
+        AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+        AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+        AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+        if (deviceId > 0)
+            AAudioStreamBuilder_setDeviceId(builder, deviceId);
+        if (sampleRate > 0)
+            AAudioStreamBuilder_setSampleRate(builder, sampleRate);
+        if (channels > 0)
+            AAudioStreamBuilder_setChannelCount(builder, channels);
+        if (device)
+        {
+            // the input stream is read from the output's callback, so has none of its own
+            if (direction == AAUDIO_DIRECTION_OUTPUT)
+            {
+                AAudioStreamBuilder_setDataCallback(builder, dataCallback, device);
+                if (framesPerCallback > 0)
+                    AAudioStreamBuilder_setFramesPerDataCallback(builder, framesPerCallback);
+            }
+            AAudioStreamBuilder_setErrorCallback(builder, errorCallback, device);
+        }
+
+        AAudioStream * stream = nullptr;
+        result = AAudioStreamBuilder_openStream(builder, &stream);
+        AAudioStreamBuilder_delete(builder);
+        if (result != AAUDIO_OK)
+        {
+            LOG_ERROR("[AudioDevice_AAudio] unable to open the %s stream: %s",
+                      direction == AAUDIO_DIRECTION_OUTPUT ? "output" : "input", AAudio_convertResultToText(result));
+            return nullptr;
+        }
+        return stream;
+    }
+}
+
+// static
+std::vector<AudioDeviceInfo> AudioDevice_AAudio::MakeAudioDeviceList()
+{
+    std::vector<AudioDeviceInfo> devices;
+
+    AAudioStream * output = openStream(AAUDIO_DIRECTION_OUTPUT, 0, 0, 0, 0, nullptr);
+    if (!output)
+        return devices;
+
+    AudioDeviceInfo info;
+    info.index = 0;
+    info.identifier = "AAudio";
+    info.num_output_channels = static_cast<uint32_t>(AAudioStream_getChannelCount(output));
+    info.nominal_samplerate = static_cast<float>(AAudioStream_getSampleRate(output));
+    info.supported_samplerates.push_back(info.nominal_samplerate);
+    info.is_default_output = true;
+    AAudioStream_close(output);
+
+    if (AAudioStream * input = openStream(AAUDIO_DIRECTION_INPUT, 0, 0, 0, 0, nullptr))
+    {
+        info.num_input_channels = static_cast<uint32_t>(AAudioStream_getChannelCount(input));
+        info.is_default_input = true;
+        AAudioStream_close(input);
+    }
+
+    devices.push_back(info);
+    return devices;
+}
+
+/////////////////////////////
+//   AudioDevice_AAudio    //
+/////////////////////////////
+
+AudioDevice_AAudio::AudioDevice_AAudio(
+    const AudioStreamConfig & _inputConfig,
+    const AudioStreamConfig & _outputConfig)
+: AudioDevice(_inputConfig, _outputConfig)
+{
+    samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
+    _requestedPeriodFrames = _outConfig.period_frames;
+    _requestedPeriods = _outConfig.periods;
+    open();
+}
+
+AudioDevice_AAudio::~AudioDevice_AAudio()
+{
+    if (_restartThread.joinable())
+        _restartThread.join();
+    close();
+    delete _renderBus;
+    delete _inputBus;
+}
+
+void AudioDevice_AAudio::open()
+{
+    const int32_t rate = static_cast<int32_t>(_outConfig.desired_samplerate);
+    _outputStream = openStream(AAUDIO_DIRECTION_OUTPUT, std::max(_outConfig.device_index, 0), rate,
+                               static_cast<int32_t>(_outConfig.desired_channels),
+                               static_cast<int32_t>(_requestedPeriodFrames), this);
+    if (!_outputStream)
+        return;
+
+    // the device may grant another rate, or shared rather than exclusive use
+    const int32_t sampleRate = AAudioStream_getSampleRate(_outputStream);
+    if (rate && rate != sampleRate)
+        LOG_INFO("[AudioDevice_AAudio] requested a %d Hz sample rate, the device runs at %d Hz", rate, sampleRate);
+    authoritativeDeviceSampleRateAtRuntime = static_cast<float>(sampleRate);
+    _outConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+    _inConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+
+    _exclusive = AAudioStream_getSharingMode(_outputStream) == AAUDIO_SHARING_MODE_EXCLUSIVE;
+    if (!_exclusive)
+        LOG_INFO("[AudioDevice_AAudio] exclusive output is unavailable, using a shared stream");
+    if (AAudioStream_getPerformanceMode(_outputStream) != AAUDIO_PERFORMANCE_MODE_LOW_LATENCY)
+        LOG_INFO("[AudioDevice_AAudio] the low latency output path is unavailable");
+
+    // the stream buffers a little more than a burst by default; keeping it to a couple of
+    // bursts is what reaches the lowest latency the device allows
+    _framesPerBurst = AAudioStream_getFramesPerBurst(_outputStream);
+    const int32_t bursts = _requestedPeriods ? static_cast<int32_t>(_requestedPeriods) : 2;
+    AAudioStream_setBufferSizeInFrames(_outputStream, bursts * _framesPerBurst);
+    _outputChannelCount = AAudioStream_getChannelCount(_outputStream);
+    _outConfig.desired_channels = static_cast<uint32_t>(_outputChannelCount);
+    _outConfig.period_frames = static_cast<uint32_t>(_framesPerBurst);
+    _outConfig.periods = static_cast<uint32_t>(AAudioStream_getBufferSizeInFrames(_outputStream) / std::max(_framesPerBurst, 1));
+    _outConfig.exclusive = _exclusive;
+    _outConfig.api = AudioApi::AAudio;
+
+    if (_inConfig.device_index >= 0 && _inConfig.desired_channels)
+    {
+        _inputStream = openStream(AAUDIO_DIRECTION_INPUT, _inConfig.device_index, sampleRate,
+                                  static_cast<int32_t>(_inConfig.desired_channels), 0, this);
+        if (_inputStream && AAudioStream_getSampleRate(_inputStream) != sampleRate)
+        {
+            LOG_ERROR("[AudioDevice_AAudio] the input runs at %d Hz rather than the output's %d Hz",
+                      AAudioStream_getSampleRate(_inputStream), sampleRate);
+            AAudioStream_close(_inputStream);
+            _inputStream = nullptr;
+        }
+    }
+    _inputChannelCount = _inputStream ? AAudioStream_getChannelCount(_inputStream) : 0;
+    _inConfig.desired_channels = static_cast<uint32_t>(_inputChannelCount);
+    if (_inputStream)
+    {
+        _inConfig.period_frames = static_cast<uint32_t>(AAudioStream_getFramesPerBurst(_inputStream));
+        _inConfig.exclusive = AAudioStream_getSharingMode(_inputStream) == AAUDIO_SHARING_MODE_EXCLUSIVE;
+        _inConfig.api = AudioApi::AAudio;
+    }
+
+    // callbacks are never larger than the stream's buffer
+    _maxFrames = std::max(AAudioStream_getBufferCapacityInFrames(_outputStream), _framesPerBurst);
+    _inputScratch.assign(static_cast<size_t>(_maxFrames) * _inputChannelCount, 0.f);
+    _outputChannels.resize(_outputChannelCount);
+    _inputChannels.resize(_inputChannelCount);
+    _xrunCount = AAudioStream_getXRunCount(_outputStream);
+    _drainInput = true;
+
+    // the buses are remade with the first callback, for the new channel counts
+    delete _renderBus;
+    delete _inputBus;
+    _renderBus = nullptr;
+    _inputBus = nullptr;
+    _fill = 0;
+}
+
+void AudioDevice_AAudio::close()
+{
+    stop();
+    if (_inputStream)
+        AAudioStream_close(_inputStream);
+    if (_outputStream)
+        AAudioStream_close(_outputStream);
+    _inputStream = nullptr;
+    _outputStream = nullptr;
+}
+
+void AudioDevice_AAudio::start()
+{
+    std::lock_guard<std::mutex> lock(_streamLock);
+    ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+    if (!_outputStream || _isRunning)
+        return;
+
+    // the input starts first, so that it has frames once the output asks for them
+    _drainInput = true;
+    if (_inputStream && AAudioStream_requestStart(_inputStream) != AAUDIO_OK)
+        LOG_ERROR("[AudioDevice_AAudio] unable to start the input stream");
+
+    aaudio_result_t result = AAudioStream_requestStart(_outputStream);
+    if (result != AAUDIO_OK)
+    {
+        LOG_ERROR("[AudioDevice_AAudio] unable to start the output stream: %s", AAudio_convertResultToText(result));
+        if (_inputStream)
+            AAudioStream_requestStop(_inputStream);
+        return;
+    }
+    _isRunning = true;
+}
+
+void AudioDevice_AAudio::stop()
+{
+    if (!_outputStream || !_isRunning)
+        return;
+
+    AAudioStream_requestStop(_outputStream);
+    if (_inputStream)
+        AAudioStream_requestStop(_inputStream);
+    _isRunning = false;
+}
+
+bool AudioDevice_AAudio::isRunning() const
+{
+    return _isRunning;
+}
+
+void AudioDevice_AAudio::backendReinitialize()
+{
+    bool wasRunning;
+    {
+        std::lock_guard<std::mutex> lock(_streamLock);
+        wasRunning = _isRunning;
+        close();
+        open();
+    }
+    if (wasRunning)
+        start();
+}
+
+double AudioDevice_AAudio::roundTripLatency() const
+{
+    if (!_outputStream || authoritativeDeviceSampleRateAtRuntime <= 0.f)
+        return 0;
+
+    // the output's buffer, a burst waiting in the input, and a staged quantum, if any
+    double frames = AAudioStream_getBufferSizeInFrames(_outputStream);
+    if (_inputStream)
+        frames += AAudioStream_getFramesPerBurst(_inputStream);
+    if (_framesPerBurst % _renderQuantum)
+        frames += _renderQuantum;
+    return frames / authoritativeDeviceSampleRateAtRuntime;
+}
+
+void AudioDevice_AAudio::streamError(int error)
+{
+    if (error != AAUDIO_ERROR_DISCONNECTED)
+    {
+        LOG_ERROR("[AudioDevice_AAudio] stream error: %s", AAudio_convertResultToText(error));
+        return;
+    }
+
+    // Reopen on the device's new route. Only one restart is in flight at a time; the
+    // previous restart thread has finished by the time the flag is clear.
+    if (_restartPending.exchange(true))
+        return;
+    if (_restartThread.joinable())
+        _restartThread.join();
+    _restartThread = std::thread([this]() {
+        LOG_INFO("[AudioDevice_AAudio] the stream was disconnected, reopening it");
+        backendReinitialize();
+        _restartPending.store(false);
+    });
+}
+
+// Renders one quantum of the graph into the render bus
+void AudioDevice_AAudio::renderQuantum()
+{
+    // Update sampling info for use by the render graph
+    const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
+    const uint64_t t = samplingInfo.current_sample_frame & ~1;
+    samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
+    samplingInfo.current_sample_frame = t + _renderQuantum + index;
+    samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
+    samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    _destinationNode->render(sourceProvider(), _inputBus, _renderBus, _renderQuantum, samplingInfo);
+}
+
+// Called by the output stream from its callback thread; pulls on the graph to fill output,
+// interleaved.
+int AudioDevice_AAudio::render(float * output, int numberOfFrames)
+{
+    const ProfileClock::time_point callbackStart = beginCallback();
+    const int out_channels = _outputChannelCount;
+    const int in_channels = _inputChannelCount;
+
+    const int32_t xruns = AAudioStream_getXRunCount(_outputStream);
+    for (; _xrunCount < xruns; ++_xrunCount)
+        reportXrun();
+
+    if (!_destinationNode)
+    {
+        memset(output, 0, sizeof(float) * numberOfFrames * out_channels);
+        endCallback(callbackStart, numberOfFrames, authoritativeDeviceSampleRateAtRuntime);
+        return 0;
+    }
+
+    if (!_renderBus)
+    {
+        // the graph is rendered in quanta of the size its context was configured with
+        _renderQuantum = _destinationNode->renderQuantumSize();
+        _renderBus = new AudioBus(out_channels, _renderQuantum, true);
+        _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        if (in_channels)
+        {
+            _inputBus = new AudioBus(in_channels, _renderQuantum, true);
+            _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        }
+    }
+
+    if (_inputStream && _drainInput)
+    {
+        // input that queued up before the output started would only add to the latency
+        while (AAudioStream_read(_inputStream, _inputScratch.data(), _maxFrames, 0) > 0) {}
+        _drainInput = false;
+    }
+
+    for (int done = 0; done < numberOfFrames;)
+    {
+        const int frames = std::min(numberOfFrames - done, _maxFrames);
+        float * out = output + static_cast<size_t>(done) * out_channels;
+        done += frames;
+
+        const float * in = _inputScratch.data();
+        if (in_channels)
+        {
+            // the input runs on the same clock, so a short read is made up with silence
+            aaudio_result_t read = AAudioStream_read(_inputStream, _inputScratch.data(), frames, 0);
+            read = std::max(read, 0);
+            if (read < frames)
+                memset(_inputScratch.data() + static_cast<size_t>(read) * in_channels, 0,
+                       sizeof(float) * (frames - read) * in_channels);
+        }
+
+        if (_fill == 0 && frames % _renderQuantum == 0)
+        {
+            // a whole number of quanta is rendered and written straight out
+            for (int offset = 0; offset < frames; offset += _renderQuantum)
+            {
+                if (in_channels)
+                {
+                    for (int i = 0; i < in_channels; ++i)
+                        _inputChannels[i] = _inputBus->channel(i)->mutableData();
+                    SampleConversion::deinterleave(in + offset * in_channels, SampleFormat::Float32,
+                                                   in_channels, _renderQuantum, _inputChannels.data());
+                }
+
+                renderQuantum();
+
+                for (int i = 0; i < out_channels; ++i)
+                    _outputChannels[i] = _renderBus->channel(i)->data();
+                SampleConversion::interleave(_outputChannels.data(), out_channels, _renderQuantum,
+                                             SampleFormat::Float32, out + offset * out_channels);
+            }
+            continue;
+        }
+
+        // frames are exchanged with a staged quantum, which is rendered each time it fills,
+        // so the output trails the input by a quantum
+        for (int offset = 0; offset < frames;)
+        {
+            const int count = std::min(frames - offset, _renderQuantum - _fill);
+            if (in_channels)
+            {
+                for (int i = 0; i < in_channels; ++i)
+                    _inputChannels[i] = _inputBus->channel(i)->mutableData() + _fill;
+                SampleConversion::deinterleave(in + offset * in_channels, SampleFormat::Float32,
+                                               in_channels, count, _inputChannels.data());
+            }
+            for (int i = 0; i < out_channels; ++i)
+                _outputChannels[i] = _renderBus->channel(i)->data() + _fill;
+            SampleConversion::interleave(_outputChannels.data(), out_channels, count,
+                                         SampleFormat::Float32, out + offset * out_channels);
+
+            offset += count;
+            _fill += count;
+            if (_fill == _renderQuantum)
+            {
+                renderQuantum();
+                _fill = 0;
+            }
+        }
+    }
+
+    endCallback(callbackStart, numberOfFrames, authoritativeDeviceSampleRateAtRuntime);
+    return 0;
+}
+
+}  // namespace lab
@@ -0,0 +1,557 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/backends/AudioDevice_CoreAudio.h"
+
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <Availability.h>
+#include <CoreAudio/CoreAudio.h>
+
+#if defined(__MAC_11_0)
+#include <os/workgroup.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+namespace lab
+{
+
+////////////////////////////////////////////////////
+//   Platform/backend specific static functions   //
+////////////////////////////////////////////////////
+
+const float kLowThreshold = -1.0f;
+const float kHighThreshold = 1.0f;
+
+namespace
+{
+#if defined(__MAC_12_0)
+    const AudioObjectPropertyElement kElement = kAudioObjectPropertyElementMain;
+#else
+    const AudioObjectPropertyElement kElement = kAudioObjectPropertyElementMaster;
+#endif
+
+    // the largest callback the unit is prepared for, and so the largest buffer
+    const UInt32 kMaxFramesPerSlice = 4096;
+
+    template <typename T>
+    bool getProperty(AudioObjectID object, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope, T & value)
+    {
+        AudioObjectPropertyAddress address = {selector, scope, kElement};
+        UInt32 size = sizeof(T);
+        return AudioObjectGetPropertyData(object, &address, 0, nullptr, &size, &value) == noErr;
+    }
+
+    template <typename T>
+    bool setProperty(AudioObjectID object, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope, const T & value)
+    {
+        AudioObjectPropertyAddress address = {selector, scope, kElement};
+        return AudioObjectSetPropertyData(object, &address, 0, nullptr, sizeof(T), &value) == noErr;
+    }
+
+    template <typename T>
+    std::vector<T> getArray(AudioObjectID object, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope)
+    {
+        AudioObjectPropertyAddress address = {selector, scope, kElement};
+        UInt32 size = 0;
+        if (AudioObjectGetPropertyDataSize(object, &address, 0, nullptr, &size) != noErr)
+            return {};
+        std::vector<T> values(size / sizeof(T));
+        if (AudioObjectGetPropertyData(object, &address, 0, nullptr, &size, values.data()) != noErr)
+            return {};
+        values.resize(size / sizeof(T));
+        return values;
+    }
+
+    std::vector<AudioObjectID> allDevices()
+    {
+        return getArray<AudioObjectID>(kAudioObjectSystemObject, kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal);
+    }
+
+    uint32_t channelCount(AudioObjectID device, AudioObjectPropertyScope scope)
+    {
+        AudioObjectPropertyAddress address = {kAudioDevicePropertyStreamConfiguration, scope, kElement};
+        UInt32 size = 0;
+        if (AudioObjectGetPropertyDataSize(device, &address, 0, nullptr, &size) != noErr || !size)
+            return 0;
+
+        std::vector<uint8_t> storage(size);
+        AudioBufferList * list = reinterpret_cast<AudioBufferList *>(storage.data());
+        if (AudioObjectGetPropertyData(device, &address, 0, nullptr, &size, list) != noErr)
+            return 0;
+
+        uint32_t channels = 0;
+        for (UInt32 i = 0; i < list->mNumberBuffers; ++i)
+            channels += list->mBuffers[i].mNumberChannels;
+        return channels;
+    }
+
+    std::string deviceName(AudioObjectID device)
+    {
+        CFStringRef name = nullptr;
+        if (!getProperty(device, kAudioObjectPropertyName, kAudioObjectPropertyScopeGlobal, name) || !name)
+            return "Core Audio device";
+
+        char text[256] = {};
+        CFStringGetCString(name, text, sizeof(text), kCFStringEncodingUTF8);
+        CFRelease(name);
+        return text;
+    }
+
+    OSStatus renderCallback(void * inRefCon, AudioUnitRenderActionFlags *, const AudioTimeStamp * inTimeStamp,
+                            UInt32, UInt32 inNumberFrames, AudioBufferList * ioData)
+    {
+        return reinterpret_cast<AudioDevice_CoreAudio *>(inRefCon)->render(inNumberFrames, ioData, inTimeStamp);
+    }
+
+    OSStatus overloadListener(AudioObjectID, UInt32, const AudioObjectPropertyAddress *, void * clientData)
+    {
+        reinterpret_cast<AudioDevice_CoreAudio *>(clientData)->reportXrun();
+        return noErr;
+    }
+
+    const AudioObjectPropertyAddress kOverloadAddress = {kAudioDeviceProcessorOverload, kAudioObjectPropertyScopeGlobal, kElement};
+
+    AudioStreamBasicDescription floatFormat(Float64 sampleRate, UInt32 channels)
+    {
+        AudioStreamBasicDescription format = {};
+        format.mSampleRate = sampleRate;
+        format.mFormatID = kAudioFormatLinearPCM;
+        format.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked | kAudioFormatFlagIsNonInterleaved;
+        format.mBytesPerPacket = sizeof(float);
+        format.mFramesPerPacket = 1;
+        format.mBytesPerFrame = sizeof(float);
+        format.mChannelsPerFrame = channels;
+        format.mBitsPerChannel = 32;
+        return format;
+    }
+}
+
+// static
+std::vector<AudioDeviceInfo> AudioDevice_CoreAudio::MakeAudioDeviceList()
+{
+    std::vector<AudioDeviceInfo> devices;
+
+    AudioObjectID defaultOutput = kAudioObjectUnknown;
+    AudioObjectID defaultInput = kAudioObjectUnknown;
+    getProperty(kAudioObjectSystemObject, kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, defaultOutput);
+    getProperty(kAudioObjectSystemObject, kAudioHardwarePropertyDefaultInputDevice, kAudioObjectPropertyScopeGlobal, defaultInput);
+
+    const std::vector<AudioObjectID> ids = allDevices();
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        AudioDeviceInfo info;
+        info.index = static_cast<int32_t>(i);
+        info.identifier = deviceName(ids[i]);
+        info.num_output_channels = channelCount(ids[i], kAudioObjectPropertyScopeOutput);
+        info.num_input_channels = channelCount(ids[i], kAudioObjectPropertyScopeInput);
+
+        Float64 nominal = 0;
+        getProperty(ids[i], kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, nominal);
+        info.nominal_samplerate = static_cast<float>(nominal);
+
+        // the device lists ranges; the usual rates within them are reported
+        const Float64 common[] = {22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000};
+        for (const AudioValueRange & range : getArray<AudioValueRange>(ids[i], kAudioDevicePropertyAvailableNominalSampleRates, kAudioObjectPropertyScopeGlobal))
+        {
+            if (range.mMinimum == range.mMaximum)
+                info.supported_samplerates.push_back(static_cast<float>(range.mMinimum));
+            else
+                for (Float64 rate : common)
+                    if (rate >= range.mMinimum && rate <= range.mMaximum)
+                        info.supported_samplerates.push_back(static_cast<float>(rate));
+        }
+        std::sort(info.supported_samplerates.begin(), info.supported_samplerates.end());
+        info.supported_samplerates.erase(std::unique(info.supported_samplerates.begin(), info.supported_samplerates.end()),
+                                         info.supported_samplerates.end());
+
+        info.is_default_output = ids[i] == defaultOutput;
+        info.is_default_input = ids[i] == defaultInput;
+        devices.push_back(info);
+    }
+    return devices;
+}
+
+/////////////////////////////
+//  AudioDevice_CoreAudio  //
+/////////////////////////////
+
+AudioDevice_CoreAudio::AudioDevice_CoreAudio(
+    const AudioStreamConfig & _inputConfig,
+    const AudioStreamConfig & _outputConfig)
+: AudioDevice(_inputConfig, _outputConfig)
+{
+    samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
+    _requestedPeriodFrames = _outConfig.period_frames;
+    _requestedExclusive = _outConfig.exclusive;
+    open();
+}
+
+AudioDevice_CoreAudio::~AudioDevice_CoreAudio()
+{
+    close();
+    delete _deviceOutputBus;
+    delete _deviceInputBus;
+    delete _renderBus;
+    delete _inputBus;
+}
+
+void AudioDevice_CoreAudio::open()
+{
+    const std::vector<AudioObjectID> ids = allDevices();
+    AudioObjectID device = kAudioObjectUnknown;
+    if (_outConfig.device_index >= 0 && _outConfig.device_index < static_cast<int32_t>(ids.size()))
+        device = ids[_outConfig.device_index];
+    else
+        getProperty(kAudioObjectSystemObject, kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, device);
+    if (device == kAudioObjectUnknown)
+    {
+        LOG_ERROR("[AudioDevice_CoreAudio] no output device is available");
+        return;
+    }
+    _deviceId = device;
+
+    // hog mode is held by a process id, or -1 when no process holds it
+    if (_requestedExclusive)
+    {
+        pid_t owner = getpid();
+        setProperty(device, kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal, owner);
+        getProperty(device, kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal, owner);
+        _hogging = owner == getpid();
+        if (!_hogging)
+            LOG_INFO("[AudioDevice_CoreAudio] the device is in use by another process, sharing it");
+    }
+
+    // Run the device at the rate asked for if it can, rather than converting in the unit.
+    // The change is made asynchronously, so it is waited for a little.
+    Float64 rate = 0;
+    getProperty(device, kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, rate);
+    const Float64 desired = _outConfig.desired_samplerate;
+    if (desired > 0 && desired != rate && setProperty(device, kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, desired))
+    {
+        for (int i = 0; i < 100 && rate != desired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            getProperty(device, kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, rate);
+        }
+    }
+    if (desired > 0 && desired != rate)
+        LOG_INFO("[AudioDevice_CoreAudio] requested a %f Hz sample rate, the device runs at %f Hz", desired, rate);
+    authoritativeDeviceSampleRateAtRuntime = static_cast<float>(rate);
+    _outConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+    _inConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+
+    const uint32_t deviceOutputs = channelCount(device, kAudioObjectPropertyScopeOutput);
+    const uint32_t deviceInputs = channelCount(device, kAudioObjectPropertyScopeInput);
+    _outConfig.desired_channels = std::min(_outConfig.desired_channels, deviceOutputs);
+    if (_inConfig.desired_channels && !deviceInputs)
+        LOG_INFO("[AudioDevice_CoreAudio] the output device has no inputs; use an aggregate device for input");
+    _inConfig.desired_channels = std::min(_inConfig.desired_channels, deviceInputs);
+
+    AudioComponentDescription description = {};
+    description.componentType = kAudioUnitType_Output;
+    description.componentSubType = kAudioUnitSubType_HALOutput;
+    description.componentManufacturer = kAudioUnitManufacturer_Apple;
+    AudioComponent component = AudioComponentFindNext(nullptr, &description);
+    AudioUnit unit = nullptr;
+    if (!component || AudioComponentInstanceNew(component, &unit) != noErr)
+    {
+        LOG_ERROR("[AudioDevice_CoreAudio] unable to make an output unit");
+        return;
+    }
+
+    // input is enabled before the device is set, as the unit checks the device has it
+    const UInt32 enableInput = _inConfig.desired_channels ? 1 : 0;
+    AudioUnitSetProperty(unit, kAudioOutputUnitProperty_EnableIO, kAudioUnitScope_Input, 1, &enableInput, sizeof(enableInput));
+
+    OSStatus status = AudioUnitSetProperty(unit, kAudioOutputUnitProperty_CurrentDevice, kAudioUnitScope_Global, 0, &device, sizeof(device));
+    const AudioStreamBasicDescription outputFormat = floatFormat(rate, _outConfig.desired_channels);
+    if (status == noErr)
+        status = AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0, &outputFormat, sizeof(outputFormat));
+    if (status == noErr && enableInput)
+    {
+        const AudioStreamBasicDescription inputFormat = floatFormat(rate, _inConfig.desired_channels);
+        status = AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 1, &inputFormat, sizeof(inputFormat));
+    }
+
+    const UInt32 maxFrames = kMaxFramesPerSlice;
+    if (status == noErr)
+        status = AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &maxFrames, sizeof(maxFrames));
+
+    AURenderCallbackStruct callback = {renderCallback, this};
+    if (status == noErr)
+        status = AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0, &callback, sizeof(callback));
+    if (status == noErr)
+        status = AudioUnitInitialize(unit);
+    if (status != noErr)
+    {
+        LOG_ERROR("[AudioDevice_CoreAudio] unable to configure the output unit (%d)", static_cast<int>(status));
+        AudioComponentInstanceDispose(unit);
+        return;
+    }
+    _unit = unit;
+
+    AudioObjectAddPropertyListener(device, &kOverloadAddress, overloadListener, this);
+
+    if (_requestedPeriodFrames)
+        setBufferFrames(_requestedPeriodFrames);
+    else
+        getProperty(device, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, _bufferFrames);
+
+    // the input is pulled into planar scratch, through a buffer list pointing into it
+    const uint32_t in_channels = _inConfig.desired_channels;
+    _inputScratch.assign(static_cast<size_t>(kMaxFramesPerSlice) * in_channels, 0.f);
+    _inputList.assign(offsetof(AudioBufferList, mBuffers) + sizeof(AudioBuffer) * std::max(in_channels, 1u), 0);
+    AudioBufferList * list = reinterpret_cast<AudioBufferList *>(_inputList.data());
+    list->mNumberBuffers = in_channels;
+    for (uint32_t i = 0; i < in_channels; ++i)
+    {
+        list->mBuffers[i].mNumberChannels = 1;
+        list->mBuffers[i].mData = _inputScratch.data() + static_cast<size_t>(i) * kMaxFramesPerSlice;
+    }
+
+    for (AudioStreamConfig * config : {&_outConfig, &_inConfig})
+    {
+        config->periods = 1;
+        config->exclusive = _hogging;
+        config->api = AudioApi::CoreAudio;
+    }
+}
+
+void AudioDevice_CoreAudio::close()
+{
+    if (!_unit)
+        return;
+
+    stop();
+    AudioObjectRemovePropertyListener(_deviceId, &kOverloadAddress, overloadListener, this);
+    AudioUnitUninitialize(_unit);
+    AudioComponentInstanceDispose(_unit);
+    _unit = nullptr;
+
+    if (_hogging)
+    {
+        const pid_t released = -1;
+        setProperty(_deviceId, kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal, released);
+        _hogging = false;
+    }
+}
+
+// Sets the device's buffer, within the range it allows; the device uses the smallest
+// buffer any process using it asks for
+void AudioDevice_CoreAudio::setBufferFrames(uint32_t frames)
+{
+    AudioValueRange range = {};
+    if (getProperty(_deviceId, kAudioDevicePropertyBufferFrameSizeRange, kAudioObjectPropertyScopeGlobal, range))
+        frames = static_cast<uint32_t>(std::max(range.mMinimum, std::min(range.mMaximum, static_cast<Float64>(frames))));
+    frames = std::min(frames, static_cast<uint32_t>(kMaxFramesPerSlice));
+
+    const UInt32 value = frames;
+    if (!setProperty(_deviceId, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, value))
+        LOG_INFO("[AudioDevice_CoreAudio] the device refused a buffer of %u frames", frames);
+    getProperty(_deviceId, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, _bufferFrames);
+    _outConfig.period_frames = _bufferFrames;
+    _inConfig.period_frames = _bufferFrames;
+}
+
+void AudioDevice_CoreAudio::start()
+{
+    ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+    if (!_unit || _isRunning)
+        return;
+
+    // unless a period was asked for, the device calls back once per render quantum
+    if (!_requestedPeriodFrames && _destinationNode)
+        setBufferFrames(static_cast<uint32_t>(_destinationNode->renderQuantumSize()));
+
+    if (AudioOutputUnitStart(_unit) != noErr)
+    {
+        LOG_ERROR("[AudioDevice_CoreAudio] unable to start the output unit");
+        return;
+    }
+    _isRunning = true;
+}
+
+void AudioDevice_CoreAudio::stop()
+{
+    if (!_unit || !_isRunning)
+        return;
+
+    AudioOutputUnitStop(_unit);
+    _isRunning = false;
+}
+
+bool AudioDevice_CoreAudio::isRunning() const
+{
+    return _isRunning;
+}
+
+void AudioDevice_CoreAudio::backendReinitialize()
+{
+    const bool wasRunning = _isRunning;
+    close();
+    open();
+    if (wasRunning)
+        start();
+}
+
+double AudioDevice_CoreAudio::roundTripLatency() const
+{
+    if (!_unit || authoritativeDeviceSampleRateAtRuntime <= 0.f)
+        return 0;
+
+    // each direction has the device's latency, its safety offset, and a buffer
+    auto direction = [this](AudioObjectPropertyScope scope) {
+        UInt32 latency = 0;
+        UInt32 safety = 0;
+        getProperty(_deviceId, kAudioDevicePropertyLatency, scope, latency);
+        getProperty(_deviceId, kAudioDevicePropertySafetyOffset, scope, safety);
+        return static_cast<double>(latency) + safety + _bufferFrames;
+    };
+
+    double frames = direction(kAudioObjectPropertyScopeOutput);
+    if (_inConfig.desired_channels)
+        frames += direction(kAudioObjectPropertyScopeInput);
+    if (_bufferFrames % _renderQuantum)
+        frames += _renderQuantum;
+    return frames / authoritativeDeviceSampleRateAtRuntime;
+}
+
+void * AudioDevice_CoreAudio::renderWorkgroup() const
+{
+#if defined(__MAC_11_0)
+    if (!_unit)
+        return nullptr;
+
+    os_workgroup_t workgroup = nullptr;
+    UInt32 size = sizeof(workgroup);
+    if (AudioUnitGetProperty(_unit, kAudioOutputUnitProperty_OSWorkgroup, kAudioUnitScope_Global, 0, &workgroup, &size) != noErr)
+        return nullptr;
+    return workgroup;
+#else
+    return nullptr;
+#endif
+}
+
+// Renders one quantum of the graph from input into output
+void AudioDevice_CoreAudio::renderQuantum(AudioBus * input, AudioBus * output)
+{
+    // Update sampling info for use by the render graph
+    const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
+    const uint64_t t = samplingInfo.current_sample_frame & ~1;
+    samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
+    samplingInfo.current_sample_frame = t + _renderQuantum + index;
+    samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
+    samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    _destinationNode->render(sourceProvider(), input, output, _renderQuantum, samplingInfo);
+}
+
+// Called by the unit from the device's IO thread; pulls on the graph to fill ioData, a
+// buffer per channel.
+int AudioDevice_CoreAudio::render(uint32_t numberOfFrames, AudioBufferList * ioData, const void * timeStamp)
+{
+    const ProfileClock::time_point callbackStart = beginCallback();
+    const int frames = static_cast<int>(numberOfFrames);
+    const int out_channels = static_cast<int>(ioData->mNumberBuffers);
+    const int in_channels = static_cast<int>(_inConfig.desired_channels);
+
+    if (in_channels)
+    {
+        AudioBufferList * list = reinterpret_cast<AudioBufferList *>(_inputList.data());
+        for (int i = 0; i < in_channels; ++i)
+            list->mBuffers[i].mDataByteSize = numberOfFrames * sizeof(float);
+        AudioUnitRenderActionFlags flags = 0;
+        if (numberOfFrames > kMaxFramesPerSlice ||
+            AudioUnitRender(_unit, &flags, static_cast<const AudioTimeStamp *>(timeStamp), 1, numberOfFrames, list) != noErr)
+            std::fill(_inputScratch.begin(), _inputScratch.end(), 0.f);
+    }
+
+    if (!_destinationNode)
+    {
+        for (int i = 0; i < out_channels; ++i)
+            memset(ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);
+        endCallback(callbackStart, frames, authoritativeDeviceSampleRateAtRuntime);
+        return noErr;
+    }
+
+    if (!_renderBus)
+    {
+        // the graph is rendered in quanta of the size its context was configured with
+        _renderQuantum = _destinationNode->renderQuantumSize();
+        _renderBus = new AudioBus(out_channels, _renderQuantum, true);
+        _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        _deviceOutputBus = new AudioBus(out_channels, _renderQuantum, false);
+        _deviceOutputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        if (in_channels)
+        {
+            _inputBus = new AudioBus(in_channels, _renderQuantum, true);
+            _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+            _deviceInputBus = new AudioBus(in_channels, _renderQuantum, false);
+            _deviceInputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        }
+    }
+
+    auto inputChannel = [this](int i) { return _inputScratch.data() + static_cast<size_t>(i) * kMaxFramesPerSlice; };
+    auto outputChannel = [ioData](int i) { return static_cast<float *>(ioData->mBuffers[i].mData); };
+
+    if (_fill == 0 && frames % _renderQuantum == 0)
+    {
+        // the graph reads the input and writes the unit's buffers in place
+        for (int offset = 0; offset < frames; offset += _renderQuantum)
+        {
+            for (int i = 0; i < in_channels; ++i)
+                _deviceInputBus->setChannelMemory(i, inputChannel(i) + offset, _renderQuantum);
+            for (int i = 0; i < out_channels; ++i)
+                _deviceOutputBus->setChannelMemory(i, outputChannel(i) + offset, _renderQuantum);
+
+            renderQuantum(_deviceInputBus, _deviceOutputBus);
+
+            for (int i = 0; i < out_channels; ++i)
+            {
+                float * p = outputChannel(i) + offset;
+                VectorMath::vclip(p, 1, &kLowThreshold, &kHighThreshold, p, 1, _renderQuantum);
+            }
+        }
+    }
+    else
+    {
+        // frames are exchanged with a staged quantum, which is rendered each time it fills,
+        // so the output trails the input by a quantum
+        for (int offset = 0; offset < frames;)
+        {
+            const int count = std::min(frames - offset, _renderQuantum - _fill);
+            for (int i = 0; i < in_channels; ++i)
+                memcpy(_inputBus->channel(i)->mutableData() + _fill, inputChannel(i) + offset, sizeof(float) * count);
+            for (int i = 0; i < out_channels; ++i)
+                VectorMath::vclip(_renderBus->channel(i)->data() + _fill, 1, &kLowThreshold, &kHighThreshold,
+                                  outputChannel(i) + offset, 1, count);
+
+            offset += count;
+            _fill += count;
+            if (_fill == _renderQuantum)
+            {
+                renderQuantum(_inputBus, _renderBus);
+                _fill = 0;
+            }
+        }
+    }
+
+    endCallback(callbackStart, frames, authoritativeDeviceSampleRateAtRuntime);
+    return noErr;
+}
+
+}  // namespace lab
@@ -0,0 +1,370 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/backends/AudioDevice_Jack.h"
+
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <jack/jack.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace lab
+{
+
+////////////////////////////////////////////////////
+//   Platform/backend specific static functions   //
+////////////////////////////////////////////////////
+
+const float kLowThreshold = -1.0f;
+const float kHighThreshold = 1.0f;
+
+namespace
+{
+    const char * kClientName = "LabSound";
+
+    int processCallback(jack_nframes_t nframes, void * arg)
+    {
+        return reinterpret_cast<AudioDevice_Jack *>(arg)->render(static_cast<int>(nframes));
+    }
+
+    int xrunCallback(void * arg)
+    {
+        reinterpret_cast<AudioDevice_Jack *>(arg)->reportXrun();
+        return 0;
+    }
+
+    // Returns the physical ports with the given flags; free the result with jack_free
+    const char ** physicalPorts(jack_client_t * client, unsigned long flags)
+    {
+        return jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | flags);
+    }
+
+    uint32_t countPorts(const char ** ports)
+    {
+        uint32_t count = 0;
+        while (ports && ports[count])
+            ++count;
+        return count;
+    }
+}
+
+// static
+std::vector<AudioDeviceInfo> AudioDevice_Jack::MakeAudioDeviceList()
+{
+    std::vector<AudioDeviceInfo> devices;
+
+    jack_status_t status;
+    jack_client_t * client = jack_client_open(kClientName, JackNoStartServer, &status);
+    if (!client)
+    {
+        LOG_ERROR("no JACK server is running");
+        return devices;
+    }
+
+    const char ** playback = physicalPorts(client, JackPortIsInput);
+    const char ** capture = physicalPorts(client, JackPortIsOutput);
+
+    AudioDeviceInfo info;
+    info.index = 0;
+    info.identifier = "JACK";
+    info.num_output_channels = countPorts(playback);
+    info.num_input_channels = countPorts(capture);
+    info.nominal_samplerate = static_cast<float>(jack_get_sample_rate(client));
+    info.supported_samplerates.push_back(info.nominal_samplerate);
+    info.is_default_output = true;
+    info.is_default_input = true;
+    devices.push_back(info);
+
+    if (playback)
+        jack_free(playback);
+    if (capture)
+        jack_free(capture);
+    jack_client_close(client);
+    return devices;
+}
+
+/////////////////////////////
+//   AudioDevice_Jack      //
+/////////////////////////////
+
+AudioDevice_Jack::AudioDevice_Jack(
+    const AudioStreamConfig & _inputConfig,
+    const AudioStreamConfig & _outputConfig)
+: AudioDevice(_inputConfig, _outputConfig)
+{
+    samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
+    open();
+}
+
+AudioDevice_Jack::~AudioDevice_Jack()
+{
+    close();
+    delete _deviceOutputBus;
+    delete _deviceInputBus;
+    delete _renderBus;
+    delete _inputBus;
+}
+
+void AudioDevice_Jack::open()
+{
+    jack_status_t status;
+    _client = jack_client_open(kClientName, JackNoStartServer, &status);
+    if (!_client)
+    {
+        LOG_ERROR("Unable to connect to the JACK server");
+        return;
+    }
+
+    // the server's rate is the only one available
+    jack_nframes_t sampleRate = jack_get_sample_rate(_client);
+    if (_outConfig.desired_samplerate != 0.f && _outConfig.desired_samplerate != static_cast<float>(sampleRate))
+        LOG_INFO("[AudioDevice_Jack] requested a %f Hz sample rate, the server runs at %u Hz", _outConfig.desired_samplerate, sampleRate);
+    authoritativeDeviceSampleRateAtRuntime = static_cast<float>(sampleRate);
+    _outConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+    _inConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+
+    if (_outConfig.period_frames && _outConfig.period_frames != jack_get_buffer_size(_client))
+    {
+        if (jack_set_buffer_size(_client, _outConfig.period_frames))
+            LOG_INFO("[AudioDevice_Jack] the server refused a buffer size of %u frames", _outConfig.period_frames);
+    }
+
+    for (uint32_t i = 0; i < _outConfig.desired_channels; ++i)
+    {
+        const std::string name = "out_" + std::to_string(i + 1);
+        jack_port_t * port = jack_port_register(_client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        if (!port)
+        {
+            LOG_ERROR("Unable to register JACK port %s", name.c_str());
+            break;
+        }
+        _outputPorts.push_back(port);
+    }
+    for (uint32_t i = 0; i < _inConfig.desired_channels; ++i)
+    {
+        const std::string name = "in_" + std::to_string(i + 1);
+        jack_port_t * port = jack_port_register(_client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        if (!port)
+        {
+            LOG_ERROR("Unable to register JACK port %s", name.c_str());
+            break;
+        }
+        _inputPorts.push_back(port);
+    }
+    _outConfig.desired_channels = static_cast<uint32_t>(_outputPorts.size());
+    _inConfig.desired_channels = static_cast<uint32_t>(_inputPorts.size());
+    _outputBuffers.resize(_outputPorts.size());
+    _inputBuffers.resize(_inputPorts.size());
+
+    jack_set_process_callback(_client, processCallback, this);
+    jack_set_xrun_callback(_client, xrunCallback, this);
+}
+
+void AudioDevice_Jack::close()
+{
+    if (!_client)
+        return;
+
+    stop();
+    jack_client_close(_client);
+    _client = nullptr;
+    _outputPorts.clear();
+    _inputPorts.clear();
+}
+
+void AudioDevice_Jack::connectPhysicalPorts()
+{
+    if (const char ** playback = physicalPorts(_client, JackPortIsInput))
+    {
+        for (size_t i = 0; i < _outputPorts.size() && playback[i]; ++i)
+            jack_connect(_client, jack_port_name(_outputPorts[i]), playback[i]);
+        jack_free(playback);
+    }
+    if (const char ** capture = physicalPorts(_client, JackPortIsOutput))
+    {
+        for (size_t i = 0; i < _inputPorts.size() && capture[i]; ++i)
+            jack_connect(_client, capture[i], jack_port_name(_inputPorts[i]));
+        jack_free(capture);
+    }
+}
+
+void AudioDevice_Jack::start()
+{
+    ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+    if (!_client || _isRunning)
+        return;
+
+    if (jack_activate(_client))
+    {
+        LOG_ERROR("Unable to activate the JACK client");
+        return;
+    }
+    _isRunning = true;
+
+    // ports can only be connected once the client is active
+    connectPhysicalPorts();
+}
+
+void AudioDevice_Jack::stop()
+{
+    if (!_client || !_isRunning)
+        return;
+
+    if (jack_deactivate(_client))
+        LOG_ERROR("Unable to deactivate the JACK client");
+    _isRunning = false;
+}
+
+bool AudioDevice_Jack::isRunning() const
+{
+    return _isRunning;
+}
+
+void AudioDevice_Jack::backendReinitialize()
+{
+    const bool wasRunning = _isRunning;
+    close();
+    open();
+    if (wasRunning)
+        start();
+}
+
+double AudioDevice_Jack::roundTripLatency() const
+{
+    if (!_client || authoritativeDeviceSampleRateAtRuntime <= 0.f)
+        return 0;
+
+    // the server tracks the latency of the chains our ports are connected to
+    jack_latency_range_t range;
+    double frames = 0;
+    if (!_inputPorts.empty())
+    {
+        jack_port_get_latency_range(_inputPorts[0], JackCaptureLatency, &range);
+        frames += range.max;
+    }
+    if (!_outputPorts.empty())
+    {
+        jack_port_get_latency_range(_outputPorts[0], JackPlaybackLatency, &range);
+        frames += range.max;
+    }
+    if (!_direct)
+        frames += _renderQuantum;
+    return frames / authoritativeDeviceSampleRateAtRuntime;
+}
+
+// Renders one quantum of the graph from input into output
+void AudioDevice_Jack::renderQuantum(AudioBus * input, AudioBus * output)
+{
+    // Update sampling info for use by the render graph
+    const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
+    const uint64_t t = samplingInfo.current_sample_frame & ~1;
+    samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
+    samplingInfo.current_sample_frame = t + _renderQuantum + index;
+    samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
+    samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    _destinationNode->render(sourceProvider(), input, output, _renderQuantum, samplingInfo);
+}
+
+// Called by the server from its process thread; pulls on the graph to fill the ports.
+int AudioDevice_Jack::render(int numberOfFrames)
+{
+    const ProfileClock::time_point callbackStart = beginCallback();
+
+    const int out_channels = static_cast<int>(_outputPorts.size());
+    const int in_channels = static_cast<int>(_inputPorts.size());
+    for (int i = 0; i < out_channels; ++i)
+        _outputBuffers[i] = static_cast<float *>(jack_port_get_buffer(_outputPorts[i], numberOfFrames));
+    for (int i = 0; i < in_channels; ++i)
+        _inputBuffers[i] = static_cast<float *>(jack_port_get_buffer(_inputPorts[i], numberOfFrames));
+
+    if (!_destinationNode)
+    {
+        for (int i = 0; i < out_channels; ++i)
+            memset(_outputBuffers[i], 0, sizeof(float) * numberOfFrames);
+        endCallback(callbackStart, numberOfFrames, authoritativeDeviceSampleRateAtRuntime);
+        return 0;
+    }
+
+    if (!_renderBus)
+    {
+        // the graph is rendered in quanta of the size its context was configured with
+        _renderQuantum = _destinationNode->renderQuantumSize();
+        _renderBus = new AudioBus(out_channels, _renderQuantum, true);
+        _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        _deviceOutputBus = new AudioBus(out_channels, _renderQuantum, false);
+        _deviceOutputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        if (in_channels)
+        {
+            _inputBus = new AudioBus(in_channels, _renderQuantum, true);
+            _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+            _deviceInputBus = new AudioBus(in_channels, _renderQuantum, false);
+            _deviceInputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        }
+    }
+
+    const bool direct = numberOfFrames % _renderQuantum == 0;
+    if (direct != _direct)
+    {
+        // the server's buffer size changed; whatever was staged is dropped
+        _direct = direct;
+        _fill = 0;
+        _renderBus->zero();
+    }
+
+    if (direct)
+    {
+        // the graph reads the input ports and writes the output ports in place
+        for (int offset = 0; offset < numberOfFrames; offset += _renderQuantum)
+        {
+            for (int i = 0; i < in_channels; ++i)
+                _deviceInputBus->setChannelMemory(i, _inputBuffers[i] + offset, _renderQuantum);
+            for (int i = 0; i < out_channels; ++i)
+                _deviceOutputBus->setChannelMemory(i, _outputBuffers[i] + offset, _renderQuantum);
+
+            renderQuantum(_deviceInputBus, _deviceOutputBus);
+
+            for (int i = 0; i < out_channels; ++i)
+            {
+                float * p = _outputBuffers[i] + offset;
+                VectorMath::vclip(p, 1, &kLowThreshold, &kHighThreshold, p, 1, _renderQuantum);
+            }
+        }
+    }
+    else
+    {
+        // frames are exchanged with a staged quantum, which is rendered each time it fills,
+        // so the output trails the input by a quantum
+        for (int offset = 0; offset < numberOfFrames;)
+        {
+            const int count = std::min(numberOfFrames - offset, _renderQuantum - _fill);
+            for (int i = 0; i < in_channels; ++i)
+                memcpy(_inputBus->channel(i)->mutableData() + _fill, _inputBuffers[i] + offset, sizeof(float) * count);
+            for (int i = 0; i < out_channels; ++i)
+                VectorMath::vclip(_renderBus->channel(i)->data() + _fill, 1, &kLowThreshold, &kHighThreshold,
+                                  _outputBuffers[i] + offset, 1, count);
+
+            offset += count;
+            _fill += count;
+            if (_fill == _renderQuantum)
+            {
+                renderQuantum(_inputBus, _renderBus);
+                _fill = 0;
+            }
+        }
+    }
+
+    endCallback(callbackStart, numberOfFrames, authoritativeDeviceSampleRateAtRuntime);
+    return 0;
+}
+
+}  // namespace lab
@@ -6,12 +6,16 @@
 #include "LabSound/backends/AudioDevice_Miniaudio.h"
 
 #include "internal/Assertions.h"
+#include "internal/DeviceResampler.h"
+#include "internal/DriftCompensator.h"
+#include "internal/SampleConversion.h"
 
 #include "LabSound/core/AudioDevice.h"
 #include "LabSound/core/AudioNode.h"
+#include "LabSound/core/StartupTiming.h"
 
+#include "LabSound/extended/JobSystem.h"
 #include "LabSound/extended/Logging.h"
-#include "LabSound/extended/VectorMath.h"
 
 #include <assert.h>
 
@@ -25,9 +29,12 @@
 #include "miniaudio.h"
 #include <atomic>
 #include <cstring>
+#include <mutex>
+#include <thread>
 
 #include "miniaudio.h"
 
+#include <map>
 #include <set>
 
 namespace lab
@@ -37,153 +44,271 @@ namespace lab
 //   Platform/backend specific static functions   //
 ////////////////////////////////////////////////////
 
-const float kLowThreshold = -1.0f;
-const float kHighThreshold = 1.0f;
-const int kRenderQuantum = AudioNode::ProcessingSizeInFrames;
-
 /// @TODO - the AudioDeviceInfo wants to support specific sample rates, but miniaudio only tells min and max
 ///         miniaudio also has a concept of minChannels, which LabSound ignores
 
 
+void PrintAudioDeviceList();
+
 namespace
 {
     ma_context g_context;
-    static std::vector<AudioDeviceInfo> g_devices;
-    static bool g_must_init = true;
+    std::mutex g_contextLock;
+    bool g_must_init = true;
 
-    void init_context()
+    // The device list is enumerated on the job system, as enumeration can take hundreds of
+    // milliseconds, and kept until the system reports that the devices have changed.
+    enum DeviceListState
     {
+        DeviceListStale = 0,
+        DeviceListEnumerating,
+        DeviceListCurrent
+    };
+
+    std::mutex g_devicesLock;
+    std::vector<AudioDeviceInfo> g_devices;
+    std::atomic<int> g_devicesState{DeviceListStale};
+    bool g_devicesChanged = false;  // a change was reported during enumeration
+    std::function<void()> g_devicesChangedCallback;
+
+    // The context lives for the rest of the process once it is made, as the device list
+    // enumerates through it in the background.
+    bool init_context()
+    {
+        std::lock_guard<std::mutex> lock(g_contextLock);
         if (g_must_init)
         {
             LOG_TRACE("[LabSound] init_context() must_init");
+            StartupPhaseScope phase("device context");
             if (ma_context_init(NULL, 0, NULL, &g_context) != MA_SUCCESS)
             {
                 LOG_ERROR("[LabSound] init_context(): Failed to initialize miniaudio context");
-                return;
+                return false;
             }
             LOG_TRACE("[LabSound] init_context() succeeded");
             g_must_init = false;
         }
+        return true;
     }
-}
 
-void PrintAudioDeviceList()
-{
-    if (!g_devices.size())
-        LOG_INFO("No devices detected");
-    else
-        for (auto & device : g_devices)
+    bool toBackend(AudioApi api, ma_backend & backend)
+    {
+        switch (api)
         {
-            LOG_INFO("[%d] %s\n----------------------\n", device.index, device.identifier.c_str());
-            LOG_INFO("   ins:%d outs:%d default_in:%s default:out:%s\n", device.num_input_channels, device.num_output_channels, device.is_default_input?"yes":"no", device.is_default_output?"yes":"no");
-            LOG_INFO("    nominal samplerate: %f\n", device.nominal_samplerate);
-            for (float f : device.supported_samplerates)
-                LOG_INFO("        %f\n", f);
+            case AudioApi::WASAPI: backend = ma_backend_wasapi; return true;
+            case AudioApi::DirectSound: backend = ma_backend_dsound; return true;
+            case AudioApi::CoreAudio: backend = ma_backend_coreaudio; return true;
+            case AudioApi::ALSA: backend = ma_backend_alsa; return true;
+            case AudioApi::PulseAudio: backend = ma_backend_pulseaudio; return true;
+            case AudioApi::JACK: backend = ma_backend_jack; return true;
+            case AudioApi::OSS: backend = ma_backend_oss; return true;
+            case AudioApi::AAudio: backend = ma_backend_aaudio; return true;
+            case AudioApi::OpenSL: backend = ma_backend_opensl; return true;
+            default: return false;  // miniaudio has no ASIO
         }
-}
+    }
 
-std::vector<AudioDeviceInfo> AudioDevice_Miniaudio::MakeAudioDeviceList()
-{
-    init_context();
-    static bool probed = false;
-    if (probed)
-        return g_devices;
+    AudioApi fromBackend(ma_backend backend)
+    {
+        for (int i = 1; i <= static_cast<int>(AudioApi::OpenSL); ++i)
+        {
+            ma_backend b;
+            if (toBackend(static_cast<AudioApi>(i), b) && b == backend)
+                return static_cast<AudioApi>(i);
+        }
+        return AudioApi::Default;
+    }
 
-    probed = true;
+    // A device asked to open on an api other than the default context's gets a context
+    // for that api, which also lives for the rest of the process
+    std::map<AudioApi, ma_context *> g_apiContexts;
 
-    ma_result result;
-    ma_device_info * pPlaybackDeviceInfos;
-    ma_uint32 playbackDeviceCount;
-    ma_device_info * pCaptureDeviceInfos;
-    ma_uint32 captureDeviceCount;
-    ma_uint32 iDevice;
+    ma_context * contextFor(AudioApi api)
+    {
+        if (!init_context())
+            return nullptr;
+        if (api == AudioApi::Default)
+            return &g_context;
 
-    result = ma_context_get_devices(&g_context,
-                                    &pPlaybackDeviceInfos,
-                                    &playbackDeviceCount,
-                                    &pCaptureDeviceInfos,
-                                    &captureDeviceCount);
+        ma_backend backend;
+        if (!toBackend(api, backend))
+        {
+            LOG_ERROR("[LabSound] the requested api is unavailable through miniaudio, using the default");
+            return &g_context;
+        }
 
-    if (result != MA_SUCCESS)
-    {
-        LOG_ERROR("Failed to retrieve audio device information.\n");
-        return {};
-    }
+        std::lock_guard<std::mutex> lock(g_contextLock);
+        if (g_context.backend == backend)
+            return &g_context;
+        auto found = g_apiContexts.find(api);
+        if (found != g_apiContexts.end())
+            return found->second;
 
-    std::set<float> playbackRates;
+        ma_context * context = new ma_context();
+        if (ma_context_init(&backend, 1, NULL, context) != MA_SUCCESS)
+        {
+            LOG_ERROR("[LabSound] the requested api could not be initialized, using the default");
+            delete context;
+            return &g_context;
+        }
+        g_apiContexts[api] = context;
+        return context;
+    }
 
-    for (iDevice = 0; iDevice < playbackDeviceCount; ++iDevice)
+    AudioDeviceInfo makeDeviceInfo(ma_device_info & info, ma_device_type type, int32_t index, bool isDefault)
     {
         AudioDeviceInfo lab_device_info;
-        lab_device_info.index = (int32_t) g_devices.size();
-        lab_device_info.identifier = pPlaybackDeviceInfos[iDevice].name;
-
-        if (ma_context_get_device_info(
-                    &g_context, 
-                    ma_device_type_playback,
-                    &pPlaybackDeviceInfos[iDevice].id, 
-                    &pPlaybackDeviceInfos[iDevice])
-            != MA_SUCCESS)
-            continue;
-
+        lab_device_info.index = index;
+        lab_device_info.identifier = info.name;
         lab_device_info.num_input_channels = 0;
         lab_device_info.num_output_channels = 0;
-        for (uint32_t i = 0; i < pPlaybackDeviceInfos[iDevice].nativeDataFormatCount; ++i)
+
+        std::set<float> rates;
+        for (uint32_t i = 0; i < info.nativeDataFormatCount; ++i)
         {
-            playbackRates.insert(static_cast<float>(pPlaybackDeviceInfos[iDevice].nativeDataFormats[i].sampleRate));
-            if (pPlaybackDeviceInfos[iDevice].nativeDataFormats[i].channels > lab_device_info.num_output_channels)
-                lab_device_info.num_output_channels = pPlaybackDeviceInfos[iDevice].nativeDataFormats[i].channels;
+            rates.insert(static_cast<float>(info.nativeDataFormats[i].sampleRate));
+            uint32_t & channels = type == ma_device_type_playback ? lab_device_info.num_output_channels : lab_device_info.num_input_channels;
+            if (info.nativeDataFormats[i].channels > channels)
+                channels = info.nativeDataFormats[i].channels;
         }
-        for (auto r : playbackRates)
-        {
+        for (auto r : rates)
             lab_device_info.supported_samplerates.push_back(r);
+
+        lab_device_info.nominal_samplerate = rates.size() > 0 ? lab_device_info.supported_samplerates.back() : 0;
+        lab_device_info.is_default_output = type == ma_device_type_playback && isDefault;
+        lab_device_info.is_default_input = type == ma_device_type_capture && isDefault;
+        return lab_device_info;
+    }
+
+    std::vector<AudioDeviceInfo> enumerateDevices()
+    {
+        std::vector<AudioDeviceInfo> devices;
+        if (!init_context())
+            return devices;
+
+        ma_device_info * pPlaybackDeviceInfos;
+        ma_uint32 playbackDeviceCount;
+        ma_device_info * pCaptureDeviceInfos;
+        ma_uint32 captureDeviceCount;
+
+        if (ma_context_get_devices(&g_context,
+                                   &pPlaybackDeviceInfos,
+                                   &playbackDeviceCount,
+                                   &pCaptureDeviceInfos,
+                                   &captureDeviceCount) != MA_SUCCESS)
+        {
+            LOG_ERROR("Failed to retrieve audio device information.\n");
+            return devices;
         }
 
-        lab_device_info.nominal_samplerate = playbackRates.size() > 0 ? lab_device_info.supported_samplerates.back() : 0;
+        for (ma_uint32 iDevice = 0; iDevice < playbackDeviceCount; ++iDevice)
+        {
+            ma_device_info & info = pPlaybackDeviceInfos[iDevice];
+            if (ma_context_get_device_info(&g_context, ma_device_type_playback, &info.id, &info) != MA_SUCCESS)
+                continue;
+            devices.push_back(makeDeviceInfo(info, ma_device_type_playback, (int32_t) devices.size(), iDevice == 0));
+        }
 
-        lab_device_info.is_default_output = iDevice == 0;
-        lab_device_info.is_default_input = false;
+        for (ma_uint32 iDevice = 0; iDevice < captureDeviceCount; ++iDevice)
+        {
+            ma_device_info & info = pCaptureDeviceInfos[iDevice];
+            if (ma_context_get_device_info(&g_context, ma_device_type_capture, &info.id, &info) != MA_SUCCESS)
+                continue;
+            devices.push_back(makeDeviceInfo(info, ma_device_type_capture, (int32_t) devices.size(), iDevice == 0));
+        }
 
-        g_devices.push_back(lab_device_info);
+        return devices;
     }
 
-    for (iDevice = 0; iDevice < captureDeviceCount; ++iDevice)
+    void enumerationJob();
+
+    // Starts an enumeration unless one is running, in which case it runs again once it ends
+    void requestEnumeration()
     {
-        AudioDeviceInfo lab_device_info;
-        lab_device_info.index = (int32_t) g_devices.size();
-        lab_device_info.identifier = pCaptureDeviceInfos[iDevice].name;
+        std::lock_guard<std::mutex> lock(g_devicesLock);
+        if (g_devicesState == DeviceListEnumerating)
+        {
+            g_devicesChanged = true;
+            return;
+        }
+        g_devicesState = DeviceListEnumerating;
+        JobSystem::shared().submit(enumerationJob, JobPriority::Normal);
+    }
 
-        if (ma_context_get_device_info(
-                    &g_context, 
-                    ma_device_type_capture,
-                    &pCaptureDeviceInfos[iDevice].id,
-                    &pCaptureDeviceInfos[iDevice])
-            != MA_SUCCESS)
-            continue;
+    void enumerationJob()
+    {
+        const int64_t begin = StartupTiming::now();
+        std::vector<AudioDeviceInfo> devices = enumerateDevices();
+        StartupTiming::record("device enumeration", begin, StartupTiming::now());
 
-        lab_device_info.num_input_channels = 0;
-        lab_device_info.num_output_channels = 0;
-        for (uint32_t i = 0; i < pCaptureDeviceInfos[iDevice].nativeDataFormatCount; ++i)
+        std::function<void()> callback;
         {
-            playbackRates.insert(static_cast<float>(pPlaybackDeviceInfos[iDevice].nativeDataFormats[i].sampleRate));
-            if (pCaptureDeviceInfos[iDevice].nativeDataFormats[i].channels > lab_device_info.num_input_channels)
-                lab_device_info.num_input_channels = pCaptureDeviceInfos[iDevice].nativeDataFormats[i].channels;
+            std::lock_guard<std::mutex> lock(g_devicesLock);
+            g_devices = std::move(devices);
+            callback = g_devicesChangedCallback;
+            if (g_devicesChanged)
+            {
+                g_devicesChanged = false;
+                JobSystem::shared().submit(enumerationJob, JobPriority::Normal);
+            }
+            else
+                g_devicesState = DeviceListCurrent;
         }
-        for (auto r : playbackRates)
+
+        PrintAudioDeviceList();
+        if (callback)
+            callback();
+    }
+}
+
+void PrintAudioDeviceList()
+{
+    std::lock_guard<std::mutex> lock(g_devicesLock);
+    if (!g_devices.size())
+        LOG_INFO("No devices detected");
+    else
+        for (auto & device : g_devices)
         {
-            lab_device_info.supported_samplerates.push_back(r);
+            LOG_INFO("[%d] %s\n----------------------\n", device.index, device.identifier.c_str());
+            LOG_INFO("   ins:%d outs:%d default_in:%s default:out:%s\n", device.num_input_channels, device.num_output_channels, device.is_default_input?"yes":"no", device.is_default_output?"yes":"no");
+            LOG_INFO("    nominal samplerate: %f\n", device.nominal_samplerate);
+            for (float f : device.supported_samplerates)
+                LOG_INFO("        %f\n", f);
         }
+}
 
-        lab_device_info.nominal_samplerate = playbackRates.size() > 0 ? lab_device_info.supported_samplerates.back() : 0;
-        lab_device_info.is_default_output = false;
-        lab_device_info.is_default_input = iDevice == 0;
+std::vector<AudioDeviceInfo> AudioDevice_Miniaudio::MakeAudioDeviceList()
+{
+    if (g_devicesState == DeviceListStale)
+        requestEnumeration();
 
-        g_devices.push_back(lab_device_info);
-    }
+    // an enumeration in flight is waited for, rather than a second one made
+    JobSystem::shared().wait([]() { return g_devicesState == DeviceListCurrent; }, JobPriority::Normal);
 
+    std::lock_guard<std::mutex> lock(g_devicesLock);
     return g_devices;
 }
 
+void AudioDevice_Miniaudio::RefreshAudioDeviceList()
+{
+    requestEnumeration();
+}
+
+void AudioDevice_Miniaudio::Prewarm()
+{
+    JobSystem::shared().submit([]() {
+        init_context();
+        if (g_devicesState == DeviceListStale)
+            requestEnumeration();
+    }, JobPriority::Normal);
+}
+
+void AudioDevice_Miniaudio::SetAudioDeviceListChangedCallback(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(g_devicesLock);
+    g_devicesChangedCallback = std::move(callback);
+}
+
 namespace
 {
     void outputCallback(ma_device * pDevice, void * pOutput, const void * pInput, ma_uint32 frameCount)
@@ -192,7 +317,84 @@ namespace
         float * fBufOut = (float *) pOutput;
         AudioDevice_Miniaudio * ad = reinterpret_cast<AudioDevice_Miniaudio *>(pDevice->pUserData);
         memset(fBufOut, 0, sizeof(float) * frameCount * ad->getOutputConfig().desired_channels);
-        ad->render(frameCount, pOutput, const_cast<void *>(pInput));
+        ad->deviceCallback(pDevice, frameCount, pOutput, const_cast<void *>(pInput));
+    }
+
+    void captureCallback(ma_device * pDevice, void * pOutput, const void * pInput, ma_uint32 frameCount)
+    {
+        AudioDevice_Miniaudio * ad = reinterpret_cast<AudioDevice_Miniaudio *>(pDevice->pUserData);
+        ad->capture(frameCount, pInput);
+    }
+
+#if MA_VERSION_MINOR >= 11
+    // miniaudio reports no arrivals or removals of its own, but a device rerouted to another,
+    // as when the default device is unplugged, means the list has changed
+    void notificationCallback(const ma_device_notification * pNotification)
+    {
+        if (pNotification->type == ma_device_notification_type_rerouted)
+            requestEnumeration();
+    }
+#endif
+
+    // When input is requested, the device is opened in duplex so that input and output
+    // arrive in the same callback, and the input isn't delayed by a period in a ring.
+    ma_device_config makeDeviceConfig(const AudioStreamConfig & outConfig, const AudioStreamConfig & inConfig, void * user)
+    {
+        const bool duplex = inConfig.desired_channels > 0 && !inConfig.independent_clock;
+        ma_device_config deviceConfig = ma_device_config_init(duplex ? ma_device_type_duplex : ma_device_type_playback);
+        deviceConfig.playback.format = ma_format_f32;
+        deviceConfig.playback.channels = outConfig.desired_channels;
+        // a fixed rate graph is converted by LabSound, so the hardware runs at its own rate
+        const bool convert = outConfig.fixed_samplerate && !duplex;
+        deviceConfig.sampleRate = convert ? 0 : static_cast<int>(outConfig.desired_samplerate);
+        deviceConfig.capture.format = ma_format_f32;
+        deviceConfig.capture.channels = inConfig.desired_channels;
+        deviceConfig.periodSizeInFrames = outConfig.period_frames;
+        deviceConfig.periods = outConfig.periods;
+        deviceConfig.playback.shareMode = outConfig.exclusive ? ma_share_mode_exclusive : ma_share_mode_shared;
+        deviceConfig.capture.shareMode = deviceConfig.playback.shareMode;
+        deviceConfig.dataCallback = outputCallback;
+#if MA_VERSION_MINOR >= 11
+        deviceConfig.notificationCallback = notificationCallback;
+#endif
+        deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+        deviceConfig.pUserData = user;
+
+#ifdef __WINDOWS_WASAPI__
+        deviceConfig.wasapi.noAutoConvertSRC = true;
+#endif
+        return deviceConfig;
+    }
+
+    // An input on a clock of its own is captured at the graph's rate, miniaudio converting
+    // from the hardware's nominal rate; the drift compensator takes care of the rest.
+    ma_device_config makeCaptureConfig(const AudioStreamConfig & inConfig, float sampleRate, void * user)
+    {
+        ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
+        deviceConfig.capture.format = ma_format_f32;
+        deviceConfig.capture.channels = inConfig.desired_channels;
+        deviceConfig.sampleRate = static_cast<int>(sampleRate);
+        deviceConfig.capture.shareMode = inConfig.exclusive ? ma_share_mode_exclusive : ma_share_mode_shared;
+        deviceConfig.dataCallback = captureCallback;
+        deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+        deviceConfig.pUserData = user;
+        return deviceConfig;
+    }
+
+    // Opens the device, sharing it if exclusive use is refused, as when another
+    // application holds it or it doesn't support the stream's format exclusively
+    ma_result initDevice(ma_context * context, ma_device_config & config, ma_device * device)
+    {
+        ma_result result = ma_device_init(context, &config, device);
+        if (result != MA_SUCCESS &&
+            (config.playback.shareMode == ma_share_mode_exclusive || config.capture.shareMode == ma_share_mode_exclusive))
+        {
+            LOG_INFO("[LabSound] exclusive use of the device was refused, sharing it");
+            config.playback.shareMode = ma_share_mode_shared;
+            config.capture.shareMode = ma_share_mode_shared;
+            result = ma_device_init(context, &config, device);
+        }
+        return result;
     }
 }
 
@@ -201,96 +403,251 @@ AudioDevice_Miniaudio::AudioDevice_Miniaudio(const AudioStreamConfig & _inputCon
 : AudioDevice(_inputConfig, _outputConfig)
 {
     _device = new ma_device();
-    auto device_list = MakeAudioDeviceList();
-    PrintAudioDeviceList();
-
-    //ma_device_config deviceConfig = ma_device_config_init(ma_device_type_duplex);
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-    deviceConfig.playback.format = ma_format_f32;
-    deviceConfig.playback.channels = _outConfig.desired_channels;
-    deviceConfig.sampleRate = static_cast<int>(_outConfig.desired_samplerate);
-    deviceConfig.capture.format = ma_format_f32;
-    deviceConfig.capture.channels = _inConfig.desired_channels;
-    deviceConfig.dataCallback = outputCallback;
-    deviceConfig.performanceProfile = ma_performance_profile_low_latency;
-    deviceConfig.pUserData = this;
+    _requestedOutConfig = _outConfig;
+    _requestedInConfig = _inConfig;
+
+    // opening the default device doesn't need the device list, which is made in the background
+    _context = contextFor(_outConfig.api);
+    if (g_devicesState == DeviceListStale)
+        requestEnumeration();
+    if (!_context)
+    {
+        LOG_ERROR("Unable to open audio playback device");
+        return;
+    }
 
-#ifdef __WINDOWS_WASAPI__
-    deviceConfig.wasapi.noAutoConvertSRC = true;
-#endif
+    ma_device_config deviceConfig = makeDeviceConfig(_requestedOutConfig, _requestedInConfig, this);
 
-    if (ma_device_init(&g_context, &deviceConfig, _device) != MA_SUCCESS)
+    const int64_t openBegin = StartupTiming::now();
+    const ma_result opened = initDevice(_context, deviceConfig, _device);
+    StartupTiming::record("device open", openBegin, StartupTiming::now());
+    if (opened != MA_SUCCESS)
     {
         LOG_ERROR("Unable to open audio playback device");
         return;
     }
+    _initialized = true;
+    _renderingDevice = _device;
 
     authoritativeDeviceSampleRateAtRuntime = _outConfig.desired_samplerate;
+    _resampler = makeResampler(_device);
+    reportNegotiated(_device);
+
+    if (_inConfig.desired_channels > 0 && _inConfig.independent_clock)
+    {
+        _captureDevice = new ma_device();
+        ma_device_config captureConfig = makeCaptureConfig(_requestedInConfig, authoritativeDeviceSampleRateAtRuntime, this);
+        if (initDevice(_context, captureConfig, _captureDevice) != MA_SUCCESS)
+        {
+            LOG_ERROR("Unable to open audio capture device");
+            delete _captureDevice;
+            _captureDevice = nullptr;
+        }
+        else
+        {
+            // hold two capture periods, and a quantum, against the two clocks' scheduling
+            const int period = static_cast<int>(_captureDevice->capture.internalPeriodSizeInFrames);
+            _drift = new DriftCompensator(_inConfig.desired_channels, 2 * std::max(period, _renderQuantum) + _renderQuantum);
+        }
+    }
 
     samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
 
     _ring = new lab::RingBufferT<float>();
     _ring->resize(static_cast<int>(authoritativeDeviceSampleRateAtRuntime));  // ad hoc. hold one second
-    _scratch = reinterpret_cast<float *>(malloc(sizeof(float) * kRenderQuantum * _inConfig.desired_channels));
 }
 
 AudioDevice_Miniaudio::~AudioDevice_Miniaudio()
 {
     stop();
+    if (_captureDevice)
+    {
+        ma_device_uninit(_captureDevice);
+        delete _captureDevice;
+    }
     ma_device_uninit(_device);
-    ma_context_uninit(&g_context);
-    g_must_init = true;
+    delete _drift;
     delete _renderBus;
     delete _inputBus;
     delete _ring;
+    delete _resampler;
     if (_scratch)
         free(_scratch);
     delete _device;
 }
 
+// The graph is not torn down to change devices. The new device is opened at the graph's
+// sample rate, or at its own with a resampler for a fixed rate graph, and started while the
+// old one plays; the graph renders into the old device until the new one's first callback
+// takes over, and carries its buses, ring and timeline across.
 void AudioDevice_Miniaudio::backendReinitialize()
 {
-    auto device_list = MakeAudioDeviceList();
-    PrintAudioDeviceList();
-
-    //ma_device_config deviceConfig = ma_device_config_init(ma_device_type_duplex);
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-    deviceConfig.playback.format = ma_format_f32;
-    deviceConfig.playback.channels = _outConfig.desired_channels;
-    deviceConfig.sampleRate = static_cast<int>(_outConfig.desired_samplerate);
-    deviceConfig.capture.format = ma_format_f32;
-    deviceConfig.capture.channels = _inConfig.desired_channels;
-    deviceConfig.dataCallback = outputCallback;
-    deviceConfig.performanceProfile = ma_performance_profile_low_latency;
-    deviceConfig.pUserData = this;
+    // the devices may have changed since the device was opened
+    RefreshAudioDeviceList();
 
-#ifdef __WINDOWS_WASAPI__
-    deviceConfig.wasapi.noAutoConvertSRC = true;
-#endif
+    if (!_context)
+        return;
 
-    if (ma_device_init(&g_context, &deviceConfig, _device) != MA_SUCCESS)
+    ma_device * next = new ma_device();
+    ma_device_config deviceConfig = makeDeviceConfig(_requestedOutConfig, _requestedInConfig, this);
+    if (initDevice(_context, deviceConfig, next) != MA_SUCCESS)
     {
         LOG_ERROR("Unable to open audio playback device");
+        delete next;
         return;
     }
+
+    if (!_initialized || !ma_device_is_started(_device))
+    {
+        if (_initialized)
+            ma_device_uninit(_device);
+        delete _device;
+        _device = next;
+        _renderingDevice = next;
+        _initialized = true;
+        delete _resampler;
+        _resampler = makeResampler(next);
+        reportNegotiated(next);
+        return;
+    }
+
+    _nextResampler = makeResampler(next);
+    _nextDevice = next;
+    if (ma_device_start(next) != MA_SUCCESS)
+    {
+        LOG_ERROR("Unable to start audio device; keeping the current one");
+        _nextDevice = nullptr;
+        ma_device_uninit(next);
+        delete next;
+        delete _nextResampler;
+        _nextResampler = nullptr;
+        return;
+    }
+
+    // a device takes a period or so to call back for the first time
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (_renderingDevice.load() != next && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    if (_renderingDevice.load() != next)
+    {
+        // once stopped, the new device is not in a callback, so the handover is settled
+        ma_device_stop(next);
+        _nextDevice = nullptr;
+        if (_renderingDevice.load() != next)
+        {
+            LOG_ERROR("The new audio device did not start; keeping the current one");
+            ma_device_uninit(next);
+            delete next;
+            delete _nextResampler;
+            _nextResampler = nullptr;
+            return;
+        }
+        ma_device_start(next);
+    }
+
+    ma_device * previous = _device;
+    _device = next;
+    ma_device_uninit(previous);
+    delete previous;
+
+    // the handover swapped the resamplers, leaving the old device's here
+    delete _nextResampler;
+    _nextResampler = nullptr;
+    reportNegotiated(next);
+}
+
+void AudioDevice_Miniaudio::reportNegotiated(ma_device * device)
+{
+    const AudioApi api = fromBackend(device->pContext->backend);
+    _outConfig.period_frames = device->playback.internalPeriodSizeInFrames;
+    _outConfig.periods = device->playback.internalPeriods;
+    _outConfig.exclusive = device->playback.shareMode == ma_share_mode_exclusive;
+    _outConfig.api = api;
+
+    ma_device * capture = _captureDevice ? _captureDevice : device;
+    if (capture->type == ma_device_type_duplex || capture->type == ma_device_type_capture)
+    {
+        _inConfig.period_frames = capture->capture.internalPeriodSizeInFrames;
+        _inConfig.periods = capture->capture.internalPeriods;
+        _inConfig.exclusive = capture->capture.shareMode == ma_share_mode_exclusive;
+        _inConfig.api = api;
+    }
 }
 
+DeviceResampler * AudioDevice_Miniaudio::makeResampler(ma_device * device)
+{
+    const float deviceRate = static_cast<float>(device->sampleRate);
+    if (!_outConfig.fixed_samplerate || device->type != ma_device_type_playback ||
+        deviceRate == authoritativeDeviceSampleRateAtRuntime || authoritativeDeviceSampleRateAtRuntime <= 0)
+        return nullptr;
+
+    LOG_INFO("Rendering at %f, converted to the device's %f", authoritativeDeviceSampleRateAtRuntime, deviceRate);
+    DeviceResampler * resampler = new DeviceResampler(_outConfig.desired_channels, authoritativeDeviceSampleRateAtRuntime, deviceRate,
+                                                      _renderQuantum, [this](float * interleaved, int frames) {
+                                                          render(frames, interleaved, nullptr);
+                                                      });
+    if (!resampler->valid())
+    {
+        delete resampler;
+        return nullptr;
+    }
+    return resampler;
+}
+
+void AudioDevice_Miniaudio::deviceCallback(ma_device * device, int numberOfFrames, void * outputBuffer, void * inputBuffer)
+{
+    // only one device renders the graph at a time; while another is, this one plays silence
+    bool expected = false;
+    if (!_inRender.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        return;
+
+    if (device != _renderingDevice.load(std::memory_order_relaxed))
+    {
+        if (device != _nextDevice.load(std::memory_order_relaxed))
+        {
+            _inRender.store(false, std::memory_order_release);
+            return;
+        }
+        _renderingDevice.store(device);
+        _nextDevice.store(nullptr);
+        std::swap(_resampler, _nextResampler);
+    }
+
+    if (_resampler)
+        _resampler->process(static_cast<float *>(outputBuffer), numberOfFrames);
+    else
+        render(numberOfFrames, outputBuffer, inputBuffer);
+    _inRender.store(false, std::memory_order_release);
+}
 
 void AudioDevice_Miniaudio::start()
 {
     ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+    if (_captureDevice && ma_device_start(_captureDevice) != MA_SUCCESS)
+    {
+        LOG_ERROR("Unable to start audio capture device");
+    }
     if (ma_device_start(_device) != MA_SUCCESS)
     {
         LOG_ERROR("Unable to start audio device");
     }
 }
 
+void AudioDevice_Miniaudio::capture(int numberOfFrames, const void * inputBuffer)
+{
+    if (_drift && inputBuffer)
+        _drift->write(static_cast<const float *>(inputBuffer), numberOfFrames);
+}
+
 void AudioDevice_Miniaudio::stop()
 {
     if (ma_device_stop(_device) != MA_SUCCESS)
     {
         LOG_ERROR("Unable to stop audio device");
     }
+    if (_captureDevice)
+        ma_device_stop(_captureDevice);
 }
 
 bool AudioDevice_Miniaudio::isRunning() const
@@ -298,21 +655,78 @@ bool AudioDevice_Miniaudio::isRunning() const
     return ma_device_is_started(_device);
 }
 
+double AudioDevice_Miniaudio::roundTripLatency() const
+{
+    if (!_initialized)
+        return 0;
+
+    // the output plays out every buffered period, and the input waits for a whole period
+    const ma_uint32 period = _device->playback.internalPeriodSizeInFrames;
+    double latency = double(period) * _device->playback.internalPeriods / _device->playback.internalSampleRate;
+    if (_device->type == ma_device_type_duplex)
+        latency += double(_device->capture.internalPeriodSizeInFrames) / _device->capture.internalSampleRate;
+    else if (_drift)
+        latency += double(_drift->targetFrames()) / authoritativeDeviceSampleRateAtRuntime;
+
+    // callbacks that aren't a whole number of quanta hold up to a quantum back for the next one
+    if (period % _renderQuantum)
+        latency += double(_renderQuantum) / authoritativeDeviceSampleRateAtRuntime;
+    return latency;
+}
+
+void * AudioDevice_Miniaudio::renderWorkgroup() const
+{
+#if defined(MA_HAS_COREAUDIO) && (defined(__MAC_11_0) || defined(__IPHONE_14_0))
+    if (!_initialized || _device->pContext->backend != ma_backend_coreaudio || !_device->coreaudio.audioUnitPlayback)
+        return nullptr;
+
+    // miniaudio loads AudioUnitGetProperty at run time, so it is called through the context
+    typedef OSStatus (*GetProperty)(AudioUnit, AudioUnitPropertyID, AudioUnitScope, AudioUnitElement, void *, UInt32 *);
+    GetProperty getProperty = reinterpret_cast<GetProperty>(_device->pContext->coreaudio.AudioUnitGetProperty);
+    os_workgroup_t workgroup = nullptr;
+    UInt32 size = sizeof(workgroup);
+    if (!getProperty || getProperty(static_cast<AudioUnit>(_device->coreaudio.audioUnitPlayback), kAudioOutputUnitProperty_OSWorkgroup,
+                                    kAudioUnitScope_Global, 0, &workgroup, &size) != noErr)
+        return nullptr;
+    return workgroup;
+#else
+    return nullptr;
+#endif
+}
+
+// Renders one quantum of the graph into _renderBus
+void AudioDevice_Miniaudio::renderQuantum()
+{
+    // Update sampling info for use by the render graph
+    const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
+    const uint64_t t = samplingInfo.current_sample_frame & ~1;
+    samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
+    samplingInfo.current_sample_frame = t + _renderQuantum + index;
+    samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
+    samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    // generate new data
+    _destinationNode->render(sourceProvider(), _inputBus, _renderBus, _renderQuantum, samplingInfo);
+}
 
 // Pulls on our provider to get rendered audio stream.
 void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, void * inputBuffer)
 {
+    const ProfileClock::time_point callbackStart = beginCallback();
     int numberOfFrames = numberOfFrames_;
     if (!_renderBus)
     {
-        _renderBus = new AudioBus(_outConfig.desired_channels, kRenderQuantum, true);
+        // the graph is rendered in quanta of the size its context was configured with
+        _renderQuantum = _destinationNode ? _destinationNode->renderQuantumSize() : AudioNode::ProcessingSizeInFrames;
+        _renderBus = new AudioBus(_outConfig.desired_channels, _renderQuantum, true);
         _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
     }
 
     if (!_inputBus && _inConfig.desired_channels)
     {
-        _inputBus = new AudioBus(_inConfig.desired_channels, kRenderQuantum, true);
+        _inputBus = new AudioBus(_inConfig.desired_channels, _renderQuantum, true);
         _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        _scratch = reinterpret_cast<float *>(malloc(sizeof(float) * _renderQuantum * _inConfig.desired_channels));
     }
 
     float * pIn = static_cast<float *>(inputBuffer);
@@ -321,6 +735,55 @@ void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, voi
     int in_channels = _inConfig.desired_channels;
     int out_channels = _outConfig.desired_channels;
 
+    if (static_cast<int>(_outputChannels.size()) != out_channels)
+        _outputChannels.resize(out_channels);
+    if (static_cast<int>(_inputChannels.size()) != in_channels)
+    {
+        _inputChannels.resize(in_channels);
+        for (int i = 0; i < in_channels; ++i)
+            _inputChannels[i] = _inputBus->channel(i)->mutableData();
+    }
+
+    // When the callback is a whole number of quanta and nothing is left over from the
+    // last one, the device buffers are converted in place, bypassing the ring and the
+    // remainder bookkeeping.
+    const bool direct = _remainder == 0 && numberOfFrames % _renderQuantum == 0 &&
+                        (!in_channels || _ring->getAvailableRead() == 0);
+    if (direct)
+    {
+        for (; numberOfFrames > 0; numberOfFrames -= _renderQuantum)
+        {
+            if (in_channels)
+            {
+                if (pIn)
+                {
+                    SampleConversion::deinterleave(pIn, SampleConversion::SampleFormat::Float32,
+                                                   in_channels, _renderQuantum, _inputChannels.data());
+                    pIn += in_channels * _renderQuantum;
+                }
+                else if (_drift)
+                {
+                    _drift->read(_scratch, _renderQuantum);
+                    SampleConversion::deinterleave(_scratch, SampleConversion::SampleFormat::Float32,
+                                                   in_channels, _renderQuantum, _inputChannels.data());
+                }
+                else
+                    _inputBus->zero();
+            }
+
+            renderQuantum();
+
+            for (int i = 0; i < out_channels; ++i)
+                _outputChannels[i] = _renderBus->channel(i)->data();
+            SampleConversion::interleave(_outputChannels.data(), out_channels, _renderQuantum,
+                                         SampleConversion::SampleFormat::Float32, pOut);
+            pOut += out_channels * _renderQuantum;
+        }
+
+        endCallback(callbackStart, numberOfFrames_, authoritativeDeviceSampleRateAtRuntime);
+        return;
+    }
+
     if (pIn && numberOfFrames * in_channels)
         _ring->write(pIn, numberOfFrames * in_channels);
 
@@ -330,21 +793,13 @@ void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, voi
         {
             // copy samples to output buffer. There might have been some rendered frames
             // left over from the previous numberOfFrames, so start by moving those into
-            // the output buffer.
-
-            // miniaudio expects interleaved data, this loop leverages the vclip operation
-            // to copy, interleave, and clip in one pass.
+            // the output buffer. All channels are clipped and interleaved in one pass.
 
             int samples = _remainder < numberOfFrames ? _remainder : numberOfFrames;
             for (int i = 0; i < out_channels; ++i)
-            {
-                int src_stride = 1;  // de-interleaved
-                int dst_stride = out_channels;  // interleaved
-                AudioChannel * channel = _renderBus->channel(i);
-                VectorMath::vclip(channel->data() + kRenderQuantum - _remainder, src_stride,
-                                  &kLowThreshold, &kHighThreshold,
-                                  pOut + i, dst_stride, samples);
-            }
+                _outputChannels[i] = _renderBus->channel(i)->data() + _renderQuantum - _remainder;
+            SampleConversion::interleave(_outputChannels.data(), out_channels, samples,
+                                         SampleConversion::SampleFormat::Float32, pOut);
             pOut += out_channels * samples;
 
             numberOfFrames -= samples;  // deduct samples actually copied to output
@@ -354,33 +809,21 @@ void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, voi
         {
             if (in_channels)
             {
-                // miniaudio provides the input data in interleaved form, vclip is used here to de-interleave
-
-                _ring->read(_scratch, in_channels * kRenderQuantum);
-                for (int i = 0; i < in_channels; ++i)
-                {
-                    int src_stride = in_channels;  // interleaved
-                    int dst_stride = 1;  // de-interleaved
-                    AudioChannel * channel = _inputBus->channel(i);
-                    VectorMath::vclip(_scratch + i, src_stride,
-                                      &kLowThreshold, &kHighThreshold,
-                                      channel->mutableData(), dst_stride, kRenderQuantum);
-                }
+                // miniaudio provides the input data in interleaved form
+                if (_drift)
+                    _drift->read(_scratch, _renderQuantum);
+                else
+                    _ring->read(_scratch, in_channels * _renderQuantum);
+                SampleConversion::deinterleave(_scratch, SampleConversion::SampleFormat::Float32,
+                                               in_channels, _renderQuantum, _inputChannels.data());
             }
 
-            // Update sampling info for use by the render graph
-            const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
-            const uint64_t t = samplingInfo.current_sample_frame & ~1;
-            samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
-            samplingInfo.current_sample_frame = t + kRenderQuantum + index;
-            samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
-            samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
-
-            // generate new data
-            _destinationNode->render(sourceProvider(), _inputBus, _renderBus, kRenderQuantum, samplingInfo);
-            _remainder = kRenderQuantum;
+            renderQuantum();
+            _remainder = _renderQuantum;
         }
     }
+
+    endCallback(callbackStart, numberOfFrames_, authoritativeDeviceSampleRateAtRuntime);
 }
 
 }  // namespace lab
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/backends/AudioDevice_WebAudio.h"
+
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/StartupTiming.h"
+
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <emscripten/em_asm.h>
+#include <emscripten/threading.h>
+#include <emscripten/webaudio.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+////////////////////////////////////////////////////
+//   Platform/backend specific static functions   //
+////////////////////////////////////////////////////
+
+namespace
+{
+    const char * kProcessorName = "labsound-device";
+    const int kWorkletStackSize = 16 * 1024;
+    const int kWorkletQuantum = 128;            // the frames of each worklet callback
+    const int kDefaultLeadFrames = 4 * kWorkletQuantum;
+    const int kMaxRenderQuantum = 4096;
+    const int kMaxChannels = 32;
+
+    const float kLowThreshold = -1.0f;
+    const float kHighThreshold = 1.0f;
+
+    EM_BOOL processCallback(int numInputs, const AudioSampleFrame * inputs,
+                            int numOutputs, AudioSampleFrame * outputs,
+                            int numParams, const AudioParamFrame * params, void * userData)
+    {
+        const float * input = numInputs > 0 ? inputs[0].data : nullptr;
+        const int inputChannels = numInputs > 0 ? inputs[0].numberOfChannels : 0;
+        float * output = numOutputs > 0 ? outputs[0].data : nullptr;
+        const int outputChannels = numOutputs > 0 ? outputs[0].numberOfChannels : 0;
+        return reinterpret_cast<AudioDevice_WebAudio *>(userData)->process(input, inputChannels, output, outputChannels, kWorkletQuantum);
+    }
+
+    void processorCreated(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void * userData)
+    {
+        if (!success)
+        {
+            LOG_ERROR("[AudioDevice_WebAudio] unable to register the audio worklet processor");
+            return;
+        }
+
+        AudioDevice_WebAudio * device = reinterpret_cast<AudioDevice_WebAudio *>(userData);
+        int outputChannelCounts[1] = {static_cast<int>(device->getOutputConfig().desired_channels)};
+
+        EmscriptenAudioWorkletNodeCreateOptions options = {};
+        options.numberOfInputs = device->getInputConfig().desired_channels > 0 ? 1 : 0;
+        options.numberOfOutputs = 1;
+        options.outputChannelCounts = outputChannelCounts;
+
+        EMSCRIPTEN_AUDIO_WORKLET_NODE_T node = emscripten_create_wasm_audio_worklet_node(context, kProcessorName, &options, processCallback, userData);
+        emscripten_audio_node_connect(node, context, 0, 0);
+        device->workletReady(node);
+    }
+
+    void workletThreadStarted(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void * userData)
+    {
+        if (!success)
+        {
+            LOG_ERROR("[AudioDevice_WebAudio] unable to start the audio worklet thread");
+            return;
+        }
+
+        WebAudioWorkletProcessorCreateOptions options = {};
+        options.name = kProcessorName;
+        emscripten_create_wasm_audio_worklet_processor_async(context, &options, processorCreated, userData);
+    }
+}
+
+// static
+std::vector<AudioDeviceInfo> AudioDevice_WebAudio::MakeAudioDeviceList()
+{
+    std::vector<AudioDeviceInfo> devices;
+
+    // a context made outside a gesture is suspended, which is all that's needed to ask it
+    const double rate = EM_ASM_DOUBLE({
+        var Context = globalThis.AudioContext || globalThis.webkitAudioContext;
+        if (!Context)
+            return 0;
+        var c = new Context();
+        var r = c.sampleRate;
+        c.close();
+        return r;
+    });
+    const int channels = EM_ASM_INT({
+        var Context = globalThis.AudioContext || globalThis.webkitAudioContext;
+        if (!Context)
+            return 0;
+        var c = new Context();
+        var n = c.destination.maxChannelCount;
+        c.close();
+        return n;
+    });
+    if (rate <= 0)
+    {
+        LOG_ERROR("Web Audio is not available");
+        return devices;
+    }
+
+    AudioDeviceInfo info;
+    info.index = 0;
+    info.identifier = "Web Audio";
+    info.num_output_channels = static_cast<uint32_t>(channels);
+    info.num_input_channels = 2;  // whatever the application connects to the node's input
+    info.nominal_samplerate = static_cast<float>(rate);
+    info.supported_samplerates.push_back(info.nominal_samplerate);
+    info.is_default_output = true;
+    info.is_default_input = true;
+    devices.push_back(info);
+    return devices;
+}
+
+/////////////////////////////
+//   AudioDevice_WebAudio  //
+/////////////////////////////
+
+AudioDevice_WebAudio::AudioDevice_WebAudio(const AudioStreamConfig & _inputConfig, const AudioStreamConfig & _outputConfig)
+: AudioDevice(_inputConfig, _outputConfig)
+{
+    StartupPhaseScope phase("device open");
+    samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
+
+    _outConfig.desired_channels = std::min<uint32_t>(std::max<uint32_t>(_outConfig.desired_channels, 1), kMaxChannels);
+    _inConfig.desired_channels = std::min<uint32_t>(_inConfig.desired_channels, kMaxChannels);
+
+    EmscriptenWebAudioCreateAttributes attributes = {};
+    attributes.latencyHint = "interactive";
+    attributes.sampleRate = static_cast<uint32_t>(_outConfig.desired_samplerate);  // zero is the browser's choice
+    _context = emscripten_create_audio_context(&attributes);
+
+    // the browser may not honor the rate asked for
+    authoritativeDeviceSampleRateAtRuntime = static_cast<float>(EM_ASM_DOUBLE({ return emscriptenGetAudioObject($0).sampleRate; }, _context));
+    if (_outConfig.desired_samplerate != 0.f && _outConfig.desired_samplerate != authoritativeDeviceSampleRateAtRuntime)
+        LOG_INFO("[AudioDevice_WebAudio] requested a %f Hz sample rate, the browser runs at %f Hz", _outConfig.desired_samplerate, authoritativeDeviceSampleRateAtRuntime);
+    _outConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+    _inConfig.desired_samplerate = authoritativeDeviceSampleRateAtRuntime;
+
+    // a period, if given, is how far ahead of the worklet the graph is rendered
+    _leadFrames = _outConfig.period_frames ? static_cast<int>(_outConfig.period_frames * std::max<uint32_t>(_outConfig.periods, 1)) : kDefaultLeadFrames;
+    _leadFrames = std::max(_leadFrames, kWorkletQuantum);
+    _outputRing.reset(new AudioRingBuffer(_outConfig.desired_channels, _leadFrames + kMaxRenderQuantum));
+    if (_inConfig.desired_channels)
+        _inputRing.reset(new AudioRingBuffer(_inConfig.desired_channels, _leadFrames + kMaxRenderQuantum));
+
+    // the worklet runs this module's code on the browser's audio thread, on a stack of its own
+    _workletStack.resize(kWorkletStackSize);
+    emscripten_start_wasm_audio_worklet_thread_async(_context, _workletStack.data(), kWorkletStackSize, workletThreadStarted, this);
+}
+
+AudioDevice_WebAudio::~AudioDevice_WebAudio()
+{
+    stop();
+
+    _closing.store(true);
+    if (const int node = _node.load())
+        EM_ASM({ emscriptenGetAudioObject($0).disconnect(); }, node);
+    EM_ASM({ emscriptenGetAudioObject($0).close(); }, _context);
+    while (_inProcess.load())
+        std::this_thread::yield();
+    emscripten_destroy_audio_context(_context);
+
+    delete _renderBus;
+    delete _inputBus;
+}
+
+void AudioDevice_WebAudio::workletReady(int node)
+{
+    _node.store(node, std::memory_order_release);
+    if (_wantRunning.load())
+        emscripten_resume_audio_context_sync(_context);
+}
+
+void AudioDevice_WebAudio::start()
+{
+    ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+    _wantRunning.store(true);
+
+    if (!_renderThreadShouldRun.exchange(true))
+        _renderThread = std::thread(&AudioDevice_WebAudio::renderLoop, this);
+
+    // otherwise the context is resumed as soon as the worklet is ready
+    if (_node.load(std::memory_order_acquire))
+        emscripten_resume_audio_context_sync(_context);
+}
+
+void AudioDevice_WebAudio::stop()
+{
+    _wantRunning.store(false);
+    EM_ASM({ emscriptenGetAudioObject($0).suspend(); }, _context);
+
+    if (_renderThreadShouldRun.exchange(false))
+    {
+        _consumed.fetch_add(1);
+        emscripten_futex_wake(&_consumed, 1);
+        if (_renderThread.joinable())
+            _renderThread.join();
+    }
+}
+
+bool AudioDevice_WebAudio::isRunning() const
+{
+    return _wantRunning.load() && emscripten_audio_context_state(_context) == AUDIO_CONTEXT_STATE_RUNNING;
+}
+
+void AudioDevice_WebAudio::backendReinitialize()
+{
+    // there is only the one output, which the browser routes as it will
+    const bool wasRunning = _wantRunning.load();
+    stop();
+    if (wasRunning)
+        start();
+}
+
+double AudioDevice_WebAudio::roundTripLatency() const
+{
+    if (authoritativeDeviceSampleRateAtRuntime <= 0.f)
+        return 0;
+
+    const double browser = EM_ASM_DOUBLE({
+        var c = emscriptenGetAudioObject($0);
+        return (c.baseLatency || 0) + (c.outputLatency || 0);
+    }, _context);
+    return browser + (_leadFrames + (_inputRing ? _leadFrames : 0)) / static_cast<double>(authoritativeDeviceSampleRateAtRuntime);
+}
+
+// Renders one quantum of the graph into the output ring
+void AudioDevice_WebAudio::renderQuantum()
+{
+    const ProfileClock::time_point callbackStart = beginCallback();
+
+    if (_inputBus && !_inputRing->read(_inputChannels.data(), _renderQuantum))
+        _inputBus->zero();
+
+    // Update sampling info for use by the render graph
+    const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
+    const uint64_t t = samplingInfo.current_sample_frame & ~1;
+    samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
+    samplingInfo.current_sample_frame = t + _renderQuantum + index;
+    samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
+    samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    _destinationNode->render(sourceProvider(), _inputBus, _renderBus, _renderQuantum, samplingInfo);
+
+    for (float * p : _outputChannels)
+        VectorMath::vclip(p, 1, &kLowThreshold, &kHighThreshold, p, 1, _renderQuantum);
+    _outputRing->write(_outputChannels.data(), _renderQuantum);
+
+    endCallback(callbackStart, _renderQuantum, authoritativeDeviceSampleRateAtRuntime);
+}
+
+// Keeps the output ring filled to the lead, waking whenever the worklet takes frames
+void AudioDevice_WebAudio::renderLoop()
+{
+    while (_renderThreadShouldRun.load())
+    {
+        const uint32_t consumed = _consumed.load(std::memory_order_acquire);
+
+        if (_destinationNode && !_renderBus)
+        {
+            // the graph is rendered in quanta of the size its context was configured with
+            _renderQuantum = std::min(_destinationNode->renderQuantumSize(), kMaxRenderQuantum);
+            _renderBus = new AudioBus(_outConfig.desired_channels, _renderQuantum, true);
+            _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+            for (int i = 0; i < static_cast<int>(_outConfig.desired_channels); ++i)
+                _outputChannels.push_back(_renderBus->channel(i)->mutableData());
+            if (_inputRing)
+            {
+                _inputBus = new AudioBus(_inConfig.desired_channels, _renderQuantum, true);
+                _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+                for (int i = 0; i < static_cast<int>(_inConfig.desired_channels); ++i)
+                    _inputChannels.push_back(_inputBus->channel(i)->mutableData());
+            }
+        }
+
+        if (_renderBus)
+        {
+            const size_t capacity = _outputRing->capacity();
+            while (_renderThreadShouldRun.load(std::memory_order_relaxed) &&
+                   capacity - _outputRing->availableWrite() < static_cast<size_t>(_leadFrames) &&
+                   _outputRing->availableWrite() >= static_cast<size_t>(_renderQuantum))
+            {
+                renderQuantum();
+            }
+        }
+
+        // the timeout covers a destination node arriving, which nothing signals
+        emscripten_futex_wait(&_consumed, consumed, 10.0);
+    }
+}
+
+// Called by the browser from the worklet; copies a quantum out of the output ring, and the
+// input into the input ring
+bool AudioDevice_WebAudio::process(const float * input, int inputChannels, float * output, int outputChannels, int frames)
+{
+    _inProcess.store(true);
+    if (_closing.load())
+    {
+        _inProcess.store(false);
+        return false;
+    }
+
+    if (output)
+    {
+        float * channels[kMaxChannels];
+        const int count = std::min(outputChannels, kMaxChannels);
+        for (int i = 0; i < count; ++i)
+            channels[i] = output + i * frames;
+
+        // the ring holds as many channels as the node was made with
+        if (count != _outputRing->channelCount() || !_outputRing->read(channels, frames))
+        {
+            memset(output, 0, sizeof(float) * outputChannels * frames);
+            if (_renderThreadShouldRun.load(std::memory_order_relaxed))
+                reportXrun();
+        }
+    }
+
+    if (_inputRing)
+    {
+        const float * channels[kMaxChannels] = {};
+        for (int i = 0; input && i < std::min(inputChannels, _inputRing->channelCount()); ++i)
+            channels[i] = input + i * frames;
+        if (!_inputRing->write(channels, frames))
+            reportXrun();
+    }
+
+    _consumed.fetch_add(1, std::memory_order_release);
+    emscripten_futex_wake(&_consumed, 1);
+
+    _inProcess.store(false);
+    return true;
+}
+
+}  // namespace lab
@@ -10,6 +10,7 @@
 #include "LabSound/extended/RealtimeAnalyser.h"
 #include "LabSound/extended/Registry.h"
 #include "internal/Assertions.h"
+#include "internal/SpectralAnalysis.h"
 #include <algorithm>
 
 namespace lab
@@ -179,7 +180,7 @@ void AnalyserNode::process(ContextRenderLock & r, int bufferSize)
     }
 
     // Give the analyser all the audio which is passing through this AudioNode.
-    _detail->m_analyser->writeInput(r, inputBus, bufferSize);
+    _detail->m_analyser->writeInput(r, inputBus, bufferSize, SpectralAnalysis::tapOf(r, input(0).get()));
 
     if (inputBus != outputBus)
     {
@@ -5,19 +5,24 @@
 #include "LabSound/core/AudioBus.h"
 #include "internal/Assertions.h"
 #include "internal/DenormalDisabler.h"
+#include "internal/MixingMatrix.h"
+#include "LabSound/extended/JobSystem.h"
 #include "LabSound/extended/VectorMath.h"
 #include "libsamplerate/include/samplerate.h"
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <math.h>
+#include <stdexcept>
+#include <vector>
 
 namespace lab
 {
 
 using namespace VectorMath;
 
-const unsigned MaxBusChannels = 32;
+const unsigned MaxBusChannels = 64;
 
 AudioBus::AudioBus(int numberOfChannels, int length, bool allocate)
     : m_length(length)
@@ -26,16 +31,68 @@ AudioBus::AudioBus(int numberOfChannels, int length, bool allocate)
     if (numberOfChannels > MaxBusChannels)
         return;
 
+    if (allocate)
+    {
+        allocatePlanar(numberOfChannels, 0);
+        return;
+    }
+
     for (int i = 0; i < numberOfChannels; ++i)
     {
-        AudioChannel * newChannel;
-        if (allocate)
-            newChannel = new AudioChannel(length);
-        else
-            newChannel = new AudioChannel(nullptr, length);
+        m_channels.emplace_back(std::unique_ptr<AudioChannel>(new AudioChannel(nullptr, length)));
+    }
+}
 
+AudioBus::~AudioBus()
+{
+    // the channels only refer to the block
+    AudioMemoryPool::deallocate(m_block, m_blockBytes);
+    if (m_memory)
+        m_memory->charge(-static_cast<int64_t>(m_blockBytes));
+}
+
+void AudioBus::allocatePlanar(int numberOfChannels, int preserveChannels)
+{
+    // each channel starts on an aligned boundary
+    const int alignedFrames = static_cast<int>(AudioMemoryPool::Alignment / sizeof(float));
+    const int stride = (m_length + alignedFrames - 1) / alignedFrames * alignedFrames;
+    const size_t bytes = sizeof(float) * stride * numberOfChannels;
+
+    float * block = nullptr;
+    if (bytes)
+    {
+        block = static_cast<float *>(AudioMemoryPool::allocate(bytes));
+        if (!block)
+            throw std::bad_alloc();
+    }
+    std::shared_ptr<MemoryOwner> memory = bytes ? MemoryAccounting::charge(static_cast<int64_t>(bytes)) : nullptr;
+
+    for (int i = 0; i < preserveChannels; ++i)
+    {
+        AudioChannel * preserved = m_channels[i].get();
+        const bool silent = preserved->isSilent();
+        if (!silent)
+            memcpy(block + i * stride, preserved->data(), sizeof(float) * preserved->length());
+        preserved->set(block + i * stride, preserved->length());
+        if (silent)
+            preserved->zero();
+    }
+
+    for (int i = static_cast<int>(m_channels.size()); i < numberOfChannels; ++i)
+    {
+        AudioChannel * newChannel = new AudioChannel(block + i * stride, m_length);
+        newChannel->zero();
         m_channels.emplace_back(std::unique_ptr<AudioChannel>(newChannel));
     }
+
+    AudioMemoryPool::deallocate(m_block, m_blockBytes);
+    if (m_memory)
+        m_memory->charge(-static_cast<int64_t>(m_blockBytes));
+    m_block = block;
+    m_blockBytes = bytes;
+    m_memory = std::move(memory);
+    m_channelStride = stride;
+    m_planar = true;
 }
 
 void AudioBus::setChannelMemory(int channelIndex, float * storage, int length)
@@ -44,9 +101,26 @@ void AudioBus::setChannelMemory(int channelIndex, float * storage, int length)
     {
         channel(channelIndex)->set(storage, length);
         m_length = length;  // @fixme - verify that this length matches all the other channel lengths
+        m_planar = false;
     }
 }
 
+float * AudioBus::planarData()
+{
+    if (!m_planar)
+        return nullptr;
+
+    for (auto & c : m_channels)
+        if (c->isAliased())
+            return nullptr;
+    return m_block;
+}
+
+const float * AudioBus::planarData() const
+{
+    return const_cast<AudioBus *>(this)->planarData();
+}
+
 void AudioBus::setNumberOfChannels(ContextRenderLock& r, int c)
 {
     if (c == m_channels.size())
@@ -58,6 +132,13 @@ void AudioBus::setNumberOfChannels(ContextRenderLock& r, int c)
         return;
     }
 
+    ASSERT(c <= MaxBusChannels);
+    if (m_planar)
+    {
+        allocatePlanar(c, static_cast<int>(m_channels.size()));
+        return;
+    }
+
     while (c > m_channels.size())
     {
         AudioChannel * newChannel = new AudioChannel(m_length);
@@ -65,6 +146,37 @@ void AudioBus::setNumberOfChannels(ContextRenderLock& r, int c)
     }
 }
 
+void AudioBus::copyToInterleaved(float * destination, int frames) const
+{
+    const int channels = numberOfChannels();
+    frames = std::min(frames, m_length);
+    for (int c = 0; c < channels; ++c)
+    {
+        const AudioChannel * source = channel(c);
+        const float * data = source->data();
+        float * dest = destination + c;
+        if (source->isSilent())
+            for (int i = 0; i < frames; ++i, dest += channels)
+                *dest = 0.f;
+        else
+            for (int i = 0; i < frames; ++i, dest += channels)
+                *dest = data[i];
+    }
+}
+
+void AudioBus::copyFromInterleaved(const float * source, int frames)
+{
+    const int channels = numberOfChannels();
+    frames = std::min(frames, m_length);
+    for (int c = 0; c < channels; ++c)
+    {
+        float * data = channel(c)->mutableData();
+        const float * src = source + c;
+        for (int i = 0; i < frames; ++i, src += channels)
+            data[i] = *src;
+    }
+}
+
 void AudioBus::resizeSmaller(int newLength)
 {
     ASSERT(newLength <= m_length);
@@ -87,88 +199,28 @@ void AudioBus::zero()
     }
 }
 
-AudioChannel * AudioBus::channelByType(Channel channelType)
+int AudioBus::registerLayout(const Channel * positions, int count)
 {
-    // For now we only support canonical channel layouts...
-    if (m_layout != LayoutCanonical) return 0;
-
-    switch (numberOfChannels())
-    {
-        case Channels::Mono:
-            if (channelType == Channel::Mono || channelType == Channel::Left || channelType == Channel::First)
-            {
-                return channel(static_cast<int>(Channel::Left));
-            }
-            return 0;
-
-        case Channels::Stereo:
-            switch (channelType)
-            {
-                case Channel::Left:
-                case Channel::Right:
-                    return channel(static_cast<int>(channelType));
-                default:
-                    return 0;
-            }
+    return MixingMatrix::registerLayout(positions, count);
+}
 
-        case Channels::Quad:
-            switch (channelType)
-            {
-                case Channel::Left:
-                case Channel::Right:
-                case Channel::SurroundLeft:
-                case Channel::SurroundRight:
-                    return channel(static_cast<int>(channelType));
-                default:
-                    return 0;
-            }
+int AudioBus::speakerLayout() const
+{
+    if (m_layout != LayoutCanonical && MixingMatrix::layoutChannels(m_layout) == numberOfChannels())
+        return m_layout;
+    return MixingMatrix::canonicalLayout(numberOfChannels());
+}
 
-        case Channels::Surround_5_0:
-            switch (channelType)
-            {
-                case Channel::Left:
-                case Channel::Right:
-                case Channel::Center:
-                case Channel::SurroundLeft:
-                case Channel::SurroundRight:
-                    return channel(static_cast<int>(channelType));
-                default:
-                    return 0;
-            }
+AudioChannel * AudioBus::channelByType(Channel channelType)
+{
+    const int layout = speakerLayout();
 
-        case Channels::Surround_5_1:
-            switch (channelType)
-            {
-                case Channel::Left:
-                case Channel::Right:
-                case Channel::Center:
-                case Channel::LFE:
-                case Channel::SurroundLeft:
-                case Channel::SurroundRight:
-                    return channel(static_cast<int>(channelType));
-                default:
-                    return 0;
-            }
+    // the one channel of a mono bus is its left as well as its center
+    if (layout == LayoutMono && channelType == Channel::Left)
+        return channel(0);
 
-        case Channels::Surround_7_1:
-            switch (channelType)
-            {
-                case Channel::Left:
-                case Channel::Right:
-                case Channel::Center:
-                case Channel::LFE:
-                case Channel::SurroundLeft:
-                case Channel::SurroundRight:
-                case Channel::BackLeft:
-                case Channel::BackRight:
-                    return channel(static_cast<int>(channelType));
-                default:
-                    return 0;
-            }
-    }
-
-    ASSERT_NOT_REACHED();
-    return 0;
+    const int index = MixingMatrix::channelIndex(layout, channelType);
+    return index >= 0 ? channel(index) : nullptr;
 }
 
 const AudioChannel * AudioBus::channelByType(Channel type) const
@@ -232,6 +284,22 @@ std::unique_ptr<AudioBus> AudioBus::createByCloning(const AudioBus * sourceBus)
     return clonedBus;
 }
 
+std::unique_ptr<AudioBus> AudioBus::createByWrapping(float * const * channels, int numberOfChannels, int length, float sampleRate)
+{
+    if (!channels || numberOfChannels <= 0 || numberOfChannels > static_cast<int>(MaxBusChannels) || length <= 0)
+        throw std::invalid_argument("Wrapped memory must have between 1 and 64 channels, and a positive length");
+
+    std::unique_ptr<AudioBus> bus(new AudioBus(numberOfChannels, length, false));
+    bus->setSampleRate(sampleRate);
+    for (int i = 0; i < numberOfChannels; ++i)
+    {
+        if (!channels[i])
+            throw std::invalid_argument("Wrapped memory can't be null");
+        bus->setChannelMemory(i, channels[i], length);
+    }
+    return bus;
+}
+
 float AudioBus::maxAbsValue() const
 {
     float max = 0.0f;
@@ -258,8 +326,7 @@ void AudioBus::scale(float scale)
 }
 
 // Just copies the samples from the source bus to this one.
-// This is just a simple copy if the number of channels match, otherwise a mixup or mixdown is done.
-// For now, we just support mixup from mono -> stereo and mixdown from stereo -> mono.
+// This is just a simple copy if the channels match, otherwise a mixup or mixdown is done.
 void AudioBus::copyFrom(const AudioBus & sourceBus, ChannelInterpretation channelInterpretation)
 {
     if (&sourceBus == this) return;
@@ -267,7 +334,8 @@ void AudioBus::copyFrom(const AudioBus & sourceBus, ChannelInterpretation channe
     int numberOfSourceChannels = sourceBus.numberOfChannels();
     int numberOfDestinationChannels = numberOfChannels();
 
-    if (numberOfDestinationChannels == numberOfSourceChannels)
+    if (numberOfDestinationChannels == numberOfSourceChannels &&
+        (channelInterpretation == ChannelInterpretation::Discrete || speakerLayout() == sourceBus.speakerLayout()))
     {
         for (int i = 0; i < numberOfSourceChannels; ++i)
         {
@@ -293,7 +361,8 @@ void AudioBus::sumFrom(const AudioBus & sourceBus, ChannelInterpretation channel
     int numberOfSourceChannels = sourceBus.numberOfChannels();
     int numberOfDestinationChannels = numberOfChannels();
 
-    if (numberOfDestinationChannels == numberOfSourceChannels)
+    if (numberOfDestinationChannels == numberOfSourceChannels &&
+        (channelInterpretation == ChannelInterpretation::Discrete || speakerLayout() == sourceBus.speakerLayout()))
     {
         for (int i = 0; i < numberOfSourceChannels; ++i)
         {
@@ -312,199 +381,22 @@ void AudioBus::sumFrom(const AudioBus & sourceBus, ChannelInterpretation channel
     }
 }
 
+// Busses with speaker layouts mix through the matrix for their pair of layouts; a bus
+// whose channel count has no layout, nor has been given one, mixes discretely.
 void AudioBus::speakersCopyFrom(const AudioBus & sourceBus)
 {
-    // FIXME: Implement down mixing 5.1 to stereo.
-    // https://bugs.webkit.org/show_bug.cgi?id=79192
-
-    const int numberOfSourceChannels = sourceBus.numberOfChannels();
-    const int numberOfDestinationChannels = numberOfChannels();
-
-    if (numberOfDestinationChannels == Channels::Stereo && numberOfSourceChannels == Channels::Mono)
-    {
-        // Handle mono -> stereo case (for now simply copy mono channel into both left and right)
-        // FIXME: Really we should apply an equal-power scaling factor here, since we're effectively panning center...
-        const AudioChannel * sourceChannel = sourceBus.channel(0);
-        channelByType(Channel::Left)->copyFrom(sourceChannel);
-        channelByType(Channel::Right)->copyFrom(sourceChannel);
-    }
-    else if (numberOfDestinationChannels == Channels::Mono && numberOfSourceChannels == Channels::Stereo)
-    {
-        // Handle stereo -> mono case. output = 0.5 * (input.L + input.R).
-        AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
-
-        const float * sourceL = sourceBusSafe.channelByType(Channel::Left)->data();
-        const float * sourceR = sourceBusSafe.channelByType(Channel::Right)->data();
-
-        float * destination = channelByType(Channel::Left)->mutableData();
-        vadd(sourceL, 1, sourceR, 1, destination, 1, length());
-        float scale = 0.5;
-        vsmul(destination, 1, &scale, destination, 1, length());
-    }
-    else if (numberOfDestinationChannels == Channels::Surround_5_1 && numberOfSourceChannels == Channels::Mono)
-    {
-        // Handle mono -> 5.1 case, copy mono channel to center.
-        channelByType(Channel::Center)->copyFrom(sourceBus.channel(0));
-        channelByType(Channel::Left)->zero();
-        channelByType(Channel::Right)->zero();
-        channelByType(Channel::LFE)->zero();
-        channelByType(Channel::SurroundLeft)->zero();
-        channelByType(Channel::SurroundRight)->zero();
-    }
-    else if (numberOfDestinationChannels == Channels::Mono && numberOfSourceChannels == Channels::Surround_5_1)
-    {
-        // Handle 5.1 -> mono case.
-        zero();
-        speakersSumFrom5_1_ToMono(sourceBus);
-    }
-    else if (numberOfDestinationChannels == Channels::Surround_7_1 && numberOfSourceChannels == Channels::Mono)
-    {
-        // Handle mono -> 7.1 case, copy mono channel to center.
-        channelByType(Channel::Center)->copyFrom(sourceBus.channel(0));
-        channelByType(Channel::Left)->zero();
-        channelByType(Channel::Right)->zero();
-        channelByType(Channel::LFE)->zero();
-        channelByType(Channel::SurroundLeft)->zero();
-        channelByType(Channel::SurroundRight)->zero();
-        channelByType(Channel::BackLeft)->zero();
-        channelByType(Channel::BackRight)->zero();
-    }
-    else if (numberOfDestinationChannels == Channels::Mono && numberOfSourceChannels == Channels::Surround_7_1)
-    {
-        // Handle 7.1 -> mono case.
-        zero();
-        speakersSumFrom7_1_ToMono(sourceBus);
-    }
+    if (const MixingMatrix * matrix = MixingMatrix::find(sourceBus.speakerLayout(), speakerLayout()))
+        matrix->copy(sourceBus, *this);
     else
-    {
-        // Fallback for unknown combinations.
         discreteCopyFrom(sourceBus);
-    }
 }
 
 void AudioBus::speakersSumFrom(const AudioBus & sourceBus)
 {
-    // FIXME: Implement down mixing 5.1 && 7.1 to stereo.
-    // https://bugs.webkit.org/show_bug.cgi?id=79192
-
-    const int numberOfSourceChannels = sourceBus.numberOfChannels();
-    const int numberOfDestinationChannels = numberOfChannels();
-
-    if (numberOfDestinationChannels == Channels::Stereo && numberOfSourceChannels == Channels::Mono)
-    {
-        // Handle mono -> stereo case (summing mono channel into both left and right).
-        const AudioChannel * sourceChannel = sourceBus.channel(0);
-        channelByType(Channel::Left)->sumFrom(sourceChannel);
-        channelByType(Channel::Right)->sumFrom(sourceChannel);
-    }
-    else if (numberOfDestinationChannels == Channels::Mono && numberOfSourceChannels == Channels::Stereo)
-    {
-        // Handle stereo -> mono case. output += 0.5 * (input.L + input.R).
-        AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
-
-        const float * sourceL = sourceBusSafe.channelByType(Channel::Left)->data();
-        const float * sourceR = sourceBusSafe.channelByType(Channel::Right)->data();
-
-        float * destination = channelByType(Channel::Left)->mutableData();
-        float scale = 0.5;
-        vsma(sourceL, 1, &scale, destination, 1, length());
-        vsma(sourceR, 1, &scale, destination, 1, length());
-    }
-    else if (numberOfDestinationChannels == Channels::Surround_5_1 && numberOfSourceChannels == Channels::Mono)
-    {
-        // Handle mono -> 5.1 case, sum mono channel into center.
-        channelByType(Channel::Center)->sumFrom(sourceBus.channel(0));
-    }
-    else if (numberOfDestinationChannels == Channels::Mono && numberOfSourceChannels == Channels::Surround_5_1)
-    {
-        // Handle 5.1 -> mono case.
-        speakersSumFrom5_1_ToMono(sourceBus);
-    }
-    else if (numberOfDestinationChannels == Channels::Surround_7_1 && numberOfSourceChannels == Channels::Mono)
-    {
-        // Handle mono -> 7.1 case, sum mono channel into center.
-        channelByType(Channel::Center)->sumFrom(sourceBus.channel(0));
-    }
-    else if (numberOfDestinationChannels == Channels::Mono && numberOfSourceChannels == Channels::Surround_7_1)
-    {
-        // Handle 7.1 -> mono case.
-        speakersSumFrom7_1_ToMono(sourceBus);
-    }
+    if (const MixingMatrix * matrix = MixingMatrix::find(sourceBus.speakerLayout(), speakerLayout()))
+        matrix->sum(sourceBus, *this);
     else
-    {
-        // Fallback for unknown combinations.
         discreteSumFrom(sourceBus);
-    }
-}
-
-void AudioBus::speakersSumFrom5_1_ToMono(const AudioBus & sourceBus)
-{
-    AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
-
-    const float * sourceL = sourceBusSafe.channelByType(Channel::Left)->data();
-    const float * sourceR = sourceBusSafe.channelByType(Channel::Right)->data();
-    const float * sourceC = sourceBusSafe.channelByType(Channel::Center)->data();
-    const float * sourceSL = sourceBusSafe.channelByType(Channel::SurroundLeft)->data();
-    const float * sourceSR = sourceBusSafe.channelByType(Channel::SurroundRight)->data();
-
-    float * destination = channelByType(Channel::Left)->mutableData();
-
-    AudioFloatArray temp(length());
-    float * tempData = temp.data();
-
-    // Sum in L and R.
-    vadd(sourceL, 1, sourceR, 1, tempData, 1, length());
-    float scale = 0.7071f;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-
-    // Sum in SL and SR.
-    vadd(sourceSL, 1, sourceSR, 1, tempData, 1, length());
-    scale = 0.5;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-
-    // Sum in center.
-    vadd(sourceC, 1, destination, 1, destination, 1, length());
-}
-
-void AudioBus::speakersSumFrom7_1_ToMono(const AudioBus & sourceBus)
-{
-    AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
-
-    const float * sourceL = sourceBusSafe.channelByType(Channel::Left)->data();
-    const float * sourceR = sourceBusSafe.channelByType(Channel::Right)->data();
-    const float * sourceC = sourceBusSafe.channelByType(Channel::Center)->data();
-    const float * sourceSL = sourceBusSafe.channelByType(Channel::SurroundLeft)->data();
-    const float * sourceSR = sourceBusSafe.channelByType(Channel::SurroundRight)->data();
-    const float * sourceBL = sourceBusSafe.channelByType(Channel::BackLeft)->data();
-    const float * sourceBR = sourceBusSafe.channelByType(Channel::BackRight)->data();
-
-    float * destination = channelByType(Channel::Left)->mutableData();
-
-    AudioFloatArray temp(length());
-    float * tempData = temp.data();
-
-    // Sum in L and R.
-    vadd(sourceL, 1, sourceR, 1, tempData, 1, length());
-    float scale = 0.7071f;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-
-    // Sum in SL and SR.
-    vadd(sourceSL, 1, sourceSR, 1, tempData, 1, length());
-    scale = 0.5;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-
-    // Sum in BL and BR.
-    vadd(sourceBL, 1, sourceBR, 1, tempData, 1, length());
-    scale = 0.5;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-
-    // Sum in center.
-    vadd(sourceC, 1, destination, 1, destination, 1, length());
 }
 
 void AudioBus::discreteCopyFrom(const AudioBus & sourceBus)
@@ -583,16 +475,6 @@ void AudioBus::copyWithGainFrom(const AudioBus & sourceBus, float * lastMixGain,
         return;
     }
 
-    AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
-    const float * sources[MaxBusChannels];
-    float * destinations[MaxBusChannels];
-
-    for (int i = 0; i < numberOfChannels; ++i)
-    {
-        sources[i] = sourceBusSafe.channel(i)->data();
-        destinations[i] = channel(i)->mutableData();
-    }
-
     // We don't want to suddenly change the gain from mixing one time slice to the next,
     // so we "de-zipper" by slowly changing the gain each sample-frame until we've achieved the target gain.
 
@@ -615,6 +497,26 @@ void AudioBus::copyWithGainFrom(const AudioBus & sourceBus, float * lastMixGain,
     // FIXME: framesToDezipper could be smaller when target gain is close enough within this process loop.
     int framesToDezipper = (gainDiff < epsilon) ? 0 : framesToProcess;
 
+    AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
+    const float * sources[MaxBusChannels];
+    float * destinations[MaxBusChannels];
+
+    for (int i = 0; i < numberOfChannels; ++i)
+    {
+        // a constant channel scaled by a settled gain stays constant
+        const AudioChannel * source = sourceBusSafe.channel(i);
+        if (!framesToDezipper && source->isConstant() && this != &sourceBus)
+        {
+            channel(i)->setConstant(source->constantValue() * totalDesiredGain);
+            sources[i] = nullptr;
+            destinations[i] = nullptr;
+            continue;
+        }
+
+        sources[i] = source->data();
+        destinations[i] = channel(i)->mutableData();
+    }
+
     if (framesToDezipper)
     {
         if (!m_dezipperGainValues.get() || m_dezipperGainValues->size() < framesToDezipper)
@@ -651,7 +553,8 @@ void AudioBus::copyWithGainFrom(const AudioBus & sourceBus, float * lastMixGain,
     {
         for (int channelIndex = 0; channelIndex < numberOfChannels; ++channelIndex)
         {
-            vsmul(sources[channelIndex], 1, &gain, destinations[channelIndex], 1, framesToProcess - framesToDezipper);
+            if (destinations[channelIndex])
+                vsmul(sources[channelIndex], 1, &gain, destinations[channelIndex], 1, framesToProcess - framesToDezipper);
         }
     }
 
@@ -693,6 +596,138 @@ void AudioBus::copyWithSampleAccurateGainValuesFrom(const AudioBus & sourceBus,
     }
 }
 
+namespace
+{
+    // Channels are converted in segments of about this many output frames, each a job of
+    // its own, so that a long multichannel asset is converted on every worker at once. A
+    // conversion with less than this to do altogether is made on the calling thread.
+    const int SampleRateSegmentFrames = 1 << 17;
+
+    // How a channel is divided. The segments' boundaries fall on output frames that
+    // coincide exactly with input frames, which is possible when both rates are whole
+    // numbers: every outputStep output frames span exactly inputStep input frames. Each
+    // segment's conversion begins and ends margin input frames beyond it, so that the sinc
+    // filter at the segment's edges sees the samples it would converting the channel whole,
+    // and the frames converted from the margins are discarded. Rates that aren't whole
+    // numbers are converted a channel at a time.
+    struct SampleRateSegments
+    {
+        int outputFrames = 0;  // per segment
+        int64_t inputStep = 0;
+        int64_t outputStep = 0;
+        int64_t margin = 0;
+
+        SampleRateSegments(double sourceRate, double destinationRate, int destinationLength)
+            : outputFrames(std::max(1, destinationLength))
+        {
+            if (sourceRate != std::floor(sourceRate) || destinationRate != std::floor(destinationRate) ||
+                destinationLength <= 2 * SampleRateSegmentFrames)
+                return;
+
+            int64_t a = static_cast<int64_t>(sourceRate);
+            int64_t b = static_cast<int64_t>(destinationRate);
+            while (b)
+            {
+                const int64_t t = a % b;
+                a = b;
+                b = t;
+            }
+            inputStep = static_cast<int64_t>(sourceRate) / a;
+            outputStep = static_cast<int64_t>(destinationRate) / a;
+            if (outputStep > SampleRateSegmentFrames)
+                return;
+
+            // SRC_SINC_FASTEST's filter reaches a few dozen input frames either side at unity,
+            // and widens with the downsampling ratio; the margin is generous beyond that
+            const int64_t reach = 256 * static_cast<int64_t>(std::ceil(std::max(1., sourceRate / destinationRate)));
+            margin = (reach + inputStep - 1) / inputStep * inputStep;
+            outputFrames = static_cast<int>((SampleRateSegmentFrames + outputStep - 1) / outputStep * outputStep);
+        }
+
+        bool segmented() const { return outputStep > 0; }
+    };
+
+    struct SampleRateConversion
+    {
+        const float * source = nullptr;
+        int sourceLength = 0;
+        float * destination = nullptr;  // the whole channel
+        int first = 0;                  // the output frames of the segment
+        int count = 0;
+    };
+
+    bool convertSegment(const SampleRateConversion & c, const SampleRateSegments & segments, double ratio, int destinationLength)
+    {
+        SRC_DATA convert;
+        convert.input_frames_used = 0;
+        convert.output_frames_gen = 0;
+        convert.end_of_input = 0;
+        convert.src_ratio = ratio;
+
+        if (!segments.segmented())
+        {
+            convert.data_in = c.source;
+            convert.data_out = c.destination;
+            convert.input_frames = c.sourceLength;
+            convert.output_frames = destinationLength;
+            return src_simple(&convert, SRC_SINC_FASTEST, 1) == 0;
+        }
+
+        const int64_t inputFirst = c.first / segments.outputStep * segments.inputStep;
+        const int64_t inputSpan = (c.count + segments.outputStep - 1) / segments.outputStep * segments.inputStep;
+        const int64_t start = std::max<int64_t>(0, inputFirst - segments.margin);
+        const int64_t end = std::min<int64_t>(c.sourceLength, inputFirst + inputSpan + segments.margin);
+        if (end <= start)
+            return true;
+
+        // the output frames converted from the leading margin, which are discarded
+        const int64_t skip = (inputFirst - start) / segments.inputStep * segments.outputStep;
+        std::vector<float> output(static_cast<size_t>(skip + c.count + segments.margin / segments.inputStep * segments.outputStep + 1));
+
+        convert.data_in = c.source + start;
+        convert.data_out = output.data();
+        convert.input_frames = static_cast<long>(end - start);
+        convert.output_frames = static_cast<long>(output.size());
+        if (src_simple(&convert, SRC_SINC_FASTEST, 1) != 0)
+            return false;
+
+        const int64_t available = std::min<int64_t>(c.count, convert.output_frames_gen - skip);
+        if (available > 0)
+            std::copy(output.begin() + skip, output.begin() + skip + available, c.destination + c.first);
+        return true;
+    }
+
+    bool convertSegments(const std::vector<SampleRateConversion> & conversions, const SampleRateSegments & segments,
+                         double ratio, int destinationLength)
+    {
+        int64_t work = 0;
+        for (const SampleRateConversion & c : conversions)
+            work += c.count;
+
+        if (conversions.size() < 2 || work < SampleRateSegmentFrames)
+        {
+            for (const SampleRateConversion & c : conversions)
+                if (!convertSegment(c, segments, ratio, destinationLength))
+                    return false;
+            return true;
+        }
+
+        // the caller may itself be a job, such as an asynchronous decode, so it helps with
+        // the segments while it waits rather than holding a worker idle
+        JobSystem & jobs = JobSystem::shared();
+        std::atomic<size_t> remaining {conversions.size()};
+        std::atomic<bool> failed {false};
+        for (const SampleRateConversion & c : conversions)
+            jobs.submit([&, c]() {
+                if (!convertSegment(c, segments, ratio, destinationLength))
+                    failed.store(true);
+                remaining.fetch_sub(1);
+            }, JobPriority::Normal);
+        jobs.wait([&remaining]() { return remaining.load() == 0; }, JobPriority::Normal);
+        return !failed.load();
+    }
+}
+
 std::unique_ptr<AudioBus> AudioBus::createBySampleRateConverting(const AudioBus * sourceBus, bool mixToMono, float newSampleRate)
 {
     // sourceBus's sample-rate must be known.
@@ -752,25 +787,26 @@ std::unique_ptr<AudioBus> AudioBus::createBySampleRateConverting(const AudioBus
     int numberOfDestinationChannels = resamplerSourceBus->numberOfChannels();
     std::unique_ptr<AudioBus> destinationBus(new AudioBus(numberOfDestinationChannels, destinationLength));
 
-    // Sample-rate convert each channel.
+    // Sample-rate convert each channel, in segments, on the job system if there's enough to do
+    std::vector<SampleRateConversion> conversions;
+    const SampleRateSegments segments(sourceSampleRate, destinationSampleRate, destinationLength);
     for (int i = 0; i < numberOfDestinationChannels; ++i)
-    {
-        SRC_DATA convert;
-        convert.data_in = resamplerSourceBus->channel(i)->data();
-        convert.data_out = destinationBus->channel(i)->mutableData();
-        convert.input_frames = sourceLength;
-        convert.output_frames = destinationLength;
-        convert.input_frames_used = 0;
-        convert.output_frames_gen = 0;
-        convert.end_of_input = 0;
-        convert.src_ratio = 1. / sampleRateRatio;
-        int result = src_simple(&convert, SRC_SINC_FASTEST, 1);
-        if (result != 0)
+        for (int first = 0; first < destinationLength; first += segments.outputFrames)
         {
-            std::unique_ptr<AudioBus> silentBus(new AudioBus(numberOfSourceChannels, static_cast<int>(sourceBus->length() / sampleRateRatio)));
-            silentBus->setSampleRate(newSampleRate);
-            return silentBus;
+            SampleRateConversion c;
+            c.source = resamplerSourceBus->channel(i)->data();
+            c.sourceLength = sourceLength;
+            c.destination = destinationBus->channel(i)->mutableData();
+            c.first = first;
+            c.count = std::min(segments.outputFrames, destinationLength - first);
+            conversions.push_back(c);
         }
+
+    if (!convertSegments(conversions, segments, 1. / sampleRateRatio, destinationLength))
+    {
+        std::unique_ptr<AudioBus> silentBus(new AudioBus(numberOfSourceChannels, static_cast<int>(sourceBus->length() / sampleRateRatio)));
+        silentBus->setSampleRate(newSampleRate);
+        return silentBus;
     }
 
     destinationBus->clearSilentFlag();
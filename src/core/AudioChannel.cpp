@@ -20,6 +20,11 @@ void AudioChannel::resizeSmaller(int newLength)
 void AudioChannel::scale(float scale)
 {
     if (isSilent()) return;
+    if (m_constant)
+    {
+        setConstant(m_constantValue * scale);
+        return;
+    }
     VectorMath::vsmul(data(), 1, &scale, mutableData(), 1, length());
 }
 
@@ -34,7 +39,67 @@ void AudioChannel::copyFrom(const AudioChannel * sourceChannel)
         zero();
         return;
     }
-    memcpy(mutableData(), sourceChannel->data(), sizeof(float) * length());
+    if (sourceChannel->m_constant)
+    {
+        setConstant(sourceChannel->m_constantValue);
+        return;
+    }
+
+    // every sample is overwritten, so an alias needn't be copied first
+    const float * source = sourceChannel->data();
+    m_alias = nullptr;
+    memcpy(mutableData(), source, sizeof(float) * length());
+}
+
+void AudioChannel::alias(const AudioChannel * sourceChannel)
+{
+    bool isSafe = (sourceChannel && sourceChannel != this && sourceChannel->length() >= length());
+    ASSERT(isSafe);
+    if (!isSafe) return;
+
+    if (sourceChannel->isSilent())
+    {
+        zero();
+        return;
+    }
+    if (sourceChannel->m_constant)
+    {
+        setConstant(sourceChannel->m_constantValue);
+        return;
+    }
+
+    m_alias = sourceChannel->data();
+    m_silent = false;
+}
+
+void AudioChannel::setConstant(float value)
+{
+    if (value == 0.f)
+    {
+        zero();
+        return;
+    }
+
+    m_alias = nullptr;
+    m_silent = false;
+    m_constant = true;
+    m_constantWritten = false;
+    m_constantValue = value;
+}
+
+void AudioChannel::writeConstant() const
+{
+    m_constantWritten = true;
+    float * samples = m_rawPointer ? m_rawPointer : m_memBuffer ? m_memBuffer->data() : nullptr;
+    if (samples)
+        std::fill(samples, samples + m_length, m_constantValue);
+}
+
+void AudioChannel::unalias()
+{
+    const float * source = m_alias;
+    m_alias = nullptr;
+    memcpy(const_cast<float *>(data()), source, sizeof(float) * m_length);
 }
 
 void AudioChannel::copyFromRange(const AudioChannel * sourceChannel, int startFrame, int endFrame)
@@ -79,6 +144,29 @@ void AudioChannel::sumFrom(const AudioChannel * sourceChannel)
     {
         copyFrom(sourceChannel);
     }
+    else if (sourceChannel->m_constant)
+    {
+        const float value = sourceChannel->m_constantValue;
+        if (m_constant)
+        {
+            setConstant(m_constantValue + value);
+            return;
+        }
+
+        float * destination = mutableData();
+        for (int i = 0; i < m_length; ++i)
+            destination[i] += value;
+    }
+    else if (m_constant)
+    {
+        // every sample is overwritten, so the constant needn't be written first
+        const float value = m_constantValue;
+        m_constant = false;
+        const float * source = sourceChannel->data();
+        float * destination = mutableData();
+        for (int i = 0; i < m_length; ++i)
+            destination[i] = source[i] + value;
+    }
     else
     {
         VectorMath::vadd(data(), 1, sourceChannel->data(), 1, mutableData(), 1, length());
@@ -88,6 +176,7 @@ void AudioChannel::sumFrom(const AudioChannel * sourceChannel)
 float AudioChannel::maxAbsValue() const
 {
     if (isSilent()) return 0;
+    if (m_constant) return fabsf(m_constantValue);
     float max = 0;
     VectorMath::vmaxmgv(data(), 1, &max, length());
     return max;
@@ -8,10 +8,22 @@
 #include "LabSound/core/AudioListener.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/ModulationBus.h"
+#include "LabSound/core/SpatialScene.h"
 #include "LabSound/core/OscillatorNode.h"
+#include "LabSound/core/RenderTrace.h"
+#include "LabSound/core/StartupTiming.h"
+#include "internal/DeferredRelease.h"
+#include "internal/EventQueue.h"
+#include "internal/EventSignal.h"
 #include "internal/HRTFDatabase.h"
+#include "internal/PublishedList.h"
+#include "internal/RenderThreadPool.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 //// for debugging only
 #include "LabSound/extended/ADSRNode.h"
@@ -23,9 +35,14 @@
 #include "concurrentqueue/concurrentqueue.h"
 #include "libnyquist/Encoders.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <queue>
 #include <stdio.h>
+#include <unordered_map>
 
 namespace lab {
 
@@ -60,20 +77,264 @@ struct PendingParamConnection
     ~PendingParamConnection() = default;
 };
 
+struct AudioContext::GraphEdit::Pending
+{
+    std::vector<PendingNodeConnection> nodes;
+    std::vector<PendingParamConnection> params;
+
+    size_t size() const { return nodes.size() + params.size(); }
+};
+
+// The compiled render schedule is a topologically sorted list of the nodes
+// reachable from the destination node and the automatic pull nodes. Running
+// it in order ensures that by the time a node pulls its inputs, every node
+// upstream of it has rendered the current quantum, so the pull resolves to a
+// cached bus instead of recursing through the graph.
+//
+// The same dependencies are also recorded as a task graph, so that when a
+// render thread pool is configured, nodes whose inputs are ready can render
+// concurrently. That is only possible if every dependency of a scheduled node
+// is itself in the schedule, and runs before it.
+//
+// A schedule run serially also shares a small pool of scratch buses between
+// the outputs it renders. An output's audio is only needed from when its node
+// renders until the last node reading it has, so outputs whose lifetimes don't
+// overlap render into the same bus, and a quantum touches the few buses live
+// at once rather than a bus per output.
+//
+// The nodes of each cycle in the graph are scheduled together, as a feedback
+// loop, so that with a feedback block size the loop can be rendered a block at
+// a time while the rest of the schedule renders a quantum at a time.
+
+// A cycle of the schedule, nodes[first, first + count), rendered in blocks
+struct FeedbackLoop
+{
+    int first = 0;
+    int count = 0;
+
+    // the outputs of nodes before the loop that its nodes read, and their quantum's
+    // audio, from which each block's frames are given to the loop
+    std::vector<AudioNodeOutput *> sources;
+    std::vector<AudioBus *> sourceBuses;
+    std::vector<std::unique_ptr<AudioBus>> sourceCopies;
+
+    // the loop's outputs, and the quantum its blocks are assembled into for the nodes after it
+    std::vector<AudioNodeOutput *> outputs;
+    std::vector<std::unique_ptr<AudioBus>> assembled;
+    std::vector<bool> silent;
+};
+
+struct RenderSchedule
+{
+    std::vector<AudioNode *> nodes;                    // dependencies first
+    std::vector<std::shared_ptr<AudioNode>> retained;  // keeps the raw pointers above valid
+    RenderTaskGraph tasks;                             // indexes into nodes
+    bool parallelizable = false;
+
+    // the scratch bus for each output of nodes[i] starts at scratch[scratchOffsets[i]];
+    // null where an output keeps its own bus, and empty if the schedule doesn't share buses
+    std::vector<AudioBus *> scratch;
+    std::vector<int> scratchOffsets;
+
+    // the latency each of nodes reported, in frames, when the compensation was last found
+    std::vector<int> latencyFrames;
+    bool latencyDirty = true;
+    bool compensating = false;
+
+    std::vector<FeedbackLoop> loops;  // in schedule order
+};
+
+// An event about a node, as the audio thread enqueues it. The scheduler is shared with
+// the node's internals, which hold its handlers, so copying it in doesn't allocate.
+struct AudioEvent
+{
+    AudioEventKind kind = AudioEventKind::Ended;
+    std::shared_ptr<AudioNodeScheduler> scheduler;
+    int64_t enqueued = 0;  // steady clock nanoseconds
+};
+
+enum class AudioCommandKind : int
+{
+    ParamValue,
+    ParamRamp,
+    Start,
+    Stop,
+    Setting
+};
+
+// A command as sent to the audio thread. target is the AudioParam, the scheduler of the
+// node, or the AudioSetting the command applies to.
+struct AudioCommand
+{
+    AudioCommandKind kind = AudioCommandKind::ParamValue;
+    uint64_t frame = 0;
+    uint64_t sequence = 0;  // orders commands landing on the same frame as they were received
+    float value = 0;
+    std::shared_ptr<void> target;
+
+    // a parameter's events go onto its timeline at once, so that a ramp is known before it starts
+    uint64_t applyFrame() const
+    {
+        return kind == AudioCommandKind::ParamValue || kind == AudioCommandKind::ParamRamp ? 0 : frame;
+    }
+
+    // orders a heap soonest first
+    static bool later(const AudioCommand & a, const AudioCommand & b)
+    {
+        const uint64_t fa = a.applyFrame();
+        const uint64_t fb = b.applyFrame();
+        return fa != fb ? fa > fb : a.sequence > b.sequence;
+    }
+};
+
+// A context suspending itself for silence is requested to by the audio thread, and is
+// suspended, and resumed, by the update thread, as a device can't be stopped from its own
+// callback.
+enum AutoSuspendState : int
+{
+    AutoSuspendRunning = 0,
+    AutoSuspendRequested,
+    AutoSuspended
+};
+
+// output quieter than this, -100 dB, counts as silent, so that decaying tails don't hold it off
+static const float AutoSuspendThreshold = 1.e-5f;
+
+namespace
+{
+    int64_t steadyNanoseconds()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // the decimation of the node processing on this thread, set as each node processes
+    thread_local int t_renderDecimation = 1;
+}
+
 struct AudioContext::Internals
 {
+    // events pending dispatch; the audio thread drops events beyond this
+    static const size_t NodeEventCapacity = 4096;
+
+    // commands sent but not yet applied; senders find the queue full beyond this
+    static const size_t CommandCapacity = 4096;
+
+    // applied graph edits held for reuse; the audio thread releases those beyond this itself
+    static const size_t SpentEditCapacity = 64;
+
     Internals(bool a)
         : autoDispatchEvents(a)
+        , nodeEvents(NodeEventCapacity)
+        , commands(CommandCapacity)
+        , spentEdits(SpentEditCapacity)
     {
+        pendingDisconnects.reserve(64);
+        pendingCommands.reserve(CommandCapacity);
+        retriedCommands.reserve(CommandCapacity);
+
+        // started here, rather than by the audio thread's first release
+        DeferredRelease::shared();
     }
     ~Internals() = default;
 
     bool autoDispatchEvents;
     moodycamel::ConcurrentQueue<std::function<void()>> enqueuedEvents;
+    EventQueue<AudioEvent> nodeEvents;
+    std::atomic<uint64_t> droppedNodeEvents{0};
+    uint64_t reportedDroppedNodeEvents = 0;  // by dispatchEvents, which logs the increase
+    uint64_t reportedRenderLockMisses = 0;
+    EventSignal eventsEnqueued;  // wakes the update thread to dispatch events
+
+    // commands are received into a heap ordered by when they apply; both vectors are
+    // only touched on the audio thread, and reserved up front so they don't grow
+    EventQueue<AudioCommand> commands;
+    std::vector<AudioCommand> pendingCommands;
+    std::vector<AudioCommand> retriedCommands;  // parameter events whose timeline was busy
+    uint64_t commandSequence = 0;
+
+    // the automatic pull nodes and render captures, published for the audio thread, which
+    // takes up a changed list without locking at the start and end of each quantum
+    PublishedList<std::shared_ptr<AudioNode>> automaticPullNodes;
+    PublishedList<std::shared_ptr<AudioRenderCapture>> renderCaptures;
     moodycamel::ConcurrentQueue<PendingNodeConnection> pendingNodeConnections;
     moodycamel::ConcurrentQueue<PendingParamConnection> pendingParamConnections;
 
+    // committed graph edits, and those the audio thread has applied, which are handed back
+    // so that the thread editing the graph releases their connections, and reuses their storage
+    moodycamel::ConcurrentQueue<std::unique_ptr<GraphEdit::Pending>> pendingEdits;
+    moodycamel::ConcurrentQueue<std::unique_ptr<GraphEdit::Pending>> spentEdits;
+
     std::shared_ptr<HRTFDatabaseLoader> hrtfDatabaseLoader;
+    int hrtfResidentLimit = 0;
+
+    // nodes that have been connected through this context, so that the render
+    // schedule can retain the nodes it refers to by raw pointer
+    std::unordered_map<AudioNode *, std::weak_ptr<AudioNode>> graphNodes;
+
+    // disconnections waiting for their sources to ramp out; only touched on
+    // the audio thread, and reserved up front so it doesn't normally grow
+    std::vector<PendingNodeConnection> pendingDisconnects;
+    std::atomic<int> pendingDisconnectCount{0};
+
+    RenderSchedule renderSchedule;
+    bool renderScheduleDirty = true;
+    uint64_t renderScheduleConnections = 0;  // the connection generation the schedule was compiled for
+    std::vector<std::unique_ptr<AudioBus>> scratchBuses;  // shared by the schedule's outputs
+    int renderScheduleMark = 0;
+
+    // while a feedback loop renders a block, the block's first frame within the quantum,
+    // by which the context's time is advanced
+    std::atomic<int> feedbackBlockOffset {0};
+
+    // optional; when present, the render schedule is executed in parallel
+    std::unique_ptr<RenderThreadPool> renderThreadPool;
+    ThreadScheduling renderThreadScheduling;
+
+    // the render thread's heartbeat, which the watchdog checks against its deadline
+    std::atomic<int> renderPhase {0};
+    std::atomic<int64_t> quantumStart {0};    // steady clock nanoseconds
+    std::atomic<uint64_t> quantumFrame {0};
+    std::atomic<uint64_t> renderStalls {0};
+    bool firstQuantumRendered = false;        // read and written by the audio thread
+
+    // for metrics(); the playing sources are only counted once they have been asked for
+    std::atomic<int> scheduledNodes {0};
+    std::atomic<int> graphLatencyFrames {0};
+    std::atomic<int> playingSources {0};
+    std::atomic<bool> countPlayingSources {false};
+    std::atomic<uint64_t> eventsDispatched {0};
+    std::atomic<int64_t> eventLatencyTotal {0};  // nanoseconds
+    std::atomic<int64_t> eventLatencyPeak {0};
+
+    std::atomic<uint64_t> autoSuspendFrames {0};  // of silence before suspending; zero never suspends
+    std::atomic<int> autoSuspendState {AutoSuspendRunning};
+    std::atomic<bool> autoSuspendWake {false};
+    uint64_t silentFrames = 0;  // consecutive frames of silent output, counted by the audio thread
+
+    std::thread watchdog;
+    std::mutex watchdogLock;
+    std::condition_variable watchdogWake;
+    double watchdogDeadline = 0;                         // guarded by watchdogLock
+    std::function<void(const RenderStall &)> onStall;    // guarded by watchdogLock
+
+    void trackNode(const std::shared_ptr<AudioNode> & node)
+    {
+        if (node)
+            graphNodes[node.get()] = node;
+    }
+
+    // apply a queued edit; a disconnection is moved to pendingDisconnects to ramp out
+    void applyParamConnection(ContextGraphLock &, PendingParamConnection &);
+    void applyNodeConnection(ContextGraphLock &, PendingNodeConnection &);
+
+    // A connection applied on the audio thread may hold the last references to its nodes,
+    // which are handed to the reclaim thread rather than destroyed here
+    template <typename Connection>
+    static void releaseConnection(Connection & c)
+    {
+        DeferredRelease::shared().release(std::move(c.destination));
+        DeferredRelease::shared().release(std::move(c.source));
+    }
 
     
     std::vector<float> debugBuffer;
@@ -133,14 +394,10 @@ AudioContext::AudioContext(bool isOffline)
     static std::atomic<int> id {1};
     m_internal.reset(new AudioContext::Internals(true));
     m_listener.reset(new AudioListener());
+    m_modulation.reset(new ModulationBus());
+    m_spatialScene.reset(new SpatialScene());
     m_audioContextInterface = std::make_shared<AudioContextInterface>(this, id);
     ++id;
-
-    if (isOffline)
-    {
-        updateThreadShouldRun = 1;
-        graphKeepAlive = 0;
-    }
 }
 
 AudioContext::AudioContext(bool isOffline, bool autoDispatchEvents)
@@ -149,14 +406,10 @@ AudioContext::AudioContext(bool isOffline, bool autoDispatchEvents)
     static std::atomic<int> id {1};
     m_internal.reset(new AudioContext::Internals(autoDispatchEvents));
     m_listener.reset(new AudioListener());
+    m_modulation.reset(new ModulationBus());
+    m_spatialScene.reset(new SpatialScene());
     m_audioContextInterface = std::make_shared<AudioContextInterface>(this, id);
     ++id;
-
-    if (isOffline)
-    {
-        updateThreadShouldRun = 1;
-        graphKeepAlive = 0;
-    }
 }
 
 bool AudioContext::isAutodispatchingEvents() const
@@ -169,11 +422,13 @@ AudioContext::~AudioContext()
 {
     LOG_TRACE("Begin AudioContext::~AudioContext()");
 
+    setRenderWatchdog(0);
+
     if (!isOfflineContext())
         graphKeepAlive = 0.25f;
 
     updateThreadShouldRun = 0;
-    cv.notify_all();
+    m_internal->eventsEnqueued.signal();
 
     if (graphUpdateThread.joinable())
         graphUpdateThread.join();
@@ -190,32 +445,47 @@ AudioContext::~AudioContext()
 
     ASSERT(!_contextIsInitialized);
     ASSERT(!m_automaticPullNodes.size());
-    ASSERT(!m_renderingAutomaticPullNodes.size());
 
     LOG_INFO("Finish AudioContext::~AudioContext()");
 }
 
 bool AudioContext::loadHrtfDatabase(const std::string & searchPath)
 {
-    //auto db = new HRTFDatabaseLoader(sampleRate(), searchPath);
-    //m_internal->hrtfDatabaseLoader.reset(db);
-    //db->loadAsynchronously();
-    //db->waitForLoaderThreadCompletion();
-    //return db->database()->numberOfElevations() > 0 && db->database()->numberOfAzimuths() > 0;
-    bool loaded = true;
-    auto db = HRTFDatabaseLoader::MakeHRTFLoaderSingleton(sampleRate(), searchPath);
-    // auto db = new HRTFDatabaseLoader(sampleRate(), searchPath);
-    if (!db->database() || !db->database()->files_found_and_loaded())
-    {
-        m_internal->hrtfDatabaseLoader.reset(db);
-        db->loadAsynchronously();
-        db->waitForLoaderThreadCompletion();
-        printf("db files found and loaded %d", db->database()->files_found_and_loaded() ? 1 : 0);
-        printf("num elevs %d num az %d\n", db->database()->numberOfElevations(), db->database()->numberOfAzimuths());
-        loaded = db->database()->files_found_and_loaded();
-        loaded = loaded && db->database()->numberOfElevations() > 0 && db->database()->numberOfAzimuths() > 0;
-    }
-    return loaded;
+    // the loader is shared with any other context using the same database
+    std::shared_ptr<HRTFDatabaseLoader> db = HRTFDatabaseLoader::MakeHRTFLoaderSingleton(sampleRate(), searchPath);
+    m_internal->hrtfDatabaseLoader = db;
+    if (m_internal->hrtfResidentLimit)
+        db->setResidentLimit(m_internal->hrtfResidentLimit);
+    db->loadAsynchronously();
+    db->waitForLoaderThreadCompletion();
+    return db->loadSucceeded();
+}
+
+void AudioContext::loadHrtfDatabaseAsync(const std::string & searchPath, std::function<void(bool)> completion)
+{
+    std::shared_ptr<HRTFDatabaseLoader> db = HRTFDatabaseLoader::MakeHRTFLoaderSingleton(sampleRate(), searchPath);
+    m_internal->hrtfDatabaseLoader = db;
+    if (m_internal->hrtfResidentLimit)
+        db->setResidentLimit(m_internal->hrtfResidentLimit);
+    db->loadAsynchronously(std::move(completion));
+}
+
+void AudioContext::setHrtfResidentLimit(int elevations)
+{
+    m_internal->hrtfResidentLimit = elevations;
+    if (m_internal->hrtfDatabaseLoader)
+        m_internal->hrtfDatabaseLoader->setResidentLimit(elevations);
+}
+
+bool AudioContext::compileHrtfDatabase(const std::string & searchPath, float sampleRate, const std::string & path)
+{
+    HRTFDatabase database(sampleRate, searchPath);
+    return database.writeCompiled(path);
+}
+
+std::string AudioContext::compiledHrtfDatabaseName(float sampleRate)
+{
+    return HRTFDatabase::compiledName(sampleRate);
 }
 
 std::shared_ptr<HRTFDatabaseLoader> AudioContext::hrtfDatabaseLoader() const {
@@ -237,18 +507,21 @@ void AudioContext::lazyInitialize()
         if (!isOfflineContext())
         {
             // start the device
-            d->device()->start();
+            {
+                StartupPhaseScope phase("device start");
+                d->device()->start();
+            }
 
             // start the audio thread and all audio rendering.
             // The destination node's provideInput() method will now be called repeatedly to render audio.
             // Each time provideInput() is called, a portion of the audio stream is rendered.
 
-            graphKeepAlive = 0.25f;  // pump the graph for the first 0.25 seconds
-            graphUpdateThread = std::thread(&AudioContext::update, this);
+            // a host driven device's host dispatches the events itself
+            if (!d->device()->isHostDriven())
+                graphUpdateThread = std::thread(&AudioContext::update, this);
         }
 
         _contextIsInitialized = 1;
-        cv.notify_all();
     }
     else
     {
@@ -264,10 +537,6 @@ void AudioContext::uninitialize()
     if (!_contextIsInitialized)
         return;
 
-    // for the case where an Offline AudioDestinationNode needs to update the graph
-    // before shutting done
-    updateAutomaticPullNodes();
-
     // This stops the audio thread and all audio rendering.
     if (_destinationNode && _destinationNode->device())
         _destinationNode->device()->stop();
@@ -275,7 +544,9 @@ void AudioContext::uninitialize()
     // Don't allow the context to initialize a second time after it's already been explicitly uninitialized.
     m_isAudioThreadFinished = true;
 
+    // the audio thread reads the published lists, so they are only taken up here once it has stopped
     updateAutomaticPullNodes();  // added for the case where an NullDeviceNode needs to update the graph
+    updateRenderCaptures();
 
     _contextIsInitialized = 0;
 }
@@ -293,123 +564,322 @@ void AudioContext::handlePreRenderTasks(ContextRenderLock & r)
 
     // At the beginning of every render quantum, update the graph.
 
-    m_audioContextInterface->_currentTime = currentTime();
+    m_audioContextInterface->_currentTime.store(currentTime(), std::memory_order_relaxed);
+
+    if (!m_internal->firstQuantumRendered)
+    {
+        m_internal->firstQuantumRendered = true;
+        if (!isOfflineContext())
+            StartupTiming::mark("first quantum");
+    }
+
+    const int sampling = m_profileSampling.load(std::memory_order_relaxed);
+    m_profilingThisQuantum = LABSOUND_PROFILING && sampling > 0 && m_profileQuantum++ % sampling == 0;
 
     // check for pending connections
     if (m_internal->pendingParamConnections.size_approx() > 0 ||
-        m_internal->pendingNodeConnections.size_approx() > 0)
+        m_internal->pendingNodeConnections.size_approx() > 0 ||
+        m_internal->pendingEdits.size_approx() > 0 ||
+        !m_internal->pendingDisconnects.empty())
+    {
+        // The audio thread never waits for the graph lock. If it is held
+        // elsewhere, the edits stay queued and are applied next quantum.
+        TraceScope trace("graph edits", "lock");
+        ContextGraphLock gLock(this, "AudioContext::handlePreRenderTasks()", std::try_to_lock);
+        if (gLock.context())
+            applyPendingConnections(gLock);
+    }
+
+    applyCommands(r);
+
+    AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
+    updateAutomaticPullNodes();
+    updateRenderCaptures();
+
+    // connections made directly under the graph lock, rather than queued, are found here;
+    // the scratch buses shared by the schedule are only safe for the connections it knows of
+    const uint64_t connections = AudioSummingJunction::connectionGeneration();
+    if (connections != m_internal->renderScheduleConnections)
+    {
+        m_internal->renderScheduleConnections = connections;
+        m_internal->renderScheduleDirty = true;
+    }
+
+    if (m_internal->renderScheduleDirty)
+        compileRenderSchedule(r);
+
+    compensateLatency(r);
+
+    // rendered before the graph, so that parameters on every render thread may read them
+    m_modulation->render(r, renderQuantumSize());
+
+    // and latched before it, so that every panner hears the same update
+    m_spatialScene->latch(r);
+}
+
+void AudioContext::Internals::applyParamConnection(ContextGraphLock & gLock, PendingParamConnection & param_connection)
+{
+    renderScheduleDirty = true;
+    if (param_connection.type == ConnectionOperationKind::Connect)
+    {
+        trackNode(param_connection.source);
+        AudioParam::connect(gLock,
+                            param_connection.destination,
+                            param_connection.source->output(param_connection.destIndex));
+
+        // if unscheduled, the source should start to play as soon as possible
+        if (!param_connection.source->isScheduledNode())
+            param_connection.source->_self->_scheduler.start(0);
+    }
+    else
+        AudioParam::disconnect(gLock,
+                               param_connection.destination,
+                               param_connection.source->output(param_connection.destIndex));
+
+    releaseConnection(param_connection);
+}
+
+void AudioContext::Internals::applyNodeConnection(ContextGraphLock & gLock, PendingNodeConnection & node_connection)
+{
+    switch (node_connection.type)
     {
-        // take a graph lock until the queues are cleared
-        ContextGraphLock gLock(this, "AudioContext::handlePreRenderTasks()");
+        case ConnectionOperationKind::Connect:
+        {
+            renderScheduleDirty = true;
+            trackNode(node_connection.destination);
+            trackNode(node_connection.source);
+            AudioNodeInput::connect(gLock,
+                                    node_connection.destination->input(node_connection.destIndex),
+                                    node_connection.source->output(node_connection.srcIndex));
+
+            if (!node_connection.source->isScheduledNode())
+                node_connection.source->_self->_scheduler.start(0);
+            releaseConnection(node_connection);
+        }
+        break;
 
-        // resolve parameter connections
-        PendingParamConnection param_connection;
-        while (m_internal->pendingParamConnections.try_dequeue(param_connection))
+        case ConnectionOperationKind::Disconnect:
         {
-            if (param_connection.type == ConnectionOperationKind::Connect)
+            if (node_connection.source)
             {
-                AudioParam::connect(gLock,
-                                    param_connection.destination,
-                                    param_connection.source->output(param_connection.destIndex));
-
-                // if unscheduled, the source should start to play as soon as possible
-                if (!param_connection.source->isScheduledNode())
-                    param_connection.source->_self->_scheduler.start(0);
+                // if source and destination are specified, then don't ramp out the destination
+                // source will be completely disconnected
+                node_connection.source->scheduleDisconnect();
             }
-            else
-                AudioParam::disconnect(gLock,
-                                       param_connection.destination,
-                                       param_connection.source->output(param_connection.destIndex));
+            else if (node_connection.destination)
+            {
+                // destination will be completely disconnected
+                node_connection.destination->scheduleDisconnect();
+            }
+            node_connection.type = ConnectionOperationKind::FinishDisconnect;
+            pendingDisconnects.push_back(std::move(node_connection));  // finished once the ramp out completes
+        }
+        break;
+
+        case ConnectionOperationKind::FinishDisconnect:
+            // only ever created above
+            ASSERT_NOT_REACHED();
+            break;
+    }
+}
+
+void AudioContext::applyPendingConnections(ContextGraphLock & gLock)
+{
+    // resolve parameter connections
+    PendingParamConnection param_connection;
+    while (m_internal->pendingParamConnections.try_dequeue(param_connection))
+        m_internal->applyParamConnection(gLock, param_connection);
+
+    // Disconnections in progress are kept in place, in storage that persists
+    // from quantum to quantum, rather than being requeued, so that waiting
+    // for the de-click ramp to finish neither allocates nor contends with
+    // the control thread for the queue. Those that were already waiting are
+    // advanced before new disconnections are added, so that a new one waits
+    // out its full duration.
+    std::vector<PendingNodeConnection> & disconnects = m_internal->pendingDisconnects;
+    size_t waiting = 0;
+    for (size_t i = 0; i < disconnects.size(); ++i)
+    {
+        PendingNodeConnection & node_connection = disconnects[i];
+        if (node_connection.duration > 0)
+        {
+            node_connection.duration -= m_renderQuantumSize / sampleRate();
+            if (waiting != i)
+                disconnects[waiting] = std::move(node_connection);
+            ++waiting;
+            continue;
         }
 
-        // resolve node connections
-        PendingNodeConnection node_connection;
-        std::vector<PendingNodeConnection> requeued_connections;
-        while (m_internal->pendingNodeConnections.try_dequeue(node_connection))
+        m_internal->renderScheduleDirty = true;
+
+        if (node_connection.source && node_connection.destination)
+        {
+            AudioNodeInput::disconnect(gLock, node_connection.destination->input(node_connection.destIndex), node_connection.source->output(node_connection.srcIndex));
+        }
+        else if (node_connection.destination)
         {
-            switch (node_connection.type)
+            for (int in = 0; in < node_connection.destination->numberOfInputs(); ++in)
             {
-                case ConnectionOperationKind::Connect:
-                {
-                    AudioNodeInput::connect(gLock,
-                                            node_connection.destination->input(node_connection.destIndex),
-                                            node_connection.source->output(node_connection.srcIndex));
+                auto input = node_connection.destination->input(in);
+                if (input)
+                    AudioNodeInput::disconnectAll(gLock, input);
+            }
+        }
+        else if (node_connection.source)
+        {
+            for (int out = 0; out < node_connection.source->numberOfOutputs(); ++out)
+            {
+                auto output = node_connection.source->output(out);
+                if (output)
+                    AudioNodeOutput::disconnectAll(gLock, output);
+            }
+        }
+        m_internal->releaseConnection(node_connection);
+    }
+    disconnects.erase(disconnects.begin() + waiting, disconnects.end());
 
-                    if (!node_connection.source->isScheduledNode())
-                        node_connection.source->_self->_scheduler.start(0);
-                }
-                break;
+    // resolve node connections
+    PendingNodeConnection node_connection;
+    while (m_internal->pendingNodeConnections.try_dequeue(node_connection))
+        m_internal->applyNodeConnection(gLock, node_connection);
 
-                case ConnectionOperationKind::Disconnect:
-                {
-                    node_connection.type = ConnectionOperationKind::FinishDisconnect;
-                    requeued_connections.push_back(node_connection);  // save for later
-                    if (node_connection.source)
-                    {
-                        // if source and destination are specified, then don't ramp out the destination
-                        // source will be completely disconnected
-                        node_connection.source->scheduleDisconnect();
-                    }
-                    else if (node_connection.destination)
-                    {
-                        // destination will be completely disconnected
-                        node_connection.destination->scheduleDisconnect();
-                    }
-                }
-                break;
+    // graph edits are applied whole; the audio thread only dequeues an edit once it has
+    // been committed in full
+    std::unique_ptr<GraphEdit::Pending> edit;
+    while (m_internal->pendingEdits.try_dequeue(edit))
+    {
+        for (PendingParamConnection & c : edit->params)
+            m_internal->applyParamConnection(gLock, c);
+        for (PendingNodeConnection & c : edit->nodes)
+            m_internal->applyNodeConnection(gLock, c);
 
-                case ConnectionOperationKind::FinishDisconnect:
-                {
-                    if (node_connection.duration > 0)
-                    {
-                        node_connection.duration -= AudioNode::ProcessingSizeInFrames / sampleRate();
-                        requeued_connections.push_back(node_connection);
-                        continue;
-                    }
+        // released here only if the queue is full, and then its nodes on the reclaim thread
+        if (!m_internal->spentEdits.try_enqueue(std::move(edit)))
+        {
+            for (PendingParamConnection & c : edit->params)
+                m_internal->releaseConnection(c);
+            for (PendingNodeConnection & c : edit->nodes)
+                m_internal->releaseConnection(c);
+        }
+        edit.reset();
+    }
 
-                    if (node_connection.source && node_connection.destination)
-                    {
-                        //if (!node_connection.destination->disconnectionReady() || !node_connection.source->disconnectionReady())
-                        //    requeued_connections.push_back(node_connection);
-                        //else
-                            AudioNodeInput::disconnect(gLock, node_connection.destination->input(node_connection.destIndex), node_connection.source->output(node_connection.srcIndex));
-                    }
-                    else if (node_connection.destination)
-                    {
-                        //if (!node_connection.destination->disconnectionReady())
-                        //    requeued_connections.push_back(node_connection);
-                        //else
-                            for (int in = 0; in < node_connection.destination->numberOfInputs(); ++in)
-                            {
-                                auto input= node_connection.destination->input(in);
-                                if (input)
-                                    AudioNodeInput::disconnectAll(gLock, input);
-                            }
-                    }
-                    else if (node_connection.source)
-                    {
-                        //if (!node_connection.destination->disconnectionReady())
-                        //    requeued_connections.push_back(node_connection);
-                        //else
-                            for (int out = 0; out < node_connection.source->numberOfOutputs(); ++out)
-                            {
-                                auto output = node_connection.source->output(out);
-                                if (output)
-                                    AudioNodeOutput::disconnectAll(gLock, output);
-                            }
-                    }
-                }
+    m_internal->pendingDisconnectCount = static_cast<int>(disconnects.size());
+}
+
+bool AudioContext::sendCommand(AudioCommandKind kind, std::shared_ptr<void> target, float value, double time)
+{
+    if (!target || !std::isfinite(time))
+        return false;
+
+    AudioCommand command;
+    command.kind = kind;
+    command.frame = static_cast<uint64_t>(std::llround(std::max(0.0, time) * sampleRate()));
+    command.value = value;
+    command.target = std::move(target);
+    if (!m_internal->commands.tryPush(std::move(command)))
+        return false;
+    wakeFromAutoSuspend();
+    return true;
+}
+
+bool AudioContext::sendParamValue(std::shared_ptr<AudioParam> param, float value, double time)
+{
+    return sendCommand(AudioCommandKind::ParamValue, std::move(param), value, time);
+}
+
+bool AudioContext::sendParamRamp(std::shared_ptr<AudioParam> param, float value, double time)
+{
+    return sendCommand(AudioCommandKind::ParamRamp, std::move(param), value, time);
+}
+
+bool AudioContext::sendStart(std::shared_ptr<AudioNode> node, double time)
+{
+    if (!node)
+        return false;
+    std::shared_ptr<AudioNodeScheduler> scheduler(node->_self, &node->_self->_scheduler);
+    return sendCommand(AudioCommandKind::Start, std::move(scheduler), 0, time);
+}
+
+bool AudioContext::sendStop(std::shared_ptr<AudioNode> node, double time)
+{
+    if (!node)
+        return false;
+    std::shared_ptr<AudioNodeScheduler> scheduler(node->_self, &node->_self->_scheduler);
+    return sendCommand(AudioCommandKind::Stop, std::move(scheduler), 0, time);
+}
+
+bool AudioContext::sendSetting(std::shared_ptr<AudioSetting> setting, float value, double time)
+{
+    return sendCommand(AudioCommandKind::Setting, std::move(setting), value, time);
+}
+
+static void applySetting(AudioSetting & setting, float value)
+{
+    switch (setting.type())
+    {
+        case SettingType::Bool: setting.setBool(value != 0.f); break;
+        case SettingType::Integer: setting.setUint32(static_cast<uint32_t>(std::max(0.f, value))); break;
+        case SettingType::Enum: setting.setEnumeration(static_cast<int>(value)); break;
+        case SettingType::Float: setting.setFloat(value); break;
+        default: break;
+    }
+}
+
+void AudioContext::applyCommands(ContextRenderLock & r)
+{
+    auto & pending = m_internal->pendingCommands;
+    auto & retried = m_internal->retriedCommands;
+
+    AudioCommand command;
+    while (pending.size() < pending.capacity() && m_internal->commands.tryPop(command))
+    {
+        command.sequence = m_internal->commandSequence++;
+        pending.push_back(std::move(command));
+        std::push_heap(pending.begin(), pending.end(), AudioCommand::later);
+    }
+
+    // apply every command landing before the end of this quantum
+    const uint64_t quantumEnd = currentSampleFrame() + m_renderQuantumSize;
+    const double sr = sampleRate();
+    while (!pending.empty() && pending.front().applyFrame() < quantumEnd)
+    {
+        std::pop_heap(pending.begin(), pending.end(), AudioCommand::later);
+        AudioCommand & c = pending.back();
+        const float time = static_cast<float>(c.frame / sr);
+
+        bool applied = true;
+        switch (c.kind)
+        {
+            case AudioCommandKind::ParamValue:
+                applied = static_cast<AudioParam *>(c.target.get())->trySetValueAtTime(c.value, time);
+                break;
+            case AudioCommandKind::ParamRamp:
+                applied = static_cast<AudioParam *>(c.target.get())->tryLinearRampToValueAtTime(c.value, time);
+                break;
+            case AudioCommandKind::Start:
+                static_cast<AudioNodeScheduler *>(c.target.get())->startAtFrame(c.frame);
+                break;
+            case AudioCommandKind::Stop:
+                static_cast<AudioNodeScheduler *>(c.target.get())->stopAtFrame(c.frame);
+                break;
+            case AudioCommandKind::Setting:
+                applySetting(*static_cast<AudioSetting *>(c.target.get()), c.value);
                 break;
-            }
         }
 
-        // We have incompletely connected nodes, so next time the thread ticks we can re-check them
-        for (auto & sc : requeued_connections)
-            m_internal->pendingNodeConnections.enqueue(sc);
+        if (!applied)
+            retried.push_back(std::move(c));
+        pending.pop_back();
     }
 
-    AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
-    updateAutomaticPullNodes();
+    // a parameter whose timeline another thread held is tried again next quantum
+    for (auto & c : retried)
+    {
+        pending.push_back(std::move(c));
+        std::push_heap(pending.begin(), pending.end(), AudioCommand::later);
+    }
+    retried.clear();
 }
 
 void AudioContext::handlePostRenderTasks(ContextRenderLock & r)
@@ -417,11 +887,23 @@ void AudioContext::handlePostRenderTasks(ContextRenderLock & r)
     ASSERT(r.context());
     AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
     updateAutomaticPullNodes();
+    updateRenderCaptures();
+
+    if (m_internal->countPlayingSources.load(std::memory_order_relaxed))
+    {
+        int playing = 0;
+        for (AudioNode * node : m_internal->renderSchedule.nodes)
+        {
+            const SchedulingState state = node->schedulingState();
+            if (node->isScheduledNode() && state >= SchedulingState::FADE_IN && state <= SchedulingState::STOPPING)
+                ++playing;
+        }
+        m_internal->playingSources.store(playing, std::memory_order_relaxed);
+    }
 }
 
 void AudioContext::synchronizeConnections(int timeOut_ms)
 {
-    cv.notify_all();
     if (!_destinationNode || !_destinationNode->device())
         return;
 
@@ -429,7 +911,8 @@ void AudioContext::synchronizeConnections(int timeOut_ms)
     if (!_destinationNode->device()->isRunning())
         return;
 
-    while (m_internal->pendingNodeConnections.size_approx() > 0 && timeOut_ms > 0)
+    while ((m_internal->pendingNodeConnections.size_approx() > 0 || m_internal->pendingEdits.size_approx() > 0 ||
+            m_internal->pendingDisconnectCount > 0) && timeOut_ms > 0)
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
         timeOut_ms -= 5;
@@ -448,44 +931,89 @@ void AudioContext::connect(std::shared_ptr<AudioNode> destination, std::shared_p
     if (destIdx > destination->numberOfInputs())
         throw std::out_of_range("Input index greater than available inputs");
     m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Connect, destination, source, destIdx, srcIdx});
+    wakeFromAutoSuspend();
 }
 
-void AudioContext::disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
+void AudioContext::connect(const std::vector<NodeConnection> & nodes, const std::vector<ParamConnection> & params)
+{
+    GraphEdit edit = beginGraphEdit();
+    for (const NodeConnection & c : nodes)
+        edit.connect(c.destination, c.source, c.destIdx, c.srcIdx);
+    for (const ParamConnection & c : params)
+        edit.connectParam(c.param, c.driver, c.index);
+    edit.commit();
+}
+
+AudioContext::GraphEdit AudioContext::beginGraphEdit()
+{
+    // the storage of an edit the audio thread has applied is reused, once its connections are released
+    std::unique_ptr<GraphEdit::Pending> pending;
+    if (m_internal->spentEdits.try_dequeue(pending))
+    {
+        pending->nodes.clear();
+        pending->params.clear();
+    }
+    else
+        pending.reset(new GraphEdit::Pending());
+    return GraphEdit(this, std::move(pending));
+}
+
+AudioContext::GraphEdit::GraphEdit(AudioContext * context, std::unique_ptr<Pending> pending)
+    : _context(context)
+    , _pending(std::move(pending))
+{
+}
+
+AudioContext::GraphEdit::GraphEdit(GraphEdit &&) noexcept = default;
+AudioContext::GraphEdit & AudioContext::GraphEdit::operator=(GraphEdit &&) noexcept = default;
+AudioContext::GraphEdit::~GraphEdit() = default;
+
+AudioContext::GraphEdit & AudioContext::GraphEdit::connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
+{
+    if (!destination)
+        throw std::runtime_error("Cannot connect to null destination");
+    if (!source)
+        throw std::runtime_error("Cannot connect from null source");
+    if (srcIdx > source->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs");
+    if (destIdx > destination->numberOfInputs())
+        throw std::out_of_range("Input index greater than available inputs");
+    _pending->nodes.push_back({ConnectionOperationKind::Connect, destination, source, destIdx, srcIdx});
+    return *this;
+}
+
+AudioContext::GraphEdit & AudioContext::GraphEdit::disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
 {
     if (!destination && !source)
-        return;
+        return *this;
     if (source && srcIdx > source->numberOfOutputs())
         throw std::out_of_range("Output index greater than available outputs");
     if (destination && destIdx > destination->numberOfInputs())
         throw std::out_of_range("Input index greater than available inputs");
-    m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Disconnect, destination, source, destIdx, srcIdx});
+    _pending->nodes.push_back({ConnectionOperationKind::Disconnect, destination, source, destIdx, srcIdx});
+    return *this;
 }
 
-void AudioContext::disconnect(std::shared_ptr<AudioNode> node, int index)
+AudioContext::GraphEdit & AudioContext::GraphEdit::disconnect(std::shared_ptr<AudioNode> node, int index)
 {
-    if (!node)
-        return;
-    m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Disconnect, node, std::shared_ptr<AudioNode>(), index, 0});
+    if (node)
+        _pending->nodes.push_back({ConnectionOperationKind::Disconnect, node, std::shared_ptr<AudioNode>(), index, 0});
+    return *this;
 }
 
-bool AudioContext::isConnected(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source)
+AudioContext::GraphEdit & AudioContext::GraphEdit::connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
 {
-    if (!destination || !source)
-        return false;
-
-    AudioNode* n = source.get();
-    for (int i = 0; i < destination->numberOfInputs(); ++i)
-    {
-        auto c = destination->input(i);
-        if (c->destinationNode() == n)
-            return true;
-    }
-
-    return false;
+    if (!param)
+        throw std::invalid_argument("No parameter specified");
+    if (!driver)
+        throw std::invalid_argument("No driving node supplied");
+    if (index >= driver->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs on the driver");
+    _pending->params.push_back({ConnectionOperationKind::Connect, param, driver, index});
+    return *this;
 }
 
-
-void AudioContext::connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
+AudioContext::GraphEdit & AudioContext::GraphEdit::disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
 {
     if (!param)
         throw std::invalid_argument("No parameter specified");
@@ -493,7 +1021,75 @@ void AudioContext::connectParam(std::shared_ptr<AudioParam> param, std::shared_p
         throw std::invalid_argument("No driving node supplied");
     if (index >= driver->numberOfOutputs())
         throw std::out_of_range("Output index greater than available outputs on the driver");
-    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
+    _pending->params.push_back({ConnectionOperationKind::Disconnect, param, driver, index});
+    return *this;
+}
+
+size_t AudioContext::GraphEdit::size() const
+{
+    return _pending ? _pending->size() : 0;
+}
+
+void AudioContext::GraphEdit::commit()
+{
+    if (!_context || !_pending || !_pending->size())
+        return;
+
+    const bool connects =
+        std::any_of(_pending->nodes.begin(), _pending->nodes.end(), [](const PendingNodeConnection & c) { return c.type == ConnectionOperationKind::Connect; }) ||
+        std::any_of(_pending->params.begin(), _pending->params.end(), [](const PendingParamConnection & c) { return c.type == ConnectionOperationKind::Connect; });
+
+    _context->m_internal->pendingEdits.enqueue(std::move(_pending));
+    _pending = std::move(_context->beginGraphEdit()._pending);
+    if (connects)
+        _context->wakeFromAutoSuspend();
+}
+
+void AudioContext::disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
+{
+    if (!destination && !source)
+        return;
+    if (source && srcIdx > source->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs");
+    if (destination && destIdx > destination->numberOfInputs())
+        throw std::out_of_range("Input index greater than available inputs");
+    m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Disconnect, destination, source, destIdx, srcIdx});
+}
+
+void AudioContext::disconnect(std::shared_ptr<AudioNode> node, int index)
+{
+    if (!node)
+        return;
+    m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Disconnect, node, std::shared_ptr<AudioNode>(), index, 0});
+}
+
+bool AudioContext::isConnected(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source)
+{
+    if (!destination || !source)
+        return false;
+
+    AudioNode* n = source.get();
+    for (int i = 0; i < destination->numberOfInputs(); ++i)
+    {
+        auto c = destination->input(i);
+        if (c->destinationNode() == n)
+            return true;
+    }
+
+    return false;
+}
+
+
+void AudioContext::connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
+{
+    if (!param)
+        throw std::invalid_argument("No parameter specified");
+    if (!driver)
+        throw std::invalid_argument("No driving node supplied");
+    if (index >= driver->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs on the driver");
+    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
+    wakeFromAutoSuspend();
 }
 
 
@@ -504,151 +1100,1075 @@ void AudioContext::connectParam(std::shared_ptr<AudioNode> destinationNode, char
     if (!parameterName)
         throw std::invalid_argument("No parameter specified");
 
-    std::shared_ptr<AudioParam> param = destinationNode->param(parameterName);
+    connectParam(destinationNode, findName(parameterName), driver, index);
+}
+
+void AudioContext::connectParam(std::shared_ptr<AudioNode> destinationNode, NameId parameter,
+                                std::shared_ptr<AudioNode> driver, int index)
+{
+    std::shared_ptr<AudioParam> param = destinationNode->param(parameter);
     if (!param)
         throw std::invalid_argument("Parameter not found on node");
 
     if (!driver)
         throw std::invalid_argument("No driving node supplied");
 
-    if (index >= driver->numberOfOutputs())
-        throw std::out_of_range("Output index greater than available outputs on the driver");
+    if (index >= driver->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs on the driver");
+
+    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
+    wakeFromAutoSuspend();
+}
+
+
+void AudioContext::disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
+{
+    if (!param)
+        throw std::invalid_argument("No parameter specified");
+
+    if (index >= driver->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs on the driver");
+
+    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Disconnect, param, driver, index});
+}
+
+void AudioContext::update()
+{
+    // an offline context is updated by its destination node between render quanta
+    if (m_isOfflineContext)
+    {
+        if (m_internal->autoDispatchEvents)
+            dispatchEvents();
+        return;
+    }
+
+    LOG_TRACE("Begin UpdateGraphThread");
+
+    // The thread sleeps until an event is enqueued, rather than polling, so that events
+    // are delivered as soon as the audio thread signals them, and an idle context
+    // doesn't wake at all.
+    while (updateThreadShouldRun != 0)
+    {
+        m_internal->eventsEnqueued.wait();
+        applyAutoSuspend();
+
+        if (m_internal->autoDispatchEvents)
+            dispatchEvents();
+    }
+
+    // graphKeepAlive keeps the thread alive momentarily once it has been signaled to
+    // stop, so that the events of nodes ending as the context closes are delivered.
+    // Audio time is checked every couple of render quanta, and the thread stops early if
+    // the graph is no longer rendering.
+    const float quantumMs = 1000.f * m_renderQuantumSize / sampleRate();
+    const int keepAliveTickMs = std::max(5, static_cast<int>(2.f * quantumMs) + 1);
+    lastGraphUpdateTime = static_cast<float>(currentTime());
+    while (graphKeepAlive > 0)
+    {
+        const bool signaled = m_internal->eventsEnqueued.waitFor(keepAliveTickMs);
+
+        if (m_internal->autoDispatchEvents)
+            dispatchEvents();
+
+        const double now = currentTime();
+        const float delta = static_cast<float>(now - lastGraphUpdateTime);
+        if (delta <= 0.f)
+        {
+            if (signaled)
+                continue;  // woken within a quantum
+            break;
+        }
+        lastGraphUpdateTime = static_cast<float>(now);
+        graphKeepAlive -= delta;
+    }
+
+    LOG_TRACE("End UpdateGraphThread");
+}
+
+void AudioContext::addAutomaticPullNode(std::shared_ptr<AudioNode> node)
+{
+    std::lock_guard<std::mutex> lock(m_updateMutex);
+    if (m_automaticPullNodes.find(node) == m_automaticPullNodes.end())
+    {
+        m_automaticPullNodes.insert(node);
+        m_internal->automaticPullNodes.publish({m_automaticPullNodes.begin(), m_automaticPullNodes.end()});
+        if (!node->isScheduledNode())
+        {
+            node->_self->_scheduler.start(0);
+        }
+    }
+}
+
+void AudioContext::removeAutomaticPullNode(std::shared_ptr<AudioNode> node)
+{
+    std::lock_guard<std::mutex> lock(m_updateMutex);
+    auto it = m_automaticPullNodes.find(node);
+    if (it != m_automaticPullNodes.end())
+    {
+        m_automaticPullNodes.erase(it);
+        m_internal->automaticPullNodes.publish({m_automaticPullNodes.begin(), m_automaticPullNodes.end()});
+    }
+}
+
+void AudioContext::updateAutomaticPullNodes()
+{
+    if (m_internal->automaticPullNodes.acquire())
+        m_internal->renderScheduleDirty = true;
+}
+
+void AudioContext::processAutomaticPullNodes(ContextRenderLock & r, int framesToProcess)
+{
+    for (auto & node : m_internal->automaticPullNodes.items())
+        node->processIfNecessary(r, framesToProcess);
+}
+
+void AudioContext::addRenderCapture(std::shared_ptr<AudioRenderCapture> capture)
+{
+    std::lock_guard<std::mutex> lock(m_updateMutex);
+    if (capture && m_renderCaptures.insert(capture).second)
+        m_internal->renderCaptures.publish({m_renderCaptures.begin(), m_renderCaptures.end()});
+}
+
+void AudioContext::removeRenderCapture(std::shared_ptr<AudioRenderCapture> capture)
+{
+    std::lock_guard<std::mutex> lock(m_updateMutex);
+    if (m_renderCaptures.erase(capture))
+        m_internal->renderCaptures.publish({m_renderCaptures.begin(), m_renderCaptures.end()});
+}
+
+void AudioContext::updateRenderCaptures()
+{
+    if (m_internal->renderCaptures.acquire())
+        m_internal->renderScheduleDirty = true;
+}
+
+void AudioContext::processRenderCaptures(ContextRenderLock & r, int framesToProcess)
+{
+    for (auto & capture : m_internal->renderCaptures.items())
+        capture->capture(r, framesToProcess);
+}
+
+void AudioContext::compileRenderSchedule(ContextRenderLock & r)
+{
+    RenderSchedule & schedule = m_internal->renderSchedule;
+    std::vector<std::shared_ptr<AudioNode>> previouslyRetained;
+    previouslyRetained.swap(schedule.retained);
+    schedule.nodes.clear();
+    m_internal->renderScheduleDirty = false;
+
+    for (auto it = m_internal->graphNodes.begin(); it != m_internal->graphNodes.end();)
+    {
+        if (it->second.expired())
+            it = m_internal->graphNodes.erase(it);
+        else
+            ++it;
+    }
+
+    // gray marks a node whose dependencies are being visited, black a node
+    // that has been scheduled. Meeting a gray node again means the graph has
+    // a cycle; the back edge is ignored, and the node that closes the cycle
+    // reads the previous quantum's output, as the recursive pull would.
+    const int gray = ++m_internal->renderScheduleMark;
+    const int black = ++m_internal->renderScheduleMark;
+
+    struct Visit
+    {
+        AudioNode * node;
+        bool expanded;
+    };
+    std::vector<Visit> stack;
+
+    auto visitJunction = [&](AudioSummingJunction * junction) {
+        int connectionCount = junction->numberOfConnections();
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            auto output = junction->connection(r, i);
+            if (!output)
+                continue;
+
+            AudioNode * source = output->sourceNode();
+            if (source && source->_self->scheduleMark != gray && source->_self->scheduleMark != black)
+                stack.push_back({source, false});
+        }
+    };
+
+    auto schedule_pending = [&]() {
+        while (!stack.empty())
+        {
+            Visit & top = stack.back();
+            AudioNode * node = top.node;
+            if (!top.expanded)
+            {
+                if (node->_self->scheduleMark == gray || node->_self->scheduleMark == black)
+                {
+                    stack.pop_back();
+                    continue;
+                }
+
+                top.expanded = true;
+                node->_self->scheduleMark = gray;
+
+                for (auto & p : node->_self->_params)
+                    visitJunction(p.get());
+                for (auto & in : node->_self->m_inputs)
+                    visitJunction(in.get());
+            }
+            else
+            {
+                stack.pop_back();
+                node->_self->scheduleMark = black;
+
+                // nodes that were not connected via this context can't be
+                // retained, and are left to the recursive pull
+                auto tracked = m_internal->graphNodes.find(node);
+                if (tracked == m_internal->graphNodes.end())
+                    continue;
+
+                if (auto retained = tracked->second.lock())
+                {
+                    schedule.nodes.push_back(node);
+                    schedule.retained.emplace_back(std::move(retained));
+                }
+            }
+        }
+    };
+
+    if (_destinationNode)
+    {
+        // the destination node itself is rendered by pull_graph
+        _destinationNode->_self->scheduleMark = black;
+        for (auto & in : _destinationNode->_self->m_inputs)
+            visitJunction(in.get());
+        schedule_pending();
+    }
+
+    for (auto & node : m_internal->automaticPullNodes.items())
+    {
+        if (!node)
+            continue;
+        m_internal->trackNode(node);
+        stack.push_back({node.get(), false});
+        schedule_pending();
+    }
+    m_internal->scheduledNodes.store(static_cast<int>(schedule.nodes.size()), std::memory_order_relaxed);
+
+    findFeedbackLoops(r);
+
+    // Record each node's scheduled dependencies as a task graph. A dependency
+    // that is not scheduled, or scheduled after the node that depends on it
+    // because it closes a cycle, would be rendered by a recursive pull from
+    // whichever thread reaches it first, so such a schedule is run serially.
+    RenderTaskGraph & tasks = schedule.tasks;
+    tasks.clear();
+    schedule.parallelizable = true;
+
+    const int nodeCount = static_cast<int>(schedule.nodes.size());
+    std::unordered_map<AudioNode *, int> index;
+    for (int i = 0; i < nodeCount; ++i)
+        index[schedule.nodes[i]] = i;
+
+    std::vector<std::vector<int>> successors(nodeCount);
+    tasks.dependencyCount.resize(nodeCount, 0);
+
+    auto addDependencies = [&](int task, AudioSummingJunction * junction) {
+        int connectionCount = junction->numberOfConnections();
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            auto output = junction->connection(r, i);
+            if (!output || !output->sourceNode())
+                continue;
+
+            auto dependency = index.find(output->sourceNode());
+            if (dependency == index.end() || dependency->second >= task)
+            {
+                schedule.parallelizable = false;
+                continue;
+            }
+
+            successors[dependency->second].push_back(task);
+            ++tasks.dependencyCount[task];
+        }
+    };
+
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        AudioNode * node = schedule.nodes[i];
+        for (auto & p : node->_self->_params)
+            addDependencies(i, p.get());
+        for (auto & in : node->_self->m_inputs)
+            addDependencies(i, in.get());
+    }
+
+    tasks.successorOffsets.reserve(nodeCount + 1);
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        tasks.successorOffsets.push_back(static_cast<int>(tasks.successors.size()));
+        tasks.successors.insert(tasks.successors.end(), successors[i].begin(), successors[i].end());
+    }
+    tasks.successorOffsets.push_back(static_cast<int>(tasks.successors.size()));
+
+    if (m_internal->renderThreadPool)
+        m_internal->renderThreadPool->reserve(nodeCount);
+
+    assignScratchBuses(r, index);
+    schedule.latencyDirty = true;
+
+    // nodes no longer in the graph may only have been kept alive by the last schedule
+    for (auto & node : previouslyRetained)
+        DeferredRelease::shared().release(std::move(node));
+}
+
+void AudioContext::findFeedbackLoops(ContextRenderLock & r)
+{
+    RenderSchedule & schedule = m_internal->renderSchedule;
+    schedule.loops.clear();
+
+    const int nodeCount = static_cast<int>(schedule.nodes.size());
+    std::unordered_map<AudioNode *, int> index;
+    for (int i = 0; i < nodeCount; ++i)
+        index[schedule.nodes[i]] = i;
+
+    // A node reading a node outside the schedule can't be in a loop, as the recursive pull
+    // would render that node for a block rather than the quantum.
+    std::vector<std::vector<int>> dependencies(nodeCount);
+    std::vector<std::vector<int>> dependents(nodeCount);
+    std::vector<bool> pullsUnscheduled(nodeCount, false);
+    std::vector<bool> feedsItself(nodeCount, false);
+    auto addEdges = [&](int node, AudioSummingJunction * junction) {
+        int connectionCount = junction->numberOfConnections();
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            auto output = junction->connection(r, i);
+            if (!output || !output->sourceNode())
+                continue;
+
+            auto dependency = index.find(output->sourceNode());
+            if (dependency == index.end())
+            {
+                pullsUnscheduled[node] = true;
+                continue;
+            }
+            if (dependency->second == node)
+                feedsItself[node] = true;
+            dependencies[node].push_back(dependency->second);
+            dependents[dependency->second].push_back(node);
+        }
+    };
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        AudioNode * node = schedule.nodes[i];
+        for (auto & p : node->_self->_params)
+            addEdges(i, p.get());
+        for (auto & in : node->_self->m_inputs)
+            addEdges(i, in.get());
+    }
+
+    // The schedule is the post order of a depth first search of the dependencies, so
+    // searching the dependents from each node not yet reached, in reverse schedule order,
+    // reaches a strongly connected component at a time, as in Kosaraju's algorithm.
+    std::vector<int> component(nodeCount, -1);
+    std::vector<int> size;
+    std::vector<int> pending;
+    for (int i = nodeCount - 1; i >= 0; --i)
+    {
+        if (component[i] >= 0)
+            continue;
+
+        const int c = static_cast<int>(size.size());
+        size.push_back(0);
+        component[i] = c;
+        pending.push_back(i);
+        while (!pending.empty())
+        {
+            const int n = pending.back();
+            pending.pop_back();
+            ++size[c];
+            for (int d : dependents[n])
+                if (component[d] < 0)
+                {
+                    component[d] = c;
+                    pending.push_back(d);
+                }
+        }
+    }
+
+    std::vector<bool> isLoop(size.size(), false);
+    for (int i = 0; i < nodeCount; ++i)
+        if (size[component[i]] > 1 || feedsItself[i])
+            isLoop[component[i]] = true;
+    for (int i = 0; i < nodeCount; ++i)
+        if (pullsUnscheduled[i])
+            isLoop[component[i]] = false;
+
+    // Each loop is moved to where its last node was scheduled, after everything it reads.
+    std::vector<int> last(size.size(), -1);
+    for (int i = 0; i < nodeCount; ++i)
+        last[component[i]] = i;
+
+    std::vector<int> order;
+    order.reserve(nodeCount);
+    std::vector<FeedbackLoop> loops;
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        const int c = component[i];
+        if (!isLoop[c])
+            order.push_back(i);
+        else if (last[c] == i)
+        {
+            FeedbackLoop loop;
+            loop.first = static_cast<int>(order.size());
+            for (int j = 0; j <= i; ++j)
+                if (component[j] == c)
+                    order.push_back(j);
+            loop.count = static_cast<int>(order.size()) - loop.first;
+            loops.emplace_back(std::move(loop));
+        }
+    }
+    if (loops.empty())
+        return;
+
+    // Only a loop's nodes may read nodes scheduled after them; otherwise the loops are
+    // left as the search scheduled them.
+    std::vector<int> position(nodeCount);
+    for (int i = 0; i < nodeCount; ++i)
+        position[order[i]] = i;
+    for (int i = 0; i < nodeCount; ++i)
+        for (int d : dependencies[i])
+            if (position[d] >= position[i] && component[d] != component[i])
+                return;
+
+    std::vector<AudioNode *> nodes(nodeCount);
+    for (int i = 0; i < nodeCount; ++i)
+        nodes[i] = schedule.nodes[order[i]];
+    schedule.nodes.swap(nodes);
+
+    for (FeedbackLoop & loop : loops)
+    {
+        const int c = component[order[loop.first]];
+        for (int i = loop.first; i < loop.first + loop.count; ++i)
+        {
+            AudioNode * node = schedule.nodes[i];
+            for (auto & out : node->_self->m_outputs)
+                loop.outputs.push_back(out.get());
+
+            auto addSources = [&](AudioSummingJunction * junction) {
+                int connectionCount = junction->numberOfConnections();
+                for (int j = 0; j < connectionCount; ++j)
+                {
+                    auto output = junction->connection(r, j);
+                    if (!output || !output->sourceNode() || component[index[output->sourceNode()]] == c)
+                        continue;
+                    if (std::find(loop.sources.begin(), loop.sources.end(), output.get()) == loop.sources.end())
+                        loop.sources.push_back(output.get());
+                }
+            };
+            for (auto & p : node->_self->_params)
+                addSources(p.get());
+            for (auto & in : node->_self->m_inputs)
+                addSources(in.get());
+        }
+        loop.sourceBuses.resize(loop.sources.size());
+        loop.sourceCopies.resize(loop.sources.size());
+        loop.assembled.resize(loop.outputs.size());
+        loop.silent.resize(loop.outputs.size());
+    }
+    schedule.loops.swap(loops);
+}
+
+void AudioContext::compensateLatency(ContextRenderLock & r)
+{
+    RenderSchedule & schedule = m_internal->renderSchedule;
+    const int nodeCount = static_cast<int>(schedule.nodes.size());
+    const bool enabled = m_latencyCompensation.load(std::memory_order_relaxed);
+    const double sampleRate = r.context()->sampleRate();
+
+    // Most quanta only find that no latency has changed
+    bool changed = schedule.latencyDirty || schedule.compensating != enabled;
+    schedule.latencyFrames.resize(nodeCount, 0);
+    if (enabled)
+    {
+        for (int i = 0; i < nodeCount; ++i)
+        {
+            const double latency = schedule.nodes[i]->latencyTime(r);
+            const int frames = latency > 0 ? static_cast<int>(std::lround(latency * sampleRate)) : 0;
+            if (frames != schedule.latencyFrames[i])
+            {
+                schedule.latencyFrames[i] = frames;
+                changed = true;
+            }
+        }
+    }
+    if (!changed)
+        return;
+
+    schedule.latencyDirty = false;
+    schedule.compensating = enabled;
+
+    // The frames by which each scheduled node's output lags the sources, found in schedule
+    // order, so that a node's sources are found before it. A source outside the schedule,
+    // or closing a cycle, is taken to be in step with the latest of the node's other sources.
+    std::unordered_map<AudioNode *, int> arrival;
+    std::vector<std::pair<AudioNodeOutput *, int>> delays;
+    auto compensate = [&](AudioNode * node) {
+        int latest = 0;
+        for (auto & in : node->_self->m_inputs)
+            for (int c = 0; c < in->numberOfConnections(); ++c)
+            {
+                auto output = in->connection(r, c);
+                auto source = output ? arrival.find(output->sourceNode()) : arrival.end();
+                if (source != arrival.end())
+                    latest = std::max(latest, source->second);
+            }
+
+        for (auto & in : node->_self->m_inputs)
+        {
+            delays.clear();
+            for (int c = 0; c < in->numberOfConnections() && enabled; ++c)
+            {
+                auto output = in->connection(r, c);
+                auto source = output ? arrival.find(output->sourceNode()) : arrival.end();
+                if (source != arrival.end() && source->second < latest)
+                    delays.emplace_back(output.get(), latest - source->second);
+            }
+            in->setLatencyCompensation(r, delays);
+        }
+        return latest;
+    };
+
+    for (int i = 0; i < nodeCount; ++i)
+        arrival[schedule.nodes[i]] = compensate(schedule.nodes[i]) + (enabled ? schedule.latencyFrames[i] : 0);
+
+    const int graphLatency = _destinationNode ? compensate(_destinationNode.get()) : 0;
+    m_internal->graphLatencyFrames.store(enabled ? graphLatency : 0, std::memory_order_relaxed);
+}
+
+void AudioContext::assignScratchBuses(ContextRenderLock & r, const std::unordered_map<AudioNode *, int> & index)
+{
+    RenderSchedule & schedule = m_internal->renderSchedule;
+    schedule.scratch.clear();
+    schedule.scratchOffsets.clear();
+
+    // nodes rendering concurrently can't share buses
+    const int nodeCount = static_cast<int>(schedule.nodes.size());
+    if (m_internal->renderThreadPool && schedule.parallelizable && nodeCount > 1)
+        return;
+
+    // The last node to read each output. An output read after the schedule has run, by the
+    // destination, a node outside the schedule, the node closing a cycle or a render
+    // capture, keeps its own bus. Reads are counted against the output's fan out, so that
+    // reads by nodes the schedule doesn't know of are found.
+    const int Unshared = std::numeric_limits<int>::max();
+    struct Reads
+    {
+        int last = -1;
+        int count = 0;
+    };
+    std::unordered_map<AudioNodeOutput *, Reads> reads;
+
+    for (AudioNode * node : schedule.nodes)
+        for (auto & out : node->_self->m_outputs)
+        {
+            out->updateRenderingState(r);
+            reads[out.get()];
+        }
+
+    auto addReads = [&](int reader, AudioSummingJunction * junction) {
+        int connectionCount = junction->numberOfConnections();
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            auto output = junction->connection(r, i);
+            auto it = output ? reads.find(output.get()) : reads.end();
+            if (it == reads.end())
+                continue;
+
+            auto source = index.find(output->sourceNode());
+            it->second.count++;
+            if (source == index.end() || source->second >= reader)
+                it->second.last = Unshared;
+            else
+                it->second.last = std::max(it->second.last, reader);
+        }
+    };
+
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        AudioNode * node = schedule.nodes[i];
+        for (auto & p : node->_self->_params)
+            addReads(i, p.get());
+        for (auto & in : node->_self->m_inputs)
+            addReads(i, in.get());
+    }
+
+    std::vector<AudioNodeOutput *> captured;
+    for (auto & capture : m_internal->renderCaptures.items())
+        capture->capturedOutputs(captured);
+    for (AudioNodeOutput * out : captured)
+    {
+        auto it = reads.find(out);
+        if (it != reads.end())
+            it->second.last = Unshared;
+    }
+
+    // a feedback loop reads its outputs from one block to the next
+    for (const FeedbackLoop & loop : schedule.loops)
+        for (AudioNodeOutput * out : loop.outputs)
+        {
+            auto it = reads.find(out);
+            if (it != reads.end())
+                it->second.last = Unshared;
+        }
+
+    // The audio a node reads may be read again later in the quantum, by the nodes reading
+    // it in turn, if the node defers a gain onto it, so an output lives until the readers of
+    // its readers have rendered.
+    std::vector<int> lifetime(nodeCount, -1);
+    for (int i = 0; i < nodeCount; ++i)
+        for (auto & out : schedule.nodes[i]->_self->m_outputs)
+        {
+            Reads & read = reads[out.get()];
+            if (read.count != out->renderingFanOutCount() + out->renderingParamFanOutCount())
+                read.last = Unshared;
+            lifetime[i] = std::max(lifetime[i], read.last);
+        }
+
+    std::unordered_map<AudioNodeOutput *, int> live;
+    auto extendLife = [&](int reader, AudioSummingJunction * junction) {
+        int connectionCount = junction->numberOfConnections();
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            auto output = junction->connection(r, i);
+            auto it = output ? reads.find(output.get()) : reads.end();
+            if (it == reads.end())
+                continue;
+
+            int & until = live.emplace(output.get(), it->second.last).first->second;
+            if (until != Unshared)
+                until = std::max(until, lifetime[reader]);
+        }
+    };
+
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        AudioNode * node = schedule.nodes[i];
+        for (auto & p : node->_self->_params)
+            extendLife(i, p.get());
+        for (auto & in : node->_self->m_inputs)
+            extendLife(i, in.get());
+    }
+
+    // Assign buses in schedule order, from free lists of buses of each shape. A bus freed
+    // by the node rendering now is reused only from the next node on, since the node reads
+    // it while writing its own outputs.
+    struct Shape
+    {
+        int channels;
+        int length;
+        std::vector<AudioBus *> free;
+    };
+    std::vector<Shape> shapes;
+    std::vector<std::vector<std::pair<int, AudioBus *>>> retiring(nodeCount);
+    size_t pooled = 0;
+
+    auto acquire = [&](int channels, int length) -> std::pair<int, AudioBus *> {
+        int s = 0;
+        while (s < static_cast<int>(shapes.size()) && (shapes[s].channels != channels || shapes[s].length != length))
+            ++s;
+        if (s == static_cast<int>(shapes.size()))
+            shapes.push_back({channels, length, {}});
+
+        if (!shapes[s].free.empty())
+        {
+            AudioBus * bus = shapes[s].free.back();
+            shapes[s].free.pop_back();
+            return {s, bus};
+        }
+
+        // buses left from an earlier schedule are reused when their shape fits
+        std::vector<std::unique_ptr<AudioBus>> & buses = m_internal->scratchBuses;
+        for (size_t i = pooled; i < buses.size(); ++i)
+        {
+            if (buses[i]->numberOfChannels() == channels && buses[i]->length() == length)
+            {
+                std::swap(buses[i], buses[pooled]);
+                return {s, buses[pooled++].get()};
+            }
+        }
 
-    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
-}
+        buses.emplace_back(new AudioBus(channels, length));
+        buses.back()->setSampleRate(sampleRate());
+        std::swap(buses.back(), buses[pooled]);
+        return {s, buses[pooled++].get()};
+    };
 
+    bool shared = false;
+    schedule.scratchOffsets.reserve(nodeCount + 1);
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        schedule.scratchOffsets.push_back(static_cast<int>(schedule.scratch.size()));
+        for (auto & out : schedule.nodes[i]->_self->m_outputs)
+        {
+            auto it = live.find(out.get());
+            int until = it != live.end() ? it->second : reads[out.get()].last;
+            if (until == Unshared || !out->numberOfChannels())
+            {
+                schedule.scratch.push_back(nullptr);
+                continue;
+            }
 
-void AudioContext::disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
-{
-    if (!param)
-        throw std::invalid_argument("No parameter specified");
+            auto bus = acquire(out->numberOfChannels(), out->processingSizeInFrames());
+            schedule.scratch.push_back(bus.second);
+            retiring[std::max(until, i)].push_back(bus);
+            shared = true;
+        }
 
-    if (index >= driver->numberOfOutputs())
-        throw std::out_of_range("Output index greater than available outputs on the driver");
+        for (auto & bus : retiring[i])
+            shapes[bus.first].free.push_back(bus.second);
+    }
+    schedule.scratchOffsets.push_back(static_cast<int>(schedule.scratch.size()));
 
-    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Disconnect, param, driver, index});
+    if (!shared)
+    {
+        schedule.scratch.clear();
+        schedule.scratchOffsets.clear();
+    }
 }
 
-void AudioContext::update()
+namespace
 {
-    if (!m_isOfflineContext) { LOG_TRACE("Begin UpdateGraphThread"); }
-
-    const float frameLengthInMilliseconds = (sampleRate() / (float) AudioNode::ProcessingSizeInFrames) / 1000.f;  // = ~0.345ms @ 44.1k/128
-    const float graphTickDurationMs = frameLengthInMilliseconds * 16;  // = ~5.5ms
-    const uint32_t graphTickDurationUs = static_cast<uint32_t>(graphTickDurationMs * 1000.f);  // = ~5550us
-
-    ASSERT(frameLengthInMilliseconds);
-    ASSERT(graphTickDurationMs);
-    ASSERT(graphTickDurationUs);
-
-    // graphKeepAlive keeps the thread alive momentarily (letting tail tasks
-    // finish) even updateThreadShouldRun has been signaled.
-    while (updateThreadShouldRun != 0 || graphKeepAlive > 0)
+    struct ScheduledRender
     {
-        if (updateThreadShouldRun > 0)
-            --updateThreadShouldRun;
+        ContextRenderLock * r;
+        AudioNode * const * nodes;
+        int framesToProcess;
+    };
 
-        // A `unique_lock` automatically acquires a lock on construction. The purpose of
-        // this mutex is to synchronize updates to the graph from the main thread,
-        // primarily through `connect(...)` and `disconnect(...)`.
-        std::unique_lock<std::mutex> lk;
+    void renderScheduledNode(ContextRenderLock & r, AudioNode * node, int framesToProcess, AudioBus * const * scratch = nullptr)
+    {
+        if (node->isProcessedForCurrentQuantum(r))
+            return;
 
-        if (!m_isOfflineContext)
+        for (int i = 0; i < node->numberOfOutputs(); ++i)
         {
-            lk = std::unique_lock<std::mutex>(m_updateMutex);
-            cv.wait_until(lk, std::chrono::steady_clock::now() + std::chrono::microseconds(5000)); // awake every five milliseconds
+            if (scratch)
+                node->output(i)->useScratchBus(scratch[i]);
+            else
+                node->output(i)->resetInPlaceBus();
         }
 
-        if (m_internal->autoDispatchEvents)
-            dispatchEvents();
+        node->processIfNecessary(r, framesToProcess);
 
+        // a node that didn't render leaves its outputs as they were
+        if (scratch)
         {
-            const double now = currentTime();
-            const float delta = static_cast<float>(now - lastGraphUpdateTime);
-            if (delta <= 0.f) // no need to keep running if the graph is no longer updating
-                break;
-            lastGraphUpdateTime = static_cast<float>(now);
-            graphKeepAlive -= delta;
+            const bool rendered = node->isProcessedForCurrentQuantum(r);
+            for (int i = 0; i < node->numberOfOutputs(); ++i)
+            {
+                if (rendered)
+                    node->output(i)->releaseScratchBus();
+                else
+                    node->output(i)->resetInPlaceBus();
+            }
         }
 
-        if (lk.owns_lock())
-            lk.unlock();
-
-        if (!updateThreadShouldRun)
-            break;
+        // Resolve channel count and fan out changes now, rather than in the first pull from
+        // a consumer, as consumers of the same output may render concurrently.
+        for (int i = 0; i < node->numberOfOutputs(); ++i)
+            node->output(i)->updateRenderingState(r);
     }
 
-    if (!m_isOfflineContext)
+    void renderScheduledTask(void * userData, int task)
     {
-        LOG_TRACE("End UpdateGraphThread");
+        ScheduledRender * render = static_cast<ScheduledRender *>(userData);
+        renderScheduledNode(*render->r, render->nodes[task], render->framesToProcess);
     }
 }
 
-void AudioContext::addAutomaticPullNode(std::shared_ptr<AudioNode> node)
+void AudioContext::processCompiledRenderSchedule(ContextRenderLock & r, int framesToProcess)
 {
-    std::lock_guard<std::mutex> lock(m_updateMutex);
-    if (m_automaticPullNodes.find(node) == m_automaticPullNodes.end())
+    RenderSchedule & schedule = m_internal->renderSchedule;
+    RenderThreadPool * pool = m_internal->renderThreadPool.get();
+
+    if (pool && schedule.parallelizable && schedule.nodes.size() > 1)
     {
-        m_automaticPullNodes.insert(node);
-        m_automaticPullNodesNeedUpdating = true;
-        if (!node->isScheduledNode())
+        ScheduledRender render = {&r, schedule.nodes.data(), framesToProcess};
+        pool->run(schedule.tasks, &renderScheduledTask, &render);
+        return;
+    }
+
+    // nothing renders in the first quantum, so loops are rendered in blocks from the second
+    const int blockSize = m_feedbackBlockSize.load(std::memory_order_relaxed);
+    const bool inBlocks = !schedule.loops.empty() && blockSize > 0 && blockSize < framesToProcess &&
+                          framesToProcess % blockSize == 0 && currentSampleFrame() > 0;
+
+    AudioBus * const * scratch = schedule.scratch.empty() ? nullptr : schedule.scratch.data();
+    size_t loop = 0;
+    const int nodeCount = static_cast<int>(schedule.nodes.size());
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        if (inBlocks && loop < schedule.loops.size() && schedule.loops[loop].first == i)
         {
-            node->_self->_scheduler.start(0);
+            i += schedule.loops[loop].count - 1;
+            renderFeedbackLoop(r, loop++, framesToProcess, blockSize);
+            continue;
         }
+
+        renderScheduledNode(r, schedule.nodes[i], framesToProcess, scratch ? scratch + schedule.scratchOffsets[i] : nullptr);
     }
 }
 
-void AudioContext::removeAutomaticPullNode(std::shared_ptr<AudioNode> node)
+void AudioContext::renderFeedbackLoop(ContextRenderLock & r, size_t index, int framesToProcess, int blockSize)
 {
-    std::lock_guard<std::mutex> lock(m_updateMutex);
-    auto it = m_automaticPullNodes.find(node);
-    if (it != m_automaticPullNodes.end())
+    RenderSchedule & schedule = m_internal->renderSchedule;
+    FeedbackLoop & loop = schedule.loops[index];
+    AudioNode * const * nodes = schedule.nodes.data() + loop.first;
+    const uint64_t frame = currentSampleFrame();
+    const uint64_t lastBlock = frame + framesToProcess - blockSize;
+    const size_t blockBytes = sizeof(float) * blockSize;
+
+    // The loop's sources have rendered the quantum. They are marked as having rendered its
+    // last block, so that the loop's pulls don't render them again, and each block's frames
+    // are copied from their quantum to the start of their buses in turn.
+    for (size_t s = 0; s < loop.sources.size(); ++s)
     {
-        m_automaticPullNodes.erase(it);
-        m_automaticPullNodesNeedUpdating = true;
+        std::atomic<uint64_t> & epoch = loop.sources[s]->sourceNode()->_self->_scheduler._epoch;
+        if (epoch.load() < lastBlock)
+            epoch.store(lastBlock);
+
+        AudioBus * bus = loop.sources[s]->bus(r);
+        std::unique_ptr<AudioBus> & copy = loop.sourceCopies[s];
+        if (!copy || copy->numberOfChannels() != bus->numberOfChannels() || copy->length() != bus->length())
+            copy.reset(new AudioBus(bus->numberOfChannels(), bus->length()));
+        for (int c = 0; c < bus->numberOfChannels(); ++c)
+            if (!bus->channel(c)->isConstant())
+                memcpy(copy->channel(c)->mutableData(), bus->channel(c)->data(), sizeof(float) * bus->length());
+        loop.sourceBuses[s] = bus;
     }
-}
 
-void AudioContext::updateAutomaticPullNodes()
-{
-    /// @TODO this seems like work for the update thread.
-    /// m_automaticPullNodesNeedUpdating can go away in favor of
-    /// add and remove doing a cv.notify.
-    /// m_automaticPullNodes should be an add/remove vector
-    /// m_renderingAutomaticPullNodes should be the actual live vector
-    if (m_automaticPullNodesNeedUpdating)
+    // The loop's outputs render into their own buses, which hold the last block of the
+    // previous quantum, for the nodes reading those closing the loop.
+    for (size_t o = 0; o < loop.outputs.size(); ++o)
+    {
+        loop.outputs[o]->resetInPlaceBus();
+        loop.silent[o] = true;
+    }
+
+    for (int offset = 0; offset < framesToProcess; offset += blockSize)
     {
-        std::lock_guard<std::mutex> lock(m_updateMutex);
+        const uint64_t block = frame + offset;
+        m_internal->feedbackBlockOffset.store(offset, std::memory_order_relaxed);
+
+        if (offset > 0)
+            for (size_t s = 0; s < loop.sources.size(); ++s)
+            {
+                AudioBus * bus = loop.sourceBuses[s];
+                for (int c = 0; c < bus->numberOfChannels(); ++c)
+                    if (!bus->channel(c)->isConstant())
+                        memcpy(bus->channel(c)->mutableData(), loop.sourceCopies[s]->channel(c)->data() + offset, blockBytes);
+            }
 
-        // Copy from m_automaticPullNodes to m_renderingAutomaticPullNodes.
-        m_renderingAutomaticPullNodes.resize(m_automaticPullNodes.size());
+        // Every node of the loop counts as having rendered the block until its turn, so
+        // that a node reading one after it reads the previous block rather than rendering it.
+        for (int i = 0; i < loop.count; ++i)
+            nodes[i]->_self->_scheduler._epoch.store(block);
 
-        unsigned j = 0;
-        for (auto i = m_automaticPullNodes.begin(); i != m_automaticPullNodes.end(); ++i, ++j)
+        size_t o = 0;
+        for (int i = 0; i < loop.count; ++i)
         {
-            m_renderingAutomaticPullNodes[j] = *i;
+            AudioNode * node = nodes[i];
+            node->_self->_scheduler._epoch.store(block - 1);
+            node->processIfNecessary(r, blockSize);
+
+            for (auto & out : node->_self->m_outputs)
+            {
+                out->updateRenderingState(r);
+
+                AudioBus * bus = out->bus(r);
+                std::unique_ptr<AudioBus> & assembled = loop.assembled[o];
+                if (!assembled || assembled->numberOfChannels() != bus->numberOfChannels() || assembled->length() != bus->length())
+                    assembled.reset(new AudioBus(bus->numberOfChannels(), bus->length()));
+
+                for (int c = 0; c < bus->numberOfChannels(); ++c)
+                {
+                    const AudioChannel * source = bus->channel(c);
+                    AudioChannel * destination = assembled->channel(c);
+                    if (!source->isSilent())
+                    {
+                        memcpy(destination->mutableData() + offset, source->data(), blockBytes);
+                        loop.silent[o] = false;
+                    }
+                    else if (!destination->isSilent())
+                        memset(destination->mutableData() + offset, 0, blockBytes);
+                }
+                ++o;
+            }
         }
+    }
+    m_internal->feedbackBlockOffset.store(0, std::memory_order_relaxed);
+
+    for (size_t s = 0; s < loop.sources.size(); ++s)
+    {
+        AudioBus * bus = loop.sourceBuses[s];
+        for (int c = 0; c < bus->numberOfChannels(); ++c)
+            if (!bus->channel(c)->isConstant())
+                memcpy(bus->channel(c)->mutableData(), loop.sourceCopies[s]->channel(c)->data(), blockBytes);
+    }
 
-        m_automaticPullNodesNeedUpdating = false;
+    // the nodes after the loop read the quantum assembled from its blocks
+    for (int i = 0; i < loop.count; ++i)
+    {
+        std::atomic<uint64_t> & epoch = nodes[i]->_self->_scheduler._epoch;
+        if (epoch.load() < lastBlock)
+            epoch.store(lastBlock);
+    }
+    for (size_t o = 0; o < loop.outputs.size(); ++o)
+    {
+        if (loop.silent[o])
+            loop.assembled[o]->zero();
+        loop.outputs[o]->useScratchBus(loop.assembled[o].get());
     }
 }
 
-void AudioContext::processAutomaticPullNodes(ContextRenderLock & r, int framesToProcess)
+void AudioContext::setRenderThreadCount(int threadCount)
+{
+    std::unique_ptr<RenderThreadPool> pool;
+    if (threadCount > 1)
+    {
+        ThreadScheduling scheduling = m_internal->renderThreadScheduling;
+        AudioDevice * device = _destinationNode ? _destinationNode->device() : nullptr;
+        if (!scheduling.workgroup && device)
+            scheduling.workgroup = device->renderWorkgroup();
+        if (scheduling.period <= 0 && sampleRate() > 0)
+            scheduling.period = renderQuantumSize() / sampleRate();
+        pool.reset(new RenderThreadPool(threadCount - 1, scheduling));
+    }
+
+    {
+        ContextRenderLock r(this, "AudioContext::setRenderThreadCount");
+        m_internal->renderThreadPool.swap(pool);
+        m_internal->renderScheduleDirty = true;
+    }
+
+    // the previous pool's threads are joined here, outside of the render lock
+}
+
+int AudioContext::renderThreadCount() const
+{
+    return m_internal->renderThreadPool ? m_internal->renderThreadPool->workerCount() + 1 : 1;
+}
+
+void AudioContext::setRenderThreadScheduling(const ThreadScheduling & scheduling)
+{
+    m_internal->renderThreadScheduling = scheduling;
+    if (m_internal->renderThreadPool)
+        setRenderThreadCount(renderThreadCount());
+}
+
+ThreadScheduling AudioContext::renderThreadScheduling() const
+{
+    return m_internal->renderThreadScheduling;
+}
+
+void AudioContext::setRenderQuantumSize(int frames)
+{
+    if (frames < AudioNode::MinProcessingSizeInFrames || frames > AudioNode::MaxProcessingSizeInFrames || (frames & (frames - 1)))
+        throw std::invalid_argument("Render quantum size must be a power of two between 16 and 4096");
+    if (_destinationNode)
+        throw std::runtime_error("Render quantum size must be set before the destination node is created");
+
+    m_renderQuantumSize = frames;
+}
+
+void AudioContext::setFeedbackBlockSize(int frames)
+{
+    if (frames < 0 || frames > AudioNode::MaxProcessingSizeInFrames || (frames & (frames - 1)))
+        throw std::invalid_argument("Feedback block size must be zero, or a power of two no larger than 4096");
+
+    m_feedbackBlockSize.store(frames, std::memory_order_relaxed);
+}
+
+int AudioContext::feedbackBlockSize() const
+{
+    return m_feedbackBlockSize.load(std::memory_order_relaxed);
+}
+
+void AudioContext::setProfileSampling(int quanta)
+{
+    m_profileSampling.store(std::max(0, quanta), std::memory_order_relaxed);
+}
+
+int AudioContext::profileSampling() const
+{
+    return m_profileSampling.load(std::memory_order_relaxed);
+}
+
+int AudioContext::renderQuantumSize() const
 {
-    for (unsigned i = 0; i < m_renderingAutomaticPullNodes.size(); ++i)
+    return m_renderQuantumSize;
+}
+
+void AudioContext::enqueueEvent(AudioNode & node, AudioEventKind kind)
+{
+    AudioEvent event;
+    event.kind = kind;
+    event.scheduler = std::shared_ptr<AudioNodeScheduler>(node._self, &node._self->_scheduler);
+    event.enqueued = steadyNanoseconds();
+    if (!m_internal->nodeEvents.tryPush(std::move(event)))
     {
-        m_renderingAutomaticPullNodes[i]->processIfNecessary(r, framesToProcess);
+        m_internal->droppedNodeEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
+
+    if (m_internal->autoDispatchEvents)
+        m_internal->eventsEnqueued.signal();  // the update thread must dispatch events
 }
 
 void AudioContext::enqueueEvent(std::function<void()> & fn)
 {
     m_internal->enqueuedEvents.enqueue(fn);
-    cv.notify_all();  // processing thread must dispatch events
+    if (m_internal->autoDispatchEvents)
+        m_internal->eventsEnqueued.signal();  // the update thread must dispatch events
 }
 
 void AudioContext::dispatchEvents()
 {
+    AudioEvent event;
+    while (m_internal->nodeEvents.tryPop(event))
+    {
+        const int64_t latency = steadyNanoseconds() - event.enqueued;
+        m_internal->eventsDispatched.fetch_add(1, std::memory_order_relaxed);
+        m_internal->eventLatencyTotal.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > m_internal->eventLatencyPeak.load(std::memory_order_relaxed))
+            m_internal->eventLatencyPeak.store(latency, std::memory_order_relaxed);
+
+        switch (event.kind)
+        {
+            case AudioEventKind::Ended:
+                if (event.scheduler->_onEnded) event.scheduler->_onEnded();
+                break;
+        }
+
+        // the last reference to a node's internals may be released here rather than on
+        // the audio thread
+        event.scheduler.reset();
+    }
+
+    // the counts are left to accumulate, for metrics(), and their increase since the last dispatch logged
+    const uint64_t dropped = m_internal->droppedNodeEvents.load(std::memory_order_relaxed);
+    if (dropped != m_internal->reportedDroppedNodeEvents)
+    {
+        LOG_WARN("AudioContext dropped %llu events; they were enqueued faster than they were dispatched",
+                 (unsigned long long) (dropped - m_internal->reportedDroppedNodeEvents));
+        m_internal->reportedDroppedNodeEvents = dropped;
+    }
+
+    const uint64_t missed = m_renderLockMisses.load(std::memory_order_relaxed);
+    if (missed != m_internal->reportedRenderLockMisses)
+    {
+        LOG_WARN("AudioContext rendered %llu quanta as silence; the render lock was held by another thread",
+                 (unsigned long long) (missed - m_internal->reportedRenderLockMisses));
+        m_internal->reportedRenderLockMisses = missed;
+    }
+
     std::function<void()> event_fn;
     while (m_internal->enqueuedEvents.try_dequeue(event_fn))
     {
@@ -659,6 +2179,7 @@ void AudioContext::dispatchEvents()
 void AudioContext::setDestinationNode(std::shared_ptr<AudioDestinationNode> device)
 {
     _destinationNode = device;
+    m_internal->renderScheduleDirty = true;
     lazyInitialize();
 }
 
@@ -677,31 +2198,177 @@ std::shared_ptr<AudioListener> AudioContext::listener()
     return m_listener;
 }
 
+std::shared_ptr<ModulationBus> AudioContext::modulation()
+{
+    return m_modulation;
+}
+
+std::shared_ptr<SpatialScene> AudioContext::spatialScene()
+{
+    return m_spatialScene;
+}
+
+void AudioContext::setLatencyCompensation(bool enabled)
+{
+    m_latencyCompensation.store(enabled, std::memory_order_relaxed);
+}
+
+bool AudioContext::latencyCompensation() const
+{
+    return m_latencyCompensation.load(std::memory_order_relaxed);
+}
+
+void AudioContext::setDenormalDetection(bool enabled)
+{
+    m_denormalDetection.store(enabled, std::memory_order_relaxed);
+}
+
+double AudioContext::graphLatency() const
+{
+    const float rate = sampleRate();
+    return rate > 0 ? m_internal->graphLatencyFrames.load(std::memory_order_relaxed) / static_cast<double>(rate) : 0;
+}
+
 double AudioContext::currentTime() const
 {
     auto dn = _destinationNode;
-    if (dn)
-        return dn->getSamplingInfo().current_time;
-    return 0.f;
+    if (!dn)
+        return 0.f;
+
+    const int offset = m_internal->feedbackBlockOffset.load(std::memory_order_relaxed);
+    if (offset)
+        return dn->clock().time + offset / static_cast<double>(dn->clock().sampleRate);
+    return dn->clock().time;
+}
+
+
+void AudioContext::setRenderPhase(RenderPhase phase)
+{
+    if (phase == RenderPhase::WaitingForLock)
+    {
+        m_internal->quantumStart.store(steadyNanoseconds(), std::memory_order_relaxed);
+        m_internal->quantumFrame.store(_destinationNode ? currentSampleFrame() : 0, std::memory_order_relaxed);
+    }
+    m_internal->renderPhase.store(static_cast<int>(phase), std::memory_order_release);
+}
+
+void AudioContext::setRenderWatchdog(double deadline, std::function<void(const RenderStall &)> onStall)
+{
+    Internals * internals = m_internal.get();
+    std::thread stopped;
+    {
+        std::lock_guard<std::mutex> lock(internals->watchdogLock);
+        internals->watchdogDeadline = deadline > 0 ? deadline : 0;
+        internals->onStall = std::move(onStall);
+
+        if (deadline <= 0)
+            stopped = std::move(internals->watchdog);
+        else if (!internals->watchdog.joinable())
+        {
+            internals->watchdog = std::thread([this, internals]()
+            {
+                // the start of the last quantum reported, so that each stall is reported once
+                int64_t reported = 0;
+
+                std::unique_lock<std::mutex> lock(internals->watchdogLock);
+                while (internals->watchdogDeadline > 0)
+                {
+                    // checked a few times per deadline, so that a stall is caught soon after it
+                    const double period = std::min(0.05, std::max(0.001, internals->watchdogDeadline * 0.25));
+                    internals->watchdogWake.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(period * 1.e6)));
+
+                    const double deadline = internals->watchdogDeadline;
+                    const RenderPhase phase = static_cast<RenderPhase>(internals->renderPhase.load(std::memory_order_acquire));
+                    const int64_t start = internals->quantumStart.load(std::memory_order_relaxed);
+                    if (deadline <= 0 || phase == RenderPhase::Idle || !start || start == reported)
+                        continue;
+
+                    const double elapsed = (steadyNanoseconds() - start) * 1.e-9;
+                    if (elapsed < deadline)
+                        continue;
+
+                    RenderStall stall;
+                    stall.elapsed = elapsed;
+                    stall.sampleFrame = internals->quantumFrame.load(std::memory_order_relaxed);
+                    stall.waitingForRenderLock = phase == RenderPhase::WaitingForLock;
+                    stall.renderLockHolder = m_renderLocker.load(std::memory_order_relaxed);
+                    stall.graphLockHolder = m_graphLocker.load(std::memory_order_relaxed);
+                    stall.node = stall.waitingForRenderLock ? nullptr : m_renderingNode.load(std::memory_order_relaxed);
+                    reported = start;
+                    internals->renderStalls.fetch_add(1, std::memory_order_relaxed);
+                    RenderTrace::instant("render stall", "render");
+
+                    LOG_WARN("render stall: the quantum at frame %llu has taken %.2f ms, %s %s; the render lock is held by %s, the graph lock by %s",
+                             (unsigned long long) stall.sampleFrame, stall.elapsed * 1.e3,
+                             stall.waitingForRenderLock ? "waiting for the render lock" : stall.node ? "processing" : "rendering, between nodes",
+                             stall.node ? stall.node : "",
+                             stall.renderLockHolder ? stall.renderLockHolder : "nobody",
+                             stall.graphLockHolder ? stall.graphLockHolder : "nobody");
+
+                    if (internals->onStall)
+                    {
+                        std::function<void(const RenderStall &)> handler = internals->onStall;
+                        lock.unlock();
+                        handler(stall);
+                        lock.lock();
+                    }
+                }
+            });
+        }
+    }
+    internals->watchdogWake.notify_all();
+
+    if (stopped.joinable())
+        stopped.join();
+}
+
+uint64_t AudioContext::renderStallCount() const
+{
+    return m_internal->renderStalls.load(std::memory_order_relaxed);
+}
+
+AudioContextMetrics AudioContext::metrics() const
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    m_internal->countPlayingSources.store(true, relaxed);
+
+    AudioContextMetrics m;
+    m.renderStalls = m_internal->renderStalls.load(relaxed);
+    m.renderLockMisses = m_renderLockMisses.load(relaxed);
+    m.scheduledNodes = m_internal->scheduledNodes.load(relaxed);
+    m.playingSources = m_internal->playingSources.load(relaxed);
+    m.pendingConnections = m_internal->pendingNodeConnections.size_approx() + m_internal->pendingParamConnections.size_approx() +
+                           m_internal->pendingEdits.size_approx();
+    m.pendingEvents = m_internal->nodeEvents.sizeApprox();
+    m.droppedEvents = m_internal->droppedNodeEvents.load(relaxed);
+    m.eventsDispatched = m_internal->eventsDispatched.load(relaxed);
+    m.eventLatencyTotal = m_internal->eventLatencyTotal.load(relaxed) * 1.e-9;
+    m.eventLatencyPeak = m_internal->eventLatencyPeak.exchange(0, relaxed) * 1.e-9;
+    m.denormalQuanta = m_denormalQuanta.load(relaxed);
+    return m;
 }
 
 uint64_t AudioContext::currentSampleFrame() const
 {
-    return _destinationNode->getSamplingInfo().current_sample_frame;
+    return _destinationNode->clock().sampleFrame + m_internal->feedbackBlockOffset.load(std::memory_order_relaxed);
 }
 
-double AudioContext::predictedCurrentTime() const
+RenderClockSnapshot AudioContext::clock() const
 {
-    auto info = _destinationNode->getSamplingInfo();
-    uint64_t t = info.current_sample_frame;
-    double val = t / info.sampling_rate;
-    auto t2 = std::chrono::high_resolution_clock::now();
-    int index = t & 1;
+    auto dn = _destinationNode;
+    if (dn)
+        return dn->clock();
+    return {};
+}
 
-    if (!info.epoch[index].time_since_epoch().count())
+double AudioContext::predictedCurrentTime() const
+{
+    const RenderClockSnapshot clock = _destinationNode->clock();
+    const double val = clock.sampleFrame / clock.sampleRate;
+    if (!clock.hostTime.time_since_epoch().count())
         return val;
 
-    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - info.epoch[index];
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - clock.hostTime;
     return val + elapsed.count();
 }
 
@@ -714,7 +2381,23 @@ float AudioContext::sampleRate() const
     if (!_destinationNode)
         return 0.f;
 
-    return _destinationNode->getSamplingInfo().sampling_rate;
+    // a decimated node, and what it reads its rate for as it processes, such as its
+    // params' automation, runs at a fraction of the rate
+    if (t_renderDecimation > 1)
+        return _destinationNode->clock().sampleRate / t_renderDecimation;
+    return _destinationNode->clock().sampleRate;
+}
+
+int AudioContext::renderDecimation()
+{
+    return t_renderDecimation;
+}
+
+int AudioContext::setRenderDecimation(int decimation)
+{
+    const int previous = t_renderDecimation;
+    t_renderDecimation = decimation;
+    return previous;
 }
 
 void AudioContext::startOfflineRendering()
@@ -743,9 +2426,129 @@ void AudioContext::resume()
     if (!_destinationNode && !_destinationNode->device())
         return;
 
+    m_internal->autoSuspendWake.store(false, std::memory_order_relaxed);
+    m_internal->autoSuspendState.store(AutoSuspendRunning, std::memory_order_release);
     _destinationNode->device()->start();
 }
 
+void AudioContext::setAutoSuspend(double silentSeconds)
+{
+    const float sr = sampleRate();
+    const uint64_t frames = silentSeconds > 0 ? std::max<uint64_t>(1, static_cast<uint64_t>(silentSeconds * (sr > 0 ? sr : 48000.f))) : 0;
+    m_internal->autoSuspendFrames.store(frames, std::memory_order_relaxed);
+    if (!frames)
+        wakeFromAutoSuspend();
+}
+
+bool AudioContext::isAutoSuspended() const
+{
+    return m_internal->autoSuspendState.load(std::memory_order_acquire) == AutoSuspended;
+}
+
+void AudioContext::updateAutoSuspend(ContextRenderLock & r, const AudioBus * output, int frames)
+{
+    const uint64_t limit = m_internal->autoSuspendFrames.load(std::memory_order_relaxed);
+    if (!limit || m_isOfflineContext || !output)
+        return;
+    if (m_internal->autoSuspendState.load(std::memory_order_relaxed) != AutoSuspendRunning)
+        return;
+
+    for (int c = 0; c < output->numberOfChannels(); ++c)
+    {
+        const AudioChannel * channel = output->channel(c);
+        if (channel->isSilent())
+            continue;
+        float peak = 0;
+        VectorMath::vmaxmgv(channel->data(), 1, &peak, frames);
+        if (peak > AutoSuspendThreshold)
+        {
+            m_internal->silentFrames = 0;
+            m_internal->autoSuspendWake.store(false, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    m_internal->silentFrames += frames;
+    if (m_internal->silentFrames < limit)
+        return;
+
+    // the output is silent, but something may be due to sound; it is checked again once
+    // another quantum has passed
+    bool due = m_internal->pendingNodeConnections.size_approx() > 0 || m_internal->pendingParamConnections.size_approx() > 0
+            || m_internal->pendingEdits.size_approx() > 0
+            || m_internal->pendingDisconnectCount.load(std::memory_order_relaxed) > 0
+            || !m_internal->pendingCommands.empty();
+    const double now = currentTime();
+    for (AudioNode * node : m_internal->renderSchedule.nodes)
+    {
+        if (due)
+            break;
+        if (node->_self->_scheduler._playbackState == SchedulingState::SCHEDULED)
+            due = true;
+        for (auto & p : node->_self->_params)
+            if (p->hasEventsAfter(now))
+                due = true;
+    }
+    if (due)
+        return;
+
+    m_internal->silentFrames = 0;
+    m_internal->autoSuspendState.store(AutoSuspendRequested, std::memory_order_release);
+    m_internal->eventsEnqueued.signal();
+}
+
+void AudioContext::wakeFromAutoSuspend()
+{
+    // The wake is kept while the context runs, as the audio thread may be about to request
+    // suspension without having seen what woke it; it is cleared once the output sounds.
+    m_internal->autoSuspendWake.store(true, std::memory_order_release);
+    if (m_internal->autoSuspendState.load(std::memory_order_acquire) != AutoSuspendRunning)
+        m_internal->eventsEnqueued.signal();
+}
+
+void AudioContext::applyAutoSuspend()
+{
+    AudioDevice * device = _destinationNode ? _destinationNode->device() : nullptr;
+    if (!device)
+        return;
+
+    const bool wake = m_internal->autoSuspendWake.exchange(false, std::memory_order_acq_rel) || !m_internal->autoSuspendFrames.load(std::memory_order_relaxed);
+    switch (m_internal->autoSuspendState.load(std::memory_order_acquire))
+    {
+        case AutoSuspendRequested:
+            if (wake)
+            {
+                m_internal->autoSuspendState.store(AutoSuspendRunning, std::memory_order_release);
+                break;
+            }
+            device->stop();
+            m_internal->autoSuspendState.store(AutoSuspended, std::memory_order_release);
+            LOG_INFO("AudioContext: the output is silent; suspending the device");
+
+            // a wake sent while the device was stopping is picked up now
+            if (m_internal->autoSuspendWake.load(std::memory_order_acquire))
+                m_internal->eventsEnqueued.signal();
+            break;
+
+        case AutoSuspended:
+            if (!wake)
+                break;
+            m_internal->autoSuspendState.store(AutoSuspendRunning, std::memory_order_release);
+            device->start();
+            LOG_INFO("AudioContext: resuming the device");
+            break;
+
+        default:
+            break;
+    }
+}
+
+void AudioContext::AudioContextInterface::wake()
+{
+    if (_ac)
+        _ac->wakeFromAutoSuspend();
+}
+
 void AudioContext::close()
 {
     suspend();
@@ -6,18 +6,154 @@
 #include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/RenderTrace.h"
 #include "LabSound/core/AudioSourceProvider.h"
 #include "LabSound/extended/AudioContextLock.h"
 
 #include "internal/Assertions.h"
 #include "internal/DenormalDisabler.h"
 
+#include <algorithm>
+#include <string.h>
+
 // Non platform-specific helper functions
 
 using namespace lab;
 
+AudioDeviceLoadStats AudioDevice::loadStats() const
+{
+    AudioDeviceLoadStats stats;
+    stats.callbacks = _callbacks.load(std::memory_order_relaxed);
+    stats.overruns = _overruns.load(std::memory_order_relaxed);
+    stats.xruns = _xruns.load(std::memory_order_relaxed);
+    stats.loadPercent = _loadPercent.load(std::memory_order_relaxed);
+    stats.averageLoadPercent = _averageLoadPercent.load(std::memory_order_relaxed);
+    stats.peakLoadPercent = _peakLoadPercent.load(std::memory_order_relaxed);
+    for (int i = 0; i < AudioDeviceLoadStats::HistogramBuckets; ++i)
+        stats.histogram[i] = _loadHistogram[i].load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AudioDevice::resetLoadStats()
+{
+    _callbacks = 0;
+    _overruns = 0;
+    _xruns = 0;
+    _peakLoadPercent = 0;
+    for (auto & bucket : _loadHistogram)
+        bucket = 0;
+}
+
+void AudioDevice::endCallback(ProfileClock::time_point start, int frames, float sampleRate)
+{
+    const float microseconds = std::chrono::duration<float, std::micro>(ProfileClock::now() - start).count();
+    _callbackTime.record(microseconds);
+
+    if (frames <= 0 || sampleRate <= 0)
+        return;
+
+    // only the audio thread writes, so the read-modify-writes below need not be atomic
+    const float period = 1.e6f * static_cast<float>(frames) / sampleRate;
+    const float load = 100.f * microseconds / period;
+    const float smoothing = std::min(1.f, period * 1.e-6f);  // a time constant of a second
+    const float average = _averageLoadPercent.load(std::memory_order_relaxed);
+
+    _loadPercent.store(load, std::memory_order_relaxed);
+    _averageLoadPercent.store(average + (load - average) * smoothing, std::memory_order_relaxed);
+    if (load > _peakLoadPercent.load(std::memory_order_relaxed))
+        _peakLoadPercent.store(load, std::memory_order_relaxed);
+
+    const int bucket = load > 100.f ? AudioDeviceLoadStats::HistogramBuckets - 1
+                                    : std::min(static_cast<int>(load * 0.1f), AudioDeviceLoadStats::HistogramBuckets - 2);
+    _loadHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (load > 100.f)
+        _overruns.fetch_add(1, std::memory_order_relaxed);
+    _callbacks.fetch_add(1, std::memory_order_relaxed);
+}
 
 
+
+namespace
+{
+    void pull_graph_locked(
+        ContextRenderLock & renderLock,
+        AudioNodeInput * required_inlet,
+        AudioBus * src, AudioBus * dst,
+        int frames,
+        AudioSourceProvider * optional_hardware_input)
+    {
+        AudioContext * ctx = renderLock.context();
+
+        if (!ctx->isInitialized())
+        {
+            if (dst)
+                dst->zero();
+            return;
+        }
+
+        // Denormals can slow down audio processing by orders of magnitude. They arise
+        // wherever a signal decays toward zero without reaching it: the state of a feedback
+        // filter or a delay's feedback loop once its input falls silent, the tail of a
+        // reverb, an exponential envelope. Flushing them to zero protects every AudioNode
+        // processed within this scope, whichever thread pulls the graph; the context's
+        // denormal detection counts the nodes that produce them.
+
+        DenormalDisabler denormalDisabler;
+
+        // Let the context take care of any business at the start of each render quantum.
+        ctx->handlePreRenderTasks(renderLock);
+
+        // Prepare the local audio input provider for this render quantum.
+        if (optional_hardware_input && src)
+        {
+            optional_hardware_input->set(src);
+        }
+
+        // Render the compiled schedule in dependency order, then pull the inputs. Any node
+        // rendered by the schedule is cached for this quantum, so the pull only recurses
+        // into parts of the graph the schedule doesn't know about.
+        ctx->processCompiledRenderSchedule(renderLock, frames);
+        AudioBus * renderedBus = required_inlet->pull(renderLock, dst, frames);
+
+        if (dst) {
+            if (!renderedBus)
+            {
+                dst->zero();
+            }
+            else if (renderedBus != dst)
+            {
+                // in-place processing was not possible - so copy
+                dst->copyFrom(*renderedBus);
+            }
+        }
+
+        // Process nodes which need extra help because they are not connected to anything,
+        // but still have work to do
+        ctx->processAutomaticPullNodes(renderLock, frames);
+
+        // Copy out any taps on the rendered graph, now that every node has rendered
+        ctx->processRenderCaptures(renderLock, frames);
+
+        ctx->updateAutoSuspend(renderLock, dst, frames);
+
+        // Let the context take care of any business at the end of each render quantum.
+        ctx->handlePostRenderTasks(renderLock);
+    }
+}
+
+namespace
+{
+    // Marks the render thread's heartbeat for the context's watchdog, from the start of a
+    // quantum, through taking the render lock, to its end.
+    struct RenderHeartbeat
+    {
+        AudioContext * ctx;
+        explicit RenderHeartbeat(AudioContext * ctx) : ctx(ctx) { ctx->setRenderPhase(AudioContext::RenderPhase::WaitingForLock); }
+        ~RenderHeartbeat() { ctx->setRenderPhase(AudioContext::RenderPhase::Idle); }
+        void locked() { ctx->setRenderPhase(AudioContext::RenderPhase::Rendering); }
+    };
+}
+
 void lab::pull_graph(
         AudioContext * ctx,
         AudioNodeInput * required_inlet,
@@ -38,56 +174,28 @@ void lab::pull_graph(
 
     ASSERT(required_inlet);
 
-    ContextRenderLock renderLock(ctx, "lab::pull_graph");
-    if (!renderLock.context()) return;  // return if couldn't acquire lock
+    RenderHeartbeat heartbeat(ctx);
 
-    if (!ctx->isInitialized())
+    // A realtime callback never waits for the render lock; if another thread holds it,
+    // the quantum is silence. An offline context has no deadline, and waits its turn.
+    if (ctx->isOfflineContext())
     {
-        if (dst)
-            dst->zero();
+        ContextRenderLock renderLock(ctx, "lab::pull_graph");
+        heartbeat.locked();
+        pull_graph_locked(renderLock, required_inlet, src, dst, frames, optional_hardware_input);
         return;
     }
 
-    // Denormals can slow down audio processing.
-    // Use an RAII object to protect all AudioNodes processed within this scope.
-
-    /// @TODO under what circumstance do they arise?
-    /// If they come from input data such as loaded WAV files, they should be corrected
-    /// at source. If they can result from signal processing; again, where? The
-    /// signal processing should not produce denormalized values.
-
-    DenormalDisabler denormalDisabler;
-
-    // Let the context take care of any business at the start of each render quantum.
-    ctx->handlePreRenderTasks(renderLock);
-
-    // Prepare the local audio input provider for this render quantum.
-    if (optional_hardware_input && src)
+    ContextRenderLock renderLock(ctx, "lab::pull_graph", std::try_to_lock);
+    if (!renderLock.context())
     {
-        optional_hardware_input->set(src);
-    }
-
-    // process the graph by pulling the inputs, which will recurse the entire processing graph.
-    AudioBus * renderedBus = required_inlet->pull(renderLock, dst, frames);
-
-    if (dst) {
-        if (!renderedBus)
-        {
+        if (dst)
             dst->zero();
-        }
-        else if (renderedBus != dst)
-        {
-            // in-place processing was not possible - so copy
-            dst->copyFrom(*renderedBus);
-        }
+        return;
     }
 
-    // Process nodes which need extra help because they are not connected to anything,
-    // but still have work to do
-    ctx->processAutomaticPullNodes(renderLock, frames);
-
-    // Let the context take care of any business at the end of each render quantum.
-    ctx->handlePostRenderTasks(renderLock);
+    heartbeat.locked();
+    pull_graph_locked(renderLock, required_inlet, src, dst, frames, optional_hardware_input);
 }
 
 namespace lab {
@@ -115,28 +223,62 @@ AudioDestinationNode::AudioDestinationNode(
 
     // Info is provided by the backend every frame, but some nodes need to be constructed
     // with a valid sample rate before the first frame so we make our best guess here
-    _last_info = {};
-    _last_info.sampling_rate = _platformAudioDevice->getOutputConfig().desired_samplerate;
+    SamplingInfo info = {};
+    info.sampling_rate = _platformAudioDevice->getOutputConfig().desired_samplerate;
+    setSamplingInfo(info);
 
     initialize();
 }
 
+void AudioDestinationNode::setSamplingInfo(const SamplingInfo & info)
+{
+    _last_info = info;
+
+    RenderClockSnapshot clock;
+    clock.sampleFrame = info.current_sample_frame;
+    clock.time = info.current_time;
+    clock.sampleRate = info.sampling_rate;
+    clock.hostTime = info.epoch[info.current_sample_frame & 1];
+    _clock.publish(clock);
+}
+
 void AudioDestinationNode::render(AudioSourceProvider* provider,
         AudioBus * src, AudioBus * dst,
         int frames,
         const SamplingInfo & info)
 {
+    RenderTrace::nameThread("LabSound render");
+    TraceScope trace("quantum", "render");
     ProfileScope selfProfile(_self->totalTime);
     ProfileScope profile(_self->graphTime);
     pull_graph(_context, input(0).get(), src, dst, frames, info, provider);
-    _last_info = info;
+    setSamplingInfo(info);
     profile.finalize();
     selfProfile.finalize();
+    _renderTime.record(_self->totalTime.microseconds.count());
+}
+
+void AudioDestinationNode::offlineRenderQuantum(AudioBus * dst)
+{
+    const int offlineRenderSizeQuantum = renderQuantumSize();
+
+    AudioSourceProvider* asp = nullptr;
+    render(asp, 0, dst, offlineRenderSizeQuantum, _last_info);
+
+    // Update sampling info
+    SamplingInfo info = _last_info;
+    const int index = 1 - (info.current_sample_frame & 1);
+    const uint64_t t = info.current_sample_frame & ~1;
+    info.current_sample_frame = t + offlineRenderSizeQuantum + index;
+    info.current_time = info.current_sample_frame / static_cast<double>(info.sampling_rate);
+    info.epoch[index] = info.epoch[1 - index] + std::chrono::nanoseconds {
+            static_cast<uint64_t>(1.e9 * (double) offlineRenderSizeQuantum / (double) info.sampling_rate)};
+    setSamplingInfo(info);
 }
 
 void AudioDestinationNode::offlineRender(AudioBus * dst, int framesToProcess)
 {
-    static const int offlineRenderSizeQuantum = AudioNode::ProcessingSizeInFrames;
+    const int offlineRenderSizeQuantum = renderQuantumSize();
 
     if (!dst || !framesToProcess || !_context || !_context->isInitialized())
         return;
@@ -151,19 +293,73 @@ void AudioDestinationNode::offlineRender(AudioBus * dst, int framesToProcess)
     while (framesToProcess > 0)
     {
         _context->update();
-        AudioSourceProvider* asp = nullptr;
-        render(asp, 0, dst, offlineRenderSizeQuantum, _last_info);
+        offlineRenderQuantum(dst);
+        framesToProcess -= offlineRenderSizeQuantum;
+    }
+}
+
+uint64_t AudioDestinationNode::offlineRender(uint64_t framesToProcess, int chunkFrames,
+                                             const OfflineRenderSink & sink, const OfflineRenderProgress & progress)
+{
+    const int quantum = renderQuantumSize();
+
+    if (!framesToProcess || !_context || !_context->isInitialized())
+        return 0;
+
+    // chunks hold a whole number of render quanta
+    if (chunkFrames < quantum)
+        chunkFrames = quantum;
+    chunkFrames = ((chunkFrames + quantum - 1) / quantum) * quantum;
+
+    const int channels = _platformAudioDevice ? (int) _platformAudioDevice->getOutputConfig().desired_channels : channelCount();
+    AudioBus quantumBus(channels, quantum);
+    AudioBus chunkBus(channels, chunkFrames);
+    quantumBus.setSampleRate(_last_info.sampling_rate);
+    chunkBus.setSampleRate(_last_info.sampling_rate);
+
+    LOG_TRACE("offline rendering started");
+
+    uint64_t framesRendered = 0;
+    while (framesRendered < framesToProcess)
+    {
+        // Graph edits and events are serviced once per chunk rather than once per quantum
+        _context->update();
 
-        // Update sampling info
-        const int index = 1 - (_last_info.current_sample_frame & 1);
-        const uint64_t t = _last_info.current_sample_frame & ~1;
-        _last_info.current_sample_frame = t + offlineRenderSizeQuantum + index;
-        _last_info.current_time = _last_info.current_sample_frame / static_cast<double>(_last_info.sampling_rate);
-        _last_info.epoch[index] += std::chrono::nanoseconds {
-                static_cast<uint64_t>(1.e9 * (double) framesToProcess / (double) offlineRenderSizeQuantum)};
+        const uint64_t framesRemaining = framesToProcess - framesRendered;
+        const int framesInChunk = framesRemaining < (uint64_t) chunkFrames ? (int) framesRemaining : chunkFrames;
 
-        framesToProcess -= offlineRenderSizeQuantum;
+        for (int offset = 0; offset < framesInChunk; offset += quantum)
+        {
+            offlineRenderQuantum(&quantumBus);
+
+            const int count = std::min(quantum, framesInChunk - offset);
+            for (int c = 0; c < channels; ++c)
+            {
+                const AudioChannel * src = quantumBus.channel(c);
+                float * dst = chunkBus.channel(c)->mutableData() + offset;
+                if (src->isSilent())
+                    memset(dst, 0, sizeof(float) * count);
+                else
+                    memcpy(dst, src->data(), sizeof(float) * count);
+            }
+        }
+
+        const uint64_t firstFrame = framesRendered;
+        framesRendered += framesInChunk;
+
+        if (progress)
+            progress(framesRendered, framesToProcess);
+
+        if (sink && !sink(chunkBus, framesInChunk, firstFrame))
+            break;
     }
+
+    LOG_TRACE("offline rendering finished");
+
+    if (_context->offlineRenderCompleteCallback)
+        _context->offlineRenderCompleteCallback();
+
+    return framesRendered;
 }
 
 void AudioDestinationNode::initialize()
@@ -182,10 +378,12 @@ void AudioDestinationNode::uninitialize()
     _platformAudioDevice.reset();
 }
 
+// Resetting the graph leaves the device playing, as restarting it is audible; a device
+// that has stopped is started.
 void AudioDestinationNode::reset(ContextRenderLock &)
 {
-    _platformAudioDevice->stop();
-    _platformAudioDevice->start();
+    if (_platformAudioDevice && !_platformAudioDevice->isRunning())
+        _platformAudioDevice->start();
 }
 
 }
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioDevice_External.h"
+#include "LabSound/core/AudioBus.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+AudioDevice_External::AudioDevice_External(const AudioStreamConfig & inputConfig, const AudioStreamConfig & outputConfig)
+    : AudioDevice(inputConfig, outputConfig)
+{
+    _samplingInfo.sampling_rate = outputConfig.desired_samplerate;
+    _samplingInfo.epoch[0] = _samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
+}
+
+AudioDevice_External::~AudioDevice_External() = default;
+
+void AudioDevice_External::renderQuantum(AudioBus * input, AudioBus * output)
+{
+    const int32_t index = 1 - (_samplingInfo.current_sample_frame & 1);
+    const uint64_t t = _samplingInfo.current_sample_frame & ~1;
+    _samplingInfo.current_sample_frame = t + _quantum + index;
+    _samplingInfo.current_time = _samplingInfo.current_sample_frame / static_cast<double>(_samplingInfo.sampling_rate);
+    _samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    _destinationNode->render(sourceProvider(), input, output, _quantum, _samplingInfo);
+}
+
+void AudioDevice_External::render(int frames, const float * const * inputs, float * const * outputs)
+{
+    const ProfileClock::time_point callbackStart = beginCallback();
+    const int outChannels = static_cast<int>(_outConfig.desired_channels);
+    const int inChannels = inputs ? static_cast<int>(_inConfig.desired_channels) : 0;
+
+    if (!_running || !_destinationNode || frames <= 0)
+    {
+        for (int c = 0; c < outChannels; ++c)
+            std::memset(outputs[c], 0, sizeof(float) * std::max(0, frames));
+        return;
+    }
+
+    if (!_quantum)
+    {
+        // the destination node, and so the quantum, is known once the context is made
+        _quantum = _destinationNode->renderQuantumSize();
+        const float rate = _samplingInfo.sampling_rate;
+        _outputWrap.reset(new AudioBus(outChannels, _quantum, false));
+        _renderBus.reset(new AudioBus(outChannels, _quantum, true));
+        _renderBus->setSampleRate(rate);
+        if (_inConfig.desired_channels)
+        {
+            _inputWrap.reset(new AudioBus(_inConfig.desired_channels, _quantum, false));
+            _inputBus.reset(new AudioBus(_inConfig.desired_channels, _quantum, true));
+            _inputHeld.reset(new AudioBus(_inConfig.desired_channels, _quantum, true));
+            _inputBus->setSampleRate(rate);
+        }
+    }
+
+    // Whole quanta, with nothing held back: the graph renders into the host's channels,
+    // and reads the host's input where it lies
+    if (_remainder == 0 && _inputHeldFrames == 0 && frames % _quantum == 0)
+    {
+        for (int offset = 0; offset < frames; offset += _quantum)
+        {
+            for (int c = 0; c < outChannels; ++c)
+                _outputWrap->setChannelMemory(c, outputs[c] + offset, _quantum);
+            _outputWrap->setSampleRate(_samplingInfo.sampling_rate);
+
+            AudioBus * input = _inputBus.get();
+            if (input && inChannels)
+            {
+                // the graph only reads its input
+                for (int c = 0; c < inChannels; ++c)
+                    _inputWrap->setChannelMemory(c, const_cast<float *>(inputs[c]) + offset, _quantum);
+                _inputWrap->setSampleRate(_samplingInfo.sampling_rate);
+                input = _inputWrap.get();
+            }
+            else if (input)
+                input->zero();
+
+            renderQuantum(input, _outputWrap.get());
+        }
+
+        endCallback(callbackStart, frames, _samplingInfo.sampling_rate);
+        return;
+    }
+
+    // Otherwise quanta are rendered as the host reaches their first frame. The input of
+    // each is the quantum of host input that preceded it, which has all arrived by then.
+    int offset = 0;
+    while (offset < frames)
+    {
+        if (_remainder == 0)
+        {
+            if (_inputBus)
+            {
+                for (int c = 0; c < static_cast<int>(_inConfig.desired_channels); ++c)
+                {
+                    float * held = _inputHeld->channel(c)->mutableData();
+                    std::fill(held + _inputHeldFrames, held + _quantum, 0.f);
+                    std::memcpy(_inputBus->channel(c)->mutableData(), held, sizeof(float) * _quantum);
+                }
+                _inputHeldFrames = 0;
+            }
+
+            renderQuantum(_inputBus.get(), _renderBus.get());
+            _remainder = _quantum;
+        }
+
+        const int n = std::min(_remainder, frames - offset);
+        const int start = _quantum - _remainder;
+        for (int c = 0; c < outChannels; ++c)
+            std::memcpy(outputs[c] + offset, _renderBus->channel(c)->data() + start, sizeof(float) * n);
+
+        if (_inputHeld)
+        {
+            for (int c = 0; c < static_cast<int>(_inConfig.desired_channels); ++c)
+            {
+                float * held = _inputHeld->channel(c)->mutableData() + _inputHeldFrames;
+                if (c < inChannels)
+                    std::memcpy(held, inputs[c] + offset, sizeof(float) * n);
+                else
+                    std::memset(held, 0, sizeof(float) * n);
+            }
+            _inputHeldFrames += n;
+        }
+
+        _remainder -= n;
+        offset += n;
+    }
+
+    endCallback(callbackStart, frames, _samplingInfo.sampling_rate);
+}
+
+}  // lab
@@ -0,0 +1,185 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioMemoryPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+namespace lab
+{
+
+namespace
+{
+    const size_t MinPooledSize = AudioMemoryPool::Alignment;
+    const int SizeClassCount = 15;  // MinPooledSize << 14 == MaxPooledSize
+
+    struct FreeBlock
+    {
+        FreeBlock * next;
+    };
+
+    struct SizeClass
+    {
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        FreeBlock * head = nullptr;
+
+        void acquire()
+        {
+            while (lock.test_and_set(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+
+        void release() { lock.clear(std::memory_order_release); }
+    };
+
+    struct Arena
+    {
+        std::mutex creationMutex;
+        std::atomic<char *> begin{nullptr};
+        size_t capacity = AudioMemoryPool::DefaultCapacity;
+        std::atomic<size_t> used{0};
+        SizeClass classes[SizeClassCount];
+    };
+
+    // The arena outlives every static AudioBus, so it is intentionally never destroyed
+    Arena & arena()
+    {
+        static Arena * a = new Arena();
+        return *a;
+    }
+
+    int sizeClassFor(size_t size)
+    {
+        int c = 0;
+        size_t blockSize = MinPooledSize;
+        while (blockSize < size)
+        {
+            blockSize <<= 1;
+            ++c;
+        }
+        return c;
+    }
+
+    char * arenaMemory(Arena & a)
+    {
+        char * begin = a.begin.load(std::memory_order_acquire);
+        if (begin)
+            return begin;
+
+        std::lock_guard<std::mutex> lock(a.creationMutex);
+        begin = a.begin.load(std::memory_order_acquire);
+        if (!begin)
+        {
+            // calloc'd so that blocks are zero the first time they are handed out;
+            // most systems commit the pages lazily
+            void * raw = calloc(a.capacity + AudioMemoryPool::Alignment, 1);
+            if (!raw)
+                return nullptr;
+            begin = (char *) ((uintptr_t(raw) + AudioMemoryPool::Alignment - 1) & ~uintptr_t(AudioMemoryPool::Alignment - 1));
+            a.begin.store(begin, std::memory_order_release);
+        }
+        return begin;
+    }
+
+    void * systemAllocate(size_t size)
+    {
+        // the original pointer is stashed in front of the aligned block
+        void * raw = calloc(size + AudioMemoryPool::Alignment + sizeof(void *), 1);
+        if (!raw)
+            return nullptr;
+        uintptr_t aligned = (uintptr_t(raw) + sizeof(void *) + AudioMemoryPool::Alignment - 1) & ~uintptr_t(AudioMemoryPool::Alignment - 1);
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    void systemFree(void * memory)
+    {
+        free(reinterpret_cast<void **>(memory)[-1]);
+    }
+}
+
+bool AudioMemoryPool::reserve(size_t capacityInBytes)
+{
+    Arena & a = arena();
+    std::lock_guard<std::mutex> lock(a.creationMutex);
+    if (a.begin.load(std::memory_order_acquire))
+        return false;
+
+    a.capacity = capacityInBytes;
+    return true;
+}
+
+size_t AudioMemoryPool::capacity()
+{
+    return arena().capacity;
+}
+
+size_t AudioMemoryPool::bytesInUse()
+{
+    Arena & a = arena();
+    size_t used = a.used.load(std::memory_order_relaxed);
+    return used < a.capacity ? used : a.capacity;
+}
+
+void * AudioMemoryPool::allocate(size_t sizeInBytes)
+{
+    if (sizeInBytes > MaxPooledSize)
+        return systemAllocate(sizeInBytes);
+
+    Arena & a = arena();
+    char * begin = arenaMemory(a);
+    if (!begin)
+        return systemAllocate(sizeInBytes);
+
+    const int c = sizeClassFor(sizeInBytes);
+    const size_t blockSize = MinPooledSize << c;
+
+    SizeClass & sc = a.classes[c];
+    sc.acquire();
+    FreeBlock * block = sc.head;
+    if (block)
+        sc.head = block->next;
+    sc.release();
+
+    if (block)
+    {
+        memset(block, 0, blockSize);
+        return block;
+    }
+
+    size_t offset = a.used.fetch_add(blockSize, std::memory_order_relaxed);
+    if (offset + blockSize <= a.capacity)
+        return begin + offset;
+
+    // the arena is exhausted
+    return systemAllocate(sizeInBytes);
+}
+
+void AudioMemoryPool::deallocate(void * memory, size_t sizeInBytes)
+{
+    if (!memory)
+        return;
+
+    Arena & a = arena();
+    char * begin = a.begin.load(std::memory_order_acquire);
+    char * p = static_cast<char *>(memory);
+    if (!begin || p < begin || p >= begin + a.capacity)
+    {
+        systemFree(memory);
+        return;
+    }
+
+    SizeClass & sc = a.classes[sizeClassFor(sizeInBytes)];
+    FreeBlock * block = reinterpret_cast<FreeBlock *>(memory);
+    sc.acquire();
+    block->next = sc.head;
+    sc.head = block;
+    sc.release();
+}
+
+}  // lab
@@ -10,10 +10,22 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/core/RenderTrace.h"
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 
+#include <algorithm>
+#include <cfenv>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
 using namespace std;
 
 #define LOG_PLAYBACK_STATE_TRANSITION(node_name, old_state, new_state) printf("Scheduler: %s ⮕ %s (%s)\n", (schedulingStateName(old_state)), (schedulingStateName(new_state)), (node_name))
@@ -21,9 +33,78 @@ using namespace std;
 namespace lab
 {
 
+// The gains of a node's start and stop envelopes. A table is made the first time a
+// length and curve is asked for, and kept for the life of the process, shared by every
+// node using it, so the audio thread can use one without counting references, and
+// setting an envelope never frees one out from under it.
+struct DeclickTable
+{
+    int frames;
+    DeclickCurve curve;
+    std::vector<float> fadeIn;  // gain of each frame from the start
+    std::vector<float> fadeOut; // gain of each frame leading up to the stop
+};
+
+static const DeclickTable * declickTable(int frames, DeclickCurve curve)
+{
+    static std::mutex tablesMutex;
+    static std::map<std::pair<int, int>, std::unique_ptr<DeclickTable>> tables;
+
+    std::lock_guard<std::mutex> lock(tablesMutex);
+    auto & table = tables[std::make_pair(frames, static_cast<int>(curve))];
+    if (table)
+        return table.get();
+
+    table.reset(new DeclickTable {frames, curve, std::vector<float>(frames), std::vector<float>(frames)});
+    for (int i = 0; i < frames; ++i)
+    {
+        const double in = double(i) / double(frames);
+        const double out = double(frames - i) / double(frames);
+        if (curve == DECLICK_EQUAL_POWER)
+        {
+            table->fadeIn[i] = static_cast<float>(std::sin(in * LAB_HALF_PI));
+            table->fadeOut[i] = static_cast<float>(std::sin(out * LAB_HALF_PI));
+        }
+        else
+        {
+            table->fadeIn[i] = static_cast<float>(in);
+            table->fadeOut[i] = static_cast<float>(out);
+        }
+    }
+    return table.get();
+}
+
 AudioNode::Internal::Internal(AudioContext & ac)
 :  _scheduler(ac.sampleRate())
-{}
+,  renderQuantumSize(ac.renderQuantumSize())
+,  declick(declickTable(64, DECLICK_LINEAR))
+,  declickPosition(std::numeric_limits<int>::max())
+{
+    std::weak_ptr<AudioContext::AudioContextInterface> context = ac.audioContextInterface();
+    _scheduler._onScheduled = [context]()
+    {
+        if (auto c = context.lock())
+            c->wake();
+    };
+}
+
+void AudioNode::setDeclickEnvelope(int frames, DeclickCurve curve)
+{
+    frames = std::max(0, std::min(frames, static_cast<int>(MaxProcessingSizeInFrames)));
+    if (curve != DECLICK_EQUAL_POWER)
+        curve = DECLICK_LINEAR;
+    _self->declick.store(declickTable(frames, curve), std::memory_order_release);
+}
+
+int AudioNode::declickFrames() const
+{
+    return _self->declick.load(std::memory_order_acquire)->frames;
+}
+
+DeclickCurve AudioNode::declickCurve() const
+{
+    return _self->declick.load(std::memory_order_acquire)->curve;
+}
 
 // static
 void AudioNode::_printGraph(const AudioNode * root, std::function<void(const char *)> prnln, int indent)
@@ -102,9 +183,6 @@ const char * schedulingStateName(SchedulingState s)
 }
 
 
-const int start_envelope = 64;
-const int end_envelope = 64;
-
 AudioNodeScheduler::AudioNodeScheduler(float sampleRate)
     : _epoch(0)
     , _startWhen(std::numeric_limits<uint64_t>::max())
@@ -113,8 +191,9 @@ AudioNodeScheduler::AudioNodeScheduler(float sampleRate)
 {
 }
 
-bool AudioNodeScheduler::update(ContextRenderLock & r, int epoch_length, const char* node_name)
+bool AudioNodeScheduler::update(ContextRenderLock & r, int epoch_length, AudioNode & node)
 {
+    const char * node_name = node.name();
     assert(node_name != nullptr);
     uint64_t proposed_epoch = r.context()->currentSampleFrame();
     if (_epoch >= proposed_epoch)
@@ -192,7 +271,7 @@ bool AudioNodeScheduler::update(ContextRenderLock & r, int epoch_length, const c
                 LOG_PLAYBACK_STATE_TRANSITION(node_name, _playbackState, SchedulingState::UNSCHEDULED);
                 _playbackState = SchedulingState::UNSCHEDULED;
                 if (_onEnded)
-                    r.context()->enqueueEvent(_onEnded);
+                    r.context()->enqueueEvent(node, AudioEventKind::Ended);
             }
             break;
 
@@ -234,6 +313,8 @@ void AudioNodeScheduler::start(double when)
 
     _startWhen = _epoch + static_cast<uint64_t>(when * _sampleRate);
     _playbackState = SchedulingState::SCHEDULED;
+    if (_onScheduled)
+        _onScheduled();
 }
 
 void AudioNodeScheduler::stop(double when)
@@ -265,6 +346,29 @@ void AudioNodeScheduler::stop(double when)
     _stopWhen = _epoch + static_cast<uint64_t>(when * _sampleRate);
 }
 
+void AudioNodeScheduler::startAtFrame(uint64_t frame)
+{
+    if (_onStart)
+        _onStart(frame > _epoch ? (frame - _epoch) / static_cast<double>(_sampleRate) : 0.0);
+
+    if (_playbackState == SchedulingState::SCHEDULED || _playbackState == SchedulingState::PLAYING)
+        return;
+
+    _stopWhen = std::numeric_limits<uint64_t>::max();
+    _startWhen = frame;
+    _playbackState = SchedulingState::SCHEDULED;
+    if (_onScheduled)
+        _onScheduled();
+}
+
+void AudioNodeScheduler::stopAtFrame(uint64_t frame)
+{
+    if (_playbackState >= SchedulingState::STOPPING)
+        return;
+
+    _stopWhen = frame;
+}
+
 void AudioNodeScheduler::reset()
 {
     _startWhen = std::numeric_limits<uint64_t>::max();
@@ -273,14 +377,79 @@ void AudioNodeScheduler::reset()
         _playbackState = SchedulingState::RESETTING;
 }
 
-void AudioNodeScheduler::finish(ContextRenderLock & r)
+void AudioNodeScheduler::finish(ContextRenderLock & r, AudioNode & node)
 {
     if (_playbackState < SchedulingState::PLAYING)
         _playbackState = SchedulingState::FINISHING;
     else if (_playbackState >= SchedulingState::PLAYING && _playbackState < SchedulingState::FINISHED)
         _playbackState = SchedulingState::FINISHING;
 
-    r.context()->enqueueEvent(_onEnded);
+    if (_onEnded)
+        r.context()->enqueueEvent(node, AudioEventKind::Ended);
+}
+
+namespace
+{
+    struct NameTable
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, NameId> ids;
+        std::deque<std::string> names;  // by id less one; a deque so that names don't move
+    };
+
+    NameTable & nameTable()
+    {
+        static NameTable table;
+        return table;
+    }
+}
+
+NameId internName(char const * const name)
+{
+    if (!name)
+        return NameId::Invalid;
+
+    NameTable & table = nameTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto it = table.ids.find(name);
+    if (it != table.ids.end())
+        return it->second;
+
+    table.names.emplace_back(name);
+    const NameId id = static_cast<NameId>(table.names.size());
+    table.ids.emplace(table.names.back(), id);
+    return id;
+}
+
+NameId findName(char const * const name)
+{
+    if (!name)
+        return NameId::Invalid;
+
+    NameTable & table = nameTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto it = table.ids.find(name);
+    return it != table.ids.end() ? it->second : NameId::Invalid;
+}
+
+char const * internedName(NameId id)
+{
+    NameTable & table = nameTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    const size_t index = static_cast<size_t>(id);
+    return index && index <= table.names.size() ? table.names[index - 1].c_str() : nullptr;
+}
+
+AudioParamDescriptor const * const AudioNodeDescriptor::param(NameId id) const
+{
+    char const * const name = internedName(id);
+    return name ? param(name) : nullptr;
+}
+
+AudioSettingDescriptor const * const AudioNodeDescriptor::setting(NameId id) const
+{
+    char const * const name = internedName(id);
+    return name ? setting(name) : nullptr;
 }
 
 AudioParamDescriptor const * const AudioNodeDescriptor::param(char const * const p) const
@@ -317,23 +486,101 @@ AudioSettingDescriptor const * const AudioNodeDescriptor::setting(char const * c
     return nullptr;
 }
 
+namespace
+{
+    template <typename Descriptor>
+    size_t descriptorCount(Descriptor const * d)
+    {
+        size_t count = 0;
+        while (d && d[count].name)
+            ++count;
+        return count;
+    }
+
+    // A node's parameters and settings, constructed side by side in one allocation rather
+    // than one apiece, so that building a node allocates less and the render thread finds
+    // them together in memory. Each is shared through the aliasing constructor, and the
+    // storage is released with the last of them.
+    class ParamStorage
+    {
+    public:
+        ParamStorage(AudioParamDescriptor const * params, size_t paramCount,
+                     AudioSettingDescriptor const * settings, size_t settingCount)
+            : _settingOffset(aligned(paramCount * sizeof(AudioParam), alignof(AudioSetting)))
+            , _memory(static_cast<unsigned char *>(::operator new(_settingOffset + settingCount * sizeof(AudioSetting))))
+        {
+            for (; _paramCount < paramCount; ++_paramCount)
+                new (param(_paramCount)) AudioParam(params + _paramCount);
+            try
+            {
+                for (; _settingCount < settingCount; ++_settingCount)
+                    new (setting(_settingCount)) AudioSetting(settings + _settingCount);
+            }
+            catch (...)
+            {
+                destroy();
+                throw;
+            }
+        }
+
+        ~ParamStorage() { destroy(); }
+
+        ParamStorage(const ParamStorage &) = delete;
+        ParamStorage & operator=(const ParamStorage &) = delete;
+
+        AudioParam * param(size_t i) { return reinterpret_cast<AudioParam *>(_memory) + i; }
+        AudioSetting * setting(size_t i) { return reinterpret_cast<AudioSetting *>(_memory + _settingOffset) + i; }
+
+    private:
+        static size_t aligned(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+        void destroy()
+        {
+            while (_settingCount)
+                setting(--_settingCount)->~AudioSetting();
+            while (_paramCount)
+                param(--_paramCount)->~AudioParam();
+            ::operator delete(_memory);
+            _memory = nullptr;
+        }
+
+        size_t _settingOffset;
+        unsigned char * _memory;
+        size_t _paramCount = 0;
+        size_t _settingCount = 0;
+    };
+}
+
 AudioNode::AudioNode(AudioContext & ac, AudioNodeDescriptor const & desc)
-    : _self(new Internal(ac))
+    : _self(std::make_shared<Internal>(ac))
 {
-    if (desc.params) {
-        AudioParamDescriptor const * i = desc.params;
-        while (i->name)
+    MemoryOwner * scoped = MemoryAccounting::current();
+    if (scoped && scoped->category() == MemoryCategory::Node && scoped->claim())
+        _self->memory = scoped->shared_from_this();
+    else
+        _self->memory = MemoryAccounting::createOwner(MemoryCategory::Node, {});
+    MemoryOwnerScope memoryScope(_self->memory);
+
+    const size_t paramCount = descriptorCount(desc.params);
+    const size_t settingCount = descriptorCount(desc.settings);
+    if (paramCount || settingCount)
+    {
+        std::shared_ptr<ParamStorage> storage = std::make_shared<ParamStorage>(desc.params, paramCount, desc.settings, settingCount);
+
+        _self->_params.reserve(paramCount);
+        _self->_paramIds.reserve(paramCount);
+        for (size_t i = 0; i < paramCount; ++i)
         {
-            _self->_params.push_back(std::make_shared<AudioParam>(i));
-            ++i;
+            _self->_params.push_back(std::shared_ptr<AudioParam>(storage, storage->param(i)));
+            _self->_paramIds.push_back(internName(desc.params[i].name));
         }
-    }
-    if (desc.settings) {
-        AudioSettingDescriptor const * i = desc.settings;
-        while (i->name)
+
+        _self->_settings.reserve(settingCount);
+        _self->_settingIds.reserve(settingCount);
+        for (size_t i = 0; i < settingCount; ++i)
         {
-            _self->_settings.push_back(std::make_shared<AudioSetting>(i));
-            ++i;
+            _self->_settings.push_back(std::shared_ptr<AudioSetting>(storage, storage->setting(i)));
+            _self->_settingIds.push_back(internName(desc.settings[i].name));
         }
     }
     
@@ -395,9 +642,16 @@ std::shared_ptr<AudioNodeInput> AudioNode::input(int i)
 
 std::shared_ptr<AudioNodeInput> AudioNode::input(char const* const str)
 {
+    return input(findName(str));
+}
+
+std::shared_ptr<AudioNodeInput> AudioNode::input(NameId id)
+{
+    if (id == NameId::Invalid)
+        return {};
     for (auto & i : _self->m_inputs)
     {
-        if (i->name() == str)
+        if (i->nameId() == id)
             return i;
     }
     return {};
@@ -413,9 +667,16 @@ std::shared_ptr<AudioNodeOutput> AudioNode::output(int i)
 
 std::shared_ptr<AudioNodeOutput> AudioNode::output(char const* const str)
 {
+    return output(findName(str));
+}
+
+std::shared_ptr<AudioNodeOutput> AudioNode::output(NameId id)
+{
+    if (id == NameId::Invalid)
+        return {};
     for (auto & i : _self->m_outputs)
     {
-        if (i->name() == str)
+        if (i->nameId() == id)
             return i;
     }
     return {};
@@ -460,13 +721,70 @@ void AudioNode::setChannelCountMode(ContextGraphLock & g, ChannelCountMode mode)
     }
 }
 
+void AudioNode::setChannelInterpretation(ChannelInterpretation interpretation)
+{
+    if (_self->m_channelInterpretation != interpretation)
+    {
+        _self->m_channelInterpretation = interpretation;
+        for (auto & input : _self->m_inputs)
+            input->channelsChanged();
+    }
+}
+
+void AudioNode::setDecimation(int factor)
+{
+    if (factor < 1 || factor > MaxProcessingSizeInFrames || (factor & (factor - 1)))
+        throw std::invalid_argument("Decimation must be a power of two no greater than MaxProcessingSizeInFrames");
+    _self->decimation.store(factor, std::memory_order_relaxed);
+}
+
+namespace
+{
+    // While a node processes, the calling thread renders at the node's decimation, and once
+    // it has, the outputs of a decimated node hold their last frame for readers at higher rates
+    class DecimationScope
+    {
+    public:
+        DecimationScope(std::vector<std::shared_ptr<AudioNodeOutput>> & outputs, int decimation, int frames)
+            : m_outputs(outputs), m_decimation(decimation), m_frames(frames)
+        {
+            m_previous = AudioContext::setRenderDecimation(decimation);
+        }
+
+        ~DecimationScope()
+        {
+            for (auto & out : m_outputs)
+                if (m_decimation > 1 || out->decimation() > 1)
+                    out->holdLastFrame(m_frames, m_decimation);
+            AudioContext::setRenderDecimation(m_previous);
+        }
+
+    private:
+        std::vector<std::shared_ptr<AudioNodeOutput>> & m_outputs;
+        int m_decimation;
+        int m_frames;
+        int m_previous;
+    };
+}
+
 void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
 {
     auto ac = r.context();
     if (!ac)
         return;
 
-    bool diagnosing_silence = ac->diagnosing().get() == this;
+    // bufferSize is in frames at the rate of the caller, which renders at its own decimation.
+    // A decimated node renders a frame for each of its factor of frames, up to a frame a pull.
+    const int callerDecimation = AudioContext::renderDecimation();
+    int decimation = _self->decimation.load(std::memory_order_relaxed);
+    if (decimation != callerDecimation)
+    {
+        const int frames = bufferSize * callerDecimation;
+        decimation = std::min(decimation, frames);
+        bufferSize = frames / decimation;
+    }
+
+    const bool diagnosing_silence = ac->isDiagnosing(this);
 
     if (diagnosing_silence) {
         if (_self->_scheduler._playbackState < SchedulingState::FADE_IN ||
@@ -486,14 +804,58 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
     // if the scheduler's recorded epoch is the same as the context's, the node
     // shall bail out as it has been processed once already this epoch.
 
-    if (!_self->_scheduler.update(r, bufferSize, name())) {
+    if (!_self->_scheduler.update(r, bufferSize * decimation, *this)) {
         if (diagnosing_silence)
             ac->diagnosed_silence("Already processed");
         return;
     }
 
-    ProfileScope selfScope(_self->totalTime);
-    _self->graphTime.zero();
+    // the scheduler finds starts and stops among the context's frames, and a decimated node
+    // renders the whole of each of its frames that they fall within
+    if (decimation > 1)
+    {
+        AudioNodeScheduler & scheduler = _self->_scheduler;
+        const int end = (scheduler._renderOffset + scheduler._renderLength + decimation - 1) / decimation;
+        scheduler._renderOffset /= decimation;
+        scheduler._renderLength = end - scheduler._renderOffset;
+    }
+
+    DecimationScope decimationScope(_self->m_outputs, decimation, bufferSize);
+
+    const bool profiling = ac->profilingThisQuantum();
+    if (profiling)
+        _self->graphTime.zero();
+    ProfileSelfScope selfScope(_self->totalTime, _self->graphTime, _self->selfTime, profiling);
+
+    // what the node allocates as it processes, such as buses for a new channel count, is charged to it
+    MemoryOwnerScope memoryScope(_self->memory);
+    _self->memory->setLabel(name());
+
+    // a gain deferred during the previous quantum is stale
+    for (auto & out : _self->m_outputs)
+        out->clearDeferredGain();
+
+    // a node propagating silence goes dormant once its inputs have been silent for longer than
+    // its tail and latency, and is skipped without pulling its inputs, conforming channels, or
+    // enveloping. Its outputs stay silent, so everything downstream of it that propagates
+    // silence goes dormant in turn. It wakes when an input sounds again.
+    if (!isScheduledNode() && !_self->m_inputs.empty() && propagatesSilence(r))
+    {
+        if (upstreamIsSilent(r))
+        {
+            _self->silentFrames += bufferSize;
+            const double tail = tailTime(r) + latencyTime(r);
+            if (_self->silentFrames > tail * ac->sampleRate())
+            {
+                silenceOutputs(r);
+                if (diagnosing_silence)
+                    ac->diagnosed_silence("Dormant");
+                return;
+            }
+        }
+        else
+            _self->silentFrames = 0;
+    }
 
     if (isScheduledNode() && 
         (_self->_scheduler._playbackState < SchedulingState::FADE_IN ||
@@ -505,20 +867,29 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
         return;
     }
 
-
     // there may need to be silence at the beginning or end of the current quantum.
 
-    int start_zero_count = _self->_scheduler._renderOffset;
-    int final_zero_start = _self->_scheduler._renderOffset + _self->_scheduler._renderLength;
+    const int render_offset = _self->_scheduler._renderOffset;
+    const int render_length = _self->_scheduler._renderLength;
+    int start_zero_count = render_offset;
+    int final_zero_start = render_offset + render_length;
     int final_zero_count = bufferSize - final_zero_start;
 
+    if (isScheduledNode() && render_length <= 0)
+    {
+        silenceOutputs(r);
+        if (diagnosing_silence)
+            ac->diagnosed_silence("Inactive this quantum");
+        return;
+    }
+
     // if the input counts need to match the output counts,
     // do it here before pulling inputs
     conformChannelCounts();
 
     // get inputs in preparation for processing
     {
-        ProfileScope scope(_self->graphTime);
+        ProfileScope scope(_self->graphTime, profiling);
         pullInputs(r, bufferSize);
         scope.finalize();   // ensure the scope is not prematurely destructed
     }
@@ -527,7 +898,53 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
     for (auto& out : _self->m_outputs)
         out->updateRenderingState(r);
 
-    //  initialize the busses with start and final zeroes.
+    // a node that is wholly bypassed isn't processed at all
+    const float bypassTarget = _self->bypassed.load(std::memory_order_relaxed) ? 1.f : 0.f;
+    if (bypassTarget == 1.f && _self->bypassMix >= 1.f)
+    {
+        if (_self->m_inputs.empty())
+        {
+            silenceOutputs(r);
+            return;
+        }
+        for (int i = 0; i < numberOfOutputs(); ++i)
+        {
+            AudioBus * out = _self->m_outputs[i]->bus(r);
+            if (i == 0)
+                out->copyFrom(*_self->m_inputs[0]->bus(r));
+            else
+                out->zero();
+        }
+        unsilenceOutputs(r);
+        selfScope.finalize();
+        return;
+    }
+
+    // do the signal processing, of only the active part of the quantum if the node can;
+    // the render watchdog reports the node processing if the quantum stalls
+
+    ac->m_renderingNode.store(name(), std::memory_order_relaxed);
+#ifdef FE_UNDERFLOW
+    // the underflow flag is raised for results flushed to zero as for denormal ones, so it
+    // finds the nodes producing denormals whether or not the thread flushes them
+    const bool detectDenormals = ac->denormalDetection();
+    if (detectDenormals)
+        std::feclearexcept(FE_UNDERFLOW);
+#endif
+    {
+        TraceScope trace(name(), "node");
+        processRange(r, bufferSize, render_offset, render_length);
+    }
+#ifdef FE_UNDERFLOW
+    if (detectDenormals && std::fetestexcept(FE_UNDERFLOW))
+    {
+        _self->denormalQuanta.fetch_add(1, std::memory_order_relaxed);
+        ac->m_denormalQuanta.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+    ac->m_renderingNode.store(nullptr, std::memory_order_relaxed);
+
+    // silence the busses before the start and after the end, whether or not the node rendered there
     if (start_zero_count)
     {
         for (auto & out : _self->m_outputs)
@@ -542,74 +959,111 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
                 memset(out->bus(r)->channel(i)->mutableData() + final_zero_start, 0, sizeof(float) * final_zero_count);
     }
 
-    // do the signal processing
-
-    process(r, bufferSize);
+    // clean pops resulting from starting or stopping. The envelope's gains are applied
+    // to every channel of every output at once, straight from the node's table.
 
-    // clean pops resulting from starting or stopping
+    const DeclickTable * declick = _self->declick.load(std::memory_order_acquire);
+    const int envelope = declick->frames;
 
-    #define OOS(x) (float(x) / float(steps))
     if (start_zero_count > 0 || _self->_scheduler._playbackState == SchedulingState::FADE_IN)
+        _self->declickPosition = 0;
+
+    // fade in from the start, continuing into following quanta if the fade is longer
+    // than the rest of this one, but not past a stop
+    if (_self->declickPosition < envelope)
     {
-        int steps = start_envelope;
-        int damp_start = start_zero_count;
-        int damp_end = start_zero_count + steps;
-        if (damp_end > bufferSize)
+        const int damp_start = _self->declickPosition == 0 ? start_zero_count : 0;
+        const int steps = std::min(envelope - _self->declickPosition, final_zero_start - damp_start);
+        if (steps > 0)
         {
-            damp_end = bufferSize;
-            steps = bufferSize - start_zero_count;
-        }
-
-        // damp out the first samples
-        if (damp_end > 0)
+            const float * gains = declick->fadeIn.data() + _self->declickPosition;
             for (auto & out : _self->m_outputs)
                 for (int i = 0; i < out->bus(r)->numberOfChannels(); ++i)
                 {
-                    float* data = out->bus(r)->channel(i)->mutableData();
-                    for (int j = damp_start; j < damp_end; ++j)
-                        data[j] *= OOS(j - damp_start);
+                    float * data = out->bus(r)->channel(i)->mutableData() + damp_start;
+                    VectorMath::vmul(data, 1, gains, 1, data, 1, steps);
                 }
+        }
+        _self->declickPosition = steps > 0 ? _self->declickPosition + steps : envelope;
     }
 
-    if (final_zero_count > 0 || _self->_scheduler._playbackState == SchedulingState::STOPPING)
+    // fade out up to the stop
+    if (envelope > 0 &&
+        (final_zero_count > 0 || _self->_scheduler._playbackState == SchedulingState::STOPPING))
     {
-        int steps = end_envelope;
-        int damp_end, damp_start;
-        if (!final_zero_count)
-        {
-            damp_end = bufferSize - final_zero_count;
-            damp_start = damp_end - steps;
-        }
-        else
-        {
-            damp_end = bufferSize - final_zero_count;
-            damp_start = damp_end - steps;
-        }
-
+        const int damp_end = final_zero_start;
+        int damp_start = damp_end - envelope;
+        int steps = envelope;
+        const float * gains = declick->fadeOut.data();
+
+        // a stop too close to the start of the quantum to fit the whole fade gets a
+        // shortened one, taken from the table at a stride
+        float shortened[MaxProcessingSizeInFrames];
         if (damp_start < 0)
         {
             damp_start = 0;
             steps = damp_end;
+            for (int j = 0; j < steps; ++j)
+                shortened[j] = gains[static_cast<int64_t>(j) * envelope / steps];
+            gains = shortened;
         }
 
-        // damp out the last samples
         if (steps > 0)
         {
-            //printf("out: %d %d\n", damp_start, damp_end);
-            for (auto& out : _self->m_outputs)
+            for (auto & out : _self->m_outputs)
                 for (int i = 0; i < out->numberOfChannels(); ++i)
                 {
-                    float* data = out->bus(r)->channel(i)->mutableData();
-                    for (int j = damp_start; j < damp_end; ++j)
-                        data[j] *= OOS(damp_end - j);
+                    float * data = out->bus(r)->channel(i)->mutableData() + damp_start;
+                    VectorMath::vmul(data, 1, gains, 1, data, 1, steps);
                 }
         }
     }
 
+    if (bypassTarget != 0.f || _self->bypassMix != 0.f)
+        blendBypass(r, bufferSize, bypassTarget);
+
     unsilenceOutputs(r);
     selfScope.finalize(); // ensure profile is not prematurely destructed
 }
 
+void AudioNode::blendBypass(ContextRenderLock & r, int bufferSize, float target)
+{
+    const float step = 1.f / std::max(1.f, 0.01f * r.context()->sampleRate());
+    const AudioBus * in = _self->m_inputs.empty() ? nullptr : _self->m_inputs[0]->bus(r);
+    const int inChannels = in ? in->numberOfChannels() : 0;
+
+    float mix = _self->bypassMix;
+    for (int k = 0; k < numberOfOutputs(); ++k)
+    {
+        AudioBus * out = _self->m_outputs[k]->bus(r);
+        for (int c = 0; c < out->numberOfChannels(); ++c)
+        {
+            // a mono input is passed to every channel of the output
+            const float * dry = nullptr;
+            if (k == 0 && inChannels)
+                dry = c < inChannels ? in->channel(c)->data() : inChannels == 1 ? in->channel(0)->data() : nullptr;
+
+            float * data = out->channel(c)->mutableData();
+            mix = _self->bypassMix;
+            for (int i = 0; i < bufferSize; ++i)
+            {
+                mix = target > mix ? std::min(target, mix + step) : std::max(target, mix - step);
+                data[i] += ((dry ? dry[i] : 0.f) - data[i]) * mix;
+            }
+        }
+    }
+    _self->bypassMix = mix;
+}
+
+bool AudioNode::isProcessedForCurrentQuantum(ContextRenderLock & r) const
+{
+    auto ac = r.context();
+    if (!ac)
+        return false;
+
+    return _self->_scheduler._epoch >= ac->currentSampleFrame();
+}
+
 void AudioNode::conformChannelCounts()
 {
     return;
@@ -656,6 +1110,10 @@ void AudioNode::checkNumberOfChannelsForInput(ContextRenderLock & r, AudioNodeIn
 
 bool AudioNode::propagatesSilence(ContextRenderLock& r) const
 {
+    // nodes that aren't sources are silent when their inputs are, once their tail has passed
+    if (!isScheduledNode())
+        return true;
+
     return _self->_scheduler._playbackState < SchedulingState::FADE_IN ||
            _self->_scheduler._playbackState == SchedulingState::FINISHED;
 }
@@ -683,6 +1141,26 @@ bool AudioNode::inputsAreSilent(ContextRenderLock & r)
     return true;
 }
 
+bool AudioNode::upstreamIsSilent(ContextRenderLock & r)
+{
+    for (auto & in : _self->m_inputs)
+    {
+        in->updateRenderingState(r);
+        const int connections = in->numberOfRenderingConnections(r);
+        for (int i = 0; i < connections; ++i)
+        {
+            auto output = in->renderingOutput(r, i);
+            if (!output)
+                continue;
+
+            // an output that hasn't rendered yet holds the previous quantum
+            if (!output->sourceNode()->isProcessedForCurrentQuantum(r) || !output->isSilent())
+                return false;
+        }
+    }
+    return true;
+}
+
 void AudioNode::silenceOutputs(ContextRenderLock & r)
 {
     for (auto out : _self->m_outputs)
@@ -695,29 +1173,52 @@ void AudioNode::unsilenceOutputs(ContextRenderLock & r)
 {
     for (auto out : _self->m_outputs)
     {
-        out->bus(r)->clearSilentFlag();
+        // a deferred gain is not silent once it is resolved, and must not be resolved here
+        if (!out->hasDeferredGain())
+            out->bus(r)->clearSilentFlag();
     }
 }
 
+// A node has a handful of params and settings, so their ids are scanned; ids are
+// integers, and a name that was never interned is rejected before the scan.
+
 std::shared_ptr<AudioParam> AudioNode::param(char const * const str)
 {
-    for (auto & p : _self->_params)
-    {
-        if (!strcmp(str, p->name().c_str()))
-            return p;
-    }
-    return {};
+    return param(findName(str));
+}
+
+std::shared_ptr<AudioParam> AudioNode::param(NameId id)
+{
+    const int index = param_index(id);
+    return index >= 0 ? _self->_params[index] : nullptr;
 }
 
 int AudioNode::param_index(char const * const str)
 {
-    int count = (int) _self->_params.size();
+    return param_index(findName(str));
+}
+
+int AudioNode::param_index(NameId id) const
+{
+    if (id == NameId::Invalid)
+        return -1;
+    const std::vector<NameId> & ids = _self->_paramIds;
+    auto it = std::find(ids.begin(), ids.end(), id);
+    return it != ids.end() ? static_cast<int>(it - ids.begin()) : -1;
+}
+
+int AudioNode::setParamValues(ParamValue const * values, int count)
+{
+    int set = 0;
     for (int i = 0; i < count; ++i)
     {
-        if (!strcmp(str, _self->_params[i]->name().c_str()))
-            return i;
+        const int index = param_index(values[i].id);
+        if (index < 0)
+            continue;
+        _self->_params[index]->setValue(values[i].value);
+        ++set;
     }
-    return -1;
+    return set;
 }
 
 std::shared_ptr<AudioParam> AudioNode::param(int index)
@@ -730,23 +1231,27 @@ std::shared_ptr<AudioParam> AudioNode::param(int index)
 
 std::shared_ptr<AudioSetting> AudioNode::setting(char const * const str)
 {
-    for (auto & p : _self->_settings)
-    {
-        if (!strcmp(str, p->name().c_str()))
-            return p;
-    }
-    return {};
+    return setting(findName(str));
+}
+
+std::shared_ptr<AudioSetting> AudioNode::setting(NameId id)
+{
+    const int index = setting_index(id);
+    return index >= 0 ? _self->_settings[index] : nullptr;
 }
 
 int AudioNode::setting_index(char const * const str)
 {
-    int count = (int) _self->_settings.size();
-    for (int i = 0; i < count; ++i)
-    {
-        if (!strcmp(str, _self->_settings[i]->name().c_str()))
-            return i;
-    }
-    return -1;
+    return setting_index(findName(str));
+}
+
+int AudioNode::setting_index(NameId id) const
+{
+    if (id == NameId::Invalid)
+        return -1;
+    const std::vector<NameId> & ids = _self->_settingIds;
+    auto it = std::find(ids.begin(), ids.end(), id);
+    return it != ids.end() ? static_cast<int>(it - ids.begin()) : -1;
 }
 
 std::shared_ptr<AudioSetting> AudioNode::setting(int index)
@@ -12,6 +12,8 @@
 #include "LabSound/extended/AudioContextLock.h"
 
 #include "internal/Assertions.h"
+#include "internal/CompensationDelay.h"
+#include "internal/MixingMatrix.h"
 
 #include <algorithm>
 #include <mutex>
@@ -21,12 +23,25 @@ using namespace std;
 namespace lab
 {
 
+namespace
+{
+    // the registered layout a bus mixes with, as AudioBus finds it
+    int mixingLayout(const AudioBus & bus)
+    {
+        const int layout = bus.layout();
+        if (layout != AudioBus::LayoutCanonical && MixingMatrix::layoutChannels(layout) == bus.numberOfChannels())
+            return layout;
+        return MixingMatrix::canonicalLayout(bus.numberOfChannels());
+    }
+}
+
 AudioNodeInput::AudioNodeInput(AudioNode * node, int processingSizeInFrames)
     : AudioSummingJunction()
     , m_destinationNode(node)
+    , m_processingSizeInFrames(processingSizeInFrames > 0 ? processingSizeInFrames : node->renderQuantumSize())
 {
     // Set to mono by default.
-    m_internalSummingBus = std::unique_ptr<AudioBus>(new AudioBus(Channels::Mono, processingSizeInFrames));
+    m_internalSummingBus = std::unique_ptr<AudioBus>(new AudioBus(Channels::Mono, m_processingSizeInFrames));
 }
 
 AudioNodeInput::~AudioNodeInput()
@@ -77,16 +92,23 @@ void AudioNodeInput::disconnectAll(ContextGraphLock & g, std::shared_ptr<AudioNo
 
 void AudioNodeInput::updateInternalBus(ContextRenderLock & r)
 {
-    int numberOfInputChannels = numberOfChannels(r);
+    if (!mixPlanIsCurrent())
+        compileMixPlan(r);
 
-    if (numberOfInputChannels == m_internalSummingBus->numberOfChannels())
+    if (m_mixChannels == m_internalSummingBus->numberOfChannels())
         return;
 
-    m_internalSummingBus = std::unique_ptr<AudioBus>(new AudioBus(numberOfInputChannels, AudioNode::ProcessingSizeInFrames));
+    m_internalSummingBus = std::unique_ptr<AudioBus>(new AudioBus(m_mixChannels, m_processingSizeInFrames));
+
+    // the steps mix to the summing bus's channels
+    compileMixPlan(r);
 }
 
 int AudioNodeInput::numberOfChannels(ContextRenderLock & r) const
 {
+    if (mixPlanIsCurrent())
+        return m_mixChannels;
+
     ChannelCountMode mode = destinationNode()->channelCountMode();
 
     if (mode == ChannelCountMode::Explicit)
@@ -117,16 +139,99 @@ int AudioNodeInput::numberOfChannels(ContextRenderLock & r) const
     return maxChannels;
 }
 
+bool AudioNodeInput::mixPlanIsCurrent() const
+{
+    return !m_mixPlanDirty && !m_renderingStateNeedUpdating && m_mixPlanVersion == m_renderingVersion;
+}
+
+void AudioNodeInput::compileMixPlan(ContextRenderLock & r)
+{
+    m_mixPlanDirty = false;
+    m_mixPlanVersion = m_renderingVersion;
+    m_mixPlan.clear();
+
+    AudioNode * node = destinationNode();
+    const ChannelCountMode mode = node->channelCountMode();
+    const ChannelInterpretation interpretation = node->channelInterpretation();
+
+    int channels = 1;
+    for (auto & o : m_renderingOutputs)
+    {
+        auto output = o.lock();
+        if (!output)
+            continue;
+
+        MixStep step;
+        step.output = output;
+        step.channels = output->numberOfChannels();
+        step.layout = MixingMatrix::canonicalLayout(step.channels);
+        for (auto & c : m_compensation)
+            if (c.first == output.get())
+                step.delay = c.second.get();
+        m_mixPlan.push_back(step);
+        channels = std::max(channels, step.channels);
+    }
+
+    if (mode == ChannelCountMode::Explicit)
+        channels = node->channelCount();
+    else if (mode == ChannelCountMode::ClampedMax)
+        channels = std::min(channels, node->channelCount());
+    m_mixChannels = channels;
+
+    // the same choices AudioBus::sumFrom makes for each bus it sums
+    const int destinationChannels = m_internalSummingBus->numberOfChannels();
+    const int destinationLayout = mixingLayout(*m_internalSummingBus);
+    for (MixStep & step : m_mixPlan)
+    {
+        if (step.channels == destinationChannels &&
+            (interpretation == ChannelInterpretation::Discrete || step.layout == destinationLayout))
+            step.kind = MixStep::Channels;
+        else if (interpretation == ChannelInterpretation::Speakers &&
+                 (step.matrix = MixingMatrix::find(step.layout, destinationLayout)) != nullptr)
+            step.kind = MixStep::Matrix;
+        else
+            step.kind = MixStep::Discrete;
+    }
+}
+
+void AudioNodeInput::mix(const MixStep & step, const AudioBus & source)
+{
+    AudioBus & destination = *m_internalSummingBus;
+
+    // an output that changed its channels since the plan was compiled is summed as the
+    // node's interpretation has it, and the plan is compiled again for the next quantum
+    if (source.numberOfChannels() != step.channels || mixingLayout(source) != step.layout)
+    {
+        destination.sumFrom(source, destinationNode()->channelInterpretation());
+        m_mixPlanDirty = true;
+        return;
+    }
+
+    switch (step.kind)
+    {
+        case MixStep::Channels:
+            for (int i = 0; i < step.channels; ++i)
+                destination.channel(i)->sumFrom(source.channel(i));
+            break;
+        case MixStep::Matrix:
+            step.matrix->sum(source, destination);
+            break;
+        case MixStep::Discrete:
+            destination.sumFrom(source, ChannelInterpretation::Discrete);
+            break;
+    }
+}
+
 AudioBus * AudioNodeInput::bus(ContextRenderLock & r)
 {
     // Handle single connection specially to allow for in-place processing.
     // note: The webkit sources check for max, but I can't see how that's correct
 
     // @tofix - did I miss part of the merge?
-    if (numberOfRenderingConnections(r) == 1)  // && node()->channelCountMode() == ChannelCountMode::Max)
+    if (numberOfRenderingConnections(r) == 1 && m_compensation.empty())  // && node()->channelCountMode() == ChannelCountMode::Max)
     {
         std::shared_ptr<AudioNodeOutput> output = renderingOutput(r, 0);
-        if (output)
+        if (output && output->decimation() == AudioContext::renderDecimation())
         {
             return output->bus(r);
         }
@@ -136,48 +241,83 @@ AudioBus * AudioNodeInput::bus(ContextRenderLock & r)
     return m_internalSummingBus.get();
 }
 
+void AudioNodeInput::setLatencyCompensation(ContextRenderLock &, const std::vector<std::pair<AudioNodeOutput *, int>> & delays)
+{
+    std::vector<std::pair<AudioNodeOutput *, std::unique_ptr<CompensationDelay>>> compensation;
+    for (const auto & d : delays)
+    {
+        if (d.second <= 0)
+            continue;
+
+        auto kept = std::find_if(m_compensation.begin(), m_compensation.end(), [&](const auto & c) {
+            return c.first == d.first && c.second && c.second->delayFrames() == d.second;
+        });
+        if (kept != m_compensation.end())
+            compensation.emplace_back(d.first, std::move(kept->second));
+        else
+            compensation.emplace_back(d.first, std::unique_ptr<CompensationDelay>(new CompensationDelay(d.second)));
+    }
+    m_compensation.swap(compensation);
+    m_mixPlanDirty = true;
+}
+
 AudioBus * AudioNodeInput::pull(ContextRenderLock & r, AudioBus * inPlaceBus, int bufferSize)
 {
     updateRenderingState(r);
     m_destinationNode->checkNumberOfChannelsForInput(r, this);
+    if (!mixPlanIsCurrent())
+        compileMixPlan(r);
 
-    size_t num_connections = numberOfRenderingConnections(r);
+    // the rate the destination node renders at; see AudioNode::setDecimation()
+    const int decimation = AudioContext::renderDecimation();
 
     // Handle single connection case.
-    if (num_connections == 1)
+    if (m_mixPlan.size() == 1 && !m_mixPlan[0].delay)
     {
         // If this input is simply passing data through, then immediately delegate the pull request to it.
-        auto output = renderingOutput(r, 0);
+        auto output = m_mixPlan[0].output.lock();
         if (output)
         {
-            return output->pull(r, inPlaceBus, bufferSize);
+            AudioBus * source = output->pull(r, inPlaceBus, bufferSize);
+            if (output->decimation() == decimation)
+                return source;
         }
-
-        num_connections = 0;  // if there's a single input, but it has no output; treat this input as silent.
     }
 
-    if (num_connections == 0)
-    {
-        // Generate silence if we're not connected to anything, and return the silent bus
-        /// @TODO a possible optimization is to flag silence and propagate it to consumers of this input.
-        m_internalSummingBus->zero();
-        return m_internalSummingBus.get();
-    }
-
-    // multiple connections
+    // Generate silence if we're not connected to anything, and return the silent bus
+    /// @TODO a possible optimization is to flag silence and propagate it to consumers of this input.
     m_internalSummingBus->zero();
 
-    for (int i = 0; i < num_connections; ++i)
+    // multiple connections
+    for (const MixStep & step : m_mixPlan)
     {
-        auto output = renderingOutput(r, i);
-        if (output)
-        {
-            // Render audio from this output.
-            AudioBus * connectionBus = output->pull(r, 0, bufferSize);
+        auto output = step.output.lock();
+        if (!output)
+            continue;
 
-            // Sum, with unity-gain.
-            m_internalSummingBus->sumFrom(*connectionBus);
+        output->renderIfNecessary(r, nullptr, bufferSize);
+        if (output->decimation() != decimation)
+        {
+            // an output at another rate is interpolated to the node's, then mixed as any other
+            const int channels = output->numberOfChannels();
+            if (!m_resampledBus || m_resampledBus->numberOfChannels() != channels)
+                m_resampledBus.reset(new AudioBus(channels, m_processingSizeInFrames));
+            output->resampleInto(r, *m_resampledBus, bufferSize, decimation);
+            mix(step, step.delay ? step.delay->process(*m_resampledBus, bufferSize) : *m_resampledBus);
+        }
+        else if (step.delay)
+        {
+            AudioBus * source = output->pull(r, nullptr, bufferSize);
+            mix(step, step.delay->process(*source, bufferSize));
+        }
+        else if (step.kind == MixStep::Channels)
+        {
+            // Render audio from this output, and sum it with unity gain, applying any gain
+            // the output's node deferred as it does.
+            output->pullAndSumInto(r, *m_internalSummingBus, bufferSize);
         }
+        else
+            mix(step, *output->pull(r, nullptr, bufferSize));
     }
     return m_internalSummingBus.get();
 }
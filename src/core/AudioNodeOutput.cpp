@@ -9,9 +9,11 @@
 #include "LabSound/core/AudioParam.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 
+#include <cmath>
 #include <mutex>
 
 using namespace std;
@@ -28,23 +30,26 @@ AudioNodeOutput::AudioNodeOutput(AudioNode * node, int numberOfChannels, int pro
     : m_sourceNode(node)
     , m_numberOfChannels(numberOfChannels)
     , m_desiredNumberOfChannels(numberOfChannels)
+    , m_processingSizeInFrames(processingSizeInFrames > 0 ? processingSizeInFrames : node->renderQuantumSize())
     , m_inPlaceBus(0)
     , m_renderingFanOutCount(0)
     , m_renderingParamFanOutCount(0)
 {
-    m_internalBus.reset(new AudioBus(numberOfChannels, processingSizeInFrames));
+    m_internalBus.reset(new AudioBus(numberOfChannels, m_processingSizeInFrames));
 }
 
 AudioNodeOutput::AudioNodeOutput(AudioNode * node, char const * const name, int numberOfChannels, int processingSizeInFrames)
     : m_sourceNode(node)
     , m_name(name)
+    , m_nameId(internName(name))
     , m_numberOfChannels(numberOfChannels)
     , m_desiredNumberOfChannels(numberOfChannels)
+    , m_processingSizeInFrames(processingSizeInFrames > 0 ? processingSizeInFrames : node->renderQuantumSize())
     , m_inPlaceBus(0)
     , m_renderingFanOutCount(0)
     , m_renderingParamFanOutCount(0)
 {
-    m_internalBus.reset(new AudioBus(numberOfChannels, processingSizeInFrames));
+    m_internalBus.reset(new AudioBus(numberOfChannels, m_processingSizeInFrames));
 }
 
 AudioNodeOutput::~AudioNodeOutput()
@@ -55,7 +60,11 @@ void AudioNodeOutput::setNumberOfChannels(ContextRenderLock & r, int numberOfCha
 {
     if (m_numberOfChannels == numberOfChannels) return;
     m_desiredNumberOfChannels = numberOfChannels;
-    m_internalBus.reset(new AudioBus(numberOfChannels, AudioNode::ProcessingSizeInFrames));
+    m_internalBus.reset(new AudioBus(numberOfChannels, m_processingSizeInFrames));
+
+    // a bus supplied for the old channel count can no longer be rendered into
+    if (m_inPlaceBus && m_inPlaceBus->numberOfChannels() != numberOfChannels)
+        m_inPlaceBus = nullptr;
 }
 
 void AudioNodeOutput::updateInternalBus()
@@ -63,7 +72,9 @@ void AudioNodeOutput::updateInternalBus()
     if (numberOfChannels() == m_internalBus->numberOfChannels())
         return;
 
-    m_internalBus.reset(new AudioBus(numberOfChannels(), AudioNode::ProcessingSizeInFrames));
+    m_internalBus.reset(new AudioBus(numberOfChannels(), m_processingSizeInFrames));
+    if (m_inPlaceBus && m_inPlaceBus->numberOfChannels() != numberOfChannels())
+        m_inPlaceBus = nullptr;
 }
 
 void AudioNodeOutput::updateRenderingState(ContextRenderLock & r)
@@ -81,6 +92,9 @@ void AudioNodeOutput::updateRenderingState(ContextRenderLock & r)
 
 void AudioNodeOutput::propagateChannelCount(ContextRenderLock & r)
 {
+    for (auto & in : m_inputs)
+        in->channelsChanged();
+
     if (isChannelCountKnown())
     {
         ASSERT(r.context());
@@ -94,7 +108,7 @@ void AudioNodeOutput::propagateChannelCount(ContextRenderLock & r)
     }
 }
 
-AudioBus * AudioNodeOutput::pull(ContextRenderLock & r, AudioBus * inPlaceBus, int bufferSize)
+void AudioNodeOutput::renderIfNecessary(ContextRenderLock & r, AudioBus * inPlaceBus, int bufferSize)
 {
     ASSERT(r.context());
     ASSERT(m_renderingFanOutCount > 0 || m_renderingParamFanOutCount > 0);
@@ -110,26 +124,209 @@ AudioBus * AudioNodeOutput::pull(ContextRenderLock & r, AudioBus * inPlaceBus, i
 
     updateRenderingState(r);
 
+    auto n = sourceNode();
+    if (!n)
+        return;
+
+    // If the node has already rendered this quantum, for example because it was run from the context's compiled
+    // render schedule, its results are in whichever bus it rendered into, and that must not be changed after the fact.
+    if (n->isProcessedForCurrentQuantum(r))
+        return;
+
     bool useInPlaceBus = inPlaceBus && inPlaceBus->numberOfChannels() == numberOfChannels() && (m_renderingFanOutCount + m_renderingParamFanOutCount) == 1;
 
     // Setup the actual destination bus for processing when our node's process() method gets called in processIfNecessary() below.
     m_inPlaceBus = useInPlaceBus ? inPlaceBus : 0;
 
-    auto n = sourceNode();
-    if (!n)
-        return bus(r);
-
     n->processIfNecessary(r, bufferSize);
+}
+
+void AudioNodeOutput::useScratchBus(AudioBus * scratch)
+{
+    m_inPlaceBus = nullptr;
+    if (!scratch || scratch->numberOfChannels() != m_internalBus->numberOfChannels() || scratch->length() != m_internalBus->length())
+        return;
+
+    // de-zippering snaps to its target the first time an output renders, rather than a bus
+    scratch->setFirstTime(m_internalBus->isFirstTime());
+    m_inPlaceBus = scratch;
+}
+
+void AudioNodeOutput::releaseScratchBus()
+{
+    if (m_inPlaceBus)
+        m_internalBus->setFirstTime(m_inPlaceBus->isFirstTime());
+}
+
+AudioBus * AudioNodeOutput::pull(ContextRenderLock & r, AudioBus * inPlaceBus, int bufferSize)
+{
+    renderIfNecessary(r, inPlaceBus, bufferSize);
     return bus(r);
 }
 
+void AudioNodeOutput::pullAndSumInto(ContextRenderLock & r, AudioBus & accumulator, int bufferSize)
+{
+    renderIfNecessary(r, nullptr, bufferSize);
+
+    AudioBus * source = m_deferredGainSource;
+    if (!source || !accumulator.topologyMatches(*source))
+    {
+        accumulator.sumFrom(*bus(r));
+        return;
+    }
+
+    // A silent source contributes nothing, as the bus it would have resolved to would be zeroed
+    if (source->isSilent())
+        return;
+
+    const int length = accumulator.length();
+    for (int i = 0; i < accumulator.numberOfChannels(); ++i)
+    {
+        AudioChannel * destination = accumulator.channel(i);
+
+        // a constant source under a constant gain sums as a scalar
+        const AudioChannel * sourceChannel = source->channel(i);
+        if (!m_deferredGainValues && sourceChannel->isConstant() && destination->isConstant())
+        {
+            destination->setConstant(destination->constantValue() + sourceChannel->constantValue() * m_deferredGain);
+            continue;
+        }
+
+        const float * sourceData = sourceChannel->data();
+        bool overwrite = destination->isSilent();
+        float * destinationData = destination->mutableData();
+
+        if (m_deferredGainValues)
+        {
+            if (overwrite)
+                VectorMath::vmul(sourceData, 1, m_deferredGainValues, 1, destinationData, 1, length);
+            else
+                VectorMath::vmadd(sourceData, 1, m_deferredGainValues, 1, destinationData, 1, length);
+        }
+        else
+        {
+            if (overwrite)
+                VectorMath::vsmul(sourceData, 1, &m_deferredGain, destinationData, 1, length);
+            else
+                VectorMath::vsma(sourceData, 1, &m_deferredGain, destinationData, 1, length);
+        }
+    }
+}
+
 AudioBus * AudioNodeOutput::bus(ContextRenderLock & r) const
 {
     // only legal during rendering because an in-place bus might have been supplied to pull
     ASSERT(r.context());
+    if (m_deferredGainSource)
+        resolveDeferredGain();
     return m_inPlaceBus ? m_inPlaceBus : m_internalBus.get();
 }
 
+bool AudioNodeOutput::isSilent() const
+{
+    if (m_deferredGainSource)
+        return m_deferredGainSource->isSilent();
+    return (m_inPlaceBus ? m_inPlaceBus : m_internalBus.get())->isSilent();
+}
+
+void AudioNodeOutput::deferGain(AudioBus * source, const float * gainValues, float gain)
+{
+    m_deferredGainSource = source;
+    m_deferredGainValues = gainValues;
+    m_deferredGain = gain;
+}
+
+void AudioNodeOutput::resolveDeferredGain() const
+{
+    AudioBus * source = m_deferredGainSource;
+    m_deferredGainSource = nullptr;
+
+    AudioBus * destination = m_inPlaceBus ? m_inPlaceBus : m_internalBus.get();
+    if (source->isSilent() || !destination->topologyMatches(*source))
+    {
+        destination->zero();
+        return;
+    }
+
+    if (m_deferredGainValues)
+    {
+        destination->copyWithSampleAccurateGainValuesFrom(*source, m_deferredGainValues, destination->length());
+        return;
+    }
+
+    for (int i = 0; i < destination->numberOfChannels(); ++i)
+        VectorMath::vsmul(source->channel(i)->data(), 1, &m_deferredGain, destination->channel(i)->mutableData(), 1, destination->length());
+}
+
+void AudioNodeOutput::holdLastFrame(int frames, int decimation)
+{
+    m_decimation = decimation;
+    m_previousFrame.swap(m_lastFrame);
+    m_lastFrame.resize(m_numberOfChannels);
+
+    const AudioBus * source = m_deferredGainSource ? m_deferredGainSource : (m_inPlaceBus ? m_inPlaceBus : m_internalBus.get());
+    float gain = 1.f;
+    if (m_deferredGainSource)
+        gain = m_deferredGainValues ? m_deferredGainValues[frames - 1] : m_deferredGain;
+
+    const bool silent = source->isSilent();
+    for (int i = 0; i < m_numberOfChannels; ++i)
+    {
+        const AudioChannel * channel = i < source->numberOfChannels() ? source->channel(i) : nullptr;
+        if (silent || !channel)
+            m_lastFrame[i] = 0.f;
+        else if (channel->isConstant())
+            m_lastFrame[i] = channel->constantValue() * gain;
+        else
+            m_lastFrame[i] = channel->data()[frames - 1] * gain;
+    }
+}
+
+void AudioNodeOutput::resampleInto(ContextRenderLock & r, AudioBus & destination, int frames, int decimation)
+{
+    const AudioBus * source = bus(r);
+
+    // The reader's frame j, which stands for the end of its span of the quantum, falls at
+    // (j + 1) * ratio - 1 of the source's frames, and is interpolated between the two about
+    // it. A source frame before the first is the one held from the quantum before.
+    const double ratio = static_cast<double>(decimation) / m_decimation;
+    const int sourceFrames = std::max(1, static_cast<int>(frames * ratio));
+    const int channels = std::min(source->numberOfChannels(), destination.numberOfChannels());
+
+    for (int i = 0; i < destination.numberOfChannels(); ++i)
+    {
+        AudioChannel * out = destination.channel(i);
+        const float held = i < static_cast<int>(m_previousFrame.size()) ? m_previousFrame[i] : 0.f;
+        const AudioChannel * in = i < channels ? source->channel(i) : nullptr;
+        if (!in || (in->isConstant() && (ratio >= 1 || held == in->constantValue())))
+        {
+            if (!in || in->isSilent())
+                out->zero();
+            else
+                out->setConstant(in->constantValue());
+            continue;
+        }
+
+        const float * s = in->data();
+        float * d = out->mutableData();
+        for (int j = 0; j < frames; ++j)
+        {
+            const double u = (j + 1) * ratio - 1;
+            const int k = static_cast<int>(std::floor(u));
+            const float f = static_cast<float>(u - k);
+            const float a = k < 0 ? held : s[k];
+            const float b = k + 1 < sourceFrames ? s[k + 1] : a;
+            d[j] = a + f * (b - a);
+        }
+    }
+}
+
+bool AudioNodeOutput::feedsSummingInput(ContextRenderLock & r) const
+{
+    return m_renderingFanOutCount == 1 && m_renderingParamFanOutCount == 0 &&
+           m_inputs.size() == 1 && m_inputs[0]->numberOfRenderingConnections(r) > 1;
+}
+
 int AudioNodeOutput::fanOutCount()
 {
     return static_cast<int>(m_inputs.size());
@@ -3,9 +3,11 @@
 
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/Macros.h"
+#include "LabSound/core/ModulationBus.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
@@ -13,18 +15,20 @@
 #include "internal/AudioUtilities.h"
 
 #include <algorithm>
+#include <memory>
+#include <mutex>
 
 using namespace lab;
 
-AudioBus const* const AudioParam::bus() const
-{
-    return m_internalSummingBus.get();
-}
-
-
 const double AudioParam::DefaultSmoothingConstant = 0.05;
 const double AudioParam::SnapThreshold = 0.001;
 
+namespace
+{
+    // serializes changes to parameters' modulations, which are copied on write
+    std::mutex s_modulationMutex;
+}
+
 AudioParam::AudioParam(AudioParamDescriptor const * const desc) noexcept
     : _desc(desc)
     , m_value(desc->defaultValue)
@@ -35,6 +39,50 @@ AudioParam::AudioParam(AudioParamDescriptor const * const desc) noexcept
 
 AudioParam::~AudioParam() {}
 
+void AudioParam::setModulations(std::shared_ptr<const Modulations> modulations)
+{
+    const bool modulated = modulations && !modulations->empty();
+    std::atomic_store(&m_modulations, std::move(modulations));
+    m_modulated.store(modulated, std::memory_order_release);
+}
+
+void AudioParam::modulate(std::shared_ptr<Modulator> modulator, float depth)
+{
+    if (!modulator)
+        return;
+
+    std::lock_guard<std::mutex> lock(s_modulationMutex);
+    std::shared_ptr<const Modulations> current = std::atomic_load(&m_modulations);
+    auto modulations = current ? std::make_shared<Modulations>(*current) : std::make_shared<Modulations>();
+    auto it = std::find_if(modulations->begin(), modulations->end(),
+                           [&](const Modulation & m) { return m.modulator == modulator; });
+    if (it != modulations->end())
+        it->depth = depth;
+    else
+        modulations->push_back({std::move(modulator), depth});
+    setModulations(std::move(modulations));
+}
+
+void AudioParam::removeModulation(std::shared_ptr<Modulator> modulator)
+{
+    std::lock_guard<std::mutex> lock(s_modulationMutex);
+    std::shared_ptr<const Modulations> current = std::atomic_load(&m_modulations);
+    if (!current)
+        return;
+
+    auto modulations = std::make_shared<Modulations>(*current);
+    modulations->erase(std::remove_if(modulations->begin(), modulations->end(),
+                                      [&](const Modulation & m) { return m.modulator == modulator; }),
+                       modulations->end());
+    setModulations(std::move(modulations));
+}
+
+void AudioParam::removeAllModulations()
+{
+    std::lock_guard<std::mutex> lock(s_modulationMutex);
+    setModulations(nullptr);
+}
+
 float AudioParam::value() const
 {
     return static_cast<float>(m_value);
@@ -80,6 +128,62 @@ bool AudioParam::smooth(ContextRenderLock & r)
     return false;
 }
 
+AudioParamBlock AudioParam::smoothBlock(ContextRenderLock & r, float * scratch, int count)
+{
+    if (hasSampleAccurateValues())
+    {
+        AudioParamBlock block = calculateSampleAccurateBlock(r, scratch, count);
+        m_smoothedValue = block.valueAt(std::max(count - 1, 0));
+        return block;
+    }
+
+    AudioParamBlock block;
+    block.value = static_cast<float>(m_value);
+    if (m_smoothedValue == m_value || !scratch || count <= 0)
+    {
+        m_smoothedValue = m_value;
+        return block;
+    }
+
+    if (count != m_frameDecayCount || m_smoothingConstant != m_frameDecayConstant)
+    {
+        m_frameDecay = pow(std::max(0., 1. - m_smoothingConstant), 1. / count);
+        m_frameDecayConstant = m_smoothingConstant;
+        m_frameDecayCount = count;
+    }
+
+    // The distance to the target decays by the same factor each frame. Four lanes, each a
+    // frame apart, step four frames at a time, which vectorizes.
+    const float target = static_cast<float>(m_value);
+    const float decay = static_cast<float>(m_frameDecay);
+    const float decay4 = decay * decay * decay * decay;
+    float lanes[4];
+    lanes[0] = static_cast<float>(m_smoothedValue - m_value) * decay;
+    for (int l = 1; l < 4; ++l)
+        lanes[l] = lanes[l - 1] * decay;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        for (int l = 0; l < 4; ++l)
+        {
+            scratch[i + l] = target + lanes[l];
+            lanes[l] *= decay4;
+        }
+    }
+    for (int l = 0; i < count; ++i, ++l)
+        scratch[i] = target + lanes[l];
+
+    // If we get close enough then snap to actual value.
+    const float last = scratch[count - 1];
+    m_smoothedValue = fabs(last - m_value) < SnapThreshold ? m_value : last;
+
+    block.kind = AudioParamBlock::Arbitrary;
+    block.value = scratch[0];
+    block.values = scratch;
+    return block;
+}
+
 float AudioParam::finalValue(ContextRenderLock & r)
 {
     float value;
@@ -96,6 +200,78 @@ void AudioParam::calculateSampleAccurateValues(ContextRenderLock & r, float * va
     calculateFinalValues(r, values, numberOfValues, true);
 }
 
+AudioParamBlock AudioParam::calculateSampleAccurateBlock(ContextRenderLock & r, float * scratch, int numberOfValues)
+{
+    AudioParamBlock block;
+    block.value = static_cast<float>(m_value);
+
+    bool isSafe = r.context() && scratch && numberOfValues;
+    if (!isSafe)
+        return block;
+
+    // Connected signals are summed into the values, so that the values must be computed,
+    // unless every connection is a constant, which adds a scalar. Modulators always vary.
+    updateRenderingState(r);
+    float connectedValue = 0;
+    bool connectionsConstant = !isModulated();
+    const int connectionCount = numberOfRenderingConnections(r);
+    const int decimation = AudioContext::renderDecimation();
+    for (int i = 0; i < connectionCount && connectionsConstant; ++i)
+    {
+        auto output = renderingOutput(r, i);
+        AudioBus * connectionBus = output ? output->pull(r, nullptr, r.context()->renderQuantumSize() / decimation) : nullptr;
+        connectionsConstant = connectionBus && connectionBus->numberOfChannels() == 1 && connectionBus->channel(0)->isConstant() &&
+                              output->decimation() == decimation;
+        if (connectionsConstant)
+            connectedValue += connectionBus->channel(0)->constantValue();
+    }
+
+    if (connectionsConstant)
+    {
+        double sampleRate = r.context()->sampleRate();
+        double startTime = r.context()->currentTime();
+        double endTime = startTime + numberOfValues / sampleRate;
+
+        float slope = 0;
+        AudioParamTimeline::BlockShape shape = m_timeline.shapeForTimeRange(
+            startTime, endTime, static_cast<float>(m_value), sampleRate, block.value, slope);
+
+        if (shape != AudioParamTimeline::BlockShape::Arbitrary)
+        {
+            if (shape == AudioParamTimeline::BlockShape::Linear)
+            {
+                block.kind = AudioParamBlock::Linear;
+                block.slope = slope;
+            }
+            m_value = block.valueAt(numberOfValues - 1);
+            block.value += connectedValue;
+            return block;
+        }
+    }
+
+    calculateFinalValues(r, scratch, numberOfValues, true);
+    block.kind = AudioParamBlock::Arbitrary;
+    block.value = scratch[0];
+    block.values = scratch;
+    return block;
+}
+
+void AudioParamBlock::render(float * destination, int count) const
+{
+    if (kind == Arbitrary)
+    {
+        if (destination != values)
+            std::copy(values, values + count, destination);
+    }
+    else if (kind == Linear)
+    {
+        for (int i = 0; i < count; ++i)
+            destination[i] = value + slope * i;
+    }
+    else
+        std::fill(destination, destination + count, value);
+}
+
 void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int numberOfValues, bool sampleAccurate)
 {
     bool isSafe = r.context() && values && numberOfValues;
@@ -121,6 +297,22 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
         values[0] = static_cast<float>(m_value);
     }
 
+    // The modulators were rendered for this quantum before the graph
+    std::shared_ptr<const Modulations> modulations;
+    if (isModulated() && (modulations = std::atomic_load(&m_modulations)))
+    {
+        // a decimated node's values are the last of each span of frames the modulators rendered
+        const int count = sampleAccurate ? numberOfValues : 1;
+        const int stride = AudioContext::renderDecimation();
+        for (const Modulation & m : *modulations)
+        {
+            const float * modulation = m.modulator->values() + stride - 1;
+            const float depth = m.depth;
+            for (int i = 0; i < count; ++i)
+                values[i] += depth * modulation[i * stride];
+        }
+    }
+
     // if there are rendering connections, be sure they are ready
     updateRenderingState(r);
 
@@ -131,16 +323,15 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
     // Now sum all of the audio-rate connections together (unity-gain summing junction).
     // Note that parameter connections would normally be mono, so mix down to mono if necessary.
 
-    // LabSound: For some reason a bus was temporarily created here and the results discarded.
-    // Bug still exists in WebKit top of tree.
-    if (m_internalSummingBus && m_internalSummingBus->length() < numberOfValues)
-        m_internalSummingBus.reset();
-
-    if (!m_internalSummingBus)
-        m_internalSummingBus.reset(new AudioBus(1, numberOfValues));
+    // The connections are summed straight into values, through a bus that owns no memory.
+    // One such bus serves every parameter that a render thread evaluates, so that a
+    // parameter holds no summing storage of its own however many modulators it has.
+    thread_local AudioBus summingBus(1, 0, false);
 
-    // point the summing bus at the values array
-    m_internalSummingBus->setChannelMemory(0, values, numberOfValues);
+    // A connection from a node rendering at another decimation than the param's node is
+    // interpolated to the param's rate first, through a bus likewise shared by the thread.
+    thread_local std::unique_ptr<AudioBus> resampledBus;
+    const int decimation = AudioContext::renderDecimation();
 
     for (int i = 0; i < connectionCount; ++i)
     {
@@ -149,7 +340,15 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
         ASSERT(output);
 
         // Render audio from this output.
-        AudioBus * connectionBus = output->pull(r, nullptr, AudioNode::ProcessingSizeInFrames);
+        AudioBus * connectionBus = output->pull(r, nullptr, r.context()->renderQuantumSize() / decimation);
+        if (output->decimation() != decimation)
+        {
+            const int channels = connectionBus->numberOfChannels();
+            if (!resampledBus || resampledBus->numberOfChannels() != channels || resampledBus->length() < numberOfValues)
+                resampledBus.reset(new AudioBus(channels, std::max(numberOfValues, r.context()->renderQuantumSize())));
+            output->resampleInto(r, *resampledBus, numberOfValues, decimation);
+            connectionBus = resampledBus.get();
+        }
 
         // Sum, with unity-gain.
         /// @TODO it was surprising in practice that the inputs are summed, as opposed to simply overriding.
@@ -158,7 +357,9 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
         /// a signal with frequency 4, bias 440, amplitude 10, and supply that as an override to the frequency of
         /// a second oscillator. Since it's summed, the solution that works is that the first oscillator should
         /// have a bias of zero. It seems like sum or override should be a setting of some sort...
-        m_internalSummingBus->sumFrom(*connectionBus);
+        // Pulling the output may have evaluated other parameters through the same bus.
+        summingBus.setChannelMemory(0, values, numberOfValues);
+        summingBus.sumFrom(*connectionBus);
     }
 }
 
@@ -166,8 +367,7 @@ void AudioParam::calculateTimelineValues(ContextRenderLock & r,
     float * values, int numberOfValues)
 {
     // Calculate values for this render quantum.
-    // Normally numberOfValues will equal AudioNode::ProcessingSizeInFrames 
-    // (the render quantum size).
+    // Normally numberOfValues will equal the context's render quantum size.
     double sampleRate = r.context()->sampleRate();
     double startTime = r.context()->currentTime();
     double endTime = startTime + numberOfValues / sampleRate;
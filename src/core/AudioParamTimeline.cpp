@@ -19,12 +19,6 @@ using namespace std;
 namespace lab
 {
 
-//@tofix - is there any reason this should be per object instead of static?
-namespace
-{
-    std::mutex m_eventsMutex;
-}
-
 void AudioParamTimeline::setValueAtTime(float value, float time)
 {
     insertEvent(ParamEvent(ParamEvent::SetValue, value, time, 0, 0, {}));
@@ -40,6 +34,31 @@ void AudioParamTimeline::exponentialRampToValueAtTime(float value, float time)
     insertEvent(ParamEvent(ParamEvent::ExponentialRampToValue, value, time, 0, 0, {}));
 }
 
+bool AudioParamTimeline::hasEventsAfter(double time)
+{
+    std::unique_lock<std::mutex> lock(m_eventsMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return true;
+
+    for (ParamEvent & e : m_events)
+    {
+        const double end = e.time() + (e.type() == ParamEvent::SetValueCurve ? e.duration() : 0.f);
+        if (end > time)
+            return true;
+    }
+    return false;
+}
+
+bool AudioParamTimeline::trySetValueAtTime(float value, float time)
+{
+    return tryInsertEvent(ParamEvent(ParamEvent::SetValue, value, time, 0, 0, {}));
+}
+
+bool AudioParamTimeline::tryLinearRampToValueAtTime(float value, float time)
+{
+    return tryInsertEvent(ParamEvent(ParamEvent::LinearRampToValue, value, time, 0, 0, {}));
+}
+
 void AudioParamTimeline::setTargetAtTime(float target, float time, float timeConstant)
 {
     insertEvent(ParamEvent(ParamEvent::SetTarget, target, time, timeConstant, 0, {}));
@@ -47,7 +66,44 @@ void AudioParamTimeline::setTargetAtTime(float target, float time, float timeCon
 
 void AudioParamTimeline::setValueCurveAtTime(std::vector<float> & curve, float time, float duration)
 {
-    insertEvent(ParamEvent(ParamEvent::SetValueCurve, 0, time, 0, duration, curve));
+    setValueCurveAtTime(std::make_shared<const std::vector<float>>(curve), time, duration);
+}
+
+void AudioParamTimeline::setValueCurveAtTime(ValueCurve curve, float time, float duration)
+{
+    insertEvent(ParamEvent(ParamEvent::SetValueCurve, 0, time, 0, duration, std::move(curve)));
+}
+
+// Writes values[j] = offset + scale * ratio^j for count values, and returns the value
+// that would follow them. The powers are stepped in independent chains of eight, rather
+// than one value from the last, so that the loop vectorizes.
+static float geometricFill(float * values, size_t count, double offset, double scale, double ratio)
+{
+    const int Chains = 8;
+    double chain[Chains];
+    double power = 1;
+    for (int l = 0; l < Chains; ++l)
+    {
+        chain[l] = scale * power;
+        power *= ratio;
+    }
+    const double step = power;
+
+    size_t j = 0;
+    for (; j + Chains <= count; j += Chains)
+    {
+        for (int l = 0; l < Chains; ++l)
+        {
+            values[j + l] = static_cast<float>(offset + chain[l]);
+            chain[l] *= step;
+        }
+    }
+
+    const size_t remaining = count - j;
+    for (size_t l = 0; l < remaining; ++l)
+        values[j + l] = static_cast<float>(offset + chain[l]);
+
+    return static_cast<float>(offset + chain[remaining]);
 }
 
 static bool isValidNumber(float x)
@@ -55,7 +111,7 @@ static bool isValidNumber(float x)
     return !std::isnan(x) && !std::isinf(x);
 }
 
-void AudioParamTimeline::insertEvent(const ParamEvent & event)
+bool AudioParamTimeline::isValidEvent(const ParamEvent & event)
 {
     // Sanity check the event. Be super careful we're not getting infected with NaN or Inf.
     bool isValid = event.type() < ParamEvent::LastType
@@ -66,70 +122,117 @@ void AudioParamTimeline::insertEvent(const ParamEvent & event)
                    && event.duration() >= 0;
 
     ASSERT(isValid);
+    return isValid;
+}
 
-    if (!isValid)
+void AudioParamTimeline::insertEvent(const ParamEvent & event)
+{
+    if (!isValidEvent(event))
         return;
 
     std::lock_guard<std::mutex> lock(m_eventsMutex);
+    pruneRenderedEvents();
 
-    unsigned i = 0;
-    float insertTime = event.time();
+    if (!insertEventLocked(event))
+        throw std::runtime_error("ParamEvent::SetValueCurve overlaps existing");
+}
 
-    for (i = 0; i < m_events.size(); ++i)
-    {
+bool AudioParamTimeline::tryInsertEvent(const ParamEvent & event)
+{
+    if (!isValidEvent(event))
+        return true;
 
-        if (event.type() == ParamEvent::SetValueCurve)
-        {
-            // If this event is a SetValueCurve, make sure it doesn't overlap any existing
-            // event. It's ok if the SetValueCurve starts at the same time as the end of some other
-            // duration.
-            double endTime = event.time() + event.duration();
-            if (m_events[i].time() > event.time() && m_events[i].time() < endTime)
-            {
-                throw std::runtime_error("ParamEvent::SetValueCurve overlaps existing");
-            }
-        }
-        else
-        {
-            // Otherwise, make sure this event doesn't overlap any existing SetValueCurve event.
-            if (m_events[i].type() == ParamEvent::SetValueCurve)
-            {
-                double endTime = m_events[i].time() + m_events[i].duration();
-                if (event.time() >= m_events[i].time() && event.time() < endTime)
-                {
-                    throw std::runtime_error("ParamEvent::SetValueCurve overlaps existing");
-                }
-            }
-        }
+    std::unique_lock<std::mutex> lock(m_eventsMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+
+    // events moved or released with a curve would allocate or free it here, on the audio
+    // thread, so a timeline holding curves is left for the next thread to prune
+    pruneRenderedEvents(true);
+    insertEventLocked(event);
+    return true;
+}
+
+bool AudioParamTimeline::insertEventLocked(const ParamEvent & event)
+{
+    const float insertTime = event.time();
+
+    // the new event goes after any others at the same time
+    auto position = std::upper_bound(m_events.begin(), m_events.end(), insertTime,
+        [](float time, const ParamEvent & e) { return time < e.time(); });
+
+    if (event.type() == ParamEvent::SetValueCurve)
+    {
+        // If this event is a SetValueCurve, make sure it doesn't overlap any existing
+        // event. It's ok if the SetValueCurve starts at the same time as the end of some other
+        // duration.
+        double endTime = event.time() + event.duration();
+        if (position != m_events.end() && position->time() < endTime)
+            return false;
+    }
 
-        // Overwrite same event type and time.
-        if (m_events[i].time() == insertTime && m_events[i].type() == event.type())
+    // Of the events before this one, only those at the latest time can be a SetValueCurve
+    // that it falls in, as a curve has no other events inside its duration.
+    auto i = position;
+    while (i != m_events.begin() && (i - 1)->time() == (position - 1)->time())
+    {
+        --i;
+        if (event.type() != ParamEvent::SetValueCurve && i->type() == ParamEvent::SetValueCurve)
         {
-            m_events[i] = event;
-            return;
+            double endTime = i->time() + i->duration();
+            if (event.time() >= i->time() && event.time() < endTime)
+                return false;
         }
+    }
 
-        if (m_events[i].time() > insertTime)
+    // Overwrite same event type and time.
+    for (; i != position; ++i)
+    {
+        if (i->time() == insertTime && i->type() == event.type())
         {
-            break;
+            *i = event;
+            return true;
         }
     }
 
-    m_events.insert(m_events.begin() + i, event);
+    m_events.insert(position, event);
+    return true;
 }
 
 void AudioParamTimeline::cancelScheduledValues(float startTime)
 {
     std::lock_guard<std::mutex> lock(m_eventsMutex);
+    pruneRenderedEvents();
 
     // Remove all events starting at startTime.
-    for (unsigned i = 0; i < m_events.size(); ++i)
+    auto first = std::lower_bound(m_events.begin(), m_events.end(), startTime,
+        [](const ParamEvent & e, float time) { return e.time() < time; });
+    m_events.erase(first, m_events.end());
+}
+
+std::vector<AudioParamTimeline::Event> AudioParamTimeline::events()
+{
+    std::lock_guard<std::mutex> lock(m_eventsMutex);
+    std::vector<Event> events;
+    events.reserve(m_events.size());
+    for (ParamEvent & e : m_events)
+        events.push_back({static_cast<EventKind>(e.type()), e.value(), e.time(), e.timeConstant(), e.duration(), e.curve()});
+    return events;
+}
+
+void AudioParamTimeline::pruneRenderedEvents(bool keepCurves)
+{
+    // Events before the one that was current when the timeline was last rendered can't
+    // affect the values of later times. They are released here, on the thread that
+    // schedules events, rather than by the audio thread.
+    if (m_firstActiveEvent > 0)
     {
-        if (m_events[i].time() >= startTime)
-        {
-            m_events.erase(m_events.begin() + i, m_events.end());
-            break;
-        }
+        auto last = m_events.begin() + std::min(m_firstActiveEvent, m_events.size());
+        if (keepCurves && std::any_of(m_events.begin(), m_events.end(), [](const ParamEvent & e) { return e.curve() != nullptr; }))
+            return;
+
+        m_events.erase(m_events.begin(), last);
+        m_firstActiveEvent = 0;
     }
 }
 
@@ -152,7 +255,7 @@ float AudioParamTimeline::valueForContextTime(
     double sampleRate = context->sampleRate();
     double startTime = context->currentTime();
     double endTime = startTime + 1.1 / sampleRate;  // time just beyond one sample-frame
-    double controlRate = sampleRate / AudioNode::ProcessingSizeInFrames;  // one parameter change per render quantum
+    double controlRate = sampleRate / context->renderQuantumSize();  // one parameter change per render quantum
     float value = valuesForTimeRange(startTime, endTime, defaultValue, &value, 1, sampleRate, controlRate);
 
     hasValue = true;
@@ -172,6 +275,65 @@ float AudioParamTimeline::valuesForTimeRange(
     return value;
 }
 
+AudioParamTimeline::BlockShape AudioParamTimeline::shapeForTimeRange(
+    double startTime,
+    double endTime,
+    float defaultValue,
+    double sampleRate,
+    float & value,
+    float & slope)
+{
+    value = defaultValue;
+    slope = 0;
+
+    // As valuesForTimeRangeImpl, the default value holds if there are no events in the range.
+    std::unique_lock<std::mutex> lock(m_eventsMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !m_events.size() || endTime <= m_events[0].time())
+        return BlockShape::Constant;
+
+    if (startTime < m_events[0].time())
+        return BlockShape::Arbitrary;
+
+    auto current = std::lower_bound(m_events.begin(), m_events.end(), startTime,
+        [](const ParamEvent & e, double time) { return e.time() < time; });
+    int first = std::max(0, static_cast<int>(current - m_events.begin()) - 1);
+    m_firstActiveEvent = first;
+
+    const ParamEvent & event = m_events[first];
+    const ParamEvent * nextEvent = first + 1 < static_cast<int>(m_events.size()) ? &m_events[first + 1] : nullptr;
+
+    // the range must lie within a single event's span
+    if (nextEvent && nextEvent->time() < endTime)
+        return BlockShape::Arbitrary;
+
+    ParamEvent::Type nextEventType = nextEvent ? static_cast<ParamEvent::Type>(nextEvent->type()) : ParamEvent::LastType;
+    if (nextEventType == ParamEvent::LinearRampToValue)
+    {
+        double time1 = event.time();
+        double deltaTime = nextEvent->time() - time1;
+        float k = static_cast<float>(deltaTime > 0 ? 1 / deltaTime : 0);
+        float x = static_cast<float>(startTime - time1) * k;
+        value = (1 - x) * event.value() + x * nextEvent->value();
+        slope = static_cast<float>((nextEvent->value() - event.value()) * k / sampleRate);
+        return BlockShape::Linear;
+    }
+
+    if (nextEventType == ParamEvent::ExponentialRampToValue)
+        return BlockShape::Arbitrary;
+
+    switch (event.type())
+    {
+        case ParamEvent::SetValue:
+        case ParamEvent::LinearRampToValue:
+        case ParamEvent::ExponentialRampToValue:
+            value = event.value();
+            return BlockShape::Constant;
+
+        default:
+            return BlockShape::Arbitrary;
+    }
+}
+
 float AudioParamTimeline::valuesForTimeRangeImpl(
     double startTime,
     double endTime,
@@ -213,12 +375,17 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
 
     float value = defaultValue;
 
+    // The events that end before currentTime are skipped; the first one that doesn't is
+    // the one before the first event at or after currentTime.
+    auto current = std::lower_bound(m_events.begin(), m_events.end(), currentTime,
+        [](const ParamEvent & e, double time) { return e.time() < time; });
+    int first = std::max(0, static_cast<int>(current - m_events.begin()) - 1);
+    m_firstActiveEvent = first;
+
     // Go through each event and render the value buffer where the times overlap,
     // stopping when we've rendered all the requested values.
-    // FIXME: could try to optimize by avoiding having to iterate starting from the very first event
-    // and keeping track of a "current" event index.
     int n = static_cast<int>(m_events.size());
-    for (int i = 0; i < n && writeIndex < numberOfValues; ++i)
+    for (int i = first; i < n && writeIndex < numberOfValues; ++i)
     {
         ParamEvent & event = m_events[i];
         ParamEvent * nextEvent = i < n - 1 ? &(m_events[i + 1]) : 0;
@@ -245,12 +412,20 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
         // First handle linear and exponential ramps which require looking ahead to the next event.
         if (nextEventType == ParamEvent::LinearRampToValue)
         {
-            for (; writeIndex < fillToFrame; ++writeIndex)
+            // each value is found from its own time, so the loop vectorizes
+            const size_t count = fillToFrame > writeIndex ? fillToFrame - writeIndex : 0;
+            const double rampStart = currentTime - time1;
+            float * out = values + writeIndex;
+            for (size_t j = 0; j < count; ++j)
             {
-                float x = static_cast<float>(currentTime - time1) * k;
-                value = (1 - x) * value1 + x * value2;
-                values[writeIndex] = value;
-                currentTime += sampleFrameTimeIncr;
+                float x = static_cast<float>(rampStart + j * sampleFrameTimeIncr) * k;
+                out[j] = (1 - x) * value1 + x * value2;
+            }
+            if (count)
+            {
+                value = out[count - 1];
+                writeIndex += static_cast<unsigned>(count);
+                currentTime += count * sampleFrameTimeIncr;
             }
         }
         else if (nextEventType == ParamEvent::ExponentialRampToValue)
@@ -273,12 +448,10 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
                 // accurate, especially if multiplier is close to 1.
                 value = value1 * powf(value2 / value1, AudioUtilities::timeToSampleFrame(currentTime - time1, sampleRate) / numSampleFrames);
 
-                for (; writeIndex < fillToFrame; ++writeIndex)
-                {
-                    values[writeIndex] = value;
-                    value *= multiplier;
-                    currentTime += sampleFrameTimeIncr;
-                }
+                const size_t count = fillToFrame > writeIndex ? fillToFrame - writeIndex : 0;
+                value = geometricFill(values + writeIndex, count, 0, value, multiplier);
+                writeIndex += static_cast<unsigned>(count);
+                currentTime += count * sampleFrameTimeIncr;
             }
         }
         else
@@ -309,29 +482,27 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
                     float timeConstant = event.timeConstant();
                     float discreteTimeConstant = static_cast<float>(AudioUtilities::discreteTimeConstantForSampleRate(timeConstant, controlRate));
 
-                    for (; writeIndex < fillToFrame; ++writeIndex)
-                    {
-                        values[writeIndex] = value;
-                        value += (target - value) * discreteTimeConstant;
-                    }
+                    // the distance to the target shrinks by the same ratio every frame
+                    const size_t count = fillToFrame > writeIndex ? fillToFrame - writeIndex : 0;
+                    value = geometricFill(values + writeIndex, count, target, value - target, 1 - discreteTimeConstant);
+                    writeIndex += static_cast<unsigned>(count);
 
                     break;
                 }
 
                 case ParamEvent::SetValueCurve:
                 {
-                    std::vector<float> & curve = event.curve();
-                    float * curveData = curve.size() > 0 ? curve.data() : 0;
-                    size_t numberOfCurvePoints = curve.size() > 0 ? curve.size() : 0;
+                    const float * curveData = event.curve() ? event.curve()->data() : nullptr;
+                    size_t numberOfCurvePoints = event.curve() ? event.curve()->size() : 0;
 
                     // Curve events have duration, so don't just use next event time.
                     float duration = event.duration();
 
                     // How much to step the curve index for each frame.  This is basically the term
                     // (N - 1)/Td in the specification.
-                    float curvePointsPerFrame = static_cast<float>((numberOfCurvePoints - 1) / duration / sampleRate);
+                    double curvePointsPerFrame = (numberOfCurvePoints - 1) / duration / sampleRate;
 
-                    if (curve.size() == 0 || !curveData || !numberOfCurvePoints || duration <= 0 || sampleRate <= 0)
+                    if (!curveData || !numberOfCurvePoints || duration <= 0 || sampleRate <= 0)
                     {
                         // Error condition - simply propagate previous value.
                         currentTime = fillToTime;
@@ -357,31 +528,30 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
 
                     // Index into the curve data using a floating-point value.
                     // We're scaling the number of curve points by the duration (see curvePointsPerFrame).
-                    float curveVirtualIndex = 0;
+                    double curveStartIndex = 0;
                     if (time1 < currentTime)
                     {
                         // Index somewhere in the middle of the curve data.
                         // Don't use timeToSampleFrame() since we want the exact floating-point frame.
-                        float frameOffset = static_cast<float>((currentTime - time1) * sampleRate);
-                        curveVirtualIndex = curvePointsPerFrame * frameOffset;
+                        curveStartIndex = curvePointsPerFrame * (currentTime - time1) * sampleRate;
                     }
 
-                    // Render the stretched curve data using nearest neighbor sampling.
-                    // Oversampled curve data can be provided if smoothness is desired.
+                    // Render the stretched curve, interpolating linearly between its points. Each
+                    // frame's index is computed from the start, rather than accumulated, and the
+                    // loop has no branches, so that only the two lookups don't vectorize.
+                    const float lastIndex = static_cast<float>(numberOfCurvePoints - 1);
+                    const size_t firstFrame = writeIndex;
                     for (; writeIndex < fillToFrame; ++writeIndex)
                     {
-                        // Ideally we'd use round() from MathExtras, but we're in a tight loop here
-                        // and we're trading off precision for extra speed.
-                        unsigned curveIndex = static_cast<unsigned>(0.5 + curveVirtualIndex);
-
-                        curveVirtualIndex += curvePointsPerFrame;
-
-                        // Bounds check.
-                        if (curveIndex < numberOfCurvePoints)
-                            value = curveData[curveIndex];
-
-                        values[writeIndex] = value;
+                        const float virtualIndex = std::min(lastIndex,
+                            static_cast<float>(curveStartIndex + curvePointsPerFrame * (writeIndex - firstFrame)));
+                        const size_t index = static_cast<size_t>(virtualIndex);
+                        const size_t next = std::min(index + 1, numberOfCurvePoints - 1);
+                        const float fraction = virtualIndex - static_cast<float>(index);
+                        values[writeIndex] = curveData[index] + (curveData[next] - curveData[index]) * fraction;
                     }
+                    if (writeIndex > firstFrame)
+                        value = values[writeIndex - 1];
 
                     // If there's any time left after the duration of this event and the start
                     // of the next, then just propagate the last value.
@@ -9,8 +9,10 @@
 #include "LabSound/extended/AudioContextLock.h"
 
 #include "internal/Assertions.h"
+#include "internal/DeferredRelease.h"
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 
 #include "LabSound/core/ConcurrentQueue.h"
@@ -22,15 +24,25 @@ lab::ConcurrentQueue<std::shared_ptr<AudioSummingJunction>> s_dirtySummingJuncti
 
 namespace
 {
-    std::mutex junctionMutex;
+    std::atomic<uint64_t> s_connectionGeneration {0};
+}
+
+uint64_t AudioSummingJunction::connectionGeneration()
+{
+    return s_connectionGeneration.load(std::memory_order_acquire);
 }
 
 void AudioSummingJunction::handleDirtyAudioSummingJunctions(ContextRenderLock & r)
 {
     ASSERT(r.context());
+    // the queue may hold the last reference to a junction, and the junction to its outputs'
+    // nodes, so they are released on the reclaim thread
     std::shared_ptr<AudioSummingJunction> asj;
     while (s_dirtySummingJunctions.try_pop(asj))
+    {
         asj->updateRenderingState(r);
+        DeferredRelease::shared().release(std::move(asj));
+    }
 }
 
 AudioSummingJunction::AudioSummingJunction()
@@ -42,7 +54,7 @@ AudioSummingJunction::~AudioSummingJunction() {}
 
 bool AudioSummingJunction::isConnected(std::shared_ptr<AudioNodeOutput> o) const
 {
-    std::lock_guard<std::mutex> lock(junctionMutex);
+    std::lock_guard<std::mutex> lock(m_junctionMutex);
 
     for (auto i : m_connectedOutputs)
         if (i.lock() == o)
@@ -51,6 +63,17 @@ bool AudioSummingJunction::isConnected(std::shared_ptr<AudioNodeOutput> o) const
     return false;
 }
 
+std::vector<std::shared_ptr<AudioNodeOutput>> AudioSummingJunction::connectedOutputs() const
+{
+    std::lock_guard<std::mutex> lock(m_junctionMutex);
+
+    std::vector<std::shared_ptr<AudioNodeOutput>> outputs;
+    for (auto & i : m_connectedOutputs)
+        if (auto o = i.lock())
+            outputs.push_back(std::move(o));
+    return outputs;
+}
+
 int AudioSummingJunction::numberOfRenderingConnections(ContextRenderLock &) const
 {
     int count = 0;
@@ -67,7 +90,7 @@ void AudioSummingJunction::junctionConnectOutput(std::shared_ptr<AudioNodeOutput
     if (!o)
         return;
 
-    std::lock_guard<std::mutex> lock(junctionMutex);
+    std::lock_guard<std::mutex> lock(m_junctionMutex);
 
     for (std::vector<std::weak_ptr<AudioNodeOutput>>::iterator i = m_connectedOutputs.begin(); i != m_connectedOutputs.end();)
         if (i->expired())
@@ -81,6 +104,7 @@ void AudioSummingJunction::junctionConnectOutput(std::shared_ptr<AudioNodeOutput
 
     m_connectedOutputs.push_back(o);
     m_renderingStateNeedUpdating = true;
+    s_connectionGeneration.fetch_add(1, std::memory_order_release);
 }
 
 void AudioSummingJunction::junctionDisconnectOutput(std::shared_ptr<AudioNodeOutput> o)
@@ -88,22 +112,24 @@ void AudioSummingJunction::junctionDisconnectOutput(std::shared_ptr<AudioNodeOut
     if (!o)
         return;
 
-    std::lock_guard<std::mutex> lock(junctionMutex);
+    std::lock_guard<std::mutex> lock(m_junctionMutex);
 
     for (std::vector<std::weak_ptr<AudioNodeOutput>>::iterator i = m_connectedOutputs.begin(); i != m_connectedOutputs.end(); ++i)
         if (!i->expired() && i->lock() == o)
         {
             m_connectedOutputs.erase(i);
             m_renderingStateNeedUpdating = true;
+            s_connectionGeneration.fetch_add(1, std::memory_order_release);
             break;
         }
 }
 
 void AudioSummingJunction::junctionDisconnectAllOutputs()
 {
-    std::lock_guard<std::mutex> lock(junctionMutex);
+    std::lock_guard<std::mutex> lock(m_junctionMutex);
     m_connectedOutputs.clear();
     m_renderingStateNeedUpdating = true;
+    s_connectionGeneration.fetch_add(1, std::memory_order_release);
 }
 
 void AudioSummingJunction::changedOutputs(ContextGraphLock &)
@@ -118,18 +144,22 @@ void AudioSummingJunction::updateRenderingState(ContextRenderLock & r)
 {
     if (r.context() && m_renderingStateNeedUpdating)
     {
-        std::lock_guard<std::mutex> lock(junctionMutex);
+        std::lock_guard<std::mutex> lock(m_junctionMutex);
 
         // Copy from m_outputs to m_renderingOutputs.
         m_renderingOutputs.clear();
+        // an output locked here may outlive its last other reference, so it is released on
+        // the reclaim thread rather than destroyed on the audio thread
         for (std::vector<std::weak_ptr<AudioNodeOutput>>::iterator i = m_connectedOutputs.begin(); i != m_connectedOutputs.end(); ++i)
-            if (!i->expired())
+            if (std::shared_ptr<AudioNodeOutput> output = i->lock())
             {
                 m_renderingOutputs.push_back(*i);
-                i->lock()->updateRenderingState(r);
+                output->updateRenderingState(r);
+                DeferredRelease::shared().release(std::move(output));
             }
 
         m_renderingStateNeedUpdating = false;
+        ++m_renderingVersion;
     }
 }
 
@@ -11,7 +11,14 @@
 #include "LabSound/extended/Registry.h"
 
 #include "internal/Biquad.h"
+#include "internal/BiquadBank.h"
+#include "internal/BiquadResponse.h"
+#include "internal/StateVariableFilter.h"
+
 #include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
 
 namespace lab
 {
@@ -21,6 +28,9 @@ static char const * const s_filter_types[FilterType::_FilterTypeCount + 1] = {
     "Low Pass", "High Pass", "Band Pass", "Low Shelf", "High Shelf", "Peaking", "Notch", "All Pass",
     nullptr};
 
+static char const * const s_topologies[BiquadFilterNode::Topology::_TopologyCount + 1] = {
+    "Biquad", "State Variable", nullptr};
+
 static AudioParamDescriptor s_bqParams[] = {
     {"frequency", "FREQ", 350.0, 10.0, 22500.0},
     {"Q", "Q   ", 1.0, 0.0001, 1000.0},
@@ -30,10 +40,12 @@ static AudioParamDescriptor s_bqParams[] = {
 
 static AudioSettingDescriptor s_bqSettings[] = {
     {"type", "TYPE", SettingType::Enum, s_filter_types},
+    {"topology", "TOPO", SettingType::Enum, s_topologies},
+    {"controlInterval", "CTLI", SettingType::Integer},
     nullptr};
 
 AudioNodeDescriptor* BiquadFilterNode::desc() {
-    static AudioNodeDescriptor d {s_bqParams, s_bqSettings, 0};
+    static AudioNodeDescriptor d {s_bqParams, s_bqSettings, 1};
     return &d;
 }
 
@@ -59,6 +71,16 @@ public:
             if (type > static_cast<uint32_t>(FilterType::ALLPASS)) throw std::out_of_range("Filter type exceeds index of known types");
             m_hasJustReset = true;  // reset filter coeffs
         });
+
+        m_topology = self->setting("topology");
+        m_topology->setEnumeration(static_cast<int>(BiquadFilterNode::BIQUAD));
+        m_topology->setValueChanged([this]() {
+            m_hasJustReset = true;  // the other topology's state is stale
+            m_topologyChanged = true;
+        });
+
+        m_controlInterval = self->setting("controlInterval");
+        m_controlInterval->setUint32(32);
     }
 
     virtual ~BiquadFilterNodeInternal() 
@@ -70,26 +92,86 @@ public:
 
     virtual void process(ContextRenderLock & r,  const lab::AudioBus * sourceBus, lab::AudioBus * destinationBus, int framesToProcess) override
     {
+        if (m_topologyChanged)
+        {
+            m_topologyChanged = false;
+            m_bank.reset();
+            m_svf.reset();
+        }
+
+        const bool snap = m_hasJustReset;
         checkForDirtyCoefficients(r);
-        updateCoefficientsIfNecessary(r, true, false);
-        the_filter->process(sourceBus->channel(0)->data(), destinationBus->channel(0)->mutableData(), framesToProcess);
+
+        // every channel is filtered, several at once
+        const int channels = std::min(sourceBus->numberOfChannels(), destinationBus->numberOfChannels());
+        if (static_cast<int>(m_sources.size()) < channels)
+        {
+            m_sources.resize(channels);
+            m_destinations.resize(channels);
+        }
+
+        const double nyquist = r.context()->sampleRate() * 0.5;
+        if (!m_hasSampleAccurateValues)
+        {
+            // The smoothed values change at most once a quantum. The coefficients designed
+            // for them are ramped to across the quantum, rather than stepped to.
+            bind(sourceBus, destinationBus, channels, 0);
+            if (!m_filterCoefficientsDirty)
+                run(channels, framesToProcess, false);
+            else
+            {
+                design(nyquist, m_frequency->smoothedValue(), m_q->smoothedValue(), m_gain->smoothedValue(), m_detune->smoothedValue());
+                if (snap)
+                    commit();
+                run(channels, framesToProcess, !snap);
+            }
+        }
+        else
+        {
+            // The automated values are followed at the control interval: the coefficients
+            // are designed for the value at the end of each sub-block, and ramped to across it.
+            if (static_cast<int>(m_scratch.size()) < 4 * framesToProcess)
+                m_scratch.resize(4 * framesToProcess);
+            const AudioParamBlock frequency = m_frequency->calculateSampleAccurateBlock(r, &m_scratch[0], framesToProcess);
+            const AudioParamBlock q = m_q->calculateSampleAccurateBlock(r, &m_scratch[framesToProcess], framesToProcess);
+            const AudioParamBlock gain = m_gain->calculateSampleAccurateBlock(r, &m_scratch[2 * framesToProcess], framesToProcess);
+            const AudioParamBlock detune = m_detune->calculateSampleAccurateBlock(r, &m_scratch[3 * framesToProcess], framesToProcess);
+
+            // nothing moves within the quantum, so one design will do
+            const bool constant = frequency.isConstant() && q.isConstant() && gain.isConstant() && detune.isConstant();
+            const int interval = constant ? framesToProcess :
+                std::max(1, std::min(framesToProcess, static_cast<int>(m_controlInterval->valueUint32())));
+
+            for (int start = 0; start < framesToProcess; start += interval)
+            {
+                const int count = std::min(interval, framesToProcess - start);
+                const int last = start + count - 1;
+                design(nyquist, frequency.valueAt(last), q.valueAt(last), gain.valueAt(last), detune.valueAt(last));
+                if (snap && !start)
+                    commit();
+                bind(sourceBus, destinationBus, channels, start);
+                run(channels, count, !(snap && !start));
+            }
+        }
+
+        for (int i = channels; i < destinationBus->numberOfChannels(); ++i)
+            destinationBus->channel(i)->zero();
     }
 
-    virtual void reset() override {}
+    virtual void reset() override
+    {
+        m_bank.reset();
+        m_svf.reset();
+        m_hasJustReset = true;
+    }
     virtual double tailTime(ContextRenderLock & r) const override { return 0.25f; } // fixed 250ms
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
     // To prevent audio glitches when parameters are changed,
     // dezippering is used to slowly change the parameters.
-    // |useSmoothing| implies that we want to update using the
-    // smoothed values. Otherwise the final target values are
-    // used. If |forceUpdate| is true, we update the coefficients even
-    // if they are not dirty. (Used when computing the frequency
-    // response.)
     void checkForDirtyCoefficients(ContextRenderLock & r)
     {
         // Deal with smoothing / de-zippering. Start out assuming filter parameters are not changing.
-        // The BiquadDSPKernel objects rely on this value to see if they need to re-compute their internal filter coefficients.
         m_filterCoefficientsDirty = false;
         m_hasSampleAccurateValues = false;
 
@@ -108,7 +190,6 @@ public:
                 m_gain->resetSmoothedValue();
                 m_detune->resetSmoothedValue();
                 m_filterCoefficientsDirty = true;
-                m_hasJustReset = false;
             }
             else
             {
@@ -120,71 +201,88 @@ public:
                 if (!(isStable1 && isStable2 && isStable3 && isStable4)) m_filterCoefficientsDirty = true;
             }
         }
+        m_hasJustReset = false;
     }
 
-    void updateCoefficientsIfNecessary(ContextRenderLock & r, bool useSmoothing, bool forceUpdate)
+    // Designs the target coefficients of the current topology for the given values
+    void design(double nyquist, double freq, double q_val, double gain, double detune)
     {
-        /* bool isStable1 = */ m_frequency->smooth(r);
-        /* bool isStable2 = */ m_q->smooth(r);
-        /* bool isStable3 = */ m_gain->smooth(r);
-        /* bool isStable4 = */ m_detune->smooth(r);
-        
-        if (forceUpdate || m_filterCoefficientsDirty)
+        // Convert from Hertz to normalized frequency 0 -> 1.
+        double normalizedFrequency = freq / nyquist;
+
+        // Offset frequency by detune
+        if (detune)
         {
-            double freq;
-            double q_val;
-            double gain;
-            double detune;
+            normalizedFrequency *= std::pow(2.0, detune / 1200.0);
+        }
 
-            if (m_hasSampleAccurateValues)
-            {
-                /// @fixme these values should be per sample, not per quantum
-                freq = m_frequency->finalValue(r);
-                q_val = m_q->finalValue(r);
-                gain = m_gain->finalValue(r);
-                detune = m_detune->finalValue(r);
-            }
-            else if (useSmoothing)
-            {
-                /// @fixme these values should be per sample, not per quantum
-                freq = m_frequency->smoothedValue();
-                q_val = m_q->smoothedValue();
-                gain = m_gain->smoothedValue();
-                detune = m_detune->smoothedValue();
-            }
-            else
-            {
-                freq = m_frequency->value();
-                q_val = m_q->value();
-                gain = m_gain->value();
-                detune = m_detune->value();
-            }
+        const FilterType type = static_cast<FilterType>(m_type->valueUint32());
+        if (m_topology->valueUint32() == BiquadFilterNode::STATE_VARIABLE)
+        {
+            m_svfTarget = StateVariableFilter::design(type, normalizedFrequency, q_val, gain);
+            return;
+        }
 
-            // Convert from Hertz to normalized frequency 0 -> 1.
-            double nyquist = r.context()->sampleRate() * 0.5f;
-            double normalizedFrequency = freq / nyquist;
+        designBiquad(*the_filter, type, normalizedFrequency, q_val, gain, m_biquadTarget);
+    }
 
-            // Offset frequency by detune
-            if (detune)
-            {
-                normalizedFrequency *= std::pow(2.0, detune / 1200.0);
-            }
+    // Configures the biquad with the filter parameters for the appropriate type of filter,
+    // and returns its coefficients; a type without a filter passes its input through.
+    static void designBiquad(Biquad & biquad, FilterType type, double normalizedFrequency, double q_val, double gain, double * coefficients)
+    {
+        // clang-format off
+        switch (type)
+        {
+            case FilterType::LOWPASS:   biquad.setLowpassParams(normalizedFrequency, q_val);       break;
+            case FilterType::HIGHPASS:  biquad.setHighpassParams(normalizedFrequency, q_val);      break;
+            case FilterType::BANDPASS:  biquad.setBandpassParams(normalizedFrequency, q_val);      break;
+            case FilterType::LOWSHELF:  biquad.setLowShelfParams(normalizedFrequency, gain);       break;
+            case FilterType::HIGHSHELF: biquad.setHighShelfParams(normalizedFrequency, gain);      break;
+            case FilterType::PEAKING:   biquad.setPeakingParams(normalizedFrequency, q_val, gain); break;
+            case FilterType::NOTCH:     biquad.setNotchParams(normalizedFrequency, q_val);         break;
+            case FilterType::ALLPASS:   biquad.setAllpassParams(normalizedFrequency, q_val);        break;
+            default:
+                coefficients[0] = 1;
+                coefficients[1] = coefficients[2] = coefficients[3] = coefficients[4] = 0;
+                return;
+        }
+        // clang-format on
+        biquad.getCoefficients(coefficients[0], coefficients[1], coefficients[2], coefficients[3], coefficients[4]);
+    }
 
-            // Configure the biquad with the new filter parameters for the appropriate type of filter.
-            // clang-format off
-            switch (m_type->valueUint32())
-            {
-                case FilterType::LOWPASS:   the_filter->setLowpassParams(normalizedFrequency, q_val);       break;
-                case FilterType::HIGHPASS:  the_filter->setHighpassParams(normalizedFrequency, q_val);      break;
-                case FilterType::BANDPASS:  the_filter->setBandpassParams(normalizedFrequency, q_val);      break;
-                case FilterType::LOWSHELF:  the_filter->setLowShelfParams(normalizedFrequency, gain);       break;
-                case FilterType::HIGHSHELF: the_filter->setHighShelfParams(normalizedFrequency, gain);      break;
-                case FilterType::PEAKING:   the_filter->setPeakingParams(normalizedFrequency, q_val, gain); break;
-                case FilterType::NOTCH:     the_filter->setNotchParams(normalizedFrequency, q_val);         break;
-                case FilterType::ALLPASS:   the_filter->setAllpassParams(normalizedFrequency, q_val);        break;
-                default: break;
-            }
-            // clang-format on
+    // Makes the target coefficients current without a ramp
+    void commit()
+    {
+        if (m_topology->valueUint32() == BiquadFilterNode::STATE_VARIABLE)
+            m_svf.setCoefficients(m_svfTarget);
+        else
+            m_bank.setSectionCoefficients(0, m_biquadTarget[0], m_biquadTarget[1], m_biquadTarget[2], m_biquadTarget[3], m_biquadTarget[4]);
+    }
+
+    void bind(const AudioBus * sourceBus, AudioBus * destinationBus, int channels, int offset)
+    {
+        for (int i = 0; i < channels; ++i)
+        {
+            m_sources[i] = sourceBus->channel(i)->data() + offset;
+            m_destinations[i] = destinationBus->channel(i)->mutableData() + offset;
+        }
+    }
+
+    void run(int channels, int frames, bool ramp)
+    {
+        if (m_topology->valueUint32() == BiquadFilterNode::STATE_VARIABLE)
+        {
+            if (ramp)
+                m_svf.processRamped(m_sources.data(), m_destinations.data(), channels, frames, m_svfTarget);
+            else
+                m_svf.process(m_sources.data(), m_destinations.data(), channels, frames);
+        }
+        else
+        {
+            if (ramp)
+                m_bank.processRamped(m_sources.data(), m_destinations.data(), channels, frames, m_biquadTarget);
+            else
+                m_bank.process(m_sources.data(), m_destinations.data(), channels, frames);
         }
     }
 
@@ -195,13 +293,25 @@ public:
 
         size_t n = std::min(frequencyHz.size(), std::min(magResponse.size(), phaseResponse.size()));
 
-        // @todo
-        if (n)
-        {
-            // std::unique_ptr<BiquadDSPKernel> responseKernel(new BiquadDSPKernel(this));
-            // responseKernel->getFrequencyResponse(r, nFrequencies, frequencyHz, magResponse, phaseResponse);
-            //biquadProcessor()->getFrequencyResponse(r, n, &frequencyHz[0], &magResponse[0], &phaseResponse[0]);
-        }
+        // The response is of the params' current values, designed apart from the render
+        // thread's filter. Both topologies have the biquad's response.
+        std::lock_guard<std::mutex> lock(m_responseMutex);
+        const double nyquist = r.context()->sampleRate() * 0.5;
+        m_responseFrequencies.resize(n);
+        for (size_t k = 0; k < n; ++k)
+            m_responseFrequencies[k] = static_cast<float>(frequencyHz[k] / nyquist);
+        m_response.setFrequencies(m_responseFrequencies.data(), static_cast<int>(n));
+
+        double normalizedFrequency = m_frequency->value() / nyquist;
+        if (m_detune->value())
+            normalizedFrequency *= std::pow(2.0, m_detune->value() / 1200.0);
+
+        Biquad design;
+        double coefficients[5];
+        designBiquad(design, static_cast<FilterType>(m_type->valueUint32()), normalizedFrequency, m_q->value(), m_gain->value(), coefficients);
+        m_response.evaluate(coefficients, 1);
+        std::copy(m_response.magnitude(), m_response.magnitude() + n, magResponse.begin());
+        std::copy(m_response.phase(), m_response.phase() + n, phaseResponse.begin());
     }
 
     // so DSP kernels know when to re-compute coefficients
@@ -211,14 +321,32 @@ public:
     bool m_hasSampleAccurateValues {false};
 
     bool m_hasJustReset {true};
+    bool m_topologyChanged {false};
 
     std::shared_ptr<AudioSetting> m_type;
+    std::shared_ptr<AudioSetting> m_topology;
+    std::shared_ptr<AudioSetting> m_controlInterval;
     std::shared_ptr<AudioParam> m_frequency;
     std::shared_ptr<AudioParam> m_q;
     std::shared_ptr<AudioParam> m_gain;
     std::shared_ptr<AudioParam> m_detune;
 
+    // the_filter designs the coefficients, which the bank runs over every channel
     std::unique_ptr<Biquad> the_filter;
+    BiquadBank m_bank;
+    double m_biquadTarget[5] = {1, 0, 0, 0, 0};
+
+    StateVariableFilter m_svf;
+    StateVariableFilter::Coefficients m_svfTarget;
+
+    std::vector<const float *> m_sources;
+    std::vector<float *> m_destinations;
+    std::vector<float> m_scratch;  // automated values of the four params
+
+    // for getFrequencyResponse, from the main thread
+    std::mutex m_responseMutex;
+    BiquadResponse m_response;
+    std::vector<float> m_responseFrequencies;
 };
  
 BiquadFilterNode::BiquadFilterNode(AudioContext & ac)
@@ -244,6 +372,26 @@ void BiquadFilterNode::getFrequencyResponse(ContextRenderLock & r, const std::ve
     biquad_impl->getFrequencyResponse(r, frequencyHz, magResponse, phaseResponse);
 }
 
+BiquadFilterNode::Topology BiquadFilterNode::topology() const
+{
+    return static_cast<Topology>(biquad_impl->m_topology->valueUint32());
+}
+
+void BiquadFilterNode::setTopology(Topology topology)
+{
+    biquad_impl->m_topology->setEnumeration(static_cast<int>(topology));
+}
+
+int BiquadFilterNode::controlInterval() const
+{
+    return static_cast<int>(biquad_impl->m_controlInterval->valueUint32());
+}
+
+void BiquadFilterNode::setControlInterval(int frames)
+{
+    biquad_impl->m_controlInterval->setUint32(static_cast<uint32_t>(std::max(1, frames)));
+}
+
 FilterType BiquadFilterNode::type() const
 {
     return (FilterType) biquad_impl->m_type->valueUint32();
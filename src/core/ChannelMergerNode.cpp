@@ -59,27 +59,19 @@ void ChannelMergerNode::process(ContextRenderLock & r, int bufferSize)
     if b < a copy 1:1 up to b, then ignore the other channels
     */
 
-    for (int i = 0; i < m_desiredNumberOfOutputChannels; ++i)
-    {
-        // initialize sum
-        output->bus(r)->channel(i)->zero();
-    }
-
+    // Each output channel refers to its input's samples rather than copying them; a consumer
+    // that writes to the output, such as a node processing in place, copies them first.
+    AudioBus * destination = output->bus(r);
     int in = numberOfInputs();
     for (int c = 0; c < m_desiredNumberOfOutputChannels; ++c)
     {
-        AudioChannel * outputChannel = output->bus(r)->channel(c);
-        if (c < in) 
-        {
-            auto input = this->input(c);
-            if (input->isConnected())
-            {
-                AudioChannel * inputChannel = input->bus(r)->channel(0);
-                outputChannel->sumFrom(inputChannel);
-            }
-        }
+        AudioChannel * outputChannel = destination->channel(c);
+        auto input = c < in ? this->input(c) : nullptr;
+        if (input && input->isConnected())
+            outputChannel->alias(input->bus(r)->channel(0));
+        else
+            outputChannel->zero();
     }
 }
 
-
 }  // namespace lab
@@ -52,9 +52,10 @@ void ChannelSplitterNode::process(ContextRenderLock & r, int bufferSize)
 
         if (i < numberOfSourceChannels)
         {
-            // Split the channel out if it exists in the source.
-            // It would be nice to avoid the copy and simply pass along pointers, but this becomes extremely difficult with fanout and fanin.
-            destination->channel(0)->copyFrom(source->channel(i));
+            // Split the channel out if it exists in the source. The output refers to the source's
+            // samples rather than copying them; a consumer that writes to the output, such as a
+            // node processing in place, copies them first.
+            destination->channel(0)->alias(source->channel(i));
         }
         else if (output(i)->renderingFanOutCount() > 0)
         {
@@ -27,7 +27,7 @@ AudioNodeDescriptor * ConstantSourceNode::desc()
 
 ConstantSourceNode::ConstantSourceNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
-, m_sampleAccurateOffsetValues(AudioNode::ProcessingSizeInFrames)
+, m_sampleAccurateOffsetValues(renderQuantumSize())
 {
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
     m_offset = param("offset");
@@ -50,6 +50,11 @@ void ConstantSourceNode::process(ContextRenderLock & r, int bufferSize)
     return process_internal(r, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
 }
 
+void ConstantSourceNode::processRange(ContextRenderLock & r, int bufferSize, int offset, int count)
+{
+    process_internal(r, bufferSize, offset, count);
+}
+
 void ConstantSourceNode::process_internal(ContextRenderLock & r, int bufferSize, int offset, int count)
 {
     AudioBus * outputBus = output(0)->bus(r);
@@ -75,24 +80,24 @@ void ConstantSourceNode::process_internal(ContextRenderLock & r, int bufferSize,
         m_sampleAccurateOffsetValues.allocate(bufferSize);
     }
 
+    // An offset that holds for the whole quantum is passed on as a constant, which consumers
+    // use without the samples being written.
+    const bool wholeQuantum = offset == 0 && nonSilentFramesToProcess == bufferSize;
+
     // fetch the constants
     float * offsets = m_sampleAccurateOffsetValues.data();
-    if (m_offset->hasSampleAccurateValues())
+    AudioParamBlock block = m_offset->smoothBlock(r, offsets, bufferSize);
+    if (wholeQuantum && block.isConstant())
     {
-        m_offset->calculateSampleAccurateValues(r, offsets, bufferSize);
-    }
-    else
-    {
-        m_offset->smooth(r);
-        float val = m_offset->smoothedValue();
-        for (int i = 0; i < bufferSize; ++i) offsets[i] = val;
+        for (int c = 0; c < outputBusChannelCount; ++c)
+            outputBus->channel(c)->setConstant(block.value);
+        return;
     }
+    block.render(offsets, bufferSize);
 
-    for (int c = 0; c < outputBus->numberOfChannels(); c++)
+    for (int c = 0; c < outputBusChannelCount; c++)
     {
-        float * destination = outputBus->channel(c)->mutableData() + offset;
-        const double sample_rate = (double) r.context()->sampleRate();
-
+        float * destination = outputBus->channel(c)->mutableData();
         for (int i = offset; i < offset + nonSilentFramesToProcess; ++i)
         {
             destination[i] = offsets[i];
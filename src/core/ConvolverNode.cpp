@@ -4,12 +4,19 @@
 
 #include "LabSound/core/ConvolverNode.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/JobSystem.h"
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/VectorMath.h"
+
+#include "internal/PartitionedConvolver.h"
+
+#include <algorithm>
 #include <cmath>
+#include <string.h>
 
 namespace lab
 {
@@ -17,20 +24,6 @@ namespace lab
 using std::isinf;
 using std::isnan;
 
-// from _SoundPipe_FFT.cpp
-struct sp_conv;
-struct sp_data;
-struct sp_ftbl;
-typedef float SPFLOAT;
-int sp_create(sp_data ** spp);
-int sp_destroy(sp_data ** spp);
-int sp_conv_compute(sp_data * sp, sp_conv * p, SPFLOAT * in, SPFLOAT * out);
-int sp_conv_create(sp_conv ** p);
-int sp_conv_destroy(sp_conv ** p);
-int sp_conv_init(sp_data * sp, sp_conv * p, sp_ftbl * ft, SPFLOAT iPartLen);
-int sp_ftbl_destroy(sp_ftbl ** ft);
-int sp_ftbl_bind(sp_data * sp, sp_ftbl ** ft, SPFLOAT * tbl, size_t size);
-
 //------------------------------------------------------------------------------
 // calculateNormalizationScale is adapted from webkit's Reverb.cpp, and carried the license:
 // calculateNormalizationScale license: BSD 3 Clause, Copyright (C) 2010, Google Inc. All rights reserved.
@@ -43,7 +36,7 @@ const float GainCalibrationSampleRate = 44100;
 // A minimum power value to when normalizing a silent (or very quiet) impulse response
 const float MinPower = 0.000125f;
 
-static float calculateNormalizationScale(AudioBus * response)
+static float calculateNormalizationScale(const AudioBus * response)
 {
     // Normalize by RMS power
     size_t numberOfChannels = response->numberOfChannels();
@@ -81,27 +74,160 @@ static float calculateNormalizationScale(AudioBus * response)
 
 //------------------------------------------------------------------------------
 
-ConvolverNode::ReverbKernel::ReverbKernel(ReverbKernel && rh) noexcept
-    : conv(rh.conv)
-    , ft(rh.ft)
+// the previous impulse response fades out over this many render quanta
+const int CrossfadeQuanta = 4;
+
+// The tail of a response holding less than this share of its energy, -80 dB, is trimmed.
+// A recorded response usually ends in a long stretch of its noise floor.
+const double TrimmedEnergy = 1.e-8;
+
+static size_t trimmedLength(const AudioBus * response)
 {
-    rh.conv = nullptr;
-    rh.ft = nullptr;
+    const int channels = static_cast<int>(response->numberOfChannels());
+    const size_t length = response->length();
+
+    double total = 0;
+    for (int c = 0; c < channels; ++c)
+    {
+        const float * data = response->channel(c)->data();
+        for (size_t i = 0; i < length; ++i)
+            total += double(data[i]) * data[i];
+    }
+
+    double tail = 0;
+    size_t trimmed = length;
+    while (trimmed > 1)
+    {
+        double frame = 0;
+        for (int c = 0; c < channels; ++c)
+        {
+            const float sample = response->channel(c)->data()[trimmed - 1];
+            frame += double(sample) * sample;
+        }
+        if (tail + frame > total * TrimmedEnergy)
+            break;
+        tail += frame;
+        --trimmed;
+    }
+    return trimmed;
 }
 
-ConvolverNode::ReverbKernel::~ReverbKernel()
+// Each engine convolves one channel of input with one or more of the impulse response's
+// channels, transforming the input once for all of them. A true stereo (four channel)
+// response has an engine per input channel, each with a response per output channel:
+// left to left, left to right, right to left, and right to right. Otherwise, output
+// channel i is input channel i convolved with response channel i; the first engine has
+// every response channel, so that a mono input is transformed once for all of them, and
+// the others have one each, for the remaining channels of a wider input. A mono response
+// is applied to each of a stereo pair.
+//
+// Offline, the engines share a batch, and the products of all their channels' partitions
+// are computed together once each has processed the quantum.
+struct ConvolverNode::KernelSet
 {
-    if (ft)
-        lab::sp_ftbl_destroy(&ft);
+    struct Engine
+    {
+        std::unique_ptr<PartitionedConvolver> convolver;
+        std::vector<int> outputs;  // the output channel of each response
+        bool idle = false;
+    };
+
+    std::unique_ptr<ConvolutionBatch> batch;  // offline only
+    std::vector<Engine> engines;
+    bool trueStereo = false;
+    int outputCount = 0;
+    int quantum = 0;
+    size_t length = 0;      // of the trimmed response, in frames
+    double tailTime = 0;
+
+    std::vector<float> results;  // a quantum per response
+    std::vector<float> mix;      // a quantum per output channel
+    std::vector<float> source;   // a quantum of input
+    std::vector<float *> dests;
+
+    void allocate(int frames)
+    {
+        quantum = frames;
+        size_t responses = 0;
+        for (auto & engine : engines)
+            responses = std::max(responses, engine.outputs.size());
+        results.assign(responses * frames, 0.f);
+        mix.assign(static_cast<size_t>(outputCount) * frames, 0.f);
+        source.assign(frames, 0.f);
+        dests.assign(responses, nullptr);
+    }
 
-    if (conv)
-        lab::sp_conv_destroy(&conv);
-}
+    float * output(int channel) { return mix.data() + channel * quantum; }
 
-//------------------------------------------------------------------------------
+    // Renders every output channel of the set. The engines run every frame of the quantum
+    // to keep their histories continuous; frames outside the scheduled region are silent.
+    void render(const AudioBus & inputBus, int offset, int length, bool waitForTail)
+    {
+        const int numInputChannels = static_cast<int>(inputBus.numberOfChannels());
+        std::fill(mix.begin(), mix.end(), 0.f);
+
+        for (size_t e = 0; e < engines.size(); ++e)
+        {
+            Engine & engine = engines[e];
+            const int responses = static_cast<int>(engine.outputs.size());
+
+            // the responses the input's channels call for
+            int channel = 0;
+            int active = responses;
+            if (trueStereo)
+                channel = std::min(static_cast<int>(e), numInputChannels - 1);
+            else if (e == 0)
+                active = numInputChannels == 1 ? responses : 1;
+            else if (numInputChannels > 1)
+                channel = std::min(static_cast<int>(e), numInputChannels - 1);
+            else
+                active = 0;
+
+            if (!active)
+            {
+                engine.idle = true;
+                continue;
+            }
+            if (engine.idle)
+            {
+                // its history is stale
+                engine.convolver->reset();
+                engine.idle = false;
+            }
+
+            const float * sourceP = inputBus.channel(channel)->data();
+            if (offset || length < quantum)
+            {
+                std::fill(source.begin(), source.end(), 0.f);
+                memcpy(source.data() + offset, sourceP + offset, sizeof(float) * length);
+                sourceP = source.data();
+            }
+
+            for (int i = 0; i < responses; ++i)
+                dests[i] = i < active ? results.data() + i * quantum : nullptr;
+            engine.convolver->process(sourceP, dests.data(), quantum, waitForTail);
+
+            for (int i = 0; i < active; ++i)
+            {
+                float * destP = output(engine.outputs[i]);
+                VectorMath::vadd(destP, 1, dests[i], 1, destP, 1, quantum);
+            }
+        }
+
+        if (batch)
+            batch->flush();
+    }
+
+    void reset()
+    {
+        for (auto & engine : engines)
+            engine.convolver->reset();
+    }
+};
 
 lab::AudioSettingDescriptor s_cSettings[] = {{"normalize", "NRML", SettingType::Bool},
-                                             {"impulseResponse", "IMPL", SettingType::Bus}, nullptr};
+                                             {"impulseResponse", "IMPL", SettingType::Bus},
+                                             {"halfPrecision", "HALF", SettingType::Bool}, nullptr};
 AudioNodeDescriptor * ConvolverNode::desc()
 {
     static AudioNodeDescriptor d {nullptr, s_cSettings, 1};
@@ -111,16 +237,16 @@ AudioNodeDescriptor * ConvolverNode::desc()
 ConvolverNode::ConvolverNode(AudioContext& ac)
 : AudioScheduledSourceNode(ac, *desc())
 {
-    _swap_ready = false;
+    _sampleRate.store(ac.sampleRate(), std::memory_order_relaxed);
+    _offline = ac.isOfflineContext();
 
     _normalize = setting("normalize");
     _normalize->setBool(true);
     _impulseResponseClip = setting("impulseResponse");
+    _halfPrecision = setting("halfPrecision");
 
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
 
-    lab::sp_create(&_sp);
-
     _impulseResponseClip->setValueChanged([this]() {
         this->_activateNewImpulse();
     });
@@ -130,8 +256,17 @@ ConvolverNode::ConvolverNode(AudioContext& ac)
 
 ConvolverNode::~ConvolverNode()
 {
-    _kernels.clear();
-    lab::sp_destroy(&_sp);
+    // a preparation in progress finishes, but nothing further is started
+    {
+        std::lock_guard<std::mutex> lock(_requestMutex);
+        _preparedSerial = _requestSerial;
+    }
+    JobSystem::shared().wait([this]() { return !_workerRunning.load(std::memory_order_acquire); }, JobPriority::Normal);
+
+    delete _incoming.exchange(nullptr, std::memory_order_acq_rel);
+    _collectRetired();
+    _kernels.reset();
+    _fading.reset();
     uninitialize();
 }
 
@@ -141,116 +276,220 @@ bool ConvolverNode::normalize() const
 }
 void ConvolverNode::setNormalize(bool new_n)
 {
-    bool n = normalize();
-    if (new_n == n)
+    if (new_n == normalize())
         return;
 
-    auto clip = _impulseResponseClip->valueBus();
-    if (clip)
-    {
-        size_t len = clip->length();
-        if (n && _scale != 1.f)
-        {
-            // undo previous normalization
-            float s = 1.f / _scale;
-            for (int i = 0; i < clip->numberOfChannels(); ++i)
-            {
-                float * data = clip->channel(i)->mutableData();
-                for (int j = 0; j < len; ++j)
-                    data[j] *= s;
-            }
-        }
-        if (!n)
-        {
-            // wasn't previously normalized, so normalize
-            _scale = calculateNormalizationScale(clip.get());
-            for (int i = 0; i < clip->numberOfChannels(); ++i)
-            {
-                float * data = clip->channel(i)->mutableData();
-                for (int j = 0; j < len; ++j)
-                    data[j] *= _scale;
-            }
-        }
-    }
-
     _normalize->setBool(new_n);
+
+    // the clip is shared and never scaled in place, so rebuild the kernels from it
+    if (_impulseResponseClip->valueBus())
+        _activateNewImpulse();
+}
+
+bool ConvolverNode::halfPrecision() const
+{
+    return _halfPrecision->valueBool();
+}
+void ConvolverNode::setHalfPrecision(bool half)
+{
+    if (half == halfPrecision())
+        return;
+
+    _halfPrecision->setBool(half);
+    if (_impulseResponseClip->valueBus())
+        _activateNewImpulse();
 }
 
-void ConvolverNode::setImpulse(std::shared_ptr<AudioBus> bus)
+void ConvolverNode::setImpulse(std::shared_ptr<const AudioBus> bus)
 {
     if (!bus)
         return; /// @TODO setting null should turn the convolver into a pass through?
 
-    /// @TODO setImpulse should return a promise of some sort, TBD, and when _activateNewImpulse
-    /// has run, the promise should be fulfilled.
-
-    auto new_bus = AudioBus::createByCloning(bus.get());
-    _impulseResponseClip->setBus(new_bus.get());    // setBus will invoke _activatNewImpulse()
+    _impulseResponseClip->setBus(std::move(bus));    // setBus will invoke _activatNewImpulse()
 }
 
 void ConvolverNode::_activateNewImpulse()
 {
-    /// @TODO Create the kernels on the main work thread, activate should simply copy
-    /// the data from the work thread.
     auto clip = _impulseResponseClip->valueBus();
-    size_t len = clip->length();
-    _scale = 1;
-    if (normalize())
+    if (!clip)
+        return;
+
+    _collectRetired();
+
+    // only the latest request is prepared; one superseded while it is being prepared
+    // is discarded when it is done
     {
-        _scale = calculateNormalizationScale(clip.get());
-        for (int i = 0; i < clip->numberOfChannels(); ++i)
+        std::lock_guard<std::mutex> lock(_requestMutex);
+        _requestClip = std::move(clip);
+        _requestNormalize = normalize();
+        _requestHalf = halfPrecision();
+        ++_requestSerial;
+        if (!_workerRunning.load(std::memory_order_relaxed))
         {
-            float * data = clip->channel(i)->mutableData();
-            for (int j = 0; j < len; ++j)
-                data[j] *= _scale;
+            // the previous job cleared the flag as its last act under the lock
+            _workerRunning.store(true, std::memory_order_relaxed);
+            JobSystem::shared().submit([this]() { _prepareImpulses(); }, JobPriority::Normal);
         }
     }
 
+    start(0);
+}
+
+void ConvolverNode::_prepareImpulses()
+{
+    // the partitions, made on a job's thread, are the node's
+    MemoryOwnerScope memoryScope(memoryOwner());
+    const int quantum = renderQuantumSize();
+    for (;;)
     {
-        std::unique_lock<std::mutex> kernel_guard(_kernel_mutex);
-        int c = static_cast<int>(clip->numberOfChannels());
-        for (int i = 0; i < c; ++i)
+        std::shared_ptr<const AudioBus> clip;
+        bool normalized;
+        bool half;
+        uint64_t serial;
         {
-            // create one kernel per IR channel
-            ReverbKernel kernel;
+            std::lock_guard<std::mutex> lock(_requestMutex);
+            if (_preparedSerial == _requestSerial)
+            {
+                _workerRunning.store(false, std::memory_order_release);
+                return;
+            }
+            clip = _requestClip;
+            normalized = _requestNormalize;
+            half = _requestHalf;
+            serial = _requestSerial;
+        }
 
-            // ft doesn't own the data; it does retain a pointer to it.
-            sp_ftbl_bind(_sp, &kernel.ft,
-                         clip->channel(0)->mutableData(), clip->channel(0)->length());
+        // the response is resampled to the rate the context renders at
+        std::unique_ptr<AudioBus> resampled;
+        const float sampleRate = _sampleRate.load(std::memory_order_relaxed);
+        if (sampleRate > 0 && clip->sampleRate() > 0 && clip->sampleRate() != sampleRate)
+        {
+            resampled = AudioBus::createBySampleRateConverting(clip.get(), false, sampleRate);
+            if (resampled && resampled->length())
+                clip.reset();
+            else
+                resampled.reset();
+        }
+        const AudioBus * response = resampled ? resampled.get() : clip.get();
+
+        // normalized as a whole, so that trimming doesn't change its loudness
+        float scale = normalized ? calculateNormalizationScale(response) : 1.f;
+        size_t len = trimmedLength(response);
+
+        // the clip may be shared with other nodes, so a normalized response is scaled into
+        // scratch copies, which the convolvers transform and then no longer need
+        const int c = std::min(static_cast<int>(response->numberOfChannels()), static_cast<int>(PartitionedConvolver::MaxResponses));
+        if (!c)
+        {
+            std::lock_guard<std::mutex> lock(_requestMutex);
+            _preparedSerial = std::max(_preparedSerial, serial);
+            continue;
+        }
 
-            sp_conv_create(&kernel.conv);
-            sp_conv_init(_sp, kernel.conv, kernel.ft, 8192);
+        std::vector<std::vector<float>> scaled(scale != 1.f ? c : 0);
+        std::vector<const float *> channels;
+        for (int i = 0; i < c; ++i)
+        {
+            const float * data = response->channel(i)->data();
+            if (!scaled.empty())
+            {
+                scaled[i].resize(len);
+                for (size_t j = 0; j < len; ++j)
+                    scaled[i][j] = data[j] * scale;
+                data = scaled[i].data();
+            }
+            channels.push_back(data);
+        }
+        if (c == 1)
+            channels.push_back(channels.front());
+
+        const PartitionedConvolver::Precision precision = half ? PartitionedConvolver::Precision::Half : PartitionedConvolver::Precision::Float;
+        std::unique_ptr<KernelSet> set(new KernelSet);
+        if (_offline)
+            set->batch.reset(new ConvolutionBatch());
+        auto addEngine = [&](const float * const * responses, const std::vector<int> & outputs)
+        {
+            KernelSet::Engine engine;
+            engine.convolver.reset(new PartitionedConvolver(responses, static_cast<int>(outputs.size()), static_cast<int>(len), quantum,
+                                                            precision, set->batch.get()));
+            engine.outputs = outputs;
+            set->engines.emplace_back(std::move(engine));
+        };
+
+        if (c == static_cast<int>(Channels::Quad))
+        {
+            set->trueStereo = true;
+            set->outputCount = 2;
+            addEngine(channels.data(), {0, 1});
+            addEngine(channels.data() + 2, {0, 1});
+        }
+        else
+        {
+            set->outputCount = static_cast<int>(channels.size());
+            std::vector<int> outputs;
+            for (int i = 0; i < set->outputCount; ++i)
+                outputs.push_back(i);
+            addEngine(channels.data(), outputs);
+            for (int i = 1; i < set->outputCount; ++i)
+                addEngine(channels.data() + i, {i});
+        }
+        set->allocate(quantum);
+        set->length = len;
+        if (sampleRate > 0 || response->sampleRate() > 0)
+            set->tailTime = double(len) / (sampleRate > 0 ? sampleRate : response->sampleRate());
 
-            _pending_kernels.emplace_back(std::move(kernel));
+        {
+            std::lock_guard<std::mutex> lock(_requestMutex);
+            _preparedSerial = std::max(_preparedSerial, serial);
+            if (serial != _requestSerial)
+                continue;
         }
-        _swap_ready = true;
+
+        // a set the audio thread hasn't picked up yet is replaced
+        delete _incoming.exchange(set.release(), std::memory_order_acq_rel);
     }
+}
 
-    start(0);
+void ConvolverNode::_collectRetired()
+{
+    delete _retired.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void ConvolverNode::_retireFading()
+{
+    // the slot is empty, as a new set is only taken up once the last retired set is gone
+    _retired.store(_fading.release(), std::memory_order_release);
 }
 
-std::shared_ptr<AudioBus> ConvolverNode::getImpulse() const
+std::shared_ptr<const AudioBus> ConvolverNode::getImpulse() const
 {
     return _impulseResponseClip->valueBus();
 }
 
 void ConvolverNode::process(ContextRenderLock & r, int bufferSize)
 {
-    if (_swap_ready) {
-        // this could cause an audio hiccough when swapping, but it's necessary to avoid a race
-        std::unique_lock<std::mutex> kernel_guard(_kernel_mutex);
-        _swap_ready = false;
-        std::swap(_kernels, _pending_kernels);
-        _pending_kernels.clear();
+    _sampleRate.store(r.context()->sampleRate(), std::memory_order_relaxed);
+
+    // take up a newly prepared set, fading the current one out
+    if (!_fading && !_retired.load(std::memory_order_acquire))
+    {
+        if (KernelSet * set = _incoming.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            _fading = std::move(_kernels);
+            _kernels.reset(set);
+            _fadeFrame = 0;
+        }
     }
 
     AudioBus * outputBus = output(0)->bus(r);
     AudioBus * inputBus = input(0)->bus(r);
 
-    if (!isInitialized() || !outputBus || !inputBus || !inputBus->numberOfChannels() || !_kernels.size())
+    if (!isInitialized() || !outputBus || !inputBus || !inputBus->numberOfChannels() || !_kernels)
     {
         if (outputBus)
             outputBus->zero();
+        if (_fading)
+            _retireFading();
         return;
     }
 
@@ -263,51 +502,80 @@ void ConvolverNode::process(ContextRenderLock & r, int bufferSize)
 
     int quantumFrameOffset = _self->_scheduler._renderOffset;
     int nonSilentFramesToProcess = _self->_scheduler._renderLength;
-
-    int numInputChannels = static_cast<int>(inputBus->numberOfChannels());
     int numOutputChannels = static_cast<int>(outputBus->numberOfChannels());
-    int numReverbChannels = static_cast<int>(_kernels.size());
 
-    if (!nonSilentFramesToProcess)
+    if (!nonSilentFramesToProcess || bufferSize != _kernels->quantum)
+    {
+        outputBus->zero();
+        if (_fading)
+            _retireFading();
+        return;
+    }
+
+    // Once the input has been silent for longer than the response, so is every engine's
+    // history, and they needn't run until it sounds again.
+    if (inputBus->isSilent())
+        _silentFrames += bufferSize;
+    else
+        _silentFrames = 0;
+    if (!_fading && _silentFrames > _kernels->length + bufferSize)
     {
         outputBus->zero();
         return;
     }
 
-    /// @todo should a situation such as 1:2:1 be invalid, or should it be powersum(1:1:1, 1:2:1)?
-    /// at the moment, this routine trivially does 1:1:1 only.
+    const bool offline = r.context()->isOfflineContext();
+    _kernels->render(*inputBus, quantumFrameOffset, nonSilentFramesToProcess, offline);
+    if (_fading)
+        _fading->render(*inputBus, quantumFrameOffset, nonSilentFramesToProcess, offline);
 
+    const int fadeFrames = CrossfadeQuanta * renderQuantumSize();
     for (int i = 0; i < numOutputChannels; ++i)
     {
-        int kernel = i < numReverbChannels ? i : numReverbChannels - 1;
-        lab::sp_conv * conv = _kernels[kernel].conv;
-        float* destP = outputBus->channel(i)->mutableData();
-        if (destP) {
-            destP += _self->_scheduler._renderOffset;
-
-            // Start rendering at the correct offset.
-            destP += quantumFrameOffset;
-            AudioBus * input_bus = input(0)->bus(r);
-            int in_channel = i < numInputChannels ? i : numInputChannels - 1;
-            float const* data = input_bus->channel(in_channel)->data() + quantumFrameOffset;
-            size_t c = input_bus->channel(in_channel)->length();
-            for (int j = 0; j < _self->_scheduler._renderLength; ++j)
+        // channels beyond the response's are silent
+        float * destP = outputBus->channel(i)->mutableData();
+        if (i < _kernels->outputCount)
+            memcpy(destP, _kernels->output(i), sizeof(float) * bufferSize);
+        else
+            memset(destP, 0, sizeof(float) * bufferSize);
+
+        if (_fading)
+        {
+            // linear, so that a response exchanged for a rescaled copy of itself doesn't swell
+            const float * fadeP = i < _fading->outputCount ? _fading->output(i) : nullptr;
+            for (int j = 0; j < bufferSize; ++j)
             {
-                lab::SPFLOAT in = j < c ? data[j] : 0.f;  // don't read off the end of the input buffer
-                lab::SPFLOAT out = 0.f;
-                lab::sp_conv_compute(_sp, conv, &in, &out);
-                *destP++ = out;
+                float g = std::min(1.f, float(_fadeFrame + j) / float(fadeFrames));
+                destP[j] = destP[j] * g + (fadeP ? fadeP[j] * (1.f - g) : 0.f);
             }
         }
     }
 
+    if (_fading)
+    {
+        _fadeFrame += bufferSize;
+        if (_fadeFrame >= fadeFrames)
+            _retireFading();
+    }
+
     _now += double(_self->_scheduler._renderLength) / r.context()->sampleRate();
     outputBus->clearSilentFlag();
 }
 
+double ConvolverNode::tailTime(ContextRenderLock & r) const
+{
+    double tail = _kernels ? _kernels->tailTime : 0;
+    if (_fading)
+        tail = std::max(tail, _fading->tailTime);
+    return tail;
+}
+
 void ConvolverNode::reset(ContextRenderLock &)
 {
-    _kernels.clear();
+    if (_fading)
+        _retireFading();
+    if (_kernels)
+        _kernels->reset();
 }
 
 bool ConvolverNode::propagatesSilence(ContextRenderLock & r) const
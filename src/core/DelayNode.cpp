@@ -7,17 +7,23 @@
 #include "LabSound/core/AudioProcessor.h"
 #include "LabSound/extended/Registry.h"
 
-#include "internal/AudioDSPKernel.h"
 #include "internal/DelayProcessor.h"
 
+#include <stdexcept>
+
 namespace lab
 {
 
-static AudioSettingDescriptor s_delayTimeSettings[] = {{"delayTime", "DELY", SettingType::Float}, nullptr};
+static char const * const s_interpolationModes[DelayNode::InterpolationMode::_Count + 1] = {
+    "Linear", "Allpass", "Lagrange", nullptr};
+
+static AudioSettingDescriptor s_delayTimeSettings[] = {
+    {"delayTime",     "DELY", SettingType::Float},
+    {"interpolation", "INTP", SettingType::Enum, s_interpolationModes}, nullptr};
 
 AudioNodeDescriptor * DelayNode::desc()
 {
-    static AudioNodeDescriptor d {nullptr, s_delayTimeSettings, 0};
+    static AudioNodeDescriptor d {nullptr, s_delayTimeSettings, 1};
     return &d;
 }
 
@@ -28,7 +34,7 @@ DelayNode::DelayNode(AudioContext& ac, double maxDelayTime)
         maxDelayTime = 0;  // delay node can't predict the future
 
     m_processor = std::make_unique<DelayProcessor>(ac.sampleRate(), 
-        maxDelayTime, setting("delayTime"));
+        maxDelayTime, setting("delayTime"), setting("interpolation"));
 
     initialize();
 }
@@ -38,6 +44,19 @@ std::shared_ptr<AudioSetting> DelayNode::delayTime()
     return delayProcessor()->delayTime();
 }
 
+DelayNode::InterpolationMode DelayNode::interpolation()
+{
+    return InterpolationMode(delayProcessor()->interpolation()->valueUint32());
+}
+
+void DelayNode::setInterpolation(InterpolationMode mode)
+{
+    if (mode >= InterpolationMode::_Count)
+        throw std::out_of_range("Interpolation argument exceeds known interpolation modes");
+
+    delayProcessor()->interpolation()->setUint32(uint32_t(mode));
+}
+
 DelayProcessor * DelayNode::delayProcessor()
 {
     return static_cast<DelayProcessor *>(processor());
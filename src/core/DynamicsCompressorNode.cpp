@@ -38,6 +38,7 @@ DynamicsCompressorNode::DynamicsCompressorNode(AudioContext& ac)
 : AudioNode(ac, *desc())
 {
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
 
     m_threshold = param("threshold");
     m_knee = param("knee");
@@ -88,7 +89,8 @@ void DynamicsCompressorNode::process(ContextRenderLock &r, int bufferSize)
     AudioBus* outputBus = output(0)->bus(r);
     ASSERT(outputBus && outputBus->numberOfChannels() == numberOfDestChannels);
 
-    m_dynamicsCompressor->process(r, input(0)->bus(r), outputBus, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
+    AudioBus * sidechainBus = input(1)->isConnected() ? input(1)->bus(r) : nullptr;
+    m_dynamicsCompressor->process(r, input(0)->bus(r), outputBus, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength, sidechainBus);
 
     float reduction = m_dynamicsCompressor->parameterValue(DynamicsCompressor::ParamReduction);
     m_reduction->setValue(reduction);
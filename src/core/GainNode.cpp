@@ -13,6 +13,8 @@
 
 #include "internal/Assertions.h"
 
+#include <math.h>
+
 namespace lab
 {
 
@@ -26,7 +28,7 @@ AudioNodeDescriptor * GainNode::desc()
 GainNode::GainNode(AudioContext& ac)
     : AudioNode(ac, *desc())
     , m_lastGain(1.f)
-    , m_sampleAccurateGainValues(AudioNode::ProcessingSizeInFrames)  // FIXME: can probably share temp buffer in context
+    , m_sampleAccurateGainValues(renderQuantumSize())  // FIXME: can probably share temp buffer in context
 {
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
 
@@ -42,10 +44,6 @@ GainNode::~GainNode()
 
 void GainNode::process(ContextRenderLock &r, int bufferSize)
 {
-    // FIXME: for some cases there is a nice optimization to avoid processing here, and let the gain change
-    // happen in the summing junction input of the AudioNode we're connected to.
-    // Then we can avoid all of the following:
-
     AudioBus * outputBus = output(0)->bus(r);
     ASSERT(outputBus);
 
@@ -73,6 +71,14 @@ void GainNode::process(ContextRenderLock &r, int bufferSize)
         outputBus = output(0)->bus(r);
     }
 
+    // If the only consumer of this node sums it with other connections, the gain can be applied as the consumer
+    // sums, saving a pass over the data. This is only possible when the whole quantum is rendered, as otherwise
+    // the zeroes and envelopes around a start or stop are applied to the output bus after processing.
+    const bool deferGain = _self->_scheduler._playbackState == SchedulingState::PLAYING &&
+                           _self->_scheduler._renderOffset == 0 && _self->_scheduler._renderLength == bufferSize &&
+                           inputBus != outputBus && outputBus->topologyMatches(*inputBus) &&
+                           output(0)->feedsSummingInput(r);
+
     if (gain()->hasSampleAccurateValues())
     {
         // Apply sample-accurate gain scaling for precise envelopes, grain windows, etc.
@@ -81,19 +87,53 @@ void GainNode::process(ContextRenderLock &r, int bufferSize)
         {
             float* gainValues_base = m_sampleAccurateGainValues.data();
             float* gainValues = gainValues_base + _self->_scheduler._renderOffset;
-            gain()->calculateSampleAccurateValues(r, gainValues, _self->_scheduler._renderLength);
+            AudioParamBlock gainBlock = gain()->calculateSampleAccurateBlock(r, gainValues, _self->_scheduler._renderLength);
+
+            // A gain that is constant over a whole quantum is applied as a scalar
+            if (gainBlock.isConstant() && _self->_scheduler._renderOffset == 0 && _self->_scheduler._renderLength == bufferSize)
+            {
+                m_lastGain = gainBlock.value;
+                if (deferGain)
+                {
+                    output(0)->deferGain(inputBus, nullptr, gainBlock.value);
+                    return;
+                }
+
+                outputBus->copyWithGainFrom(*inputBus, &m_lastGain, gainBlock.value);
+                outputBus->clearSilentFlag();
+                return;
+            }
+
+            gainBlock.render(gainValues, _self->_scheduler._renderLength);
             if (_self->_scheduler._renderOffset > 0)
                 memset(gainValues_base, 0, sizeof(float) * _self->_scheduler._renderOffset);
             int bzero_start = _self->_scheduler._renderOffset + _self->_scheduler._renderLength;
             if (bzero_start < bufferSize)
                 memset(gainValues_base + bzero_start, 0, sizeof(float) * bufferSize - bzero_start);
+
+            if (deferGain)
+            {
+                output(0)->deferGain(inputBus, m_sampleAccurateGainValues.data(), 1.f);
+                return;
+            }
+
             outputBus->copyWithSampleAccurateGainValuesFrom(*inputBus, m_sampleAccurateGainValues.data(), bufferSize);
         }
     }
     else
     {
+        // A gain within copyWithGainFrom's de-zippering epsilon of the target is applied as a constant, and
+        // so can be deferred.
+        const float targetGain = gain()->value();
+        if (deferGain && !outputBus->isFirstTime() && fabsf(targetGain - m_lastGain) < 0.001f)
+        {
+            m_lastGain = targetGain;
+            output(0)->deferGain(inputBus, nullptr, targetGain);
+            return;
+        }
+
         // Apply the gain with de-zippering into the output bus.
-        outputBus->copyWithGainFrom(*inputBus, &m_lastGain, gain()->value());
+        outputBus->copyWithGainFrom(*inputBus, &m_lastGain, targetGain);
     }
 
     outputBus->clearSilentFlag();
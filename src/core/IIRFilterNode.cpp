@@ -0,0 +1,201 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/IIRFilterNode.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioProcessor.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/Registry.h"
+
+#include "internal/BiquadBank.h"
+#include "internal/BiquadResponse.h"
+#include "internal/SecondOrderSections.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+namespace lab
+{
+
+AudioNodeDescriptor * IIRFilterNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+class IIRFilterNode::IIRFilterNodeInternal : public AudioProcessor
+{
+public:
+    IIRFilterNodeInternal(float sampleRate)
+        : AudioProcessor()
+        , sampleRate(sampleRate)
+    {
+    }
+
+    virtual ~IIRFilterNodeInternal() {}
+
+    virtual void initialize() override {}
+    virtual void uninitialize() override {}
+
+    virtual void process(ContextRenderLock & r,
+                         const lab::AudioBus * sourceBus, lab::AudioBus * destinationBus,
+                         int framesToProcess) override
+    {
+        // pick up new sections, if the main thread isn't in the middle of changing them
+        std::unique_lock<std::mutex> lock(sectionMutex, std::try_to_lock);
+        if (lock.owns_lock() && sectionsChanged)
+        {
+            const int count = static_cast<int>(sections.size() / 5);
+            bank.setNumberOfSections(count);
+            for (int i = 0; i < count; ++i)
+            {
+                const double * c = &sections[5 * i];
+                bank.setSectionCoefficients(i, c[0], c[1], c[2], c[3], c[4]);
+            }
+            renderTailTime = stagedTailTime;
+            sectionsChanged = false;
+        }
+        if (lock.owns_lock())
+            lock.unlock();
+
+        const int channels = std::min(sourceBus->numberOfChannels(), destinationBus->numberOfChannels());
+        if (static_cast<int>(sources.size()) < channels)
+        {
+            sources.resize(channels);
+            destinations.resize(channels);
+        }
+        for (int i = 0; i < channels; ++i)
+        {
+            sources[i] = sourceBus->channel(i)->data();
+            destinations[i] = destinationBus->channel(i)->mutableData();
+        }
+
+        bank.process(sources.data(), destinations.data(), channels, framesToProcess);
+
+        for (int i = channels; i < destinationBus->numberOfChannels(); ++i)
+            destinationBus->channel(i)->zero();
+    }
+
+    virtual void reset() override { bank.reset(); }
+    virtual double tailTime(ContextRenderLock & r) const override { return renderTailTime; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    const float sampleRate;
+
+    // staged by the main thread
+    mutable std::mutex sectionMutex;
+    std::vector<double> feedforward {1};
+    std::vector<double> feedback {1};
+    std::vector<double> sections {1, 0, 0, 0, 0};
+    double stagedTailTime = 0;
+    bool sectionsChanged = false;
+
+    // render thread state
+    BiquadBank bank;
+    double renderTailTime = 0;
+    std::vector<const float *> sources;
+    std::vector<float *> destinations;
+
+    // for getFrequencyResponse
+    std::mutex responseMutex;
+    BiquadResponse response;
+    std::vector<float> responseFrequencies;
+};
+
+IIRFilterNode::IIRFilterNode(AudioContext & ac)
+    : AudioBasicProcessorNode(ac, *desc())
+{
+    iir_impl = new IIRFilterNodeInternal(ac.sampleRate());
+    m_processor.reset(iir_impl);
+    initialize();
+}
+
+IIRFilterNode::IIRFilterNode(AudioContext & ac, const std::vector<double> & feedforward, const std::vector<double> & feedback)
+    : IIRFilterNode(ac)
+{
+    setCoefficients(feedforward, feedback);
+}
+
+IIRFilterNode::~IIRFilterNode()
+{
+    if (isInitialized()) uninitialize();
+}
+
+void IIRFilterNode::setCoefficients(const std::vector<double> & feedforward, const std::vector<double> & feedback)
+{
+    if (feedforward.empty() || feedforward.size() > MaxOrder + 1 || feedback.empty() || feedback.size() > MaxOrder + 1)
+        throw std::invalid_argument("IIRFilterNode takes from one to 21 coefficients of each kind");
+    if (feedback[0] == 0)
+        throw std::invalid_argument("IIRFilterNode's first feedback coefficient must not be zero");
+    if (std::all_of(feedforward.begin(), feedforward.end(), [](double c) { return c == 0; }))
+        throw std::invalid_argument("IIRFilterNode's feedforward coefficients must not all be zero");
+
+    std::vector<double> sections;
+    const double radius = decomposeToSections(feedforward, feedback, sections);
+    if (radius >= 1)
+        LOG_WARN("IIRFilterNode: the filter is unstable, with a pole at radius %f", radius);
+
+    // the time for the slowest pole to decay by 60 dB, within reason
+    double tail = 10;
+    if (radius <= 0)
+        tail = (feedback.size() + feedforward.size()) / iir_impl->sampleRate;
+    else if (radius < 1)
+        tail = std::min(tail, std::log(0.001) / std::log(radius) / iir_impl->sampleRate);
+
+    std::lock_guard<std::mutex> lock(iir_impl->sectionMutex);
+    iir_impl->feedforward = feedforward;
+    iir_impl->feedback = feedback;
+    iir_impl->sections = std::move(sections);
+    iir_impl->stagedTailTime = tail;
+    iir_impl->sectionsChanged = true;
+}
+
+std::vector<double> IIRFilterNode::feedforward() const
+{
+    std::lock_guard<std::mutex> lock(iir_impl->sectionMutex);
+    return iir_impl->feedforward;
+}
+
+std::vector<double> IIRFilterNode::feedback() const
+{
+    std::lock_guard<std::mutex> lock(iir_impl->sectionMutex);
+    return iir_impl->feedback;
+}
+
+int IIRFilterNode::numberOfSections() const
+{
+    std::lock_guard<std::mutex> lock(iir_impl->sectionMutex);
+    return static_cast<int>(iir_impl->sections.size() / 5);
+}
+
+void IIRFilterNode::getFrequencyResponse(const std::vector<float> & frequencyHz, std::vector<float> & magResponse, std::vector<float> & phaseResponse) const
+{
+    const size_t n = std::min(frequencyHz.size(), std::min(magResponse.size(), phaseResponse.size()));
+    if (!n)
+        return;
+
+    IIRFilterNodeInternal & node = *iir_impl;
+    std::lock_guard<std::mutex> lock(node.responseMutex);
+
+    const float nyquist = node.sampleRate * 0.5f;
+    node.responseFrequencies.resize(n);
+    for (size_t k = 0; k < n; ++k)
+        node.responseFrequencies[k] = frequencyHz[k] / nyquist;
+    node.response.setFrequencies(node.responseFrequencies.data(), static_cast<int>(n));
+
+    std::vector<double> sections;
+    {
+        std::lock_guard<std::mutex> sectionLock(node.sectionMutex);
+        sections = node.sections;
+    }
+    node.response.evaluate(sections.data(), static_cast<int>(sections.size() / 5));
+    std::copy(node.response.magnitude(), node.response.magnitude() + n, magResponse.begin());
+    std::copy(node.response.phase(), node.response.phase() + n, phaseResponse.begin());
+}
+
+}  // namespace lab
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/MemoryAccounting.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace lab
+{
+
+namespace
+{
+    const int CategoryCount = static_cast<int>(MemoryCategory::_Count);
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::weak_ptr<MemoryOwner>> owners;  // pruned of those destroyed as it grows
+        size_t pruneAt = 64;
+        std::map<std::string, std::shared_ptr<MemoryOwner>> subsystems;
+        std::atomic<int64_t> bytes[CategoryCount] = {};
+        std::atomic<int64_t> budgets[CategoryCount] = {};
+    };
+
+    // never destroyed, so that memory freed during static destruction can still be released
+    Registry & registry()
+    {
+        static Registry * r = new Registry;
+        return *r;
+    }
+
+    thread_local MemoryOwner * t_current = nullptr;
+
+    int index(MemoryCategory category)
+    {
+        const int i = static_cast<int>(category);
+        return i >= 0 && i < CategoryCount ? i : 0;
+    }
+}
+
+std::string MemoryOwner::name() const
+{
+    if (!_name.empty())
+        return _name;
+    const char * label = _label.load(std::memory_order_relaxed);
+    return label ? label : "";
+}
+
+void MemoryOwner::charge(int64_t bytes)
+{
+    const int64_t now = _bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = _peakBytes.load(std::memory_order_relaxed);
+    while (now > peak && !_peakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+    {
+    }
+    MemoryAccounting::record(_category, bytes);
+}
+
+void MemoryAccounting::record(MemoryCategory category, int64_t bytes)
+{
+    registry().bytes[index(category)].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+std::shared_ptr<MemoryOwner> MemoryAccounting::createOwner(MemoryCategory category, const std::string & name)
+{
+    std::shared_ptr<MemoryOwner> owner = std::make_shared<MemoryOwner>(category, name);
+
+    Registry & r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.owners.size() >= r.pruneAt)
+    {
+        r.owners.erase(std::remove_if(r.owners.begin(), r.owners.end(), [](const std::weak_ptr<MemoryOwner> & o) { return o.expired(); }),
+                       r.owners.end());
+        r.pruneAt = std::max<size_t>(64, r.owners.size() * 2);
+    }
+    r.owners.push_back(owner);
+    return owner;
+}
+
+std::shared_ptr<MemoryOwner> MemoryAccounting::subsystem(const std::string & name)
+{
+    {
+        Registry & r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto found = r.subsystems.find(name);
+        if (found != r.subsystems.end())
+            return found->second;
+    }
+
+    std::shared_ptr<MemoryOwner> owner = createOwner(MemoryCategory::Subsystem, name);
+    Registry & r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.subsystems.emplace(name, owner).first->second;  // another thread's, if it made one first
+}
+
+MemoryOwner * MemoryAccounting::current()
+{
+    return t_current;
+}
+
+std::shared_ptr<MemoryOwner> MemoryAccounting::charge(int64_t bytes)
+{
+    static std::shared_ptr<MemoryOwner> * unattributed = new std::shared_ptr<MemoryOwner>(createOwner(MemoryCategory::Unattributed, "unattributed"));
+
+    std::shared_ptr<MemoryOwner> owner = t_current ? t_current->shared_from_this() : *unattributed;
+    owner->charge(bytes);
+    return owner;
+}
+
+int64_t MemoryAccounting::totalBytes()
+{
+    int64_t total = 0;
+    for (int i = 0; i < CategoryCount; ++i)
+        total += registry().bytes[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+int64_t MemoryAccounting::bytes(MemoryCategory category)
+{
+    return registry().bytes[index(category)].load(std::memory_order_relaxed);
+}
+
+std::vector<MemoryUsage> MemoryAccounting::usage()
+{
+    std::vector<MemoryUsage> result;
+    {
+        Registry & r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto & weak : r.owners)
+        {
+            std::shared_ptr<MemoryOwner> owner = weak.lock();
+            if (!owner || owner->bytes() <= 0)
+                continue;
+
+            MemoryUsage u;
+            u.name = owner->name();
+            u.category = owner->category();
+            u.bytes = owner->bytes();
+            u.peakBytes = owner->peakBytes();
+            result.push_back(std::move(u));
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const MemoryUsage & a, const MemoryUsage & b) { return a.bytes > b.bytes; });
+    return result;
+}
+
+std::vector<MemoryUsage> MemoryAccounting::usage(MemoryCategory category)
+{
+    std::vector<MemoryUsage> result = usage();
+    result.erase(std::remove_if(result.begin(), result.end(), [category](const MemoryUsage & u) { return u.category != category; }),
+                 result.end());
+    return result;
+}
+
+std::vector<MemoryUsage> MemoryAccounting::topConsumers(int count)
+{
+    std::vector<MemoryUsage> result = usage();
+    if (count >= 0 && static_cast<size_t>(count) < result.size())
+        result.resize(count);
+    return result;
+}
+
+void MemoryAccounting::setBudget(MemoryCategory category, int64_t bytes)
+{
+    registry().budgets[index(category)].store(bytes, std::memory_order_relaxed);
+}
+
+int64_t MemoryAccounting::budget(MemoryCategory category)
+{
+    return registry().budgets[index(category)].load(std::memory_order_relaxed);
+}
+
+bool MemoryAccounting::isOverBudget(MemoryCategory category)
+{
+    const int64_t limit = budget(category);
+    return limit > 0 && bytes(category) > limit;
+}
+
+MemoryOwnerScope::MemoryOwnerScope(MemoryOwner * owner)
+    : _previous(t_current)
+{
+    t_current = owner;
+}
+
+MemoryOwnerScope::~MemoryOwnerScope()
+{
+    t_current = _previous;
+}
+
+}  // lab
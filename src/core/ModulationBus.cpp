@@ -0,0 +1,118 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/ModulationBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/Macros.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace lab
+{
+
+Modulator::Modulator(ModulationShape shape, double beatsPerCycle, double phase)
+    : m_shape(shape)
+    , m_beatsPerCycle(beatsPerCycle)
+    , m_phase(phase - std::floor(phase))
+    , m_values(AudioNode::MaxProcessingSizeInFrames, 0.f)
+{
+}
+
+void Modulator::render(double beat, double beatsPerFrame, int frames)
+{
+    // The phase at the start of the quantum is found from the beat in double precision, so
+    // that it doesn't drift however long the context runs; within a quantum float is plenty.
+    const double cycles = beat / m_beatsPerCycle + m_phase;
+    const double start = cycles - std::floor(cycles);
+    const double step = beatsPerFrame / m_beatsPerCycle;
+    float * values = m_values.data();
+    frames = std::min(frames, static_cast<int>(m_values.size()));
+
+    for (int i = 0; i < frames; ++i)
+    {
+        double p = start + step * i;
+        p -= std::floor(p);
+        const float x = static_cast<float>(p);
+        switch (m_shape)
+        {
+            case ModulationShape::Sine: values[i] = std::sin(2.f * static_cast<float>(LAB_PI) * x); break;
+            case ModulationShape::Triangle: values[i] = x < 0.5f ? 4.f * x - 1.f : 3.f - 4.f * x; break;
+            case ModulationShape::Square: values[i] = x < 0.5f ? 1.f : -1.f; break;
+            case ModulationShape::SawUp: values[i] = 2.f * x - 1.f; break;
+            case ModulationShape::SawDown: values[i] = 1.f - 2.f * x; break;
+            case ModulationShape::Ramp: values[i] = x; break;
+        }
+    }
+}
+
+ModulationBus::ModulationBus(float tempo)
+    : m_tempo(tempo)
+    , m_rendering(std::make_shared<const Modulators>())
+{
+    if (!(tempo > 0.f))
+        throw std::invalid_argument("ModulationBus tempo must be positive");
+}
+
+ModulationBus::~ModulationBus() {}
+
+void ModulationBus::setTempo(float beatsPerMinute)
+{
+    if (!(beatsPerMinute > 0.f) || std::isinf(beatsPerMinute))
+        throw std::invalid_argument("ModulationBus tempo must be positive");
+    m_tempo.store(beatsPerMinute, std::memory_order_relaxed);
+}
+
+void ModulationBus::setBeat(double beat)
+{
+    m_requestedBeat.store(beat, std::memory_order_relaxed);
+    m_beatRequested.store(true, std::memory_order_release);
+}
+
+std::shared_ptr<Modulator> ModulationBus::lfo(ModulationShape shape, double beatsPerCycle, double phase)
+{
+    if (!(beatsPerCycle > 0) || std::isinf(beatsPerCycle))
+        throw std::invalid_argument("Modulator period must be a positive number of beats");
+
+    phase -= std::floor(phase);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto & m : m_modulators)
+    {
+        if (m->m_shape == shape && m->m_beatsPerCycle == beatsPerCycle && m->m_phase == phase)
+            return m;
+    }
+
+    // modulators held only by the bus are dropped as the new one is published
+    m_modulators.erase(std::remove_if(m_modulators.begin(), m_modulators.end(),
+                                      [](const std::shared_ptr<Modulator> & m) { return m.use_count() == 1; }),
+                       m_modulators.end());
+
+    std::shared_ptr<Modulator> modulator(new Modulator(shape, beatsPerCycle, phase));
+    m_modulators.push_back(modulator);
+    std::atomic_store(&m_rendering, std::shared_ptr<const Modulators>(std::make_shared<Modulators>(m_modulators)));
+    return modulator;
+}
+
+void ModulationBus::render(ContextRenderLock & r, int frames)
+{
+    if (!r.context() || frames <= 0)
+        return;
+
+    double beat = m_beat.load(std::memory_order_relaxed);
+    if (m_beatRequested.exchange(false, std::memory_order_acquire))
+        beat = m_requestedBeat.load(std::memory_order_relaxed);
+
+    const double beatsPerFrame = tempo() / (60.0 * r.context()->sampleRate());
+    std::shared_ptr<const Modulators> modulators = std::atomic_load(&m_rendering);
+    for (const auto & m : *modulators)
+        m->render(beat, beatsPerFrame, frames);
+
+    m_beat.store(beat + beatsPerFrame * frames, std::memory_order_relaxed);
+}
+
+}  // namespace lab
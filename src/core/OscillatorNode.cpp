@@ -17,34 +17,107 @@
 
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
+#include "internal/LookupTables.h"
 #include "LabSound/extended/VectorMath.h"
 
 #include <algorithm>
-//#include <emmintrin.h>
+#include <cmath>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
 
 using namespace lab;
 
-// https://www.musicdsp.org/en/latest/Synthesis/13-sine-calculation.html
-// phase should be between between -LAB_PI and +LAB_PI
-inline float burk_fast_sine(const double phase) 
+namespace
 {
-    // Factorial coefficients.
-    const float IF3 = 1.f / (2 * 3);
-    const float IF5 = IF3 / (4 * 5);
-    const float IF7 = IF5 / (6 * 7);
-    const float IF9 = IF7 / (8 * 9);
-    const float IF11 = IF9 / (10 * 11);
-
-    // Wrap phase back into region where results are more accurate. 
-    double x = (phase > +LAB_HALF_PI) ? +(LAB_PI - phase)
-           : ((phase < -LAB_HALF_PI) ? -(LAB_PI + phase) : phase);
-
-    double x2 = (x * x);
-
-    // Taylor expansion out to x**11/11! factored into multiply-adds 
-    return static_cast<float>(
-            x * (x2 * (x2 * (x2 * (x2 * ((x2 * (-IF11)) + IF9) - IF7) + IF5) - IF3) + 1)
-        );
+    // Reads count frames from a pair of band limited tables at the given table indices,
+    // interpolating within each table and crossfading between them, and applies amplitude
+    // and bias. Four frames are rendered at a time where SIMD is available.
+    void renderWavetable(const float * lower, const float * higher, float tableInterpolationFactor, unsigned mask,
+                         const float * indices, const float * amplitudes, const float * bias, float * destination, int count)
+    {
+        int i = 0;
+
+#if defined(__SSE2__)
+        const __m128 factor = _mm_set1_ps(tableInterpolationFactor);
+        const __m128i maskv = _mm_set1_epi32(static_cast<int>(mask));
+        const __m128i onev = _mm_set1_epi32(1);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 index = _mm_loadu_ps(indices + i);
+            const __m128i truncated = _mm_cvttps_epi32(index);
+            const __m128 fraction = _mm_sub_ps(index, _mm_cvtepi32_ps(truncated));
+
+            alignas(16) int32_t i1[4];
+            alignas(16) int32_t i2[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(i1), _mm_and_si128(truncated, maskv));
+            _mm_store_si128(reinterpret_cast<__m128i *>(i2), _mm_and_si128(_mm_add_epi32(truncated, onev), maskv));
+
+            const __m128 lower1 = _mm_setr_ps(lower[i1[0]], lower[i1[1]], lower[i1[2]], lower[i1[3]]);
+            const __m128 lower2 = _mm_setr_ps(lower[i2[0]], lower[i2[1]], lower[i2[2]], lower[i2[3]]);
+            const __m128 higher1 = _mm_setr_ps(higher[i1[0]], higher[i1[1]], higher[i1[2]], higher[i1[3]]);
+            const __m128 higher2 = _mm_setr_ps(higher[i2[0]], higher[i2[1]], higher[i2[2]], higher[i2[3]]);
+
+            const __m128 lowerSample = _mm_add_ps(lower1, _mm_mul_ps(fraction, _mm_sub_ps(lower2, lower1)));
+            const __m128 higherSample = _mm_add_ps(higher1, _mm_mul_ps(fraction, _mm_sub_ps(higher2, higher1)));
+            const __m128 sample = _mm_add_ps(higherSample, _mm_mul_ps(factor, _mm_sub_ps(lowerSample, higherSample)));
+
+            _mm_storeu_ps(destination + i, _mm_add_ps(_mm_loadu_ps(bias + i), _mm_mul_ps(_mm_loadu_ps(amplitudes + i), sample)));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const uint32x4_t maskv = vdupq_n_u32(mask);
+        for (; i + 4 <= count; i += 4)
+        {
+            const float32x4_t index = vld1q_f32(indices + i);
+            const uint32x4_t truncated = vcvtq_u32_f32(index);
+            const float32x4_t fraction = vsubq_f32(index, vcvtq_f32_u32(truncated));
+
+            uint32_t i1[4];
+            uint32_t i2[4];
+            vst1q_u32(i1, vandq_u32(truncated, maskv));
+            vst1q_u32(i2, vandq_u32(vaddq_u32(truncated, vdupq_n_u32(1)), maskv));
+
+            float gathered[4][4];
+            for (int k = 0; k < 4; ++k)
+            {
+                gathered[0][k] = lower[i1[k]];
+                gathered[1][k] = lower[i2[k]];
+                gathered[2][k] = higher[i1[k]];
+                gathered[3][k] = higher[i2[k]];
+            }
+            const float32x4_t lower1 = vld1q_f32(gathered[0]);
+            const float32x4_t higher1 = vld1q_f32(gathered[2]);
+            const float32x4_t lowerSample = vmlaq_f32(lower1, fraction, vsubq_f32(vld1q_f32(gathered[1]), lower1));
+            const float32x4_t higherSample = vmlaq_f32(higher1, fraction, vsubq_f32(vld1q_f32(gathered[3]), higher1));
+            const float32x4_t sample = vmlaq_n_f32(higherSample, vsubq_f32(lowerSample, higherSample), tableInterpolationFactor);
+
+            vst1q_f32(destination + i, vmlaq_f32(vld1q_f32(bias + i), vld1q_f32(amplitudes + i), sample));
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            const unsigned truncated = static_cast<unsigned>(indices[i]);
+            const unsigned index1 = truncated & mask;
+            const unsigned index2 = (truncated + 1) & mask;
+            const float fraction = indices[i] - static_cast<float>(truncated);
+
+            const float lowerSample = lower[index1] + fraction * (lower[index2] - lower[index1]);
+            const float higherSample = higher[index1] + fraction * (higher[index2] - higher[index1]);
+            const float sample = higherSample + tableInterpolationFactor * (lowerSample - higherSample);
+            destination[i] = bias[i] + amplitudes[i] * sample;
+        }
+    }
+
+    // Frames rendered with one choice of band limited tables, so that the tables follow a
+    // modulated frequency
+    const int WavetableSegmentFrames = 32;
 }
 
 static char const * const s_types[] = {
@@ -69,8 +142,9 @@ AudioNodeDescriptor * OscillatorNode::desc()
 
 OscillatorNode::OscillatorNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
-, m_phaseIncrements(AudioNode::ProcessingSizeInFrames)
-, m_detuneValues(AudioNode::ProcessingSizeInFrames)
+, m_phaseIncrements(renderQuantumSize())
+, m_detuneValues(renderQuantumSize())
+, m_tableIndices(renderQuantumSize())
 {
     m_frequency = param("frequency");
     m_detune = param("detune");
@@ -99,6 +173,12 @@ void OscillatorNode::setType(OscillatorType type)
     m_type->setUint32(static_cast<uint32_t>(type));
 }
 
+void OscillatorNode::setPeriodicWave(std::shared_ptr<PeriodicWave> wave)
+{
+    std::atomic_store(&m_periodicWave, wave);
+    setType(OscillatorType::CUSTOM);
+}
+
 void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, int offset, int count)
 {
     AudioBus * outputBus = output(0)->bus(r);
@@ -129,6 +209,8 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
         m_amplitudeValues.allocate(bufferSize);
     if (bufferSize > m_biasValues.size())
         m_biasValues.allocate(bufferSize);
+    if (bufferSize > m_tableIndices.size())
+        m_tableIndices.allocate(bufferSize);
     
     // calculate phase increments
     float* phaseIncrements = m_phaseIncrements.data();
@@ -137,7 +219,7 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
     {
         // Get the sample-accurate frequency values in preparation for conversion to phase increments.
         // They will be converted to phase increments below.
-        m_frequency->calculateSampleAccurateValues(r, phaseIncrements, nonSilentFramesToProcess);
+        m_frequency->calculateSampleAccurateBlock(r, phaseIncrements, nonSilentFramesToProcess).render(phaseIncrements, nonSilentFramesToProcess);
     }
     else
     {
@@ -155,14 +237,28 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
         // Get the sample-accurate detune values.
         float* detuneValues = m_detuneValues.data();
         float* offset_detunes = detuneValues + +quantumFrameOffset;
-        m_detune->calculateSampleAccurateValues(r, offset_detunes, nonSilentFramesToProcess);
+        AudioParamBlock detuneBlock = m_detune->calculateSampleAccurateBlock(r, offset_detunes, nonSilentFramesToProcess);
         
         // Convert from cents to rate scalar and perform detuning
         float k = 1.f / 1200.f;
-        VectorMath::vsmul(offset_detunes, 1, &k, offset_detunes, 1, nonSilentFramesToProcess);
-        for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+        if (detuneBlock.isConstant())
+        {
+            // a constant detune is one scale for the whole quantum
+            if (detuneBlock.value != 0)
+            {
+                float detuneScale = powf(2, detuneBlock.value * k);
+                for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+                    phaseIncrements[i] *= detuneScale;
+            }
+        }
+        else
         {
-            phaseIncrements[i] *= powf(2, detuneValues[i]);  // FIXME: converting to expf() will be faster.
+            detuneBlock.render(offset_detunes, nonSilentFramesToProcess);
+            VectorMath::vsmul(offset_detunes, 1, &k, offset_detunes, 1, nonSilentFramesToProcess);
+            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+            {
+                phaseIncrements[i] *= powf(2, detuneValues[i]);  // FIXME: converting to expf() will be faster.
+            }
         }
     }
     else
@@ -188,7 +284,7 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
     float* amplitudes = m_amplitudeValues.data();
     if (m_amplitude->hasSampleAccurateValues())
     {
-        m_amplitude->calculateSampleAccurateValues(r, amplitudes + quantumFrameOffset, nonSilentFramesToProcess);
+        m_amplitude->calculateSampleAccurateBlock(r, amplitudes + quantumFrameOffset, nonSilentFramesToProcess).render(amplitudes + quantumFrameOffset, nonSilentFramesToProcess);
     }
     else
     {
@@ -202,7 +298,7 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
     float* bias = m_biasValues.data();
     if (m_bias->hasSampleAccurateValues())
     {
-        m_bias->calculateSampleAccurateValues(r, bias + quantumFrameOffset, nonSilentFramesToProcess);
+        m_bias->calculateSampleAccurateBlock(r, bias + quantumFrameOffset, nonSilentFramesToProcess).render(bias + quantumFrameOffset, nonSilentFramesToProcess);
     }
     else
     {
@@ -232,14 +328,18 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
             break;
             
         case OscillatorType::FAST_SINE:
+        {
+            // interpolated from the sine table, rather than by the library's sin
+            const float turnsPerRadian = 0.5f / pi;
             for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
             {
-                destP[i] = burk_fast_sine(phase);
+                destP[i] = bias[i] + amplitudes[i] * LookupTables::sine(static_cast<float>(phase) * turnsPerRadian);
                 phase += phaseIncrements[i];
-                if (phase > pi)
-                    phase -= 0.5f * pi;
+                if (phase > 2.f * pi)
+                    phase -= 2.f * pi;
             }
             break;
+        }
             
         case OscillatorType::SQUARE:
             for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
@@ -289,6 +389,49 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
             }
             break;
             
+        case OscillatorType::CUSTOM:
+        {
+            std::shared_ptr<PeriodicWave> wave = std::atomic_load(&m_periodicWave);
+            if (!wave)
+            {
+                for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+                    destP[i] = bias[i];
+                break;
+            }
+
+            // accumulate the phase as table indices; this is the only serial part of the kernel
+            const unsigned waveSize = wave->periodicWaveSize();
+            const double toIndex = waveSize / (2. * LAB_PI);
+            float * indices = m_tableIndices.data();
+            double index = phase * toIndex;
+            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+            {
+                indices[i] = static_cast<float>(index);
+                index += phaseIncrements[i] * toIndex;
+                if (index >= waveSize)
+                    index -= waveSize;
+            }
+            phase = index / toIndex;
+
+            // a steady frequency needs only one choice of tables for the quantum
+            const bool steady = phaseIncrements[quantumFrameOffset] == phaseIncrements[nonSilentFramesToProcess - 1];
+            const int segmentFrames = steady ? nonSilentFramesToProcess - quantumFrameOffset : WavetableSegmentFrames;
+            for (int start = quantumFrameOffset; start < nonSilentFramesToProcess; start += segmentFrames)
+            {
+                const int count = std::min(segmentFrames, nonSilentFramesToProcess - start);
+
+                float * lowerWave;
+                float * higherWave;
+                float tableInterpolationFactor;
+                const float frequency = phaseIncrements[start] * sample_rate / (2.f * pi);
+                wave->waveDataForFundamentalFrequency(frequency, lowerWave, higherWave, tableInterpolationFactor);
+
+                renderWavetable(lowerWave, higherWave, tableInterpolationFactor, waveSize - 1,
+                                indices + start, amplitudes + start, bias + start, destP + start, count);
+            }
+        }
+        break;
+
         default: break; // other types do nothing
     }
     
@@ -297,14 +440,12 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
 
 void OscillatorNode::process(ContextRenderLock & r, int bufferSize)
 {
-    OscillatorType type = static_cast<OscillatorType>(m_type->valueUint32());
-    if (type != OscillatorType::CUSTOM)
-    {
-        process_oscillator(r, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
-        return;
-    }
+    process_oscillator(r, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
+}
 
-    return;
+void OscillatorNode::processRange(ContextRenderLock & r, int bufferSize, int offset, int count)
+{
+    process_oscillator(r, bufferSize, offset, count);
 }
 
 bool OscillatorNode::propagatesSilence(ContextRenderLock & r) const
@@ -14,19 +14,30 @@
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Registry.h"
 
+#include "internal/Ambisonics.h"
 #include "internal/Assertions.h"
+#include "internal/BinauralPanner.h"
 #include "internal/Cone.h"
 #include "internal/Distance.h"
+#include "internal/DopplerDelay.h"
 #include "internal/EqualPowerPanner.h"
 #include "internal/HRTFDatabase.h"
 #include "internal/HRTFPanner.h"
 #include "internal/Panner.h"
 
+#include <algorithm>
+
 using namespace std;
 
 namespace lab
 {
 
+// The longest propagation delay a doppler enabled panner renders
+static const double MaxDopplerDelayTime = 1.0;
+
+// The length of the crossfade from one spatial tier to another
+static const double TierCrossfadeTime = 0.02;
+
 template <typename T>
 static void fixNANs(T & x)
 {
@@ -38,7 +49,7 @@ static void fixNANs(T & x)
 static char const * const s_distance_models[lab::DistanceEffect::ModelType::_Count + 1] = {
     "Linear", "Inverse", "Exponential", nullptr};
 static char const * const s_panning_models[lab::PanningModel::_PanningModeCount + 1] = {
-    "Linear", "Inverse", "Exponential", nullptr};
+    "None", "EqualPower", "HRTF", "Ambisonic", "Binaural", nullptr};
 
 static AudioParamDescriptor s_pDesc[] = {
     {"orientationX", "OR X", 0.f,    -1.f,    1.f},
@@ -62,6 +73,9 @@ static AudioSettingDescriptor s_sDesc[] = {
     {"coneInnerAngle", "CONI", SettingType::Float},
     {"coneOuterAngle", "CONO", SettingType::Float},
     {"panningMode",    "PANM", SettingType::Enum, s_panning_models},
+    {"ambisonicOrder", "AMBO", SettingType::Integer},
+    {"doppler",        "DOPL", SettingType::Bool},
+    {"hrtfInterpolation", "HRTI", SettingType::Bool},
     nullptr};
 
 AudioNodeDescriptor * PannerNode::desc()
@@ -95,6 +109,9 @@ PannerNode::PannerNode(AudioContext & ac)
     m_coneInnerAngle = setting("coneInnerAngle");
     m_coneOuterAngle = setting("coneOuterAngle");
     m_panningModel = setting("panningMode");
+    m_ambisonicOrder = setting("ambisonicOrder");
+    m_doppler = setting("doppler");
+    m_hrtfInterpolation = setting("hrtfInterpolation");
 
     m_distanceEffect.reset(new DistanceEffect());
     m_coneEffect.reset(new ConeEffect());
@@ -108,6 +125,7 @@ PannerNode::PannerNode(AudioContext & ac)
                 case DistanceEffect::ModelInverse:
                 case DistanceEffect::ModelExponential:
                     m_distanceEffect->setModel(model, true);
+                    m_gainSettingsChanged = true;
                     break;
 
                 default:
@@ -119,26 +137,31 @@ PannerNode::PannerNode(AudioContext & ac)
     m_refDistance->setValueChanged(
         [this]() {
             m_distanceEffect->setRefDistance(m_refDistance->valueFloat());
+            m_gainSettingsChanged = true;
         });
 
     m_maxDistance->setValueChanged(
         [this]() {
             m_distanceEffect->setMaxDistance(m_maxDistance->valueFloat());
+            m_gainSettingsChanged = true;
         });
 
     m_rolloffFactor->setValueChanged(
         [this]() {
             m_distanceEffect->setRolloffFactor(m_rolloffFactor->valueFloat());
+            m_gainSettingsChanged = true;
         });
 
     m_coneInnerAngle->setValueChanged(
         [this]() {
             m_coneEffect->setInnerAngle(m_coneInnerAngle->valueFloat());
+            m_gainSettingsChanged = true;
         });
 
     m_coneOuterAngle->setValueChanged(
         [this]() {
             m_coneEffect->setOuterAngle(m_coneOuterAngle->valueFloat());
+            m_gainSettingsChanged = true;
         });
 
     m_panningModel->setUint32(static_cast<uint32_t>(EQUALPOWER));
@@ -147,6 +170,10 @@ PannerNode::PannerNode(AudioContext & ac)
             setPanningModel(static_cast<PanningModel>(m_panningModel->valueUint32()));
         });
 
+    m_ambisonicOrder->setUint32(1, false);
+    m_doppler->setBool(false, false);
+    m_hrtfInterpolation->setBool(false, false);
+
     // Node-specific default mixing rules.
     _self->m_channelCount = 2;
     _self->m_channelCountMode = ChannelCountMode::ClampedMax;
@@ -172,6 +199,12 @@ void PannerNode::initialize()
         case PanningModel::HRTF:
             //m_panner = std::unique_ptr<Panner>(new HRTFPanner(m_sampleRate));
             break;
+        case PanningModel::AMBISONIC:
+            m_panner = std::unique_ptr<Panner>(new AmbisonicPanner(m_sampleRate));
+            break;
+        case PanningModel::BINAURAL:
+            m_panner = std::unique_ptr<Panner>(new BinauralPanner(m_sampleRate));
+            break;
         default:
             throw std::runtime_error("invalid panning model");
     }
@@ -212,6 +245,13 @@ void PannerNode::setVelocity(const FloatPoint3D & velocity)
 
 void PannerNode::process(ContextRenderLock & r, int bufferSize)
 {
+    // In the Ambisonic model the output is a sound field of the chosen order, and otherwise stereo.
+    // A change of channels takes effect from the next quantum.
+    PanningModel curr = static_cast<PanningModel>(m_panningModel->valueUint32());
+    const int outputChannels = curr == PanningModel::AMBISONIC ? ambisonicChannelCount(ambisonicOrder()) : 2;
+    if (output(0)->numberOfChannels() != outputChannels)
+        output(0)->setNumberOfChannels(r, outputChannels);
+
     AudioBus * destination = output(0)->bus(r);
 
     if (!isInitialized() || !input(0)->isConnected())
@@ -222,35 +262,37 @@ void PannerNode::process(ContextRenderLock & r, int bufferSize)
 
     AudioBus * source = input(0)->bus(r);
 
-    if (!source)
+    if (!source || destination->numberOfChannels() != outputChannels)
     {
         destination->zero();
         return;
     }
 
-    PanningModel curr = static_cast<PanningModel>(m_panningModel->valueUint32());
-    auto db = r.context()->hrtfDatabaseLoader();
+    // A panner given a tier, or still fading out of one, is rendered by its tiers. A sound
+    // field can't be faded into stereo, so the AMBISONIC model leaves its tier at once.
+    if (curr == PanningModel::AMBISONIC)
+    {
+        m_renderedTier = SpatialTier::Model;
+        m_tierFadeRemaining = 0;
+    }
+    else if (spatialTier() != SpatialTier::Model || m_renderedTier != SpatialTier::Model)
+    {
+        const SpatialTier tier = spatialTier();
+        processTiers(r, tier, *source, *destination, bufferSize);
+        return;
+    }
+
     if (curr == PanningModel::HRTF) {
-        if (!db) {
+        if (!hrtfReady(r)) {
             destination->zero();
             return;
         }
-        if (!db->isLoaded()) {
-            if (r.context()->isOfflineContext()) {
-                // HRTFDatabase should be loaded before proceeding for offline audio context
-                if (db)
-                    db->waitForLoaderThreadCompletion();
-            }
-            else {
-                destination->zero();
-                return;
-            }
-        }
 
         if (!m_panner) {
             //uint32_t fftSize = HRTFPanner::fftSizeForSampleLength(db->database()->sampleSize());
             m_panner = std::unique_ptr<Panner>(new HRTFPanner(m_sampleRate)); //, fftSize));
         }
+        static_cast<HRTFPanner *>(m_panner.get())->setInterpolatesKernels(m_hrtfInterpolation->valueBool());
     }
     
     if (!m_panner)
@@ -259,11 +301,43 @@ void PannerNode::process(ContextRenderLock & r, int bufferSize)
         return;
     }
 
+    if (m_doppler->valueBool())
+    {
+        if (!m_dopplerDelay)
+            m_dopplerDelay.reset(new DopplerDelay(MaxDopplerDelayTime, m_sampleRate));
+        source = &dopplerDelayed(r, *source, bufferSize);
+    }
 
     // Apply the panning effect.
     double azimuth;
     double elevation;
-    getAzimuthElevation(r, &azimuth, &elevation);
+    if (curr == PanningModel::AMBISONIC)
+    {
+        // The field is encoded as it is heard facing the world's -z with y up; an
+        // AmbisonicDecoderNode turns the mixed field to the listener's orientation once.
+        auto listener = r.context()->listener();
+        FloatPoint3D listenerPosition = {
+            listener->positionX()->value(),
+            listener->positionY()->value(),
+            listener->positionZ()->value()};
+        const FloatPoint3D position = sourceTransform(r).position;
+        cachedAzimuthElevation(position, listenerPosition, {0.f, 0.f, -1.f}, {0.f, 1.f, 0.f}, &azimuth, &elevation);
+
+        if (m_panner->panningModel() == PanningModel::AMBISONIC)
+        {
+            // The distance and cone gain is ramped with the encoding, rather than over every channel of the field
+            float totalGain = distanceConeGain(r);
+            static_cast<AmbisonicPanner *>(m_panner.get())->setGain(totalGain);
+            m_panner->pan(r, azimuth, elevation,
+                          *source, *destination,
+                          _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
+            m_lastGain = totalGain;
+            m_audibleGain.store(totalGain, std::memory_order_relaxed);
+            return;
+        }
+    }
+    else
+        getAzimuthElevation(r, &azimuth, &elevation);
     
     m_panner->pan(r, azimuth, elevation,
                   *source, *destination,
@@ -271,6 +345,7 @@ void PannerNode::process(ContextRenderLock & r, int bufferSize)
 
     // Get the distance and cone gain.
     float totalGain = distanceConeGain(r);
+    m_audibleGain.store(totalGain, std::memory_order_relaxed);
 
     // Snap to desired gain at the beginning.
     if (m_lastGain == -1.f)
@@ -280,11 +355,208 @@ void PannerNode::process(ContextRenderLock & r, int bufferSize)
     destination->copyWithGainFrom(*destination, &m_lastGain, totalGain);
 }
 
+bool PannerNode::hrtfReady(ContextRenderLock & r)
+{
+    auto db = r.context()->hrtfDatabaseLoader();
+    if (!db)
+        return false;
+    if (!db->isLoaded())
+    {
+        // HRTFDatabase should be loaded before proceeding for offline audio context
+        if (!r.context()->isOfflineContext())
+            return false;
+        db->waitForLoaderThreadCompletion();
+    }
+    return true;
+}
+
+Panner * PannerNode::tierPanner(ContextRenderLock & r, SpatialTier tier)
+{
+    switch (tier)
+    {
+        case SpatialTier::Model:
+            if (!m_panner && panningModel() == PanningModel::HRTF && hrtfReady(r))
+                m_panner = std::unique_ptr<Panner>(new HRTFPanner(m_sampleRate));
+            if (m_panner && m_panner->panningModel() == PanningModel::HRTF)
+                static_cast<HRTFPanner *>(m_panner.get())->setInterpolatesKernels(m_hrtfInterpolation->valueBool());
+            return m_panner.get();
+
+        case SpatialTier::HRTF:
+            if (!hrtfReady(r))
+                return tierPanner(r, SpatialTier::Binaural);
+            if (!m_tierPanners[0])
+                m_tierPanners[0].reset(new HRTFPanner(m_sampleRate));
+            static_cast<HRTFPanner *>(m_tierPanners[0].get())->setInterpolatesKernels(m_hrtfInterpolation->valueBool());
+            return m_tierPanners[0].get();
+
+        case SpatialTier::Binaural:
+            if (!m_tierPanners[1])
+                m_tierPanners[1].reset(new BinauralPanner(m_sampleRate));
+            return m_tierPanners[1].get();
+
+        case SpatialTier::EqualPower:
+            if (!m_tierPanners[2])
+                m_tierPanners[2].reset(new EqualPowerPanner(m_sampleRate));
+            return m_tierPanners[2].get();
+
+        case SpatialTier::Virtual:
+        default:
+            return nullptr;
+    }
+}
+
+void PannerNode::processTiers(ContextRenderLock & r, SpatialTier tier, const AudioBus & input, AudioBus & destination, int bufferSize)
+{
+    const AudioBus * source = &input;
+    if (m_doppler->valueBool())
+    {
+        if (!m_dopplerDelay)
+            m_dopplerDelay.reset(new DopplerDelay(MaxDopplerDelayTime, m_sampleRate));
+        source = &dopplerDelayed(r, *source, bufferSize);
+    }
+
+    // A change of tier waits for the fade in progress to finish, as HRTFPanner's changes
+    // of position do, so that no more than two tiers are ever heard at once.
+    if (tier != m_renderedTier && m_tierFadeRemaining == 0)
+    {
+        if (!m_tierFadeLength)
+            m_tierFadeLength = std::max(1, static_cast<int>(TierCrossfadeTime * m_sampleRate));
+        m_fadingTier = m_renderedTier;
+        m_renderedTier = tier;
+        m_tierFadeRemaining = m_tierFadeLength;
+    }
+
+    const int offset = _self->_scheduler._renderOffset;
+    const int length = _self->_scheduler._renderLength;
+
+    const float totalGain = distanceConeGain(r);
+    m_audibleGain.store(totalGain, std::memory_order_relaxed);
+
+    Panner * panner = tierPanner(r, m_renderedTier);
+    Panner * fadingPanner = m_tierFadeRemaining > 0 ? tierPanner(r, m_fadingTier) : nullptr;
+    if (!panner && !fadingPanner)
+    {
+        // a virtual source costs nothing beyond keeping its gain up to date
+        destination.zero();
+        m_tierFadeRemaining = 0;
+        m_lastGain = totalGain;
+        return;
+    }
+
+    double azimuth;
+    double elevation;
+    getAzimuthElevation(r, &azimuth, &elevation);
+
+    if (panner)
+        panner->pan(r, azimuth, elevation, *source, destination, offset, length);
+    else
+        destination.zero();
+
+    if (m_tierFadeRemaining > 0)
+    {
+        if (!m_tierFadeBus || m_tierFadeBus->length() < bufferSize)
+            m_tierFadeBus.reset(new AudioBus(2, bufferSize));
+
+        if (fadingPanner)
+            fadingPanner->pan(r, azimuth, elevation, *source, *m_tierFadeBus, offset, length);
+        else
+            m_tierFadeBus->zero();
+
+        // a linear fade, since both tiers render the same source
+        const float step = 1.f / m_tierFadeLength;
+        for (int c = 0; c < 2; ++c)
+        {
+            float * dst = destination.channel(c)->mutableData();
+            const float * old = m_tierFadeBus->channel(c)->data();
+            float fade = 1.f - m_tierFadeRemaining * step;
+            for (int i = 0; i < bufferSize; ++i)
+            {
+                const float t = std::min(1.f, fade);
+                dst[i] = old[i] + (dst[i] - old[i]) * t;
+                fade += step;
+            }
+        }
+
+        m_tierFadeRemaining = std::max(0, m_tierFadeRemaining - bufferSize);
+        if (!m_tierFadeRemaining && fadingPanner)
+            fadingPanner->reset();
+    }
+
+    // Snap to desired gain at the beginning.
+    if (m_lastGain == -1.f)
+        m_lastGain = totalGain;
+
+    // Apply gain in-place with de-zippering.
+    destination.copyWithGainFrom(destination, &m_lastGain, totalGain);
+}
+
 void PannerNode::reset(ContextRenderLock &)
 {
     m_lastGain = -1.0;  // force to snap to initial gain
     if (m_panner.get())
         m_panner->reset();
+    for (auto & panner : m_tierPanners)
+        if (panner)
+            panner->reset();
+    m_tierFadeRemaining = 0;
+    if (m_dopplerDelay)
+        m_dopplerDelay->reset();
+}
+
+AudioBus & PannerNode::dopplerDelayed(ContextRenderLock & r, const AudioBus & source, int bufferSize)
+{
+    auto listener = r.context()->listener();
+
+    /// @fixme these values should be per sample, not per quantum
+    FloatPoint3D listenerPosition = {
+        listener->positionX()->value(),
+        listener->positionY()->value(),
+        listener->positionZ()->value()};
+
+    /// @fixme these values should be per sample, not per quantum
+    const SpatialTransform transform = sourceTransform(r);
+    const FloatPoint3D & position = transform.position;
+    const FloatPoint3D & sourceVelocity = transform.velocity;
+
+    // The sound heard now left the source when it was further along its path, so the delay
+    // is the distance over the speed of sound less the source's speed toward the listener,
+    // which the delay's own rate of change then agrees with. With a dopplerFactor of zero
+    // there is neither a delay nor a shift.
+    double targetDelayFrames = 0;
+    const double dopplerFactor = listener->dopplerFactor()->value();
+    const double speedOfSound = listener->speedOfSound()->value();
+    if (dopplerFactor > 0 && speedOfSound > 0)
+    {
+        const FloatPoint3D sourceToListener = position - listenerPosition;
+        const double distance = magnitude(sourceToListener);
+        const double scaledSpeedOfSound = speedOfSound / dopplerFactor;
+        const double approach = distance > 0 ? -dot(sourceToListener, sourceVelocity) / distance : 0;
+        const double speed = std::max(scaledSpeedOfSound - approach, scaledSpeedOfSound / 16);
+        targetDelayFrames = distance * m_sampleRate / speed;
+        fixNANs(targetDelayFrames);
+    }
+
+    return m_dopplerDelay->process(source, bufferSize, dopplerRate(r), targetDelayFrames);
+}
+
+bool PannerNode::dopplerEnabled() const
+{
+    return m_doppler->valueBool();
+}
+
+void PannerNode::setDopplerEnabled(bool enabled)
+{
+    m_doppler->setBool(enabled);
+}
+
+bool PannerNode::hrtfInterpolation() const
+{
+    return m_hrtfInterpolation->valueBool();
+}
+
+void PannerNode::setHrtfInterpolation(bool enabled)
+{
+    m_hrtfInterpolation->setBool(enabled);
 }
 
 PanningModel PannerNode::panningModel() const
@@ -294,7 +566,7 @@ PanningModel PannerNode::panningModel() const
 
 void PannerNode::setPanningModel(PanningModel model)
 {
-    if (model != PanningModel::EQUALPOWER && model != PanningModel::HRTF)
+    if (model != PanningModel::EQUALPOWER && model != PanningModel::HRTF && model != PanningModel::AMBISONIC && model != PanningModel::BINAURAL)
         throw std::invalid_argument("Unknown panning model specified");
 
     ASSERT(m_sampleRate);
@@ -315,12 +587,30 @@ void PannerNode::setPanningModel(PanningModel model)
                 // @TODO setting the panner is not thread safe.
                 // all of this should be part of the processing graph pre-render step.
                 break;
+            case PanningModel::AMBISONIC:
+                m_panner = std::unique_ptr<Panner>(new AmbisonicPanner(m_sampleRate));
+                break;
+            case PanningModel::BINAURAL:
+                m_panner = std::unique_ptr<Panner>(new BinauralPanner(m_sampleRate));
+                break;
             default:
                 throw std::invalid_argument("invalid panning model");
         }
     }
 }
 
+int PannerNode::ambisonicOrder() const
+{
+    return std::max(1, std::min(static_cast<int>(m_ambisonicOrder->valueUint32()), MaxAmbisonicOrder));
+}
+
+void PannerNode::setAmbisonicOrder(int order)
+{
+    if (order < 1 || order > MaxAmbisonicOrder)
+        throw std::invalid_argument("Ambisonic orders run from 1 to 3");
+    m_ambisonicOrder->setUint32(static_cast<uint32_t>(order));
+}
+
 void PannerNode::setDistanceModel(DistanceModel model)
 {
     m_distanceModel->setUint32(static_cast<uint32_t>(model));
@@ -334,11 +624,8 @@ void PannerNode::getAzimuthElevation(ContextRenderLock & r, double * outAzimuth,
 {
     // FIXME: we should cache azimuth and elevation (if possible), so we only re-calculate if a change has been made.
 
-    double azimuth = 0.0;
-
     auto listener = r.context()->listener();
 
-    // Calculate the source-listener vector
     /// @fixme these values should be per sample, not per quantum
     FloatPoint3D listenerPosition = {
         listener->positionX()->value(),
@@ -346,27 +633,13 @@ void PannerNode::getAzimuthElevation(ContextRenderLock & r, double * outAzimuth,
         listener->positionZ()->value()};
 
     /// @fixme these values should be per sample, not per quantum
-    FloatPoint3D sourceListener = {
-        positionX()->value(),
-        positionY()->value(),
-        positionZ()->value()};
-
-    sourceListener = normalize(sourceListener - listenerPosition);
-
-    if (is_zero(sourceListener))
-    {
-        // degenerate case if source and listener are at the same point
-        *outAzimuth = 0.0;
-        *outElevation = 0.0;
-        return;
-    }
+    const FloatPoint3D position = sourceTransform(r).position;
 
-    // Align axes
     /// @fixme these values should be per sample, not per quantum
-    FloatPoint3D listenerFront = normalize(FloatPoint3D{
+    FloatPoint3D listenerFront = {
         listener->forwardX()->value(),
         listener->forwardY()->value(),
-        listener->forwardZ()->value()});
+        listener->forwardZ()->value()};
 
     /// @fixme these values should be per sample, not per quantum
     FloatPoint3D listenerUp = {
@@ -374,6 +647,52 @@ void PannerNode::getAzimuthElevation(ContextRenderLock & r, double * outAzimuth,
         listener->upY()->value(),
         listener->upZ()->value()};
 
+    cachedAzimuthElevation(position, listenerPosition, listenerFront, listenerUp, outAzimuth, outElevation);
+}
+
+void PannerNode::cachedAzimuthElevation(const FloatPoint3D & position, const FloatPoint3D & listenerPosition,
+                                        const FloatPoint3D & listenerForward, const FloatPoint3D & listenerUp,
+                                        double * outAzimuth, double * outElevation)
+{
+    AzimuthElevationCache & cache = m_azimuthElevationCache;
+    if (!cache.valid || cache.position != position || cache.listenerPosition != listenerPosition ||
+        cache.listenerForward != listenerForward || cache.listenerUp != listenerUp)
+    {
+        azimuthElevation(position, listenerPosition, listenerForward, listenerUp, &cache.azimuth, &cache.elevation);
+        cache.position = position;
+        cache.listenerPosition = listenerPosition;
+        cache.listenerForward = listenerForward;
+        cache.listenerUp = listenerUp;
+        cache.valid = true;
+    }
+
+    if (outAzimuth)
+        *outAzimuth = cache.azimuth;
+    if (outElevation)
+        *outElevation = cache.elevation;
+}
+
+void PannerNode::azimuthElevation(const FloatPoint3D & position, const FloatPoint3D & listenerPosition,
+                                  const FloatPoint3D & listenerForward, const FloatPoint3D & listenerUp,
+                                  double * outAzimuth, double * outElevation)
+{
+    double azimuth = 0.0;
+
+    // Calculate the source-listener vector
+    FloatPoint3D sourceListener = normalize(position - listenerPosition);
+
+    if (is_zero(sourceListener))
+    {
+        // degenerate case if source and listener are at the same point
+        if (outAzimuth)
+            *outAzimuth = 0.0;
+        if (outElevation)
+            *outElevation = 0.0;
+        return;
+    }
+
+    // Align axes
+    FloatPoint3D listenerFront = normalize(listenerForward);
     FloatPoint3D listenerRight = normalize(cross(listenerFront, listenerUp));
     FloatPoint3D up = cross(listenerRight, listenerFront);
 
@@ -410,13 +729,25 @@ void PannerNode::getAzimuthElevation(ContextRenderLock & r, double * outAzimuth,
         *outElevation = elevation;
 }
 
+SpatialTransform PannerNode::sourceTransform(ContextRenderLock & r) const
+{
+    SpatialTransform t;
+    const int slot = sceneSlot();
+    if (slot >= 0 && r.context() && r.context()->spatialScene()->transform(this, slot, t))
+        return t;
+
+    t.position = {positionX()->value(), positionY()->value(), positionZ()->value()};
+    t.orientation = {orientationX()->value(), orientationY()->value(), orientationZ()->value()};
+    t.velocity = {velocityX()->value(), velocityY()->value(), velocityZ()->value()};
+    return t;
+}
+
 float PannerNode::dopplerRate(ContextRenderLock & r)
 {
     double dopplerShift = 1.0;
 
     auto listener = r.context()->listener();
 
-    // FIXME: optimize for case when neither source nor listener has changed...
     /// @fixme these values should be per sample, not per quantum
     double dopplerFactor = listener->dopplerFactor()->value();
 
@@ -426,10 +757,8 @@ float PannerNode::dopplerRate(ContextRenderLock & r)
         double speedOfSound = listener->speedOfSound()->value();
 
         /// @fixme these values should be per sample, not per quantum
-        const FloatPoint3D sourceVelocity = {
-            velocityX()->value(),
-            velocityY()->value(),
-            velocityZ()->value()};
+        const SpatialTransform transform = sourceTransform(r);
+        const FloatPoint3D & sourceVelocity = transform.velocity;
         /// @fixme these values should be per sample, not per quantum
         const FloatPoint3D listenerVelocity = {
             listener->velocityX()->value(),
@@ -449,13 +778,17 @@ float PannerNode::dopplerRate(ContextRenderLock & r)
                 listener->positionY()->value(),
                 listener->positionZ()->value()};
 
-            /// @fixme these values should be per sample, not per quantum
-            FloatPoint3D sourceToListener = {
-                positionX()->value(),
-                positionY()->value(),
-                positionZ()->value()};
+            const FloatPoint3D & position = transform.position;
 
-            sourceToListener = sourceToListener - listenerPosition;
+            DopplerCache & cache = m_dopplerCache;
+            if (cache.valid && cache.position == position && cache.velocity == sourceVelocity &&
+                cache.listenerPosition == listenerPosition && cache.listenerVelocity == listenerVelocity &&
+                cache.dopplerFactor == dopplerFactor && cache.speedOfSound == speedOfSound)
+            {
+                return cache.rate;
+            }
+
+            FloatPoint3D sourceToListener = position - listenerPosition;
 
             double sourceListenerMagnitude = magnitude(sourceToListener);
 
@@ -477,6 +810,15 @@ float PannerNode::dopplerRate(ContextRenderLock & r)
                 dopplerShift = 16.0;
             else if (dopplerShift < 0.125)
                 dopplerShift = 0.125;
+
+            cache.position = position;
+            cache.velocity = sourceVelocity;
+            cache.listenerPosition = listenerPosition;
+            cache.listenerVelocity = listenerVelocity;
+            cache.dopplerFactor = dopplerFactor;
+            cache.speedOfSound = speedOfSound;
+            cache.rate = static_cast<float>(dopplerShift);
+            cache.valid = true;
         }
     }
 
@@ -494,10 +836,17 @@ float PannerNode::distanceConeGain(ContextRenderLock & r)
         listener->positionZ()->value()};
 
     /// @fixme these values should be per sample, not per quantum
-    FloatPoint3D position = {
-        positionX()->value(),
-        positionY()->value(),
-        positionZ()->value()};
+    const SpatialTransform transform = sourceTransform(r);
+    const FloatPoint3D & position = transform.position;
+    const FloatPoint3D & orientation = transform.orientation;
+
+    GainCache & cache = m_gainCache;
+    const bool settingsChanged = m_gainSettingsChanged.exchange(false);
+    if (!settingsChanged && cache.valid && cache.position == position &&
+        cache.orientation == orientation && cache.listenerPosition == listenerPosition)
+    {
+        return cache.gain;
+    }
 
     double listenerDistance = magnitude(position - listenerPosition);  // "distanceTo"
 
@@ -505,19 +854,16 @@ float PannerNode::distanceConeGain(ContextRenderLock & r)
 
     m_distanceGain->setValue(static_cast<float>(distanceGain));
 
-    // FIXME: could optimize by caching coneGain
-
-    /// @fixme these values should be per sample, not per quantum
-    FloatPoint3D orientation = {
-        orientationX()->value(),
-        orientationY()->value(),
-        orientationZ()->value()};
-
     double coneGain = m_coneEffect->gain(position, orientation, listenerPosition);
 
     m_coneGain->setValue(static_cast<float>(coneGain));
 
-    return float(distanceGain * coneGain);
+    cache.position = position;
+    cache.orientation = orientation;
+    cache.listenerPosition = listenerPosition;
+    cache.gain = float(distanceGain * coneGain);
+    cache.valid = true;
+    return cache.gain;
 }
 
 void PannerNode::notifyAudioSourcesConnectedToNode(ContextRenderLock & r, AudioNode * node)
@@ -593,15 +939,28 @@ float PannerNode::coneOuterGain() const
 void PannerNode::setConeOuterGain(float angle)
 {
     m_coneEffect->setOuterGain(angle);
+    m_gainSettingsChanged = true;
 }
 
 double PannerNode::tailTime(ContextRenderLock & r) const
 {
-    return m_panner ? m_panner->tailTime(r) : 0;
+    // the sound in flight to the listener is still to be heard
+    const double inFlight = m_dopplerDelay && m_doppler->valueBool() ? m_dopplerDelay->delayFrames() / m_sampleRate : 0;
+    double tail = m_panner && m_renderedTier == SpatialTier::Model ? m_panner->tailTime(r) : 0;
+    for (auto & panner : m_tierPanners)
+        if (panner && m_renderedTier != SpatialTier::Model)
+            tail = std::max(tail, panner->tailTime(r));
+    return tail + inFlight;
 }
 double PannerNode::latencyTime(ContextRenderLock & r) const
 {
-    return m_panner ? m_panner->latencyTime(r) : 0;
+    if (m_renderedTier == SpatialTier::Model)
+        return m_panner ? m_panner->latencyTime(r) : 0;
+    double latency = 0;
+    for (auto & panner : m_tierPanners)
+        if (panner)
+            latency = std::max(latency, panner->latencyTime(r));
+    return latency;
 }
 
 }  // namespace lab
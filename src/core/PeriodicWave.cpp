@@ -12,8 +12,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
 
 // The number of bands per octave.  Each octave will have this many entries in the wave tables.
 const unsigned kNumberOfOctaveBands = 3;
@@ -72,6 +78,87 @@ PeriodicWave::~PeriodicWave()
 {
 }
 
+namespace
+{
+    struct WaveCacheEntry
+    {
+        std::vector<float> real;
+        std::vector<float> imag;
+        std::weak_ptr<PeriodicWave> wave;
+    };
+
+    // keyed by sample rate, waveform, and a hash of the coefficients; entries with the same
+    // key are told apart by comparing the coefficients themselves
+    typedef std::tuple<float, int, uint64_t> WaveCacheKey;
+
+    std::mutex s_waveCacheMutex;
+    std::multimap<WaveCacheKey, WaveCacheEntry> s_waveCache;
+
+    uint64_t hashCoefficients(const std::vector<float> & real, const std::vector<float> & imag)
+    {
+        // FNV-1a over the bytes of the coefficients
+        uint64_t hash = 14695981039346656037ull;
+        for (const std::vector<float> * v : {&real, &imag})
+        {
+            const uint8_t * bytes = reinterpret_cast<const uint8_t *>(v->data());
+            for (size_t i = 0; i < v->size() * sizeof(float); ++i)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::shared_ptr<PeriodicWave> sharedWave(float sampleRate, OscillatorType type, const std::vector<float> & real, const std::vector<float> & imag)
+    {
+        const WaveCacheKey key(sampleRate, static_cast<int>(type), hashCoefficients(real, imag));
+
+        std::lock_guard<std::mutex> lock(s_waveCacheMutex);
+        auto range = s_waveCache.equal_range(key);
+        for (auto it = range.first; it != range.second;)
+        {
+            if (std::shared_ptr<PeriodicWave> wave = it->second.wave.lock())
+            {
+                if (it->second.real == real && it->second.imag == imag)
+                    return wave;
+                ++it;
+            }
+            else
+                it = s_waveCache.erase(it);  // the last user released it
+        }
+
+        std::shared_ptr<PeriodicWave> wave;
+        if (type == OscillatorType::CUSTOM)
+        {
+            std::vector<float> r = real, i = imag;
+            wave = std::make_shared<PeriodicWave>(sampleRate, type, r, i);
+        }
+        else
+            wave = std::make_shared<PeriodicWave>(sampleRate, type);
+
+        s_waveCache.emplace(key, WaveCacheEntry {real, imag, wave});
+        return wave;
+    }
+}
+
+std::shared_ptr<PeriodicWave> PeriodicWave::shared(float sampleRate, OscillatorType basicWaveform)
+{
+    switch (basicWaveform)
+    {
+        case OscillatorType::SINE:
+        case OscillatorType::SQUARE:
+        case OscillatorType::SAWTOOTH:
+        case OscillatorType::TRIANGLE:
+            break;
+        default:
+            throw std::invalid_argument("PeriodicWave tables can only be generated for sine, square, sawtooth and triangle waves");
+    }
+    return sharedWave(sampleRate, basicWaveform, {}, {});
+}
+
+std::shared_ptr<PeriodicWave> PeriodicWave::shared(float sampleRate, const std::vector<float> & real, const std::vector<float> & imag)
+{
+    return sharedWave(sampleRate, OscillatorType::CUSTOM, real, imag);
+}
+
 unsigned PeriodicWave::periodicWaveSize() const
 {
     // Choose an appropriate wave size for the given sample rate.  This allows us to use shorter
@@ -136,6 +223,7 @@ int PeriodicWave::numberOfPartialsForRange(int rangeIndex) const
 // Thus, higher ranges have more high-frequency partials culled out.
 void PeriodicWave::createBandLimitedTables(const float * realData, const float * imagData, int numberOfComponents)
 {
+    MemoryOwnerScope memoryScope(MemoryAccounting::subsystem("periodic waves"));
     float normalizationScale = 1.f;
 
     int fftSize = periodicWaveSize();
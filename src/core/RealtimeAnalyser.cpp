@@ -3,8 +3,8 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNode.h"
 #include "LabSound/core/Macros.h"
-#include "LabSound/core/WindowFunctions.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/RealtimeAnalyser.h"
@@ -13,11 +13,11 @@
 
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
-#include "internal/FFTFrame.h"
+#include "internal/SpectralAnalysis.h"
 
 #include <algorithm>
-#include <complex>
 #include <limits.h>
+#include <limits>
 
 using namespace std;
 
@@ -34,9 +34,19 @@ const int RealtimeAnalyser::MinFFTSize = 32;
 const int RealtimeAnalyser::MaxFFTSize = 2048;
 const int RealtimeAnalyser::InputBufferSize = RealtimeAnalyser::MaxFFTSize * 2;
 
+namespace
+{
+    // Bits of m_requests
+    const int RequestSpectrum = 1;
+    const int RequestWaveform = 2;
+
+    // m_middleSnapshot holds a snapshot index, marked fresh until the reader takes it
+    const int SnapshotIndex = 3;
+    const int FreshSnapshot = 4;
+}
+
 RealtimeAnalyser::RealtimeAnalyser(int fftSize)
-    : m_inputBuffer(InputBufferSize)
-    , m_writeIndex(0)
+    : m_byteScratch(MaxFFTSize / 2)
     , m_smoothingTimeConstant(DefaultSmoothingTimeConstant)
     , m_minDecibels(DefaultMinDecibels)
     , m_maxDecibels(DefaultMaxDecibels)
@@ -44,103 +54,97 @@ RealtimeAnalyser::RealtimeAnalyser(int fftSize)
     uint32_t size = max(min(RoundNextPow2(fftSize), MaxFFTSize), MinFFTSize);
     m_fftSize = size;
 
-    m_analysisFrame = std::unique_ptr<FFTFrame>(new FFTFrame(size));
-
-    // m_magnitudeBuffer has size = fftSize / 2 because it contains floats reduced from complex values in m_analysisFrame.
+    // m_magnitudeBuffer has size = fftSize / 2 because it contains floats reduced from complex values in the analysis.
     m_magnitudeBuffer.allocate(size / 2);
+    makeAnalysis();
+
+    // the snapshots hold the largest analysis, so publishing never allocates
+    for (Snapshot & snapshot : m_snapshots)
+    {
+        snapshot.magnitudes.allocate(MaxFFTSize / 2);
+        snapshot.timeDomain.allocate(MaxFFTSize);
+    }
 }
 
 RealtimeAnalyser::~RealtimeAnalyser() {}
 
 void RealtimeAnalyser::reset()
 {
-    m_writeIndex = 0;
-    m_inputBuffer.zero();
+    // a shared analysis carries on for the analysers still using it
+    m_ownAnalysis->reset();
+    m_analysis = m_ownAnalysis;
+    m_tap = nullptr;
+    m_smoothedHop = ~uint64_t(0);
     m_magnitudeBuffer.zero();
 }
 
 void RealtimeAnalyser::setFftSize(int fftSize)
 {
-    m_writeIndex = 0;
-
     int size = max(min(RoundNextPow2(fftSize), MaxFFTSize), MinFFTSize);
     m_fftSize = size;
 
-    m_analysisFrame = std::unique_ptr<FFTFrame>(new FFTFrame(size));
-
-    m_inputBuffer.zero();
     m_magnitudeBuffer.allocate(size / 2);
+    makeAnalysis();
 }
 
-void RealtimeAnalyser::writeInput(ContextRenderLock & r, AudioBus * bus, int framesToProcess)
+void RealtimeAnalyser::makeAnalysis()
+{
+    m_ownAnalysis = std::make_shared<SpectralAnalysis>(m_fftSize, AudioNode::ProcessingSizeInFrames);
+    m_analysis = m_ownAnalysis;
+    m_tap = nullptr;
+    m_smoothedHop = ~uint64_t(0);
+}
+
+void RealtimeAnalyser::writeInput(ContextRenderLock & r, AudioBus * bus, int framesToProcess, const void * tap)
 {
     bool isBusGood = bus && bus->numberOfChannels() > 0 && bus->channel(0)->length() >= framesToProcess && r.context();
     if (!isBusGood)
         return;
 
-    // FIXME : allow to work with non-FFTSize divisible chunking
-    bool isDestinationGood = m_writeIndex < m_inputBuffer.size() && m_writeIndex + framesToProcess <= m_inputBuffer.size();
-    ASSERT(isDestinationGood);
-    if (!isDestinationGood)
-        return;
-
-    // copy data for analysis
-    const float * source = bus->channel(0)->data();
-    float * dest = m_inputBuffer.data() + m_writeIndex;
-
-    // The source has already been sanity checked with isBusGood above.
-    memcpy(dest, source, sizeof(float) * framesToProcess);
-
-    // Sum all channels in one if numberOfChannels > 1.
-    const size_t numberOfChannels = bus->numberOfChannels();
-    if (numberOfChannels > 1)
+    if (tap != m_tap)
     {
-        for (int i = 1; i < numberOfChannels; i++)
-        {
-            source = bus->channel(i)->data();
-            VectorMath::vadd(dest, 1, source, 1, dest, 1, framesToProcess);
-        }
-        const float scale = 1.f / numberOfChannels;
-        VectorMath::vsmul(dest, 1, &scale, dest, 1, framesToProcess);
+        m_tap = tap;
+        m_analysis = SpectralAnalysis::share(tap, m_ownAnalysis);
+        m_smoothedHop = ~uint64_t(0);
     }
+    m_analysis->write(r.context()->currentSampleFrame(), bus, framesToProcess);
 
-    m_writeIndex += framesToProcess;
-    if (m_writeIndex >= InputBufferSize)
-        m_writeIndex = 0;
+    // Nothing is analysed until a reader asks for it
+    if (m_requests.load(std::memory_order_relaxed))
+        publish((m_requests.exchange(0, std::memory_order_acquire) & RequestSpectrum) != 0);
 }
 
-void RealtimeAnalyser::doFFTAnalysis()
+void RealtimeAnalyser::publish(bool analyse)
 {
-    // Unroll the input buffer into a temporary buffer, where we'll apply an analysis window followed by an FFT.
-    uint32_t fftSize = this->fftSize();
+    Snapshot & snapshot = m_snapshots[m_backSnapshot];
 
-    AudioFloatArray temporaryBuffer(fftSize);
-    float * inputBuffer = m_inputBuffer.data();
-    float * tempP = temporaryBuffer.data();
+    // Take the previous fftSize values from the analysis, oldest first.
+    m_analysis->copyLatestFrames(snapshot.timeDomain.data());
 
-    // Take the previous fftSize values from the input buffer and copy into the temporary buffer.
-    size_t writeIndex = m_writeIndex;
-    if (writeIndex < fftSize)
-    {
-        memcpy(tempP, inputBuffer + writeIndex - fftSize + InputBufferSize, sizeof(*tempP) * (fftSize - writeIndex));
-        memcpy(tempP + fftSize - writeIndex, inputBuffer, sizeof(*tempP) * writeIndex);
-    }
-    else
-    {
-        memcpy(tempP, inputBuffer + writeIndex - fftSize, sizeof(*tempP) * fftSize);
-    }
+    // A snapshot published only for the time domain data keeps the last spectrum
+    if (analyse)
+        doFFTAnalysis();
+    memcpy(snapshot.magnitudes.data(), magnitudeBuffer().data(), sizeof(float) * magnitudeBuffer().size());
 
-    // Window the input samples.
-    ApplyWindowFunctionInplace(WindowFunction::blackman, tempP, fftSize);
+    m_backSnapshot = m_middleSnapshot.exchange(m_backSnapshot | FreshSnapshot, std::memory_order_acq_rel) & SnapshotIndex;
+}
 
-    // Do the analysis.
-    m_analysisFrame->computeForwardFFT(tempP);
+const RealtimeAnalyser::Snapshot & RealtimeAnalyser::latestSnapshot()
+{
+    if (m_middleSnapshot.load(std::memory_order_relaxed) & FreshSnapshot)
+        m_frontSnapshot = m_middleSnapshot.exchange(m_frontSnapshot, std::memory_order_acq_rel) & SnapshotIndex;
+    return m_snapshots[m_frontSnapshot];
+}
 
-    float * realP = m_analysisFrame->realData();
-    float * imagP = m_analysisFrame->imagData();
+void RealtimeAnalyser::doFFTAnalysis()
+{
+    // Each hop's spectrum is smoothed in once, however often it is asked for.
+    const uint64_t hop = m_analysis->hops();
+    if (hop == m_smoothedHop)
+        return;
+    m_smoothedHop = hop;
 
-    // Erase the packed nyquist component.
-    imagP[0] = 0;
+    const float * magnitudes = m_analysis->magnitudes();
 
     // Normalize so than an input sine wave at 0dBfs registers as 0dBfs (undo FFT scaling factor).
     const double magnitudeScale = 1.0 / DefaultFFTSize;
@@ -150,31 +154,32 @@ void RealtimeAnalyser::doFFTAnalysis()
     k = max(0.0, k);
     k = min(1.0, k);
 
-    // Convert the analysis data from complex to magnitude and average with the previous result.
+    // Scale the magnitudes and average them with the previous result.
     float * destination = magnitudeBuffer().data();
     size_t n = magnitudeBuffer().size();
     for (size_t i = 0; i < n; ++i)
     {
-        std::complex<double> c(realP[i], imagP[i]);
-        double scalarMagnitude = abs(c) * magnitudeScale;
-        destination[i] = float(k * destination[i] + (1 - k) * scalarMagnitude);
+        double scalarMagnitude = magnitudes[i] * magnitudeScale;
+        const float magnitude = float(k * destination[i] + (1 - k) * scalarMagnitude);
+
+        // Silent bins decay into denormals, which are slow to smooth and to convert to decibels
+        destination[i] = magnitude < std::numeric_limits<float>::min() ? 0.f : magnitude;
     }
 }
 
 void RealtimeAnalyser::getFloatFrequencyData(std::vector<float> & destinationArray)
 {
+    m_requests.fetch_or(RequestSpectrum, std::memory_order_release);
     if (!destinationArray.size())
         return;
 
-    doFFTAnalysis();
-
     // Convert from linear magnitude to floating-point decibels.
     const double minDecibels = m_minDecibels;
-    size_t sourceLength = magnitudeBuffer().size();
+    size_t sourceLength = frequencyBinCount();
     size_t len = min(sourceLength, destinationArray.size());
     if (len > 0)
     {
-        const float * source = magnitudeBuffer().data();
+        const float * source = latestSnapshot().magnitudes.data();
         for (size_t i = 0; i < len; ++i)
         {
             float linearValue = source[i];
@@ -186,31 +191,27 @@ void RealtimeAnalyser::getFloatFrequencyData(std::vector<float> & destinationArr
 
 void RealtimeAnalyser::getByteFrequencyData(std::vector<uint8_t> & destinationArray, bool resample)
 {
-    if (!destinationArray.size() || !magnitudeBuffer().size())
+    m_requests.fetch_or(RequestSpectrum, std::memory_order_release);
+    if (!destinationArray.size() || !frequencyBinCount())
         return;
 
-    doFFTAnalysis();
-
-    size_t len = destinationArray.size();
+    size_t len = min(destinationArray.size(), size_t(frequencyBinCount()));
     uint8_t * dest = &destinationArray[0];
-    std::vector<uint8_t> result;
     if (destinationArray.size() == frequencyBinCount())
         resample = false;
     else
     {
         if (resample) {
             len = frequencyBinCount();
-            result.resize(len);
-            dest = &result[0];
+            dest = m_byteScratch.data();
         }
     }
 
     // Convert from linear magnitude to unsigned-byte decibels.
-    size_t sourceLength = magnitudeBuffer().size();
     const double rangeScaleFactor = m_maxDecibels == m_minDecibels ? 1 : 1 / (m_maxDecibels - m_minDecibels);
     const double minDecibels = m_minDecibels;
 
-    const float * source = magnitudeBuffer().data();
+    const float * source = latestSnapshot().magnitudes.data();
     for (size_t i = 0; i < len; ++i)
     {
         float linearValue = source[i];
@@ -277,30 +278,20 @@ void RealtimeAnalyser::getByteFrequencyData(std::vector<uint8_t> & destinationAr
 // LabSound begin
 void RealtimeAnalyser::getFloatTimeDomainData(std::vector<float> & destinationArray)
 {
+    m_requests.fetch_or(RequestWaveform, std::memory_order_release);
     if (!destinationArray.size())
         return;
 
     size_t fftSize = this->fftSize();
     size_t len = min(fftSize, destinationArray.size());
     if (len > 0)
-    {
-        bool isInputBufferGood = m_inputBuffer.size() == InputBufferSize && m_inputBuffer.size() > fftSize;
-        ASSERT(isInputBufferGood);
-        if (!isInputBufferGood)
-            return;
-
-        float * inputBuffer = m_inputBuffer.data();
-        size_t writeIndex = m_writeIndex;
-
-        for (size_t i = 0; i < len; ++i)
-            // Buffer access is protected due to modulo operation.
-            destinationArray[i] = inputBuffer[(i + writeIndex - fftSize + InputBufferSize) % InputBufferSize];
-    }
+        memcpy(destinationArray.data(), latestSnapshot().timeDomain.data(), sizeof(float) * len);
 }
 // LabSound end
 
 void RealtimeAnalyser::getByteTimeDomainData(std::vector<uint8_t> & destinationArray)
 {
+    m_requests.fetch_or(RequestWaveform, std::memory_order_release);
     if (!destinationArray.size())
         return;
 
@@ -308,21 +299,13 @@ void RealtimeAnalyser::getByteTimeDomainData(std::vector<uint8_t> & destinationA
     size_t len = min(fftSize, destinationArray.size());
     if (len > 0)
     {
-        bool isInputBufferGood = m_inputBuffer.size() == InputBufferSize && m_inputBuffer.size() > fftSize;
-        ASSERT(isInputBufferGood);
-        if (!isInputBufferGood)
-            return;
-
-        float * inputBuffer = m_inputBuffer.data();
-        size_t writeIndex = m_writeIndex;
-
+        const float * timeDomain = latestSnapshot().timeDomain.data();
         for (size_t i = 0; i < len; ++i)
         {
-            // Buffer access is protected due to modulo operation.
-            float value = inputBuffer[(i + writeIndex - fftSize + InputBufferSize) % InputBufferSize];
+            float value = timeDomain[i];
 
             // Scale from nominal -1 -> +1 to unsigned byte.
-            double scaledValue = AudioNode::ProcessingSizeInFrames * (value + 1);
+            double scaledValue = 128 * (value + 1);
 
             // Clip to valid range.
             if (scaledValue < 0)
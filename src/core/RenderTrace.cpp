@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/RenderTrace.h"
+#include "LabSound/core/Profiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+// suppress warnings about fopen
+#pragma warning(disable : 4996)
+#endif
+
+namespace lab
+{
+
+std::atomic<bool> RenderTrace::s_enabled {false};
+
+namespace
+{
+    struct Event
+    {
+        const char * name;
+        const char * category;
+        int64_t begin;
+        int64_t end;  // negative for an instant
+    };
+
+    // written only by the thread that claimed it
+    struct ThreadBuffer
+    {
+        std::unique_ptr<Event[]> events;
+        std::atomic<int> count {0};
+        std::atomic<const char *> name {nullptr};
+    };
+
+    struct Trace
+    {
+        std::mutex mutex;  // taken by start and writeChromeJson only
+        std::unique_ptr<ThreadBuffer[]> buffers;
+        int threads = 0;
+        int capacity = 0;
+        int64_t origin = 0;
+
+        std::atomic<int> claimed {0};
+        std::atomic<uint32_t> generation {0};  // of the recording; a thread claims a buffer in each
+        std::atomic<uint64_t> dropped {0};
+    };
+
+    Trace & trace()
+    {
+        static Trace t;
+        return t;
+    }
+
+    thread_local ThreadBuffer * t_buffer = nullptr;
+    thread_local uint32_t t_generation = 0;
+
+    // the calling thread's buffer in the current recording, or null if there were too few
+    ThreadBuffer * threadBuffer()
+    {
+        Trace & t = trace();
+        const uint32_t generation = t.generation.load(std::memory_order_acquire);
+        if (t_generation != generation)
+        {
+            const int slot = t.claimed.fetch_add(1, std::memory_order_relaxed);
+            t_buffer = slot < t.threads ? &t.buffers[slot] : nullptr;
+            t_generation = generation;
+        }
+        return t_buffer;
+    }
+
+    void append(const Event & e)
+    {
+        ThreadBuffer * buffer = threadBuffer();
+        const int n = buffer ? buffer->count.load(std::memory_order_relaxed) : 0;
+        if (!buffer || n >= trace().capacity)
+        {
+            trace().dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer->events[n] = e;
+        buffer->count.store(n + 1, std::memory_order_release);
+    }
+
+    void writeString(FILE * file, const char * s)
+    {
+        fputc('"', file);
+        for (; s && *s; ++s)
+        {
+            if (*s == '"' || *s == '\\')
+                fputc('\\', file);
+            if (static_cast<unsigned char>(*s) >= 0x20)
+                fputc(*s, file);
+        }
+        fputc('"', file);
+    }
+}
+
+void RenderTrace::start(int eventsPerThread, int threads)
+{
+    Trace & t = trace();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    s_enabled.store(false);
+
+    if (!t.buffers && eventsPerThread > 0 && threads > 0)
+    {
+        t.buffers.reset(new ThreadBuffer[threads]);
+        for (int i = 0; i < threads; ++i)
+            t.buffers[i].events.reset(new Event[eventsPerThread]);
+        t.threads = threads;
+        t.capacity = eventsPerThread;
+    }
+
+    for (int i = 0; i < t.threads; ++i)
+    {
+        t.buffers[i].count.store(0);
+        t.buffers[i].name.store(nullptr);
+    }
+    t.claimed.store(0);
+    t.dropped.store(0);
+    t.origin = now();
+    t.generation.fetch_add(1, std::memory_order_release);
+    s_enabled.store(true);
+}
+
+void RenderTrace::stop()
+{
+    s_enabled.store(false);
+}
+
+uint64_t RenderTrace::droppedEvents()
+{
+    return trace().dropped.load();
+}
+
+int64_t RenderTrace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ProfileClock::now().time_since_epoch()).count();
+}
+
+void RenderTrace::record(const char * name, const char * category, int64_t begin, int64_t end)
+{
+    if (enabled())
+        append({name, category, begin, end});
+}
+
+void RenderTrace::instant(const char * name, const char * category)
+{
+    if (enabled())
+        append({name, category, now(), -1});
+}
+
+void RenderTrace::nameThread(const char * name)
+{
+    if (!enabled())
+        return;
+    if (ThreadBuffer * buffer = threadBuffer())
+        buffer->name.store(name, std::memory_order_relaxed);
+}
+
+bool RenderTrace::writeChromeJson(const std::string & path)
+{
+    Trace & t = trace();
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    FILE * file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first = true;
+    const int threads = std::min(t.claimed.load(), t.threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        const ThreadBuffer & buffer = t.buffers[i];
+        const int tid = i + 1;
+        if (const char * name = buffer.name.load(std::memory_order_relaxed))
+        {
+            fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", tid);
+            writeString(file, name);
+            fputs("}}", file);
+            first = false;
+        }
+
+        const int count = buffer.count.load(std::memory_order_acquire);
+        for (int e = 0; e < count; ++e)
+        {
+            const Event & event = buffer.events[e];
+            fputs(first ? "{\"name\":" : ",\n{\"name\":", file);
+            first = false;
+            writeString(file, event.name);
+            fputs(",\"cat\":", file);
+            writeString(file, event.category);
+
+            // microseconds, from the start of the recording
+            const double ts = (event.begin - t.origin) * 1.e-3;
+            if (event.end < 0)
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", tid, ts);
+            else
+                fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", tid, ts, (event.end - event.begin) * 1.e-3);
+        }
+    }
+    fputs("\n]}\n", file);
+    return fclose(file) == 0;
+}
+
+}  // lab
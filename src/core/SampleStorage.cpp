@@ -0,0 +1,308 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/SampleStorage.h"
+#include "LabSound/core/AudioBus.h"
+
+#include "internal/Assertions.h"
+#include "internal/MappedFile.h"
+#include "internal/PCMFileReader.h"
+#include "internal/SampleConversion.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    // IMA ADPCM, as in the IMA Digital Audio Focus and Technical Working Groups'
+    // recommended practice. Each block starts with the predictor and step index, four
+    // bytes, followed by a nibble per frame, low nibble first.
+    const int AdpcmHeaderBytes = 4;
+    const int AdpcmBlockBytes = AdpcmHeaderBytes + SampleStorage::AdpcmBlockFrames / 2;
+
+    const int AdpcmIndexTable[16] = {
+        -1, -1, -1, -1, 2, 4, 6, 8,
+        -1, -1, -1, -1, 2, 4, 6, 8};
+
+    const int AdpcmStepTable[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+        19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+        50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+        130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+        337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+        876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+        2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+        5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+        15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+    struct AdpcmState
+    {
+        int predictor = 0;
+        int index = 0;
+
+        int decode(int code)
+        {
+            const int step = AdpcmStepTable[index];
+            int delta = step >> 3;
+            if (code & 4) delta += step;
+            if (code & 2) delta += step >> 1;
+            if (code & 1) delta += step >> 2;
+            predictor += (code & 8) ? -delta : delta;
+            predictor = std::min(32767, std::max(-32768, predictor));
+            index = std::min(88, std::max(0, index + AdpcmIndexTable[code]));
+            return predictor;
+        }
+
+        int encode(int sample)
+        {
+            int diff = sample - predictor;
+            int code = 0;
+            if (diff < 0)
+            {
+                code = 8;
+                diff = -diff;
+            }
+            int step = AdpcmStepTable[index];
+            for (int bit = 4; bit; bit >>= 1, step >>= 1)
+            {
+                if (diff >= step)
+                {
+                    code |= bit;
+                    diff -= step;
+                }
+            }
+            // update the state exactly as the decoder will
+            decode(code);
+            return code;
+        }
+    };
+
+    void encodeAdpcm(const int16_t * samples, int length, uint8_t * destination)
+    {
+        AdpcmState state;
+        for (int start = 0; start < length; start += SampleStorage::AdpcmBlockFrames)
+        {
+            // start each block from the previous sample, rather than from the prediction of
+            // it, so that errors don't carry across blocks
+            if (start > 0)
+                state.predictor = samples[start - 1];
+
+            uint8_t * block = destination + (start / SampleStorage::AdpcmBlockFrames) * AdpcmBlockBytes;
+            block[0] = static_cast<uint8_t>(state.predictor);
+            block[1] = static_cast<uint8_t>(state.predictor >> 8);
+            block[2] = static_cast<uint8_t>(state.index);
+            block[3] = 0;
+
+            const int count = std::min(SampleStorage::AdpcmBlockFrames, length - start);
+            uint8_t * nibbles = block + AdpcmHeaderBytes;
+            for (int i = 0; i < count; ++i)
+            {
+                const int code = state.encode(samples[start + i]);
+                if (i & 1)
+                    nibbles[i >> 1] |= static_cast<uint8_t>(code << 4);
+                else
+                    nibbles[i >> 1] = static_cast<uint8_t>(code);
+            }
+        }
+    }
+
+    void decodeAdpcm(const uint8_t * source, int frame, int count, float * destination)
+    {
+        while (count > 0)
+        {
+            const int offset = frame % SampleStorage::AdpcmBlockFrames;
+            const int n = std::min(count, SampleStorage::AdpcmBlockFrames - offset);
+            const uint8_t * block = source + (frame / SampleStorage::AdpcmBlockFrames) * AdpcmBlockBytes;
+            const uint8_t * nibbles = block + AdpcmHeaderBytes;
+
+            AdpcmState state;
+            state.predictor = static_cast<int16_t>(block[0] | (block[1] << 8));
+            state.index = block[2];
+
+            // blocks decode from their start, so run up to the first requested frame
+            for (int i = 0; i < offset; ++i)
+                state.decode((nibbles[i >> 1] >> ((i & 1) << 2)) & 0xf);
+            for (int i = offset; i < offset + n; ++i)
+                *destination++ = state.decode((nibbles[i >> 1] >> ((i & 1) << 2)) & 0xf) * (1.f / 32768.f);
+
+            frame += n;
+            count -= n;
+        }
+    }
+
+    int bytesPerSample(SampleStorage::Format format)
+    {
+        return format == SampleStorage::Format::Float32 ? sizeof(float) : sizeof(int16_t);
+    }
+}
+
+SampleStorage::SampleStorage(Format format, int channels, int length, float sampleRate)
+    : m_format(format)
+    , m_length(length)
+    , m_sampleRate(sampleRate)
+    , m_channels(channels)
+{
+}
+
+std::shared_ptr<SampleStorage> SampleStorage::create(const AudioBus & bus, Format format)
+{
+    const int length = bus.length();
+    std::shared_ptr<SampleStorage> storage(new SampleStorage(format, bus.numberOfChannels(), length, bus.sampleRate()));
+
+    std::vector<int16_t> samples(length);
+    for (int c = 0; c < bus.numberOfChannels(); ++c)
+    {
+        const float * source = bus.channel(c)->data();
+        SampleConversion::interleave(&source, 1, length, SampleConversion::SampleFormat::Int16, samples.data());
+
+        std::vector<uint8_t> & data = storage->m_channels[c];
+        if (format == Format::Float32)
+        {
+            data.resize(length * sizeof(float));
+            SampleConversion::interleave(&source, 1, length, SampleConversion::SampleFormat::Float32, data.data());
+        }
+        else if (format == Format::Int16)
+        {
+            data.resize(length * sizeof(int16_t));
+            std::copy(samples.begin(), samples.end(), reinterpret_cast<int16_t *>(data.data()));
+        }
+        else
+        {
+            const int blocks = (length + AdpcmBlockFrames - 1) / AdpcmBlockFrames;
+            data.resize(size_t(blocks) * AdpcmBlockBytes);
+            encodeAdpcm(samples.data(), length, data.data());
+        }
+    }
+    return storage;
+}
+
+std::shared_ptr<SampleStorage> SampleStorage::map(const std::string & path)
+{
+    // the reader finds the samples, and is done with the file
+    PCMFileReader reader;
+    if (!reader.open(path))
+        return nullptr;
+
+    Format format;
+    if (reader.format() == SampleConversion::SampleFormat::Int16)
+        format = Format::Int16;
+    else if (reader.format() == SampleConversion::SampleFormat::Float32)
+        format = Format::Float32;
+    else
+        return nullptr;
+
+    return mapFrames(path, format, reader.channelCount(), reader.sampleRate(), reader.dataOffset(), reader.lengthInFrames());
+}
+
+std::shared_ptr<SampleStorage> SampleStorage::mapRaw(const std::string & path, Format format, int channels,
+                                                     float sampleRate, size_t dataOffset)
+{
+    if (format == Format::ImaAdpcm || channels <= 0)
+        return nullptr;
+    return mapFrames(path, format, channels, sampleRate, dataOffset, UINT64_MAX);
+}
+
+std::shared_ptr<SampleStorage> SampleStorage::mapFrames(const std::string & path, Format format, int channels,
+                                                        float sampleRate, uint64_t dataOffset, uint64_t frames)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file || dataOffset >= file->size())
+        return nullptr;
+
+    // a truncated file plays the frames it has
+    const uint64_t frameBytes = uint64_t(channels) * bytesPerSample(format);
+    frames = std::min(frames, (file->size() - dataOffset) / frameBytes);
+    if (!frames || frames > uint64_t(INT32_MAX))
+        return nullptr;
+
+    std::shared_ptr<SampleStorage> storage(new SampleStorage(format, channels, static_cast<int>(frames), sampleRate));
+    storage->m_mapped = file->data() + dataOffset;
+    storage->m_file = std::move(file);
+    return storage;
+}
+
+const uint8_t * SampleStorage::samples(int channel) const
+{
+    if (m_file)
+        return m_mapped + size_t(channel) * bytesPerSample(m_format);
+    return m_channels[channel].data();
+}
+
+size_t SampleStorage::sizeInBytes() const
+{
+    if (m_file)
+        return size_t(m_length) * numberOfChannels() * bytesPerSample(m_format);
+
+    size_t size = 0;
+    for (const std::vector<uint8_t> & data : m_channels)
+        size += data.size();
+    return size;
+}
+
+void SampleStorage::read(int channel, int frame, int count, float * destination) const
+{
+    ASSERT(channel >= 0 && channel < numberOfChannels());
+    ASSERT(frame >= 0 && frame + count <= m_length);
+    if (count <= 0)
+        return;
+
+    if (m_format == Format::ImaAdpcm)
+    {
+        decodeAdpcm(m_channels[channel].data(), frame, count, destination);
+        return;
+    }
+
+    // samples are copied out rather than loaded in place, as a mapped file's samples
+    // needn't be aligned
+    const int stride = this->stride();
+    const int bytes = bytesPerSample(m_format);
+    const uint8_t * data = samples(channel) + size_t(frame) * stride * bytes;
+    if (m_format == Format::Float32)
+    {
+        if (stride == 1)
+            memcpy(destination, data, size_t(count) * sizeof(float));
+        else
+            for (int i = 0; i < count; ++i, data += stride * sizeof(float))
+                memcpy(destination + i, data, sizeof(float));
+    }
+    else if (stride == 1 && !(reinterpret_cast<uintptr_t>(data) & 1))
+        SampleConversion::deinterleave(data, SampleConversion::SampleFormat::Int16, 1, count, &destination);
+    else
+    {
+        for (int i = 0; i < count; ++i, data += stride * sizeof(int16_t))
+        {
+            int16_t sample;
+            memcpy(&sample, data, sizeof(sample));
+            destination[i] = sample * (1.f / 32768.f);
+        }
+    }
+}
+
+void SampleStorage::prefetch(int frame, int count) const
+{
+    if (!m_file)
+        return;
+
+    frame = std::max(0, std::min(frame, m_length));
+    count = std::max(0, std::min(count, m_length - frame));
+    if (!count)
+        return;
+
+    // the channels are interleaved, so the frames' pages hold every channel
+    const size_t frameBytes = size_t(numberOfChannels()) * bytesPerSample(m_format);
+    m_file->prefetch(size_t(m_mapped - m_file->data()) + size_t(frame) * frameBytes, size_t(count) * frameBytes);
+}
+
+std::unique_ptr<AudioBus> SampleStorage::createBus() const
+{
+    std::unique_ptr<AudioBus> bus(new AudioBus(numberOfChannels(), m_length));
+    bus->setSampleRate(m_sampleRate);
+    for (int c = 0; c < numberOfChannels(); ++c)
+        read(c, 0, m_length, bus->channel(c)->mutableData());
+    return bus;
+}
+
+}  // namespace lab
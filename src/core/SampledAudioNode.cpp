@@ -9,14 +9,21 @@
 #include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/core/SampleStorage.h"
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/JobSystem.h"
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
+#include "internal/DeferredRelease.h"
+#include "internal/TimeStretch.h"
 
 #include "concurrentqueue/concurrentqueue.h"
-#include "libsamplerate/include/samplerate.h"
+
+#include <atomic>
+#include <chrono>
 
 using namespace lab;
 
@@ -29,24 +36,85 @@ namespace lab {
     * start/stop(when)
      */
 
-    struct SRC_Resampler
+    // Windowed sinc coefficients for each of Phases fractional positions between source
+    // frames, plus one so that neighbouring phases can be interpolated. When the source is
+    // read faster than the context's rate, a band with a lower cutoff keeps the
+    // frequencies above the context's Nyquist from aliasing.
+    struct SincTable
     {
-        SRC_STATE* sampler = nullptr;
-        SRC_DATA data;
+        static const int Taps = 16;
+        static const int Phases = 256;
+        static const int Bands = 5;    // cutoffs a half octave apart, down to a quarter band
+
+        std::vector<float> coefficients;
 
-        SRC_Resampler() = delete;
-        SRC_Resampler(SRC_STATE* s) : sampler(s) 
+        SincTable()
+        : coefficients(size_t(Bands) * (Phases + 1) * Taps)
         {
-            memset(&data, 0, sizeof(data));
+            // a Kaiser window with beta 8 trades a little transition width for stopband
+            const double beta = 8.0;
+            auto bessel_i0 = [](double x) {
+                double sum = 1, term = 1;
+                for (int k = 1; k < 32; ++k)
+                {
+                    term *= (x / (2 * k)) * (x / (2 * k));
+                    sum += term;
+                }
+                return sum;
+            };
+
+            for (int b = 0; b < Bands; ++b)
+            {
+                const double cutoff = 0.95 / std::pow(2.0, b * 0.5);
+                for (int p = 0; p <= Phases; ++p)
+                {
+                    float* row = &coefficients[(size_t(b) * (Phases + 1) + p) * Taps];
+                    double sum = 0;
+                    for (int t = 0; t < Taps; ++t)
+                    {
+                        // distance from the tap to the interpolated position
+                        const double d = (t - (Taps / 2 - 1)) - double(p) / Phases;
+                        const double u = d / (Taps / 2);
+                        const double x = LAB_PI * cutoff * d;
+                        const double sinc = fabs(x) < 1e-9 ? 1.0 : sin(x) / x;
+                        const double window = fabs(u) < 1 ? bessel_i0(beta * sqrt(1 - u * u)) / bessel_i0(beta) : 0.0;
+                        row[t] = static_cast<float>(sinc * window);
+                        sum += row[t];
+                    }
+                    // unity gain at DC for every phase
+                    for (int t = 0; t < Taps; ++t)
+                        row[t] = static_cast<float>(row[t] / sum);
+                }
+            }
         }
 
-        ~SRC_Resampler()
+        // the coefficients whose cutoff suits reading the source at rate
+        const float* band(float rate) const
         {
-            if (sampler)
-                src_delete(sampler);
+            int b = rate > 1.f ? static_cast<int>(std::ceil(2.f * std::log2(rate))) : 0;
+            return &coefficients[size_t(std::min(b, Bands - 1)) * (Phases + 1) * Taps];
+        }
+
+        // y holds the Taps source frames around the position, which is t past y[Taps / 2 - 1]
+        static float interpolate(const float* band, const float* y, float t)
+        {
+            const float position = t * Phases;
+            const int p = std::min(static_cast<int>(position), Phases - 1);
+            const float f = position - p;
+            const float* c0 = band + p * Taps;
+            const float* c1 = c0 + Taps;
+            float sum = 0;
+            for (int i = 0; i < Taps; ++i)
+                sum += y[i] * (c0[i] + f * (c1[i] - c0[i]));
+            return sum;
         }
     };
 
+    const SincTable& sincTable()
+    {
+        static const SincTable table;
+        return table;
+    }
 
     struct SampledAudioNode::Scheduled
     {
@@ -55,8 +123,12 @@ namespace lab {
         int32_t grain_end;
         int32_t cursor;
         int loopCount;        // -1 means forever, 0 means play once, 1 means repeat once -2 is a sentinel value meaning clear the schedule
-        std::shared_ptr<AudioBus> sourceBus;
-        std::vector<std::shared_ptr<SRC_Resampler>> resampler; // there is one resampler per source channel
+        std::shared_ptr<const AudioBus> sourceBus;
+        std::shared_ptr<SampleStorage> sourceStorage;
+        double phase = 0;     // the fraction of a source frame past the cursor, when resampling
+        float gain = 1.f;     // of this play alone
+        float rate = 1.f;     // this play's pitch, as a multiple of the node's
+        int stretcher = -1;   // the pooled stretcher of a time stretched play
     };
 
     struct SampledAudioNode::Internals
@@ -65,21 +137,74 @@ namespace lab {
         : greatest_cursor(-1)
         , ac(ac_.audioContextInterface())
         {
+            scheduled.reserve(MaxScheduled);
+            stretchers.reserve(MaxScheduled);
+            freeStretchers.reserve(MaxScheduled);
         }
         ~Internals() = default;
+
+        // a stretcher for a play, from those free, or a new one while fewer than the plays
+        int acquireStretcher(float sampleRate)
+        {
+            if (!freeStretchers.empty())
+            {
+                const int index = freeStretchers.back();
+                freeStretchers.pop_back();
+                return index;
+            }
+            if (stretchers.size() >= MaxScheduled)
+                return -1;
+            stretchers.emplace_back(new TimeStretcher(sampleRate));
+            return static_cast<int>(stretchers.size()) - 1;
+        }
+
+        void releaseStretcher(Scheduled & s)
+        {
+            if (s.stretcher >= 0)
+                freeStretchers.push_back(s.stretcher);
+            s.stretcher = -1;
+        }
+
+        // Plays in progress, or waiting to begin. The list is bounded, so that a burst of
+        // retriggers never allocates on the audio thread; once it is full, a new play
+        // replaces the one that began earliest.
+        enum { MaxScheduled = 64 };
+
         moodycamel::ConcurrentQueue<Scheduled> incoming;
         std::vector<Scheduled> scheduled;
         int32_t greatest_cursor = -1;
         std::weak_ptr<AudioContext::AudioContextInterface> ac;
         bool bus_setting_updated = false;
+
+        // the stretchers of time stretched plays, kept as the pool grows so that their
+        // buffers are reused by later plays
+        std::vector<std::unique_ptr<TimeStretcher>> stretchers;
+        std::vector<int> freeStretchers;
+        std::vector<float*> stretchOutputs;
+
+        // the play of mapped storage whose start was last read in, and when, so that a burst
+        // of retriggers reads it once
+        std::atomic<int32_t> prefetchedStart {-1};
+        std::atomic<int64_t> prefetchedAt {0};
     };
 
+    // seconds of a mapped sound read in ahead of a play, and how long they are taken to
+    // stay resident
+    static const double PrefetchSeconds = 1.0;
+
     static AudioParamDescriptor s_saParams[] = {
         {"playbackRate", "RATE",  1.0, 0.0, 1024.},
         {"detune",       "DTUNE", 0.0, 0.0, 1200.},
         {"dopplerRate",  "DPLR",  1.0, 0.0, 1200.}, nullptr};
+    static char const * const s_interpolationModes[SampledAudioNode::InterpolationMode::_Count + 1] = {
+        "Linear", "Cubic", "Sinc", nullptr};
+    static char const * const s_timeStretchModes[static_cast<int>(SampledAudioNode::TimeStretchMode::_Count) + 1] = {
+        "Off", "Speech", "Music", nullptr};
+
     static AudioSettingDescriptor s_saSettings[] = {
-        {"sourceBus", "SBUS", SettingType::Bus}, nullptr};
+        {"sourceBus",     "SBUS", SettingType::Bus},
+        {"interpolation", "INTP", SettingType::Enum, s_interpolationModes},
+        {"timeStretch",   "TSTR", SettingType::Enum, s_timeStretchModes}, nullptr};
     
     AudioNodeDescriptor * SampledAudioNode::desc()
     {
@@ -95,6 +220,13 @@ namespace lab {
         m_playbackRate = param("playbackRate");
         m_detune = param("detune");
         m_dopplerRate = param("dopplerRate");
+        m_interpolation = setting("interpolation");
+        m_interpolation->setUint32(uint32_t(InterpolationMode::LINEAR));
+        m_timeStretch = setting("timeStretch");
+        m_timeStretch->setUint32(uint32_t(TimeStretchMode::Off));
+
+        // build the sinc table now rather than on the render thread
+        sincTable();
 
         m_sourceBus->setValueChanged([this]() {
             this->_internals->bus_setting_updated = true;
@@ -114,12 +246,24 @@ namespace lab {
 
     void SampledAudioNode::clearSchedules()
     {
+        // discard pending schedules, but not a pending change of source
         Scheduled s;
-        while (_internals->incoming.try_dequeue(s)) {}
+        Scheduled source;
+        bool sourcePending = false;
+        while (_internals->incoming.try_dequeue(s))
+        {
+            if (s.loopCount == -3)
+            {
+                source = s;
+                sourcePending = true;
+            }
+        }
         _internals->incoming.enqueue({ 0., 0,0,0, -2 });
+        if (sourcePending)
+            _internals->incoming.enqueue(source);
     }
 
-    void SampledAudioNode::setBus(std::shared_ptr<AudioBus> sourceBus)
+    void SampledAudioNode::setBus(std::shared_ptr<const AudioBus> sourceBus)
     {
         // loop count of -3 means set the bus.
         _internals->incoming.enqueue({ 0, 0, 0, 0, -3, sourceBus });
@@ -129,16 +273,92 @@ namespace lab {
         // the value last scheduled. This eliminates a confusing sitatuion where getBus
         // will not be useful until the scheduling queue is serviced
         m_pendingSourceBus = sourceBus;
+        m_pendingStorage.reset();
+    }
+
+    void SampledAudioNode::setStorage(std::shared_ptr<SampleStorage> storage)
+    {
+        _internals->incoming.enqueue({ 0, 0, 0, 0, -3, nullptr, storage });
+        initialize();
+
+        m_pendingStorage = storage;
+        m_pendingSourceBus.reset();
+        _internals->prefetchedStart = -1;
+    }
+
+    void SampledAudioNode::setInterpolation(InterpolationMode mode)
+    {
+        if (mode >= InterpolationMode::_Count)
+            throw std::out_of_range("Interpolation argument exceeds known interpolation modes");
+
+        m_interpolation->setUint32(uint32_t(mode));
+    }
+
+    SampledAudioNode::InterpolationMode SampledAudioNode::interpolation() const
+    {
+        return InterpolationMode(m_interpolation->valueUint32());
+    }
+
+    void SampledAudioNode::setTimeStretch(TimeStretchMode mode)
+    {
+        if (mode >= TimeStretchMode::_Count)
+            throw std::out_of_range("Time stretch argument exceeds known time stretch modes");
+
+        m_timeStretch->setUint32(uint32_t(mode));
+    }
+
+    SampledAudioNode::TimeStretchMode SampledAudioNode::timeStretch() const
+    {
+        return TimeStretchMode(m_timeStretch->valueUint32());
+    }
+
+    bool SampledAudioNode::pendingSource(int32_t & length, float & sampleRate) const
+    {
+        if (m_pendingStorage)
+        {
+            length = m_pendingStorage->length();
+            sampleRate = m_pendingStorage->sampleRate();
+            return true;
+        }
+        if (m_pendingSourceBus)
+        {
+            length = m_pendingSourceBus->length();
+            sampleRate = m_pendingSourceBus->sampleRate();
+            return true;
+        }
+        return false;
     }
     
-    void SampledAudioNode::setBus(ContextRenderLock&, std::shared_ptr<AudioBus> sourceBus) {
+    void SampledAudioNode::prefetch(int32_t grainStart, int32_t grainEnd, float pitch)
+    {
+        std::shared_ptr<SampleStorage> storage = m_pendingStorage;
+        if (!storage || !storage->isMapped())
+            return;
+
+        const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (_internals->prefetchedStart.exchange(grainStart) == grainStart &&
+            now - _internals->prefetchedAt.load() < static_cast<int64_t>(PrefetchSeconds * 1000))
+            return;
+        _internals->prefetchedAt = now;
+
+        const int count = std::min(grainEnd - grainStart,
+            static_cast<int>(PrefetchSeconds * storage->sampleRate() * std::max(1.f, pitch)));
+        JobSystem::shared().submit([storage, grainStart, count]()
+        {
+            storage->prefetch(grainStart, count);
+        }, JobPriority::High);
+    }
+
+    void SampledAudioNode::setBus(ContextRenderLock&, std::shared_ptr<const AudioBus> sourceBus) {
         setBus(sourceBus);
     }
 
     void SampledAudioNode::start(float when)
     {
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (!bus)
+        int32_t length;
+        float sampleRate;
+        if (!pendingSource(length, sampleRate))
             return;
 
         auto ac = _internals->ac.lock();
@@ -150,14 +370,16 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        _internals->incoming.enqueue({when, 0, bus->length(), 0, 0});
+        _internals->incoming.enqueue({when, 0, length, 0, 0});
+        prefetch(0, length);
         initialize();
     }
 
     void SampledAudioNode::start(float when, int loopCount)
     {
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (!bus)
+        int32_t length;
+        float sampleRate;
+        if (!pendingSource(length, sampleRate))
             return;
 
         auto ac = _internals->ac.lock();
@@ -169,14 +391,16 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        _internals->incoming.enqueue({when, 0, bus->length(), 0, loopCount});
+        _internals->incoming.enqueue({when, 0, length, 0, loopCount});
+        prefetch(0, length);
         initialize();
     }
 
     void SampledAudioNode::start(float when, float grainOffset, int loopCount)
     {
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (!bus)
+        int32_t length;
+        float sampleRate;
+        if (!pendingSource(length, sampleRate))
             return;
 
         auto ac = _internals->ac.lock();
@@ -188,22 +412,24 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        float r = bus->sampleRate();
+        float r = sampleRate;
         int32_t grainStart = static_cast<uint32_t>(grainOffset * r);
-        int32_t grainEnd = bus->length();
+        int32_t grainEnd = length;
         if (grainStart < grainEnd)
         {
             _internals->incoming.enqueue({when,
                                           grainStart, grainEnd, grainStart,
                                           loopCount});
+            prefetch(grainStart, grainEnd);
         }
         initialize();
     }
 
     void SampledAudioNode::start(float when, float grainOffset, float grainDuration, int loopCount)
     {
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (!bus)
+        int32_t length;
+        float sampleRate;
+        if (!pendingSource(length, sampleRate))
             return;
 
         auto ac = _internals->ac.lock();
@@ -215,16 +441,17 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        float r = bus->sampleRate();
+        float r = sampleRate;
         int32_t grainStart = static_cast<uint32_t>(grainOffset * r);
         int32_t grainEnd = grainStart + static_cast<uint32_t>(grainDuration * r);
-        if (grainEnd > bus->length())
-            grainEnd = bus->length() - grainStart;
+        if (grainEnd > length)
+            grainEnd = length - grainStart;
         if (grainStart < grainEnd)
         {
             _internals->incoming.enqueue({when,
                                           grainStart, grainEnd, grainStart,
                                           loopCount});
+            prefetch(grainStart, grainEnd);
         }
         initialize();
     }
@@ -235,9 +462,11 @@ namespace lab {
             _self->_scheduler.start(0.);
         }
 
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (bus) {
-            _internals->incoming.enqueue({when, 0, bus->length(), 0, 0});
+        int32_t length;
+        float sampleRate;
+        if (pendingSource(length, sampleRate)) {
+            _internals->incoming.enqueue({when, 0, length, 0, 0});
+            prefetch(0, length);
         }
         else {
             if (_internals->bus_setting_updated)
@@ -252,9 +481,12 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (bus)
-            _internals->incoming.enqueue({when, 0, bus->length(), 0, loopCount});
+        int32_t length;
+        float sampleRate;
+        if (pendingSource(length, sampleRate)) {
+            _internals->incoming.enqueue({when, 0, length, 0, loopCount});
+            prefetch(0, length);
+        }
         else {
             if (_internals->bus_setting_updated)
                 _internals->incoming.enqueue({when, 0, m_sourceBus->valueBus()->length(), 0, loopCount});
@@ -268,16 +500,18 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (bus) {
-            float r = bus->sampleRate();
+        int32_t length;
+        float sampleRate;
+        if (pendingSource(length, sampleRate)) {
+            float r = sampleRate;
             int32_t grainStart = static_cast<uint32_t>(grainOffset * r);
-            int32_t grainEnd = bus->length();
+            int32_t grainEnd = length;
             if (grainStart < grainEnd)
             {
                 _internals->incoming.enqueue({when,
                                               grainStart, grainEnd, grainStart,
                                               loopCount});
+                prefetch(grainStart, grainEnd);
             }
         }
 
@@ -289,51 +523,109 @@ namespace lab {
         if (!isPlayingOrScheduled())
             _self->_scheduler.start(0.);
 
-        std::shared_ptr<AudioBus> bus = m_pendingSourceBus;
-        if (bus) {
-            float r = bus->sampleRate();
+        int32_t length;
+        float sampleRate;
+        if (pendingSource(length, sampleRate)) {
+            float r = sampleRate;
             int32_t grainStart = static_cast<uint32_t>(grainOffset * r);
             int32_t grainEnd = grainStart + static_cast<uint32_t>(grainDuration * r);
-            if (grainEnd > bus->length())
-                grainEnd = bus->length() - grainStart;
+            if (grainEnd > length)
+                grainEnd = length - grainStart;
             if (grainStart < grainEnd)
             {
                 _internals->incoming.enqueue({when,
                                               grainStart, grainEnd, grainStart,
                                               loopCount});
+                prefetch(grainStart, grainEnd);
             }
         }
         
         initialize();
     }
 
-    bool SampledAudioNode::renderSample(ContextRenderLock& r, Scheduled& schedule, size_t destinationSampleOffset, size_t frameSize)
+    void SampledAudioNode::scheduleVoice(float when, float gain, float pitch, int loopCount)
+    {
+        if (!isPlayingOrScheduled())
+            _self->_scheduler.start(0.);
+
+        int32_t length;
+        float sampleRate;
+        if (pendingSource(length, sampleRate) && pitch > 0)
+        {
+            Scheduled s {when, 0, length, 0, loopCount};
+            s.gain = gain;
+            s.rate = pitch;
+            _internals->incoming.enqueue(s);
+            prefetch(0, length, pitch);
+        }
+
+        initialize();
+    }
+
+    bool SampledAudioNode::renderSample(ContextRenderLock& r, Scheduled& schedule, size_t destinationSampleOffset, size_t frameSize, float rate)
     {
-        std::shared_ptr<AudioBus> srcBus = m_sourceBus->valueBus();
+        const SampleStorage* storage = m_retainedStorage.get();
+        std::shared_ptr<const AudioBus> srcBus = storage ? nullptr : m_sourceBus->valueBus();
         AudioBus* dstBus = output(0)->bus(r);
         size_t dstChannelCount = dstBus->numberOfChannels();
-        size_t srcChannelCount = srcBus->numberOfChannels();
+        size_t srcChannelCount = storage ? storage->numberOfChannels() : srcBus->numberOfChannels();
         ASSERT(dstChannelCount == srcChannelCount);
 
-        float* buffer = dstBus->channel(0)->mutableData();
-        float rate = totalPitchRate(r);
+        // returns count source frames of a channel from the cursor; storage is decoded
+        // only as far as the quantum needs.
+        auto source = [&](int channel, int cursor, int count) -> const float*
+        {
+            if (!storage)
+                return srcBus->channel(channel)->data() + cursor;
+
+            float* decoded = _decoded[channel].data();
+            storage->read(channel, cursor, count, decoded);
+            return decoded;
+        };
+
+        // returns count source frames of a channel from first, for interpolating across.
+        // frames outside the grain repeat the grain's first or last frame.
+        auto window = [&](int channel, const Scheduled& s, int first, int count) -> const float*
+        {
+            float* w = _decoded[channel].data();
+            const int lo = std::max(first, s.grain_start);
+            const int hi = std::min(first + count, s.grain_end);
+            if (hi <= lo)
+            {
+                std::fill(w, w + count, 0.f);
+                return w;
+            }
+
+            if (storage)
+                storage->read(channel, lo, hi - lo, w + (lo - first));
+            else
+                std::copy(srcBus->channel(channel)->data() + lo, srcBus->channel(channel)->data() + hi, w + (lo - first));
+            std::fill(w, w + (lo - first), w[lo - first]);
+            std::fill(w + (hi - first), w + count, w[hi - first - 1]);
+            return w;
+        };
+
+        const int frames = static_cast<int>(frameSize);
+        const float gain = schedule.gain;
+
         if (fabsf(rate - 1.f) < 1e-3f)
         {
             // no pitch modification
             int write_index = (int) destinationSampleOffset;
-            while (write_index < AudioNode::ProcessingSizeInFrames)
+            while (write_index < frames)
             {
-                int count = AudioNode::ProcessingSizeInFrames - write_index;
+                int count = frames - write_index;
                 int remainder = schedule.grain_end - schedule.cursor;
                 bool ending = remainder < count;
                 count = std::min(count, remainder);
 
                 for (int i = 0; i < srcChannelCount; ++i)
                 {
-                    float* buffer = dstBus->channel(i)->mutableData();
-                    VectorMath::vadd(srcBus->channel(i)->data() + schedule.cursor, 1, 
-                                     buffer + write_index, 1,
-                                     buffer + write_index, 1, count);
+                    float* buffer = dstBus->channel(i)->mutableData() + write_index;
+                    if (gain == 1.f)
+                        VectorMath::vadd(source(i, schedule.cursor, count), 1, buffer, 1, buffer, 1, count);
+                    else
+                        VectorMath::vsma(source(i, schedule.cursor, count), 1, &gain, buffer, 1, count);
                 }
 
                 schedule.cursor += count;
@@ -359,93 +651,177 @@ namespace lab {
         }
         else
         {
-            while (schedule.resampler.size() < srcBus->numberOfChannels())
+            // pitch modification
+            const InterpolationMode mode = InterpolationMode(m_interpolation->valueUint32());
+            const int taps = mode == InterpolationMode::SINC ? SincTable::Taps : (mode == InterpolationMode::CUBIC ? 4 : 2);
+            const int left = taps / 2 - 1;  // taps before the interpolated position
+            const float* sinc = mode == InterpolationMode::SINC ? sincTable().band(rate) : nullptr;
+
+            int write_index = (int) destinationSampleOffset;
+            while (write_index < frames)
             {
-                // samplers are expensive to allocate, so if there's one to recycle, use it
-                if (_resamplers.size())
+                // output frames until the position passes the end of the grain
+                int count = frames - write_index;
+                double span = (schedule.grain_end - schedule.cursor) - schedule.phase;
+                int remainder = span > 0 ? static_cast<int>(std::ceil(span / rate)) : 0;
+                bool ending = remainder <= count;
+                count = std::min(count, remainder);
+
+                if (count > 0)
                 {
-                    auto resampler = _resamplers.back();
-                    schedule.resampler.push_back(resampler);
-                    _resamplers.pop_back();
-                    src_reset(resampler->sampler);
-                    memset(&resampler->data, 0, sizeof(resampler->data));
+                    const int first = schedule.cursor - left;
+                    const int needed = static_cast<int>(schedule.phase + (count - 1) * rate) + taps + 1;
+                    for (int i = 0; i < srcChannelCount; ++i)
+                    {
+                        const float* w = window(i, schedule, first, needed);
+                        float* buffer = dstBus->channel(i)->mutableData() + write_index;
+                        for (int j = 0; j < count; ++j)
+                        {
+                            const double x = schedule.phase + j * rate;
+                            const int k = static_cast<int>(x);
+                            const float t = static_cast<float>(x - k);
+                            const float* y = w + k;
+                            switch (mode)
+                            {
+                                case InterpolationMode::SINC:
+                                    buffer[j] += gain * SincTable::interpolate(sinc, y, t);
+                                    break;
+                                case InterpolationMode::CUBIC:
+                                {
+                                    // Catmull-Rom Hermite spline through y[1] and y[2]
+                                    const float c1 = 0.5f * (y[2] - y[0]);
+                                    const float c2 = y[0] - 2.5f * y[1] + 2.f * y[2] - 0.5f * y[3];
+                                    const float c3 = 0.5f * (y[3] - y[0]) + 1.5f * (y[1] - y[2]);
+                                    buffer[j] += gain * (((c3 * t + c2) * t + c1) * t + y[1]);
+                                    break;
+                                }
+                                default:
+                                    buffer[j] += gain * (y[0] + t * (y[1] - y[0]));
+                                    break;
+                            }
+                        }
+                    }
+
+                    const double advance = schedule.phase + count * rate;
+                    const int whole = static_cast<int>(advance);
+                    schedule.cursor += whole;
+                    schedule.phase = advance - whole;
+                    write_index += count;
                 }
-                else
+
+                if (ending)
                 {
-                    int err = 0;
-                    schedule.resampler.push_back(std::make_shared<SRC_Resampler>(src_new(SRC_LINEAR, 1, &err)));
+                    schedule.cursor = schedule.grain_start; // reset to start
+                    schedule.phase = 0;
+
+                    if (schedule.loopCount > 0)
+                        schedule.loopCount--;
+                    else if (schedule.loopCount < 0 && schedule.grain_end > schedule.grain_start)
+                    {
+                        // infinite looping, nothing to do
+                    }
+                    else
+                    {
+                        schedule.loopCount = -3;    // signal retirement of the schedule
+                        break;                      // and stop the write loop
+                    }
                 }
             }
-            if (schedule.resampler.size() >= srcBus->numberOfChannels())
+        }
+
+        //r.context()->appendDebugBuffer(dstBus, 0, frames);
+        dstBus->clearSilentFlag();
+        return true;
+    }
+
+    void SampledAudioNode::renderStretched(ContextRenderLock& r, Scheduled& schedule, size_t destinationSampleOffset, size_t frameSize,
+                                           TimeStretchMode mode, float tempo, float pitch)
+    {
+        const SampleStorage* storage = m_retainedStorage.get();
+        std::shared_ptr<const AudioBus> srcBus = storage ? nullptr : m_sourceBus->valueBus();
+        AudioBus* dstBus = output(0)->bus(r);
+        const int channels = storage ? storage->numberOfChannels() : srcBus->numberOfChannels();
+        const TimeStretcher::Mode stretchMode = mode == TimeStretchMode::Music ? TimeStretcher::Music : TimeStretcher::Speech;
+
+        if (schedule.stretcher < 0)
+        {
+            schedule.stretcher = _internals->acquireStretcher(r.context()->sampleRate());
+            if (schedule.stretcher < 0)
+                return;
+            _internals->stretchers[schedule.stretcher]->start(stretchMode, channels, schedule.cursor + schedule.phase);
+        }
+        TimeStretcher& stretcher = *_internals->stretchers[schedule.stretcher];
+        if (stretcher.mode() != stretchMode || stretcher.channels() != channels)
+            stretcher.start(stretchMode, channels, stretcher.position());
+
+        // the grain's frames; frames past its end wrap to its start while the play loops,
+        // and other frames outside it are silent
+        struct GrainReader : TimeStretcher::Reader
+        {
+            const SampleStorage* storage;
+            const AudioBus* bus;
+            int start, end;
+            bool looping;
+
+            virtual void read(int channel, int first, int count, float* destination) override
             {
-                // pitch modification
-                int write_index = (int) destinationSampleOffset;
-                while (write_index < AudioNode::ProcessingSizeInFrames)
+                const int length = end - start;
+                while (count > 0)
                 {
-                    int count = AudioNode::ProcessingSizeInFrames - write_index;
-                    int remainder = schedule.grain_end - schedule.cursor;
-                    bool ending = remainder < count;
+                    int at = first;
+                    if (looping && at >= end)
+                        at = start + (at - start) % length;
 
-                    int src_increment = 0;
-                    int dst_increment = 0;
-                    for (int i = 0; i < srcChannelCount; ++i)
+                    int n;
+                    if (at < start || at >= end)
                     {
-                        SRC_DATA* src_data = &schedule.resampler[i]->data;
-                        float* buffer = dstBus->channel(i)->mutableData();
-
-                        src_data->data_in = srcBus->channel(i)->data() + schedule.cursor;
-                        src_data->input_frames = remainder;
-                        std::array<float, AudioNode::ProcessingSizeInFrames> buff;
-                        src_data->data_out = buff.data();
-                        src_data->output_frames = AudioNode::ProcessingSizeInFrames;
-                        src_data->src_ratio = 1. / rate;
-                        src_data->end_of_input = ending ? 1 : 0;
-                        src_process(schedule.resampler[i]->sampler, src_data);
-                        VectorMath::vadd(buff.data(), 1, buffer + write_index, 1, buffer + write_index, 1, count);
-                        src_increment = static_cast<int>(src_data->input_frames_used);
-                        dst_increment = static_cast<int>(src_data->output_frames_gen);
+                        n = at < start ? std::min(count, start - at) : count;
+                        std::fill(destination, destination + n, 0.f);
                     }
-                    schedule.cursor += src_increment;
-                    write_index += dst_increment;
-
-                    ending |= (src_increment == 0) || (dst_increment == 0);
-
-                    if (ending)
+                    else
                     {
-                        if (write_index < AudioNode::ProcessingSizeInFrames) {
-                            // if the buffer didn't fully fill the buffer, at the end, zero out the remainder
-                            /// @TODO should lerp the end value to zero over a 10ms tail period.
-                            /// Going to assume the source data doesn't end with a non-zero value for now.
-                            for (int i = 0; i < srcChannelCount; ++i)
-                            {
-                                SRC_DATA * src_data = &schedule.resampler[i]->data;
-                                float* buffer = dstBus->channel(i)->mutableData();
-                                for (int j = write_index; j < AudioNode::ProcessingSizeInFrames; ++j)
-                                    buffer[j] = 0.f;
-                            }
-                        }
-
-                        schedule.cursor = schedule.grain_start; // reset to start
-
-                        if (schedule.loopCount > 0)
-                            schedule.loopCount--;
-                        else if (schedule.loopCount < 0)
-                        {
-                            // infinite looping, nothing to do
-                        }
+                        n = std::min(count, end - at);
+                        if (storage)
+                            storage->read(channel, at, n, destination);
                         else
-                        {
-                            schedule.loopCount = -3;    // signal retirement of the schedule
-                            break;                      // and stop the write loop
-                        }
+                            std::copy(bus->channel(channel)->data() + at, bus->channel(channel)->data() + at + n, destination);
                     }
+                    first += n;
+                    count -= n;
+                    destination += n;
                 }
             }
+        };
+
+        GrainReader reader;
+        reader.storage = storage;
+        reader.bus = srcBus.get();
+        reader.start = schedule.grain_start;
+        reader.end = schedule.grain_end;
+        reader.looping = schedule.loopCount != 0 && schedule.grain_end > schedule.grain_start;
+
+        std::vector<float*>& out = _internals->stretchOutputs;
+        out.resize(channels);
+        for (int i = 0; i < channels; ++i)
+            out[i] = dstBus->channel(i)->mutableData() + destinationSampleOffset;
+        stretcher.render(reader, out.data(), static_cast<int>(frameSize - destinationSampleOffset), tempo, pitch, schedule.gain);
+
+        // a loop's end moves the play back to its start, and the last loop retires once its
+        // grains have been heard
+        const int length = schedule.grain_end - schedule.grain_start;
+        while (length > 0 && schedule.loopCount != 0 && stretcher.position() >= schedule.grain_end)
+        {
+            stretcher.rewind(length);
+            if (schedule.loopCount > 0)
+                schedule.loopCount--;
         }
+        if (length <= 0 || (schedule.loopCount == 0 && stretcher.playedPast(schedule.grain_end, tempo, pitch)))
+            schedule.loopCount = -3;
 
-        //r.context()->appendDebugBuffer(dstBus, 0, AudioNode::ProcessingSizeInFrames);
+        const double position = std::min(std::max(stretcher.position(), double(schedule.grain_start)), double(schedule.grain_end));
+        schedule.cursor = static_cast<int32_t>(position);
+        schedule.phase = position - schedule.cursor;
         dstBus->clearSilentFlag();
-        return true;
     }
 
     void SampledAudioNode::process(ContextRenderLock& r, int framesToProcess)
@@ -453,7 +829,7 @@ namespace lab {
         auto ac = r.context();
         if (!ac)
             return;
-        bool diagnosing_silence = ac->diagnosing().get() == this;
+        bool diagnosing_silence = ac->isDiagnosing(this);
 
         if (_internals->bus_setting_updated) {
             _internals->bus_setting_updated = false;
@@ -463,7 +839,7 @@ namespace lab {
       
         AudioBus* dstBus = output(0)->bus(r);
         size_t dstChannelCount = dstBus->numberOfChannels();
-        std::shared_ptr<AudioBus> srcBus = m_sourceBus->valueBus();
+        std::shared_ptr<const AudioBus> srcBus = m_retainedStorage ? nullptr : m_sourceBus->valueBus();
 
         // move requested starts to the internal schedule if there's a source bus.
         // if there's no source bus, the schedule requests are discarded.
@@ -471,10 +847,23 @@ namespace lab {
             Scheduled s;
             while (_internals->incoming.try_dequeue(s))
             {
-                if (s.loopCount == -3)
+                // the storage or bus replaced may be the last reference to megabytes of
+                // samples, so it is released on the reclaim thread
+                if (s.loopCount == -3 && s.sourceStorage)
+                {
+                    DeferredRelease::shared().release(std::move(m_retainedStorage));
+                    DeferredRelease::shared().release(std::move(m_retainedSourceBus));
+                    m_retainedStorage = s.sourceStorage;
+                    srcBus.reset();
+                    if (diagnosing_silence)
+                        ac->diagnosed_silence("SampledAudioNode::storage has been set");
+                }
+                else if (s.loopCount == -3)
                 {
+                    DeferredRelease::shared().release(std::move(m_retainedStorage));
+                    DeferredRelease::shared().release(std::move(m_retainedSourceBus));
                     m_retainedSourceBus = s.sourceBus;
-                    m_sourceBus->setBus(s.sourceBus.get());
+                    m_sourceBus->setBus(s.sourceBus);  // shared, not copied, on the audio thread
                     srcBus = s.sourceBus;
                     _internals->bus_setting_updated = false; // setting bus causes this -3 state to occur so clear it immediately
                     if (diagnosing_silence)
@@ -482,13 +871,27 @@ namespace lab {
                 }   
                 else if (s.loopCount == -2)
                 {
+                    for (Scheduled & play : _internals->scheduled)
+                        _internals->releaseStretcher(play);
                     _internals->scheduled.clear();
                     if (diagnosing_silence)
                         ac->diagnosed_silence("SampledAudioNode::clearing schedule");
                 }
-                else if (srcBus)
+                else if (srcBus || m_retainedStorage)
                 {
-                    _internals->scheduled.push_back(s);
+                    auto & scheduled = _internals->scheduled;
+                    if (scheduled.size() < Internals::MaxScheduled)
+                        scheduled.push_back(s);
+                    else
+                    {
+                        // the earliest play has counted down the furthest
+                        auto earliest = std::min_element(scheduled.begin(), scheduled.end(),
+                            [](const Scheduled & a, const Scheduled & b) { return a.when < b.when; });
+                        _internals->releaseStretcher(*earliest);
+                        *earliest = s;
+                        if (_self->_scheduler._onEnded)
+                            r.context()->enqueueEvent(*this, AudioEventKind::Ended);
+                    }
                     if (diagnosing_silence)
                         ac->diagnosed_silence("SampledAudioNode::push_back schedule");
                 }
@@ -503,14 +906,23 @@ namespace lab {
 
         // silence the outputs if there's nothing to play.
         int schedule_count = static_cast<int>(_internals->scheduled.size());
-        if (!schedule_count || !srcBus) {
+        if (!schedule_count || (!srcBus && !m_retainedStorage)) {
             if (diagnosing_silence)
                 ac->diagnosed_silence("SampledAudioNode::process no schedule_count");
             return;
         }
 
         // if there's something to play, conform the output channel count.
-        int srcChannelCount = srcBus->numberOfChannels();
+        int srcChannelCount = m_retainedStorage ? m_retainedStorage->numberOfChannels() : srcBus->numberOfChannels();
+        {
+            // enough for a quantum at the greatest pitch rate, and the interpolator's taps
+            const size_t decodedLength = static_cast<size_t>(framesToProcess) * 101 + SincTable::Taps;
+            if (_decoded.size() < srcChannelCount)
+                _decoded.resize(srcChannelCount);
+            for (std::vector<float> & d : _decoded)
+                if (d.size() < decodedLength)
+                    d.resize(decodedLength);
+        }
         if (dstChannelCount != srcChannelCount)
         {
             output(0)->setNumberOfChannels(r, srcChannelCount);
@@ -520,11 +932,16 @@ namespace lab {
 
         // compute the frame timing in samples and seconds
         uint64_t quantumStartFrame = r.context()->currentSampleFrame();
-        uint64_t quantumEndFrame = quantumStartFrame + AudioNode::ProcessingSizeInFrames;
-        double quantumDuration = static_cast<double>(AudioNode::ProcessingSizeInFrames) / r.context()->sampleRate();
+        uint64_t quantumEndFrame = quantumStartFrame + framesToProcess;
+        double quantumDuration = static_cast<double>(framesToProcess) / r.context()->sampleRate();
         double quantumStartTime = r.context()->currentTime();
         double quantumEndTime = quantumStartTime + quantumDuration;
 
+        // the node's pitch, and its tempo when time stretching, is found once for all the plays
+        const TimeStretchMode stretch = TimeStretchMode(m_timeStretch->valueUint32());
+        float tempo = 1.f;
+        const float rate = stretch == TimeStretchMode::Off ? totalPitchRate(r) : totalPitchRate(r, &tempo);
+
         // is anything playing in this quantum?
         for (int i = 0; i < schedule_count; ++i)
         {
@@ -532,7 +949,15 @@ namespace lab {
             if (s.when < quantumDuration)   // has s.when counted down to within this quantum?
             {
                 int32_t offset = (s.when < quantumStartTime) ? 0 : static_cast<int32_t>(s.when * r.context()->sampleRate());
-                renderSample(r, s, (size_t) offset, AudioNode::ProcessingSizeInFrames);
+                const float pitch = std::min(100.f, std::max(1.e-2f, rate * s.rate));
+                if (stretch != TimeStretchMode::Off)
+                    renderStretched(r, s, (size_t) offset, framesToProcess, stretch, tempo, pitch);
+                else
+                {
+                    // a play stretched until now goes on from where its stretcher was
+                    _internals->releaseStretcher(s);
+                    renderSample(r, s, (size_t) offset, framesToProcess, pitch);
+                }
                 output(0)->bus(r)->clearSilentFlag();
                 if (s.cursor > _internals->greatest_cursor)
                     _internals->greatest_cursor = s.cursor;
@@ -548,19 +973,14 @@ namespace lab {
             Scheduled& s = _internals->scheduled.at(i);
             if (s.loopCount < -1)
             {
-                while (s.resampler.size())
-                {
-                    _resamplers.push_back(s.resampler.back()); // resamplers are expensive to construct, so cache them
-                    s.resampler.pop_back();
-                }
-
+                _internals->releaseStretcher(s);
                 if (schedule_count - 1 > i)
                     _internals->scheduled.at(i) = _internals->scheduled.at(schedule_count - 1);
                 _internals->scheduled.pop_back();
                 --schedule_count;
 
                 if (_self->_scheduler._onEnded)
-                    r.context()->enqueueEvent(_self->_scheduler._onEnded);
+                    r.context()->enqueueEvent(*this, AudioEventKind::Ended);
             }
         }
     }
@@ -575,20 +995,32 @@ namespace lab {
     /// // if true is returned, rate_array[0] applies to the entire quantum
     /// // if the computed total rate has any illegal values, true will be returned, and a default rate of 1.f
     /// bool SampledAudioNode::totalPitchRate(ContextRenderLock& r, float*& rate);
-    float SampledAudioNode::totalPitchRate(ContextRenderLock& r)
+    float SampledAudioNode::totalPitchRate(ContextRenderLock& r, float * tempo)
     {
-        std::shared_ptr<AudioBus> srcBus = m_sourceBus->valueBus();
+        std::shared_ptr<const AudioBus> srcBus = m_sourceBus->valueBus();
+        if (tempo)
+            *tempo = 1.f;
 
         // if there's no bus, pitchrate is defaulted.
-        if (!srcBus)
+        if (!srcBus && !m_retainedStorage)
             return 1.f;
 
-        double sampleRateFactor = sampleRateFactor = srcBus->sampleRate() / r.context()->sampleRate();
+        float sourceRate = m_retainedStorage ? m_retainedStorage->sampleRate() : srcBus->sampleRate();
+        double sampleRateFactor = sourceRate / r.context()->sampleRate();
 
         /// @fixme these values should be per sample, not per quantum
         /// -or- they should be settings if they don't vary per sample
         double basePitchRate = playbackRate()->value();
 
+        // time stretching, the base rate is the tempo's; the stretcher holds it in its range
+        if (tempo)
+        {
+            const double tempoRate = sampleRateFactor * basePitchRate;
+            if (!std::isnan(tempoRate) && !std::isinf(tempoRate))
+                *tempo = static_cast<float>(std::max(0.0, tempoRate));
+            basePitchRate = 1.0;
+        }
+
         /// @fixme these values should be per sample, not per quantum
         double totalRate = m_dopplerRate->value() * sampleRateFactor * basePitchRate;
         totalRate *= pow(2, detune()->value() / 1200);
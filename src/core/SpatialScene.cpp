@@ -0,0 +1,210 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/SpatialScene.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/PannerNode.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+SpatialScene::Frames::Frames(int capacity_)
+    : capacity(capacity_)
+    , ready(1)
+{
+    for (Frame & f : frames)
+    {
+        f.values.assign(size_t(capacity) * CoordinateCount, 0.f);
+        f.owners.assign(capacity, nullptr);
+    }
+}
+
+SpatialScene::SpatialScene()
+{
+    m_frames = std::make_shared<Frames>(64);
+    m_writing = 2;
+    m_published = 1;
+}
+
+SpatialScene::~SpatialScene() {}
+
+// Copies one frame's slots into another's, which may be larger
+static void copyFrame(const std::vector<float> & fromValues, const std::vector<const PannerNode *> & fromOwners, int fromCapacity,
+                      std::vector<float> & toValues, std::vector<const PannerNode *> & toOwners, int toCapacity)
+{
+    for (int c = 0; c < SpatialScene::CoordinateCount; ++c)
+        std::memcpy(toValues.data() + size_t(c) * toCapacity, fromValues.data() + size_t(c) * fromCapacity, sizeof(float) * fromCapacity);
+    std::copy(fromOwners.begin(), fromOwners.end(), toOwners.begin());
+}
+
+void SpatialScene::grow(int capacity)
+{
+    // the render thread goes on reading the old frames until it next latches, and then reads
+    // the last published transforms, in their new layout
+    const Frames & old = *m_frames;
+    std::shared_ptr<Frames> frames = std::make_shared<Frames>(capacity);
+    for (int i = 0; i < 2; ++i)
+        copyFrame(old.frames[m_published].values, old.frames[m_published].owners, old.capacity,
+                  frames->frames[i].values, frames->frames[i].owners, capacity);
+    copyFrame(old.frames[m_writing].values, old.frames[m_writing].owners, old.capacity,
+              frames->frames[2].values, frames->frames[2].owners, capacity);
+    m_writing = 2;
+    m_published = 1;
+    std::atomic_store(&m_frames, frames);
+}
+
+int SpatialScene::add(std::shared_ptr<PannerNode> panner)
+{
+    if (!panner)
+        return -1;
+
+    int slot = panner->sceneSlot();
+    if (slot >= 0 && slot < slots() && m_panners[slot].lock() == panner)
+        return slot;
+
+    slot = -1;
+    for (int i = 0; i < slots(); ++i)
+    {
+        if (m_panners[i].expired())
+        {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0)
+    {
+        slot = slots();
+        m_panners.emplace_back();
+        if (slot >= m_frames->capacity)
+            grow(m_frames->capacity * 2);
+    }
+    m_panners[slot] = panner;
+
+    const int capacity = m_frames->capacity;
+    Frame & f = writing();
+    float * v = f.values.data() + slot;
+    v[PositionX * capacity] = panner->positionX()->value();
+    v[PositionY * capacity] = panner->positionY()->value();
+    v[PositionZ * capacity] = panner->positionZ()->value();
+    v[OrientationX * capacity] = panner->orientationX()->value();
+    v[OrientationY * capacity] = panner->orientationY()->value();
+    v[OrientationZ * capacity] = panner->orientationZ()->value();
+    v[VelocityX * capacity] = panner->velocityX()->value();
+    v[VelocityY * capacity] = panner->velocityY()->value();
+    v[VelocityZ * capacity] = panner->velocityZ()->value();
+    f.owners[slot] = panner.get();
+
+    panner->m_sceneSlot.store(slot, std::memory_order_relaxed);
+    return slot;
+}
+
+void SpatialScene::remove(const std::shared_ptr<PannerNode> & panner)
+{
+    if (!panner)
+        return;
+
+    const int slot = panner->sceneSlot();
+    if (slot < 0 || slot >= slots() || m_panners[slot].lock() != panner)
+        return;
+
+    m_panners[slot].reset();
+    writing().owners[slot] = nullptr;
+    panner->m_sceneSlot.store(-1, std::memory_order_relaxed);
+}
+
+float * SpatialScene::edit(Coordinate coordinate)
+{
+    if (coordinate < 0 || coordinate >= CoordinateCount)
+        return nullptr;
+    return writing().values.data() + size_t(coordinate) * m_frames->capacity;
+}
+
+void SpatialScene::commit()
+{
+    Frames & frames = *m_frames;
+    const int published = m_writing;
+    m_writing = frames.ready.exchange(published | Fresh, std::memory_order_acq_rel) & ~Fresh;
+    m_published = published;
+
+    // the render thread only reads the frames, so the published one may be copied from as it does
+    const Frame & from = frames.frames[published];
+    Frame & to = frames.frames[m_writing];
+    to.values = from.values;
+    to.owners = from.owners;
+}
+
+void SpatialScene::update(const SpatialTransform * transforms, int count)
+{
+    count = std::min(count, slots());
+    if (transforms && count > 0)
+    {
+        const int capacity = m_frames->capacity;
+        float * v = writing().values.data();
+        for (int i = 0; i < count; ++i)
+        {
+            const SpatialTransform & t = transforms[i];
+            v[PositionX * capacity + i] = t.position.x;
+            v[PositionY * capacity + i] = t.position.y;
+            v[PositionZ * capacity + i] = t.position.z;
+            v[OrientationX * capacity + i] = t.orientation.x;
+            v[OrientationY * capacity + i] = t.orientation.y;
+            v[OrientationZ * capacity + i] = t.orientation.z;
+            v[VelocityX * capacity + i] = t.velocity.x;
+            v[VelocityY * capacity + i] = t.velocity.y;
+            v[VelocityZ * capacity + i] = t.velocity.z;
+        }
+    }
+    commit();
+}
+
+// A slot's transform from a frame
+static SpatialTransform slotTransform(const float * v, int capacity, int slot)
+{
+    v += slot;
+    SpatialTransform t;
+    t.position = {v[SpatialScene::PositionX * capacity], v[SpatialScene::PositionY * capacity], v[SpatialScene::PositionZ * capacity]};
+    t.orientation = {v[SpatialScene::OrientationX * capacity], v[SpatialScene::OrientationY * capacity], v[SpatialScene::OrientationZ * capacity]};
+    t.velocity = {v[SpatialScene::VelocityX * capacity], v[SpatialScene::VelocityY * capacity], v[SpatialScene::VelocityZ * capacity]};
+    return t;
+}
+
+SpatialTransform SpatialScene::transform(int slot) const
+{
+    if (slot < 0 || slot >= slots())
+        return {};
+    return slotTransform(m_frames->frames[m_published].values.data(), m_frames->capacity, slot);
+}
+
+void SpatialScene::latch(ContextRenderLock & r)
+{
+    std::shared_ptr<Frames> frames = std::atomic_load(&m_frames);
+    if (frames != m_rendering)
+    {
+        m_rendering = frames;
+        m_reading = 0;
+    }
+
+    Frames & f = *m_rendering;
+    if (f.ready.load(std::memory_order_acquire) & Fresh)
+        m_reading = f.ready.exchange(m_reading, std::memory_order_acq_rel) & ~Fresh;
+}
+
+bool SpatialScene::transform(const PannerNode * panner, int slot, SpatialTransform & out) const
+{
+    if (!m_rendering || slot < 0 || slot >= m_rendering->capacity)
+        return false;
+
+    const Frame & f = m_rendering->frames[m_reading];
+    if (f.owners[slot] != panner)
+        return false;
+
+    out = slotTransform(f.values.data(), m_rendering->capacity, slot);
+    return true;
+}
+
+}  // namespace lab
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/StartupTiming.h"
+#include "LabSound/core/RenderTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+
+namespace lab
+{
+
+namespace
+{
+    struct Phase
+    {
+        const char * name;
+        int64_t begin;
+        int64_t end;
+        std::atomic<bool> written {false};  // set once the slot's claimant has filled it in
+    };
+
+    Phase s_phases[StartupTiming::Capacity];
+    std::atomic<int> s_claimed {0};
+
+    // taken as the library is loaded, which the phases are timed from
+    const int64_t s_origin = RenderTrace::now();
+}
+
+int64_t StartupTiming::now()
+{
+    return RenderTrace::now();
+}
+
+void StartupTiming::record(const char * name, int64_t begin, int64_t end)
+{
+    if (s_claimed.load(std::memory_order_relaxed) >= Capacity)
+        return;
+    const int slot = s_claimed.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= Capacity)
+        return;
+
+    Phase & p = s_phases[slot];
+    p.name = name;
+    p.begin = begin;
+    p.end = end;
+    p.written.store(true, std::memory_order_release);
+}
+
+void StartupTiming::mark(const char * name)
+{
+    const int64_t t = now();
+    record(name, t, t);
+}
+
+std::vector<StartupPhase> StartupTiming::phases()
+{
+    std::vector<StartupPhase> result;
+    const int count = std::min(s_claimed.load(std::memory_order_acquire), Capacity);
+    for (int i = 0; i < count; ++i)
+    {
+        const Phase & p = s_phases[i];
+        if (!p.written.load(std::memory_order_acquire))
+            continue;  // still being written
+
+        StartupPhase phase;
+        phase.name = p.name;
+        phase.startMilliseconds = (p.begin - s_origin) * 1.e-6;
+        phase.durationMilliseconds = (p.end - p.begin) * 1.e-6;
+        result.push_back(std::move(phase));
+    }
+
+    // phases are recorded as they end, so one enclosing another is recorded after it
+    std::stable_sort(result.begin(), result.end(),
+                     [](const StartupPhase & a, const StartupPhase & b) { return a.startMilliseconds < b.startMilliseconds; });
+    return result;
+}
+
+std::string StartupTiming::report()
+{
+    std::string out;
+    char line[256];
+    for (const StartupPhase & p : phases())
+    {
+        if (p.durationMilliseconds > 0)
+            snprintf(line, sizeof(line), "%10.2f ms  %-28s %9.2f ms\n", p.startMilliseconds, p.name.c_str(), p.durationMilliseconds);
+        else
+            snprintf(line, sizeof(line), "%10.2f ms  %s\n", p.startMilliseconds, p.name.c_str());
+        out += line;
+    }
+    return out;
+}
+
+}  // lab
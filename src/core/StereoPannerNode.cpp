@@ -11,6 +11,7 @@
 #include "LabSound/core/Mixing.h"
 #include "LabSound/core/SampledAudioNode.h"
 #include "LabSound/extended/Util.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Registry.h"
@@ -19,9 +20,146 @@
 #include "internal/AudioUtilities.h"
 #include "internal/Panner.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
 namespace lab
 {
 
+namespace
+{
+    // cos(x pi/2) over [0, 1], as its Taylor series in x^2 up to the x^12 term, which is
+    // within 1e-8 of it there. sin(x pi/2) is the same curve at 1 - x.
+    const float QuarterCosine[7] = {
+        1.f, -1.2337005501361697f, 0.253669507901048f, -0.020863480763352957f,
+        0.0009192602748394263f, -2.5202042373060596e-05f, 4.710874778818169e-07f};
+
+    inline float quarterCosine(float x)
+    {
+        const float u = x * x;
+        float p = QuarterCosine[6];
+        for (int i = 5; i >= 0; --i)
+            p = p * u + QuarterCosine[i];
+        return p;
+    }
+
+#if defined(__SSE2__)
+    inline __m128 quarterCosine(__m128 x)
+    {
+        const __m128 u = _mm_mul_ps(x, x);
+        __m128 p = _mm_set1_ps(QuarterCosine[6]);
+        for (int i = 5; i >= 0; --i)
+            p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(QuarterCosine[i]));
+        return p;
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    inline float32x4_t quarterCosine(float32x4_t x)
+    {
+        const float32x4_t u = vmulq_f32(x, x);
+        float32x4_t p = vdupq_n_f32(QuarterCosine[6]);
+        for (int i = 5; i >= 0; --i)
+            p = vmlaq_f32(vdupq_n_f32(QuarterCosine[i]), p, u);
+        return p;
+    }
+#endif
+
+    // The equal power gains of a mono source for each frame's pan in [-1, 1], which is
+    // normalized to [0, 1] from left to right.
+    void monoPanGains(const float * pan, float * gainL, float * gainR, int count)
+    {
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 minusOne = _mm_set1_ps(-1.f);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 p = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(pan + i), one), minusOne);
+            const __m128 x = _mm_add_ps(_mm_mul_ps(p, half), half);
+            _mm_storeu_ps(gainL + i, quarterCosine(x));
+            _mm_storeu_ps(gainR + i, quarterCosine(_mm_sub_ps(one, x)));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const float32x4_t minusOne = vdupq_n_f32(-1.f);
+        for (; i + 4 <= count; i += 4)
+        {
+            const float32x4_t p = vmaxq_f32(vminq_f32(vld1q_f32(pan + i), one), minusOne);
+            const float32x4_t x = vmlaq_f32(half, p, half);
+            vst1q_f32(gainL + i, quarterCosine(x));
+            vst1q_f32(gainR + i, quarterCosine(vsubq_f32(one, x)));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            const float x = clampTo(pan[i], -1.f, 1.f) * 0.5f + 0.5f;
+            gainL[i] = quarterCosine(x);
+            gainR[i] = quarterCosine(1.f - x);
+        }
+    }
+
+    // The gains of a stereo source for each frame's pan in [-1, 1], so that the left output
+    // is leftFromL * L + leftFromR * R, and the right rightFromL * L + rightFromR * R.
+    // Panning left keeps the left channel and equal power pans the right channel across
+    // both, normalizing [-1, 0] to [0, 1]; panning right does the opposite.
+    void stereoPanGains(const float * pan, float * leftFromL, float * leftFromR,
+                        float * rightFromL, float * rightFromR, int count)
+    {
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 minusOne = _mm_set1_ps(-1.f);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 p = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(pan + i), one), minusOne);
+            const __m128 left = _mm_cmple_ps(p, zero);
+            const __m128 x = _mm_add_ps(p, _mm_and_ps(left, one));
+            const __m128 gainL = quarterCosine(x);
+            const __m128 gainR = quarterCosine(_mm_sub_ps(one, x));
+            _mm_storeu_ps(leftFromL + i, _mm_or_ps(_mm_and_ps(left, one), _mm_andnot_ps(left, gainL)));
+            _mm_storeu_ps(leftFromR + i, _mm_and_ps(left, gainL));
+            _mm_storeu_ps(rightFromL + i, _mm_andnot_ps(left, gainR));
+            _mm_storeu_ps(rightFromR + i, _mm_or_ps(_mm_and_ps(left, gainR), _mm_andnot_ps(left, one)));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t zero = vdupq_n_f32(0.f);
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const float32x4_t minusOne = vdupq_n_f32(-1.f);
+        for (; i + 4 <= count; i += 4)
+        {
+            const float32x4_t p = vmaxq_f32(vminq_f32(vld1q_f32(pan + i), one), minusOne);
+            const uint32x4_t left = vcleq_f32(p, zero);
+            const float32x4_t x = vaddq_f32(p, vbslq_f32(left, one, zero));
+            const float32x4_t gainL = quarterCosine(x);
+            const float32x4_t gainR = quarterCosine(vsubq_f32(one, x));
+            vst1q_f32(leftFromL + i, vbslq_f32(left, one, gainL));
+            vst1q_f32(leftFromR + i, vbslq_f32(left, gainL, zero));
+            vst1q_f32(rightFromL + i, vbslq_f32(left, zero, gainR));
+            vst1q_f32(rightFromR + i, vbslq_f32(left, gainR, one));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            const float p = clampTo(pan[i], -1.f, 1.f);
+            const bool left = p <= 0;
+            const float x = left ? p + 1.f : p;
+            const float gainL = quarterCosine(x);
+            const float gainR = quarterCosine(1.f - x);
+            leftFromL[i] = left ? 1.f : gainL;
+            leftFromR[i] = left ? gainL : 0.f;
+            rightFromL[i] = left ? 0.f : gainR;
+            rightFromR[i] = left ? gainR : 1.f;
+        }
+    }
+}
+
 class Spatializer
 {
 
@@ -59,6 +197,32 @@ public:
 
         ASSERT(isOutputSafe);
 
+        if (!isOutputSafe)
+            return;
+
+        if (framesToProcess <= 0)
+            return;
+
+        m_pan = clampTo(panValues[framesToProcess - 1], -1.0, 1.0);
+        panWithValues(inputBus, outputBus, panValues, framesToProcess);
+    }
+
+    // Handle panning that holds one value for the whole quantum, with gains found once.
+    void panWithConstantValue(const AudioBus * inputBus, AudioBus * outputBus, float panValue, size_t framesToProcess)
+    {
+        size_t numberOfInputChannels = inputBus->numberOfChannels();
+
+        bool isInputSafe = inputBus && (inputBus->numberOfChannels() == Channels::Mono || inputBus->numberOfChannels() == Channels::Stereo) && framesToProcess <= inputBus->length();
+
+        ASSERT(isInputSafe);
+
+        if (!isInputSafe)
+            return;
+
+        bool isOutputSafe = outputBus && framesToProcess <= outputBus->length();
+
+        ASSERT(isOutputSafe);
+
         if (!isOutputSafe)
             return;
 
@@ -71,53 +235,44 @@ public:
         if (!sourceL || !sourceR || !destinationL || !destinationR)
             return;
 
-        double gainL, gainR, panRadian;
-        size_t n = framesToProcess;
+        m_pan = clampTo(panValue, -1.0, 1.0);
+        m_isFirstRender = false;
 
-        // For mono source case.
+        // The gains are those the sample-accurate kernels find for the same pan.
         if (numberOfInputChannels == Channels::Mono)
         {
-            while (n--)
+            const float x = static_cast<float>(m_pan * 0.5 + 0.5);
+            const float gainL = quarterCosine(x);
+            const float gainR = quarterCosine(1.f - x);
+            for (size_t i = 0; i < framesToProcess; ++i)
             {
-                float inputL = *sourceL++;
-
-                m_pan = clampTo(*panValues++, -1.0, 1.0);
-
-                // Pan from left to right [-1; 1] will be normalized as [0; 1].
-                panRadian = (m_pan * 0.5 + 0.5) * LAB_HALF_PI;
-
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
-
-                *destinationL++ = static_cast<float>(inputL * gainL);
-                *destinationR++ = static_cast<float>(inputL * gainR);
+                destinationL[i] = static_cast<float>(sourceL[i] * gainL);
+                destinationR[i] = static_cast<float>(sourceL[i] * gainR);
             }
         }
-        // For stereo source case.
         else
         {
-            while (n--)
+            const float x = static_cast<float>(m_pan <= 0 ? m_pan + 1 : m_pan);
+            const float gainL = quarterCosine(x);
+            const float gainR = quarterCosine(1.f - x);
+            if (m_pan <= 0)
             {
-                float inputL = *sourceL++;
-                float inputR = *sourceR++;
-
-                m_pan = clampTo(*panValues++, -1.0, 1.0);
-
-                // Normalize [-1; 0] to [0; 1]. Do nothing when [0; 1].
-                panRadian = (m_pan <= 0 ? m_pan + 1 : m_pan) * LAB_HALF_PI;
-
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
-
-                if (m_pan <= 0)
+                for (size_t i = 0; i < framesToProcess; ++i)
                 {
-                    *destinationL++ = static_cast<float>(inputL + inputR * gainL);
-                    *destinationR++ = static_cast<float>(inputR * gainR);
+                    const float inputL = sourceL[i];
+                    const float inputR = sourceR[i];
+                    destinationL[i] = static_cast<float>(inputL + inputR * gainL);
+                    destinationR[i] = static_cast<float>(inputR * gainR);
                 }
-                else
+            }
+            else
+            {
+                for (size_t i = 0; i < framesToProcess; ++i)
                 {
-                    *destinationL++ = static_cast<float>(inputL * gainL);
-                    *destinationR++ = static_cast<float>(inputR + inputL * gainR);
+                    const float inputL = sourceL[i];
+                    const float inputR = sourceR[i];
+                    destinationL[i] = static_cast<float>(inputL * gainL);
+                    destinationR[i] = static_cast<float>(inputR + inputL * gainR);
                 }
             }
         }
@@ -160,65 +315,30 @@ public:
             m_pan = targetPan;
         }
 
-        double gainL, gainR, panRadian;
-        const double smoothingConstant = m_smoothingConstant;
-        size_t n = framesToProcess;
-
-        // For mono source case.
-        if (numberOfInputChannels == Channels::Mono)
+        // Once the pan has arrived, the gains don't change
+        if (m_pan == targetPan)
         {
-            while (n--)
-            {
-                float inputL = *sourceL++;
-
-                m_pan += (targetPan - m_pan) * smoothingConstant;
-
-                // Pan from left to right [-1; 1] will be normalized as [0; 1].
-                panRadian = (m_pan * 0.5 + 0.5) * LAB_HALF_PI;
-
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
-
-                *destinationL++ = static_cast<float>(inputL * gainL);
-                *destinationR++ = static_cast<float>(inputL * gainR);
-            }
+            panWithConstantValue(inputBus, outputBus, targetPan, framesToProcess);
+            return;
         }
-        // For stereo source case.
-        else
-        {
-            while (n--)
-            {
-                float inputL = *sourceL++;
-                float inputR = *sourceR++;
-
-                m_pan += (targetPan - m_pan) * smoothingConstant;
 
-                // Normalize [-1; 0] to [0; 1] for the left pan position (<= 0), and
-                // do nothing when [0; 1].
+        // The approach is found frame by frame, and the gains for all of it at once
+        if (m_smoothedPanValues.size() < static_cast<int>(framesToProcess))
+            m_smoothedPanValues.allocate(static_cast<int>(framesToProcess));
 
-                panRadian = (m_pan <= 0 ? m_pan + 1 : m_pan) * LAB_HALF_PI;
+        float * panValues = m_smoothedPanValues.data();
+        const double smoothingConstant = m_smoothingConstant;
+        for (size_t i = 0; i < framesToProcess; ++i)
+        {
+            m_pan += (targetPan - m_pan) * smoothingConstant;
+            panValues[i] = static_cast<float>(m_pan);
+        }
 
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
+        panWithValues(inputBus, outputBus, panValues, static_cast<int>(framesToProcess));
 
-                // The pan value should be checked every sample when de-zippering.
-                // See crbug.com/470559.
-                if (m_pan <= 0)
-                {
-                    // When [-1; 0], keep left channel intact and equal-power pan the
-                    // right channel only.
-                    *destinationL++ = static_cast<float>(inputL + inputR * gainL);
-                    *destinationR++ = static_cast<float>(inputR * gainR);
-                }
-                else
-                {
-                    // When [0; 1], keep right channel intact and equal-power pan the
-                    // left channel only.
-                    *destinationL++ = static_cast<float>(inputL * gainL);
-                    *destinationR++ = static_cast<float>(inputR + inputL * gainR);
-                }
-            }
-        }
+        // The approach slows as it nears the target, and may stall a few ulps short of it
+        if (std::fabs(targetPan - m_pan) < 1e-9)
+            m_pan = targetPan;
     }
 
     virtual void reset()
@@ -230,11 +350,55 @@ public:
     virtual double latencyTime(ContextRenderLock & r) const { return 0; }
 
 private:
+    // Pans the input by a value per frame, already checked to be a mono or stereo bus
+    void panWithValues(const AudioBus * inputBus, AudioBus * outputBus, const float * panValues, int framesToProcess)
+    {
+        const float * sourceL = inputBus->channel(0)->data();
+        const float * sourceR = inputBus->numberOfChannels() > Channels::Mono ? inputBus->channel(1)->data() : sourceL;
+
+        float * destinationL = outputBus->channelByType(Channel::Left)->mutableData();
+        float * destinationR = outputBus->channelByType(Channel::Right)->mutableData();
+
+        if (!sourceL || !sourceR || !destinationL || !destinationR)
+            return;
+
+        for (AudioFloatArray & gains : m_gains)
+        {
+            if (gains.size() < framesToProcess)
+                gains.allocate(framesToProcess);
+        }
+
+        if (inputBus->numberOfChannels() == Channels::Mono)
+        {
+            float * gainL = m_gains[0].data();
+            float * gainR = m_gains[1].data();
+            monoPanGains(panValues, gainL, gainR, framesToProcess);
+            VectorMath::vmul(sourceL, 1, gainL, 1, destinationL, 1, framesToProcess);
+            VectorMath::vmul(sourceL, 1, gainR, 1, destinationR, 1, framesToProcess);
+        }
+        else
+        {
+            float * leftFromL = m_gains[0].data();
+            float * leftFromR = m_gains[1].data();
+            float * rightFromL = m_gains[2].data();
+            float * rightFromR = m_gains[3].data();
+            stereoPanGains(panValues, leftFromL, leftFromR, rightFromL, rightFromR, framesToProcess);
+            VectorMath::vmul(sourceL, 1, leftFromL, 1, destinationL, 1, framesToProcess);
+            VectorMath::vmadd(sourceR, 1, leftFromR, 1, destinationL, 1, framesToProcess);
+            VectorMath::vmul(sourceR, 1, rightFromR, 1, destinationR, 1, framesToProcess);
+            VectorMath::vmadd(sourceL, 1, rightFromL, 1, destinationR, 1, framesToProcess);
+        }
+    }
+
     bool m_isFirstRender = true;
     double m_pan = 0.0;
 
     double m_smoothingConstant;
 
+    // Scratch for the pan values while smoothing, and the gains found from them
+    AudioFloatArray m_smoothedPanValues;
+    AudioFloatArray m_gains[4];
+
     // Use a 50ms smoothing / de-zippering time-constant.
     const float SmoothingTimeConstant = 0.050f;
 };
@@ -253,7 +417,7 @@ AudioNodeDescriptor * StereoPannerNode::desc()
 StereoPannerNode::StereoPannerNode(AudioContext& ac)
     : AudioNode(ac, *desc())
 {
-    m_sampleAccuratePanValues.reset(new AudioFloatArray(AudioNode::ProcessingSizeInFrames));
+    m_sampleAccuratePanValues.reset(new AudioFloatArray(renderQuantumSize()));
 
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
 
@@ -295,8 +459,16 @@ void StereoPannerNode::process(ContextRenderLock & r, int bufferSize)
         if (bufferSize <= m_sampleAccuratePanValues->size())
         {
             float * panValues = m_sampleAccuratePanValues->data();
-            m_pan->calculateSampleAccurateValues(r, panValues, bufferSize);
-            m_stereoPanner->panWithSampleAccurateValues(inputBus, outputBus, panValues, bufferSize);
+            AudioParamBlock panBlock = m_pan->calculateSampleAccurateBlock(r, panValues, bufferSize);
+            if (panBlock.isConstant())
+            {
+                m_stereoPanner->panWithConstantValue(inputBus, outputBus, panBlock.value, bufferSize);
+            }
+            else
+            {
+                panBlock.render(panValues, bufferSize);
+                m_stereoPanner->panWithSampleAccurateValues(inputBus, outputBus, panValues, bufferSize);
+            }
         }
     }
     else
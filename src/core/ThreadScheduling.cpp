@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/ThreadScheduling.h"
+#include "LabSound/extended/Logging.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <avrt.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "avrt.lib")
+#endif
+#elif defined(__APPLE__)
+#include <Availability.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#include <pthread/qos.h>
+#if defined(__MAC_11_0) || defined(__IPHONE_14_0)
+#include <os/workgroup.h>
+#define LABSOUND_HAS_WORKGROUPS
+#endif
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lab
+{
+
+#if defined(_WIN32)
+
+ScopedThreadScheduling::ScopedThreadScheduling(const ThreadScheduling & scheduling)
+{
+    HANDLE thread = GetCurrentThread();
+
+    if (!scheduling.cpus.empty())
+    {
+        DWORD_PTR mask = 0;
+        for (int cpu : scheduling.cpus)
+            if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+                mask |= DWORD_PTR(1) << cpu;
+        if (!mask || !SetThreadAffinityMask(thread, mask))
+        {
+            LOG_WARN("ThreadScheduling: could not set the thread's processor affinity");
+            _applied = false;
+        }
+    }
+
+    if (scheduling.priority == ThreadPriority::Realtime)
+    {
+        DWORD taskIndex = 0;
+        HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+        if (task)
+        {
+            AvSetMmThreadPriority(task, AVRT_PRIORITY_HIGH);
+            _handle = task;
+        }
+        else
+        {
+            LOG_WARN("ThreadScheduling: could not join the Pro Audio MMCSS task");
+            _applied = false;
+        }
+    }
+    else if (scheduling.priority == ThreadPriority::High)
+    {
+        _previousPriority = GetThreadPriority(thread);
+        _priorityChanged = SetThreadPriority(thread, THREAD_PRIORITY_HIGHEST) != 0;
+        _applied = _applied && _priorityChanged;
+    }
+}
+
+ScopedThreadScheduling::~ScopedThreadScheduling()
+{
+    if (_handle)
+        AvRevertMmThreadCharacteristics(static_cast<HANDLE>(_handle));
+    if (_priorityChanged)
+        SetThreadPriority(GetCurrentThread(), _previousPriority);
+}
+
+#elif defined(__APPLE__)
+
+ScopedThreadScheduling::ScopedThreadScheduling(const ThreadScheduling & scheduling)
+{
+    if (!scheduling.cpus.empty())
+        _applied = false;
+
+    if (scheduling.priority == ThreadPriority::Realtime)
+    {
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        const double ticksPerSecond = 1.e9 * timebase.denom / timebase.numer;
+        const double period = scheduling.period > 0 ? scheduling.period : 0.005;
+
+        // as Core Audio budgets its own IO thread: half the period to compute, due by its end
+        thread_time_constraint_policy_data_t policy;
+        policy.period = static_cast<uint32_t>(period * ticksPerSecond);
+        policy.computation = static_cast<uint32_t>(0.5 * period * ticksPerSecond);
+        policy.constraint = static_cast<uint32_t>(period * ticksPerSecond);
+        policy.preemptible = 1;
+        _priorityChanged = thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                                             reinterpret_cast<thread_policy_t>(&policy), THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+        if (!_priorityChanged)
+        {
+            LOG_WARN("ThreadScheduling: could not make the thread realtime");
+            _applied = false;
+        }
+    }
+    else if (scheduling.priority == ThreadPriority::High)
+    {
+        _priorityChanged = pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0) == 0;
+        _applied = _applied && _priorityChanged;
+    }
+
+#if defined(LABSOUND_HAS_WORKGROUPS)
+    if (scheduling.workgroup)
+    {
+        if (__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+        {
+            os_workgroup_t workgroup = static_cast<os_workgroup_t>(scheduling.workgroup);
+            os_workgroup_join_token_s * token = new os_workgroup_join_token_s;
+            if (os_workgroup_join(workgroup, token) == 0)
+            {
+                _workgroup = scheduling.workgroup;
+                _joinToken = token;
+            }
+            else
+            {
+                LOG_WARN("ThreadScheduling: could not join the audio workgroup");
+                delete token;
+                _applied = false;
+            }
+        }
+    }
+#endif
+}
+
+ScopedThreadScheduling::~ScopedThreadScheduling()
+{
+#if defined(LABSOUND_HAS_WORKGROUPS)
+    if (_joinToken)
+    {
+        if (__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+        {
+            os_workgroup_join_token_s * token = static_cast<os_workgroup_join_token_s *>(_joinToken);
+            os_workgroup_leave(static_cast<os_workgroup_t>(_workgroup), token);
+            delete token;
+        }
+    }
+#endif
+
+    if (!_priorityChanged)
+        return;
+
+    thread_standard_policy_data_t policy = {};
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_STANDARD_POLICY,
+                      reinterpret_cast<thread_policy_t>(&policy), THREAD_STANDARD_POLICY_COUNT);
+    pthread_set_qos_class_self_np(QOS_CLASS_DEFAULT, 0);
+}
+
+#else
+
+ScopedThreadScheduling::ScopedThreadScheduling(const ThreadScheduling & scheduling)
+{
+#if defined(__linux__)
+    if (!scheduling.cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : scheduling.cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        {
+            LOG_WARN("ThreadScheduling: could not set the thread's processor affinity");
+            _applied = false;
+        }
+    }
+#else
+    if (!scheduling.cpus.empty())
+        _applied = false;
+#endif
+
+    if (scheduling.priority == ThreadPriority::Realtime)
+    {
+        // below the top of the range, which audio servers such as JACK keep for their own threads
+        sched_param param;
+        pthread_getschedparam(pthread_self(), &_previousPolicy, &param);
+        _previousPriority = param.sched_priority;
+
+        param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO) - 20);
+        _priorityChanged = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+        if (!_priorityChanged)
+        {
+            LOG_WARN("ThreadScheduling: could not make the thread SCHED_FIFO; is rtprio permitted?");
+            _applied = false;
+        }
+    }
+    else if (scheduling.priority == ThreadPriority::High)
+    {
+#if defined(__linux__)
+        // on Linux, niceness belongs to the thread
+        const id_t thread = static_cast<id_t>(syscall(SYS_gettid));
+        errno = 0;
+        const int nice = getpriority(PRIO_PROCESS, thread);
+        if (errno == 0 && setpriority(PRIO_PROCESS, thread, std::min(nice, -10)) == 0)
+        {
+            _previousPolicy = -1;
+            _previousPriority = nice;
+            _priorityChanged = true;
+        }
+#endif
+        _applied = _applied && _priorityChanged;
+    }
+}
+
+ScopedThreadScheduling::~ScopedThreadScheduling()
+{
+    if (!_priorityChanged)
+        return;
+
+#if defined(__linux__)
+    if (_previousPolicy == -1)
+    {
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), _previousPriority);
+        return;
+    }
+#endif
+
+    sched_param param;
+    param.sched_priority = _previousPriority;
+    pthread_setschedparam(pthread_self(), _previousPolicy, &param);
+}
+
+#endif
+
+}  // lab
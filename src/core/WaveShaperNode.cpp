@@ -3,6 +3,7 @@
 
 #include "LabSound/core/WaveShaperNode.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/extended/Registry.h"
@@ -10,32 +11,9 @@
 #include <algorithm>
 #include <memory>
 #include <vector>
-#include "internal/UpSampler.h" //ouch..how to hide internal from calling application?
-#include "internal/DownSampler.h"
+#include "internal/Oversampler.h"
 
 namespace lab {
-struct OverSamplingArrays
-{
-    std::shared_ptr<AudioFloatArray> m_tempBuffer;
-    std::shared_ptr<AudioFloatArray> m_tempBuffer2;
-    std::shared_ptr<UpSampler> m_upSampler;
-    std::shared_ptr<DownSampler> m_downSampler;
-    std::shared_ptr<UpSampler> m_upSampler2;
-    std::shared_ptr<DownSampler> m_downSampler2;
-};
-
-static void* createOversamplingArrays()
-{
-    struct OverSamplingArrays * osa = new struct OverSamplingArrays;
-    int renderQuantumSize = 128;  // from https://www.w3.org/TR/webaudio/#render-quantum-size
-    osa->m_tempBuffer = std::make_shared<AudioFloatArray>(renderQuantumSize * 2);
-    osa->m_tempBuffer2 = std::make_shared<AudioFloatArray>(renderQuantumSize * 4);
-    osa->m_upSampler = std::make_shared<UpSampler>(renderQuantumSize);
-    osa->m_downSampler = std::make_shared<DownSampler>(renderQuantumSize * 2);
-    osa->m_upSampler2 = std::make_shared<UpSampler>(renderQuantumSize * 2);
-    osa->m_downSampler2 = std::make_shared<DownSampler>(renderQuantumSize * 4);
-    return (void *) osa;
-}
 
 AudioNodeDescriptor * WaveShaperNode::desc()
 {
@@ -57,84 +35,103 @@ WaveShaperNode::WaveShaperNode(AudioContext & ac, AudioNodeDescriptor const & de
     initialize();
 }
 
-WaveShaperNode::~WaveShaperNode()
+WaveShaperNode::~WaveShaperNode() = default;
+
+void WaveShaperNode::setCurve(std::vector<float> & curve)
 {
-    delete (OverSamplingArrays*) m_oversamplingArrays;
+    std::vector<CurvePoint> points(curve.size());
+    for (size_t i = 0; i < curve.size(); ++i)
+    {
+        points[i].value = curve[i];
+        points[i].slope = i + 1 < curve.size() ? curve[i + 1] - curve[i] : 0.f;
+    }
+
+    std::lock_guard<std::mutex> lock(_curveMutex);
+    m_newCurve.swap(points);
+    m_newPolynomial.clear();
+    _newCurveReady = 1;
 }
 
-void WaveShaperNode::setCurve(std::vector<float> & curve)
+void WaveShaperNode::setPolynomial(const std::vector<float> & coefficients)
 {
     std::lock_guard<std::mutex> lock(_curveMutex);
-    m_newCurve = curve;
+    m_newPolynomial = coefficients;
+    m_newCurve.clear();
     _newCurveReady = 1;
 }
 
+// frames are shaped in chunks, so that the arithmetic of a chunk runs as one vectorizable
+// loop ahead of the loop that depends on it
+static const int ShapingChunk = 128;
+
 void WaveShaperNode::processCurve(const float* source, float* destination, int framesToProcess)
 {
-    float const* curveData = m_curve.data();
+    if (!m_polynomial.empty())
+    {
+        const float * coefficients = m_polynomial.data();
+        const int order = static_cast<int>(m_polynomial.size()) - 1;
+        float x[ShapingChunk];
+        for (int start = 0; start < framesToProcess; start += ShapingChunk)
+        {
+            const int count = std::min(ShapingChunk, framesToProcess - start);
+            float * out = destination + start;
+            for (int i = 0; i < count; ++i)
+            {
+                x[i] = std::max(-1.f, std::min(1.f, source[start + i]));
+                out[i] = coefficients[order];
+            }
+
+            // Horner's rule, a coefficient at a time across the chunk
+            for (int k = order - 1; k >= 0; --k)
+            {
+                const float c = coefficients[k];
+                for (int i = 0; i < count; ++i)
+                    out[i] = out[i] * x[i] + c;
+            }
+        }
+        return;
+    }
+
+    const CurvePoint * points = m_curve.data();
     int curveLength = static_cast<int>(m_curve.size());
 
-    ASSERT(curveData);
+    ASSERT(points);
 
-    if (!curveData || !curveLength)
+    if (!points || !curveLength)
     {
         memcpy(destination, source, sizeof(float) * framesToProcess);
         return;
     }
 
-    // Apply waveshaping curve.
-    for (int i = 0; i < framesToProcess; ++i)
+    // Apply waveshaping curve. An input of -1 to +1 spans the curve, with 0 at its center,
+    // and input outside the nominal range is clamped to the curve's ends.
+    const float scale = 0.5f * static_cast<float>(curveLength - 1);
+    const float lastIndex = static_cast<float>(curveLength - 1);
+    int index[ShapingChunk];
+    float fraction[ShapingChunk];
+    for (int start = 0; start < framesToProcess; start += ShapingChunk)
     {
-        const float input = source[i];
-
-        // Calculate an index based on input -1 -> +1 with 0 being at the center of the curve data.
-        int index = static_cast<int>( (curveLength * (input + 1)) / 2 );
+        const int count = std::min(ShapingChunk, framesToProcess - start);
+        const float * in = source + start;
+        for (int i = 0; i < count; ++i)
+        {
+            const float position = std::max(0.f, std::min(lastIndex, scale * (in[i] + 1.f)));
+            index[i] = static_cast<int>(position);
+            fraction[i] = position - static_cast<float>(index[i]);
+        }
 
-        // Clip index to the input range of the curve.
-        // This takes care of input outside of nominal range -1 -> +1
-        index = std::max(index, 0);
-        index = std::min(index, curveLength - 1);
-        destination[i] = curveData[index];
+        float * out = destination + start;
+        for (int i = 0; i < count; ++i)
+        {
+            const CurvePoint & point = points[index[i]];
+            out[i] = point.value + point.slope * fraction[i];
+        }
     }
 }
-// https://github.com/WebKit/WebKit/blob/main/Source/WebCore/Modules/webaudio/WaveShaperDSPKernel.cpp
-void WaveShaperNode::processCurve2x(const float * source, float * destination, int framesToProcess)
-{
-    OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays;
-    
-    auto hold_buffer_pointer = osa->m_tempBuffer;
-    auto hold_sampler = osa->m_upSampler;
-    float * tempP = osa->m_tempBuffer->data();
-
-    osa->m_upSampler->process(source, tempP, framesToProcess);
-
-    // Process at 2x up-sampled rate.
-    processCurve(tempP, tempP, framesToProcess * 2);
-
-    osa->m_downSampler->process(tempP, destination, framesToProcess * 2);
-}
 
-void WaveShaperNode::processCurve4x(const float * source, float * destination, int framesToProcess)
+double WaveShaperNode::latencyTime(ContextRenderLock & r) const
 {
-    OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays;
-
-    auto hold_buffer_pointer = osa->m_tempBuffer;
-    auto hold_buffer_pointer2 = osa->m_tempBuffer2;
-    auto hold_sampler = osa->m_upSampler;
-    auto hold_sampler2 = osa->m_upSampler2;
-
-    
-    float * tempP = osa->m_tempBuffer->data();
-    float * tempP2 = osa->m_tempBuffer2->data();
-
-    osa->m_upSampler->process(source, tempP, framesToProcess);
-    osa->m_upSampler2->process(tempP, tempP2, framesToProcess * 2);
-
-    // Process at 4x up-sampled rate.
-    processCurve(tempP2, tempP2, framesToProcess * 4);
-
-    osa->m_downSampler2->process(tempP2, tempP, framesToProcess * 4);
-    osa->m_downSampler->process(tempP, destination, framesToProcess * 2);
+    return Oversampler::latencyFrames(m_oversample, m_oversampleQuality) / r.context()->sampleRate();
 }
 
 void WaveShaperNode::process(ContextRenderLock & r, int bufferSize)
@@ -144,11 +141,12 @@ void WaveShaperNode::process(ContextRenderLock & r, int bufferSize)
         // this could cause a pop, but setting a curve should be extremely rare
         std::lock_guard<std::mutex> lock(_curveMutex);
         std::swap(m_curve, m_newCurve);
+        std::swap(m_polynomial, m_newPolynomial);
         _newCurveReady = 0;
     }
 
     AudioBus* destinationBus = output(0)->bus(r);
-    if (!isInitialized() || !m_curve.size())
+    if (!isInitialized() || (m_curve.empty() && m_polynomial.empty()))
     {
         destinationBus->zero();
         return;
@@ -168,31 +166,30 @@ void WaveShaperNode::process(ContextRenderLock & r, int bufferSize)
         output(0)->setNumberOfChannels(r, srcChannelCount);
         destinationBus = output(0)->bus(r);
     }
-    if (m_oversample != OverSampleType::NONE && !m_oversamplingArrays)
-         m_oversamplingArrays = createOversamplingArrays();
 
-    for (int i = 0; i < srcChannelCount; ++i)
+    const OverSampleType oversample = m_oversample;
+    const OverSampleQuality quality = m_oversampleQuality;
+    if (oversample == OverSampleType::NONE)
     {
-        const float * source = sourceBus->channel(i)->data();
-        float * destination = destinationBus->channel(i)->mutableData();
-        int framesToProcess = bufferSize;
-        switch (m_oversample)
-        {
-            case OverSampleType::NONE:
-                processCurve(source, destination, framesToProcess);
-                break;
-            case OverSampleType::_2X :
-                processCurve2x(source, destination, framesToProcess);
-                break;
-            case OverSampleType::_4X :
-                processCurve4x(source, destination, framesToProcess);
-                break;
-
-            default:
-                ASSERT_NOT_REACHED();
-        }
+        m_oversamplers.clear();
+        for (int i = 0; i < srcChannelCount; ++i)
+            processCurve(sourceBus->channel(i)->data(), destinationBus->channel(i)->mutableData(), bufferSize);
+        return;
+    }
 
-        //processCurve( sourceBus->channel(i)->data(), destinationBus->channel(i)->mutableData(), bufferSize);
+    // each channel has its own filter history
+    if (m_oversamplers.size() != static_cast<size_t>(srcChannelCount) ||
+        m_oversamplers[0]->type() != oversample || m_oversamplers[0]->quality() != quality)
+    {
+        m_oversamplers.clear();
+        for (int i = 0; i < srcChannelCount; ++i)
+            m_oversamplers.emplace_back(new Oversampler(oversample, quality));
+    }
+
+    for (int i = 0; i < srcChannelCount; ++i)
+    {
+        m_oversamplers[i]->process(sourceBus->channel(i)->data(), destinationBus->channel(i)->mutableData(), bufferSize,
+            [this](float * frames, int count) { processCurve(frames, frames, count); });
     }
 }
 
@@ -0,0 +1,207 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/WindowFunctions.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace lab
+{
+
+// Reference https://github.com/spurious/snd-mirror/blob/master/clm.c
+static void computeWindow(const WindowFunction type, float * buffer, const int window_size)
+{
+    const float max_index = static_cast<float>(window_size) - 1.f;
+
+    switch (type)
+    {
+        case WindowFunction::rectangle:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = 1.f;
+            }
+        }
+        break;
+
+        case WindowFunction::cosine:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = std::sin((static_cast<float>(LAB_PI) * i) / max_index);
+            }
+        }
+        break;
+
+        case WindowFunction::hann:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_1(max_index, i, 0.5f, 0.5f);
+            }
+        }
+        break;
+
+        case WindowFunction::hamming:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_1(max_index, i, 0.54f, 0.46f);
+            }
+        }
+        break;
+
+        case WindowFunction::blackman:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_2(max_index, i, 0.42f, 0.50f, 0.08f);
+            }
+        }
+        break;
+
+        case WindowFunction::nutall:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_3(max_index, i, 0.355768f, 0.487396f, 0.144232f, 0.012604f);
+            }
+        }
+        break;
+
+        case WindowFunction::blackman_harris:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_3(max_index, i, 0.35875f, 0.48829f, 0.14128f, 0.01168f);
+            }
+        }
+        break;
+
+        case WindowFunction::blackman_nutall:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_3(max_index, i, 0.3635819f, 0.4891775f, 0.1365995f, 0.0106411f);
+            }
+        }
+        break;
+
+        case WindowFunction::hann_poisson:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                const float alpha = 2.f;
+                const float a = 1.f - std::cos((static_cast<float>(LAB_TAU) * i) / max_index);
+                const float b = (-alpha * std::abs(max_index - 2.f * i)) / max_index;
+                buffer[i] = 0.5f * a * exp(b);
+            }
+        }
+        break;
+
+        case WindowFunction::gaussian50:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gaussian(max_index, i, 0.50f);
+            }
+        }
+        break;
+
+        case WindowFunction::gaussian25:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gaussian(max_index, i, 0.25f);
+            }
+        }
+        break;
+
+        case WindowFunction::welch:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                const float num = i - (max_index * 0.5f);
+                const float denom = (window_size + 1.f) * 0.5f;
+                const float fract = num / denom;
+                buffer[i] = 1.f - fract * fract;
+            }
+        }
+        break;
+
+        case WindowFunction::bartlett:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = 2.f / (window_size - 1.f) * (max_index / 2.f - std::abs(i - max_index / 2.f));
+            }
+        }
+        break;
+
+        case WindowFunction::bartlett_hann:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_2(max_index, i, 0.63f, 0.48f, 0.38f);
+            }
+        }
+        break;
+
+        case WindowFunction::parzen:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = 1.f - abs((2.f * i - window_size) / (window_size + 1.f));
+            }
+        }
+        break;
+
+        case WindowFunction::flat_top:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::gen_cosine_4(max_index, i, 1.f, 1.93f, 1.29f, 0.388f, 0.028f);
+            }
+        }
+        break;
+
+        case WindowFunction::lanczos:
+        {
+            for (int i = 0; i < window_size; ++i)
+            {
+                buffer[i] = detail::sinc(2.f * i / max_index - 1.f);
+            }
+        }
+        break;
+    }
+}
+
+const float * WindowFunctionTable(const WindowFunction type, const int window_size)
+{
+    if (window_size <= 0)
+        return nullptr;
+
+    static std::mutex tablesMutex;
+    static std::map<std::pair<int, int>, std::unique_ptr<std::vector<float>>> tables;
+
+    std::lock_guard<std::mutex> lock(tablesMutex);
+    auto & table = tables[std::make_pair(static_cast<int>(type), window_size)];
+    if (!table)
+    {
+        table.reset(new std::vector<float>(window_size, 1.f));
+        computeWindow(type, table->data(), window_size);
+    }
+    return table->data();
+}
+
+void ApplyWindowFunctionInplace(const WindowFunction type, float * buffer, const int window_size)
+{
+    if (const float * window = WindowFunctionTable(type, window_size))
+        VectorMath::vmul(buffer, 1, window, 1, buffer, 1, window_size);
+}
+
+}  // namespace lab
@@ -10,8 +10,9 @@
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/VectorMath.h"
 
+#include <algorithm>
 #include <limits>
-#include <deque>
+#include <math.h>
 
 namespace lab
 {
@@ -39,14 +40,66 @@ namespace lab
     {
     public:
         float cached_sample_rate = 48000.f;   // typical default
-        struct LerpTarget { float t, dvdt; };
-        std:: deque<LerpTarget> _lerp;
 
-        ADSRNodeImpl() : AudioProcessor()
+        // The envelope is a short queue of linear segments, of a whole number of frames
+        // each. Attack, decay, sustain and release are the most ever queued, so the queue
+        // is a fixed array, and a gate transition never allocates.
+        struct Segment { double frames; float dvdt; };
+        enum { MaxSegments = 4 };
+        Segment _segments[MaxSegments];
+        int _segment = 0;       // the segment being generated
+        int _segmentCount = 0;  // segments queued
+
+        void clearSegments() { _segment = _segmentCount = 0; }
+
+        void pushSegment(float steps, float dvdt)
         {
-            envelope.reserve(AudioNode::ProcessingSizeInFrames * 4);
+            // a segment of a fractional number of steps takes the whole step it starts
+            if (_segmentCount < MaxSegments)
+                _segments[_segmentCount++] = Segment{ steps > 0 ? ceil(static_cast<double>(steps)) : 0., dvdt };
         }
 
+        bool segmentsRemaining() const { return _segment < _segmentCount; }
+
+        // Writes count frames of the envelope. Each run within a segment is computed in
+        // closed form, which vectorizes, rather than accumulated frame by frame. Returns
+        // false if any frame differed from the envelope's value at the start.
+        bool generate(float * destination, int count)
+        {
+            bool flat = true;
+            int i = 0;
+            while (i < count)
+            {
+                if (!segmentsRemaining())
+                {
+                    std::fill(destination + i, destination + count, currentEnvelope);
+                    return flat;
+                }
+
+                Segment & segment = _segments[_segment];
+                if (segment.frames <= 0)
+                {
+                    ++_segment;
+                    continue;
+                }
+
+                const int n = static_cast<int>(std::min(segment.frames, static_cast<double>(count - i)));
+                const float start = currentEnvelope;
+                const float dvdt = segment.dvdt;
+                float * run = destination + i;
+                for (int k = 0; k < n; ++k)
+                    run[k] = start + dvdt * static_cast<float>(k + 1);
+
+                currentEnvelope = start + dvdt * static_cast<float>(n);
+                flat = flat && dvdt == 0.f;
+                segment.frames -= n;
+                i += n;
+            }
+            return flat;
+        }
+
+        ADSRNodeImpl() : AudioProcessor() { }
+
         virtual ~ADSRNodeImpl() {}
 
         virtual void initialize() override { }
@@ -55,8 +108,6 @@ namespace lab
         // Processes the source to destination bus. The number of channels must match in source and destination.
         virtual void process(ContextRenderLock & r, const lab::AudioBus * sourceBus, lab::AudioBus* destinationBus, int framesToProcess) override
         {
-            using std::deque;
-
             if (!destinationBus->numberOfChannels())
                 return;
 
@@ -66,27 +117,26 @@ namespace lab
                 return;
             }
 
-            if (framesToProcess != _gateArray.size()) 
-                _gateArray.resize(framesToProcess);
-            if (envelope.size() != framesToProcess)
-                envelope.resize(framesToProcess);
+            if (framesToProcess > _gateArray.size())
+                _gateArray.allocate(framesToProcess);
+            if (framesToProcess > envelope.size())
+                envelope.allocate(framesToProcess);
 
             // scan the gate signal
             const bool gate_is_connected = m_gate->hasSampleAccurateValues();
+            float * gates = _gateArray.data();
             if (gate_is_connected)
             {
-                m_gate->calculateSampleAccurateValues(r, _gateArray.data(), framesToProcess);
+                m_gate->calculateSampleAccurateValues(r, gates, framesToProcess);
 
                 // threshold the gate to on or off
                 for (int i = 0; i < framesToProcess; ++i)
-                    _gateArray[i] = _gateArray[i] > 0 ? 1.f : 0.f;
+                    gates[i] = gates[i] > 0 ? 1.f : 0.f;
             }
             else
             {
-                float g = m_gate->value();
-                // threshold the gate to on or off
-                for (int i = 0; i < framesToProcess; ++i)
-                    _gateArray[i] = g > 0 ? 1.f : 0.f;
+                // threshold the gate to on or off; it can only change at the first frame
+                gates[0] = m_gate->value() > 0 ? 1.f : 0.f;
             }
 
             // oneshot == false means gate controls Attack/Sustain
@@ -94,68 +144,87 @@ namespace lab
             bool oneshot = m_oneShot->valueBool();
 
             cached_sample_rate = r.context()->sampleRate();
-            for (int i = 0; i < framesToProcess; ++i)
+            const float startEnvelope = currentEnvelope;
+            bool flat = true;
+            float * env = envelope.data();
+            int i = 0;
+            while (i < framesToProcess)
             {
-                if (_currentGate == 0 && _gateArray[i] > 0)
+                const float gate = gate_is_connected ? gates[i] : gates[0];
+                if (_currentGate == 0 && gate > 0)
                 {
                     // attack begin
                     _currentGate = 1;
-                    _lerp.clear();  // forget all previous lerps
+                    clearSegments();  // forget all previous lerps
                     float attackLevel = m_attackLevel->valueFloat();
                     float attackDelta = m_attackLevel->valueFloat() - currentEnvelope;
                     float attackRatio = attackDelta / attackLevel;
                     float attackSteps = m_attackTime->valueFloat() * attackRatio * cached_sample_rate;
                     float attackStepSize = attackDelta / attackSteps;
 
-                    _lerp.emplace_back(LerpTarget{ attackSteps, attackStepSize });
+                    pushSegment(attackSteps, attackStepSize);
 
                     float sustainLevel = m_sustainLevel->valueFloat();
                     float decaySteps = m_decayTime->valueFloat() * cached_sample_rate;
                     float decayStepSize = (sustainLevel - attackLevel) / decaySteps;
-                    _lerp.emplace_back(LerpTarget{ decaySteps, decayStepSize });
+                    pushSegment(decaySteps, decayStepSize);
 
                     if (!gate_is_connected || oneshot)
                     {
                         // if the gate is not connected, automate the sustain and release.
                         float sustainSteps = m_sustainTime->valueFloat() * cached_sample_rate;
-                        _lerp.emplace_back(LerpTarget{ sustainSteps, 0.f });
+                        pushSegment(sustainSteps, 0.f);
                         float releaseSteps = m_releaseTime->valueFloat() * cached_sample_rate;
-                        _lerp.emplace_back(LerpTarget{ releaseSteps, -sustainLevel / releaseSteps });
+                        pushSegment(releaseSteps, -sustainLevel / releaseSteps);
                     }
-                    envelope[i] = currentEnvelope;
+                    env[i++] = currentEnvelope;
+                    continue;
                 }
-                else if (_currentGate > 0 && _gateArray[i] == 0)
+                else if (_currentGate > 0 && gate == 0)
                 {
                     // release begin
                     _currentGate = 0;
-                    _lerp.clear();  // forget all previous lerps
+                    clearSegments();  // forget all previous lerps
                     float releaseSteps = m_releaseTime->valueFloat() * cached_sample_rate;
-                    _lerp.emplace_back(LerpTarget{ releaseSteps, -currentEnvelope / releaseSteps });
-                    envelope[i] = currentEnvelope;
+                    pushSegment(releaseSteps, -currentEnvelope / releaseSteps);
+                    env[i++] = currentEnvelope;
+                    continue;
                 }
-                else
+
+                // generate up to the next transition of the gate
+                int end = framesToProcess;
+                if (gate_is_connected)
                 {
-                    bool assigned = false;
-                    while (_lerp.size())
-                    {
-                        LerpTarget& front = _lerp.front();
-                        if (front.t > 0)
-                        {
-                            currentEnvelope += front.dvdt;
-                            envelope[i] = currentEnvelope;
-                            front.t -= 1.f;
-                            assigned = true;
-                            break;
-                        }
-                        else
-                            _lerp.pop_front();
-                    }
-                    if (!assigned)
-                        envelope[i] = currentEnvelope;
+                    end = i + 1;
+                    while (end < framesToProcess && gates[end] == gate)
+                        ++end;
                 }
+                flat = generate(env + i, end - i) && flat;
+                i = end;
+            }
+
+            // an envelope that held still for the whole quantum is applied as a scalar
+            if (flat && currentEnvelope == startEnvelope && destinationBus->topologyMatches(*sourceBus))
+            {
+                if (currentEnvelope == 0.f)
+                {
+                    destinationBus->zero();
+                    return;
+                }
+
+                for (int c = 0; c < destinationBus->numberOfChannels(); ++c)
+                {
+                    const AudioChannel * source = sourceBus->channel(c);
+                    AudioChannel * destination = destinationBus->channel(c);
+                    if (source->isConstant())
+                        destination->setConstant(source->constantValue() * currentEnvelope);
+                    else
+                        VectorMath::vsmul(source->data(), 1, &currentEnvelope, destination->mutableData(), 1, framesToProcess);
+                }
+                return;
             }
 
-            destinationBus->copyWithSampleAccurateGainValuesFrom(*sourceBus, envelope.data(), framesToProcess);
+            destinationBus->copyWithSampleAccurateGainValuesFrom(*sourceBus, env, framesToProcess);
         }
 
         virtual void reset() override { }
@@ -166,9 +235,9 @@ namespace lab
         float _currentGate{ 0.0 };
 
         float currentEnvelope{ 0.f };
-        std::vector<float> envelope;
+        AudioFloatArray envelope;
 
-        std::vector<float> _gateArray;
+        AudioFloatArray _gateArray;
 
         std::shared_ptr<AudioParam> m_gate;
 
@@ -192,6 +261,8 @@ namespace lab
         addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
         
         adsr_impl->m_gate = param("gate");
+        adsr_impl->envelope.allocate(renderQuantumSize());
+        adsr_impl->_gateArray.allocate(renderQuantumSize());
 
         adsr_impl->m_oneShot = setting("oneShot");
         adsr_impl->m_oneShot->setBool(true);
@@ -256,7 +327,7 @@ namespace lab
             return true;
 
         double now = r.context()->currentTime();
-        return adsr_impl->_lerp.size() > 0;
+        return adsr_impl->segmentsRemaining();
     }
 
     void ADSRNode::process(ContextRenderLock& r, int bufferSize)
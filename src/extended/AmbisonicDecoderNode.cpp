@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/AmbisonicDecoderNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioListener.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Ambisonics.h"
+#include "internal/Assertions.h"
+#include "internal/DelayDSPKernel.h"
+#include "internal/FFTConvolver.h"
+#include "internal/HRTFDatabase.h"
+#include "internal/HRTFPanner.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace lab
+{
+
+using namespace VectorMath;
+
+// as the HRTFPanner's
+static const double MaxDelayTimeSeconds = 0.002;
+
+static char const * const s_decoder_modes[] = {"Binaural", "Speakers", nullptr};
+
+static AudioSettingDescriptor s_sDesc[] = {
+    {"order",       "ORDR", SettingType::Integer},
+    {"decoderMode", "MODE", SettingType::Enum, s_decoder_modes},
+    nullptr};
+
+AudioNodeDescriptor * AmbisonicDecoderNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_sDesc, 2};
+    return &d;
+}
+
+// The virtual speakers of the binaural decoder, for each order, as azimuth and elevation pairs in
+// the field's frame. They lie on the database's grid, and there are enough of them for the order;
+// none are below the database's lowest elevation.
+static const int s_binauralLayout1[] = {
+    45, -45, 135, -45, 225, -45, 315, -45,
+    0, 45, 90, 45, 180, 45, 270, 45};
+
+static const int s_binauralLayout2[] = {
+    0, -45, 90, -45, 180, -45, 270, -45,
+    30, 0, 90, 0, 150, 0, 210, 0, 270, 0, 330, 0,
+    45, 45, 135, 45, 225, 45, 315, 45,
+    0, 90};
+
+static const int s_binauralLayout3[] = {
+    0, -45, 60, -45, 120, -45, 180, -45, 240, -45, 300, -45,
+    0, 0, 45, 0, 90, 0, 135, 0, 180, 0, 225, 0, 270, 0, 315, 0,
+    30, 45, 90, 45, 150, 45, 210, 45, 270, 45, 330, 45,
+    0, 90};
+
+static void binauralLayout(int order, const int *& layout, int & speakers)
+{
+    switch (order)
+    {
+        case 1: layout = s_binauralLayout1; speakers = sizeof(s_binauralLayout1) / sizeof(int) / 2; break;
+        case 2: layout = s_binauralLayout2; speakers = sizeof(s_binauralLayout2) / sizeof(int) / 2; break;
+        default: layout = s_binauralLayout3; speakers = sizeof(s_binauralLayout3) / sizeof(int) / 2; break;
+    }
+}
+
+static void appendDirection(std::vector<double> & directions, double azimuth, double elevation)
+{
+    const double phi = azimuth * LAB_PI / 180.0;
+    const double theta = elevation * LAB_PI / 180.0;
+    directions.push_back(cos(theta) * cos(phi));
+    directions.push_back(cos(theta) * sin(phi));
+    directions.push_back(sin(theta));
+}
+
+// A speaker of the binaural decoder, which is heard through the database's responses for its direction
+struct AmbisonicDecoderNode::VirtualSpeaker
+{
+    VirtualSpeaker(int fftSize, float sampleRate)
+        : convolverL(fftSize)
+        , convolverR(fftSize)
+        , delayL(MaxDelayTimeSeconds, sampleRate)
+        , delayR(MaxDelayTimeSeconds, sampleRate)
+    {
+    }
+
+    void reset()
+    {
+        convolverL.reset();
+        convolverR.reset();
+        delayL.reset();
+        delayR.reset();
+    }
+
+    int azimuthIndex = 0;
+    double elevation = 0;
+
+    FFTConvolver convolverL;
+    FFTConvolver convolverR;
+    DelayDSPKernel delayL;
+    DelayDSPKernel delayR;
+};
+
+AmbisonicDecoderNode::AmbisonicDecoderNode(AudioContext & ac)
+    : AudioNode(ac, *desc())
+    , m_rotation(new AmbisonicRotation())
+    , m_sampleRate(ac.sampleRate())
+{
+    m_order = setting("order");
+    m_decoderMode = setting("decoderMode");
+
+    m_order->setUint32(1, false);
+    m_decoderMode->setUint32(static_cast<uint32_t>(BINAURAL), false);
+
+    m_speakers = {{-30.f, 0.f}, {30.f, 0.f}};
+
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+    // the field's channels are summed as they are, however many there are
+    _self->m_channelCount = MaxAmbisonicChannels;
+    _self->m_channelCountMode = ChannelCountMode::Max;
+    _self->m_channelInterpretation = ChannelInterpretation::Discrete;
+
+    initialize();
+}
+
+AmbisonicDecoderNode::~AmbisonicDecoderNode()
+{
+    uninitialize();
+}
+
+int AmbisonicDecoderNode::order() const
+{
+    return std::max(1, std::min(static_cast<int>(m_order->valueUint32()), MaxAmbisonicOrder));
+}
+
+void AmbisonicDecoderNode::setOrder(int order)
+{
+    if (order < 1 || order > MaxAmbisonicOrder)
+        throw std::invalid_argument("Ambisonic orders run from 1 to 3");
+    m_order->setUint32(static_cast<uint32_t>(order));
+}
+
+AmbisonicDecoderNode::DecoderMode AmbisonicDecoderNode::decoderMode() const
+{
+    return static_cast<DecoderMode>(m_decoderMode->valueUint32());
+}
+
+void AmbisonicDecoderNode::setDecoderMode(DecoderMode mode)
+{
+    if (mode != BINAURAL && mode != SPEAKERS)
+        throw std::invalid_argument("invalid decoder mode");
+    m_decoderMode->setUint32(static_cast<uint32_t>(mode));
+}
+
+void AmbisonicDecoderNode::setSpeakers(const std::vector<Speaker> & speakers)
+{
+    if (speakers.empty())
+        throw std::invalid_argument("AmbisonicDecoderNode needs at least one speaker");
+
+    std::lock_guard<std::mutex> lock(m_speakerMutex);
+    m_speakers = speakers;
+    m_speakersChanged = true;
+}
+
+std::vector<AmbisonicDecoderNode::Speaker> AmbisonicDecoderNode::speakers() const
+{
+    std::lock_guard<std::mutex> lock(m_speakerMutex);
+    return m_speakers;
+}
+
+void AmbisonicDecoderNode::updateDecoder(int order, DecoderMode mode)
+{
+    std::vector<double> directions;
+    if (mode == BINAURAL)
+    {
+        const int * layout;
+        int count;
+        binauralLayout(order, layout, count);
+
+        const int fftSize = HRTFPanner::fftSizeForSampleRate(m_sampleRate);
+        const double azimuthSpacing = 360.0 / HRTFDatabase::numberOfAzimuths();
+        m_virtualSpeakers.resize(count);
+        for (int s = 0; s < count; ++s)
+        {
+            if (!m_virtualSpeakers[s])
+                m_virtualSpeakers[s].reset(new VirtualSpeaker(fftSize, m_sampleRate));
+            else
+                m_virtualSpeakers[s]->reset();
+
+            // the database's azimuths turn counterclockwise, as the field's do
+            m_virtualSpeakers[s]->azimuthIndex = static_cast<int>(floor(layout[s * 2] / azimuthSpacing + 0.5)) % HRTFDatabase::numberOfAzimuths();
+            m_virtualSpeakers[s]->elevation = layout[s * 2 + 1];
+            appendDirection(directions, layout[s * 2], layout[s * 2 + 1]);
+        }
+    }
+    else
+    {
+        // the speakers' azimuths turn clockwise, and the field's counterclockwise
+        for (const Speaker & speaker : m_renderSpeakers)
+            appendDirection(directions, -speaker.azimuth, speaker.elevation);
+    }
+
+    m_decoder = ambisonicDecodingMatrix(order, directions);
+    m_decodedOrder = order;
+    m_decodedMode = mode;
+}
+
+void AmbisonicDecoderNode::process(ContextRenderLock & r, int bufferSize)
+{
+    // pick up a new speaker layout, unless it is being written
+    if (m_speakerMutex.try_lock())
+    {
+        if (m_speakersChanged)
+        {
+            m_renderSpeakers = m_speakers;
+            m_speakersChanged = false;
+            m_decodedOrder = -1;
+        }
+        m_speakerMutex.unlock();
+    }
+
+    const int order = this->order();
+    const DecoderMode mode = decoderMode() == SPEAKERS ? SPEAKERS : BINAURAL;
+
+    // A change of channels takes effect from the next quantum
+    const int outputChannels = mode == BINAURAL ? 2 : static_cast<int>(m_renderSpeakers.size());
+    if (output(0)->numberOfChannels() != outputChannels)
+        output(0)->setNumberOfChannels(r, outputChannels);
+
+    AudioBus * destination = output(0)->bus(r);
+    destination->zero();
+
+    if (!isInitialized() || !input(0)->isConnected() || destination->numberOfChannels() != outputChannels)
+        return;
+
+    AudioBus * source = input(0)->bus(r);
+    if (!source)
+        return;
+
+    HRTFDatabase * database = nullptr;
+    if (mode == BINAURAL)
+    {
+        std::shared_ptr<HRTFDatabaseLoader> loader = r.context()->hrtfDatabaseLoader();
+        if (!loader)
+            return;
+
+        if (!loader->isLoaded())
+        {
+            // as a PannerNode, an offline context waits for the database, and a realtime one is silent
+            if (!r.context()->isOfflineContext())
+                return;
+            loader->waitForLoaderThreadCompletion();
+        }
+
+        database = loader->database();
+        if (!database)
+            return;
+    }
+    HRTFDatabase::Reading reading(database);
+
+    if (order != m_decodedOrder || mode != m_decodedMode)
+        updateDecoder(order, mode);
+
+    // A silent field is skipped once the virtual speakers have rung out
+    const int releaseFrames = mode == BINAURAL ? HRTFPanner::fftSizeForSampleRate(m_sampleRate) + static_cast<int>(ceil(MaxDelayTimeSeconds * m_sampleRate)) : 0;
+    if (source->isSilent())
+    {
+        m_silentFrames += bufferSize;
+        if (m_silentFrames > releaseFrames)
+            return;
+    }
+    else
+        m_silentFrames = 0;
+
+    if (!m_field || m_field->length() < bufferSize)
+    {
+        m_field.reset(new AudioBus(MaxAmbisonicChannels, bufferSize));
+        m_feed.allocate(bufferSize);
+        m_tempL.allocate(bufferSize);
+        m_tempR.allocate(bufferSize);
+    }
+
+    // Turn the field to the listener's orientation
+    auto listener = r.context()->listener();
+    const FloatPoint3D listenerForward = {listener->forwardX()->value(), listener->forwardY()->value(), listener->forwardZ()->value()};
+    const FloatPoint3D listenerUp = {listener->upX()->value(), listener->upY()->value(), listener->upZ()->value()};
+    m_rotation->setListenerOrientation(listenerForward, listenerUp);
+    m_rotation->process(order, *source, *m_field, bufferSize);
+
+    const int channels = ambisonicChannelCount(order);
+    const int outputs = static_cast<int>(m_decoder.size()) / channels;
+
+    if (mode == SPEAKERS)
+    {
+        for (int s = 0; s < outputs && s < outputChannels; ++s)
+        {
+            float * dst = destination->channel(s)->mutableData();
+            for (int k = 0; k < channels; ++k)
+            {
+                const float gain = static_cast<float>(m_decoder[s * channels + k]);
+                if (gain != 0.f)
+                    vsma(m_field->channel(k)->data(), 1, &gain, dst, 1, bufferSize);
+            }
+        }
+        return;
+    }
+
+    float * destinationL = destination->channel(0)->mutableData();
+    float * destinationR = destination->channel(1)->mutableData();
+    float * feed = m_feed.data();
+    float * tempL = m_tempL.data();
+    float * tempR = m_tempR.data();
+
+    for (int s = 0; s < outputs && s < static_cast<int>(m_virtualSpeakers.size()); ++s)
+    {
+        VirtualSpeaker & speaker = *m_virtualSpeakers[s];
+
+        const float w = static_cast<float>(m_decoder[s * channels]);
+        vsmul(m_field->channel(0)->data(), 1, &w, feed, 1, bufferSize);
+        for (int k = 1; k < channels; ++k)
+        {
+            const float gain = static_cast<float>(m_decoder[s * channels + k]);
+            if (gain != 0.f)
+                vsma(m_field->channel(k)->data(), 1, &gain, feed, 1, bufferSize);
+        }
+
+        HRTFKernel * kernelL;
+        HRTFKernel * kernelR;
+        double frameDelayL;
+        double frameDelayR;
+        database->getKernelsFromAzimuthElevation(0, speaker.azimuthIndex, speaker.elevation, kernelL, kernelR, frameDelayL, frameDelayR);
+
+        // First run through delay lines for inter-aural time difference.
+        speaker.delayL.setDelayFrames(frameDelayL);
+        speaker.delayR.setDelayFrames(frameDelayR);
+        speaker.delayL.process(r, feed, tempL, bufferSize);
+        speaker.delayR.process(r, feed, tempR, bufferSize);
+
+        speaker.convolverL.process(kernelL->realData(), kernelL->imagData(), tempL, tempL, bufferSize);
+        speaker.convolverR.process(kernelR->realData(), kernelR->imagData(), tempR, tempR, bufferSize);
+
+        vadd(destinationL, 1, tempL, 1, destinationL, 1, bufferSize);
+        vadd(destinationR, 1, tempR, 1, destinationR, 1, bufferSize);
+    }
+}
+
+void AmbisonicDecoderNode::reset(ContextRenderLock &)
+{
+    m_rotation->reset();
+    for (auto & speaker : m_virtualSpeakers)
+        speaker->reset();
+    m_silentFrames = 0;
+}
+
+double AmbisonicDecoderNode::tailTime(ContextRenderLock & r) const
+{
+    if (decoderMode() != BINAURAL)
+        return 0;
+
+    // as an HRTFPanner's, the delay lines' and the convolvers' tails
+    return MaxDelayTimeSeconds + (HRTFPanner::fftSizeForSampleRate(m_sampleRate) / 2) / static_cast<double>(r.context()->sampleRate());
+}
+
+double AmbisonicDecoderNode::latencyTime(ContextRenderLock & r) const
+{
+    if (decoderMode() != BINAURAL)
+        return 0;
+
+    return (HRTFPanner::fftSizeForSampleRate(m_sampleRate) / 2) / static_cast<double>(r.context()->sampleRate());
+}
+
+}  // namespace lab
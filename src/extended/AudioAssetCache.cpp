@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/AudioAssetCache.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/MemoryAccounting.h"
+#include "LabSound/extended/AudioFileReader.h"
+#include "LabSound/extended/Logging.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace lab
+{
+
+namespace
+{
+    // A converted asset on disk is laid out as
+    //
+    //     DiskHeader
+    //     the asset's key, of keyLength bytes
+    //     each channel's samples in turn, as 32 bit floats
+    //
+    // in the byte order of the machine that wrote it. The key is checked on reading, so that
+    // a file whose name collides with another asset's is not taken for it.
+    const char DiskMagic[4] = {'L', 'S', 'P', 'C'};
+    const uint32_t DiskVersion = 1;
+
+    struct DiskHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t channels;
+        uint32_t length;
+        float sampleRate;
+        uint32_t keyLength;
+    };
+
+    // identifies the file as it is now, and the form it was asked for in; empty if the
+    // file can't be found
+    std::string assetKey(const std::string & path, bool mixToMono, float targetSampleRate)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return {};
+
+        char suffix[96];
+        snprintf(suffix, sizeof(suffix), "|%lld|%lld|%d|%g",
+                 (long long) st.st_size, (long long) st.st_mtime, mixToMono ? 1 : 0, (double) targetSampleRate);
+        return path + suffix;
+    }
+
+    std::string diskPath(const std::string & directory, const std::string & key)
+    {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : key)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.lspcm", (unsigned long long) hash);
+        return directory + "/" + name;
+    }
+
+    std::shared_ptr<AudioBus> readDisk(const std::string & path, const std::string & key)
+    {
+        FILE * file = fopen(path.c_str(), "rb");
+        if (!file)
+            return nullptr;
+
+        std::shared_ptr<AudioBus> bus;
+        DiskHeader header;
+        std::string storedKey;
+        if (fread(&header, sizeof(header), 1, file) == 1 && !memcmp(header.magic, DiskMagic, sizeof(DiskMagic)) &&
+            header.version == DiskVersion && header.keyLength == key.size() && header.channels > 0 && header.length > 0)
+        {
+            storedKey.resize(header.keyLength);
+            if (fread(&storedKey[0], 1, storedKey.size(), file) == storedKey.size() && storedKey == key)
+            {
+                bus = std::make_shared<AudioBus>(static_cast<int>(header.channels), static_cast<int>(header.length));
+                for (int c = 0; bus && c < static_cast<int>(header.channels); ++c)
+                    if (fread(bus->channel(c)->mutableData(), sizeof(float), header.length, file) != header.length)
+                        bus.reset();
+                if (bus)
+                {
+                    bus->setSampleRate(header.sampleRate);
+                    bus->clearSilentFlag();
+                }
+            }
+        }
+        fclose(file);
+        return bus;
+    }
+
+    void writeDisk(const std::string & path, const std::string & key, const AudioBus & bus)
+    {
+        // written under another name, and renamed once complete, so that a reader never
+        // finds a partial file
+        const std::string partial = path + ".partial";
+        FILE * file = fopen(partial.c_str(), "wb");
+        if (!file)
+        {
+            LOG_WARN("AudioAssetCache: could not write %s", partial.c_str());
+            return;
+        }
+
+        DiskHeader header;
+        memcpy(header.magic, DiskMagic, sizeof(DiskMagic));
+        header.version = DiskVersion;
+        header.channels = static_cast<uint32_t>(bus.numberOfChannels());
+        header.length = static_cast<uint32_t>(bus.length());
+        header.sampleRate = bus.sampleRate();
+        header.keyLength = static_cast<uint32_t>(key.size());
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(key.data(), 1, key.size(), file) == key.size();
+        for (int c = 0; ok && c < bus.numberOfChannels(); ++c)
+            ok = fwrite(bus.channel(c)->data(), sizeof(float), header.length, file) == header.length;
+        ok = fclose(file) == 0 && ok;
+
+        remove(path.c_str());
+        if (!ok || rename(partial.c_str(), path.c_str()) != 0)
+        {
+            LOG_WARN("AudioAssetCache: could not write %s", path.c_str());
+            remove(partial.c_str());
+        }
+    }
+}
+
+AudioAssetCache::AudioAssetCache()
+    : AudioAssetCache(Settings())
+{
+}
+
+AudioAssetCache::AudioAssetCache(const Settings & settings)
+    : m_settings(settings)
+{
+}
+
+AudioAssetCache::~AudioAssetCache() = default;
+
+std::shared_ptr<const AudioBus> AudioAssetCache::get(const std::string & path, bool mixToMono, float targetSampleRate)
+{
+    return acquire(path, mixToMono, targetSampleRate, false);
+}
+
+std::shared_ptr<const AudioBus> AudioAssetCache::pin(const std::string & path, bool mixToMono, float targetSampleRate)
+{
+    return acquire(path, mixToMono, targetSampleRate, true);
+}
+
+std::shared_ptr<const AudioBus> AudioAssetCache::acquire(const std::string & path, bool mixToMono, float targetSampleRate, bool pinned)
+{
+    const std::string key = assetKey(path, mixToMono, targetSampleRate);
+    if (key.empty())
+        return nullptr;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto found = m_index.find(key);
+    if (found != m_index.end())
+    {
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        if (pinned)
+            ++found->second->pins;
+        ++m_stats.hits;
+        std::shared_future<std::shared_ptr<const AudioBus>> bus = found->second->bus;
+        lock.unlock();
+        return bus.get();  // waits, if another request is decoding it
+    }
+
+    ++m_stats.misses;
+    std::promise<std::shared_ptr<const AudioBus>> promise;
+    Entry entry;
+    entry.key = key;
+    entry.id = m_nextId++;
+    entry.bus = promise.get_future().share();
+    entry.pins = pinned ? 1 : 0;
+    const uint64_t id = entry.id;
+    m_entries.push_front(std::move(entry));
+    m_index[key] = m_entries.begin();
+    lock.unlock();
+
+    std::shared_ptr<const AudioBus> bus;
+    try
+    {
+        bus = load(path, key, mixToMono, targetSampleRate);
+    }
+    catch (...)
+    {
+        bus.reset();
+    }
+    promise.set_value(bus);
+
+    lock.lock();
+    found = m_index.find(key);
+    if (found != m_index.end() && found->second->id == id)
+    {
+        if (bus)
+        {
+            found->second->ready = true;
+            found->second->bytes = sizeof(float) * static_cast<size_t>(bus->numberOfChannels()) * static_cast<size_t>(bus->length());
+            m_stats.memoryUsed += found->second->bytes;
+            ++m_stats.assets;
+            trim();
+        }
+        else
+        {
+            // a failure isn't remembered, so that the file is tried again next time
+            m_entries.erase(found->second);
+            m_index.erase(found);
+        }
+    }
+    return bus;
+}
+
+std::shared_ptr<const AudioBus> AudioAssetCache::load(const std::string & path, const std::string & key, bool mixToMono, float targetSampleRate)
+{
+    std::shared_ptr<MemoryOwner> asset = MemoryAccounting::createOwner(MemoryCategory::Asset, path);
+    MemoryOwnerScope memoryScope(asset);
+
+    std::string cached;
+    if (!m_settings.diskCachePath.empty())
+    {
+        cached = diskPath(m_settings.diskCachePath, key);
+        if (std::shared_ptr<AudioBus> bus = readDisk(cached, key))
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.diskHits;
+            return bus;
+        }
+    }
+
+    std::shared_ptr<AudioBus> bus = targetSampleRate > 0 ? MakeBusFromFile(path, mixToMono, targetSampleRate) : MakeBusFromFile(path, mixToMono);
+    if (!bus)
+    {
+        LOG_ERROR("AudioAssetCache: could not decode %s", path.c_str());
+        return nullptr;
+    }
+
+    if (!cached.empty())
+        writeDisk(cached, key, *bus);
+    return bus;
+}
+
+void AudioAssetCache::unpin(const std::string & path, bool mixToMono, float targetSampleRate)
+{
+    const std::string key = assetKey(path, mixToMono, targetSampleRate);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_index.find(key);
+    if (found != m_index.end() && found->second->pins > 0)
+    {
+        --found->second->pins;
+        trim();
+    }
+}
+
+void AudioAssetCache::evict(const std::string & path, bool mixToMono, float targetSampleRate)
+{
+    const std::string key = assetKey(path, mixToMono, targetSampleRate);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_index.find(key);
+    if (found == m_index.end())
+        return;
+
+    if (found->second->ready)
+    {
+        m_stats.memoryUsed -= found->second->bytes;
+        --m_stats.assets;
+    }
+    ++m_stats.evictions;
+    m_entries.erase(found->second);
+    m_index.erase(found);
+}
+
+void AudioAssetCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.evictions += m_stats.assets;
+    m_entries.clear();
+    m_index.clear();
+    m_stats.memoryUsed = 0;
+    m_stats.assets = 0;
+}
+
+void AudioAssetCache::setMemoryBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_settings.memoryBudget = bytes;
+    trim();
+}
+
+size_t AudioAssetCache::memoryBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_settings.memoryBudget;
+}
+
+AudioAssetCache::Stats AudioAssetCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void AudioAssetCache::trim()
+{
+    auto it = m_entries.end();
+    while (m_stats.memoryUsed > m_settings.memoryBudget && it != m_entries.begin())
+    {
+        --it;
+        if (!it->ready || it->pins > 0)
+            continue;
+
+        m_stats.memoryUsed -= it->bytes;
+        --m_stats.assets;
+        ++m_stats.evictions;
+        m_index.erase(it->key);
+        it = m_entries.erase(it);
+    }
+}
+
+}  // lab
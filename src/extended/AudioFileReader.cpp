@@ -5,12 +5,16 @@
 
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/Macros.h"
+#include "LabSound/core/MemoryAccounting.h"
 #include "LabSound/core/Mixing.h"
+#include "LabSound/core/RenderTrace.h"
 
 #include "LabSound/extended/AudioFileReader.h"
+#include "LabSound/extended/JobSystem.h"
 
 #include "libnyquist/Decoders.h"
 
+#include <algorithm>
 #include <cstring>
 #include <mutex>
 
@@ -64,24 +68,16 @@ std::shared_ptr<lab::AudioBus> LoadInternal(nqr::AudioData * audioData, bool mix
 
     return audioBus;
 }
-}
 
-namespace lab
+std::shared_ptr<lab::AudioBus> LoadFile(nqr::NyquistIO & io, const char * filePath, bool mixToMono)
 {
-
-nqr::NyquistIO nyquist_io;
-std::mutex g_fileIOMutex;
-
-std::shared_ptr<AudioBus> MakeBusFromFile(const char * filePath, bool mixToMono)
-{
-    std::lock_guard<std::mutex> lock(g_fileIOMutex);
     nqr::AudioData * audioData = new nqr::AudioData();
     try
     {
         FILE* test = fopen(filePath, "rb");
         if (test) {
             fclose(test);
-            nyquist_io.Load(audioData, std::string(filePath));
+            io.Load(audioData, std::string(filePath));
             printf("Loaded %s\n", filePath);
         }
         else {
@@ -94,10 +90,55 @@ std::shared_ptr<AudioBus> MakeBusFromFile(const char * filePath, bool mixToMono)
     {
         // use empty pointer as load failure sentinel
         /// @TODO report loading error
+        delete audioData;
         return {};
     }
 
-    return detail::LoadInternal(audioData, mixToMono);
+    return LoadInternal(audioData, mixToMono);
+}
+
+std::shared_ptr<lab::AudioBus> LoadMemory(nqr::NyquistIO & io, const std::vector<uint8_t> & buffer, const std::string & extension, bool mixToMono)
+{
+    nqr::AudioData * audioData = new nqr::AudioData();
+    try
+    {
+        if (extension.empty())
+            io.Load(audioData, buffer);
+        else
+            io.Load(audioData, extension, buffer);
+    }
+    catch (...)
+    {
+        delete audioData;
+        return {};
+    }
+
+    return LoadInternal(audioData, mixToMono);
+}
+}
+
+namespace lab
+{
+
+nqr::NyquistIO nyquist_io;
+std::mutex g_fileIOMutex;
+
+namespace
+{
+    // a decoded file is charged to an asset owner named for it, unless the caller has scoped another
+    std::shared_ptr<MemoryOwner> assetOwner(const char * name)
+    {
+        return MemoryAccounting::current() ? nullptr : MemoryAccounting::createOwner(MemoryCategory::Asset, name);
+    }
+}
+
+std::shared_ptr<AudioBus> MakeBusFromFile(const char * filePath, bool mixToMono)
+{
+    std::shared_ptr<MemoryOwner> asset = assetOwner(filePath);
+    MemoryOwnerScope memoryScope(asset ? asset.get() : MemoryAccounting::current());
+    std::lock_guard<std::mutex> lock(g_fileIOMutex);
+    TraceScope trace("decode", "io");
+    return detail::LoadFile(nyquist_io, filePath, mixToMono);
 }
 
 std::shared_ptr<AudioBus> MakeBusFromFile(const std::string & path, bool mixToMono)
@@ -107,6 +148,8 @@ std::shared_ptr<AudioBus> MakeBusFromFile(const std::string & path, bool mixToMo
 
 std::shared_ptr<AudioBus> MakeBusFromFile(const char * filePath, bool mixToMono, float targetSampleRate)
 {
+    std::shared_ptr<MemoryOwner> asset = assetOwner(filePath);
+    MemoryOwnerScope memoryScope(asset ? asset.get() : MemoryAccounting::current());
     auto bus = MakeBusFromFile(filePath, false);
     if (bus)
     {
@@ -123,6 +166,8 @@ std::shared_ptr<AudioBus> MakeBusFromFile(const std::string & path, bool mixToMo
 
 std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer, bool mixToMono)
 {
+    std::shared_ptr<MemoryOwner> asset = assetOwner("decoded from memory");
+    MemoryOwnerScope memoryScope(asset ? asset.get() : MemoryAccounting::current());
     std::lock_guard<std::mutex> lock(g_fileIOMutex);
     nqr::AudioData * audioData = new nqr::AudioData();
     nyquist_io.Load(audioData, buffer);
@@ -131,10 +176,157 @@ std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer,
 
 std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer, const std::string & extension, bool mixToMono)
 {
+    std::shared_ptr<MemoryOwner> asset = assetOwner("decoded from memory");
+    MemoryOwnerScope memoryScope(asset ? asset.get() : MemoryAccounting::current());
     std::lock_guard<std::mutex> lock(g_fileIOMutex);
     nqr::AudioData * audioData = new nqr::AudioData();
     nyquist_io.Load(audioData, extension, buffer);
     return detail::LoadInternal(audioData, mixToMono);
 }
 
+
+/////////////////////////
+//   AudioFileLoader   //
+/////////////////////////
+
+struct AudioFileLoader::Request
+{
+    uint64_t id = 0;
+    std::string path;
+    std::vector<uint8_t> buffer;
+    std::string extension;
+    bool fromMemory = false;
+    bool mixToMono = false;
+    float targetSampleRate = 0.f;
+    std::promise<std::shared_ptr<AudioBus>> promise;
+    Callback onLoaded;
+
+    void complete(std::shared_ptr<AudioBus> bus)
+    {
+        promise.set_value(bus);
+        if (onLoaded)
+            onLoaded(bus);
+    }
+};
+
+AudioFileLoader::AudioFileLoader(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = JobSystem::shared().workerCount();
+    m_threadCount = std::max(1, threadCount);
+}
+
+AudioFileLoader::~AudioFileLoader()
+{
+    cancelAll();
+    JobSystem::shared().wait([this]() { return m_jobs.load(std::memory_order_acquire) == 0; }, JobPriority::Normal);
+}
+
+AudioFileLoader::Load AudioFileLoader::load(const std::string & path, bool mixToMono, float targetSampleRate,
+                                            int priority, Callback onLoaded)
+{
+    std::unique_ptr<Request> request(new Request());
+    request->path = path;
+    request->mixToMono = mixToMono;
+    request->targetSampleRate = targetSampleRate;
+    request->onLoaded = std::move(onLoaded);
+    return enqueue(std::move(request), priority);
+}
+
+AudioFileLoader::Load AudioFileLoader::load(std::vector<uint8_t> buffer, const std::string & extension, bool mixToMono,
+                                            float targetSampleRate, int priority, Callback onLoaded)
+{
+    std::unique_ptr<Request> request(new Request());
+    request->buffer = std::move(buffer);
+    request->extension = extension;
+    request->fromMemory = true;
+    request->mixToMono = mixToMono;
+    request->targetSampleRate = targetSampleRate;
+    request->onLoaded = std::move(onLoaded);
+    return enqueue(std::move(request), priority);
+}
+
+AudioFileLoader::Load AudioFileLoader::enqueue(std::unique_ptr<Request> request, int priority)
+{
+    Load load;
+    load.bus = request->promise.get_future().share();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        load.id = request->id = m_nextId++;
+        m_queue[std::make_pair(-priority, load.id)] = std::move(request);
+
+        // the requests are taken in order by the jobs, however many there are
+        if (m_jobs.load(std::memory_order_relaxed) >= m_threadCount)
+            return load;
+        m_jobs.fetch_add(1, std::memory_order_relaxed);
+    }
+    JobSystem::shared().submit([this]() { decodeJob(); }, JobPriority::Normal);
+    return load;
+}
+
+bool AudioFileLoader::cancel(uint64_t id)
+{
+    std::unique_ptr<Request> request;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find_if(m_queue.begin(), m_queue.end(), [id](const auto & entry) { return entry.first.second == id; });
+        if (it == m_queue.end())
+            return false;
+        request = std::move(it->second);
+        m_queue.erase(it);
+    }
+    request->complete({});
+    return true;
+}
+
+void AudioFileLoader::cancelAll()
+{
+    std::map<std::pair<int, uint64_t>, std::unique_ptr<Request>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        cancelled.swap(m_queue);
+    }
+    for (auto & entry : cancelled)
+        entry.second->complete({});
+}
+
+size_t AudioFileLoader::queued() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+void AudioFileLoader::decodeJob()
+{
+    // each job system thread has its own decoders, so that decodes run in parallel
+    static thread_local nqr::NyquistIO io;
+
+    for (;;)
+    {
+        std::unique_ptr<Request> request;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queue.empty())
+            {
+                // the job's last act, as the loader may be destroyed once there are none
+                m_jobs.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+            request = std::move(m_queue.begin()->second);
+            m_queue.erase(m_queue.begin());
+        }
+
+        std::shared_ptr<AudioBus> bus;
+        if (request->fromMemory)
+            bus = detail::LoadMemory(io, request->buffer, request->extension, request->targetSampleRate > 0 ? false : request->mixToMono);
+        else
+            bus = detail::LoadFile(io, request->path.c_str(), request->targetSampleRate > 0 ? false : request->mixToMono);
+
+        if (bus && request->targetSampleRate > 0)
+            bus = AudioBus::createBySampleRateConverting(bus.get(), request->mixToMono, request->targetSampleRate);
+
+        request->complete(bus);
+    }
+}
+
 }  // end namespace lab
@@ -2,9 +2,11 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioProcessor.h"
+#include "LabSound/core/ModulationBus.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/BPMDelayNode.h"
@@ -80,6 +82,20 @@ BPMDelay::~BPMDelay()
 {
 }
 
+void BPMDelay::process(ContextRenderLock & r, int bufferSize)
+{
+    if (syncToContext && r.context())
+    {
+        const float contextTempo = r.context()->modulation()->tempo();
+        if (contextTempo != tempo)
+        {
+            tempo = contextTempo;
+            recomputeDelay();
+        }
+    }
+    DelayNode::process(r, bufferSize);
+}
+
 void BPMDelay::SetDelayIndex(TempoSync value)
 {
     if (value >= TempoSync::TS_32 && value <= TempoSync::TS_2D)
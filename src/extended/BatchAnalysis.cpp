@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/BatchAnalysis.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/WindowFunctions.h"
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/FFTFrame.h"
+#include "internal/FastMath.h"
+#include "internal/Lanes4.h"
+#include "internal/LoudnessMeter.h"
+#include "internal/PCMFileReader.h"
+
+#include "libnyquist/Decoders.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace detail
+{
+// in AudioFileReader.cpp
+std::shared_ptr<lab::AudioBus> LoadFile(nqr::NyquistIO & io, const char * filePath, bool mixToMono);
+}
+
+namespace lab
+{
+
+namespace
+{
+    // frames read from a streamed file at a time
+    const int ChunkFrames = 16384;
+
+    inline float decibels(double power)
+    {
+        return power > 0 ? static_cast<float>(10.0 * std::log10(power)) : -std::numeric_limits<float>::infinity();
+    }
+
+    // The measurements of one signal, to which its frames are added a chunk at a time
+    class Analyzer
+    {
+    public:
+        Analyzer(const BatchAnalysisSettings & settings, float sampleRate, int channels, int layout)
+            : m_settings(settings)
+            , m_sampleRate(sampleRate)
+            , m_channels(channels)
+        {
+            if (m_settings.loudness)
+            {
+                m_meter.reset(new LoudnessMeter());
+                m_meter->configure(sampleRate, std::min(channels, static_cast<int>(LoudnessMeter::MaxChannels)), layout);
+            }
+
+            int size = 32;
+            while (size < m_settings.fftSize && size < 32768)
+                size <<= 1;
+            m_settings.fftSize = size;
+            if (m_settings.spectrum)
+            {
+                m_fft.reset(new FFTFrame(size));
+                m_window = WindowFunctionTable(WindowFunction::blackman, size);
+                m_frame.assign(size, 0.f);
+            }
+        }
+
+        // Adds frames [offset, offset + count) of the bus
+        void add(const AudioBus & bus, int offset, int count)
+        {
+            for (int c = 0; c < m_channels; ++c)
+            {
+                const float * data = bus.channel(c)->data() + offset;
+                float squares = 0;
+                float peak = 0;
+                VectorMath::vsvesq(data, 1, &squares, count);
+                VectorMath::vmaxmgv(data, 1, &peak, count);
+                m_squares += squares;
+                m_peak = std::max(m_peak, peak);
+            }
+            m_frames += count;
+
+            for (int done = 0; m_meter && done < count;)
+            {
+                const int n = std::min(count - done, m_meter->blockFrames - m_meter->blockPosition);
+                m_meter->run(&bus, offset + done, n);
+                done += n;
+                if (m_meter->blockPosition == m_meter->blockFrames)
+                {
+                    float momentary, shortTerm, integrated, truePeak;
+                    m_meter->finishBlock(momentary, shortTerm, integrated, truePeak);
+                    m_maxMomentary = std::max(m_maxMomentary, momentary);
+                    m_maxShortTerm = std::max(m_maxShortTerm, shortTerm);
+                    m_integrated = integrated;
+                }
+            }
+
+            // the mean of the channels, an analysis frame at a time
+            const float scale = 1.f / m_channels;
+            for (int done = 0; m_fft && done < count;)
+            {
+                const int n = std::min(count - done, m_settings.fftSize - m_framePosition);
+                for (int c = 0; c < m_channels; ++c)
+                    VectorMath::vsma(bus.channel(c)->data() + offset + done, 1, &scale, m_frame.data() + m_framePosition, 1, n);
+                m_framePosition += n;
+                done += n;
+                if (m_framePosition == m_settings.fftSize)
+                    analyseFrame();
+            }
+        }
+
+        void finish(AnalysisRecord & record)
+        {
+            if (m_fft && m_framePosition > 0)
+            {
+                std::fill(m_frame.begin() + m_framePosition, m_frame.end(), 0.f);
+                analyseFrame();
+            }
+
+            record.sampleRate = m_sampleRate;
+            record.channels = m_channels;
+            record.frames = m_frames;
+            if (m_frames)
+                record.rms = decibels(m_squares / (static_cast<double>(m_frames) * m_channels));
+            record.samplePeak = decibels(static_cast<double>(m_peak) * m_peak);
+            if (m_meter)
+            {
+                record.truePeak = std::max(m_meter->truePeak(), record.samplePeak);
+                record.integratedLoudness = m_integrated;
+                record.maxMomentaryLoudness = m_maxMomentary;
+                record.maxShortTermLoudness = m_maxShortTerm;
+            }
+            if (m_spectralEnergy > 0)
+            {
+                const double centroid = m_weightedCentroid / m_spectralEnergy;
+                record.spectralCentroid = static_cast<float>(centroid);
+                record.spectralSpread = static_cast<float>(std::sqrt(std::max(0.0, m_weightedSpread / m_spectralEnergy)));
+                record.spectralFlatness = static_cast<float>(m_weightedFlatness / m_spectralEnergy);
+            }
+        }
+
+    private:
+        // The frame's power spectrum, and its moments and log mean, in one pass over the bins
+        void analyseFrame()
+        {
+            const int size = m_settings.fftSize;
+            m_framePosition = 0;
+            VectorMath::vmul(m_frame.data(), 1, m_window, 1, m_frame.data(), 1, size);
+            m_fft->computeForwardFFT(m_frame.data());
+            std::fill(m_frame.begin(), m_frame.end(), 0.f);
+
+            const float * realP = m_fft->realData();
+            float * imagP = m_fft->imagData();
+            imagP[0] = 0;  // the packed nyquist component, where there is one
+
+            const int bins = size / 2;
+            const float binHz = m_sampleRate / size;
+            const float lanes[4] = {0.f, binHz, 2.f * binHz, 3.f * binHz};
+            Lanes4 hz = Lanes4::load(lanes);
+            const Lanes4 step(4.f * binHz);
+            Lanes4 power(0.f), moment1(0.f), moment2(0.f), logs(0.f);
+            for (int k = 0; k < bins; k += 4)
+            {
+                const Lanes4 re = Lanes4::load(realP + k);
+                const Lanes4 im = Lanes4::load(imagP + k);
+                const Lanes4 p = re * re + im * im;
+                power = power + p;
+                moment1 = moment1 + p * hz;
+                moment2 = moment2 + p * hz * hz;
+                logs = logs + FastMath::log2(p + Lanes4(1e-20f));
+                hz = hz + step;
+            }
+
+            const double energy = power.sum();
+            if (energy <= 0)
+                return;
+            const double centroid = moment1.sum() / energy;
+            const double spread = moment2.sum() / energy - centroid * centroid;
+            const double flatness = std::exp2(logs.sum() / bins) / (energy / bins);
+
+            m_spectralEnergy += energy;
+            m_weightedCentroid += energy * centroid;
+            m_weightedSpread += energy * spread;
+            m_weightedFlatness += energy * std::min(1.0, flatness);
+        }
+
+        BatchAnalysisSettings m_settings;
+        float m_sampleRate;
+        int m_channels;
+
+        uint64_t m_frames = 0;
+        double m_squares = 0;
+        float m_peak = 0;
+
+        std::unique_ptr<LoudnessMeter> m_meter;
+        float m_integrated = -std::numeric_limits<float>::infinity();
+        float m_maxMomentary = -std::numeric_limits<float>::infinity();
+        float m_maxShortTerm = -std::numeric_limits<float>::infinity();
+
+        std::unique_ptr<FFTFrame> m_fft;
+        const float * m_window = nullptr;
+        std::vector<float> m_frame;
+        int m_framePosition = 0;
+        double m_spectralEnergy = 0;
+        double m_weightedCentroid = 0;
+        double m_weightedSpread = 0;
+        double m_weightedFlatness = 0;
+    };
+
+    // Streams an uncompressed WAV file through an analyzer; false if it isn't one
+    bool analyzeStream(const std::string & path, const BatchAnalysisSettings & settings, AnalysisRecord & record)
+    {
+        PCMFileReader reader;
+        if (!reader.open(path) || reader.channelCount() <= 0)
+            return false;
+
+        AudioBus chunk(reader.channelCount(), ChunkFrames);
+        std::vector<float *> planes(reader.channelCount());
+        for (int c = 0; c < reader.channelCount(); ++c)
+            planes[c] = chunk.channel(c)->mutableData();
+
+        Analyzer analyzer(settings, reader.sampleRate(), reader.channelCount(), chunk.layout());
+        for (uint64_t frame = 0; frame < reader.lengthInFrames();)
+        {
+            const int count = reader.read(frame, ChunkFrames, planes.data());
+            if (count <= 0)
+                break;
+            analyzer.add(chunk, 0, count);
+            frame += count;
+        }
+        analyzer.finish(record);
+        record.ok = true;
+        return true;
+    }
+}
+
+AnalysisRecord BatchAnalysis::analyzeBus(const AudioBus & bus, const BatchAnalysisSettings & settings)
+{
+    AnalysisRecord record;
+    if (bus.numberOfChannels() <= 0)
+        return record;
+
+    Analyzer analyzer(settings, bus.sampleRate(), bus.numberOfChannels(), bus.layout());
+    for (int offset = 0; offset < bus.length(); offset += ChunkFrames)
+        analyzer.add(bus, offset, std::min(ChunkFrames, bus.length() - offset));
+    analyzer.finish(record);
+    record.ok = true;
+    return record;
+}
+
+AnalysisRecord BatchAnalysis::analyzeFile(const std::string & path, const BatchAnalysisSettings & settings)
+{
+    AnalysisRecord record;
+    if (!analyzeStream(path, settings, record))
+    {
+        // each job system thread has its own decoders, so that decodes run in parallel
+        static thread_local nqr::NyquistIO io;
+        std::shared_ptr<AudioBus> bus = ::detail::LoadFile(io, path.c_str(), false);
+        if (bus)
+            record = analyzeBus(*bus, settings);
+        else
+            LOG_WARN("BatchAnalysis: could not read %s", path.c_str());
+    }
+    record.path = path;
+    return record;
+}
+
+std::vector<AnalysisRecord> BatchAnalysis::analyzeFiles(const std::vector<std::string> & paths,
+                                                        const BatchAnalysisSettings & settings, Callback onRecord)
+{
+    std::vector<AnalysisRecord> records(paths.size());
+    if (paths.empty())
+        return records;
+
+    // each job takes the next file until there are none, so that a few jobs, rather than a
+    // job per file, share out any number of files
+    struct Batch
+    {
+        std::atomic<size_t> next {0};
+        std::atomic<int> jobs {0};
+    } batch;
+
+    JobSystem & jobs = JobSystem::shared();
+    int threadCount = settings.threadCount > 0 ? settings.threadCount : jobs.workerCount();
+    threadCount = std::max(1, std::min(threadCount, static_cast<int>(paths.size())));
+    batch.jobs.store(threadCount, std::memory_order_relaxed);
+
+    for (int j = 0; j < threadCount; ++j)
+        jobs.submit([&]()
+        {
+            size_t i = batch.next.fetch_add(1, std::memory_order_relaxed);
+            while (i < paths.size())
+            {
+                records[i] = analyzeFile(paths[i], settings);
+                if (onRecord)
+                    onRecord(i, records[i]);
+                i = batch.next.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // the job's last act, as the batch is gone once there are none
+            batch.jobs.fetch_sub(1, std::memory_order_release);
+        }, JobPriority::Normal);
+
+    jobs.wait([&batch]() { return batch.jobs.load(std::memory_order_acquire) == 0; }, JobPriority::Normal);
+    return records;
+}
+
+}  // lab
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/BlockProcessorNode.h"
+#include "LabSound/extended/Registry.h"
+
+namespace lab
+{
+
+AudioNodeDescriptor * BlockProcessorNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 0};
+    return &d;
+}
+
+BlockProcessorNodeStorage::BlockProcessorNodeStorage(const std::vector<AudioParamDescriptor> & descriptors)
+{
+    for (const AudioParamDescriptor & p : descriptors)
+    {
+        names.emplace_back(p.name ? p.name : "");
+        const char * name = names.back().c_str();
+        names.emplace_back(p.shortName ? p.shortName : "");
+        const char * shortName = names.back().c_str();
+        params.push_back({name, shortName, p.defaultValue, p.minValue, p.maxValue});
+    }
+    params.push_back({nullptr, nullptr, 0, 0, 0});
+    descriptor.params = params.data();
+}
+
+BlockProcessorNode::BlockProcessorNode(AudioContext & ac)
+    : BlockProcessorNode(ac, Layout(), nullptr)
+{
+}
+
+BlockProcessorNode::BlockProcessorNode(AudioContext & ac, const Layout & layout, std::unique_ptr<BlockProcessor> processor)
+    : BlockProcessorNode(ac, layout)
+{
+    _processor = std::move(processor);
+    if (_processor)
+        _processor->prepare(_sampleRate, renderQuantumSize());
+}
+
+BlockProcessorNode::BlockProcessorNode(AudioContext & ac, const Layout & layout)
+    : BlockProcessorNodeStorage(layout.params)
+    , AudioNode(ac, descriptor)
+    , _sampleRate(ac.sampleRate())
+{
+    build(layout);
+    initialize();
+}
+
+BlockProcessorNode::~BlockProcessorNode()
+{
+    uninitialize();
+}
+
+void BlockProcessorNode::build(const Layout & layout)
+{
+    for (int i = 0; i < layout.inputs; ++i)
+        addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+    for (int channels : layout.outputChannels)
+        addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, channels > 0 ? channels : 1)));
+
+    const int frames = renderQuantumSize();
+    _inputBusses.resize(numberOfInputs());
+    _outputBusses.resize(numberOfOutputs());
+    _paramBlocks.resize(_self->_params.size());
+    _paramValues.resize(_self->_params.size() * frames);
+}
+
+void BlockProcessorNode::process(ContextRenderLock & r, int bufferSize)
+{
+    for (int i = 0; i < numberOfOutputs(); ++i)
+    {
+        _outputBusses[i] = output(i)->bus(r);
+        _outputBusses[i]->zero();
+    }
+
+    if (!_active)
+        return;
+
+    for (int i = 0; i < numberOfInputs(); ++i)
+        _inputBusses[i] = input(i)->bus(r);
+
+    const int params = static_cast<int>(_paramBlocks.size());
+    if (static_cast<int>(_paramValues.size()) < params * bufferSize)
+        _paramValues.resize(params * bufferSize);
+    for (int i = 0; i < params; ++i)
+        _paramBlocks[i] = _self->_params[i]->calculateSampleAccurateBlock(r, &_paramValues[i * bufferSize], bufferSize);
+
+    ProcessBlock block;
+    block.frames = bufferSize;
+    block.time = r.context()->currentTime();
+    block.sampleRate = r.context()->sampleRate();
+    block.numberOfInputs = numberOfInputs();
+    block.numberOfOutputs = numberOfOutputs();
+    block.numberOfParams = params;
+    block.inputs = _inputBusses.data();
+    block.outputs = _outputBusses.data();
+    block.params = _paramBlocks.data();
+
+    _active = processBlock(r, block);
+}
+
+bool BlockProcessorNode::processBlock(ContextRenderLock & r, const ProcessBlock & block)
+{
+    return _processor ? _processor->process(r, block) : false;
+}
+
+void BlockProcessorNode::resetBlock()
+{
+    if (_processor)
+        _processor->reset();
+}
+
+void BlockProcessorNode::reset(ContextRenderLock & r)
+{
+    resetBlock();
+}
+
+}  // namespace lab
@@ -2,6 +2,7 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioProcessor.h"
@@ -13,7 +14,13 @@
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/VectorMath.h"
 
+#include "internal/Oversampler.h"
+
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 using namespace lab;
@@ -36,7 +43,7 @@ static AudioSettingDescriptor s_cnSettings[] = {{"mode", "MODE", SettingType::En
 
 AudioNodeDescriptor * ClipNode::desc()
 {
-    static AudioNodeDescriptor d {s_cnParams, s_cnSettings, 0};
+    static AudioNodeDescriptor d {s_cnParams, s_cnSettings, 1};
     return &d;
 }
 
@@ -77,62 +84,75 @@ public:
 
         ClipNode::Mode clipMode = static_cast<ClipNode::Mode>(mode->valueUint32());
 
-        if (clipMode == ClipNode::TANH)
+        /// @fixme these values should be per sample, not per quantum
+        /// -or- they should be settings if they don't vary per sample
+        // in TANH mode a is the output gain and b the input gain, in CLIP mode they're the range
+        const float a = aVal->value();
+        const float b = bVal->value();
+        auto shaper = [clipMode, a, b](float * frames, int count)
         {
-            /// @fixme these values should be per sample, not per quantum
-            /// -or- they should be settings if they don't vary per sample
-            float outputGain = aVal->value();
-            float inputGain = bVal->value();
-
-            for (int channelIndex = 0; channelIndex < dstChannels; ++channelIndex)
+            if (clipMode == ClipNode::TANH)
             {
-                int srcIndex = srcChannels < channelIndex ? srcChannels : channelIndex;
-                float const * source = sourceBus->channel(srcIndex)->data();
-                float * destination = destinationBus->channel(channelIndex)->mutableData();
-                if (destination)
-                    for (int i = 0; i < framesToProcess; ++i)
-                    {
-                        *destination++ = outputGain * tanhf(inputGain * source[i]);
-                    }
+                VectorMath::vtanh(frames, b, frames, count);
+                if (a != 1.f)
+                    VectorMath::vsmul(frames, 1, &a, frames, 1, count);
             }
+            else
+                VectorMath::vclip(frames, 1, &a, &b, frames, 1, count);
+        };
+
+        const OverSampleType type = oversample;
+        const OverSampleQuality quality = oversampleQuality;
+        if (type == OverSampleType::NONE)
+            oversamplers.clear();
+        else if (oversamplers.size() != static_cast<size_t>(dstChannels) ||
+                 oversamplers[0]->type() != type || oversamplers[0]->quality() != quality)
+        {
+            // each channel has its own filter history
+            oversamplers.clear();
+            for (int i = 0; i < dstChannels; ++i)
+                oversamplers.emplace_back(new Oversampler(type, quality));
         }
-        else
+
+        for (int channelIndex = 0; channelIndex < dstChannels; ++channelIndex)
         {
-            /// @fixme these values should be per sample, not per quantum
-            /// -or- they should be settings if they don't vary per sample
-            float minf = aVal->value();
-            float maxf = bVal->value();
+            int srcIndex = srcChannels < channelIndex ? srcChannels : channelIndex;
+            float const * source = sourceBus->channel(srcIndex)->data();
+            float * destination = destinationBus->channel(channelIndex)->mutableData();
+            if (!destination)
+                continue;
 
-            for (int channelIndex = 0; channelIndex < dstChannels; ++channelIndex)
+            if (oversamplers.empty())
             {
-                int srcIndex = srcChannels < channelIndex ? srcChannels : channelIndex;
-                float const * source = sourceBus->channel(srcIndex)->data();
-                float * destination = destinationBus->channel(channelIndex)->mutableData();
-                if (destination)
-                    for (int i = 0; i < framesToProcess; ++i)
-                    {
-                        float d = source[i];
-
-                        if (d < minf)
-                            d = minf;
-                        else if (d > maxf)
-                            d = maxf;
-
-                        *destination++ = d;
-                    }
+                if (destination != source)
+                    memcpy(destination, source, sizeof(float) * framesToProcess);
+                shaper(destination, framesToProcess);
             }
+            else
+                oversamplers[channelIndex]->process(source, destination, framesToProcess, shaper);
         }
     }
 
-    virtual void reset() override {}
+    virtual void reset() override
+    {
+        for (auto & oversampler : oversamplers)
+            oversampler->reset();
+    }
 
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
-    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override
+    {
+        return Oversampler::latencyFrames(oversample, oversampleQuality) / r.context()->sampleRate();
+    }
 
     ClipNode * _owner = nullptr;
     std::shared_ptr<AudioParam> aVal;
     std::shared_ptr<AudioParam> bVal;
     std::shared_ptr<AudioSetting> mode;
+
+    std::atomic<OverSampleType> oversample{OverSampleType::NONE};
+    std::atomic<OverSampleQuality> oversampleQuality{OverSampleQuality::Medium};
+    std::vector<std::unique_ptr<Oversampler>> oversamplers;
 };
 
 /////////////////////
@@ -162,6 +182,28 @@ void ClipNode::setMode(Mode m)
     internalNode->mode->setUint32(uint32_t(m));
 }
 
+void ClipNode::setOversample(OverSampleType oversample)
+{
+    if (oversample < OverSampleType::NONE || oversample >= OverSampleType::_OverSampleTypeCount)
+        throw std::out_of_range("Invalid oversample type");
+    internalNode->oversample = oversample;
+}
+
+OverSampleType ClipNode::oversample() const
+{
+    return internalNode->oversample;
+}
+
+void ClipNode::setOversampleQuality(OverSampleQuality quality)
+{
+    internalNode->oversampleQuality = quality;
+}
+
+OverSampleQuality ClipNode::oversampleQuality() const
+{
+    return internalNode->oversampleQuality;
+}
+
 std::shared_ptr<AudioParam> ClipNode::aVal()
 {
     return internalNode->aVal;
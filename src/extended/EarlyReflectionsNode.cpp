@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/EarlyReflectionsNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioListener.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/PannerNode.h"
+#include "LabSound/core/SpatialScene.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "internal/EarlyReflections.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+// The delay lines reach images 170 metres away, past the second order images of a 50 metre hall
+static const double MaxReflectionDelay = 0.5;
+
+static AudioSettingDescriptor s_sDesc[] = {
+    {"order", "ORDR", SettingType::Integer},
+    nullptr};
+
+AudioNodeDescriptor * EarlyReflectionsNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_sDesc, 2};
+    return &d;
+}
+
+struct EarlyReflectionsNode::Source
+{
+    // written by any thread, read by the render thread
+    std::atomic<float> x {0.f};
+    std::atomic<float> y {0.f};
+    std::atomic<float> z {0.f};
+    std::shared_ptr<PannerNode> panner;  // atomically
+};
+
+EarlyReflectionsNode::EarlyReflectionsNode(AudioContext & ac, int numberOfInputs)
+    : AudioNode(ac, *desc())
+    , m_reflections(new EarlyReflections(ac.sampleRate(), MaxReflectionDelay))
+    , m_room(new ShoeboxRoom())
+{
+    m_order = setting("order");
+    m_order->setUint32(2, false);
+
+    publishRoom();
+    addInputs(numberOfInputs);
+
+    // every source is mixed down to mono before it is reflected
+    _self->m_channelCount = 1;
+    _self->m_channelCountMode = ChannelCountMode::Explicit;
+    _self->m_channelInterpretation = ChannelInterpretation::Speakers;
+
+    initialize();
+}
+
+EarlyReflectionsNode::~EarlyReflectionsNode()
+{
+    uninitialize();
+}
+
+void EarlyReflectionsNode::addInputs(int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+        m_sources.emplace_back(new Source());
+    }
+}
+
+void EarlyReflectionsNode::setPosition(int input, const FloatPoint3D & position)
+{
+    if (input < 0 || input >= static_cast<int>(m_sources.size()))
+        throw std::out_of_range("EarlyReflectionsNode has no such input");
+
+    Source & source = *m_sources[input];
+    source.x.store(position.x, std::memory_order_relaxed);
+    source.y.store(position.y, std::memory_order_relaxed);
+    source.z.store(position.z, std::memory_order_relaxed);
+    std::atomic_store(&source.panner, std::shared_ptr<PannerNode>());
+}
+
+FloatPoint3D EarlyReflectionsNode::position(int input) const
+{
+    if (input < 0 || input >= static_cast<int>(m_sources.size()))
+        throw std::out_of_range("EarlyReflectionsNode has no such input");
+
+    const Source & source = *m_sources[input];
+    return {source.x.load(std::memory_order_relaxed),
+            source.y.load(std::memory_order_relaxed),
+            source.z.load(std::memory_order_relaxed)};
+}
+
+void EarlyReflectionsNode::follow(int input, std::shared_ptr<PannerNode> panner)
+{
+    if (input < 0 || input >= static_cast<int>(m_sources.size()))
+        throw std::out_of_range("EarlyReflectionsNode has no such input");
+
+    std::atomic_store(&m_sources[input]->panner, std::move(panner));
+}
+
+void EarlyReflectionsNode::publishRoom()
+{
+    std::atomic_store(&m_renderingRoom, std::shared_ptr<const ShoeboxRoom>(std::make_shared<ShoeboxRoom>(*m_room)));
+}
+
+void EarlyReflectionsNode::setRoom(const FloatPoint3D & minimum, const FloatPoint3D & maximum)
+{
+    if (!(minimum.x < maximum.x && minimum.y < maximum.y && minimum.z < maximum.z))
+        throw std::invalid_argument("EarlyReflectionsNode's room must have a positive extent on every axis");
+
+    m_room->minimum = minimum;
+    m_room->maximum = maximum;
+    publishRoom();
+}
+
+void EarlyReflectionsNode::setAbsorption(float absorption)
+{
+    const float reflection = std::sqrt(1.f - std::min(std::max(absorption, 0.f), 1.f));
+    std::fill(m_room->reflection, m_room->reflection + 6, reflection);
+    publishRoom();
+}
+
+void EarlyReflectionsNode::setWallAbsorption(int wall, float absorption)
+{
+    if (wall < 0 || wall >= 6)
+        throw std::out_of_range("EarlyReflectionsNode's room has six walls");
+
+    m_room->reflection[wall] = std::sqrt(1.f - std::min(std::max(absorption, 0.f), 1.f));
+    publishRoom();
+}
+
+int EarlyReflectionsNode::order() const { return static_cast<int>(m_order->valueUint32()); }
+void EarlyReflectionsNode::setOrder(int order)
+{
+    m_order->setUint32(static_cast<uint32_t>(std::max(1, std::min(order, EarlyReflections::MaxOrder))));
+}
+
+void EarlyReflectionsNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * destination = output(0)->bus(r);
+    destination->zero();
+
+    if (!isInitialized() || destination->numberOfChannels() < 2)
+        return;
+
+    const int sources = std::min(numberOfInputs(), static_cast<int>(m_sources.size()));
+    if (m_reflections->sources() != sources)
+    {
+        m_reflections->setSources(sources);
+        m_positions.resize(sources);
+        m_inputs.resize(sources);
+    }
+
+    auto listener = r.context()->listener();
+    SpatialListener spatialListener;
+    spatialListener.position = {listener->positionX()->value(), listener->positionY()->value(), listener->positionZ()->value()};
+    spatialListener.forward = {listener->forwardX()->value(), listener->forwardY()->value(), listener->forwardZ()->value()};
+    spatialListener.up = {listener->upX()->value(), listener->upY()->value(), listener->upZ()->value()};
+
+    std::shared_ptr<SpatialScene> scene = r.context()->spatialScene();
+    for (int i = 0; i < sources; ++i)
+    {
+        Source & source = *m_sources[i];
+        auto in = input(i);
+        AudioBus * bus = in->isConnected() ? in->bus(r) : nullptr;
+        m_inputs[i] = bus && !bus->isSilent() ? bus->channel(0)->data() : nullptr;
+
+        std::shared_ptr<PannerNode> panner = std::atomic_load(&source.panner);
+        SpatialTransform transform;
+        if (!panner)
+            m_positions[i] = {source.x.load(std::memory_order_relaxed),
+                              source.y.load(std::memory_order_relaxed),
+                              source.z.load(std::memory_order_relaxed)};
+        else if (scene && scene->transform(panner.get(), panner->sceneSlot(), transform))
+            m_positions[i] = transform.position;
+        else
+            m_positions[i] = {panner->positionX()->value(), panner->positionY()->value(), panner->positionZ()->value()};
+    }
+
+    std::shared_ptr<const ShoeboxRoom> room = std::atomic_load(&m_renderingRoom);
+    m_reflections->process(*room, order(), spatialListener, m_positions.data(), m_inputs.data(),
+                           destination->channel(0)->mutableData(), destination->channel(1)->mutableData(), bufferSize);
+}
+
+void EarlyReflectionsNode::reset(ContextRenderLock &)
+{
+    m_reflections->reset();
+}
+
+double EarlyReflectionsNode::tailTime(ContextRenderLock & r) const
+{
+    return MaxReflectionDelay;
+}
+
+}  // namespace lab
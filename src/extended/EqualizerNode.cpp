@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioProcessor.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/EqualizerNode.h"
+#include "LabSound/extended/Registry.h"
+
+#include "internal/Biquad.h"
+#include "internal/BiquadBank.h"
+#include "internal/BiquadResponse.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+namespace lab
+{
+
+//////////////////////////////////////////
+// Private EqualizerNode Implementation //
+//////////////////////////////////////////
+
+AudioNodeDescriptor * EqualizerNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+namespace
+{
+    // Configures a biquad as one of the equalizer's bands
+    void designBand(Biquad & biquad, const EqualizerNode::Band & band, float sampleRate)
+    {
+        const double normalizedFrequency = band.frequency / (sampleRate * 0.5);
+
+        // clang-format off
+        switch (band.type)
+        {
+            case FilterType::LOWPASS:   biquad.setLowpassParams(normalizedFrequency, band.q);              break;
+            case FilterType::HIGHPASS:  biquad.setHighpassParams(normalizedFrequency, band.q);             break;
+            case FilterType::BANDPASS:  biquad.setBandpassParams(normalizedFrequency, band.q);             break;
+            case FilterType::LOWSHELF:  biquad.setLowShelfParams(normalizedFrequency, band.gain);          break;
+            case FilterType::HIGHSHELF: biquad.setHighShelfParams(normalizedFrequency, band.gain);         break;
+            case FilterType::PEAKING:   biquad.setPeakingParams(normalizedFrequency, band.q, band.gain);   break;
+            case FilterType::NOTCH:     biquad.setNotchParams(normalizedFrequency, band.q);                break;
+            case FilterType::ALLPASS:   biquad.setAllpassParams(normalizedFrequency, band.q);              break;
+            default:                    biquad.setZeroPolePairs(0, 0);                                     break;
+        }
+        // clang-format on
+    }
+
+    // Moves value toward target as AudioParam smooths, and returns true once they meet
+    bool smooth(float & value, float target)
+    {
+        value += static_cast<float>((target - value) * AudioParam::DefaultSmoothingConstant);
+        if (std::fabs(value - target) < AudioParam::SnapThreshold)
+            value = target;
+        return value == target;
+    }
+}
+
+class EqualizerNode::EqualizerNodeInternal : public lab::AudioProcessor
+{
+public:
+    EqualizerNodeInternal(float sampleRate)
+        : AudioProcessor()
+        , sampleRate(sampleRate)
+    {
+        bank.setNumberOfSections(0);
+    }
+
+    virtual ~EqualizerNodeInternal() {}
+
+    virtual void initialize() override {}
+    virtual void uninitialize() override {}
+
+    virtual void process(ContextRenderLock & r,
+                         const lab::AudioBus * sourceBus, lab::AudioBus * destinationBus,
+                         int framesToProcess) override
+    {
+        // pick up new bands, if the main thread isn't in the middle of changing them
+        std::unique_lock<std::mutex> lock(bandMutex, std::try_to_lock);
+        if (lock.owns_lock() && bandsChanged)
+        {
+            if (targets.size() != bands.size())
+            {
+                // the cascade is rebuilt from rest, with no smoothing
+                bank.setNumberOfSections(static_cast<int>(bands.size()));
+                current = bands;
+                isFirstRender = true;
+            }
+            targets = bands;
+            bandsChanged = false;
+        }
+        if (lock.owns_lock())
+            lock.unlock();
+
+        updateSections();
+
+        const int channels = std::min(sourceBus->numberOfChannels(), destinationBus->numberOfChannels());
+        if (static_cast<int>(sources.size()) < channels)
+        {
+            sources.resize(channels);
+            destinations.resize(channels);
+        }
+        for (int i = 0; i < channels; ++i)
+        {
+            sources[i] = sourceBus->channel(i)->data();
+            destinations[i] = destinationBus->channel(i)->mutableData();
+        }
+
+        if (bank.numberOfSections())
+        {
+            bank.process(sources.data(), destinations.data(), channels, framesToProcess);
+        }
+        else
+        {
+            for (int i = 0; i < channels; ++i)
+                if (sources[i] != destinations[i])
+                    std::copy(sources[i], sources[i] + framesToProcess, destinations[i]);
+        }
+
+        for (int i = channels; i < destinationBus->numberOfChannels(); ++i)
+            destinationBus->channel(i)->zero();
+    }
+
+    // Smooths the bands toward their targets, and redesigns those that moved
+    void updateSections()
+    {
+        Biquad design;
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            Band & band = current[i];
+            const Band & target = targets[i];
+            bool stable = true;
+            if (isFirstRender || band.type != target.type)
+            {
+                band = target;
+                stable = false;
+            }
+            else
+            {
+                stable &= smooth(band.frequency, target.frequency);
+                stable &= smooth(band.q, target.q);
+                stable &= smooth(band.gain, target.gain);
+            }
+
+            if (!stable || isFirstRender)
+            {
+                designBand(design, band, sampleRate);
+                bank.setSection(static_cast<int>(i), design);
+            }
+        }
+        isFirstRender = false;
+    }
+
+    virtual void reset() override
+    {
+        bank.reset();
+        isFirstRender = true;
+    }
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    const float sampleRate;
+
+    // staged by the main thread
+    mutable std::mutex bandMutex;
+    std::vector<Band> bands;
+    bool bandsChanged = false;
+
+    // render thread state
+    std::vector<Band> targets;
+    std::vector<Band> current;
+    bool isFirstRender = true;
+    BiquadBank bank;
+    std::vector<const float *> sources;
+    std::vector<float *> destinations;
+
+    // the response last drawn, for the bands it was designed for
+    std::mutex responseMutex;
+    BiquadResponse response;
+    std::vector<float> responseFrequencies;
+    std::vector<Band> responseBands;
+    std::vector<double> responseCoefficients;
+};
+
+//////////////////////////
+// Public EqualizerNode //
+//////////////////////////
+
+EqualizerNode::EqualizerNode(AudioContext & ac)
+    : lab::AudioBasicProcessorNode(ac, *desc())
+{
+    internalNode = new EqualizerNodeInternal(ac.sampleRate());
+    m_processor.reset(internalNode);
+    initialize();
+}
+
+EqualizerNode::~EqualizerNode()
+{
+    uninitialize();
+}
+
+void EqualizerNode::setBands(const std::vector<Band> & bands)
+{
+    std::lock_guard<std::mutex> lock(internalNode->bandMutex);
+    internalNode->bands = bands;
+    internalNode->bandsChanged = true;
+}
+
+std::vector<EqualizerNode::Band> EqualizerNode::bands() const
+{
+    std::lock_guard<std::mutex> lock(internalNode->bandMutex);
+    return internalNode->bands;
+}
+
+void EqualizerNode::setBand(int index, const Band & band)
+{
+    std::lock_guard<std::mutex> lock(internalNode->bandMutex);
+    if (index < 0 || index >= static_cast<int>(internalNode->bands.size()))
+        throw std::out_of_range("EqualizerNode band index out of range");
+    internalNode->bands[index] = band;
+    internalNode->bandsChanged = true;
+}
+
+void EqualizerNode::getFrequencyResponse(const std::vector<float> & frequencyHz, std::vector<float> & magResponse, std::vector<float> & phaseResponse) const
+{
+    const size_t n = std::min(frequencyHz.size(), std::min(magResponse.size(), phaseResponse.size()));
+    if (!n)
+        return;
+
+    EqualizerNodeInternal & node = *internalNode;
+    std::lock_guard<std::mutex> lock(node.responseMutex);
+
+    const float nyquist = node.sampleRate * 0.5f;
+    node.responseFrequencies.resize(n);
+    for (size_t k = 0; k < n; ++k)
+        node.responseFrequencies[k] = frequencyHz[k] / nyquist;
+    node.response.setFrequencies(node.responseFrequencies.data(), static_cast<int>(n));
+
+    // the bands are only designed again once they have changed
+    const std::vector<Band> current = bands();
+    const bool changed = current.size() != node.responseBands.size() ||
+        !std::equal(current.begin(), current.end(), node.responseBands.begin(), [](const Band & a, const Band & b) {
+            return a.type == b.type && a.frequency == b.frequency && a.q == b.q && a.gain == b.gain;
+        });
+    if (changed)
+    {
+        node.responseBands = current;
+        node.responseCoefficients.resize(5 * current.size());
+        Biquad design;
+        for (size_t i = 0; i < current.size(); ++i)
+        {
+            designBand(design, current[i], node.sampleRate);
+            double * c = &node.responseCoefficients[5 * i];
+            design.getCoefficients(c[0], c[1], c[2], c[3], c[4]);
+        }
+    }
+
+    node.response.evaluate(node.responseCoefficients.data(), static_cast<int>(current.size()));
+    std::copy(node.response.magnitude(), node.response.magnitude() + n, magResponse.begin());
+    std::copy(node.response.phase(), node.response.phase() + n, phaseResponse.begin());
+}
+
+}  // namespace lab
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/ExternalSinkNode.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lab;
+
+namespace
+{
+    int checkedChannelCount(const std::vector<std::shared_ptr<RingBufferT<float>>> & rings)
+    {
+        if (rings.empty())
+            throw std::invalid_argument("An external sink needs a ring per channel");
+        for (auto & ring : rings)
+            if (!ring)
+                throw std::invalid_argument("An external sink's rings can't be null");
+        return static_cast<int>(rings.size());
+    }
+
+    int checkedChannelCount(const std::shared_ptr<AudioRingBuffer> & ring)
+    {
+        if (!ring)
+            throw std::invalid_argument("An external sink's ring can't be null");
+        return ring->channelCount();
+    }
+}
+
+AudioNodeDescriptor * ExternalSinkNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+ExternalSinkNode::ExternalSinkNode(AudioContext & ac, std::vector<std::shared_ptr<RingBufferT<float>>> rings)
+    : AudioNode(ac, {nullptr, nullptr, checkedChannelCount(rings)})
+    , _rings(std::move(rings))
+    , _silence(AudioNode::MaxProcessingSizeInFrames, 0.f)
+{
+    _self->m_channelCountMode = ChannelCountMode::Explicit;
+    _self->m_channelInterpretation = ChannelInterpretation::Discrete;
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+    initialize();
+}
+
+ExternalSinkNode::ExternalSinkNode(AudioContext & ac, std::shared_ptr<AudioRingBuffer> ring)
+    : AudioNode(ac, {nullptr, nullptr, checkedChannelCount(ring)})
+    , _ring(std::move(ring))
+    , _channels(_ring->channelCount(), nullptr)
+{
+    _self->m_channelCountMode = ChannelCountMode::Explicit;
+    _self->m_channelInterpretation = ChannelInterpretation::Discrete;
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+    initialize();
+}
+
+ExternalSinkNode::~ExternalSinkNode()
+{
+    uninitialize();
+}
+
+void ExternalSinkNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+    AudioBus * inputBus = input(0)->isConnected() ? input(0)->bus(r) : nullptr;
+    const int inputChannels = inputBus ? inputBus->numberOfChannels() : 0;
+
+    // a quantum is written to every ring or to none, so that the rings stay frame aligned
+    bool fits = true;
+    for (auto & ring : _rings)
+        fits = fits && ring->getAvailableWrite() >= static_cast<size_t>(bufferSize);
+
+    if (_ring)
+    {
+        // channels past the input's are written silence
+        for (int c = 0; c < _ring->channelCount(); ++c)
+            _channels[c] = c < inputChannels ? inputBus->channel(c)->data() : nullptr;
+        if (!_ring->write(_channels.data(), bufferSize))
+            _overflowFrames.fetch_add(bufferSize, std::memory_order_relaxed);
+    }
+    else if (fits)
+    {
+        for (size_t i = 0; i < _rings.size(); ++i)
+        {
+            const int c = static_cast<int>(i);
+            const float * source = c < inputChannels ? inputBus->channel(c)->data() : _silence.data();
+            _rings[i]->write(source, bufferSize);
+        }
+    }
+    else
+    {
+        _overflowFrames.fetch_add(bufferSize, std::memory_order_relaxed);
+    }
+
+    // pass through
+    if (inputBus)
+        outputBus->copyFrom(*inputBus);
+    else
+        outputBus->zero();
+}
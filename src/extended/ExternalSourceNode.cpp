@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/ExternalSourceNode.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lab;
+
+namespace
+{
+    int checkedChannelCount(const std::vector<std::shared_ptr<RingBufferT<float>>> & rings)
+    {
+        if (rings.empty())
+            throw std::invalid_argument("An external source needs a ring per channel");
+        for (auto & ring : rings)
+            if (!ring)
+                throw std::invalid_argument("An external source's rings can't be null");
+        return static_cast<int>(rings.size());
+    }
+
+    int checkedChannelCount(const std::shared_ptr<AudioRingBuffer> & ring)
+    {
+        if (!ring)
+            throw std::invalid_argument("An external source's ring can't be null");
+        return ring->channelCount();
+    }
+}
+
+AudioNodeDescriptor * ExternalSourceNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+ExternalSourceNode::ExternalSourceNode(AudioContext & ac, std::vector<std::shared_ptr<RingBufferT<float>>> rings)
+    : AudioScheduledSourceNode(ac, {nullptr, nullptr, checkedChannelCount(rings)})
+    , _rings(std::move(rings))
+{
+    initialize();
+}
+
+ExternalSourceNode::ExternalSourceNode(AudioContext & ac, std::shared_ptr<AudioRingBuffer> ring)
+    : AudioScheduledSourceNode(ac, {nullptr, nullptr, checkedChannelCount(ring)})
+    , _ring(std::move(ring))
+    , _channels(_ring->channelCount(), nullptr)
+{
+    initialize();
+}
+
+ExternalSourceNode::~ExternalSourceNode()
+{
+    uninitialize();
+}
+
+void ExternalSourceNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+
+    const int quantumFrameOffset = _self->_scheduler._renderOffset;
+    const int nonSilentFramesToProcess = _self->_scheduler._renderLength;
+
+    if (!isInitialized() || !nonSilentFramesToProcess)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    // the client writes each channel's ring in turn, so the frames every ring has are the
+    // frames it has finished writing
+    size_t available = static_cast<size_t>(nonSilentFramesToProcess);
+    if (_ring)
+        available = std::min(available, _ring->availableRead());
+    for (auto & ring : _rings)
+        available = std::min(available, ring->getAvailableRead());
+    const int frames = static_cast<int>(available);
+
+    const int ringChannels = _ring ? _ring->channelCount() : static_cast<int>(_rings.size());
+    const int channels = std::min(outputBus->numberOfChannels(), ringChannels);
+    if (_ring && frames)
+    {
+        for (int i = 0; i < ringChannels; ++i)
+            _channels[i] = i < channels ? outputBus->channel(i)->mutableData() + quantumFrameOffset : nullptr;
+        _ring->read(_channels.data(), frames);
+    }
+
+    for (int i = 0; i < outputBus->numberOfChannels(); ++i)
+    {
+        float * destP = outputBus->channel(i)->mutableData();
+        if (i < channels && frames)
+        {
+            if (!_ring)
+                _rings[i]->read(destP + quantumFrameOffset, frames);
+        }
+        else
+            std::fill(destP + quantumFrameOffset, destP + quantumFrameOffset + frames, 0.f);
+
+        std::fill(destP, destP + quantumFrameOffset, 0.f);
+        std::fill(destP + quantumFrameOffset + frames, destP + bufferSize, 0.f);
+    }
+
+    if (frames < nonSilentFramesToProcess)
+        _underrunFrames.fetch_add(nonSilentFramesToProcess - frames, std::memory_order_relaxed);
+}
+
+void ExternalSourceNode::reset(ContextRenderLock & r)
+{
+    // the rings belong to the client, whose writes are never discarded
+}
+
+bool ExternalSourceNode::propagatesSilence(ContextRenderLock & r) const
+{
+    return !isPlayingOrScheduled() || hasFinished();
+}
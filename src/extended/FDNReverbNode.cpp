@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/FDNReverbNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "internal/FeedbackDelayNetwork.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+static AudioParamDescriptor s_fdnParams[] = {
+    {"decay",            "DCAY",    2.f,  0.1f,    30.f},
+    {"damping",          "DAMP",  0.5f, 0.05f,     1.f},
+    {"dampingFrequency", "DFRQ", 4000.f, 200.f, 16000.f},
+    {"modulationDepth",  "MDEP",  0.5f,   0.f,     4.f},
+    {"modulationRate",   "MRAT",  0.5f, 0.05f,     5.f},
+    {"dry",              "DRY ",    0.f,   0.f,     1.f},
+    {"wet",              "WET ",    1.f,   0.f,     1.f}, nullptr};
+
+static AudioSettingDescriptor s_fdnSettings[] = {
+    {"lines", "LINE", SettingType::Integer},
+    {"size",  "SIZE", SettingType::Float}, nullptr};
+
+AudioNodeDescriptor * FDNReverbNode::desc()
+{
+    static AudioNodeDescriptor d {s_fdnParams, s_fdnSettings, 2};
+    return &d;
+}
+
+FDNReverbNode::FDNReverbNode(AudioContext & ac)
+    : AudioNode(ac, *desc())
+{
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+    _decay = param("decay");
+    _damping = param("damping");
+    _dampingFrequency = param("dampingFrequency");
+    _modulationDepth = param("modulationDepth");
+    _modulationRate = param("modulationRate");
+    _dry = param("dry");
+    _wet = param("wet");
+    _lines = setting("lines");
+    _lines->setUint32(8);
+    _size = setting("size");
+    _size->setFloat(1.f);
+
+    initialize();
+}
+
+FDNReverbNode::~FDNReverbNode()
+{
+    uninitialize();
+}
+
+void FDNReverbNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+    AudioBus * inputBus = input(0)->bus(r);
+    if (!isInitialized() || !input(0)->isConnected() || !inputBus || outputBus->numberOfChannels() < 2)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    // the network is made again, empty, when its shape changes
+    const float sampleRate = r.context()->sampleRate();
+    const int lines = _lines->valueUint32() > 8 ? 16 : 8;
+    const float size = std::min(std::max(_size->valueFloat(), 0.25f), 4.f);
+    if (!_network || _network->lines() != lines || _network->size() != size)
+        _network.reset(new FeedbackDelayNetwork(sampleRate, lines, size));
+
+    FeedbackDelayNetwork::Parameters p;
+    p.decay = _decay->value();
+    p.damping = _damping->value();
+    p.dampingFrequency = _dampingFrequency->value();
+    p.modulationDepth = _modulationDepth->value();
+    p.modulationRate = _modulationRate->value();
+
+    const float * left = inputBus->channel(0)->data();
+    const float * right = inputBus->numberOfChannels() > 1 ? inputBus->channel(1)->data() : left;
+    float * outL = outputBus->channel(0)->mutableData();
+    float * outR = outputBus->channel(1)->mutableData();
+    _network->process(p, left, right, outL, outR, bufferSize);
+
+    const float wet = _wet->value();
+    const float dry = _dry->value();
+    if (wet != 1.f)
+    {
+        VectorMath::vsmul(outL, 1, &wet, outL, 1, bufferSize);
+        VectorMath::vsmul(outR, 1, &wet, outR, 1, bufferSize);
+    }
+    if (dry > 0.f)
+    {
+        VectorMath::vsma(left, 1, &dry, outL, 1, bufferSize);
+        VectorMath::vsma(right, 1, &dry, outR, 1, bufferSize);
+    }
+
+    for (int c = 2; c < outputBus->numberOfChannels(); ++c)
+        outputBus->channel(c)->zero();
+}
+
+void FDNReverbNode::reset(ContextRenderLock & r)
+{
+    if (_network)
+        _network->reset();
+}
+
+double FDNReverbNode::tailTime(ContextRenderLock & r) const
+{
+    const double delay = _network ? _network->longestDelay() : 0.0;
+    return std::max(_decay->value(), 0.1f) + delay;
+}
+
+}  // namespace lab
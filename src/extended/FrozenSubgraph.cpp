@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/FrozenSubgraph.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/GainNode.h"
+#include "LabSound/core/SampledAudioNode.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/extended/Logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <unordered_set>
+#include <vector>
+
+namespace lab
+{
+
+namespace
+{
+    // The nodes of the chain ending at root, root first, in an order that depends only on
+    // the chain's shape, so that two builds of a chain list corresponding nodes alike.
+    std::vector<AudioNode *> chainNodes(AudioNode * root)
+    {
+        std::vector<AudioNode *> nodes;
+        std::unordered_set<AudioNode *> visited;
+        auto visit = [&](const std::vector<std::shared_ptr<AudioNodeOutput>> & outputs)
+        {
+            for (auto & o : outputs)
+            {
+                AudioNode * n = o->sourceNode();
+                if (n && visited.insert(n).second)
+                    nodes.push_back(n);
+            }
+        };
+
+        if (!root)
+            return nodes;
+        visited.insert(root);
+        nodes.push_back(root);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            AudioNode * n = nodes[i];
+            for (int j = 0; j < n->numberOfInputs(); ++j)
+                visit(n->input(j)->connectedOutputs());
+            for (auto & p : n->params())
+                visit(p->connectedOutputs());
+        }
+        return nodes;
+    }
+
+    inline void hashIn(uint64_t & h, const void * data, size_t size)
+    {
+        // FNV-1a
+        const uint8_t * p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i)
+            h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+
+    template <typename T>
+    inline void hashIn(uint64_t & h, const T & value) { hashIn(h, &value, sizeof(value)); }
+
+    // Changes if a node joins or leaves the chain, or a param or setting in it changes.
+    uint64_t fingerprint(const std::vector<AudioNode *> & nodes)
+    {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (AudioNode * n : nodes)
+        {
+            hashIn(h, n);
+            for (auto & p : n->params())
+                hashIn(h, p->value());
+            for (auto & s : n->settings())
+            {
+                hashIn(h, s->valueFloat());
+                hashIn(h, s->valueUint32());
+                hashIn(h, s->valueBool());
+                hashIn(h, s->valueBus().get());
+            }
+        }
+        return h;
+    }
+
+    // The values of a chain's params and settings, to give to another build of it
+    struct NodeValues
+    {
+        std::string name;
+        std::vector<float> params;
+        std::vector<float> floats;
+        std::vector<uint32_t> integers;
+        std::vector<bool> bools;
+        std::vector<std::shared_ptr<const AudioBus>> busses;
+    };
+
+    std::vector<NodeValues> snapshot(const std::vector<AudioNode *> & nodes)
+    {
+        std::vector<NodeValues> values(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            NodeValues & v = values[i];
+            v.name = nodes[i]->name();
+            for (auto & p : nodes[i]->params())
+                v.params.push_back(p->value());
+            for (auto & s : nodes[i]->settings())
+            {
+                v.floats.push_back(s->valueFloat());
+                v.integers.push_back(s->valueUint32());
+                v.bools.push_back(s->valueBool());
+                v.busses.push_back(s->valueBus());
+            }
+        }
+        return values;
+    }
+
+    bool apply(const std::vector<NodeValues> & values, const std::vector<AudioNode *> & nodes)
+    {
+        if (values.size() != nodes.size())
+            return false;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            auto params = nodes[i]->params();
+            auto settings = nodes[i]->settings();
+            if (values[i].name != nodes[i]->name() || values[i].params.size() != params.size() || values[i].floats.size() != settings.size())
+                return false;
+        }
+
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const NodeValues & v = values[i];
+            auto params = nodes[i]->params();
+            for (size_t j = 0; j < params.size(); ++j)
+                params[j]->setValue(v.params[j]);
+
+            auto settings = nodes[i]->settings();
+            for (size_t j = 0; j < settings.size(); ++j)
+            {
+                AudioSetting & s = *settings[j];
+                switch (s.type())
+                {
+                    case SettingType::Bool: s.setBool(v.bools[j]); break;
+                    case SettingType::Integer: s.setUint32(v.integers[j]); break;
+                    case SettingType::Float: s.setFloat(v.floats[j]); break;
+                    case SettingType::Enum: s.setEnumeration(static_cast<int>(v.integers[j])); break;
+                    case SettingType::Bus: s.setBus(v.busses[j]); break;
+                    case SettingType::None: break;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+FrozenSubgraph::FrozenSubgraph(AudioContext & ac, Builder build, int channels)
+    : _ac(&ac)
+    , _build(std::move(build))
+    , _channels(channels > 0 ? channels : 1)
+{
+    _root = _build(ac);
+    _output = std::make_shared<GainNode>(ac);
+    if (_root)
+        ac.connect(_output, _root);
+}
+
+FrozenSubgraph::~FrozenSubgraph()
+{
+    JobSystem::shared().wait([this]() { return !_rendering.load(std::memory_order_acquire); });
+}
+
+std::shared_ptr<AudioNode> FrozenSubgraph::output() const
+{
+    return _output;
+}
+
+void FrozenSubgraph::freeze(double seconds, bool loop)
+{
+    const float sampleRate = _ac->sampleRate();
+    const uint64_t frames = static_cast<uint64_t>(std::ceil(seconds * sampleRate));
+    if (!_root || !frames || sampleRate <= 0 || _rendering.load(std::memory_order_acquire))
+        return;
+
+    const std::vector<AudioNode *> nodes = chainNodes(_root.get());
+    _frozenFingerprint = fingerprint(nodes);
+    _loop = loop;
+    _rendering.store(true, std::memory_order_release);
+
+    std::vector<NodeValues> values = snapshot(nodes);
+    JobSystem::shared().submit([this, values, frames, sampleRate]()
+    {
+        AudioStreamConfig inputConfig;
+        AudioStreamConfig outputConfig;
+        outputConfig.device_index = 0;
+        outputConfig.desired_channels = _channels;
+        outputConfig.desired_samplerate = sampleRate;
+
+        std::shared_ptr<AudioBus> rendering;
+        {
+            auto context = std::make_shared<AudioContext>(true, false);
+            auto device = std::make_shared<AudioDevice_Null>(inputConfig, outputConfig);
+            auto destination = std::make_shared<AudioDestinationNode>(*context, device);
+            device->setDestinationNode(destination);
+            context->setDestinationNode(destination);
+
+            std::shared_ptr<AudioNode> root = _build(*context);
+            if (root)
+            {
+                // the build's connections are queued; they are applied now so that the
+                // chain can be walked
+                {
+                    ContextRenderLock r(context.get(), "FrozenSubgraph::freeze");
+                    context->handlePreRenderTasks(r);
+                }
+
+                if (!apply(values, chainNodes(root.get())))
+                    LOG_ERROR("FrozenSubgraph: the chain was built differently offline; rendering it as built");
+
+                context->connect(destination, root);
+                rendering = std::make_shared<AudioBus>(_channels, static_cast<int>(frames));
+                rendering->setSampleRate(sampleRate);
+
+                context->startOfflineRendering();
+                destination->offlineRender(frames, 0, [&rendering](const AudioBus & chunk, int count, uint64_t first) -> bool
+                {
+                    const int channels = std::min(rendering->numberOfChannels(), chunk.numberOfChannels());
+                    for (int c = 0; c < channels; ++c)
+                        memcpy(rendering->channel(c)->mutableData() + first, chunk.channel(c)->data(), sizeof(float) * count);
+                    return true;
+                });
+            }
+
+            // the device, context, and destination are circularly referenced
+            destination.reset();
+            device->setDestinationNode(destination);
+            context->setDestinationNode(destination);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_renderedMutex);
+            _rendered = std::move(rendering);
+        }
+
+        // the job's last act, as the subgraph may be destroyed once it's done
+        _rendering.store(false, std::memory_order_release);
+    }, JobPriority::Background);
+}
+
+void FrozenSubgraph::update()
+{
+    if (!_root)
+        return;
+
+    if (_frozen)
+    {
+        if (fingerprint(chainNodes(_root.get())) == _frozenFingerprint)
+            return;
+
+        // the live chain has changed, so the rendering no longer stands for it
+        _player->clearSchedules();
+        _ac->disconnect(_output, _player);
+        _ac->connect(_output, _root);
+        _bus.reset();
+        _frozen = false;
+        return;
+    }
+
+    std::shared_ptr<const AudioBus> rendered;
+    {
+        std::lock_guard<std::mutex> lock(_renderedMutex);
+        rendered = std::move(_rendered);
+        _rendered.reset();
+    }
+
+    // a rendering of a chain that has changed since is stale
+    if (!rendered || fingerprint(chainNodes(_root.get())) != _frozenFingerprint)
+        return;
+
+    if (!_player)
+        _player = std::make_shared<SampledAudioNode>(*_ac);
+    _bus = std::move(rendered);
+    _player->setBus(_bus);
+    _player->schedule(0.f, _loop ? -1 : 0);
+    _ac->disconnect(_output, _root);
+    _ac->connect(_output, _player);
+    _frozen = true;
+}
+
+}  // lab
@@ -11,19 +11,34 @@
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Util.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace lab;
 
 
+namespace
+{
+    // The most grains a cloud can hold; grain state is allocated for this many up front
+    const int MaxGrains = 2048;
+
+    // Resolution of the window table, which is interpolated as grains play through it
+    const int WindowTableSize = 1024;
+}
+
 static AudioParamDescriptor s_GranulationParams[] = {
-    {"NumGrains",         "NGRN", 8.f,  1.f,  256.f},
+    {"NumGrains",         "NGRN", 8.f,  1.f,  static_cast<float>(MaxGrains)},
     {"GrainDuration",     "GDUR", 0.5f, 0.01f,  0.5f},
     {"PositionMin",       "GMIN", 0.0f, 0.0f,   1.0f},
     {"PositionMax",       "GMAX", 1.0f, 0.0f,   1.0f},
     {"PlaybackFrequency", "FREQ", 1.0f, 0.01f, 12.0f},
+    {"PitchSpread",       "PSPR", 0.0f, 0.0f,  24.0f},
+    {"PanSpread",         "PANS", 0.0f, 0.0f,   1.0f},
     {nullptr}};
 
 static AudioSettingDescriptor s_GranulationSettings[] = {
@@ -37,6 +52,18 @@ AudioNodeDescriptor * GranulationNode::desc()
     return &d;
 }
 
+void GranulationNode::GrainState::resize(int count)
+{
+    position.resize(count);
+    increment.resize(count);
+    regionStart.resize(count);
+    regionLength.resize(count);
+    phase.resize(count);
+    phaseIncrement.resize(count);
+    gainLeft.resize(count);
+    gainRight.resize(count);
+}
+
 GranulationNode::GranulationNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
 {
@@ -46,11 +73,15 @@ GranulationNode::GranulationNode(AudioContext & ac)
     // Windowing function that will be applied as an envelope to each grain during playback
     windowFunc = setting("WindowFunction");
     windowFunc->setEnumeration(static_cast<int>(WindowFunction::bartlett), true);
+    windowFunc->setValueChanged([this]() {
+        // compute the table now, so the render thread finds it already cached
+        WindowFunctionTable(static_cast<WindowFunction>(windowFunc->valueUint32()), WindowTableSize + 1);
+    });
 
-    // Total number of grains that will be allocated
+    // Number of grains sounding at once
     numGrains = param("NumGrains");
 
-    // Duration of each grain in seconds (currently fixed but ideally will be configurable per-grain)
+    // Duration of each grain in seconds, picked up as each grain respawns
     grainDuration = param("GrainDuration");
 
     // The min/max positional offset (given in a normalized 0-1 range) from which a grain should
@@ -62,6 +93,16 @@ GranulationNode::GranulationNode(AudioContext & ac)
     // How fast the grain should play, given as a multiplier. Useful for pitch-shifting effects.
     grainPlaybackFreq = param("PlaybackFrequency");
 
+    // The range, in semitones either side of PlaybackFrequency, of each grain's random detune
+    grainPitchSpread = param("PitchSpread");
+
+    // How far across the stereo field grains are randomly panned; 0 is centered, 1 is anywhere
+    grainPanSpread = param("PanSpread");
+
+    grains.resize(MaxGrains);
+    grain_buffer.resize(AudioNode::MaxProcessingSizeInFrames);
+    updateWindow();
+
     initialize();
 }
 
@@ -72,18 +113,53 @@ GranulationNode::~GranulationNode()
 
 void GranulationNode::reset(ContextRenderLock&)
 {
+    // the cloud respawns from scratch on the next render
+    active_grains = 0;
+}
+
+void GranulationNode::updateWindow()
+{
+    window_type = windowFunc->valueUint32();
+    window_table = WindowFunctionTable(static_cast<WindowFunction>(window_type), WindowTableSize + 1);
+}
 
+void GranulationNode::spawnGrain(int index, float sampleRate, double phase)
+{
+    const double length = static_cast<double>(source_bus->length());
+
+    float positionMin = grainPositionMin->value();
+    float positionMax = grainPositionMax->value();
+    if (positionMax < positionMin)
+        std::swap(positionMin, positionMax);
+
+    const double duration = std::max(1.0, grainDuration->value() * static_cast<double>(sampleRate));
+    const double start = std::min(length - 1.0, std::floor(rnd.random_float(positionMin, positionMax) * length));
+    const double spread = grainPitchSpread->value();
+    const double semitones = spread > 0 ? rnd.random_float(-1.f, 1.f) * spread : 0.0;
+
+    grains.regionStart[index] = start;
+    grains.regionLength[index] = std::max(1.0, std::min(duration, length - start));
+    grains.position[index] = start;
+    grains.increment[index] = grainPlaybackFreq->value() * std::pow(2.0, semitones / 12.0) *
+                              (source_bus->sampleRate() / sampleRate);
+    grains.phase[index] = phase;
+    grains.phaseIncrement[index] = 1.0 / duration;
+
+    // a balance law, so that centered grains play at full level in both channels
+    const float pan = rnd.random_float(-1.f, 1.f) * grainPanSpread->value();
+    grains.gainLeft[index] = std::min(1.f, 1.f - pan);
+    grains.gainRight[index] = std::min(1.f, 1.f + pan);
 }
 
 bool GranulationNode::RenderGranulation(ContextRenderLock & r, AudioBus * out_bus, int destinationFrameOffset, int numberOfFrames)
 {
-    if (!r.context())
+    if (!r.context() || !out_bus || !source_bus || !source_bus->length() || out_bus->numberOfChannels() < 2)
         return false;
 
     // Sanity check destinationFrameOffset, numberOfFrames.
     const int destinationLength = out_bus->length();
 
-    bool isLengthGood = destinationLength <= 4096 && numberOfFrames <= 4096;
+    bool isLengthGood = destinationLength <= static_cast<int>(grain_buffer.size()) && numberOfFrames <= static_cast<int>(grain_buffer.size());
     ASSERT(isLengthGood);
     if (!isLengthGood)
         return false;
@@ -93,34 +169,79 @@ bool GranulationNode::RenderGranulation(ContextRenderLock & r, AudioBus * out_bu
     if (!isOffsetGood)
         return false;
 
-    if (!out_bus) return false;
+    if (windowFunc->valueUint32() != window_type)
+        updateWindow();
 
-    float * mono_destination = out_bus->channel(0)->mutableData();
+    const float sampleRate = r.context()->sampleRate();
 
-    // @fixme - this vector
-    std::vector<float> grain_sum_buffer(numberOfFrames, 0.f);
+    // grains joining the cloud start part way through their windows, so that they don't
+    // all arrive together
+    const int grainCount = clampTo(static_cast<int>(numGrains->value()), 1, MaxGrains);
+    for (int g = active_grains; g < grainCount; ++g)
+        spawnGrain(g, sampleRate, rnd.random_float());
+    active_grains = grainCount;
 
-    {
-        for (int i = 0; i < grain_pool.size(); ++i)
-        {
-            grain_pool[i].tick(grain_sum_buffer.data(), static_cast<int>(grain_sum_buffer.size()));
-        }
+    const float * source = source_bus->channel(0)->data();
+    const int sourceEnd = source_bus->length() - 1;
+    const float * window = window_table;
+    float * buffer = grain_buffer.data();
+    float * left = out_bus->channel(0)->mutableData() + destinationFrameOffset;
+    float * right = out_bus->channel(1)->mutableData() + destinationFrameOffset;
+
+    // the cloud is normalized by its density
+    const float scale = 1.f / static_cast<float>(grainCount);
 
-        for (int f = 0; f < numberOfFrames; ++f)
+    for (int g = 0; g < grainCount; ++g)
+    {
+        int frame = 0;
+        while (frame < numberOfFrames)
         {
-            grain_sum_buffer[f] /= static_cast<float>(grain_pool.size());
-            mono_destination[f] = grain_sum_buffer[f]; // @todo - memcpy
+            double position = grains.position[g];
+            double phase = grains.phase[g];
+            const double increment = grains.increment[g];
+            const double phaseIncrement = grains.phaseIncrement[g];
+            const double regionStart = grains.regionStart[g];
+            const double regionLength = grains.regionLength[g];
+            const double regionEnd = regionStart + regionLength;
+
+            // render up to the end of the grain's window, after which it respawns
+            const int remaining = static_cast<int>(std::ceil((1.0 - phase) / phaseIncrement));
+            const int count = std::max(1, std::min(numberOfFrames - frame, remaining));
+
+            for (int i = 0; i < count; ++i)
+            {
+                const int index = static_cast<int>(position);
+                const float fraction = static_cast<float>(position - index);
+                const float a = source[index];
+                const float b = source[std::min(index + 1, sourceEnd)];
+
+                const double windowPosition = std::min(phase, 1.0) * WindowTableSize;
+                const int w = std::min(static_cast<int>(windowPosition), WindowTableSize - 1);
+                const float windowFraction = static_cast<float>(windowPosition - w);
+                const float envelope = window[w] + (window[w + 1] - window[w]) * windowFraction;
+
+                buffer[i] = (a + (b - a) * fraction) * envelope;
+
+                position += increment;
+                if (position >= regionEnd)
+                    position = regionStart + std::fmod(position - regionStart, regionLength);
+                phase += phaseIncrement;
+            }
+
+            const float gainLeft = grains.gainLeft[g] * scale;
+            const float gainRight = grains.gainRight[g] * scale;
+            VectorMath::vsma(buffer, 1, &gainLeft, left + frame, 1, count);
+            VectorMath::vsma(buffer, 1, &gainRight, right + frame, 1, count);
+
+            frame += count;
+            if (phase >= 1.0)
+                spawnGrain(g, sampleRate, phase - 1.0);
+            else
+            {
+                grains.position[g] = position;
+                grains.phase[g] = phase;
+            }
         }
-
-        // Optional grain culling when they're "done"
-        // if (!grain_pool.empty())
-        // {
-        //     auto it = std::remove_if(std::begin(grain_pool), std::end(grain_pool), [this](const grain & g)
-        //     {
-        //         return g.in_use;
-        //     });
-        //     grain_pool.erase(it, std::end(grain_pool));
-        // }
     }
 
     out_bus->clearSilentFlag();
@@ -128,58 +249,16 @@ bool GranulationNode::RenderGranulation(ContextRenderLock & r, AudioBus * out_bu
     return true;
 }
 
-bool GranulationNode::setGrainSource(ContextRenderLock & r, std::shared_ptr<AudioBus> buffer)
+bool GranulationNode::setGrainSource(ContextRenderLock & r, std::shared_ptr<const AudioBus> buffer)
 {
     ASSERT(grainSourceBus);
 
-    // Granulation Settings Sanity Check
-    /// @fixme these values should be per sample, not per quantum
-    /// -or- they should be settings if they don't vary per sample
-    std::cout << "GranulationNode::WindowFunction    " << s_window_types[windowFunc->valueUint32()] << std::endl;
-    std::cout << "GranulationNode::numGrains         " << numGrains->value() << std::endl;
-    std::cout << "GranulationNode::grainDuration     " << grainDuration->value() << std::endl;
-    std::cout << "GranulationNode::grainPositionMin  " << grainPositionMin->value() << std::endl;
-    std::cout << "GranulationNode::grainPositionMax  " << grainPositionMax->value() << std::endl;
-    std::cout << "GranulationNode::grainPlaybackFreq " << grainPlaybackFreq->value() << std::endl;
-
-    grainSourceBus->setBus(buffer.get());
-    output(0)->setNumberOfChannels(r, buffer ? buffer->numberOfChannels() : 0);
-
-    // Compute useful values
-    /// @fixme these values should be per sample, not per quantum
-    /// -or- they should be settings if they don't vary per sample
-    const float grain_duration_seconds = grainDuration->value();
-    const uint64_t grain_duration_samples = static_cast<uint64_t>(grain_duration_seconds * r.context()->sampleRate());
-
-    // Setup window/envelope
-    std::vector<float> grain_window(grain_duration_samples, 1.f);
-    lab::ApplyWindowFunctionInplace(static_cast<WindowFunction>(windowFunc->valueUint32()), grain_window.data(), static_cast<int>(grain_window.size()));
-
-    window_bus.reset(new lab::AudioBus(1, static_cast<int>(grain_duration_samples)));
-    window_bus->setSampleRate(r.context()->sampleRate());
-
-    float * windowData = window_bus->channel(0)->mutableData();
-    for (uint32_t sample = 0; sample < grain_window.size(); ++sample)
-    {
-        windowData[sample] = grain_window[sample];
-    }
-
-    // Setup grains
-    UniformRandomGenerator rnd;
-    auto sample_to_granulate = grainSourceBus->valueBus();
-    
-    int ng = static_cast<int>(numGrains->value());
-    for (int i = 0; i < ng; ++i)
-    {
-        /// @fixme these values should be per sample, not per quantum
-        /// -or- they should be settings if they don't vary per sample
-        const float random_pos_offset = rnd.random_float(grainPositionMin->value(), grainPositionMax->value());
-        
-        printf("grain offset %f\n", random_pos_offset);
-        
-        grain_pool.emplace_back(grain(sample_to_granulate, window_bus, r.context()->sampleRate(), random_pos_offset, grain_duration_seconds, grainPlaybackFreq->value()));
-    }
+    grainSourceBus->setBus(std::move(buffer));
+    source_bus = grainSourceBus->valueBus();
+    output(0)->setNumberOfChannels(r, source_bus ? 2 : 0);
 
+    // the cloud respawns over the new source on the next render
+    active_grains = 0;
     return true;
 }
 
@@ -202,6 +281,8 @@ void GranulationNode::process(ContextRenderLock& r, int bufferSize)
         return;
     }
 
+    // grains are mixed into the output
+    outputBus->zero();
     if (!RenderGranulation(r, outputBus, quantumFrameOffset, bufferFramesToProcess))
     {
         outputBus->zero();
@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/GraphAnalysis.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+
+#include <algorithm>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <unordered_map>
+
+namespace lab
+{
+
+namespace
+{
+    // the nodes a node pulls from, through each of its inputs and then each of its params
+    std::vector<std::vector<AudioNode *>> sourcesOf(AudioNode * node)
+    {
+        std::vector<std::vector<AudioNode *>> sources;
+        auto add = [&](const std::vector<std::shared_ptr<AudioNodeOutput>> & outputs) {
+            sources.emplace_back();
+            for (auto & output : outputs)
+                if (output && output->sourceNode())
+                    sources.back().push_back(output->sourceNode());
+        };
+
+        for (int i = 0; i < node->numberOfInputs(); ++i)
+            if (auto input = node->input(i))
+                add(input->connectedOutputs());
+        for (auto & param : node->params())
+            add(param->connectedOutputs());
+        return sources;
+    }
+
+    void appendNumber(std::string & s, double v)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.9g,", v);
+        s += text;
+    }
+}
+
+double GraphAnalysis::speedup(int threads) const
+{
+    if (threads < 1 || totalCost <= 0)
+        return 1.0;
+    return totalCost / std::max(criticalPathCost, totalCost / threads);
+}
+
+GraphAnalysis AnalyzeGraph(AudioContext & ac, const GraphAnalysisSettings & settings)
+{
+    GraphAnalysis analysis;
+    std::shared_ptr<AudioDestinationNode> destination = ac.destinationNode();
+    if (!destination)
+        return analysis;
+    if (ac.sampleRate() > 0)
+        analysis.quantumMicroseconds = 1.e6 * ac.renderQuantumSize() / ac.sampleRate();
+
+    // Visit the nodes depth first, listing each once its dependencies are. A node met again
+    // while its dependencies are being visited closes a cycle; that edge is left out, as
+    // the render schedule leaves it out.
+    enum Mark { Unvisited = 0, Visiting, Visited };
+    struct Visit
+    {
+        AudioNode * node;
+        bool expanded;
+    };
+    std::unordered_map<AudioNode *, Mark> marks;
+    std::unordered_map<AudioNode *, std::vector<std::vector<AudioNode *>>> sources;
+    std::unordered_map<AudioNode *, int> index;
+    std::vector<Visit> stack;
+
+    marks[destination.get()] = Visited;
+    for (auto & group : sourcesOf(destination.get()))
+        for (AudioNode * source : group)
+            stack.push_back({source, false});
+
+    std::vector<AudioNode *> order;                           // as listed
+    std::vector<std::vector<std::vector<int>>> dependencies;  // of each node, input by input
+    while (!stack.empty())
+    {
+        Visit & top = stack.back();
+        AudioNode * node = top.node;
+        if (!top.expanded)
+        {
+            if (marks[node] != Unvisited)
+            {
+                stack.pop_back();
+                continue;
+            }
+            top.expanded = true;
+            marks[node] = Visiting;
+            std::vector<std::vector<AudioNode *>> & groups = sources[node];
+            groups = sourcesOf(node);
+            for (auto & group : groups)
+                for (AudioNode * source : group)
+                    if (marks[source] == Unvisited)
+                        stack.push_back({source, false});
+            continue;
+        }
+
+        stack.pop_back();
+        marks[node] = Visited;
+        index[node] = static_cast<int>(analysis.nodes.size());
+        order.push_back(node);
+
+        std::vector<std::vector<int>> groups;
+        for (auto & group : sources[node])
+        {
+            groups.emplace_back();
+            for (AudioNode * source : group)
+            {
+                auto found = index.find(source);
+                if (found != index.end())
+                    groups.back().push_back(found->second);
+            }
+        }
+        dependencies.push_back(std::move(groups));
+
+        GraphNodeReport report;
+        report.node = node;
+        report.name = node->name();
+        const ProfileStats stats = node->selfTimeStats(settings.window);
+        report.timed = stats.count > 0;
+        report.cost = stats.mean;
+        for (int i = 0; i < node->numberOfOutputs(); ++i)
+        {
+            auto output = node->output(i);
+            if (output && !output->isConnected())
+                ++report.unusedOutputs;
+        }
+        analysis.nodes.push_back(std::move(report));
+    }
+
+    // The costliest chain ending at each node. Dependencies are listed first, so one pass
+    // finds them all.
+    const int count = static_cast<int>(analysis.nodes.size());
+    std::vector<int> predecessor(count, -1);
+    int last = -1;
+    for (int i = 0; i < count; ++i)
+    {
+        GraphNodeReport & n = analysis.nodes[i];
+        double longest = 0;
+        for (auto & group : dependencies[i])
+            for (int d : group)
+            {
+                ++n.dependencies;
+                if (analysis.nodes[d].pathCost > longest)
+                {
+                    longest = analysis.nodes[d].pathCost;
+                    predecessor[i] = d;
+                }
+            }
+        n.pathCost = n.cost + longest;
+        analysis.totalCost += n.cost;
+        if (last < 0 || n.pathCost > analysis.nodes[last].pathCost)
+            last = i;
+    }
+
+    if (last >= 0)
+    {
+        analysis.criticalPathCost = analysis.nodes[last].pathCost;
+        for (int i = last; i >= 0; i = predecessor[i])
+        {
+            analysis.nodes[i].critical = true;
+            analysis.criticalPath.push_back(i);
+        }
+        std::reverse(analysis.criticalPath.begin(), analysis.criticalPath.end());
+    }
+
+    for (int i = 0; i < count; ++i)
+        if (analysis.totalCost > 0 && analysis.nodes[i].cost >= settings.dominantShare * analysis.totalCost)
+            analysis.dominant.push_back(i);
+    std::sort(analysis.dominant.begin(), analysis.dominant.end(),
+              [&](int a, int b) { return analysis.nodes[a].cost > analysis.nodes[b].cost; });
+
+    // A node's signature is its type, param values and settings, and the subgraphs feeding
+    // each of its inputs and params, named by the first node found with their signature;
+    // a node whose signature was seen before computes the same as that node did.
+    std::map<std::string, int> firstWithSignature;
+    std::vector<int> canonical(count);
+    for (int i = 0; i < count; ++i)
+    {
+        AudioNode * node = order[i];
+        std::string signature = analysis.nodes[i].name + "|";
+        for (auto & param : node->params())
+            appendNumber(signature, param->value());
+        signature += '|';
+        for (auto & setting : node->settings())
+        {
+            switch (setting->type())
+            {
+                case SettingType::Float: appendNumber(signature, setting->valueFloat()); break;
+                case SettingType::Bool: appendNumber(signature, setting->valueBool() ? 1 : 0); break;
+                case SettingType::Bus: appendNumber(signature, static_cast<double>(reinterpret_cast<uintptr_t>(setting->valueBus().get()))); break;
+                default: appendNumber(signature, setting->valueUint32()); break;
+            }
+        }
+        for (auto & group : dependencies[i])
+        {
+            std::vector<int> ids;
+            for (int d : group)
+                ids.push_back(canonical[d]);
+            std::sort(ids.begin(), ids.end());  // inputs sum, so their order doesn't matter
+            signature += '|';
+            for (int id : ids)
+                appendNumber(signature, id);
+        }
+
+        auto found = firstWithSignature.emplace(signature, i);
+        canonical[i] = found.first->second;
+        if (!found.second)
+            analysis.nodes[i].duplicateOf = found.first->second;
+    }
+
+    return analysis;
+}
+
+std::string GraphAnalysis::report() const
+{
+    std::string out;
+    char line[256];
+
+    snprintf(line, sizeof(line), "%d nodes, %.1f us per quantum", static_cast<int>(nodes.size()), totalCost);
+    out += line;
+    if (quantumMicroseconds > 0)
+    {
+        snprintf(line, sizeof(line), " of %.1f us (%.1f%%)", quantumMicroseconds, 100.0 * totalCost / quantumMicroseconds);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "\ncritical path %.1f us over %d nodes; parallel speedup at most %.2fx, %.2fx on 4 threads\n",
+             criticalPathCost, static_cast<int>(criticalPath.size()), maximumSpeedup(), speedup(4));
+    out += line;
+
+    int untimed = 0;
+    for (const GraphNodeReport & n : nodes)
+        untimed += n.timed ? 0 : 1;
+    if (untimed)
+    {
+        snprintf(line, sizeof(line), "%d nodes have not been timed, and count as free\n", untimed);
+        out += line;
+    }
+
+    out += "\ncritical path:\n";
+    for (int i : criticalPath)
+    {
+        snprintf(line, sizeof(line), "  #%-5d %-24s %9.2f us  %9.2f us to here\n", i, nodes[i].name.c_str(), nodes[i].cost, nodes[i].pathCost);
+        out += line;
+    }
+
+    if (!dominant.empty())
+    {
+        out += "\ndominant:\n";
+        for (int i : dominant)
+        {
+            snprintf(line, sizeof(line), "  #%-5d %-24s %9.2f us  %5.1f%%%s\n", i, nodes[i].name.c_str(), nodes[i].cost,
+                     totalCost > 0 ? 100.0 * nodes[i].cost / totalCost : 0.0, nodes[i].critical ? "  critical" : "");
+            out += line;
+        }
+    }
+
+    bool redundant = false;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const GraphNodeReport & n = nodes[i];
+        if (n.duplicateOf < 0 && !n.unusedOutputs)
+            continue;
+        if (!redundant)
+            out += "\nredundant:\n";
+        redundant = true;
+
+        if (n.duplicateOf >= 0)
+        {
+            snprintf(line, sizeof(line), "  #%-5d %-24s %9.2f us  repeats #%d\n", static_cast<int>(i), n.name.c_str(), n.cost, n.duplicateOf);
+            out += line;
+        }
+        if (n.unusedOutputs)
+        {
+            snprintf(line, sizeof(line), "  #%-5d %-24s %d unused outputs\n", static_cast<int>(i), n.name.c_str(), n.unusedOutputs);
+            out += line;
+        }
+    }
+    return out;
+}
+
+}  // lab
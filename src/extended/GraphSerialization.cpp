@@ -0,0 +1,557 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/GraphSerialization.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/Registry.h"
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace lab
+{
+
+namespace
+{
+    const uint8_t GraphMagic[4] = {'L', 'S', 'G', 'R'};
+    const uint32_t DestinationIndex = 0xffffffff;  // a connection to the context's destination node
+
+    class Writer
+    {
+    public:
+        std::vector<uint8_t> & out;
+
+        void u8(uint8_t v) { out.push_back(v); }
+        void u16(uint16_t v)
+        {
+            out.push_back(static_cast<uint8_t>(v));
+            out.push_back(static_cast<uint8_t>(v >> 8));
+        }
+        void u32(uint32_t v)
+        {
+            for (int i = 0; i < 4; ++i)
+                out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+        void f32(float v)
+        {
+            uint32_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            u32(bits);
+        }
+    };
+
+    // Reads past the end return zero, and clear ok, so that a truncated graph is found
+    // once rather than at every read
+    class Reader
+    {
+    public:
+        Reader(const uint8_t * data, size_t size) : _data(data), _size(data ? size : 0) {}
+
+        bool ok = true;
+
+        uint8_t u8() { return static_cast<uint8_t>(read(1)); }
+        uint16_t u16() { return static_cast<uint16_t>(read(2)); }
+        uint32_t u32() { return read(4); }
+        float f32()
+        {
+            const uint32_t bits = read(4);
+            float v;
+            memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+        const uint8_t * bytes(size_t count)
+        {
+            if (!ok || _size - _offset < count)
+            {
+                ok = false;
+                return nullptr;
+            }
+            const uint8_t * p = _data + _offset;
+            _offset += count;
+            return p;
+        }
+
+        // a count of items of at least itemSize bytes each, checked against the bytes left,
+        // so that a corrupt count doesn't reserve storage for items that aren't there
+        uint32_t count(size_t itemSize)
+        {
+            const uint32_t n = u32();
+            if (ok && static_cast<uint64_t>(n) * itemSize > _size - _offset)
+                ok = false;
+            return ok ? n : 0;
+        }
+
+    private:
+        uint32_t read(int bytes)
+        {
+            const uint8_t * p = this->bytes(bytes);
+            uint32_t v = 0;
+            for (int i = 0; p && i < bytes; ++i)
+                v |= static_cast<uint32_t>(p[i]) << (8 * i);
+            return v;
+        }
+
+        const uint8_t * _data;
+        size_t _size;
+        size_t _offset = 0;
+    };
+
+    bool isSaved(SettingType type)
+    {
+        return type == SettingType::Bool || type == SettingType::Integer || type == SettingType::Float || type == SettingType::Enum;
+    }
+
+    // A node type's parameters and saved settings, by name, in the order its nodes' values are stored
+    struct TypeRecord
+    {
+        uint32_t name = 0;
+        std::vector<uint32_t> params;
+        std::vector<uint32_t> settings;
+        std::vector<uint8_t> settingTypes;
+        std::vector<int> settingIndices;  // saving: the node's settings that are saved
+    };
+
+    int outputIndex(AudioNode * node, const std::shared_ptr<AudioNodeOutput> & output)
+    {
+        for (int i = 0; i < node->numberOfOutputs(); ++i)
+            if (node->output(i) == output)
+                return i;
+        return -1;
+    }
+}
+
+std::vector<uint8_t> SaveGraph(AudioContext & ac, const std::vector<std::shared_ptr<AudioNode>> & nodes)
+{
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> stringIndex;
+    auto intern = [&](const std::string & s) -> uint32_t {
+        auto it = stringIndex.find(s);
+        if (it != stringIndex.end())
+            return it->second;
+        const uint32_t index = static_cast<uint32_t>(strings.size());
+        strings.push_back(s);
+        stringIndex[s] = index;
+        return index;
+    };
+
+    std::vector<TypeRecord> types;
+    std::unordered_map<std::string, uint32_t> typeIndex;
+    std::vector<uint32_t> nodeTypes;
+    std::unordered_map<AudioNode *, uint32_t> nodeIndex;
+    for (const std::shared_ptr<AudioNode> & node : nodes)
+    {
+        nodeIndex[node.get()] = static_cast<uint32_t>(nodeTypes.size());
+
+        const std::string name = node->name();
+        auto it = typeIndex.find(name);
+        if (it == typeIndex.end())
+        {
+            TypeRecord type;
+            type.name = intern(name);
+            for (auto & param : node->params())
+                type.params.push_back(intern(param->name()));
+            std::vector<std::shared_ptr<AudioSetting>> settings = node->settings();
+            for (int i = 0; i < static_cast<int>(settings.size()); ++i)
+                if (isSaved(settings[i]->type()))
+                {
+                    type.settings.push_back(intern(settings[i]->name()));
+                    type.settingTypes.push_back(static_cast<uint8_t>(settings[i]->type()));
+                    type.settingIndices.push_back(i);
+                }
+            it = typeIndex.emplace(name, static_cast<uint32_t>(types.size())).first;
+            types.push_back(std::move(type));
+        }
+        nodeTypes.push_back(it->second);
+    }
+
+    std::vector<uint8_t> data;
+    Writer w{data};
+    for (uint8_t c : GraphMagic)
+        w.u8(c);
+    w.u16(GraphFormatVersion);
+    w.u16(0);  // flags, reserved
+
+    w.u32(static_cast<uint32_t>(strings.size()));
+    for (const std::string & s : strings)
+    {
+        w.u16(static_cast<uint16_t>(s.size()));
+        data.insert(data.end(), s.begin(), s.begin() + static_cast<uint16_t>(s.size()));
+    }
+
+    w.u32(static_cast<uint32_t>(types.size()));
+    for (const TypeRecord & type : types)
+    {
+        w.u32(type.name);
+        w.u16(static_cast<uint16_t>(type.params.size()));
+        for (uint32_t p : type.params)
+            w.u32(p);
+        w.u16(static_cast<uint16_t>(type.settings.size()));
+        for (size_t i = 0; i < type.settings.size(); ++i)
+        {
+            w.u32(type.settings[i]);
+            w.u8(type.settingTypes[i]);
+        }
+    }
+
+    w.u32(static_cast<uint32_t>(nodes.size()));
+    for (size_t n = 0; n < nodes.size(); ++n)
+    {
+        const TypeRecord & type = types[nodeTypes[n]];
+        w.u32(nodeTypes[n]);
+
+        std::vector<std::shared_ptr<AudioParam>> params = nodes[n]->params();
+        for (auto & param : params)
+            w.f32(param->value());
+
+        std::vector<std::shared_ptr<AudioSetting>> settings = nodes[n]->settings();
+        for (int i : type.settingIndices)
+        {
+            AudioSetting & setting = *settings[i];
+            switch (setting.type())
+            {
+                case SettingType::Bool: w.u8(setting.valueBool() ? 1 : 0); break;
+                case SettingType::Float: w.f32(setting.valueFloat()); break;
+                default: w.u32(setting.valueUint32()); break;
+            }
+        }
+
+        std::vector<std::pair<uint16_t, AudioParamTimeline::Event>> events;
+        for (size_t p = 0; p < params.size(); ++p)
+            for (auto & e : params[p]->timelineEvents())
+                events.emplace_back(static_cast<uint16_t>(p), std::move(e));
+        w.u32(static_cast<uint32_t>(events.size()));
+        for (auto & e : events)
+        {
+            w.u16(e.first);
+            w.u8(static_cast<uint8_t>(e.second.kind));
+            w.f32(e.second.value);
+            w.f32(e.second.time);
+            w.f32(e.second.timeConstant);
+            w.f32(e.second.duration);
+            w.u32(static_cast<uint32_t>(e.second.curve ? e.second.curve->size() : 0));
+            if (e.second.curve)
+                for (float v : *e.second.curve)
+                    w.f32(v);
+        }
+    }
+
+    struct Connection
+    {
+        uint32_t source;
+        uint16_t output;
+        uint32_t destination;
+        uint16_t index;  // the destination's input, or parameter
+    };
+
+    std::vector<Connection> connections;
+    auto addInputs = [&](AudioNode * destination, uint32_t destinationIndex) {
+        for (int i = 0; i < destination->numberOfInputs(); ++i)
+            for (auto & output : destination->input(i)->connectedOutputs())
+            {
+                auto source = output ? nodeIndex.find(output->sourceNode()) : nodeIndex.end();
+                if (source == nodeIndex.end())
+                    continue;
+                const int o = outputIndex(output->sourceNode(), output);
+                if (o >= 0)
+                    connections.push_back({source->second, static_cast<uint16_t>(o), destinationIndex, static_cast<uint16_t>(i)});
+            }
+    };
+    for (size_t n = 0; n < nodes.size(); ++n)
+        addInputs(nodes[n].get(), static_cast<uint32_t>(n));
+    if (std::shared_ptr<AudioNode> destination = ac.destinationNode())
+        if (nodeIndex.find(destination.get()) == nodeIndex.end())
+            addInputs(destination.get(), DestinationIndex);
+
+    std::vector<Connection> paramConnections;
+    for (size_t n = 0; n < nodes.size(); ++n)
+    {
+        std::vector<std::shared_ptr<AudioParam>> params = nodes[n]->params();
+        for (size_t p = 0; p < params.size(); ++p)
+            for (auto & output : params[p]->connectedOutputs())
+            {
+                auto source = output ? nodeIndex.find(output->sourceNode()) : nodeIndex.end();
+                if (source == nodeIndex.end())
+                    continue;
+                const int o = outputIndex(output->sourceNode(), output);
+                if (o >= 0)
+                    paramConnections.push_back({source->second, static_cast<uint16_t>(o), static_cast<uint32_t>(n), static_cast<uint16_t>(p)});
+            }
+    }
+
+    for (auto * list : {&connections, &paramConnections})
+    {
+        w.u32(static_cast<uint32_t>(list->size()));
+        for (const Connection & c : *list)
+        {
+            w.u32(c.source);
+            w.u16(c.output);
+            w.u32(c.destination);
+            w.u16(c.index);
+        }
+    }
+
+    return data;
+}
+
+bool LoadGraph(AudioContext & ac, const uint8_t * data, size_t size, std::vector<std::shared_ptr<AudioNode>> & nodes)
+{
+    nodes.clear();
+    Reader r(data, size);
+
+    const uint8_t * magic = r.bytes(sizeof(GraphMagic));
+    if (!magic || memcmp(magic, GraphMagic, sizeof(GraphMagic)))
+    {
+        LOG_ERROR("LoadGraph: the data is not a LabSound graph");
+        return false;
+    }
+    const uint16_t version = r.u16();
+    r.u16();  // flags
+    if (version == 0 || version > GraphFormatVersion)
+    {
+        LOG_ERROR("LoadGraph: graph version %d can't be read; versions up to %d can", version, GraphFormatVersion);
+        return false;
+    }
+
+    std::vector<std::string> strings(r.count(2));
+    for (std::string & s : strings)
+    {
+        const uint16_t length = r.u16();
+        if (const uint8_t * p = r.bytes(length))
+            s.assign(reinterpret_cast<const char *>(p), length);
+    }
+    auto nameAt = [&](uint32_t index) -> const std::string & {
+        static const std::string none;
+        if (index < strings.size())
+            return strings[index];
+        r.ok = false;
+        return none;
+    };
+
+    // Each type's names are resolved to the indices of its nodes' parameters and settings
+    // when its first node is created, and reused for the rest
+    struct LoadedType
+    {
+        std::string name;
+        std::vector<std::string> params;
+        std::vector<std::string> settings;
+        std::vector<SettingType> settingTypes;
+        bool resolved = false;
+        std::vector<int> paramIndices;    // -1 for a parameter this build's node doesn't have
+        std::vector<int> settingIndices;  // likewise, or whose type has changed
+    };
+
+    NodeRegistry & registry = NodeRegistry::Instance();
+    std::vector<LoadedType> types(r.count(8));
+    for (LoadedType & type : types)
+    {
+        type.name = nameAt(r.u32());
+        type.params.resize(r.u16());
+        for (std::string & p : type.params)
+            p = nameAt(r.u32());
+        const uint16_t settingCount = r.u16();
+        for (uint16_t i = 0; i < settingCount; ++i)
+        {
+            type.settings.push_back(nameAt(r.u32()));
+            type.settingTypes.push_back(static_cast<SettingType>(r.u8()));
+            if (!isSaved(type.settingTypes.back()))
+                r.ok = false;
+        }
+        if (r.ok && !registry.Descriptor(type.name))
+        {
+            LOG_ERROR("LoadGraph: the NodeRegistry has no node type %s", type.name.c_str());
+            return false;
+        }
+    }
+
+    const uint32_t nodeCount = r.count(8);
+    nodes.reserve(nodeCount);
+    std::vector<uint32_t> nodeTypes;
+    nodeTypes.reserve(nodeCount);
+    for (uint32_t n = 0; n < nodeCount && r.ok; ++n)
+    {
+        const uint32_t t = r.u32();
+        if (t >= types.size())
+        {
+            r.ok = false;
+            break;
+        }
+        LoadedType & type = types[t];
+
+        std::shared_ptr<AudioNode> node(registry.Create(type.name, ac));
+        if (!node)
+        {
+            LOG_ERROR("LoadGraph: a %s node can't be created", type.name.c_str());
+            nodes.clear();
+            return false;
+        }
+
+        std::vector<std::shared_ptr<AudioParam>> params = node->params();
+        std::vector<std::shared_ptr<AudioSetting>> settings = node->settings();
+        if (!type.resolved)
+        {
+            type.resolved = true;
+            for (const std::string & name : type.params)
+            {
+                int index = -1;
+                for (int i = 0; i < static_cast<int>(params.size()) && index < 0; ++i)
+                    if (params[i]->name() == name)
+                        index = i;
+                type.paramIndices.push_back(index);
+            }
+            for (size_t s = 0; s < type.settings.size(); ++s)
+            {
+                int index = -1;
+                for (int i = 0; i < static_cast<int>(settings.size()) && index < 0; ++i)
+                    if (settings[i]->name() == type.settings[s] && settings[i]->type() == type.settingTypes[s])
+                        index = i;
+                type.settingIndices.push_back(index);
+            }
+        }
+
+        for (int index : type.paramIndices)
+        {
+            const float value = r.f32();
+            if (index >= 0)
+                params[index]->setValue(value);
+        }
+
+        for (size_t s = 0; s < type.settings.size(); ++s)
+        {
+            AudioSetting * setting = type.settingIndices[s] >= 0 ? settings[type.settingIndices[s]].get() : nullptr;
+            switch (type.settingTypes[s])
+            {
+                case SettingType::Bool:
+                {
+                    const bool v = r.u8() != 0;
+                    if (setting)
+                        setting->setBool(v);
+                    break;
+                }
+                case SettingType::Float:
+                {
+                    const float v = r.f32();
+                    if (setting)
+                        setting->setFloat(v);
+                    break;
+                }
+                case SettingType::Enum:
+                {
+                    const uint32_t v = r.u32();
+                    if (setting)
+                        setting->setEnumeration(static_cast<int>(v));
+                    break;
+                }
+                default:
+                {
+                    const uint32_t v = r.u32();
+                    if (setting)
+                        setting->setUint32(v);
+                    break;
+                }
+            }
+        }
+
+        const uint32_t eventCount = r.count(23);
+        for (uint32_t e = 0; e < eventCount && r.ok; ++e)
+        {
+            const uint16_t slot = r.u16();
+            const uint8_t kind = r.u8();
+            const float value = r.f32();
+            const float time = r.f32();
+            const float timeConstant = r.f32();
+            const float duration = r.f32();
+            std::vector<float> curve(r.count(4));
+            for (float & v : curve)
+                v = r.f32();
+
+            if (slot >= type.paramIndices.size())
+            {
+                r.ok = false;
+                break;
+            }
+            if (type.paramIndices[slot] < 0)
+                continue;
+
+            AudioParam & param = *params[type.paramIndices[slot]];
+            switch (static_cast<AudioParamTimeline::EventKind>(kind))
+            {
+                case AudioParamTimeline::EventKind::SetValue: param.setValueAtTime(value, time); break;
+                case AudioParamTimeline::EventKind::LinearRampToValue: param.linearRampToValueAtTime(value, time); break;
+                case AudioParamTimeline::EventKind::ExponentialRampToValue: param.exponentialRampToValueAtTime(value, time); break;
+                case AudioParamTimeline::EventKind::SetTarget: param.setTargetAtTime(value, time, timeConstant); break;
+                case AudioParamTimeline::EventKind::SetValueCurve: param.setValueCurveAtTime(std::move(curve), time, duration); break;
+                default: r.ok = false; break;
+            }
+        }
+
+        nodes.push_back(std::move(node));
+        nodeTypes.push_back(t);
+    }
+
+    // the connections are checked as they are read, and queued only once all of them are
+    std::vector<AudioContext::NodeConnection> connections(r.count(12));
+    std::shared_ptr<AudioNode> destination = ac.destinationNode();
+    for (AudioContext::NodeConnection & c : connections)
+    {
+        const uint32_t source = r.u32();
+        c.srcIdx = r.u16();
+        const uint32_t dest = r.u32();
+        c.destIdx = r.u16();
+        if (source >= nodes.size() || (dest >= nodes.size() && !(dest == DestinationIndex && destination)))
+        {
+            r.ok = false;
+            break;
+        }
+        c.source = nodes[source];
+        c.destination = dest == DestinationIndex ? destination : nodes[dest];
+        if (c.srcIdx >= c.source->numberOfOutputs() || c.destIdx >= c.destination->numberOfInputs())
+        {
+            r.ok = false;
+            break;
+        }
+    }
+
+    const uint32_t paramConnectionCount = r.count(12);
+    std::vector<AudioContext::ParamConnection> paramConnections;
+    paramConnections.reserve(paramConnectionCount);
+    for (uint32_t i = 0; i < paramConnectionCount && r.ok; ++i)
+    {
+        const uint32_t source = r.u32();
+        const uint16_t output = r.u16();
+        const uint32_t dest = r.u32();
+        const uint16_t slot = r.u16();
+        if (source >= nodes.size() || dest >= nodes.size() || output >= nodes[source]->numberOfOutputs() ||
+            slot >= types[nodeTypes[dest]].paramIndices.size())
+        {
+            r.ok = false;
+            break;
+        }
+
+        // a parameter this build's node doesn't have is left unconnected, as its value was
+        const int index = types[nodeTypes[dest]].paramIndices[slot];
+        if (index >= 0)
+            paramConnections.push_back({nodes[dest]->params()[index], nodes[source], output});
+    }
+
+    if (!r.ok)
+    {
+        LOG_ERROR("LoadGraph: the graph is truncated or corrupt");
+        nodes.clear();
+        return false;
+    }
+
+    ac.connect(connections, paramConnections);
+    return true;
+}
+
+}  // lab
@@ -0,0 +1,459 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/HRTFMixerNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioListener.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/PannerNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Assertions.h"
+#include "internal/DelayDSPKernel.h"
+#include "internal/Distance.h"
+#include "internal/FFTConvolver.h"
+#include "internal/HRTFDatabase.h"
+#include "internal/HRTFPanner.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace lab
+{
+
+using namespace VectorMath;
+
+// as the HRTFPanner's
+static const double MaxDelayTimeSeconds = 0.002;
+
+// The elevations the database's kernels are made for
+static const int MinElevation = -45;
+static const int MaxElevation = 90;
+static const int ElevationSpacing = 15;
+static const int NumberOfElevations = (MaxElevation - MinElevation) / ElevationSpacing + 1;
+
+static char const * const s_distance_models[lab::DistanceEffect::ModelType::_Count + 1] = {
+    "Linear", "Inverse", "Exponential", nullptr};
+
+static AudioSettingDescriptor s_sDesc[] = {
+    {"distanceModel",   "DSTM", SettingType::Enum, s_distance_models},
+    {"refDistance",     "REFD", SettingType::Float},
+    {"maxDistance",     "MAXD", SettingType::Float},
+    {"rolloffFactor",   "ROLL", SettingType::Float},
+    {"azimuthGrouping", "AZGR", SettingType::Integer},
+    nullptr};
+
+AudioNodeDescriptor * HRTFMixerNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_sDesc, 2};
+    return &d;
+}
+
+struct HRTFMixerNode::Source
+{
+    // written by any thread, read by the render thread
+    std::atomic<float> x {0.f};
+    std::atomic<float> y {0.f};
+    std::atomic<float> z {0.f};
+
+    // render thread state. While moving between directions, the source cross-fades from
+    // the direction it was in to the one it is in, as an HRTFPanner does.
+    int key = -1;
+    int fadingFromKey = -1;
+    float fade = 1.f;
+    float gain = -1.f;
+};
+
+// A direction of the database, which sums the sources heard from it and convolves them together
+struct HRTFMixerNode::Direction
+{
+    Direction(int fftSize, float sampleRate)
+        : convolverL(fftSize)
+        , convolverR(fftSize)
+        , delayL(MaxDelayTimeSeconds, sampleRate)
+        , delayR(MaxDelayTimeSeconds, sampleRate)
+    {
+    }
+
+    void reset()
+    {
+        convolverL.reset();
+        convolverR.reset();
+        delayL.reset();
+        delayR.reset();
+        input.zero();
+        silentFrames = 0;
+        key = -1;
+    }
+
+    int key = -1;
+    int azimuthIndex = 0;
+    double elevation = 0;
+
+    bool heard = false;    // a source was summed into input this quantum
+    int silentFrames = 0;  // frames since a source was last heard
+
+    FFTConvolver convolverL;
+    FFTConvolver convolverR;
+    DelayDSPKernel delayL;
+    DelayDSPKernel delayR;
+    AudioFloatArray input;
+};
+
+HRTFMixerNode::HRTFMixerNode(AudioContext & ac, int numberOfInputs)
+    : AudioNode(ac, *desc())
+    , m_distanceEffect(new DistanceEffect())
+    , m_sampleRate(ac.sampleRate())
+{
+    m_distanceModel = setting("distanceModel");
+    m_refDistance = setting("refDistance");
+    m_maxDistance = setting("maxDistance");
+    m_rolloffFactor = setting("rolloffFactor");
+    m_azimuthGrouping = setting("azimuthGrouping");
+
+    m_distanceModel->setUint32(static_cast<uint32_t>(m_distanceEffect->model()), false);
+    m_refDistance->setFloat(static_cast<float>(m_distanceEffect->refDistance()), false);
+    m_maxDistance->setFloat(static_cast<float>(m_distanceEffect->maxDistance()), false);
+    m_rolloffFactor->setFloat(static_cast<float>(m_distanceEffect->rolloffFactor()), false);
+    m_azimuthGrouping->setUint32(1, false);
+
+    m_distanceModel->setValueChanged(
+        [this]() {
+            DistanceEffect::ModelType model(static_cast<DistanceEffect::ModelType>(m_distanceModel->valueUint32()));
+            if (model >= DistanceEffect::_Count)
+                throw std::invalid_argument("invalid distance model");
+            m_distanceEffect->setModel(model, true);
+        });
+
+    m_refDistance->setValueChanged(
+        [this]() {
+            m_distanceEffect->setRefDistance(m_refDistance->valueFloat());
+        });
+
+    m_maxDistance->setValueChanged(
+        [this]() {
+            m_distanceEffect->setMaxDistance(m_maxDistance->valueFloat());
+        });
+
+    m_rolloffFactor->setValueChanged(
+        [this]() {
+            m_distanceEffect->setRolloffFactor(m_rolloffFactor->valueFloat());
+        });
+
+    m_directionByKey.resize(HRTFDatabase::numberOfAzimuths() * NumberOfElevations, nullptr);
+
+    addInputs(numberOfInputs);
+
+    // every source is mixed down to mono before it is spatialized
+    _self->m_channelCount = 1;
+    _self->m_channelCountMode = ChannelCountMode::Explicit;
+    _self->m_channelInterpretation = ChannelInterpretation::Speakers;
+
+    initialize();
+}
+
+HRTFMixerNode::~HRTFMixerNode()
+{
+    uninitialize();
+}
+
+void HRTFMixerNode::addInputs(int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+        m_sources.emplace_back(new Source());
+    }
+}
+
+void HRTFMixerNode::setPosition(int input, const FloatPoint3D & position)
+{
+    if (input < 0 || input >= static_cast<int>(m_sources.size()))
+        throw std::out_of_range("HRTFMixerNode has no such input");
+
+    Source & source = *m_sources[input];
+    source.x.store(position.x, std::memory_order_relaxed);
+    source.y.store(position.y, std::memory_order_relaxed);
+    source.z.store(position.z, std::memory_order_relaxed);
+}
+
+FloatPoint3D HRTFMixerNode::position(int input) const
+{
+    if (input < 0 || input >= static_cast<int>(m_sources.size()))
+        throw std::out_of_range("HRTFMixerNode has no such input");
+
+    const Source & source = *m_sources[input];
+    return {source.x.load(std::memory_order_relaxed),
+            source.y.load(std::memory_order_relaxed),
+            source.z.load(std::memory_order_relaxed)};
+}
+
+float HRTFMixerNode::refDistance() const { return m_refDistance->valueFloat(); }
+void HRTFMixerNode::setRefDistance(float refDistance) { m_refDistance->setFloat(refDistance); }
+
+float HRTFMixerNode::maxDistance() const { return m_maxDistance->valueFloat(); }
+void HRTFMixerNode::setMaxDistance(float maxDistance) { m_maxDistance->setFloat(maxDistance); }
+
+float HRTFMixerNode::rolloffFactor() const { return m_rolloffFactor->valueFloat(); }
+void HRTFMixerNode::setRolloffFactor(float rolloffFactor) { m_rolloffFactor->setFloat(rolloffFactor); }
+
+int HRTFMixerNode::azimuthGrouping() const { return static_cast<int>(m_azimuthGrouping->valueUint32()); }
+void HRTFMixerNode::setAzimuthGrouping(int azimuths)
+{
+    m_azimuthGrouping->setUint32(static_cast<uint32_t>(std::max(1, std::min(azimuths, static_cast<int>(HRTFDatabase::numberOfAzimuths())))));
+}
+
+HRTFMixerNode::Direction * HRTFMixerNode::acquireDirection(int key, int frames)
+{
+    Direction * direction = m_directionByKey[key];
+    if (direction)
+        return direction;
+
+    if (m_freeDirections.empty())
+    {
+        m_directions.emplace_back(new Direction(HRTFPanner::fftSizeForSampleRate(m_sampleRate), m_sampleRate));
+        m_freeDirections.push_back(m_directions.back().get());
+    }
+
+    direction = m_freeDirections.back();
+    m_freeDirections.pop_back();
+
+    direction->key = key;
+    direction->azimuthIndex = key / NumberOfElevations;
+    direction->elevation = MinElevation + (key % NumberOfElevations) * ElevationSpacing;
+    direction->silentFrames = 0;
+    if (direction->input.size() != frames)
+    {
+        direction->input.allocate(frames);
+        direction->input.zero();
+    }
+    m_directionByKey[key] = direction;
+    m_activeDirections.push_back(direction);
+    return direction;
+}
+
+// Sums source into a direction, ramping its gain from gain0 to gain1 and, over the same
+// frames, its share from fade0 to fade1.
+static void sumInto(float * dst, const float * source, float gain0, float gain1, float fade0, float fade1, int frames)
+{
+    const float gainStep = (gain1 - gain0) / frames;
+    const float fadeStep = (fade1 - fade0) / frames;
+    float gain = gain0;
+    float fade = fade0;
+    for (int i = 0; i < frames; ++i)
+    {
+        dst[i] += source[i] * gain * fade;
+        gain += gainStep;
+        fade += fadeStep;
+    }
+}
+
+void HRTFMixerNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * destination = output(0)->bus(r);
+    destination->zero();
+
+    if (!isInitialized())
+        return;
+
+    std::shared_ptr<HRTFDatabaseLoader> loader = r.context()->hrtfDatabaseLoader();
+    if (!loader)
+        return;
+
+    if (!loader->isLoaded())
+    {
+        // as a PannerNode, an offline context waits for the database, and a realtime one is silent
+        if (!r.context()->isOfflineContext())
+            return;
+        loader->waitForLoaderThreadCompletion();
+    }
+
+    HRTFDatabase * database = loader->database();
+    if (!database)
+        return;
+    HRTFDatabase::Reading reading(database);
+
+    if (static_cast<int>(m_tempL.size()) < bufferSize)
+    {
+        m_tempL.allocate(bufferSize);
+        m_tempR.allocate(bufferSize);
+    }
+
+    auto listener = r.context()->listener();
+    const FloatPoint3D listenerPosition = {listener->positionX()->value(), listener->positionY()->value(), listener->positionZ()->value()};
+    const FloatPoint3D listenerForward = {listener->forwardX()->value(), listener->forwardY()->value(), listener->forwardZ()->value()};
+    const FloatPoint3D listenerUp = {listener->upX()->value(), listener->upY()->value(), listener->upZ()->value()};
+
+    const int numberOfAzimuths = static_cast<int>(HRTFDatabase::numberOfAzimuths());
+    const int grouping = std::max(1, std::min(azimuthGrouping(), numberOfAzimuths));
+    const double azimuthSpacing = 360.0 / numberOfAzimuths;
+
+    // cross-fade between directions over around 45 milliseconds, as an HRTFPanner does
+    const float fadeStep = static_cast<float>(bufferSize) / (m_sampleRate <= 48000 ? 2048.f : 4096.f);
+
+    // Sum every source into the directions it is heard from
+    const int sources = std::min(numberOfInputs(), static_cast<int>(m_sources.size()));
+    for (int i = 0; i < sources; ++i)
+    {
+        Source & source = *m_sources[i];
+        auto in = input(i);
+        if (!in->isConnected())
+        {
+            source.key = -1;
+            source.fadingFromKey = -1;
+            source.gain = -1.f;
+            continue;
+        }
+
+        AudioBus * bus = in->bus(r);
+        if (!bus || bus->isSilent())
+        {
+            // a silent source keeps its direction and gain, so that it resumes without a fade
+            continue;
+        }
+
+        const FloatPoint3D position = {source.x.load(std::memory_order_relaxed),
+                                       source.y.load(std::memory_order_relaxed),
+                                       source.z.load(std::memory_order_relaxed)};
+
+        double azimuth;
+        double elevation;
+        PannerNode::azimuthElevation(position, listenerPosition, listenerForward, listenerUp, &azimuth, &elevation);
+
+        // the database's azimuths turn the other way from the panner's, and run from 0 to 360
+        azimuth = -azimuth;
+        if (azimuth < 0)
+            azimuth += 360.0;
+
+        int azimuthIndex = static_cast<int>(floor(azimuth / (azimuthSpacing * grouping) + 0.5)) * grouping;
+        azimuthIndex %= numberOfAzimuths;
+
+        elevation = std::max(static_cast<double>(MinElevation), std::min(static_cast<double>(MaxElevation), elevation));
+        const int elevationIndex = static_cast<int>(floor((elevation - MinElevation) / ElevationSpacing + 0.5));
+
+        const int key = azimuthIndex * NumberOfElevations + elevationIndex;
+
+        const float gain = static_cast<float>(m_distanceEffect->gain(magnitude(position - listenerPosition)));
+        const float lastGain = source.gain < 0 ? gain : source.gain;
+        source.gain = gain;
+
+        // a new direction is taken once any fade under way has finished
+        if (source.key < 0)
+            source.key = key;
+        else if (source.fadingFromKey < 0 && key != source.key)
+        {
+            source.fadingFromKey = source.key;
+            source.key = key;
+            source.fade = 0.f;
+        }
+
+        const float * samples = bus->channel(0)->data();
+        const float fade0 = source.fade;
+        const float fade1 = source.fadingFromKey < 0 ? 1.f : std::min(1.f, fade0 + fadeStep);
+
+        Direction * to = acquireDirection(source.key, bufferSize);
+        sumInto(to->input.data(), samples, lastGain, gain, fade0, fade1, bufferSize);
+        to->heard = true;
+
+        if (source.fadingFromKey >= 0)
+        {
+            Direction * from = acquireDirection(source.fadingFromKey, bufferSize);
+            sumInto(from->input.data(), samples, lastGain, gain, 1.f - fade0, 1.f - fade1, bufferSize);
+            from->heard = true;
+
+            source.fade = fade1;
+            if (fade1 >= 1.f)
+                source.fadingFromKey = -1;
+        }
+    }
+
+    // Convolve every direction that is heard, or whose convolution is still ringing out
+    const int releaseFrames = HRTFPanner::fftSizeForSampleRate(m_sampleRate) + static_cast<int>(ceil(MaxDelayTimeSeconds * m_sampleRate));
+    float * destinationL = destination->channel(0)->mutableData();
+    float * destinationR = destination->channel(1)->mutableData();
+    float * tempL = m_tempL.data();
+    float * tempR = m_tempR.data();
+
+    for (size_t i = 0; i < m_activeDirections.size();)
+    {
+        Direction * direction = m_activeDirections[i];
+        if (direction->heard)
+            direction->silentFrames = 0;
+        else
+            direction->silentFrames += bufferSize;
+        direction->heard = false;
+
+        if (direction->silentFrames >= releaseFrames)
+        {
+            m_directionByKey[direction->key] = nullptr;
+            direction->reset();
+            m_freeDirections.push_back(direction);
+            m_activeDirections[i] = m_activeDirections.back();
+            m_activeDirections.pop_back();
+            continue;
+        }
+
+        HRTFKernel * kernelL;
+        HRTFKernel * kernelR;
+        double frameDelayL;
+        double frameDelayR;
+        database->getKernelsFromAzimuthElevation(0, direction->azimuthIndex, direction->elevation, kernelL, kernelR, frameDelayL, frameDelayR);
+
+        const float * input = direction->input.data();
+
+        // First run through delay lines for inter-aural time difference.
+        direction->delayL.setDelayFrames(frameDelayL);
+        direction->delayR.setDelayFrames(frameDelayR);
+        direction->delayL.process(r, input, tempL, bufferSize);
+        direction->delayR.process(r, input, tempR, bufferSize);
+
+        direction->convolverL.process(kernelL->realData(), kernelL->imagData(), tempL, tempL, bufferSize);
+        direction->convolverR.process(kernelR->realData(), kernelR->imagData(), tempR, tempR, bufferSize);
+
+        vadd(destinationL, 1, tempL, 1, destinationL, 1, bufferSize);
+        vadd(destinationR, 1, tempR, 1, destinationR, 1, bufferSize);
+
+        direction->input.zero();
+        ++i;
+    }
+
+    m_activeDirectionCount.store(static_cast<int>(m_activeDirections.size()), std::memory_order_relaxed);
+}
+
+void HRTFMixerNode::reset(ContextRenderLock &)
+{
+    for (Direction * direction : m_activeDirections)
+    {
+        m_directionByKey[direction->key] = nullptr;
+        direction->reset();
+        m_freeDirections.push_back(direction);
+    }
+    m_activeDirections.clear();
+    m_activeDirectionCount.store(0, std::memory_order_relaxed);
+
+    for (auto & source : m_sources)
+    {
+        source->key = -1;
+        source->fadingFromKey = -1;
+        source->fade = 1.f;
+        source->gain = -1.f;
+    }
+}
+
+double HRTFMixerNode::tailTime(ContextRenderLock & r) const
+{
+    // as an HRTFPanner's, the delay lines' and the convolvers' tails
+    return MaxDelayTimeSeconds + (HRTFPanner::fftSizeForSampleRate(m_sampleRate) / 2) / static_cast<double>(r.context()->sampleRate());
+}
+
+double HRTFMixerNode::latencyTime(ContextRenderLock & r) const
+{
+    return (HRTFPanner::fftSizeForSampleRate(m_sampleRate) / 2) / static_cast<double>(r.context()->sampleRate());
+}
+
+}  // namespace lab
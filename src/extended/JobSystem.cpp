@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/core/RenderTrace.h"
+
+#include "internal/DenormalDisabler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace lab
+{
+
+namespace
+{
+    std::mutex s_sharedLock;
+    JobSystem::Settings s_sharedSettings;
+    JobSystem * s_shared = nullptr;  // never destroyed, so that jobs may run during exit
+}
+
+JobSystem & JobSystem::shared()
+{
+    std::lock_guard<std::mutex> lock(s_sharedLock);
+    if (!s_shared)
+        s_shared = new JobSystem(s_sharedSettings);
+    return *s_shared;
+}
+
+bool JobSystem::configure(const Settings & settings)
+{
+    std::lock_guard<std::mutex> lock(s_sharedLock);
+    if (s_shared)
+        return false;
+    s_sharedSettings = settings;
+    return true;
+}
+
+JobSystem::JobSystem()
+    : JobSystem(Settings())
+{
+}
+
+JobSystem::JobSystem(const Settings & settings)
+{
+    int workerCount = settings.workerCount;
+    if (workerCount <= 0)
+        workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+
+    for (int i = 0; i < workerCount; ++i)
+        m_workers.emplace_back(&JobSystem::workerLoop, this, settings.scheduling);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shouldExit = true;
+    }
+    m_wake.notify_all();
+    for (auto & worker : m_workers)
+        worker.join();
+}
+
+void JobSystem::submit(std::function<void()> job, JobPriority priority)
+{
+    if (!job)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[static_cast<int>(priority)].push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+bool JobSystem::popJob(std::function<void()> & job, JobPriority lowest)
+{
+    for (int i = 0; i <= static_cast<int>(lowest); ++i)
+        if (!m_queues[i].empty())
+        {
+            job = std::move(m_queues[i].front());
+            m_queues[i].pop_front();
+            return true;
+        }
+    return false;
+}
+
+size_t JobSystem::queued() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (auto & queue : m_queues)
+        count += queue.size();
+    return count;
+}
+
+void JobSystem::wait(const std::function<bool()> & done, JobPriority helpWith)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!done())
+    {
+        std::function<void()> job;
+        if (popJob(job, helpWith))
+        {
+            lock.unlock();
+            {
+                TraceScope trace("job", "job");
+                job();
+            }
+            job = nullptr;
+            lock.lock();
+            m_finished.notify_all();
+        }
+        else
+        {
+            // done() is usually made true by a job, which notifies as it finishes; the
+            // timeout covers anything else that makes it true
+            m_finished.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+}
+
+void JobSystem::workerLoop(const ThreadScheduling & scheduling)
+{
+    // jobs decode and convolve impulse responses, and render offline
+    DenormalDisabler denormalDisabler;
+    ScopedThreadScheduling scoped(scheduling);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        std::function<void()> job;
+        if (popJob(job, JobPriority::Background))
+        {
+            lock.unlock();
+            RenderTrace::nameThread("LabSound job worker");
+            {
+                TraceScope trace("job", "job");
+                job();
+            }
+            job = nullptr;  // released before the lock is taken, as its captures may take it
+            lock.lock();
+            m_finished.notify_all();
+            continue;
+        }
+
+        // the queues are drained before the workers stop
+        if (m_shouldExit)
+            return;
+        m_wake.wait(lock);
+    }
+}
+
+}  // lab
@@ -110,54 +110,440 @@ void log_set_quiet(int enable) {
 }
 
 
-void LabSoundLog(int level, const char *file, int line, const char *fmt, ...) {
-  if (level < L.level) {
-    return;
-  }
-
-  /* Acquire lock */
+/* Writes a formatted message, holding the user's lock */
+static void log_emit(int level, const char *file, int line, time_t t, const char *message) {
   lock();
 
-  /* Get current time */
-  time_t t = time(NULL);
   struct tm *lt = localtime(&t);
 
   /* Log to stderr */
   if (!L.quiet) {
-    va_list args;
     char buf[16];
     buf[strftime(buf, sizeof(buf), "%H:%M:%S", lt)] = '\0';
 #ifdef LOG_USE_COLOR
     fprintf(
-      stderr, "%s %s%-5s\x1b[0m \x1b[90m%s:%d:\x1b[0m ",
-      buf, level_colors[level], level_names[level], file, line);
+      stderr, "%s %s%-5s\x1b[0m \x1b[90m%s:%d:\x1b[0m %s\n",
+      buf, level_colors[level], level_names[level], file, line, message);
 #else
-    fprintf(stderr, "%s %-5s %s:%d: ", buf, level_names[level], file, line);
+    fprintf(stderr, "%s %-5s %s:%d: %s\n", buf, level_names[level], file, line, message);
 #endif
-    va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
-    va_end(args);
-    fprintf(stderr, "\n");
     fflush(stderr);
   }
 
   /* Log to file */
   if (L.fp) {
-    va_list args;
     char buf[32];
     buf[strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", lt)] = '\0';
-    fprintf(L.fp, "%s %-5s %s:%d: ", buf, level_names[level], file, line);
-    va_start(args, fmt);
-    vfprintf(L.fp, fmt, args);
-    va_end(args);
-    fprintf(L.fp, "\n");
+    fprintf(L.fp, "%s %-5s %s:%d: %s\n", buf, level_names[level], file, line, message);
     fflush(L.fp);
   }
 
-  /* Release lock */
   unlock();
 }
 
+
+/*
+ * Asynchronous logging
+ *
+ * With async logging enabled, a message is captured as a fixed size record of its format,
+ * source location, time, and arguments, without formatting it, and pushed onto a bounded
+ * lock free queue. A writer thread formats and writes the records. Capturing takes no lock,
+ * allocation or system call, so it is safe on the audio thread. The format must be a string
+ * that outlives the program, as a literal does; string arguments are copied into the record,
+ * and truncated if they don't fit. A message that finds the queue full is dropped, and the
+ * writer reports how many were.
+ */
+
+namespace {
+
+const int LogRecordCount = 1024;   /* a power of two */
+const int LogPayloadSize = 224;
+const int LogMaxMessage = 1024;
+
+struct LogRecord {
+  std::atomic<uint32_t> sequence;
+  int level;
+  int line;
+  const char *file;
+  const char *fmt;
+  time_t time;
+  int size;      /* bytes of payload used */
+  bool truncated;
+  unsigned char payload[LogPayloadSize];
+};
+
+/* A bounded multiple producer queue of records, after Dmitry Vyukov's */
+struct LogQueue {
+  LogRecord records[LogRecordCount];
+  std::atomic<uint32_t> head {0};   /* the next record to claim */
+  uint32_t tail = 0;                /* the next record to write; the writer's own */
+  std::atomic<uint32_t> dropped {0};
+
+  LogQueue() {
+    for (uint32_t i = 0; i < LogRecordCount; ++i)
+      records[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  LogRecord *claim() {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    for (;;) {
+      LogRecord &r = records[position & (LogRecordCount - 1)];
+      const int32_t difference = static_cast<int32_t>(r.sequence.load(std::memory_order_acquire) - position);
+      if (difference == 0) {
+        if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          return &r;
+      }
+      else if (difference < 0) {
+        return nullptr;
+      }
+      else {
+        position = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void publish(LogRecord *r) {
+    const uint32_t position = r->sequence.load(std::memory_order_relaxed);
+    r->sequence.store(position + 1, std::memory_order_release);
+  }
+
+  LogRecord *next() {
+    LogRecord &r = records[tail & (LogRecordCount - 1)];
+    if (r.sequence.load(std::memory_order_acquire) != tail + 1)
+      return nullptr;
+    return &r;
+  }
+
+  void release(LogRecord *r) {
+    r->sequence.store(tail + LogRecordCount, std::memory_order_release);
+    ++tail;
+  }
+};
+
+/* The parts of a printf conversion that the record and the writer agree on */
+struct LogConversion {
+  enum Kind { None, Literal, Integer, Unsigned, Real, String, Pointer, Count };
+  Kind kind = None;
+  int stars = 0;        /* width and precision arguments */
+  bool isLong = false;  /* an l, ll, z, j or t length */
+  bool isLongDouble = false;
+  const char *start = nullptr;
+  const char *end = nullptr;
+};
+
+/* Parses the conversion starting at the % at fmt */
+LogConversion log_parse_conversion(const char *fmt) {
+  LogConversion c;
+  c.start = fmt++;
+  if (*fmt == '%') {
+    c.kind = LogConversion::Literal;
+    c.end = fmt + 1;
+    return c;
+  }
+  while (*fmt && strchr("-+ #0'", *fmt)) ++fmt;
+  if (*fmt == '*') { ++c.stars; ++fmt; }
+  while (*fmt >= '0' && *fmt <= '9') ++fmt;
+  if (*fmt == '.') {
+    ++fmt;
+    if (*fmt == '*') { ++c.stars; ++fmt; }
+    while (*fmt >= '0' && *fmt <= '9') ++fmt;
+  }
+  while (*fmt && strchr("hlLqjzt", *fmt)) {
+    if (strchr("lqjzt", *fmt))
+      c.isLong = true;
+    if (*fmt == 'L')
+      c.isLongDouble = true;
+    ++fmt;
+  }
+  switch (*fmt) {
+    case 'd': case 'i': c.kind = LogConversion::Integer; break;
+    case 'u': case 'o': case 'x': case 'X': c.kind = LogConversion::Unsigned; break;
+    case 'c': c.kind = LogConversion::Integer; c.isLong = false; break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': c.kind = LogConversion::Real; break;
+    case 's': c.kind = LogConversion::String; break;
+    case 'p': c.kind = LogConversion::Pointer; break;
+    case 'n': c.kind = LogConversion::Count; break;
+    default: c.kind = LogConversion::None; break;
+  }
+  c.end = *fmt ? fmt + 1 : fmt;
+  return c;
+}
+
+template <typename T>
+bool log_put(LogRecord *r, const T &value) {
+  if (r->size + static_cast<int>(sizeof(T)) > LogPayloadSize)
+    return false;
+  memcpy(r->payload + r->size, &value, sizeof(T));
+  r->size += static_cast<int>(sizeof(T));
+  return true;
+}
+
+template <typename T>
+bool log_get(const LogRecord *r, int &offset, T &value) {
+  if (offset + static_cast<int>(sizeof(T)) > r->size)
+    return false;
+  memcpy(&value, r->payload + offset, sizeof(T));
+  offset += static_cast<int>(sizeof(T));
+  return true;
+}
+
+/* Copies the arguments the format names into the record */
+void log_capture(LogRecord *r, const char *fmt, va_list args) {
+  r->size = 0;
+  r->truncated = false;
+  for (const char *p = strchr(fmt, '%'); p && *p; p = strchr(p, '%')) {
+    LogConversion c = log_parse_conversion(p);
+    p = c.end;
+    bool fits = true;
+    for (int i = 0; i < c.stars && fits; ++i)
+      fits = log_put(r, va_arg(args, int));
+    switch (c.kind) {
+      case LogConversion::Integer:
+        fits = fits && log_put(r, c.isLong ? va_arg(args, long long) : static_cast<long long>(va_arg(args, int)));
+        break;
+      case LogConversion::Unsigned:
+        fits = fits && log_put(r, c.isLong ? va_arg(args, unsigned long long) : static_cast<unsigned long long>(va_arg(args, unsigned int)));
+        break;
+      case LogConversion::Real:
+        fits = fits && log_put(r, c.isLongDouble ? static_cast<double>(va_arg(args, long double)) : va_arg(args, double));
+        break;
+      case LogConversion::Pointer:
+      case LogConversion::Count:
+        fits = fits && log_put(r, va_arg(args, void *));
+        break;
+      case LogConversion::String: {
+        const char *str = va_arg(args, const char *);
+        if (!str)
+          str = "(null)";
+        const int room = LogPayloadSize - r->size;
+        const int length = static_cast<int>(strnlen(str, static_cast<size_t>(room > 0 ? room : 0)));
+        if (room <= 0)
+          fits = false;
+        else {
+          const int copied = length < room ? length : room - 1;
+          memcpy(r->payload + r->size, str, static_cast<size_t>(copied));
+          r->payload[r->size + copied] = '\0';
+          r->size += copied + 1;
+          r->truncated = r->truncated || copied < length;
+        }
+        break;
+      }
+      case LogConversion::Literal:
+      case LogConversion::None:
+        break;
+    }
+    if (!fits) {
+      /* the remaining arguments are left out */
+      r->truncated = true;
+      return;
+    }
+  }
+}
+
+/* Formats a record's message into message */
+void log_format(const LogRecord *r, char *message, int size) {
+  int used = 0;
+  int offset = 0;
+  auto append = [&](int written) { if (written > 0) used = used + written < size ? used + written : size - 1; };
+
+  const char *p = r->fmt;
+  while (*p && used < size - 1) {
+    const char *percent = strchr(p, '%');
+    const int literal = percent ? static_cast<int>(percent - p) : static_cast<int>(strlen(p));
+    append(snprintf(message + used, static_cast<size_t>(size - used), "%.*s", literal, p));
+    if (!percent)
+      break;
+
+    LogConversion c = log_parse_conversion(percent);
+    p = c.end;
+    if (c.kind == LogConversion::Literal) {
+      append(snprintf(message + used, static_cast<size_t>(size - used), "%%"));
+      continue;
+    }
+
+    /* the conversion, with its stars replaced by their values and its length by the recorded one */
+    char spec[64];
+    int specLength = 0;
+    bool complete = true;
+    for (const char *q = c.start; q < c.end - 1 && specLength < 40; ++q) {
+      if (*q == '*') {
+        int value = 0;
+        complete = complete && log_get(r, offset, value);
+        specLength += snprintf(spec + specLength, sizeof(spec) - specLength, "%d", value);
+      }
+      else if (!strchr("hlLqjzt", *q)) {
+        spec[specLength++] = *q;
+      }
+    }
+    if ((c.kind == LogConversion::Integer || c.kind == LogConversion::Unsigned) && *(c.end - 1) != 'c') {
+      spec[specLength++] = 'l';
+      spec[specLength++] = 'l';
+    }
+    spec[specLength++] = *(c.end - 1);
+    spec[specLength] = '\0';
+
+    switch (c.kind) {
+      case LogConversion::Integer: {
+        long long value = 0;
+        complete = complete && log_get(r, offset, value);
+        if (complete) append(*(c.end - 1) == 'c' ? snprintf(message + used, static_cast<size_t>(size - used), spec, static_cast<int>(value))
+                                                 : snprintf(message + used, static_cast<size_t>(size - used), spec, value));
+        break;
+      }
+      case LogConversion::Unsigned: {
+        unsigned long long value = 0;
+        complete = complete && log_get(r, offset, value);
+        if (complete) append(snprintf(message + used, static_cast<size_t>(size - used), spec, value));
+        break;
+      }
+      case LogConversion::Real: {
+        double value = 0;
+        complete = complete && log_get(r, offset, value);
+        if (complete) append(snprintf(message + used, static_cast<size_t>(size - used), spec, value));
+        break;
+      }
+      case LogConversion::Pointer: {
+        void *value = nullptr;
+        complete = complete && log_get(r, offset, value);
+        if (complete) append(snprintf(message + used, static_cast<size_t>(size - used), spec, value));
+        break;
+      }
+      case LogConversion::String: {
+        const char *value = offset < r->size ? reinterpret_cast<const char *>(r->payload + offset) : nullptr;
+        complete = complete && value;
+        if (complete) {
+          offset += static_cast<int>(strlen(value)) + 1;
+          append(snprintf(message + used, static_cast<size_t>(size - used), spec, value));
+        }
+        break;
+      }
+      case LogConversion::Count: {
+        void *ignored = nullptr;
+        log_get(r, offset, ignored);
+        break;
+      }
+      case LogConversion::Literal:
+      case LogConversion::None:
+        break;
+    }
+    if (!complete)
+      break;
+  }
+
+  if (r->truncated)
+    append(snprintf(message + used, static_cast<size_t>(size - used), " [truncated]"));
+}
+
+/* Never destroyed, so that messages logged as the program exits are still written */
+struct LogWriter {
+  LogQueue queue;
+  std::atomic<bool> enabled {false};
+  std::mutex lock;     /* held while starting, stopping or draining */
+  std::thread thread;
+  std::atomic<bool> running {false};
+  bool stopsAtExit = false;
+
+  void drain() {
+    char message[LogMaxMessage];
+    while (LogRecord *r = queue.next()) {
+      log_format(r, message, sizeof(message));
+      log_emit(r->level, r->file, r->line, r->time, message);
+      queue.release(r);
+    }
+    const uint32_t dropped = queue.dropped.exchange(0);
+    if (dropped) {
+      snprintf(message, sizeof(message), "%u log messages were dropped", dropped);
+      log_emit(LOGLEVEL_WARN, __FILE__, __LINE__, time(NULL), message);
+    }
+  }
+
+  void start() {
+    std::lock_guard<std::mutex> guard(lock);
+    enabled.store(true);
+    if (running.load())
+      return;
+    if (!stopsAtExit) {
+      stopsAtExit = true;
+      atexit([]() { log_set_async(0); });
+    }
+    running.store(true);
+    thread = std::thread([this]() {
+      while (running.load()) {
+        {
+          std::lock_guard<std::mutex> draining(lock);
+          drain();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+    });
+  }
+
+  void stop() {
+    enabled.store(false);
+    running.store(false);
+    if (thread.joinable())
+      thread.join();
+    std::lock_guard<std::mutex> guard(lock);
+    drain();
+  }
+};
+
+LogWriter &log_writer() {
+  static LogWriter *writer = new LogWriter();
+  return *writer;
+}
+
+}  // namespace
+
+
+void log_set_async(int enable) {
+  if (enable)
+    log_writer().start();
+  else
+    log_writer().stop();
+}
+
+
+void log_flush(void) {
+  LogWriter &writer = log_writer();
+  std::lock_guard<std::mutex> guard(writer.lock);
+  writer.drain();
+}
+
+
+void LabSoundLog(int level, const char *file, int line, const char *fmt, ...) {
+  if (level < L.level) {
+    return;
+  }
+
+  LogWriter &writer = log_writer();
+  if (writer.enabled.load(std::memory_order_relaxed)) {
+    LogRecord *r = writer.queue.claim();
+    if (!r) {
+      writer.queue.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    r->level = level;
+    r->file = file;
+    r->line = line;
+    r->fmt = fmt;
+    r->time = time(NULL);
+    va_list args;
+    va_start(args, fmt);
+    log_capture(r, fmt, args);
+    va_end(args);
+    writer.queue.publish(r);
+    return;
+  }
+
+  char message[LogMaxMessage];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  log_emit(level, file, line, time(NULL), message);
+}
+
 void LabSoundAssertLog(const char * file_, int line, const char * function_, const char * assertion_)
 {
     const char * file = file_ ? file_ : "Unknown source file";
@@ -225,6 +611,11 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext& ac)->AudioNode* { return new GainNode(ac); },
             [](AudioNode* n) { delete n; });
         
+        reg.Register(
+            IIRFilterNode::static_name(), IIRFilterNode::desc(),
+            [](AudioContext& ac)->AudioNode* { return new IIRFilterNode(ac); },
+            [](AudioNode* n) { delete n; });
+        
         reg.Register(
             OscillatorNode::static_name(), OscillatorNode::desc(),
             [](AudioContext& ac)->AudioNode* { return new OscillatorNode(ac); },
@@ -252,11 +643,21 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
         
         // extended
         
+        reg.Register(
+            AmbisonicDecoderNode::static_name(), AmbisonicDecoderNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new AmbisonicDecoderNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             ADSRNode::static_name(), ADSRNode::desc(),
            [](AudioContext& ac)->AudioNode* { return new ADSRNode(ac); },
            [](AudioNode* n) { delete n; });
         
+        reg.Register(
+            BlockProcessorNode::static_name(), BlockProcessorNode::desc(),
+            [](AudioContext& ac)->AudioNode* { return new BlockProcessorNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             ClipNode::static_name(), ClipNode::desc(),
             [](AudioContext& ac)->AudioNode* { return new ClipNode(ac); },
@@ -267,6 +668,21 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext& ac)->AudioNode* { return new DiodeNode(ac); },
             [](AudioNode* n) { delete n; });
         
+        reg.Register(
+            EarlyReflectionsNode::static_name(), EarlyReflectionsNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new EarlyReflectionsNode(ac); },
+            [](AudioNode * n) { delete n; });
+
+        reg.Register(
+            EqualizerNode::static_name(), EqualizerNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new EqualizerNode(ac); },
+            [](AudioNode * n) { delete n; });
+
+        reg.Register(
+            FDNReverbNode::static_name(), FDNReverbNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new FDNReverbNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             FunctionNode::static_name(), FunctionNode::desc(),
             [](AudioContext& ac)->AudioNode* { return new FunctionNode(ac); },
@@ -277,6 +693,26 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext& ac)->AudioNode* { return new GranulationNode(ac); },
             [](AudioNode* n) { delete n; });
         
+        reg.Register(
+            HRTFMixerNode::static_name(), HRTFMixerNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new HRTFMixerNode(ac); },
+            [](AudioNode * n) { delete n; });
+
+        reg.Register(
+            LimiterNode::static_name(), LimiterNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new LimiterNode(ac); },
+            [](AudioNode * n) { delete n; });
+
+        reg.Register(
+            LoudnessMeterNode::static_name(), LoudnessMeterNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new LoudnessMeterNode(ac); },
+            [](AudioNode * n) { delete n; });
+
+        reg.Register(
+            MixerNode::static_name(), MixerNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new MixerNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             NoiseNode::static_name(), NoiseNode::desc(),
            [](AudioContext& ac)->AudioNode* { return new NoiseNode(ac); },
@@ -287,6 +723,11 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext & ac) -> AudioNode * { return new PeakCompNode(ac); },
             [](AudioNode * n) { delete n; });
 
+        reg.Register(
+            PolyBLEPBankNode::static_name(), PolyBLEPBankNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new PolyBLEPBankNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             PolyBLEPNode::static_name(), PolyBLEPNode::desc(),
             [](AudioContext & ac) -> AudioNode * { return new PolyBLEPNode(ac); },
@@ -302,7 +743,12 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext& ac)->AudioNode* { return new PWMNode(ac); },
             [](AudioNode* n) { delete n; });
         
-        //reg.Register(PdNode::static_name());
+#ifdef PD
+        reg.Register(
+            PdNode::static_name(), PdNode::desc(),
+            [](AudioContext& ac)->AudioNode* { return new PdNode(ac); },
+            [](AudioNode* n) { delete n; });
+#endif
         
         reg.Register(
             RecorderNode::static_name(), RecorderNode::desc(),
@@ -318,7 +764,17 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             SpectralMonitorNode::static_name(), SpectralMonitorNode::desc(),
             [](AudioContext& ac)->AudioNode* { return new SpectralMonitorNode(ac); },
             [](AudioNode* n) { delete n; });
+
+        reg.Register(
+            SpectralProcessorNode::static_name(), SpectralProcessorNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new SpectralProcessorNode(ac); },
+            [](AudioNode * n) { delete n; });
         
+        reg.Register(
+            StreamingAudioNode::static_name(), StreamingAudioNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new StreamingAudioNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             SupersawNode::static_name(), SupersawNode::desc(),
             [](AudioContext& ac)->AudioNode* { return new SupersawNode(ac); },
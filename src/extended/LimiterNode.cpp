@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/LimiterNode.h"
+#include "LabSound/extended/Registry.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioProcessor.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Lanes4.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace lab
+{
+
+static AudioParamDescriptor s_limParams[] = {
+    {"ceiling", "CEIL", -1.0,  -60,    0},
+    {"release", "RELS", 100.0,   1, 5000}, nullptr};
+
+static AudioSettingDescriptor s_limSettings[] = {{"lookahead", "LOOK", SettingType::Float}, nullptr};
+
+AudioNodeDescriptor * LimiterNode::desc()
+{
+    static AudioNodeDescriptor d {s_limParams, s_limSettings, 1};
+    return &d;
+}
+
+////////////////////////////////////////
+// Private LimiterNode Implementation //
+////////////////////////////////////////
+
+// Each frame asks for the gain that brings its loudest channel down to the ceiling. The
+// least gain asked for over the lookahead window is found with a monotonic queue, in
+// constant time per frame however long the window, and is allowed to recover at the
+// release rate. That gain envelope is then averaged over the window, which turns each
+// drop into a ramp as long as the lookahead. Every frame averaged into the gain for a
+// delayed frame has held it within reach, so the ramp always arrives at or below the gain
+// that frame needs.
+class LimiterNode::LimiterNodeInternal : public AudioProcessor
+{
+public:
+    LimiterNodeInternal() : AudioProcessor() {}
+    virtual ~LimiterNodeInternal() {}
+
+    virtual void initialize() override {}
+    virtual void uninitialize() override {}
+
+    virtual void process(ContextRenderLock & r, const AudioBus * sourceBus, AudioBus * destinationBus, int framesToProcess) override
+    {
+        const int channels = std::min(sourceBus->numberOfChannels(), destinationBus->numberOfChannels());
+        if (!channels)
+            return;
+
+        const float sampleRate = r.context()->sampleRate();
+        configure(sampleRate, m_lookahead->valueFloat(), channels);
+
+        const float ceiling = powf(10.f, std::min(m_ceiling->value(), 0.f) * 0.05f);
+        const double release = std::max(m_release->value(), 1.f) * 0.001;
+        const float recovery = static_cast<float>(1.0 - exp(-1.0 / (release * sampleRate)));
+
+        if (m_gain.size() < static_cast<size_t>(framesToProcess))
+            m_gain.resize(framesToProcess);
+        float * gain = m_gain.data();
+
+        // the peak of each frame across the channels, four frames at a time
+        int i = 0;
+        for (; i + 4 <= framesToProcess; i += 4)
+        {
+            Lanes4 peak(0.f);
+            for (int c = 0; c < channels; ++c)
+                peak = maxOf(peak, absOf(Lanes4::load(sourceBus->channel(c)->data() + i)));
+            peak.store(gain + i);
+        }
+        for (; i < framesToProcess; ++i)
+        {
+            float peak = 0.f;
+            for (int c = 0; c < channels; ++c)
+                peak = std::max(peak, fabsf(sourceBus->channel(c)->data()[i]));
+            gain[i] = peak;
+        }
+
+        // and from it the gain each frame asks for
+        i = 0;
+        const Lanes4 ceiling4(ceiling);
+        for (; i + 4 <= framesToProcess; i += 4)
+        {
+            const Lanes4 peak = Lanes4::load(gain + i);
+            select(peak > ceiling4, ceiling4 / peak, Lanes4(1.f)).store(gain + i);
+        }
+        for (; i < framesToProcess; ++i)
+            gain[i] = gain[i] > ceiling ? ceiling / gain[i] : 1.f;
+
+        for (i = 0; i < framesToProcess; ++i)
+        {
+            // drop the oldest frame from the window, and the gains the newest overrules
+            const uint64_t frame = m_frame++;
+            if (m_queueSize && m_queue[m_queueHead].frame + m_window <= frame)
+            {
+                m_queueHead = m_queueHead + 1 == m_window ? 0 : m_queueHead + 1;
+                --m_queueSize;
+            }
+            while (m_queueSize && m_queue[tail()].gain >= gain[i])
+                --m_queueSize;
+            ++m_queueSize;
+            m_queue[tail()] = {gain[i], frame};
+            const float least = m_queue[m_queueHead].gain;
+
+            // fall at once, recover at the release rate
+            m_envelope = least < m_envelope ? least : m_envelope + (least - m_envelope) * recovery;
+
+            m_sum += m_envelope - m_history[m_historyIndex];
+            m_history[m_historyIndex] = m_envelope;
+            if (++m_historyIndex == m_window)
+            {
+                // resum once a window, so rounding errors don't accumulate in the sum
+                m_historyIndex = 0;
+                m_sum = 0;
+                for (float g : m_history)
+                    m_sum += g;
+            }
+            gain[i] = static_cast<float>(m_sum / m_window);
+        }
+
+        // delay each channel by the lookahead and apply the gain
+        const int delay = m_window - 1;
+        for (int c = 0; c < channels; ++c)
+        {
+            if (m_lines[c].size() < static_cast<size_t>(delay + framesToProcess))
+                m_lines[c].resize(delay + framesToProcess);
+            float * line = m_lines[c].data();
+            memcpy(line + delay, sourceBus->channel(c)->data(), sizeof(float) * framesToProcess);
+            VectorMath::vmul(line, 1, gain, 1, destinationBus->channel(c)->mutableData(), 1, framesToProcess);
+            memmove(line, line + framesToProcess, sizeof(float) * delay);
+        }
+        for (int c = channels; c < destinationBus->numberOfChannels(); ++c)
+            destinationBus->channel(c)->zero();
+    }
+
+    virtual void reset() override
+    {
+        m_queueHead = 0;
+        m_queueSize = 0;
+        m_frame = 0;
+        m_envelope = 1.f;
+        std::fill(m_history.begin(), m_history.end(), 1.f);
+        m_historyIndex = 0;
+        m_sum = m_window;
+        for (auto & line : m_lines)
+            std::fill(line.begin(), line.end(), 0.f);
+    }
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override
+    {
+        return m_sampleRate > 0 ? (m_window - 1) / static_cast<double>(m_sampleRate) : 0;
+    }
+
+    std::shared_ptr<AudioParam> m_ceiling;
+    std::shared_ptr<AudioParam> m_release;
+    std::shared_ptr<AudioSetting> m_lookahead;
+
+private:
+    int tail() const
+    {
+        const int t = m_queueHead + m_queueSize - 1;
+        return t >= m_window ? t - m_window : t;
+    }
+
+    // the delay lines hold the lookahead, plus room for a quantum
+    void configure(float sampleRate, float lookaheadMs, int channels)
+    {
+        const int window = std::max(1, static_cast<int>(std::lround(std::max(lookaheadMs, 0.f) * 0.001 * sampleRate)) + 1);
+        if (sampleRate == m_sampleRate && window == m_window && channels == static_cast<int>(m_lines.size()))
+            return;
+
+        m_sampleRate = sampleRate;
+        m_window = window;
+        m_queue.resize(window);
+        m_history.resize(window);
+        m_lines.resize(channels);
+        for (auto & line : m_lines)
+            line.resize(window - 1 + AudioNode::ProcessingSizeInFrames);
+        reset();
+    }
+
+    struct Request
+    {
+        float gain;
+        uint64_t frame;
+    };
+
+    float m_sampleRate = 0;
+    int m_window = 1;  // the lookahead in frames, plus the current frame
+
+    // the gains requested within the window, increasing from the head
+    std::vector<Request> m_queue;
+    int m_queueHead = 0;
+    int m_queueSize = 0;
+    uint64_t m_frame = 0;
+
+    float m_envelope = 1.f;
+    std::vector<float> m_history;
+    int m_historyIndex = 0;
+    double m_sum = 1;
+
+    std::vector<float> m_gain;
+    std::vector<std::vector<float>> m_lines;
+};
+
+std::shared_ptr<AudioParam> LimiterNode::ceiling() const
+{
+    return internalNode->m_ceiling;
+}
+
+std::shared_ptr<AudioParam> LimiterNode::release() const
+{
+    return internalNode->m_release;
+}
+
+std::shared_ptr<AudioSetting> LimiterNode::lookahead() const
+{
+    return internalNode->m_lookahead;
+}
+
+////////////////////////
+// Public LimiterNode //
+////////////////////////
+
+LimiterNode::LimiterNode(AudioContext & ac)
+    : AudioBasicProcessorNode(ac, *desc())
+{
+    m_processor.reset(new LimiterNodeInternal());
+
+    internalNode = static_cast<LimiterNodeInternal *>(m_processor.get());
+    internalNode->m_ceiling = param("ceiling");
+    internalNode->m_release = param("release");
+    internalNode->m_lookahead = setting("lookahead");
+    internalNode->m_lookahead->setFloat(5.f);
+    initialize();
+}
+
+LimiterNode::~LimiterNode()
+{
+    uninitialize();
+}
+
+}  // namespace lab
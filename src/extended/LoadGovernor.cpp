@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/LoadGovernor.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/PannerNode.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+void LoadGovernor::addVoice(std::shared_ptr<AudioNode> voice, int priority)
+{
+    if (!voice)
+        return;
+    std::weak_ptr<AudioNode> weak = voice;
+    addStep(voice->name(), priority, [weak](bool shed) {
+        if (auto n = weak.lock())
+            n->setBypassed(shed);
+    });
+    _entries.back()->node = voice;
+    _entries.back()->hasNode = true;
+}
+
+void LoadGovernor::addEffect(std::shared_ptr<AudioNode> effect, int priority)
+{
+    // bypassing a node with inputs passes the first through, so an effect is shed the same way
+    addVoice(std::move(effect), priority);
+}
+
+void LoadGovernor::addPanner(std::shared_ptr<PannerNode> panner, int priority)
+{
+    if (!panner)
+        return;
+    std::weak_ptr<PannerNode> weak = panner;
+    addStep(panner->name(), priority, [weak](bool shed) {
+        if (auto n = weak.lock())
+            n->setSpatialTier(shed ? SpatialTier::EqualPower : SpatialTier::Model);
+    });
+    _entries.back()->node = panner;
+    _entries.back()->hasNode = true;
+}
+
+void LoadGovernor::addStep(const std::string & name, int priority, Step step)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->name = name;
+    entry->priority = priority;
+    entry->step = std::move(step);
+    _entries.push_back(entry);
+}
+
+void LoadGovernor::restore(Entry & entry)
+{
+    if (!entry.shed)
+        return;
+    entry.shed = false;
+    entry.step(false);
+    _shed.erase(std::remove_if(_shed.begin(), _shed.end(),
+                               [&entry](const std::shared_ptr<Entry> & e) { return e.get() == &entry; }),
+                _shed.end());
+}
+
+void LoadGovernor::remove(const std::shared_ptr<AudioNode> & node)
+{
+    for (auto & e : _entries)
+        if (e->hasNode && e->node.lock() == node)
+            restore(*e);
+    _entries.erase(std::remove_if(_entries.begin(), _entries.end(),
+                                  [&node](const std::shared_ptr<Entry> & e) { return e->hasNode && e->node.lock() == node; }),
+                   _entries.end());
+}
+
+void LoadGovernor::remove(const std::string & name)
+{
+    for (auto & e : _entries)
+        if (e->name == name)
+            restore(*e);
+    _entries.erase(std::remove_if(_entries.begin(), _entries.end(),
+                                  [&name](const std::shared_ptr<Entry> & e) { return e->name == name; }),
+                   _entries.end());
+}
+
+void LoadGovernor::forgetExpired()
+{
+    auto expired = [](const std::shared_ptr<Entry> & e) { return e->hasNode && e->node.expired(); };
+    _entries.erase(std::remove_if(_entries.begin(), _entries.end(), expired), _entries.end());
+    _shed.erase(std::remove_if(_shed.begin(), _shed.end(), expired), _shed.end());
+}
+
+void LoadGovernor::change(AudioContext & ac, Entry & entry, bool shed)
+{
+    entry.shed = shed;
+    entry.step(shed);
+    if (!_listener)
+        return;
+
+    Event event = {entry.name, entry.priority, shed, _loadPercent};
+    auto listener = _listener;
+    std::function<void()> fn = [listener, event]() { listener(event); };
+    ac.enqueueEvent(fn);
+}
+
+void LoadGovernor::update(AudioContext & ac)
+{
+    forgetExpired();
+
+    // the device's callback load, or failing that, the render time against the quantum
+    std::shared_ptr<AudioDestinationNode> destination = ac.destinationNode();
+    if (!destination)
+        return;
+    if (AudioDevice * device = destination->device())
+        _loadPercent = device->loadStats().averageLoadPercent;
+    else
+    {
+        const ProfileStats stats = destination->renderTimeStats(64);
+        const float quantumMicroseconds = 1.e6f * ac.renderQuantumSize() / ac.sampleRate();
+        _loadPercent = stats.count ? 100.f * stats.mean / quantumMicroseconds : 0.f;
+    }
+
+    if (_loadPercent > _settings.thresholdPercent)
+    {
+        _quietUpdates = 0;
+
+        std::shared_ptr<Entry> next;
+        double nextCost = 0;
+        for (auto & e : _entries)
+        {
+            if (e->shed)
+                continue;
+            std::shared_ptr<AudioNode> node = e->node.lock();
+            const double cost = node ? node->selfTimeStats(64).mean : 0.0;
+            if (!next || e->priority < next->priority || (e->priority == next->priority && cost > nextCost))
+            {
+                next = e;
+                nextCost = cost;
+            }
+        }
+        if (next)
+        {
+            _shed.push_back(next);
+            change(ac, *next, true);
+        }
+    }
+    else if (_loadPercent < _settings.thresholdPercent - _settings.hysteresisPercent && !_shed.empty())
+    {
+        if (++_quietUpdates >= _settings.restoreUpdates)
+        {
+            _quietUpdates = 0;
+            std::shared_ptr<Entry> last = _shed.back();
+            _shed.pop_back();
+            change(ac, *last, false);
+        }
+    }
+    else
+        _quietUpdates = 0;
+}
+
+void LoadGovernor::restoreAll(AudioContext & ac)
+{
+    while (!_shed.empty())
+    {
+        std::shared_ptr<Entry> last = _shed.back();
+        _shed.pop_back();
+        change(ac, *last, false);
+    }
+    _quietUpdates = 0;
+}
+
+}  // lab
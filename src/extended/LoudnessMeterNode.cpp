@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/LoudnessMeterNode.h"
+#include "LabSound/extended/Registry.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/Macros.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "internal/LoudnessMeter.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace lab
+{
+
+namespace
+{
+    const float Silence = -std::numeric_limits<float>::infinity();
+}
+
+static_assert(static_cast<int>(LoudnessMeterNode::MaxChannels) == static_cast<int>(LoudnessMeter::MaxChannels), "the node meters as many channels as the meter");
+
+AudioNodeDescriptor * LoudnessMeterNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+LoudnessMeterNode::LoudnessMeterNode(AudioContext & ac)
+    : AudioBasicInspectorNode(ac, *desc())
+    , _meter(new LoudnessMeter())
+    , _momentary(Silence)
+    , _shortTerm(Silence)
+    , _integrated(Silence)
+    , _truePeak(Silence)
+{
+    _meter->configure(ac.sampleRate(), 0, 0);
+    initialize();
+}
+
+LoudnessMeterNode::~LoudnessMeterNode()
+{
+    uninitialize();
+}
+
+void LoudnessMeterNode::process(ContextRenderLock & r, int bufferSize)
+{
+    // This node acts as a pass-through if it is embedded in a chain
+
+    AudioBus * outputBus = output(0)->bus(r);
+
+    if (!isInitialized() || !input(0)->isConnected())
+    {
+        if (outputBus)
+            outputBus->zero();
+        return;
+    }
+
+    AudioBus * bus = input(0)->bus(r);
+    bool isBusGood = bus && bus->numberOfChannels() > 0 && bus->channel(0)->length() >= bufferSize;
+    if (!isBusGood)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    LoudnessMeter & meter = *_meter;
+    meter.configure(r.context()->sampleRate(), std::min(static_cast<int>(bus->numberOfChannels()), static_cast<int>(MaxChannels)), bus->layout());
+    if (_resetRequested.exchange(false, std::memory_order_acquire))
+    {
+        meter.resetIntegration();
+        _integrated.store(Silence, std::memory_order_relaxed);
+        _truePeak.store(Silence, std::memory_order_relaxed);
+    }
+
+    for (int offset = 0; offset < bufferSize;)
+    {
+        const int count = std::min(bufferSize - offset, meter.blockFrames - meter.blockPosition);
+        meter.run(bus, offset, count);
+        offset += count;
+
+        if (meter.blockPosition == meter.blockFrames)
+        {
+            float momentary, shortTerm, integrated, truePeak;
+            meter.finishBlock(momentary, shortTerm, integrated, truePeak);
+            _momentary.store(momentary, std::memory_order_relaxed);
+            _shortTerm.store(shortTerm, std::memory_order_relaxed);
+            _integrated.store(integrated, std::memory_order_relaxed);
+            _truePeak.store(truePeak, std::memory_order_relaxed);
+        }
+    }
+
+    if (bus != outputBus)
+        outputBus->copyFrom(*bus);
+}
+
+void LoudnessMeterNode::reset(ContextRenderLock &)
+{
+    _meter->resetFilters();
+    _meter->resetIntegration();
+    _momentary.store(Silence, std::memory_order_relaxed);
+    _shortTerm.store(Silence, std::memory_order_relaxed);
+    _integrated.store(Silence, std::memory_order_relaxed);
+    _truePeak.store(Silence, std::memory_order_relaxed);
+}
+
+}  // namespace lab
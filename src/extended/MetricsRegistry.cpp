@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/MetricsRegistry.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioMemoryPool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace lab
+{
+
+namespace
+{
+    void appendValue(std::string & out, double v)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.17g", v);
+        out += text;
+    }
+
+    // context="main",bus="music" as |#context:main,bus:music
+    std::string dogstatsdTags(const std::string & labels)
+    {
+        std::string tags;
+        for (char c : labels)
+        {
+            if (c == '=')
+                tags += ':';
+            else if (c != '"')
+                tags += c;
+        }
+        return tags.empty() ? tags : "|#" + tags;
+    }
+}
+
+uint64_t MetricsRegistry::Metric::bits(double v)
+{
+    uint64_t b;
+    memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+double MetricsRegistry::Metric::value(uint64_t b)
+{
+    double v;
+    memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+void MetricsRegistry::Metric::add(double v)
+{
+    uint64_t expected = _bits.load(std::memory_order_relaxed);
+    while (!_bits.compare_exchange_weak(expected, bits(value(expected) + v), std::memory_order_relaxed))
+    {
+    }
+}
+
+MetricsRegistry::Metric * MetricsRegistry::counter(const std::string & name, const std::string & help, const std::string & labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return find(name, help, labels, Type::Counter);
+}
+
+MetricsRegistry::Metric * MetricsRegistry::gauge(const std::string & name, const std::string & help, const std::string & labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return find(name, help, labels, Type::Gauge);
+}
+
+MetricsRegistry::Metric * MetricsRegistry::find(const std::string & name, const std::string & help, const std::string & labels, Type type)
+{
+    for (Metric & m : _metrics)
+    {
+        if (m._name == name && m._labels == labels)
+        {
+            m._retired = false;
+            return &m;
+        }
+    }
+    _metrics.emplace_back(name, help, labels, type);
+    return &_metrics.back();
+}
+
+void MetricsRegistry::addContext(std::shared_ptr<AudioContext> context, const std::string & name)
+{
+    if (!context)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    removeContextLocked(context.get());
+
+    Context c;
+    c.context = context;
+    c.labels = "context=\"" + name + "\"";
+    c.dspLoad = find("labsound_dsp_load_percent", "Render time of recent quanta against their duration", c.labels, Type::Gauge);
+    c.callbackLoad = find("labsound_callback_load_percent", "Device callback time against its buffer period, smoothed", c.labels, Type::Gauge);
+    c.xruns = find("labsound_xruns_total", "Underflows and overflows reported by the driver", c.labels, Type::Counter);
+    c.overruns = find("labsound_callback_overruns_total", "Device callbacks that took longer than their buffer period", c.labels, Type::Counter);
+    c.renderStalls = find("labsound_render_stalls_total", "Quanta reported by the render watchdog", c.labels, Type::Counter);
+    c.renderLockMisses = find("labsound_render_lock_misses_total", "Quanta rendered as silence as the render lock was held", c.labels, Type::Counter);
+    c.scheduledNodes = find("labsound_scheduled_nodes", "Nodes in the render schedule", c.labels, Type::Gauge);
+    c.playingSources = find("labsound_playing_sources", "Scheduled source nodes that are playing", c.labels, Type::Gauge);
+    c.pendingConnections = find("labsound_pending_connections", "Connections and graph edits queued for the audio thread", c.labels, Type::Gauge);
+    c.pendingEvents = find("labsound_pending_events", "Node events awaiting dispatch", c.labels, Type::Gauge);
+    c.droppedEvents = find("labsound_dropped_events_total", "Node events dropped as the queue was full", c.labels, Type::Counter);
+    c.eventsDispatched = find("labsound_events_dispatched_total", "Node events dispatched", c.labels, Type::Counter);
+    c.eventLatency = find("labsound_event_latency_seconds_total", "Time node events waited to be dispatched", c.labels, Type::Counter);
+    c.eventLatencyPeak = find("labsound_event_latency_peak_seconds", "Longest wait of a node event since the last export", c.labels, Type::Gauge);
+    _contexts.push_back(c);
+
+    if (!_poolBytes)
+        _poolBytes = find("labsound_memory_pool_bytes", "Bytes of the audio memory pool's arena in use", {}, Type::Gauge);
+}
+
+void MetricsRegistry::removeContext(const std::shared_ptr<AudioContext> & context)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    removeContextLocked(context.get());
+}
+
+void MetricsRegistry::removeContextLocked(const AudioContext * context)
+{
+    for (auto it = _contexts.begin(); it != _contexts.end();)
+    {
+        std::shared_ptr<AudioContext> held = it->context.lock();
+        if (held && held.get() != context)
+        {
+            ++it;
+            continue;
+        }
+
+        // a context removed, or destroyed, stops being exported
+        for (Metric & m : _metrics)
+            if (m._labels == it->labels)
+                m._retired = true;
+        it = _contexts.erase(it);
+    }
+}
+
+void MetricsRegistry::collect()
+{
+    removeContextLocked(nullptr);  // those destroyed
+
+    for (Context & c : _contexts)
+    {
+        std::shared_ptr<AudioContext> context = c.context.lock();
+        if (!context)
+            continue;
+
+        const AudioContextMetrics m = context->metrics();
+        c.renderStalls->set(static_cast<double>(m.renderStalls));
+        c.renderLockMisses->set(static_cast<double>(m.renderLockMisses));
+        c.scheduledNodes->set(m.scheduledNodes);
+        c.playingSources->set(m.playingSources);
+        c.pendingConnections->set(static_cast<double>(m.pendingConnections));
+        c.pendingEvents->set(static_cast<double>(m.pendingEvents));
+        c.droppedEvents->set(static_cast<double>(m.droppedEvents));
+        c.eventsDispatched->set(static_cast<double>(m.eventsDispatched));
+        c.eventLatency->set(m.eventLatencyTotal);
+        c.eventLatencyPeak->set(m.eventLatencyPeak);
+
+        std::shared_ptr<AudioDestinationNode> destination = context->destinationNode();
+        if (!destination)
+            continue;
+
+        const ProfileStats render = destination->renderTimeStats(64);
+        const float quantumMicroseconds = 1.e6f * context->renderQuantumSize() / context->sampleRate();
+        c.dspLoad->set(render.count && quantumMicroseconds > 0 ? 100.0 * render.mean / quantumMicroseconds : 0.0);
+
+        if (AudioDevice * device = destination->device())
+        {
+            const AudioDeviceLoadStats load = device->loadStats();
+            c.callbackLoad->set(load.averageLoadPercent);
+            c.xruns->set(static_cast<double>(load.xruns));
+            c.overruns->set(static_cast<double>(load.overruns));
+        }
+    }
+
+    if (_poolBytes)
+        _poolBytes->set(static_cast<double>(AudioMemoryPool::bytesInUse()));
+}
+
+std::string MetricsRegistry::prometheus()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    collect();
+
+    // the samples of a metric are grouped under one HELP and TYPE, whatever order their
+    // labels were registered in
+    std::string out;
+    std::vector<const Metric *> written;
+    for (const Metric & first : _metrics)
+    {
+        if (first._retired)
+            continue;
+        bool seen = false;
+        for (const Metric * w : written)
+            seen = seen || w->_name == first._name;
+        if (seen)
+            continue;
+        written.push_back(&first);
+
+        out += "# HELP " + first._name + " " + first._help + "\n";
+        out += "# TYPE " + first._name + (first._type == Type::Counter ? " counter\n" : " gauge\n");
+        for (const Metric & m : _metrics)
+        {
+            if (m._retired || m._name != first._name)
+                continue;
+            out += m._name;
+            if (!m._labels.empty())
+                out += "{" + m._labels + "}";
+            out += ' ';
+            appendValue(out, m.value());
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+std::string MetricsRegistry::statsd(const std::string & prefix)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    collect();
+
+    std::string out;
+    for (Metric & m : _metrics)
+    {
+        if (m._retired)
+            continue;
+
+        const double v = m.value();
+        out += prefix + m._name + ':';
+        if (m._type == Type::Counter)
+        {
+            appendValue(out, v - m._sent);
+            out += "|c";
+        }
+        else
+        {
+            appendValue(out, v);
+            out += "|g";
+        }
+        m._sent = v;
+        out += dogstatsdTags(m._labels) + '\n';
+    }
+    return out;
+}
+
+}  // lab
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/MixerNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "internal/FastMath.h"
+#include "internal/Lanes4.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace lab
+{
+
+static AudioSettingDescriptor s_sDesc[] = {
+    {"metering", "METR", SettingType::Bool},
+    nullptr};
+
+AudioNodeDescriptor * MixerNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_sDesc, 2};
+    return &d;
+}
+
+struct MixerNode::Strip
+{
+    Strip()
+    {
+        for (int k = 0; k < MaxSends; ++k)
+        {
+            send[k].store(0.f, std::memory_order_relaxed);
+            sendPreFader[k].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // written by any thread, read by the render thread
+    std::atomic<float> gain {1.f};
+    std::atomic<float> pan {0.f};
+    std::atomic<bool> mute {false};
+    std::atomic<bool> solo {false};
+    std::atomic<float> send[MaxSends];
+    std::atomic<bool> sendPreFader[MaxSends];
+
+    // written by the render thread
+    std::atomic<float> peak {0.f};
+    std::atomic<float> level {0.f};
+
+    // The gains from the input's left and right channels to the main output's left, and to
+    // its right, then to each send's, as of the end of the last quantum. A mono input's are
+    // the first of each.
+    float matrix[1 + MaxSends][4] = {};
+    bool started = false;
+};
+
+namespace
+{
+    // Four frames' gains, ramping by step a frame from start, for the frames after the first
+    inline Lanes4 rampOf(float start, float step)
+    {
+        const float ramp[4] = {start + step, start + 2.f * step, start + 3.f * step, start + 4.f * step};
+        return Lanes4::load(ramp);
+    }
+
+    inline float greatestOf(Lanes4 x)
+    {
+        float lanes[4];
+        x.store(lanes);
+        return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+
+    // An output that a strip is heard in, the main one or a send, and the strip's gains to
+    // it at the start and the end of the quantum
+    struct Destination
+    {
+        float * outL;
+        float * outR;
+        const float * from;
+        const float * to;
+    };
+
+    struct Ramp
+    {
+        Lanes4 gain {0.f};
+        Lanes4 step4 {0.f};
+        float from = 0.f;
+        float step = 0.f;
+    };
+
+    // Adds a strip's input to each of its destinations through its gains, ramped over the
+    // frames, reading the input once, and measures the input as it goes if Meter is set. A
+    // mono input is read from inL alone.
+    template <bool Meter, bool Stereo>
+    void mixStrip(const float * inL, const float * inR, const Destination * destinations, int count, int frames,
+                  float & peak, float & squares)
+    {
+        // a mono input has gains to the left and right, and a stereo one from each channel to each
+        const int gains = Stereo ? 4 : 2;
+        Ramp ramps[(1 + MixerNode::MaxSends) * 4];
+        for (int d = 0; d < count; ++d)
+            for (int g = 0; g < gains; ++g)
+            {
+                const int m = Stereo ? g : 2 * g;
+                Ramp & ramp = ramps[d * gains + g];
+                ramp.from = destinations[d].from[m];
+                ramp.step = (destinations[d].to[m] - ramp.from) / frames;
+                ramp.gain = rampOf(ramp.from, ramp.step);
+                ramp.step4 = Lanes4(4.f * ramp.step);
+            }
+        Lanes4 peak4(0.f);
+        Lanes4 squares4(0.f);
+
+        int i = 0;
+        for (; i + 4 <= frames; i += 4)
+        {
+            const Lanes4 l = Lanes4::load(inL + i);
+            const Lanes4 r = Stereo ? Lanes4::load(inR + i) : l;
+            for (int d = 0; d < count; ++d)
+            {
+                float * outL = destinations[d].outL + i;
+                float * outR = destinations[d].outR + i;
+                Ramp * ramp = ramps + d * gains;
+                if (Stereo)
+                {
+                    (Lanes4::load(outL) + l * ramp[0].gain + r * ramp[1].gain).store(outL);
+                    (Lanes4::load(outR) + l * ramp[2].gain + r * ramp[3].gain).store(outR);
+                }
+                else
+                {
+                    (Lanes4::load(outL) + l * ramp[0].gain).store(outL);
+                    (Lanes4::load(outR) + l * ramp[1].gain).store(outR);
+                }
+                for (int g = 0; g < gains; ++g)
+                    ramp[g].gain = ramp[g].gain + ramp[g].step4;
+            }
+            if (Meter)
+            {
+                peak4 = maxOf(peak4, Stereo ? maxOf(absOf(l), absOf(r)) : absOf(l));
+                squares4 = Stereo ? squares4 + l * l + r * r : squares4 + l * l;
+            }
+        }
+        peak = greatestOf(peak4);
+        squares = squares4.sum();
+        for (; i < frames; ++i)
+        {
+            const float l = inL[i];
+            const float r = Stereo ? inR[i] : l;
+            const float t = static_cast<float>(i + 1);
+            for (int d = 0; d < count; ++d)
+            {
+                const Ramp * ramp = ramps + d * gains;
+                if (Stereo)
+                {
+                    destinations[d].outL[i] += l * (ramp[0].from + ramp[0].step * t) + r * (ramp[1].from + ramp[1].step * t);
+                    destinations[d].outR[i] += l * (ramp[2].from + ramp[2].step * t) + r * (ramp[3].from + ramp[3].step * t);
+                }
+                else
+                {
+                    destinations[d].outL[i] += l * (ramp[0].from + ramp[0].step * t);
+                    destinations[d].outR[i] += l * (ramp[1].from + ramp[1].step * t);
+                }
+            }
+            if (Meter)
+            {
+                peak = std::max(peak, Stereo ? std::max(std::fabs(l), std::fabs(r)) : std::fabs(l));
+                squares += Stereo ? l * l + r * r : l * l;
+            }
+        }
+    }
+
+    inline bool isZero(const float * gains)
+    {
+        return gains[0] == 0.f && gains[1] == 0.f && gains[2] == 0.f && gains[3] == 0.f;
+    }
+}
+
+MixerNode::MixerNode(AudioContext & ac, int numberOfInputs, int numberOfSends)
+    : AudioNode(ac, *desc())
+    , m_sends(numberOfSends)
+{
+    if (numberOfSends < 0 || numberOfSends > MaxSends)
+        throw std::invalid_argument("MixerNode supports 0 to 8 sends");
+
+    m_metering = setting("metering");
+    m_metering->setBool(false, false);
+
+    addInputs(numberOfInputs);
+    for (int k = 0; k < numberOfSends; ++k)
+        addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, 2)));
+
+    // inputs of more than two channels are mixed down to stereo
+    _self->m_channelCount = 2;
+    _self->m_channelCountMode = ChannelCountMode::ClampedMax;
+    _self->m_channelInterpretation = ChannelInterpretation::Speakers;
+
+    initialize();
+}
+
+MixerNode::~MixerNode()
+{
+    uninitialize();
+}
+
+void MixerNode::addInputs(int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+        m_strips.emplace_back(new Strip());
+    }
+}
+
+MixerNode::Strip & MixerNode::strip(int input) const
+{
+    if (input < 0 || input >= static_cast<int>(m_strips.size()))
+        throw std::out_of_range("MixerNode has no such input");
+    return *m_strips[input];
+}
+
+void MixerNode::setGain(int input, float gain) { strip(input).gain.store(gain, std::memory_order_relaxed); }
+float MixerNode::gain(int input) const { return strip(input).gain.load(std::memory_order_relaxed); }
+
+void MixerNode::setPan(int input, float pan)
+{
+    strip(input).pan.store(std::max(-1.f, std::min(pan, 1.f)), std::memory_order_relaxed);
+}
+float MixerNode::pan(int input) const { return strip(input).pan.load(std::memory_order_relaxed); }
+
+void MixerNode::setMute(int input, bool mute) { strip(input).mute.store(mute, std::memory_order_relaxed); }
+bool MixerNode::mute(int input) const { return strip(input).mute.load(std::memory_order_relaxed); }
+
+void MixerNode::setSolo(int input, bool solo) { strip(input).solo.store(solo, std::memory_order_relaxed); }
+bool MixerNode::solo(int input) const { return strip(input).solo.load(std::memory_order_relaxed); }
+
+void MixerNode::checkSend(int send) const
+{
+    if (send < 0 || send >= m_sends)
+        throw std::out_of_range("MixerNode has no such send");
+}
+
+void MixerNode::setSend(int input, int send, float level)
+{
+    checkSend(send);
+    strip(input).send[send].store(level, std::memory_order_relaxed);
+}
+float MixerNode::send(int input, int send) const
+{
+    checkSend(send);
+    return strip(input).send[send].load(std::memory_order_relaxed);
+}
+
+void MixerNode::setSendPreFader(int input, int send, bool preFader)
+{
+    checkSend(send);
+    strip(input).sendPreFader[send].store(preFader, std::memory_order_relaxed);
+}
+bool MixerNode::sendPreFader(int input, int send) const
+{
+    checkSend(send);
+    return strip(input).sendPreFader[send].load(std::memory_order_relaxed);
+}
+
+bool MixerNode::metering() const { return m_metering->valueBool(); }
+void MixerNode::setMetering(bool metering) { m_metering->setBool(metering); }
+
+float MixerNode::takePeak(int input) { return strip(input).peak.exchange(0.f, std::memory_order_relaxed); }
+float MixerNode::level(int input) const { return strip(input).level.load(std::memory_order_relaxed); }
+
+void MixerNode::process(ContextRenderLock & r, int bufferSize)
+{
+    // the main output, then the sends
+    const int outputs = 1 + m_sends;
+    AudioBus * buses[1 + MaxSends];
+    bool stereoOutputs = true;
+    for (int o = 0; o < outputs; ++o)
+    {
+        buses[o] = output(o)->bus(r);
+        buses[o]->zero();
+        stereoOutputs = stereoOutputs && buses[o]->numberOfChannels() >= 2;
+    }
+    if (!isInitialized() || !stereoOutputs)
+        return;
+
+    const int strips = std::min(numberOfInputs(), static_cast<int>(m_strips.size()));
+    const bool meter = m_metering->valueBool();
+
+    bool soloing = false;
+    for (int i = 0; i < strips && !soloing; ++i)
+        soloing = m_strips[i]->solo.load(std::memory_order_relaxed);
+
+    // each output's channels, fetched once something is mixed to it
+    float * outL[1 + MaxSends] = {};
+    float * outR[1 + MaxSends] = {};
+    for (int i = 0; i < strips; ++i)
+    {
+        Strip & strip = *m_strips[i];
+        auto in = input(i);
+        AudioBus * bus = in->isConnected() ? in->bus(r) : nullptr;
+        const bool stereo = bus && bus->numberOfChannels() > 1;
+
+        // the strip's gains for this quantum, by the equal power law of a StereoPannerNode,
+        // to the main output, then to the sends, at their levels, after the fader or before
+        float target[1 + MaxSends][4] = {};
+        const bool heard = !strip.mute.load(std::memory_order_relaxed) && (!soloing || strip.solo.load(std::memory_order_relaxed));
+        if (heard)
+        {
+            const float pan = strip.pan.load(std::memory_order_relaxed);
+            float panned[4] = {0.f, 0.f, 0.f, 0.f};
+            if (!stereo)
+            {
+                const float x = 0.5f * (pan + 1.f);
+                panned[0] = FastMath::sinHalfPi(1.f - x);
+                panned[2] = FastMath::sinHalfPi(x);
+            }
+            else if (pan <= 0.f)
+            {
+                const float x = pan + 1.f;
+                panned[0] = 1.f;
+                panned[1] = FastMath::sinHalfPi(1.f - x);
+                panned[3] = FastMath::sinHalfPi(x);
+            }
+            else
+            {
+                panned[0] = FastMath::sinHalfPi(1.f - pan);
+                panned[2] = FastMath::sinHalfPi(pan);
+                panned[3] = 1.f;
+            }
+
+            const float gain = strip.gain.load(std::memory_order_relaxed);
+            for (int m = 0; m < 4; ++m)
+                target[0][m] = gain * panned[m];
+            for (int k = 0; k < m_sends; ++k)
+            {
+                const float level = strip.send[k].load(std::memory_order_relaxed);
+                const float * source = strip.sendPreFader[k].load(std::memory_order_relaxed) ? panned : target[0];
+                for (int m = 0; m < 4; ++m)
+                    target[1 + k][m] = level * source[m];
+            }
+        }
+        if (!strip.started)
+        {
+            std::copy(&target[0][0], &target[0][0] + outputs * 4, &strip.matrix[0][0]);
+            strip.started = true;
+        }
+
+        // the outputs the strip is heard in, this quantum or the last
+        Destination destinations[1 + MaxSends];
+        int count = 0;
+        const bool silent = !bus || bus->isSilent();
+        for (int o = 0; o < outputs && !silent; ++o)
+        {
+            if (isZero(target[o]) && isZero(strip.matrix[o]))
+                continue;
+            if (!outL[o])
+            {
+                outL[o] = buses[o]->channel(0)->mutableData();
+                outR[o] = buses[o]->channel(1)->mutableData();
+            }
+            destinations[count++] = {outL[o], outR[o], strip.matrix[o], target[o]};
+        }
+
+        if (silent || (!count && !meter))
+        {
+            std::copy(&target[0][0], &target[0][0] + outputs * 4, &strip.matrix[0][0]);
+            if (meter && silent)
+                strip.level.store(0.f, std::memory_order_relaxed);
+            continue;
+        }
+
+        float peak = 0.f;
+        float squares = 0.f;
+        const float * inL = bus->channel(0)->data();
+        if (stereo)
+        {
+            const float * inR = bus->channel(1)->data();
+            if (meter)
+                mixStrip<true, true>(inL, inR, destinations, count, bufferSize, peak, squares);
+            else
+                mixStrip<false, true>(inL, inR, destinations, count, bufferSize, peak, squares);
+            squares *= 0.5f;
+        }
+        else if (meter)
+            mixStrip<true, false>(inL, nullptr, destinations, count, bufferSize, peak, squares);
+        else
+            mixStrip<false, false>(inL, nullptr, destinations, count, bufferSize, peak, squares);
+        std::copy(&target[0][0], &target[0][0] + outputs * 4, &strip.matrix[0][0]);
+
+        if (meter)
+        {
+            float held = strip.peak.load(std::memory_order_relaxed);
+            while (peak > held && !strip.peak.compare_exchange_weak(held, peak, std::memory_order_relaxed)) {}
+            strip.level.store(std::sqrt(squares / bufferSize), std::memory_order_relaxed);
+        }
+    }
+}
+
+void MixerNode::reset(ContextRenderLock &)
+{
+    for (auto & strip : m_strips)
+    {
+        strip->started = false;
+        strip->peak.store(0.f, std::memory_order_relaxed);
+        strip->level.store(0.f, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace lab
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/NetworkSinkNode.h"
+
+#include "internal/DenormalDisabler.h"
+#include "internal/RtpPacket.h"
+#include "internal/UdpSocket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+using namespace lab;
+
+namespace
+{
+    SampleConversion::SampleFormat sampleFormat(NetworkPayload payload)
+    {
+        switch (payload)
+        {
+            case NetworkPayload::Int24: return SampleConversion::SampleFormat::Int24;
+            case NetworkPayload::Float32: return SampleConversion::SampleFormat::Float32;
+            default: return SampleConversion::SampleFormat::Int16;
+        }
+    }
+
+    NetworkStreamConfig checkedConfig(NetworkStreamConfig config, int renderQuantum)
+    {
+        if (config.channels < 1)
+            throw std::invalid_argument("A network sink needs at least one channel");
+        if (!config.port || config.address.empty())
+            throw std::invalid_argument("A network sink needs an address and a port to send to");
+        if (config.packetFrames <= 0)
+            config.packetFrames = renderQuantum;
+        const int bytes = config.packetFrames * config.channels * SampleConversion::bytesPerSample(sampleFormat(config.payload));
+        if (bytes > NetworkStreamConfig::MaxPacketBytes)
+            throw std::invalid_argument("A network sink's packets must fit in NetworkStreamConfig::MaxPacketBytes");
+        return config;
+    }
+}
+
+AudioNodeDescriptor * NetworkSinkNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+NetworkSinkNode::NetworkSinkNode(AudioContext & ac, const NetworkStreamConfig & config)
+    : AudioNode(ac, *desc())
+{
+    _config = checkedConfig(config, renderQuantumSize());
+
+    std::string error;
+    _socket = UdpSocket::connect(_config.address, _config.port, error);
+    if (!_socket)
+        throw std::runtime_error("A network sink couldn't open its socket: " + error);
+
+    // the ring rides out the sender being descheduled for a few packets
+    const size_t frames = static_cast<size_t>(std::max(_config.packetFrames, renderQuantumSize())) * 8;
+    _ring.reset(new AudioRingBuffer(_config.channels, frames));
+    _channels.resize(_config.channels, nullptr);
+
+    _self->m_channelCount = _config.channels;
+    _self->m_channelCountMode = ChannelCountMode::Explicit;
+    _self->m_channelInterpretation = ChannelInterpretation::Discrete;
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+    initialize();
+
+    _sender = std::thread(&NetworkSinkNode::senderEntry, this);
+}
+
+NetworkSinkNode::~NetworkSinkNode()
+{
+    _quit.store(true, std::memory_order_release);
+    _senderWake.notify_one();
+    if (_sender.joinable())
+        _sender.join();
+    uninitialize();
+}
+
+void NetworkSinkNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+    AudioBus * inputBus = input(0)->isConnected() ? input(0)->bus(r) : nullptr;
+    const int inputChannels = inputBus ? inputBus->numberOfChannels() : 0;
+
+    // channels past the input's are sent silent
+    for (int c = 0; c < _config.channels; ++c)
+        _channels[c] = c < inputChannels ? inputBus->channel(c)->data() : nullptr;
+    if (_ring->write(_channels.data(), bufferSize))
+        wakeSender();
+    else
+        _overflowFrames.fetch_add(bufferSize, std::memory_order_relaxed);
+
+    // pass through
+    if (inputBus)
+        outputBus->copyFrom(*inputBus);
+    else
+        outputBus->zero();
+}
+
+void NetworkSinkNode::wakeSender()
+{
+    if (_senderMutex.try_lock())
+    {
+        _senderWake.notify_one();
+        _senderMutex.unlock();
+    }
+}
+
+void NetworkSinkNode::senderEntry()
+{
+    DenormalDisabler denormalDisabler;
+    const int channels = _config.channels;
+    const int frames = _config.packetFrames;
+    const SampleConversion::SampleFormat format = sampleFormat(_config.payload);
+
+    std::vector<float> planar(static_cast<size_t>(channels) * frames);
+    std::vector<float *> destinations(channels);
+    for (int c = 0; c < channels; ++c)
+        destinations[c] = planar.data() + static_cast<size_t>(c) * frames;
+    std::vector<uint8_t> packet(RtpPacket::HeaderBytes + NetworkStreamConfig::MaxPacketBytes);
+
+    // RFC 3550 starts the sequence and timestamp at random, as well as the source's id
+    std::random_device seed;
+    std::mt19937 random(seed());
+    RtpPacket::Header header;
+    header.payloadType = _config.payloadType;
+    header.marker = true;
+    header.sequence = static_cast<uint16_t>(random());
+    header.timestamp = static_cast<uint32_t>(random());
+    header.ssrc = static_cast<uint32_t>(random());
+
+    while (!_quit.load(std::memory_order_acquire))
+    {
+        if (!_ring->read(destinations.data(), frames))
+        {
+            // the render thread doesn't block to wake the sender, so a wake up can be missed;
+            // the timeout bounds how late a packet can then be
+            std::unique_lock<std::mutex> lock(_senderMutex);
+            _senderWake.wait_for(lock, std::chrono::milliseconds(1));
+            continue;
+        }
+
+        size_t bytes = 0;
+        if (_config.rtp)
+        {
+            RtpPacket::writeHeader(header, packet.data());
+            bytes = RtpPacket::HeaderBytes;
+        }
+        bytes += RtpPacket::encode(destinations.data(), channels, frames, format, packet.data() + bytes);
+
+        if (_socket->send(packet.data(), bytes))
+            _packetsSent.fetch_add(1, std::memory_order_relaxed);
+        else
+            _sendErrors.fetch_add(1, std::memory_order_relaxed);
+
+        header.marker = false;
+        ++header.sequence;
+        header.timestamp += static_cast<uint32_t>(frames);
+    }
+}
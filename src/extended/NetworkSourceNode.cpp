@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/NetworkSourceNode.h"
+
+#include "internal/DenormalDisabler.h"
+#include "internal/JitterBuffer.h"
+#include "internal/RtpPacket.h"
+#include "internal/UdpSocket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+using namespace lab;
+
+namespace
+{
+    SampleConversion::SampleFormat sampleFormat(NetworkPayload payload)
+    {
+        switch (payload)
+        {
+            case NetworkPayload::Int24: return SampleConversion::SampleFormat::Int24;
+            case NetworkPayload::Float32: return SampleConversion::SampleFormat::Float32;
+            default: return SampleConversion::SampleFormat::Int16;
+        }
+    }
+
+    const NetworkStreamConfig & checkedConfig(const NetworkStreamConfig & config)
+    {
+        if (config.channels < 1)
+            throw std::invalid_argument("A network source needs at least one channel");
+        if (!config.port)
+            throw std::invalid_argument("A network source needs a port to listen on");
+        if (config.minLatency < 0 || config.maxLatency < config.minLatency)
+            throw std::invalid_argument("A network source's latency bounds are out of order");
+        return config;
+    }
+}
+
+AudioNodeDescriptor * NetworkSourceNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+NetworkSourceNode::NetworkSourceNode(AudioContext & ac, const NetworkStreamConfig & config)
+    : AudioScheduledSourceNode(ac, {nullptr, nullptr, checkedConfig(config).channels})
+    , _config(config)
+{
+    const int frameBytes = _config.channels * SampleConversion::bytesPerSample(sampleFormat(_config.payload));
+    _maxPacketFrames = NetworkStreamConfig::MaxPacketBytes / frameBytes;
+    if (_config.packetFrames > 0)
+        _maxPacketFrames = std::min(_maxPacketFrames, _config.packetFrames);
+    if (!_maxPacketFrames)
+        throw std::invalid_argument("A network source's frames don't fit in NetworkStreamConfig::MaxPacketBytes");
+
+    std::string error;
+    _socket = UdpSocket::bind(_config.address, _config.port, error);
+    if (!_socket)
+        throw std::runtime_error("A network source couldn't bind its socket: " + error);
+
+    _jitterBuffer.reset(new JitterBuffer(_config.channels, _maxPacketFrames, renderQuantumSize(), ac.sampleRate(),
+                                         _config.minLatency, _config.maxLatency));
+    _channels.resize(_config.channels, nullptr);
+    initialize();
+
+    _receiver = std::thread(&NetworkSourceNode::receiverEntry, this);
+}
+
+NetworkSourceNode::~NetworkSourceNode()
+{
+    _quit.store(true, std::memory_order_release);
+    if (_receiver.joinable())
+        _receiver.join();
+    uninitialize();
+}
+
+void NetworkSourceNode::receiverEntry()
+{
+    DenormalDisabler denormalDisabler;
+    const int channels = _config.channels;
+    const SampleConversion::SampleFormat format = sampleFormat(_config.payload);
+
+    std::vector<uint8_t> packet(RtpPacket::HeaderBytes + NetworkStreamConfig::MaxPacketBytes + 1024);
+    std::vector<float> planar(static_cast<size_t>(channels) * _maxPacketFrames);
+    std::vector<float *> destinations(channels);
+    for (int c = 0; c < channels; ++c)
+        destinations[c] = planar.data() + static_cast<size_t>(c) * _maxPacketFrames;
+
+    // bare payloads are numbered as they arrive
+    uint16_t rawSequence = 0;
+    uint32_t rawTimestamp = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!_quit.load(std::memory_order_acquire))
+    {
+        // the timeout bounds how long the node takes to notice it is being destroyed
+        const int bytes = _socket->receive(packet.data(), packet.size(), 20);
+        if (bytes <= 0)
+        {
+            if (bytes < 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+        const double arrival = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        RtpPacket::Header header;
+        size_t offset = 0;
+        size_t payloadBytes = static_cast<size_t>(bytes);
+        if (_config.rtp)
+        {
+            if (!RtpPacket::readHeader(packet.data(), payloadBytes, header, offset, payloadBytes))
+                continue;
+            if (header.payloadType != _config.payloadType)
+                continue;
+        }
+
+        // a packet larger than expected is cut to the frames the jitter buffer holds
+        const size_t frameBytes = static_cast<size_t>(channels) * SampleConversion::bytesPerSample(format);
+        payloadBytes = std::min(payloadBytes, frameBytes * _maxPacketFrames);
+        const int frames = RtpPacket::decode(packet.data() + offset, payloadBytes, format, channels, destinations.data());
+        if (!frames)
+            continue;
+
+        if (!_config.rtp)
+        {
+            header.sequence = rawSequence++;
+            header.timestamp = rawTimestamp;
+            rawTimestamp += static_cast<uint32_t>(frames);
+        }
+        _jitterBuffer->push(header.ssrc, header.sequence, header.timestamp, destinations.data(), frames, arrival);
+    }
+}
+
+void NetworkSourceNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+
+    const int quantumFrameOffset = _self->_scheduler._renderOffset;
+    const int nonSilentFramesToProcess = _self->_scheduler._renderLength;
+
+    if (!isInitialized() || !nonSilentFramesToProcess)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    // the stream's channels past the output's are discarded, and output channels past the
+    // stream's are silent
+    const int outputChannels = outputBus->numberOfChannels();
+    for (int c = 0; c < _config.channels; ++c)
+        _channels[c] = c < outputChannels ? outputBus->channel(c)->mutableData() + quantumFrameOffset : nullptr;
+    _jitterBuffer->pull(_channels.data(), nonSilentFramesToProcess);
+
+    for (int i = 0; i < outputChannels; ++i)
+    {
+        float * destP = outputBus->channel(i)->mutableData();
+        if (i >= _config.channels)
+            std::fill(destP + quantumFrameOffset, destP + quantumFrameOffset + nonSilentFramesToProcess, 0.f);
+        std::fill(destP, destP + quantumFrameOffset, 0.f);
+        std::fill(destP + quantumFrameOffset + nonSilentFramesToProcess, destP + bufferSize, 0.f);
+    }
+}
+
+bool NetworkSourceNode::propagatesSilence(ContextRenderLock & r) const
+{
+    return !isPlayingOrScheduled() || hasFinished();
+}
+
+uint64_t NetworkSourceNode::packetsReceived() const { return _jitterBuffer->packetsReceived(); }
+uint64_t NetworkSourceNode::packetsLost() const { return _jitterBuffer->packetsLost(); }
+uint64_t NetworkSourceNode::packetsLate() const { return _jitterBuffer->packetsLate(); }
+uint64_t NetworkSourceNode::droppedFrames() const { return _jitterBuffer->droppedFrames(); }
+uint64_t NetworkSourceNode::underrunFrames() const { return _jitterBuffer->underrunFrames(); }
+double NetworkSourceNode::jitter() const { return _jitterBuffer->jitterSeconds(); }
+double NetworkSourceNode::latency() const { return _jitterBuffer->latencySeconds(); }
@@ -8,6 +8,16 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSetting.h"
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
 using namespace std;
 using namespace lab;
 
@@ -17,7 +27,144 @@ namespace lab
 static char const * const s_noiseTypes[NoiseNode::NoiseType::_Count + 1] = {
     "White", "Pink", "Brown", nullptr};
 
-static AudioSettingDescriptor s_nSettings[] = {{"type", "TYPE", SettingType::Enum, s_noiseTypes}, nullptr};
+static AudioSettingDescriptor s_nSettings[] = {
+    {"type", "TYPE", SettingType::Enum, s_noiseTypes},
+    {"seed", "SEED", SettingType::Integer},
+    nullptr};
+
+namespace
+{
+    // successive instances get well separated default seeds
+    std::atomic<uint32_t> s_instanceCount {0};
+
+    // Paul Kellet's refined pink filter, reference: http://www.firstpr.com.au/dsp/pink-noise/
+    // The sixth lane is the direct path, and the seventh is unused.
+    const float s_pinkPoles[8] = {0.99886f, 0.99332f, 0.96900f, 0.86650f, 0.55000f, -0.7616f, 0.f, 0.f};
+    const float s_pinkGains[8] = {0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f, 0.5329522f, -0.0168980f, 0.5362f, 0.f};
+    const float s_pinkDelayedGain = 0.115926f;
+    const float s_pinkScale = 0.11f;  // roughly compensates gain
+
+    const float s_intToUnit = 1.f / 2147483648.f;
+
+    // fills destination with uniform noise in [-1, 1) from eight xorshift32 generators
+    void fillWhite(uint32_t * lanes, float * destination, int count)
+    {
+        int i = 0;
+#if defined(__SSE2__)
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + 4));
+        const __m128 scale = _mm_set1_ps(s_intToUnit);
+        auto step = [](__m128i x) {
+            x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+            return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        };
+        for (; i < count; i += 8)
+        {
+            a = step(a);
+            b = step(b);
+            alignas(16) float block[8];
+            _mm_store_ps(block, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+            _mm_store_ps(block + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+            if (i + 8 <= count)
+                std::copy(block, block + 8, destination + i);
+            else
+                std::copy(block, block + (count - i), destination + i);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 4), b);
+#elif defined(ARM_NEON_INTRINSICS)
+        uint32x4_t a = vld1q_u32(lanes);
+        uint32x4_t b = vld1q_u32(lanes + 4);
+        auto step = [](uint32x4_t x) {
+            x = veorq_u32(x, vshlq_n_u32(x, 13));
+            x = veorq_u32(x, vshrq_n_u32(x, 17));
+            return veorq_u32(x, vshlq_n_u32(x, 5));
+        };
+        for (; i < count; i += 8)
+        {
+            a = step(a);
+            b = step(b);
+            float block[8];
+            vst1q_f32(block, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(a)), s_intToUnit));
+            vst1q_f32(block + 4, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(b)), s_intToUnit));
+            std::copy(block, block + std::min(8, count - i), destination + i);
+        }
+        vst1q_u32(lanes, a);
+        vst1q_u32(lanes + 4, b);
+#else
+        for (; i < count; i += 8)
+        {
+            float block[8];
+            for (int l = 0; l < 8; ++l)
+            {
+                uint32_t x = lanes[l];
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                lanes[l] = x;
+                block[l] = static_cast<float>(static_cast<int32_t>(x)) * s_intToUnit;
+            }
+            std::copy(block, block + std::min(8, count - i), destination + i);
+        }
+#endif
+    }
+
+    // filters white noise to pink in place, with the filter bank's lanes run together
+    void filterPink(float * pink, float & delayed, float * samples, int count)
+    {
+#if defined(__SSE2__)
+        __m128 p0 = _mm_loadu_ps(pink);
+        __m128 p1 = _mm_loadu_ps(pink + 4);
+        const __m128 a0 = _mm_loadu_ps(s_pinkPoles), a1 = _mm_loadu_ps(s_pinkPoles + 4);
+        const __m128 b0 = _mm_loadu_ps(s_pinkGains), b1 = _mm_loadu_ps(s_pinkGains + 4);
+        for (int i = 0; i < count; ++i)
+        {
+            const float white = samples[i];
+            const __m128 w = _mm_set1_ps(white);
+            p0 = _mm_add_ps(_mm_mul_ps(a0, p0), _mm_mul_ps(b0, w));
+            p1 = _mm_add_ps(_mm_mul_ps(a1, p1), _mm_mul_ps(b1, w));
+            __m128 sum = _mm_add_ps(p0, p1);
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            samples[i] = (_mm_cvtss_f32(sum) + delayed) * s_pinkScale;
+            delayed = white * s_pinkDelayedGain;
+        }
+        _mm_storeu_ps(pink, p0);
+        _mm_storeu_ps(pink + 4, p1);
+#elif defined(ARM_NEON_INTRINSICS)
+        float32x4_t p0 = vld1q_f32(pink);
+        float32x4_t p1 = vld1q_f32(pink + 4);
+        const float32x4_t a0 = vld1q_f32(s_pinkPoles), a1 = vld1q_f32(s_pinkPoles + 4);
+        const float32x4_t b0 = vld1q_f32(s_pinkGains), b1 = vld1q_f32(s_pinkGains + 4);
+        for (int i = 0; i < count; ++i)
+        {
+            const float white = samples[i];
+            p0 = vmlaq_n_f32(vmulq_f32(a0, p0), b0, white);
+            p1 = vmlaq_n_f32(vmulq_f32(a1, p1), b1, white);
+            const float32x4_t sum = vaddq_f32(p0, p1);
+            const float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+            samples[i] = (vget_lane_f32(vpadd_f32(pair, pair), 0) + delayed) * s_pinkScale;
+            delayed = white * s_pinkDelayedGain;
+        }
+        vst1q_f32(pink, p0);
+        vst1q_f32(pink + 4, p1);
+#else
+        for (int i = 0; i < count; ++i)
+        {
+            const float white = samples[i];
+            float sum = 0.f;
+            for (int l = 0; l < 8; ++l)
+            {
+                pink[l] = s_pinkPoles[l] * pink[l] + s_pinkGains[l] * white;
+                sum += pink[l];
+            }
+            samples[i] = (sum + delayed) * s_pinkScale;
+            delayed = white * s_pinkDelayedGain;
+        }
+#endif
+    }
+}
 
 AudioNodeDescriptor * NoiseNode::desc()
 {
@@ -29,6 +176,9 @@ NoiseNode::NoiseNode(AudioContext & ac)
     : AudioScheduledSourceNode(ac, *desc())
 {
     _type = setting("type");
+    _seed = setting("seed");
+    _seed->setUint32(1489853723u + 0x9e3779b9u * s_instanceCount.fetch_add(1), false);
+    _seed->setValueChanged([this]() { _reseed = true; });
     initialize();
 }
 
@@ -50,6 +200,17 @@ NoiseNode::NoiseType NoiseNode::type() const
     return NoiseType(_type->valueUint32());
 }
 
+uint32_t NoiseNode::seed() const
+{
+    return _seed->valueUint32();
+}
+
+void NoiseNode::setSeed(uint32_t seed)
+{
+    _seed->setUint32(seed);
+    _reseed = true;
+}
+
 void NoiseNode::process(ContextRenderLock &r, int bufferSize)
 {
     AudioBus * outputBus = output(0)->bus(r);
@@ -75,47 +236,39 @@ void NoiseNode::process(ContextRenderLock &r, int bufferSize)
         return;
     }
 
+    if (_reseed.exchange(false))
+    {
+        // each lane starts from a hash of the seed and its index; xorshift needs a nonzero state
+        const uint32_t seed = _seed->valueUint32();
+        for (uint32_t l = 0; l < 8; ++l)
+        {
+            uint32_t x = seed + 0x9e3779b9u * (l + 1);
+            x = (x ^ (x >> 16)) * 0x85ebca6bu;
+            x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+            x ^= x >> 16;
+            _lanes[l] = x ? x : 0x6d2b79f5u;
+        }
+    }
+
     // Start rendering at the correct offset.
     destP += quantumFrameOffset;
-    int n = nonSilentFramesToProcess;
+    const int n = nonSilentFramesToProcess;
+
+    // all the noises are made from white noise, filtered in place
+    fillWhite(_lanes, destP, n);
 
     switch (NoiseType(_type->valueUint32()))
     {
-            // reference: http://noisehack.com/generate-noise-web-audio-api/
         case WHITE:
-            while (n--)
-            {
-                float white = ((float) ((whiteSeed & 0x7fffffff) - 0x40000000)) * (float) (1.0f / 0x40000000);
-                white = (white * 0.5f) - 1.0f;
-                *destP++ = white;
-                whiteSeed = whiteSeed * 435898247 + 382842987;
-            }
             break;
         case PINK:
-            while (n--)
-            {
-                float white = ((float) ((whiteSeed & 0x7fffffff) - 0x40000000)) * (float) (1.0f / 0x40000000);
-                white = (white * 0.5f) - 1.0f;
-                whiteSeed = whiteSeed * 435898247 + 382842987;
-
-                pink0 = 0.99886f * pink0 + white * 0.0555179f;
-                pink1 = 0.99332f * pink1 + white * 0.0750759f;
-                pink2 = 0.96900f * pink2 + white * 0.1538520f;
-                pink3 = 0.86650f * pink3 + white * 0.3104856f;
-                pink4 = 0.55000f * pink4 + white * 0.5329522f;
-                pink5 = -0.7616f * pink5 - white * 0.0168980f;
-                *destP++ = (pink0 + pink1 + pink2 + pink3 + pink4 + pink5 + pink6 + (white * 0.5362f)) * 0.11f;  // .11 roughly compensates gain
-                pink6 = white * 0.115926f;
-            }
+            filterPink(_pink, _pinkDelayed, destP, n);
             break;
         case BROWN:
-            while (n--)
+            for (int i = 0; i < n; ++i)
             {
-                float white = ((float) ((whiteSeed & 0x7fffffff) - 0x40000000)) * (float) (1.0f / 0x40000000);
-                white = (white * 0.5f) - 1.0f;
-                whiteSeed = whiteSeed * 435898247 + 382842987;
-                float brown = (lastBrown + (0.02f * white)) / 1.02f;
-                *destP++ = brown * 3.5f;  // roughly compensate for gain
+                float brown = (lastBrown + (0.02f * destP[i])) / 1.02f;
+                destP[i] = brown * 3.5f;  // roughly compensate for gain
                 lastBrown = brown;
             }
             break;
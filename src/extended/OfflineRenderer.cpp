@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/OfflineRenderer.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/extended/Logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+namespace lab
+{
+
+void RenderOfflineContexts(std::vector<OfflineRenderJob> & jobs, int threadCount)
+{
+    // the calling thread renders alongside the job system's workers
+    JobSystem & jobSystem = JobSystem::shared();
+    if (threadCount <= 0)
+        threadCount = jobSystem.workerCount() + 1;
+    if (threadCount > static_cast<int>(jobs.size()))
+        threadCount = static_cast<int>(jobs.size());
+    if (threadCount < 1)
+        threadCount = 1;
+
+    // threads claim the next unstarted job until there are none left, so that short
+    // jobs don't leave a thread idle while long ones are still queued
+    std::atomic<size_t> nextJob {0};
+    auto renderJobs = [&jobs, &nextJob]()
+    {
+        for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+        {
+            OfflineRenderJob & job = jobs[i];
+            job.framesRendered = 0;
+
+            std::shared_ptr<AudioDestinationNode> destination = job.context ? job.context->destinationNode() : nullptr;
+            if (!destination || !job.context->isOfflineContext())
+            {
+                LOG_ERROR("offline render job %d has no offline context with a destination node", (int) i);
+                continue;
+            }
+
+            job.context->startOfflineRendering();
+            job.framesRendered = destination->offlineRender(job.framesToRender, job.chunkFrames, job.sink, job.progress);
+        }
+    };
+
+    std::atomic<int> helpers {threadCount - 1};
+    for (int i = 1; i < threadCount; ++i)
+        jobSystem.submit([&renderJobs, &helpers]()
+        {
+            renderJobs();
+            helpers.fetch_sub(1, std::memory_order_release);
+        }, JobPriority::Background);
+
+    renderJobs();
+
+    // a helper that hasn't started yet finds nothing left to render, and may run here
+    jobSystem.wait([&helpers]() { return helpers.load(std::memory_order_acquire) == 0; });
+}
+
+namespace
+{
+    struct WavFileWriter
+    {
+        FILE * file = nullptr;
+        int channelCount = 0;
+        float sampleRate = 0;
+        uint64_t framesWritten = 0;
+        std::vector<float> interleaved;
+
+        ~WavFileWriter()
+        {
+            if (file)
+                fclose(file);
+        }
+
+        static void put16(uint8_t *& p, uint32_t v)
+        {
+            *p++ = uint8_t(v);
+            *p++ = uint8_t(v >> 8);
+        }
+
+        static void put32(uint8_t *& p, uint32_t v)
+        {
+            put16(p, v & 0xffff);
+            put16(p, v >> 16);
+        }
+
+        bool writeHeader()
+        {
+            const uint32_t bytesPerFrame = sizeof(float) * channelCount;
+            const uint32_t dataBytes = static_cast<uint32_t>(framesWritten * bytesPerFrame);
+
+            uint8_t header[44];
+            uint8_t * p = header;
+            memcpy(p, "RIFF", 4); p += 4;
+            put32(p, 36 + dataBytes);
+            memcpy(p, "WAVEfmt ", 8); p += 8;
+            put32(p, 16);
+            put16(p, 3);  // IEEE float
+            put16(p, channelCount);
+            put32(p, static_cast<uint32_t>(sampleRate));
+            put32(p, static_cast<uint32_t>(sampleRate) * bytesPerFrame);
+            put16(p, bytesPerFrame);
+            put16(p, 32);
+            memcpy(p, "data", 4); p += 4;
+            put32(p, dataBytes);
+
+            if (fseek(file, 0, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, file) != 1)
+                return false;
+            return fseek(file, 0, SEEK_END) == 0;
+        }
+
+        bool write(const AudioBus & chunk, int frames)
+        {
+            interleaved.resize(static_cast<size_t>(frames) * channelCount);
+            const int chunkChannels = chunk.numberOfChannels();
+            for (int c = 0; c < channelCount; ++c)
+            {
+                const float * src = c < chunkChannels ? chunk.channel(c)->data() : nullptr;
+                float * dst = interleaved.data() + c;
+                for (int i = 0; i < frames; ++i, dst += channelCount)
+                    *dst = src ? src[i] : 0.f;
+            }
+
+            return writeInterleaved(interleaved.data(), frames);
+        }
+
+        bool writeInterleaved(const float * samples, size_t frames)
+        {
+            if (fwrite(samples, sizeof(float) * channelCount, frames, file) != frames)
+                return false;
+
+            framesWritten += frames;
+            return writeHeader();
+        }
+    };
+
+    // Finds the format and sample data of a 32 bit float WAV file, leaving file at the data
+    bool readWavHeader(FILE * file, int & channelCount, uint32_t & sampleRate, uint64_t & frames)
+    {
+        uint8_t riff[12];
+        if (fread(riff, sizeof(riff), 1, file) != 1 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4))
+            return false;
+
+        channelCount = 0;
+        for (;;)
+        {
+            uint8_t chunk[8];
+            if (fread(chunk, sizeof(chunk), 1, file) != 1)
+                return false;
+            const uint32_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | (uint32_t(chunk[7]) << 24);
+
+            if (!memcmp(chunk, "fmt ", 4) && size >= 16)
+            {
+                uint8_t fmt[16];
+                if (fread(fmt, sizeof(fmt), 1, file) != 1)
+                    return false;
+                const int format = fmt[0] | (fmt[1] << 8);
+                channelCount = fmt[2] | (fmt[3] << 8);
+                sampleRate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (uint32_t(fmt[7]) << 24);
+                const int bits = fmt[14] | (fmt[15] << 8);
+                if (format != 3 || bits != 32 || channelCount < 1)
+                    return false;
+                if (fseek(file, (size - 16) + (size & 1), SEEK_CUR) != 0)
+                    return false;
+            }
+            else if (!memcmp(chunk, "data", 4))
+            {
+                if (!channelCount)
+                    return false;
+                frames = size / (sizeof(float) * channelCount);
+                return true;
+            }
+            else if (fseek(file, size + (size & 1), SEEK_CUR) != 0)
+                return false;
+        }
+    }
+
+    // the tail and latency of the longest path from node to the destination's input
+    double pathTailTime(ContextRenderLock & r, AudioNode * node, std::map<AudioNode *, double> & memo)
+    {
+        auto found = memo.find(node);
+        if (found != memo.end())
+            return found->second;
+
+        // a node met again on a cycle contributes nothing further; a feedback loop's
+        // decay belongs in the tail time of the delay that closes it
+        memo[node] = 0;
+
+        double upstream = 0;
+        for (int i = 0; i < node->numberOfInputs(); ++i)
+            for (auto & output : node->input(i)->connectedOutputs())
+                if (output && output->sourceNode())
+                    upstream = std::max(upstream, pathTailTime(r, output->sourceNode(), memo));
+
+        const double time = upstream + node->tailTime(r) + node->latencyTime(r);
+        memo[node] = time;
+        return time;
+    }
+}
+
+OfflineRenderSink MakeWavFileSink(const std::string & path, int channelCount, float sampleRate)
+{
+    if (channelCount < 1 || sampleRate <= 0)
+        return {};
+
+    std::shared_ptr<WavFileWriter> writer = std::make_shared<WavFileWriter>();
+    writer->file = fopen(path.c_str(), "wb");
+    writer->channelCount = channelCount;
+    writer->sampleRate = sampleRate;
+    if (!writer->file || !writer->writeHeader())
+    {
+        LOG_ERROR("could not create %s", path.c_str());
+        return {};
+    }
+
+    return [writer](const AudioBus & chunk, int frames, uint64_t) -> bool
+    {
+        return writer->write(chunk, frames);
+    };
+}
+
+std::string RenderSegment::toString() const
+{
+    char text[96];
+    snprintf(text, sizeof(text), "segment %d %llu %llu %llu", index, (unsigned long long) firstFrame,
+             (unsigned long long) frames, (unsigned long long) preroll);
+    return text;
+}
+
+bool RenderSegment::parse(const std::string & text, RenderSegment & segment)
+{
+    unsigned long long first, frames, preroll;
+    int index;
+    if (sscanf(text.c_str(), "segment %d %llu %llu %llu", &index, &first, &frames, &preroll) != 4 || preroll > first)
+        return false;
+    segment.index = index;
+    segment.firstFrame = first;
+    segment.frames = frames;
+    segment.preroll = preroll;
+    return true;
+}
+
+std::vector<RenderSegment> PlanRenderSegments(uint64_t totalFrames, int segmentCount, double tailSeconds,
+                                              float sampleRate, int quantum)
+{
+    std::vector<RenderSegment> segments;
+    if (!totalFrames || segmentCount < 1 || quantum < 1)
+        return segments;
+
+    const uint64_t q = static_cast<uint64_t>(quantum);
+    const uint64_t quanta = (totalFrames + q - 1) / q;
+    const uint64_t count = std::min<uint64_t>(segmentCount, quanta);
+    const uint64_t prerollQuanta = static_cast<uint64_t>(std::ceil(std::max(0.0, tailSeconds) * sampleRate / quantum));
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        const uint64_t startQuantum = quanta * i / count;
+        const uint64_t endQuantum = quanta * (i + 1) / count;
+
+        RenderSegment segment;
+        segment.index = static_cast<int>(i);
+        segment.firstFrame = startQuantum * q;
+        segment.frames = std::min(endQuantum * q, totalFrames) - segment.firstFrame;
+        segment.preroll = std::min(startQuantum, prerollQuanta) * q;
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+double GraphTailTime(AudioContext & ac)
+{
+    std::shared_ptr<AudioDestinationNode> destination = ac.destinationNode();
+    if (!destination)
+        return 0;
+
+    ContextRenderLock r(&ac, "GraphTailTime");
+    std::map<AudioNode *, double> memo;
+    return pathTailTime(r, destination.get(), memo);
+}
+
+OfflineRenderJob MakeSegmentRenderJob(const RenderSegment & segment, std::shared_ptr<AudioContext> context,
+                                      OfflineRenderSink sink, int chunkFrames)
+{
+    OfflineRenderJob job;
+    job.context = context;
+    job.framesToRender = segment.preroll + segment.frames;
+    job.chunkFrames = chunkFrames;
+
+    // the preroll is dropped, and a chunk that straddles its end is trimmed to the segment
+    const uint64_t preroll = segment.preroll;
+    const uint64_t firstFrame = segment.firstFrame;
+    std::shared_ptr<AudioBus> trimmed;
+    job.sink = [sink, preroll, firstFrame, trimmed](const AudioBus & chunk, int frames, uint64_t chunkFirst) mutable -> bool
+    {
+        const uint64_t chunkEnd = chunkFirst + frames;
+        if (chunkEnd <= preroll)
+            return true;
+        if (chunkFirst >= preroll)
+            return sink(chunk, frames, firstFrame + (chunkFirst - preroll));
+
+        const int skip = static_cast<int>(preroll - chunkFirst);
+        const int kept = frames - skip;
+        if (!trimmed || trimmed->numberOfChannels() != chunk.numberOfChannels() || trimmed->length() < kept)
+        {
+            trimmed = std::make_shared<AudioBus>(chunk.numberOfChannels(), chunk.length());
+            trimmed->setSampleRate(chunk.sampleRate());
+        }
+        for (int c = 0; c < chunk.numberOfChannels(); ++c)
+            memcpy(trimmed->channel(c)->mutableData(), chunk.channel(c)->data() + skip, sizeof(float) * kept);
+        return sink(*trimmed, kept, firstFrame);
+    };
+    return job;
+}
+
+bool StitchWavSegments(const std::vector<std::string> & segmentPaths, const std::string & outputPath)
+{
+    WavFileWriter writer;
+    std::vector<float> samples;
+
+    for (const std::string & path : segmentPaths)
+    {
+        FILE * file = fopen(path.c_str(), "rb");
+        int channelCount = 0;
+        uint32_t sampleRate = 0;
+        uint64_t frames = 0;
+        if (!file || !readWavHeader(file, channelCount, sampleRate, frames))
+        {
+            LOG_ERROR("could not read the segment %s", path.c_str());
+            if (file)
+                fclose(file);
+            return false;
+        }
+
+        if (!writer.file)
+        {
+            writer.file = fopen(outputPath.c_str(), "wb");
+            writer.channelCount = channelCount;
+            writer.sampleRate = static_cast<float>(sampleRate);
+            if (!writer.file || !writer.writeHeader())
+            {
+                LOG_ERROR("could not create %s", outputPath.c_str());
+                fclose(file);
+                return false;
+            }
+        }
+        else if (channelCount != writer.channelCount || sampleRate != static_cast<uint32_t>(writer.sampleRate))
+        {
+            LOG_ERROR("the segment %s has a different format from the first", path.c_str());
+            fclose(file);
+            return false;
+        }
+
+        // copied a second at a time; a short read means the segment's render was cut off
+        samples.resize(static_cast<size_t>(sampleRate) * channelCount);
+        while (frames > 0)
+        {
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(frames, sampleRate));
+            const size_t read = fread(samples.data(), sizeof(float) * channelCount, n, file);
+            if (read && !writer.writeInterleaved(samples.data(), read))
+            {
+                fclose(file);
+                return false;
+            }
+            if (read < n)
+                break;
+            frames -= n;
+        }
+        fclose(file);
+    }
+
+    return writer.file != nullptr;
+}
+
+}  // lab
@@ -1,166 +1,284 @@
-
 // Copyright (c) 2003-2013 Nick Porcino, All rights reserved.
 // License is MIT: http://opensource.org/licenses/MIT
 
 #ifdef PD
 
-#include "PdNode.h"
-#include "LabSound.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
 
-#include "AudioBus.h"
-#include "AudioNodeInput.h"
-#include "AudioNodeOutput.h"
-#include "AudioProcessor.h"
-#include "LabSound/extended/Registry.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/PdNode.h"
 
-#include "PdBase.hpp"
 #include "z_libpd.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 namespace lab
 {
 
-class PdNode::PdNodeInternal : public lab::AudioProcessor
+namespace
 {
-public:
-    PdNodeInternal(float sampleRate)
-        : AudioProcessor(sampleRate)
-        , numChannels(2)
-        , pdBuffSize(128)
+    // Guards libpd's current instance when it is shared by every thread, and the creation
+    // of instances in any case
+    std::mutex & libraryMutex()
     {
+        static std::mutex m;
+        return m;
     }
 
-    virtual ~PdNodeInternal()
-    {
-    }
+#ifndef PDINSTANCE
+    int s_instances = 0;
+#endif
+}
+
+PdInstance::PdInstance(int inputs, int outputs, float sampleRate)
+    : m_inputs(inputs)
+    , m_outputs(outputs)
+{
+    if (inputs < 0 || outputs < 0)
+        throw std::invalid_argument("A Pd instance can't have negative channels");
 
-    // AudioProcessor interface
-    virtual void initialize()
     {
+        std::lock_guard<std::mutex> lock(libraryMutex());
+        static std::once_flag initialized;
+        std::call_once(initialized, []() { libpd_init(); });
+#ifdef PDINSTANCE
+        m_instance = libpd_new_instance();
+        if (!m_instance)
+            throw std::runtime_error("libpd couldn't create an instance");
+#else
+        if (s_instances)
+            throw std::runtime_error("libpd was built without PDINSTANCE, so it has only one instance");
+        ++s_instances;
+#endif
     }
 
-    virtual void uninitialize() {}
+#if defined(PDINSTANCE) && defined(PDTHREADS)
+    m_mutex = &m_ownMutex;
+#else
+    m_mutex = &libraryMutex();
+#endif
 
-    // Processes the source to destination bus.  The number of channels must match in source and destination.
-    virtual void process(const lab::AudioBus * source, lab::AudioBus * destination, size_t framesToProcess)
-    {
-        if (!numChannels)
-            return;
+    std::unique_lock<std::mutex> lock = acquire();
+    libpd_init_audio(inputs, outputs, static_cast<int>(sampleRate));
+    libpd_start_message(1);
+    libpd_add_float(1.f);
+    libpd_finish_message("pd", "dsp");
+}
 
-        int ticks = framesToProcess >> blockSizeAsLog;  // this is a faster way of computing (inNumberFrames / blockSize)
-        const float * inData = source->channel(0)->data();
-        float * outData = destination->channel(0)->mutableData();
-        pd.processFloat(ticks, inData, outData);
-    }
+PdInstance::~PdInstance()
+{
+    std::unique_lock<std::mutex> lock = acquire();
+    for (void * patch : m_patches)
+        libpd_closefile(patch);
+    libpd_start_message(1);
+    libpd_add_float(0.f);
+    libpd_finish_message("pd", "dsp");
+#ifdef PDINSTANCE
+    libpd_free_instance(static_cast<t_pdinstance *>(m_instance));
+#else
+    --s_instances;
+#endif
+}
 
-    // Resets filter state
-    virtual void reset() {}
+int PdInstance::blockSize()
+{
+    return libpd_blocksize();
+}
 
-    virtual void setNumberOfChannels(unsigned i)
-    {
-        numChannels = i;
-    }
+std::unique_lock<std::mutex> PdInstance::acquire()
+{
+    std::unique_lock<std::mutex> lock(*m_mutex);
+#ifdef PDINSTANCE
+    libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+#endif
+    return lock;
+}
 
-    virtual double tailTime() const { return 0; }
-    virtual double latencyTime() const { return 0; }
+void PdInstance::perform(const std::function<void()> & fn)
+{
+    std::unique_lock<std::mutex> lock = acquire();
+    fn();
+}
 
-    // return true on successful initialization
-    bool initPure(const int numInChannels, const int numOutChannels,
-                  const int sampleRate, const int ticksPerBuffer);
+bool PdInstance::openPatch(const std::string & file, const std::string & directory)
+{
+    std::unique_lock<std::mutex> lock = acquire();
+    void * patch = libpd_openfile(file.c_str(), directory.c_str());
+    if (!patch)
+        return false;
+    m_patches.push_back(patch);
+    return true;
+}
 
-    /// print
-    virtual void print(const std::string & message);
+void PdInstance::closePatches()
+{
+    std::unique_lock<std::mutex> lock = acquire();
+    for (void * patch : m_patches)
+        libpd_closefile(patch);
+    m_patches.clear();
+}
 
-    pd::PdBase pd;
+void PdInstance::sendBang(const std::string & receiver)
+{
+    std::unique_lock<std::mutex> lock = acquire();
+    libpd_bang(receiver.c_str());
+}
 
-    int numChannels;
-    int pdBuffSize;
-    int blockSizeAsLog;
-};
+void PdInstance::sendFloat(const std::string & receiver, float value)
+{
+    std::unique_lock<std::mutex> lock = acquire();
+    libpd_float(receiver.c_str(), value);
+}
 
-namespace
+void PdInstance::attach(int renderQuantum)
 {
-    //http://graphics.stanford.edu/~seander/bithacks.html#IntegerLogObvious
-    int log2int(int x)
-    {
-        if (x < 1)
-        {
-            return -1;
-        }
-        int y = 1;
-        while (x >>= 1)
-        {
-            ++y;
-        }
-        return y;
-    }
-}  // anon
+    std::unique_lock<std::mutex> lock = acquire();
+    const size_t in = size_t(renderQuantum) * m_inputs;
+    const size_t out = size_t(renderQuantum) * m_outputs;
+    if (m_in.size() < in)
+        m_in.resize(in, 0.f);
+    if (m_out.size() < out)
+        m_out.resize(out, 0.f);
+    ++m_nodes;
+}
 
-// return true on successful initialization
-bool PdNode::PdNodeInternal::initPure(const int numInChannels, const int numOutChannels,
-                                      const int sampleRate, const int ticksPerBuffer)
+void PdInstance::detach()
 {
+    std::unique_lock<std::mutex> lock = acquire();
+    --m_nodes;
+}
 
-    if (!pd.init(numInChannels, numOutChannels, sampleRate))
+void PdInstance::render(uint64_t frame, const AudioBus * source, int firstInput, int inputCount,
+                        AudioBus * destination, int firstOutput, int outputCount, int frames)
+{
+    const int block = blockSize();
+    const int ticks = frames / block;
+    if (size_t(frames) * m_inputs > m_in.size() || size_t(frames) * m_outputs > m_out.size())
     {
-        return false;
+        destination->zero();
+        return;
     }
-    blockSizeAsLog = log2int(libpd_blocksize());
 
-    // subscribe to receive source names
-    pd.subscribe("toOF");
-    pd.subscribe("env");
+    auto stage = [&]() {
+        const int sourceChannels = source ? source->numberOfChannels() : 0;
+        for (int c = 0; c < inputCount; ++c)
+        {
+            const float * from = c < sourceChannels ? source->channel(c)->data() : nullptr;
+            float * to = m_in.data() + size_t(firstInput + c) * block;
+            for (int t = 0; t < ticks; ++t, to += size_t(m_inputs) * block)
+            {
+                if (from)
+                    memcpy(to, from + size_t(t) * block, sizeof(float) * block);
+                else
+                    std::fill(to, to + block, 0.f);
+            }
+        }
+    };
 
-    // add the data/pd folder to the search path
-    pd.addToSearchPath("pd");
+    // a node alone on its instance is heard at once; the nodes sharing one are heard a
+    // quantum later, so that it doesn't matter which of them renders first
+    const bool shared = m_nodes.load(std::memory_order_relaxed) > 1;
+    if (!shared)
+        stage();
 
-    // audio processing on
-    pd.computeAudio(true);
+    if (frame != m_renderedFrame)
+    {
+        m_renderedFrame = frame;
+        for (int t = 0; t < ticks; ++t)
+            libpd_process_raw(m_in.data() + size_t(t) * m_inputs * block, m_out.data() + size_t(t) * m_outputs * block);
+    }
 
-    return true;
+    const int destinationChannels = destination->numberOfChannels();
+    for (int c = 0; c < destinationChannels; ++c)
+    {
+        float * to = destination->channel(c)->mutableData();
+        if (c >= outputCount)
+        {
+            std::fill(to, to + frames, 0.f);
+            continue;
+        }
+        const float * from = m_out.data() + size_t(firstOutput + c) * block;
+        for (int t = 0; t < ticks; ++t, from += size_t(m_outputs) * block)
+            memcpy(to + size_t(t) * block, from, sizeof(float) * block);
+    }
+
+    if (shared)
+        stage();
 }
 
-//--------------------------------------------------------------
-void PdNode::PdNodeInternal::print(const std::string & message)
+AudioNodeDescriptor * PdNode::desc()
 {
-    std::cout << message << std::endl;
+    static AudioNodeDescriptor d {nullptr, nullptr, 2};
+    return &d;
 }
 
-pd::PdBase & PdNode::pd() const
+PdNode::PdNode(AudioContext & ac, int inputChannels, int outputChannels)
+    : PdNode(ac, std::make_shared<PdInstance>(inputChannels, outputChannels, ac.sampleRate()), inputChannels, outputChannels)
 {
-    return data->pd;
 }
 
-PdNode::PdNode(lab::AudioContext * context, float sampleRate)
-    : lab::AudioBasicProcessorNode(context, sampleRate)
-    , data(new PdNodeInternal(sampleRate))
+PdNode::PdNode(AudioContext & ac, std::shared_ptr<PdInstance> instance, int inputChannels, int outputChannels,
+               int firstInput, int firstOutput)
+    : AudioNode(ac, {nullptr, nullptr, outputChannels})
+    , _instance(std::move(instance))
+    , _firstInput(firstInput)
+    , _firstOutput(firstOutput)
+    , _inputChannels(inputChannels)
+    , _outputChannels(outputChannels)
 {
-    // Initially setup as lowpass filter.
-    m_processor = std::move(std::unique_ptr<lab::AudioProcessor>(data));
-
-    setNodeType((AudioNode::NodeType) lab::NodeTypePd);
-
-    addInput(adoptPtr(new lab::AudioNodeInput(this)));
-    addOutput(adoptPtr(new lab::AudioNodeOutput(this, 2)));  // 2 stereo
-
-    data->initPure(2, 2, sampleRate, 128);
-
+    if (!_instance)
+        throw std::invalid_argument("A PdNode needs an instance");
+    if (inputChannels < 0 || outputChannels < 1 || firstInput < 0 || firstOutput < 0
+        || firstInput + inputChannels > _instance->inputs() || firstOutput + outputChannels > _instance->outputs())
+        throw std::invalid_argument("A PdNode's channels must lie within its instance's");
+    if (renderQuantumSize() % PdInstance::blockSize())
+        throw std::invalid_argument("A PdNode needs a render quantum that is a multiple of libpd's block size");
+
+    _self->m_channelCount = std::max(1, inputChannels);
+    _self->m_channelCountMode = ChannelCountMode::Explicit;
+    _self->m_channelInterpretation = ChannelInterpretation::Discrete;
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+    _instance->attach(renderQuantumSize());
     initialize();
 }
 
 PdNode::~PdNode()
 {
-    data->numChannels = 0;  // ensure there if there is a latent callback pending, pd is not invoked
-    data = 0;
+    _instance->detach();
     uninitialize();
 }
 
-bool PdNode::propagatesSilence() const
+void PdNode::process(ContextRenderLock & r, int bufferSize)
 {
-    return !data->pd.isInited();
+    AudioBus * outputBus = output(0)->bus(r);
+    if (!isInitialized())
+    {
+        outputBus->zero();
+        return;
+    }
+
+    AudioBus * inputBus = _inputChannels && input(0)->isConnected() ? input(0)->bus(r) : nullptr;
+    {
+        std::unique_lock<std::mutex> lock = _instance->acquire();
+        _instance->render(r.context()->currentSampleFrame(), inputBus, _firstInput, _inputChannels,
+                          outputBus, _firstOutput, _outputChannels, bufferSize);
+    }
+    outputBus->clearSilentFlag();
 }
 
-}  // LabSound
+double PdNode::latencyTime(ContextRenderLock & r) const
+{
+    if (_instance->m_nodes.load(std::memory_order_relaxed) > 1)
+        return double(renderQuantumSize()) / r.context()->sampleRate();
+    return 0;
+}
 
-#endif
+}  // namespace lab
+
+#endif  // PD
@@ -7,6 +7,7 @@
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioProcessor.h"
+#include "LabSound/core/AudioSetting.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/PeakCompNode.h"
@@ -14,6 +15,8 @@
 
 #include "LabSound/core/Macros.h"
 
+#include "internal/Lanes4.h"
+
 #include <algorithm>
 #include <vector>
 
@@ -34,26 +37,47 @@ static AudioParamDescriptor s_pcParams[] = {
     {"makeup",    "MAKE", 0.0,   0,   60},
     {"knee",      "KNEE", 0.0,   0,    1}, nullptr };
 
-    
+static AudioSettingDescriptor s_pcSettings[] = {{"linked", "LINK", SettingType::Bool}, nullptr};
+
 AudioNodeDescriptor * PeakCompNode::desc()
 {
-    static AudioNodeDescriptor d {s_pcParams, nullptr, 1};
+    static AudioNodeDescriptor d {s_pcParams, s_pcSettings, 1};
     return &d;
 }
 
 
-class PeakCompNode::PeakCompNodeInternal : public AudioProcessor
+// The compressor's state, per detector: one for the linked channels, or one per channel
+struct PeakCompState
 {
-public:
-    PeakCompNodeInternal() : AudioProcessor()
+    float release = 0.f;
+    float attack = 0.f;
+    float knee = 0.f;
+};
+
+// The gain computer, (threshold + ratio * (envelope - threshold)) / envelope clamped to
+// [0, 1], over four frames at a time
+static void computeGain(const float * envelope, float * gain, float threshold, float ratio, int frames)
+{
+    int i = 0;
+    for (; i + 4 <= frames; i += 4)
     {
-        for (int i = 0; i < 2; i++)
-        {
-            kneeRecursive[i] = 0.f;
-            attackRecursive[i] = 0.f;
-            releaseRecursive[i] = 0.f;
-        }
+        const Lanes4 e = Lanes4::load(envelope + i);
+        const Lanes4 g = (Lanes4(threshold) + Lanes4(ratio) * (e - Lanes4(threshold))) / e;
+        maxOf(minOf(g, Lanes4(1.f)), Lanes4(0.f)).store(gain + i);
     }
+    for (; i < frames; ++i)
+    {
+        const float e = envelope[i];
+        gain[i] = maxOf(minOf((threshold + ratio * (e - threshold)) / e, 1.f), 0.f);
+    }
+}
+
+class PeakCompNode::PeakCompNodeInternal : public AudioProcessor
+{
+public:
+    static const int MaxChannels = 16;
+
+    PeakCompNodeInternal() : AudioProcessor() {}
 
     virtual ~PeakCompNodeInternal() {}
 
@@ -61,6 +85,68 @@ public:
 
     virtual void uninitialize() override {}
 
+    // Compresses the channels by one detector: their peak, the greatest magnitude across the
+    // channels, is followed by the release and attack envelopes, which the gain computer
+    // turns into a gain, smoothed by the knee and applied to every channel alike. The
+    // elementwise passes run four frames at a time, and the recursive ones, left scalar,
+    // are each a couple of multiply-adds a frame.
+    void compress(PeakCompState & state, const float * const * source, float * const * dest, int channels, int frames)
+    {
+        float * envelope = m_envelope.data();
+        float * gain = m_gain.data();
+
+        // the peak across the channels
+        int i = 0;
+        for (; i + 4 <= frames; i += 4)
+        {
+            Lanes4 peak = absOf(Lanes4::load(source[0] + i));
+            for (int c = 1; c < channels; ++c)
+                peak = maxOf(peak, absOf(Lanes4::load(source[c] + i)));
+            peak.store(envelope + i);
+        }
+        for (; i < frames; ++i)
+        {
+            float peak = absOf(source[0][i]);
+            for (int c = 1; c < channels; ++c)
+                peak = maxOf(peak, absOf(source[c][i]));
+            envelope[i] = peak;
+        }
+
+        // release, then attack
+        float release = state.release;
+        float attack = state.attack;
+        for (i = 0; i < frames; ++i)
+        {
+            const float peak = envelope[i];
+            release = releaseCoeffMinus * peak + releaseCoeff * maxOf(peak, release);
+            attack = attackCoeffsMinus * release + attackCoeffs * attack + 0.000001f;  // avoid div by 0
+            envelope[i] = attack;
+        }
+        state.release = release;
+        state.attack = attack;
+
+        computeGain(envelope, gain, threshold, ratio, frames);
+
+        // knee smoothing, and makeup
+        float knee = state.knee;
+        for (i = 0; i < frames; ++i)
+        {
+            knee = kneeCoeffsMinus * gain[i] + kneeCoeffs * knee;
+            gain[i] = knee * makeupGain;
+        }
+        state.knee = knee;
+
+        for (int c = 0; c < channels; ++c)
+        {
+            const float * in = source[c];
+            float * out = dest[c];
+            for (i = 0; i + 4 <= frames; i += 4)
+                (Lanes4::load(in + i) * Lanes4::load(gain + i)).store(out + i);
+            for (; i < frames; ++i)
+                out[i] = in[i] * gain[i];
+        }
+    }
+
     // Processes the source to destination bus.  The number of channels must match in source and destination.
     virtual void process(ContextRenderLock & r, const lab::AudioBus * sourceBus, lab::AudioBus * destinationBus, int framesToProcess) override
     {
@@ -132,86 +218,75 @@ public:
         }
 
         // calc coefficients from run time vars
-        kneeCoeffs = exp(0. - (oneOverSampleRate / knee));
-        kneeCoeffsMinus = 1. - kneeCoeffs;
+        kneeCoeffs = static_cast<float>(exp(0. - (oneOverSampleRate / knee)));
+        kneeCoeffsMinus = 1.f - kneeCoeffs;
 
-        attackCoeffs = exp(0. - (oneOverSampleRate / attack));
-        attackCoeffsMinus = 1. - attackCoeffs;
+        attackCoeffs = static_cast<float>(exp(0. - (oneOverSampleRate / attack)));
+        attackCoeffsMinus = 1.f - attackCoeffs;
 
-        releaseCoeff = exp(0. - (oneOverSampleRate / release));
-        releaseCoeffMinus = 1. - releaseCoeff;
+        releaseCoeff = static_cast<float>(exp(0. - (oneOverSampleRate / release)));
+        releaseCoeffMinus = 1.f - releaseCoeff;
 
-        // Handle both the 1 -> N and N -> N case here.
-        const float * source[16];
-        for (int i = 0; i < sourceNumChannels; ++i)
+        if (m_envelope.size() < framesToProcess)
         {
-            if (sourceBus->numberOfChannels() == sourceNumChannels)
-                source[i] = sourceBus->channel(i)->data();
-            else
-                source[i] = sourceBus->channel(0)->data();
+            m_envelope.allocate(framesToProcess);
+            m_gain.allocate(framesToProcess);
         }
 
-        float * dest[16];
-        for (int i = 0; i < destNumChannels; ++i)
+        // Handle both the 1 -> N and N -> N case here.
+        const int channels = std::min(destNumChannels, static_cast<int>(MaxChannels));
+        const float * source[MaxChannels];
+        float * dest[MaxChannels];
+        for (int i = 0; i < channels; ++i)
+        {
+            source[i] = sourceBus->channel(sourceNumChannels == destNumChannels ? i : 0)->data();
             dest[i] = destinationBus->channel(i)->mutableData();
+        }
+        for (int i = channels; i < destNumChannels; ++i)
+            destinationBus->channel(i)->zero();
 
-        for (int i = 0; i < framesToProcess; ++i)
+        // linked, the channels share a detector, so that a peak in one channel doesn't shift the image
+        if (m_linked->valueBool())
+            compress(m_state[0], source, dest, channels, framesToProcess);
+        else
         {
-            float peakEnv = 0;
-            for (int j = 0; j < sourceNumChannels; ++j)
-            {
-                peakEnv += source[j][i];
-            }
-            // Release recursive
-            releaseRecursive[0] = (releaseCoeffMinus * peakEnv) + (releaseCoeff * std::max(peakEnv, float(releaseRecursive[1])));
-
-            // Attack recursive
-            attackRecursive[0] = ((attackCoeffsMinus * releaseRecursive[0]) + (attackCoeffs * attackRecursive[1])) + 0.000001f;  // avoid div by 0
-
-            // Knee smoothening and gain reduction
-            kneeRecursive[0] = (kneeCoeffsMinus * std::max(std::min(((threshold + (ratio * (attackRecursive[0] - threshold))) / attackRecursive[0]), 1.), 0.)) + (kneeCoeffs * kneeRecursive[1]);
-
-            int k = std::min(sourceNumChannels, destNumChannels);
-            for (int j = 0; j < k; ++j)
-            {
-                dest[j][i] = static_cast<float>(source[j][i] * kneeRecursive[0] * makeupGain);
-            }
+            for (int c = 0; c < channels; ++c)
+                compress(m_state[c], source + c, dest + c, 1, framesToProcess);
         }
-
-        releaseRecursive[1] = releaseRecursive[0];
-        attackRecursive[1] = attackRecursive[0];
-        kneeRecursive[1] = kneeRecursive[0];
     }
 
     float internalSampleRate = 44000.f;
     double oneOverSampleRate = 1.0 / 44000.f;
 
-    // Arrays for delay lines
-    double kneeRecursive[2];
-    double attackRecursive[2];
-    double releaseRecursive[2];
+    // the detectors, the first of which is the linked one
+    PeakCompState m_state[MaxChannels];
+
+    // a quantum of the envelope, and of the gain
+    AudioFloatArray m_envelope;
+    AudioFloatArray m_gain;
 
     double attack = 0.;
     double release = 0.;
-    double ratio = 1.;
-    double threshold = 0.;
+    float ratio = 1.f;
+    float threshold = 0.f;
 
     double knee = 0;
-    double kneeCoeffs = 0;
-    double kneeCoeffsMinus = 0;
+    float kneeCoeffs = 0;
+    float kneeCoeffsMinus = 0;
 
-    double attackCoeffs = 0;
-    double attackCoeffsMinus = 0;
+    float attackCoeffs = 0;
+    float attackCoeffsMinus = 0;
 
-    double releaseCoeff = 0;
-    double releaseCoeffMinus = 0;
+    float releaseCoeff = 0;
+    float releaseCoeffMinus = 0;
 
-    double makeupGain = 0;
+    float makeupGain = 0;
 
     // Resets filter state
     virtual void reset() override
-    { 
-        // @tofix
+    {
+        for (auto & state : m_state)
+            state = PeakCompState();
     }
 
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
@@ -223,6 +298,7 @@ public:
     std::shared_ptr<AudioParam> m_release;
     std::shared_ptr<AudioParam> m_makeup;
     std::shared_ptr<AudioParam> m_knee;
+    std::shared_ptr<AudioSetting> m_linked;
 };
 
 std::shared_ptr<AudioParam> PeakCompNode::threshold() const
@@ -255,6 +331,11 @@ std::shared_ptr<AudioParam> PeakCompNode::knee() const
     return internalNode->m_knee;
 }
 
+std::shared_ptr<AudioSetting> PeakCompNode::linked() const
+{
+    return internalNode->m_linked;
+}
+
 /////////////////////////
 // Public PeakCompNode //
 /////////////////////////
@@ -271,6 +352,9 @@ PeakCompNode::PeakCompNode(AudioContext & ac)
     n->m_release = param("release");
     n->m_makeup = param("makeup");
     n->m_knee = param("knee");
+    n->m_linked = setting("linked");
+    n->m_linked->setBool(true);
+    internalNode = n;
     initialize();
 }
 
@@ -1,90 +1,275 @@
 // SPDX-License-Identifier: BSD-2-Clause
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
+#include "LabSound/core/AudioArray.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
-#include "LabSound/core/AudioProcessor.h"
+#include "LabSound/core/AudioSetting.h"
 #include "LabSound/core/Macros.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/PingPongDelayNode.h"
 #include "LabSound/extended/Util.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/AudioUtilities.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 using namespace lab;
 
 namespace lab
 {
+
+// The longest delay, three beats at 22.5 beats per minute
+static const double MaxDelayTime = 8.0;
+
+// The delay time approaches a new setting over this time constant, as a DelayNode's does
+static const double SmoothingTimeConstant = 0.020;
+
+// The length of each TempoSync note in beats
+static const float s_noteBeats[] = {
+    1.f / 8.f,
+    (1.f / 4.f) * 2.f / 3.f,
+    (1.f / 8.f) * 3.f / 2.f,
+    1.f / 4.f,
+    (1.f / 2.f) * 2.f / 3.f,
+    (1.f / 4.f) * 3.f / 2.f,
+    1.f / 2.f,
+    1.f * 2.f / 3.f,
+    (1.f / 2.f) * 3.f / 2.f,
+    1.0f,
+    2.f * 2.f / 3.f,
+    1.f * 3.f / 2.f,
+    2.f,
+    3.f};
+
+static AudioParamDescriptor s_ppParams[] = {
+    {"feedback", "FDBK", 0.5, 0.0, 1.0},
+    {"level",    "LEVL", 1.0, 0.0, 1.0}, nullptr};
+
+static AudioSettingDescriptor s_ppSettings[] = {{"delayTime", "DELY", SettingType::Float}, nullptr};
+
+// The fused stages of a PingPongDelayNode. The left and right delay lines are rings that
+// are written and read a frame at a time, since each feeds the other.
+class PingPongDelay : public AudioNode
+{
+public:
+    explicit PingPongDelay(AudioContext & ac)
+        : AudioNode(ac, *desc())
+        , m_writeIndex(0)
+        , m_delayFrames(0)
+        , m_firstTime(true)
+        , m_mono(AudioNode::ProcessingSizeInFrames)
+    {
+        addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+        m_feedback = param("feedback");
+        m_level = param("level");
+        m_delayTime = setting("delayTime");
+
+        const int frames = 2 + static_cast<int>(MaxDelayTime * ac.sampleRate());
+        int length = 1;
+        while (length < frames)
+            length <<= 1;
+        m_left.allocate(length);
+        m_right.allocate(length);
+        m_mask = length - 1;
+
+        m_smoothingRate = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, ac.sampleRate());
+
+        initialize();
+    }
+
+    virtual ~PingPongDelay()
+    {
+        uninitialize();
+    }
+
+    static const char * static_name() { return "PingPongDelay"; }
+    virtual const char * name() const override { return static_name(); }
+
+    static AudioNodeDescriptor * desc()
+    {
+        static AudioNodeDescriptor d {s_ppParams, s_ppSettings, 2};
+        return &d;
+    }
+
+    std::shared_ptr<AudioParam> feedback() const { return m_feedback; }
+    std::shared_ptr<AudioParam> level() const { return m_level; }
+    std::shared_ptr<AudioSetting> delayTime() const { return m_delayTime; }
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override
+    {
+        AudioBus * outputBus = output(0)->bus(r);
+        AudioBus * inputBus = input(0)->bus(r);
+
+        if (!isInitialized() || !input(0)->isConnected() || !inputBus || !inputBus->numberOfChannels())
+        {
+            outputBus->zero();
+            return;
+        }
+
+        const double sampleRate = r.context()->sampleRate();
+        const double delayTime = std::min(MaxDelayTime, std::max(1.0 / sampleRate, static_cast<double>(m_delayTime->valueFloat())));
+        const double targetFrames = delayTime * sampleRate;
+        if (m_firstTime)
+        {
+            m_delayFrames = targetFrames;
+            m_firstTime = false;
+        }
+
+        const float feedback = clampTo<float>(m_feedback->value(), 0.0f, 1.0f);
+        const float level = clampTo<float>(m_level->value(), 0.0f, 1.0f);
+
+        if (bufferSize > m_mono.size())
+            m_mono.allocate(bufferSize);
+
+        // the input averaged to mono, at the level of the wet signal
+        float * mono = m_mono.data();
+        if (inputBus->numberOfChannels() > 1)
+        {
+            const float scale = 0.5f * level;
+            VectorMath::vadd(inputBus->channel(0)->data(), 1, inputBus->channel(1)->data(), 1, mono, 1, bufferSize);
+            VectorMath::vsmul(mono, 1, &scale, mono, 1, bufferSize);
+        }
+        else
+            VectorMath::vsmul(inputBus->channel(0)->data(), 1, &level, mono, 1, bufferSize);
+
+        float * left = m_left.data();
+        float * right = m_right.data();
+        float * destinationL = outputBus->channel(0)->mutableData();
+        float * destinationR = outputBus->channel(1)->mutableData();
+        const int mask = m_mask;
+        int writeIndex = m_writeIndex;
+        double delayFrames = m_delayFrames;
+
+        for (int i = 0; i < bufferSize; ++i)
+        {
+            // Approach desired delay time.
+            delayFrames += (targetFrames - delayFrames) * m_smoothingRate;
+
+            // the two frames the delayed position lies between, both at least a frame old
+            const int wholeFrames = static_cast<int>(delayFrames);
+            const float t = 1.f - static_cast<float>(delayFrames - wholeFrames);
+            const int k0 = (writeIndex - wholeFrames - 1) & mask;
+            const int k1 = (k0 + 1) & mask;
+
+            const float leftOut = left[k0] + (left[k1] - left[k0]) * t;
+            const float rightOut = right[k0] + (right[k1] - right[k0]) * t;
+
+            left[writeIndex] = mono[i] + feedback * rightOut;
+            right[writeIndex] = leftOut;
+            writeIndex = (writeIndex + 1) & mask;
+
+            destinationL[i] = leftOut;
+            destinationR[i] = rightOut;
+        }
+
+        m_writeIndex = writeIndex;
+        m_delayFrames = delayFrames;
+        outputBus->clearSilentFlag();
+    }
+
+    virtual void reset(ContextRenderLock &) override
+    {
+        m_left.zero();
+        m_right.zero();
+        m_firstTime = true;
+    }
+
+    // The echoes ring on until they have fallen 60 dB, two delays per round trip
+    virtual double tailTime(ContextRenderLock & r) const override
+    {
+        const double feedback = m_feedback->value();
+        if (feedback >= 0.999)
+            return std::numeric_limits<double>::infinity();
+
+        const double roundTrips = feedback > 0 ? std::log(0.001) / std::log(feedback) : 0;
+        return 2 * (1 + roundTrips) * m_delayTime->valueFloat();
+    }
+
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    // the output is stereo whatever the input
+    virtual void conformChannelCounts() override {}
+
+private:
+    std::shared_ptr<AudioParam> m_feedback;
+    std::shared_ptr<AudioParam> m_level;
+    std::shared_ptr<AudioSetting> m_delayTime;
+
+    AudioFloatArray m_left;
+    AudioFloatArray m_right;
+    int m_mask;
+    int m_writeIndex;
+    double m_delayFrames;
+    double m_smoothingRate;
+    bool m_firstTime;
+
+    AudioFloatArray m_mono;
+};
+
 PingPongDelayNode::PingPongDelayNode(AudioContext & ac, float tempo)
+    : tempo(tempo)
+    , delayIndex(TempoSync::TS_8)
 {
     input = std::make_shared<lab::GainNode>(ac);
     output = std::make_shared<lab::GainNode>(ac);
-    
-    leftDelay = std::make_shared<lab::BPMDelay>(ac, tempo);
-    rightDelay = std::make_shared<lab::BPMDelay>(ac, tempo);
-    
-    splitterGain = std::make_shared<lab::GainNode>(ac);
-    wetGain = std::make_shared<lab::GainNode>(ac);
-    feedbackGain = std::make_shared<lab::GainNode>(ac);
-    
-    merger = std::make_shared<lab::ChannelMergerNode>(ac, 2);
-    splitter = std::make_shared<lab::ChannelSplitterNode>(ac, 2);
-    
+    delay = std::make_shared<PingPongDelay>(ac);
+
     SetDelayIndex(TempoSync::TS_8);
     SetFeedback(0.5f);
     SetLevel(1.0f);
 }
 
+PingPongDelay * PingPongDelayNode::pingPong() const
+{
+    return static_cast<PingPongDelay *>(delay.get());
+}
+
+void PingPongDelayNode::recomputeDelay()
+{
+    pingPong()->delayTime()->setFloat(60.f * s_noteBeats[delayIndex] / tempo);
+}
+
 void PingPongDelayNode::SetTempo(float t)
 {
     tempo = t;
-    leftDelay->SetTempo(tempo);
-    rightDelay->SetTempo(tempo);
+    recomputeDelay();
 }
 
 void PingPongDelayNode::SetFeedback(float f)
 {
     auto clamped = clampTo<float>(f, 0.0f, 1.0f);
-    feedbackGain->gain()->setValue(clamped);
+    pingPong()->feedback()->setValue(clamped);
 }
 
 void PingPongDelayNode::SetLevel(float f)
 {
     auto clamped = clampTo<float>(f, 0.0f, 1.0f);
-    wetGain->gain()->setValue(clamped);
+    pingPong()->level()->setValue(clamped);
 }
 
 void PingPongDelayNode::SetDelayIndex(TempoSync value)
 {
-    leftDelay->SetDelayIndex(value);
-    rightDelay->SetDelayIndex(value);
+    if (value < TempoSync::TS_32 || value > TempoSync::TS_2D)
+        throw std::invalid_argument("Delay index out of bounds");
+
+    delayIndex = value;
+    recomputeDelay();
 }
 
 void PingPongDelayNode::BuildSubgraph(AudioContext & ac)
 {
-    /// @TODO rewrite with individual splitters
-    // Input into splitter
-    ac.connect(splitter, input, 0, 0);
-    
-    ac.connect(splitterGain, splitter, 0, 0);
-    ac.connect(splitterGain, splitter, 0, 1);
-    
-    ac.connect(wetGain, splitterGain, 0, 0);
-    splitterGain->gain()->setValue(0.5f);
-    
-    ac.connect(leftDelay, wetGain, 0, 0);
-    ac.connect(leftDelay, feedbackGain, 0, 0);
-    
-    ac.connect(rightDelay, leftDelay, 0, 0);
-    ac.connect(feedbackGain, rightDelay, 0, 0);
-    
-    ac.connect(merger, leftDelay, 0, 0);
-    ac.connect(merger, rightDelay, 1, 0);
-    
-    ac.connect(output, merger, 0, 0);
-    
+    ac.connect(delay, input, 0, 0);
+    ac.connect(output, delay, 0, 0);
+
     // Activate with input->output
     ac.connect(output, input, 0, 0);
 }
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/PolyBLEPBankNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/Registry.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+
+#include "internal/PolyBLEP.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lab;
+
+// the waveforms with branch free kernels, in PolyBLEPType order
+static char const * const s_bank_types[] = {
+    "Triangle", "Square", "Rectangle", "Sawtooth", "Ramp", nullptr};
+
+static AudioSettingDescriptor s_bankSettings[] = {{"type", "TYPE", SettingType::Enum, s_bank_types}, nullptr};
+
+AudioNodeDescriptor * PolyBLEPBankNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_bankSettings, 1};
+    return &d;
+}
+
+PolyBLEPBankNode::PolyBLEPBankNode(AudioContext & ac)
+    : AudioScheduledSourceNode(ac, *desc())
+    , m_targetFrequency(MaxVoices)
+    , m_targetAmplitude(MaxVoices)
+    , m_phase(MaxVoices, 0.f)
+    , m_increment(MaxVoices, 0.f)
+    , m_reciprocalIncrement(MaxVoices, 0.f)
+    , m_amplitude(MaxVoices, 0.f)
+    , m_amplitudeStep(MaxVoices, 0.f)
+    , m_renderTarget(MaxVoices, 0.f)
+{
+    for (int i = 0; i < MaxVoices; ++i)
+    {
+        m_targetFrequency[i].store(440.f);
+        m_targetAmplitude[i].store(0.f);
+    }
+
+    m_type = setting("type");
+    setType(PolyBLEPType::SAWTOOTH);
+    initialize();
+}
+
+PolyBLEPBankNode::~PolyBLEPBankNode()
+{
+    uninitialize();
+}
+
+PolyBLEPType PolyBLEPBankNode::type() const
+{
+    return PolyBLEPType(m_type->valueUint32());
+}
+
+void PolyBLEPBankNode::setType(PolyBLEPType type)
+{
+    if (!PolyBLEP::hasKernel(type))
+        throw std::out_of_range("PolyBLEPBankNode supports triangle, square, rectangle, sawtooth, and ramp waves");
+    m_type->setUint32(static_cast<uint32_t>(type));
+}
+
+void PolyBLEPBankNode::setVoice(int voice, float frequency, float amplitude)
+{
+    setVoiceFrequency(voice, frequency);
+    setVoiceAmplitude(voice, amplitude);
+}
+
+void PolyBLEPBankNode::setVoiceFrequency(int voice, float frequency)
+{
+    if (voice < 0 || voice >= MaxVoices)
+        throw std::out_of_range("PolyBLEPBankNode voice index out of range");
+    m_targetFrequency[voice].store(frequency);
+}
+
+void PolyBLEPBankNode::setVoiceAmplitude(int voice, float amplitude)
+{
+    if (voice < 0 || voice >= MaxVoices)
+        throw std::out_of_range("PolyBLEPBankNode voice index out of range");
+    m_targetAmplitude[voice].store(amplitude);
+}
+
+void PolyBLEPBankNode::reset(ContextRenderLock &)
+{
+    std::fill(m_phase.begin(), m_phase.end(), 0.f);
+}
+
+void PolyBLEPBankNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+
+    const int offset = _self->_scheduler._renderOffset;
+    const int count = _self->_scheduler._renderLength;
+
+    if (!r.context() || !isInitialized() || !outputBus->numberOfChannels() || !count)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    // pick up the voices' targets; only lanes up to the highest sounding voice are rendered
+    const float k = 1.f / r.context()->sampleRate();
+    int voices = 0;
+    for (int i = 0; i < MaxVoices; ++i)
+    {
+        const float target = m_targetAmplitude[i].load(std::memory_order_relaxed);
+        if (target != 0.f || m_amplitude[i] != 0.f)
+        {
+            voices = i + 1;
+            const float dt = std::min(0.5f, std::max(1e-7f, m_targetFrequency[i].load(std::memory_order_relaxed) * k));
+            m_increment[i] = dt;
+            m_reciprocalIncrement[i] = 1.f / dt;
+            m_renderTarget[i] = target;
+            m_amplitudeStep[i] = (target - m_amplitude[i]) / static_cast<float>(count);
+        }
+    }
+
+    outputBus->zero();
+    if (!voices)
+        return;
+
+    // lanes are rendered in fours; the extra lanes are silent
+    const int lanes = std::min(MaxVoices, (voices + 3) & ~3);
+    float * phase = m_phase.data();
+    const float * increment = m_increment.data();
+    const float * reciprocal = m_reciprocalIncrement.data();
+    float * amplitude = m_amplitude.data();
+    const float * step = m_amplitudeStep.data();
+    float * destination = outputBus->channel(0)->mutableData() + offset;
+
+    PolyBLEP::dispatch(type(), [&](auto kernel) {
+        const Lanes4 pulseWidth(0.5f);
+        for (int f = 0; f < count; ++f)
+        {
+            Lanes4 sum(0.f);
+            for (int i = 0; i < lanes; i += 4)
+            {
+                const Lanes4 t = Lanes4::load(phase + i);
+                const Lanes4 dt = Lanes4::load(increment + i);
+                const Lanes4 a = Lanes4::load(amplitude + i);
+                sum = sum + a * kernel.sample(t, dt, Lanes4::load(reciprocal + i), pulseWidth);
+                (a + Lanes4::load(step + i)).store(amplitude + i);
+                PolyBLEP::wrap(t + dt).store(phase + i);
+            }
+            destination[f] = sum.sum();
+        }
+    });
+
+    // land exactly on the targets, so that silenced voices drop out of the bank
+    for (int i = 0; i < voices; ++i)
+    {
+        m_amplitude[i] = m_renderTarget[i];
+        m_amplitudeStep[i] = 0.f;
+    }
+
+    outputBus->clearSilentFlag();
+}
+
+bool PolyBLEPBankNode::propagatesSilence(ContextRenderLock & r) const
+{
+    return !isPlayingOrScheduled() || hasFinished();
+}
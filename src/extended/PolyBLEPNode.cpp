@@ -15,6 +15,7 @@
 
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
+#include "internal/PolyBLEP.h"
 
 #include <algorithm>
 
@@ -374,12 +375,14 @@ public:
     void setWaveform(const PolyBLEPType waveform) { type = waveform; }
     void setSampleRate(float sr) { sampleRate = sr; }
     double getFreqInHz() const { return freqInSecondsPerSample * sampleRate; }
+    double getFreqInCyclesPerSample() const { return freqInSecondsPerSample; }
+    double getPhase() const { return t; }
 };
 
 // clang-format on
 
 static char const * const s_polyblep_types[] = {
-    "Triangle", "Square", "Sawtooth", "Ramp", "Modified_Triangle", "Modified_Square", "Half Wave Rectified Sine",
+    "Triangle", "Square", "Rectangle", "Sawtooth", "Ramp", "Modified_Triangle", "Modified_Square", "Half Wave Rectified Sine",
     "Full Wave Rectified Sine", "Triangular Pulse", "Trapezoid Fixed", "Trapezoid Variable",
     nullptr};
 
@@ -461,16 +464,50 @@ void PolyBLEPNode::processPolyBLEP(ContextRenderLock & r, int bufferSize, int of
     }
 
     // calculate and write the wave
-    float* destination = outputBus->channel(0)->mutableData() + offset;
+    float* destination = outputBus->channel(0)->mutableData();
 
     /// @fixme these values should be per sample, not per quantum
     /// -or- they should be settings if they don't vary per sample
+    const PolyBLEPType type = static_cast<PolyBLEPType>(m_type->valueUint32());
     polyblep->setFrequency(m_frequency->value());
-    polyblep->setWaveform(static_cast<PolyBLEPType>(m_type->valueUint32()));
+    polyblep->setWaveform(type);
 
-    for (int i = offset; i < offset + nonSilentFramesToProcess; ++i)
+    const double dt = polyblep->getFreqInCyclesPerSample();
+    if (PolyBLEP::hasKernel(type) && dt > 0 && dt <= 0.5)
     {
-        destination[i] = (amplitudes[i] * static_cast<float>(polyblep->getPhaseAndIncrement()));
+        if (bufferSize > m_phaseValues.size()) m_phaseValues.allocate(bufferSize);
+
+        // accumulate the phases, then evaluate the waveform over them branch free
+        float * phases = m_phaseValues.data();
+        double t = polyblep->getPhase();
+        for (int i = offset; i < offset + nonSilentFramesToProcess; ++i)
+        {
+            phases[i] = static_cast<float>(t);
+            t += dt;
+            if (t >= 1.0) t -= 1.0;
+        }
+        polyblep->syncToPhase(t);
+
+        const float dtf = static_cast<float>(dt);
+        const float rdt = 1.f / dtf;
+        PolyBLEP::dispatch(type, [&](auto kernel) {
+            const int end = offset + nonSilentFramesToProcess;
+            int i = offset;
+            for (; i + 4 <= end; i += 4)
+            {
+                const Lanes4 sample = kernel.sample(Lanes4::load(phases + i), Lanes4(dtf), Lanes4(rdt), Lanes4(0.5f));
+                (Lanes4::load(amplitudes + i) * sample).store(destination + i);
+            }
+            for (; i < end; ++i)
+                destination[i] = amplitudes[i] * kernel.sample(phases[i], dtf, rdt, 0.5f);
+        });
+    }
+    else
+    {
+        for (int i = offset; i < offset + nonSilentFramesToProcess; ++i)
+        {
+            destination[i] = (amplitudes[i] * static_cast<float>(polyblep->getPhaseAndIncrement()));
+        }
     }
 
     outputBus->clearSilentFlag();
@@ -481,6 +518,11 @@ void PolyBLEPNode::process(ContextRenderLock & r, int bufferSize)
     return processPolyBLEP(r, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
 }
 
+void PolyBLEPNode::processRange(ContextRenderLock & r, int bufferSize, int offset, int count)
+{
+    processPolyBLEP(r, bufferSize, offset, count);
+}
+
 bool PolyBLEPNode::propagatesSilence(ContextRenderLock & r) const
 {
     return !isPlayingOrScheduled() || hasFinished();
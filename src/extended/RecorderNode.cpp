@@ -7,12 +7,16 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/extended/RecorderNode.h"
 #include "internal/Assertions.h"
+#include "internal/CaptureWriter.h"
+#include "internal/RecordingFile.h"
 #include "LabSound/extended/Registry.h"
 
 #include "libnyquist/Encoders.h"
 
-using namespace lab;
+#include <algorithm>
+#include <cstring>
 
+using namespace lab;
 
 AudioNodeDescriptor * RecorderNode::desc()
 {
@@ -44,9 +48,58 @@ RecorderNode::RecorderNode(AudioContext & ac, const AudioStreamConfig & outConfi
 
 RecorderNode::~RecorderNode()
 {
+    m_session.store(0);
+    m_writer.reset();
     uninitialize();
 }
 
+CaptureWriter & RecorderNode::writer()
+{
+    if (!m_writer)
+    {
+        MemoryOwnerScope memoryScope(memoryOwner());
+        m_writer.reset(new CaptureWriter(m_sampleRate, std::max(1, _self->m_channelCount)));
+    }
+    return *m_writer;
+}
+
+void RecorderNode::startRecording()
+{
+    CaptureWriter & w = writer();
+    m_session.store(0);
+    m_session.store(w.beginToMemory(), std::memory_order_release);
+}
+
+bool RecorderNode::startRecordingToFile(const std::string & path, RecorderFileFormat format)
+{
+    CaptureWriter & w = writer();
+    const uint32_t previous = m_session.exchange(0);
+
+    std::unique_ptr<RecordingFile> file = createRecordingFile(path, std::max(1, _self->m_channelCount), m_sampleRate, format);
+    if (!file)
+    {
+        // whatever was being recorded is finished, as when any new recording starts
+        w.end(previous);
+        return false;
+    }
+
+    m_session.store(w.beginToFile(std::move(file)), std::memory_order_release);
+    return true;
+}
+
+void RecorderNode::stopRecording()
+{
+    const uint32_t session = m_session.exchange(0);
+    if (!m_writer || !session)
+        return;
+
+    m_writer->end(session);
+}
+
+uint64_t RecorderNode::droppedFrames() const
+{
+    return m_writer ? m_writer->droppedFrames() : 0;
+}
 
 void RecorderNode::process(ContextRenderLock & r, int bufferSize)
 {
@@ -83,33 +136,18 @@ void RecorderNode::process(ContextRenderLock & r, int bufferSize)
         }
     }
 
-    if (m_recording)
+    const uint32_t session = m_session.load(std::memory_order_acquire);
+    if (session)
     {
         const int numChannels = std::min(inputBusNumChannels, outputBusNumChannels);
-
-        std::vector<const float*> channels;
-        for (int i = 0; i < numChannels; ++i)
-        {
-            channels.push_back(inputBus->channel(i)->data());
-        }
-
-        if (m_data.size() < numChannels)
-        {
-            // allocate the recording buffers lazily when the number of input channels is finally known
-            for (int i = 0; i < numChannels; ++i)
-            {
-                m_data.emplace_back(std::vector<float>());
-                m_data[i].reserve(1024 * 1024);
-            }
-        }
-
-        // copy the output. @TODO this should be a memcpy
-        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        float * frames = m_writer->beginBlock(numChannels, bufferSize);
         for (int c = 0; c < numChannels; ++c)
         {
+            const float * channel = inputBus->channel(c)->data();
             for (int i = 0; i < bufferSize; ++i)
-                m_data[c].push_back(channels[c][i]);
+                frames[i * numChannels + c] = channel[i];
         }
+        m_writer->commitBlock(session, r.context()->isOfflineContext());
     }
 
     // pass through 
@@ -120,33 +158,26 @@ void RecorderNode::process(ContextRenderLock & r, int bufferSize)
 
 float RecorderNode::recordedLengthInSeconds() const
 {
-    size_t recordedChannelCount = m_data.size();
-    if (!recordedChannelCount) 
+    if (!m_writer)
         return 0;
 
-    size_t numSamples = m_data[0].size();
-    return numSamples / m_sampleRate;
+    return m_writer->recordedFrames() / m_sampleRate;
 }
 
 
 bool RecorderNode::writeRecordingToWav(const std::string & filenameWithWavExtension, bool mixToMono)
 {
-    size_t recordedChannelCount = m_data.size();
+    std::vector<std::vector<float>> clear_data;
+    if (m_writer)
+        clear_data = m_writer->takeRecording();
+
+    size_t recordedChannelCount = clear_data.size();
     if (!recordedChannelCount) return false;
-    size_t numSamples = m_data[0].size();
+    size_t numSamples = clear_data[0].size();
     if (!numSamples) return false;
 
     std::unique_ptr<nqr::AudioData> fileData(new nqr::AudioData());
 
-    std::vector<std::vector<float>> clear_data;
-    for (int i = 0; i < recordedChannelCount; ++i)
-        clear_data.emplace_back(std::vector<float>());
-
-    {
-        std::lock_guard<std::recursive_mutex> lock(m_mutex);
-        m_data.swap(clear_data);
-    }
-
     if (recordedChannelCount == 1)
     {
         // only one channel recorded
@@ -164,9 +195,9 @@ bool RecorderNode::writeRecordingToWav(const std::string & filenameWithWavExtens
         for (size_t i = 0; i < numSamples; i++)
         {
             dst[i] = 0;
-            for (size_t j = 0; j < _self->m_channelCount; ++j)
+            for (size_t j = 0; j < recordedChannelCount; ++j)
                 dst[i] += clear_data[j][i];
-            dst[i] *= 1.f / static_cast<float>(_self->m_channelCount);
+            dst[i] *= 1.f / static_cast<float>(recordedChannelCount);
         }
     }
     else
@@ -185,55 +216,59 @@ bool RecorderNode::writeRecordingToWav(const std::string & filenameWithWavExtens
     fileData->sampleRate = static_cast<int>(m_sampleRate);
     fileData->sourceFormat = nqr::PCM_FLT;
 
-    nqr::EncoderParams params = {static_cast<int>(recordedChannelCount), nqr::PCM_FLT, nqr::DITHER_NONE};
+    nqr::EncoderParams params = {fileData->channelCount, nqr::PCM_FLT, nqr::DITHER_NONE};
     bool result = nqr::EncoderError::NoError == nqr::encode_wav_to_disk(params, fileData.get(), filenameWithWavExtension);
     return result;
 }
 
 std::unique_ptr<AudioBus> RecorderNode::createBusFromRecording(bool mixToMono)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    std::vector<std::vector<float>> data;
+    if (m_writer)
+        data = m_writer->takeRecording();
 
-    int numSamples = static_cast<int>(m_data[0].size());
+    const int recordedChannelCount = static_cast<int>(data.size());
+    if (!recordedChannelCount)
+        return {};
+
+    int numSamples = static_cast<int>(data[0].size());
     if (!numSamples) return {};
 
-    const int result_channel_count = mixToMono ? 1 : _self->m_channelCount;
+    const int result_channel_count = mixToMono ? 1 : recordedChannelCount;
 
     // Create AudioBus where we'll put the PCM audio data
     std::unique_ptr<lab::AudioBus> result_audioBus(new lab::AudioBus(result_channel_count, numSamples));
     result_audioBus->setSampleRate(m_sampleRate);
 
     // Mix channels to mono if requested, and there's more than one input channel.
-    if (_self->m_channelCount > 1 && mixToMono)
+    if (recordedChannelCount > 1 && mixToMono)
     {
         float* destinationMono = result_audioBus->channel(0)->mutableData();
 
         for (int i = 0; i < numSamples; i++)
         {
             destinationMono[i] = 0;
-            for (size_t j = 0; j < _self->m_channelCount; ++j)
-                destinationMono[i] += m_data[j][i];
-            destinationMono[i] *= 1.f / static_cast<float>(_self->m_channelCount);
+            for (int j = 0; j < recordedChannelCount; ++j)
+                destinationMono[i] += data[j][i];
+            destinationMono[i] *= 1.f / static_cast<float>(recordedChannelCount);
         }
     }
     else
     {
         for (int i = 0; i < result_channel_count; ++i)
         {
-            memcpy(result_audioBus->channel(i)->mutableData(), m_data[0].data(), numSamples * sizeof(float));
+            memcpy(result_audioBus->channel(i)->mutableData(), data[i].data(), numSamples * sizeof(float));
         }
     }
 
-    for (int i = 0; i < m_data.size(); ++i)
-        m_data[i].clear();
-
     return result_audioBus;
 }
 
 
 void RecorderNode::reset(ContextRenderLock & r)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_mutex);
-    for (int i = 0; i < m_data.size(); ++i)
-        m_data[i].clear();
+    // the render thread doesn't lock, so the writer clears the recording before it next
+    // adds to it
+    if (m_writer)
+        m_writer->clearRecording();
 }
@@ -1,5 +1,9 @@
 
 #include "LabSound/extended/Registry.h"
+#include "LabSound/core/MemoryAccounting.h"
+#include "LabSound/core/StartupTiming.h"
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/extended/Logging.h"
 
 #include <cstdio>
 #include <memory>
@@ -15,10 +19,18 @@ std::once_flag instance_flag;
 NodeRegistry& NodeRegistry::Instance()
 {
     static NodeRegistry s_registry;
-    std::call_once(instance_flag, []() { LabSoundRegistryInit(s_registry); });
+    std::call_once(instance_flag, []() {
+        StartupPhaseScope phase("node registry");
+        LabSoundRegistryInit(s_registry);
+    });
     return s_registry;
 }
 
+void NodeRegistry::Prewarm()
+{
+    JobSystem::shared().submit([]() { Instance(); }, JobPriority::Background);
+}
+
 struct NodeDescriptor
 {
     std::string name;
@@ -45,7 +57,7 @@ NodeRegistry::~NodeRegistry()
 
 bool NodeRegistry::Register(char const* const name, AudioNodeDescriptor* desc, CreateNodeFn c, DeleteNodeFn d)
 {
-    printf("Registering %s\n", name);
+    LOG_TRACE("Registering %s", name);
     _detail->descriptors[name] = { name, desc, c, d };
     return true;
 }
@@ -65,6 +77,8 @@ lab::AudioNode* NodeRegistry::Create(const std::string& n, lab::AudioContext& ac
     if (i == _detail->descriptors.end())
         return nullptr;
 
+    // the node adopts the owner, and is charged for what it allocates as it is constructed
+    MemoryOwnerScope memoryScope(MemoryAccounting::createOwner(MemoryCategory::Node, n));
     return i->second.c(ac);
 }
 
@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/RenderAheadNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include "internal/DenormalDisabler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+// The stream's context and its ring of rendered quanta. Blocks go round from the free ring,
+// through the stream's thread, which renders into them, to the filled ring, and back once
+// the render thread has played them out.
+struct RenderAheadNode::Stream
+{
+    std::shared_ptr<AudioContext> context;
+    std::shared_ptr<AudioDevice_Null> device;
+    std::shared_ptr<AudioDestinationNode> destination;
+    std::shared_ptr<AudioNode> root;
+    int quantum = 0;
+    float sampleRate = 0;
+
+    std::vector<std::unique_ptr<AudioBus>> blocks;
+    RingBufferT<int> filled;  // written by the stream's thread, read by the render thread
+    RingBufferT<int> free;    // written by the render thread, read by the stream's thread
+
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerWake;
+    std::atomic<bool> quit {false};
+    ThreadScheduling scheduling;
+
+    // render thread
+    int current = -1;
+    int offset = 0;
+    std::atomic<uint64_t> underruns {0};
+
+    ~Stream()
+    {
+        if (worker.joinable())
+        {
+            quit.store(true, std::memory_order_release);
+            wakeWorker();
+            worker.join();
+        }
+
+        // the device, context, and destination are circularly referenced
+        if (device)
+            device->setDestinationNode(nullptr);
+        if (context)
+            context->setDestinationNode(nullptr);
+    }
+
+    void wakeWorker()
+    {
+        if (workerMutex.try_lock())
+        {
+            workerWake.notify_one();
+            workerMutex.unlock();
+        }
+    }
+
+    void workerEntry()
+    {
+        DenormalDisabler denormalDisabler;
+        ScopedThreadScheduling scheduled(scheduling);
+
+        // waits for a block to come free no longer than a quantum, so a wake that is missed
+        // costs less than the ring holds
+        const auto period = std::chrono::microseconds(static_cast<int64_t>(1.e6 * quantum / sampleRate));
+        while (!quit.load(std::memory_order_acquire))
+        {
+            int index;
+            if (!free.read(&index, 1))
+            {
+                std::unique_lock<std::mutex> lock(workerMutex);
+                workerWake.wait_for(lock, period);
+                continue;
+            }
+
+            AudioBus & block = *blocks[index];
+            destination->offlineRender(&block, quantum);
+            filled.write(&index, 1);
+        }
+    }
+};
+
+AudioNodeDescriptor * RenderAheadNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 2};
+    return &d;
+}
+
+RenderAheadNode::RenderAheadNode(AudioContext & ac, Builder build, int channels, double aheadSeconds,
+                                 const ThreadScheduling & scheduling)
+    : AudioNode(ac, {nullptr, nullptr, std::max(1, channels)})
+    , _stream(new Stream())
+{
+    if (!build)
+        throw std::invalid_argument("A RenderAheadNode needs a graph to build");
+
+    Stream & stream = *_stream;
+    stream.quantum = renderQuantumSize();
+    stream.sampleRate = ac.sampleRate();
+    stream.scheduling = scheduling;
+    channels = std::max(1, channels);
+
+    AudioStreamConfig inputConfig;
+    AudioStreamConfig outputConfig;
+    outputConfig.device_index = 0;
+    outputConfig.desired_channels = channels;
+    outputConfig.desired_samplerate = stream.sampleRate;
+
+    // the stream renders a quantum into each block, so its quantum is the node's
+    stream.context = std::make_shared<AudioContext>(true, true);
+    stream.context->setRenderQuantumSize(stream.quantum);
+    stream.device = std::make_shared<AudioDevice_Null>(inputConfig, outputConfig);
+    stream.destination = std::make_shared<AudioDestinationNode>(*stream.context, stream.device);
+    stream.device->setDestinationNode(stream.destination);
+    stream.context->setDestinationNode(stream.destination);
+
+    stream.root = build(*stream.context);
+    if (!stream.root)
+        throw std::invalid_argument("A RenderAheadNode's builder returned no node");
+    stream.context->connect(stream.destination, stream.root);
+
+    // one block more than the ring holds ahead, for the block being played out
+    const int count = std::max(2, static_cast<int>(std::ceil(aheadSeconds * stream.sampleRate / stream.quantum)) + 1);
+    stream.blocks.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        stream.blocks.emplace_back(new AudioBus(channels, stream.quantum));
+        stream.blocks.back()->setSampleRate(stream.sampleRate);
+    }
+    stream.filled.resize(count);
+    stream.free.resize(count);
+    for (int i = 0; i < count; ++i)
+        stream.free.write(&i, 1);
+
+    initialize();
+    stream.context->startOfflineRendering();
+    stream.worker = std::thread(&Stream::workerEntry, &stream);
+}
+
+RenderAheadNode::~RenderAheadNode()
+{
+    _stream.reset();
+    uninitialize();
+}
+
+std::shared_ptr<AudioContext> RenderAheadNode::streamContext() const
+{
+    return _stream->context;
+}
+
+std::shared_ptr<AudioNode> RenderAheadNode::root() const
+{
+    return _stream->root;
+}
+
+double RenderAheadNode::ahead() const
+{
+    return (_stream->blocks.size() - 1) * _stream->quantum / static_cast<double>(_stream->sampleRate);
+}
+
+double RenderAheadNode::buffered() const
+{
+    return _stream->filled.getAvailableRead() * _stream->quantum / static_cast<double>(_stream->sampleRate);
+}
+
+uint64_t RenderAheadNode::underrunFrames() const
+{
+    return _stream->underruns.load(std::memory_order_relaxed);
+}
+
+void RenderAheadNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+    if (!isInitialized())
+    {
+        outputBus->zero();
+        return;
+    }
+
+    // Blocks are the stream's quanta, which are the node's; a shorter bufferSize plays part of
+    // a block, and the next call carries on from there
+    Stream & stream = *_stream;
+    const int outputChannels = outputBus->numberOfChannels();
+    int written = 0;
+    while (written < bufferSize)
+    {
+        if (stream.current < 0 && !stream.filled.read(&stream.current, 1))
+        {
+            stream.current = -1;
+            break;
+        }
+
+        const AudioBus & block = *stream.blocks[stream.current];
+        const int count = std::min(bufferSize - written, stream.quantum - stream.offset);
+        for (int c = 0; c < outputChannels; ++c)
+        {
+            float * destination = outputBus->channel(c)->mutableData() + written;
+            if (c < block.numberOfChannels())
+                memcpy(destination, block.channel(c)->data() + stream.offset, sizeof(float) * count);
+            else
+                memset(destination, 0, sizeof(float) * count);
+        }
+
+        written += count;
+        stream.offset += count;
+        if (stream.offset == stream.quantum)
+        {
+            stream.free.write(&stream.current, 1);
+            stream.current = -1;
+            stream.offset = 0;
+        }
+    }
+
+    if (written < bufferSize)
+    {
+        stream.underruns.fetch_add(bufferSize - written, std::memory_order_relaxed);
+        for (int c = 0; c < outputChannels; ++c)
+            memset(outputBus->channel(c)->mutableData() + written, 0, sizeof(float) * (bufferSize - written));
+    }
+
+    // the stream's thread tops the ring back up
+    stream.wakeWorker();
+}
+
+}  // namespace lab
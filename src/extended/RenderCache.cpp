@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/RenderCache.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/extended/GraphSerialization.h"
+#include "LabSound/extended/Logging.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+
+namespace lab
+{
+
+namespace
+{
+    // A render on disk is laid out as
+    //
+    //     RenderHeader
+    //     the key's text, of keyLength bytes
+    //     each channel's samples in turn, as 32 bit floats
+    //
+    // in the byte order of the machine that wrote it. The key is checked on reading, so that
+    // a file renamed or damaged is not taken for another render.
+    const char RenderMagic[4] = {'L', 'S', 'R', 'C'};
+    const uint32_t RenderVersion = 1;
+
+    struct RenderHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t channels;
+        uint32_t length;
+        float sampleRate;
+        uint32_t keyLength;
+    };
+
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t fmix(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    const uint64_t C1 = 0x87c37b91114253d5ull;
+    const uint64_t C2 = 0x4cf5ad432745937full;
+}
+
+// The two lanes of MurmurHash3's 128 bit variant, fed a word at a time; each add's last
+// partial word is padded with zeros, so that the key depends on how the pieces were added
+// as well as on their bytes.
+RenderKey::RenderKey()
+    : m_high(0x9e3779b97f4a7c15ull)
+    , m_low(0x6a09e667f3bcc908ull)
+{
+}
+
+RenderKey & RenderKey::add(const void * data, size_t size)
+{
+    const unsigned char * bytes = static_cast<const unsigned char *>(data);
+    m_length += size;
+    while (size)
+    {
+        uint64_t word = 0;
+        const size_t n = std::min(size, sizeof(word));
+        memcpy(&word, bytes, n);
+        bytes += n;
+        size -= n;
+
+        m_high ^= rotl(word * C1, 31) * C2;
+        m_high = rotl(m_high, 27) + m_low;
+        m_high = m_high * 5 + 0x52dce729;
+        m_low ^= rotl(word * C2, 33) * C1;
+        m_low = rotl(m_low, 31) + m_high;
+        m_low = m_low * 5 + 0x38495ab5;
+    }
+    return *this;
+}
+
+RenderKey & RenderKey::add(const std::string & text)
+{
+    add(static_cast<uint64_t>(text.size()));
+    return add(text.data(), text.size());
+}
+
+RenderKey & RenderKey::add(uint64_t value)
+{
+    return add(&value, sizeof(value));
+}
+
+RenderKey & RenderKey::add(double value)
+{
+    return add(&value, sizeof(value));
+}
+
+RenderKey & RenderKey::addGraph(AudioContext & ac, const std::vector<std::shared_ptr<AudioNode>> & nodes)
+{
+    const std::vector<uint8_t> graph = SaveGraph(ac, nodes);
+    add(static_cast<uint64_t>(graph.size()));
+    return add(graph.data(), graph.size());
+}
+
+RenderKey & RenderKey::addBus(const AudioBus & bus)
+{
+    add(static_cast<uint64_t>(bus.numberOfChannels()));
+    add(static_cast<uint64_t>(bus.length()));
+    add(static_cast<double>(bus.sampleRate()));
+    for (int c = 0; c < bus.numberOfChannels(); ++c)
+        add(bus.channel(c)->data(), sizeof(float) * bus.length());
+    return *this;
+}
+
+bool RenderKey::addFile(const std::string & path)
+{
+    FILE * file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        add("unreadable " + path);
+        return false;
+    }
+
+    // read in whole words, so that only the file's last word is padded
+    std::vector<unsigned char> buffer(64 * 1024);
+    uint64_t size = 0;
+    size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+    {
+        add(buffer.data(), n);
+        size += n;
+    }
+    const bool ok = !ferror(file);
+    fclose(file);
+    add(size);
+    if (!ok)
+        add("unreadable " + path);
+    return ok;
+}
+
+std::string RenderKey::toString() const
+{
+    uint64_t high = m_high ^ m_length;
+    uint64_t low = m_low ^ m_length;
+    high += low;
+    low += high;
+    high = fmix(high);
+    low = fmix(low);
+    high += low;
+    low += high;
+
+    char text[40];
+    snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long) high, (unsigned long long) low);
+    return text;
+}
+
+RenderCache::RenderCache(const std::string & directory)
+    : m_directory(directory)
+{
+}
+
+std::string RenderCache::path(const RenderKey & key) const
+{
+    return m_directory + "/" + key.toString() + ".lsrender";
+}
+
+std::shared_ptr<AudioBus> RenderCache::find(const RenderKey & key)
+{
+    const std::string text = key.toString();
+    FILE * file = fopen(path(key).c_str(), "rb");
+    if (!file)
+    {
+        ++m_misses;
+        return nullptr;
+    }
+
+    std::shared_ptr<AudioBus> bus;
+    RenderHeader header;
+    std::string storedKey;
+    if (fread(&header, sizeof(header), 1, file) == 1 && !memcmp(header.magic, RenderMagic, sizeof(RenderMagic)) &&
+        header.version == RenderVersion && header.keyLength == text.size() && header.channels > 0 && header.length > 0)
+    {
+        storedKey.resize(header.keyLength);
+        if (fread(&storedKey[0], 1, storedKey.size(), file) == storedKey.size() && storedKey == text)
+        {
+            bus = std::make_shared<AudioBus>(static_cast<int>(header.channels), static_cast<int>(header.length));
+            for (int c = 0; bus && c < static_cast<int>(header.channels); ++c)
+                if (fread(bus->channel(c)->mutableData(), sizeof(float), header.length, file) != header.length)
+                    bus.reset();
+            if (bus)
+            {
+                bus->setSampleRate(header.sampleRate);
+                bus->clearSilentFlag();
+            }
+        }
+    }
+    fclose(file);
+
+    if (bus)
+        ++m_hits;
+    else
+        ++m_misses;
+    return bus;
+}
+
+bool RenderCache::store(const RenderKey & key, const AudioBus & render)
+{
+    const std::string text = key.toString();
+    const std::string final = path(key);
+    const std::string partial = final + ".partial";
+    FILE * file = fopen(partial.c_str(), "wb");
+    if (!file)
+    {
+        LOG_WARN("RenderCache: could not write %s", partial.c_str());
+        ++m_failedStores;
+        return false;
+    }
+
+    RenderHeader header;
+    memcpy(header.magic, RenderMagic, sizeof(RenderMagic));
+    header.version = RenderVersion;
+    header.channels = static_cast<uint32_t>(render.numberOfChannels());
+    header.length = static_cast<uint32_t>(render.length());
+    header.sampleRate = render.sampleRate();
+    header.keyLength = static_cast<uint32_t>(text.size());
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(text.data(), 1, text.size(), file) == text.size();
+    for (int c = 0; ok && c < render.numberOfChannels(); ++c)
+        ok = fwrite(render.channel(c)->data(), sizeof(float), header.length, file) == header.length;
+    ok = fclose(file) == 0 && ok;
+
+    remove(final.c_str());
+    if (!ok || rename(partial.c_str(), final.c_str()) != 0)
+    {
+        LOG_WARN("RenderCache: could not write %s", final.c_str());
+        remove(partial.c_str());
+        ++m_failedStores;
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<AudioBus> RenderCache::render(const RenderKey & key, std::shared_ptr<AudioContext> context, uint64_t frames, int chunkFrames)
+{
+    std::shared_ptr<AudioDestinationNode> destination = context ? context->destinationNode() : nullptr;
+    if (!destination || !context->isOfflineContext())
+    {
+        LOG_ERROR("RenderCache: the render needs an offline context with a destination node");
+        return nullptr;
+    }
+    if (frames == 0 || frames > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+    {
+        LOG_ERROR("RenderCache: can't hold a render of %llu frames", (unsigned long long) frames);
+        return nullptr;
+    }
+
+    const float sampleRate = context->sampleRate();
+    RenderKey full = key;
+    full.add(frames).add(static_cast<double>(sampleRate));
+    if (std::shared_ptr<AudioBus> stored = find(full))
+        return stored;
+
+    std::shared_ptr<AudioBus> result;
+    auto sink = [&result, frames, sampleRate](const AudioBus & chunk, int count, uint64_t firstFrame) -> bool
+    {
+        if (!result)
+        {
+            result = std::make_shared<AudioBus>(chunk.numberOfChannels(), static_cast<int>(frames));
+            result->setSampleRate(sampleRate);
+        }
+        const int kept = static_cast<int>(std::min<uint64_t>(count, frames - firstFrame));
+        for (int c = 0; c < std::min(chunk.numberOfChannels(), result->numberOfChannels()); ++c)
+            memcpy(result->channel(c)->mutableData() + firstFrame, chunk.channel(c)->data(), sizeof(float) * kept);
+        return true;
+    };
+
+    context->startOfflineRendering();
+    const uint64_t rendered = destination->offlineRender(frames, chunkFrames, sink);
+    if (!result || rendered < frames)
+    {
+        LOG_ERROR("RenderCache: the render stopped after %llu of %llu frames", (unsigned long long) rendered, (unsigned long long) frames);
+        return nullptr;
+    }
+
+    result->clearSilentFlag();
+    store(full, *result);
+    return result;
+}
+
+RenderCache::Stats RenderCache::stats() const
+{
+    Stats stats;
+    stats.hits = m_hits.load();
+    stats.misses = m_misses.load();
+    stats.failedStores = m_failedStores.load();
+    return stats;
+}
+
+}  // lab
@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/RenderServer.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice_External.h"
+
+#include "internal/DenormalDisabler.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+namespace
+{
+    void accumulate(RenderAccount & account, const RenderAccount & delta)
+    {
+        account.streams += delta.streams;
+        account.blocks += delta.blocks;
+        account.frames += delta.frames;
+        account.cpuSeconds += delta.cpuSeconds;
+        account.missedDeadlines += delta.missedDeadlines;
+        account.memoryBytes += delta.memoryBytes;
+    }
+}
+
+RenderServer::RenderServer()
+    : RenderServer(Settings())
+{
+}
+
+RenderServer::RenderServer(const Settings & settings)
+{
+    int workerCount = settings.workerCount;
+    if (workerCount <= 0)
+        workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    for (int i = 0; i < workerCount; ++i)
+        _workers.emplace_back(&RenderServer::workerLoop, this, settings.scheduling);
+}
+
+RenderServer::~RenderServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shouldExit = true;
+    }
+    _wake.notify_all();
+    for (auto & worker : _workers)
+        worker.join();
+
+    for (auto & entry : _streams)
+        entry.second->settings.device->stop();
+}
+
+RenderServer::StreamId RenderServer::add(const RenderStream & settings)
+{
+    if (!settings.context || !settings.device || !settings.sink)
+        return 0;
+
+    std::unique_ptr<Stream> stream(new Stream);
+    stream->settings = settings;
+
+    const int blockFrames = settings.blockFrames > 0 ? settings.blockFrames : settings.context->renderQuantumSize();
+    const int channels = static_cast<int>(settings.device->getOutputConfig().desired_channels);
+    const float sampleRate = settings.device->getOutputConfig().desired_samplerate;
+    stream->settings.blockFrames = blockFrames;
+    stream->bus.reset(new AudioBus(channels, blockFrames));
+    stream->bus->setSampleRate(sampleRate);
+    for (int i = 0; i < channels; ++i)
+        stream->channels.push_back(stream->bus->channel(i)->mutableData());
+    if (sampleRate > 0)
+        stream->period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(blockFrames / double(sampleRate)));
+    stream->release = Clock::now();
+
+    RenderAccount opened;
+    opened.streams = 1;
+    opened.memoryBytes = static_cast<int64_t>(sizeof(float)) * channels * blockFrames;
+    stream->account = opened;
+
+    settings.device->start();
+
+    StreamId id;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        id = _nextId++;
+
+        // a new offline stream starts level with the others rather than owed their history
+        stream->virtualTime = _offlineClock;
+        charge(settings.tenant, opened);
+        _streams[id] = std::move(stream);
+    }
+    _wake.notify_all();
+    return id;
+}
+
+void RenderServer::remove(StreamId id)
+{
+    std::unique_ptr<Stream> stream;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _streams.find(id);
+        if (it == _streams.end())
+            return;
+        _wake.wait(lock, [&it]() { return !it->second->busy; });
+
+        stream = std::move(it->second);
+        _streams.erase(it);
+
+        RenderAccount closed;
+        closed.streams = -1;
+        closed.memoryBytes = -static_cast<int64_t>(sizeof(float)) * stream->bus->numberOfChannels() * stream->bus->length();
+        charge(stream->settings.tenant, closed);
+    }
+
+    // the context is released outside the lock, as tearing it down takes a while
+    stream->settings.device->stop();
+}
+
+bool RenderServer::isActive(StreamId id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _streams.find(id);
+    return it != _streams.end() && !it->second->ended;
+}
+
+RenderAccount RenderServer::streamAccount(StreamId id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _streams.find(id);
+    return it != _streams.end() ? it->second->account : RenderAccount();
+}
+
+RenderAccount RenderServer::tenantAccount(uint64_t tenant) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _tenants.find(tenant);
+    return it != _tenants.end() ? it->second : RenderAccount();
+}
+
+void RenderServer::attributeMemory(uint64_t tenant, int64_t bytes)
+{
+    RenderAccount delta;
+    delta.memoryBytes = bytes;
+    std::lock_guard<std::mutex> lock(_mutex);
+    charge(tenant, delta);
+}
+
+void RenderServer::charge(uint64_t tenant, const RenderAccount & delta)
+{
+    accumulate(_tenants[tenant], delta);
+}
+
+RenderServer::Stream * RenderServer::pick(Clock::time_point now, Clock::time_point & wakeAt)
+{
+    // realtime blocks that have been released, earliest deadline first
+    Stream * best = nullptr;
+    for (auto & entry : _streams)
+    {
+        Stream * s = entry.second.get();
+        if (s->busy || s->ended || s->settings.pacing != StreamPacing::Realtime)
+            continue;
+        if (s->release > now)
+        {
+            wakeAt = std::min(wakeAt, s->release);
+            continue;
+        }
+        if (!best || s->release + s->period < best->release + best->period)
+            best = s;
+    }
+    if (best)
+        return best;
+
+    // then the offline stream that has had the least of its share
+    for (auto & entry : _streams)
+    {
+        Stream * s = entry.second.get();
+        if (s->busy || s->ended || s->settings.pacing != StreamPacing::Offline)
+            continue;
+        if (!best || s->virtualTime < best->virtualTime)
+            best = s;
+    }
+    return best;
+}
+
+void RenderServer::workerLoop(const ThreadScheduling & scheduling)
+{
+    DenormalDisabler denormalDisabler;
+    ScopedThreadScheduling scoped(scheduling);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_shouldExit)
+    {
+        Clock::time_point wakeAt = Clock::time_point::max();
+        Stream * s = pick(Clock::now(), wakeAt);
+        if (!s)
+        {
+            if (wakeAt == Clock::time_point::max())
+                _wake.wait(lock);
+            else
+                _wake.wait_until(lock, wakeAt);
+            continue;
+        }
+
+        s->busy = true;
+        if (s->settings.pacing == StreamPacing::Offline)
+            _offlineClock = s->virtualTime;
+        int frames = s->settings.blockFrames;
+        if (s->settings.frames)
+            frames = static_cast<int>(std::min<uint64_t>(frames, s->settings.frames - s->rendered));
+        const uint64_t firstFrame = s->rendered;
+        lock.unlock();
+
+        // the stream is not removed while busy, so it is safe to use unlocked
+        const Clock::time_point start = Clock::now();
+        s->settings.device->render(frames, nullptr, s->channels.data());
+        const bool more = s->settings.sink(*s->bus, frames, firstFrame);
+        if (s->settings.context->isAutodispatchingEvents())
+            s->settings.context->dispatchEvents();
+        const Clock::time_point end = Clock::now();
+
+        lock.lock();
+        RenderAccount delta;
+        delta.blocks = 1;
+        delta.frames = frames;
+        delta.cpuSeconds = std::chrono::duration<double>(end - start).count();
+
+        if (s->settings.pacing == StreamPacing::Realtime)
+        {
+            if (end > s->release + s->period)
+                delta.missedDeadlines = 1;
+            s->release += s->period;
+        }
+        else
+            s->virtualTime += delta.cpuSeconds / std::max(1.e-3f, s->settings.weight);
+
+        s->rendered += frames;
+        accumulate(s->account, delta);
+        charge(s->settings.tenant, delta);
+
+        if (!more || (s->settings.frames && s->rendered >= s->settings.frames))
+        {
+            s->ended = true;
+            s->settings.device->stop();
+        }
+        s->busy = false;
+        _wake.notify_all();
+    }
+}
+
+}  // lab
@@ -179,11 +179,17 @@
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/AudioSetting.h"
 
+#include "internal/DenormalDisabler.h"
+#include "internal/FastMath.h"
+#include "internal/Lanes4.h"
+
+#include <algorithm>
+#include <atomic>
 #include <math.h>
 #include <memory.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 using namespace std;
 using namespace lab;
@@ -221,9 +227,15 @@ inline float flurp(float a)
     return a / (1.0f - a);
 }
 
+// Each voice draws its noise from its own generator, rather than from rand, so that a
+// sound can be baked off the audio thread
+static std::atomic<uint32_t> s_noiseSeeds {0x9e3779b9u};
+
 class SfxrNode::Sfxr
 {
 public:
+    Sfxr() : noise_seed(s_noiseSeeds.fetch_add(0x9e3779b9u) | 1u) {}
+
     int wave_type;
 
     float p_base_freq;
@@ -297,17 +309,39 @@ public:
     int arp_limit;
     double arp_mod;
 
-    int wav_bits;
-    int wav_freq;
-
-    int file_sampleswritten;
-    float filesample;
-    int fileacc;
+    uint32_t noise_seed;
 
     void ResetParams();
     void ResetSample(bool restart);
     void PlaySample();
-    void SynthSample(size_t length, float * buffer, FILE * file);
+
+    // Renders up to length frames, and returns the number rendered before the sound ended
+    int SynthSample(int length, float * buffer);
+
+    // Renders LaneCount voices at once, one to a SIMD lane, each into its buffer of up to
+    // lengths[lane] frames, and sets rendered[lane] to the number rendered before its sound
+    // ended. The voices must share the first one's waveform, and its low pass filtering
+    // or the lack of it.
+    static const int LaneCount = 4;
+    static void SynthLanes(Sfxr * const * voices, float * const * buffers, const int * lengths, int * rendered);
+
+private:
+    void StepControl();
+
+    template <int Wave, bool LowPass>
+    int Synth(int length, float * buffer);
+
+    template <int Wave, bool LowPass>
+    static void Lanes(Sfxr * const * voices, float * const * buffers, const int * lengths, int * rendered);
+
+    // xorshift, in [-1, 1)
+    float noise()
+    {
+        noise_seed ^= noise_seed << 13;
+        noise_seed ^= noise_seed >> 17;
+        noise_seed ^= noise_seed << 5;
+        return static_cast<float>(noise_seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
 };
 
 void SfxrNode::Sfxr::ResetParams()
@@ -345,8 +379,6 @@ void SfxrNode::Sfxr::ResetParams()
     p_arp_speed = 0.0f;
     p_arp_mod = 0.0f;
 
-    wav_bits = 16;
-    wav_freq = 44100;
     sound_vol = 0.5f;
     master_vol = 0.05f;
 }
@@ -404,7 +436,7 @@ void SfxrNode::Sfxr::ResetSample(bool restart)
             phaser_buffer[i] = 0.0f;
 
         for (int i = 0; i < 32; i++)
-            noise_buffer[i] = frnd(2.0f) - 1.0f;
+            noise_buffer[i] = noise();
 
         rep_time = 0;
         rep_limit = (int) (pow(1.0f - p_repeat_speed, 2.0f) * 20000 + 32);
@@ -419,171 +451,378 @@ void SfxrNode::Sfxr::PlaySample()
     playing_sample = true;
 }
 
-void SfxrNode::Sfxr::SynthSample(size_t length, float * buffer, FILE * file)
+// Advances the sound's pitch, duty, envelope, phaser and high pass filter by a sample
+inline void SfxrNode::Sfxr::StepControl()
 {
-    for (int i = 0; i < length; i++)
+    rep_time++;
+    if (rep_limit != 0 && rep_time >= rep_limit)
     {
-        if (!playing_sample)
-            break;
+        rep_time = 0;
+        ResetSample(true);
+    }
 
-        rep_time++;
-        if (rep_limit != 0 && rep_time >= rep_limit)
-        {
-            rep_time = 0;
-            ResetSample(true);
-        }
+    // frequency envelopes/arpeggios
+    arp_time++;
+    if (arp_limit != 0 && arp_time >= arp_limit)
+    {
+        arp_limit = 0;
+        fperiod *= arp_mod;
+    }
+    fslide += fdslide;
+    fperiod *= fslide;
+    if (fperiod > fmaxperiod)
+    {
+        fperiod = fmaxperiod;
+        if (p_freq_limit > 0.0f)
+            playing_sample = false;
+    }
+    float rfperiod = static_cast<float>(fperiod);
+    if (vib_amp > 0.0f)
+    {
+        vib_phase += vib_speed;
+        rfperiod = static_cast<float>(fperiod * (1.0 + sin(vib_phase) * vib_amp));
+    }
+    period = (int) rfperiod;
+    if (period < 8) period = 8;
+    square_duty += square_slide;
+    if (square_duty < 0.0f) square_duty = 0.0f;
+    if (square_duty > 0.5f) square_duty = 0.5f;
+    // volume envelope
+    env_time++;
+    if (env_time > env_length[env_stage])
+    {
+        env_time = 0;
+        env_stage++;
+        if (env_stage == 3)
+            playing_sample = false;
+    }
+    if (env_stage == 0)
+        env_vol = (float) env_time / env_length[0];
+    if (env_stage == 1)
+        env_vol = 1.0f + (1.0f - (float) env_time / env_length[1]) * 2.0f * p_env_punch;
+    if (env_stage == 2)
+        env_vol = 1.0f - (float) env_time / env_length[2];
+
+    // phaser step
+    fphase += fdphase;
+    iphase = abs((int) fphase);
+    if (iphase > 1023) iphase = 1023;
+
+    if (flthp_d != 0.0f)
+    {
+        flthp *= flthp_d;
+        if (flthp < 0.00001f) flthp = 0.00001f;
+        if (flthp > 0.1f) flthp = 0.1f;
+    }
+}
 
-        // frequency envelopes/arpeggios
-        arp_time++;
-        if (arp_limit != 0 && arp_time >= arp_limit)
-        {
-            arp_limit = 0;
-            fperiod *= arp_mod;
-        }
-        fslide += fdslide;
-        fperiod *= fslide;
-        if (fperiod > fmaxperiod)
-        {
-            fperiod = fmaxperiod;
-            if (p_freq_limit > 0.0f)
-                playing_sample = false;
-        }
-        float rfperiod = static_cast<float>(fperiod);
-        if (vib_amp > 0.0f)
-        {
-            vib_phase += vib_speed;
-            rfperiod = static_cast<float>(fperiod * (1.0 + sin(vib_phase) * vib_amp));
-        }
-        period = (int) rfperiod;
-        if (period < 8) period = 8;
-        square_duty += square_slide;
-        if (square_duty < 0.0f) square_duty = 0.0f;
-        if (square_duty > 0.5f) square_duty = 0.5f;
-        // volume envelope
-        env_time++;
-        if (env_time > env_length[env_stage])
-        {
-            env_time = 0;
-            env_stage++;
-            if (env_stage == 3)
-                playing_sample = false;
-        }
-        if (env_stage == 0)
-            env_vol = (float) env_time / env_length[0];
-        if (env_stage == 1)
-            env_vol = 1.0f + pow(1.0f - (float) env_time / env_length[1], 1.0f) * 2.0f * p_env_punch;
-        if (env_stage == 2)
-            env_vol = 1.0f - (float) env_time / env_length[2];
-
-        // phaser step
-        fphase += fdphase;
-        iphase = abs((int) fphase);
-        if (iphase > 1023) iphase = 1023;
+int SfxrNode::Sfxr::SynthSample(int length, float * buffer)
+{
+    // The waveform and whether the low pass filter is on hold for a whole sound, so each
+    // combination has a loop of its own, rather than branching on them per sample
+    const bool lowPass = p_lpf_freq != 1.0f;
+    switch (wave_type)
+    {
+        case SQUARE: return lowPass ? Synth<SQUARE, true>(length, buffer) : Synth<SQUARE, false>(length, buffer);
+        case SAWTOOTH: return lowPass ? Synth<SAWTOOTH, true>(length, buffer) : Synth<SAWTOOTH, false>(length, buffer);
+        case SINE: return lowPass ? Synth<SINE, true>(length, buffer) : Synth<SINE, false>(length, buffer);
+        case NOISE: return lowPass ? Synth<NOISE, true>(length, buffer) : Synth<NOISE, false>(length, buffer);
+    }
+    return 0;
+}
 
-        if (flthp_d != 0.0f)
-        {
-            flthp *= flthp_d;
-            if (flthp < 0.00001f) flthp = 0.00001f;
-            if (flthp > 0.1f) flthp = 0.1f;
-        }
+template <int Wave, bool LowPass>
+int SfxrNode::Sfxr::Synth(int length, float * buffer)
+{
+    // The filter, phaser and oscillator state changes every supersample; it's kept in
+    // locals for the length of the block, where the compiler can hold it in registers,
+    // since the stores to the buffer might otherwise alias it.
+    int lphase = phase;
+    float lfltp = fltp;
+    float lfltdp = fltdp;
+    float lfltw = fltw;
+    float lfltphp = fltphp;
+    int lipp = ipp;
+    const float lfltw_d = fltw_d;
+    const float lfltdmp = fltdmp;
+
+    const float gain = master_vol * 2.0f * sound_vol / 8;
+
+    int i = 0;
+    for (; i < length && playing_sample; i++)
+    {
+        StepControl();
+        const float rperiod = 1.0f / period;
+        const float lflthp = flthp;
 
         float ssample = 0.0f;
         for (int si = 0; si < 8; si++)  // 8x supersampling
         {
-            float sample = 0.0f;
-            phase++;
-            if (phase >= period)
+            lphase++;
+            if (lphase >= period)
             {
-                //                phase=0;
-                phase %= period;
-                if (wave_type == NOISE)
-                    for (int i = 0; i < 32; i++)
-                        noise_buffer[i] = frnd(2.0f) - 1.0f;
+                lphase %= period;
+                if (Wave == NOISE)
+                    for (int n = 0; n < 32; n++)
+                        noise_buffer[n] = noise();
             }
             // base waveform
-            float fp = (float) phase / period;
-            switch (wave_type)
+            const float fp = lphase * rperiod;
+            float sample;
+            if (Wave == SQUARE)
+                sample = fp < square_duty ? 0.5f : -0.5f;
+            else if (Wave == SAWTOOTH)
+                sample = 1.0f - fp * 2;
+            else if (Wave == SINE)
             {
-                case 0:  // square
-                    if (fp < square_duty)
-                        sample = 0.5f;
-                    else
-                        sample = -0.5f;
-                    break;
-                case 1:  // sawtooth
-                    sample = 1.0f - fp * 2;
-                    break;
-                case 2:  // sine
-                    sample = (float) sin(fp * 2 * PI);
-                    break;
-                case 3:  // noise
-                    sample = noise_buffer[phase * 32 / period];
-                    break;
+                // sin(2 pi fp), from its first quadrant
+                const float t = fp * 4;
+                const float u = t < 2 ? t : t - 2;
+                const float q = FastMath::sinHalfPi(u < 1 ? u : 2 - u);
+                sample = t < 2 ? q : -q;
             }
+            else
+                sample = noise_buffer[lphase * 32 / period];
             // lp filter
-            float pp = fltp;
-            fltw *= fltw_d;
-            if (fltw < 0.0f) fltw = 0.0f;
-            if (fltw > 0.1f) fltw = 0.1f;
-            if (p_lpf_freq != 1.0f)
+            const float pp = lfltp;
+            lfltw *= lfltw_d;
+            if (lfltw < 0.0f) lfltw = 0.0f;
+            if (lfltw > 0.1f) lfltw = 0.1f;
+            if (LowPass)
             {
-                fltdp += (sample - fltp) * fltw;
-                fltdp -= fltdp * fltdmp;
+                lfltdp += (sample - lfltp) * lfltw;
+                lfltdp -= lfltdp * lfltdmp;
             }
             else
             {
-                fltp = sample;
-                fltdp = 0.0f;
+                lfltp = sample;
+                lfltdp = 0.0f;
             }
-            fltp += fltdp;
+            lfltp += lfltdp;
             // hp filter
-            fltphp += fltp - pp;
-            fltphp -= fltphp * flthp;
-            sample = fltphp;
+            lfltphp += lfltp - pp;
+            lfltphp -= lfltphp * lflthp;
+            sample = lfltphp;
             // phaser
-            phaser_buffer[ipp & 1023] = sample;
-            sample += phaser_buffer[(ipp - iphase + 1024) & 1023];
-            ipp = (ipp + 1) & 1023;
+            phaser_buffer[lipp & 1023] = sample;
+            sample += phaser_buffer[(lipp - iphase + 1024) & 1023];
+            lipp = (lipp + 1) & 1023;
             // final accumulation and envelope application
             ssample += sample * env_vol;
         }
-        ssample = ssample / 8 * master_vol;
+        ssample *= gain;
 
-        ssample *= 2.0f * sound_vol;
+        if (ssample > 1.0f) ssample = 1.0f;
+        if (ssample < -1.0f) ssample = -1.0f;
+        buffer[i] = ssample;
+    }
 
-        if (buffer != NULL)
-        {
-            if (ssample > 1.0f) ssample = 1.0f;
-            if (ssample < -1.0f) ssample = -1.0f;
-            *buffer++ = ssample;
-        }
-        if (file != NULL)
+    phase = lphase;
+    fltp = lfltp;
+    fltdp = lfltdp;
+    fltw = lfltw;
+    fltphp = lfltphp;
+    ipp = lipp;
+    return i;
+}
+
+void SfxrNode::Sfxr::SynthLanes(Sfxr * const * voices, float * const * buffers, const int * lengths, int * rendered)
+{
+    const bool lowPass = voices[0]->p_lpf_freq != 1.0f;
+    switch (voices[0]->wave_type)
+    {
+        case SQUARE: return lowPass ? Lanes<SQUARE, true>(voices, buffers, lengths, rendered) : Lanes<SQUARE, false>(voices, buffers, lengths, rendered);
+        case SAWTOOTH: return lowPass ? Lanes<SAWTOOTH, true>(voices, buffers, lengths, rendered) : Lanes<SAWTOOTH, false>(voices, buffers, lengths, rendered);
+        case SINE: return lowPass ? Lanes<SINE, true>(voices, buffers, lengths, rendered) : Lanes<SINE, false>(voices, buffers, lengths, rendered);
+        case NOISE: return lowPass ? Lanes<NOISE, true>(voices, buffers, lengths, rendered) : Lanes<NOISE, false>(voices, buffers, lengths, rendered);
+    }
+}
+
+template <int Wave, bool LowPass>
+void SfxrNode::Sfxr::Lanes(Sfxr * const * voices, float * const * buffers, const int * lengths, int * rendered)
+{
+    // Each voice's pitch and envelope advance per lane as in Synth, as they branch
+    // differently for every sound. The oscillators, waveforms, filters, phasers and
+    // envelopes that follow, eight times a sample, are computed for the four voices at
+    // once, from their state held a voice to a lane, in the same order of operations as
+    // Synth, so that each voice renders exactly as it would alone.
+    static_assert(LaneCount == 4, "a voice to each of Lanes4's lanes");
+    float laneState[LaneCount];
+    auto lanesOf = [&](float Sfxr::*member) {
+        for (int l = 0; l < LaneCount; ++l)
+            laneState[l] = voices[l]->*member;
+        return Lanes4::load(laneState);
+    };
+    Lanes4 fltp = lanesOf(&Sfxr::fltp);
+    Lanes4 fltdp = lanesOf(&Sfxr::fltdp);
+    Lanes4 fltw = lanesOf(&Sfxr::fltw);
+    Lanes4 fltphp = lanesOf(&Sfxr::fltphp);
+    const Lanes4 fltw_d = lanesOf(&Sfxr::fltw_d);
+    const Lanes4 fltdmp = lanesOf(&Sfxr::fltdmp);
+    for (int l = 0; l < LaneCount; ++l)
+        laneState[l] = voices[l]->master_vol * 2.0f * voices[l]->sound_vol / 8;
+    const Lanes4 gain = Lanes4::load(laneState);
+
+    // the phasers' buffers, interleaved a frame of every lane at a time. Every voice
+    // starts with an empty buffer at its start, so the voices share a write position.
+    std::vector<float> phaser(1024 * LaneCount, 0.f);
+    int lipp = voices[0]->ipp;
+
+    float noise[8][LaneCount];  // the supersamples of noise, per lane
+    float phase[LaneCount], period[LaneCount], rperiod[LaneCount];
+    float duty[LaneCount], env[LaneCount], hp[LaneCount], out[LaneCount];
+    int delay[LaneCount];
+    for (int l = 0; l < LaneCount; ++l)
+        rendered[l] = 0;
+
+    for (int i = 0;; i++)
+    {
+        bool playing = false;
+        for (int l = 0; l < LaneCount; ++l)
         {
-            // quantize depending on format
-            // accumulate/count to accomodate variable sample rate?
-            ssample *= 4.0f;  // arbitrary gain to get reasonable output volume...
-            if (ssample > 1.0f) ssample = 1.0f;
-            if (ssample < -1.0f) ssample = -1.0f;
-            filesample += ssample;
-            fileacc++;
-            if (wav_freq == 44100 || fileacc == 2)
+            Sfxr & v = *voices[l];
+            if (!v.playing_sample || i >= lengths[l])
             {
-                filesample /= fileacc;
-                fileacc = 0;
-                if (wav_bits == 16)
-                {
-                    short isample = (short) (filesample * 32000);
-                    fwrite(&isample, 1, 2, file);
-                }
-                else
+                // a silent lane, until the others end
+                for (int si = 0; si < 8; si++)
+                    noise[si][l] = 0.0f;
+                phase[l] = 0.0f;
+                period[l] = 8.0f;
+                rperiod[l] = 0.0f;
+                duty[l] = 0.0f;
+                env[l] = 0.0f;
+                hp[l] = v.flthp;
+                delay[l] = 0;
+                continue;
+            }
+
+            playing = true;
+            rendered[l] = i + 1;
+            v.StepControl();
+
+            // The first supersample's step wraps the phase however far the period has fallen
+            // since the last sample; as the period is at least 8, the other seven wrap it at
+            // most once more, which the lanes do for themselves, except for noise.
+            v.phase++;
+            if (v.phase >= v.period)
+            {
+                v.phase %= v.period;
+                if (Wave == NOISE)
+                    for (int n = 0; n < 32; n++)
+                        v.noise_buffer[n] = v.noise();
+            }
+            if (Wave == NOISE)
+            {
+                noise[0][l] = v.noise_buffer[v.phase * 32 / v.period];
+                for (int si = 1; si < 8; si++)
                 {
-                    unsigned char isample = (unsigned char) (filesample * 127 + 128);
-                    fwrite(&isample, 1, 1, file);
+                    v.phase++;
+                    if (v.phase >= v.period)
+                    {
+                        v.phase %= v.period;
+                        for (int n = 0; n < 32; n++)
+                            v.noise_buffer[n] = v.noise();
+                    }
+                    noise[si][l] = v.noise_buffer[v.phase * 32 / v.period];
                 }
-                filesample = 0.0f;
             }
-            file_sampleswritten++;
+            else
+            {
+                phase[l] = static_cast<float>(v.phase);
+                period[l] = static_cast<float>(v.period);
+                rperiod[l] = 1.0f / v.period;
+                v.phase += 7;
+                if (v.phase >= v.period)
+                    v.phase -= v.period;
+            }
+            duty[l] = v.square_duty;
+            env[l] = v.env_vol;
+            hp[l] = v.flthp;
+            delay[l] = v.iphase;
+        }
+        if (!playing)
+            break;
+
+        // Reads of the phasers that precede this sample's writes, as Synth's reads precede
+        // its later writes, where they wrap around to them.
+        float delayed[8][LaneCount];
+        int split[LaneCount];
+        for (int l = 0; l < LaneCount; ++l)
+        {
+            split[l] = delay[l] < 8 ? delay[l] : 8;
+            for (int si = 0; si < split[l]; si++)
+                delayed[si][l] = phaser[((lipp + si - delay[l] + 1024) & 1023) * LaneCount + l];
+        }
+
+        Lanes4 lanePhase = Lanes4::load(phase);
+        const Lanes4 lanePeriod = Lanes4::load(period);
+        const Lanes4 laneRPeriod = Lanes4::load(rperiod);
+        const Lanes4 squareDuty = Lanes4::load(duty);
+        const Lanes4 flthp = Lanes4::load(hp);
+        for (int si = 0; si < 8; si++)
+        {
+            // base waveform
+            if (si > 0)
+            {
+                lanePhase = lanePhase + Lanes4(1.0f);
+                lanePhase = lab::select(lanePhase >= lanePeriod, lanePhase - lanePeriod, lanePhase);
+            }
+            const Lanes4 fp = lanePhase * laneRPeriod;
+            Lanes4 sample = fp;
+            if (Wave == NOISE)
+                sample = Lanes4::load(noise[si]);
+            else if (Wave == SQUARE)
+                sample = lab::select(fp < squareDuty, Lanes4(0.5f), Lanes4(-0.5f));
+            else if (Wave == SAWTOOTH)
+                sample = Lanes4(1.0f) - fp * Lanes4(2.0f);
+            else if (Wave == SINE)
+            {
+                const Lanes4 t = fp * Lanes4(4.0f);
+                const Mask4 firstHalf = t < Lanes4(2.0f);
+                const Lanes4 u = lab::select(firstHalf, t, t - Lanes4(2.0f));
+                const Lanes4 q = FastMath::sinHalfPi(lab::select(u < Lanes4(1.0f), u, Lanes4(2.0f) - u));
+                sample = lab::select(firstHalf, q, Lanes4(0.0f) - q);
+            }
+            // lp filter
+            const Lanes4 pp = fltp;
+            fltw = minOf(maxOf(fltw * fltw_d, Lanes4(0.0f)), Lanes4(0.1f));
+            if (LowPass)
+            {
+                fltdp = fltdp + (sample - fltp) * fltw;
+                fltdp = fltdp - fltdp * fltdmp;
+            }
+            else
+            {
+                fltp = sample;
+                fltdp = Lanes4(0.0f);
+            }
+            fltp = fltp + fltdp;
+            // hp filter
+            fltphp = fltphp + (fltp - pp);
+            fltphp = fltphp - fltphp * flthp;
+            fltphp.store(&phaser[((lipp + si) & 1023) * LaneCount]);
+        }
+
+        // The phasers' reads of this sample's writes, and the final accumulation and envelope
+        // application. The phaser is applied after the filters, which don't depend on it, so
+        // that the filters' recurrence isn't held up by the reads.
+        for (int l = 0; l < LaneCount; ++l)
+            for (int si = split[l]; si < 8; si++)
+                delayed[si][l] = phaser[((lipp + si - delay[l]) & 1023) * LaneCount + l];
+        const Lanes4 envVol = Lanes4::load(env);
+        Lanes4 ssample(0.0f);
+        for (int si = 0; si < 8; si++)
+        {
+            const Lanes4 sample = Lanes4::load(&phaser[((lipp + si) & 1023) * LaneCount]) + Lanes4::load(delayed[si]);
+            ssample = ssample + sample * envVol;
         }
+        ssample = maxOf(minOf(ssample * gain, Lanes4(1.0f)), Lanes4(-1.0f));
+        ssample.store(out);
+        lipp = (lipp + 8) & 1023;
+
+        for (int l = 0; l < LaneCount; ++l)
+            if (rendered[l] == i + 1)
+                buffers[l][i] = out[l];
     }
 }
 
@@ -695,50 +934,28 @@ SfxrNode::SfxrNode(AudioContext & ac)
 SfxrNode::~SfxrNode()
 {
     uninitialize();
+    delete sfxr;
 }
 
-void SfxrNode::process(ContextRenderLock &r, int bufferSize)
+bool SfxrNode::updateParams(Sfxr & voice) const
 {
-    AudioBus * outputBus = output(0)->bus(r);
-
-    if (!isInitialized() || !outputBus->numberOfChannels())
-    {
-        outputBus->zero();
-        return;
-    }
-
-    int quantumFrameOffset = _self->_scheduler._renderOffset;
-    int nonSilentFramesToProcess = _self->_scheduler._renderLength;
-
-    if (!nonSilentFramesToProcess)
-    {
-        outputBus->zero();
-        return;
-    }
-
-    float * destP = outputBus->channel(0)->mutableData();
-
-    // Start rendering at the correct offset.
-    destP += quantumFrameOffset;
-    int n = nonSilentFramesToProcess;
-
 #define UPDATE(typ, cur, val)                   \
     {                                           \
         typ v = static_cast<typ>(val->value()); \
-        if (sfxr->cur != v)                     \
+        if (voice.cur != v)                     \
         {                                       \
             needUpdate = true;                  \
-            sfxr->cur = v;                      \
+            voice.cur = v;                      \
         }                                       \
     }
 
     bool needUpdate = false;
     {
         int v = _waveType->valueUint32();
-        if (sfxr->wave_type != v)
+        if (voice.wave_type != v)
         {
             needUpdate = true;
-            sfxr->wave_type = v;
+            voice.wave_type = v;
         }
     }
 
@@ -760,7 +977,7 @@ void SfxrNode::process(ContextRenderLock &r, int bufferSize)
     UPDATE(float, p_env_punch, _sustainPunch)
 
     UPDATE(float, p_lpf_resonance, _lpFilterResonance)
-    sfxr->filter_on = sfxr->p_lpf_resonance > 0;
+    voice.filter_on = voice.p_lpf_resonance > 0;
     UPDATE(float, p_lpf_freq, _lpFilterCutoff)
     UPDATE(float, p_lpf_ramp, _lpFilterCutoffSweep)
     UPDATE(float, p_hpf_freq, _hpFilterCutoff)
@@ -773,25 +990,43 @@ void SfxrNode::process(ContextRenderLock &r, int bufferSize)
     UPDATE(float, p_arp_speed, _changeSpeed)
     UPDATE(float, p_arp_mod, _changeAmount)
 
-    if (needUpdate)
-        sfxr->ResetSample(false);
-
 #undef UPDATE
 
-    memset(destP, 0, sizeof(float) * n);
-    sfxr->SynthSample(n, destP, NULL);
+    return needUpdate;
+}
+
+void SfxrNode::process(ContextRenderLock &r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
 
-    /// @TODO check - does this really need clamping? If yes, should there be a comopressor of some sort here?
-    while (n--)
+    if (!isInitialized() || !outputBus->numberOfChannels())
     {
-        float f = destP[n];
-        if (f < -1.0f)
-            f = -1.0f;
-        else if (f > 1.0f)
-            f = 1.0f;
-        destP[n] = f;
+        outputBus->zero();
+        return;
     }
 
+    int quantumFrameOffset = _self->_scheduler._renderOffset;
+    int nonSilentFramesToProcess = _self->_scheduler._renderLength;
+
+    if (!nonSilentFramesToProcess)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    float * destP = outputBus->channel(0)->mutableData();
+
+    // Start rendering at the correct offset.
+    destP += quantumFrameOffset;
+    int n = nonSilentFramesToProcess;
+
+    if (updateParams(*sfxr))
+        sfxr->ResetSample(false);
+
+    const int rendered = sfxr->SynthSample(n, destP);
+    if (rendered < n)
+        memset(destP + rendered, 0, sizeof(float) * (n - rendered));
+
     outputBus->clearSilentFlag();
 }
 
@@ -799,6 +1034,159 @@ void SfxrNode::reset(ContextRenderLock &)
 {
 }
 
+std::shared_ptr<AudioBus> SfxrNode::bake() const
+{
+    // baking may be on a thread of the caller's, whose denormals would otherwise slow the
+    // filters' tails
+    DenormalDisabler denormalDisabler;
+
+    // a voice of its own, so that the node's playback is undisturbed
+    Sfxr voice;
+    voice.ResetParams();
+    voice.sound_vol = sfxr->sound_vol;
+    updateParams(voice);
+    voice.PlaySample();
+
+    // the sound can't outlast its envelope
+    const int length = voice.env_length[0] + voice.env_length[1] + voice.env_length[2] + 3;
+    std::vector<float> frames(length);
+    const int rendered = voice.SynthSample(length, frames.data());
+
+    auto bus = std::make_shared<AudioBus>(1, rendered);
+    memcpy(bus->channel(0)->mutableData(), frames.data(), sizeof(float) * rendered);
+    bus->setSampleRate(44100.f);
+    return bus;
+}
+
+SfxrNode::Sound SfxrNode::sound() const
+{
+    Sound s;
+    s.waveType = static_cast<int>(_waveType->valueUint32());
+    s.attack = _attack->value();
+    s.sustainTime = _sustainTime->value();
+    s.sustainPunch = _sustainPunch->value();
+    s.decayTime = _decayTime->value();
+    s.startFrequency = _startFrequency->value();
+    s.minFrequency = _minFrequency->value();
+    s.slide = _slide->value();
+    s.deltaSlide = _deltaSlide->value();
+    s.vibratoDepth = _vibratoDepth->value();
+    s.vibratoSpeed = _vibratoSpeed->value();
+    s.changeAmount = _changeAmount->value();
+    s.changeSpeed = _changeSpeed->value();
+    s.squareDuty = _squareDuty->value();
+    s.dutySweep = _dutySweep->value();
+    s.repeatSpeed = _repeatSpeed->value();
+    s.phaserOffset = _phaserOffset->value();
+    s.phaserSweep = _phaserSweep->value();
+    s.lpFilterCutoff = _lpFilterCutoff->value();
+    s.lpFilterCutoffSweep = _lpFilterCutoffSweep->value();
+    s.lpFilterResonance = _lpFilterResonance->value();
+    s.hpFilterCutoff = _hpFilterCutoff->value();
+    s.hpFilterCutoffSweep = _hpFilterCutoffSweep->value();
+    s.volume = sfxr->sound_vol;
+    return s;
+}
+
+void SfxrNode::setSound(Sfxr & voice, const Sound & s)
+{
+    voice.ResetParams();
+    voice.wave_type = s.waveType;
+    voice.p_base_freq = s.startFrequency;
+    voice.p_freq_limit = s.minFrequency;
+    voice.p_freq_ramp = s.slide;
+    voice.p_freq_dramp = s.deltaSlide;
+    voice.p_duty = s.squareDuty;
+    voice.p_duty_ramp = s.dutySweep;
+    voice.p_vib_strength = s.vibratoDepth;
+    voice.p_vib_speed = s.vibratoSpeed;
+    voice.p_env_attack = s.attack;
+    voice.p_env_sustain = s.sustainTime;
+    voice.p_env_decay = s.decayTime;
+    voice.p_env_punch = s.sustainPunch;
+    voice.p_lpf_resonance = s.lpFilterResonance;
+    voice.filter_on = voice.p_lpf_resonance > 0;
+    voice.p_lpf_freq = s.lpFilterCutoff;
+    voice.p_lpf_ramp = s.lpFilterCutoffSweep;
+    voice.p_hpf_freq = s.hpFilterCutoff;
+    voice.p_hpf_ramp = s.hpFilterCutoffSweep;
+    voice.p_pha_offset = s.phaserOffset;
+    voice.p_pha_ramp = s.phaserSweep;
+    voice.p_repeat_speed = s.repeatSpeed;
+    voice.p_arp_speed = s.changeSpeed;
+    voice.p_arp_mod = s.changeAmount;
+    voice.sound_vol = s.volume;
+}
+
+std::vector<std::shared_ptr<AudioBus>> SfxrNode::bake(const std::vector<Sound> & sounds)
+{
+    DenormalDisabler denormalDisabler;
+
+    const size_t count = sounds.size();
+    std::vector<std::unique_ptr<Sfxr>> voices(count);
+    std::vector<int> lengths(count);
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        voices[i].reset(new Sfxr());
+        setSound(*voices[i], sounds[i]);
+        voices[i]->PlaySample();
+        lengths[i] = voices[i]->env_length[0] + voices[i]->env_length[1] + voices[i]->env_length[2] + 3;
+        order[i] = i;
+    }
+
+    // voices rendered together share a loop for their waveform and filtering, and run
+    // until the longest of them ends, so they are grouped by those, and then by length
+    auto key = [&](size_t i) { return voices[i]->wave_type * 2 + (voices[i]->p_lpf_freq != 1.0f ? 1 : 0); };
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return key(a) != key(b) ? key(a) < key(b) : lengths[a] < lengths[b];
+    });
+
+    // a voice that has ended fills the lanes a group lacks
+    Sfxr idle;
+    idle.ResetParams();
+    idle.PlaySample();
+    idle.playing_sample = false;
+
+    std::vector<std::shared_ptr<AudioBus>> buses(count);
+    std::vector<float> frames[Sfxr::LaneCount];
+    for (size_t first = 0; first < count;)
+    {
+        Sfxr * lanes[Sfxr::LaneCount];
+        float * buffers[Sfxr::LaneCount];
+        int laneLengths[Sfxr::LaneCount];
+        int rendered[Sfxr::LaneCount];
+        size_t members[Sfxr::LaneCount];
+        int n = 0;
+        for (; n < Sfxr::LaneCount && first + n < count && key(order[first + n]) == key(order[first]); ++n)
+        {
+            members[n] = order[first + n];
+            lanes[n] = voices[members[n]].get();
+            laneLengths[n] = lengths[members[n]];
+            frames[n].resize(laneLengths[n]);
+            buffers[n] = frames[n].data();
+        }
+        for (int l = n; l < Sfxr::LaneCount; ++l)
+        {
+            lanes[l] = &idle;
+            laneLengths[l] = 0;
+            buffers[l] = nullptr;
+        }
+
+        Sfxr::SynthLanes(lanes, buffers, laneLengths, rendered);
+
+        for (int l = 0; l < n; ++l)
+        {
+            auto bus = std::make_shared<AudioBus>(1, rendered[l]);
+            memcpy(bus->channel(0)->mutableData(), frames[l].data(), sizeof(float) * rendered[l]);
+            bus->setSampleRate(44100.f);
+            buses[members[l]] = bus;
+        }
+        first += n;
+    }
+    return buses;
+}
+
 bool SfxrNode::propagatesSilence(ContextRenderLock & r) const
 {
     return !isPlayingOrScheduled() || hasFinished();
@@ -855,8 +1243,6 @@ void SfxrNode::setDefaultBeep()
 
     // Sample parameters
     sfxr->sound_vol = 0.5f;
-    sfxr->wav_freq = 44100;
-    sfxr->wav_bits = 16;
 }
 
 void SfxrNode::coin()
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/SpatialLOD.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioListener.h"
+
+#include "internal/SpatialBatch.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+void SpatialLOD::add(std::shared_ptr<PannerNode> panner, float weight)
+{
+    if (!panner)
+        return;
+    for (auto & s : _sources)
+        if (s.panner.lock() == panner)
+        {
+            s.weight = weight;
+            return;
+        }
+
+    Source s;
+    s.panner = panner;
+    s.weight = weight;
+    _sources.push_back(s);
+}
+
+void SpatialLOD::remove(const std::shared_ptr<PannerNode> & panner)
+{
+    auto it = std::find_if(_sources.begin(), _sources.end(), [&panner](const Source & s) { return s.panner.lock() == panner; });
+    if (it == _sources.end())
+        return;
+    if (panner)
+        panner->setSpatialTier(SpatialTier::Model);
+    _sources.erase(it);
+}
+
+void SpatialLOD::setWeight(const std::shared_ptr<PannerNode> & panner, float weight)
+{
+    for (auto & s : _sources)
+        if (s.panner.lock() == panner)
+            s.weight = weight;
+}
+
+void SpatialLOD::update(AudioContext & ac)
+{
+    _sources.erase(std::remove_if(_sources.begin(), _sources.end(), [](const Source & s) { return s.panner.expired(); }),
+                   _sources.end());
+
+    // shrink the budget while rendering takes more than its share of each quantum
+    if (_settings.targetLoad > 0)
+    {
+        std::shared_ptr<AudioDestinationNode> destination = ac.destinationNode();
+        const float sampleRate = ac.sampleRate();
+        if (destination && sampleRate > 0)
+        {
+            const ProfileStats stats = destination->renderTimeStats(64);
+            const float quantumMicroseconds = 1.e6f * ac.renderQuantumSize() / sampleRate;
+            const float load = stats.count ? stats.mean / quantumMicroseconds : 0.f;
+            if (load > _settings.targetLoad)
+                _budgetScale = std::max(0.05f, _budgetScale * 0.9f);
+            else if (load < 0.8f * _settings.targetLoad)
+                _budgetScale = std::min(1.f, _budgetScale * 1.05f);
+        }
+    }
+    else
+        _budgetScale = 1.f;
+
+    auto listener = ac.listener();
+    SpatialListener frame;
+    frame.position = {
+        listener->positionX()->value(),
+        listener->positionY()->value(),
+        listener->positionZ()->value()};
+
+    // the distances are found in one pass over the positions
+    const int count = static_cast<int>(_sources.size());
+    _positions.resize(size_t(count) * 3);
+    _distances.resize(count);
+    std::shared_ptr<SpatialScene> scene = ac.spatialScene();
+    for (int i = 0; i < count; ++i)
+    {
+        std::shared_ptr<PannerNode> panner = _sources[i].panner.lock();
+        FloatPoint3D position = {panner->positionX()->value(), panner->positionY()->value(), panner->positionZ()->value()};
+        if (panner->sceneSlot() >= 0)
+            position = scene->transform(panner->sceneSlot()).position;
+        _positions[i] = position.x;
+        _positions[count + i] = position.y;
+        _positions[2 * count + i] = position.z;
+    }
+    SpatialSources positions;
+    positions.x = _positions.data();
+    positions.y = positions.x + count;
+    positions.z = positions.y + count;
+    positions.count = count;
+    SpatialBatch::distances(frame, positions, _distances.data());
+
+    _ranked.clear();
+    for (int i = 0; i < count; ++i)
+    {
+        Source & s = _sources[i];
+        std::shared_ptr<PannerNode> panner = s.panner.lock();
+        s.distance = _distances[i];
+
+        // a source holding a costly tier is ranked a little above its audibility
+        const bool holdsTier = s.tier == SpatialTier::HRTF || s.tier == SpatialTier::Binaural;
+        s.score = panner->audibleGain() * s.weight * (holdsTier ? 1.f + _settings.hysteresis : 1.f);
+        _ranked.push_back(&s);
+    }
+    std::stable_sort(_ranked.begin(), _ranked.end(), [](const Source * a, const Source * b) { return a->score > b->score; });
+
+    float remaining = _settings.budget * _budgetScale;
+    for (Source * s : _ranked)
+    {
+        SpatialTier tier = SpatialTier::Virtual;
+        if (s->score >= _settings.cullGain)
+        {
+            if (s->distance <= _settings.hrtfDistance && remaining >= _settings.hrtfCost)
+            {
+                tier = SpatialTier::HRTF;
+                remaining -= _settings.hrtfCost;
+            }
+            else if (s->distance <= _settings.binauralDistance && remaining >= _settings.binauralCost)
+            {
+                tier = SpatialTier::Binaural;
+                remaining -= _settings.binauralCost;
+            }
+            else if (remaining >= _settings.equalPowerCost)
+            {
+                tier = SpatialTier::EqualPower;
+                remaining -= _settings.equalPowerCost;
+            }
+        }
+
+        if (tier != s->tier)
+        {
+            s->tier = tier;
+            s->panner.lock()->setSpatialTier(tier);
+        }
+    }
+}
+
+}  // lab
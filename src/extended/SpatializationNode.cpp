@@ -7,6 +7,10 @@
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/SpatializationNode.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
 namespace lab
 {
 
@@ -25,47 +29,228 @@ namespace
         float d = magnitude(cross(x0x1, x0x2)) / magnitude(x2x1);
         return d;
     }
+
+    // An occluder covering more cells than this is tested against every line instead
+    const int MaxCellsPerOccluder = 64;
+
+    uint64_t cellKey(int x, int y, int z)
+    {
+        return (uint64_t(uint32_t(x) & 0x1fffff) << 42) | (uint64_t(uint32_t(y) & 0x1fffff) << 21) | uint64_t(uint32_t(z) & 0x1fffff);
+    }
+
+    int cellOf(float v)
+    {
+        const float limit = float(1 << 30);
+        return static_cast<int>(floorf(std::max(-limit, std::min(limit, v))));
+    }
+}
+
+Occluders::Occluders(float cellSize)
+    : m_cellSize(cellSize > 0 ? cellSize : 1.f)
+{
+}
+
+Occluders::CellRange Occluders::cellsCovered(const Occluder & o) const
+{
+    const float scale = 1.f / m_cellSize;
+    const float r = o.outerRadius;
+    CellRange range;
+    range.x0 = cellOf((o.x - r) * scale);
+    range.y0 = cellOf((o.y - r) * scale);
+    range.z0 = cellOf((o.z - r) * scale);
+    range.x1 = cellOf((o.x + r) * scale);
+    range.y1 = cellOf((o.y + r) * scale);
+    range.z1 = cellOf((o.z + r) * scale);
+    const int64_t cells = int64_t(range.x1 - range.x0 + 1) * (range.y1 - range.y0 + 1) * (range.z1 - range.z0 + 1);
+    range.large = cells > MaxCellsPerOccluder;
+    return range;
+}
+
+void Occluders::file(int id, const Occluder & o)
+{
+    const CellRange range = cellsCovered(o);
+    if (range.large)
+    {
+        m_large.push_back(id);
+        return;
+    }
+
+    for (int x = range.x0; x <= range.x1; ++x)
+        for (int y = range.y0; y <= range.y1; ++y)
+            for (int z = range.z0; z <= range.z1; ++z)
+                m_cells[cellKey(x, y, z)].push_back(id);
+}
+
+void Occluders::unfile(int id, const Occluder & o)
+{
+    auto eraseFrom = [id](std::vector<int> & ids)
+    {
+        auto i = std::find(ids.begin(), ids.end(), id);
+        if (i != ids.end())
+        {
+            *i = ids.back();
+            ids.pop_back();
+        }
+    };
+
+    const CellRange range = cellsCovered(o);
+    if (range.large)
+    {
+        eraseFrom(m_large);
+        return;
+    }
+
+    for (int x = range.x0; x <= range.x1; ++x)
+        for (int y = range.y0; y <= range.y1; ++y)
+            for (int z = range.z0; z <= range.z1; ++z)
+            {
+                auto cell = m_cells.find(cellKey(x, y, z));
+                if (cell == m_cells.end())
+                    continue;
+                eraseFrom(cell->second);
+                if (cell->second.empty())
+                    m_cells.erase(cell);
+            }
 }
 
 void Occluders::setOccluder(int id, float x, float y, float z, float radius)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     Occluder o(x, y, z, radius);
-    occluders[id] = o;
+    auto i = occluders.find(id);
+    if (i != occluders.end())
+    {
+        unfile(id, i->second.occluder);
+        i->second.occluder = o;
+    }
+    else
+        occluders[id].occluder = o;
+
+    file(id, o);
+    ++m_revision;
 }
 
 void Occluders::removeOccluder(int id)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     auto i = occluders.find(id);
     if (i != occluders.end())
+    {
+        unfile(id, i->second.occluder);
         occluders.erase(i);
+        ++m_revision;
+    }
+}
+
+void Occluders::attenuate(const Occluder & o, const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos, float & occlusionAttenuation)
+{
+    FloatPoint3D occPos(o.x, o.y, o.z);
+
+    float t;
+    float d = distanceFromPointToLine(occPos, listenerPos, sourcePos, t);
+
+    if (t <= 0 || t >= 1)
+        return;
+
+    float maxAtten = o.maxAttenuation;
+
+    if (d <= o.innerRadius)
+    {
+        occlusionAttenuation *= maxAtten;
+    }
+    else if (d <= o.outerRadius)
+    {
+        float inner = o.innerRadius;
+        float t = (d - inner) / (o.outerRadius - inner);
+        occlusionAttenuation *= maxAtten + (1.0f - maxAtten) * t;
+    }
 }
 
 float Occluders::occlusion(const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos) const
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     float occlusionAttenuation = 1.0f;
-    for (const auto & i : occluders)
+    if (occluders.empty())
+        return occlusionAttenuation;
+
+    // an occluder may be filed in several cells the line crosses, but is tested once
+    uint32_t visit = ++m_visit;
+    if (!visit)
+    {
+        for (const auto & i : occluders)
+            i.second.visit = 0;
+        visit = m_visit = 1;
+    }
+    auto testId = [&](int id)
     {
-        FloatPoint3D occPos(i.second.x, i.second.y, i.second.z);
+        const Entry & entry = occluders.find(id)->second;
+        if (entry.visit == visit)
+            return;
+        entry.visit = visit;
+        attenuate(entry.occluder, sourcePos, listenerPos, occlusionAttenuation);
+    };
 
-        float t;
-        float d = distanceFromPointToLine(occPos, listenerPos, sourcePos, t);
+    for (int id : m_large)
+        testId(id);
 
-        if (t <= 0 || t >= 1)
-            continue;
+    // Walk the cells the line crosses, from the listener to the source, a cell at a time
+    // along whichever axis reaches its next cell boundary first
+    const float scale = 1.f / m_cellSize;
+    const FloatPoint3D from = listenerPos * scale;
+    const FloatPoint3D to = sourcePos * scale;
+    int cell[3] = {cellOf(from.x), cellOf(from.y), cellOf(from.z)};
+    const int last[3] = {cellOf(to.x), cellOf(to.y), cellOf(to.z)};
+    const int64_t count = 1 + int64_t(std::abs(last[0] - cell[0])) + std::abs(last[1] - cell[1]) + std::abs(last[2] - cell[2]);
 
-        float maxAtten = i.second.maxAttenuation;
+    // a line crossing more cells than there are occluders is cheaper to test against each
+    if (count > static_cast<int64_t>(occluders.size()))
+    {
+        for (const auto & i : occluders)
+            testId(i.first);
+        return occlusionAttenuation;
+    }
 
-        if (d <= i.second.innerRadius)
+    const FloatPoint3D direction = to - from;
+    int step[3];
+    float tMax[3];
+    float tDelta[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (direction[axis] > 0)
+        {
+            step[axis] = 1;
+            tDelta[axis] = 1.f / direction[axis];
+            tMax[axis] = (cell[axis] + 1 - from[axis]) * tDelta[axis];
+        }
+        else if (direction[axis] < 0)
         {
-            occlusionAttenuation *= maxAtten;
+            step[axis] = -1;
+            tDelta[axis] = -1.f / direction[axis];
+            tMax[axis] = (from[axis] - cell[axis]) * tDelta[axis];
         }
-        else if (d <= i.second.outerRadius)
+        else
         {
-            float inner = i.second.innerRadius;
-            float t = (d - inner) / (i.second.outerRadius - inner);
-            occlusionAttenuation *= maxAtten + (1.0f - maxAtten) * t;
+            step[axis] = 0;
+            tDelta[axis] = FLT_MAX;
+            tMax[axis] = FLT_MAX;
         }
     }
+
+    for (int64_t i = 0; i < count; ++i)
+    {
+        auto found = m_cells.find(cellKey(cell[0], cell[1], cell[2]));
+        if (found != m_cells.end())
+            for (int id : found->second)
+                testId(id);
+
+        const int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+    }
+
     return occlusionAttenuation;
 }
 
@@ -89,18 +274,26 @@ float SpatializationNode::distanceConeGain(ContextRenderLock & r)
     auto listener = r.context()->listener();
 
     /// @fixme these values should be per sample, not per quantum
-    FloatPoint3D fwd = {
-        listener->forwardX()->value(),
-        listener->forwardY()->value(),
-        listener->forwardZ()->value()};
+    FloatPoint3D listenerPos = {
+        listener->positionX()->value(),
+        listener->positionY()->value(),
+        listener->positionZ()->value()};
 
     /// @fixme these values should be per sample, not per quantum
-    FloatPoint3D pos = {
-        positionX()->value(),
-        positionY()->value(),
-        positionZ()->value()};
+    const FloatPoint3D pos = sourceTransform(r).position;
+
+    // the occlusion only changes when the geometry or a position does
+    const Occluders * o = occluders.get();
+    const uint64_t revision = o ? o->revision() : 0;
+    if (o != m_cachedOccluders || revision != m_cachedRevision || pos != m_cachedSource || listenerPos != m_cachedListener)
+    {
+        m_cachedOcclusion = o ? o->occlusion(pos, listenerPos) : 1.0f;
+        m_cachedOccluders = o;
+        m_cachedRevision = revision;
+        m_cachedSource = pos;
+        m_cachedListener = listenerPos;
+    }
 
-    float occlusionAttenuation = occluders ? occluders->occlusion(pos, fwd) : 1.0f;
-    return occlusionAttenuation * PannerNode::distanceConeGain(r);
+    return m_cachedOcclusion * PannerNode::distanceConeGain(r);
 }
 }
@@ -6,100 +6,78 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSetting.h"
 #include "LabSound/core/Macros.h"
-#include "LabSound/core/WindowFunctions.h"
 
 #include "LabSound/extended/SpectralMonitorNode.h"
 #include "LabSound/extended/Registry.h"
+#include "LabSound/extended/Util.h"
 
-#include <cmath>
-#include <ooura/fftsg.h>
+#include "internal/SpectralAnalysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace lab
 {
 
 using namespace lab;
 
-//////////////////////////////////////////////////////
-// Prviate FFT + SpectralMonitorNode Implementation //
-//////////////////////////////////////////////////////
-
-// FFT class directly inspired by that in Cinder Audio 2.
-struct FFT
-{
-public:
-    FFT(int size)
-        : size(size)
-    {
-        oouraIp = (int *) calloc(2 + (int) sqrt(size / 2), sizeof(int));
-        oouraW = (float *) calloc(size / 2, sizeof(float));
-    }
-
-    ~FFT()
-    {
-        free(oouraIp);
-        free(oouraW);
-    }
-
-    // does an in place transform of waveform to real and imag.
-    // real values are on even, imag on odd
-    void forward(std::vector<float> & waveform)
-    {
-        ooura::rdft(static_cast<int>(size), 1, &waveform[0], oouraIp, oouraW);
-    }
-
-    int size;
-    int * oouraIp;
-    float * oouraW;
-};
+////////////////////////////////////////
+// Private SpectralMonitorNode Internal //
+////////////////////////////////////////
 
+// The audio thread writes the input to a SpectralAnalysis, shared with other monitors of the
+// same signal, and copies the latest spectrum out of it when the reader has asked for one.
+// The reader changes the analysis and takes the spectrum under the mutex, which the audio
+// thread only tries to take, so it never waits for the reader.
 class SpectralMonitorNode::SpectralMonitorNodeInternal
 {
 public:
-    SpectralMonitorNodeInternal(std::shared_ptr<AudioSetting> windowSize_)
+    SpectralMonitorNodeInternal(std::shared_ptr<AudioSetting> windowSize_, std::shared_ptr<AudioSetting> hopSize_)
         : windowSize(windowSize_)
-        , fft(nullptr)
-    {
-        setWindowSize(512);
-    }
-
-    ~SpectralMonitorNodeInternal()
+        , hopSize(hopSize_)
     {
-        delete fft;
+        windowSize->setUint32(512);
+        configure();
     }
 
-    void setWindowSize(int s)
+    // Under the mutex. Makes a new analysis if the settings no longer match the current one.
+    void configure()
     {
-        cursor = 0;
-        windowSize->setUint32(static_cast<int>(s));
-
-        buffer.resize(s);
-
-        for (int i = 0; i < s; ++i)
-        {
-            buffer[i] = 0;
-        }
-
-        delete fft;
-        fft = new FFT(s);
+        const int fftSize = std::max(2, static_cast<int>(RoundNextPow2(windowSize->valueUint32())));
+        const int hop = hopSize->valueUint32() ? static_cast<int>(hopSize->valueUint32()) : fftSize;
+        if (own && own->fftSize() == fftSize && own->hopSize() == std::min(hop, fftSize))
+            return;
+
+        own = std::make_shared<SpectralAnalysis>(fftSize, hop);
+        analysis = own;
+        tap = nullptr;
+        magnitudes.assign(own->binCount(), 0.f);
+        publishedHop = ~uint64_t(0);
     }
 
-    float _db;
+    std::shared_ptr<AudioSetting> windowSize;
+    std::shared_ptr<AudioSetting> hopSize;
 
-    int cursor;
+    std::mutex magMutex;
 
-    std::vector<float> buffer;
-    std::recursive_mutex magMutex;
+    // the node's own analysis, and the one it writes, which may be shared
+    std::shared_ptr<SpectralAnalysis> own;
+    std::shared_ptr<SpectralAnalysis> analysis;
+    const void * tap = nullptr;
 
-    std::shared_ptr<AudioSetting> windowSize;
-
-    FFT * fft;
+    // the spectrum of the hop last published
+    std::vector<float> magnitudes;
+    uint64_t publishedHop = ~uint64_t(0);
+    std::atomic<bool> requested {false};
 };
 
 ////////////////////////////////
 // Public SpectralMonitorNode //
 ////////////////////////////////
 
-static AudioSettingDescriptor s_smSettings[] = {{"windowSize", "WNSZ", SettingType::Integer}, nullptr};
+static AudioSettingDescriptor s_smSettings[] = {{"windowSize", "WNSZ", SettingType::Integer},
+                                                {"hopSize",    "HOPS", SettingType::Integer}, nullptr};
 
 AudioNodeDescriptor * SpectralMonitorNode::desc()
 {
@@ -110,7 +88,7 @@ AudioNodeDescriptor * SpectralMonitorNode::desc()
 SpectralMonitorNode::SpectralMonitorNode(AudioContext & ac)
 : AudioBasicInspectorNode(ac, *desc())
 {
-    internalNode = new SpectralMonitorNodeInternal(setting("windowSize"));
+    internalNode = new SpectralMonitorNodeInternal(setting("windowSize"), setting("hopSize"));
     initialize();
 }
 
@@ -144,48 +122,28 @@ void SpectralMonitorNode::process(ContextRenderLock &r, int bufferSize)
 
     // specific to this node
     {
-        std::vector<const float *> channels;
-        int numberOfChannels = bus->numberOfChannels();
-        for (int c = 0; c < numberOfChannels; ++c)
-            channels.push_back(bus->channel(c)->data());
-
-        int sz = internalNode->windowSize->valueUint32();
-
-        // if the fft is smaller than the quantum, just grab a chunk
-        if (sz < bufferSize)
-        {
-            internalNode->cursor = 0;
-            bufferSize = internalNode->windowSize->valueUint32();
-        }
-
-        // if the quantum overlaps the end of the window, just fill up the buffer
-        if (internalNode->cursor + bufferSize > sz)
-            bufferSize = sz - internalNode->cursor;
-
+        std::unique_lock<std::mutex> lock(internalNode->magMutex, std::try_to_lock);
+        if (lock.owns_lock())
         {
-            std::lock_guard<std::recursive_mutex> lock(internalNode->magMutex);
-
-            internalNode->buffer.resize(sz);
+            SpectralMonitorNodeInternal & in = *internalNode;
 
-            for (int i = 0; i < bufferSize; ++i)
+            const void * tap = SpectralAnalysis::tapOf(r, input(0).get());
+            if (tap != in.tap)
             {
-                internalNode->buffer[i + internalNode->cursor] = 0;
+                in.tap = tap;
+                in.analysis = SpectralAnalysis::share(tap, in.own);
+                in.publishedHop = ~uint64_t(0);
             }
+            in.analysis->write(r.context()->currentSampleFrame(), bus, bufferSize);
 
-            for (int c = 0; c < numberOfChannels; ++c)
+            // publish each hop's spectrum, as long as the reader keeps asking
+            const uint64_t hop = in.analysis->hops();
+            if (hop != in.publishedHop && in.requested.exchange(false, std::memory_order_acquire))
             {
-                for (int i = 0; i < bufferSize; ++i)
-                {
-                    float p = channels[c][i];
-                    internalNode->buffer[i + internalNode->cursor] += p;
-                }
+                in.publishedHop = hop;
+                memcpy(in.magnitudes.data(), in.analysis->magnitudes(), sizeof(float) * in.magnitudes.size());
             }
         }
-
-        // advance the cursor
-        internalNode->cursor += bufferSize;
-        if (internalNode->cursor >= static_cast<int>(internalNode->windowSize->valueUint32()))
-            internalNode->cursor = 0;
     }
     // to here
 
@@ -195,43 +153,33 @@ void SpectralMonitorNode::process(ContextRenderLock &r, int bufferSize)
 
 void SpectralMonitorNode::reset(ContextRenderLock &)
 {
-    internalNode->setWindowSize(internalNode->windowSize->valueUint32());
+    std::unique_lock<std::mutex> lock(internalNode->magMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    // a shared analysis carries on for the monitors still using it
+    internalNode->own->reset();
+    internalNode->analysis = internalNode->own;
+    internalNode->tap = nullptr;
+    internalNode->publishedHop = ~uint64_t(0);
+    std::fill(internalNode->magnitudes.begin(), internalNode->magnitudes.end(), 0.f);
 }
 
 void SpectralMonitorNode::spectralMag(std::vector<float> & result)
 {
-    std::vector<float> window;
-
     {
-        std::lock_guard<std::recursive_mutex> lock(internalNode->magMutex);
-        window.swap(internalNode->buffer);
-        internalNode->setWindowSize(internalNode->windowSize->valueUint32());
+        std::lock_guard<std::mutex> lock(internalNode->magMutex);
+        internalNode->configure();
+        result = internalNode->magnitudes;
     }
 
-    // http://www.ni.com/white-paper/4844/en/
-    ApplyWindowFunctionInplace(WindowFunction::blackman, window.data(), static_cast<int>(window.size()));
-    internalNode->fft->forward(window);
-
-    // similar to cinder audio2 Scope object, although Scope smooths spectral samples frame by frame
-    // remove nyquist component - the first imaginary component
-    window[1] = 0.0f;
-
-    // compute normalized magnitude spectrum
-    /// @TODO @tofix - break this into vector Cartesian -> polar and then vector lowpass. skip lowpass if smoothing factor is very small
-    const float kMagScale = 1.0f;  /// detail->windowSize;
-    for (int i = 0; i < window.size(); i += 2)
-    {
-        float re = window[i];
-        float im = window[i + 1];
-        window[i / 2] = sqrt(re * re + im * im) * kMagScale;
-    }
-
-    result.swap(window);
+    // ask for the spectrum of the next hop to be published
+    internalNode->requested.store(true, std::memory_order_release);
 }
 
 void SpectralMonitorNode::windowSize(unsigned int ws)
 {
-    internalNode->setWindowSize(ws);
+    internalNode->windowSize->setUint32(ws);
 }
 
 unsigned int SpectralMonitorNode::windowSize() const
@@ -239,4 +187,14 @@ unsigned int SpectralMonitorNode::windowSize() const
     return internalNode->windowSize->valueUint32();
 }
 
+void SpectralMonitorNode::hopSize(unsigned int hs)
+{
+    internalNode->hopSize->setUint32(hs);
+}
+
+unsigned int SpectralMonitorNode::hopSize() const
+{
+    return internalNode->hopSize->valueUint32();
+}
+
 }  // namespace lab
@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/SpectralProcessorNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/WindowFunctions.h"
+
+#include "internal/FFTFrame.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+using namespace VectorMath;
+
+static AudioSettingDescriptor s_spectralSettings[] = {
+    {"fftSize", "FFTS", SettingType::Integer},
+    {"overlap", "OVLP", SettingType::Integer},
+    {"window",  "WNDW", SettingType::Enum, s_window_types},
+    nullptr};
+
+AudioNodeDescriptor * SpectralProcessorNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_spectralSettings, 1};
+    return &d;
+}
+
+// fftSize rounded up to a power of two from 32 to 32768, and its hop for overlap rounded up
+// to a power of two up to 16
+static void chooseSizes(int requestedSize, int requestedOverlap, int & fftSize, int & hop)
+{
+    fftSize = 32;
+    while (fftSize < requestedSize && fftSize < 32768)
+        fftSize *= 2;
+    int overlap = 1;
+    while (overlap < requestedOverlap && overlap < 16)
+        overlap *= 2;
+    hop = fftSize / overlap;
+}
+
+// A channel's frames, its overlapping resyntheses, and its spectrum
+struct SpectralProcessorNode::Channel
+{
+    Channel(int fftSize, int hopSize)
+        : frame(fftSize)
+        , input(fftSize)
+        , time(fftSize)
+        , accumulated(fftSize)
+        , ready(hopSize)
+    {
+        // a backend whose spectra are laid out otherwise has them unpacked into bins of its own
+        if (FFTFrame::spectrumLayout() != 1)
+        {
+            real.allocate(fftSize / 2 + 1);
+            imag.allocate(fftSize / 2 + 1);
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        input.zero();
+        accumulated.zero();
+        ready.zero();
+    }
+
+    float * realBins() { return real.size() ? real.data() : frame.realData(); }
+    float * imagBins() { return imag.size() ? imag.data() : frame.imagData(); }
+
+    // from the layout with nyquist packed into the imaginary DC value and the bins scaled by two
+    void unpack()
+    {
+        if (!real.size())
+            return;
+        const int half = frame.fftSize() / 2;
+        const float scale = 0.5f;
+        vsmul(frame.realData(), 1, &scale, real.data(), 1, half);
+        vsmul(frame.imagData(), 1, &scale, imag.data(), 1, half);
+        real[half] = imag[0];
+        imag[0] = 0.f;
+        imag[half] = 0.f;
+    }
+
+    void pack()
+    {
+        if (!real.size())
+            return;
+        const int half = frame.fftSize() / 2;
+        const float scale = 2.f;
+        imag[0] = real[half];
+        vsmul(real.data(), 1, &scale, frame.realData(), 1, half);
+        vsmul(imag.data(), 1, &scale, frame.imagData(), 1, half);
+    }
+
+    FFTFrame frame;
+    AudioFloatArray input;        // the last fftSize frames taken in
+    AudioFloatArray time;         // a windowed frame, and its resynthesis
+    AudioFloatArray accumulated;  // the sum of the resyntheses overlapping the next fftSize frames
+    AudioFloatArray ready;        // the hop being played out
+    AudioFloatArray real;
+    AudioFloatArray imag;
+};
+
+SpectralProcessorNode::SpectralProcessorNode(AudioContext & ac)
+    : SpectralProcessorNode(ac, nullptr)
+{
+}
+
+SpectralProcessorNode::SpectralProcessorNode(AudioContext & ac, std::unique_ptr<SpectralProcessor> processor, int fftSize, int overlap)
+    : AudioNode(ac, *desc())
+    , _processor(std::move(processor))
+{
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+    _fftSize = setting("fftSize");
+    _overlap = setting("overlap");
+    _window = setting("window");
+    _fftSize->setUint32(static_cast<uint32_t>(fftSize), false);
+    _overlap->setUint32(static_cast<uint32_t>(overlap), false);
+    _window->setUint32(static_cast<uint32_t>(WindowFunction::hann), false);
+
+    // The node is configured as it first renders, when its channels are known. The window's
+    // table and the FFT's plan are made here, so that the audio thread finds them ready.
+    int size, hop;
+    chooseSizes(fftSize, overlap, size, hop);
+    WindowFunctionTable(WindowFunction::hann, size);
+    FFTFrame plan(size);
+
+    initialize();
+}
+
+SpectralProcessorNode::~SpectralProcessorNode()
+{
+    uninitialize();
+}
+
+void SpectralProcessorNode::prepareSpectrum(float sampleRate, int fftSize, int hopSize, int channels)
+{
+    if (_processor)
+        _processor->prepare(sampleRate, fftSize, hopSize, channels);
+}
+
+void SpectralProcessorNode::processSpectrum(ContextRenderLock & r, const SpectralBlock & block)
+{
+    if (_processor)
+        _processor->process(r, block);
+}
+
+void SpectralProcessorNode::configure(float sampleRate, int fftSize, int hopSize, int windowType, int channels)
+{
+    _sampleRate = sampleRate;
+    _size = fftSize;
+    _hopSize = hopSize;
+    _windowType = windowType;
+    _fill = 0;
+    _hops = 0;
+
+    // The synthesis window is the analysis window over the sum of the squares of the windows
+    // overlapping each frame, so that analysis and synthesis together sum to one.
+    _analysis = WindowFunctionTable(static_cast<WindowFunction>(windowType), fftSize);
+    _synthesis.allocate(fftSize);
+    for (int i = 0; i < hopSize; ++i)
+    {
+        float sum = 0.f;
+        for (int j = i; j < fftSize; j += hopSize)
+            sum += _analysis[j] * _analysis[j];
+        for (int j = i; j < fftSize; j += hopSize)
+            _synthesis[j] = sum > 1e-6f ? _analysis[j] / sum : 0.f;
+    }
+
+    _channels.clear();
+    for (int c = 0; c < channels; ++c)
+        _channels.emplace_back(new Channel(fftSize, hopSize));
+    _real.resize(channels);
+    _imag.resize(channels);
+    for (int c = 0; c < channels; ++c)
+    {
+        _real[c] = _channels[c]->realBins();
+        _imag[c] = _channels[c]->imagBins();
+    }
+
+    prepareSpectrum(sampleRate, fftSize, hopSize, channels);
+}
+
+void SpectralProcessorNode::analyseAndResynthesize(ContextRenderLock & r)
+{
+    const int size = _size;
+    const int hop = _hopSize;
+
+    for (auto & channel : _channels)
+    {
+        vmul(channel->input.data(), 1, _analysis, 1, channel->time.data(), 1, size);
+        channel->frame.computeForwardFFT(channel->time.data());
+        channel->unpack();
+    }
+
+    SpectralBlock block;
+    block.fftSize = size;
+    block.hopSize = hop;
+    block.binCount = size / 2 + 1;
+    block.channels = static_cast<int>(_channels.size());
+    block.sampleRate = _sampleRate;
+    block.hop = _hops++;
+    block.real = _real.data();
+    block.imag = _imag.data();
+    processSpectrum(r, block);
+
+    for (auto & channel : _channels)
+    {
+        channel->pack();
+        channel->frame.computeInverseFFT(channel->time.data());
+
+        // the resynthesis is added to those overlapping it, whose first hop is then complete
+        float * accumulated = channel->accumulated.data();
+        vmadd(channel->time.data(), 1, _synthesis.data(), 1, accumulated, 1, size);
+        std::memcpy(channel->ready.data(), accumulated, sizeof(float) * hop);
+        std::memmove(accumulated, accumulated + hop, sizeof(float) * (size - hop));
+        std::memset(accumulated + size - hop, 0, sizeof(float) * hop);
+
+        float * input = channel->input.data();
+        std::memmove(input, input + hop, sizeof(float) * (size - hop));
+    }
+}
+
+void SpectralProcessorNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * destination = output(0)->bus(r);
+    AudioBus * source = input(0)->bus(r);
+    if (!isInitialized() || !input(0)->isConnected() || !source)
+    {
+        destination->zero();
+        return;
+    }
+
+    const int channels = std::min(source->numberOfChannels(), static_cast<int>(MaxChannels));
+    if (destination->numberOfChannels() != channels)
+    {
+        output(0)->setNumberOfChannels(r, channels);
+        destination = output(0)->bus(r);
+    }
+
+    int fftSize, hop;
+    chooseSizes(static_cast<int>(_fftSize->valueUint32()), static_cast<int>(_overlap->valueUint32()), fftSize, hop);
+    const int windowType = static_cast<int>(_window->valueUint32());
+
+    // the frames under way are dropped when the sizes change, as a node made afresh would
+    const float sampleRate = r.context()->sampleRate();
+    if (fftSize != _size || hop != _hopSize || windowType != _windowType || sampleRate != _sampleRate ||
+        channels != static_cast<int>(_channels.size()))
+        configure(sampleRate, fftSize, hop, windowType, channels);
+
+    for (int done = 0; done < bufferSize;)
+    {
+        const int count = std::min(bufferSize - done, hop - _fill);
+        for (int c = 0; c < channels; ++c)
+        {
+            Channel & channel = *_channels[c];
+            std::memcpy(channel.input.data() + fftSize - hop + _fill, source->channel(c)->data() + done, sizeof(float) * count);
+            std::memcpy(destination->channel(c)->mutableData() + done, channel.ready.data() + _fill, sizeof(float) * count);
+        }
+
+        _fill += count;
+        done += count;
+        if (_fill == hop)
+        {
+            analyseAndResynthesize(r);
+            _fill = 0;
+        }
+    }
+}
+
+void SpectralProcessorNode::reset(ContextRenderLock & r)
+{
+    for (auto & channel : _channels)
+        channel->reset();
+    _fill = 0;
+    _hops = 0;
+    if (_processor)
+        _processor->reset();
+}
+
+double SpectralProcessorNode::tailTime(ContextRenderLock & r) const
+{
+    return _sampleRate > 0 ? _size / static_cast<double>(_sampleRate) : 0;
+}
+
+double SpectralProcessorNode::latencyTime(ContextRenderLock & r) const
+{
+    return _sampleRate > 0 ? _size / static_cast<double>(_sampleRate) : 0;
+}
+
+}  // namespace lab
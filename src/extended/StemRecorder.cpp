@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/StemRecorder.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "internal/CaptureWriter.h"
+#include "internal/RecordingFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+using namespace lab;
+
+// What the audio thread runs for one recording. Its taps don't change once it is made.
+struct StemRecorder::Capture : public AudioRenderCapture
+{
+    struct Track
+    {
+        std::shared_ptr<AudioNode> node;
+        std::shared_ptr<AudioNodeOutput> output;
+        int firstTrack;  // of its writer's frames
+        int channels;
+        int writer;      // or bus, when recording into buses
+    };
+
+    struct Writer
+    {
+        std::shared_ptr<CaptureWriter> writer;
+        uint32_t session;
+        int stride;
+        float * frames;  // the block being captured
+    };
+
+    std::vector<Track> tracks;
+    std::vector<Writer> writers;
+    std::vector<std::shared_ptr<AudioBus>> buses;
+    uint64_t busLength = 0;  // of the longest
+    std::atomic<uint64_t> busFrames {0};
+
+    // the audio thread is busy while it captures, so that stopping can wait for it to be
+    // done with the buses
+    std::atomic<bool> active {false};
+    std::atomic<bool> busy {false};
+
+    virtual void capture(ContextRenderLock & r, int framesToProcess) override
+    {
+        busy.store(true);
+        if (active.load())
+        {
+            if (buses.empty())
+                captureToWriters(r, framesToProcess);
+            else
+                captureToBuses(r, framesToProcess);
+        }
+        busy.store(false, std::memory_order_release);
+    }
+
+    // an output is only read once its node has rendered this quantum, since otherwise its
+    // bus holds a previous quantum, or is gone
+    static AudioBus * renderedBus(ContextRenderLock & r, const Track & t, int framesToProcess)
+    {
+        if (!t.node->isProcessedForCurrentQuantum(r))
+            return nullptr;
+        AudioBus * bus = t.output->bus(r);
+        return bus && bus->length() >= framesToProcess ? bus : nullptr;
+    }
+
+    void captureToWriters(ContextRenderLock & r, int framesToProcess)
+    {
+        for (Writer & w : writers)
+            w.frames = w.writer->beginBlock(w.stride, framesToProcess);
+
+        for (const Track & t : tracks)
+        {
+            AudioBus * bus = renderedBus(r, t, framesToProcess);
+            const int shared = bus ? std::min(t.channels, bus->numberOfChannels()) : 0;
+            const int stride = writers[t.writer].stride;
+            for (int c = 0; c < t.channels; ++c)
+            {
+                float * dst = writers[t.writer].frames + t.firstTrack + c;
+                if (c < shared)
+                {
+                    const float * src = bus->channel(c)->data();
+                    for (int i = 0; i < framesToProcess; ++i)
+                        dst[size_t(i) * stride] = src[i];
+                }
+                else
+                {
+                    for (int i = 0; i < framesToProcess; ++i)
+                        dst[size_t(i) * stride] = 0.f;
+                }
+            }
+        }
+
+        const bool offline = r.context()->isOfflineContext();
+        for (Writer & w : writers)
+            w.writer->commitBlock(w.session, offline);
+    }
+
+    void captureToBuses(ContextRenderLock & r, int framesToProcess)
+    {
+        const uint64_t first = busFrames.load(std::memory_order_relaxed);
+        if (first >= busLength)
+            return;
+
+        for (const Track & t : tracks)
+        {
+            AudioBus * target = buses[t.writer].get();
+            if (first >= uint64_t(target->length()))
+                continue;
+
+            const int frames = static_cast<int>(std::min<uint64_t>(framesToProcess, target->length() - first));
+            AudioBus * bus = renderedBus(r, t, framesToProcess);
+            const int channels = std::min(t.channels, target->numberOfChannels());
+            const int shared = bus ? std::min(channels, bus->numberOfChannels()) : 0;
+            for (int c = 0; c < channels; ++c)
+            {
+                float * dst = target->channel(c)->mutableData() + first;
+                if (c < shared)
+                    memcpy(dst, bus->channel(c)->data(), sizeof(float) * frames);
+                else
+                    memset(dst, 0, sizeof(float) * frames);
+            }
+        }
+        busFrames.store(std::min(first + framesToProcess, busLength), std::memory_order_relaxed);
+    }
+
+    virtual void capturedOutputs(std::vector<AudioNodeOutput *> & outputs) const override
+    {
+        for (const Track & t : tracks)
+            outputs.push_back(t.output.get());
+    }
+};
+
+StemRecorder::StemRecorder(AudioContext & context)
+    : m_context(&context)
+{
+}
+
+StemRecorder::~StemRecorder()
+{
+    stopRecording();
+}
+
+int StemRecorder::addTap(std::shared_ptr<AudioNode> node, int outputIndex, int channels, const std::string & name)
+{
+    if (!node)
+        throw std::invalid_argument("Cannot tap a null node");
+    if (outputIndex < 0 || outputIndex >= node->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs");
+    if (channels < 0)
+        throw std::invalid_argument("A tap's channel count can't be negative");
+    if (isRecording())
+        throw std::runtime_error("Cannot add a tap while recording");
+
+    int firstTrack = 0;
+    for (const Tap & t : m_taps)
+        firstTrack += t.channels ? t.channels : std::max(1, t.node->output(t.outputIndex)->numberOfChannels());
+
+    m_taps.push_back({std::move(node), outputIndex, channels, name});
+    return firstTrack;
+}
+
+std::string StemRecorder::tapName(int tap) const
+{
+    if (tap < 0 || tap >= tapCount())
+        throw std::out_of_range("Tap index greater than available taps");
+    return m_taps[tap].name.empty() ? "stem" + std::to_string(tap + 1) : m_taps[tap].name;
+}
+
+void StemRecorder::clearTaps()
+{
+    if (isRecording())
+        throw std::runtime_error("Cannot clear taps while recording");
+    m_taps.clear();
+}
+
+bool StemRecorder::startRecording()
+{
+    return start(Destination::Memory, {}, RecorderFileFormat::WavFloat32, {});
+}
+
+bool StemRecorder::startRecordingToFile(const std::string & path, RecorderFileFormat format)
+{
+    return start(Destination::File, path, format, {});
+}
+
+bool StemRecorder::startRecordingStems(const std::string & directory, RecorderFileFormat format)
+{
+    return start(Destination::Stems, directory, format, {});
+}
+
+bool StemRecorder::startRecordingInto(const std::vector<std::shared_ptr<AudioBus>> & buses)
+{
+    if (buses.size() != m_taps.size())
+        throw std::invalid_argument("A bus is needed for every tap");
+    for (const std::shared_ptr<AudioBus> & bus : buses)
+        if (!bus)
+            throw std::invalid_argument("Cannot record into a null bus");
+    return start(Destination::Buses, {}, RecorderFileFormat::WavFloat32, buses);
+}
+
+bool StemRecorder::start(Destination destination, const std::string & path, RecorderFileFormat format,
+                         const std::vector<std::shared_ptr<AudioBus>> & buses)
+{
+    stopRecording();
+    m_writers.clear();
+    m_busFrames = 0;
+    if (m_taps.empty())
+        return false;
+
+    // each tap's channels are fixed here, so that every frame has the same tracks
+    std::shared_ptr<Capture> capture = std::make_shared<Capture>();
+    const bool perTap = destination == Destination::Stems || destination == Destination::Buses;
+    int trackCount = 0;
+    for (size_t i = 0; i < m_taps.size(); ++i)
+    {
+        const Tap & t = m_taps[i];
+        std::shared_ptr<AudioNodeOutput> output = t.node->output(t.outputIndex);
+        const int channels = t.channels ? t.channels : std::max(1, output->numberOfChannels());
+        capture->tracks.push_back({t.node, output, perTap ? 0 : trackCount, channels, perTap ? static_cast<int>(i) : 0});
+        trackCount += channels;
+    }
+
+    if (destination == Destination::Buses)
+    {
+        capture->buses = buses;
+        for (const std::shared_ptr<AudioBus> & bus : buses)
+            capture->busLength = std::max(capture->busLength, uint64_t(bus->length()));
+    }
+    else
+    {
+        // every file is created before any is written, so that a failure records nothing. Each
+        // stem's writer thread encodes its own file, and compressed files share the JobSystem.
+        std::vector<std::unique_ptr<RecordingFile>> files;
+        if (destination == Destination::File)
+        {
+            files.push_back(createRecordingFile(path, trackCount, m_context->sampleRate(), format));
+            if (!files.back())
+                return false;
+        }
+        else if (destination == Destination::Stems)
+        {
+            for (size_t i = 0; i < capture->tracks.size(); ++i)
+            {
+                const std::string file = path + "/" + tapName(static_cast<int>(i)) + recordingFileExtension(format);
+                files.push_back(createRecordingFile(file, capture->tracks[i].channels, m_context->sampleRate(), format));
+                if (!files.back())
+                    return false;
+            }
+        }
+
+        if (destination == Destination::Stems)
+        {
+            for (size_t i = 0; i < files.size(); ++i)
+            {
+                const int channels = capture->tracks[i].channels;
+                std::shared_ptr<CaptureWriter> writer = std::make_shared<CaptureWriter>(m_context->sampleRate(), channels);
+                const uint32_t session = writer->beginToFile(std::move(files[i]));
+                m_writers.push_back(writer);
+                capture->writers.push_back({std::move(writer), session, channels, nullptr});
+            }
+        }
+        else
+        {
+            std::shared_ptr<CaptureWriter> writer = std::make_shared<CaptureWriter>(m_context->sampleRate(), trackCount);
+            const uint32_t session = files.empty() ? writer->beginToMemory() : writer->beginToFile(std::move(files[0]));
+            m_writers.push_back(writer);
+            capture->writers.push_back({std::move(writer), session, trackCount, nullptr});
+        }
+    }
+
+    m_trackCount = trackCount;
+    capture->active.store(true);
+    m_capture = capture;
+    m_context->addRenderCapture(capture);
+    return true;
+}
+
+void StemRecorder::stopRecording()
+{
+    if (!m_capture)
+        return;
+
+    // the audio thread may still run the capture this quantum; what it copies for a writer
+    // then is discarded by the writer, and it is waited for if it is copying into buses
+    m_capture->active.store(false);
+    while (m_capture->busy.load())
+        std::this_thread::yield();
+    m_busFrames = m_capture->busFrames.load();
+
+    m_context->removeRenderCapture(m_capture);
+    for (const Capture::Writer & w : m_capture->writers)
+        w.writer->end(w.session);
+    m_capture.reset();
+}
+
+bool StemRecorder::isRecording() const
+{
+    return m_capture && m_capture->active.load();
+}
+
+uint64_t StemRecorder::droppedFrames() const
+{
+    uint64_t dropped = 0;
+    for (const std::shared_ptr<CaptureWriter> & writer : m_writers)
+        dropped += writer->droppedFrames();
+    return dropped;
+}
+
+uint64_t StemRecorder::framesRecordedInto() const
+{
+    return m_capture ? m_capture->busFrames.load() : m_busFrames;
+}
+
+std::unique_ptr<AudioBus> StemRecorder::createBusFromRecording()
+{
+    // only a recording of every track in one writer is made in memory
+    if (m_writers.size() != 1)
+        return {};
+
+    std::vector<std::vector<float>> data = m_writers[0]->takeRecording();
+    if (data.empty() || data[0].empty())
+        return {};
+
+    const int length = static_cast<int>(data[0].size());
+    std::unique_ptr<AudioBus> bus(new AudioBus(static_cast<int>(data.size()), length));
+    bus->setSampleRate(m_context->sampleRate());
+    for (size_t i = 0; i < data.size(); ++i)
+        memcpy(bus->channel(static_cast<int>(i))->mutableData(), data[i].data(), length * sizeof(float));
+    return bus;
+}
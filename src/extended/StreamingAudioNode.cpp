@@ -0,0 +1,456 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/StreamingAudioNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/Registry.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include "internal/DenormalDisabler.h"
+#include "internal/PCMFileReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+namespace
+{
+    // frames in a block of read ahead audio
+    const int BlockFrames = 2048;
+
+    // frames read from the file at a time
+    const int WindowFrames = 4096;
+}
+
+// State shared by the node and the streams' readers
+struct StreamingAudioNode::Controls
+{
+    float sampleRate = 0;
+
+    // a seek bumps the generation, and blocks read for an older generation are dropped
+    std::atomic<uint32_t> generation {0};
+    std::atomic<double> seekPosition {0};
+
+    std::atomic<bool> loop {false};
+    std::atomic<double> loopStart {0};
+    std::atomic<double> loopEnd {0};
+
+    std::atomic<double> position {0};
+    std::atomic<uint64_t> underruns {0};
+
+    // the most recently set file, for the main thread
+    int channels = 0;
+    float fileSampleRate = 0;
+    double duration = 0;
+};
+
+struct StreamingAudioNode::Stream
+{
+    struct Block
+    {
+        std::vector<std::vector<float>> channels;
+        int frames = 0;
+        uint32_t generation = 0;
+        double position = 0;  // file frame of the first frame
+        double loopStart = 0;
+        double loopEnd = 0;   // the loop the block was read with; equal to loopStart when not looping
+        bool end = false;     // the file ended in this block
+    };
+
+    PCMFileReader reader;
+    std::shared_ptr<Controls> controls;
+    int channels = 0;
+    double step = 1;  // file frames per rendered frame
+
+    std::vector<Block> blocks;
+    RingBufferT<int> filled;  // written by the reader, read by the render thread
+    RingBufferT<int> free;    // written by the render thread, read by the reader
+
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerWake;
+    std::atomic<bool> quit {false};
+
+    // render thread
+    int current = -1;
+    int offset = 0;
+    uint32_t renderGeneration = ~0u;
+    bool ended = false;
+
+    // reader thread
+    uint32_t readGeneration = ~0u;
+    double readPosition = 0;
+    bool atEnd = false;
+    std::vector<std::vector<float>> window;
+    std::vector<float *> windowPlanes;
+    uint64_t windowStart = 0;
+    int windowLength = 0;
+    std::vector<float> frame0;
+    std::vector<float> frame1;
+
+    explicit Stream(std::shared_ptr<Controls> controls)
+        : controls(controls)
+    {
+    }
+
+    ~Stream()
+    {
+        if (worker.joinable())
+        {
+            quit.store(true, std::memory_order_release);
+            wakeWorker();
+            worker.join();
+        }
+    }
+
+    void start(double prefetchSeconds)
+    {
+        channels = reader.channelCount();
+        step = reader.sampleRate() / controls->sampleRate;
+
+        const int count = std::max(2, static_cast<int>(std::ceil(prefetchSeconds * controls->sampleRate / BlockFrames)) + 1);
+        blocks.resize(count);
+        for (Block & block : blocks)
+            block.channels.assign(channels, std::vector<float>(BlockFrames));
+        filled.resize(count);
+        free.resize(count);
+        for (int i = 0; i < count; ++i)
+            free.write(&i, 1);
+
+        window.assign(channels, std::vector<float>(WindowFrames));
+        for (auto & plane : window)
+            windowPlanes.push_back(plane.data());
+        frame0.resize(channels);
+        frame1.resize(channels);
+
+        worker = std::thread(&Stream::workerEntry, this);
+    }
+
+    void wakeWorker()
+    {
+        if (workerMutex.try_lock())
+        {
+            workerWake.notify_one();
+            workerMutex.unlock();
+        }
+    }
+
+    void workerEntry()
+    {
+        DenormalDisabler denormalDisabler;
+        while (!quit.load(std::memory_order_acquire))
+        {
+            const uint32_t generation = controls->generation.load(std::memory_order_acquire);
+            if (generation != readGeneration)
+            {
+                readGeneration = generation;
+                readPosition = std::max(0.0, controls->seekPosition.load() * reader.sampleRate());
+                atEnd = false;
+            }
+
+            int index;
+            if (!atEnd && free.getAvailableRead() && free.read(&index, 1))
+            {
+                readBlock(blocks[index]);
+                filled.write(&index, 1);
+                continue;
+            }
+
+            // as with the convolver's worker, a missed wake up is bounded by the timeout
+            std::unique_lock<std::mutex> lock(workerMutex);
+            workerWake.wait_for(lock, std::chrono::milliseconds(5));
+        }
+    }
+
+    // Copies file frame i into frame, reading a window of the file if it isn't loaded
+    void fetch(uint64_t i, std::vector<float> & frame)
+    {
+        if (i < windowStart || i >= windowStart + windowLength)
+        {
+            windowStart = i;
+            windowLength = reader.read(i, WindowFrames, windowPlanes.data());
+        }
+        if (i >= windowStart + windowLength)
+        {
+            std::fill(frame.begin(), frame.end(), 0.f);
+            return;
+        }
+        for (int c = 0; c < channels; ++c)
+            frame[c] = window[c][i - windowStart];
+    }
+
+    void readBlock(Block & block)
+    {
+        const double length = static_cast<double>(reader.lengthInFrames());
+        const double rate = reader.sampleRate();
+        double loopStart = std::min(length, std::max(0.0, controls->loopStart.load() * rate));
+        double loopEnd = controls->loopEnd.load() > 0 ? std::min(length, controls->loopEnd.load() * rate) : length;
+        if (!controls->loop.load() || loopEnd <= loopStart)
+            loopEnd = loopStart;
+        const bool looping = loopEnd > loopStart;
+
+        block.generation = readGeneration;
+        block.loopStart = loopStart;
+        block.loopEnd = loopEnd;
+        block.end = false;
+
+        int n = 0;
+        for (; n < BlockFrames; ++n)
+        {
+            if (looping && readPosition >= loopEnd)
+                readPosition = loopStart + std::fmod(readPosition - loopStart, loopEnd - loopStart);
+            if (!looping && readPosition >= length)
+            {
+                block.end = true;
+                atEnd = true;
+                break;
+            }
+            if (!n)
+                block.position = readPosition;
+
+            // frames between samples are interpolated linearly, across the loop when looping
+            const uint64_t i0 = static_cast<uint64_t>(readPosition);
+            const float fraction = static_cast<float>(readPosition - i0);
+            fetch(i0, frame0);
+            if (fraction > 0)
+            {
+                uint64_t i1 = i0 + 1;
+                if (looping && i1 >= loopEnd)
+                    i1 = static_cast<uint64_t>(loopStart);
+                fetch(i1, frame1);
+                for (int c = 0; c < channels; ++c)
+                    block.channels[c][n] = frame0[c] + fraction * (frame1[c] - frame0[c]);
+            }
+            else
+            {
+                for (int c = 0; c < channels; ++c)
+                    block.channels[c][n] = frame0[c];
+            }
+
+            readPosition += step;
+        }
+        block.frames = n;
+    }
+
+    void release()
+    {
+        free.write(&current, 1);
+        current = -1;
+        wakeWorker();
+    }
+};
+
+/////////////////////////////////
+// Public StreamingAudioNode   //
+/////////////////////////////////
+
+AudioNodeDescriptor * StreamingAudioNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, nullptr, 1};
+    return &d;
+}
+
+StreamingAudioNode::StreamingAudioNode(AudioContext & ac)
+    : AudioScheduledSourceNode(ac, *desc())
+    , m_controls(std::make_shared<Controls>())
+{
+    m_controls->sampleRate = ac.sampleRate();
+    initialize();
+}
+
+StreamingAudioNode::~StreamingAudioNode()
+{
+    uninitialize();
+}
+
+bool StreamingAudioNode::setFile(const std::string & path, double prefetchSeconds)
+{
+    std::unique_ptr<Stream> stream(new Stream(m_controls));
+    if (!stream->reader.open(path))
+        return false;
+
+    // the new stream starts from the beginning of its file
+    m_controls->seekPosition.store(0);
+    m_controls->generation.fetch_add(1, std::memory_order_acq_rel);
+    stream->start(prefetchSeconds);
+
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_controls->channels = stream->reader.channelCount();
+    m_controls->fileSampleRate = stream->reader.sampleRate();
+    m_controls->duration = stream->reader.lengthInFrames() / static_cast<double>(stream->reader.sampleRate());
+    m_retired.reset();
+    m_pending = std::move(stream);
+    return true;
+}
+
+int StreamingAudioNode::channelCount() const
+{
+    return m_controls->channels;
+}
+
+float StreamingAudioNode::fileSampleRate() const
+{
+    return m_controls->fileSampleRate;
+}
+
+double StreamingAudioNode::duration() const
+{
+    return m_controls->duration;
+}
+
+void StreamingAudioNode::seek(double seconds)
+{
+    m_controls->seekPosition.store(std::max(0.0, seconds));
+    m_controls->generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+double StreamingAudioNode::position() const
+{
+    return m_controls->position.load();
+}
+
+void StreamingAudioNode::setLoop(bool loop)
+{
+    m_controls->loop.store(loop);
+}
+
+void StreamingAudioNode::setLoopPoints(double loopStart, double loopEnd)
+{
+    m_controls->loopStart.store(loopStart);
+    m_controls->loopEnd.store(loopEnd);
+}
+
+bool StreamingAudioNode::loop() const
+{
+    return m_controls->loop.load();
+}
+
+uint64_t StreamingAudioNode::underruns() const
+{
+    return m_controls->underruns.load();
+}
+
+void StreamingAudioNode::process(ContextRenderLock & r, int bufferSize)
+{
+    // pick up a new stream, if the main thread isn't in the middle of setting one
+    std::unique_lock<std::mutex> lock(m_streamMutex, std::try_to_lock);
+    if (lock.owns_lock() && m_pending)
+    {
+        m_retired = std::move(m_active);
+        m_active = std::move(m_pending);
+    }
+    if (lock.owns_lock())
+        lock.unlock();
+
+    AudioBus * outputBus = output(0)->bus(r);
+    if (!isInitialized() || !m_active)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    Stream & stream = *m_active;
+    if (outputBus->numberOfChannels() != stream.channels)
+    {
+        output(0)->setNumberOfChannels(r, stream.channels);
+        outputBus = output(0)->bus(r);
+    }
+
+    outputBus->zero();
+    const int quantumFrameOffset = _self->_scheduler._renderOffset;
+    const int nonSilentFramesToProcess = _self->_scheduler._renderLength;
+    if (!nonSilentFramesToProcess)
+        return;
+
+    uint32_t generation = m_controls->generation.load(std::memory_order_acquire);
+    if (generation != stream.renderGeneration)
+    {
+        stream.renderGeneration = generation;
+        stream.ended = false;
+    }
+
+    bool underrun = false;
+    bool ended = false;
+    int written = 0;
+    while (written < nonSilentFramesToProcess && !stream.ended)
+    {
+        if (stream.current < 0)
+        {
+            if (!stream.filled.read(&stream.current, 1))
+            {
+                stream.current = -1;
+                underrun = true;
+                break;
+            }
+            stream.offset = 0;
+        }
+
+        Stream::Block & block = stream.blocks[stream.current];
+        if (block.generation != generation)
+        {
+            // the block was read before a seek, or after one made during this quantum
+            generation = m_controls->generation.load(std::memory_order_acquire);
+            if (block.generation != generation)
+            {
+                stream.release();
+                continue;
+            }
+            stream.renderGeneration = generation;
+        }
+
+        const int count = std::min(nonSilentFramesToProcess - written, block.frames - stream.offset);
+        for (int c = 0; c < stream.channels; ++c)
+        {
+            float * destination = outputBus->channel(c)->mutableData() + quantumFrameOffset + written;
+            memcpy(destination, block.channels[c].data() + stream.offset, sizeof(float) * count);
+        }
+
+        if (count)
+        {
+            double position = block.position + (stream.offset + count - 1) * stream.step;
+            if (block.loopEnd > block.loopStart && position >= block.loopEnd)
+                position = block.loopStart + std::fmod(position - block.loopStart, block.loopEnd - block.loopStart);
+            m_controls->position.store(position / stream.reader.sampleRate(), std::memory_order_relaxed);
+        }
+
+        stream.offset += count;
+        written += count;
+        if (stream.offset == block.frames)
+        {
+            const bool end = block.end;
+            stream.release();
+            if (end)
+            {
+                stream.ended = true;
+                ended = true;
+            }
+        }
+    }
+
+    if (underrun)
+        m_controls->underruns.fetch_add(1, std::memory_order_relaxed);
+    if (ended)
+        _self->_scheduler.finish(r, *this);
+}
+
+void StreamingAudioNode::reset(ContextRenderLock &)
+{
+}
+
+bool StreamingAudioNode::propagatesSilence(ContextRenderLock & r) const
+{
+    return !isPlayingOrScheduled() || hasFinished();
+}
+
+}  // namespace lab
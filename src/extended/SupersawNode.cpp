@@ -2,19 +2,28 @@
 // SPDX-License-Identifier: BSD-2-Clause
 // Copyright (C) 2015, The LabSound Authors. All rights reserved.
 
+#include "LabSound/core/AudioArray.h"
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSetting.h"
-#include "LabSound/core/GainNode.h"
-#include "LabSound/core/OscillatorNode.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/SupersawNode.h"
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/VectorMath.h"
 
+#include <algorithm>
 #include <cfloat>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
 
 using namespace lab;
 
@@ -36,102 +45,162 @@ AudioNodeDescriptor * SupersawNode::desc()
     return &d;
 }
 
+// The saws are lanes of one oscillator bank rather than separate nodes, so that their cost
+// is a few vector operations a frame. Each lane is a PolyBLEP sawtooth, matching the band
+// limiting of PolyBLEPNode, detuned evenly across the detune range.
 class SupersawNode::SupersawNodeInternal
 {
 public:
-    SupersawNodeInternal(AudioContext & ac)
-        : cachedDetune(FLT_MAX)
-        , cachedFrequency(FLT_MAX)
+    // Lanes are allocated up front; sawCount is clamped to this
+    static constexpr int MaxSaws = 64;
+
+    SupersawNodeInternal()
+        : phases(MaxSaws)
+        , ratios(MaxSaws, 1.f)
+        , weights(MaxSaws, 0.f)
+        , frequencies(AudioNode::ProcessingSizeInFrames)
     {
-        gainNode = std::make_shared<GainNode>(ac);
+        // spread the starting phases so the saws don't start out in step
+        for (int i = 0; i < MaxSaws; ++i)
+            phases[i] = static_cast<float>(std::fmod(i * 0.6180339887, 1.0));
     }
 
     ~SupersawNodeInternal() = default;
 
+    int laneCount() const
+    {
+        return std::max(1, std::min(MaxSaws, static_cast<int>(sawCount->valueUint32())));
+    }
+
+    // recomputes the lanes' detune ratios and mix weights if the count or detune changed
     void update(ContextRenderLock & r)
     {
-        /// @fixme these values should be per sample, not per quantum
-        /// -or- they should be settings if they don't vary per sample
-        if (cachedFrequency != frequency->value())
+        detune->smooth(r);
+        const float currentDetune = detune->smoothedValue();
+        const int n = laneCount();
+        if (n == cachedCount && currentDetune == cachedDetune)
+            return;
+
+        cachedCount = n;
+        cachedDetune = currentDetune;
+        const float step = n > 1 ? 2.f * currentDetune / float(n - 1) : 0.f;
+        for (int i = 0; i < MaxSaws; ++i)
         {
-            cachedFrequency = frequency->value();
-            for (auto i : saws)
-            {
-                i->frequency()->setValue(cachedFrequency);
-                i->frequency()->resetSmoothedValue();
-            }
+            const float cents = n > 1 ? -currentDetune + float(i) * step : 0.f;
+            ratios[i] = i < n ? std::pow(2.f, cents / 1200.f) : 0.f;
+            weights[i] = i < n ? 1.f / float(n) : 0.f;
         }
+    }
 
-        /// @fixme these values should be per sample, not per quantum
-        /// -or- they should be settings if they don't vary per sample
-        if (cachedDetune != detune->value())
+    // frequencies are in cycles per frame
+    void render(const float * frequencies, float * destination, int count)
+    {
+        const int groups = (cachedCount + 3) / 4;
+        float * phase = phases.data();
+        const float * ratio = ratios.data();
+        const float * weight = weights.data();
+
+#if defined(__SSE2__)
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 two = _mm_set1_ps(2.f);
+        for (int f = 0; f < count; ++f)
         {
-            cachedDetune = detune->value();
-            float n = cachedDetune / ((float) saws.size() - 1.0f);
-            for (size_t i = 0; i < saws.size(); ++i)
+            const __m128 increment = _mm_set1_ps(frequencies[f]);
+            __m128 sum = _mm_setzero_ps();
+            for (int g = 0; g < groups; ++g)
             {
-                saws[i]->detune()->setValue(-cachedDetune + float(i) * 2 * n);
-                saws[i]->detune()->resetSmoothedValue();
+                __m128 t = _mm_loadu_ps(phase + g * 4);
+                const __m128 dt = _mm_mul_ps(increment, _mm_loadu_ps(ratio + g * 4));
+                const __m128 rdt = _mm_div_ps(one, _mm_max_ps(dt, _mm_set1_ps(1e-9f)));
+
+                // the residual is -(t/dt - 1)^2 after a wrap, and ((t - 1)/dt + 1)^2 before one
+                const __m128 a = _mm_sub_ps(_mm_mul_ps(t, rdt), one);
+                const __m128 b = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(t, one), rdt), one);
+                const __m128 afterWrap = _mm_and_ps(_mm_cmplt_ps(t, dt), _mm_mul_ps(a, a));
+                const __m128 beforeWrap = _mm_and_ps(_mm_cmpgt_ps(t, _mm_sub_ps(one, dt)), _mm_mul_ps(b, b));
+                const __m128 saw = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(two, t), one), afterWrap), beforeWrap);
+                sum = _mm_add_ps(sum, _mm_mul_ps(saw, _mm_loadu_ps(weight + g * 4)));
+
+                t = _mm_add_ps(t, dt);
+                t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpge_ps(t, one), one));
+                _mm_storeu_ps(phase + g * 4, t);
             }
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            destination[f] = _mm_cvtss_f32(sum);
         }
-    }
-
-    void update(ContextRenderLock & r, bool okayToReallocate)
-    {
-        size_t currentN = saws.size();
-        int n = int(sawCount->valueUint32() + 0.5f);
-
-        auto context = r.context();
-
-        if (okayToReallocate && (n != currentN))
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t one = vdupq_n_f32(1.f);
+        for (int f = 0; f < count; ++f)
         {
-            sampleRate = r.context()->sampleRate();
-
-            // This implementation is similar to the technique illustrated here
-            // https://noisehack.com/how-to-build-supersaw-synth-web-audio-api/
-            //
-            for (auto i : sawStorage)
+            const float32x4_t increment = vdupq_n_f32(frequencies[f]);
+            float32x4_t sum = vdupq_n_f32(0.f);
+            for (int g = 0; g < groups; ++g)
             {
-                context->disconnect(i, nullptr);
+                float32x4_t t = vld1q_f32(phase + g * 4);
+                const float32x4_t dt = vmulq_f32(increment, vld1q_f32(ratio + g * 4));
+                float32x4_t rdt = vrecpeq_f32(vmaxq_f32(dt, vdupq_n_f32(1e-9f)));
+                rdt = vmulq_f32(vrecpsq_f32(dt, rdt), rdt);
+                rdt = vmulq_f32(vrecpsq_f32(dt, rdt), rdt);
+
+                const float32x4_t a = vsubq_f32(vmulq_f32(t, rdt), one);
+                const float32x4_t b = vaddq_f32(vmulq_f32(vsubq_f32(t, one), rdt), one);
+                const float32x4_t afterWrap = vreinterpretq_f32_u32(vandq_u32(vcltq_f32(t, dt), vreinterpretq_u32_f32(vmulq_f32(a, a))));
+                const float32x4_t beforeWrap = vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, vsubq_f32(one, dt)), vreinterpretq_u32_f32(vmulq_f32(b, b))));
+                const float32x4_t saw = vsubq_f32(vaddq_f32(vsubq_f32(vaddq_f32(t, t), one), afterWrap), beforeWrap);
+                sum = vmlaq_f32(sum, saw, vld1q_f32(weight + g * 4));
+
+                t = vaddq_f32(t, dt);
+                t = vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgeq_f32(t, one), vreinterpretq_u32_f32(one))));
+                vst1q_f32(phase + g * 4, t);
             }
-
-            sawStorage.clear();
-            saws.clear();
-
-            for (int i = 0; i < n; ++i)
-                sawStorage.emplace_back(std::make_shared<OscillatorNode>(*context));
-
-            for (int i = 0; i < n; ++i)
-                saws.push_back(sawStorage[i].get());
-
-            for (auto i : sawStorage)
+            const float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+            destination[f] = vget_lane_f32(vpadd_f32(pair, pair), 0);
+        }
+#else
+        const int lanes = groups * 4;
+        for (int f = 0; f < count; ++f)
+        {
+            float sum = 0.f;
+            for (int i = 0; i < lanes; ++i)
             {
-                i->setType(OscillatorType::SAWTOOTH);
-                context->connect(gainNode, i, 0, 0);
-                i->start(0);
+                float t = phase[i];
+                const float dt = frequencies[f] * ratio[i];
+                float saw = 2.f * t - 1.f;
+                if (t < dt)
+                {
+                    const float a = t / dt - 1.f;
+                    saw += a * a;
+                }
+                else if (t > 1.f - dt)
+                {
+                    const float b = (t - 1.f) / dt + 1.f;
+                    saw -= b * b;
+                }
+                sum += saw * weight[i];
+
+                t += dt;
+                if (t >= 1.f) t -= 1.f;
+                phase[i] = t;
             }
-
-            gainNode->gain()->setValue(1.f / float(n));
-
-            cachedFrequency = FLT_MAX;
-            cachedDetune = FLT_MAX;
+            destination[f] = sum;
         }
-
-        update(r);
+#endif
     }
 
-    std::shared_ptr<GainNode> gainNode;
     std::shared_ptr<AudioParam> detune;
     std::shared_ptr<AudioParam> frequency;
     std::shared_ptr<AudioSetting> sawCount;
 
+    AudioFloatArray frequencies;
+
 private:
-    float sampleRate;
-    float cachedDetune;
-    float cachedFrequency;
+    float cachedDetune = FLT_MAX;
+    int cachedCount = 0;
 
-    std::vector<std::shared_ptr<OscillatorNode>> sawStorage;
-    std::vector<OscillatorNode *> saws;
+    std::vector<float> phases;   // per lane, in cycles
+    std::vector<float> ratios;   // per lane detune, as a frequency ratio; zero for unused lanes
+    std::vector<float> weights;  // per lane mix weight; zero for unused lanes
 };
 
 //////////////////////////
@@ -141,7 +210,7 @@ private:
 SupersawNode::SupersawNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
 {
-    internalNode.reset(new SupersawNodeInternal(ac));
+    internalNode.reset(new SupersawNodeInternal());
     internalNode->sawCount = setting("sawCount");
     internalNode->sawCount->setUint32(1);
     internalNode->detune = param("detune");
@@ -156,28 +225,49 @@ SupersawNode::~SupersawNode()
 
 void SupersawNode::process(ContextRenderLock & r, int bufferSize)
 {
-    internalNode->update(r, true);
-
     AudioBus * outputBus = output(0)->bus(r);
 
-    if (!isInitialized() || !outputBus->numberOfChannels())
+    const int offset = _self->_scheduler._renderOffset;
+    const int count = _self->_scheduler._renderLength;
+
+    if (!r.context() || !isInitialized() || !outputBus->numberOfChannels() || !count)
     {
         outputBus->zero();
         return;
     }
 
-    AudioBus * dst = nullptr;
-    internalNode->gainNode->input(0)->bus(r)->zero();
-    /*AudioBus * renderedBus =*/ internalNode->gainNode->input(0)->pull(r, dst, bufferSize);
-    internalNode->gainNode->process(r, bufferSize);
-    AudioBus * inputBus = internalNode->gainNode->output(0)->bus(r);
-    outputBus->copyFrom(*inputBus);
+    internalNode->update(r);
+
+    AudioFloatArray & frequencies = internalNode->frequencies;
+    if (bufferSize > frequencies.size())
+        frequencies.allocate(bufferSize);
+
+    float * values = frequencies.data();
+    if (internalNode->frequency->hasSampleAccurateValues())
+    {
+        internalNode->frequency->calculateSampleAccurateValues(r, values, bufferSize);
+    }
+    else
+    {
+        internalNode->frequency->smooth(r);
+        const float frequency = internalNode->frequency->smoothedValue();
+        for (int i = 0; i < bufferSize; ++i)
+            values[i] = frequency;
+    }
+
+    // convert to cycles per frame, up to Nyquist
+    const float k = 1.f / r.context()->sampleRate();
+    for (int i = offset; i < offset + count; ++i)
+        values[i] = std::min(0.5f, std::max(0.f, values[i] * k));
+
+    outputBus->zero();
+    internalNode->render(values + offset, outputBus->channel(0)->mutableData() + offset, count);
     outputBus->clearSilentFlag();
 }
 
 void SupersawNode::update(ContextRenderLock & r)
 {
-    internalNode->update(r, true);
+    internalNode->update(r);
 }
 
 std::shared_ptr<AudioParam> SupersawNode::detune() const
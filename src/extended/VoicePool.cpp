@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/VoicePool.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/core/GainNode.h"
+#include "LabSound/core/SampledAudioNode.h"
+#include "LabSound/extended/PowerMonitorNode.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace lab
+{
+
+VoicePool::VoicePool(AudioContext & ac, int voiceCount, VoiceFactory factory, StealPolicy policy)
+    : m_context(ac)
+    , m_output(std::make_shared<GainNode>(ac))
+    , m_voices(voiceCount > 0 ? voiceCount : 0)
+    , m_policy(policy)
+{
+    if (voiceCount <= 0)
+        throw std::invalid_argument("VoicePool needs at least one voice");
+
+    for (Slot & slot : m_voices)
+    {
+        slot.voice = factory(ac);
+        if (!slot.voice.source || !slot.voice.output)
+            throw std::invalid_argument("VoicePool factory must supply a source and an output");
+
+        slot.ended = std::make_shared<std::atomic<uint64_t>>(0);
+        std::shared_ptr<std::atomic<uint64_t>> ended = slot.ended;
+        slot.voice.source->setOnEnded([ended]() { ++*ended; });
+
+        // the monitor is a sink, pulled alongside the graph, that lets the quietest voice be found
+        ac.connect(m_output, slot.voice.output);
+        slot.monitor = std::make_shared<PowerMonitorNode>(ac);
+        ac.connect(slot.monitor, slot.voice.output);
+        ac.addAutomaticPullNode(slot.monitor);
+    }
+}
+
+VoicePool::~VoicePool()
+{
+    for (Slot & slot : m_voices)
+    {
+        slot.voice.source->setOnEnded(nullptr);
+        m_context.removeAutomaticPullNode(slot.monitor);
+        m_context.disconnect(slot.monitor, slot.voice.output);
+        m_context.disconnect(m_output, slot.voice.output);
+    }
+}
+
+bool VoicePool::isBusy(int index) const
+{
+    const Slot & slot = m_voices[index];
+    return slot.claimed && slot.ended->load() == slot.endedAtClaim;
+}
+
+int VoicePool::busyCount() const
+{
+    int count = 0;
+    for (int i = 0; i < voiceCount(); ++i)
+        count += isBusy(i) ? 1 : 0;
+    return count;
+}
+
+void VoicePool::release(int index)
+{
+    m_voices[index].claimed = false;
+}
+
+void VoicePool::steal(Slot & slot)
+{
+    if (SampledAudioNode * sampled = dynamic_cast<SampledAudioNode *>(slot.voice.source.get()))
+        sampled->clearSchedules();
+    else
+        slot.voice.source->stop(std::numeric_limits<float>::infinity());
+
+    ++m_steals;
+}
+
+int VoicePool::claim(float priority)
+{
+    int chosen = -1;
+    bool stealing = false;
+
+    // a free voice, preferring the one that has been free the longest
+    for (int i = 0; i < voiceCount(); ++i)
+    {
+        if (!isBusy(i) && (chosen < 0 || m_voices[i].claimSerial < m_voices[chosen].claimSerial))
+            chosen = i;
+    }
+
+    if (chosen < 0)
+    {
+        stealing = true;
+        switch (m_policy)
+        {
+            case StealPolicy::None:
+                break;
+
+            case StealPolicy::Oldest:
+                for (int i = 0; i < voiceCount(); ++i)
+                    if (chosen < 0 || m_voices[i].claimSerial < m_voices[chosen].claimSerial)
+                        chosen = i;
+                break;
+
+            case StealPolicy::Quietest:
+                for (int i = 0; i < voiceCount(); ++i)
+                    if (chosen < 0 || m_voices[i].monitor->db() < m_voices[chosen].monitor->db())
+                        chosen = i;
+                break;
+
+            case StealPolicy::LowestPriority:
+                for (int i = 0; i < voiceCount(); ++i)
+                {
+                    const Slot & slot = m_voices[i];
+                    if (chosen < 0 || slot.priority < m_voices[chosen].priority ||
+                        (slot.priority == m_voices[chosen].priority && slot.claimSerial < m_voices[chosen].claimSerial))
+                        chosen = i;
+                }
+                if (chosen >= 0 && m_voices[chosen].priority >= priority)
+                    chosen = -1;
+                break;
+        }
+    }
+
+    if (chosen < 0)
+        return -1;
+
+    Slot & slot = m_voices[chosen];
+    if (stealing)
+        steal(slot);
+
+    slot.claimed = true;
+    slot.endedAtClaim = slot.ended->load();
+    slot.claimSerial = ++m_serial;
+    slot.priority = priority;
+    return chosen;
+}
+
+}  // lab
@@ -0,0 +1,111 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef Ambisonics_h
+#define Ambisonics_h
+
+#include "LabSound/core/FloatPoint3D.h"
+
+#include "internal/Panner.h"
+
+#include <vector>
+
+namespace lab
+{
+
+class AudioBus;
+
+// LabSound's Ambisonics are AmbiX: the channels are in ACN order, normalized as SN3D, and
+// directions are given with x ahead, y to the left and z up. An order N sound field has
+// (N + 1) * (N + 1) channels.
+const int MaxAmbisonicOrder = 3;
+const int MaxAmbisonicChannels = (MaxAmbisonicOrder + 1) * (MaxAmbisonicOrder + 1);
+
+inline int ambisonicChannelCount(int order) { return (order + 1) * (order + 1); }
+
+// The order of the sound field with channelCount channels, or -1 if there is no such order
+int ambisonicOrderForChannelCount(int channelCount);
+
+// The gains with which a plane wave arriving from the unit direction (x, y, z) is encoded in
+// each channel of an order N sound field
+void ambisonicEncodingCoefficients(int order, double x, double y, double z, double * coefficients);
+
+// The sound field's direction (x, y, z) of the world's direction v, whose listener faces -z with y up
+inline void ambisonicDirectionFromWorld(const FloatPoint3D & v, double & x, double & y, double & z)
+{
+    x = -v.z;
+    y = -v.x;
+    z = v.y;
+}
+
+// The decoding matrix, speakers rows of channels gains, which plays an order N sound field
+// over speakers in the given directions (x, y, z triplets in the sound field's frame).
+// The field is matched at the speakers in the least squares sense, regularized so that
+// layouts with too few speakers for the order still decode, and weighted for the highest
+// energy concentration (max rE), then scaled so that a plane wave from any direction plays
+// with unit energy on average.
+std::vector<double> ambisonicDecodingMatrix(int order, const std::vector<double> & speakerDirections);
+
+// AmbisonicRotation turns a sound field from the world's frame into a listener's.
+// The rotation of each order is block diagonal; it is found once a quantum by encoding a set
+// of directions before and after the rotation, and is ramped across the quantum.
+class AmbisonicRotation
+{
+public:
+    AmbisonicRotation();
+
+    // Sets the rotation to the one heard by a listener facing forward with up above
+    void setListenerOrientation(const FloatPoint3D & forward, const FloatPoint3D & up);
+
+    // Rotates the first channels of source, which holds an order N field, into destination
+    void process(int order, const AudioBus & source, AudioBus & destination, int framesToProcess);
+
+    void reset() { m_isFirstRender = true; }
+
+private:
+    void updateMatrix();
+
+    // the rotation of directions, row major
+    double m_rotation[9];
+    bool m_rotationChanged = true;
+
+    // the block diagonal matrices of orders 1 through MaxAmbisonicOrder, current and previous
+    std::vector<double> m_matrix;
+    std::vector<double> m_lastMatrix;
+    bool m_isFirstRender = true;
+    bool m_isIdentity = true;
+    bool m_wasIdentity = true;
+};
+
+// AmbisonicPanner encodes its input, mixed down to mono, into a sound field of as many channels
+// as the output bus has. Azimuth and elevation are those of PannerNode: clockwise from ahead,
+// and up from the horizon, in degrees.
+class AmbisonicPanner : public Panner
+{
+public:
+    AmbisonicPanner(const float sampleRate);
+
+    virtual void pan(ContextRenderLock & r,
+                     double azimuth, double elevation,
+                     const AudioBus & inputBus, AudioBus & outputBus,
+                     int busOffset,
+                     int framesToProcess) override;
+
+    virtual void reset() override { m_isFirstRender = true; }
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+    // A gain applied with the encoding, from the next pan
+    void setGain(double gain) { m_gain = gain; }
+
+private:
+    // For de-zippering, the coefficients are ramped over a quantum
+    bool m_isFirstRender = true;
+    double m_gain = 1.0;
+    double m_coefficients[MaxAmbisonicChannels];
+};
+
+}  // namespace lab
+
+#endif
@@ -8,46 +8,126 @@
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/AudioProcessor.h"
 
-#include "internal/AudioDSPKernel.h"
+#include "internal/Assertions.h"
 
+#include <memory>
 #include <vector>
 
 namespace lab
 {
 
-class AudioBus;
-class AudioProcessor;
+class ContextRenderLock;
 
 // AudioDSPKernelProcessor processes one input -> one output (N channels each)
-// It uses one AudioDSPKernel object per channel to do the processing, thus there is no cross-channel processing.
+// It uses one Kernel object per channel to do the processing, thus there is no cross-channel processing.
 // Despite this limitation it turns out to be a very common and useful type of processor.
-
+//
+// The kernel's type is known here, so the kernels are called directly rather than through
+// a virtual function per channel, and the parameters they share are evaluated once a
+// quantum by the processor rather than read by every kernel. Mono and stereo busses are
+// processed by loops specialized for their channel count. A Kernel provides
+//
+//     struct Params;
+//     void process(const Params &, const float * source, float * destination, int framesToProcess);
+//     void reset();
+//     double tailTime(ContextRenderLock &) const;
+//     double latencyTime(ContextRenderLock &) const;
+template <typename Kernel>
 class AudioDSPKernelProcessor : public AudioProcessor
 {
 public:
-    // numberOfChannels may be later changed if object is not yet in an "initialized" state
-    AudioDSPKernelProcessor();
-    virtual ~AudioDSPKernelProcessor()
+    using Params = typename Kernel::Params;
+
+    AudioDSPKernelProcessor() = default;
+    virtual ~AudioDSPKernelProcessor() {}
+
+    // Subclasses create a kernel for each channel here
+    virtual std::unique_ptr<Kernel> createKernel() = 0;
+
+    // and evaluate the kernels' parameters for a quantum here
+    virtual Params kernelParams(ContextRenderLock &) = 0;
+
+    // AudioProcessor methods
+    virtual void initialize() override
+    {
+        m_initialized = true;
+    }
+
+    virtual void uninitialize() override
     {
-        if (isInitialized()) uninitialize();
+        if (!isInitialized())
+            return;
+
+        m_kernels.clear();
+        m_initialized = false;
     }
 
-    // Subclasses create the appropriate type of processing kernel here.
-    // We'll call this to create a kernel for each channel.
-    virtual AudioDSPKernel * createKernel() = 0;
+    virtual void process(ContextRenderLock & r, const AudioBus * source, AudioBus * destination, int framesToProcess) override
+    {
+        ASSERT(source && destination);
+        if (!source || !destination)
+            return;
 
-    // AudioProcessor methods
-    virtual void initialize() override;
-    virtual void uninitialize() override;
-    virtual void process(ContextRenderLock &, const AudioBus * source, AudioBus * destination, int framesToProcess) override;
-    virtual void reset() override;
+        if (!isInitialized())
+        {
+            destination->zero();
+            return;
+        }
+
+        const int channels = destination->numberOfChannels();
+        if (m_kernels.size() != static_cast<size_t>(channels))
+        {
+            m_kernels.clear();
+            for (int i = 0; i < channels; ++i)
+                m_kernels.push_back(createKernel());
+        }
+
+        bool channelCountMatches = source->numberOfChannels() == channels;
+        ASSERT(channelCountMatches);
+        if (!channelCountMatches)
+            return;
 
-    virtual double tailTime(ContextRenderLock & r) const override;
-    virtual double latencyTime(ContextRenderLock & r) const override;
+        const Params params = kernelParams(r);
+        switch (channels)
+        {
+            case 1: processChannels<1>(params, source, destination, channels, framesToProcess); break;
+            case 2: processChannels<2>(params, source, destination, channels, framesToProcess); break;
+            default: processChannels<0>(params, source, destination, channels, framesToProcess); break;
+        }
+    }
+
+    // Resets filter state
+    virtual void reset() override
+    {
+        if (!isInitialized())
+            return;
+
+        for (auto & kernel : m_kernels)
+            kernel->reset();
+    }
+
+    // It is expected that all the kernels have the same tail and latency times.
+    virtual double tailTime(ContextRenderLock & r) const override
+    {
+        return !m_kernels.empty() ? m_kernels.front()->tailTime(r) : 0;
+    }
+
+    virtual double latencyTime(ContextRenderLock & r) const override
+    {
+        return !m_kernels.empty() ? m_kernels.front()->latencyTime(r) : 0;
+    }
 
 protected:
-    std::vector<std::unique_ptr<AudioDSPKernel>> m_kernels;
-    bool m_hasJustReset;
+    // Channels is the channel count, or zero if it is only known at run time
+    template <int Channels>
+    void processChannels(const Params & params, const AudioBus * source, AudioBus * destination, int channels, int framesToProcess)
+    {
+        const int count = Channels ? Channels : channels;
+        for (int i = 0; i < count; ++i)
+            m_kernels[i]->process(params, source->channel(i)->data(), destination->channel(i)->mutableData(), framesToProcess);
+    }
+
+    std::vector<std::unique_ptr<Kernel>> m_kernels;
 };
 
 }  // namespace lab
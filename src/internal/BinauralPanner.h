@@ -0,0 +1,48 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef BinauralPanner_h
+#define BinauralPanner_h
+
+#include "internal/Panner.h"
+
+namespace lab
+{
+
+// An inexpensive binaural panner, for sources that don't warrant HRTF convolution. The
+// source is mixed to mono and panned with equal power gains, and the ear turned away
+// from it hears it later, by the interaural time difference of a spherical head, and
+// muffled, by a one pole low pass standing in for the head's shadow. Elevation is not
+// rendered. It costs a few operations a frame, against two convolutions for HRTF.
+class BinauralPanner : public Panner
+{
+public:
+    BinauralPanner(const float sampleRate);
+
+    virtual void pan(ContextRenderLock & r,
+                     double azimuth, double elevation,
+                     const AudioBus & inputBus, AudioBus & outputBus,
+                     int busOffset,
+                     int framesToProcess) override;
+
+    virtual void reset() override;
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+private:
+    enum { HistorySize = 128 };  // a power of two above the longest delay at 192 kHz
+
+    float m_history[HistorySize];
+    int m_writeIndex = 0;
+
+    bool m_isFirstRender = true;
+    double m_gainL = 0, m_gainR = 0;
+    double m_delayL = 0, m_delayR = 0;
+    double m_shadowL = 0, m_shadowR = 0;  // the low pass coefficients
+    float m_lowpassL = 0, m_lowpassR = 0;  // and states
+};
+
+}  // namespace lab
+
+#endif  // BinauralPanner_h
@@ -48,6 +48,16 @@ public:
     // Resets filter state
     void reset();
 
+    // The normalized coefficients, for filters such as BiquadBank that run the design elsewhere
+    void getCoefficients(double & b0, double & b1, double & b2, double & a1, double & a2) const
+    {
+        b0 = m_b0;
+        b1 = m_b1;
+        b2 = m_b2;
+        a1 = m_a1;
+        a2 = m_a2;
+    }
+
     // Filter response at a set of n frequencies. The magnitude and
     // phase response are returned in magResponse and phaseResponse.
     // The phase response is in radians.
@@ -0,0 +1,59 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef BiquadBank_h
+#define BiquadBank_h
+
+#include <vector>
+
+namespace lab
+{
+
+class Biquad;
+
+// BiquadBank filters any number of channels through the same cascade of biquad sections.
+// The channels are interleaved in groups, so that each lane of a SIMD register carries a
+// channel and a group's channels are filtered at once: four or eight at a time where AVX2 or
+// AVX-512 is available, otherwise two. The sections are in transposed direct form II, in
+// double precision as a Biquad is.
+class BiquadBank
+{
+public:
+    BiquadBank();
+    ~BiquadBank();
+
+    // Sets the number of sections, which start as pass-throughs, and resets the filter state
+    void setNumberOfSections(int sections);
+    int numberOfSections() const { return static_cast<int>(m_coefficients.size() / 5); }
+
+    // Copies the coefficients of a section from a designed Biquad
+    void setSection(int section, const Biquad & design);
+    void setSectionCoefficients(int section, double b0, double b1, double b2, double a1, double a2);
+
+    // sources and destinations may be the same channels
+    void process(const float * const * sources, float * const * destinations, int channels, int framesToProcess);
+
+    // As process, but the coefficients move linearly, frame by frame, from the current ones
+    // to the targets, five for each section, which are current afterwards. The lanes are
+    // run without the wide kernels, so this is for blocks in which the filter is modulated.
+    void processRamped(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+                       const double * targetCoefficients);
+
+    // Resets filter state
+    void reset();
+
+private:
+    void run(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+             const double * targetCoefficients);
+
+    std::vector<double> m_coefficients;  // five for each section
+    std::vector<double> m_state;         // for each group, section, and state, a lane for each channel
+    std::vector<double> m_interleaved;   // a group's channels, frame by frame
+    void (*m_kernel)(double * data, int frames, const double * coefficients, double * state, int sections);
+    int m_lanes;
+    int m_groups = 0;
+};
+
+}  // namespace lab
+
+#endif  // BiquadBank_h
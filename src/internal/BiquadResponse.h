@@ -0,0 +1,57 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef BiquadResponse_h
+#define BiquadResponse_h
+
+#include <vector>
+
+namespace lab
+{
+
+// BiquadResponse evaluates the magnitude and phase response of a cascade of biquad sections
+// at many frequencies, four frequencies at a time, for drawing equalizer curves. The
+// trigonometry of the frequencies is kept while they stay the same, and the response is
+// kept while the sections' coefficients do too, so that redrawing an unchanged curve costs
+// a comparison.
+//
+// The magnitude is found from the sections' coefficient sums in the sin^2(w/2) form, which
+// stays accurate in single precision for filters far below Nyquist, where evaluating the
+// transfer function directly would cancel.
+class BiquadResponse
+{
+public:
+    // The frequencies, 0 - 1 normalized to Nyquist, as for a Biquad
+    void setFrequencies(const float * frequency, int count);
+
+    // Five coefficients for each section, b0 b1 b2 a1 a2 normalized, as a BiquadBank takes
+    // them. Returns false if the response was already evaluated for them.
+    bool evaluate(const double * coefficients, int sections);
+
+    int size() const { return m_count; }
+    const float * magnitude() const { return m_magnitude.data(); }
+    const float * phase() const { return m_phase.data(); }  // in radians
+
+private:
+    int m_count = 0;
+    std::vector<float> m_frequencies;
+
+    // for each frequency, padded to a multiple of four
+    std::vector<float> m_phi;  // sin^2(w/2)
+    std::vector<float> m_cos1;
+    std::vector<float> m_sin1;
+    std::vector<float> m_cos2;
+    std::vector<float> m_sin2;
+    std::vector<float> m_power;
+    std::vector<float> m_real;
+    std::vector<float> m_imag;
+
+    std::vector<double> m_coefficients;  // of the cascade last evaluated
+    bool m_valid = false;
+    std::vector<float> m_magnitude;
+    std::vector<float> m_phase;
+};
+
+}  // namespace lab
+
+#endif  // BiquadResponse_h
@@ -0,0 +1,108 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef CaptureWriter_h
+#define CaptureWriter_h
+
+#include "LabSound/core/ConcurrentQueue.h"
+#include "LabSound/core/MemoryAccounting.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+class RecordingFile;
+
+// CaptureWriter carries audio captured on the render thread to a writer thread, which writes
+// it into memory or to a file. The render thread copies each quantum, interleaved, into a
+// block that is pushed whole into a lock-free ring holding a few seconds of audio; it never
+// locks or waits, unless it renders offline, and drops whole quanta, counting them, if the
+// writer falls that far behind. The writer wakes periodically to drain the ring, or sooner
+// once the render thread finds it half full.
+//
+// Each recording is a session, and each block carries the session it was captured for, so
+// that a block the render thread captured as a session ended is discarded rather than
+// written into the next.
+class CaptureWriter
+{
+public:
+    // The ring and the render thread's block are sized for channels
+    CaptureWriter(float sampleRate, int channels);
+    ~CaptureWriter();
+
+    // Main thread. A session begun ends the current one, and returns the tag the render
+    // thread captures it with. A file takes the channels of the first block written to it,
+    // and blocks of other channel counts are matched to those.
+    uint32_t beginToMemory();
+    uint32_t beginToFile(std::unique_ptr<RecordingFile> file);
+
+    // Returns once the session's blocks already in the ring are written, and its file closed
+    void end(uint32_t session);
+
+    // The recording made in memory, non-interleaved, taken or measured after the blocks
+    // already in the ring are added to it
+    std::vector<std::vector<float>> takeRecording();
+    size_t recordedFrames();
+
+    // Any thread; the writer clears the recording in memory before it next adds to it
+    void clearRecording() { m_clearRequested.store(true); }
+
+    uint64_t droppedFrames() const { return m_dropped.load(); }
+
+    // Render thread. beginBlock returns space for frames of channels, interleaved, which
+    // commitBlock pushes into the ring tagged with session.
+    float * beginBlock(int channels, int frames);
+    void commitBlock(uint32_t session, bool offline);
+
+private:
+    void workerEntry();
+    void wakeWorker();
+    void flush(std::unique_lock<std::mutex> & lock);
+    uint32_t begin(std::unique_lock<std::mutex> & lock, std::unique_ptr<RecordingFile> file);
+    void end(std::unique_lock<std::mutex> & lock, uint32_t session);
+    void drain();
+    void writeToFile(int channels, int frames);
+    void writeToMemory(int channels, int frames);
+
+    RingBufferT<float> m_ring;
+    std::atomic<uint64_t> m_dropped {0};
+    std::atomic<bool> m_clearRequested {false};
+
+    // render thread
+    std::vector<float> m_renderBlock;
+    int m_renderChannels = 0;
+    int m_renderFrames = 0;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_drained;
+
+    // guarded by the mutex
+    bool m_quit = false;
+    uint64_t m_passes = 0;
+    uint32_t m_nextSession = 0;
+    uint32_t m_activeSession = 0;
+    std::unique_ptr<RecordingFile> m_file;  // null when recording into memory
+    uint64_t m_headerFrames = 0;
+    uint64_t m_headerPeriod = 0;
+    std::vector<std::vector<float>> m_data;
+    std::vector<float> m_block;
+    std::vector<float> m_remapped;
+
+    // the ring, blocks and recording are charged to the owner scoped as the writer was made
+    std::shared_ptr<MemoryOwner> m_memory;
+    int64_t m_charged = 0;
+    void chargeMemory();  // the lock is held
+};
+
+}  // namespace lab
+
+#endif  // CaptureWriter_h
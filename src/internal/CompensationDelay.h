@@ -0,0 +1,40 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef CompensationDelay_h
+#define CompensationDelay_h
+
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class AudioBus;
+
+// CompensationDelay holds back the audio of a shorter path by a whole number of frames, so
+// that it lines up with a longer path's where the two are summed. It is a plain ring per
+// channel, copied through in at most two spans a block, so that it costs little more than
+// the copy however long it is.
+class CompensationDelay
+{
+public:
+    explicit CompensationDelay(int delayFrames);
+    ~CompensationDelay();
+
+    int delayFrames() const { return m_delayFrames; }
+
+    // Delays framesToProcess frames of every channel of source, and returns them in a bus of
+    // its own. A change of channel count starts the new channels from silence.
+    AudioBus & process(const AudioBus & source, int framesToProcess);
+
+private:
+    int m_delayFrames;
+    int m_position = 0;
+    std::vector<std::vector<float>> m_rings;
+    std::unique_ptr<AudioBus> m_output;
+};
+
+}  // namespace lab
+
+#endif  // CompensationDelay_h
@@ -0,0 +1,50 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef DeferredRelease_h
+#define DeferredRelease_h
+
+#include "internal/EventQueue.h"
+#include "internal/EventSignal.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace lab
+{
+
+// DeferredRelease takes references that the audio thread would otherwise drop, and drops
+// them on a reclaim thread of its own, so that when one is the last reference to a node or
+// a bus, its destructor, and the free of its memory, don't run on the render path. The
+// queue is bounded, and allocated up front, so a release never allocates; if it is full,
+// the reference is dropped where it is, as it would have been.
+class DeferredRelease
+{
+public:
+    static DeferredRelease & shared();
+
+    explicit DeferredRelease(size_t capacity);
+    ~DeferredRelease();
+
+    // Any thread. Moving the reference in leaves the caller's pointer null.
+    void release(std::shared_ptr<const void> object);
+
+    // Releases dropped in place because the queue was full
+    uint64_t overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void drain();
+
+    EventQueue<std::shared_ptr<const void>> m_queue;
+    EventSignal m_pending;
+    std::atomic<bool> m_running {true};
+    std::atomic<uint64_t> m_overflows {0};
+    std::thread m_thread;
+};
+
+}  // namespace lab
+
+#endif  // DeferredRelease_h
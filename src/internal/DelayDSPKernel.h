@@ -7,33 +7,62 @@
 
 #include "LabSound/core/AudioArray.h"
 
-#include "internal/AudioDSPKernel.h"
-#include "internal/DelayProcessor.h"
+#include "LabSound/core/DelayNode.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+
+#include <vector>
 
 namespace lab
 {
 
-class DelayProcessor;
-
-class DelayDSPKernel : public AudioDSPKernel
+// The delay line is a power of two ring buffer that each block is copied into before it
+// is read. Once the smoothed delay time has settled, a whole number of frames is copied
+// straight out of the ring, and a fractional delay is interpolated four frames at a time;
+// while the delay time moves, each frame finds its own read position.
+//
+// A DelayProcessor runs a kernel per channel, passing them all the same parameters; used
+// on its own, a kernel takes its delay from setDelayFrames and setInterpolation.
+class DelayDSPKernel
 {
 public:
-    explicit DelayDSPKernel(DelayProcessor *, float sampleRate);
+    // The parameters of a quantum; the delay time is within [0, maxDelayTime]
+    struct Params
+    {
+        double delayTime;
+        DelayNode::InterpolationMode interpolation;
+        float sampleRate;
+    };
+
     DelayDSPKernel(double maxDelayTime, float sampleRate);
-    virtual ~DelayDSPKernel() {}
 
-    virtual void process(ContextRenderLock &, const float * source, float * destination, int framesToProcess) override;
-    virtual void reset() override;
+    void process(const Params &, const float * source, float * destination, int framesToProcess);
+    void process(ContextRenderLock &, const float * source, float * destination, int framesToProcess);
+    void reset();
 
     double maxDelayTime() const { return m_maxDelayTime; }
 
     void setDelayFrames(double numberOfFrames) { m_desiredDelayFrames = numberOfFrames; }
+    void setInterpolation(DelayNode::InterpolationMode mode) { m_interpolation = mode; }
 
-    virtual double tailTime(ContextRenderLock & r) const override;
-    virtual double latencyTime(ContextRenderLock & r) const override;
+    double tailTime(ContextRenderLock & r) const;
+    double latencyTime(ContextRenderLock & r) const;
 
 private:
+    enum
+    {
+        // Blocks are at most this long, so that a block can be written before it is read
+        MaxBlockFrames = AudioNode::ProcessingSizeInFrames,
+
+        // Lagrange interpolation reads a frame either side of the two it lies between
+        InterpolationFrames = 3
+    };
+
+    void processBlock(DelayNode::InterpolationMode, const float * source, float * destination, int framesToProcess,
+                      double delayTime, double sampleRate);
+
     AudioFloatArray m_buffer;
+    int m_bufferMask;
     double m_maxDelayTime;
     int m_writeIndex;
     double m_currentDelayTime;
@@ -41,9 +70,13 @@ private:
     bool m_firstTime;
     double m_desiredDelayFrames;
 
-    AudioFloatArray m_delayTimes;
+    DelayNode::InterpolationMode m_interpolation;
+    float m_allpassOutput;
+
+    AudioFloatArray m_window;          // the frames a constant delay reads, in order
+    AudioFloatArray m_fractions;       // per frame interpolation positions while the delay moves
+    std::vector<int> m_readIndices;    // and the ring index of the frame before each position
 
-    DelayProcessor * delayProcessor() { return static_cast<DelayProcessor *>(processor()); }
     size_t bufferLengthForDelay(double delayTime, double sampleRate) const;
 };
 
@@ -8,26 +8,29 @@
 #include "LabSound/core/AudioSetting.h"
 
 #include "internal/AudioDSPKernelProcessor.h"
+#include "internal/DelayDSPKernel.h"
 
 namespace lab
 {
 
-class AudioDSPKernel;
-
-class DelayProcessor : public AudioDSPKernelProcessor
+class DelayProcessor : public AudioDSPKernelProcessor<DelayDSPKernel>
 {
     std::shared_ptr<AudioSetting> m_delayTime;
+    std::shared_ptr<AudioSetting> m_interpolation;
     double m_maxDelayTime;
     float m_sampleRate;
 
 public:
-    DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> delayTime);
+    DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> delayTime,
+                   std::shared_ptr<AudioSetting> interpolation);
 
     virtual ~DelayProcessor();
 
-    virtual AudioDSPKernel * createKernel();
+    virtual std::unique_ptr<DelayDSPKernel> createKernel() override;
+    virtual DelayDSPKernel::Params kernelParams(ContextRenderLock &) override;
 
     std::shared_ptr<AudioSetting> delayTime() const { return m_delayTime; }
+    std::shared_ptr<AudioSetting> interpolation() const { return m_interpolation; }
 
     double maxDelayTime() { return m_maxDelayTime; }
 };
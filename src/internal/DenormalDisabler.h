@@ -8,6 +8,8 @@
 #include "LabSound/core/Macros.h"
 
 // Deal with denormals. They can very seriously impact performance on x86.
+// Every thread LabSound owns that runs DSP holds a DenormalDisabler for its life,
+// since the flush modes belong to the thread, not the process.
 
 // Define HAVE_DENORMAL if we support flushing denormals to zero.
 #if defined(LABSOUND_PLATFORM_WINDOWS)
@@ -16,9 +18,14 @@
 #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 #define HAVE_DENORMAL
 #endif
+#if defined(__GNUC__) && (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FP)))
+#define HAVE_DENORMAL
+#define HAVE_ARM_DENORMAL
+#endif
 
 #include <float.h>
 #include <math.h>
+#include <stdint.h>
 
 namespace lab
 {
@@ -37,6 +44,10 @@ public:
         _controlfp_s(&m_savedCSR, 0, 0);
         unsigned int unused;
         _controlfp_s(&unused, _DN_FLUSH, _MCW_DN);
+#elif defined(HAVE_ARM_DENORMAL)
+        // ARM has no denormals-are-zero; FZ flushes both the results and the operands
+        m_savedCSR = getCSR();
+        setCSR(m_savedCSR | (1u << 24));
 #else
         m_savedCSR = getCSR();
         setCSR(m_savedCSR | 0x8040);
@@ -84,6 +95,39 @@ private:
                      : "m"(temp));
     }
 
+#elif defined(__aarch64__)
+    inline unsigned int getCSR()
+    {
+        uint64_t result;
+        asm volatile("mrs %0, fpcr"
+                     : "=r"(result));
+        return static_cast<unsigned int>(result);
+    }
+
+    inline void setCSR(unsigned int a)
+    {
+        uint64_t temp = a;
+        asm volatile("msr fpcr, %0"
+                     :
+                     : "r"(temp));
+    }
+
+#elif defined(HAVE_ARM_DENORMAL)
+    inline unsigned int getCSR()
+    {
+        unsigned int result;
+        asm volatile("vmrs %0, fpscr"
+                     : "=r"(result));
+        return result;
+    }
+
+    inline void setCSR(unsigned int a)
+    {
+        asm volatile("vmsr fpscr, %0"
+                     :
+                     : "r"(a));
+    }
+
 #endif
 
     unsigned int m_savedCSR;
@@ -109,4 +153,5 @@ public:
 }  // lab
 
 #undef HAVE_DENORMAL
+#undef HAVE_ARM_DENORMAL
 #endif  // DenormalDisabler_h
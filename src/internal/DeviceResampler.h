@@ -0,0 +1,50 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef DeviceResampler_h
+#define DeviceResampler_h
+
+#include <functional>
+#include <vector>
+
+typedef struct SRC_STATE_tag SRC_STATE;
+
+namespace lab
+{
+
+// DeviceResampler converts a rendered stream to the rate of the device playing it, so that
+// a graph can run at a rate of its own. It pulls interleaved blocks from its source as it
+// needs them, and converts with libsamplerate's windowed sinc. Nothing is allocated once
+// it is made, so it may run in the audio callback.
+class DeviceResampler
+{
+public:
+    // pull fills sourceFrames interleaved frames at sourceRate into the buffer it is given
+    DeviceResampler(int channels, double sourceRate, double destinationRate, int sourceFrames,
+                    std::function<void(float * interleaved, int frames)> pull);
+    ~DeviceResampler();
+
+    DeviceResampler(const DeviceResampler &) = delete;
+    DeviceResampler & operator=(const DeviceResampler &) = delete;
+
+    bool valid() const { return _state != nullptr; }
+
+    // Writes frames interleaved frames at the destination rate
+    void process(float * interleaved, int frames);
+
+    void reset();
+
+private:
+    static long supply(void * self, float ** data);
+
+    SRC_STATE * _state = nullptr;
+    std::function<void(float *, int)> _pull;
+    std::vector<float> _block;
+    int _channels;
+    int _sourceFrames;
+    double _ratio;  // destination frames per source frame
+};
+
+}  // namespace lab
+
+#endif  // DeviceResampler_h
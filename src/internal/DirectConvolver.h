@@ -40,8 +40,10 @@ class DirectConvolver final {
     //WTF_MAKE_FAST_ALLOCATED;
     //WTF_MAKE_NONCOPYABLE(DirectConvolver);
 public:
+    // Convolves with kernels of up to inputBlockSize frames
     explicit DirectConvolver(size_t inputBlockSize);
 
+    // Blocks may be of any size
     void process(AudioFloatArray* convolutionKernel, const float* sourceP, float* destP, size_t framesToProcess);
 
     void reset();
@@ -27,7 +27,8 @@ public:
     // Returns scalar gain for the given distance the current distance model is used
     double gain(double distance);
 
-    ModelType model() { return m_model; }
+    ModelType model() const { return m_model; }
+    bool isClamped() const { return m_isClamped; }
 
     void setModel(ModelType model, bool clamped)
     {
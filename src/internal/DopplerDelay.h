@@ -0,0 +1,56 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef DopplerDelay_h
+#define DopplerDelay_h
+
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class AudioBus;
+
+// DopplerDelay is the propagation delay between a moving source and the listener, read
+// with third order Lagrange interpolation. Across each block the delay moves as the
+// doppler rate says it should, rate frames read for every frame written, and is drawn
+// gently toward the delay of the distance the sound travels, so that the shift is heard
+// smoothly from the velocities, and the delay can neither drift nor grow without bound.
+// The delay is held between MinDelayFrames and the delay of maxDelayTime; a source too
+// far away to fit is heard without a shift as long as it stays there.
+class DopplerDelay
+{
+public:
+    DopplerDelay(double maxDelayTime, float sampleRate);
+    ~DopplerDelay();
+
+    // The Lagrange kernel reads a frame either side of the two it lies between
+    static const int MinDelayFrames = 2;
+
+    // Delays framesToProcess frames of every channel of source, the doppler rate being the
+    // ratio of the heard to the emitted frequency, and returns them in a bus of its own
+    AudioBus & process(const AudioBus & source, int framesToProcess, double rate, double targetDelayFrames);
+
+    void reset();
+
+    double delayFrames() const { return m_delayFrames; }
+    double maxDelayFrames() const { return m_maxDelayFrames; }
+
+private:
+    std::vector<std::vector<float>> m_rings;
+    std::unique_ptr<AudioBus> m_output;
+    std::vector<int> m_readIndices;
+    std::vector<float> m_fractions;
+
+    double m_maxDelayFrames;
+    double m_delayFrames;
+    double m_correctionRate;
+    int m_mask;
+    int m_writeIndex;
+    bool m_firstTime;
+};
+
+}  // namespace lab
+
+#endif  // DopplerDelay_h
@@ -42,7 +42,7 @@ class DownSampler final {
 public:
     explicit DownSampler(size_t inputBlockSize);
 
-    // The destination buffer |destP| is of size sourceFramesToProcess / 2.
+    // The destination buffer |destP| is of size sourceFramesToProcess / 2. Blocks may be of any even size.
     void process(const float* sourceP, float* destP, size_t sourceFramesToProcess);
 
     void reset();
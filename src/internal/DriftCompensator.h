@@ -0,0 +1,73 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef DriftCompensator_h
+#define DriftCompensator_h
+
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+typedef struct SRC_STATE_tag SRC_STATE;
+
+namespace lab
+{
+
+// DriftCompensator carries audio from one device's clock to another's, as from an input
+// device to a different output device. Their nominal rates match, but the clocks drift
+// apart by up to a few hundred parts per million, so a plain ring between them would
+// eventually run dry or overflow.
+//
+// The input is written to a ring, and read through an asynchronous resampler whose ratio
+// is steered to hold the ring at a target fill. The correction is limited to half a
+// percent and changes slowly, so it is inaudible. The writer and the reader may be on
+// different threads; nothing is allocated once it is made.
+class DriftCompensator
+{
+public:
+    // targetFrames is the fill the ring is held at, and so the latency added to the input;
+    // it should cover a period of each device and some scheduling jitter
+    DriftCompensator(int channels, int targetFrames);
+    ~DriftCompensator();
+
+    DriftCompensator(const DriftCompensator &) = delete;
+    DriftCompensator & operator=(const DriftCompensator &) = delete;
+
+    // From the input's thread. A write that doesn't fit is dropped, and counted as an overrun.
+    void write(const float * interleaved, int frames);
+
+    // From the output's thread. Until the ring first reaches its target, and after it runs
+    // dry, silence is read while it refills.
+    void read(float * interleaved, int frames);
+
+    // output frames made per input frame consumed
+    double ratio() const { return _ratio.load(std::memory_order_relaxed); }
+    int targetFrames() const { return _targetFrames; }
+    uint64_t underruns() const { return _underruns.load(std::memory_order_relaxed); }
+    uint64_t overruns() const { return _overruns.load(std::memory_order_relaxed); }
+
+private:
+    static long supply(void * self, float ** data);
+
+    RingBufferT<float> _ring;
+    SRC_STATE * _state = nullptr;
+    std::vector<float> _block;
+    int _channels;
+    int _targetFrames;
+    int _blockFrames;
+    bool _primed = false;
+
+    // the reader's control loop
+    double _error = 0;      // the ring's smoothed distance from its target, as a fraction of it
+    double _integral = 0;
+
+    std::atomic<double> _ratio{1.0};
+    std::atomic<uint64_t> _underruns{0};
+    std::atomic<uint64_t> _overruns{0};
+};
+
+}  // namespace lab
+
+#endif  // DriftCompensator_h
@@ -49,7 +49,9 @@ public:
 
     DynamicsCompressor(unsigned numberOfChannels);
 
-    void process(ContextRenderLock &, const AudioBus * sourceBus, AudioBus * destinationBus, int bufferSize, int offset, int count);
+    // The sidechain bus, if not null, drives compression of the source
+    void process(ContextRenderLock &, const AudioBus * sourceBus, AudioBus * destinationBus, int bufferSize, int offset, int count,
+                 const AudioBus * sidechainBus = nullptr);
     void reset();
     void setNumberOfChannels(unsigned);
 
@@ -82,6 +84,7 @@ protected:
 
     std::unique_ptr<const float * []> m_sourceChannels;
     std::unique_ptr<float * []> m_destinationChannels;
+    std::vector<const float *> m_sidechainChannels;
 
     void setEmphasisStageParameters(unsigned stageIndex, float gain, float normalizedFrequency /* 0 -> 1 */);
     void setEmphasisParameters(float gain, float anchorFreq, float filterStageRatio);
@@ -23,11 +23,14 @@ public:
 
     void setNumberOfChannels(unsigned);
 
-    // Performs stereo-linked compression.
+    // Performs stereo-linked compression. The loudest of the sidechain channels drives
+    // the compression if there are any; otherwise the loudest of the source channels does.
     void process(ContextRenderLock &,
                  const float * sourceChannels[],
                  float * destinationChannels[],
                  unsigned numberOfChannels,
+                 const float * sidechainChannels[],
+                 unsigned numberOfSidechainChannels,
                  int framesToProcess,
 
                  float dbThreshold,
@@ -63,9 +66,21 @@ protected:
     {
         MaxPreDelayFrames = 1024
     };
+
+    // Audio is processed in chunks of up to ChunkFrames, each written to the pre-delay
+    // buffers before any of it is read, so the buffers hold the longest pre-delay and a
+    // chunk.
+    enum
+    {
+        ChunkFrames = 1024
+    };
     enum
     {
-        MaxPreDelayFramesMask = MaxPreDelayFrames - 1
+        PreDelayBufferFrames = MaxPreDelayFrames + ChunkFrames
+    };
+    enum
+    {
+        PreDelayBufferMask = PreDelayBufferFrames - 1
     };
     enum
     {
@@ -81,6 +96,14 @@ protected:
 
     float m_maxAttackCompressionDiffDb;
 
+    // Per frame values of a chunk. The attenuation of the detector level and the rate it
+    // releases at are found for the whole chunk at once, then the envelopes are run frame
+    // by frame to find the compressor gain, which becomes the total gain to apply.
+    AudioFloatArray m_attenuation;
+    AudioFloatArray m_releaseRate;
+    AudioFloatArray m_gain;
+    AudioFloatArray m_meteringGainDb;
+
     // Static compression curve.
     float kneeCurve(float x, float k);
     float saturate(float x, float k);
@@ -0,0 +1,113 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef EarlyReflections_h
+#define EarlyReflections_h
+
+#include "LabSound/core/FloatPoint3D.h"
+#include "internal/Distance.h"
+#include "internal/SpatialBatch.h"
+
+#include <vector>
+
+namespace lab
+{
+
+// A box shaped room. Its walls lie on the planes of its bounds, are numbered -x, +x, -y, +y,
+// -z, +z, and reflect the share of the amplitude they are given.
+struct ShoeboxRoom
+{
+    FloatPoint3D minimum = {-5.f, 0.f, -5.f};
+    FloatPoint3D maximum = {5.f, 3.f, 5.f};
+    float reflection[6] = {0.8f, 0.8f, 0.8f, 0.8f, 0.8f, 0.8f};
+};
+
+// EarlyReflections renders the first and second order reflections of many sources from the
+// walls of a box shaped room, by the image source method: each reflection is heard from the
+// source's mirror image in the walls it bounces off, delayed by the image's distance and
+// attenuated by it and by the walls' reflection coefficients.
+//
+// A source has 6 images of the first order, and 18 more of the second. Every image of every
+// source is laid out in one set of arrays, so that their distances, distance gains and
+// directions are found together by SpatialBatch, and their equal-power pan gains four at a
+// time. Each source then writes its block to a delay line once, and every image is a tap on
+// it: a read whose delay and gains are ramped across the block from where they were at the
+// last, so that moving sources glide rather than click. A tap whose delay holds still, as
+// most do, is read and summed four frames at a time.
+//
+// The direct sound is not rendered; it is the source's own PannerNode's.
+class EarlyReflections
+{
+public:
+    EarlyReflections(float sampleRate, double maxDelayTime);
+
+    // The number of sources, each with a delay line of its own; changing it clears them
+    void setSources(int count);
+    int sources() const { return static_cast<int>(m_delays.size()); }
+
+    // How each image is attenuated by its distance
+    DistanceEffect & distanceEffect() { return m_distanceEffect; }
+
+    static const int MaxOrder = 2;
+    static int imagesForOrder(int order) { return order >= 2 ? 24 : 6; }
+
+    // Renders frames of the reflections of the sources at positions, whose samples are
+    // inputs, which may be null for a source that is silent, summing them into outL and outR.
+    // order is 1 or 2. Sources outside the room are heard from the images of their clamped
+    // positions.
+    void process(const ShoeboxRoom & room, int order, const SpatialListener & listener,
+                 const FloatPoint3D * positions, const float * const * inputs,
+                 float * outL, float * outR, int frames);
+
+    void reset();
+
+    double maxDelayTime() const { return m_maxDelayTime; }
+
+private:
+    struct Delay
+    {
+        std::vector<float> ring;
+        std::vector<float> lastDelay;  // each image's delay and gains at the end of the last block,
+        std::vector<float> lastGainL;  // or a negative delay if it has none yet
+        std::vector<float> lastGainR;
+    };
+
+    void findImages(const ShoeboxRoom & room, int order, const FloatPoint3D * positions);
+    // A tap whose delay holds still across the block, and whose span of the line doesn't wrap
+    struct StillTap
+    {
+        const float * span;
+        float fraction;
+        float gainL, gainR;
+        float stepL, stepR;
+    };
+
+    // Renders a tap whose delay moves, or returns true and describes one that holds still
+    bool tap(Delay & delay, int image, int index, float * outL, float * outR, int frames, StillTap & still);
+    static void mixStill(const StillTap * taps, int count, float * outL, float * outR, int frames);
+
+    float m_sampleRate;
+    double m_maxDelayTime;
+    float m_maxDelayFrames;
+    int m_mask = 0;
+    int m_write = 0;
+    DistanceEffect m_distanceEffect;
+    std::vector<Delay> m_delays;
+    StillTap m_still[24];
+
+    // every image of every source, source by source
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_reflection;
+    std::vector<float> m_distance;
+    std::vector<float> m_azimuth;
+    std::vector<float> m_elevation;
+    std::vector<float> m_delay;
+    std::vector<float> m_gainL;
+    std::vector<float> m_gainR;
+};
+
+}  // namespace lab
+
+#endif  // EarlyReflections_h
@@ -11,6 +11,10 @@ namespace lab
 {
 
 // Common type of stereo panner as found in normal audio mixing equipment.
+//
+// The gains are found once a quantum, and ramped linearly across it to where the 50ms
+// de-zippering would have brought them by its end, so that each frame is only a multiply
+// and add. The trig is redone only when the azimuth moves.
 class EqualPowerPanner : public Panner
 {
 
@@ -29,12 +33,21 @@ public:
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
 private:
-    // For smoothing / de-zippering
+    // For smoothing / de-zippering; the gains keep this much of their distance from the
+    // desired gains each frame, and m_decay over a quantum of m_decayFrames
     bool m_isFirstRender = true;
-    double m_smoothingConstant;
-
-    double m_gainL = 0.0;
-    double m_gainR = 0.0;
+    double m_retention;
+    double m_decay = 0.0;
+    int m_decayFrames = 0;
+
+    float m_gainL = 0.f;
+    float m_gainR = 0.f;
+
+    // The desired gains, for the azimuth and input channels they were found for
+    double m_desiredAzimuth = 0.0;
+    int m_desiredChannels = 0;
+    float m_desiredGainL = 0.f;
+    float m_desiredGainR = 0.f;
 };
 
 }  // namespace lab
@@ -0,0 +1,121 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef EventQueue_h
+#define EventQueue_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace lab
+{
+
+// A bounded queue of fixed size records, after Dmitry Vyukov's bounded MPMC queue. Every
+// slot is allocated when the queue is constructed, so pushing never allocates, and any
+// number of threads may push at once without locking; a push into a full queue fails
+// rather than waiting. Each slot carries a sequence number saying whether it is ready to
+// be written or to be read, so a popped record is moved out of its slot, and releases
+// whatever it holds on the popping thread.
+template <typename T>
+class EventQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit EventQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // The records pushed and not yet popped, which may be out of date by the time it returns
+    size_t sizeApprox() const
+    {
+        const size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+        const size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    // Any thread
+    bool tryPush(T && value)
+    {
+        Cell * cell;
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;  // full
+            else
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Any thread, though the context pops from one
+    bool tryPop(T & value)
+    {
+        Cell * cell;
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;  // empty
+            else
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+
+    // padded apart, so that producers and the consumer don't contend for a cache line;
+    // padded rather than aligned, as the queue may be allocated without over-alignment
+    char m_padding0[64];
+    std::atomic<size_t> m_enqueuePos {0};
+    char m_padding1[64];
+    std::atomic<size_t> m_dequeuePos {0};
+};
+
+}  // namespace lab
+
+#endif  // EventQueue_h
@@ -0,0 +1,56 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef EventSignal_h
+#define EventSignal_h
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace lab
+{
+
+// EventSignal wakes a single waiting thread when any number of other threads have
+// something for it. A signal is remembered until the waiter consumes it, so one sent
+// before the waiter sleeps is not lost, and several sent while it is awake wake it once.
+//
+// Signalling is wait free while the waiter is awake, and otherwise costs one wake up
+// call; on Linux that is a futex wake, which never blocks, so the audio thread may
+// signal. Elsewhere the waiter sleeps on a condition variable, and the signal that
+// wakes it takes the mutex the waiter holds only while it goes to sleep.
+class EventSignal
+{
+public:
+    EventSignal() = default;
+    ~EventSignal() = default;
+
+    // Any thread
+    void signal();
+
+    // The waiting thread. Returns true if a signal was consumed, false if the wait
+    // timed out first.
+    bool wait();
+    bool waitFor(int milliseconds);
+
+private:
+    bool consume(int milliseconds);  // negative waits indefinitely
+
+    enum State : int
+    {
+        Sleeping = -1,
+        Idle = 0,
+        Signalled = 1
+    };
+
+    std::atomic<int> m_state {Idle};
+
+#if !defined(__linux__)
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+#endif
+};
+
+}  // namespace lab
+
+#endif  // EventSignal_h
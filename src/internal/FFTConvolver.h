@@ -27,6 +27,9 @@ public:
     // Processing in-place is allowed...
     void process(FFTFrame * fftKernel, const float * sourceP, float * destP, int framesToProcess);
 
+    // The same, with a kernel spectrum laid out as FFTFrame's realData() and imagData() are
+    void process(const float * kernelRealP, const float * kernelImagP, const float * sourceP, float * destP, int framesToProcess);
+
     void reset();
 
     int fftSize() const { return m_frame.fftSize(); }
@@ -9,15 +9,22 @@
 
 #include "LabSound/core/Macros.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
-#if defined(LABSOUND_PLATFORM_OSX) && !defined(USE_KISS_FFT)
+// Accelerate is used on Apple platforms, and Ooura's FFT elsewhere. Defining USE_KISS_FFT
+// or USE_OOURA_FFT selects that implementation instead.
+#if defined(LABSOUND_PLATFORM_OSX) && !defined(USE_KISS_FFT) && !defined(USE_OOURA_FFT)
   #define USE_ACCELERATE_FFT 1
 #else
   #define USE_ACCELERATE_FFT 0
 #endif
 
+#if !USE_ACCELERATE_FFT && !defined(USE_KISS_FFT) && !defined(USE_OOURA_FFT)
+  #define USE_OOURA_FFT 1
+#endif
+
 #if USE_ACCELERATE_FFT
   #include <Accelerate/Accelerate.h>
 #endif 
@@ -46,6 +53,15 @@ public:
     void computeForwardFFT(const float * data);
     void computeInverseFFT(float * data);
     void multiply(const FFTFrame & frame);  // multiplies ourself with frame : effectively operator*=()
+    void multiply(const float * realP, const float * imagP);  // the same, with a spectrum laid out as realData() and imagData() are
+    void zero();
+
+    // Adds the product of two spectra, laid out as realData() and imagData() are, to ourself.
+    // This lets spectra be kept without the overhead of a frame per spectrum.
+    void multiplyAccumulate(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P);
+
+    // The same, with the second spectrum in half precision, its values multiplied by scale2.
+    void multiplyAccumulate(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P, float scale2);
 
     float * realData() const;
     float * imagData() const;
@@ -62,6 +78,11 @@ public:
     void addConstantGroupDelay(double sampleFrameDelay);
 
     int fftSize() const { return m_FFTSize; }
+    int spectrumSize() const;  // the number of values in each of realData() and imagData()
+
+    // Identifies how this implementation lays out and scales spectra, so that spectra
+    // stored by one build can be checked before another uses them
+    static uint32_t spectrumLayout();
     int log2FFTSize() const { return m_log2FFTSize; }
 
 #if USE_ACCELERATE_FFT
@@ -92,6 +113,19 @@ private:
     AudioFloatArray m_imagData;
 #endif
 
+#if defined(USE_OOURA_FFT)
+    struct OouraPlan;
+
+    // Plans are made once per size and shared by every frame of that size
+    static const OouraPlan * planForSize(int log2FFTSize);
+
+    const OouraPlan * m_plan;
+    AudioFloatArray m_work;  // the transform is done in place
+
+    AudioFloatArray m_realData;
+    AudioFloatArray m_imagData;
+#endif
+
 #if defined(USE_KISS_FFT)
     kiss_fftr_cfg mFFT;
     kiss_fftr_cfg mIFFT;
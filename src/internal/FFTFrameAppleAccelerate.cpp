@@ -3,11 +3,11 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/core/Macros.h"
+#include "internal/FFTFrame.h"
 
-#if defined(LABSOUND_PLATFORM_OSX) && !defined(WEBAUDIO_KISSFFT)
+#if USE_ACCELERATE_FFT
 
 #include "internal/Assertions.h"
-#include "internal/FFTFrame.h"
 #include "LabSound/extended/VectorMath.h"
 
 namespace lab
@@ -86,15 +86,10 @@ void FFTFrame::cleanup()
     fftSetups = 0;
 }
 
-void FFTFrame::multiply(const FFTFrame & frame)
+void FFTFrame::multiply(const float * realP2, const float * imagP2)
 {
-    FFTFrame & frame1 = *this;
-    const FFTFrame & frame2 = frame;
-
-    float * realP1 = frame1.realData();
-    float * imagP1 = frame1.imagData();
-    const float * realP2 = frame2.realData();
-    const float * imagP2 = frame2.imagData();
+    float * realP1 = realData();
+    float * imagP1 = imagData();
 
     int halfSize = m_FFTSize / 2;
     float real0 = realP1[0];
@@ -115,6 +110,62 @@ void FFTFrame::multiply(const FFTFrame & frame)
     VectorMath::vsmul(imagP1, 1, &scale, imagP1, 1, halfSize);
 }
 
+void FFTFrame::multiplyAccumulate(const float * realP1, const float * imagP1, const float * realP2, const float * imagP2)
+{
+    float * realDestP = realData();
+    float * imagDestP = imagData();
+
+    int halfSize = m_FFTSize / 2;
+    float real0 = realDestP[0] + 0.5f * realP1[0] * realP2[0];
+    float imag0 = imagDestP[0] + 0.5f * imagP1[0] * imagP2[0];
+
+    // Scale the products as multiply() does, to account for vecLib's scaling
+    for (int i = 0; i < halfSize; ++i)
+    {
+        realDestP[i] += 0.5f * (realP1[i] * realP2[i] - imagP1[i] * imagP2[i]);
+        imagDestP[i] += 0.5f * (realP1[i] * imagP2[i] + imagP1[i] * realP2[i]);
+    }
+
+    // The packed DC/nyquist component
+    realDestP[0] = real0;
+    imagDestP[0] = imag0;
+}
+
+void FFTFrame::multiplyAccumulate(const float * realP1, const float * imagP1, const uint16_t * realP2, const uint16_t * imagP2, float scale2)
+{
+    float * realDestP = realData();
+    float * imagDestP = imagData();
+
+    float dc2, nyquist2;
+    VectorMath::vfromhalf(realP2, scale2, &dc2, 1);
+    VectorMath::vfromhalf(imagP2, scale2, &nyquist2, 1);
+    float real0 = realDestP[0] + 0.5f * realP1[0] * dc2;
+    float imag0 = imagDestP[0] + 0.5f * imagP1[0] * nyquist2;
+
+    // Scale the products as multiply() does, to account for vecLib's scaling
+    VectorMath::zvmaddh(realP1, imagP1, realP2, imagP2, 0.5f * scale2, realDestP, imagDestP, m_FFTSize / 2);
+
+    // The packed DC/nyquist component
+    realDestP[0] = real0;
+    imagDestP[0] = imag0;
+}
+
+int FFTFrame::spectrumSize() const
+{
+    return m_FFTSize / 2;
+}
+
+uint32_t FFTFrame::spectrumLayout()
+{
+    return 2;  // fftSize / 2 bins scaled by two, the nyquist value packed into the imaginary DC value
+}
+
+void FFTFrame::zero()
+{
+    memset(realData(), 0, sizeof(float) * spectrumSize());
+    memset(imagData(), 0, sizeof(float) * spectrumSize());
+}
+
 void FFTFrame::computeForwardFFT(const float * data)
 {
     vDSP_ctoz((DSPComplex *) data, 2, &m_frame, 1, m_FFTSize / 2);
@@ -0,0 +1,139 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef FastMath_h
+#define FastMath_h
+
+#include "internal/Lanes4.h"
+
+namespace lab
+{
+
+// Polynomial approximations of the transcendental functions used in per sample gain
+// computation, written for float and for Lanes4. log2 is within 3e-6 of the true value,
+// so decibels are within 2e-5 dB, and exp2 and sinHalfPi are within 2e-7 relative. acos
+// is within 3e-7 radians, atan2 within 2e-6, and sinCos within 3e-6 over a few turns.
+// They are meant for positive normal arguments and gains, and don't handle infinities
+// or NaNs.
+namespace FastMath
+{
+
+    template <typename T>
+    inline T log2(T x)
+    {
+        T mantissa = x;
+        const T exponent = splitExponent(x, mantissa);
+        const T t = mantissa - T(1.f);
+        T p = T(-0.025792337074572715f);
+        p = p * t + T(0.12147292471165402f);
+        p = p * t + T(-0.2773416197062027f);
+        p = p * t + T(0.4571581077989454f);
+        p = p * t + T(-0.7180335874383149f);
+        p = p * t + T(1.4425347793525622f);
+        return exponent + p * t;
+    }
+
+    template <typename T>
+    inline T exp2(T x)
+    {
+        x = maxOf(minOf(x, T(127.f)), T(-126.f));
+        const T n = floorOf(x);
+        const T f = x - n;
+        T p = T(0.001885403805066876f);
+        p = p * f + T(0.008972899264771309f);
+        p = p * f + T(0.05583659804684137f);
+        p = p * f + T(0.24015244461653132f);
+        p = p * f + T(0.6931525352656525f);
+        p = p * f + T(1.f);
+        return scaleByPowerOf2(p, n);
+    }
+
+    // 20 log10(x), and its inverse
+    template <typename T>
+    inline T linearToDecibels(T x) { return T(6.020599913279624f) * log2(x); }
+
+    template <typename T>
+    inline T decibelsToLinear(T db) { return exp2(db * T(0.16609640474436813f)); }
+
+    // e^x
+    template <typename T>
+    inline T exp(T x) { return exp2(x * T(1.4426950408889634f)); }
+
+    // sin(x pi/2), for x in [0, 1]
+    template <typename T>
+    inline T sinHalfPi(T x)
+    {
+        const T u = x * x;
+        T p = T(0.0001508171530630822f);
+        p = p * u + T(-0.00467222025043036f);
+        p = p * u + T(0.07968847478927504f);
+        p = p * u + T(-0.6459633582701119f);
+        p = p * u + T(1.5707962899029677f);
+        return x * p;
+    }
+
+    // acos(x) in radians, for x clamped to [-1, 1], by Abramowitz and Stegun 4.4.46
+    template <typename T>
+    inline T acos(T x)
+    {
+        x = maxOf(minOf(x, T(1.f)), T(-1.f));
+        const T a = absOf(x);
+        T p = T(-0.0012624911f);
+        p = p * a + T(0.0066700901f);
+        p = p * a + T(-0.0170881256f);
+        p = p * a + T(0.0308918810f);
+        p = p * a + T(-0.0501743046f);
+        p = p * a + T(0.0889789874f);
+        p = p * a + T(-0.2145988016f);
+        p = p * a + T(1.5707963050f);
+        const T r = sqrtOf(T(1.f) - a) * p;
+        return select(x < T(0.f), T(3.14159265358979f) - r, r);
+    }
+
+    // atan2(y, x) in radians, in [-pi, pi], and 0 for the origin. The ratio of the smaller
+    // magnitude to the larger is taken through a minimax polynomial for atan on [0, 1].
+    template <typename T>
+    inline T atan2(T y, T x)
+    {
+        const T ax = absOf(x);
+        const T ay = absOf(y);
+        const T larger = maxOf(ax, ay);
+        const T a = minOf(ax, ay) / maxOf(larger, T(1e-30f));
+        const T u = a * a;
+        T p = T(-0.0117212f);
+        p = p * u + T(0.05265332f);
+        p = p * u + T(-0.11643287f);
+        p = p * u + T(0.19354346f);
+        p = p * u + T(-0.33262347f);
+        p = p * u + T(0.99997726f);
+        T r = a * p;
+        r = select(ay > ax, T(1.5707963267948966f) - r, r);
+        r = select(x < T(0.f), T(3.14159265358979f) - r, r);
+        return select(y < T(0.f), T(0.f) - r, r);
+    }
+
+    // sin(x) and cos(x), for x of any size that a float resolves to well within a radian, by
+    // the quarter turn nearest x and sinHalfPi of the rest
+    template <typename T>
+    inline void sinCos(T x, T & sine, T & cosine)
+    {
+        const T q = x * T(0.6366197723675814f);
+        const T k = floorOf(q + T(0.5f));
+        const T r = q - k;
+        const T s = sinHalfPi(r);
+        const T c = sinHalfPi(T(1.f) - absOf(r));
+
+        // the quarter turn, 0 to 3; odd ones swap sine and cosine, and the latter two negate
+        const T quarter = k - T(4.f) * floorOf(k * T(0.25f));
+        const T odd = quarter - T(2.f) * floorOf(quarter * T(0.5f));
+        T sn = select(odd > T(0.5f), c, s);
+        T cs = select(odd > T(0.5f), T(0.f) - s, c);
+        sine = select(quarter > T(1.5f), T(0.f) - sn, sn);
+        cosine = select(quarter > T(1.5f), T(0.f) - cs, cs);
+    }
+
+}  // namespace FastMath
+
+}  // namespace lab
+
+#endif  // FastMath_h
@@ -0,0 +1,82 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef FeedbackDelayNetwork_h
+#define FeedbackDelayNetwork_h
+
+#include <vector>
+
+namespace lab
+{
+
+// A feedback delay network reverberator: 8 or 16 delay lines whose outputs are damped,
+// mixed by a normalized Hadamard matrix, and fed back with the input. The lines' lengths are
+// spread exponentially over the room's size and made prime, so that their echoes don't
+// coincide, and their read positions are swept slowly by LFOs of spread phases, which
+// smooths the modes of the tail.
+//
+// Each line is damped by a crossover at dampingFrequency, whose low band decays by 60 dB in
+// decay seconds and whose high band in decay * damping seconds, with the gain each band
+// loses over the line's length.
+//
+// Every line is longer than a block, so a whole block of each line's output is known before
+// any of it is fed back; the matrix then mixes a block at a time, four frames at a time in
+// Lanes4, as a fast Walsh-Hadamard transform of add and subtract butterflies.
+class FeedbackDelayNetwork
+{
+public:
+    struct Parameters
+    {
+        float decay = 2.f;               // seconds to fall 60 dB, below the crossover
+        float damping = 0.5f;            // the high band's decay, as a share of decay
+        float dampingFrequency = 4000.f; // Hz
+        float modulationDepth = 0.5f;    // ms
+        float modulationRate = 0.5f;     // Hz
+    };
+
+    // lines is 8 or 16; size scales the lines' lengths, from 20 to 80 ms at 1
+    FeedbackDelayNetwork(float sampleRate, int lines, float size);
+
+    int lines() const { return m_lines; }
+    float size() const { return m_size; }
+
+    // The longest line, in seconds
+    double longestDelay() const;
+
+    // Renders frames of the reverberation of left and right, which may be the same, into
+    // outL and outR.
+    void process(const Parameters & p, const float * left, const float * right, float * outL, float * outR, int frames);
+
+    void reset();
+
+    static const int MaxModulationMs = 4;
+
+private:
+    void processBlock(const float * left, const float * right, float * outL, float * outR, int frames);
+
+    float m_sampleRate;
+    int m_lines;
+    float m_size;
+    int m_mask;              // each line's ring holds mask + 1 frames
+    int m_write = 0;
+    int m_block;             // the most frames processed before feeding back
+    int m_modulationFrames;  // the deepest sweep the rings allow for
+
+    std::vector<float> m_rings;      // each line's ring in turn
+    std::vector<int> m_lengths;
+    std::vector<float> m_gainLow;
+    std::vector<float> m_gainHigh;
+    std::vector<float> m_lowpass;    // each line's crossover state
+    std::vector<float> m_lfoSin;     // each line's LFO, as a rotating phasor
+    std::vector<float> m_lfoCos;
+    std::vector<float> m_scratch;    // a block of each line's output
+
+    float m_crossover = 0;           // the one pole coefficient
+    float m_depth = 0;               // frames
+    float m_rotateSin = 0;
+    float m_rotateCos = 1;
+};
+
+}  // namespace lab
+
+#endif  // FeedbackDelayNetwork_h
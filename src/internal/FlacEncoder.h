@@ -0,0 +1,47 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef FlacEncoder_h
+#define FlacEncoder_h
+
+#include <cstdint>
+#include <vector>
+
+namespace lab
+{
+namespace FlacEncoder
+{
+
+    enum : int
+    {
+        MaxChannels = 8,
+        StreamInfoBytes = 42  // the stream marker, and the STREAMINFO block with its header
+    };
+
+    struct StreamInfo
+    {
+        int blockSize = 4096;
+        uint32_t minFrameBytes = 0;  // zero is unknown
+        uint32_t maxFrameBytes = 0;
+        uint32_t sampleRate = 0;
+        int channels = 0;
+        int bitsPerSample = 16;
+        uint64_t totalFrames = 0;    // zero is unknown
+    };
+
+    // Writes the stream marker and a STREAMINFO block, the only metadata, to out
+    void writeStreamInfo(const StreamInfo & info, uint8_t out[StreamInfoBytes]);
+
+    // Appends one FLAC frame of frames interleaved samples to out. Frames are independent
+    // of each other, so a stream's frames may be encoded in any order, or in parallel, as
+    // long as each has its number, counted in blocks from the start of a stream of fixed
+    // block size. Each channel is coded with the best of the fixed predictors and Rice
+    // coded residuals, or verbatim; a stereo pair also tries its mid and side channels.
+    // Samples must fit in bitsPerSample, which is 8, 12, 16, 20 or 24.
+    void encodeFrame(const int32_t * interleaved, int channels, int frames, int bitsPerSample, uint32_t sampleRate,
+                     uint32_t frameNumber, std::vector<uint8_t> & out);
+
+}  // namespace FlacEncoder
+}  // namespace lab
+
+#endif  // FlacEncoder_h
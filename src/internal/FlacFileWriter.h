@@ -0,0 +1,84 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef FlacFileWriter_h
+#define FlacFileWriter_h
+
+#include "internal/RecordingFile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+// FlacFileWriter streams a recording to a FLAC file. FLAC frames are independent of each
+// other, so frames are gathered into chunks of several blocks, and each block of a chunk is
+// encoded as a job on the shared JobSystem, while the writer goes on gathering the next
+// chunk; finished chunks are written in order. The writer only waits for the encoders when
+// more chunks are in flight than it allows, which bounds the memory a recording holds.
+// STREAMINFO is brought up to date as the file grows, so that a file cut short is readable
+// up to its last update.
+class FlacFileWriter : public RecordingFile
+{
+public:
+    FlacFileWriter() = default;
+    virtual ~FlacFileWriter();
+
+    FlacFileWriter(const FlacFileWriter &) = delete;
+    FlacFileWriter & operator=(const FlacFileWriter &) = delete;
+
+    // Returns false if the file can't be created, or FLAC can't hold the stream.
+    // bitsPerSample is 16 or 24.
+    bool open(const std::string & path, int channels, float sampleRate, int bitsPerSample);
+
+    virtual bool setChannelCount(int channels) override;
+    virtual bool write(const float * interleaved, int frames) override;
+
+    // Rewrites STREAMINFO for the frames written so far; frames still being encoded are
+    // counted when their chunk is written
+    virtual bool updateHeader() override;
+
+    // Encodes and writes what remains, updates STREAMINFO and closes the file
+    virtual bool close() override;
+
+    bool isOpen() const { return m_file != nullptr; }
+    virtual int channels() const override { return m_channels; }
+    virtual uint64_t framesWritten() const override { return m_frames; }
+
+private:
+    struct Chunk
+    {
+        std::vector<int32_t> samples;  // interleaved
+        int frames = 0;
+        uint32_t firstBlock = 0;
+        std::vector<std::vector<uint8_t>> encoded;  // a frame per block
+        std::atomic<int> remaining {0};             // blocks still encoding
+    };
+
+    void submit();                  // encodes the chunk being gathered
+    bool writeFinished(bool wait);  // writes the finished chunks at the front, or waits for all
+
+    FILE * m_file = nullptr;
+    int m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    int m_bitsPerSample = 16;
+    bool m_failed = false;
+    uint64_t m_frames = 0;         // accepted, whether or not written yet
+    uint64_t m_writtenFrames = 0;  // in frames written to the file
+    uint32_t m_nextBlock = 0;
+    uint32_t m_minFrameBytes = 0;
+    uint32_t m_maxFrameBytes = 0;
+
+    std::unique_ptr<Chunk> m_gathering;
+    std::deque<std::unique_ptr<Chunk>> m_encoding;
+};
+
+}  // namespace lab
+
+#endif  // FlacFileWriter_h
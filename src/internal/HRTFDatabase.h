@@ -8,7 +8,10 @@
 #include "LabSound/extended/Util.h"
 #include "internal/FFTFrame.h"
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -16,14 +19,42 @@
 namespace lab
 {
 
+class AudioBus;
 class AudioChannel;
 
-// Hard-coded to the IRCAM HRTF Database
+// The impulse responses of an AES69 (SOFA) file, resampled to the database's sample rate.
+// SOFA files are HDF5 files, which are read with libmysofa when LabSound is configured
+// with LABSOUND_USE_LIBMYSOFA.
+class HRTFSofaFile
+{
+public:
+    // Returns null if the file can't be read, or if LabSound was built without SOFA support.
+    static std::shared_ptr<HRTFSofaFile> open(const std::string & path, float sampleRate);
+
+    // True if path names a .sofa file
+    static bool isSofaPath(const std::string & path);
+
+    ~HRTFSofaFile();
+
+    // The stereo response nearest to azimuth and elevation, in degrees as the IRCAM responses
+    // measure them, or null.
+    std::shared_ptr<AudioBus> impulseResponse(int azimuth, int elevation);
+
+private:
+    HRTFSofaFile() = default;
+
+    void * m_sofa = nullptr;
+    int m_filterLength = 0;
+    float m_sampleRate = 0;
+};
+
+// Hard-coded to the IRCAM HRTF Database, sampled on the same grid when read from a SOFA file
 struct HRTFDatabaseInfo
 {
     std::string subjectName;
     std::string searchPath;
     float sampleRate;
+    std::shared_ptr<HRTFSofaFile> sofa;  // null unless searchPath names a SOFA file
 
     int minElevation = -45;
     int maxElevation = 90;
@@ -71,15 +102,34 @@ public:
 
     HRTFKernel(std::unique_ptr<FFTFrame> fftFrame, float frameDelay, float sampleRate)
         : m_fftFrame(std::move(fftFrame))
+        , m_realData(m_fftFrame->realData())
+        , m_imagData(m_fftFrame->imagData())
+        , m_fftSize(m_fftFrame->fftSize())
         , m_frameDelay(frameDelay)
         , m_sampleRate(sampleRate)
     {
         //m_fftFrame->print();
     }
 
+    // A kernel whose spectrum, laid out as FFTFrame's realData() and imagData() are, is kept
+    // elsewhere, such as in a compiled database's mapped file. storage keeps it valid.
+    HRTFKernel(int fftSize, const float * realData, const float * imagData, float frameDelay, float sampleRate, std::shared_ptr<const void> storage)
+        : m_storage(std::move(storage))
+        , m_realData(realData)
+        , m_imagData(imagData)
+        , m_fftSize(fftSize)
+        , m_frameDelay(frameDelay)
+        , m_sampleRate(sampleRate)
+    {
+    }
+
+    // null for a kernel whose spectrum is kept elsewhere
     FFTFrame * fftFrame() { return m_fftFrame.get(); }
 
-    int fftSize() const { return m_fftFrame->fftSize(); }
+    const float * realData() const { return m_realData; }
+    const float * imagData() const { return m_imagData; }
+
+    int fftSize() const { return m_fftSize; }
     float frameDelay() const { return m_frameDelay; }
 
     // Converts back into impulse-response form.
@@ -90,6 +140,10 @@ public:
 private:
     // Note: this is destructive on the passed in AudioChannel.
     std::unique_ptr<FFTFrame> m_fftFrame;
+    std::shared_ptr<const void> m_storage;
+    const float * m_realData = nullptr;
+    const float * m_imagData = nullptr;
+    int m_fftSize = 0;
     float m_frameDelay;
     float m_sampleRate;
 };
@@ -110,6 +164,10 @@ public:
     // Valid values for elevation are -45 -> +90 in 15 degree increments.
     static std::unique_ptr<HRTFElevation> createForSubject(HRTFDatabaseInfo * info, int elevation);
 
+    // Returns an HRTFElevation of kernels made elsewhere, such as read from a compiled database.
+    // Each list must hold a kernel for every one of the NumberOfTotalAzimuths.
+    static std::unique_ptr<HRTFElevation> createWithKernels(std::unique_ptr<HRTFKernelList> kernelListL, std::unique_ptr<HRTFKernelList> kernelListR, double elevationAngle);
+
     // Given two HRTFElevations, and an interpolation factor x: 0 -> 1, returns an interpolated HRTFElevation.
     static std::unique_ptr<HRTFElevation> createByInterpolatingSlices(HRTFDatabaseInfo * info, HRTFElevation * hrtfElevation1, HRTFElevation * hrtfElevation2, float x);
 
@@ -148,7 +206,7 @@ public:
     static bool calculateSymmetricKernelsForAzimuthElevation(HRTFDatabaseInfo * info, int azimuth, int elevation, std::shared_ptr<HRTFKernel> & kernelL, std::shared_ptr<HRTFKernel> & kernelR);
 
 private:
-    HRTFElevation(HRTFDatabaseInfo * info, std::unique_ptr<HRTFKernelList> kernelListL, std::unique_ptr<HRTFKernelList> kernelListR, int elevation)
+    HRTFElevation(HRTFDatabaseInfo * info, std::unique_ptr<HRTFKernelList> kernelListL, std::unique_ptr<HRTFKernelList> kernelListR, double elevation)
         : m_kernelListL(std::move(kernelListL))
         , m_kernelListR(std::move(kernelListR))
         , m_elevationAngle(elevation)
@@ -161,89 +219,174 @@ private:
     double m_elevationAngle;
 };
 
+// The elevations of a database built from impulse responses are made on demand. Only the
+// elevation nearest the horizon is made as the database loads; an elevation asked for that
+// isn't resident is made, with its neighbours, on a worker thread, and until it is ready the
+// nearest resident elevation stands in for it. With a resident limit, the elevations used
+// least recently are released once more than the limit are resident. A compiled database
+// is mapped whole, and so is always resident.
 class HRTFDatabase
 {
 
     NO_MOVE(HRTFDatabase);
 
 public:
+    // Loads the IRCAM impulse responses in the directory searchPath, or, if searchPath names a
+    // .sofa file, the responses in it nearest to the IRCAM grid.
     HRTFDatabase(float sampleRate, const std::string & searchPath);
+    ~HRTFDatabase();
+
+    // Loads a database written by writeCompiled(). The kernels are used in place in the mapped
+    // file, so loading takes no decoding, resampling or transforming, and processes using the
+    // same file share its pages. Returns null if there is no such file, or if it was compiled
+    // for another sample rate or FFT implementation.
+    static std::unique_ptr<HRTFDatabase> loadCompiled(const std::string & path, float sampleRate);
+
+    // Writes the kernels and delays in the form loadCompiled() reads, making any elevations
+    // that aren't resident. Returns true on success.
+    bool writeCompiled(const std::string & path) const;
+
+    // The name with which the loader looks for a compiled database in its search path
+    static std::string compiledName(float sampleRate);
 
     // getKernelsFromAzimuthElevation() returns a left and right ear kernel, and an interpolated left and right frame delay for the given azimuth and elevation.
     // azimuthBlend must be in the range 0 -> 1.
     // Valid values for azimuthIndex are 0 -> HRTFElevation::NumberOfTotalAzimuths - 1 (corresponding to angles of 0 -> 360).
     // Valid values for elevationAngle are MinElevation -> MaxElevation.
+    // The kernels remain valid while the caller holds a Reading of the database.
     void getKernelsFromAzimuthElevation(double azimuthBlend, unsigned azimuthIndex, double elevationAngle, HRTFKernel *& kernelL, HRTFKernel *& kernelR, double & frameDelayL, double & frameDelayR);
 
+    // Held by a render while it uses kernels from the database, so that the elevations they
+    // belong to aren't released under it. Taking one doesn't block.
+    class Reading
+    {
+    public:
+        explicit Reading(HRTFDatabase * database) : m_database(database) { if (m_database) m_database->m_readers.fetch_add(1); }
+        ~Reading() { if (m_database) m_database->m_readers.fetch_sub(1); }
+        Reading(const Reading &) = delete;
+        Reading & operator=(const Reading &) = delete;
+    private:
+        HRTFDatabase * m_database;
+    };
+
     // Returns the number of different azimuth angles.
     static unsigned numberOfAzimuths() { return HRTFElevation::NumberOfTotalAzimuths; }
-    int numberOfElevations() const { return (int) m_elevations.size(); }
-    bool files_found_and_loaded() { return info->files_found_and_loaded; }
+    int numberOfElevations() const { return m_numberOfElevations; }
+    bool files_found_and_loaded() const { return m_filesFound; }
+
+    // The most elevations to keep resident, or zero to keep every elevation once it's made.
+    // The elevation nearest the horizon, and the one most recently asked for, are always kept.
+    void setResidentLimit(int elevations);
+    int residentLimit() const { return m_residentLimit.load(std::memory_order_relaxed); }
+    int residentElevations() const;
 
 private:
+    HRTFDatabase() = default;
+
+    // publishes elevation index to the readers
+    void makeResident(int index, std::unique_ptr<HRTFElevation> elevation);
+
+    // Makes the elevation at index, and the raw elevations it's interpolated from if they
+    // aren't resident. Requires m_makeLock.
+    std::unique_ptr<HRTFElevation> makeElevation(int index) const;
+
+    void residencyWorker();
+    void evict(int keep);
+
+    int m_numberOfElevations = 0;
+    bool m_filesFound = false;
+    int m_pinned = -1;
+
+    // Owned here, and changed only on the worker thread once it has started, under m_lock.
+    // The readers see them through m_resident.
     std::vector<std::unique_ptr<HRTFElevation>> m_elevations;
+    std::unique_ptr<std::atomic<HRTFElevation *>[]> m_resident;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_lastUsed;
+    std::atomic<uint64_t> m_clock {0};
+
+    // Elevations asked for that aren't resident, one bit each; set by the readers, and cleared by
+    // the worker as it makes them.
+    std::atomic<uint64_t> m_wanted {0};
+    std::atomic<int> m_residentLimit {0};
+    std::atomic<int> m_readers {0};
+
+    mutable std::mutex m_lock;
+    mutable std::mutex m_makeLock;  // making elevations reads files that mustn't be read concurrently
+    std::condition_variable m_wake;
+    std::thread m_worker;
+    bool m_stopping = false;
+    bool m_limitChanged = false;
+
+    // elevations no longer resident, released once no Reading is held
+    std::vector<std::unique_ptr<HRTFElevation>> m_retired;
 
     std::unique_ptr<HRTFDatabaseInfo> info;
 };
 
-// HRTFDatabaseLoader will asynchronously load the default HRTFDatabase in a new thread.
+// HRTFDatabaseLoader will asynchronously load the default HRTFDatabase as a job on the shared JobSystem.
 
 class HRTFDatabaseLoader
 {
 
 public:
-    // Both constructor and destructor must be called from the main thread.
-    // It's expected that the singletons will be accessed instead.
-    // @CBB the guts of the loader should be a private singleton, so that the loader can be constructed without a factory
+    // It's expected that the shared loaders will be accessed instead.
     explicit HRTFDatabaseLoader(float sampleRate, const std::string & searchPath);
 
-    // Lazily creates the singleton HRTFDatabaseLoader (if not already created) and starts loading asynchronously (when created the first time).
-    // Returns the singleton HRTFDatabaseLoader.
-    // Must be called from the main thread.
-    static HRTFDatabaseLoader* MakeHRTFLoaderSingleton(float sampleRate, const std::string & searchPath);
+    // Returns the loader for the database at searchPath for sampleRate, creating it if no context
+    // currently holds one. Contexts share a loader so that the database is loaded once however many
+    // contexts use it; once loaded, the database is only read, so concurrently rendering contexts
+    // don't contend for it. A loader whose files could not be found is replaced by a fresh one.
+    // Call loadAsynchronously() to begin loading.
+    static std::shared_ptr<HRTFDatabaseLoader> MakeHRTFLoaderSingleton(float sampleRate, const std::string & searchPath);
 
-    // Returns the singleton HRTFDatabaseLoader.
-    static HRTFDatabaseLoader* loader() { return s_loader; }
-
-    // Both constructor and destructor must be called from the main thread.
     ~HRTFDatabaseLoader();
 
-    // Returns true once the default database has been completely loaded.
+    // Returns true once loading has finished, whether or not it succeeded.
     bool isLoaded() const;
 
+    // Returns true once a complete database has been loaded.
+    bool loadSucceeded() const;
+
     // waitForLoaderThreadCompletion() may be called more than once and is thread-safe.
     void waitForLoaderThreadCompletion();
 
-    HRTFDatabase * database() { return m_hrtfDatabase.get(); }
+    // Null until isLoaded()
+    HRTFDatabase * database() { return isLoaded() ? m_hrtfDatabase.get() : nullptr; }
 
     float databaseSampleRate() const { return m_databaseSampleRate; }
 
-    // Called in asynchronous loading thread.
+    // Called in the asynchronous loading job.
     void load();
 
-    // defaultHRTFDatabase() gives access to the loaded database.
-    // This can be called from any thread, but it is the callers responsibilty to call this while the context (and thus HRTFDatabaseLoader)
-    // is still alive.  Otherwise this will return 0.
-    static HRTFDatabase * defaultHRTFDatabase();
+    const std::string & databaseSearchPath() const { return searchPath; }
 
-        // If it hasn't already been loaded, creates a new thread and initiates asynchronous loading of the default database.
-    // This must be called from the main thread.
+    // Sets the database's resident limit, once it's loaded if it isn't yet.
+    void setResidentLimit(int elevations);
+
+    // If it hasn't already been loaded, submits a job that loads the default database.
+    // May be called from any thread, and more than once.
     void loadAsynchronously();
 
+    // As loadAsynchronously(), calling completion with loadSucceeded() once loading finishes.
+    // completion is called by the loading job, or on the calling thread if loading has already
+    // finished; it must not release the last reference to this loader.
+    void loadAsynchronously(std::function<void(bool)> completion);
+
 private:
     static void databaseLoaderEntry(HRTFDatabaseLoader * threadData);
 
 
-    static HRTFDatabaseLoader* s_loader;  // convenience pointer, owned elsewhere
     std::unique_ptr<HRTFDatabase> m_hrtfDatabase;
 
-    // Holding a m_threadLock is required when accessing m_databaseLoaderThread.
+    // Holding a m_threadLock is required when accessing m_loading and m_completions.
     std::mutex m_threadLock;
-    std::thread m_databaseLoaderThread;
-    std::condition_variable m_loadingCondition;
+    std::vector<std::function<void(bool)>> m_completions;
     bool m_loading;
+    std::atomic<bool> m_loaded {false};
+    std::atomic<bool> m_jobFinished {false};  // the loading job no longer refers to the loader
 
     float m_databaseSampleRate;
+    std::atomic<int> m_residentLimit {0};
 
     std::string searchPath;
 };
@@ -12,6 +12,8 @@
 namespace lab
 {
 
+class HRTFDatabase;
+
 class HRTFPanner : public Panner
 {
 
@@ -36,10 +38,18 @@ public:
     virtual double tailTime(ContextRenderLock & r) const override;
     virtual double latencyTime(ContextRenderLock & r) const override;
 
+    // With kernel interpolation, a change of direction blends the old and new kernels' spectra
+    // as it crossfades, and convolves once per ear with the blend, so that a moving source costs
+    // no more than a still one. The kernels' leading delays are removed, and rendered by the
+    // delay lines, so their spectra blend without comb filtering. Otherwise each direction is
+    // convolved separately and the results crossfaded. The default is off.
+    void setInterpolatesKernels(bool interpolates);
+    bool interpolatesKernels() const { return m_interpolatesKernels; }
+
 private:
     // Given an azimuth angle in the range -180 -> +180, returns the corresponding azimuth index for the database,
     // and azimuthBlend which is an interpolation value from 0 -> 1.
-    int calculateDesiredAzimuthIndexAndBlend(double azimuth, double & azimuthBlend);
+    int calculateDesiredAzimuthIndexAndBlend(HRTFDatabase * database, double azimuth, double & azimuthBlend);
 
     // We maintain two sets of convolvers for smooth cross-faded interpolations when
     // then azimuth and elevation are dynamically changing.
@@ -86,6 +96,12 @@ private:
     AudioFloatArray m_tempR1;
     AudioFloatArray m_tempL2;
     AudioFloatArray m_tempR2;
+
+    // the blended kernel spectra, real values followed by imaginary
+    bool m_interpolatesKernels = false;
+    int m_spectrumSize;
+    AudioFloatArray m_blendL;
+    AudioFloatArray m_blendR;
 };
 
 }  // namespace lab
@@ -0,0 +1,119 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef JitterBuffer_h
+#define JitterBuffer_h
+
+#include "LabSound/core/ConcurrentQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace lab
+{
+
+// Turns packets of audio arriving from a network, late, out of order, or not at all, into
+// a continuous stream for the render thread, a fixed latency behind the sender.
+//
+// Packets are pushed by a receiving thread. They are held a few packets' time in case
+// one arrives out of order, then written in sequence into a ring that the render thread
+// pulls from without locks or waiting. A packet still missing once ReorderDepth packets
+// after it have arrived is lost, and concealed by the previous packet fading out; a packet
+// arriving after it has been given up on is dropped.
+//
+// The latency the ring is held to follows the interarrival jitter, estimated as RFC 3550
+// does, at four times the jitter plus a packet and a render quantum, within the given
+// bounds. The render thread waits for the ring to fill to that latency before it plays,
+// and again after it runs dry. When more arrives than that latency needs, as after a stall
+// on the network, or when the sender's clock runs fast, the excess is dropped a little at
+// a time, crossfaded within a packet, so that the latency returns to the target.
+class JitterBuffer
+{
+public:
+    JitterBuffer(int channels, int maxPacketFrames, int renderQuantum, float sampleRate, double minLatency, double maxLatency);
+    ~JitterBuffer();
+
+    enum : int
+    {
+        Slots = 16,        // packets held for reordering
+        ReorderDepth = 3,  // packets after a missing one before it is lost
+        Resync = 64        // packets a sequence may jump by before the stream is taken to have restarted
+    };
+
+    // Receiving thread: takes a packet of frames, the first of which is at timestamp, in
+    // frames, on the sender's clock. A new ssrc is a new stream.
+    void push(uint32_t ssrc, uint16_t sequence, uint32_t timestamp, const float * const * channels, int frames,
+              double arrivalSeconds);
+
+    // Render thread: reads frames into channels, returning how many were played; the rest
+    // are silence. A null channel is discarded.
+    int pull(float * const * channels, int frames);
+
+    int channelCount() const { return _channels; }
+
+    uint64_t packetsReceived() const { return _packetsReceived.load(std::memory_order_relaxed); }
+    uint64_t packetsLost() const { return _packetsLost.load(std::memory_order_relaxed); }
+    uint64_t packetsLate() const { return _packetsLate.load(std::memory_order_relaxed); }
+    uint64_t droppedFrames() const { return _droppedFrames.load(std::memory_order_relaxed); }
+    uint64_t underrunFrames() const { return _underrunFrames.load(std::memory_order_relaxed); }
+    double jitterSeconds() const { return _jitterFrames.load(std::memory_order_relaxed) / _sampleRate; }
+    double latencySeconds() const { return _targetFrames.load(std::memory_order_relaxed) / _sampleRate; }
+
+private:
+    JitterBuffer(const JitterBuffer &) = delete;
+    JitterBuffer & operator=(const JitterBuffer &) = delete;
+
+    struct Slot
+    {
+        std::vector<float> data;  // planar, maxPacketFrames per channel
+        int frames = 0;
+        bool full = false;
+    };
+
+    void resync(uint32_t ssrc, uint16_t sequence);
+    void advance();  // writes the expected packet, or its concealment, to the ring
+    void deliver(const float * data, int frames);
+    void updateTarget();
+
+    const int _channels;
+    const int _maxPacketFrames;
+    const int _renderQuantum;
+    const float _sampleRate;
+    const int _minFrames;
+    const int _maxFrames;
+
+    AudioRingBuffer _ring;
+
+    // owned by the receiving thread
+    Slot _slots[Slots];
+    bool _started = false;
+    uint32_t _ssrc = 0;
+    uint16_t _expected = 0;
+    uint16_t _newest = 0;
+    int _packetFrames = 0;      // the last packet's
+    double _lastArrival = 0;    // of the last packet, in seconds
+    uint32_t _lastTimestamp = 0;
+    bool _haveTransit = false;
+    double _jitter = 0;         // in frames
+    std::vector<float> _last;   // the last packet delivered, for concealing a lost one
+    int _lastFrames = 0;
+    bool _concealing = false;
+    std::vector<float> _scratch;
+    std::vector<const float *> _sources;
+
+    // owned by the render thread
+    bool _playing = false;
+
+    std::atomic<int> _targetFrames;
+    std::atomic<float> _jitterFrames {0.f};
+    std::atomic<uint64_t> _packetsReceived {0};
+    std::atomic<uint64_t> _packetsLost {0};
+    std::atomic<uint64_t> _packetsLate {0};
+    std::atomic<uint64_t> _droppedFrames {0};
+    std::atomic<uint64_t> _underrunFrames {0};
+};
+
+}  // namespace lab
+
+#endif  // JitterBuffer_h
@@ -0,0 +1,267 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef Lanes4_h
+#define Lanes4_h
+
+#include "LabSound/core/Macros.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+#if defined(WASM_SIMD128_INTRINSICS)
+#include <wasm_simd128.h>
+#endif
+
+namespace lab
+{
+
+// Lanes4 holds four floats in a SIMD register, SSE2, NEON or wasm SIMD128 where available, so that
+// kernels written once as templates over float and Lanes4 can process four frames or
+// voices at a time. Comparisons produce a Mask4, for select to choose lanes by. The
+// helpers have float overloads of the same names, which don't clash with std's, and
+// splitExponent and scaleByPowerOf2 work on the bits of positive normal floats, for
+// approximations of logarithms and exponentials.
+
+#if defined(__SSE2__)
+struct Lanes4
+{
+    __m128 v;
+    Lanes4(__m128 v_) : v(v_) {}
+    Lanes4(float f) : v(_mm_set1_ps(f)) {}
+    static Lanes4 load(const float * p) { return _mm_loadu_ps(p); }
+    void store(float * p) const { _mm_storeu_ps(p, v); }
+    float sum() const
+    {
+        __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+struct Mask4 { __m128 m; };
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { return _mm_add_ps(a.v, b.v); }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b) { return _mm_div_ps(a.v, b.v); }
+inline Mask4 operator<(Lanes4 a, Lanes4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask4 operator<=(Lanes4 a, Lanes4 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Mask4 operator>(Lanes4 a, Lanes4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Mask4 operator>=(Lanes4 a, Lanes4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Lanes4 select(Mask4 c, Lanes4 a, Lanes4 b) { return _mm_or_ps(_mm_and_ps(c.m, a.v), _mm_andnot_ps(c.m, b.v)); }
+inline Lanes4 minOf(Lanes4 a, Lanes4 b) { return _mm_min_ps(a.v, b.v); }
+inline Lanes4 maxOf(Lanes4 a, Lanes4 b) { return _mm_max_ps(a.v, b.v); }
+inline Lanes4 absOf(Lanes4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline Lanes4 sqrtOf(Lanes4 a) { return _mm_sqrt_ps(a.v); }
+inline Lanes4 floorOf(Lanes4 a)
+{
+    const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.f)));
+}
+inline Lanes4 splitExponent(Lanes4 x, Lanes4 & mantissa)
+{
+    const __m128i bits = _mm_castps_si128(x.v);
+    mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+    return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+}
+inline Lanes4 scaleByPowerOf2(Lanes4 x, Lanes4 n)
+{
+    const __m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n.v), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(x.v, _mm_castsi128_ps(scale));
+}
+#elif defined(ARM_NEON_INTRINSICS)
+struct Lanes4
+{
+    float32x4_t v;
+    Lanes4(float32x4_t v_) : v(v_) {}
+    Lanes4(float f) : v(vdupq_n_f32(f)) {}
+    static Lanes4 load(const float * p) { return vld1q_f32(p); }
+    void store(float * p) const { vst1q_f32(p, v); }
+    float sum() const
+    {
+        const float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(pair, pair), 0);
+    }
+};
+struct Mask4 { uint32x4_t m; };
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { return vaddq_f32(a.v, b.v); }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { return vsubq_f32(a.v, b.v); }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { return vmulq_f32(a.v, b.v); }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b)
+{
+#if defined(__aarch64__)
+    return vdivq_f32(a.v, b.v);
+#else
+    float32x4_t r = vrecpeq_f32(b.v);
+    r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+    r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+    return vmulq_f32(a.v, r);
+#endif
+}
+inline Mask4 operator<(Lanes4 a, Lanes4 b) { return {vcltq_f32(a.v, b.v)}; }
+inline Mask4 operator<=(Lanes4 a, Lanes4 b) { return {vcleq_f32(a.v, b.v)}; }
+inline Mask4 operator>(Lanes4 a, Lanes4 b) { return {vcgtq_f32(a.v, b.v)}; }
+inline Mask4 operator>=(Lanes4 a, Lanes4 b) { return {vcgeq_f32(a.v, b.v)}; }
+inline Lanes4 select(Mask4 c, Lanes4 a, Lanes4 b) { return vbslq_f32(c.m, a.v, b.v); }
+inline Lanes4 minOf(Lanes4 a, Lanes4 b) { return vminq_f32(a.v, b.v); }
+inline Lanes4 maxOf(Lanes4 a, Lanes4 b) { return vmaxq_f32(a.v, b.v); }
+inline Lanes4 absOf(Lanes4 a) { return vabsq_f32(a.v); }
+inline Lanes4 sqrtOf(Lanes4 a)
+{
+#if defined(__aarch64__)
+    return vsqrtq_f32(a.v);
+#else
+    // a times its reciprocal square root, refined twice; zero would be zero times infinity
+    float32x4_t r = vrsqrteq_f32(a.v);
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+    return vbslq_f32(vceqq_f32(a.v, vdupq_n_f32(0.f)), a.v, vmulq_f32(a.v, r));
+#endif
+}
+inline Lanes4 floorOf(Lanes4 a)
+{
+    const float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(a.v));
+    return vsubq_f32(t, vbslq_f32(vcgtq_f32(t, a.v), vdupq_n_f32(1.f), vdupq_n_f32(0.f)));
+}
+inline Lanes4 splitExponent(Lanes4 x, Lanes4 & mantissa)
+{
+    const uint32x4_t bits = vreinterpretq_u32_f32(x.v);
+    mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000)));
+    return vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+}
+inline Lanes4 scaleByPowerOf2(Lanes4 x, Lanes4 n)
+{
+    const int32x4_t scale = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n.v), vdupq_n_s32(127)), 23);
+    return vmulq_f32(x.v, vreinterpretq_f32_s32(scale));
+}
+#elif defined(WASM_SIMD128_INTRINSICS)
+struct Lanes4
+{
+    v128_t v;
+    Lanes4(v128_t v_) : v(v_) {}
+    Lanes4(float f) : v(wasm_f32x4_splat(f)) {}
+    static Lanes4 load(const float * p) { return wasm_v128_load(p); }
+    void store(float * p) const { wasm_v128_store(p, v); }
+    float sum() const
+    {
+        const v128_t pair = wasm_f32x4_add(v, wasm_i32x4_shuffle(v, v, 2, 3, 0, 1));
+        return wasm_f32x4_extract_lane(pair, 0) + wasm_f32x4_extract_lane(pair, 1);
+    }
+};
+struct Mask4 { v128_t m; };
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { return wasm_f32x4_add(a.v, b.v); }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { return wasm_f32x4_sub(a.v, b.v); }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { return wasm_f32x4_mul(a.v, b.v); }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b) { return wasm_f32x4_div(a.v, b.v); }
+inline Mask4 operator<(Lanes4 a, Lanes4 b) { return {wasm_f32x4_lt(a.v, b.v)}; }
+inline Mask4 operator<=(Lanes4 a, Lanes4 b) { return {wasm_f32x4_le(a.v, b.v)}; }
+inline Mask4 operator>(Lanes4 a, Lanes4 b) { return {wasm_f32x4_gt(a.v, b.v)}; }
+inline Mask4 operator>=(Lanes4 a, Lanes4 b) { return {wasm_f32x4_ge(a.v, b.v)}; }
+inline Lanes4 select(Mask4 c, Lanes4 a, Lanes4 b) { return wasm_v128_bitselect(a.v, b.v, c.m); }
+// pmin and pmax choose as SSE's min and max do, and are single instructions on x86 hosts
+inline Lanes4 minOf(Lanes4 a, Lanes4 b) { return wasm_f32x4_pmin(a.v, b.v); }
+inline Lanes4 maxOf(Lanes4 a, Lanes4 b) { return wasm_f32x4_pmax(a.v, b.v); }
+inline Lanes4 absOf(Lanes4 a) { return wasm_f32x4_abs(a.v); }
+inline Lanes4 sqrtOf(Lanes4 a) { return wasm_f32x4_sqrt(a.v); }
+inline Lanes4 floorOf(Lanes4 a) { return wasm_f32x4_floor(a.v); }
+inline Lanes4 splitExponent(Lanes4 x, Lanes4 & mantissa)
+{
+    mantissa = wasm_v128_or(wasm_v128_and(x.v, wasm_i32x4_splat(0x007fffff)), wasm_i32x4_splat(0x3f800000));
+    return wasm_f32x4_convert_i32x4(wasm_i32x4_sub(wasm_u32x4_shr(x.v, 23), wasm_i32x4_splat(127)));
+}
+inline Lanes4 scaleByPowerOf2(Lanes4 x, Lanes4 n)
+{
+    const v128_t scale = wasm_i32x4_shl(wasm_i32x4_add(wasm_i32x4_trunc_sat_f32x4(n.v), wasm_i32x4_splat(127)), 23);
+    return wasm_f32x4_mul(x.v, scale);
+}
+#else
+struct Lanes4
+{
+    float v[4];
+    Lanes4() = default;
+    Lanes4(float f) : v {f, f, f, f} {}
+    static Lanes4 load(const float * p) { Lanes4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+    void store(float * p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+    float sum() const { return (v[0] + v[1]) + (v[2] + v[3]); }
+};
+struct Mask4 { bool m[4]; };
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] /= b.v[i]; return a; }
+inline Mask4 operator<(Lanes4 a, Lanes4 b) { Mask4 c; for (int i = 0; i < 4; ++i) c.m[i] = a.v[i] < b.v[i]; return c; }
+inline Mask4 operator<=(Lanes4 a, Lanes4 b) { Mask4 c; for (int i = 0; i < 4; ++i) c.m[i] = a.v[i] <= b.v[i]; return c; }
+inline Mask4 operator>(Lanes4 a, Lanes4 b) { Mask4 c; for (int i = 0; i < 4; ++i) c.m[i] = a.v[i] > b.v[i]; return c; }
+inline Mask4 operator>=(Lanes4 a, Lanes4 b) { Mask4 c; for (int i = 0; i < 4; ++i) c.m[i] = a.v[i] >= b.v[i]; return c; }
+inline Lanes4 select(Mask4 c, Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] = c.m[i] ? a.v[i] : b.v[i]; return a; }
+inline Lanes4 minOf(Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline Lanes4 maxOf(Lanes4 a, Lanes4 b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline Lanes4 absOf(Lanes4 a) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] < 0 ? -a.v[i] : a.v[i]; return a; }
+inline Lanes4 sqrtOf(Lanes4 a) { for (int i = 0; i < 4; ++i) a.v[i] = std::sqrt(a.v[i]); return a; }
+inline Lanes4 floorOf(Lanes4 a)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        const float t = static_cast<float>(static_cast<int32_t>(a.v[i]));
+        a.v[i] = t > a.v[i] ? t - 1.f : t;
+    }
+    return a;
+}
+#endif
+
+inline float select(bool c, float a, float b) { return c ? a : b; }
+inline float minOf(float a, float b) { return a < b ? a : b; }
+inline float maxOf(float a, float b) { return a > b ? a : b; }
+inline float absOf(float a) { return a < 0 ? -a : a; }
+inline float sqrtOf(float a) { return std::sqrt(a); }
+inline float floorOf(float a)
+{
+    const float t = static_cast<float>(static_cast<int32_t>(a));
+    return t > a ? t - 1.f : t;
+}
+
+// The exponent of x and its mantissa in [1, 2), for positive normal x
+inline float splitExponent(float x, float & mantissa)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const uint32_t m = (bits & 0x007fffff) | 0x3f800000;
+    std::memcpy(&mantissa, &m, sizeof(mantissa));
+    return static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+}
+
+// x * 2^n, for integral n in [-126, 127]
+inline float scaleByPowerOf2(float x, float n)
+{
+    const uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return x * scale;
+}
+
+#if !defined(__SSE2__) && !defined(ARM_NEON_INTRINSICS) && !defined(WASM_SIMD128_INTRINSICS)
+inline Lanes4 splitExponent(Lanes4 x, Lanes4 & mantissa)
+{
+    Lanes4 e;
+    for (int i = 0; i < 4; ++i)
+        e.v[i] = splitExponent(x.v[i], mantissa.v[i]);
+    return e;
+}
+inline Lanes4 scaleByPowerOf2(Lanes4 x, Lanes4 n)
+{
+    for (int i = 0; i < 4; ++i)
+        x.v[i] = scaleByPowerOf2(x.v[i], n.v[i]);
+    return x;
+}
+#endif
+
+}  // namespace lab
+
+#endif  // Lanes4_h
@@ -0,0 +1,101 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LookupTables_h
+#define LookupTables_h
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace lab
+{
+
+// Tables of the functions that scalar hot paths evaluate per sample or per bin, with
+// interpolated lookups. The tables are generated by constexpr functions, so they are
+// built by the compiler and lie in the binary's read only data, costing nothing at
+// startup, and are small enough to stay in cache: a turn of sine in 2048 steps, within
+// 1.3e-6, and 2^x and log2 over an octave in 256 steps, so that decibels convert to gains
+// within 2e-6 relative, and gains to decibels within 3e-5 dB. FastMath's polynomials remain the choice where four lanes
+// are evaluated at once, as a table can't be read a lane at a time.
+namespace LookupTables
+{
+    enum : int
+    {
+        SineSize = 2048,
+        OctaveSize = 256
+    };
+
+    // size + 1 values, the last repeating the first period's end, so that interpolation
+    // never wraps
+    template <int Size>
+    struct Table
+    {
+        float values[Size + 1];
+    };
+
+    extern const Table<SineSize> sineTurn;        // sin(2 pi i / SineSize)
+    extern const Table<OctaveSize> exp2Octave;    // 2^(i / OctaveSize)
+    extern const Table<OctaveSize> log2Octave;    // log2(1 + i / OctaveSize)
+
+    template <int Size>
+    inline float interpolate(const Table<Size> & table, float position)
+    {
+        const int i = static_cast<int>(position);
+        const float f = position - static_cast<float>(i);
+        return table.values[i] + f * (table.values[i + 1] - table.values[i]);
+    }
+
+    // sin(2 pi turns), for any number of turns
+    inline float sine(float turns)
+    {
+        const float t = turns - std::floor(turns);
+        return interpolate(sineTurn, t * SineSize);
+    }
+
+    // The gains of the equal power pan law, cos(x pi/2) to the left and sin(x pi/2) to the
+    // right, for x clamped to [0, 1], from a quarter turn of the sine table
+    inline void equalPower(float x, float & left, float & right)
+    {
+        x = x < 0.f ? 0.f : (x > 1.f ? 1.f : x);
+        left = interpolate(sineTurn, (1.f - x) * (SineSize / 4));
+        right = interpolate(sineTurn, x * (SineSize / 4));
+    }
+
+    // 2^x, clamped to the normal floats
+    inline float exp2(float x)
+    {
+        x = x < -126.f ? -126.f : (x > 127.f ? 127.f : x);
+        const float n = std::floor(x);
+        const uint32_t bits = static_cast<uint32_t>(static_cast<int>(n) + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, sizeof(scale));
+        return scale * interpolate(exp2Octave, (x - n) * OctaveSize);
+    }
+
+    // log2(x), for x positive and finite
+    inline float log2(float x)
+    {
+        // subnormals are scaled up into the normal range first
+        float bias = 0.f;
+        if (x < 1.17549435e-38f)
+        {
+            x *= 18446744073709551616.f;  // 2^64
+            bias = -64.f;
+        }
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        const int exponent = static_cast<int>(bits >> 23) - 127;
+        bits = (bits & 0x007fffffu) | 0x3f800000u;
+        float mantissa;  // in [1, 2)
+        memcpy(&mantissa, &bits, sizeof(mantissa));
+        return bias + static_cast<float>(exponent) + interpolate(log2Octave, (mantissa - 1.f) * OctaveSize);
+    }
+
+    inline float decibelsToLinear(float db) { return exp2(db * 0.16609640474436813f); }
+    inline float linearToDecibels(float x) { return 6.020599913279624f * log2(x); }
+}
+
+}  // namespace lab
+
+#endif  // LookupTables_h
@@ -0,0 +1,89 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef LoudnessMeter_h
+#define LoudnessMeter_h
+
+#include <cstdint>
+
+namespace lab
+{
+
+class AudioBus;
+
+// The measurement behind LoudnessMeterNode, as ITU-R BS.1770-4 and EBU R128 describe,
+// for any caller that can hand it a bus at a time: the channels are K-weighted four at
+// a time in SIMD lanes, their weighted mean squares gathered into 100 ms blocks, and
+// the true peak found by oversampling four times. See LoudnessMeterNode for the details.
+//
+// Frames are metered a block at a time; a caller runs no more than the frames left in
+// the block, and finishes the block once blockPosition reaches blockFrames.
+struct LoudnessMeter
+{
+    enum
+    {
+        MaxChannels = 16,
+        Groups = MaxChannels / 4,
+        TruePeakTaps = 12,
+        ShortTermBlocks = 30,
+        HistogramBins = 800  // up to +10 LUFS; anything louder is counted in the last bin
+    };
+
+    // b0, b1, b2, a1, a2 of a biquad, normalized by a0
+    struct Coefficients
+    {
+        float b0, b1, b2, a1, a2;
+    };
+
+    float sampleRate = 0;
+    int channels = 0;
+    int layout = -1;
+
+    Coefficients shelf;
+    Coefficients highpass;
+    float weights[Groups][4];
+
+    // the filters' states, a lane per channel
+    float shelfState[Groups][2][4];
+    float highpassState[Groups][2][4];
+
+    // the last TruePeakTaps input frames, twice over, so that they can be read in order
+    // from any starting point without wrapping
+    float history[Groups][TruePeakTaps * 2][4];
+    int historyIndex = 0;
+    float peak[Groups][4];
+
+    // the block being gathered, and the mean squares of the ones before it
+    int blockFrames = 0;
+    int blockPosition = 0;
+    double blockEnergy = 0;
+    double blocks[ShortTermBlocks];
+    uint64_t blockCount = 0;
+
+    uint32_t histogramCount[HistogramBins];
+    double histogramEnergy[HistogramBins];
+
+    // Up to MaxChannels channels, in a speaker layout as AudioBus names them
+    void configure(float sampleRate, int channels, int layout);
+
+    void resetFilters();
+    void resetIntegration();
+
+    // Meters frames [offset, offset + count) of the bus, which lie within one block
+    void run(const AudioBus * bus, int offset, int count);
+
+    // Closes the block, and updates the measurements, in LUFS and dBTP, minus infinity
+    // for silence
+    void finishBlock(float & momentary, float & shortTerm, float & integrated, float & truePeak);
+
+    // The greatest true peak of any channel since the integration was reset, including
+    // the frames of the block being gathered
+    float truePeak() const;
+
+private:
+    void setWeights();
+};
+
+}  // namespace lab
+
+#endif  // LoudnessMeter_h
@@ -0,0 +1,48 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lab
+{
+
+// A read only mapping of a whole file, unmapped when the last owner lets it go. Pages are
+// read in as they are touched, and are shared through the page cache by every process
+// mapping the same file.
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    // returns null if the file doesn't exist or can't be mapped
+    static std::shared_ptr<MappedFile> open(const std::string & path);
+
+    const uint8_t * data() const { return _data; }
+    size_t size() const { return _size; }
+
+    // Asks for a range of the file to be read in, and touches each of its pages, so that
+    // reading it later doesn't wait on the disk. Blocks while they are read in, and so is
+    // for a background thread.
+    void prefetch(size_t offset, size_t length) const;
+
+private:
+    MappedFile() = default;
+
+    const uint8_t * _data = nullptr;
+    size_t _size = 0;
+    void * _file = nullptr;     // Windows handles
+    void * _mapping = nullptr;
+};
+
+}  // namespace lab
+
+#endif  // MappedFile_h
@@ -0,0 +1,74 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef MixingMatrix_h
+#define MixingMatrix_h
+
+#include "LabSound/core/Mixing.h"
+
+#include <vector>
+
+namespace lab
+{
+
+class AudioBus;
+
+// A MixingMatrix up or down mixes the channels of a bus in one speaker layout into a
+// bus in another, each destination channel being a weighted sum of source channels.
+//
+// Layouts are registered once, off the audio thread, and every registration makes the
+// matrices between the new layout and each one registered before it, so finding one
+// on the audio thread is an array lookup that never locks or allocates. The standard
+// layouts are registered first, with the ids AudioBus names, and mix as the Web Audio
+// specification describes; other pairs of layouts route each source channel missing
+// from the destination to its nearest neighbours there.
+class MixingMatrix
+{
+public:
+    enum : int
+    {
+        MaxLayouts = 64,
+        MaxChannels = 32
+    };
+
+    // Returns the id of the layout with the given channel positions, registering it if
+    // it is new. Throws std::invalid_argument if the positions are invalid or repeat,
+    // or if MaxLayouts have already been registered.
+    static int registerLayout(const Channel * positions, int count);
+
+    // The id of the standard layout of a number of channels, or zero if there is none.
+    static int canonicalLayout(int channels);
+
+    // The number of channels of a registered layout, or zero if the id isn't one.
+    static int layoutChannels(int layout);
+
+    // The index of the channel at a position in a layout, or -1 if it has none there.
+    static int channelIndex(int layout, Channel position);
+
+    // The matrix mixing one registered layout into another, or nullptr if either id
+    // isn't one. Any thread.
+    static const MixingMatrix * find(int sourceLayout, int destinationLayout);
+
+    // Mix source into destination, replacing or adding to what is there. The busses
+    // must have the channel counts of the layouts the matrix was found for.
+    void copy(const AudioBus & source, AudioBus & destination) const;
+    void sum(const AudioBus & source, AudioBus & destination) const;
+
+    MixingMatrix(const std::vector<Channel> & source, const std::vector<Channel> & destination);
+
+private:
+    struct Term
+    {
+        int source;
+        float gain;
+    };
+
+    void mix(const AudioBus & source, AudioBus & destination, bool accumulate) const;
+
+    // the terms of each destination channel, in channel order; a channel with none is silent
+    std::vector<std::vector<Term>> m_terms;
+};
+
+}  // namespace lab
+
+#endif  // MixingMatrix_h
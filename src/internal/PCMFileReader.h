@@ -0,0 +1,59 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef PCMFileReader_h
+#define PCMFileReader_h
+
+#include "internal/SampleConversion.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+// PCMFileReader reads frames from anywhere in an uncompressed WAV file, without loading
+// the file, so that long files can be streamed. 16 and 24 bit integer and 32 bit float
+// samples are supported, including in WAVE_FORMAT_EXTENSIBLE and RF64 files.
+class PCMFileReader
+{
+public:
+    PCMFileReader() = default;
+    ~PCMFileReader();
+
+    PCMFileReader(const PCMFileReader &) = delete;
+    PCMFileReader & operator=(const PCMFileReader &) = delete;
+
+    // Returns false if the file can't be opened or isn't a supported WAV file
+    bool open(const std::string & path);
+    void close();
+    bool isOpen() const { return m_file != nullptr; }
+
+    int channelCount() const { return m_channels; }
+    float sampleRate() const { return m_sampleRate; }
+    uint64_t lengthInFrames() const { return m_frames; }
+
+    // Where the interleaved frames begin in the file, and their sample format
+    uint64_t dataOffset() const { return m_dataOffset; }
+    SampleConversion::SampleFormat format() const { return m_format; }
+
+    // Reads up to count frames starting at frame into a plane for each channel, and
+    // returns the number read; fewer than count are read at the end of the file.
+    int read(uint64_t frame, int count, float * const * channels);
+
+private:
+    FILE * m_file = nullptr;
+    int m_channels = 0;
+    float m_sampleRate = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_dataOffset = 0;
+    SampleConversion::SampleFormat m_format = SampleConversion::SampleFormat::Int16;
+    int m_frameBytes = 0;
+    std::vector<uint8_t> m_scratch;
+};
+
+}  // namespace lab
+
+#endif  // PCMFileReader_h
@@ -0,0 +1,64 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef PCMFileWriter_h
+#define PCMFileWriter_h
+
+#include "internal/RecordingFile.h"
+#include "internal/SampleConversion.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+// PCMFileWriter appends interleaved frames to an uncompressed WAV file, or to a headerless
+// raw file, so that recordings of any length can be written as they are made. The WAV
+// header is brought up to date as the file grows, so that a file cut short is still
+// readable up to its last update. A WAV file that outgrows the four gigabytes RIFF can
+// describe becomes an RF64 file when it is closed, in the space a JUNK chunk holds for it.
+class PCMFileWriter : public RecordingFile
+{
+public:
+    PCMFileWriter() = default;
+    virtual ~PCMFileWriter();
+
+    PCMFileWriter(const PCMFileWriter &) = delete;
+    PCMFileWriter & operator=(const PCMFileWriter &) = delete;
+
+    // Returns false if the file can't be created
+    bool open(const std::string & path, int channels, float sampleRate, SampleConversion::SampleFormat format, bool raw);
+
+    // Changes the channels of a file nothing has been written to yet
+    virtual bool setChannelCount(int channels) override;
+
+    // Returns false if the file couldn't be written, or isn't open
+    virtual bool write(const float * interleaved, int frames) override;
+
+    // Rewrites the header for the frames written so far
+    virtual bool updateHeader() override;
+
+    // Updates the header and closes the file; returns false if any write failed
+    virtual bool close() override;
+
+    bool isOpen() const { return m_file != nullptr; }
+    virtual int channels() const override { return m_channels; }
+    virtual uint64_t framesWritten() const override { return m_frames; }
+
+private:
+    FILE * m_file = nullptr;
+    int m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    SampleConversion::SampleFormat m_format = SampleConversion::SampleFormat::Float32;
+    bool m_raw = false;
+    bool m_failed = false;
+    uint64_t m_frames = 0;
+    std::vector<uint8_t> m_scratch;
+};
+
+}  // namespace lab
+
+#endif  // PCMFileWriter_h
@@ -0,0 +1,206 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef PartitionedConvolver_h
+#define PartitionedConvolver_h
+
+#include "LabSound/core/AudioArray.h"
+
+#include "internal/DirectConvolver.h"
+#include "internal/FFTFrame.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+class ConvolutionBatch;
+
+// Convolves a signal with an impulse response, with no latency.
+//
+// The first few frames of the impulse response are applied directly in the time
+// domain. The rest is split into partitions that grow in size further into the
+// response, each group of equal partitions being applied by a uniformly partitioned
+// overlap-save convolution in the frequency domain. Small partitions early on keep
+// the latency at zero, and large partitions for the tail keep long responses cheap.
+// The largest partitions are convolved on a worker thread, so that the audio thread
+// never has to do an FFT of a size the tail needs.
+//
+// Several responses of the same length may be applied to one input, as the channels of
+// a multichannel or true stereo response are. Each partition of input is then transformed
+// once, and its spectrum is multiplied with every response's partitions.
+//
+// The transformed partitions may be kept in half precision, each partition scaled by a
+// power of two to make the most of the format's range. That halves the memory a response
+// takes, and the memory traffic of convolving it, for an error more than 60 dB below the
+// response's spectrum.
+//
+// Convolvers given a ConvolutionBatch leave their frequency domain products to it, and
+// convolve their whole tail on the calling thread, with no worker; that is for rendering
+// offline, where the tail is never dropped, and the result is the same as without one.
+class PartitionedConvolver
+{
+public:
+    enum class Precision : int
+    {
+        Float,
+        Half
+    };
+
+    // blockSize is the number of frames every call to process() will be asked for,
+    // and must be a power of two. The impulse response is copied. If another convolver
+    // with the same block size already has the same impulse response, its transformed
+    // partitions are shared rather than computed again.
+    PartitionedConvolver(const float * impulseResponse, int impulseLength, int blockSize,
+                         Precision precision = Precision::Float, ConvolutionBatch * batch = nullptr);
+
+    // A convolver of one input with responseCount responses of the same length, at most
+    // MaxResponses of them.
+    PartitionedConvolver(const float * const * impulseResponses, int responseCount, int impulseLength, int blockSize,
+                         Precision precision = Precision::Float, ConvolutionBatch * batch = nullptr);
+
+    // A convolver of the same impulse response with its own state. The transformed
+    // impulse response is shared rather than computed again, as is the batch, if any.
+    PartitionedConvolver(const PartitionedConvolver & other);
+
+    ~PartitionedConvolver();
+
+    // framesToProcess must equal the block size. Processing in-place is allowed.
+    // The worker is given as long as a partition of the tail lasts to convolve it, and the
+    // tail is dropped if it is late. When rendering faster than real time, waitForTail has
+    // the caller wait for the worker instead.
+    void process(const float * sourceP, float * destP, int framesToProcess, bool waitForTail = false);
+
+    // Writes the input convolved with each response to the corresponding destination. A
+    // response whose destination is null is skipped, and resumes from silence; the input
+    // is still taken in, so the responses that are applied stay continuous.
+    void process(const float * sourceP, float * const * destP, int framesToProcess, bool waitForTail = false);
+
+    void reset();
+
+    int blockSize() const { return m_blockSize; }
+    int impulseLength() const { return m_impulseLength; }
+    int responseCount() const { return static_cast<int>(m_partitions.size()); }
+
+    enum : int
+    {
+        MaxPartitionSize = 8192,         // the largest partition of the tail, which bounds the size of the FFTs
+        BackgroundPartitionSize = 2048,  // partitions this large and larger are convolved on the worker
+        MaxResponses = 32
+    };
+
+private:
+    friend class ConvolutionBatch;
+
+    PartitionedConvolver & operator=(const PartitionedConvolver &) = delete;
+
+    struct Partitions;
+    struct Stage;
+    struct BackgroundStage;
+
+    void createStages();
+    void workerEntry();
+    void wakeWorker();  // doesn't block
+
+    int m_blockSize;
+    int m_impulseLength;
+    ConvolutionBatch * m_batch = nullptr;
+
+    std::vector<std::shared_ptr<const Partitions>> m_partitions;  // one per response
+
+    std::vector<std::unique_ptr<AudioFloatArray>> m_headKernels;
+    std::vector<std::unique_ptr<DirectConvolver>> m_heads;
+    AudioFloatArray m_source;  // a copy of the input when processing in place
+    std::vector<std::unique_ptr<Stage>> m_stages;
+    std::vector<std::unique_ptr<BackgroundStage>> m_backgroundStages;
+
+    std::thread m_worker;
+    std::mutex m_workerMutex;
+    std::condition_variable m_workerWake;
+    std::atomic<bool> m_quit {false};
+};
+
+// Collects the frequency domain multiply-accumulates of the convolvers sharing it, so that
+// the products of many channels' partitions are computed together, in one dispatch. A stage
+// whose partitions are at least the block size only completes a partition at the end of a
+// block, and plays its result from the start of the next, so its products can wait until
+// every convolver has processed the block. flush() must then be called before any of them
+// processes the next. Smaller stages are convolved as they complete, as without a batch.
+//
+// The products are computed by a Backend. The default one computes them on the calling
+// thread with FFTFrame, just as a convolver does itself. A compute backend, as on a GPU,
+// must zero each accumulation's frame and add its products in the order given, in single
+// precision and without fused multiply-adds, for the output to match the CPU's exactly.
+class ConvolutionBatch
+{
+public:
+    // The product of a partition of input and a partition of a response. The response's
+    // partition is in single precision, or else in half precision, multiplied by scale.
+    struct Product
+    {
+        const float * inputReal;
+        const float * inputImag;
+        const float * real = nullptr;
+        const float * imag = nullptr;
+        const uint16_t * halfReal = nullptr;
+        const uint16_t * halfImag = nullptr;
+        float scale = 1.f;
+    };
+
+    // The sum of products for one response and one partition of input, left in frame
+    struct Accumulation
+    {
+        FFTFrame * frame;
+        int firstProduct;
+        int productCount;
+    };
+
+    class Backend
+    {
+    public:
+        virtual ~Backend() = default;
+
+        // Called from the rendering thread, for every accumulation of a flush at once. A
+        // backend may be shared by several batches, and called from several threads.
+        virtual void accumulate(const Accumulation * accumulations, int accumulationCount, const Product * products) = 0;
+    };
+
+    // A null backend is the default one at the time
+    explicit ConvolutionBatch(std::shared_ptr<Backend> backend = nullptr);
+    ~ConvolutionBatch();
+
+    // Computes the products deferred since the last flush, and the results they're for
+    void flush();
+
+    // The backend batches are made with; setting null restores the CPU's
+    static void setDefaultBackend(std::shared_ptr<Backend> backend);
+    static std::shared_ptr<Backend> defaultBackend();
+
+private:
+    ConvolutionBatch(const ConvolutionBatch &) = delete;
+    ConvolutionBatch & operator=(const ConvolutionBatch &) = delete;
+
+    friend class PartitionedConvolver;
+
+    struct Deferred
+    {
+        PartitionedConvolver::Stage * stage;
+        uint32_t mask;
+    };
+
+    void defer(PartitionedConvolver::Stage * stage, uint32_t mask) { m_deferred.push_back({stage, mask}); }
+
+    std::shared_ptr<Backend> m_backend;
+    std::vector<Deferred> m_deferred;
+    std::vector<Accumulation> m_accumulations;
+    std::vector<Product> m_products;
+};
+
+}  // namespace lab
+
+#endif  // PartitionedConvolver_h
@@ -0,0 +1,119 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef PolyBLEP_h
+#define PolyBLEP_h
+
+#include "LabSound/extended/PolyBLEPNode.h"
+
+#include "internal/Lanes4.h"
+
+namespace lab
+{
+
+// Branch free PolyBLEP kernels for the band limited waveforms used most, the step and
+// ramp shapes of virtual analog synthesis. Phases are in [0, 1) and dt is the phase
+// increment per frame, in (0, 0.5]. Each kernel evaluates both polynomial residuals and
+// selects between them, and is written once for float and for Lanes4, four values in a
+// SIMD register, so that frames or voices can be rendered four at a time.
+namespace PolyBLEP
+{
+
+    // The waveforms with kernels here, which are the first in PolyBLEPType
+    inline bool hasKernel(PolyBLEPType type)
+    {
+        return type == PolyBLEPType::TRIANGLE || type == PolyBLEPType::SQUARE || type == PolyBLEPType::RECTANGLE ||
+               type == PolyBLEPType::SAWTOOTH || type == PolyBLEPType::RAMP;
+    }
+
+    template <typename T>
+    inline T wrap(T t) { return select(t >= T(1.f), t - T(1.f), t); }
+
+    template <typename T>
+    inline T blep(T t, T dt, T rdt)
+    {
+        const T a = t * rdt - T(1.f);
+        const T b = (t - T(1.f)) * rdt + T(1.f);
+        return select(t < dt, T(0.f) - a * a, select(t > T(1.f) - dt, b * b, T(0.f)));
+    }
+
+    template <typename T>
+    inline T blamp(T t, T dt, T rdt)
+    {
+        const T a = t * rdt - T(1.f);
+        const T b = (t - T(1.f)) * rdt + T(1.f);
+        return select(t < dt, T(-1.f / 3.f) * a * a * a, select(t > T(1.f) - dt, T(1.f / 3.f) * b * b * b, T(0.f)));
+    }
+
+    struct Triangle
+    {
+        template <typename T>
+        static T sample(T t, T dt, T rdt, T)
+        {
+            const T t1 = wrap(t + T(0.25f));
+            const T t2 = wrap(t + T(0.75f));
+            const T y = T(4.f) * t;
+            const T shaped = select(y >= T(3.f), y - T(4.f), select(y > T(1.f), T(2.f) - y, y));
+            return shaped + T(4.f) * dt * (blamp(t1, dt, rdt) - blamp(t2, dt, rdt));
+        }
+    };
+
+    struct Square
+    {
+        template <typename T>
+        static T sample(T t, T dt, T rdt, T)
+        {
+            const T t2 = wrap(t + T(0.5f));
+            return select(t < T(0.5f), T(1.f), T(-1.f)) + blep(t, dt, rdt) - blep(t2, dt, rdt);
+        }
+    };
+
+    struct Rectangle
+    {
+        template <typename T>
+        static T sample(T t, T dt, T rdt, T pulseWidth)
+        {
+            const T t2 = wrap(t + T(1.f) - pulseWidth);
+            return select(t < pulseWidth, T(2.f), T(0.f)) - T(2.f) * pulseWidth + blep(t, dt, rdt) - blep(t2, dt, rdt);
+        }
+    };
+
+    struct Sawtooth
+    {
+        template <typename T>
+        static T sample(T t, T dt, T rdt, T)
+        {
+            const T t2 = wrap(t + T(0.5f));
+            return T(2.f) * t2 - T(1.f) - blep(t2, dt, rdt);
+        }
+    };
+
+    struct Ramp
+    {
+        template <typename T>
+        static T sample(T t, T dt, T rdt, T)
+        {
+            return T(1.f) - T(2.f) * t + blep(t, dt, rdt);
+        }
+    };
+
+    // Calls f with the kernel for type, which must have one
+    template <typename F>
+    inline void dispatch(PolyBLEPType type, F && f)
+    {
+        switch (type)
+        {
+            case PolyBLEPType::TRIANGLE: f(Triangle()); break;
+            case PolyBLEPType::SQUARE: f(Square()); break;
+            case PolyBLEPType::RECTANGLE: f(Rectangle()); break;
+            case PolyBLEPType::SAWTOOTH: f(Sawtooth()); break;
+            case PolyBLEPType::RAMP: f(Ramp()); break;
+            default: break;
+        }
+    }
+
+}  // namespace PolyBLEP
+
+}  // namespace lab
+
+#endif  // PolyBLEP_h
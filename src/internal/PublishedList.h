@@ -0,0 +1,94 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef PublishedList_h
+#define PublishedList_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lab
+{
+
+// A list written by other threads and read by the audio thread, read-copy-update style.
+// A writer builds a new version of the list and publishes it with a single atomic store;
+// the reader picks up the latest version with an atomic load, and never locks or waits.
+//
+// A replaced version is retired rather than freed, since the reader may still be using it.
+// The reader acknowledges each version it acquires, and a retired version older than the
+// one last acknowledged is freed on the writer's thread the next time one publishes, so
+// that releasing the list's items doesn't happen on the audio thread.
+//
+// Writers must be serialized by the caller; there may only be one reader.
+template <typename T>
+class PublishedList
+{
+public:
+    PublishedList() = default;
+    PublishedList(const PublishedList &) = delete;
+    PublishedList & operator=(const PublishedList &) = delete;
+
+    // Writer
+    void publish(std::vector<T> items)
+    {
+        std::unique_ptr<Version> version(new Version {std::move(items), m_nextGeneration++});
+        m_published.store(version.get(), std::memory_order_release);
+        m_versions.push_back(std::move(version));
+        reclaim();
+    }
+
+    // Reader. Takes up the latest published version, which stays valid until the next
+    // acquire, and returns true if it differs from the version previously acquired.
+    bool acquire()
+    {
+        Version * version = m_published.load(std::memory_order_acquire);
+        if (version == m_reading)
+            return false;
+
+        m_reading = version;
+        m_readGeneration.store(version->generation, std::memory_order_release);
+        return true;
+    }
+
+    // Reader. The version last acquired.
+    const std::vector<T> & items() const
+    {
+        static const std::vector<T> none;
+        return m_reading ? m_reading->items : none;
+    }
+
+private:
+    struct Version
+    {
+        std::vector<T> items;
+        uint64_t generation;
+    };
+
+    void reclaim()
+    {
+        // the reader never goes back to a version older than the one it acknowledged,
+        // and every version is older than the one published last
+        const uint64_t inUse = m_readGeneration.load(std::memory_order_acquire);
+        auto retired = m_versions.begin();
+        while (retired != m_versions.end() - 1 && (*retired)->generation < inUse)
+            ++retired;
+        m_versions.erase(m_versions.begin(), retired);
+    }
+
+    std::atomic<Version *> m_published {nullptr};
+    std::atomic<uint64_t> m_readGeneration {0};
+
+    // writer; oldest first, the last being the one published
+    std::vector<std::unique_ptr<Version>> m_versions;
+    uint64_t m_nextGeneration = 1;
+
+    // reader
+    Version * m_reading = nullptr;
+};
+
+}  // namespace lab
+
+#endif  // PublishedList_h
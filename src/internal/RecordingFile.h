@@ -0,0 +1,49 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef RecordingFile_h
+#define RecordingFile_h
+
+#include "LabSound/extended/RecorderNode.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lab
+{
+
+// A file a recording is streamed to, a block of interleaved frames at a time, from a
+// CaptureWriter's writer thread
+class RecordingFile
+{
+public:
+    virtual ~RecordingFile() = default;
+
+    // Changes the channels of a file nothing has been written to yet
+    virtual bool setChannelCount(int channels) = 0;
+
+    // Returns false if the file couldn't be written, or isn't open
+    virtual bool write(const float * interleaved, int frames) = 0;
+
+    // Brings the file's header up to date, so that a file cut short is readable up to here
+    virtual bool updateHeader() = 0;
+
+    // Finishes and closes the file; returns false if any write failed
+    virtual bool close() = 0;
+
+    virtual int channels() const = 0;
+    virtual uint64_t framesWritten() const = 0;
+};
+
+// Creates a file of the format at path, replacing any there; returns null if it can't be
+// created, or the format can't hold that many channels
+std::unique_ptr<RecordingFile> createRecordingFile(const std::string & path, int channels, float sampleRate,
+                                                   RecorderFileFormat format);
+
+// The extension, with its dot, of the format's files
+const char * recordingFileExtension(RecorderFileFormat format);
+
+}  // namespace lab
+
+#endif  // RecordingFile_h
@@ -0,0 +1,85 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef RenderThreadPool_h
+#define RenderThreadPool_h
+
+#include "LabSound/core/ThreadScheduling.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+// A dependency graph of render tasks, in compressed form. Task i may only run
+// once dependencyCount[i] of its predecessors have completed, and completing
+// it releases successors[successorOffsets[i] .. successorOffsets[i + 1]).
+struct RenderTaskGraph
+{
+    std::vector<int> dependencyCount;
+    std::vector<int> successorOffsets;
+    std::vector<int> successors;
+
+    int taskCount() const { return static_cast<int>(dependencyCount.size()); }
+
+    void clear()
+    {
+        dependencyCount.clear();
+        successorOffsets.clear();
+        successors.clear();
+    }
+};
+
+// A work-stealing pool that runs a RenderTaskGraph to completion. The calling
+// thread participates in the work, so a run completes even if no worker wakes
+// up in time, and run() does not heap allocate once reserve() has been called
+// with the graph's task count.
+class RenderThreadPool
+{
+public:
+    typedef void (*TaskFunction)(void * userData, int task);
+
+    // workerCount threads are started in addition to the thread calling run(), each
+    // scheduled as given
+    explicit RenderThreadPool(int workerCount, const ThreadScheduling & scheduling = ThreadScheduling());
+    ~RenderThreadPool();
+
+    int workerCount() const { return static_cast<int>(m_threads.size()); }
+
+    void reserve(int taskCount);
+
+    // blocks until every task of the graph has run
+    void run(const RenderTaskGraph & graph, TaskFunction fn, void * userData);
+
+private:
+    struct TaskQueue;
+
+    void workerLoop(int queueIndex, ThreadScheduling scheduling);
+    void execute(int queueIndex);
+    bool popOrSteal(int queueIndex, int & task);
+    void push(int queueIndex, int task);
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;  // [0] belongs to the caller of run()
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<std::atomic<int>[]> m_pending;
+    int m_capacity = 0;
+
+    const RenderTaskGraph * m_graph = nullptr;
+    TaskFunction m_fn = nullptr;
+    void * m_userData = nullptr;
+    std::atomic<int> m_remaining{0};
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint64_t> m_generation{0};
+    std::atomic<bool> m_shouldExit{false};
+};
+
+}  // namespace lab
+
+#endif  // RenderThreadPool_h
@@ -0,0 +1,50 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef RtpPacket_h
+#define RtpPacket_h
+
+#include "internal/SampleConversion.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lab
+{
+namespace RtpPacket
+{
+
+    // The fixed header of RFC 3550, without contributing sources or extensions
+    enum : int { HeaderBytes = 12 };
+
+    struct Header
+    {
+        uint8_t payloadType = 96;  // the first of the dynamic types
+        bool marker = false;       // set on the first packet of a stream
+        uint16_t sequence = 0;
+        uint32_t timestamp = 0;    // in frames
+        uint32_t ssrc = 0;         // identifies the stream
+    };
+
+    // Writes the header to the start of packet, which must have HeaderBytes
+    void writeHeader(const Header & header, uint8_t * packet);
+
+    // Reads the header of a packet, and where its payload starts and how long it is, past
+    // any contributing sources, extension and padding. Returns false if it isn't RTP.
+    bool readHeader(const uint8_t * packet, size_t bytes, Header & header, size_t & payloadOffset, size_t & payloadBytes);
+
+    // Encodes planar frames as interleaved samples in network byte order, as RTP's L16
+    // and L24 formats are; Float32 is sent the same way, as IEEE floats. Returns the bytes
+    // written to payload.
+    size_t encode(const float * const * channels, int channelCount, int frames, SampleConversion::SampleFormat format,
+                  uint8_t * payload);
+
+    // Decodes a payload into planar frames, returning how many it held; any partial
+    // frame at its end is ignored. payload is byte swapped in place.
+    int decode(uint8_t * payload, size_t bytes, SampleConversion::SampleFormat format, int channelCount,
+               float * const * channels);
+
+}  // namespace RtpPacket
+}  // namespace lab
+
+#endif  // RtpPacket_h
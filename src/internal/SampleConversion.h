@@ -0,0 +1,35 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef SampleConversion_h
+#define SampleConversion_h
+
+namespace lab
+{
+namespace SampleConversion
+{
+
+    // The sample formats of device buffers. Integers are little endian and signed, and
+    // Int24 samples are packed in three bytes.
+    enum class SampleFormat
+    {
+        Float32,
+        Int16,
+        Int24,
+    };
+
+    int bytesPerSample(SampleFormat format);
+
+    // Interleaves frames of the planar sources into destination, clipping them to [-1, 1]
+    // and converting them to format. All of the channels are written in one pass over the
+    // frames; mono and stereo float have SIMD paths.
+    void interleave(const float * const * sources, int channels, int frames, SampleFormat format, void * destination);
+
+    // Splits frames of the interleaved source, in format, into the planar destinations.
+    // Float samples are clipped to [-1, 1]. Mono int16 has a SIMD path.
+    void deinterleave(const void * source, SampleFormat format, int channels, int frames, float * const * destinations);
+
+}  // namespace SampleConversion
+}  // namespace lab
+
+#endif  // SampleConversion_h
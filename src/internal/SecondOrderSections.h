@@ -0,0 +1,28 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef SecondOrderSections_h
+#define SecondOrderSections_h
+
+#include <vector>
+
+namespace lab
+{
+
+// Factors the transfer function
+//
+//   H(z) = (b0 + b1 z^-1 + ... + bM z^-M) / (a0 + a1 z^-1 + ... + aN z^-N)
+//
+// into a cascade of second order sections, five normalized coefficients each (b0 b1 b2 a1
+// a2), as a BiquadBank takes them. The roots of the numerator and denominator are found,
+// complex ones paired with their conjugates, and each pair of poles is given the pair of
+// zeros nearest it, starting with the poles nearest the unit circle; the sections are
+// ordered with those poles last. The overall gain is applied in the first section.
+// feedback[0] must not be zero. Returns the largest pole radius, which is below one for a
+// stable filter.
+double decomposeToSections(const std::vector<double> & feedforward, const std::vector<double> & feedback,
+                           std::vector<double> & sections);
+
+}  // namespace lab
+
+#endif  // SecondOrderSections_h
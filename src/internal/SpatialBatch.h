@@ -0,0 +1,58 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef SpatialBatch_h
+#define SpatialBatch_h
+
+#include "LabSound/core/FloatPoint3D.h"
+
+namespace lab
+{
+
+class ConeEffect;
+class DistanceEffect;
+
+// The sources of a scene, as arrays of each coordinate, so that four sources at a time load
+// into Lanes4. Orientations may be null when only distances and directions are wanted.
+struct SpatialSources
+{
+    const float * x = nullptr;
+    const float * y = nullptr;
+    const float * z = nullptr;
+    const float * orientationX = nullptr;
+    const float * orientationY = nullptr;
+    const float * orientationZ = nullptr;
+    int count = 0;
+};
+
+struct SpatialListener
+{
+    FloatPoint3D position;
+    FloatPoint3D forward = {0.f, 0.f, -1.f};
+    FloatPoint3D up = {0.f, 1.f, 0.f};
+};
+
+// SpatialBatch evaluates what a PannerNode computes for its one source for a whole scene
+// of them against one listener, four at a time, in a single pass over each array, so that
+// a scene's sources can be updated together each quantum or frame. The results match the
+// scalar models to within FastMath's error, about 1e-4 degrees and a few parts in a million
+// of gain. A source at the listener has no direction, and is heard outside no cone.
+namespace SpatialBatch
+{
+    // Each source's distance from the listener
+    void distances(const SpatialListener & listener, const SpatialSources & sources, float * distances);
+
+    // The distance model's gain at each distance
+    void distanceGains(const DistanceEffect & effect, const float * distances, int count, float * gains);
+
+    // Each source's cone gain toward the listener
+    void coneGains(const ConeEffect & effect, const SpatialListener & listener, const SpatialSources & sources, float * gains);
+
+    // Each source's direction from the listener, in degrees, as PannerNode::azimuthElevation
+    void azimuthElevations(const SpatialListener & listener, const SpatialSources & sources,
+                           float * azimuths, float * elevations);
+}
+
+}  // namespace lab
+
+#endif  // SpatialBatch_h
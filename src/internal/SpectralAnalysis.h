@@ -0,0 +1,93 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef SpectralAnalysis_h
+#define SpectralAnalysis_h
+
+#include "LabSound/core/AudioArray.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace lab
+{
+
+class AudioBus;
+class AudioNodeInput;
+class ContextRenderLock;
+class FFTFrame;
+
+// A short time Fourier transform of a signal, for the nodes that analyse it.
+//
+// The signal's channels are averaged into a ring of recent frames as they are written, and
+// each time another hopSize frames have arrived, the fftSize frames ending there become the
+// latest analysis frame. A frame's spectrum is only computed when a consumer asks for it,
+// and then at most once however many consumers ask, so overlapping windows cost an FFT per
+// hop at most, and a spectrum nobody reads costs nothing.
+//
+// Nodes tapping the same output with the same sizes share an analysis. Each of them writes
+// the signal every quantum, and writes after the first in a quantum are ignored.
+class SpectralAnalysis
+{
+public:
+    // fftSize must be a power of two; hopSize is clamped to [1, fftSize]
+    SpectralAnalysis(int fftSize, int hopSize);
+    ~SpectralAnalysis();
+
+    SpectralAnalysis(const SpectralAnalysis &) = delete;
+    SpectralAnalysis & operator=(const SpectralAnalysis &) = delete;
+
+    int fftSize() const { return m_fftSize; }
+    int hopSize() const { return m_hopSize; }
+    int binCount() const { return m_fftSize / 2; }
+
+    // Audio thread. Appends the average of the bus's channels, unless the quantum starting
+    // at frame has already been written.
+    void write(uint64_t frame, const AudioBus * bus, int framesToProcess);
+
+    // Audio thread. The number of hops completed; a consumer that has already seen this
+    // count has seen the latest analysis frame.
+    uint64_t hops() const { return m_written / m_hopSize; }
+
+    // Audio thread. Copies the fftSize frames most recently written, oldest first.
+    void copyLatestFrames(float * destination) const;
+
+    // Audio thread. The magnitudes of the binCount bins of the latest analysis frame,
+    // windowed with a Blackman window and not normalized. The first request after a hop
+    // computes them.
+    const float * magnitudes();
+
+    // Audio thread
+    void reset();
+
+    // Audio thread. The analysis shared by the consumers of a tap with the sizes of own,
+    // which becomes the shared analysis if there isn't one. Never blocks or allocates; if
+    // the registry is busy or full, or there is no tap, own is returned unshared.
+    static std::shared_ptr<SpectralAnalysis> share(const void * tap, const std::shared_ptr<SpectralAnalysis> & own);
+
+    // Audio thread. The output feeding an input, if exactly one does, to use as a tap.
+    static const void * tapOf(ContextRenderLock &, AudioNodeInput *);
+
+private:
+    void copyFramesEndingAt(uint64_t end, float * destination) const;
+
+    int m_fftSize;
+    int m_hopSize;
+
+    // the mixed down signal, m_written frames of it having been written in all
+    AudioFloatArray m_ring;
+    int m_ringMask;
+    uint64_t m_written = 0;
+    uint64_t m_lastWriteFrame = ~uint64_t(0);
+
+    // the latest analysis, of the hop m_analysedHop
+    const float * m_window;
+    std::unique_ptr<FFTFrame> m_frame;
+    AudioFloatArray m_windowed;
+    AudioFloatArray m_magnitudes;
+    uint64_t m_analysedHop = ~uint64_t(0);
+};
+
+}  // namespace lab
+
+#endif  // SpectralAnalysis_h
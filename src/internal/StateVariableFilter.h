@@ -0,0 +1,56 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef StateVariableFilter_h
+#define StateVariableFilter_h
+
+#include "LabSound/core/AudioNode.h"
+
+#include <vector>
+
+namespace lab
+{
+
+// A trapezoidal integrated (TPT) state variable filter, after Zavalishin and Simper, for
+// any number of channels. Unlike a direct form biquad it stays stable, and free of zipper
+// noise, while its frequency and resonance are modulated quickly, so its coefficients may
+// be interpolated linearly between designs. It offers the same responses as a Biquad,
+// with the same meaning of Q and gain.
+class StateVariableFilter
+{
+public:
+    struct Coefficients
+    {
+        double g = 0;   // the integrators' gain, tan(w / 2)
+        double k = 2;   // damping, 1 / Q
+        double m0 = 1;  // the mix of the input, band pass and low pass outputs
+        double m1 = 0;
+        double m2 = 0;
+    };
+
+    // frequency is 0 - 1 normalized to Nyquist, as for a Biquad
+    static Coefficients design(FilterType type, double frequency, double Q, double dbGain);
+
+    void setCoefficients(const Coefficients & c) { m_coefficients = c; }
+
+    // sources and destinations may be the same channels
+    void process(const float * const * sources, float * const * destinations, int channels, int framesToProcess);
+
+    // As process, but the coefficients move linearly, frame by frame, to the target, which
+    // is current afterwards.
+    void processRamped(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+                       const Coefficients & target);
+
+    void reset();
+
+private:
+    void run(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+             const Coefficients & target);
+
+    Coefficients m_coefficients;
+    std::vector<double> m_state;  // two integrators for each channel
+};
+
+}  // namespace lab
+
+#endif  // StateVariableFilter_h
@@ -0,0 +1,115 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#ifndef TimeStretch_h
+#define TimeStretch_h
+
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class FFTFrame;
+
+// TimeStretcher plays a sound at a tempo and a pitch of their own. Both are rates in source
+// frames per output frame: the tempo is how fast the sound's position advances, and the pitch
+// is how fast each grain of it is read, by linear interpolation, so that the pitch also
+// converts the source's sample rate.
+//
+// Speech is stretched by WSOLA: grains half overlapping, each taken from within a quarter
+// grain of where the tempo puts it, at the offset whose start best matches how the last grain
+// would have continued, so that the pitch periods line up and voices stay clear. The match is
+// found on a signal decimated by four, and refined at full rate around it.
+//
+// Music is stretched by a phase vocoder, a quarter of a frame apart. The phase of each peak of
+// the spectrum is advanced by the peak's measured frequency, and the bins around it keep their
+// phases relative to it, so that chords and tones keep their pitches without smearing. The
+// polar conversions are vectorized approximations, and the FFT plans are shared with every
+// other frame of the size.
+//
+// The sound is read through a Reader a span at a time, so that it can come from a bus or from
+// compact storage, and loop. Positions run on past the sound's length; the reader maps them.
+class TimeStretcher
+{
+public:
+    enum Mode
+    {
+        Speech = 1,
+        Music = 2
+    };
+
+    struct Reader
+    {
+        virtual ~Reader() = default;
+
+        // count frames of a channel from first, which may lie outside the sound
+        virtual void read(int channel, int first, int count, float * destination) = 0;
+    };
+
+    explicit TimeStretcher(float sampleRate);
+    ~TimeStretcher();
+
+    // Begins a play from a source frame. Allocates only if the mode or channels need more.
+    void start(Mode mode, int channels, double position);
+
+    Mode mode() const { return m_mode; }
+    int channels() const { return m_channels; }
+
+    // The source frame the next grain is taken from
+    double position() const { return m_position; }
+
+    // Moves the positions back by a loop's length, once the sound has looped
+    void rewind(double frames);
+
+    // Whether every grain read from before end has been played out
+    bool playedPast(double end, double tempo, double pitch) const
+    {
+        return m_position >= end + m_tolerance * pitch + (m_size + m_hop) * tempo;
+    }
+
+    // Adds frames of the stretched sound, times gain, to each channel of out. tempo is held
+    // between 1/16 and 8, and pitch between 1/4 and 4.
+    void render(Reader & reader, float * const * out, int frames, double tempo, double pitch, float gain);
+
+    static const int MaxPitch = 4;
+
+private:
+    struct Channel;
+
+    void synthesizeSpeech(Reader & reader, double tempo, double pitch);
+    void synthesizeMusic(Reader & reader, double tempo, double pitch);
+    void overlapAdd(Channel & channel, const float * grain, const float * window);
+    void readResampled(Reader & reader, int channel, double position, double pitch, int count, float * destination);
+    void readMono(Reader & reader, double position, double pitch, int count, float * destination);
+    int bestOffset(const float * reference, int length, const float * region, int offsets);
+
+    float m_sampleRate;
+    Mode m_mode = Speech;
+    int m_channels = 0;
+    int m_size = 0;          // grain or frame length
+    int m_hop = 0;           // output frames between them
+    int m_tolerance = 0;     // how far from its place a speech grain may be taken
+    int m_fill = 0;          // frames of the ready hop played
+    bool m_first = true;
+
+    double m_position = 0;   // where the next grain is placed by the tempo
+    double m_previous = 0;   // where the last grain was taken from
+
+    std::vector<std::unique_ptr<Channel>> m_channelState;
+    std::vector<float> m_window;     // analysis, or the grain's window
+    std::vector<float> m_synthesis;  // the phase vocoder's synthesis window
+    std::vector<float> m_span;       // source frames, for resampling
+    std::vector<float> m_mono;
+    std::vector<float> m_reference;
+    std::vector<float> m_region;
+    std::vector<float> m_grain;
+    std::vector<float> m_magnitude;  // of a frame's bins
+    std::vector<float> m_phase;
+    std::vector<float> m_rotation;   // the turn of each bin's phase, as its peak's
+    std::vector<int> m_peaks;
+};
+
+}  // namespace lab
+
+#endif  // TimeStretch_h
@@ -0,0 +1,48 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef UdpSocket_h
+#define UdpSocket_h
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lab
+{
+
+// A datagram socket, over IPv4 or IPv6, either connected to one peer to send to it, or
+// bound to a local port to receive from any peer.
+class UdpSocket
+{
+public:
+    ~UdpSocket();
+
+    UdpSocket(const UdpSocket &) = delete;
+    UdpSocket & operator=(const UdpSocket &) = delete;
+
+    // host is a name or a numeric address. The socket's packets are marked for expedited
+    // forwarding, which networks that honor it queue ahead of bulk traffic. Returns null,
+    // with the reason in error, if the host can't be resolved or the socket opened.
+    static std::unique_ptr<UdpSocket> connect(const std::string & host, uint16_t port, std::string & error);
+
+    // An empty address binds every interface
+    static std::unique_ptr<UdpSocket> bind(const std::string & address, uint16_t port, std::string & error);
+
+    // Returns false if the datagram couldn't be sent; a datagram that was sent may still be lost
+    bool send(const void * data, size_t bytes);
+
+    // Waits up to timeoutMilliseconds for a datagram. Returns its size, zero if none came,
+    // or -1 on an error. A datagram larger than capacity is truncated.
+    int receive(void * data, size_t capacity, int timeoutMilliseconds);
+
+private:
+    UdpSocket() = default;
+
+    intptr_t _socket = -1;
+};
+
+}  // namespace lab
+
+#endif  // UdpSocket_h
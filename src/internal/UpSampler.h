@@ -43,7 +43,7 @@ class UpSampler final {
 public:
     explicit UpSampler(size_t inputBlockSize);
 
-    // The destination buffer |destP| is of size sourceFramesToProcess * 2.
+    // The destination buffer |destP| is of size sourceFramesToProcess * 2. Blocks may be of any size.
     void process(const float* sourceP, float* destP, size_t sourceFramesToProcess);
 
     void reset();
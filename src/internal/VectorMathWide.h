@@ -0,0 +1,65 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef VectorMathWide_h
+#define VectorMathWide_h
+
+#include "LabSound/core/Macros.h"
+
+#include <cstdint>
+
+// On x86, VectorMath's kernels for contiguous data can run on 256 or 512 bit
+// lanes. The wide implementations are compiled with per function target
+// attributes rather than global compiler flags, which would let the compiler
+// emit AVX anywhere in the library, and are selected once at startup
+// according to what the CPU reports.
+
+#if !defined(LABSOUND_PLATFORM_OSX) && \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && \
+    (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define LABSOUND_VECTORMATH_WIDE 1
+#endif
+
+#if defined(LABSOUND_VECTORMATH_WIDE)
+
+namespace lab
+{
+
+namespace VectorMath
+{
+
+    // Kernels over unit stride vectors. Sources and destinations need not be aligned.
+    struct WideKernels
+    {
+        const char * name;
+        void (*vsma)(const float * sourceP, float scale, float * destP, int framesToProcess);
+        void (*vsmul)(const float * sourceP, float scale, float * destP, int framesToProcess);
+        void (*vadd)(const float * source1P, const float * source2P, float * destP, int framesToProcess);
+        void (*vmul)(const float * source1P, const float * source2P, float * destP, int framesToProcess);
+        void (*vmadd)(const float * source1P, const float * source2P, float * destP, int framesToProcess);
+        void (*zvmul)(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess);
+        void (*zvmadd)(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess);
+        void (*zvmaddh)(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P, float scale2, float * realDestP, float * imagDestP, int framesToProcess);
+        float (*vsvesq)(const float * sourceP, int framesToProcess);
+        float (*vmaxmgv)(const float * sourceP, int framesToProcess);
+
+        // Runs each of biquadLanes channels, interleaved in data, through a cascade of biquad
+        // sections in transposed direct form II, in place. Each section has five coefficients,
+        // b0 b1 b2 a1 a2, shared by the channels, and two states for each channel.
+        int biquadLanes;
+        void (*biquad)(double * data, int frames, const double * coefficients, double * state, int sections);
+    };
+
+    const WideKernels & avx2Kernels();       // requires AVX2, FMA and F16C
+    const WideKernels & avx512Kernels();     // requires AVX-512F
+
+    // The widest kernels the CPU supports, or nullptr if it has nothing wider than SSE2
+    const WideKernels * selectWideKernels();
+
+}  // namespace VectorMath
+
+}  // namespace lab
+
+#endif  // LABSOUND_VECTORMATH_WIDE
+
+#endif  // VectorMathWide_h
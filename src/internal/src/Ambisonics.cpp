@@ -0,0 +1,502 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/Ambisonics.h"
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+namespace lab
+{
+
+using namespace VectorMath;
+
+int ambisonicOrderForChannelCount(int channelCount)
+{
+    for (int order = 0; order <= MaxAmbisonicOrder; ++order)
+    {
+        if (ambisonicChannelCount(order) == channelCount)
+            return order;
+    }
+    return -1;
+}
+
+void ambisonicEncodingCoefficients(int order, double x, double y, double z, double * c)
+{
+    c[0] = 1.0;
+    if (order < 1)
+        return;
+
+    c[1] = y;
+    c[2] = z;
+    c[3] = x;
+    if (order < 2)
+        return;
+
+    const double sqrt3 = sqrt(3.0);
+    c[4] = sqrt3 * x * y;
+    c[5] = sqrt3 * y * z;
+    c[6] = 0.5 * (3.0 * z * z - 1.0);
+    c[7] = sqrt3 * x * z;
+    c[8] = 0.5 * sqrt3 * (x * x - y * y);
+    if (order < 3)
+        return;
+
+    const double sqrt5_8 = sqrt(5.0 / 8.0);
+    const double sqrt3_8 = sqrt(3.0 / 8.0);
+    const double sqrt15 = sqrt(15.0);
+    c[9] = sqrt5_8 * y * (3.0 * x * x - y * y);
+    c[10] = sqrt15 * x * y * z;
+    c[11] = sqrt3_8 * y * (5.0 * z * z - 1.0);
+    c[12] = 0.5 * z * (5.0 * z * z - 3.0);
+    c[13] = sqrt3_8 * x * (5.0 * z * z - 1.0);
+    c[14] = 0.5 * sqrt15 * z * (x * x - y * y);
+    c[15] = sqrt5_8 * x * (x * x - 3.0 * y * y);
+}
+
+// Directions spread evenly over the sphere, along a Fibonacci spiral
+static std::vector<double> sphereDirections(int count)
+{
+    std::vector<double> directions(count * 3);
+    const double goldenAngle = LAB_PI * (3.0 - sqrt(5.0));
+    for (int i = 0; i < count; ++i)
+    {
+        const double z = 1.0 - 2.0 * (i + 0.5) / count;
+        const double radius = sqrt(std::max(0.0, 1.0 - z * z));
+        directions[i * 3 + 0] = radius * cos(goldenAngle * i);
+        directions[i * 3 + 1] = radius * sin(goldenAngle * i);
+        directions[i * 3 + 2] = z;
+    }
+    return directions;
+}
+
+// Inverts the n by n matrix a, row major, in place, by Gauss-Jordan elimination
+static bool invertMatrix(std::vector<double> & a, int n)
+{
+    std::vector<double> inverse(n * n, 0.0);
+    for (int i = 0; i < n; ++i)
+        inverse[i * n + i] = 1.0;
+
+    for (int column = 0; column < n; ++column)
+    {
+        int pivot = column;
+        for (int row = column + 1; row < n; ++row)
+        {
+            if (fabs(a[row * n + column]) > fabs(a[pivot * n + column]))
+                pivot = row;
+        }
+        if (fabs(a[pivot * n + column]) < 1e-12)
+            return false;
+
+        if (pivot != column)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                std::swap(a[pivot * n + k], a[column * n + k]);
+                std::swap(inverse[pivot * n + k], inverse[column * n + k]);
+            }
+        }
+
+        const double scale = 1.0 / a[column * n + column];
+        for (int k = 0; k < n; ++k)
+        {
+            a[column * n + k] *= scale;
+            inverse[column * n + k] *= scale;
+        }
+
+        for (int row = 0; row < n; ++row)
+        {
+            const double factor = a[row * n + column];
+            if (row == column || factor == 0.0)
+                continue;
+            for (int k = 0; k < n; ++k)
+            {
+                a[row * n + k] -= factor * a[column * n + k];
+                inverse[row * n + k] -= factor * inverse[column * n + k];
+            }
+        }
+    }
+
+    a.swap(inverse);
+    return true;
+}
+
+std::vector<double> ambisonicDecodingMatrix(int order, const std::vector<double> & speakerDirections)
+{
+    ASSERT(order >= 0 && order <= MaxAmbisonicOrder);
+    const int channels = ambisonicChannelCount(order);
+    const int speakers = static_cast<int>(speakerDirections.size() / 3);
+    std::vector<double> decoder(speakers * channels, 0.0);
+    if (!speakers)
+        return decoder;
+
+    // the encoding of each speaker's direction, channels by speakers
+    std::vector<double> encoding(channels * speakers);
+    double c[MaxAmbisonicChannels];
+    for (int s = 0; s < speakers; ++s)
+    {
+        ambisonicEncodingCoefficients(order, speakerDirections[s * 3], speakerDirections[s * 3 + 1], speakerDirections[s * 3 + 2], c);
+        for (int k = 0; k < channels; ++k)
+            encoding[k * speakers + s] = c[k];
+    }
+
+    // decoder = encoding' (encoding encoding' + lambda I)^-1
+    std::vector<double> gram(channels * channels, 0.0);
+    double trace = 0;
+    for (int i = 0; i < channels; ++i)
+    {
+        for (int j = 0; j < channels; ++j)
+        {
+            double sum = 0;
+            for (int s = 0; s < speakers; ++s)
+                sum += encoding[i * speakers + s] * encoding[j * speakers + s];
+            gram[i * channels + j] = sum;
+        }
+        trace += gram[i * channels + i];
+    }
+    const double lambda = 0.01 * trace / channels;
+    for (int i = 0; i < channels; ++i)
+        gram[i * channels + i] += lambda;
+
+    if (!invertMatrix(gram, channels))
+        return decoder;
+
+    for (int s = 0; s < speakers; ++s)
+    {
+        for (int k = 0; k < channels; ++k)
+        {
+            double sum = 0;
+            for (int j = 0; j < channels; ++j)
+                sum += encoding[j * speakers + s] * gram[j * channels + k];
+            decoder[s * channels + k] = sum;
+        }
+    }
+
+    // The max rE weights of each degree are the Legendre polynomials at the largest root of
+    // the polynomial of the next order
+    static const double maxReWeights[MaxAmbisonicOrder + 1][MaxAmbisonicOrder + 1] = {
+        {1.0, 0.0, 0.0, 0.0},
+        {1.0, 0.577350, 0.0, 0.0},
+        {1.0, 0.774597, 0.4, 0.0},
+        {1.0, 0.861136, 0.612333, 0.304753}};
+    for (int k = 0; k < channels; ++k)
+    {
+        const int degree = static_cast<int>(sqrt(static_cast<double>(k)));
+        for (int s = 0; s < speakers; ++s)
+            decoder[s * channels + k] *= maxReWeights[order][degree];
+    }
+
+    // normalize the energy of a plane wave, averaged over the sphere, to one
+    const int probes = 64;
+    const std::vector<double> probe = sphereDirections(probes);
+    double energy = 0;
+    for (int p = 0; p < probes; ++p)
+    {
+        ambisonicEncodingCoefficients(order, probe[p * 3], probe[p * 3 + 1], probe[p * 3 + 2], c);
+        for (int s = 0; s < speakers; ++s)
+        {
+            double gain = 0;
+            for (int k = 0; k < channels; ++k)
+                gain += decoder[s * channels + k] * c[k];
+            energy += gain * gain;
+        }
+    }
+    energy /= probes;
+    if (energy > 0)
+    {
+        const double scale = 1.0 / sqrt(energy);
+        for (double & gain : decoder)
+            gain *= scale;
+    }
+
+    return decoder;
+}
+
+// The rotation of a degree is found from how a set of probe directions encode before and after
+// the rotation: with A the probes' coefficients in that degree, and B the rotated probes', the
+// rotation is B A' (A A')^-1. The right hand part only depends on the probes, and is kept.
+namespace
+{
+    const int RotationProbes = 32;
+
+    struct RotationProbeSet
+    {
+        std::vector<double> directions;
+        std::vector<double> projection[MaxAmbisonicOrder + 1];  // probes by 2n + 1, for each degree n
+
+        RotationProbeSet()
+            : directions(sphereDirections(RotationProbes))
+        {
+            std::vector<double> coefficients(RotationProbes * MaxAmbisonicChannels);
+            for (int p = 0; p < RotationProbes; ++p)
+                ambisonicEncodingCoefficients(MaxAmbisonicOrder, directions[p * 3], directions[p * 3 + 1], directions[p * 3 + 2], &coefficients[p * MaxAmbisonicChannels]);
+
+            for (int degree = 1; degree <= MaxAmbisonicOrder; ++degree)
+            {
+                const int first = degree * degree;
+                const int size = 2 * degree + 1;
+
+                std::vector<double> gram(size * size, 0.0);
+                for (int i = 0; i < size; ++i)
+                    for (int j = 0; j < size; ++j)
+                        for (int p = 0; p < RotationProbes; ++p)
+                            gram[i * size + j] += coefficients[p * MaxAmbisonicChannels + first + i] * coefficients[p * MaxAmbisonicChannels + first + j];
+
+                bool inverted = invertMatrix(gram, size);
+                ASSERT(inverted);
+                (void) inverted;
+
+                std::vector<double> & projection = this->projection[degree];
+                projection.assign(RotationProbes * size, 0.0);
+                for (int p = 0; p < RotationProbes; ++p)
+                    for (int k = 0; k < size; ++k)
+                        for (int j = 0; j < size; ++j)
+                            projection[p * size + k] += coefficients[p * MaxAmbisonicChannels + first + j] * gram[j * size + k];
+            }
+        }
+    };
+
+    const RotationProbeSet & rotationProbes()
+    {
+        static RotationProbeSet probes;
+        return probes;
+    }
+
+    // the offset of each degree's block in a block diagonal rotation
+    int rotationBlockOffset(int degree)
+    {
+        int offset = 0;
+        for (int n = 1; n < degree; ++n)
+            offset += (2 * n + 1) * (2 * n + 1);
+        return offset;
+    }
+}
+
+AmbisonicRotation::AmbisonicRotation()
+    : m_matrix(rotationBlockOffset(MaxAmbisonicOrder + 1), 0.0)
+    , m_lastMatrix(rotationBlockOffset(MaxAmbisonicOrder + 1), 0.0)
+{
+    for (int i = 0; i < 9; ++i)
+        m_rotation[i] = (i % 4) == 0 ? 1.0 : 0.0;
+    updateMatrix();
+    m_lastMatrix = m_matrix;
+}
+
+void AmbisonicRotation::setListenerOrientation(const FloatPoint3D & forward, const FloatPoint3D & up)
+{
+    FloatPoint3D f = normalize(forward);
+    FloatPoint3D right = normalize(cross(f, up));
+    FloatPoint3D u = cross(right, f);
+    if (std::isnan(right.x) || std::isnan(f.x))
+        return;
+
+    // In the field's frame, a world direction v is (-v.z, -v.x, v.y); the listener hears it
+    // ahead by v . f, to the left by -v . right, and up by v . u.
+    const double rotation[9] = {
+        -f.z, -f.x, f.y,
+        right.z, right.x, -right.y,
+        -u.z, -u.x, u.y};
+
+    if (memcmp(rotation, m_rotation, sizeof(m_rotation)) == 0)
+        return;
+
+    memcpy(m_rotation, rotation, sizeof(m_rotation));
+    m_rotationChanged = true;
+}
+
+void AmbisonicRotation::updateMatrix()
+{
+    m_isIdentity = true;
+    for (int i = 0; i < 9; ++i)
+    {
+        if (fabs(m_rotation[i] - ((i % 4) == 0 ? 1.0 : 0.0)) > 1e-9)
+            m_isIdentity = false;
+    }
+
+    const RotationProbeSet & probes = rotationProbes();
+    std::vector<double> rotated(RotationProbes * MaxAmbisonicChannels);
+    for (int p = 0; p < RotationProbes; ++p)
+    {
+        const double * d = &probes.directions[p * 3];
+        const double x = m_rotation[0] * d[0] + m_rotation[1] * d[1] + m_rotation[2] * d[2];
+        const double y = m_rotation[3] * d[0] + m_rotation[4] * d[1] + m_rotation[5] * d[2];
+        const double z = m_rotation[6] * d[0] + m_rotation[7] * d[1] + m_rotation[8] * d[2];
+        ambisonicEncodingCoefficients(MaxAmbisonicOrder, x, y, z, &rotated[p * MaxAmbisonicChannels]);
+    }
+
+    for (int degree = 1; degree <= MaxAmbisonicOrder; ++degree)
+    {
+        const int first = degree * degree;
+        const int size = 2 * degree + 1;
+        const std::vector<double> & projection = probes.projection[degree];
+        double * block = &m_matrix[rotationBlockOffset(degree)];
+        for (int i = 0; i < size; ++i)
+        {
+            for (int k = 0; k < size; ++k)
+            {
+                double sum = 0;
+                for (int p = 0; p < RotationProbes; ++p)
+                    sum += rotated[p * MaxAmbisonicChannels + first + i] * projection[p * size + k];
+                block[i * size + k] = sum;
+            }
+        }
+    }
+}
+
+void AmbisonicRotation::process(int order, const AudioBus & source, AudioBus & destination, int framesToProcess)
+{
+    ASSERT(destination.numberOfChannels() >= ambisonicChannelCount(order));
+
+    m_lastMatrix = m_matrix;
+    const bool wasIdentity = m_isIdentity;
+    if (m_rotationChanged)
+    {
+        updateMatrix();
+        m_rotationChanged = false;
+    }
+    if (m_isFirstRender)
+    {
+        m_isFirstRender = false;
+        m_lastMatrix = m_matrix;
+    }
+
+    const int sourceChannels = source.numberOfChannels();
+    const bool ramp = m_lastMatrix != m_matrix;
+
+    // the omnidirectional channel is unchanged by any rotation
+    if (sourceChannels > 0)
+        memcpy(destination.channel(0)->mutableData(), source.channel(0)->data(), sizeof(float) * framesToProcess);
+    else
+        destination.channel(0)->zero();
+
+    for (int degree = 1; degree <= order; ++degree)
+    {
+        const int first = degree * degree;
+        const int size = 2 * degree + 1;
+        const double * block = &m_matrix[rotationBlockOffset(degree)];
+        const double * lastBlock = &m_lastMatrix[rotationBlockOffset(degree)];
+
+        for (int i = 0; i < size; ++i)
+        {
+            float * dst = destination.channel(first + i)->mutableData();
+
+            if (m_isIdentity && wasIdentity)
+            {
+                if (first + i < sourceChannels)
+                    memcpy(dst, source.channel(first + i)->data(), sizeof(float) * framesToProcess);
+                else
+                    memset(dst, 0, sizeof(float) * framesToProcess);
+                continue;
+            }
+
+            memset(dst, 0, sizeof(float) * framesToProcess);
+            for (int k = 0; k < size && first + k < sourceChannels; ++k)
+            {
+                const float * src = source.channel(first + k)->data();
+                const float gain = static_cast<float>(block[i * size + k]);
+                if (!ramp)
+                {
+                    if (gain != 0.f)
+                        vsma(src, 1, &gain, dst, 1, framesToProcess);
+                    continue;
+                }
+
+                float g = static_cast<float>(lastBlock[i * size + k]);
+                const float step = (gain - g) / framesToProcess;
+                for (int n = 0; n < framesToProcess; ++n)
+                {
+                    dst[n] += src[n] * g;
+                    g += step;
+                }
+            }
+        }
+    }
+}
+
+AmbisonicPanner::AmbisonicPanner(const float sampleRate)
+    : Panner(sampleRate, PanningModel::AMBISONIC)
+{
+    memset(m_coefficients, 0, sizeof(m_coefficients));
+}
+
+void AmbisonicPanner::pan(ContextRenderLock & r,
+                          double azimuth, double elevation,
+                          const AudioBus & inputBus, AudioBus & outputBus,
+                          int busOffset,
+                          int framesToProcess)
+{
+    const int numberOfInputChannels = inputBus.numberOfChannels();
+    bool isInputSafe = (numberOfInputChannels == Channels::Mono || numberOfInputChannels == Channels::Stereo) &&
+                       (framesToProcess + busOffset) <= inputBus.length();
+    ASSERT(isInputSafe);
+    if (!isInputSafe)
+        return;
+
+    const int channels = outputBus.numberOfChannels();
+    const int order = ambisonicOrderForChannelCount(channels);
+    bool isOutputSafe = order >= 0 && (framesToProcess + busOffset) <= outputBus.length();
+    ASSERT(isOutputSafe);
+    if (!isOutputSafe)
+        return;
+
+    if (busOffset > 0 || framesToProcess < outputBus.length())
+        outputBus.zero();
+
+    // the panner's azimuths turn clockwise, and the field's counterclockwise
+    const double phi = -azimuth * LAB_PI / 180.0;
+    const double theta = elevation * LAB_PI / 180.0;
+    double coefficients[MaxAmbisonicChannels];
+    ambisonicEncodingCoefficients(order, cos(theta) * cos(phi), cos(theta) * sin(phi), sin(theta), coefficients);
+    for (int k = 0; k < channels; ++k)
+        coefficients[k] *= m_gain;
+
+    // Don't de-zipper on first render call.
+    if (m_isFirstRender)
+    {
+        m_isFirstRender = false;
+        memcpy(m_coefficients, coefficients, sizeof(double) * channels);
+    }
+
+    const float * sourceL = inputBus.channel(0)->data() + busOffset;
+    const float * sourceR = numberOfInputChannels > 1 ? inputBus.channel(1)->data() + busOffset : nullptr;
+
+    // A stereo input is encoded from its mono mix, made in the omnidirectional channel, which
+    // is the last to be encoded
+    const float * mono = sourceL;
+    if (sourceR)
+    {
+        float * mix = outputBus.channel(0)->mutableData() + busOffset;
+        const float half = 0.5f;
+        vadd(sourceL, 1, sourceR, 1, mix, 1, framesToProcess);
+        vsmul(mix, 1, &half, mix, 1, framesToProcess);
+        mono = mix;
+    }
+
+    for (int k = channels - 1; k >= 0; --k)
+    {
+        float * dst = outputBus.channel(k)->mutableData() + busOffset;
+        float gain = static_cast<float>(m_coefficients[k]);
+        const float step = static_cast<float>((coefficients[k] - m_coefficients[k]) / framesToProcess);
+        if (step == 0.f)
+        {
+            vsmul(mono, 1, &gain, dst, 1, framesToProcess);
+            continue;
+        }
+        for (int n = 0; n < framesToProcess; ++n)
+        {
+            dst[n] = mono[n] * gain;
+            gain += step;
+        }
+    }
+
+    memcpy(m_coefficients, coefficients, sizeof(double) * channels);
+}
+
+}  // namespace lab
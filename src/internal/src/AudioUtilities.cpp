@@ -4,12 +4,13 @@
 
 #include "internal/AudioUtilities.h"
 #include "internal/Assertions.h"
+#include "internal/LookupTables.h"
 
 #include "LabSound/core/Macros.h"
 
 float lab::AudioUtilities::decibelsToLinear(float decibels)
 {
-    return std::pow(10.f, 0.05f * decibels);
+    return LookupTables::decibelsToLinear(decibels);
 }
 
 float lab::AudioUtilities::linearToDecibels(float linear)
@@ -17,6 +18,8 @@ float lab::AudioUtilities::linearToDecibels(float linear)
     // It's not possible to calculate decibels for a zero linear value since it would be -Inf.
     // -1000.0 dB represents a very tiny linear value in case we ever reach this case.
     if (!linear) return -1000.0;
+    if (linear > 0 && std::isfinite(linear))
+        return LookupTables::linearToDecibels(linear);
     return (20.f * std::log10(linear));
 }
 
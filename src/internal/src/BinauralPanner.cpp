@@ -0,0 +1,156 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/core/Mixing.h"
+
+#include "internal/Assertions.h"
+#include "internal/AudioUtilities.h"
+#include "internal/BinauralPanner.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    // Use a 50ms smoothing / de-zippering time-constant, as the equal power panner does.
+    const float SmoothingTimeConstant = 0.050f;
+
+    // a spherical head, for Woodworth's interaural time difference
+    const double HeadRadius = 0.0875;  // m
+    const double SpeedOfSound = 343.0;  // m/s
+
+    // the far ear's low pass runs from open, facing the source, to this, side on
+    const double ShadowCutoff = 1500.0;  // Hz
+    const double OpenCutoff = 20000.0;  // Hz
+}
+
+BinauralPanner::BinauralPanner(const float sampleRate)
+    : Panner(sampleRate, PanningModel::BINAURAL)
+{
+    reset();
+}
+
+void BinauralPanner::reset()
+{
+    memset(m_history, 0, sizeof(m_history));
+    m_writeIndex = 0;
+    m_isFirstRender = true;
+    m_lowpassL = 0;
+    m_lowpassR = 0;
+}
+
+void BinauralPanner::pan(ContextRenderLock & r,
+                         double azimuth, double elevation,
+                         const AudioBus & inputBus, AudioBus & outputBus,
+                         int busOffset,
+                         int framesToProcess)
+{
+    const float sampleRate = r.context()->sampleRate();
+    const double smoothing = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, sampleRate);
+
+    bool isInputSafe = (inputBus.numberOfChannels() == Channels::Mono ||
+                        inputBus.numberOfChannels() == Channels::Stereo) &&
+                        (framesToProcess + busOffset) <= inputBus.length();
+    ASSERT(isInputSafe);
+    if (!isInputSafe)
+        return;
+
+    bool isOutputSafe = outputBus.numberOfChannels() == Channels::Stereo &&
+                        (framesToProcess + busOffset) <= outputBus.length();
+    ASSERT(isOutputSafe);
+    if (!isOutputSafe)
+        return;
+
+    const float * sourceL = inputBus.channelByType(Channel::Left)->data() + busOffset;
+    const float * sourceR = inputBus.numberOfChannels() > 1 ?
+                            inputBus.channelByType(Channel::Right)->data() + busOffset : nullptr;
+    float * destinationL = outputBus.channelByType(Channel::Left)->mutableData() + busOffset;
+    float * destinationR = outputBus.channelByType(Channel::Right)->mutableData() + busOffset;
+
+    // The lateral angle, positive to the right; a source behind is heard as its mirror
+    // image in front, as with equal power panning.
+    const double lateral = std::asin(std::max(-1.0, std::min(1.0, std::sin(azimuth * LAB_PI / 180.0))));
+    const double side = std::fabs(std::sin(lateral));
+
+    const double itd = HeadRadius / SpeedOfSound * (std::fabs(lateral) + side) * sampleRate;
+    const double nearGain = std::sqrt(0.5 * (1.0 + 0.5 * side));
+    const double farGain = std::sqrt(0.5 * (1.0 - 0.5 * side));
+    const double cutoff = std::min(OpenCutoff * std::pow(ShadowCutoff / OpenCutoff, side), 0.45 * sampleRate);
+    const double shadow = std::exp(-2.0 * LAB_PI * cutoff / sampleRate);
+
+    const bool rightIsNear = lateral >= 0;
+    const double desiredGainL = rightIsNear ? farGain : nearGain;
+    const double desiredGainR = rightIsNear ? nearGain : farGain;
+    const double desiredDelayL = rightIsNear ? itd : 0;
+    const double desiredDelayR = rightIsNear ? 0 : itd;
+    const double desiredShadowL = rightIsNear ? shadow : 0;
+    const double desiredShadowR = rightIsNear ? 0 : shadow;
+
+    // Don't de-zipper on first render call.
+    if (m_isFirstRender)
+    {
+        m_isFirstRender = false;
+        m_gainL = desiredGainL;
+        m_gainR = desiredGainR;
+        m_delayL = desiredDelayL;
+        m_delayR = desiredDelayR;
+        m_shadowL = desiredShadowL;
+        m_shadowR = desiredShadowR;
+    }
+
+    double gainL = m_gainL, gainR = m_gainR;
+    double delayL = m_delayL, delayR = m_delayR;
+    double shadowL = m_shadowL, shadowR = m_shadowR;
+    float lowpassL = m_lowpassL, lowpassR = m_lowpassR;
+    int writeIndex = m_writeIndex;
+
+    auto delayed = [this, &writeIndex](double delay) -> float
+    {
+        const int whole = static_cast<int>(delay);
+        const float fraction = static_cast<float>(delay - whole);
+        const float a = m_history[(writeIndex - whole) & (HistorySize - 1)];
+        const float b = m_history[(writeIndex - whole - 1) & (HistorySize - 1)];
+        return a + (b - a) * fraction;
+    };
+
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        gainL += (desiredGainL - gainL) * smoothing;
+        gainR += (desiredGainR - gainR) * smoothing;
+        delayL += (desiredDelayL - delayL) * smoothing;
+        delayR += (desiredDelayR - delayR) * smoothing;
+        shadowL += (desiredShadowL - shadowL) * smoothing;
+        shadowR += (desiredShadowR - shadowR) * smoothing;
+
+        m_history[writeIndex] = sourceR ? 0.5f * (sourceL[i] + sourceR[i]) : sourceL[i];
+
+        const float l = delayed(delayL);
+        const float r = delayed(delayR);
+        lowpassL = static_cast<float>(l + (lowpassL - l) * shadowL);
+        lowpassR = static_cast<float>(r + (lowpassR - r) * shadowR);
+        destinationL[i] = static_cast<float>(lowpassL * gainL);
+        destinationR[i] = static_cast<float>(lowpassR * gainR);
+
+        writeIndex = (writeIndex + 1) & (HistorySize - 1);
+    }
+
+    m_gainL = gainL;
+    m_gainR = gainR;
+    m_delayL = delayL;
+    m_delayR = delayR;
+    m_shadowL = shadowL;
+    m_shadowR = shadowR;
+    m_lowpassL = lowpassL;
+    m_lowpassR = lowpassR;
+    m_writeIndex = writeIndex;
+}
+
+}  // namespace lab
@@ -0,0 +1,220 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/BiquadBank.h"
+#include "internal/Assertions.h"
+#include "internal/Biquad.h"
+#include "internal/VectorMathWide.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+namespace
+{
+    const int PortableLanes = 2;
+
+    // Two lanes, which compilers keep in one SSE2 or NEON register
+    void biquadPortable(double * data, int frames, const double * coefficients, double * state, int sections)
+    {
+        for (int section = 0; section < sections; ++section, coefficients += 5, state += 2 * PortableLanes)
+        {
+            const double b0 = coefficients[0];
+            const double b1 = coefficients[1];
+            const double b2 = coefficients[2];
+            const double a1 = coefficients[3];
+            const double a2 = coefficients[4];
+            double s1[PortableLanes] = {state[0], state[1]};
+            double s2[PortableLanes] = {state[2], state[3]};
+            double * p = data;
+            for (int i = 0; i < frames; ++i, p += PortableLanes)
+            {
+                for (int lane = 0; lane < PortableLanes; ++lane)
+                {
+                    const double x = p[lane];
+                    const double y = b0 * x + s1[lane];
+                    s1[lane] = b1 * x - a1 * y + s2[lane];
+                    s2[lane] = b2 * x - a2 * y;
+                    p[lane] = y;
+                }
+            }
+            state[0] = s1[0];
+            state[1] = s1[1];
+            state[2] = s2[0];
+            state[3] = s2[1];
+        }
+    }
+
+    // Any number of lanes up to MaxRampLanes, with coefficients stepping toward the targets
+    const int MaxRampLanes = 16;
+    void biquadRamped(double * data, int frames, int lanes, const double * coefficients, const double * targets,
+                      double * state, int sections)
+    {
+        const double step = 1.0 / frames;
+        for (int section = 0; section < sections; ++section, coefficients += 5, targets += 5, state += 2 * lanes)
+        {
+            double c[5], dc[5];
+            for (int j = 0; j < 5; ++j)
+            {
+                c[j] = coefficients[j];
+                dc[j] = (targets[j] - coefficients[j]) * step;
+            }
+            double s1[MaxRampLanes], s2[MaxRampLanes];
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                s1[lane] = state[lane];
+                s2[lane] = state[lanes + lane];
+            }
+            double * p = data;
+            for (int i = 0; i < frames; ++i, p += lanes)
+            {
+                for (int j = 0; j < 5; ++j)
+                    c[j] += dc[j];
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    const double x = p[lane];
+                    const double y = c[0] * x + s1[lane];
+                    s1[lane] = c[1] * x - c[3] * y + s2[lane];
+                    s2[lane] = c[2] * x - c[4] * y;
+                    p[lane] = y;
+                }
+            }
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                state[lane] = s1[lane];
+                state[lanes + lane] = s2[lane];
+            }
+        }
+    }
+
+    typedef void (*BiquadKernel)(double * data, int frames, const double * coefficients, double * state, int sections);
+
+    void selectKernel(BiquadKernel & kernel, int & lanes)
+    {
+#if defined(LABSOUND_VECTORMATH_WIDE)
+        static const VectorMath::WideKernels * const wide = VectorMath::selectWideKernels();
+        if (wide)
+        {
+            kernel = wide->biquad;
+            lanes = wide->biquadLanes;
+            return;
+        }
+#endif
+        kernel = biquadPortable;
+        lanes = PortableLanes;
+    }
+}
+
+BiquadBank::BiquadBank()
+{
+    selectKernel(m_kernel, m_lanes);
+    setNumberOfSections(1);
+}
+
+BiquadBank::~BiquadBank()
+{
+}
+
+void BiquadBank::setNumberOfSections(int sections)
+{
+    ASSERT(sections >= 0);
+    m_coefficients.resize(sections * 5);
+    for (int section = 0; section < sections; ++section)
+        setSectionCoefficients(section, 1, 0, 0, 0, 0);
+
+    m_state.assign(m_groups * sections * 2 * m_lanes, 0.0);
+}
+
+void BiquadBank::setSection(int section, const Biquad & design)
+{
+    double b0, b1, b2, a1, a2;
+    design.getCoefficients(b0, b1, b2, a1, a2);
+    setSectionCoefficients(section, b0, b1, b2, a1, a2);
+}
+
+void BiquadBank::setSectionCoefficients(int section, double b0, double b1, double b2, double a1, double a2)
+{
+    ASSERT(section >= 0 && section < numberOfSections());
+    double * c = &m_coefficients[section * 5];
+    c[0] = b0;
+    c[1] = b1;
+    c[2] = b2;
+    c[3] = a1;
+    c[4] = a2;
+}
+
+void BiquadBank::reset()
+{
+    std::fill(m_state.begin(), m_state.end(), 0.0);
+}
+
+void BiquadBank::process(const float * const * sources, float * const * destinations, int channels, int framesToProcess)
+{
+    run(sources, destinations, channels, framesToProcess, nullptr);
+}
+
+void BiquadBank::processRamped(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+                               const double * targetCoefficients)
+{
+    ASSERT(m_lanes <= MaxRampLanes);
+    if (framesToProcess > 0)
+        run(sources, destinations, channels, framesToProcess, targetCoefficients);
+    std::copy(targetCoefficients, targetCoefficients + m_coefficients.size(), m_coefficients.begin());
+}
+
+void BiquadBank::run(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+                     const double * targetCoefficients)
+{
+    const int lanes = m_lanes;
+    const int sections = numberOfSections();
+    const int groups = (channels + lanes - 1) / lanes;
+    if (groups != m_groups)
+    {
+        // a group that is added starts from rest, and the others keep their state
+        m_groups = groups;
+        m_state.resize(groups * sections * 2 * lanes, 0.0);
+    }
+
+    if (static_cast<int>(m_interleaved.size()) < framesToProcess * lanes)
+        m_interleaved.resize(framesToProcess * lanes);
+
+    double * interleaved = m_interleaved.data();
+    for (int group = 0; group < groups; ++group)
+    {
+        const int first = group * lanes;
+        const int count = std::min(lanes, channels - first);
+
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            double * p = interleaved + lane;
+            if (lane < count)
+            {
+                const float * source = sources[first + lane];
+                for (int i = 0; i < framesToProcess; ++i, p += lanes)
+                    *p = source[i];
+            }
+            else
+            {
+                for (int i = 0; i < framesToProcess; ++i, p += lanes)
+                    *p = 0.0;
+            }
+        }
+
+        double * state = &m_state[group * sections * 2 * lanes];
+        if (targetCoefficients)
+            biquadRamped(interleaved, framesToProcess, lanes, m_coefficients.data(), targetCoefficients, state, sections);
+        else
+            m_kernel(interleaved, framesToProcess, m_coefficients.data(), state, sections);
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            const double * p = interleaved + lane;
+            float * destination = destinations[first + lane];
+            for (int i = 0; i < framesToProcess; ++i, p += lanes)
+                destination[i] = static_cast<float>(*p);
+        }
+    }
+}
+
+}  // namespace lab
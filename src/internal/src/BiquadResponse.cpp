@@ -0,0 +1,123 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/BiquadResponse.h"
+#include "internal/Lanes4.h"
+
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+void BiquadResponse::setFrequencies(const float * frequency, int count)
+{
+    count = std::max(0, count);
+    if (count == m_count && std::equal(frequency, frequency + count, m_frequencies.begin()))
+        return;
+
+    m_count = count;
+    m_frequencies.assign(frequency, frequency + count);
+    m_valid = false;
+
+    const int padded = (count + 3) & ~3;
+    // the padding is at zero frequency
+    for (std::vector<float> * v : {&m_phi, &m_sin1, &m_sin2, &m_power, &m_real, &m_imag})
+        v->assign(padded, 0.f);
+    m_cos1.assign(padded, 1.f);
+    m_cos2.assign(padded, 1.f);
+    m_magnitude.resize(count);
+    m_phase.resize(count);
+
+    for (int k = 0; k < count; ++k)
+    {
+        const double w = static_cast<double>(LAB_PI) * std::max(0.f, std::min(frequency[k], 1.f));
+        const double s = std::sin(0.5 * w);
+        m_phi[k] = static_cast<float>(s * s);
+        m_cos1[k] = static_cast<float>(std::cos(w));
+        m_sin1[k] = static_cast<float>(std::sin(w));
+        m_cos2[k] = static_cast<float>(std::cos(2 * w));
+        m_sin2[k] = static_cast<float>(std::sin(2 * w));
+    }
+}
+
+bool BiquadResponse::evaluate(const double * coefficients, int sections)
+{
+    const size_t size = 5 * static_cast<size_t>(std::max(0, sections));
+    if (m_valid && size == m_coefficients.size() && std::equal(coefficients, coefficients + size, m_coefficients.begin()))
+        return false;
+    m_coefficients.assign(coefficients, coefficients + size);
+    m_valid = true;
+
+    // for each section, the terms of |N|^2 and |D|^2 as polynomials in phi, found in
+    // double precision, then the coefficients themselves
+    struct Terms
+    {
+        float n0, n1, n2, d0, d1, d2;
+        float b0, b1, b2, a1, a2;
+    };
+    std::vector<Terms> terms(sections);
+    for (int s = 0; s < sections; ++s)
+    {
+        const double * c = coefficients + 5 * s;
+        const double b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+        Terms & t = terms[s];
+        t.n0 = static_cast<float>((b0 + b1 + b2) * (b0 + b1 + b2));
+        t.n1 = static_cast<float>(-4 * (b0 * b1 + 4 * b0 * b2 + b1 * b2));
+        t.n2 = static_cast<float>(16 * b0 * b2);
+        t.d0 = static_cast<float>((1 + a1 + a2) * (1 + a1 + a2));
+        t.d1 = static_cast<float>(-4 * (a1 + 4 * a2 + a1 * a2));
+        t.d2 = static_cast<float>(16 * a2);
+        t.b0 = static_cast<float>(b0);
+        t.b1 = static_cast<float>(b1);
+        t.b2 = static_cast<float>(b2);
+        t.a1 = static_cast<float>(a1);
+        t.a2 = static_cast<float>(a2);
+    }
+
+    const int padded = static_cast<int>(m_phi.size());
+    for (int k = 0; k < padded; k += 4)
+    {
+        const Lanes4 phi = Lanes4::load(&m_phi[k]);
+        const Lanes4 c1 = Lanes4::load(&m_cos1[k]);
+        const Lanes4 s1 = Lanes4::load(&m_sin1[k]);
+        const Lanes4 c2 = Lanes4::load(&m_cos2[k]);
+        const Lanes4 s2 = Lanes4::load(&m_sin2[k]);
+
+        // the product of the sections' |N|^2 and |D|^2, and of their N conj(D), whose
+        // argument is the phase
+        Lanes4 numerator = 1.f, denominator = 1.f;
+        Lanes4 re = 1.f, im = 0.f;
+        for (const Terms & t : terms)
+        {
+            numerator = numerator * maxOf(Lanes4(t.n0) + phi * (Lanes4(t.n1) + phi * t.n2), 0.f);
+            denominator = denominator * maxOf(Lanes4(t.d0) + phi * (Lanes4(t.d1) + phi * t.d2), 1.e-30f);
+
+            // z^-1 = exp(-jw)
+            const Lanes4 nr = Lanes4(t.b0) + c1 * t.b1 + c2 * t.b2;
+            const Lanes4 ni = Lanes4(0.f) - (s1 * t.b1 + s2 * t.b2);
+            const Lanes4 dr = Lanes4(1.f) + c1 * t.a1 + c2 * t.a2;
+            const Lanes4 di = Lanes4(0.f) - (s1 * t.a1 + s2 * t.a2);
+            const Lanes4 hr = nr * dr + ni * di;
+            const Lanes4 hi = ni * dr - nr * di;
+
+            const Lanes4 r = re * hr - im * hi;
+            im = re * hi + im * hr;
+            re = r;
+        }
+        (numerator / denominator).store(&m_power[k]);
+        re.store(&m_real[k]);
+        im.store(&m_imag[k]);
+    }
+
+    for (int k = 0; k < m_count; ++k)
+    {
+        m_magnitude[k] = std::sqrt(m_power[k]);
+        m_phase[k] = std::atan2(m_imag[k], m_real[k]);
+    }
+    return true;
+}
+
+}  // namespace lab
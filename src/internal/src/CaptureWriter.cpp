@@ -0,0 +1,291 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/CaptureWriter.h"
+#include "LabSound/core/AudioNode.h"
+#include "internal/DenormalDisabler.h"
+#include "internal/RecordingFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    // The ring holds this much audio, so the writer may fall this far behind the render thread
+    const double RingSeconds = 4.0;
+
+    // The writer wakes this often to drain the ring
+    const int WriterPeriodMilliseconds = 10;
+
+    // A file's header is rewritten after about this much audio
+    const double HeaderUpdateSeconds = 1.0;
+
+    // Each block in the ring is a header of its session, channel count and frame count,
+    // stored bitwise in floats, followed by its interleaved frames
+    const int BlockHeader = 3;
+
+    inline float toSlot(uint32_t v)
+    {
+        float f;
+        memcpy(&f, &v, sizeof(f));
+        return f;
+    }
+
+    inline uint32_t fromSlot(float f)
+    {
+        uint32_t v;
+        memcpy(&v, &f, sizeof(v));
+        return v;
+    }
+}
+
+CaptureWriter::CaptureWriter(float sampleRate, int channels)
+    : m_ring(static_cast<size_t>(RingSeconds * sampleRate) * std::max(1, channels))
+    , m_renderBlock(BlockHeader + size_t(AudioNode::MaxProcessingSizeInFrames) * std::max(1, channels))
+    , m_headerPeriod(static_cast<uint64_t>(HeaderUpdateSeconds * sampleRate))
+    , m_memory(MemoryAccounting::charge(0))
+{
+    chargeMemory();
+    m_worker = std::thread(&CaptureWriter::workerEntry, this);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+    if (m_file)
+        m_file->close();
+    m_memory->charge(-m_charged);
+}
+
+void CaptureWriter::chargeMemory()
+{
+    size_t bytes = sizeof(float) * (m_ring.getSize() + m_renderBlock.capacity() + m_block.capacity() + m_remapped.capacity());
+    for (const auto & channel : m_data)
+        bytes += sizeof(float) * channel.capacity();
+
+    m_memory->charge(static_cast<int64_t>(bytes) - m_charged);
+    m_charged = static_cast<int64_t>(bytes);
+}
+
+void CaptureWriter::workerEntry()
+{
+    DenormalDisabler denormalDisabler;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        drain();
+        ++m_passes;
+        m_drained.notify_all();
+        if (m_quit)
+            return;
+        m_wake.wait_for(lock, std::chrono::milliseconds(WriterPeriodMilliseconds));
+    }
+}
+
+// Called by the render thread, which doesn't wait if the writer is busy, since then it is
+// already draining the ring
+void CaptureWriter::wakeWorker()
+{
+    if (m_mutex.try_lock())
+    {
+        m_wake.notify_one();
+        m_mutex.unlock();
+    }
+}
+
+// Waits, with the lock held, until the writer has drained everything in the ring now
+void CaptureWriter::flush(std::unique_lock<std::mutex> & lock)
+{
+    const uint64_t target = m_passes + 1;
+    m_wake.notify_one();
+    m_drained.wait(lock, [&]() { return m_passes >= target; });
+}
+
+uint32_t CaptureWriter::beginToMemory()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return begin(lock, nullptr);
+}
+
+uint32_t CaptureWriter::beginToFile(std::unique_ptr<RecordingFile> file)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return begin(lock, std::move(file));
+}
+
+uint32_t CaptureWriter::begin(std::unique_lock<std::mutex> & lock, std::unique_ptr<RecordingFile> file)
+{
+    if (m_activeSession)
+        end(lock, m_activeSession);
+
+    if (++m_nextSession == 0)
+        ++m_nextSession;
+    m_activeSession = m_nextSession;
+    m_file = std::move(file);
+    m_headerFrames = 0;
+    return m_activeSession;
+}
+
+void CaptureWriter::end(uint32_t session)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    end(lock, session);
+}
+
+void CaptureWriter::end(std::unique_lock<std::mutex> & lock, uint32_t session)
+{
+    if (!session || m_activeSession != session)
+        return;
+
+    flush(lock);
+    m_activeSession = 0;
+    if (m_file)
+        m_file->close();
+    m_file.reset();
+}
+
+std::vector<std::vector<float>> CaptureWriter::takeRecording()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_activeSession && !m_file)
+        flush(lock);
+
+    std::vector<std::vector<float>> data;
+    data.swap(m_data);
+    chargeMemory();  // the recording is the caller's now
+    return data;
+}
+
+size_t CaptureWriter::recordedFrames()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_activeSession && !m_file)
+        flush(lock);
+    return m_data.empty() ? 0 : m_data[0].size();
+}
+
+float * CaptureWriter::beginBlock(int channels, int frames)
+{
+    // the block was sized for the channels the writer was made with, and only grows if a
+    // quantum has more
+    const size_t count = BlockHeader + size_t(channels) * frames;
+    if (m_renderBlock.size() < count)
+        m_renderBlock.resize(count);
+
+    m_renderChannels = channels;
+    m_renderFrames = frames;
+    return m_renderBlock.data() + BlockHeader;
+}
+
+void CaptureWriter::commitBlock(uint32_t session, bool offline)
+{
+    float * block = m_renderBlock.data();
+    block[0] = toSlot(session);
+    block[1] = toSlot(static_cast<uint32_t>(m_renderChannels));
+    block[2] = toSlot(static_cast<uint32_t>(m_renderFrames));
+    const size_t count = BlockHeader + size_t(m_renderChannels) * m_renderFrames;
+
+    // the block is written whole, so the writer never sees part of one. An offline
+    // context has no deadline to keep, so it waits for the writer rather than dropping.
+    bool written = m_ring.write(block, count);
+    while (!written && offline)
+    {
+        wakeWorker();
+        std::this_thread::yield();
+        written = m_ring.write(block, count);
+    }
+
+    if (!written)
+        m_dropped.fetch_add(m_renderFrames, std::memory_order_relaxed);
+    else if (m_ring.getAvailableWrite() < m_ring.getSize() / 2)
+        wakeWorker();
+}
+
+// Runs on the worker with the lock held
+void CaptureWriter::drain()
+{
+    if (m_clearRequested.exchange(false))
+    {
+        for (auto & channel : m_data)
+            channel.clear();
+    }
+
+    float header[BlockHeader];
+    while (m_ring.getAvailableRead() >= BlockHeader && m_ring.read(header, BlockHeader))
+    {
+        const uint32_t session = fromSlot(header[0]);
+        const int channels = static_cast<int>(fromSlot(header[1]));
+        const int frames = static_cast<int>(fromSlot(header[2]));
+        m_block.resize(size_t(channels) * frames);
+        if (!m_ring.read(m_block.data(), m_block.size()))
+            break;
+
+        if (!session || session != m_activeSession)
+            continue;
+
+        if (m_file)
+            writeToFile(channels, frames);
+        else
+            writeToMemory(channels, frames);
+    }
+    chargeMemory();
+}
+
+void CaptureWriter::writeToFile(int channels, int frames)
+{
+    if (!m_file->framesWritten() && channels != m_file->channels())
+        m_file->setChannelCount(channels);
+
+    const int fileChannels = m_file->channels();
+    const float * interleaved = m_block.data();
+    if (channels != fileChannels)
+    {
+        m_remapped.assign(size_t(fileChannels) * frames, 0.f);
+        const int shared = std::min(channels, fileChannels);
+        for (int i = 0; i < frames; ++i)
+            for (int c = 0; c < shared; ++c)
+                m_remapped[size_t(i) * fileChannels + c] = m_block[size_t(i) * channels + c];
+        interleaved = m_remapped.data();
+    }
+
+    m_file->write(interleaved, frames);
+    m_headerFrames += frames;
+    if (m_headerFrames >= m_headerPeriod)
+    {
+        m_file->updateHeader();
+        m_headerFrames = 0;
+    }
+}
+
+void CaptureWriter::writeToMemory(int channels, int frames)
+{
+    if (static_cast<int>(m_data.size()) < channels)
+    {
+        // channels that join part way through start with silence
+        const size_t length = m_data.empty() ? 0 : m_data[0].size();
+        m_data.resize(channels, std::vector<float>(length, 0.f));
+    }
+
+    for (size_t c = 0; c < m_data.size(); ++c)
+    {
+        std::vector<float> & channel = m_data[c];
+        const size_t length = channel.size();
+        channel.resize(length + frames, 0.f);
+        if (static_cast<int>(c) < channels)
+        {
+            for (int i = 0; i < frames; ++i)
+                channel[length + i] = m_block[size_t(i) * channels + c];
+        }
+    }
+}
+
+}  // namespace lab
@@ -0,0 +1,61 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/CompensationDelay.h"
+#include "LabSound/core/AudioBus.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+CompensationDelay::CompensationDelay(int delayFrames)
+    : m_delayFrames(std::max(1, delayFrames))
+{
+}
+
+CompensationDelay::~CompensationDelay() {}
+
+AudioBus & CompensationDelay::process(const AudioBus & source, int framesToProcess)
+{
+    const int channels = source.numberOfChannels();
+    if (!m_output || m_output->numberOfChannels() != channels || m_output->length() < framesToProcess)
+        m_output.reset(new AudioBus(channels, std::max(framesToProcess, source.length())));
+    if (static_cast<int>(m_rings.size()) != channels)
+        m_rings.resize(channels, std::vector<float>(m_delayFrames, 0.f));
+
+    const int delay = m_delayFrames;
+    const int n = framesToProcess;
+    for (int c = 0; c < channels; ++c)
+    {
+        const float * input = source.channel(c)->data();
+        float * ring = m_rings[c].data();
+        float * output = m_output->channel(c)->mutableData();
+
+        if (n <= delay)
+        {
+            // read the n oldest frames out of the ring, and write the block in their place
+            const int first = std::min(n, delay - m_position);
+            memcpy(output, ring + m_position, sizeof(float) * first);
+            memcpy(output + first, ring, sizeof(float) * (n - first));
+            memcpy(ring + m_position, input, sizeof(float) * first);
+            memcpy(ring, input + first, sizeof(float) * (n - first));
+        }
+        else
+        {
+            // the whole ring comes out first, followed by the start of the block, and the end
+            // of the block is what remains
+            const int first = delay - m_position;
+            memcpy(output, ring + m_position, sizeof(float) * first);
+            memcpy(output + first, ring, sizeof(float) * m_position);
+            memcpy(output + delay, input, sizeof(float) * (n - delay));
+            memcpy(ring, input + n - delay, sizeof(float) * delay);
+        }
+    }
+
+    m_position = n <= delay ? (m_position + n) % delay : 0;
+    return *m_output;
+}
+
+}  // namespace lab
@@ -0,0 +1,70 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/DeferredRelease.h"
+
+namespace lab
+{
+
+namespace
+{
+    // enough for the nodes and buses a large graph edit lets go of in a quantum
+    const size_t ReleaseCapacity = 4096;
+
+    // the reclaim thread wakes when signalled, and now and then regardless, in case a
+    // signal raced its going to sleep
+    const int ReclaimWaitMilliseconds = 100;
+}
+
+DeferredRelease & DeferredRelease::shared()
+{
+    static DeferredRelease deferred(ReleaseCapacity);
+    return deferred;
+}
+
+DeferredRelease::DeferredRelease(size_t capacity)
+    : m_queue(capacity)
+{
+    m_thread = std::thread([this]() { run(); });
+}
+
+DeferredRelease::~DeferredRelease()
+{
+    m_running.store(false, std::memory_order_release);
+    m_pending.signal();
+    if (m_thread.joinable())
+        m_thread.join();
+    drain();
+}
+
+void DeferredRelease::release(std::shared_ptr<const void> object)
+{
+    if (!object)
+        return;
+
+    if (!m_queue.tryPush(std::move(object)))
+    {
+        // released as this function returns
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_pending.signal();
+}
+
+void DeferredRelease::run()
+{
+    while (m_running.load(std::memory_order_acquire))
+    {
+        m_pending.waitFor(ReclaimWaitMilliseconds);
+        drain();
+    }
+}
+
+void DeferredRelease::drain()
+{
+    std::shared_ptr<const void> object;
+    while (m_queue.tryPop(object))
+        object.reset();
+}
+
+}  // namespace lab
@@ -7,8 +7,12 @@
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
 #include "internal/DelayDSPKernel.h"
+#include "internal/DenormalDisabler.h"
+#include "internal/Lanes4.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace std;
 
@@ -17,35 +21,57 @@ namespace lab
 
 const float SmoothingTimeConstant = 0.020f;  // 20ms
 
-DelayDSPKernel::DelayDSPKernel(DelayProcessor * processor, float sampleRate)
-    : AudioDSPKernel(processor)
-    , m_writeIndex(0)
-    , m_firstTime(true)
-    , m_delayTimes(AudioNode::ProcessingSizeInFrames)
+// The smoothed delay is taken to have settled once it is this close to the target
+const double SettledDelayFrames = 1e-6;
+
+namespace
 {
-    ASSERT(processor);
-    if (!processor)
-        return;
+    // Copies count frames from the ring, starting at index, which may be negative
+    inline void readRing(const float * ring, int mask, int index, int count, float * dest)
+    {
+        index &= mask;
+        const int first = std::min(count, mask + 1 - index);
+        memcpy(dest, ring + index, sizeof(float) * first);
+        memcpy(dest + first, ring, sizeof(float) * (count - first));
+    }
 
-    m_maxDelayTime = processor->maxDelayTime();
-    ASSERT(m_maxDelayTime >= 0);
-    if (m_maxDelayTime < 0)
-        return;
+    template <typename T>
+    inline T linear(T s0, T s1, T t) { return s0 + (s1 - s0) * t; }
 
-    m_buffer.allocate((int) bufferLengthForDelay(m_maxDelayTime, sampleRate));
-    m_buffer.zero();
+    // Third order Lagrange interpolation through four frames, at t between s0 and s1
+    template <typename T>
+    inline T lagrange(T sm1, T s0, T s1, T s2, T t)
+    {
+        const T tp1 = t + T(1.f);
+        const T tm1 = t - T(1.f);
+        const T tm2 = t - T(2.f);
+        return tm1 * tm2 * (T(-1.f / 6.f) * t * sm1 + T(0.5f) * tp1 * s0) +
+               tp1 * t * (T(-0.5f) * tm2 * s1 + T(1.f / 6.f) * tm1 * s2);
+    }
 
-    m_smoothingRate = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, sampleRate);
+    // First order allpass interpolation, delta frames behind the newer of two frames
+    inline float allpass(float newer, float older, float delta, float & state)
+    {
+        const float eta = (1.f - delta) / (1.f + delta);
+        state = eta * (newer - state) + older;
+        return state;
+    }
 }
 
 DelayDSPKernel::DelayDSPKernel(double maxDelayTime, float sampleRate)
-    : AudioDSPKernel()
+    : m_bufferMask(0)
     , m_maxDelayTime(maxDelayTime)
     , m_writeIndex(0)
     , m_firstTime(true)
+    , m_desiredDelayFrames(0)
+    , m_interpolation(DelayNode::InterpolationMode::LINEAR)
+    , m_allpassOutput(0)
+    , m_window(MaxBlockFrames + InterpolationFrames)
+    , m_fractions(MaxBlockFrames)
+    , m_readIndices(MaxBlockFrames)
 {
-    ASSERT(maxDelayTime > 0.0);
-    if (maxDelayTime <= 0.0)
+    ASSERT(maxDelayTime >= 0.0);
+    if (maxDelayTime < 0.0)
         return;
 
     int bufferLength = (int) bufferLengthForDelay(maxDelayTime, sampleRate);
@@ -54,6 +80,7 @@ DelayDSPKernel::DelayDSPKernel(double maxDelayTime, float sampleRate)
 
     m_buffer.allocate(bufferLength);
     m_buffer.zero();
+    m_bufferMask = bufferLength - 1;
 
     m_smoothingRate = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, sampleRate);
 }
@@ -61,107 +88,181 @@ DelayDSPKernel::DelayDSPKernel(double maxDelayTime, float sampleRate)
 size_t DelayDSPKernel::bufferLengthForDelay(double maxDelayTime, double sampleRate) const
 {
     // Compute the length of the buffer needed to handle a max delay of |maxDelayTime|. One is
-    // added to handle the case where the actual delay equals the maximum delay.
-    return 1 + AudioUtilities::timeToSampleFrame(maxDelayTime, sampleRate);
+    // added to handle the case where the actual delay equals the maximum delay, and room is
+    // left for a block to be written ahead of its reads, and for the interpolation frames.
+    // The length is rounded up to a power of two so that indices can be masked.
+    const size_t frames = 1 + AudioUtilities::timeToSampleFrame(maxDelayTime, sampleRate) + MaxBlockFrames + InterpolationFrames;
+    size_t length = 1;
+    while (length < frames)
+        length <<= 1;
+    return length;
 }
 
 void DelayDSPKernel::process(ContextRenderLock & r, const float * source, float * destination, int framesToProcess)
 {
-    size_t bufferLength = m_buffer.size();
-    float * buffer = m_buffer.data();
+    Params params;
+    params.sampleRate = r.context()->sampleRate();
+    params.delayTime = min(m_maxDelayTime, max(0.0, m_desiredDelayFrames / params.sampleRate));
+    params.interpolation = m_interpolation < DelayNode::InterpolationMode::_Count ?
+        m_interpolation : DelayNode::InterpolationMode::LINEAR;
 
-    ASSERT(bufferLength);
-    if (!bufferLength)
+    process(params, source, destination, framesToProcess);
+}
+
+void DelayDSPKernel::process(const Params & params, const float * source, float * destination, int framesToProcess)
+{
+    ASSERT(m_buffer.size());
+    if (!m_buffer.size())
         return;
 
     ASSERT(source && destination);
     if (!source || !destination)
         return;
 
-    float sampleRate = r.context()->sampleRate();
-    double delayTime = 0;
-    float * delayTimes = m_delayTimes.data();
-    double maxTime = maxDelayTime();
-
-#if 1
-    /// @TODO before deleting the else clause here, is there a legitimate reason to have the delayTime be automated?
-    /// is it not just a setting? If it's actually an audio rate signal, then delayTime should be switched back
-    /// from AudioSetting to AudioParam.
-    delayTime = delayProcessor() ? delayProcessor()->delayTime()->valueFloat() : m_desiredDelayFrames / sampleRate;
-
-    // Make sure the delay time is in a valid range.
-    delayTime = min(maxTime, delayTime);
-    delayTime = max(0.0, delayTime);
-
     if (m_firstTime)
     {
-        m_currentDelayTime = delayTime;
+        m_currentDelayTime = params.delayTime;
         m_firstTime = false;
     }
-    bool sampleAccurate = false;
-#else
-    bool sampleAccurate = delayProcessor() && delayProcessor()->delayTime()->hasSampleAccurateValues();
 
-    if (sampleAccurate)
-        delayProcessor()->delayTime()->calculateSampleAccurateValues(r, delayTimes, framesToProcess);
-    else
+    for (int offset = 0; offset < framesToProcess; offset += MaxBlockFrames)
     {
-        delayTime = delayProcessor() ? delayProcessor()->delayTime()->finalValue(r) : m_desiredDelayFrames / sampleRate;
+        const int frames = min(static_cast<int>(MaxBlockFrames), framesToProcess - offset);
+        processBlock(params.interpolation, source + offset, destination + offset, frames, params.delayTime, params.sampleRate);
+    }
 
-        // Make sure the delay time is in a valid range.
-        delayTime = min(maxTime, delayTime);
-        delayTime = max(0.0, delayTime);
+    m_allpassOutput = DenormalDisabler::flushDenormalFloatToZero(m_allpassOutput);
+}
 
-        if (m_firstTime)
-        {
-            m_currentDelayTime = delayTime;
-            m_firstTime = false;
-        }
-    }
-#endif
+void DelayDSPKernel::processBlock(DelayNode::InterpolationMode mode, const float * source, float * destination, int framesToProcess,
+                                  double delayTime, double sampleRate)
+{
+    float * buffer = m_buffer.data();
+    const int mask = m_bufferMask;
 
-    for (int i = 0; i < framesToProcess; ++i)
+    // Write the block first, so that every frame can read any delay from zero up.
+    const int blockStart = m_writeIndex;
+    const int firstWrite = min(framesToProcess, mask + 1 - blockStart);
+    memcpy(buffer + blockStart, source, sizeof(float) * firstWrite);
+    memcpy(buffer, source + firstWrite, sizeof(float) * (framesToProcess - firstWrite));
+    m_writeIndex = (blockStart + framesToProcess) & mask;
+
+    if (fabs(delayTime - m_currentDelayTime) * sampleRate < SettledDelayFrames)
     {
-        if (sampleAccurate)
+        // The delay is constant for the block.
+        m_currentDelayTime = delayTime;
+
+        const double delayFrames = delayTime * sampleRate;
+        const int wholeFrames = static_cast<int>(delayFrames);
+        const float fraction = static_cast<float>(delayFrames - wholeFrames);
+
+        if (fraction == 0.f)
         {
-            delayTime = delayTimes[i];
-            delayTime = std::min(maxTime, delayTime);
-            delayTime = std::max(0.0, delayTime);
-            m_currentDelayTime = delayTime;
+            readRing(buffer, mask, blockStart - wholeFrames, framesToProcess, destination);
+            m_allpassOutput = destination[framesToProcess - 1];
+            return;
         }
-        else
+
+        // window[i + 1] and window[i + 2] are the frames that frame i lies between, and
+        // window[i] and window[i + 3] the frames either side of them.
+        float * window = m_window.data();
+        readRing(buffer, mask, blockStart - wholeFrames - 2, framesToProcess + InterpolationFrames, window);
+
+        if (mode == DelayNode::InterpolationMode::ALLPASS)
         {
-            // Approach desired delay time.
-            m_currentDelayTime += (delayTime - m_currentDelayTime) * m_smoothingRate;
+            // The allpass is most even with a delay of half a frame to a frame and a half
+            const int shift = fraction < 0.5f && wholeFrames >= 1 ? 1 : 0;
+            const float delta = fraction + shift;
+            for (int i = 0; i < framesToProcess; ++i)
+                destination[i] = allpass(window[i + 2 + shift], window[i + 1 + shift], delta, m_allpassOutput);
+            return;
         }
 
-        double desiredDelayFrames = m_currentDelayTime * sampleRate;
+        const bool useLagrange = mode == DelayNode::InterpolationMode::LAGRANGE && wholeFrames >= 1;
+        const float t = 1.f - fraction;
+        const Lanes4 t4(t);
 
-        double readPosition = m_writeIndex + bufferLength - desiredDelayFrames;
-        if (readPosition >= bufferLength)
-            readPosition -= bufferLength;
-
-        // Linearly interpolate in-between delay times.
-        int readIndex1 = static_cast<int>(readPosition);
-        int readIndex2 = (readIndex1 + 1) % bufferLength;
-        double interpolationFactor = readPosition - readIndex1;
+        int i = 0;
+        if (useLagrange)
+        {
+            for (; i + 4 <= framesToProcess; i += 4)
+                lagrange(Lanes4::load(window + i), Lanes4::load(window + i + 1), Lanes4::load(window + i + 2),
+                         Lanes4::load(window + i + 3), t4).store(destination + i);
+            for (; i < framesToProcess; ++i)
+                destination[i] = lagrange(window[i], window[i + 1], window[i + 2], window[i + 3], t);
+        }
+        else
+        {
+            for (; i + 4 <= framesToProcess; i += 4)
+                linear(Lanes4::load(window + i + 1), Lanes4::load(window + i + 2), t4).store(destination + i);
+            for (; i < framesToProcess; ++i)
+                destination[i] = linear(window[i + 1], window[i + 2], t);
+        }
 
-        double input = static_cast<float>(*source++);
-        buffer[m_writeIndex] = static_cast<float>(input);
-        m_writeIndex = (m_writeIndex + 1) % bufferLength;
+        m_allpassOutput = destination[framesToProcess - 1];
+        return;
+    }
 
-        double sample1 = buffer[readIndex1];
-        double sample2 = buffer[readIndex2];
+    // The delay is moving towards its target, so each frame has its own read position,
+    // relative to the start of the block: readIndices[i] is the frame before it, and
+    // fractions[i] how far it is past that frame.
+    float * fractions = m_fractions.data();
+    int * readIndices = m_readIndices.data();
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        // Approach desired delay time.
+        m_currentDelayTime += (delayTime - m_currentDelayTime) * m_smoothingRate;
 
-        double output = (1.0 - interpolationFactor) * sample1 + interpolationFactor * sample2;
+        const double position = i - m_currentDelayTime * sampleRate;
+        const double whole = floor(position);
+        readIndices[i] = static_cast<int>(whole);
+        fractions[i] = static_cast<float>(position - whole);
+    }
 
-        *destination++ = static_cast<float>(output);
+    switch (mode)
+    {
+        case DelayNode::InterpolationMode::ALLPASS:
+            for (int i = 0; i < framesToProcess; ++i)
+            {
+                // the newest frame at or before the read position, and the delay behind it
+                int newer = readIndices[i] + (fractions[i] > 0.f ? 1 : 0);
+                float delta = fractions[i] > 0.f ? 1.f - fractions[i] : 0.f;
+                if (delta < 0.5f && newer + 1 <= i)
+                {
+                    ++newer;
+                    delta += 1.f;
+                }
+                destination[i] = allpass(buffer[(blockStart + newer) & mask], buffer[(blockStart + newer - 1) & mask], delta, m_allpassOutput);
+            }
+            break;
+
+        case DelayNode::InterpolationMode::LAGRANGE:
+            for (int i = 0; i < framesToProcess; ++i)
+            {
+                const int k = blockStart + readIndices[i];
+                if (readIndices[i] + 2 <= i)
+                    destination[i] = lagrange(buffer[(k - 1) & mask], buffer[k & mask], buffer[(k + 1) & mask], buffer[(k + 2) & mask], fractions[i]);
+                else
+                    destination[i] = linear(buffer[k & mask], buffer[(k + 1) & mask], fractions[i]);
+            }
+            m_allpassOutput = destination[framesToProcess - 1];
+            break;
+
+        default:
+            for (int i = 0; i < framesToProcess; ++i)
+            {
+                const int k = blockStart + readIndices[i];
+                destination[i] = linear(buffer[k & mask], buffer[(k + 1) & mask], fractions[i]);
+            }
+            m_allpassOutput = destination[framesToProcess - 1];
+            break;
     }
 }
 
 void DelayDSPKernel::reset()
 {
     m_firstTime = true;
+    m_allpassOutput = 0;
     m_buffer.zero();
 }
 
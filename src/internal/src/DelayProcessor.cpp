@@ -3,8 +3,11 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "internal/DelayProcessor.h"
-#include "internal/AudioDSPKernelProcessor.h"
-#include "internal/DelayDSPKernel.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include <algorithm>
 
 using namespace std;
 
@@ -12,11 +15,13 @@ namespace lab
 {
 
 
-DelayProcessor::DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> t)
-    : AudioDSPKernelProcessor()
+DelayProcessor::DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> t,
+                               std::shared_ptr<AudioSetting> interpolation)
+    : AudioDSPKernelProcessor<DelayDSPKernel>()
     , m_maxDelayTime(maxDelayTime)
     , m_sampleRate(sampleRate)
     , m_delayTime(t)
+    , m_interpolation(interpolation)
 {
 }
 
@@ -26,9 +31,27 @@ DelayProcessor::~DelayProcessor()
         uninitialize();
 }
 
-AudioDSPKernel * DelayProcessor::createKernel()
+std::unique_ptr<DelayDSPKernel> DelayProcessor::createKernel()
+{
+    return std::unique_ptr<DelayDSPKernel>(new DelayDSPKernel(m_maxDelayTime, m_sampleRate));
+}
+
+DelayDSPKernel::Params DelayProcessor::kernelParams(ContextRenderLock & r)
 {
-    return new DelayDSPKernel(this, m_sampleRate);
+    DelayDSPKernel::Params params;
+    params.sampleRate = r.context()->sampleRate();
+
+    /// @TODO is there a legitimate reason to have the delayTime be automated? is it not just a
+    /// setting? If it's actually an audio rate signal, then delayTime should be switched back
+    /// from AudioSetting to AudioParam, and the moving delay path given per frame times.
+    params.delayTime = min(m_maxDelayTime, max(0.0, double(m_delayTime->valueFloat())));
+
+    params.interpolation = m_interpolation ?
+        DelayNode::InterpolationMode(m_interpolation->valueUint32()) : DelayNode::InterpolationMode::LINEAR;
+    if (params.interpolation >= DelayNode::InterpolationMode::_Count)
+        params.interpolation = DelayNode::InterpolationMode::LINEAR;
+
+    return params;
 }
 
 }  // namespace lab
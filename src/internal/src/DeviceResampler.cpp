@@ -0,0 +1,68 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/DeviceResampler.h"
+
+#include "LabSound/extended/Logging.h"
+
+#include "libsamplerate/include/samplerate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+DeviceResampler::DeviceResampler(int channels, double sourceRate, double destinationRate, int sourceFrames,
+                                 std::function<void(float *, int)> pull)
+    : _pull(std::move(pull))
+    , _block(static_cast<size_t>(channels) * sourceFrames)
+    , _channels(channels)
+    , _sourceFrames(sourceFrames)
+    , _ratio(destinationRate / sourceRate)
+{
+    // the medium sinc is transparent for audio, and about half the cost of the best
+    int error = 0;
+    _state = src_callback_new(&DeviceResampler::supply, SRC_SINC_MEDIUM_QUALITY, channels, &error, this);
+    if (!_state)
+        LOG_ERROR("DeviceResampler: %s", src_strerror(error));
+}
+
+DeviceResampler::~DeviceResampler()
+{
+    if (_state)
+        src_delete(_state);
+}
+
+long DeviceResampler::supply(void * self, float ** data)
+{
+    DeviceResampler * resampler = static_cast<DeviceResampler *>(self);
+    resampler->_pull(resampler->_block.data(), resampler->_sourceFrames);
+    *data = resampler->_block.data();
+    return resampler->_sourceFrames;
+}
+
+void DeviceResampler::process(float * interleaved, int frames)
+{
+    long written = 0;
+    if (_state)
+    {
+        while (written < frames)
+        {
+            long n = src_callback_read(_state, _ratio, frames - written, interleaved + written * _channels);
+            if (n <= 0)
+                break;
+            written += n;
+        }
+    }
+    if (written < frames)
+        std::memset(interleaved + written * _channels, 0, sizeof(float) * (frames - written) * _channels);
+}
+
+void DeviceResampler::reset()
+{
+    if (_state)
+        src_reset(_state);
+}
+
+}  // namespace lab
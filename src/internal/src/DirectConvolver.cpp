@@ -39,6 +39,17 @@
 #include "LabSound/extended/VectorMath.h"
 #include "LabSound/core/Macros.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <string.h>
+
 namespace lab {
     
 DirectConvolver::DirectConvolver(size_t inputBlockSize)
@@ -47,12 +58,52 @@ DirectConvolver::DirectConvolver(size_t inputBlockSize)
 {
 }
 
-void DirectConvolver::process(AudioFloatArray* convolutionKernel, const float* sourceP, float* destP, size_t framesToProcess)
+// Convolves framesToProcess frames, reading kernelSize - 1 frames of history before inputP.
+// Outputs are computed four at a time, each kernel tap multiplying four adjacent inputs, so
+// that the loads are contiguous and the sums independent.
+static void convolve(const float* kernelP, size_t kernelSize, const float* inputP, float* destP, size_t framesToProcess)
 {
-    ASSERT(framesToProcess == m_inputBlockSize);
-    if (framesToProcess != m_inputBlockSize)
-        return;
+#if defined(LABSOUND_PLATFORM_OSX)
+    vDSP_conv(inputP - kernelSize + 1, 1, kernelP + kernelSize - 1, -1, destP, 1, framesToProcess, kernelSize);
+#else
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= framesToProcess; i += 8) {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        const float* p = inputP + i;
+        for (size_t j = 0; j < kernelSize; ++j) {
+            const __m128 k = _mm_set1_ps(kernelP[j]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(p - j), k));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(p - j + 4), k));
+        }
+        _mm_storeu_ps(destP + i, sum0);
+        _mm_storeu_ps(destP + i + 4, sum1);
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    for (; i + 8 <= framesToProcess; i += 8) {
+        float32x4_t sum0 = vdupq_n_f32(0);
+        float32x4_t sum1 = vdupq_n_f32(0);
+        const float* p = inputP + i;
+        for (size_t j = 0; j < kernelSize; ++j) {
+            sum0 = vmlaq_n_f32(sum0, vld1q_f32(p - j), kernelP[j]);
+            sum1 = vmlaq_n_f32(sum1, vld1q_f32(p - j + 4), kernelP[j]);
+        }
+        vst1q_f32(destP + i, sum0);
+        vst1q_f32(destP + i + 4, sum1);
+    }
+#endif
+    for (; i < framesToProcess; ++i) {
+        float sum = 0;
+        for (size_t j = 0; j < kernelSize; ++j)
+            sum += inputP[i - j] * kernelP[j];
+        destP[i] = sum;
+    }
+#endif
+}
 
+void DirectConvolver::process(AudioFloatArray* convolutionKernel, const float* sourceP, float* destP, size_t framesToProcess)
+{
     // Only support kernelSize <= m_inputBlockSize
     size_t kernelSize = convolutionKernel->size();
     ASSERT(kernelSize <= m_inputBlockSize);
@@ -67,287 +118,22 @@ void DirectConvolver::process(AudioFloatArray* convolutionKernel, const float* s
     if (!isCopyGood)
         return;
 
+    // The buffer holds the last m_inputBlockSize frames of input, followed by the frames
+    // being convolved. Blocks of any size are convolved up to m_inputBlockSize frames at a
+    // time, after each of which the history slides along.
     float* inputP = m_buffer.data() + m_inputBlockSize;
+    while (framesToProcess) {
+        const size_t n = std::min(framesToProcess, m_inputBlockSize);
 
-    // Copy samples to 2nd half of input buffer.
-    memcpy(inputP, sourceP, sizeof(float) * framesToProcess);
-
-#if defined(LABSOUND_PLATFORM_OSX) //#if USE(ACCELERATE)
-    vDSP_conv(inputP - kernelSize + 1, 1, kernelP + kernelSize - 1, -1, destP, 1, framesToProcess, kernelSize);
-#else
-    // FIXME: The macro can be further optimized to avoid pipeline stalls. One possibility is to maintain 4 separate sums and change the macro to CONVOLVE_FOUR_SAMPLES.
-#define CONVOLVE_ONE_SAMPLE             \
-    sum += inputP[i - j] * kernelP[j];  \
-    j++;
+        // Copy samples to 2nd half of input buffer.
+        memcpy(inputP, sourceP, sizeof(float) * n);
+        convolve(kernelP, kernelSize, inputP, destP, n);
+        memmove(m_buffer.data(), m_buffer.data() + n, sizeof(float) * m_inputBlockSize);
 
-    size_t i = 0;
-    while (i < framesToProcess) {
-        size_t j = 0;
-        float sum = 0;
-        
-        // FIXME: SSE optimization may be applied here.
-        if (kernelSize == 32) {
-            CONVOLVE_ONE_SAMPLE // 1
-            CONVOLVE_ONE_SAMPLE // 2
-            CONVOLVE_ONE_SAMPLE // 3
-            CONVOLVE_ONE_SAMPLE // 4
-            CONVOLVE_ONE_SAMPLE // 5
-            CONVOLVE_ONE_SAMPLE // 6
-            CONVOLVE_ONE_SAMPLE // 7
-            CONVOLVE_ONE_SAMPLE // 8
-            CONVOLVE_ONE_SAMPLE // 9
-            CONVOLVE_ONE_SAMPLE // 10
-
-            CONVOLVE_ONE_SAMPLE // 11
-            CONVOLVE_ONE_SAMPLE // 12
-            CONVOLVE_ONE_SAMPLE // 13
-            CONVOLVE_ONE_SAMPLE // 14
-            CONVOLVE_ONE_SAMPLE // 15
-            CONVOLVE_ONE_SAMPLE // 16
-            CONVOLVE_ONE_SAMPLE // 17
-            CONVOLVE_ONE_SAMPLE // 18
-            CONVOLVE_ONE_SAMPLE // 19
-            CONVOLVE_ONE_SAMPLE // 20
-
-            CONVOLVE_ONE_SAMPLE // 21
-            CONVOLVE_ONE_SAMPLE // 22
-            CONVOLVE_ONE_SAMPLE // 23
-            CONVOLVE_ONE_SAMPLE // 24
-            CONVOLVE_ONE_SAMPLE // 25
-            CONVOLVE_ONE_SAMPLE // 26
-            CONVOLVE_ONE_SAMPLE // 27
-            CONVOLVE_ONE_SAMPLE // 28
-            CONVOLVE_ONE_SAMPLE // 29
-            CONVOLVE_ONE_SAMPLE // 30
-
-            CONVOLVE_ONE_SAMPLE // 31
-            CONVOLVE_ONE_SAMPLE // 32
-
-        } else if (kernelSize == 64) {
-            CONVOLVE_ONE_SAMPLE // 1
-            CONVOLVE_ONE_SAMPLE // 2
-            CONVOLVE_ONE_SAMPLE // 3
-            CONVOLVE_ONE_SAMPLE // 4
-            CONVOLVE_ONE_SAMPLE // 5
-            CONVOLVE_ONE_SAMPLE // 6
-            CONVOLVE_ONE_SAMPLE // 7
-            CONVOLVE_ONE_SAMPLE // 8
-            CONVOLVE_ONE_SAMPLE // 9
-            CONVOLVE_ONE_SAMPLE // 10
-
-            CONVOLVE_ONE_SAMPLE // 11
-            CONVOLVE_ONE_SAMPLE // 12
-            CONVOLVE_ONE_SAMPLE // 13
-            CONVOLVE_ONE_SAMPLE // 14
-            CONVOLVE_ONE_SAMPLE // 15
-            CONVOLVE_ONE_SAMPLE // 16
-            CONVOLVE_ONE_SAMPLE // 17
-            CONVOLVE_ONE_SAMPLE // 18
-            CONVOLVE_ONE_SAMPLE // 19
-            CONVOLVE_ONE_SAMPLE // 20
-
-            CONVOLVE_ONE_SAMPLE // 21
-            CONVOLVE_ONE_SAMPLE // 22
-            CONVOLVE_ONE_SAMPLE // 23
-            CONVOLVE_ONE_SAMPLE // 24
-            CONVOLVE_ONE_SAMPLE // 25
-            CONVOLVE_ONE_SAMPLE // 26
-            CONVOLVE_ONE_SAMPLE // 27
-            CONVOLVE_ONE_SAMPLE // 28
-            CONVOLVE_ONE_SAMPLE // 29
-            CONVOLVE_ONE_SAMPLE // 30
-
-            CONVOLVE_ONE_SAMPLE // 31
-            CONVOLVE_ONE_SAMPLE // 32
-            CONVOLVE_ONE_SAMPLE // 33
-            CONVOLVE_ONE_SAMPLE // 34
-            CONVOLVE_ONE_SAMPLE // 35
-            CONVOLVE_ONE_SAMPLE // 36
-            CONVOLVE_ONE_SAMPLE // 37
-            CONVOLVE_ONE_SAMPLE // 38
-            CONVOLVE_ONE_SAMPLE // 39
-            CONVOLVE_ONE_SAMPLE // 40
-
-            CONVOLVE_ONE_SAMPLE // 41
-            CONVOLVE_ONE_SAMPLE // 42
-            CONVOLVE_ONE_SAMPLE // 43
-            CONVOLVE_ONE_SAMPLE // 44
-            CONVOLVE_ONE_SAMPLE // 45
-            CONVOLVE_ONE_SAMPLE // 46
-            CONVOLVE_ONE_SAMPLE // 47
-            CONVOLVE_ONE_SAMPLE // 48
-            CONVOLVE_ONE_SAMPLE // 49
-            CONVOLVE_ONE_SAMPLE // 50
-
-            CONVOLVE_ONE_SAMPLE // 51
-            CONVOLVE_ONE_SAMPLE // 52
-            CONVOLVE_ONE_SAMPLE // 53
-            CONVOLVE_ONE_SAMPLE // 54
-            CONVOLVE_ONE_SAMPLE // 55
-            CONVOLVE_ONE_SAMPLE // 56
-            CONVOLVE_ONE_SAMPLE // 57
-            CONVOLVE_ONE_SAMPLE // 58
-            CONVOLVE_ONE_SAMPLE // 59
-            CONVOLVE_ONE_SAMPLE // 60
-
-            CONVOLVE_ONE_SAMPLE // 61
-            CONVOLVE_ONE_SAMPLE // 62
-            CONVOLVE_ONE_SAMPLE // 63
-            CONVOLVE_ONE_SAMPLE // 64
-
-        } else if (kernelSize == 128) {
-            CONVOLVE_ONE_SAMPLE // 1
-            CONVOLVE_ONE_SAMPLE // 2
-            CONVOLVE_ONE_SAMPLE // 3
-            CONVOLVE_ONE_SAMPLE // 4
-            CONVOLVE_ONE_SAMPLE // 5
-            CONVOLVE_ONE_SAMPLE // 6
-            CONVOLVE_ONE_SAMPLE // 7
-            CONVOLVE_ONE_SAMPLE // 8
-            CONVOLVE_ONE_SAMPLE // 9
-            CONVOLVE_ONE_SAMPLE // 10
-
-            CONVOLVE_ONE_SAMPLE // 11
-            CONVOLVE_ONE_SAMPLE // 12
-            CONVOLVE_ONE_SAMPLE // 13
-            CONVOLVE_ONE_SAMPLE // 14
-            CONVOLVE_ONE_SAMPLE // 15
-            CONVOLVE_ONE_SAMPLE // 16
-            CONVOLVE_ONE_SAMPLE // 17
-            CONVOLVE_ONE_SAMPLE // 18
-            CONVOLVE_ONE_SAMPLE // 19
-            CONVOLVE_ONE_SAMPLE // 20
-
-            CONVOLVE_ONE_SAMPLE // 21
-            CONVOLVE_ONE_SAMPLE // 22
-            CONVOLVE_ONE_SAMPLE // 23
-            CONVOLVE_ONE_SAMPLE // 24
-            CONVOLVE_ONE_SAMPLE // 25
-            CONVOLVE_ONE_SAMPLE // 26
-            CONVOLVE_ONE_SAMPLE // 27
-            CONVOLVE_ONE_SAMPLE // 28
-            CONVOLVE_ONE_SAMPLE // 29
-            CONVOLVE_ONE_SAMPLE // 30
-
-            CONVOLVE_ONE_SAMPLE // 31
-            CONVOLVE_ONE_SAMPLE // 32
-            CONVOLVE_ONE_SAMPLE // 33
-            CONVOLVE_ONE_SAMPLE // 34
-            CONVOLVE_ONE_SAMPLE // 35
-            CONVOLVE_ONE_SAMPLE // 36
-            CONVOLVE_ONE_SAMPLE // 37
-            CONVOLVE_ONE_SAMPLE // 38
-            CONVOLVE_ONE_SAMPLE // 39
-            CONVOLVE_ONE_SAMPLE // 40
-
-            CONVOLVE_ONE_SAMPLE // 41
-            CONVOLVE_ONE_SAMPLE // 42
-            CONVOLVE_ONE_SAMPLE // 43
-            CONVOLVE_ONE_SAMPLE // 44
-            CONVOLVE_ONE_SAMPLE // 45
-            CONVOLVE_ONE_SAMPLE // 46
-            CONVOLVE_ONE_SAMPLE // 47
-            CONVOLVE_ONE_SAMPLE // 48
-            CONVOLVE_ONE_SAMPLE // 49
-            CONVOLVE_ONE_SAMPLE // 50
-
-            CONVOLVE_ONE_SAMPLE // 51
-            CONVOLVE_ONE_SAMPLE // 52
-            CONVOLVE_ONE_SAMPLE // 53
-            CONVOLVE_ONE_SAMPLE // 54
-            CONVOLVE_ONE_SAMPLE // 55
-            CONVOLVE_ONE_SAMPLE // 56
-            CONVOLVE_ONE_SAMPLE // 57
-            CONVOLVE_ONE_SAMPLE // 58
-            CONVOLVE_ONE_SAMPLE // 59
-            CONVOLVE_ONE_SAMPLE // 60
-
-            CONVOLVE_ONE_SAMPLE // 61
-            CONVOLVE_ONE_SAMPLE // 62
-            CONVOLVE_ONE_SAMPLE // 63
-            CONVOLVE_ONE_SAMPLE // 64
-            CONVOLVE_ONE_SAMPLE // 65
-            CONVOLVE_ONE_SAMPLE // 66
-            CONVOLVE_ONE_SAMPLE // 67
-            CONVOLVE_ONE_SAMPLE // 68
-            CONVOLVE_ONE_SAMPLE // 69
-            CONVOLVE_ONE_SAMPLE // 70
-
-            CONVOLVE_ONE_SAMPLE // 71
-            CONVOLVE_ONE_SAMPLE // 72
-            CONVOLVE_ONE_SAMPLE // 73
-            CONVOLVE_ONE_SAMPLE // 74
-            CONVOLVE_ONE_SAMPLE // 75
-            CONVOLVE_ONE_SAMPLE // 76
-            CONVOLVE_ONE_SAMPLE // 77
-            CONVOLVE_ONE_SAMPLE // 78
-            CONVOLVE_ONE_SAMPLE // 79
-            CONVOLVE_ONE_SAMPLE // 80
-
-            CONVOLVE_ONE_SAMPLE // 81
-            CONVOLVE_ONE_SAMPLE // 82
-            CONVOLVE_ONE_SAMPLE // 83
-            CONVOLVE_ONE_SAMPLE // 84
-            CONVOLVE_ONE_SAMPLE // 85
-            CONVOLVE_ONE_SAMPLE // 86
-            CONVOLVE_ONE_SAMPLE // 87
-            CONVOLVE_ONE_SAMPLE // 88
-            CONVOLVE_ONE_SAMPLE // 89
-            CONVOLVE_ONE_SAMPLE // 90
-
-            CONVOLVE_ONE_SAMPLE // 91
-            CONVOLVE_ONE_SAMPLE // 92
-            CONVOLVE_ONE_SAMPLE // 93
-            CONVOLVE_ONE_SAMPLE // 94
-            CONVOLVE_ONE_SAMPLE // 95
-            CONVOLVE_ONE_SAMPLE // 96
-            CONVOLVE_ONE_SAMPLE // 97
-            CONVOLVE_ONE_SAMPLE // 98
-            CONVOLVE_ONE_SAMPLE // 99
-            CONVOLVE_ONE_SAMPLE // 100
-
-            CONVOLVE_ONE_SAMPLE // 101
-            CONVOLVE_ONE_SAMPLE // 102
-            CONVOLVE_ONE_SAMPLE // 103
-            CONVOLVE_ONE_SAMPLE // 104
-            CONVOLVE_ONE_SAMPLE // 105
-            CONVOLVE_ONE_SAMPLE // 106
-            CONVOLVE_ONE_SAMPLE // 107
-            CONVOLVE_ONE_SAMPLE // 108
-            CONVOLVE_ONE_SAMPLE // 109
-            CONVOLVE_ONE_SAMPLE // 110
-
-            CONVOLVE_ONE_SAMPLE // 111
-            CONVOLVE_ONE_SAMPLE // 112
-            CONVOLVE_ONE_SAMPLE // 113
-            CONVOLVE_ONE_SAMPLE // 114
-            CONVOLVE_ONE_SAMPLE // 115
-            CONVOLVE_ONE_SAMPLE // 116
-            CONVOLVE_ONE_SAMPLE // 117
-            CONVOLVE_ONE_SAMPLE // 118
-            CONVOLVE_ONE_SAMPLE // 119
-            CONVOLVE_ONE_SAMPLE // 120
-
-            CONVOLVE_ONE_SAMPLE // 121
-            CONVOLVE_ONE_SAMPLE // 122
-            CONVOLVE_ONE_SAMPLE // 123
-            CONVOLVE_ONE_SAMPLE // 124
-            CONVOLVE_ONE_SAMPLE // 125
-            CONVOLVE_ONE_SAMPLE // 126
-            CONVOLVE_ONE_SAMPLE // 127
-            CONVOLVE_ONE_SAMPLE // 128
-        } else {
-            while (j < kernelSize) {
-                // Non-optimized using actual while loop.
-                CONVOLVE_ONE_SAMPLE
-            }
-        }
-        destP[i++] = sum;
+        sourceP += n;
+        destP += n;
+        framesToProcess -= n;
     }
-#endif // USE(ACCELERATE)
-
-    // Copy 2nd half of input buffer to 1st half.
-    memcpy(m_buffer.data(), inputP, sizeof(float) * framesToProcess);
 }
 
 void DirectConvolver::reset()
@@ -0,0 +1,132 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/DopplerDelay.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNode.h"
+#include "internal/Assertions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+// The delay is drawn toward the distance's delay over this time constant, long enough that
+// the correction is not heard as a shift of its own
+static const double CorrectionTimeConstant = 0.5;
+
+namespace
+{
+    // Third order Lagrange interpolation through four frames, at t between s0 and s1
+    inline float lagrange(float sm1, float s0, float s1, float s2, float t)
+    {
+        const float tp1 = t + 1.f;
+        const float tm1 = t - 1.f;
+        const float tm2 = t - 2.f;
+        return tm1 * tm2 * (-1.f / 6.f * t * sm1 + 0.5f * tp1 * s0) +
+               tp1 * t * (-0.5f * tm2 * s1 + 1.f / 6.f * tm1 * s2);
+    }
+}
+
+DopplerDelay::DopplerDelay(double maxDelayTime, float sampleRate)
+    : m_readIndices(AudioNode::ProcessingSizeInFrames)
+    , m_fractions(AudioNode::ProcessingSizeInFrames)
+    , m_delayFrames(MinDelayFrames)
+    , m_writeIndex(0)
+    , m_firstTime(true)
+{
+    ASSERT(maxDelayTime > 0 && sampleRate > 0);
+
+    m_maxDelayFrames = std::max(static_cast<double>(MinDelayFrames), maxDelayTime * sampleRate);
+    m_correctionRate = 1.0 / (CorrectionTimeConstant * sampleRate);
+
+    // room for the longest delay behind the longest block, and the kernel's frames around it
+    const int frames = static_cast<int>(m_maxDelayFrames) + AudioNode::MaxProcessingSizeInFrames + 4;
+    int length = 1;
+    while (length < frames)
+        length <<= 1;
+    m_mask = length - 1;
+}
+
+DopplerDelay::~DopplerDelay() = default;
+
+AudioBus & DopplerDelay::process(const AudioBus & source, int framesToProcess, double rate, double targetDelayFrames)
+{
+    const int channels = source.numberOfChannels();
+    if (!m_output || m_output->numberOfChannels() != channels || m_output->length() < framesToProcess)
+    {
+        m_output.reset(new AudioBus(channels, std::max(framesToProcess, static_cast<int>(AudioNode::ProcessingSizeInFrames))));
+        m_rings.resize(channels);
+        for (auto & ring : m_rings)
+            ring.assign(m_mask + 1, 0.f);
+    }
+    if (static_cast<int>(m_readIndices.size()) < framesToProcess)
+    {
+        m_readIndices.resize(framesToProcess);
+        m_fractions.resize(framesToProcess);
+    }
+
+    const double minDelay = MinDelayFrames;
+    const double maxDelay = m_maxDelayFrames;
+    targetDelayFrames = std::min(maxDelay, std::max(minDelay, targetDelayFrames));
+    if (m_firstTime)
+    {
+        m_delayFrames = targetDelayFrames;
+        m_firstTime = false;
+    }
+
+    // a source approaching at the rate's speed shortens the delay by 1 - rate frames per
+    // frame; the correction only takes up what the velocities and the positions disagree by
+    const double start = m_delayFrames;
+    const double correction = std::min(1.0, framesToProcess * m_correctionRate);
+    double end = start + (1.0 - rate) * framesToProcess + (targetDelayFrames - start) * correction;
+    end = std::min(maxDelay, std::max(minDelay, end));
+
+    // the read positions are shared by every channel; the delay is ramped linearly to end
+    // at the last frame of the block
+    const double step = (end - start) / framesToProcess;
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        const double position = static_cast<double>(m_writeIndex + i) - (start + step * (i + 1));
+        const double whole = std::floor(position);
+        m_readIndices[i] = static_cast<int>(whole);
+        m_fractions[i] = static_cast<float>(position - whole);
+    }
+    m_delayFrames = end;
+
+    const int mask = m_mask;
+    for (int c = 0; c < channels; ++c)
+    {
+        float * ring = m_rings[c].data();
+        const float * input = source.channel(c)->data();
+        float * destination = m_output->channel(c)->mutableData();
+
+        // the block is written first, since the shortest delay reads into it
+        const int first = std::min(framesToProcess, mask + 1 - m_writeIndex);
+        memcpy(ring + m_writeIndex, input, sizeof(float) * first);
+        memcpy(ring, input + first, sizeof(float) * (framesToProcess - first));
+
+        for (int i = 0; i < framesToProcess; ++i)
+        {
+            const int k = m_readIndices[i];
+            destination[i] = lagrange(ring[(k - 1) & mask], ring[k & mask], ring[(k + 1) & mask], ring[(k + 2) & mask],
+                                      m_fractions[i]);
+        }
+    }
+
+    m_writeIndex = (m_writeIndex + framesToProcess) & mask;
+    m_output->clearSilentFlag();
+    return *m_output;
+}
+
+void DopplerDelay::reset()
+{
+    for (auto & ring : m_rings)
+        std::fill(ring.begin(), ring.end(), 0.f);
+    m_writeIndex = 0;
+    m_firstTime = true;
+}
+
+}  // namespace lab
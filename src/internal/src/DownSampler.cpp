@@ -30,6 +30,9 @@
 #include "DownSampler.h"
 #include "LabSound/core/Macros.h"
 #include "internal/Assertions.h"
+
+#include <algorithm>
+#include <string.h>
 //#include <wtf/MathExtras.h>
 
 namespace lab {
@@ -79,18 +82,6 @@ void DownSampler::initializeKernel()
 
 void DownSampler::process(const float* sourceP, float* destP, size_t sourceFramesToProcess)
 {
-    bool isInputBlockSizeGood = sourceFramesToProcess == m_inputBlockSize;
-    ASSERT(isInputBlockSizeGood);
-    if (!isInputBlockSizeGood)
-        return;
-
-    size_t destFramesToProcess = sourceFramesToProcess / 2;
-
-    bool isTempBufferGood = destFramesToProcess == m_tempBuffer.size();
-    ASSERT(isTempBufferGood);
-    if (!isTempBufferGood)
-        return;
-
     bool isReducedKernelGood = m_reducedKernel.size() == DefaultKernelSize / 2;
     ASSERT(isReducedKernelGood);
     if (!isReducedKernelGood)
@@ -98,35 +89,46 @@ void DownSampler::process(const float* sourceP, float* destP, size_t sourceFrame
 
     size_t halfSize = DefaultKernelSize / 2;
 
-    // Copy source samples to 2nd half of input buffer.
-    bool isInputBufferGood = m_inputBuffer.size() == sourceFramesToProcess * 2 && halfSize <= sourceFramesToProcess;
+    bool isInputBufferGood = m_inputBuffer.size() == m_inputBlockSize * 2 && halfSize <= m_inputBlockSize &&
+                             !(m_inputBlockSize & 1) && m_tempBuffer.size() == m_inputBlockSize / 2 && !(sourceFramesToProcess & 1);
     ASSERT(isInputBufferGood);
     if (!isInputBufferGood)
         return;
 
-    float* inputP = m_inputBuffer.data() + sourceFramesToProcess;
-    memcpy(inputP, sourceP, sizeof(float) * sourceFramesToProcess);
-
-    // Copy the odd sample-frames from sourceP, delayed by one sample-frame (destination sample-rate)
-    // to match shifting forward in time in m_reducedKernel.
+    // Blocks of any even size are processed up to m_inputBlockSize frames at a time, after
+    // each of which the delay line slides along.
+    float* inputP = m_inputBuffer.data() + m_inputBlockSize;
     float* oddSamplesP = m_tempBuffer.data();
-    for (unsigned i = 0; i < destFramesToProcess; ++i)
-        oddSamplesP[i] = *((inputP - 1) + i * 2);
+    while (sourceFramesToProcess) {
+        const size_t n = std::min(sourceFramesToProcess, m_inputBlockSize);
+        const size_t destFramesToProcess = n / 2;
+
+        // Copy source samples to 2nd half of input buffer.
+        memcpy(inputP, sourceP, sizeof(float) * n);
+
+        // Copy the odd sample-frames from sourceP, delayed by one sample-frame (destination sample-rate)
+        // to match shifting forward in time in m_reducedKernel.
+        for (size_t i = 0; i < destFramesToProcess; ++i)
+            oddSamplesP[i] = *((inputP - 1) + i * 2);
 
-    // Actually process oddSamplesP with m_reducedKernel for efficiency.
-    // The theoretical kernel is double this size with 0 values for even terms (except center).
-    m_convolver.process(&m_reducedKernel, oddSamplesP, destP, destFramesToProcess);
+        // Actually process oddSamplesP with m_reducedKernel for efficiency.
+        // The theoretical kernel is double this size with 0 values for even terms (except center).
+        m_convolver.process(&m_reducedKernel, oddSamplesP, destP, destFramesToProcess);
 
-    // Now, account for the 0.5 term right in the middle of the kernel.
-    // This amounts to a delay-line of length halfSize (at the source sample-rate),
-    // scaled by 0.5.
+        // Now, account for the 0.5 term right in the middle of the kernel.
+        // This amounts to a delay-line of length halfSize (at the source sample-rate),
+        // scaled by 0.5.
 
-    // Sum into the destination.
-    for (unsigned i = 0; i < destFramesToProcess; ++i)
-        destP[i] += (float) (0.5 * *((inputP - halfSize) + i * 2));
+        // Sum into the destination.
+        for (size_t i = 0; i < destFramesToProcess; ++i)
+            destP[i] += 0.5f * *((inputP - halfSize) + i * 2);
 
-    // Copy 2nd half of input buffer to 1st half.
-    memcpy(m_inputBuffer.data(), inputP, sizeof(float) * sourceFramesToProcess);
+        memmove(m_inputBuffer.data(), m_inputBuffer.data() + n, sizeof(float) * m_inputBlockSize);
+
+        sourceP += n;
+        destP += destFramesToProcess;
+        sourceFramesToProcess -= n;
+    }
 }
 
 void DownSampler::reset()
@@ -0,0 +1,104 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/DriftCompensator.h"
+
+#include "LabSound/extended/Logging.h"
+
+#include "libsamplerate/include/samplerate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    // Per read, the error is smoothed over about a hundred callbacks, and the integral
+    // term takes some seconds to absorb a steady drift. The proportional term alone holds
+    // a drift of a hundred parts per million at a tenth of the target off.
+    const double ErrorSmoothing = 0.01;
+    const double ProportionalGain = 1.e-3;
+    const double IntegralGain = 2.e-6;
+    const double MaxCorrection = 0.005;
+}
+
+DriftCompensator::DriftCompensator(int channels, int targetFrames)
+    : _channels(channels)
+    , _targetFrames(std::max(1, targetFrames))
+    , _blockFrames(std::max(16, _targetFrames / 8))
+{
+    _ring.resize(static_cast<size_t>(_targetFrames) * 4 * channels);
+    _block.resize(static_cast<size_t>(_blockFrames) * channels);
+
+    // the fastest sinc is ample for a ratio this close to one
+    int error = 0;
+    _state = src_callback_new(&DriftCompensator::supply, SRC_SINC_FASTEST, channels, &error, this);
+    if (!_state)
+        LOG_ERROR("DriftCompensator: %s", src_strerror(error));
+}
+
+DriftCompensator::~DriftCompensator()
+{
+    if (_state)
+        src_delete(_state);
+}
+
+void DriftCompensator::write(const float * interleaved, int frames)
+{
+    if (!_ring.write(interleaved, static_cast<size_t>(frames) * _channels))
+        _overruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+long DriftCompensator::supply(void * self, float ** data)
+{
+    DriftCompensator * dc = static_cast<DriftCompensator *>(self);
+    if (!dc->_ring.read(dc->_block.data(), dc->_block.size()))
+    {
+        // ran dry; silence until the ring refills to its target
+        std::fill(dc->_block.begin(), dc->_block.end(), 0.f);
+        dc->_underruns.fetch_add(1, std::memory_order_relaxed);
+        dc->_primed = false;
+    }
+    *data = dc->_block.data();
+    return dc->_blockFrames;
+}
+
+void DriftCompensator::read(float * interleaved, int frames)
+{
+    const size_t bytes = sizeof(float) * static_cast<size_t>(frames) * _channels;
+    const int available = static_cast<int>(_ring.getAvailableRead() / _channels);
+    if (!_state || (!_primed && available < _targetFrames))
+    {
+        std::memset(interleaved, 0, bytes);
+        return;
+    }
+    if (!_primed)
+    {
+        _primed = true;
+        _error = 0;
+        src_reset(_state);
+    }
+
+    // a ring fuller than its target is consumed a little faster, and an emptier one slower
+    const double error = double(available - _targetFrames) / _targetFrames;
+    _error += ErrorSmoothing * (error - _error);
+    _integral = std::max(-MaxCorrection, std::min(MaxCorrection, _integral + IntegralGain * _error));
+    const double correction = std::max(-MaxCorrection, std::min(MaxCorrection, ProportionalGain * _error + _integral));
+    const double ratio = 1.0 / (1.0 + correction);
+    _ratio.store(ratio, std::memory_order_relaxed);
+
+    long written = 0;
+    while (written < frames)
+    {
+        long n = src_callback_read(_state, ratio, frames - written, interleaved + written * _channels);
+        if (n <= 0)
+            break;
+        written += n;
+    }
+    if (written < frames)
+        std::memset(interleaved + written * _channels, 0, sizeof(float) * (frames - written) * _channels);
+}
+
+}  // namespace lab
@@ -103,7 +103,8 @@ void DynamicsCompressor::setEmphasisParameters(float gain, float anchorFreq, flo
     setEmphasisStageParameters(3, gain, anchorFreq / (filterStageRatio * filterStageRatio * filterStageRatio));
 }
 
-void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceBus, AudioBus * destinationBus, int bufferSize, int offset, int count)
+void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceBus, AudioBus * destinationBus, int bufferSize, int offset, int count,
+                                 const AudioBus * sidechainBus)
 {
     int numberOfDestChannels = destinationBus->numberOfChannels();
     int numberOfSourceChannels = sourceBus->numberOfChannels();
@@ -131,6 +132,11 @@ void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceB
         m_destinationChannels[i] = destinationBus->channel(i)->mutableData();
     }
 
+    const int numberOfSidechainChannels = sidechainBus ? sidechainBus->numberOfChannels() : 0;
+    m_sidechainChannels.resize(numberOfSidechainChannels);
+    for (int i = 0; i < numberOfSidechainChannels; ++i)
+        m_sidechainChannels[i] = sidechainBus->channel(i)->data();
+
     float filterStageGain = parameterValue(ParamFilterStageGain);
     float filterStageRatio = parameterValue(ParamFilterStageRatio);
     float anchor = parameterValue(ParamFilterAnchor);
@@ -183,6 +189,8 @@ void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceB
                          m_sourceChannels.get(),
                          m_destinationChannels.get(),
                          numberOfDestChannels,
+                         m_sidechainChannels.data(),
+                         numberOfSidechainChannels,
                          bufferSize,
                          dbThreshold,
                          dbKnee,
@@ -8,10 +8,13 @@
 #include "internal/AudioUtilities.h"
 #include "internal/DenormalDisabler.h"
 #include "internal/DynamicsCompressorKernel.h"
+#include "internal/FastMath.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 
 using namespace std;
@@ -26,6 +29,42 @@ const float meteringReleaseTimeConstant = 0.325f;
 
 const float uninitializedValue = -1;
 
+namespace
+{
+    // The static curve, as used to find the attenuation of each frame
+    struct CurveParameters
+    {
+        float linearThreshold;
+        float kneeThreshold;
+        float kneeThresholdDb;
+        float ykneeThresholdDb;
+        float slope;
+        float k;
+        float satReleaseFrames;
+    };
+
+    // Finds the attenuation of the detector level, and the rate at which the detector
+    // average releases towards it. This is saturate() and the detector's release rate, with
+    // fast approximations, evaluating every part of the curve and selecting between them.
+    template <typename T>
+    inline void detect(T level, const CurveParameters & c, T & attenuation, T & releaseRate)
+    {
+        // Put through shaping curve.
+        // This is linear up to the threshold, then enters a "knee" portion followed by the "ratio" portion.
+        // The transition from the threshold to the knee is smooth (1st derivative matched).
+        // The transition from the knee to the ratio portion is smooth (1st derivative matched).
+        const T linearThreshold(c.linearThreshold);
+        const T knee = linearThreshold + (T(1.f) - FastMath::exp(T(-c.k) * (level - linearThreshold))) * T(1.f / c.k);
+        const T ratio = FastMath::decibelsToLinear(T(c.ykneeThresholdDb) + T(c.slope) * (FastMath::linearToDecibels(level) - T(c.kneeThresholdDb)));
+        const T shaped = select(level < linearThreshold, level, select(level < T(c.kneeThreshold), knee, ratio));
+
+        attenuation = select(level <= T(0.0001f), T(1.f), shaped / maxOf(level, T(0.0001f)));
+
+        const T attenuationDb = maxOf(T(2.f), T(0.f) - FastMath::linearToDecibels(attenuation));
+        releaseRate = FastMath::decibelsToLinear(attenuationDb * T(1.f / c.satReleaseFrames)) - T(1.f);
+    }
+}
+
 DynamicsCompressorKernel::DynamicsCompressorKernel(unsigned numberOfChannels)
     : m_lastPreDelayFrames(DefaultPreDelayFrames)
     , m_preDelayReadIndex(0)
@@ -42,6 +81,11 @@ DynamicsCompressorKernel::DynamicsCompressorKernel(unsigned numberOfChannels)
 {
     setNumberOfChannels(numberOfChannels);
 
+    m_meteringGainDb.allocate(ChunkFrames);
+    m_attenuation.allocate(ChunkFrames);
+    m_releaseRate.allocate(ChunkFrames);
+    m_gain.allocate(ChunkFrames);
+
     // Initializes most member variables
     reset();
 }
@@ -54,7 +98,7 @@ void DynamicsCompressorKernel::setNumberOfChannels(unsigned numberOfChannels)
 
     m_preDelayBuffers.clear();
     for (unsigned i = 0; i < numberOfChannels; ++i)
-        m_preDelayBuffers.push_back(std::unique_ptr<AudioFloatArray>(new AudioFloatArray(MaxPreDelayFrames)));
+        m_preDelayBuffers.push_back(std::unique_ptr<AudioFloatArray>(new AudioFloatArray(PreDelayBufferFrames)));
 }
 
 void DynamicsCompressorKernel::setPreDelayTime(float preDelayTime, float sampleRate)
@@ -188,6 +232,8 @@ void DynamicsCompressorKernel::process(ContextRenderLock & r,
                                        const float * sourceChannels[],
                                        float * destinationChannels[],
                                        unsigned numberOfChannels,
+                                       const float * sidechainChannels[],
+                                       unsigned numberOfSidechainChannels,
                                        int framesToProcess,
                                        float dbThreshold,
                                        float dbKnee,
@@ -258,142 +304,163 @@ void DynamicsCompressorKernel::process(ContextRenderLock & r,
 
     setPreDelayTime(preDelayTime, r.context()->sampleRate());
 
-    const int nDivisionFrames = 32;
-
-    const int nDivisions = framesToProcess / nDivisionFrames;
-
-    unsigned frameIndex = 0;
-    for (int i = 0; i < nDivisions; ++i)
+    // The level driving compression comes from the sidechain if there is one
+    if (!sidechainChannels || !numberOfSidechainChannels)
     {
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-        // Calculate desired gain
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        sidechainChannels = sourceChannels;
+        numberOfSidechainChannels = numberOfChannels;
+    }
 
-        // Fix gremlins.
-        if (std::isnan(m_detectorAverage))
-            m_detectorAverage = 1;
-        if (std::isinf(m_detectorAverage))
-            m_detectorAverage = 1;
+    CurveParameters curve;
+    curve.linearThreshold = m_linearThreshold;
+    curve.kneeThreshold = m_kneeThreshold;
+    curve.kneeThresholdDb = m_kneeThresholdDb;
+    curve.ykneeThresholdDb = m_ykneeThresholdDb;
+    curve.slope = m_slope;
+    curve.k = k;
+    curve.satReleaseFrames = satReleaseFrames;
 
-        float desiredGain = m_detectorAverage;
+    const float wetGain = wetMix * masterLinearGain;
+    const int nDivisionFrames = 32;
 
-        // Pre-warp so we get desiredGain after sin() warp below.
-        float scaledDesiredGain = asinf(desiredGain) / (0.5f * static_cast<float>(LAB_PI));
+    for (int chunkStart = 0; chunkStart < framesToProcess; chunkStart += ChunkFrames)
+    {
+        const int chunkFrames = min(static_cast<int>(ChunkFrames), framesToProcess - chunkStart);
 
         // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-        // Deal with envelopes
+        // Predelay signal, computing compression amount from un-delayed version.
         // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-        // envelopeRate is the rate we slew from current compressor level to the desired level.
-        // The exact rate depends on if we're attacking or releasing and by how much.
-        float envelopeRate;
-
-        bool isReleasing = scaledDesiredGain > m_compressorGain;
-
-        // compressionDiffDb is the difference between current compression level and the desired level.
-        float compressionDiffDb = linearToDecibels(m_compressorGain / scaledDesiredGain);
-
-        if (isReleasing)
+        const int firstWrite = min(chunkFrames, PreDelayBufferFrames - m_preDelayWriteIndex);
+        for (unsigned c = 0; c < numberOfChannels; ++c)
         {
-            // Release mode - compressionDiffDb should be negative dB
-            m_maxAttackCompressionDiffDb = -1;
-
-            // Fix gremlins.
-            if (isnan(compressionDiffDb))
-                compressionDiffDb = -1;
-            if (isinf(compressionDiffDb))
-                compressionDiffDb = -1;
-
-            // Adaptive release - higher compression (lower compressionDiffDb)  releases faster.
-
-            // Contain within range: -12 -> 0 then scale to go from 0 -> 3
-            float x = compressionDiffDb;
-            x = max(-12.0f, x);
-            x = min(0.0f, x);
-            x = 0.25f * (x + 12);
-
-            // Compute adaptive release curve using 4th order polynomial.
-            // Normal values for the polynomial coefficients would create a monotonically increasing function.
-            float x2 = x * x;
-            float x3 = x2 * x;
-            float x4 = x2 * x2;
-            float releaseFrames = kA + kB * x + kC * x2 + kD * x3 + kE * x4;
+            float * delayBuffer = m_preDelayBuffers[c]->data();
+            const float * source = sourceChannels[c] + chunkStart;
+            memcpy(delayBuffer + m_preDelayWriteIndex, source, sizeof(float) * firstWrite);
+            memcpy(delayBuffer, source + firstWrite, sizeof(float) * (chunkFrames - firstWrite));
+        }
 
-#define kSpacingDb 5
-            float dbPerFrame = kSpacingDb / releaseFrames;
+        // The detector level is the loudest channel, and its attenuation and release rate
+        // depend on nothing else, so they are found four frames at a time.
+        float * attenuations = m_attenuation.data();
+        float * releaseRates = m_releaseRate.data();
+        int frame = 0;
+        for (; frame + 4 <= chunkFrames; frame += 4)
+        {
+            Lanes4 level = absOf(Lanes4::load(sidechainChannels[0] + chunkStart + frame));
+            for (unsigned c = 1; c < numberOfSidechainChannels; ++c)
+                level = maxOf(level, absOf(Lanes4::load(sidechainChannels[c] + chunkStart + frame)));
+
+            Lanes4 attenuation(0.f), releaseRate(0.f);
+            detect(level, curve, attenuation, releaseRate);
+            attenuation.store(attenuations + frame);
+            releaseRate.store(releaseRates + frame);
+        }
+        for (; frame < chunkFrames; ++frame)
+        {
+            float level = absOf(sidechainChannels[0][chunkStart + frame]);
+            for (unsigned c = 1; c < numberOfSidechainChannels; ++c)
+                level = maxOf(level, absOf(sidechainChannels[c][chunkStart + frame]));
 
-            envelopeRate = decibelsToLinear(dbPerFrame);
+            detect(level, curve, attenuations[frame], releaseRates[frame]);
         }
-        else
+
+        float * gains = m_gain.data();
+        for (int divisionStart = 0; divisionStart < chunkFrames; divisionStart += nDivisionFrames)
         {
-            // Attack mode - compressionDiffDb should be positive dB
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // Calculate desired gain
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
             // Fix gremlins.
-            if (isnan(compressionDiffDb))
-                compressionDiffDb = 1;
-            if (isinf(compressionDiffDb))
-                compressionDiffDb = 1;
+            if (std::isnan(m_detectorAverage))
+                m_detectorAverage = 1;
+            if (std::isinf(m_detectorAverage))
+                m_detectorAverage = 1;
 
-            // As long as we're still in attack mode, use a rate based off
-            // the largest compressionDiffDb we've encountered so far.
-            if (m_maxAttackCompressionDiffDb == -1 || m_maxAttackCompressionDiffDb < compressionDiffDb)
-                m_maxAttackCompressionDiffDb = compressionDiffDb;
+            float desiredGain = m_detectorAverage;
 
-            float effAttenDiffDb = max(0.5f, m_maxAttackCompressionDiffDb);
+            // Pre-warp so we get desiredGain after sin() warp below.
+            float scaledDesiredGain = asinf(desiredGain) / (0.5f * static_cast<float>(LAB_PI));
 
-            float x = 0.25f / effAttenDiffDb;
-            envelopeRate = 1 - powf(x, 1 / attackFrames);
-        }
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // Deal with envelopes
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-        // Inner loop - calculate shaped power average - apply compression.
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // envelopeRate is the rate we slew from current compressor level to the desired level.
+            // The exact rate depends on if we're attacking or releasing and by how much.
+            float envelopeRate;
 
-        {
-            int preDelayReadIndex = m_preDelayReadIndex;
-            int preDelayWriteIndex = m_preDelayWriteIndex;
-            float detectorAverage = m_detectorAverage;
-            float compressorGain = m_compressorGain;
+            bool isReleasing = scaledDesiredGain > m_compressorGain;
+
+            // compressionDiffDb is the difference between current compression level and the desired level.
+            float compressionDiffDb = linearToDecibels(m_compressorGain / scaledDesiredGain);
 
-            int loopFrames = nDivisionFrames;
-            while (loopFrames--)
+            if (isReleasing)
             {
-                float compressorInput = 0;
+                // Release mode - compressionDiffDb should be negative dB
+                m_maxAttackCompressionDiffDb = -1;
 
-                // Predelay signal, computing compression amount from un-delayed version.
-                for (unsigned i = 0; i < numberOfChannels; ++i)
-                {
-                    float * delayBuffer = m_preDelayBuffers[i]->data();
-                    float undelayedSource = sourceChannels[i][frameIndex];
-                    delayBuffer[preDelayWriteIndex] = undelayedSource;
+                // Fix gremlins.
+                if (isnan(compressionDiffDb))
+                    compressionDiffDb = -1;
+                if (isinf(compressionDiffDb))
+                    compressionDiffDb = -1;
+
+                // Adaptive release - higher compression (lower compressionDiffDb)  releases faster.
+
+                // Contain within range: -12 -> 0 then scale to go from 0 -> 3
+                float x = compressionDiffDb;
+                x = max(-12.0f, x);
+                x = min(0.0f, x);
+                x = 0.25f * (x + 12);
+
+                // Compute adaptive release curve using 4th order polynomial.
+                // Normal values for the polynomial coefficients would create a monotonically increasing function.
+                float x2 = x * x;
+                float x3 = x2 * x;
+                float x4 = x2 * x2;
+                float releaseFrames = kA + kB * x + kC * x2 + kD * x3 + kE * x4;
 
-                    float absUndelayedSource = undelayedSource > 0 ? undelayedSource : -undelayedSource;
-                    if (compressorInput < absUndelayedSource)
-                        compressorInput = absUndelayedSource;
-                }
+#define kSpacingDb 5
+                float dbPerFrame = kSpacingDb / releaseFrames;
 
-                // Calculate shaped power on undelayed input.
+                envelopeRate = decibelsToLinear(dbPerFrame);
+            }
+            else
+            {
+                // Attack mode - compressionDiffDb should be positive dB
 
-                float scaledInput = compressorInput;
-                float absInput = scaledInput > 0 ? scaledInput : -scaledInput;
+                // Fix gremlins.
+                if (isnan(compressionDiffDb))
+                    compressionDiffDb = 1;
+                if (isinf(compressionDiffDb))
+                    compressionDiffDb = 1;
 
-                // Put through shaping curve.
-                // This is linear up to the threshold, then enters a "knee" portion followed by the "ratio" portion.
-                // The transition from the threshold to the knee is smooth (1st derivative matched).
-                // The transition from the knee to the ratio portion is smooth (1st derivative matched).
-                float shapedInput = saturate(absInput, k);
+                // As long as we're still in attack mode, use a rate based off
+                // the largest compressionDiffDb we've encountered so far.
+                if (m_maxAttackCompressionDiffDb == -1 || m_maxAttackCompressionDiffDb < compressionDiffDb)
+                    m_maxAttackCompressionDiffDb = compressionDiffDb;
 
-                float attenuation = absInput <= 0.0001f ? 1 : shapedInput / absInput;
+                float effAttenDiffDb = max(0.5f, m_maxAttackCompressionDiffDb);
 
-                float attenuationDb = -linearToDecibels(attenuation);
-                attenuationDb = max(2.0f, attenuationDb);
+                float x = 0.25f / effAttenDiffDb;
+                envelopeRate = 1 - powf(x, 1 / attackFrames);
+            }
 
-                float dbPerFrame = attenuationDb / satReleaseFrames;
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // Inner loop - calculate shaped power average - find compression.
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-                float satReleaseRate = decibelsToLinear(dbPerFrame) - 1;
+            float detectorAverage = m_detectorAverage;
+            float compressorGain = m_compressorGain;
 
+            const int divisionEnd = min(divisionStart + nDivisionFrames, chunkFrames);
+            for (int i = divisionStart; i < divisionEnd; ++i)
+            {
+                const float attenuation = attenuations[i];
                 bool isRelease = (attenuation > detectorAverage);
-                float rate = isRelease ? satReleaseRate : 1;
+                float rate = isRelease ? releaseRates[i] : 1;
 
                 detectorAverage += (attenuation - detectorAverage) * rate;
                 detectorAverage = min(1.0f, detectorAverage);
@@ -417,37 +484,55 @@ void DynamicsCompressorKernel::process(ContextRenderLock & r,
                     compressorGain = min(1.0f, compressorGain);
                 }
 
-                // Warp pre-compression gain to smooth out sharp exponential transition points.
-                float postWarpCompressorGain = sinf(0.5f * static_cast<float>(LAB_PI) * compressorGain);
-
-                // Calculate total gain using master gain and effect blend.
-                float totalGain = dryMix + wetMix * masterLinearGain * postWarpCompressorGain;
-
-                // Calculate metering.
-                float dbRealGain = 20 * log10(postWarpCompressorGain);
-                if (dbRealGain < m_meteringGain)
-                    m_meteringGain = dbRealGain;
-                else
-                    m_meteringGain += (dbRealGain - m_meteringGain) * m_meteringReleaseK;
-
-                // Apply final gain.
-                for (unsigned i = 0; i < numberOfChannels; ++i)
-                {
-                    float * delayBuffer = m_preDelayBuffers[i]->data();
-                    destinationChannels[i][frameIndex] = delayBuffer[preDelayReadIndex] * totalGain;
-                }
-
-                frameIndex++;
-                preDelayReadIndex = (preDelayReadIndex + 1) & MaxPreDelayFramesMask;
-                preDelayWriteIndex = (preDelayWriteIndex + 1) & MaxPreDelayFramesMask;
+                gains[i] = compressorGain;
             }
 
             // Locals back to member variables.
-            m_preDelayReadIndex = preDelayReadIndex;
-            m_preDelayWriteIndex = preDelayWriteIndex;
             m_detectorAverage = DenormalDisabler::flushDenormalFloatToZero(detectorAverage);
             m_compressorGain = DenormalDisabler::flushDenormalFloatToZero(compressorGain);
         }
+
+        // Warp pre-compression gain to smooth out sharp exponential transition points, then
+        // calculate total gain using master gain and effect blend.
+        float * dbRealGains = m_meteringGainDb.data();
+        frame = 0;
+        for (; frame + 4 <= chunkFrames; frame += 4)
+        {
+            const Lanes4 postWarpCompressorGain = FastMath::sinHalfPi(Lanes4::load(gains + frame));
+            (Lanes4(dryMix) + Lanes4(wetGain) * postWarpCompressorGain).store(gains + frame);
+            FastMath::linearToDecibels(postWarpCompressorGain).store(dbRealGains + frame);
+        }
+        for (; frame < chunkFrames; ++frame)
+        {
+            const float postWarpCompressorGain = FastMath::sinHalfPi(gains[frame]);
+            gains[frame] = dryMix + wetGain * postWarpCompressorGain;
+            dbRealGains[frame] = FastMath::linearToDecibels(postWarpCompressorGain);
+        }
+
+        // Calculate metering.
+        float meteringGain = m_meteringGain;
+        for (int i = 0; i < chunkFrames; ++i)
+        {
+            const float dbRealGain = dbRealGains[i];
+            if (dbRealGain < meteringGain)
+                meteringGain = dbRealGain;
+            else
+                meteringGain += (dbRealGain - meteringGain) * m_meteringReleaseK;
+        }
+        m_meteringGain = meteringGain;
+
+        // Apply final gain to the delayed signal.
+        const int firstRead = min(chunkFrames, PreDelayBufferFrames - m_preDelayReadIndex);
+        for (unsigned c = 0; c < numberOfChannels; ++c)
+        {
+            const float * delayBuffer = m_preDelayBuffers[c]->data();
+            float * destination = destinationChannels[c] + chunkStart;
+            VectorMath::vmul(delayBuffer + m_preDelayReadIndex, 1, gains, 1, destination, 1, firstRead);
+            VectorMath::vmul(delayBuffer, 1, gains + firstRead, 1, destination + firstRead, 1, chunkFrames - firstRead);
+        }
+
+        m_preDelayReadIndex = (m_preDelayReadIndex + chunkFrames) & PreDelayBufferMask;
+        m_preDelayWriteIndex = (m_preDelayWriteIndex + chunkFrames) & PreDelayBufferMask;
     }
 }
 
@@ -0,0 +1,305 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/EarlyReflections.h"
+#include "internal/FastMath.h"
+#include "internal/Lanes4.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+namespace
+{
+    const float SpeedOfSound = 343.f;  // metres per second
+
+    // An image is the source mirrored n times along each axis: -1 in the low wall, +1 in the
+    // high wall, and -2 or +2 in both, the room's length away. The first order images come
+    // first, so that the first six serve for either order.
+    struct Image
+    {
+        int n[3];
+    };
+
+    const Image s_images[24] = {
+        {{-1, 0, 0}}, {{1, 0, 0}}, {{0, -1, 0}}, {{0, 1, 0}}, {{0, 0, -1}}, {{0, 0, 1}},
+
+        {{-2, 0, 0}}, {{2, 0, 0}}, {{0, -2, 0}}, {{0, 2, 0}}, {{0, 0, -2}}, {{0, 0, 2}},
+        {{-1, -1, 0}}, {{-1, 1, 0}}, {{1, -1, 0}}, {{1, 1, 0}},
+        {{-1, 0, -1}}, {{-1, 0, 1}}, {{1, 0, -1}}, {{1, 0, 1}},
+        {{0, -1, -1}}, {{0, -1, 1}}, {{0, 1, -1}}, {{0, 1, 1}},
+    };
+
+    // The image's coordinate along an axis from low to high, and the walls' share of its amplitude
+    inline float mirror(int n, float x, float low, float high, float reflectLow, float reflectHigh, float & reflection)
+    {
+        switch (n)
+        {
+            case -1: reflection *= reflectLow; return 2.f * low - x;
+            case 1: reflection *= reflectHigh; return 2.f * high - x;
+            case -2: reflection *= reflectLow * reflectHigh; return x - 2.f * (high - low);
+            case 2: reflection *= reflectLow * reflectHigh; return x + 2.f * (high - low);
+            default: return x;
+        }
+    }
+
+    template <typename T>
+    inline T load(const float * p, int i);
+
+    template <>
+    inline float load<float>(const float * p, int i) { return p[i]; }
+
+    template <>
+    inline Lanes4 load<Lanes4>(const float * p, int i) { return Lanes4::load(p + i); }
+
+    inline void store(float v, float * p, int i) { p[i] = v; }
+    inline void store(Lanes4 v, float * p, int i) { v.store(p + i); }
+
+    const float s_ramp[4] = {0.f, 1.f, 2.f, 3.f};
+}
+
+EarlyReflections::EarlyReflections(float sampleRate, double maxDelayTime)
+    : m_sampleRate(sampleRate)
+    , m_maxDelayTime(maxDelayTime)
+{
+    // a reflection further away than the lines reach is held at their end
+    m_maxDelayFrames = static_cast<float>(std::ceil(maxDelayTime * sampleRate));
+    m_distanceEffect.setModel(DistanceEffect::ModelInverse, true);
+}
+
+void EarlyReflections::setSources(int count)
+{
+    m_delays.resize(std::max(count, 0));
+    reset();
+}
+
+void EarlyReflections::reset()
+{
+    for (Delay & delay : m_delays)
+    {
+        std::fill(delay.ring.begin(), delay.ring.end(), 0.f);
+        std::fill(delay.lastDelay.begin(), delay.lastDelay.end(), -1.f);
+    }
+    m_write = 0;
+}
+
+void EarlyReflections::findImages(const ShoeboxRoom & room, int order, const FloatPoint3D * positions)
+{
+    const int images = imagesForOrder(order);
+    const int count = sources() * images;
+    if (static_cast<int>(m_x.size()) < count)
+    {
+        for (std::vector<float> * v : {&m_x, &m_y, &m_z, &m_reflection, &m_distance, &m_azimuth,
+                                       &m_elevation, &m_delay, &m_gainL, &m_gainR})
+            v->resize(count);
+    }
+
+    const float * low = &room.minimum.x;
+    const float * high = &room.maximum.x;
+    float * axes[3] = {m_x.data(), m_y.data(), m_z.data()};
+
+    for (int s = 0; s < sources(); ++s)
+    {
+        float p[3];
+        for (int a = 0; a < 3; ++a)
+            p[a] = std::min(std::max((&positions[s].x)[a], low[a]), high[a]);
+
+        for (int k = 0; k < images; ++k)
+        {
+            const int i = s * images + k;
+            float reflection = 1.f;
+            for (int a = 0; a < 3; ++a)
+                axes[a][i] = mirror(s_images[k].n[a], p[a], low[a], high[a], room.reflection[2 * a], room.reflection[2 * a + 1], reflection);
+            m_reflection[i] = reflection;
+        }
+    }
+}
+
+void EarlyReflections::process(const ShoeboxRoom & room, int order, const SpatialListener & listener,
+                               const FloatPoint3D * positions, const float * const * inputs,
+                               float * outL, float * outR, int frames)
+{
+    order = std::min(std::max(order, 1), MaxOrder);
+    const int images = imagesForOrder(order);
+    const int count = sources() * images;
+
+    // every delay line holds the longest delay, and the block written before it is read
+    int ringSize = 1;
+    while (ringSize < static_cast<int>(m_maxDelayFrames) + frames + 2)
+        ringSize *= 2;
+    if (ringSize - 1 != m_mask)
+    {
+        m_mask = ringSize - 1;
+        m_write = 0;
+        for (Delay & delay : m_delays)
+            delay.ring.clear();
+    }
+    for (Delay & delay : m_delays)
+    {
+        if (static_cast<int>(delay.ring.size()) != ringSize)
+            delay.ring.assign(ringSize, 0.f);
+        if (static_cast<int>(delay.lastDelay.size()) != images)
+        {
+            delay.lastDelay.assign(images, -1.f);
+            delay.lastGainL.assign(images, 0.f);
+            delay.lastGainR.assign(images, 0.f);
+        }
+    }
+
+    findImages(room, order, positions);
+
+    // every image's distance and direction at once
+    SpatialSources batch;
+    batch.x = m_x.data();
+    batch.y = m_y.data();
+    batch.z = m_z.data();
+    batch.count = count;
+    SpatialBatch::distances(listener, batch, m_distance.data());
+    SpatialBatch::distanceGains(m_distanceEffect, m_distance.data(), count, m_gainL.data());
+    SpatialBatch::azimuthElevations(listener, batch, m_azimuth.data(), m_elevation.data());
+
+    // and its delay, and its gains panned equal power by azimuth, as the EqualPowerPanner pans
+    // a mono source
+    const float framesPerMetre = m_sampleRate / SpeedOfSound;
+    auto gains = [&](auto lanes, int i) {
+        using T = decltype(lanes);
+        store(minOf(load<T>(m_distance.data(), i) * T(framesPerMetre), T(m_maxDelayFrames)), m_delay.data(), i);
+
+        T azimuth = load<T>(m_azimuth.data(), i);
+        azimuth = select(azimuth < T(-90.f), T(-180.f) - azimuth, azimuth);
+        azimuth = select(azimuth > T(90.f), T(180.f) - azimuth, azimuth);
+        const T pan = (azimuth + T(90.f)) * T(1.f / 180.f);
+
+        const T gain = load<T>(m_gainL.data(), i) * load<T>(m_reflection.data(), i);
+        store(gain * FastMath::sinHalfPi(T(1.f) - pan), m_gainL.data(), i);
+        store(gain * FastMath::sinHalfPi(pan), m_gainR.data(), i);
+    };
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        gains(Lanes4(0.f), i);
+    for (; i < count; ++i)
+        gains(0.f, i);
+
+    // each source is written to its line once, and read by every image's tap
+    for (int s = 0; s < sources(); ++s)
+    {
+        Delay & delay = m_delays[s];
+        const int first = std::min(frames, ringSize - m_write);
+        if (inputs[s])
+        {
+            std::copy(inputs[s], inputs[s] + first, delay.ring.begin() + m_write);
+            std::copy(inputs[s] + first, inputs[s] + frames, delay.ring.begin());
+        }
+        else
+        {
+            std::fill(delay.ring.begin() + m_write, delay.ring.begin() + m_write + first, 0.f);
+            std::fill(delay.ring.begin(), delay.ring.begin() + (frames - first), 0.f);
+        }
+
+        // the taps that hold still are summed together, four frames at a time, so that the
+        // outputs are read and written once for all of them
+        int still = 0;
+        for (int k = 0; k < images; ++k)
+            if (tap(delay, k, s * images + k, outL, outR, frames, m_still[still]))
+                ++still;
+        mixStill(m_still, still, outL, outR, frames);
+    }
+
+    m_write = (m_write + frames) & m_mask;
+}
+
+bool EarlyReflections::tap(Delay & delay, int image, int index, float * outL, float * outR, int frames, StillTap & still)
+{
+    const float delay1 = m_delay[index];
+    const float gainL1 = m_gainL[index];
+    const float gainR1 = m_gainR[index];
+    const bool first = delay.lastDelay[image] < 0.f;
+    const float delay0 = first ? delay1 : delay.lastDelay[image];
+    const float gainL0 = first ? gainL1 : delay.lastGainL[image];
+    const float gainR0 = first ? gainR1 : delay.lastGainR[image];
+    delay.lastDelay[image] = delay1;
+    delay.lastGainL[image] = gainL1;
+    delay.lastGainR[image] = gainR1;
+
+    if (gainL0 == 0.f && gainL1 == 0.f && gainR0 == 0.f && gainR1 == 0.f)
+        return false;
+
+    const float * ring = delay.ring.data();
+    const float stepL = (gainL1 - gainL0) / frames;
+    const float stepR = (gainR1 - gainR0) / frames;
+
+    if (delay0 == delay1)
+    {
+        // a still tap reads a span of the line, which is left to mixStill where it doesn't wrap
+        const int whole = static_cast<int>(delay1);
+        const int start = (m_write - whole) & m_mask;
+        if (start >= 1 && start + frames <= m_mask + 1)
+        {
+            still.span = ring + start;
+            still.fraction = delay1 - whole;
+            still.gainL = gainL0;
+            still.gainR = gainR0;
+            still.stepL = stepL;
+            still.stepR = stepR;
+            return true;
+        }
+    }
+
+    const float delayStep = (delay1 - delay0) / frames;
+    float gainL = gainL0;
+    float gainR = gainR0;
+    for (int i = 0; i < frames; ++i)
+    {
+        const float d = delay0 + delayStep * i;
+        const int whole = static_cast<int>(d);
+        const float fraction = d - whole;
+        const int n = (m_write + i - whole) & m_mask;
+        const float x0 = ring[n];
+        const float x = x0 + fraction * (ring[(n - 1) & m_mask] - x0);
+        outL[i] += x * gainL;
+        outR[i] += x * gainR;
+        gainL += stepL;
+        gainR += stepR;
+    }
+    return false;
+}
+
+void EarlyReflections::mixStill(const StillTap * taps, int count, float * outL, float * outR, int frames)
+{
+    if (!count)
+        return;
+
+    const Lanes4 ramp = Lanes4::load(s_ramp);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        const Lanes4 offset = Lanes4(static_cast<float>(i)) + ramp;
+        Lanes4 l = Lanes4::load(outL + i);
+        Lanes4 r = Lanes4::load(outR + i);
+        for (int t = 0; t < count; ++t)
+        {
+            const StillTap & tap = taps[t];
+            const Lanes4 x0 = Lanes4::load(tap.span + i);
+            const Lanes4 x = x0 + Lanes4(tap.fraction) * (Lanes4::load(tap.span + i - 1) - x0);
+            l = l + x * (Lanes4(tap.gainL) + offset * Lanes4(tap.stepL));
+            r = r + x * (Lanes4(tap.gainR) + offset * Lanes4(tap.stepR));
+        }
+        l.store(outL + i);
+        r.store(outR + i);
+    }
+    for (; i < frames; ++i)
+    {
+        for (int t = 0; t < count; ++t)
+        {
+            const StillTap & tap = taps[t];
+            const float x0 = tap.span[i];
+            const float x = x0 + tap.fraction * (tap.span[i - 1] - x0);
+            outL[i] += x * (tap.gainL + i * tap.stepL);
+            outR[i] += x * (tap.gainR + i * tap.stepR);
+        }
+    }
+}
+
+}  // namespace lab
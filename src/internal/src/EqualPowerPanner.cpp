@@ -9,22 +9,97 @@
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
 #include "internal/EqualPowerPanner.h"
+#include "internal/Lanes4.h"
+#include "internal/LookupTables.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
 #include <algorithm>
+#include <cmath>
 
 // Use a 50ms smoothing / de-zippering time-constant.
 const float SmoothingTimeConstant = 0.050f;
 
+// Once the gains are this close to the desired gains they are snapped to them, and held
+const float SettledGain = 1e-5f;
+
 using namespace std;
 
 namespace lab
 {
 
+namespace
+{
+    // How the inputs reach the outputs. A mono input is panned across both. Panning a stereo
+    // input left keeps the left channel and pans the right across both, as a mono input,
+    // and panning it right does the opposite.
+    enum class Route
+    {
+        Mono,
+        StereoLeft,
+        StereoRight
+    };
+
+    template <Route R, typename T>
+    inline void panFrame(T inputL, T inputR, T gainL, T gainR, T & outputL, T & outputR)
+    {
+        if (R == Route::Mono)
+        {
+            outputL = inputL * gainL;
+            outputR = inputL * gainR;
+        }
+        else if (R == Route::StereoLeft)
+        {
+            outputL = inputL + inputR * gainL;
+            outputR = inputR * gainR;
+        }
+        else
+        {
+            outputL = inputL * gainL;
+            outputR = inputR + inputL * gainR;
+        }
+    }
+
+    const float LaneOffsets[4] = {0.f, 1.f, 2.f, 3.f};
+
+    // Pans frames with the gains ramped linearly from gainL and gainR by stepL and stepR a
+    // frame. Each frame's gains are found from its index rather than accumulated, so the
+    // ramp doesn't drift, and both inputs are read before the outputs are written, so the
+    // buses may be the same.
+    template <Route R>
+    void panRamp(const float * sourceL, const float * sourceR, float * destinationL, float * destinationR,
+                 int frames, float gainL, float stepL, float gainR, float stepR)
+    {
+        int i = 0;
+        const Lanes4 offsets = Lanes4::load(LaneOffsets);
+        for (; i + 4 <= frames; i += 4)
+        {
+            const Lanes4 index = offsets + Lanes4(static_cast<float>(i));
+            const Lanes4 inputL = Lanes4::load(sourceL + i);
+            const Lanes4 inputR = R == Route::Mono ? inputL : Lanes4::load(sourceR + i);
+            Lanes4 outputL(0.f);
+            Lanes4 outputR(0.f);
+            panFrame<R>(inputL, inputR, Lanes4(gainL) + Lanes4(stepL) * index, Lanes4(gainR) + Lanes4(stepR) * index,
+                        outputL, outputR);
+            outputL.store(destinationL + i);
+            outputR.store(destinationR + i);
+        }
+        for (; i < frames; ++i)
+        {
+            const float index = static_cast<float>(i);
+            float outputL, outputR;
+            panFrame<R>(sourceL[i], R == Route::Mono ? sourceL[i] : sourceR[i],
+                        gainL + stepL * index, gainR + stepR * index, outputL, outputR);
+            destinationL[i] = outputL;
+            destinationR[i] = outputR;
+        }
+    }
+}
+
 EqualPowerPanner::EqualPowerPanner(const float sampleRate)
     : Panner(sampleRate, PanningModel::EQUALPOWER)
 {
+    m_retention = 1.0 - AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, sampleRate);
 }
 
 void EqualPowerPanner::pan(ContextRenderLock & r,
@@ -33,8 +108,6 @@ void EqualPowerPanner::pan(ContextRenderLock & r,
          int busOffset,
          int framesToProcess)
 {
-    m_smoothingConstant = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, r.context()->sampleRate());
-
     bool isInputSafe = (inputBus.numberOfChannels() == Channels::Mono ||
                         inputBus.numberOfChannels() == Channels::Stereo) &&
                         (framesToProcess + busOffset) <= inputBus.length();
@@ -42,7 +115,7 @@ void EqualPowerPanner::pan(ContextRenderLock & r,
     if (!isInputSafe)
         return;
 
-    unsigned numberOfInputChannels = inputBus.numberOfChannels();
+    int numberOfInputChannels = inputBus.numberOfChannels();
 
     bool isOutputSafe = outputBus.numberOfChannels() == Channels::Stereo &&
                         (framesToProcess + busOffset) <= outputBus.length();
@@ -75,92 +148,72 @@ void EqualPowerPanner::pan(ContextRenderLock & r,
     else if (azimuth > 90)
         azimuth = 180 - azimuth;
 
-    double desiredPanPosition;
-    double desiredGainL;
-    double desiredGainR;
-
-    if (numberOfInputChannels == 1)
-    {  // For mono source case.
-        // Pan smoothly from left to right with azimuth going from -90 -> +90 degrees.
-        desiredPanPosition = (azimuth + 90) / 180;
-    }
-    else
-    {  // For stereo source case.
-        if (azimuth <= 0)
-        {  // from -90 -> 0
-            // sourceL -> destL and "equal-power pan" sourceR as in mono case
-            // by transforming the "azimuth" value from -90 -> 0 degrees into the range -90 -> +90.
-            desiredPanPosition = (azimuth + 90) / 90;
+    if (azimuth != m_desiredAzimuth || numberOfInputChannels != m_desiredChannels)
+    {
+        double desiredPanPosition;
+        if (numberOfInputChannels == 1)
+        {  // For mono source case.
+            // Pan smoothly from left to right with azimuth going from -90 -> +90 degrees.
+            desiredPanPosition = (azimuth + 90) / 180;
         }
         else
-        {  // from 0 -> +90
-            // sourceR -> destR and "equal-power pan" sourceL as in mono case
-            // by transforming the "azimuth" value from 0 -> +90 degrees into the range -90 -> +90.
-            desiredPanPosition = azimuth / 90;
+        {  // For stereo source case.
+            if (azimuth <= 0)
+            {  // from -90 -> 0
+                // sourceL -> destL and "equal-power pan" sourceR as in mono case
+                // by transforming the "azimuth" value from -90 -> 0 degrees into the range -90 -> +90.
+                desiredPanPosition = (azimuth + 90) / 90;
+            }
+            else
+            {  // from 0 -> +90
+                // sourceR -> destR and "equal-power pan" sourceL as in mono case
+                // by transforming the "azimuth" value from 0 -> +90 degrees into the range -90 -> +90.
+                desiredPanPosition = azimuth / 90;
+            }
         }
-    }
 
-    desiredGainL = cos(0.5 * static_cast<double>(LAB_PI) * desiredPanPosition);
-    desiredGainR = sin(0.5 * static_cast<double>(LAB_PI) * desiredPanPosition);
+        m_desiredAzimuth = azimuth;
+        m_desiredChannels = numberOfInputChannels;
+        LookupTables::equalPower(static_cast<float>(desiredPanPosition), m_desiredGainL, m_desiredGainR);
+    }
 
     // Don't de-zipper on first render call.
     if (m_isFirstRender)
     {
         m_isFirstRender = false;
-        m_gainL = desiredGainL;
-        m_gainR = desiredGainR;
+        m_gainL = m_desiredGainL;
+        m_gainR = m_desiredGainR;
     }
 
-    // Cache in local variables.
-    double gainL = m_gainL;
-    double gainR = m_gainR;
+    if (framesToProcess != m_decayFrames)
+    {
+        m_decayFrames = framesToProcess;
+        m_decay = pow(m_retention, framesToProcess);
+    }
 
-    // Get local copy of smoothing constant.
-    const double SmoothingConstant = m_smoothingConstant;
+    // The gains at the end of the quantum, where smoothing frame by frame would have left them
+    const float decay = static_cast<float>(m_decay);
+    float endGainL = m_desiredGainL + (m_gainL - m_desiredGainL) * decay;
+    float endGainR = m_desiredGainR + (m_gainR - m_desiredGainR) * decay;
+    if (fabs(endGainL - m_desiredGainL) < SettledGain && fabs(endGainR - m_desiredGainR) < SettledGain)
+    {
+        endGainL = m_desiredGainL;
+        endGainR = m_desiredGainR;
+    }
 
-    int n = framesToProcess;
+    const float frames = static_cast<float>(max(1, framesToProcess));
+    const float stepL = (endGainL - m_gainL) / frames;
+    const float stepR = (endGainR - m_gainR) / frames;
 
     if (numberOfInputChannels == 1)
-    {  // For mono source case.
-        while (n--)
-        {
-            float inputL = *sourceL++;
-            gainL += (desiredGainL - gainL) * SmoothingConstant;
-            gainR += (desiredGainR - gainR) * SmoothingConstant;
-            *destinationL++ = static_cast<float>(inputL * gainL);
-            *destinationR++ = static_cast<float>(inputL * gainR);
-        }
-    }
+        panRamp<Route::Mono>(sourceL, sourceR, destinationL, destinationR, framesToProcess, m_gainL, stepL, m_gainR, stepR);
+    else if (azimuth <= 0)
+        panRamp<Route::StereoLeft>(sourceL, sourceR, destinationL, destinationR, framesToProcess, m_gainL, stepL, m_gainR, stepR);
     else
-    {  // For stereo source case.
-        if (azimuth <= 0)
-        {  // from -90 -> 0
-            while (n--)
-            {
-                float inputL = *sourceL++;
-                float inputR = *sourceR++;
-                gainL += (desiredGainL - gainL) * SmoothingConstant;
-                gainR += (desiredGainR - gainR) * SmoothingConstant;
-                *destinationL++ = static_cast<float>(inputL + inputR * gainL);
-                *destinationR++ = static_cast<float>(inputR * gainR);
-            }
-        }
-        else
-        {  // from 0 -> +90
-            while (n--)
-            {
-                float inputL = *sourceL++;
-                float inputR = *sourceR++;
-                gainL += (desiredGainL - gainL) * SmoothingConstant;
-                gainR += (desiredGainR - gainR) * SmoothingConstant;
-                *destinationL++ = static_cast<float>(inputL * gainL);
-                *destinationR++ = static_cast<float>(inputR + inputL * gainR);
-            }
-        }
-    }
+        panRamp<Route::StereoRight>(sourceL, sourceR, destinationL, destinationR, framesToProcess, m_gainL, stepL, m_gainR, stepR);
 
-    m_gainL = gainL;
-    m_gainR = gainR;
+    m_gainL = endGainL;
+    m_gainR = endGainR;
 }
 
 }  // namespace lab
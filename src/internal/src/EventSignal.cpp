@@ -0,0 +1,96 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/EventSignal.h"
+
+#include <chrono>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace lab
+{
+
+#if defined(__linux__)
+
+static void futexWait(std::atomic<int> * address, int expected, int milliseconds)
+{
+    if (milliseconds < 0)
+    {
+        syscall(SYS_futex, reinterpret_cast<int *>(address), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+        return;
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_nsec = (milliseconds % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<int *>(address), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+}
+
+static void futexWake(std::atomic<int> * address)
+{
+    syscall(SYS_futex, reinterpret_cast<int *>(address), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+#endif
+
+void EventSignal::signal()
+{
+    // only a sleeping waiter needs a wake up call
+    if (m_state.exchange(Signalled) != Sleeping)
+        return;
+
+#if defined(__linux__)
+    futexWake(&m_state);
+#else
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+#endif
+}
+
+bool EventSignal::wait()
+{
+    return consume(-1);
+}
+
+bool EventSignal::waitFor(int milliseconds)
+{
+    return consume(milliseconds < 0 ? 0 : milliseconds);
+}
+
+bool EventSignal::consume(int milliseconds)
+{
+    int expected = Signalled;
+    if (m_state.compare_exchange_strong(expected, Idle))
+        return true;
+
+    if (milliseconds == 0)
+        return false;
+
+    // A signal sent from here on finds the waiter Sleeping, and either stops it going
+    // to sleep, or wakes it. The futex only sleeps if the state is still Sleeping;
+    // the condition variable is only signalled under the mutex held until it sleeps.
+    expected = Idle;
+    if (m_state.compare_exchange_strong(expected, Sleeping))
+    {
+#if defined(__linux__)
+        futexWait(&m_state, Sleeping, milliseconds);
+#else
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto woken = [this]() { return m_state.load() != Sleeping; };
+        if (milliseconds < 0)
+            m_wake.wait(lock, woken);
+        else
+            m_wake.wait_for(lock, std::chrono::milliseconds(milliseconds), woken);
+#endif
+    }
+
+    // whether woken, timed out, or interrupted, a signal is consumed if one arrived
+    return m_state.exchange(Idle) == Signalled;
+}
+
+}  // namespace lab
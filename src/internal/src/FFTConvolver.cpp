@@ -21,6 +21,12 @@ FFTConvolver::FFTConvolver(int fftSize)
 }
 
 void FFTConvolver::process(FFTFrame * fftKernel, const float * sourceP, float * destP, int framesToProcess)
+{
+    ASSERT(fftKernel && fftKernel->fftSize() == fftSize());
+    process(fftKernel->realData(), fftKernel->imagData(), sourceP, destP, framesToProcess);
+}
+
+void FFTConvolver::process(const float * kernelRealP, const float * kernelImagP, const float * sourceP, float * destP, int framesToProcess)
 {
     int halfSize = fftSize() / 2;
 
@@ -71,7 +77,7 @@ void FFTConvolver::process(FFTFrame * fftKernel, const float * sourceP, float *
 
             // The input buffer is now filled (get frequency-domain version)
             m_frame.computeForwardFFT(m_inputBuffer.data());
-            m_frame.multiply(*fftKernel);
+            m_frame.multiply(kernelRealP, kernelImagP);
             m_frame.computeInverseFFT(m_outputBuffer.data());
 
             // Overlap-add 1st half from previous time
@@ -4,6 +4,7 @@
 
 #include "LabSound/extended/Logging.h"
 
+#include "internal/Assertions.h"
 #include "internal/FFTFrame.h"
 
 #ifndef NDEBUG
@@ -18,6 +19,12 @@ namespace lab
 
 typedef std::complex<double> Complex;
 
+void FFTFrame::multiply(const FFTFrame & frame)
+{
+    ASSERT(frame.fftSize() == fftSize());
+    multiply(frame.realData(), frame.imagData());
+}
+
 void FFTFrame::doPaddedFFT(const float * data, int dataSize)
 {
     // Zero-pad the impulse response
@@ -47,7 +47,7 @@ FFTFrame::FFTFrame() : m_FFTSize(0), m_log2FFTSize(0), mFFT(0), mIFFT(0)
 
 // Copy constructor.
 FFTFrame::FFTFrame(const FFTFrame & frame) 
-    : m_FFTSize(frame.m_FFTSize), m_log2FFTSize(frame.m_log2FFTSize), mFFT(0), mIFFT(0), m_realData(frame.m_FFTSize / 2), m_imagData(frame.m_FFTSize / 2)
+    : m_FFTSize(frame.m_FFTSize), m_log2FFTSize(frame.m_log2FFTSize), mFFT(0), mIFFT(0), m_realData(frame.m_FFTSize / 2 + 1), m_imagData(frame.m_FFTSize / 2 + 1)
 {
     mFFT = kiss_fftr_alloc(m_FFTSize, 0, nullptr, nullptr);
     mIFFT = kiss_fftr_alloc(m_FFTSize, 1, nullptr, nullptr);
@@ -72,24 +72,41 @@ FFTFrame::~FFTFrame()
     delete m_cpxOutputData;
 }
 
-void FFTFrame::multiply(const FFTFrame & frame)
+void FFTFrame::multiply(const float * realP, const float * imagP)
 {
-    FFTFrame & frame1 = *this;
-    FFTFrame & frame2 = const_cast<FFTFrame &>(frame);
-
-    float * realP1 = frame1.realData();
-    float * imagP1 = frame1.imagData();
-    const float * realP2 = frame2.realData();
-    const float * imagP2 = frame2.imagData();
-
-    unsigned halfSize = fftSize() / 2;
-    float real0 = realP1[0];
-    float imag0 = imagP1[0];
-    VectorMath::zvmul(realP1, imagP1, realP2, imagP2, realP1, imagP1, halfSize);
-
-    // Multiply the packed DC/nyquist component
-    realP1[0] = real0 * realP2[0];
-    imagP1[0] = imag0 * imagP2[0];
+    float * realP1 = realData();
+    float * imagP1 = imagData();
+
+    // every bin, including DC and nyquist, is an ordinary complex value
+    VectorMath::zvmul(realP1, imagP1, realP, imagP, realP1, imagP1, spectrumSize());
+}
+
+void FFTFrame::multiplyAccumulate(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P)
+{
+    // every bin, including DC and nyquist, is an ordinary complex value
+    VectorMath::zvmadd(real1P, imag1P, real2P, imag2P, realData(), imagData(), spectrumSize());
+}
+
+void FFTFrame::multiplyAccumulate(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P, float scale2)
+{
+    VectorMath::zvmaddh(real1P, imag1P, real2P, imag2P, scale2, realData(), imagData(), spectrumSize());
+}
+
+int FFTFrame::spectrumSize() const
+{
+    return m_FFTSize / 2 + 1;
+}
+
+uint32_t FFTFrame::spectrumLayout()
+{
+    return 1;  // fftSize / 2 + 1 unscaled bins
+}
+
+void FFTFrame::zero()
+{
+    const int nbytes = sizeof(float) * spectrumSize();
+    memset(realData(), 0, nbytes);
+    memset(imagData(), 0, nbytes);
 }
 
 void FFTFrame::computeForwardFFT(const float * data)
@@ -98,8 +115,8 @@ void FFTFrame::computeForwardFFT(const float * data)
 
     float * outputData = reinterpret_cast<float *>(m_cpxOutputData);  // interleaved .r / .i
 
-    // De-interleave to separate real and complex arrays.
-    VectorMath::vdeintlve(outputData, m_realData.data(), m_imagData.data(), m_FFTSize);
+    // De-interleave to separate real and complex arrays, including the nyquist bin
+    VectorMath::vdeintlve(outputData, m_realData.data(), m_imagData.data(), m_FFTSize + 2);
 }
 
 void FFTFrame::computeInverseFFT(float * data)
@@ -0,0 +1,179 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/Macros.h"
+#include "internal/Assertions.h"
+#include "internal/FFTFrame.h"
+
+#if defined(USE_OOURA_FFT)
+
+#include "LabSound/extended/VectorMath.h"
+
+#include <ooura/fftsg.h>
+
+#include <mutex>
+#include <string.h>
+
+// This is the default implementation where Accelerate isn't available; add USE_KISS_FFT=1
+// to the list of preprocessor defines to use KissFFT instead.
+namespace lab
+{
+
+const int kMaxFFTPow2Size = 24;
+
+// The bit reversal and twiddle tables for one size of FFT. They are only written while
+// the plan is made, so every frame of that size, on any thread, can share them.
+struct FFTFrame::OouraPlan
+{
+    std::vector<int> ip;
+    std::vector<float> w;
+
+    explicit OouraPlan(int fftSize)
+        : ip(2 + static_cast<int>(sqrt(static_cast<double>(fftSize / 2))) + 1, 0)
+        , w(fftSize / 2)
+    {
+        // the tables are made on the first transform of this size
+        std::vector<float> scratch(fftSize);
+        ooura::rdft(fftSize, 1, scratch.data(), ip.data(), w.data());
+    }
+};
+
+const FFTFrame::OouraPlan * FFTFrame::planForSize(int log2FFTSize)
+{
+    ASSERT(log2FFTSize < kMaxFFTPow2Size);
+
+    static std::mutex planMutex;
+    static std::unique_ptr<OouraPlan> plans[kMaxFFTPow2Size];
+
+    std::lock_guard<std::mutex> lock(planMutex);
+    if (!plans[log2FFTSize])
+        plans[log2FFTSize].reset(new OouraPlan(1 << log2FFTSize));
+    return plans[log2FFTSize].get();
+}
+
+// Normal constructor: allocates for a given fftSize.
+FFTFrame::FFTFrame(int fftSize)
+    : m_FFTSize(fftSize), m_log2FFTSize(static_cast<int>(log2((double) fftSize)))
+    , m_plan(nullptr), m_work(fftSize), m_realData(fftSize / 2 + 1), m_imagData(fftSize / 2 + 1)
+{
+    // We only allow power of two.
+    ASSERT(1UL << m_log2FFTSize == m_FFTSize);
+
+    m_plan = planForSize(m_log2FFTSize);
+    zero();
+}
+
+// Creates a blank/empty frame (interpolate() must later be called).
+FFTFrame::FFTFrame() : m_FFTSize(0), m_log2FFTSize(0), m_plan(nullptr)
+{
+}
+
+// Copy constructor.
+FFTFrame::FFTFrame(const FFTFrame & frame)
+    : m_FFTSize(frame.m_FFTSize), m_log2FFTSize(frame.m_log2FFTSize)
+    , m_plan(frame.m_plan), m_work(frame.m_FFTSize), m_realData(frame.m_FFTSize / 2 + 1), m_imagData(frame.m_FFTSize / 2 + 1)
+{
+    const size_t nbytes = sizeof(float) * spectrumSize();
+    memcpy(realData(), frame.realData(), nbytes);
+    memcpy(imagData(), frame.imagData(), nbytes);
+}
+
+FFTFrame::~FFTFrame()
+{
+}
+
+void FFTFrame::multiply(const float * realP, const float * imagP)
+{
+    float * realP1 = realData();
+    float * imagP1 = imagData();
+
+    // every bin, including DC and nyquist, is an ordinary complex value
+    VectorMath::zvmul(realP1, imagP1, realP, imagP, realP1, imagP1, spectrumSize());
+}
+
+void FFTFrame::multiplyAccumulate(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P)
+{
+    // every bin, including DC and nyquist, is an ordinary complex value
+    VectorMath::zvmadd(real1P, imag1P, real2P, imag2P, realData(), imagData(), spectrumSize());
+}
+
+void FFTFrame::multiplyAccumulate(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P, float scale2)
+{
+    VectorMath::zvmaddh(real1P, imag1P, real2P, imag2P, scale2, realData(), imagData(), spectrumSize());
+}
+
+int FFTFrame::spectrumSize() const
+{
+    return m_FFTSize / 2 + 1;
+}
+
+uint32_t FFTFrame::spectrumLayout()
+{
+    return 1;  // as KissFFT: fftSize / 2 + 1 unscaled bins
+}
+
+void FFTFrame::zero()
+{
+    const size_t nbytes = sizeof(float) * spectrumSize();
+    memset(realData(), 0, nbytes);
+    memset(imagData(), 0, nbytes);
+}
+
+// Ooura's real transform is done in place, with the real and imaginary values of each bin
+// interleaved, except that the DC and nyquist bins, which are real, share the first pair.
+// Its sign convention is the opposite of the other implementations, so the imaginary values
+// are negated on the way in and out.
+void FFTFrame::computeForwardFFT(const float * data)
+{
+    float * work = m_work.data();
+    memcpy(work, data, sizeof(float) * m_FFTSize);
+    ooura::rdft(m_FFTSize, 1, work, const_cast<int *>(m_plan->ip.data()), const_cast<float *>(m_plan->w.data()));
+
+    const int half = m_FFTSize / 2;
+    float * realP = realData();
+    float * imagP = imagData();
+    for (int i = 1; i < half; ++i)
+    {
+        realP[i] = work[2 * i];
+        imagP[i] = -work[2 * i + 1];
+    }
+    realP[0] = work[0];
+    realP[half] = work[1];
+    imagP[0] = 0.f;
+    imagP[half] = 0.f;
+}
+
+void FFTFrame::computeInverseFFT(float * data)
+{
+    const int half = m_FFTSize / 2;
+    const float * realP = realData();
+    const float * imagP = imagData();
+
+    float * work = m_work.data();
+    for (int i = 0; i < half; ++i)
+    {
+        work[2 * i] = realP[i];
+        work[2 * i + 1] = -imagP[i];
+    }
+    work[1] = realP[half];
+
+    ooura::rdft(m_FFTSize, -1, work, const_cast<int *>(m_plan->ip.data()), const_cast<float *>(m_plan->w.data()));
+
+    // Scale so that a forward then inverse FFT yields exactly the original data
+    const float scale = 2.0f / m_FFTSize;
+    VectorMath::vsmul(work, 1, &scale, data, 1, m_FFTSize);
+}
+
+float * FFTFrame::realData() const
+{
+    return const_cast<float *>(m_realData.data());
+}
+
+float * FFTFrame::imagData() const
+{
+    return const_cast<float *>(m_imagData.data());
+}
+
+}  // namespace lab
+
+#endif  // USE_OOURA_FFT
@@ -0,0 +1,232 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/FeedbackDelayNetwork.h"
+#include "internal/Lanes4.h"
+
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    const int MaxLines = 16;
+    const int MinBlock = 64;
+
+    bool isPrime(int n)
+    {
+        if (n < 2)
+            return false;
+        for (int d = 2; d * d <= n; ++d)
+            if (n % d == 0)
+                return false;
+        return true;
+    }
+
+    inline void loadTo(Lanes4 & v, const float * p) { v = Lanes4::load(p); }
+    inline void loadTo(float & v, const float * p) { v = *p; }
+    inline void storeFrom(const Lanes4 & v, float * p) { v.store(p); }
+    inline void storeFrom(float v, float * p) { *p = v; }
+
+    // The unnormalized Hadamard transform of n values, n a power of two
+    template <typename T>
+    inline void hadamard(T * v, int n)
+    {
+        for (int h = 1; h < n; h *= 2)
+            for (int i = 0; i < n; i += 2 * h)
+                for (int j = i; j < i + h; ++j)
+                {
+                    const T a = v[j];
+                    const T b = v[j + h];
+                    v[j] = a + b;
+                    v[j + h] = a - b;
+                }
+    }
+
+    // Taps a frame, or four, of the lines' damped outputs, each stride apart in block, into
+    // the outputs, the even lines to the left and the odd to the right, then mixes them and
+    // adds the input to feed back in their place. Pairs of lines alternate in sign, for both
+    // the taps and the input, so that the sides are decorrelated.
+    template <typename T>
+    inline void tapAndMix(float * block, int stride, int lines, const float * left, const float * right,
+                          float * outL, float * outR, float tapGain, float mixGain, float inputGain)
+    {
+        T v[MaxLines] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+        T tapL = 0.f;
+        T tapR = 0.f;
+        for (int l = 0; l < lines; ++l)
+        {
+            loadTo(v[l], block + l * stride);
+            const T signedTap = ((l >> 1) & 1) ? T(0.f) - v[l] : v[l];
+            if (l & 1)
+                tapR = tapR + signedTap;
+            else
+                tapL = tapL + signedTap;
+        }
+        storeFrom(tapL * T(tapGain), outL);
+        storeFrom(tapR * T(tapGain), outR);
+
+        hadamard(v, lines);
+
+        T inL = 0.f;
+        T inR = 0.f;
+        loadTo(inL, left);
+        loadTo(inR, right);
+        for (int l = 0; l < lines; ++l)
+        {
+            const T in = (l & 1) ? inR : inL;
+            const T gain = ((l >> 1) & 1) ? -inputGain : inputGain;
+            storeFrom(v[l] * T(mixGain) + in * gain, block + l * stride);
+        }
+    }
+}
+
+FeedbackDelayNetwork::FeedbackDelayNetwork(float sampleRate, int lines, float size)
+    : m_sampleRate(sampleRate)
+    , m_lines(lines > 8 ? 16 : 8)
+    , m_size(std::min(std::max(size, 0.25f), 4.f))
+{
+    // every line must outlast a block, and the sweep of its read position
+    m_modulationFrames = static_cast<int>(std::ceil(MaxModulationMs * 0.001f * sampleRate)) + 2;
+    const int shortest = MinBlock + m_modulationFrames;
+
+    m_lengths.resize(m_lines);
+    for (int l = 0; l < m_lines; ++l)
+    {
+        const double ms = 20.0 * m_size * std::pow(4.0, static_cast<double>(l) / (m_lines - 1));
+        int length = std::max(shortest, static_cast<int>(std::lround(ms * 0.001 * sampleRate)));
+        while (!isPrime(length) || std::find(m_lengths.begin(), m_lengths.begin() + l, length) != m_lengths.begin() + l)
+            ++length;
+        m_lengths[l] = length;
+    }
+
+    const int longest = *std::max_element(m_lengths.begin(), m_lengths.end());
+    m_block = std::min(*std::min_element(m_lengths.begin(), m_lengths.end()) - m_modulationFrames, 4096);
+
+    int ring = 1;
+    while (ring < longest + m_modulationFrames + m_block + 2)
+        ring *= 2;
+    m_mask = ring - 1;
+
+    m_rings.assign(size_t(ring) * m_lines, 0.f);
+    m_gainLow.assign(m_lines, 0.f);
+    m_gainHigh.assign(m_lines, 0.f);
+    m_lowpass.assign(m_lines, 0.f);
+    m_lfoSin.resize(m_lines);
+    m_lfoCos.resize(m_lines);
+    m_scratch.assign(size_t(m_block) * m_lines, 0.f);
+    reset();
+}
+
+double FeedbackDelayNetwork::longestDelay() const
+{
+    return (*std::max_element(m_lengths.begin(), m_lengths.end()) + m_depth) / m_sampleRate;
+}
+
+void FeedbackDelayNetwork::reset()
+{
+    std::fill(m_rings.begin(), m_rings.end(), 0.f);
+    std::fill(m_lowpass.begin(), m_lowpass.end(), 0.f);
+    for (int l = 0; l < m_lines; ++l)
+    {
+        const double phase = 2.0 * LAB_PI * l / m_lines;
+        m_lfoSin[l] = static_cast<float>(std::sin(phase));
+        m_lfoCos[l] = static_cast<float>(std::cos(phase));
+    }
+    m_write = 0;
+}
+
+void FeedbackDelayNetwork::process(const Parameters & p, const float * left, const float * right, float * outL, float * outR, int frames)
+{
+    const double decay = std::max(p.decay, 0.05f);
+    const double damping = std::min(std::max(p.damping, 0.05f), 1.f);
+    for (int l = 0; l < m_lines; ++l)
+    {
+        // the gain that falls 60 dB over decay seconds, over the line's length
+        m_gainLow[l] = static_cast<float>(std::pow(10.0, -3.0 * m_lengths[l] / (m_sampleRate * decay)));
+        m_gainHigh[l] = static_cast<float>(std::pow(10.0, -3.0 * m_lengths[l] / (m_sampleRate * decay * damping)));
+    }
+
+    const double crossover = std::min(std::max(p.dampingFrequency, 20.f), m_sampleRate * 0.45f);
+    m_crossover = static_cast<float>(1.0 - std::exp(-2.0 * LAB_PI * crossover / m_sampleRate));
+    m_depth = std::min(std::max(p.modulationDepth, 0.f) * 0.001f * m_sampleRate, static_cast<float>(m_modulationFrames - 2));
+    const double rotation = 2.0 * LAB_PI * std::max(p.modulationRate, 0.f) / m_sampleRate;
+    m_rotateSin = static_cast<float>(std::sin(rotation));
+    m_rotateCos = static_cast<float>(std::cos(rotation));
+
+    for (int done = 0; done < frames;)
+    {
+        const int count = std::min(frames - done, m_block);
+        processBlock(left + done, right + done, outL + done, outR + done, count);
+        done += count;
+    }
+}
+
+void FeedbackDelayNetwork::processBlock(const float * left, const float * right, float * outL, float * outR, int frames)
+{
+    const int ringSize = m_mask + 1;
+
+    // each line's output, read from its swept position and damped
+    for (int l = 0; l < m_lines; ++l)
+    {
+        const float * ring = m_rings.data() + size_t(l) * ringSize;
+        float * out = m_scratch.data() + size_t(l) * m_block;
+        const float length = static_cast<float>(m_lengths[l]);
+        const float gainLow = m_gainLow[l];
+        const float gainHigh = m_gainHigh[l];
+        float lowpass = m_lowpass[l];
+        float s = m_lfoSin[l];
+        float c = m_lfoCos[l];
+
+        for (int i = 0; i < frames; ++i)
+        {
+            const float delay = length + m_depth * (0.5f + 0.5f * s);
+            const int whole = static_cast<int>(delay);
+            const float fraction = delay - whole;
+            const int index = (m_write + i - whole) & m_mask;
+            const float x0 = ring[index];
+            const float x = x0 + fraction * (ring[(index - 1) & m_mask] - x0);
+
+            lowpass += m_crossover * (x - lowpass);
+            out[i] = gainLow * lowpass + gainHigh * (x - lowpass);
+
+            const float rotated = s * m_rotateCos + c * m_rotateSin;
+            c = c * m_rotateCos - s * m_rotateSin;
+            s = rotated;
+        }
+
+        // the phasor's length drifts with rounding, so it is put back to one each block
+        const float norm = 1.f / std::sqrt(s * s + c * c);
+        m_lfoSin[l] = s * norm;
+        m_lfoCos[l] = c * norm;
+        m_lowpass[l] = lowpass;
+    }
+
+    // tapped, and mixed with the input to be fed back, four frames at a time
+    const float tapGain = 1.f / std::sqrt(m_lines * 0.5f);
+    const float mixGain = 1.f / std::sqrt(static_cast<float>(m_lines));
+    const float inputGain = 1.f / std::sqrt(static_cast<float>(m_lines));
+    int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        tapAndMix<Lanes4>(m_scratch.data() + i, m_block, m_lines, left + i, right + i, outL + i, outR + i, tapGain, mixGain, inputGain);
+    for (; i < frames; ++i)
+        tapAndMix<float>(m_scratch.data() + i, m_block, m_lines, left + i, right + i, outL + i, outR + i, tapGain, mixGain, inputGain);
+
+    // and written to the lines, in at most two spans each
+    const int first = std::min(frames, ringSize - m_write);
+    for (int l = 0; l < m_lines; ++l)
+    {
+        float * ring = m_rings.data() + size_t(l) * ringSize;
+        const float * in = m_scratch.data() + size_t(l) * m_block;
+        std::memcpy(ring + m_write, in, sizeof(float) * first);
+        std::memcpy(ring, in + first, sizeof(float) * (frames - first));
+    }
+    m_write = (m_write + frames) & m_mask;
+}
+
+}  // namespace lab
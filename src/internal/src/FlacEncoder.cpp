@@ -0,0 +1,470 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/FlacEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace lab
+{
+namespace FlacEncoder
+{
+
+namespace
+{
+    // The most partitions of a residual, as a power of two
+    const int MaxPartitionOrder = 8;
+
+    // Rice parameters above this need the five bit parameters of the second coding method
+    const int MaxRiceParameter = 14;
+    const int MaxRice2Parameter = 30;
+
+    struct Tables
+    {
+        uint8_t crc8[256];
+        uint16_t crc16[256];
+
+        Tables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                uint8_t c8 = static_cast<uint8_t>(i);
+                for (int b = 0; b < 8; ++b)
+                    c8 = static_cast<uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                crc8[i] = c8;
+
+                uint16_t c16 = static_cast<uint16_t>(i << 8);
+                for (int b = 0; b < 8; ++b)
+                    c16 = static_cast<uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+                crc16[i] = c16;
+            }
+        }
+    };
+
+    const Tables & tables()
+    {
+        static const Tables t;
+        return t;
+    }
+
+    uint8_t crc8(const uint8_t * data, size_t bytes)
+    {
+        const Tables & t = tables();
+        uint8_t crc = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            crc = t.crc8[crc ^ data[i]];
+        return crc;
+    }
+
+    uint16_t crc16(const uint8_t * data, size_t bytes)
+    {
+        const Tables & t = tables();
+        uint16_t crc = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            crc = static_cast<uint16_t>((crc << 8) ^ t.crc16[(crc >> 8) ^ data[i]]);
+        return crc;
+    }
+
+    // Writes bits most significant first, as FLAC is laid out
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t> & out) : m_out(out) {}
+
+        void put(uint32_t value, int bits)
+        {
+            if (!bits)
+                return;
+            const uint64_t mask = bits == 32 ? 0xffffffffull : ((1ull << bits) - 1);
+            m_accumulator = (m_accumulator << bits) | (value & mask);
+            m_bits += bits;
+            while (m_bits >= 8)
+            {
+                m_bits -= 8;
+                m_out.push_back(static_cast<uint8_t>(m_accumulator >> m_bits));
+            }
+        }
+
+        void putSigned(int32_t value, int bits) { put(static_cast<uint32_t>(value), bits); }
+
+        // zeros, then a one
+        void putUnary(uint32_t zeros)
+        {
+            while (zeros >= 31)
+            {
+                put(0, 31);
+                zeros -= 31;
+            }
+            put(1, static_cast<int>(zeros) + 1);
+        }
+
+        void putRice(uint32_t folded, int parameter)
+        {
+            putUnary(folded >> parameter);
+            put(folded, parameter);
+        }
+
+        void align()
+        {
+            if (m_bits)
+                put(0, 8 - m_bits);
+        }
+
+    private:
+        std::vector<uint8_t> & m_out;
+        uint64_t m_accumulator = 0;
+        int m_bits = 0;
+    };
+
+    // Residuals are folded to unsigned, so that small ones of either sign are small
+    inline uint32_t fold(int32_t v)
+    {
+        return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+    }
+
+    // The residual of the fixed predictor of order at sample i, which must be at least order
+    inline int32_t fixedResidual(const int32_t * x, int i, int order)
+    {
+        switch (order)
+        {
+            case 0: return x[i];
+            case 1: return x[i] - x[i - 1];
+            case 2: return x[i] - 2 * x[i - 1] + x[i - 2];
+            case 3: return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            default: return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        }
+    }
+
+    struct Subframe
+    {
+        enum class Type { Constant, Verbatim, Fixed } type = Type::Verbatim;
+        int order = 0;
+        int partitionOrder = 0;
+        int parameterBits = 4;
+        int parameters[1 << MaxPartitionOrder] = {};
+        uint64_t bits = 0;  // of the whole subframe
+    };
+
+    // The Rice parameter with the fewest bits for a partition of count folded residuals
+    // that sum to sum, and how many bits that is, estimating each residual's quotient as
+    // the sum's
+    int riceParameter(uint64_t sum, int count, uint64_t & bits)
+    {
+        int best = 0;
+        bits = ~0ull;
+        for (int k = 0; k <= MaxRice2Parameter; ++k)
+        {
+            const uint64_t b = static_cast<uint64_t>(count) * (k + 1) + (sum >> k);
+            if (b < bits)
+            {
+                bits = b;
+                best = k;
+            }
+            if ((sum >> k) == 0)
+                break;
+        }
+        return best;
+    }
+
+    // Chooses how a channel of n samples of bits each is coded
+    void planSubframe(const int32_t * x, int n, int bits, std::vector<uint32_t> & folded, Subframe & plan)
+    {
+        const uint64_t headerBits = 8;  // the zero pad, the type, and no wasted bits
+        plan.type = Subframe::Type::Verbatim;
+        plan.bits = headerBits + static_cast<uint64_t>(n) * bits;
+
+        bool constant = true;
+        for (int i = 1; i < n && constant; ++i)
+            constant = x[i] == x[0];
+        if (constant)
+        {
+            plan.type = Subframe::Type::Constant;
+            plan.bits = headerBits + bits;
+            return;
+        }
+
+        // the order whose residuals are smallest, measured past the longest warm up
+        const int maxOrder = std::min(4, n - 1);
+        uint64_t total[5] = {};
+        for (int i = maxOrder; i < n; ++i)
+            for (int o = 0; o <= maxOrder; ++o)
+                total[o] += static_cast<uint64_t>(std::llabs(static_cast<long long>(fixedResidual(x, i, o))));
+        int order = 0;
+        for (int o = 1; o <= maxOrder; ++o)
+            if (total[o] < total[order])
+                order = o;
+
+        folded.resize(n);
+        for (int i = order; i < n; ++i)
+            folded[i] = fold(fixedResidual(x, i, order));
+
+        // the partition order with the fewest bits; every partition must be whole, and the
+        // first must have samples past the warm up
+        Subframe best;
+        best.bits = ~0ull;
+        for (int po = 0; po <= MaxPartitionOrder; ++po)
+        {
+            const int partitionSize = n >> po;
+            if ((n & ((1 << po) - 1)) || partitionSize <= order)
+                break;
+
+            Subframe candidate;
+            candidate.partitionOrder = po;
+            uint64_t residualBits = 0;
+            int largest = 0;
+            for (int p = 0; p < (1 << po); ++p)
+            {
+                const int start = p ? p * partitionSize : order;
+                const int end = (p + 1) * partitionSize;
+                uint64_t sum = 0;
+                for (int i = start; i < end; ++i)
+                    sum += folded[i];
+                uint64_t partitionBits;
+                candidate.parameters[p] = riceParameter(sum, end - start, partitionBits);
+                largest = std::max(largest, candidate.parameters[p]);
+                residualBits += partitionBits;
+            }
+            candidate.parameterBits = largest > MaxRiceParameter ? 5 : 4;
+            candidate.bits = 2 + 4 + (static_cast<uint64_t>(candidate.parameterBits) << po) + residualBits;
+            if (candidate.bits < best.bits)
+                best = candidate;
+        }
+
+        const uint64_t fixedBits = headerBits + static_cast<uint64_t>(order) * bits + best.bits;
+        if (fixedBits < plan.bits)
+        {
+            plan = best;
+            plan.type = Subframe::Type::Fixed;
+            plan.order = order;
+            plan.bits = fixedBits;
+        }
+    }
+
+    void writeSubframe(BitWriter & w, const int32_t * x, int n, int bits, std::vector<uint32_t> & folded, const Subframe & plan)
+    {
+        w.put(0, 1);
+        switch (plan.type)
+        {
+            case Subframe::Type::Constant:
+                w.put(0x00, 6);
+                w.put(0, 1);
+                w.putSigned(x[0], bits);
+                return;
+
+            case Subframe::Type::Verbatim:
+                w.put(0x01, 6);
+                w.put(0, 1);
+                for (int i = 0; i < n; ++i)
+                    w.putSigned(x[i], bits);
+                return;
+
+            case Subframe::Type::Fixed:
+                break;
+        }
+
+        w.put(0x08 | plan.order, 6);
+        w.put(0, 1);
+        for (int i = 0; i < plan.order; ++i)
+            w.putSigned(x[i], bits);
+
+        folded.resize(n);
+        for (int i = plan.order; i < n; ++i)
+            folded[i] = fold(fixedResidual(x, i, plan.order));
+
+        w.put(plan.parameterBits == 5 ? 1 : 0, 2);
+        w.put(plan.partitionOrder, 4);
+        const int partitionSize = n >> plan.partitionOrder;
+        for (int p = 0; p < (1 << plan.partitionOrder); ++p)
+        {
+            const int k = plan.parameters[p];
+            w.put(k, plan.parameterBits);
+            const int start = p ? p * partitionSize : plan.order;
+            const int end = (p + 1) * partitionSize;
+            for (int i = start; i < end; ++i)
+                w.putRice(folded[i], k);
+        }
+    }
+
+    int blockSizeCode(int frames)
+    {
+        if (frames == 192)
+            return 1;
+        for (int k = 2; k <= 5; ++k)
+            if (frames == (576 << (k - 2)))
+                return k;
+        for (int k = 8; k <= 15; ++k)
+            if (frames == (256 << (k - 8)))
+                return k;
+        return frames <= 256 ? 6 : 7;
+    }
+
+    int sampleRateCode(uint32_t rate)
+    {
+        switch (rate)
+        {
+            case 88200: return 1;
+            case 176400: return 2;
+            case 192000: return 3;
+            case 8000: return 4;
+            case 16000: return 5;
+            case 22050: return 6;
+            case 24000: return 7;
+            case 32000: return 8;
+            case 44100: return 9;
+            case 48000: return 10;
+            case 96000: return 11;
+            default: break;
+        }
+        if (rate % 1000 == 0 && rate / 1000 <= 255)
+            return 12;
+        if (rate <= 65535)
+            return 13;
+        if (rate % 10 == 0 && rate / 10 <= 65535)
+            return 14;
+        return 0;  // as STREAMINFO has it
+    }
+
+    int sampleSizeCode(int bitsPerSample)
+    {
+        switch (bitsPerSample)
+        {
+            case 8: return 1;
+            case 12: return 2;
+            case 16: return 4;
+            case 20: return 5;
+            case 24: return 6;
+            default: return 0;
+        }
+    }
+
+    // the frame number, coded as UTF-8 codes a character, extended to 31 bits
+    void putFrameNumber(BitWriter & w, uint32_t n)
+    {
+        if (n < 0x80)
+        {
+            w.put(n, 8);
+            return;
+        }
+        int continuation = n < 0x800 ? 1 : n < 0x10000 ? 2 : n < 0x200000 ? 3 : n < 0x4000000 ? 4 : 5;
+        const uint32_t lead = (0xff00u >> (continuation + 1)) & 0xff;
+        w.put(lead | (n >> (6 * continuation)), 8);
+        while (continuation--)
+            w.put(0x80 | ((n >> (6 * continuation)) & 0x3f), 8);
+    }
+}
+
+void writeStreamInfo(const StreamInfo & info, uint8_t out[StreamInfoBytes])
+{
+    std::vector<uint8_t> bytes;
+    bytes.reserve(StreamInfoBytes);
+    BitWriter w(bytes);
+    w.put('f', 8);
+    w.put('L', 8);
+    w.put('a', 8);
+    w.put('C', 8);
+
+    w.put(1, 1);  // the last metadata block
+    w.put(0, 7);  // STREAMINFO
+    w.put(34, 24);
+
+    w.put(info.blockSize, 16);
+    w.put(info.blockSize, 16);
+    w.put(info.minFrameBytes, 24);
+    w.put(info.maxFrameBytes, 24);
+    w.put(info.sampleRate, 20);
+    w.put(info.channels - 1, 3);
+    w.put(info.bitsPerSample - 1, 5);
+    w.put(static_cast<uint32_t>(info.totalFrames >> 32), 4);
+    w.put(static_cast<uint32_t>(info.totalFrames), 32);
+    for (int i = 0; i < 4; ++i)
+        w.put(0, 32);  // no MD5 of the audio
+    memcpy(out, bytes.data(), StreamInfoBytes);
+}
+
+void encodeFrame(const int32_t * interleaved, int channels, int frames, int bitsPerSample, uint32_t sampleRate,
+                 uint32_t frameNumber, std::vector<uint8_t> & out)
+{
+    const size_t frameStart = out.size();
+    const size_t n = static_cast<size_t>(frames);
+
+    // channels apart, with the mid and side of a stereo pair after them
+    const int planes = channels == 2 ? 4 : channels;
+    std::vector<int32_t> planar(n * planes);
+    for (int c = 0; c < channels; ++c)
+        for (size_t i = 0; i < n; ++i)
+            planar[c * n + i] = interleaved[i * channels + c];
+
+    std::vector<uint32_t> folded;
+    std::vector<Subframe> plans(planes);
+    int assignment = channels - 1;
+    int coded[2] = {0, 1};
+    if (channels == 2)
+    {
+        int32_t * left = planar.data();
+        int32_t * right = left + n;
+        int32_t * mid = right + n;
+        int32_t * side = mid + n;
+        for (size_t i = 0; i < n; ++i)
+        {
+            mid[i] = (left[i] + right[i]) >> 1;
+            side[i] = left[i] - right[i];
+        }
+        for (int p = 0; p < 4; ++p)
+            planSubframe(planar.data() + p * n, frames, bitsPerSample + (p == 3 ? 1 : 0), folded, plans[p]);
+
+        // independent, left and side, side and right, or mid and side
+        const uint64_t costs[4] = {plans[0].bits + plans[1].bits, plans[0].bits + plans[3].bits,
+                                   plans[3].bits + plans[1].bits, plans[2].bits + plans[3].bits};
+        const int choices[4][2] = {{0, 1}, {0, 3}, {3, 1}, {2, 3}};
+        int best = 0;
+        for (int i = 1; i < 4; ++i)
+            if (costs[i] < costs[best])
+                best = i;
+        assignment = best ? 7 + best : 1;
+        coded[0] = choices[best][0];
+        coded[1] = choices[best][1];
+    }
+    else
+    {
+        for (int c = 0; c < channels; ++c)
+            planSubframe(planar.data() + c * n, frames, bitsPerSample, folded, plans[c]);
+    }
+
+    BitWriter w(out);
+    w.put(0x3ffe, 14);
+    w.put(0, 1);
+    w.put(0, 1);  // a fixed block size, so frames are numbered rather than given a sample offset
+    const int blockCode = blockSizeCode(frames);
+    const int rateCode = sampleRateCode(sampleRate);
+    w.put(blockCode, 4);
+    w.put(rateCode, 4);
+    w.put(assignment, 4);
+    w.put(sampleSizeCode(bitsPerSample), 3);
+    w.put(0, 1);
+    putFrameNumber(w, frameNumber);
+    if (blockCode == 6)
+        w.put(frames - 1, 8);
+    else if (blockCode == 7)
+        w.put(frames - 1, 16);
+    if (rateCode == 12)
+        w.put(sampleRate / 1000, 8);
+    else if (rateCode == 13)
+        w.put(sampleRate, 16);
+    else if (rateCode == 14)
+        w.put(sampleRate / 10, 16);
+    w.put(crc8(out.data() + frameStart, out.size() - frameStart), 8);
+
+    for (int c = 0; c < channels; ++c)
+    {
+        const int p = channels == 2 ? coded[c] : c;
+        const int bits = bitsPerSample + (channels == 2 && p == 3 ? 1 : 0);
+        writeSubframe(w, planar.data() + p * n, frames, bits, folded, plans[p]);
+    }
+    w.align();
+    w.put(crc16(out.data() + frameStart, out.size() - frameStart), 16);
+}
+
+}  // namespace FlacEncoder
+}  // namespace lab
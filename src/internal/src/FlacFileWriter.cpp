@@ -0,0 +1,221 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/FlacFileWriter.h"
+#include "internal/FlacEncoder.h"
+
+#include "LabSound/extended/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+// suppress warnings about fopen
+#pragma warning(disable : 4996)
+#endif
+
+namespace lab
+{
+
+namespace
+{
+    // Frames per FLAC frame, the block size most encoders use at their default settings
+    const int BlockFrames = 4096;
+
+    // A chunk's blocks are encoded in parallel; a chunk of this many is a little under
+    // three seconds at 48 kHz, enough to keep a pool busy without holding much audio
+    const int ChunkBlocks = 32;
+
+    // The writer waits for the oldest chunk once this many are being encoded
+    const size_t MaxChunksEncoding = 3;
+
+    inline int32_t quantize(float x, float scale)
+    {
+        x = x < -1.f ? -1.f : (x > 1.f ? 1.f : x);
+        return static_cast<int32_t>(std::lrint(x * scale));
+    }
+}
+
+FlacFileWriter::~FlacFileWriter()
+{
+    close();
+}
+
+bool FlacFileWriter::open(const std::string & path, int channels, float sampleRate, int bitsPerSample)
+{
+    close();
+    // STREAMINFO holds the rate in 20 bits
+    if (channels <= 0 || channels > FlacEncoder::MaxChannels || sampleRate < 1 || sampleRate > 655350)
+        return false;
+    if (bitsPerSample != 16 && bitsPerSample != 24)
+        return false;
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    m_channels = channels;
+    m_sampleRate = static_cast<uint32_t>(sampleRate);
+    m_bitsPerSample = bitsPerSample;
+    m_failed = false;
+    m_frames = 0;
+    m_writtenFrames = 0;
+    m_nextBlock = 0;
+    m_minFrameBytes = 0;
+    m_maxFrameBytes = 0;
+
+    if (!updateHeader())
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool FlacFileWriter::setChannelCount(int channels)
+{
+    if (!m_file || m_frames || channels <= 0 || channels > FlacEncoder::MaxChannels)
+        return false;
+
+    m_channels = channels;
+    return updateHeader();
+}
+
+bool FlacFileWriter::write(const float * interleaved, int frames)
+{
+    if (!m_file || frames <= 0)
+        return m_file != nullptr;
+
+    const float scale = m_bitsPerSample == 24 ? 8388607.f : 32767.f;
+    const size_t chunkFrames = size_t(BlockFrames) * ChunkBlocks;
+    while (frames > 0)
+    {
+        if (!m_gathering)
+        {
+            m_gathering.reset(new Chunk());
+            m_gathering->samples.resize(chunkFrames * m_channels);
+        }
+
+        Chunk & chunk = *m_gathering;
+        const int count = std::min(frames, static_cast<int>(chunkFrames) - chunk.frames);
+        int32_t * destination = chunk.samples.data() + size_t(chunk.frames) * m_channels;
+        const size_t samples = size_t(count) * m_channels;
+        for (size_t i = 0; i < samples; ++i)
+            destination[i] = quantize(interleaved[i], scale);
+
+        chunk.frames += count;
+        m_frames += count;
+        interleaved += samples;
+        frames -= count;
+        if (chunk.frames == static_cast<int>(chunkFrames))
+            submit();
+    }
+
+    writeFinished(false);
+    return !m_failed;
+}
+
+void FlacFileWriter::submit()
+{
+    if (!m_gathering || !m_gathering->frames)
+        return;
+
+    Chunk * chunk = m_gathering.get();
+    const int blocks = (chunk->frames + BlockFrames - 1) / BlockFrames;
+    chunk->firstBlock = m_nextBlock;
+    chunk->encoded.resize(blocks);
+    chunk->remaining.store(blocks, std::memory_order_release);
+    m_nextBlock += static_cast<uint32_t>(blocks);
+    m_encoding.push_back(std::move(m_gathering));
+
+    const int channels = m_channels;
+    const int bitsPerSample = m_bitsPerSample;
+    const uint32_t sampleRate = m_sampleRate;
+    for (int b = 0; b < blocks; ++b)
+    {
+        JobSystem::shared().submit([chunk, b, channels, bitsPerSample, sampleRate]()
+        {
+            const int first = b * BlockFrames;
+            const int frames = std::min(BlockFrames, chunk->frames - first);
+            FlacEncoder::encodeFrame(chunk->samples.data() + size_t(first) * channels, channels, frames,
+                                     bitsPerSample, sampleRate, chunk->firstBlock + b, chunk->encoded[b]);
+            chunk->remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }, JobPriority::Normal);
+    }
+
+    // the writer falls behind the encoders no further than this
+    if (m_encoding.size() > MaxChunksEncoding)
+    {
+        Chunk * oldest = m_encoding.front().get();
+        JobSystem::shared().wait([oldest]() { return oldest->remaining.load(std::memory_order_acquire) == 0; },
+                                 JobPriority::Normal);
+    }
+}
+
+bool FlacFileWriter::writeFinished(bool wait)
+{
+    while (!m_encoding.empty())
+    {
+        Chunk * chunk = m_encoding.front().get();
+        if (chunk->remaining.load(std::memory_order_acquire))
+        {
+            if (!wait)
+                break;
+            JobSystem::shared().wait([chunk]() { return chunk->remaining.load(std::memory_order_acquire) == 0; },
+                                     JobPriority::Normal);
+        }
+
+        for (const std::vector<uint8_t> & frame : chunk->encoded)
+        {
+            if (fwrite(frame.data(), 1, frame.size(), m_file) != frame.size())
+                m_failed = true;
+            const uint32_t bytes = static_cast<uint32_t>(frame.size());
+            m_minFrameBytes = m_minFrameBytes ? std::min(m_minFrameBytes, bytes) : bytes;
+            m_maxFrameBytes = std::max(m_maxFrameBytes, bytes);
+        }
+        m_writtenFrames += chunk->frames;
+        m_encoding.pop_front();
+    }
+    return !m_failed;
+}
+
+bool FlacFileWriter::updateHeader()
+{
+    if (!m_file)
+        return false;
+
+    FlacEncoder::StreamInfo info;
+    info.blockSize = BlockFrames;
+    info.minFrameBytes = m_minFrameBytes;
+    info.maxFrameBytes = m_maxFrameBytes;
+    info.sampleRate = m_sampleRate;
+    info.channels = m_channels;
+    info.bitsPerSample = m_bitsPerSample;
+    info.totalFrames = m_writtenFrames;
+
+    uint8_t header[FlacEncoder::StreamInfoBytes];
+    FlacEncoder::writeStreamInfo(info, header);
+    if (fseek(m_file, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), m_file) != sizeof(header)
+        || fseek(m_file, 0, SEEK_END) != 0)
+        m_failed = true;
+    return !m_failed;
+}
+
+bool FlacFileWriter::close()
+{
+    if (!m_file)
+        return false;
+
+    submit();
+    writeFinished(true);
+    updateHeader();
+
+    if (fclose(m_file) != 0)
+        m_failed = true;
+    m_file = nullptr;
+    m_gathering.reset();
+    return !m_failed;
+}
+
+}  // namespace lab
@@ -0,0 +1,279 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/HRTFDatabase.h"
+#include "internal/HRTFPanner.h"
+#include "internal/Assertions.h"
+#include "internal/MappedFile.h"
+
+#include "LabSound/core/Macros.h"
+#include "LabSound/extended/Logging.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// A compiled database holds every kernel of an HRTFDatabase, interpolated ones included,
+// as the spectra FFTFrame produces for the sample rate it was compiled for, so that it can
+// be mapped and used as it is. It is laid out as
+//
+//     CompiledHeader
+//     an elevation angle for every elevation
+//     left and right frame delays for every azimuth of every elevation
+//     left and right spectra for every azimuth of every elevation, from spectraOffset
+//
+// with every spectrum, real values then imaginary, starting on a SpectrumAlignment byte
+// boundary. The byte order and float format are those of the machine that compiled it.
+
+namespace lab
+{
+
+namespace
+{
+    const char CompiledMagic[8] = {'L', 'A', 'B', 'H', 'R', 'T', 'F', 0};
+    const uint32_t CompiledVersion = 1;
+    const uint32_t CompiledByteOrder = 0x01020304;
+    const int SpectrumAlignment = 64;
+
+    struct CompiledHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t spectrumLayout;  // FFTFrame::spectrumLayout() of the compiling build
+        float sampleRate;
+        int32_t fftSize;
+        int32_t spectrumSize;
+        int32_t spectrumStride;  // floats from the start of one array of a spectrum to the next
+        int32_t numberOfElevations;
+        int32_t numberOfAzimuths;
+        int32_t minElevation;
+        int32_t maxElevation;
+        int32_t rawElevationAngleSpacing;
+        int32_t interpolationFactor;
+        int32_t reserved;
+        uint64_t spectraOffset;
+        uint64_t fileSize;
+    };
+
+    uint64_t tableSize(int elevations, int azimuths)
+    {
+        return sizeof(float) * (static_cast<uint64_t>(elevations) + 2ull * elevations * azimuths);
+    }
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + SpectrumAlignment - 1) & ~static_cast<uint64_t>(SpectrumAlignment - 1);
+    }
+}
+
+std::string HRTFDatabase::compiledName(float sampleRate)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "Composite_%d.hrtf", static_cast<int>(sampleRate));
+    return name;
+}
+
+std::unique_ptr<HRTFDatabase> HRTFDatabase::loadCompiled(const std::string & path, float sampleRate)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file)
+        return nullptr;
+
+    CompiledHeader header;
+    if (file->size() < sizeof(header))
+    {
+        LOG_ERROR("%s is not a compiled HRTF database", path.c_str());
+        return nullptr;
+    }
+    memcpy(&header, file->data(), sizeof(header));
+
+    if (memcmp(header.magic, CompiledMagic, sizeof(CompiledMagic)) || header.version != CompiledVersion || header.byteOrder != CompiledByteOrder)
+    {
+        LOG_ERROR("%s is not a compiled HRTF database this build can read", path.c_str());
+        return nullptr;
+    }
+
+    const int fftSize = static_cast<int>(HRTFPanner::fftSizeForSampleRate(sampleRate));
+    if (header.sampleRate != sampleRate || header.fftSize != fftSize || header.spectrumLayout != FFTFrame::spectrumLayout())
+    {
+        LOG_INFO("%s was compiled for %f Hz or another FFT, and is not used at %f Hz", path.c_str(), header.sampleRate, sampleRate);
+        return nullptr;
+    }
+
+    const int spectrumSize = FFTFrame(fftSize).spectrumSize();
+    const int elevations = header.numberOfElevations;
+    const int azimuths = header.numberOfAzimuths;
+    const uint64_t spectrumBytes = 2ull * sizeof(float) * header.spectrumStride;
+    bool isHeaderGood = header.spectrumSize == spectrumSize
+        && header.spectrumStride >= spectrumSize
+        && (sizeof(float) * header.spectrumStride) % SpectrumAlignment == 0
+        && azimuths == static_cast<int>(HRTFElevation::NumberOfTotalAzimuths)
+        && elevations > 0 && header.interpolationFactor > 0 && header.rawElevationAngleSpacing > 0
+        && header.spectraOffset % SpectrumAlignment == 0
+        && header.spectraOffset >= sizeof(header) + tableSize(elevations, azimuths)
+        && header.fileSize == file->size()
+        && header.spectraOffset + 2ull * elevations * azimuths * spectrumBytes <= file->size();
+    if (!isHeaderGood)
+    {
+        LOG_ERROR("%s is a damaged compiled HRTF database", path.c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<HRTFDatabase> database(new HRTFDatabase());
+    database->info.reset(new HRTFDatabaseInfo("Composite", path, sampleRate));
+    HRTFDatabaseInfo * info = database->info.get();
+    info->minElevation = header.minElevation;
+    info->maxElevation = header.maxElevation;
+    info->rawElevationAngleSpacing = header.rawElevationAngleSpacing;
+    info->interpolationFactor = header.interpolationFactor;
+    info->numTotalElevations = elevations;
+    info->numberOfRawElevations = elevations / header.interpolationFactor;
+
+    const float * angles = reinterpret_cast<const float *>(file->data() + sizeof(header));
+    const float * delays = angles + elevations;
+    const uint8_t * spectra = file->data() + header.spectraOffset;
+
+    std::shared_ptr<const void> storage = file;
+    database->m_elevations.resize(elevations);
+    database->m_resident.reset(new std::atomic<HRTFElevation *>[elevations]);
+    database->m_lastUsed.reset(new std::atomic<uint64_t>[elevations]);
+    for (int e = 0; e < elevations; ++e)
+    {
+        std::unique_ptr<HRTFKernelList> kernelListL(new HRTFKernelList(azimuths));
+        std::unique_ptr<HRTFKernelList> kernelListR(new HRTFKernelList(azimuths));
+        for (int a = 0; a < azimuths; ++a)
+        {
+            const uint64_t kernel = 2ull * (static_cast<uint64_t>(e) * azimuths + a);
+            const float * realL = reinterpret_cast<const float *>(spectra + kernel * spectrumBytes);
+            const float * realR = reinterpret_cast<const float *>(spectra + (kernel + 1) * spectrumBytes);
+            const float * delay = delays + kernel;
+            (*kernelListL)[a] = std::make_shared<HRTFKernel>(fftSize, realL, realL + header.spectrumStride, delay[0], sampleRate, storage);
+            (*kernelListR)[a] = std::make_shared<HRTFKernel>(fftSize, realR, realR + header.spectrumStride, delay[1], sampleRate, storage);
+        }
+        database->m_lastUsed[e].store(0, std::memory_order_relaxed);
+        database->makeResident(e, HRTFElevation::createWithKernels(std::move(kernelListL), std::move(kernelListR), angles[e]));
+    }
+
+    info->files_found_and_loaded = true;
+    database->m_filesFound = true;
+    database->m_numberOfElevations = elevations;
+    LOG_INFO("loaded compiled HRTF database %s", path.c_str());
+    return database;
+}
+
+bool HRTFDatabase::writeCompiled(const std::string & path) const
+{
+    const int elevations = m_numberOfElevations;
+    const int azimuths = static_cast<int>(HRTFElevation::NumberOfTotalAzimuths);
+    if (!m_filesFound || !elevations)
+    {
+        LOG_ERROR("the HRTF database at %s wasn't loaded, so can't be compiled", info->searchPath.c_str());
+        return false;
+    }
+
+    // the resident elevations are held while they're written, and the others made for the writing
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::vector<std::unique_ptr<HRTFElevation>> made(elevations);
+    std::vector<HRTFElevation *> elevationList(elevations);
+    {
+        std::lock_guard<std::mutex> making(m_makeLock);
+        for (int e = 0; e < elevations; ++e)
+        {
+            elevationList[e] = m_elevations[e].get();
+            if (!elevationList[e])
+            {
+                made[e] = makeElevation(e);
+                elevationList[e] = made[e].get();
+            }
+            if (!elevationList[e])
+            {
+                LOG_ERROR("the HRTF database at %s couldn't be made whole, so can't be compiled", info->searchPath.c_str());
+                return false;
+            }
+        }
+    }
+
+    const int fftSize = elevationList[0]->kernelListL()->at(0)->fftSize();
+    const int spectrumSize = FFTFrame(fftSize).spectrumSize();
+    const int floatsPerAlignment = SpectrumAlignment / static_cast<int>(sizeof(float));
+    const int spectrumStride = (spectrumSize + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+
+    CompiledHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CompiledMagic, sizeof(CompiledMagic));
+    header.version = CompiledVersion;
+    header.byteOrder = CompiledByteOrder;
+    header.spectrumLayout = FFTFrame::spectrumLayout();
+    header.sampleRate = info->sampleRate;
+    header.fftSize = fftSize;
+    header.spectrumSize = spectrumSize;
+    header.spectrumStride = spectrumStride;
+    header.numberOfElevations = elevations;
+    header.numberOfAzimuths = azimuths;
+    header.minElevation = info->minElevation;
+    header.maxElevation = info->maxElevation;
+    header.rawElevationAngleSpacing = info->rawElevationAngleSpacing;
+    header.interpolationFactor = info->interpolationFactor;
+    header.spectraOffset = alignUp(sizeof(header) + tableSize(elevations, azimuths));
+    header.fileSize = header.spectraOffset + 2ull * elevations * azimuths * 2ull * sizeof(float) * spectrumStride;
+
+    std::vector<float> table;
+    for (int e = 0; e < elevations; ++e)
+        table.push_back(static_cast<float>(elevationList[e]->elevationAngle()));
+    for (int e = 0; e < elevations; ++e)
+    {
+        for (int a = 0; a < azimuths; ++a)
+        {
+            table.push_back(elevationList[e]->kernelListL()->at(a)->frameDelay());
+            table.push_back(elevationList[e]->kernelListR()->at(a)->frameDelay());
+        }
+    }
+
+    // written beside the destination and then moved over it, so that a process that has the
+    // old file mapped never sees it change
+    const std::string temporaryPath = path + ".tmp";
+    FILE * f = fopen(temporaryPath.c_str(), "wb");
+    if (!f)
+    {
+        LOG_ERROR("could not create %s", temporaryPath.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> padding(static_cast<size_t>(header.spectraOffset - sizeof(header) - sizeof(float) * table.size()), 0);
+    std::vector<float> spectrum(2 * spectrumStride, 0.f);
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1
+        && fwrite(table.data(), sizeof(float), table.size(), f) == table.size()
+        && (padding.empty() || fwrite(padding.data(), padding.size(), 1, f) == 1);
+
+    for (int e = 0; e < elevations && written; ++e)
+    {
+        for (int a = 0; a < azimuths && written; ++a)
+        {
+            const HRTFKernel * kernels[2] = {elevationList[e]->kernelListL()->at(a).get(), elevationList[e]->kernelListR()->at(a).get()};
+            for (const HRTFKernel * kernel : kernels)
+            {
+                memcpy(spectrum.data(), kernel->realData(), sizeof(float) * spectrumSize);
+                memcpy(spectrum.data() + spectrumStride, kernel->imagData(), sizeof(float) * spectrumSize);
+                written = written && fwrite(spectrum.data(), sizeof(float), spectrum.size(), f) == spectrum.size();
+            }
+        }
+    }
+
+    written = fclose(f) == 0 && written;
+    if (written && rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        // rename doesn't replace an existing file everywhere
+        remove(path.c_str());
+        written = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+
+    if (!written)
+    {
+        remove(temporaryPath.c_str());
+        LOG_ERROR("could not write %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace lab
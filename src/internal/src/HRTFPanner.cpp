@@ -5,19 +5,30 @@
 #include "internal/HRTFPanner.h"
 
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/Macros.h"
+#include "LabSound/core/MemoryAccounting.h"
+#include "LabSound/core/RenderTrace.h"
+#include "LabSound/core/StartupTiming.h"
 #include "LabSound/extended/AudioFileReader.h"
+#include "LabSound/extended/JobSystem.h"
+#include "LabSound/extended/VectorMath.h"
 #include "internal/Assertions.h"
+#include "internal/DenormalDisabler.h"
 #include "internal/HRTFDatabase.h"
 #include "internal/Biquad.h"
 #include "internal/FFTConvolver.h"
 #include "internal/FFTFrame.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <math.h>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <algorithm>
 
@@ -34,47 +45,261 @@ namespace lab
 
 
 
+namespace
+{
+    // the readers ask for elevations by setting a bit of a 64 bit mask
+    const int MaxLazyElevations = 64;
+
+    // how long the worker sleeps between looking for work it may not have been woken for
+    const std::chrono::milliseconds WorkerIdleWait(250);
+    const std::chrono::milliseconds WorkerRetireWait(10);
+}
+
 HRTFDatabase::HRTFDatabase(float sampleRate, const std::string & searchPath)
 {
     info.reset(new HRTFDatabaseInfo("Composite", searchPath, sampleRate));
 
-    m_elevations.resize(info->numTotalElevations);
+    if (HRTFSofaFile::isSofaPath(searchPath))
+    {
+        info->sofa = HRTFSofaFile::open(searchPath, sampleRate);
+        if (!info->sofa)
+            return;
+    }
+
+    const int count = info->numTotalElevations;
+    m_elevations.resize(count);
+    m_resident.reset(new std::atomic<HRTFElevation *>[count]);
+    m_lastUsed.reset(new std::atomic<uint64_t>[count]);
+    for (int i = 0; i < count; ++i)
+    {
+        m_resident[i].store(nullptr, std::memory_order_relaxed);
+        m_lastUsed[i].store(0, std::memory_order_relaxed);
+    }
+
+    // The elevation at the horizon is made now, so that the files are known to be found, and
+    // so that there is always an elevation to stand in for one that isn't resident yet.
+    m_pinned = info->indexFromElevationAngle(0);
+    std::unique_ptr<HRTFElevation> horizon;
+    {
+        std::lock_guard<std::mutex> lock(m_makeLock);
+        horizon = makeElevation(m_pinned);
+    }
+    if (!horizon)
+        return;
+
+    m_numberOfElevations = count;
+    m_filesFound = info->files_found_and_loaded;
+    makeResident(m_pinned, std::move(horizon));
+
+    if (count > MaxLazyElevations)
+    {
+        // too many to ask for by bit, so they're all made now
+        std::lock_guard<std::mutex> lock(m_makeLock);
+        for (int i = 0; i < count; ++i)
+        {
+            if (m_elevations[i])
+                continue;
+            std::unique_ptr<HRTFElevation> elevation = makeElevation(i);
+            if (!elevation)
+            {
+                m_numberOfElevations = 0;
+                return;
+            }
+            makeResident(i, std::move(elevation));
+        }
+        return;
+    }
+
+    m_worker = std::thread(&HRTFDatabase::residencyWorker, this);
+}
 
-    int elevationIndex = 0;
-    for (int elevation = info->minElevation; elevation <= info->maxElevation; elevation += info->rawElevationAngleSpacing)
+HRTFDatabase::~HRTFDatabase()
+{
+    if (m_worker.joinable())
     {
-        std::unique_ptr<HRTFElevation> hrtfElevation = HRTFElevation::createForSubject(info.get(), elevation);
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        m_worker.join();
+    }
+}
 
-        // @tofix - removed ASSERT(hrtfElevation.get());
-        if (!hrtfElevation.get()) return;
+void HRTFDatabase::makeResident(int index, std::unique_ptr<HRTFElevation> elevation)
+{
+    m_elevations[index] = std::move(elevation);
+    m_resident[index].store(m_elevations[index].get(), std::memory_order_release);
+}
 
-        m_elevations[elevationIndex] = std::move(hrtfElevation);
-        elevationIndex += info->interpolationFactor;
+std::unique_ptr<HRTFElevation> HRTFDatabase::makeElevation(int index) const
+{
+    const int factor = info->interpolationFactor;
+    const int raw = index - index % factor;
+    if (raw == index)
+        return HRTFElevation::createForSubject(info.get(), info->minElevation + (index / factor) * info->rawElevationAngleSpacing);
+
+    // the last raw elevation is interpolated with itself
+    int upper = raw + factor;
+    if (upper >= info->numTotalElevations)
+        upper = raw;
+
+    std::unique_ptr<HRTFElevation> lowerMade;
+    std::unique_ptr<HRTFElevation> upperMade;
+    HRTFElevation * lower = m_elevations[raw].get();
+    if (!lower)
+    {
+        lowerMade = makeElevation(raw);
+        lower = lowerMade.get();
+    }
+    HRTFElevation * higher = upper == raw ? lower : m_elevations[upper].get();
+    if (!higher)
+    {
+        upperMade = makeElevation(upper);
+        higher = upperMade.get();
     }
 
-    // Go back and interpolate elevations
-    if (info->interpolationFactor > 1)
+    if (!lower || !higher)
+        return nullptr;
+
+    const float x = static_cast<float>(index - raw) / static_cast<float>(factor);
+    return HRTFElevation::createByInterpolatingSlices(info.get(), lower, higher, x);
+}
+
+void HRTFDatabase::residencyWorker()
+{
+    DenormalDisabler denormalDisabler;
+    MemoryOwnerScope memoryScope(MemoryAccounting::subsystem("HRTF database"));
+    const int count = m_numberOfElevations;
+    uint64_t failed = 0;
+    std::vector<int> prefetch;
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (!m_stopping)
     {
-        for (int i = 0; i < info->numTotalElevations; i += info->interpolationFactor)
+        const uint64_t wanted = m_wanted.load() & ~failed;
+        int index = -1;
+        for (int i = 0; i < count && index < 0; ++i)
+            if (wanted & (1ull << i))
+                index = i;
+
+        bool prefetching = false;
+        if (index < 0)
         {
-            int j = (i + info->interpolationFactor);
+            // neighbours of the elevations asked for are made while nothing else is wanted, and
+            // while there is room for them
+            const int limit = m_residentLimit.load(std::memory_order_relaxed);
+            while (!prefetch.empty() && index < 0)
+            {
+                const int i = prefetch.back();
+                prefetch.pop_back();
+                if (!m_elevations[i] && !(failed & (1ull << i)) && (limit <= 0 || residentElevations() < limit))
+                    index = i;
+            }
+            prefetching = index >= 0;
+        }
 
-            if (j >= info->numTotalElevations)
+        if (index >= 0)
+        {
+            std::unique_ptr<HRTFElevation> elevation;
+            if (!m_elevations[index])
             {
-                j = i;  // for last elevation interpolate with itself
+                lock.unlock();
+                {
+                    std::lock_guard<std::mutex> making(m_makeLock);
+                    elevation = makeElevation(index);
+                }
+                lock.lock();
+                if (!elevation)
+                {
+                    // its bit is left set, so that the readers don't ask for it again
+                    LOG_ERROR("HRTF elevation %d could not be made", index);
+                    failed |= 1ull << index;
+                    continue;
+                }
+
+                // a prefetched elevation is released before any that has been used
+                m_lastUsed[index].store(prefetching ? 0 : m_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                makeResident(index, std::move(elevation));
             }
+            m_wanted.fetch_and(~(1ull << index));
 
-            // Create the interpolated convolution kernels and delays.
-            for (int jj = 1; jj < info->interpolationFactor; ++jj)
+            if (!prefetching)
             {
-                float x = static_cast<float>(jj) / static_cast<float>(info->interpolationFactor);
-                m_elevations[i + jj] = HRTFElevation::createByInterpolatingSlices(info.get(), m_elevations[i].get(), m_elevations[j].get(), x);
-                ASSERT(m_elevations[i + jj].get());
+                if (index > 0)
+                    prefetch.push_back(index - 1);
+                if (index + 1 < count)
+                    prefetch.push_back(index + 1);
             }
         }
+
+        evict(prefetching ? -1 : index);
+        m_limitChanged = false;
+
+        if (!m_retired.empty() && m_readers.load() == 0)
+            m_retired.clear();
+
+        if (index < 0)
+        {
+            m_wake.wait_for(lock, m_retired.empty() ? WorkerIdleWait : WorkerRetireWait, [this, failed]()
+            {
+                return m_stopping || m_limitChanged || (m_wanted.load() & ~failed) != 0;
+            });
+        }
     }
 }
 
+void HRTFDatabase::evict(int keep)
+{
+    const int limit = m_residentLimit.load(std::memory_order_relaxed);
+    if (limit <= 0)
+        return;
+
+    int resident = residentElevations();
+    while (resident > limit)
+    {
+        int oldest = -1;
+        for (int i = 0; i < m_numberOfElevations; ++i)
+        {
+            if (!m_elevations[i] || i == m_pinned || i == keep)
+                continue;
+            if (oldest < 0 || m_lastUsed[i].load(std::memory_order_relaxed) < m_lastUsed[oldest].load(std::memory_order_relaxed))
+                oldest = i;
+        }
+        if (oldest < 0)
+            return;
+
+        // a reader that has already found the elevation may still be using it, so it's kept
+        // until no reading is held
+        m_resident[oldest].store(nullptr);
+        m_retired.push_back(std::move(m_elevations[oldest]));
+        --resident;
+    }
+}
+
+void HRTFDatabase::setResidentLimit(int elevations)
+{
+    m_residentLimit.store(std::max(0, elevations), std::memory_order_relaxed);
+    if (m_worker.joinable())
+    {
+        // the worker evicts to the new limit on waking
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_limitChanged = true;
+        }
+        m_wake.notify_one();
+    }
+}
+
+int HRTFDatabase::residentElevations() const
+{
+    int resident = 0;
+    for (int i = 0; i < m_numberOfElevations; ++i)
+        if (m_resident[i].load(std::memory_order_relaxed))
+            ++resident;
+    return resident;
+}
+
 void HRTFDatabase::getKernelsFromAzimuthElevation(double azimuthBlend,
                                                   unsigned azimuthIndex,
                                                   double elevationAngle,
@@ -83,62 +308,83 @@ void HRTFDatabase::getKernelsFromAzimuthElevation(double azimuthBlend,
                                                   double & frameDelayL,
                                                   double & frameDelayR)
 {
+    const int count = m_numberOfElevations;
+    ASSERT(count > 0);
 
-    size_t elevationIndex = info->indexFromElevationAngle(elevationAngle);
-
-    ASSERT(elevationIndex < m_elevations.size() && m_elevations.size() > 0);
-
-    if (!m_elevations.size())
+    if (!count)
     {
         kernelL = 0;
         kernelR = 0;
         return;
     }
 
-    if (elevationIndex > m_elevations.size() - 1)
+    int elevationIndex = std::min(info->indexFromElevationAngle(elevationAngle), count - 1);
+    HRTFElevation * hrtfElevation = m_resident[elevationIndex].load(std::memory_order_acquire);
+
+    if (!hrtfElevation)
     {
-        elevationIndex = m_elevations.size() - 1;
-    }
+        // asked for once; the worker clears the bit when the elevation is resident
+        const uint64_t bit = 1ull << elevationIndex;
+        if (!(m_wanted.fetch_or(bit) & bit))
+            m_wake.notify_one();
 
-    HRTFElevation * hrtfElevation = m_elevations[elevationIndex].get();
+        // the nearest resident elevation stands in meanwhile
+        for (int d = 1; d < count && !hrtfElevation; ++d)
+        {
+            if (elevationIndex - d >= 0 && (hrtfElevation = m_resident[elevationIndex - d].load(std::memory_order_acquire)))
+                elevationIndex -= d;
+            else if (elevationIndex + d < count && (hrtfElevation = m_resident[elevationIndex + d].load(std::memory_order_acquire)))
+                elevationIndex += d;
+        }
+    }
 
     ASSERT(hrtfElevation);
 
     if (!hrtfElevation)
     {
-        throw std::runtime_error("Error getting hrtfElevation");
+        kernelL = 0;
+        kernelR = 0;
+        return;
     }
 
+    m_lastUsed[elevationIndex].store(m_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     hrtfElevation->getKernelsFromAzimuth(azimuthBlend, azimuthIndex, kernelL, kernelR, frameDelayL, frameDelayR);
 }
 
 
 
-// Singleton
-HRTFDatabaseLoader* HRTFDatabaseLoader::s_loader;
+namespace
+{
+    std::mutex s_loadersLock;
+    std::vector<std::weak_ptr<HRTFDatabaseLoader>> s_loaders;
+}
 
-HRTFDatabaseLoader* HRTFDatabaseLoader::MakeHRTFLoaderSingleton(float sampleRate, const std::string & searchPath)
+std::shared_ptr<HRTFDatabaseLoader> HRTFDatabaseLoader::MakeHRTFLoaderSingleton(float sampleRate, const std::string & searchPath)
 {
-    //if (!s_loader)
-    //{
-    //    s_loader = new HRTFDatabaseLoader(sampleRate, searchPath);
-    //    s_loader->loadAsynchronously();
-    //}
-    if (!s_loader)
-    {
-        s_loader = new HRTFDatabaseLoader(sampleRate, searchPath);
-        // s_loader->loadAsynchronously();
-    }
-    if (s_loader && (!s_loader->database() || !s_loader->database()->files_found_and_loaded()))
+    std::lock_guard<std::mutex> lock(s_loadersLock);
+
+    for (auto i = s_loaders.begin(); i != s_loaders.end();)
     {
-        s_loader = new HRTFDatabaseLoader(sampleRate, searchPath);
+        std::shared_ptr<HRTFDatabaseLoader> loader = i->lock();
+        if (!loader)
+        {
+            i = s_loaders.erase(i);
+            continue;
+        }
+
+        if (loader->databaseSampleRate() == sampleRate && loader->databaseSearchPath() == searchPath)
+        {
+            // a database that was loaded without finding its files is retried with a new loader
+            HRTFDatabase * database = loader->isLoaded() ? loader->database() : nullptr;
+            if (!database || database->files_found_and_loaded())
+                return loader;
+        }
+        ++i;
     }
-    // if (s_loader && s_loader->database() && (s_loader->searchPath != searchPath ) )
-    //{
-    //     s_loader = new HRTFDatabaseLoader(sampleRate, searchPath);
-    // }
 
-    return s_loader;
+    std::shared_ptr<HRTFDatabaseLoader> loader = std::make_shared<HRTFDatabaseLoader>(sampleRate, searchPath);
+    s_loaders.push_back(loader);
+    return loader;
 }
 
 HRTFDatabaseLoader::HRTFDatabaseLoader(float sampleRate, const std::string & searchPath)
@@ -146,75 +392,121 @@ HRTFDatabaseLoader::HRTFDatabaseLoader(float sampleRate, const std::string & sea
     , m_databaseSampleRate(sampleRate)
     , searchPath(searchPath)
 {
-    s_loader = this;
 }
 
 HRTFDatabaseLoader::~HRTFDatabaseLoader()
 {
-    waitForLoaderThreadCompletion();
-
-    if (m_databaseLoaderThread.joinable()) m_databaseLoaderThread.join();
+    bool loading;
+    {
+        std::lock_guard<std::mutex> lock(m_threadLock);
+        loading = m_loading;
+    }
+    if (loading)
+        JobSystem::shared().wait([this]() { return m_jobFinished.load(std::memory_order_acquire); }, JobPriority::High);
 
     m_hrtfDatabase.reset();
-
-    ASSERT(this == s_loader);
-
-    //s_loader = nullptr; //.reset(db) creates new loader before calling this destructor
 }
 
-// Asynchronously load the database in this thread.
+// Asynchronously load the database, as a job.
 void HRTFDatabaseLoader::databaseLoaderEntry(HRTFDatabaseLoader * threadData)
 {
-    std::lock_guard<std::mutex> locker(threadData->m_threadLock);
     HRTFDatabaseLoader * loader = reinterpret_cast<HRTFDatabaseLoader *>(threadData);
     ASSERT(loader);
 
-    threadData->m_loading = true;
+    // the lock isn't held while loading, so that other threads may ask to be called back
     loader->load();
-    threadData->m_loadingCondition.notify_one();
+
+    std::vector<std::function<void(bool)>> completions;
+    {
+        std::lock_guard<std::mutex> locker(loader->m_threadLock);
+        if (loader->m_hrtfDatabase)
+            loader->m_hrtfDatabase->setResidentLimit(loader->m_residentLimit.load());
+        loader->m_loaded.store(true, std::memory_order_release);
+        completions.swap(loader->m_completions);
+    }
+
+    const bool succeeded = loader->loadSucceeded();
+    for (auto & completion : completions)
+        completion(succeeded);
+
+    loader->m_jobFinished.store(true, std::memory_order_release);
 }
 
 void HRTFDatabaseLoader::load()
 {
-    m_hrtfDatabase.reset(new HRTFDatabase(m_databaseSampleRate, searchPath));
-
-    if (!m_hrtfDatabase.get())
+    TraceScope trace("HRTF database load", "io");
+    StartupPhaseScope phase("HRTF database");
+    MemoryOwnerScope memoryScope(MemoryAccounting::subsystem("HRTF database"));
+
+    // a compiled database, either named by the search path or found in it, is used in
+    // preference to the impulse responses
+    m_hrtfDatabase = HRTFDatabase::loadCompiled(searchPath, m_databaseSampleRate);
+    if (!m_hrtfDatabase && !HRTFSofaFile::isSofaPath(searchPath))
+        m_hrtfDatabase = HRTFDatabase::loadCompiled(searchPath + "/" + HRTFDatabase::compiledName(m_databaseSampleRate), m_databaseSampleRate);
+    if (!m_hrtfDatabase)
+        m_hrtfDatabase.reset(new HRTFDatabase(m_databaseSampleRate, searchPath));
+
+    if (!m_hrtfDatabase->files_found_and_loaded())
     {
         LOG_ERROR("HRTF database not loaded");
     }
 }
 
-void HRTFDatabaseLoader::loadAsynchronously()
+void HRTFDatabaseLoader::setResidentLimit(int elevations)
 {
     std::lock_guard<std::mutex> lock(m_threadLock);
+    m_residentLimit.store(elevations);
+    if (isLoaded() && m_hrtfDatabase)
+        m_hrtfDatabase->setResidentLimit(elevations);
+}
 
-    if (!m_hrtfDatabase.get() && !m_loading)
+void HRTFDatabaseLoader::loadAsynchronously()
+{
+    loadAsynchronously(nullptr);
+}
+
+void HRTFDatabaseLoader::loadAsynchronously(std::function<void(bool)> completion)
+{
     {
-        m_databaseLoaderThread = std::thread(databaseLoaderEntry, this);
+        std::lock_guard<std::mutex> lock(m_threadLock);
+
+        if (!m_loaded.load(std::memory_order_acquire))
+        {
+            if (completion)
+                m_completions.push_back(std::move(completion));
+
+            if (!m_loading)
+            {
+                m_loading = true;
+                JobSystem::shared().submit([this]() { databaseLoaderEntry(this); }, JobPriority::High);
+            }
+            return;
+        }
     }
+
+    if (completion)
+        completion(loadSucceeded());
 }
 
 bool HRTFDatabaseLoader::isLoaded() const
 {
-    return (m_hrtfDatabase.get() != nullptr);
+    return m_loaded.load(std::memory_order_acquire);
 }
 
-void HRTFDatabaseLoader::waitForLoaderThreadCompletion()
+bool HRTFDatabaseLoader::loadSucceeded() const
 {
-    std::unique_lock<std::mutex> locker(m_threadLock);
-    while (!m_hrtfDatabase.get())
-    {
-        m_loadingCondition.wait(locker);
-    }
+    if (!isLoaded() || !m_hrtfDatabase)
+        return false;
+
+    return m_hrtfDatabase->files_found_and_loaded() && m_hrtfDatabase->numberOfElevations() > 0;
 }
 
-HRTFDatabase * HRTFDatabaseLoader::defaultHRTFDatabase()
+void HRTFDatabaseLoader::waitForLoaderThreadCompletion()
 {
-    if (!s_loader) return nullptr;
-    return s_loader->database();
+    // the loading job is run here if no worker has taken it up yet
+    JobSystem::shared().wait([this]() { return m_loaded.load(std::memory_order_acquire); }, JobPriority::High);
 }
 
-
 // The range of elevations for the IRCAM impulse responses varies depending on azimuth, but the minimum elevation appears to always be -45.
 static int maxElevations[] = {
     // Azimuth
@@ -278,21 +570,10 @@ bool HRTFElevation::calculateSymmetricKernelsForAzimuthElevation(HRTFDatabaseInf
     return true;
 }
 
-bool HRTFElevation::calculateKernelsForAzimuthElevation(
-    HRTFDatabaseInfo * info, int azimuth, int elevation, 
-    std::shared_ptr<HRTFKernel> & kernelL, std::shared_ptr<HRTFKernel> & kernelR)
+// Loads the IRCAM impulse response for azimuth and elevation from the subject's files in the
+// search path, resampled to the database's rate.
+static std::shared_ptr<AudioBus> loadIrcamImpulseResponse(HRTFDatabaseInfo * info, int azimuth, int elevation)
 {
-    // Valid values for azimuth are 0 -> 345 in 15 degree increments.
-    // Valid values for elevation are -45 -> +90 in 15 degree increments.
-
-    bool isAzimuthGood = azimuth >= 0 && azimuth <= 345 && (azimuth / 15) * 15 == azimuth;
-    ASSERT(isAzimuthGood);
-    if (!isAzimuthGood) return false;
-
-    bool isElevationGood = elevation >= -45 && elevation <= 90 && (elevation / 15) * 15 == elevation;
-    ASSERT(isElevationGood);
-    if (!isElevationGood) return false;
-
     // Construct the resource name from the subject name, azimuth, and elevation, for example:
     // "IRC_Composite_C_R0195_T015_P000"
     int positiveElevation = elevation < 0 ? elevation + 360 : elevation;
@@ -311,8 +592,7 @@ bool HRTFElevation::calculateKernelsForAzimuthElevation(
     if (!impulseResponse)
     {
         LOG_ERROR("impulse not found %s (bad path?)", resourceName.c_str());
-        info->files_found_and_loaded = false;
-        return false;
+        return nullptr;
     }
 
     // The impulse files are 44.1k so we need to resample them if the graph is playing back at any other rate
@@ -323,6 +603,34 @@ bool HRTFElevation::calculateKernelsForAzimuthElevation(
         // LOG_VERBOSE("converting %s impulse to %f hz", resourceName.c_str(), info->sampleRate);
     }
 
+    return impulseResponse;
+}
+
+bool HRTFElevation::calculateKernelsForAzimuthElevation(
+    HRTFDatabaseInfo * info, int azimuth, int elevation, 
+    std::shared_ptr<HRTFKernel> & kernelL, std::shared_ptr<HRTFKernel> & kernelR)
+{
+    // Valid values for azimuth are 0 -> 345 in 15 degree increments.
+    // Valid values for elevation are -45 -> +90 in 15 degree increments.
+
+    bool isAzimuthGood = azimuth >= 0 && azimuth <= 345 && (azimuth / 15) * 15 == azimuth;
+    ASSERT(isAzimuthGood);
+    if (!isAzimuthGood) return false;
+
+    bool isElevationGood = elevation >= -45 && elevation <= 90 && (elevation / 15) * 15 == elevation;
+    ASSERT(isElevationGood);
+    if (!isElevationGood) return false;
+
+    std::shared_ptr<AudioBus> impulseResponse = info->sofa
+        ? info->sofa->impulseResponse(azimuth, elevation)
+        : loadIrcamImpulseResponse(info, azimuth, elevation);
+
+    if (!impulseResponse)
+    {
+        info->files_found_and_loaded = false;
+        return false;
+    }
+
     // Check number of channels. For now these are fixed and known.
     bool isBusGood = (impulseResponse->numberOfChannels() == Channels::Stereo);
 
@@ -361,7 +669,8 @@ std::unique_ptr<HRTFElevation> HRTFElevation::createForSubject(HRTFDatabaseInfo
     for (uint32_t rawIndex = 0; rawIndex < NumberOfRawAzimuths; ++rawIndex)
     {
         // Don't let elevation exceed maximum for this azimuth.
-        int maxElevation = maxElevations[rawIndex];
+        // A SOFA file is assumed to cover the whole sphere.
+        int maxElevation = info->sofa ? info->maxElevation : maxElevations[rawIndex];
         int actualElevation = min(elevation, maxElevation);
 
         bool success = calculateKernelsForAzimuthElevation(
@@ -394,6 +703,16 @@ std::unique_ptr<HRTFElevation> HRTFElevation::createForSubject(HRTFDatabaseInfo
     return std::unique_ptr<HRTFElevation>(new HRTFElevation(info, std::move(kernelListL), std::move(kernelListR), elevation));
 }
 
+std::unique_ptr<HRTFElevation> HRTFElevation::createWithKernels(std::unique_ptr<HRTFKernelList> kernelListL, std::unique_ptr<HRTFKernelList> kernelListR, double elevationAngle)
+{
+    bool isListGood = kernelListL && kernelListR && kernelListL->size() == NumberOfTotalAzimuths && kernelListR->size() == NumberOfTotalAzimuths;
+    ASSERT(isListGood);
+    if (!isListGood)
+        return nullptr;
+
+    return std::unique_ptr<HRTFElevation>(new HRTFElevation(nullptr, std::move(kernelListL), std::move(kernelListR), elevationAngle));
+}
+
 std::unique_ptr<HRTFElevation> HRTFElevation::createByInterpolatingSlices(HRTFDatabaseInfo * info, HRTFElevation * hrtfElevation1, HRTFElevation * hrtfElevation2, float x)
 {
     ASSERT(hrtfElevation1 && hrtfElevation2);
@@ -420,7 +739,7 @@ std::unique_ptr<HRTFElevation> HRTFElevation::createByInterpolatingSlices(HRTFDa
     // Interpolate elevation angle.
     double angle = (1.0 - x) * hrtfElevation1->elevationAngle() + x * hrtfElevation2->elevationAngle();
 
-    return std::unique_ptr<HRTFElevation>(new HRTFElevation(info, std::move(kernelListL), std::move(kernelListR), (int) angle));
+    return std::unique_ptr<HRTFElevation>(new HRTFElevation(info, std::move(kernelListL), std::move(kernelListR), angle));
 }
 
 void HRTFElevation::getKernelsFromAzimuth(double azimuthBlend, unsigned azimuthIndex, HRTFKernel *& kernelL, HRTFKernel *& kernelR, double & frameDelayL, double & frameDelayR)
@@ -518,12 +837,17 @@ HRTFKernel::HRTFKernel(AudioChannel * channel, int fftSize, float sampleRate)
 
     m_fftFrame = std::unique_ptr<FFTFrame>(new FFTFrame(fftSize));
     m_fftFrame->doPaddedFFT(impulseResponse, truncatedResponseLength);
+    m_realData = m_fftFrame->realData();
+    m_imagData = m_fftFrame->imagData();
+    m_fftSize = fftSize;
 }
 
 std::unique_ptr<AudioChannel> HRTFKernel::createImpulseResponse()
 {
     std::unique_ptr<AudioChannel> channel(new AudioChannel(fftSize()));
-    FFTFrame fftFrame(*m_fftFrame);
+    FFTFrame fftFrame(fftSize());
+    memcpy(fftFrame.realData(), m_realData, sizeof(float) * fftFrame.spectrumSize());
+    memcpy(fftFrame.imagData(), m_imagData, sizeof(float) * fftFrame.spectrumSize());
 
     // Add leading delay back in.
     fftFrame.addConstantGroupDelay(m_frameDelay);
@@ -549,6 +873,11 @@ std::unique_ptr<HRTFKernel> MakeInterpolatedKernel(HRTFKernel * kernel1, HRTFKer
     if (sampleRate1 != sampleRate2)
         return 0;
 
+    // only kernels made from impulse responses are interpolated
+    ASSERT(kernel1->fftFrame() && kernel2->fftFrame());
+    if (!kernel1->fftFrame() || !kernel2->fftFrame())
+        return 0;
+
     float frameDelay = (1 - x) * kernel1->frameDelay() + x * kernel2->frameDelay();
     //kernel1->fftFrame()->print();
 
@@ -562,7 +891,9 @@ std::unique_ptr<HRTFKernel> MakeInterpolatedKernel(HRTFKernel * kernel1, HRTFKer
 // We ASSERT the delay values used in process() with this value.
 const double MaxDelayTimeSeconds = 0.002;
 const int UninitializedAzimuth = -1;
-const uint32_t RenderingQuantum = AudioNode::ProcessingSizeInFrames;
+// Kernels and inter-aural delays are updated once per segment of at most this many frames,
+// independently of the context's render quantum size
+const uint32_t MaxFramesPerSegment = AudioNode::ProcessingSizeInFrames;
 
 HRTFPanner::HRTFPanner(float sampleRate)
     : Panner(sampleRate, PanningModel::HRTF)
@@ -579,10 +910,13 @@ HRTFPanner::HRTFPanner(float sampleRate)
     , m_convolverR2(fftSizeForSampleRate(sampleRate))
     , m_delayLineL(MaxDelayTimeSeconds, sampleRate)
     , m_delayLineR(MaxDelayTimeSeconds, sampleRate)
-    , m_tempL1(RenderingQuantum)
-    , m_tempR1(RenderingQuantum)
-    , m_tempL2(RenderingQuantum)
-    , m_tempR2(RenderingQuantum)
+    , m_tempL1(MaxFramesPerSegment)
+    , m_tempR1(MaxFramesPerSegment)
+    , m_tempL2(MaxFramesPerSegment)
+    , m_tempR2(MaxFramesPerSegment)
+    , m_spectrumSize(FFTFrame(fftSizeForSampleRate(sampleRate)).spectrumSize())
+    , m_blendL(2 * m_spectrumSize)
+    , m_blendR(2 * m_spectrumSize)
 {
 }
 
@@ -627,14 +961,36 @@ void HRTFPanner::reset()
     m_delayLineR.reset();
 }
 
-int HRTFPanner::calculateDesiredAzimuthIndexAndBlend(double azimuth, double & azimuthBlend)
+void HRTFPanner::setInterpolatesKernels(bool interpolates)
+{
+    if (interpolates == m_interpolatesKernels)
+        return;
+
+    // the modes keep different convolvers' histories
+    m_interpolatesKernels = interpolates;
+    m_convolverL1.reset();
+    m_convolverR1.reset();
+    m_convolverL2.reset();
+    m_convolverR2.reset();
+}
+
+// Blends two kernels' spectra, (1 - x) of the first and x of the second, into blend.
+static void blendKernels(const HRTFKernel * kernel1, const HRTFKernel * kernel2, float x, int spectrumSize, float * blend)
+{
+    const float x1 = 1 - x;
+    VectorMath::vsmul(kernel1->realData(), 1, &x1, blend, 1, spectrumSize);
+    VectorMath::vsma(kernel2->realData(), 1, &x, blend, 1, spectrumSize);
+    VectorMath::vsmul(kernel1->imagData(), 1, &x1, blend + spectrumSize, 1, spectrumSize);
+    VectorMath::vsma(kernel2->imagData(), 1, &x, blend + spectrumSize, 1, spectrumSize);
+}
+
+int HRTFPanner::calculateDesiredAzimuthIndexAndBlend(HRTFDatabase * database, double azimuth, double & azimuthBlend)
 {
     // Convert the azimuth angle from the range -180 -> +180 into the range 0 -> 360.
     // The azimuth index may then be calculated from this positive value.
     if (azimuth < 0)
         azimuth += 360.0;
 
-    HRTFDatabase * database = HRTFDatabaseLoader::defaultHRTFDatabase();
     ASSERT(database);
 
     int numberOfAzimuths = database->numberOfAzimuths();
@@ -673,7 +1029,8 @@ void HRTFPanner::pan(ContextRenderLock & r,
     }
 
     // This code only runs as long as the context is alive and after database has been loaded.
-    HRTFDatabase * database = HRTFDatabaseLoader::defaultHRTFDatabase();
+    std::shared_ptr<HRTFDatabaseLoader> loader = r.context()->hrtfDatabaseLoader();
+    HRTFDatabase * database = loader && loader->isLoaded() ? loader->database() : nullptr;
     ASSERT(database);
 
     if (!database)
@@ -681,6 +1038,7 @@ void HRTFPanner::pan(ContextRenderLock & r,
         outputBus.zero();
         return;
     }
+    HRTFDatabase::Reading reading(database);
 
     // IRCAM HRTF azimuths values from the loaded database is reversed from the panner's notion of azimuth.
     double azimuth = -desiredAzimuth;
@@ -706,7 +1064,7 @@ void HRTFPanner::pan(ContextRenderLock & r,
     float * destinationR = outputBus.channelByType(Channel::Right)->mutableData();
 
     double azimuthBlend;
-    int desiredAzimuthIndex = calculateDesiredAzimuthIndexAndBlend(azimuth, azimuthBlend);
+    int desiredAzimuthIndex = calculateDesiredAzimuthIndexAndBlend(database, azimuth, azimuthBlend);
 
     // Initially snap azimuth and elevation values to first values encountered.
     if (m_azimuthIndex1 == UninitializedAzimuth)
@@ -749,11 +1107,11 @@ void HRTFPanner::pan(ContextRenderLock & r,
         }
     }
 
-    // This algorithm currently requires that we process in power-of-two size chunks at least RenderingQuantum.
+    // This algorithm currently requires that we process in power-of-two size chunks, so that the segments
+    // add up to the convolvers' fftSize / 2.
     ASSERT(uint64_t(1) << static_cast<int>(log2(framesToProcess)) == framesToProcess);
-    ASSERT(framesToProcess >= RenderingQuantum);
 
-    const int framesPerSegment = RenderingQuantum;
+    const int framesPerSegment = framesToProcess < (int) MaxFramesPerSegment ? framesToProcess : (int) MaxFramesPerSegment;
     const int numberOfSegments = framesToProcess / framesPerSegment;
 
     for (int segment = 0; segment < numberOfSegments; ++segment)
@@ -803,50 +1161,80 @@ void HRTFPanner::pan(ContextRenderLock & r,
 
         bool needsCrossfading = m_crossfadeIncr;
 
-        // Have the convolvers render directly to the final destination if we're not cross-fading.
-        float * convolutionDestinationL1 = needsCrossfading ? m_tempL1.data() : segmentDestinationL;
-        float * convolutionDestinationR1 = needsCrossfading ? m_tempR1.data() : segmentDestinationR;
-        float * convolutionDestinationL2 = needsCrossfading ? m_tempL2.data() : segmentDestinationL;
-        float * convolutionDestinationR2 = needsCrossfading ? m_tempR2.data() : segmentDestinationR;
-
-        // Now do the convolutions.
-        // Note that we avoid doing convolutions on both sets of convolvers if we're not currently cross-fading.
-        if (m_crossfadeSelection == CrossfadeSelection1 || needsCrossfading)
+        if (m_interpolatesKernels)
         {
-            m_convolverL1.process(kernelL1->fftFrame(), segmentDestinationL, convolutionDestinationL1, framesPerSegment);
-            m_convolverR1.process(kernelR1->fftFrame(), segmentDestinationR, convolutionDestinationR1, framesPerSegment);
-        }
+            // One convolution per ear, with the kernel of whichever direction is heard, or
+            // during a crossfade the blend of both at the middle of the segment.
+            const float * kernelRealL = m_crossfadeSelection == CrossfadeSelection1 ? kernelL1->realData() : kernelL2->realData();
+            const float * kernelImagL = m_crossfadeSelection == CrossfadeSelection1 ? kernelL1->imagData() : kernelL2->imagData();
+            const float * kernelRealR = m_crossfadeSelection == CrossfadeSelection1 ? kernelR1->realData() : kernelR2->realData();
+            const float * kernelImagR = m_crossfadeSelection == CrossfadeSelection1 ? kernelR1->imagData() : kernelR2->imagData();
+
+            if (needsCrossfading)
+            {
+                const float x = std::min(1.f, std::max(0.f, m_crossfadeX + 0.5f * m_crossfadeIncr * framesPerSegment));
+                blendKernels(kernelL1, kernelL2, x, m_spectrumSize, m_blendL.data());
+                blendKernels(kernelR1, kernelR2, x, m_spectrumSize, m_blendR.data());
+                kernelRealL = m_blendL.data();
+                kernelImagL = m_blendL.data() + m_spectrumSize;
+                kernelRealR = m_blendR.data();
+                kernelImagR = m_blendR.data() + m_spectrumSize;
+                m_crossfadeX += m_crossfadeIncr * framesPerSegment;
+            }
 
-        if (m_crossfadeSelection == CrossfadeSelection2 || needsCrossfading)
-        {
-            m_convolverL2.process(kernelL2->fftFrame(), segmentDestinationL, convolutionDestinationL2, framesPerSegment);
-            m_convolverR2.process(kernelR2->fftFrame(), segmentDestinationR, convolutionDestinationR2, framesPerSegment);
+            m_convolverL1.process(kernelRealL, kernelImagL, segmentDestinationL, segmentDestinationL, framesPerSegment);
+            m_convolverR1.process(kernelRealR, kernelImagR, segmentDestinationR, segmentDestinationR, framesPerSegment);
         }
-
-        if (needsCrossfading)
+        else
         {
-            // Apply linear cross-fade.
-            float x = m_crossfadeX;
-            float incr = m_crossfadeIncr;
+            // Have the convolvers render directly to the final destination if we're not cross-fading.
+            float * convolutionDestinationL1 = needsCrossfading ? m_tempL1.data() : segmentDestinationL;
+            float * convolutionDestinationR1 = needsCrossfading ? m_tempR1.data() : segmentDestinationR;
+            float * convolutionDestinationL2 = needsCrossfading ? m_tempL2.data() : segmentDestinationL;
+            float * convolutionDestinationR2 = needsCrossfading ? m_tempR2.data() : segmentDestinationR;
+
+            // Now do the convolutions.
+            // Note that we avoid doing convolutions on both sets of convolvers if we're not currently cross-fading.
+            if (m_crossfadeSelection == CrossfadeSelection1 || needsCrossfading)
+            {
+                m_convolverL1.process(kernelL1->realData(), kernelL1->imagData(), segmentDestinationL, convolutionDestinationL1, framesPerSegment);
+                m_convolverR1.process(kernelR1->realData(), kernelR1->imagData(), segmentDestinationR, convolutionDestinationR1, framesPerSegment);
+            }
 
-            for (uint32_t i = 0; i < framesPerSegment; ++i)
+            if (m_crossfadeSelection == CrossfadeSelection2 || needsCrossfading)
             {
-                segmentDestinationL[i] = (1 - x) * convolutionDestinationL1[i] + x * convolutionDestinationL2[i];
-                segmentDestinationR[i] = (1 - x) * convolutionDestinationR1[i] + x * convolutionDestinationR2[i];
-                x += incr;
+                m_convolverL2.process(kernelL2->realData(), kernelL2->imagData(), segmentDestinationL, convolutionDestinationL2, framesPerSegment);
+                m_convolverR2.process(kernelR2->realData(), kernelR2->imagData(), segmentDestinationR, convolutionDestinationR2, framesPerSegment);
             }
 
-            // Update cross-fade value from local.
-            m_crossfadeX = x;
+            if (needsCrossfading)
+            {
+                // Apply linear cross-fade.
+                float x = m_crossfadeX;
+                float incr = m_crossfadeIncr;
+
+                for (uint32_t i = 0; i < framesPerSegment; ++i)
+                {
+                    segmentDestinationL[i] = (1 - x) * convolutionDestinationL1[i] + x * convolutionDestinationL2[i];
+                    segmentDestinationR[i] = (1 - x) * convolutionDestinationR1[i] + x * convolutionDestinationR2[i];
+                    x += incr;
+                }
+
+                // Update cross-fade value from local.
+                m_crossfadeX = x;
+            }
+        }
 
-            if (m_crossfadeIncr > 0 && fabs(m_crossfadeX - 1) < m_crossfadeIncr)
+        if (needsCrossfading)
+        {
+            if (m_crossfadeIncr > 0 && m_crossfadeX > 1 - m_crossfadeIncr)
             {
                 // We've fully made the crossfade transition from 1 -> 2.
                 m_crossfadeSelection = CrossfadeSelection2;
                 m_crossfadeX = 1;
                 m_crossfadeIncr = 0;
             }
-            else if (m_crossfadeIncr < 0 && fabs(m_crossfadeX) < -m_crossfadeIncr)
+            else if (m_crossfadeIncr < 0 && m_crossfadeX < -m_crossfadeIncr)
             {
                 // We've fully made the crossfade transition from 2 -> 1.
                 m_crossfadeSelection = CrossfadeSelection1;
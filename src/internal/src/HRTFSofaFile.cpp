@@ -0,0 +1,123 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/HRTFDatabase.h"
+#include "internal/HRTFPanner.h"
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/extended/Logging.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// SOFA files are netCDF-4, that is HDF5, files. LabSound doesn't carry an HDF5 reader of its
+// own; configure with LABSOUND_USE_LIBMYSOFA to read them with libmysofa.
+#if defined(LABSOUND_HAVE_LIBMYSOFA)
+#include <mysofa.h>
+#endif
+
+namespace lab
+{
+
+bool HRTFSofaFile::isSofaPath(const std::string & path)
+{
+    static const char extension[] = ".sofa";
+    const size_t n = sizeof(extension) - 1;
+    if (path.size() <= n)
+        return false;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        char c = path[path.size() - n + i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != extension[i])
+            return false;
+    }
+    return true;
+}
+
+#if defined(LABSOUND_HAVE_LIBMYSOFA)
+
+std::shared_ptr<HRTFSofaFile> HRTFSofaFile::open(const std::string & path, float sampleRate)
+{
+    // libmysofa resamples the responses to sampleRate, and normalizes their loudness
+    int filterLength = 0;
+    int err = MYSOFA_OK;
+    MYSOFA_EASY * sofa = mysofa_open(path.c_str(), sampleRate, &filterLength, &err);
+    if (!sofa || err != MYSOFA_OK)
+    {
+        LOG_ERROR("SOFA file %s could not be read (error %d)", path.c_str(), err);
+        if (sofa)
+            mysofa_close(sofa);
+        return nullptr;
+    }
+
+    std::shared_ptr<HRTFSofaFile> file(new HRTFSofaFile());
+    file->m_sofa = sofa;
+    file->m_filterLength = filterLength;
+    file->m_sampleRate = sampleRate;
+    return file;
+}
+
+HRTFSofaFile::~HRTFSofaFile()
+{
+    if (m_sofa)
+        mysofa_close(static_cast<MYSOFA_EASY *>(m_sofa));
+}
+
+std::shared_ptr<AudioBus> HRTFSofaFile::impulseResponse(int azimuth, int elevation)
+{
+    // SOFA's listener coordinates have x ahead, y to the left and z up, so that azimuths
+    // turn counterclockwise, as the IRCAM responses' do
+    const double az = static_cast<double>(azimuth) * LAB_PI / 180.0;
+    const double el = static_cast<double>(elevation) * LAB_PI / 180.0;
+    const float x = static_cast<float>(cos(el) * cos(az));
+    const float y = static_cast<float>(cos(el) * sin(az));
+    const float z = static_cast<float>(sin(el));
+
+    std::vector<float> left(m_filterLength);
+    std::vector<float> right(m_filterLength);
+    float delayL = 0;
+    float delayR = 0;
+    mysofa_getfilter_float(static_cast<MYSOFA_EASY *>(m_sofa), x, y, z, left.data(), right.data(), &delayL, &delayR);
+
+    // A file may hold its onset delays apart from its responses. The kernels find their delay
+    // in the response itself, so the delays are put back as leading silence.
+    const int offsetL = std::max(0, static_cast<int>(delayL * m_sampleRate + 0.5f));
+    const int offsetR = std::max(0, static_cast<int>(delayR * m_sampleRate + 0.5f));
+    // the kernels analyse at least half an FFT of the response
+    const int length = std::max(m_filterLength + std::max(offsetL, offsetR), static_cast<int>(HRTFPanner::fftSizeForSampleRate(m_sampleRate)) / 2);
+
+    std::shared_ptr<AudioBus> bus(new AudioBus(Channels::Stereo, length));
+    bus->setSampleRate(m_sampleRate);
+    bus->zero();
+    memcpy(bus->channel(0)->mutableData() + offsetL, left.data(), sizeof(float) * m_filterLength);
+    memcpy(bus->channel(1)->mutableData() + offsetR, right.data(), sizeof(float) * m_filterLength);
+    return bus;
+}
+
+#else
+
+std::shared_ptr<HRTFSofaFile> HRTFSofaFile::open(const std::string & path, float)
+{
+    LOG_ERROR("SOFA file %s could not be read: LabSound was built without LABSOUND_USE_LIBMYSOFA", path.c_str());
+    return nullptr;
+}
+
+HRTFSofaFile::~HRTFSofaFile()
+{
+}
+
+std::shared_ptr<AudioBus> HRTFSofaFile::impulseResponse(int, int)
+{
+    return nullptr;
+}
+
+#endif  // LABSOUND_HAVE_LIBMYSOFA
+
+}  // namespace lab
@@ -0,0 +1,212 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/JitterBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+namespace lab
+{
+
+JitterBuffer::JitterBuffer(int channels, int maxPacketFrames, int renderQuantum, float sampleRate, double minLatency,
+                           double maxLatency)
+    : _channels(std::max(1, channels))
+    , _maxPacketFrames(std::max(1, maxPacketFrames))
+    , _renderQuantum(std::max(1, renderQuantum))
+    , _sampleRate(sampleRate > 0 ? sampleRate : 48000.f)
+    , _minFrames(static_cast<int>(std::max(0.0, minLatency) * _sampleRate))
+    , _maxFrames(std::max(_minFrames, static_cast<int>(std::max(0.0, maxLatency) * _sampleRate)))
+    , _ring(_channels, static_cast<size_t>(_maxFrames + 2 * (_maxPacketFrames + _renderQuantum)))
+    , _last(static_cast<size_t>(_channels) * _maxPacketFrames)
+    , _scratch(static_cast<size_t>(_channels) * _maxPacketFrames)
+    , _sources(_channels)
+    , _targetFrames(std::max(_minFrames, _renderQuantum))
+{
+    for (Slot & slot : _slots)
+        slot.data.resize(static_cast<size_t>(_channels) * _maxPacketFrames);
+}
+
+JitterBuffer::~JitterBuffer() = default;
+
+void JitterBuffer::resync(uint32_t ssrc, uint16_t sequence)
+{
+    for (Slot & slot : _slots)
+        slot.full = false;
+    _started = true;
+    _ssrc = ssrc;
+    _expected = sequence;
+    _newest = sequence;
+    _haveTransit = false;
+    _concealing = false;
+    _lastFrames = 0;
+}
+
+void JitterBuffer::push(uint32_t ssrc, uint16_t sequence, uint32_t timestamp, const float * const * channels, int frames,
+                        double arrivalSeconds)
+{
+    _packetsReceived.fetch_add(1, std::memory_order_relaxed);
+    frames = std::min(frames, _maxPacketFrames);
+    if (frames <= 0)
+        return;
+
+    int distance = static_cast<int16_t>(sequence - _expected);
+    if (!_started || ssrc != _ssrc || distance > Resync || distance < -Resync)
+    {
+        resync(ssrc, sequence);
+        distance = 0;
+    }
+    if (distance < 0)
+    {
+        // given up on already
+        _packetsLate.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // interarrival jitter, as RFC 3550 estimates it; the difference of timestamps is taken
+    // before converting it, so that it survives the timestamp wrapping
+    if (_haveTransit)
+    {
+        const double difference = (arrivalSeconds - _lastArrival) * _sampleRate
+                                   - static_cast<double>(static_cast<int32_t>(timestamp - _lastTimestamp));
+        _jitter += (std::fabs(difference) - _jitter) / 16.0;
+    }
+    _lastArrival = arrivalSeconds;
+    _lastTimestamp = timestamp;
+    _haveTransit = true;
+    _packetFrames = frames;
+    updateTarget();
+
+    // a packet too far ahead to hold means those before it can't be waited for
+    while (distance >= Slots)
+    {
+        advance();
+        distance = static_cast<int16_t>(sequence - _expected);
+    }
+
+    Slot & slot = _slots[sequence % Slots];
+    for (int c = 0; c < _channels; ++c)
+        memcpy(slot.data.data() + static_cast<size_t>(c) * _maxPacketFrames, channels[c], sizeof(float) * frames);
+    slot.frames = frames;
+    slot.full = true;
+    if (static_cast<int16_t>(sequence - _newest) > 0)
+        _newest = sequence;
+
+    // write what is in order, and give up on a missing packet once enough have overtaken it
+    for (;;)
+    {
+        if (_slots[_expected % Slots].full)
+            advance();
+        else if (static_cast<int16_t>(_newest - _expected) >= ReorderDepth)
+            advance();
+        else
+            break;
+    }
+}
+
+void JitterBuffer::advance()
+{
+    Slot & slot = _slots[_expected % Slots];
+    ++_expected;
+    if (slot.full)
+    {
+        slot.full = false;
+        deliver(slot.data.data(), slot.frames);
+        std::swap(_last, slot.data);
+        _lastFrames = slot.frames;
+        _concealing = false;
+        return;
+    }
+
+    // a lost packet plays as the last one fading out, and any further ones as silence
+    _packetsLost.fetch_add(1, std::memory_order_relaxed);
+    const int frames = _packetFrames;
+    if (!_concealing && _lastFrames)
+    {
+        const int faded = std::min(frames, _lastFrames);
+        for (int c = 0; c < _channels; ++c)
+        {
+            float * data = _last.data() + static_cast<size_t>(c) * _maxPacketFrames;
+            for (int i = 0; i < faded; ++i)
+                data[i] *= 1.f - (i + 0.5f) / faded;
+            std::fill(data + faded, data + frames, 0.f);
+        }
+    }
+    else
+        std::fill(_last.begin(), _last.end(), 0.f);
+    _concealing = true;
+    _lastFrames = frames;
+    deliver(_last.data(), frames);
+    std::fill(_last.begin(), _last.end(), 0.f);
+}
+
+void JitterBuffer::deliver(const float * data, int frames)
+{
+    for (int c = 0; c < _channels; ++c)
+        _sources[c] = data + static_cast<size_t>(c) * _maxPacketFrames;
+
+    // more than the target latency, a packet and a quantum of the render thread's reading
+    // is excess; up to half a packet of it is dropped, by crossfading the start of the
+    // packet into the frames that follow the dropped ones
+    const int target = _targetFrames.load(std::memory_order_relaxed);
+    const int fill = static_cast<int>(_ring.capacity() - _ring.availableWrite());
+    const int highWater = target + _packetFrames + _renderQuantum;
+    const int drop = std::min(fill + frames - highWater, frames / 2);
+    if (drop > 0)
+    {
+        for (int c = 0; c < _channels; ++c)
+        {
+            const float * source = _sources[c];
+            float * dest = _scratch.data() + static_cast<size_t>(c) * _maxPacketFrames;
+            for (int i = 0; i < drop; ++i)
+            {
+                const float w = (i + 0.5f) / drop;
+                dest[i] = source[i] * (1.f - w) + source[i + drop] * w;
+            }
+            memcpy(dest + drop, source + 2 * drop, sizeof(float) * (frames - 2 * drop));
+            _sources[c] = dest;
+        }
+        frames -= drop;
+        _droppedFrames.fetch_add(drop, std::memory_order_relaxed);
+    }
+
+    if (!_ring.write(_sources.data(), frames))
+        _droppedFrames.fetch_add(frames, std::memory_order_relaxed);
+}
+
+void JitterBuffer::updateTarget()
+{
+    const int target = _renderQuantum + _packetFrames + static_cast<int>(4.0 * _jitter);
+    _targetFrames.store(std::max(_minFrames, std::min(_maxFrames, target)), std::memory_order_relaxed);
+    _jitterFrames.store(static_cast<float>(_jitter), std::memory_order_relaxed);
+}
+
+int JitterBuffer::pull(float * const * channels, int frames)
+{
+    const size_t available = _ring.availableRead();
+
+    // wait until the target latency has built up, so that the jitter it covers doesn't
+    // run the ring dry again straight away
+    if (!_playing && available >= static_cast<size_t>(_targetFrames.load(std::memory_order_relaxed)))
+        _playing = true;
+
+    int played = 0;
+    if (_playing)
+    {
+        played = static_cast<int>(std::min(available, static_cast<size_t>(frames)));
+        _ring.read(channels, played);
+        if (played < frames)
+        {
+            _underrunFrames.fetch_add(frames - played, std::memory_order_relaxed);
+            _playing = false;
+        }
+    }
+
+    for (int c = 0; c < _channels; ++c)
+        if (channels[c])
+            std::fill(channels[c] + played, channels[c] + frames, 0.f);
+    return played;
+}
+
+}  // namespace lab
@@ -0,0 +1,101 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/LookupTables.h"
+
+namespace lab
+{
+
+namespace
+{
+    // The functions the tables sample, for the compiler to evaluate, by series that
+    // converge to double precision over the ranges they are sampled on
+
+    constexpr double Pi = 3.14159265358979323846;
+    constexpr double Ln2 = 0.69314718055994530942;
+
+    // sin(x), for x in [-pi, pi]
+    constexpr double seriesSin(double x)
+    {
+        if (x > Pi / 2)
+            x = Pi - x;
+        else if (x < -Pi / 2)
+            x = -Pi - x;
+        double term = x;
+        double sum = x;
+        for (int n = 1; n < 12; ++n)
+        {
+            term *= -x * x / ((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // 2^x, for x in [0, 1]
+    constexpr double seriesExp2(double x)
+    {
+        const double y = x * Ln2;
+        double term = 1;
+        double sum = 1;
+        for (int n = 1; n < 20; ++n)
+        {
+            term *= y / n;
+            sum += term;
+        }
+        return sum;
+    }
+
+    // log2(x), for x in [1, 2], as 2 atanh((x - 1) / (x + 1)) / ln 2
+    constexpr double seriesLog2(double x)
+    {
+        const double z = (x - 1) / (x + 1);
+        double power = z;
+        double sum = 0;
+        for (int n = 0; n < 20; ++n)
+        {
+            sum += power / (2 * n + 1);
+            power *= z * z;
+        }
+        return 2 * sum / Ln2;
+    }
+
+    template <int Size>
+    constexpr LookupTables::Table<Size> sineTable()
+    {
+        LookupTables::Table<Size> table {};
+        for (int i = 0; i <= Size; ++i)
+        {
+            // reduced to [-pi, pi] exactly, by the index
+            const int j = i > Size / 2 ? i - Size : i;
+            table.values[i] = static_cast<float>(seriesSin(2 * Pi * j / Size));
+        }
+        return table;
+    }
+
+    template <int Size>
+    constexpr LookupTables::Table<Size> exp2Table()
+    {
+        LookupTables::Table<Size> table {};
+        for (int i = 0; i <= Size; ++i)
+            table.values[i] = static_cast<float>(seriesExp2(static_cast<double>(i) / Size));
+        return table;
+    }
+
+    template <int Size>
+    constexpr LookupTables::Table<Size> log2Table()
+    {
+        LookupTables::Table<Size> table {};
+        for (int i = 0; i <= Size; ++i)
+            table.values[i] = static_cast<float>(seriesLog2(1 + static_cast<double>(i) / Size));
+        return table;
+    }
+}
+
+namespace LookupTables
+{
+    constexpr Table<SineSize> sineTurn = sineTable<SineSize>();
+    constexpr Table<OctaveSize> exp2Octave = exp2Table<OctaveSize>();
+    constexpr Table<OctaveSize> log2Octave = log2Table<OctaveSize>();
+}
+
+}  // namespace lab
@@ -0,0 +1,279 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/LoudnessMeter.h"
+#include "internal/Lanes4.h"
+#include "internal/MixingMatrix.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace lab
+{
+
+namespace
+{
+    // 100 ms blocks; the momentary window is 4 of them, the short term window 30
+    const double BlockSeconds = 0.1;
+    const int MomentaryBlocks = 4;
+    const int ShortTermBlocks = LoudnessMeter::ShortTermBlocks;
+
+    // Gating blocks louder than the absolute gate are counted in a histogram of 0.1 LU
+    // bins, so the integrated loudness needs no more memory the longer it runs.
+    const double AbsoluteGate = -70.0;
+    const double RelativeGate = -10.0;
+    const double HistogramStep = 0.1;
+    const int HistogramBins = LoudnessMeter::HistogramBins;
+
+    // ITU-R BS.1770-4 Annex 2, four phases of a 48 tap interpolating filter
+    const int TruePeakTaps = LoudnessMeter::TruePeakTaps;
+    const float TruePeakFilter[4][TruePeakTaps] = {
+        {0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f, 0.1373291015625f,
+         0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f},
+        {-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f, 0.4650878906250f,
+         0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f},
+        {-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f, 0.7797851562500f,
+         0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f},
+        {-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f, 0.9721679687500f,
+         0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f}};
+
+    const float Silence = -std::numeric_limits<float>::infinity();
+
+    inline float loudness(double meanSquare)
+    {
+        return meanSquare > 0 ? static_cast<float>(-0.691 + 10.0 * std::log10(meanSquare)) : Silence;
+    }
+
+    // The two stages of the K-weighting filter, for any sample rate, as derived from the
+    // 48 kHz coefficients of BS.1770: a high shelf modelling the head, then a high pass.
+    void kWeighting(double sampleRate, LoudnessMeter::Coefficients & shelf, LoudnessMeter::Coefficients & highpass)
+    {
+        {
+            const double f0 = 1681.974450955533;
+            const double G = 3.999843853973347;
+            const double Q = 0.7071752369554196;
+            const double K = std::tan(LAB_PI * f0 / sampleRate);
+            const double Vh = std::pow(10.0, G / 20.0);
+            const double Vb = std::pow(Vh, 0.4996667741545416);
+            const double a0 = 1.0 + K / Q + K * K;
+            shelf.b0 = static_cast<float>((Vh + Vb * K / Q + K * K) / a0);
+            shelf.b1 = static_cast<float>(2.0 * (K * K - Vh) / a0);
+            shelf.b2 = static_cast<float>((Vh - Vb * K / Q + K * K) / a0);
+            shelf.a1 = static_cast<float>(2.0 * (K * K - 1.0) / a0);
+            shelf.a2 = static_cast<float>((1.0 - K / Q + K * K) / a0);
+        }
+        {
+            const double f0 = 38.13547087602444;
+            const double Q = 0.5003270373238773;
+            const double K = std::tan(LAB_PI * f0 / sampleRate);
+            const double a0 = 1.0 + K / Q + K * K;
+            highpass.b0 = 1.f;
+            highpass.b1 = -2.f;
+            highpass.b2 = 1.f;
+            highpass.a1 = static_cast<float>(2.0 * (K * K - 1.0) / a0);
+            highpass.a2 = static_cast<float>((1.0 - K / Q + K * K) / a0);
+        }
+    }
+
+    // One sample through a transposed direct form II biquad, a lane per channel
+    inline Lanes4 biquad(const LoudnessMeter::Coefficients & c, Lanes4 x, Lanes4 & s1, Lanes4 & s2)
+    {
+        const Lanes4 y = Lanes4(c.b0) * x + s1;
+        s1 = Lanes4(c.b1) * x - Lanes4(c.a1) * y + s2;
+        s2 = Lanes4(c.b2) * x - Lanes4(c.a2) * y;
+        return y;
+    }
+}
+
+void LoudnessMeter::configure(float sampleRate_, int channels_, int layout_)
+{
+    if (sampleRate_ != sampleRate)
+    {
+        sampleRate = sampleRate_;
+        kWeighting(sampleRate, shelf, highpass);
+        blockFrames = std::max(1, static_cast<int>(std::lround(sampleRate * BlockSeconds)));
+        resetFilters();
+        resetIntegration();
+    }
+    if (channels_ != channels || layout_ != layout)
+    {
+        channels = channels_;
+        layout = layout_;
+        setWeights();
+        resetFilters();
+    }
+}
+
+// LFE is left out, and the surround channels count for +1.5 dB
+void LoudnessMeter::setWeights()
+{
+    float * w = &weights[0][0];
+    for (int c = 0; c < MaxChannels; ++c)
+        w[c] = c < channels ? 1.f : 0.f;
+
+    int speakers = layout;
+    if (!speakers || MixingMatrix::layoutChannels(speakers) != channels)
+        speakers = MixingMatrix::canonicalLayout(channels);
+    if (!speakers)
+        return;
+
+    const int lfe = MixingMatrix::channelIndex(speakers, Channel::LFE);
+    if (lfe >= 0 && lfe < MaxChannels)
+        w[lfe] = 0.f;
+
+    const Channel surrounds[] = {Channel::SurroundLeft, Channel::SurroundRight, Channel::BackLeft, Channel::BackRight};
+    for (Channel position : surrounds)
+    {
+        const int c = MixingMatrix::channelIndex(speakers, position);
+        if (c >= 0 && c < MaxChannels)
+            w[c] = 1.41f;
+    }
+}
+
+void LoudnessMeter::resetFilters()
+{
+    memset(shelfState, 0, sizeof(shelfState));
+    memset(highpassState, 0, sizeof(highpassState));
+    memset(history, 0, sizeof(history));
+    historyIndex = 0;
+    blockPosition = 0;
+    blockEnergy = 0;
+    memset(blocks, 0, sizeof(blocks));
+}
+
+void LoudnessMeter::resetIntegration()
+{
+    blockCount = 0;
+    memset(peak, 0, sizeof(peak));
+    memset(histogramCount, 0, sizeof(histogramCount));
+    memset(histogramEnergy, 0, sizeof(histogramEnergy));
+}
+
+void LoudnessMeter::run(const AudioBus * bus, int offset, int count)
+{
+    const int groups = (channels + 3) / 4;
+    for (int g = 0; g < groups; ++g)
+    {
+        const float * data[4];
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const int c = g * 4 + lane;
+            data[lane] = c < channels ? bus->channel(c)->data() + offset : nullptr;
+        }
+
+        Lanes4 s1 = Lanes4::load(shelfState[g][0]);
+        Lanes4 s2 = Lanes4::load(shelfState[g][1]);
+        Lanes4 h1 = Lanes4::load(highpassState[g][0]);
+        Lanes4 h2 = Lanes4::load(highpassState[g][1]);
+        Lanes4 groupPeak = Lanes4::load(peak[g]);
+        Lanes4 sum(0.f);
+
+        int index = historyIndex;
+        float frame[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int i = 0; i < count; ++i)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+                if (data[lane])
+                    frame[lane] = data[lane][i];
+            const Lanes4 x = Lanes4::load(frame);
+
+            // the newest frame goes in both copies, after which the history runs
+            // oldest first from index + 1
+            x.store(history[g][index]);
+            x.store(history[g][index + TruePeakTaps]);
+            index = index + 1 == TruePeakTaps ? 0 : index + 1;
+            const float (*taps)[4] = &history[g][index];
+            for (int phase = 0; phase < 4; ++phase)
+            {
+                Lanes4 y(0.f);
+                for (int k = 0; k < TruePeakTaps; ++k)
+                    y = y + Lanes4(TruePeakFilter[phase][TruePeakTaps - 1 - k]) * Lanes4::load(taps[k]);
+                groupPeak = maxOf(groupPeak, absOf(y));
+            }
+
+            const Lanes4 k = biquad(highpass, biquad(shelf, x, s1, s2), h1, h2);
+            sum = sum + k * k;
+        }
+
+        s1.store(shelfState[g][0]);
+        s2.store(shelfState[g][1]);
+        h1.store(highpassState[g][0]);
+        h2.store(highpassState[g][1]);
+        groupPeak.store(peak[g]);
+        blockEnergy += (sum * Lanes4::load(weights[g])).sum();
+    }
+
+    historyIndex = (historyIndex + count) % TruePeakTaps;
+    blockPosition += count;
+}
+
+void LoudnessMeter::finishBlock(float & momentary, float & shortTerm, float & integrated, float & truePeak)
+{
+    blocks[blockCount % ShortTermBlocks] = blockEnergy / blockFrames;
+    ++blockCount;
+    blockEnergy = 0;
+    blockPosition = 0;
+
+    // the windows are taken to have been silent before metering began
+    double momentaryEnergy = 0;
+    double shortTermEnergy = 0;
+    for (int i = 0; i < ShortTermBlocks; ++i)
+    {
+        const double e = blocks[(blockCount - 1 - i) % ShortTermBlocks];
+        shortTermEnergy += e;
+        if (i < MomentaryBlocks)
+            momentaryEnergy += e;
+    }
+    momentaryEnergy /= MomentaryBlocks;
+    shortTermEnergy /= ShortTermBlocks;
+    momentary = loudness(momentaryEnergy);
+    shortTerm = loudness(shortTermEnergy);
+
+    // each 400 ms gating block overlaps the one before by 75%
+    if (blockCount >= MomentaryBlocks && momentary > AbsoluteGate)
+    {
+        const int bin = std::min(HistogramBins - 1, static_cast<int>((momentary - AbsoluteGate) / HistogramStep));
+        ++histogramCount[bin];
+        histogramEnergy[bin] += momentaryEnergy;
+    }
+
+    double energy = 0;
+    uint64_t gated = 0;
+    for (int bin = 0; bin < HistogramBins; ++bin)
+    {
+        energy += histogramEnergy[bin];
+        gated += histogramCount[bin];
+    }
+    integrated = Silence;
+    if (gated)
+    {
+        const double relativeGate = loudness(energy / gated) + RelativeGate;
+        const int first = std::max(0, static_cast<int>(std::ceil((relativeGate - AbsoluteGate) / HistogramStep)));
+        energy = 0;
+        gated = 0;
+        for (int bin = first; bin < HistogramBins; ++bin)
+        {
+            energy += histogramEnergy[bin];
+            gated += histogramCount[bin];
+        }
+        if (gated)
+            integrated = loudness(energy / gated);
+    }
+
+    truePeak = this->truePeak();
+}
+
+float LoudnessMeter::truePeak() const
+{
+    float greatest = 0;
+    for (int c = 0; c < channels; ++c)
+        greatest = std::max(greatest, (&peak[0][0])[c]);
+    return greatest > 0 ? 20.f * std::log10(greatest) : Silence;
+}
+
+}  // namespace lab
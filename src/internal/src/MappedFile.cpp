@@ -0,0 +1,102 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/MappedFile.h"
+
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace lab
+{
+
+MappedFile::~MappedFile()
+{
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+    if (_data)
+        UnmapViewOfFile(_data);
+    if (_mapping)
+        CloseHandle(_mapping);
+    if (_file)
+        CloseHandle(_file);
+#else
+    if (_data)
+        munmap(const_cast<uint8_t *>(_data), _size);
+#endif
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string & path)
+{
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+    mapped->_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || !size.QuadPart)
+        return nullptr;
+
+    mapped->_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped->_mapping)
+        return nullptr;
+
+    mapped->_data = static_cast<const uint8_t *>(MapViewOfFile(mapped->_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped->_data)
+        return nullptr;
+    mapped->_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    void * data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping holds its own reference to the file
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    mapped->_data = static_cast<const uint8_t *>(data);
+    mapped->_size = static_cast<size_t>(st.st_size);
+#endif
+    return mapped;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (!_data || offset >= _size)
+        return;
+    length = std::min(length, _size - offset);
+
+    const size_t page = 4096;
+#if !defined(LABSOUND_PLATFORM_WINDOWS)
+    // the kernel starts reading the whole range at once, rather than a fault at a time
+    const size_t first = offset & ~(page - 1);
+    madvise(const_cast<uint8_t *>(_data) + first, offset + length - first, MADV_WILLNEED);
+#endif
+
+    volatile uint8_t sink = 0;
+    for (size_t i = offset; i < offset + length; i += page)
+        sink = sink + _data[i];
+    sink = sink + _data[offset + length - 1];
+}
+
+}  // namespace lab
@@ -0,0 +1,368 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/MixingMatrix.h"
+#include "internal/Lanes4.h"
+
+#include "LabSound/core/AudioBus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace lab
+{
+
+namespace
+{
+    const int PositionCount = static_cast<int>(Channel::TopBackRight) + 1;
+    const float Half = 0.5f;
+    const float HalfPower = 0.7071067811865476f;  // sqrt(1/2)
+
+    struct Route
+    {
+        Channel position;
+        float gain;
+    };
+
+    // Where a position missing from a layout goes instead: the first alternative
+    // whose positions can all be reached, one or two neighbours at a time. LFE
+    // has no alternatives, and is dropped.
+    struct Alternative
+    {
+        int count;
+        Route routes[2];
+    };
+
+    struct Fallbacks
+    {
+        int count;
+        Alternative alternatives[3];
+    };
+
+    const Fallbacks & fallbacks(Channel position)
+    {
+        static const Fallbacks none = {0, {}};
+        static const Fallbacks table[PositionCount] = {
+            /* Left           */ {1, {{1, {{Channel::Center, HalfPower}}}}},
+            /* Right          */ {1, {{1, {{Channel::Center, HalfPower}}}}},
+            /* Center         */ {1, {{2, {{Channel::Left, HalfPower}, {Channel::Right, HalfPower}}}}},
+            /* LFE            */ {0, {}},
+            /* SurroundLeft   */ {2, {{1, {{Channel::BackLeft, 1.f}}}, {1, {{Channel::Left, HalfPower}}}}},
+            /* SurroundRight  */ {2, {{1, {{Channel::BackRight, 1.f}}}, {1, {{Channel::Right, HalfPower}}}}},
+            /* BackLeft       */ {2, {{1, {{Channel::SurroundLeft, 1.f}}}, {1, {{Channel::Left, HalfPower}}}}},
+            /* BackRight      */ {2, {{1, {{Channel::SurroundRight, 1.f}}}, {1, {{Channel::Right, HalfPower}}}}},
+            /* TopFrontLeft   */ {1, {{1, {{Channel::Left, HalfPower}}}}},
+            /* TopFrontRight  */ {1, {{1, {{Channel::Right, HalfPower}}}}},
+            /* TopBackLeft    */ {2, {{1, {{Channel::SurroundLeft, HalfPower}}}, {1, {{Channel::BackLeft, HalfPower}}}}},
+            /* TopBackRight   */ {2, {{1, {{Channel::SurroundRight, HalfPower}}}, {1, {{Channel::BackRight, HalfPower}}}}},
+        };
+        const int i = static_cast<int>(position);
+        return i >= 0 && i < PositionCount ? table[i] : none;
+    }
+
+    // neighbours of neighbours are as far as a channel is routed
+    const int MaxRouteDepth = 4;
+
+    int indexOf(const std::vector<Channel> & layout, Channel position)
+    {
+        auto it = std::find(layout.begin(), layout.end(), position);
+        return it == layout.end() ? -1 : static_cast<int>(it - layout.begin());
+    }
+
+    bool reachable(const std::vector<Channel> & layout, Channel position, int depth)
+    {
+        if (indexOf(layout, position) >= 0)
+            return true;
+        if (depth == 0)
+            return false;
+
+        const Fallbacks & f = fallbacks(position);
+        for (int a = 0; a < f.count; ++a)
+        {
+            bool all = true;
+            for (int r = 0; r < f.alternatives[a].count && all; ++r)
+                all = reachable(layout, f.alternatives[a].routes[r].position, depth - 1);
+            if (all)
+                return true;
+        }
+        return false;
+    }
+
+    void route(const std::vector<Channel> & layout, Channel position, float gain, int depth, std::vector<float> & gains)
+    {
+        const int index = indexOf(layout, position);
+        if (index >= 0)
+        {
+            gains[index] += gain;
+            return;
+        }
+        if (depth == 0)
+            return;
+
+        const Fallbacks & f = fallbacks(position);
+        for (int a = 0; a < f.count; ++a)
+        {
+            const Alternative & alternative = f.alternatives[a];
+            bool all = true;
+            for (int r = 0; r < alternative.count && all; ++r)
+                all = reachable(layout, alternative.routes[r].position, depth - 1);
+            if (!all)
+                continue;
+
+            for (int r = 0; r < alternative.count; ++r)
+                route(layout, alternative.routes[r].position, gain * alternative.routes[r].gain, depth - 1, gains);
+            return;
+        }
+    }
+
+    bool isLayout(const std::vector<Channel> & layout, std::initializer_list<Channel> positions)
+    {
+        return layout.size() == positions.size() && std::equal(layout.begin(), layout.end(), positions.begin());
+    }
+
+    struct LayoutRegistry
+    {
+        std::mutex registering;
+        std::atomic<int> count {1};  // zero is AudioBus::LayoutCanonical, never a registered layout
+        std::vector<Channel> layouts[MixingMatrix::MaxLayouts];
+        std::atomic<const MixingMatrix *> matrices[MixingMatrix::MaxLayouts][MixingMatrix::MaxLayouts];
+        std::vector<std::unique_ptr<MixingMatrix>> owned;
+
+        LayoutRegistry()
+        {
+            for (auto & row : matrices)
+                for (auto & matrix : row)
+                    matrix.store(nullptr, std::memory_order_relaxed);
+        }
+
+        int add(std::vector<Channel> positions)
+        {
+            std::lock_guard<std::mutex> lock(registering);
+            const int n = count.load(std::memory_order_relaxed);
+            for (int i = 1; i < n; ++i)
+                if (layouts[i] == positions)
+                    return i;
+
+            if (n == MixingMatrix::MaxLayouts)
+                throw std::invalid_argument("Too many speaker layouts have been registered");
+
+            layouts[n] = std::move(positions);
+            for (int i = 1; i <= n; ++i)
+            {
+                owned.emplace_back(new MixingMatrix(layouts[i], layouts[n]));
+                matrices[i][n].store(owned.back().get(), std::memory_order_relaxed);
+                if (i == n)
+                    continue;
+                owned.emplace_back(new MixingMatrix(layouts[n], layouts[i]));
+                matrices[n][i].store(owned.back().get(), std::memory_order_relaxed);
+            }
+
+            // publishes the layout and its matrices together
+            count.store(n + 1, std::memory_order_release);
+            return n;
+        }
+    };
+
+    LayoutRegistry & registry()
+    {
+        static LayoutRegistry * r = []() {
+            LayoutRegistry * built = new LayoutRegistry();
+
+            // in the order of AudioBus's layout ids
+            using C = Channel;
+            built->add({C::Center});
+            built->add({C::Left, C::Right});
+            built->add({C::Left, C::Right, C::SurroundLeft, C::SurroundRight});
+            built->add({C::Left, C::Right, C::Center, C::SurroundLeft, C::SurroundRight});
+            built->add({C::Left, C::Right, C::Center, C::LFE, C::SurroundLeft, C::SurroundRight});
+            built->add({C::Left, C::Right, C::Center, C::LFE, C::SurroundLeft, C::SurroundRight, C::BackLeft, C::BackRight});
+            built->add({C::Left, C::Right, C::Center, C::LFE, C::SurroundLeft, C::SurroundRight, C::BackLeft, C::BackRight,
+                        C::TopFrontLeft, C::TopFrontRight, C::TopBackLeft, C::TopBackRight});
+            return built;
+        }();
+        return *r;
+    }
+
+    // dest = (accumulate ? dest : 0) + sum of sources[i] * gains[i], four frames at a time,
+    // reading and writing each destination frame once however many sources there are
+    void mixChannel(const float * const * sources, const float * gains, int count, float * dest, int frames, bool accumulate)
+    {
+        int i = 0;
+        for (; i + 4 <= frames; i += 4)
+        {
+            Lanes4 sum = accumulate ? Lanes4::load(dest + i) : Lanes4(0.f);
+            for (int s = 0; s < count; ++s)
+                sum = sum + Lanes4::load(sources[s] + i) * Lanes4(gains[s]);
+            sum.store(dest + i);
+        }
+        for (; i < frames; ++i)
+        {
+            float sum = accumulate ? dest[i] : 0.f;
+            for (int s = 0; s < count; ++s)
+                sum += sources[s][i] * gains[s];
+            dest[i] = sum;
+        }
+    }
+}
+
+int MixingMatrix::registerLayout(const Channel * positions, int count)
+{
+    if (!positions || count <= 0 || count > MaxChannels)
+        throw std::invalid_argument("A speaker layout must have at least one channel");
+
+    std::vector<Channel> layout(positions, positions + count);
+    for (int i = 0; i < count; ++i)
+    {
+        const int p = static_cast<int>(layout[i]);
+        if (p < 0 || p >= PositionCount)
+            throw std::invalid_argument("Unknown speaker position in layout");
+        if (std::find(layout.begin(), layout.begin() + i, layout[i]) != layout.begin() + i)
+            throw std::invalid_argument("Speaker position repeated in layout");
+    }
+
+    return registry().add(std::move(layout));
+}
+
+int MixingMatrix::canonicalLayout(int channels)
+{
+    switch (channels)
+    {
+        case Channels::Mono: return AudioBus::LayoutMono;
+        case Channels::Stereo: return AudioBus::LayoutStereo;
+        case Channels::Quad: return AudioBus::LayoutQuad;
+        case Channels::Surround_5_0: return AudioBus::Layout5_0;
+        case Channels::Surround_5_1: return AudioBus::Layout5_1;
+        case Channels::Surround_7_1: return AudioBus::Layout7_1;
+        case Channels::Surround_7_1_4: return AudioBus::Layout7_1_4;
+    }
+    return AudioBus::LayoutCanonical;
+}
+
+int MixingMatrix::layoutChannels(int layout)
+{
+    LayoutRegistry & r = registry();
+    if (layout <= 0 || layout >= r.count.load(std::memory_order_acquire))
+        return 0;
+    return static_cast<int>(r.layouts[layout].size());
+}
+
+int MixingMatrix::channelIndex(int layout, Channel position)
+{
+    LayoutRegistry & r = registry();
+    if (layout <= 0 || layout >= r.count.load(std::memory_order_acquire))
+        return -1;
+    return indexOf(r.layouts[layout], position);
+}
+
+const MixingMatrix * MixingMatrix::find(int sourceLayout, int destinationLayout)
+{
+    LayoutRegistry & r = registry();
+    const int count = r.count.load(std::memory_order_acquire);
+    if (sourceLayout <= 0 || sourceLayout >= count || destinationLayout <= 0 || destinationLayout >= count)
+        return nullptr;
+    return r.matrices[sourceLayout][destinationLayout].load(std::memory_order_relaxed);
+}
+
+MixingMatrix::MixingMatrix(const std::vector<Channel> & source, const std::vector<Channel> & destination)
+{
+    using C = Channel;
+    const int sourceChannels = static_cast<int>(source.size());
+    const int destinationChannels = static_cast<int>(destination.size());
+    std::vector<std::vector<float>> gains(sourceChannels, std::vector<float>(destinationChannels, 0.f));
+
+    const bool monoDestination = isLayout(destination, {C::Center});
+    const bool quadToStereo = isLayout(source, {C::Left, C::Right, C::SurroundLeft, C::SurroundRight}) &&
+                              isLayout(destination, {C::Left, C::Right});
+
+    // the mixes the Web Audio specification gives that routing doesn't arrive at
+    int sourcesWithoutLFE = 0;
+    for (C position : source)
+        if (position != C::LFE)
+            ++sourcesWithoutLFE;
+
+    for (int s = 0; s < sourceChannels; ++s)
+    {
+        const C position = source[s];
+        if (sourceChannels == 1 && indexOf(destination, C::Center) < 0 &&
+            indexOf(destination, C::Left) >= 0 && indexOf(destination, C::Right) >= 0)
+        {
+            // mono is copied to left and right at full level
+            gains[s][indexOf(destination, C::Left)] = 1.f;
+            gains[s][indexOf(destination, C::Right)] = 1.f;
+        }
+        else if (monoDestination && indexOf(source, C::Center) < 0)
+        {
+            // a layout without a center averages into mono
+            if (position != C::LFE)
+                gains[s][0] = 1.f / static_cast<float>(sourcesWithoutLFE);
+        }
+        else if (quadToStereo)
+        {
+            gains[s][indexOf(destination, (position == C::Left || position == C::SurroundLeft) ? C::Left : C::Right)] = Half;
+        }
+        else
+            route(destination, position, 1.f, MaxRouteDepth, gains[s]);
+    }
+
+    m_terms.resize(destinationChannels);
+    for (int d = 0; d < destinationChannels; ++d)
+        for (int s = 0; s < sourceChannels; ++s)
+            if (gains[s][d] != 0.f)
+                m_terms[d].push_back({s, gains[s][d]});
+}
+
+void MixingMatrix::copy(const AudioBus & source, AudioBus & destination) const
+{
+    mix(source, destination, false);
+}
+
+void MixingMatrix::sum(const AudioBus & source, AudioBus & destination) const
+{
+    mix(source, destination, true);
+}
+
+void MixingMatrix::mix(const AudioBus & source, AudioBus & destination, bool accumulate) const
+{
+    const int frames = destination.length();
+    const float * sources[MaxChannels];
+    float gains[MaxChannels];
+
+    for (int d = 0; d < static_cast<int>(m_terms.size()); ++d)
+    {
+        AudioChannel * channel = destination.channel(d);
+
+        // silent sources contribute nothing
+        int count = 0;
+        for (const Term & term : m_terms[d])
+        {
+            const AudioChannel * from = source.channel(term.source);
+            if (from->isSilent())
+                continue;
+            sources[count] = from->data();
+            gains[count] = term.gain;
+            ++count;
+        }
+
+        if (!count)
+        {
+            if (!accumulate)
+                channel->zero();
+            continue;
+        }
+
+        const bool add = accumulate && !channel->isSilent();
+        if (count == 1 && gains[0] == 1.f && !add)
+        {
+            memcpy(channel->mutableData(), sources[0], sizeof(float) * frames);
+            continue;
+        }
+
+        mixChannel(sources, gains, count, channel->mutableData(), frames, add);
+    }
+}
+
+}  // namespace lab
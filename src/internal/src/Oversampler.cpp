@@ -0,0 +1,250 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/Oversampler.h"
+#include "LabSound/core/Macros.h"
+#include "internal/Assertions.h"
+#include "internal/Lanes4.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    // The half taps and Kaiser window beta of a half band stage
+    struct HalfBandDesign
+    {
+        int halfTaps;
+        double beta;
+    };
+
+    // The first octave's stage, then the stage for each octave after it
+    const HalfBandDesign s_designs[3][2] = {
+        {{8, 5.0}, {3, 4.5}},     // Low
+        {{16, 10.0}, {4, 7.0}},   // Medium
+        {{32, 10.0}, {6, 10.0}},  // High
+    };
+
+    HalfBandDesign designFor(OverSampleQuality quality, int octave)
+    {
+        return s_designs[static_cast<int>(quality)][octave > 0 ? 1 : 0];
+    }
+
+    // The zeroth order modified Bessel function of the first kind
+    double besselI0(double x)
+    {
+        double sum = 1;
+        double term = 1;
+        for (int k = 1; term > 1e-12 * sum; ++k)
+        {
+            const double t = x / (2 * k);
+            term *= t * t;
+            sum += term;
+        }
+        return sum;
+    }
+}
+
+// A half band filter has a centre tap of one half, and every other tap beside it is zero,
+// so with K half taps it is 4K - 1 long and only the K coefficients g[m], at offsets
+// +/-(2m + 1) from the centre, are needed. The buffers keep the last 2K - 1 frames of input
+// in front of the block being filtered, so all reads are forward and contiguous.
+class Oversampler::HalfBand
+{
+public:
+    explicit HalfBand(const HalfBandDesign & design)
+        : m_halfTaps(design.halfTaps)
+        , m_history(2 * design.halfTaps - 1)
+        , m_coefficients(design.halfTaps)
+    {
+        // windowed sinc, normalised so that the taps sum to one
+        const double windowScale = 1.0 / besselI0(design.beta);
+        double sum = 0;
+        for (int m = 0; m < m_halfTaps; ++m)
+        {
+            const double offset = 2 * m + 1;
+            const double t = offset / (2 * m_halfTaps);
+            const double window = besselI0(design.beta * std::sqrt(1 - t * t)) * windowScale;
+            const double sinc = ((m & 1) ? -1 : 1) / (LAB_PI * offset);
+            m_coefficients[m] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+        const float scale = static_cast<float>(0.25 / sum);
+        for (float & g : m_coefficients)
+            g *= scale;
+
+        reset();
+    }
+
+    void reset()
+    {
+        m_input.assign(m_history, 0.f);
+        m_even.assign(m_history, 0.f);
+        m_odd.assign(m_history, 0.f);
+    }
+
+    // Doubles the rate of framesToProcess frames of source into destination
+    void up(const float * source, float * destination, int framesToProcess)
+    {
+        m_input.resize(m_history + framesToProcess);
+        memcpy(m_input.data() + m_history, source, sizeof(float) * framesToProcess);
+
+        // the even output frames lie half way between input frames, and the odd are input
+        // frames, delayed by the centre tap
+        const float * input = m_input.data() + m_halfTaps;
+        const float * g = m_coefficients.data();
+        const int K = m_halfTaps;
+
+        int j = 0;
+        for (; j + 4 <= framesToProcess; j += 4)
+        {
+            Lanes4 sum(0.f);
+            for (int m = 0; m < K; ++m)
+                sum = sum + Lanes4(g[m]) * (Lanes4::load(input + j + m) + Lanes4::load(input + j - 1 - m));
+
+            float even[4];
+            (sum * Lanes4(2.f)).store(even);
+            for (int i = 0; i < 4; ++i)
+            {
+                destination[2 * (j + i)] = even[i];
+                destination[2 * (j + i) + 1] = input[j + i];
+            }
+        }
+        for (; j < framesToProcess; ++j)
+        {
+            float sum = 0;
+            for (int m = 0; m < K; ++m)
+                sum += g[m] * (input[j + m] + input[j - 1 - m]);
+            destination[2 * j] = 2.f * sum;
+            destination[2 * j + 1] = input[j];
+        }
+
+        memmove(m_input.data(), m_input.data() + framesToProcess, sizeof(float) * m_history);
+    }
+
+    // Halves the rate of 2 * framesToProcess frames of source into destination
+    void down(const float * source, float * destination, int framesToProcess)
+    {
+        m_even.resize(m_history + framesToProcess);
+        m_odd.resize(m_history + framesToProcess);
+        float * even = m_even.data() + m_history;
+        float * odd = m_odd.data() + m_history;
+        for (int i = 0; i < framesToProcess; ++i)
+        {
+            even[i] = source[2 * i];
+            odd[i] = source[2 * i + 1];
+        }
+
+        // only the frames that survive decimation are filtered; the odd phase meets the
+        // centre tap alone
+        const float * e = m_even.data() + m_halfTaps;
+        const float * o = m_odd.data() + m_halfTaps - 1;
+        const float * g = m_coefficients.data();
+        const int K = m_halfTaps;
+
+        int j = 0;
+        for (; j + 4 <= framesToProcess; j += 4)
+        {
+            Lanes4 sum = Lanes4(0.5f) * Lanes4::load(o + j);
+            for (int m = 0; m < K; ++m)
+                sum = sum + Lanes4(g[m]) * (Lanes4::load(e + j + m) + Lanes4::load(e + j - 1 - m));
+            sum.store(destination + j);
+        }
+        for (; j < framesToProcess; ++j)
+        {
+            float sum = 0.5f * o[j];
+            for (int m = 0; m < K; ++m)
+                sum += g[m] * (e[j + m] + e[j - 1 - m]);
+            destination[j] = sum;
+        }
+
+        memmove(m_even.data(), m_even.data() + framesToProcess, sizeof(float) * m_history);
+        memmove(m_odd.data(), m_odd.data() + framesToProcess, sizeof(float) * m_history);
+    }
+
+private:
+    int m_halfTaps;
+    int m_history;
+    std::vector<float> m_coefficients;
+    std::vector<float> m_input;
+    std::vector<float> m_even;
+    std::vector<float> m_odd;
+};
+
+Oversampler::Oversampler(OverSampleType type, OverSampleQuality quality)
+    : m_type(type)
+    , m_quality(quality)
+{
+    ASSERT(type >= OverSampleType::NONE && type < OverSampleType::_OverSampleTypeCount);
+
+    const int octaves = static_cast<int>(type);
+    for (int octave = 0; octave < octaves; ++octave)
+        m_stages.emplace_back(new HalfBand(designFor(quality, octave)));
+
+    // without oversampling there is still a buffer for the shaper to work in
+    m_octaves.resize(octaves > 0 ? octaves : 1);
+}
+
+Oversampler::~Oversampler() = default;
+
+float * Oversampler::upsample(const float * source, int framesToProcess)
+{
+    if (m_stages.empty())
+    {
+        m_octaves[0].resize(framesToProcess);
+        memcpy(m_octaves[0].data(), source, sizeof(float) * framesToProcess);
+        return m_octaves[0].data();
+    }
+
+    const float * input = source;
+    int frames = framesToProcess;
+    for (size_t octave = 0; octave < m_stages.size(); ++octave)
+    {
+        std::vector<float> & buffer = m_octaves[octave];
+        buffer.resize(2 * frames);
+        m_stages[octave]->up(input, buffer.data(), frames);
+        input = buffer.data();
+        frames *= 2;
+    }
+    return m_octaves.back().data();
+}
+
+void Oversampler::downsample(float * destination, int framesToProcess)
+{
+    if (m_stages.empty())
+    {
+        memcpy(destination, m_octaves[0].data(), sizeof(float) * framesToProcess);
+        return;
+    }
+
+    for (int octave = static_cast<int>(m_stages.size()) - 1; octave >= 0; --octave)
+    {
+        const int frames = framesToProcess << octave;
+        float * output = octave > 0 ? m_octaves[octave - 1].data() : destination;
+        m_stages[octave]->down(m_octaves[octave].data(), output, frames);
+    }
+}
+
+void Oversampler::reset()
+{
+    for (auto & stage : m_stages)
+        stage->reset();
+}
+
+double Oversampler::latencyFrames(OverSampleType type, OverSampleQuality quality)
+{
+    // each stage delays by its centre tap, 2K - 1 frames at its upper rate, going up and
+    // again coming down
+    double frames = 0;
+    for (int octave = 0; octave < static_cast<int>(type); ++octave)
+    {
+        const int history = 2 * designFor(quality, octave).halfTaps - 1;
+        frames += 2.0 * history / (2 << octave);
+    }
+    return frames;
+}
+
+}  // namespace lab
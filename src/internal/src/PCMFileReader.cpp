@@ -0,0 +1,166 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/PCMFileReader.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER)
+// suppress warnings about fopen
+#pragma warning(disable : 4996)
+#endif
+
+namespace lab
+{
+
+namespace
+{
+    const uint16_t WaveFormatPCM = 1;
+    const uint16_t WaveFormatIEEEFloat = 3;
+    const uint16_t WaveFormatExtensible = 0xFFFE;
+
+    uint16_t readU16(const uint8_t * p) { return uint16_t(p[0] | (p[1] << 8)); }
+    uint32_t readU32(const uint8_t * p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24); }
+    uint64_t readU64(const uint8_t * p) { return uint64_t(readU32(p)) | (uint64_t(readU32(p + 4)) << 32); }
+
+    bool seekTo(FILE * file, uint64_t offset)
+    {
+#if defined(_MSC_VER)
+        return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+}
+
+PCMFileReader::~PCMFileReader()
+{
+    close();
+}
+
+void PCMFileReader::close()
+{
+    if (m_file)
+        fclose(m_file);
+    m_file = nullptr;
+    m_channels = 0;
+    m_sampleRate = 0;
+    m_frames = 0;
+}
+
+bool PCMFileReader::open(const std::string & path)
+{
+    close();
+
+    FILE * file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    uint8_t riff[12];
+    if (fread(riff, 1, 12, file) != 12 || (memcmp(riff, "RIFF", 4) && memcmp(riff, "RF64", 4)) || memcmp(riff + 8, "WAVE", 4))
+    {
+        fclose(file);
+        return false;
+    }
+
+    // walk the chunks for the format and the data
+    bool haveFormat = false;
+    uint16_t formatTag = 0;
+    uint16_t channels = 0;
+    uint32_t sampleRate = 0;
+    uint16_t bitsPerSample = 0;
+    uint64_t dataSize64 = 0;  // from an RF64 file's ds64 chunk
+    uint64_t offset = 12;
+    for (;;)
+    {
+        uint8_t header[8];
+        if (!seekTo(file, offset) || fread(header, 1, 8, file) != 8)
+            break;
+
+        uint64_t size = readU32(header + 4);
+        if (!memcmp(header, "ds64", 4))
+        {
+            uint8_t ds64[16];
+            if (size < sizeof(ds64) || fread(ds64, 1, sizeof(ds64), file) != sizeof(ds64))
+                break;
+            dataSize64 = readU64(ds64 + 8);
+        }
+        else if (!memcmp(header, "fmt ", 4))
+        {
+            uint8_t fmt[40] = {};
+            const size_t n = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (n < 16 || fread(fmt, 1, n, file) != n)
+                break;
+
+            formatTag = readU16(fmt);
+            channels = readU16(fmt + 2);
+            sampleRate = readU32(fmt + 4);
+            bitsPerSample = readU16(fmt + 14);
+            if (formatTag == WaveFormatExtensible && n >= 26)
+                formatTag = readU16(fmt + 24);  // the first two bytes of the sub format GUID
+            haveFormat = true;
+        }
+        else if (!memcmp(header, "data", 4))
+        {
+            if (!haveFormat)
+                break;
+            if (size == 0xFFFFFFFFu && dataSize64)
+                size = dataSize64;
+
+            if (formatTag == WaveFormatPCM && bitsPerSample == 16)
+                m_format = SampleConversion::SampleFormat::Int16;
+            else if (formatTag == WaveFormatPCM && bitsPerSample == 24)
+                m_format = SampleConversion::SampleFormat::Int24;
+            else if (formatTag == WaveFormatIEEEFloat && bitsPerSample == 32)
+                m_format = SampleConversion::SampleFormat::Float32;
+            else
+                break;
+
+            if (!channels || !sampleRate)
+                break;
+
+            m_file = file;
+            m_channels = channels;
+            m_sampleRate = static_cast<float>(sampleRate);
+            m_frameBytes = channels * SampleConversion::bytesPerSample(m_format);
+            m_dataOffset = offset + 8;
+            m_frames = size / m_frameBytes;
+            return true;
+        }
+
+        // chunks are padded to an even size
+        offset += 8 + size + (size & 1);
+    }
+
+    fclose(file);
+    return false;
+}
+
+int PCMFileReader::read(uint64_t frame, int count, float * const * channels)
+{
+    if (!m_file || frame >= m_frames || count <= 0)
+        return 0;
+
+    if (frame + count > m_frames)
+        count = static_cast<int>(m_frames - frame);
+
+    m_scratch.resize(size_t(count) * m_frameBytes);
+    if (!seekTo(m_file, m_dataOffset + frame * m_frameBytes))
+        return 0;
+    count = static_cast<int>(fread(m_scratch.data(), m_frameBytes, count, m_file));
+
+    if (m_format == SampleConversion::SampleFormat::Float32)
+    {
+        // float files may exceed full scale, so they aren't clipped as device buffers are
+        const float * s = reinterpret_cast<const float *>(m_scratch.data());
+        for (int i = 0; i < count; ++i)
+            for (int c = 0; c < m_channels; ++c)
+                channels[c][i] = *s++;
+    }
+    else
+        SampleConversion::deinterleave(m_scratch.data(), m_format, m_channels, count, channels);
+
+    return count;
+}
+
+}  // namespace lab
@@ -0,0 +1,188 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/PCMFileWriter.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER)
+// suppress warnings about fopen
+#pragma warning(disable : 4996)
+#endif
+
+namespace lab
+{
+
+namespace
+{
+    const uint16_t WaveFormatPCM = 1;
+    const uint16_t WaveFormatIEEEFloat = 3;
+
+    // RIFF, JUNK or ds64, fmt and the data chunk's header
+    const int HeaderBytes = 80;
+    const uint32_t JunkBytes = 28;
+
+    void writeU16(uint8_t * p, uint16_t v)
+    {
+        p[0] = uint8_t(v);
+        p[1] = uint8_t(v >> 8);
+    }
+
+    void writeU32(uint8_t * p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = uint8_t(v >> (8 * i));
+    }
+
+    void writeU64(uint8_t * p, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            p[i] = uint8_t(v >> (8 * i));
+    }
+
+    bool seekTo(FILE * file, uint64_t offset, int origin)
+    {
+#if defined(_MSC_VER)
+        return _fseeki64(file, static_cast<__int64>(offset), origin) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+    }
+}
+
+PCMFileWriter::~PCMFileWriter()
+{
+    close();
+}
+
+bool PCMFileWriter::open(const std::string & path, int channels, float sampleRate, SampleConversion::SampleFormat format, bool raw)
+{
+    close();
+    if (channels <= 0 || sampleRate <= 0)
+        return false;
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    m_channels = channels;
+    m_sampleRate = static_cast<uint32_t>(sampleRate);
+    m_format = format;
+    m_raw = raw;
+    m_failed = false;
+    m_frames = 0;
+
+    // the header is written empty, and kept up to date as the data follows it
+    if (!m_raw && !updateHeader())
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool PCMFileWriter::setChannelCount(int channels)
+{
+    if (!m_file || m_frames || channels <= 0)
+        return false;
+
+    m_channels = channels;
+    return m_raw || updateHeader();
+}
+
+bool PCMFileWriter::write(const float * interleaved, int frames)
+{
+    if (!m_file || frames <= 0)
+        return m_file != nullptr;
+
+    const size_t samples = size_t(frames) * m_channels;
+    size_t written;
+    if (m_format == SampleConversion::SampleFormat::Float32)
+    {
+        // float recordings may exceed full scale, so they aren't clipped as integers are
+        written = fwrite(interleaved, sizeof(float), samples, m_file);
+    }
+    else
+    {
+        // interleaved frames convert as a single channel of all their samples
+        const int bytes = SampleConversion::bytesPerSample(m_format);
+        m_scratch.resize(samples * bytes);
+        SampleConversion::interleave(&interleaved, 1, static_cast<int>(samples), m_format, m_scratch.data());
+        written = fwrite(m_scratch.data(), bytes, samples, m_file);
+    }
+
+    if (written != samples)
+        m_failed = true;
+    m_frames += written / m_channels;
+    return !m_failed;
+}
+
+bool PCMFileWriter::updateHeader()
+{
+    if (!m_file)
+        return false;
+    if (m_raw)
+        return !m_failed;
+
+    const int bytesPerSample = SampleConversion::bytesPerSample(m_format);
+    const uint64_t dataBytes = m_frames * m_channels * bytesPerSample;
+    const uint64_t riffBytes = HeaderBytes - 8 + dataBytes + (dataBytes & 1);
+    const bool rf64 = riffBytes > 0xFFFFFFFFull;
+
+    uint8_t header[HeaderBytes] = {};
+    memcpy(header, rf64 ? "RF64" : "RIFF", 4);
+    writeU32(header + 4, rf64 ? 0xFFFFFFFFu : uint32_t(riffBytes));
+    memcpy(header + 8, "WAVE", 4);
+
+    memcpy(header + 12, rf64 ? "ds64" : "JUNK", 4);
+    writeU32(header + 16, JunkBytes);
+    if (rf64)
+    {
+        writeU64(header + 20, riffBytes);
+        writeU64(header + 28, dataBytes);
+        writeU64(header + 36, m_frames);
+    }
+
+    memcpy(header + 48, "fmt ", 4);
+    writeU32(header + 52, 16);
+    writeU16(header + 56, m_format == SampleConversion::SampleFormat::Float32 ? WaveFormatIEEEFloat : WaveFormatPCM);
+    writeU16(header + 58, uint16_t(m_channels));
+    writeU32(header + 60, m_sampleRate);
+    writeU32(header + 64, m_sampleRate * m_channels * bytesPerSample);
+    writeU16(header + 68, uint16_t(m_channels * bytesPerSample));
+    writeU16(header + 70, uint16_t(8 * bytesPerSample));
+
+    memcpy(header + 72, "data", 4);
+    writeU32(header + 76, rf64 ? 0xFFFFFFFFu : uint32_t(dataBytes));
+
+    if (!seekTo(m_file, 0, SEEK_SET) || fwrite(header, 1, HeaderBytes, m_file) != HeaderBytes || !seekTo(m_file, 0, SEEK_END))
+        m_failed = true;
+    return !m_failed;
+}
+
+bool PCMFileWriter::close()
+{
+    if (!m_file)
+        return false;
+
+    if (!m_raw)
+    {
+        // chunks are padded to an even size
+        const uint64_t dataBytes = m_frames * m_channels * SampleConversion::bytesPerSample(m_format);
+        if (dataBytes & 1)
+        {
+            const uint8_t pad = 0;
+            if (fwrite(&pad, 1, 1, m_file) != 1)
+                m_failed = true;
+        }
+        updateHeader();
+    }
+
+    if (fclose(m_file) != 0)
+        m_failed = true;
+    m_file = nullptr;
+    return !m_failed;
+}
+
+}  // namespace lab
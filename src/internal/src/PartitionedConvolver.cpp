@@ -0,0 +1,819 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/PartitionedConvolver.h"
+#include "internal/Assertions.h"
+#include "internal/DenormalDisabler.h"
+
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <string.h>
+
+namespace lab
+{
+
+// Frames of the impulse response applied in the time domain, and so also the
+// size of the smallest partition.
+static const int HeadSize = 128;
+
+// A partition of the response with less than this share of its energy, -120 dB, is skipped
+static const float SilentPartitionEnergy = 1.e-12f;
+
+// The impulse response, without its head, transformed partition by partition.
+struct PartitionedConvolver::Partitions
+{
+    struct Group
+    {
+        int offset;            // where the group's first partition starts in the impulse response
+        int partitionSize;
+        int partitionCount;
+        int spectrumSize;      // of the FFT of twice the partition size
+        AudioFloatArray spectra;  // real then imaginary values, partition by partition
+
+        // in half precision, the spectra are kept here instead, with a scale per partition
+        std::vector<uint16_t> halfSpectra;
+        std::vector<float> scales;
+
+        // partitions with too little of the response's energy to hear are skipped
+        std::vector<uint8_t> silent;
+
+        Group(int offset, int partitionSize, int partitionCount, int spectrumSize, Precision precision)
+            : offset(offset), partitionSize(partitionSize), partitionCount(partitionCount)
+            , spectrumSize(spectrumSize)
+            , spectra(precision == Precision::Float ? 2 * spectrumSize * partitionCount : 0)
+            , halfSpectra(precision == Precision::Half ? 2 * spectrumSize * partitionCount : 0)
+            , scales(precision == Precision::Half ? partitionCount : 0)
+            , silent(partitionCount, 0) {}
+
+        bool isHalf() const { return !halfSpectra.empty(); }
+
+        float * real(int partition) { return spectra.data() + 2 * spectrumSize * partition; }
+        float * imag(int partition) { return real(partition) + spectrumSize; }
+        const float * real(int partition) const { return spectra.data() + 2 * spectrumSize * partition; }
+        const float * imag(int partition) const { return real(partition) + spectrumSize; }
+        uint16_t * halfReal(int partition) { return halfSpectra.data() + 2 * spectrumSize * partition; }
+        uint16_t * halfImag(int partition) { return halfReal(partition) + spectrumSize; }
+        const uint16_t * halfReal(int partition) const { return halfSpectra.data() + 2 * spectrumSize * partition; }
+        const uint16_t * halfImag(int partition) const { return halfReal(partition) + spectrumSize; }
+    };
+
+    std::vector<std::unique_ptr<Group>> groups;
+
+    // Returns the partitions of an impulse response whose first partition is
+    // firstPartitionSize frames. Convolvers of the same response share one set, so the
+    // response is only transformed again once every convolver using it has gone.
+    static std::shared_ptr<const Partitions> find(const float * impulseResponse, int impulseLength, int firstPartitionSize,
+                                                  Precision precision);
+
+private:
+    static std::shared_ptr<const Partitions> create(const float * impulseResponse, int impulseLength, int firstPartitionSize,
+                                                    Precision precision);
+
+    struct Key
+    {
+        uint64_t hash;
+        int impulseLength;
+        int firstPartitionSize;  // which, with the length, determines the layout of the groups
+        Precision precision;
+
+        bool operator<(const Key & rhs) const
+        {
+            if (hash != rhs.hash) return hash < rhs.hash;
+            if (impulseLength != rhs.impulseLength) return impulseLength < rhs.impulseLength;
+            if (firstPartitionSize != rhs.firstPartitionSize) return firstPartitionSize < rhs.firstPartitionSize;
+            return precision < rhs.precision;
+        }
+    };
+};
+
+// A hash of the bits of every sample, to recognize a response that has been transformed already
+static uint64_t hashImpulse(const float * impulseResponse, int impulseLength)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ static_cast<uint64_t>(impulseLength);
+    for (int i = 0; i < impulseLength; ++i)
+    {
+        uint32_t bits;
+        memcpy(&bits, impulseResponse + i, sizeof(bits));
+        hash ^= bits;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+// Applies one group of partitions. Input is gathered until a whole partition has
+// arrived, then convolved with every partition in the group at once; the result is
+// played out over the time it takes for the next partition of input to arrive.
+//
+// A group's result can therefore only begin a partition's length after the input
+// it depends on, which is why a group may not start earlier in the impulse response
+// than its own partition size. If it starts later, its input spectra are delayed by
+// the difference before being applied.
+//
+// With several responses, the stage has the same group of each, and the input spectra
+// are shared between them; a response left out of the mask is skipped, and its result
+// is silent.
+//
+// A batched stage has a frame per response to sum its products in, so that they can be
+// left to a batch, and the results inverse transformed once the batch has computed them.
+struct PartitionedConvolver::Stage
+{
+    std::vector<const Partitions::Group *> groups;  // one per response, all laid out alike
+    const Partitions::Group & group;
+    FFTFrame frame;
+    AudioFloatArray input;    // the previous and the current partition of input
+    AudioFloatArray output;   // the results being played out, response by response
+    AudioFloatArray scratch;
+    AudioFloatArray inputSpectra;  // a ring of the most recent input spectra
+    std::vector<uint8_t> silentInput;  // which of the ring's spectra are of silence, and so not computed
+    int delay;                // partitions of input before the group's first partition applies
+    int spectrumCount;
+    int newestSpectrum = 0;
+    int filled = 0;           // frames of the current partition of input received
+    std::vector<std::unique_ptr<FFTFrame>> sums;  // when batched, one per response
+    std::vector<uint8_t> audible;                 // which of the sums the batch is computing
+
+    // latency is how many partitions after its input the result may be played, in addition
+    // to the one partition it takes for the input to arrive
+    Stage(const std::vector<const Partitions::Group *> & groups, int latency, bool batched = false)
+        : groups(groups)
+        , group(*groups.front())
+        , frame(2 * group.partitionSize)
+        , input(2 * group.partitionSize)
+        , output(group.partitionSize * groups.size())
+        , scratch(2 * group.partitionSize)
+        , delay(group.offset / group.partitionSize - 1 - latency)
+        , spectrumCount(delay + group.partitionCount)
+    {
+        ASSERT(delay >= 0);
+        inputSpectra.allocate(2 * group.spectrumSize * spectrumCount);
+        silentInput.resize(spectrumCount);
+        if (batched)
+        {
+            for (size_t r = 0; r < groups.size(); ++r)
+                sums.emplace_back(new FFTFrame(2 * group.partitionSize));
+            audible.resize(groups.size());
+        }
+        reset();
+    }
+
+    int responseCount() const { return static_cast<int>(groups.size()); }
+
+    void reset()
+    {
+        input.zero();
+        output.zero();
+        inputSpectra.zero();
+        std::fill(silentInput.begin(), silentInput.end(), 1);
+        newestSpectrum = 0;
+        filled = 0;
+    }
+
+    // adds each response's result for the next framesToProcess frames to its destination
+    void process(const float * sourceP, float * const * destP, uint32_t mask, int framesToProcess,
+                 ConvolutionBatch * batch = nullptr)
+    {
+        const int partitionSize = group.partitionSize;
+        int done = 0;
+        while (done < framesToProcess)
+        {
+            const int frames = std::min(framesToProcess - done, partitionSize - filled);
+            memcpy(input.data() + partitionSize + filled, sourceP + done, sizeof(float) * frames);
+            for (int r = 0; r < responseCount(); ++r)
+            {
+                if (mask & (1u << r))
+                {
+                    const float * result = output.data() + r * partitionSize + filled;
+                    VectorMath::vadd(destP[r] + done, 1, result, 1, destP[r] + done, 1, frames);
+                }
+            }
+
+            filled += frames;
+            done += frames;
+
+            if (filled == partitionSize)
+            {
+                if (batch && !sums.empty())
+                {
+                    transformInput();
+                    batch->defer(this, mask);
+                }
+                else
+                    convolve(mask);
+            }
+        }
+    }
+
+    // takes in a completed partition of input
+    void transformInput()
+    {
+        const int partitionSize = group.partitionSize;
+        const int spectrumSize = group.spectrumSize;
+
+        // silent input isn't transformed, and the products with it are skipped, as are
+        // those with silent partitions of the response
+        float peak = 0.f;
+        VectorMath::vmaxmgv(input.data(), 1, &peak, 2 * partitionSize);
+        newestSpectrum = (newestSpectrum + 1) % spectrumCount;
+        silentInput[newestSpectrum] = peak == 0.f;
+        if (peak != 0.f)
+        {
+            frame.computeForwardFFT(input.data());
+            float * newest = inputSpectra.data() + 2 * spectrumSize * newestSpectrum;
+            memcpy(newest, frame.realData(), sizeof(float) * spectrumSize);
+            memcpy(newest + spectrumSize, frame.imagData(), sizeof(float) * spectrumSize);
+        }
+        memcpy(input.data(), input.data() + partitionSize, sizeof(float) * partitionSize);
+        filled = 0;
+    }
+
+    void convolve(uint32_t mask)
+    {
+        const int partitionSize = group.partitionSize;
+        const int spectrumSize = group.spectrumSize;
+        transformInput();
+
+        for (int r = 0; r < responseCount(); ++r)
+        {
+            float * result = output.data() + r * partitionSize;
+            bool audible = false;
+            if (mask & (1u << r))
+            {
+                // the first partition applies to the input from delay partitions ago, the next to
+                // the input before that, and so on
+                const Partitions::Group & response = *groups[r];
+                for (int i = 0; i < group.partitionCount; ++i)
+                {
+                    const int age = delay + i;
+                    const int index = (newestSpectrum - age + spectrumCount) % spectrumCount;
+                    if (silentInput[index] || response.silent[i])
+                        continue;
+
+                    if (!audible)
+                    {
+                        frame.zero();
+                        audible = true;
+                    }
+                    const float * spectrum = inputSpectra.data() + 2 * spectrumSize * index;
+                    if (response.isHalf())
+                        frame.multiplyAccumulate(spectrum, spectrum + spectrumSize, response.halfReal(i), response.halfImag(i), response.scales[i]);
+                    else
+                        frame.multiplyAccumulate(spectrum, spectrum + spectrumSize, response.real(i), response.imag(i));
+                }
+            }
+
+            if (!audible)
+            {
+                memset(result, 0, sizeof(float) * partitionSize);
+                continue;
+            }
+
+            // overlap-save: the second half of the inverse holds the linear convolution
+            frame.computeInverseFFT(scratch.data());
+            memcpy(result, scratch.data() + partitionSize, sizeof(float) * partitionSize);
+        }
+    }
+
+    // Appends the products of the newest input's convolution to a batch, as convolve()
+    // would sum them, with an accumulation for each response that has any.
+    void gather(uint32_t mask, std::vector<ConvolutionBatch::Accumulation> & accumulations,
+                std::vector<ConvolutionBatch::Product> & products)
+    {
+        const int spectrumSize = group.spectrumSize;
+        for (int r = 0; r < responseCount(); ++r)
+        {
+            audible[r] = 0;
+            if (!(mask & (1u << r)))
+                continue;
+
+            const Partitions::Group & response = *groups[r];
+            const int first = static_cast<int>(products.size());
+            for (int i = 0; i < group.partitionCount; ++i)
+            {
+                const int age = delay + i;
+                const int index = (newestSpectrum - age + spectrumCount) % spectrumCount;
+                if (silentInput[index] || response.silent[i])
+                    continue;
+
+                ConvolutionBatch::Product product;
+                product.inputReal = inputSpectra.data() + 2 * spectrumSize * index;
+                product.inputImag = product.inputReal + spectrumSize;
+                if (response.isHalf())
+                {
+                    product.halfReal = response.halfReal(i);
+                    product.halfImag = response.halfImag(i);
+                    product.scale = response.scales[i];
+                }
+                else
+                {
+                    product.real = response.real(i);
+                    product.imag = response.imag(i);
+                }
+                products.push_back(product);
+            }
+
+            const int count = static_cast<int>(products.size()) - first;
+            if (count)
+            {
+                sums[r]->zero();
+                accumulations.push_back({sums[r].get(), first, count});
+                audible[r] = 1;
+            }
+        }
+    }
+
+    // takes up the sums the batch computed
+    void finish()
+    {
+        const int partitionSize = group.partitionSize;
+        for (int r = 0; r < responseCount(); ++r)
+        {
+            float * result = output.data() + r * partitionSize;
+            if (!audible[r])
+            {
+                memset(result, 0, sizeof(float) * partitionSize);
+                continue;
+            }
+            sums[r]->computeInverseFFT(scratch.data());
+            memcpy(result, scratch.data() + partitionSize, sizeof(float) * partitionSize);
+        }
+    }
+};
+
+// Applies one group of partitions on the convolver's worker thread. The group must start
+// at least two partitions into the impulse response, which gives the worker a partition's
+// worth of time to convolve each partition of input.
+//
+// The audio thread appends its input to a ring of partitions; the worker convolves each
+// partition once it is complete, leaving the result in a ring of three outputs. While the
+// audio thread plays one, the worker writes the next, and the third is the one just finished
+// with. If the worker falls behind, the tail is silent until it catches up. Each partition
+// of input carries the mask of responses that were applied when it was completed.
+struct PartitionedConvolver::BackgroundStage
+{
+    enum : int { InputPartitions = 4, OutputPartitions = 3 };
+
+    Stage stage;              // only touched by the worker
+    AudioFloatArray inputs;   // the most recent partitions of input
+    AudioFloatArray outputs;  // results, partition by partition, each response by response
+    uint32_t masks[InputPartitions] = {};
+
+    std::atomic<uint64_t> submitted {0};  // partitions of input completed by the audio thread
+    std::atomic<uint64_t> completed {0};  // partitions convolved by the worker
+    std::atomic<uint64_t> resetAt {0};    // partitions submitted before the last reset
+    uint64_t workerResetAt = 0;
+
+    int filled = 0;           // frames of the current partition of input received
+    const float * playing = nullptr;
+
+    explicit BackgroundStage(const std::vector<const Partitions::Group *> & groups)
+        : stage(groups, 1)
+        , inputs(InputPartitions * groups.front()->partitionSize)
+        , outputs(OutputPartitions * groups.front()->partitionSize * groups.size())
+    {
+        inputs.zero();
+        outputs.zero();
+    }
+
+    int partitionSize() const { return stage.group.partitionSize; }
+
+    // called from the audio thread; returns true when a partition is ready for the worker
+    bool process(PartitionedConvolver & owner, const float * sourceP, float * const * destP, uint32_t mask,
+                 int framesToProcess, bool waitForTail)
+    {
+        const int size = partitionSize();
+        const int responses = stage.responseCount();
+        bool submittedPartition = false;
+        int done = 0;
+        while (done < framesToProcess)
+        {
+            const int frames = std::min(framesToProcess - done, size - filled);
+            const uint64_t partition = submitted.load(std::memory_order_relaxed);
+            memcpy(inputs.data() + (partition % InputPartitions) * size + filled, sourceP + done, sizeof(float) * frames);
+            if (playing)
+            {
+                for (int r = 0; r < responses; ++r)
+                    if (mask & (1u << r))
+                        VectorMath::vadd(destP[r] + done, 1, playing + r * size + filled, 1, destP[r] + done, 1, frames);
+            }
+
+            filled += frames;
+            done += frames;
+
+            if (filled == size)
+            {
+                masks[partition % InputPartitions] = mask;
+                submitted.store(partition + 1, std::memory_order_release);
+                submittedPartition = true;
+                filled = 0;
+
+                // play the result of the partition before the one just submitted
+                playing = nullptr;
+                if (partition >= 1 && partition - 1 >= resetAt.load(std::memory_order_relaxed))
+                {
+                    while (waitForTail && completed.load(std::memory_order_acquire) < partition)
+                    {
+                        owner.wakeWorker();
+                        std::this_thread::yield();
+                    }
+                    if (completed.load(std::memory_order_acquire) >= partition)
+                        playing = outputs.data() + ((partition - 1) % OutputPartitions) * size * responses;
+                }
+            }
+        }
+        return submittedPartition;
+    }
+
+    // called from the audio thread; the worker clears its own state when it gets there
+    void reset()
+    {
+        resetAt.store(submitted.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        playing = nullptr;
+        filled = 0;
+    }
+
+    // called from the worker; returns true if there was a partition to convolve
+    bool convolveNext()
+    {
+        const uint64_t partition = completed.load(std::memory_order_relaxed);
+        const uint64_t available = submitted.load(std::memory_order_acquire);
+        if (partition >= available)
+            return false;
+
+        const uint64_t reset = resetAt.load(std::memory_order_relaxed);
+        if (reset != workerResetAt && partition >= reset)
+        {
+            stage.reset();
+            workerResetAt = reset;
+        }
+
+        const int size = partitionSize();
+        const int responses = stage.responseCount();
+        float * currentInput = stage.input.data() + size;
+        uint32_t mask = ~0u;
+        if (available - partition < InputPartitions)
+        {
+            memcpy(currentInput, inputs.data() + (partition % InputPartitions) * size, sizeof(float) * size);
+            mask = masks[partition % InputPartitions];
+        }
+        else
+            memset(currentInput, 0, sizeof(float) * size);  // overwritten while the worker was behind
+
+        stage.convolve(mask);
+        memcpy(outputs.data() + (partition % OutputPartitions) * size * responses, stage.output.data(), sizeof(float) * size * responses);
+        completed.store(partition + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+std::shared_ptr<const PartitionedConvolver::Partitions>
+PartitionedConvolver::Partitions::create(const float * impulseResponse, int impulseLength, int firstPartitionSize,
+                                         Precision precision)
+{
+    // The smallest partitions are the size of the head, and three of them follow it.
+    // After that each group has two partitions twice the size of the last group's, so
+    // that every group starts at a multiple of, and at least one of, its partition size.
+    // Once partitions reach the maximum size, a final group covers the rest.
+    std::shared_ptr<Partitions> partitions = std::make_shared<Partitions>();
+    float energy = 0.f;
+    if (impulseLength > 0)
+        VectorMath::vsvesq(impulseResponse, 1, &energy, impulseLength);
+
+    int partitionSize = firstPartitionSize;
+    int offset = partitionSize;
+    int partitionCount = 3;
+    while (offset < impulseLength)
+    {
+        const int remaining = (impulseLength - offset + partitionSize - 1) / partitionSize;
+        const bool last = partitionSize >= MaxPartitionSize;
+        const int count = last ? remaining : std::min(partitionCount, remaining);
+
+        FFTFrame frame(2 * partitionSize);
+        std::unique_ptr<Partitions::Group> group(new Partitions::Group(offset, partitionSize, count, frame.spectrumSize(), precision));
+        for (int i = 0; i < count; ++i)
+        {
+            const int start = offset + i * partitionSize;
+            const int frames = std::min(partitionSize, impulseLength - start);
+            float partitionEnergy = 0.f;
+            VectorMath::vsvesq(impulseResponse + start, 1, &partitionEnergy, frames);
+            group->silent[i] = partitionEnergy <= energy * SilentPartitionEnergy;
+
+            frame.doPaddedFFT(impulseResponse + start, frames);
+            if (precision == Precision::Half)
+            {
+                // scale the largest value to just below the top of the half range; the
+                // scale is bounded so that the kernels can fold it into the widening
+                float peak = 0.f;
+                VectorMath::vmaxmgv(frame.realData(), 1, &peak, group->spectrumSize);
+                float imagPeak = 0.f;
+                VectorMath::vmaxmgv(frame.imagData(), 1, &imagPeak, group->spectrumSize);
+                peak = std::max(peak, imagPeak);
+                int exponent = 0;
+                if (peak > 0.f)
+                    frexpf(peak, &exponent);
+                exponent = std::max(-100, std::min(14, exponent - 15));
+                group->scales[i] = ldexpf(1.f, exponent);
+                VectorMath::vtohalf(frame.realData(), ldexpf(1.f, -exponent), group->halfReal(i), group->spectrumSize);
+                VectorMath::vtohalf(frame.imagData(), ldexpf(1.f, -exponent), group->halfImag(i), group->spectrumSize);
+            }
+            else
+            {
+                memcpy(group->real(i), frame.realData(), sizeof(float) * group->spectrumSize);
+                memcpy(group->imag(i), frame.imagData(), sizeof(float) * group->spectrumSize);
+            }
+        }
+        partitions->groups.emplace_back(std::move(group));
+
+        offset += count * partitionSize;
+        partitionSize *= 2;
+        partitionCount = 2;
+    }
+
+    return partitions;
+}
+
+std::shared_ptr<const PartitionedConvolver::Partitions>
+PartitionedConvolver::Partitions::find(const float * impulseResponse, int impulseLength, int firstPartitionSize,
+                                       Precision precision)
+{
+    Key key;
+    key.hash = hashImpulse(impulseResponse, impulseLength);
+    key.impulseLength = impulseLength;
+    key.firstPartitionSize = firstPartitionSize;
+    key.precision = precision;
+
+    static std::mutex cacheMutex;
+    static std::map<Key, std::weak_ptr<const Partitions>> cache;
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(key);
+        if (it != cache.end())
+        {
+            if (std::shared_ptr<const Partitions> cached = it->second.lock())
+                return cached;
+        }
+    }
+
+    // transform outside the lock, as a long response takes a while
+    std::shared_ptr<const Partitions> partitions = create(impulseResponse, impulseLength, firstPartitionSize, precision);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto it = cache.begin(); it != cache.end();)
+    {
+        if (it->second.expired())
+            it = cache.erase(it);
+        else
+            ++it;
+    }
+
+    // another thread may have transformed the same response in the meantime
+    std::weak_ptr<const Partitions> & entry = cache[key];
+    if (std::shared_ptr<const Partitions> cached = entry.lock())
+        return cached;
+    entry = partitions;
+    return partitions;
+}
+
+PartitionedConvolver::PartitionedConvolver(const float * impulseResponse, int impulseLength, int blockSize, Precision precision,
+                                           ConvolutionBatch * batch)
+    : PartitionedConvolver(&impulseResponse, 1, impulseLength, blockSize, precision, batch)
+{
+}
+
+PartitionedConvolver::PartitionedConvolver(const float * const * impulseResponses, int responseCount, int impulseLength, int blockSize,
+                                           Precision precision, ConvolutionBatch * batch)
+    : m_blockSize(blockSize)
+    , m_impulseLength(impulseLength)
+    , m_batch(batch)
+    , m_source(blockSize)
+{
+    ASSERT(blockSize > 0 && !(blockSize & (blockSize - 1)));
+    ASSERT(responseCount > 0 && responseCount <= MaxResponses);
+    responseCount = std::max(1, std::min(responseCount, static_cast<int>(MaxResponses)));
+
+    const int headSize = std::max(1, std::min(std::min(blockSize, static_cast<int>(HeadSize)), impulseLength));
+    for (int r = 0; r < responseCount; ++r)
+    {
+        std::unique_ptr<AudioFloatArray> headKernel(new AudioFloatArray(headSize));
+        headKernel->zero();
+        if (impulseLength > 0)
+            headKernel->copyToRange(impulseResponses[r], 0, headSize);
+        m_headKernels.emplace_back(std::move(headKernel));
+        m_heads.emplace_back(new DirectConvolver(blockSize));
+        m_partitions.push_back(Partitions::find(impulseResponses[r], impulseLength, std::min(blockSize, static_cast<int>(HeadSize)), precision));
+    }
+    createStages();
+}
+
+PartitionedConvolver::PartitionedConvolver(const PartitionedConvolver & other)
+    : m_blockSize(other.m_blockSize)
+    , m_impulseLength(other.m_impulseLength)
+    , m_batch(other.m_batch)
+    , m_partitions(other.m_partitions)
+    , m_source(other.m_blockSize)
+{
+    for (auto & kernel : other.m_headKernels)
+    {
+        std::unique_ptr<AudioFloatArray> headKernel(new AudioFloatArray(kernel->size()));
+        headKernel->copyToRange(kernel->data(), 0, kernel->size());
+        m_headKernels.emplace_back(std::move(headKernel));
+        m_heads.emplace_back(new DirectConvolver(m_blockSize));
+    }
+    createStages();
+}
+
+PartitionedConvolver::~PartitionedConvolver()
+{
+    if (m_worker.joinable())
+    {
+        m_quit.store(true, std::memory_order_release);
+        m_workerWake.notify_one();
+        m_worker.join();
+    }
+}
+
+void PartitionedConvolver::createStages()
+{
+    // responses of the same length are partitioned alike
+    const size_t groupCount = m_partitions.front()->groups.size();
+    for (size_t g = 0; g < groupCount; ++g)
+    {
+        std::vector<const Partitions::Group *> groups;
+        for (auto & partitions : m_partitions)
+            groups.push_back(partitions->groups[g].get());
+
+        // a batched convolver has no worker; its stages of partitions as large as a block
+        // leave their products to the batch
+        const Partitions::Group & group = *groups.front();
+        if (m_batch)
+            m_stages.emplace_back(new Stage(groups, 0, group.partitionSize >= m_blockSize));
+        else if (group.partitionSize >= BackgroundPartitionSize && group.offset >= 2 * group.partitionSize)
+            m_backgroundStages.emplace_back(new BackgroundStage(groups));
+        else
+            m_stages.emplace_back(new Stage(groups, 0));
+    }
+
+    if (!m_backgroundStages.empty())
+        m_worker = std::thread(&PartitionedConvolver::workerEntry, this);
+}
+
+void PartitionedConvolver::workerEntry()
+{
+    DenormalDisabler denormalDisabler;
+    while (!m_quit.load(std::memory_order_acquire))
+    {
+        bool convolved = false;
+        for (auto & stage : m_backgroundStages)
+            convolved |= stage->convolveNext();
+
+        if (convolved)
+            continue;
+
+        // the audio thread doesn't block to wake the worker, so a wake up can be missed;
+        // the timeout bounds how late the worker can then be
+        std::unique_lock<std::mutex> lock(m_workerMutex);
+        m_workerWake.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+void PartitionedConvolver::wakeWorker()
+{
+    if (m_workerMutex.try_lock())
+    {
+        m_workerWake.notify_one();
+        m_workerMutex.unlock();
+    }
+}
+
+void PartitionedConvolver::process(const float * sourceP, float * destP, int framesToProcess, bool waitForTail)
+{
+    ASSERT(responseCount() == 1);
+    process(sourceP, &destP, framesToProcess, waitForTail);
+}
+
+void PartitionedConvolver::process(const float * sourceP, float * const * destP, int framesToProcess, bool waitForTail)
+{
+    ASSERT(framesToProcess == m_blockSize);
+    if (framesToProcess != m_blockSize)
+        return;
+
+    uint32_t mask = 0;
+    bool inPlace = false;
+    for (int r = 0; r < responseCount(); ++r)
+    {
+        if (destP[r])
+        {
+            mask |= 1u << r;
+            inPlace |= destP[r] == sourceP;
+        }
+    }
+
+    if (inPlace && (!m_stages.empty() || responseCount() > 1))
+    {
+        // a head would overwrite the source, which the stages and other heads still need
+        memcpy(m_source.data(), sourceP, sizeof(float) * framesToProcess);
+        sourceP = m_source.data();
+    }
+
+    for (int r = 0; r < responseCount(); ++r)
+    {
+        if (destP[r])
+            m_heads[r]->process(m_headKernels[r].get(), sourceP, destP[r], framesToProcess);
+        else
+            m_heads[r]->reset();
+    }
+
+    for (auto & stage : m_stages)
+        stage->process(sourceP, destP, mask, framesToProcess, m_batch);
+
+    bool wake = false;
+    for (auto & stage : m_backgroundStages)
+        wake |= stage->process(*this, sourceP, destP, mask, framesToProcess, waitForTail);
+
+    if (wake)
+        wakeWorker();
+}
+
+void PartitionedConvolver::reset()
+{
+    for (auto & head : m_heads)
+        head->reset();
+    for (auto & stage : m_stages)
+        stage->reset();
+    for (auto & stage : m_backgroundStages)
+        stage->reset();
+}
+
+// Computes every accumulation on the calling thread, as a stage does itself
+class CpuConvolutionBackend : public ConvolutionBatch::Backend
+{
+public:
+    virtual void accumulate(const ConvolutionBatch::Accumulation * accumulations, int accumulationCount,
+                            const ConvolutionBatch::Product * products) override
+    {
+        for (int a = 0; a < accumulationCount; ++a)
+        {
+            FFTFrame & frame = *accumulations[a].frame;
+            const ConvolutionBatch::Product * product = products + accumulations[a].firstProduct;
+            for (int i = 0; i < accumulations[a].productCount; ++i, ++product)
+            {
+                if (product->halfReal)
+                    frame.multiplyAccumulate(product->inputReal, product->inputImag, product->halfReal, product->halfImag, product->scale);
+                else
+                    frame.multiplyAccumulate(product->inputReal, product->inputImag, product->real, product->imag);
+            }
+        }
+    }
+};
+
+static std::mutex s_backendMutex;
+static std::shared_ptr<ConvolutionBatch::Backend> s_defaultBackend;
+
+void ConvolutionBatch::setDefaultBackend(std::shared_ptr<Backend> backend)
+{
+    std::lock_guard<std::mutex> lock(s_backendMutex);
+    s_defaultBackend = std::move(backend);
+}
+
+std::shared_ptr<ConvolutionBatch::Backend> ConvolutionBatch::defaultBackend()
+{
+    std::lock_guard<std::mutex> lock(s_backendMutex);
+    if (!s_defaultBackend)
+        s_defaultBackend = std::make_shared<CpuConvolutionBackend>();
+    return s_defaultBackend;
+}
+
+ConvolutionBatch::ConvolutionBatch(std::shared_ptr<Backend> backend)
+    : m_backend(backend ? std::move(backend) : defaultBackend())
+{
+}
+
+ConvolutionBatch::~ConvolutionBatch()
+{
+    ASSERT(m_deferred.empty());
+}
+
+void ConvolutionBatch::flush()
+{
+    if (m_deferred.empty())
+        return;
+
+    m_accumulations.clear();
+    m_products.clear();
+    for (auto & deferred : m_deferred)
+        deferred.stage->gather(deferred.mask, m_accumulations, m_products);
+
+    if (!m_accumulations.empty())
+        m_backend->accumulate(m_accumulations.data(), static_cast<int>(m_accumulations.size()), m_products.data());
+
+    for (auto & deferred : m_deferred)
+        deferred.stage->finish();
+    m_deferred.clear();
+}
+
+}  // namespace lab
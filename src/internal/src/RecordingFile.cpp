@@ -0,0 +1,45 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/RecordingFile.h"
+#include "internal/FlacFileWriter.h"
+#include "internal/PCMFileWriter.h"
+
+namespace lab
+{
+
+std::unique_ptr<RecordingFile> createRecordingFile(const std::string & path, int channels, float sampleRate,
+                                                   RecorderFileFormat format)
+{
+    if (format == RecorderFileFormat::FlacInt16 || format == RecorderFileFormat::FlacInt24)
+    {
+        std::unique_ptr<FlacFileWriter> file(new FlacFileWriter());
+        if (!file->open(path, channels, sampleRate, format == RecorderFileFormat::FlacInt24 ? 24 : 16))
+            return nullptr;
+        return std::move(file);
+    }
+
+    SampleConversion::SampleFormat sampleFormat = SampleConversion::SampleFormat::Float32;
+    if (format == RecorderFileFormat::WavInt16)
+        sampleFormat = SampleConversion::SampleFormat::Int16;
+    else if (format == RecorderFileFormat::WavInt24)
+        sampleFormat = SampleConversion::SampleFormat::Int24;
+
+    std::unique_ptr<PCMFileWriter> file(new PCMFileWriter());
+    if (!file->open(path, channels, sampleRate, sampleFormat, format == RecorderFileFormat::RawFloat32))
+        return nullptr;
+    return std::move(file);
+}
+
+const char * recordingFileExtension(RecorderFileFormat format)
+{
+    switch (format)
+    {
+        case RecorderFileFormat::RawFloat32: return ".raw";
+        case RecorderFileFormat::FlacInt16:
+        case RecorderFileFormat::FlacInt24: return ".flac";
+        default: return ".wav";
+    }
+}
+
+}  // namespace lab
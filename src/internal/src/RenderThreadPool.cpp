@@ -0,0 +1,199 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/RenderThreadPool.h"
+#include "internal/Assertions.h"
+#include "internal/DenormalDisabler.h"
+
+#include <chrono>
+
+namespace lab
+{
+
+// A bounded deque of task indices. The owning thread pushes and pops at the
+// back, so that it continues on the work it just released; thieves take from
+// the front. Critical sections are a handful of instructions, so a spin lock
+// is used rather than a mutex that could put the audio thread to sleep.
+struct RenderThreadPool::TaskQueue
+{
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    std::vector<int> tasks;
+    int head = 0;
+    int count = 0;
+
+    void acquire()
+    {
+        while (lock.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void release() { lock.clear(std::memory_order_release); }
+};
+
+RenderThreadPool::RenderThreadPool(int workerCount, const ThreadScheduling & scheduling)
+{
+    if (workerCount < 0)
+        workerCount = 0;
+
+    for (int i = 0; i <= workerCount; ++i)
+        m_queues.emplace_back(new TaskQueue());
+
+    for (int i = 0; i < workerCount; ++i)
+        m_threads.emplace_back(&RenderThreadPool::workerLoop, this, i + 1, scheduling);
+}
+
+RenderThreadPool::~RenderThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_shouldExit = true;
+    }
+    m_wake.notify_all();
+
+    for (auto & t : m_threads)
+        t.join();
+}
+
+void RenderThreadPool::reserve(int taskCount)
+{
+    if (taskCount <= m_capacity)
+        return;
+
+    m_pending.reset(new std::atomic<int>[taskCount]);
+    for (auto & q : m_queues)
+        q->tasks.resize(taskCount);
+    m_capacity = taskCount;
+}
+
+void RenderThreadPool::push(int queueIndex, int task)
+{
+    TaskQueue & q = *m_queues[queueIndex];
+    q.acquire();
+    ASSERT(q.count < static_cast<int>(q.tasks.size()));
+    q.tasks[(q.head + q.count) % q.tasks.size()] = task;
+    ++q.count;
+    q.release();
+}
+
+bool RenderThreadPool::popOrSteal(int queueIndex, int & task)
+{
+    TaskQueue & own = *m_queues[queueIndex];
+    own.acquire();
+    if (own.count)
+    {
+        --own.count;
+        task = own.tasks[(own.head + own.count) % own.tasks.size()];
+        own.release();
+        return true;
+    }
+    own.release();
+
+    const int queueCount = static_cast<int>(m_queues.size());
+    for (int i = 1; i < queueCount; ++i)
+    {
+        TaskQueue & victim = *m_queues[(queueIndex + i) % queueCount];
+        victim.acquire();
+        if (victim.count)
+        {
+            task = victim.tasks[victim.head];
+            victim.head = (victim.head + 1) % static_cast<int>(victim.tasks.size());
+            --victim.count;
+            victim.release();
+            return true;
+        }
+        victim.release();
+    }
+    return false;
+}
+
+void RenderThreadPool::execute(int queueIndex)
+{
+    int task;
+    while (m_remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!popOrSteal(queueIndex, task))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        m_fn(m_userData, task);
+
+        const RenderTaskGraph & graph = *m_graph;
+        for (int i = graph.successorOffsets[task]; i < graph.successorOffsets[task + 1]; ++i)
+        {
+            int successor = graph.successors[i];
+            if (m_pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                push(queueIndex, successor);
+        }
+
+        m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void RenderThreadPool::workerLoop(int queueIndex, ThreadScheduling scheduling)
+{
+    // workers render nodes just as the device thread does, so they need the same protection,
+    // and as it, may be realtime threads in the device's workgroup
+    DenormalDisabler denormalDisabler;
+    ScopedThreadScheduling scoped(scheduling);
+
+    uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            // The wake up is not sent under the mutex, so that run() never blocks on it; the
+            // timeout recovers from a missed notification, and the caller of run() makes
+            // progress on its own in the meantime.
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10), [&]() {
+                return m_shouldExit.load() || m_generation.load(std::memory_order_acquire) != seenGeneration;
+            });
+        }
+
+        if (m_shouldExit)
+            return;
+
+        seenGeneration = m_generation.load(std::memory_order_acquire);
+        execute(queueIndex);
+    }
+}
+
+void RenderThreadPool::run(const RenderTaskGraph & graph, TaskFunction fn, void * userData)
+{
+    const int taskCount = graph.taskCount();
+    if (!taskCount)
+        return;
+
+    reserve(taskCount);
+
+    m_graph = &graph;
+    m_fn = fn;
+    m_userData = userData;
+
+    for (int i = 0; i < taskCount; ++i)
+        m_pending[i].store(graph.dependencyCount[i], std::memory_order_relaxed);
+    m_remaining.store(taskCount, std::memory_order_release);
+
+    // deal the initially ready tasks out across all the queues
+    const int queueCount = static_cast<int>(m_queues.size());
+    int next = 0;
+    for (int i = 0; i < taskCount; ++i)
+    {
+        if (graph.dependencyCount[i] == 0)
+        {
+            push(next, i);
+            next = (next + 1) % queueCount;
+        }
+    }
+
+    if (!m_threads.empty())
+    {
+        m_generation.fetch_add(1, std::memory_order_acq_rel);
+        m_wake.notify_all();
+    }
+
+    execute(0);
+}
+
+}  // namespace lab
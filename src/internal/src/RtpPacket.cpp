@@ -0,0 +1,99 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/RtpPacket.h"
+
+#include <algorithm>
+
+namespace lab
+{
+namespace RtpPacket
+{
+
+    using SampleConversion::SampleFormat;
+
+    // Samples are converted little endian, so every sample's bytes are reversed to put
+    // them in network order, and back
+    static void swapBytes(uint8_t * data, size_t samples, int bytesPerSample)
+    {
+        for (size_t i = 0; i < samples; ++i, data += bytesPerSample)
+            std::reverse(data, data + bytesPerSample);
+    }
+
+    void writeHeader(const Header & header, uint8_t * packet)
+    {
+        packet[0] = 0x80;  // version 2, no padding, extension or contributing sources
+        packet[1] = static_cast<uint8_t>((header.marker ? 0x80 : 0) | (header.payloadType & 0x7f));
+        packet[2] = static_cast<uint8_t>(header.sequence >> 8);
+        packet[3] = static_cast<uint8_t>(header.sequence);
+        for (int i = 0; i < 4; ++i)
+        {
+            packet[4 + i] = static_cast<uint8_t>(header.timestamp >> (24 - 8 * i));
+            packet[8 + i] = static_cast<uint8_t>(header.ssrc >> (24 - 8 * i));
+        }
+    }
+
+    bool readHeader(const uint8_t * packet, size_t bytes, Header & header, size_t & payloadOffset, size_t & payloadBytes)
+    {
+        if (bytes < HeaderBytes || (packet[0] >> 6) != 2)
+            return false;
+
+        const bool padding = (packet[0] & 0x20) != 0;
+        const bool extension = (packet[0] & 0x10) != 0;
+        const int contributors = packet[0] & 0x0f;
+
+        header.marker = (packet[1] & 0x80) != 0;
+        header.payloadType = packet[1] & 0x7f;
+        header.sequence = static_cast<uint16_t>((packet[2] << 8) | packet[3]);
+        header.timestamp = 0;
+        header.ssrc = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            header.timestamp = (header.timestamp << 8) | packet[4 + i];
+            header.ssrc = (header.ssrc << 8) | packet[8 + i];
+        }
+
+        size_t offset = HeaderBytes + 4 * static_cast<size_t>(contributors);
+        if (extension)
+        {
+            if (offset + 4 > bytes)
+                return false;
+            const size_t words = (static_cast<size_t>(packet[offset + 2]) << 8) | packet[offset + 3];
+            offset += 4 + 4 * words;
+        }
+        size_t end = bytes;
+        if (padding)
+        {
+            const size_t pad = packet[bytes - 1];
+            if (!pad || pad > bytes)
+                return false;
+            end -= pad;
+        }
+        if (offset > end)
+            return false;
+
+        payloadOffset = offset;
+        payloadBytes = end - offset;
+        return true;
+    }
+
+    size_t encode(const float * const * channels, int channelCount, int frames, SampleFormat format, uint8_t * payload)
+    {
+        const int sampleBytes = SampleConversion::bytesPerSample(format);
+        const size_t samples = static_cast<size_t>(frames) * channelCount;
+        SampleConversion::interleave(channels, channelCount, frames, format, payload);
+        swapBytes(payload, samples, sampleBytes);
+        return samples * sampleBytes;
+    }
+
+    int decode(uint8_t * payload, size_t bytes, SampleFormat format, int channelCount, float * const * channels)
+    {
+        const int sampleBytes = SampleConversion::bytesPerSample(format);
+        const int frames = static_cast<int>(bytes / (static_cast<size_t>(sampleBytes) * channelCount));
+        swapBytes(payload, static_cast<size_t>(frames) * channelCount, sampleBytes);
+        SampleConversion::deinterleave(payload, format, channelCount, frames, channels);
+        return frames;
+    }
+
+}  // namespace RtpPacket
+}  // namespace lab
@@ -0,0 +1,261 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/SampleConversion.h"
+#include "internal/Assertions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+namespace lab
+{
+namespace SampleConversion
+{
+
+namespace
+{
+    const float Int16Scale = 32767.f;
+    const float Int24Scale = 8388607.f;
+
+    inline float clip(float x)
+    {
+        return std::min(1.f, std::max(-1.f, x));
+    }
+
+    inline int16_t toInt16(float x)
+    {
+        return static_cast<int16_t>(std::lrint(clip(x) * Int16Scale));
+    }
+
+    inline void toInt24(float x, uint8_t * p)
+    {
+        const int32_t v = static_cast<int32_t>(std::lrint(clip(x) * Int24Scale));
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+        p[2] = static_cast<uint8_t>(v >> 16);
+    }
+
+    inline float fromInt24(const uint8_t * p)
+    {
+        // assemble in the upper bytes so the shift back down is sign-extending
+        const int32_t v = static_cast<int32_t>((uint32_t(p[0]) << 8) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 24)) >> 8;
+        return v * (1.f / 8388608.f);
+    }
+
+    void interleaveFloatStereo(const float * left, const float * right, int frames, float * destination)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        const __m128 lo = _mm_set1_ps(-1.f);
+        const __m128 hi = _mm_set1_ps(1.f);
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m128 l = _mm_min_ps(hi, _mm_max_ps(lo, _mm_loadu_ps(left + i)));
+            const __m128 r = _mm_min_ps(hi, _mm_max_ps(lo, _mm_loadu_ps(right + i)));
+            _mm_storeu_ps(destination + 2 * i, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(destination + 2 * i + 4, _mm_unpackhi_ps(l, r));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t lo = vdupq_n_f32(-1.f);
+        const float32x4_t hi = vdupq_n_f32(1.f);
+        for (; i + 4 <= frames; i += 4)
+        {
+            float32x4x2_t lr;
+            lr.val[0] = vminq_f32(hi, vmaxq_f32(lo, vld1q_f32(left + i)));
+            lr.val[1] = vminq_f32(hi, vmaxq_f32(lo, vld1q_f32(right + i)));
+            vst2q_f32(destination + 2 * i, lr);
+        }
+#endif
+        for (; i < frames; ++i)
+        {
+            destination[2 * i] = clip(left[i]);
+            destination[2 * i + 1] = clip(right[i]);
+        }
+    }
+
+    void deinterleaveFloatStereo(const float * source, int frames, float * left, float * right)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        const __m128 lo = _mm_set1_ps(-1.f);
+        const __m128 hi = _mm_set1_ps(1.f);
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps(source + 2 * i);
+            const __m128 b = _mm_loadu_ps(source + 2 * i + 4);
+            const __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(left + i, _mm_min_ps(hi, _mm_max_ps(lo, l)));
+            _mm_storeu_ps(right + i, _mm_min_ps(hi, _mm_max_ps(lo, r)));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t lo = vdupq_n_f32(-1.f);
+        const float32x4_t hi = vdupq_n_f32(1.f);
+        for (; i + 4 <= frames; i += 4)
+        {
+            const float32x4x2_t lr = vld2q_f32(source + 2 * i);
+            vst1q_f32(left + i, vminq_f32(hi, vmaxq_f32(lo, lr.val[0])));
+            vst1q_f32(right + i, vminq_f32(hi, vmaxq_f32(lo, lr.val[1])));
+        }
+#endif
+        for (; i < frames; ++i)
+        {
+            left[i] = clip(source[2 * i]);
+            right[i] = clip(source[2 * i + 1]);
+        }
+    }
+
+    void clipFloat(const float * source, int frames, float * destination)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        const __m128 lo = _mm_set1_ps(-1.f);
+        const __m128 hi = _mm_set1_ps(1.f);
+        for (; i + 4 <= frames; i += 4)
+            _mm_storeu_ps(destination + i, _mm_min_ps(hi, _mm_max_ps(lo, _mm_loadu_ps(source + i))));
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t lo = vdupq_n_f32(-1.f);
+        const float32x4_t hi = vdupq_n_f32(1.f);
+        for (; i + 4 <= frames; i += 4)
+            vst1q_f32(destination + i, vminq_f32(hi, vmaxq_f32(lo, vld1q_f32(source + i))));
+#endif
+        for (; i < frames; ++i)
+            destination[i] = clip(source[i]);
+    }
+
+    void fromInt16Mono(const int16_t * source, int frames, float * destination)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+        for (; i + 8 <= frames; i += 8)
+        {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+            // sign-extend by placing each sample in the upper half of a 32 bit lane
+            const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+            const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+            _mm_storeu_ps(destination + i, _mm_mul_ps(scale, _mm_cvtepi32_ps(lo)));
+            _mm_storeu_ps(destination + i + 4, _mm_mul_ps(scale, _mm_cvtepi32_ps(hi)));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t scale = vdupq_n_f32(1.f / 32768.f);
+        for (; i + 8 <= frames; i += 8)
+        {
+            const int16x8_t s = vld1q_s16(source + i);
+            vst1q_f32(destination + i, vmulq_f32(scale, vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)))));
+            vst1q_f32(destination + i + 4, vmulq_f32(scale, vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)))));
+        }
+#endif
+        for (; i < frames; ++i)
+            destination[i] = source[i] * (1.f / 32768.f);
+    }
+}
+
+int bytesPerSample(SampleFormat format)
+{
+    switch (format)
+    {
+        case SampleFormat::Float32: return 4;
+        case SampleFormat::Int16: return 2;
+        case SampleFormat::Int24: return 3;
+    }
+    return 0;
+}
+
+void interleave(const float * const * sources, int channels, int frames, SampleFormat format, void * destination)
+{
+    ASSERT(channels > 0);
+
+    switch (format)
+    {
+        case SampleFormat::Float32:
+        {
+            float * d = static_cast<float *>(destination);
+            if (channels == 1)
+                clipFloat(sources[0], frames, d);
+            else if (channels == 2)
+                interleaveFloatStereo(sources[0], sources[1], frames, d);
+            else
+            {
+                for (int i = 0; i < frames; ++i)
+                    for (int c = 0; c < channels; ++c)
+                        *d++ = clip(sources[c][i]);
+            }
+            break;
+        }
+        case SampleFormat::Int16:
+        {
+            int16_t * d = static_cast<int16_t *>(destination);
+            for (int i = 0; i < frames; ++i)
+                for (int c = 0; c < channels; ++c)
+                    *d++ = toInt16(sources[c][i]);
+            break;
+        }
+        case SampleFormat::Int24:
+        {
+            uint8_t * d = static_cast<uint8_t *>(destination);
+            for (int i = 0; i < frames; ++i)
+                for (int c = 0; c < channels; ++c, d += 3)
+                    toInt24(sources[c][i], d);
+            break;
+        }
+    }
+}
+
+void deinterleave(const void * source, SampleFormat format, int channels, int frames, float * const * destinations)
+{
+    ASSERT(channels > 0);
+
+    switch (format)
+    {
+        case SampleFormat::Float32:
+        {
+            const float * s = static_cast<const float *>(source);
+            if (channels == 1)
+                clipFloat(s, frames, destinations[0]);
+            else if (channels == 2)
+                deinterleaveFloatStereo(s, frames, destinations[0], destinations[1]);
+            else
+            {
+                for (int i = 0; i < frames; ++i)
+                    for (int c = 0; c < channels; ++c)
+                        destinations[c][i] = clip(*s++);
+            }
+            break;
+        }
+        case SampleFormat::Int16:
+        {
+            const int16_t * s = static_cast<const int16_t *>(source);
+            if (channels == 1)
+                fromInt16Mono(s, frames, destinations[0]);
+            else
+            {
+                for (int i = 0; i < frames; ++i)
+                    for (int c = 0; c < channels; ++c)
+                        destinations[c][i] = *s++ * (1.f / 32768.f);
+            }
+            break;
+        }
+        case SampleFormat::Int24:
+        {
+            const uint8_t * s = static_cast<const uint8_t *>(source);
+            for (int i = 0; i < frames; ++i)
+                for (int c = 0; c < channels; ++c, s += 3)
+                    destinations[c][i] = fromInt24(s);
+            break;
+        }
+    }
+}
+
+}  // namespace SampleConversion
+}  // namespace lab
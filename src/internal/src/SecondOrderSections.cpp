@@ -0,0 +1,267 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/SecondOrderSections.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+namespace lab
+{
+
+namespace
+{
+    typedef std::complex<double> Complex;
+
+    // p(x) = x^n + c[n-1] x^(n-1) + ... + c[0]
+    Complex evaluateMonic(const std::vector<double> & c, Complex x)
+    {
+        Complex p = 1.0;
+        for (size_t i = c.size(); i-- > 0;)
+            p = p * x + c[i];
+        return p;
+    }
+
+    Complex derivativeMonic(const std::vector<double> & c, Complex x)
+    {
+        const size_t n = c.size();
+        Complex d = static_cast<double>(n);
+        for (size_t i = n - 1; i-- > 0;)
+            d = d * x + static_cast<double>(i + 1) * c[i + 1];
+        return n ? d : Complex(0.0);
+    }
+
+    // The roots of a monic polynomial, by Durand-Kerner iteration polished with Newton steps
+    std::vector<Complex> roots(const std::vector<double> & c)
+    {
+        const size_t n = c.size();
+        std::vector<Complex> r(n);
+        if (!n)
+            return r;
+
+        // start on a circle that bounds the roots
+        double bound = 0;
+        for (double v : c)
+            bound = std::max(bound, std::fabs(v));
+        bound = std::min(1.0 + bound, 2.0);
+        const Complex seed(0.4, 0.9);
+        Complex z = 1.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            z *= seed;
+            r[i] = bound * z / std::abs(z) * (0.5 + 0.5 * (i + 1) / n);
+        }
+
+        for (int iteration = 0; iteration < 1000; ++iteration)
+        {
+            double change = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                Complex denominator = 1.0;
+                for (size_t j = 0; j < n; ++j)
+                    if (j != i)
+                        denominator *= r[i] - r[j];
+                if (std::abs(denominator) < 1.e-300)
+                    denominator = 1.e-300;
+                const Complex step = evaluateMonic(c, r[i]) / denominator;
+                r[i] -= step;
+                change = std::max(change, std::abs(step) / (1.0 + std::abs(r[i])));
+            }
+            if (change < 1.e-15)
+                break;
+        }
+
+        for (Complex & x : r)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                const Complex d = derivativeMonic(c, x);
+                if (std::abs(d) < 1.e-300)
+                    break;
+                x -= evaluateMonic(c, x) / d;
+            }
+        }
+        return r;
+    }
+
+    // A factor (1 - r1 z^-1)(1 - r2 z^-1) = 1 + c1 z^-1 + c2 z^-2, or of one root with c2 zero
+    struct Factor
+    {
+        double c1 = 0;
+        double c2 = 0;
+        Complex root;  // a representative root, for pairing
+        double radius = 0;
+    };
+
+    // Pairs each root above the real axis with the root nearest its conjugate, and the real
+    // roots with each other, by magnitude
+    std::vector<Factor> factors(std::vector<Complex> r, std::vector<double> reals)
+    {
+        std::sort(r.begin(), r.end(), [](const Complex & a, const Complex & b) { return a.imag() > b.imag(); });
+
+        std::vector<Factor> f;
+        std::vector<bool> used(r.size(), false);
+        for (size_t i = 0; i < r.size(); ++i)
+        {
+            if (used[i])
+                continue;
+            used[i] = true;
+            const Complex x = r[i];
+            if (std::fabs(x.imag()) <= 1.e-9 * (1.0 + std::abs(x)))
+            {
+                reals.push_back(x.real());
+                continue;
+            }
+
+            size_t conjugate = r.size();
+            for (size_t j = i + 1; j < r.size(); ++j)
+                if (!used[j] && (conjugate == r.size() || std::abs(r[j] - std::conj(x)) < std::abs(r[conjugate] - std::conj(x))))
+                    conjugate = j;
+            if (conjugate == r.size())
+            {
+                reals.push_back(x.real());
+                continue;
+            }
+            used[conjugate] = true;
+
+            // the pair's average, for roots that came out not quite conjugate
+            const Complex y = 0.5 * (x + std::conj(r[conjugate]));
+            Factor factor;
+            factor.c1 = -2 * y.real();
+            factor.c2 = std::norm(y);
+            factor.root = y;
+            factor.radius = std::abs(y);
+            f.push_back(factor);
+        }
+
+        std::sort(reals.begin(), reals.end(), [](double a, double b) { return std::fabs(a) > std::fabs(b); });
+        for (size_t i = 0; i < reals.size(); i += 2)
+        {
+            Factor factor;
+            if (i + 1 < reals.size())
+            {
+                factor.c1 = -(reals[i] + reals[i + 1]);
+                factor.c2 = reals[i] * reals[i + 1];
+            }
+            else
+                factor.c1 = -reals[i];
+            factor.root = reals[i];
+            factor.radius = std::fabs(reals[i]);
+            f.push_back(factor);
+        }
+        return f;
+    }
+
+    // The roots in z of the polynomial in z^-1 with the given coefficients, after its
+    // first, which must not be zero; trailing zero coefficients are roots at the origin,
+    // whose factors are one.
+    std::vector<Factor> factorPolynomial(const std::vector<double> & coefficients)
+    {
+        size_t last = coefficients.size();
+        while (last > 1 && coefficients[last - 1] == 0)
+            --last;
+
+        // the polynomial in z, highest power first
+        std::vector<double> p(coefficients.begin(), coefficients.begin() + last);
+        for (size_t i = 1; i < p.size(); ++i)
+            p[i] /= p[0];
+        p[0] = 1;
+
+        // Roots at z = 1 and z = -1, as the zeros of low and high pass designs are, are
+        // often repeated, and an iteration would find them only roughly; they are divided
+        // out exactly first.
+        std::vector<double> reals;
+        for (double root : {-1.0, 1.0})
+        {
+            while (p.size() > 1)
+            {
+                double scale = 0, value = 0;
+                for (double v : p)
+                {
+                    scale += std::fabs(v);
+                    value = value * root + v;
+                }
+                if (std::fabs(value) > 1.e-10 * scale)
+                    break;
+
+                for (size_t i = 1; i < p.size(); ++i)
+                    p[i] += root * p[i - 1];
+                p.pop_back();
+                reals.push_back(root);
+            }
+        }
+
+        const size_t order = p.size() - 1;
+        std::vector<double> monic(order);
+        for (size_t i = 0; i < order; ++i)
+            monic[i] = p[order - i];
+        return factors(roots(monic), reals);
+    }
+}
+
+double decomposeToSections(const std::vector<double> & feedforward, const std::vector<double> & feedback,
+                           std::vector<double> & sections)
+{
+    sections.clear();
+    if (feedback.empty() || feedback[0] == 0)
+        return 0;
+
+    // leading zeros of the numerator are delays
+    size_t delays = 0;
+    while (delays < feedforward.size() && feedforward[delays] == 0)
+        ++delays;
+    if (delays == feedforward.size())
+    {
+        // silence
+        sections = {0, 0, 0, 0, 0};
+        return 0;
+    }
+
+    const std::vector<double> numerator(feedforward.begin() + delays, feedforward.end());
+    const double gain = numerator[0] / feedback[0];
+    std::vector<Factor> zeros = factorPolynomial(numerator);
+    std::vector<Factor> poles = factorPolynomial(feedback);
+
+    double maxRadius = 0;
+    for (const Factor & p : poles)
+        maxRadius = std::max(maxRadius, p.radius);
+
+    // each pair of poles takes the nearest zeros, the poles nearest the unit circle first
+    std::sort(poles.begin(), poles.end(), [](const Factor & a, const Factor & b) { return a.radius > b.radius; });
+    std::vector<double> reversed;
+    for (const Factor & p : poles)
+    {
+        double b1 = 0, b2 = 0;
+        if (!zeros.empty())
+        {
+            auto nearest = std::min_element(zeros.begin(), zeros.end(), [&p](const Factor & a, const Factor & b) {
+                return std::abs(a.root - p.root) < std::abs(b.root - p.root);
+            });
+            b1 = nearest->c1;
+            b2 = nearest->c2;
+            zeros.erase(nearest);
+        }
+        const double section[5] = {1, b1, b2, p.c1, p.c2};
+        reversed.insert(reversed.end(), section, section + 5);
+    }
+
+    // the remaining zeros, then the delays, are sections without poles; the others follow
+    // in the order the poles approach the unit circle
+    for (const Factor & z : zeros)
+        sections.insert(sections.end(), {1, z.c1, z.c2, 0, 0});
+    for (; delays >= 2; delays -= 2)
+        sections.insert(sections.end(), {0, 0, 1, 0, 0});
+    if (delays)
+        sections.insert(sections.end(), {0, 1, 0, 0, 0});
+    for (size_t i = reversed.size(); i >= 5; i -= 5)
+        sections.insert(sections.end(), reversed.begin() + (i - 5), reversed.begin() + i);
+
+    if (sections.empty())
+        sections = {1, 0, 0, 0, 0};
+    for (int i = 0; i < 3; ++i)
+        sections[i] *= gain;
+    return maxRadius;
+}
+
+}  // namespace lab
@@ -0,0 +1,191 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/SpatialBatch.h"
+#include "internal/Cone.h"
+#include "internal/Distance.h"
+#include "internal/FastMath.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+namespace
+{
+    const float DegreesPerRadian = 57.29577951308232f;
+
+    template <typename T>
+    inline T load(const float * p, int i);
+
+    template <>
+    inline float load<float>(const float * p, int i) { return p[i]; }
+
+    template <>
+    inline Lanes4 load<Lanes4>(const float * p, int i) { return Lanes4::load(p + i); }
+
+    inline void store(float v, float * p, int i) { p[i] = v; }
+    inline void store(Lanes4 v, float * p, int i) { v.store(p + i); }
+
+    // Runs kernel on four sources at a time, then on those left over one at a time
+    template <typename Kernel>
+    inline void forEach(int count, Kernel kernel)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+            kernel(Lanes4(0.f), i);
+        for (; i < count; ++i)
+            kernel(0.f, i);
+    }
+
+    template <typename T>
+    struct Vector3
+    {
+        T x, y, z;
+    };
+
+    template <typename T>
+    inline T dot(const Vector3<T> & a, const Vector3<T> & b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    template <typename T>
+    inline Vector3<T> splat(const FloatPoint3D & p) { return {T(p.x), T(p.y), T(p.z)}; }
+
+    // v over its length, or zero if it has none
+    template <typename T>
+    inline Vector3<T> normalized(const Vector3<T> & v, T & length)
+    {
+        length = sqrtOf(dot(v, v));
+        const T scale = select(length > T(0.f), T(1.f) / maxOf(length, T(1e-30f)), T(0.f));
+        return {v.x * scale, v.y * scale, v.z * scale};
+    }
+
+    // the listener's front, right and up, square to each other, as PannerNode aligns them
+    struct ListenerAxes
+    {
+        FloatPoint3D front, right, up;
+
+        explicit ListenerAxes(const SpatialListener & listener)
+        {
+            front = normalize(listener.forward);
+            right = normalize(cross(front, listener.up));
+            up = cross(right, front);
+        }
+    };
+}
+
+void SpatialBatch::distances(const SpatialListener & listener, const SpatialSources & sources, float * distances)
+{
+    forEach(sources.count, [&](auto lanes, int i) {
+        using T = decltype(lanes);
+        const Vector3<T> v = {load<T>(sources.x, i) - T(listener.position.x), load<T>(sources.y, i) - T(listener.position.y),
+                              load<T>(sources.z, i) - T(listener.position.z)};
+        store(sqrtOf(dot(v, v)), distances, i);
+    });
+}
+
+void SpatialBatch::distanceGains(const DistanceEffect & effect, const float * distances, int count, float * gains)
+{
+    const float ref = static_cast<float>(effect.refDistance());
+    const float maxDistance = static_cast<float>(effect.maxDistance());
+    const float rolloff = static_cast<float>(effect.rolloffFactor());
+    const bool clamped = effect.isClamped();
+    const DistanceEffect::ModelType model = effect.model();
+
+    forEach(count, [&](auto lanes, int i) {
+        using T = decltype(lanes);
+        T d = minOf(load<T>(distances, i), T(maxDistance));
+        if (clamped)
+            d = maxOf(d, T(ref));
+
+        T gain(0.f);
+        switch (model)
+        {
+            case DistanceEffect::ModelInverse:
+                gain = T(ref) / (T(ref) + T(rolloff) * (d - T(ref)));
+                break;
+            case DistanceEffect::ModelExponential:
+                // pow(d / ref, -rolloff); a distance of zero is kept off log2's domain's edge
+                gain = FastMath::exp2(T(-rolloff) * FastMath::log2(maxOf(d / T(ref), T(1e-30f))));
+                break;
+            default:
+                gain = T(1.f) - T(rolloff) * (d - T(ref)) / T(maxDistance - ref);
+                break;
+        }
+        store(gain, gains, i);
+    });
+}
+
+void SpatialBatch::coneGains(const ConeEffect & effect, const SpatialListener & listener, const SpatialSources & sources, float * gains)
+{
+    const float innerAngle = static_cast<float>(effect.innerAngle());
+    const float outerAngle = static_cast<float>(effect.outerAngle());
+    if ((innerAngle == 360.f && outerAngle == 360.f) || !sources.orientationX)
+    {
+        std::fill(gains, gains + sources.count, 1.f);  // no cone, unity gain
+        return;
+    }
+
+    // the API's angles are whole, and the cone's half angles are compared
+    const float inner = std::abs(innerAngle) * 0.5f;
+    const float outer = std::abs(outerAngle) * 0.5f;
+    const float outerGain = static_cast<float>(effect.outerGain());
+    const float span = outer > inner ? 1.f / (outer - inner) : 0.f;
+
+    forEach(sources.count, [&](auto lanes, int i) {
+        using T = decltype(lanes);
+        const Vector3<T> toListener = {T(listener.position.x) - load<T>(sources.x, i), T(listener.position.y) - load<T>(sources.y, i),
+                                       T(listener.position.z) - load<T>(sources.z, i)};
+        const Vector3<T> orientation = {load<T>(sources.orientationX, i), load<T>(sources.orientationY, i),
+                                        load<T>(sources.orientationZ, i)};
+        T distance(0.f), orientationLength(0.f);
+        const Vector3<T> direction = normalized(toListener, distance);
+        const Vector3<T> forward = normalized(orientation, orientationLength);
+
+        const T angle = FastMath::acos(dot(direction, forward)) * T(DegreesPerRadian);
+        const T x = minOf(maxOf((angle - T(inner)) * T(span), T(0.f)), T(1.f));
+        T gain = T(1.f) - x + T(outerGain) * x;
+        gain = select(angle >= T(outer), T(outerGain), gain);
+        gain = select(angle <= T(inner), T(1.f), gain);
+
+        // a source without an orientation, or at the listener, has no cone to be outside of
+        const T orientationExtent = maxOf(maxOf(absOf(orientation.x), absOf(orientation.y)), absOf(orientation.z));
+        gain = select(orientationExtent < T(FLT_EPSILON), T(1.f), gain);
+        gain = select(distance > T(0.f), gain, T(1.f));
+        store(gain, gains, i);
+    });
+}
+
+void SpatialBatch::azimuthElevations(const SpatialListener & listener, const SpatialSources & sources,
+                                     float * azimuths, float * elevations)
+{
+    const ListenerAxes axes(listener);
+
+    forEach(sources.count, [&](auto lanes, int i) {
+        using T = decltype(lanes);
+        const Vector3<T> offset = {load<T>(sources.x, i) - T(listener.position.x), load<T>(sources.y, i) - T(listener.position.y),
+                                   load<T>(sources.z, i) - T(listener.position.z)};
+        T distance(0.f), projectedLength(0.f);
+        const Vector3<T> direction = normalized(offset, distance);
+
+        const Vector3<T> up = splat<T>(axes.up);
+        const T upProjection = dot(direction, up);
+        const Vector3<T> projected = normalized(Vector3<T> {direction.x - upProjection * up.x, direction.y - upProjection * up.y,
+                                                            direction.z - upProjection * up.z},
+                                                projectedLength);
+
+        // a source straight above or below is ahead, as PannerNode resolves it
+        const T across = select(projectedLength > T(0.f), dot(projected, splat<T>(axes.right)), T(1.f));
+        T azimuth = FastMath::acos(across) * T(DegreesPerRadian);
+        azimuth = select(dot(projected, splat<T>(axes.front)) < T(0.f), T(360.f) - azimuth, azimuth);
+
+        // relative to the front rather than the right
+        azimuth = select(azimuth <= T(270.f), T(90.f) - azimuth, T(450.f) - azimuth);
+        const T elevation = T(90.f) - FastMath::acos(upProjection) * T(DegreesPerRadian);
+
+        // a source at the listener has no direction
+        store(select(distance > T(0.f), azimuth, T(0.f)), azimuths, i);
+        store(select(distance > T(0.f), elevation, T(0.f)), elevations, i);
+    });
+}
+
+}  // namespace lab
@@ -0,0 +1,172 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/SpectralAnalysis.h"
+#include "internal/FFTFrame.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/WindowFunctions.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+namespace lab
+{
+
+namespace
+{
+    // The analyses being shared, at most one per tap and sizes
+    struct Shared
+    {
+        const void * tap = nullptr;
+        int fftSize = 0;
+        int hopSize = 0;
+        std::weak_ptr<SpectralAnalysis> analysis;
+    };
+
+    const int MaxShared = 64;
+    Shared s_shared[MaxShared];
+    std::mutex s_sharedMutex;
+}
+
+SpectralAnalysis::SpectralAnalysis(int fftSize, int hopSize)
+    : m_fftSize(fftSize)
+    , m_hopSize(std::max(1, std::min(hopSize, fftSize)))
+    , m_window(WindowFunctionTable(WindowFunction::blackman, fftSize))
+    , m_frame(new FFTFrame(fftSize))
+    , m_windowed(fftSize)
+    , m_magnitudes(fftSize / 2)
+{
+    // room for a whole analysis frame, however far writing has run past the end of it
+    int ringSize = 1;
+    while (ringSize < fftSize * 2)
+        ringSize <<= 1;
+    m_ring.allocate(ringSize);
+    m_ringMask = ringSize - 1;
+}
+
+SpectralAnalysis::~SpectralAnalysis() {}
+
+void SpectralAnalysis::write(uint64_t frame, const AudioBus * bus, int framesToProcess)
+{
+    if (frame == m_lastWriteFrame || !bus || !bus->numberOfChannels())
+        return;
+    m_lastWriteFrame = frame;
+
+    const int channels = bus->numberOfChannels();
+    const float scale = 1.f / static_cast<float>(channels);
+    float * ring = m_ring.data();
+
+    // copy in as many as two runs, where the ring wraps
+    int written = 0;
+    while (written < framesToProcess)
+    {
+        const int index = static_cast<int>((m_written + written) & m_ringMask);
+        const int count = std::min(framesToProcess - written, m_ringMask + 1 - index);
+        float * dest = ring + index;
+
+        memcpy(dest, bus->channel(0)->data() + written, sizeof(float) * count);
+        for (int c = 1; c < channels; ++c)
+            VectorMath::vadd(dest, 1, bus->channel(c)->data() + written, 1, dest, 1, count);
+        if (channels > 1)
+            VectorMath::vsmul(dest, 1, &scale, dest, 1, count);
+
+        written += count;
+    }
+    m_written += framesToProcess;
+}
+
+void SpectralAnalysis::copyFramesEndingAt(uint64_t end, float * destination) const
+{
+    // before the ring has filled, the frames before the first are silent
+    const int ringSize = m_ringMask + 1;
+    const int start = static_cast<int>((end - m_fftSize) & m_ringMask);
+    const int first = std::min(m_fftSize, ringSize - start);
+    memcpy(destination, m_ring.data() + start, sizeof(float) * first);
+    memcpy(destination + first, m_ring.data(), sizeof(float) * (m_fftSize - first));
+}
+
+void SpectralAnalysis::copyLatestFrames(float * destination) const
+{
+    copyFramesEndingAt(m_written, destination);
+}
+
+const float * SpectralAnalysis::magnitudes()
+{
+    const uint64_t hop = hops();
+    if (hop == m_analysedHop)
+        return m_magnitudes.data();
+    m_analysedHop = hop;
+
+    copyFramesEndingAt(hop * m_hopSize, m_windowed.data());
+    VectorMath::vmul(m_windowed.data(), 1, m_window, 1, m_windowed.data(), 1, m_fftSize);
+    m_frame->computeForwardFFT(m_windowed.data());
+
+    const float * realP = m_frame->realData();
+    float * imagP = m_frame->imagData();
+
+    // Erase the packed nyquist component.
+    imagP[0] = 0;
+
+    float * magnitudes = m_magnitudes.data();
+    const int bins = binCount();
+    for (int i = 0; i < bins; ++i)
+        magnitudes[i] = std::sqrt(realP[i] * realP[i] + imagP[i] * imagP[i]);
+
+    return magnitudes;
+}
+
+void SpectralAnalysis::reset()
+{
+    m_ring.zero();
+    m_written = 0;
+    m_lastWriteFrame = ~uint64_t(0);
+    m_analysedHop = ~uint64_t(0);
+}
+
+std::shared_ptr<SpectralAnalysis> SpectralAnalysis::share(const void * tap, const std::shared_ptr<SpectralAnalysis> & own)
+{
+    if (!tap || !own)
+        return own;
+
+    std::unique_lock<std::mutex> lock(s_sharedMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return own;
+
+    Shared * vacant = nullptr;
+    for (Shared & shared : s_shared)
+    {
+        if (shared.tap == tap && shared.fftSize == own->fftSize() && shared.hopSize == own->hopSize())
+        {
+            if (std::shared_ptr<SpectralAnalysis> analysis = shared.analysis.lock())
+                return analysis;
+            vacant = &shared;
+            break;
+        }
+        if (!vacant && shared.analysis.expired())
+            vacant = &shared;
+    }
+
+    if (vacant)
+    {
+        vacant->tap = tap;
+        vacant->fftSize = own->fftSize();
+        vacant->hopSize = own->hopSize();
+        vacant->analysis = own;
+    }
+    return own;
+}
+
+const void * SpectralAnalysis::tapOf(ContextRenderLock & r, AudioNodeInput * input)
+{
+    if (!input || input->numberOfRenderingConnections(r) != 1)
+        return nullptr;
+    return input->renderingOutput(r, 0).get();
+}
+
+}  // namespace lab
@@ -0,0 +1,153 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/StateVariableFilter.h"
+
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+StateVariableFilter::Coefficients StateVariableFilter::design(FilterType type, double frequency, double Q, double dbGain)
+{
+    // keep the warped frequency finite at Nyquist
+    frequency = std::max(0.0, std::min(frequency, 0.9999));
+    const double g = std::tan(0.5 * static_cast<double>(LAB_PI) * frequency);
+    const double A = std::pow(10.0, dbGain / 40);
+    const double shelfDamping = std::sqrt(2.0);  // a slope of one, as for a Biquad's shelves
+
+    Coefficients c;
+    c.g = g;
+    switch (type)
+    {
+        case FilterType::LOWPASS:
+        case FilterType::HIGHPASS:
+        {
+            // Q is the resonance in decibels; the damping is that of the Biquad's design
+            const double resonance = std::pow(10.0, 0.05 * std::max(0.0, Q));
+            c.k = std::sqrt((4 - std::sqrt(16 - 16 / (resonance * resonance))) / 2);
+            if (type == FilterType::LOWPASS)
+            {
+                c.m0 = 0;
+                c.m2 = 1;
+            }
+            else
+            {
+                c.m1 = -c.k;
+                c.m2 = -1;
+            }
+            break;
+        }
+        case FilterType::BANDPASS:
+            c.k = 1 / std::max(Q, 1.e-4);
+            c.m0 = 0;
+            c.m1 = c.k;
+            break;
+        case FilterType::NOTCH:
+            c.k = 1 / std::max(Q, 1.e-4);
+            c.m1 = -c.k;
+            break;
+        case FilterType::ALLPASS:
+            c.k = 1 / std::max(Q, 1.e-4);
+            c.m1 = -2 * c.k;
+            break;
+        case FilterType::PEAKING:
+            c.k = 1 / (std::max(Q, 1.e-4) * A);
+            c.m1 = c.k * (A * A - 1);
+            break;
+        case FilterType::LOWSHELF:
+            c.g = g / std::sqrt(A);
+            c.k = shelfDamping;
+            c.m1 = c.k * (A - 1);
+            c.m2 = A * A - 1;
+            break;
+        case FilterType::HIGHSHELF:
+            c.g = g * std::sqrt(A);
+            c.k = shelfDamping;
+            c.m0 = A * A;
+            c.m1 = c.k * (1 - A) * A;
+            c.m2 = 1 - A * A;
+            break;
+        default:
+            break;
+    }
+    return c;
+}
+
+void StateVariableFilter::reset()
+{
+    std::fill(m_state.begin(), m_state.end(), 0.0);
+}
+
+void StateVariableFilter::process(const float * const * sources, float * const * destinations, int channels, int framesToProcess)
+{
+    run(sources, destinations, channels, framesToProcess, m_coefficients);
+}
+
+void StateVariableFilter::processRamped(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+                                        const Coefficients & target)
+{
+    if (framesToProcess > 0)
+        run(sources, destinations, channels, framesToProcess, target);
+    m_coefficients = target;
+}
+
+void StateVariableFilter::run(const float * const * sources, float * const * destinations, int channels, int framesToProcess,
+                              const Coefficients & target)
+{
+    // a channel that is added starts from rest
+    if (static_cast<int>(m_state.size()) < 2 * channels)
+        m_state.resize(2 * channels, 0.0);
+
+    const Coefficients & from = m_coefficients;
+    const double step = framesToProcess > 0 ? 1.0 / framesToProcess : 0.0;
+    const double dg = (target.g - from.g) * step;
+    const double dk = (target.k - from.k) * step;
+    const double dm0 = (target.m0 - from.m0) * step;
+    const double dm1 = (target.m1 - from.m1) * step;
+    const double dm2 = (target.m2 - from.m2) * step;
+    const bool constant = !dg && !dk && !dm0 && !dm1 && !dm2;
+
+    for (int c = 0; c < channels; ++c)
+    {
+        const float * source = sources[c];
+        float * destination = destinations[c];
+        double ic1 = m_state[2 * c];
+        double ic2 = m_state[2 * c + 1];
+
+        double g = from.g, k = from.k, m0 = from.m0, m1 = from.m1, m2 = from.m2;
+        double a1 = 1 / (1 + g * (g + k));
+        double a2 = g * a1;
+        double a3 = g * a2;
+        for (int i = 0; i < framesToProcess; ++i)
+        {
+            if (!constant)
+            {
+                g += dg;
+                k += dk;
+                m0 += dm0;
+                m1 += dm1;
+                m2 += dm2;
+                a1 = 1 / (1 + g * (g + k));
+                a2 = g * a1;
+                a3 = g * a2;
+            }
+
+            const double v0 = source[i];
+            const double v3 = v0 - ic2;
+            const double v1 = a1 * ic1 + a2 * v3;
+            const double v2 = ic2 + a2 * ic1 + a3 * v3;
+            ic1 = 2 * v1 - ic1;
+            ic2 = 2 * v2 - ic2;
+            destination[i] = static_cast<float>(m0 * v0 + m1 * v1 + m2 * v2);
+        }
+
+        m_state[2 * c] = ic1;
+        m_state[2 * c + 1] = ic2;
+    }
+}
+
+}  // namespace lab
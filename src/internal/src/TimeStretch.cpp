@@ -0,0 +1,380 @@
+// License: BSD 2 Clause
+// Copyright (C) 2020+, The LabSound Authors. All rights reserved.
+
+#include "internal/TimeStretch.h"
+#include "internal/FFTFrame.h"
+#include "internal/FastMath.h"
+#include "internal/Lanes4.h"
+
+#include "LabSound/core/Macros.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    const double TwoPi = 2.0 * LAB_PI;
+
+    inline float dot(const float * a, const float * b, int n)
+    {
+        Lanes4 sum4(0.f);
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+            sum4 = sum4 + Lanes4::load(a + i) * Lanes4::load(b + i);
+        float sum = sum4.sum();
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    // the average of each four frames
+    inline void decimate4(const float * source, int count, float * destination)
+    {
+        for (int i = 0; i < count; ++i)
+            destination[i] = 0.25f * (source[4 * i] + source[4 * i + 1] + source[4 * i + 2] + source[4 * i + 3]);
+    }
+
+    inline int powerOfTwoAtLeast(double frames)
+    {
+        int n = 64;
+        while (n < frames)
+            n *= 2;
+        return n;
+    }
+}
+
+struct TimeStretcher::Channel
+{
+    std::vector<float> accumulated;  // the grains overlapping the next size frames
+    std::vector<float> ready;        // the hop being played out
+    std::unique_ptr<FFTFrame> frame;
+    std::vector<float> analysisPhase;
+    std::vector<float> synthesisPhase;
+};
+
+TimeStretcher::TimeStretcher(float sampleRate)
+    : m_sampleRate(sampleRate)
+{
+}
+
+TimeStretcher::~TimeStretcher() = default;
+
+void TimeStretcher::start(Mode mode, int channels, double position)
+{
+    // speech grains of about 20 ms, and music frames of about 40
+    const int size = mode == Music ? powerOfTwoAtLeast(0.04 * m_sampleRate) : powerOfTwoAtLeast(0.02 * m_sampleRate);
+    if (mode != m_mode || size != m_size || channels > static_cast<int>(m_channelState.size()))
+    {
+        m_mode = mode;
+        m_size = size;
+        m_hop = mode == Music ? size / 4 : size / 2;
+        m_tolerance = mode == Music ? 0 : size / 4;
+
+        // a periodic Hann window; half overlapping, its copies sum to one
+        m_window.resize(size);
+        for (int i = 0; i < size; ++i)
+            m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(TwoPi * i / size));
+
+        // the phase vocoder's frames are windowed twice, and the synthesis window is normalized
+        // so that the overlapping squares sum to one
+        m_synthesis.resize(size);
+        for (int i = 0; i < m_hop; ++i)
+        {
+            float sum = 0.f;
+            for (int j = i; j < size; j += m_hop)
+                sum += m_window[j] * m_window[j];
+            for (int j = i; j < size; j += m_hop)
+                m_synthesis[j] = sum > 1e-6f ? m_window[j] / sum : 0.f;
+        }
+
+        const int longest = size + 2 * m_tolerance;
+        m_span.resize(size_t(longest) * MaxPitch + 8);
+        m_mono.resize(longest);
+        m_reference.resize(longest);
+        m_region.resize(longest);
+        m_grain.resize(longest);
+        m_magnitude.resize(size / 2 + 1);
+        m_phase.resize(size / 2 + 1);
+        m_rotation.resize(size / 2 + 1);
+        m_peaks.reserve(size / 2);
+
+        m_channelState.clear();
+        for (int c = 0; c < std::max(channels, 1); ++c)
+        {
+            std::unique_ptr<Channel> channel(new Channel());
+            channel->accumulated.resize(size);
+            channel->ready.resize(m_hop);
+            if (mode == Music)
+            {
+                channel->frame.reset(new FFTFrame(size));
+                channel->analysisPhase.resize(size / 2 + 1);
+                channel->synthesisPhase.resize(size / 2 + 1);
+            }
+            m_channelState.push_back(std::move(channel));
+        }
+    }
+
+    for (auto & channel : m_channelState)
+    {
+        std::fill(channel->accumulated.begin(), channel->accumulated.end(), 0.f);
+        std::fill(channel->ready.begin(), channel->ready.end(), 0.f);
+    }
+
+    m_channels = channels;
+    m_position = position;
+    m_previous = position;
+    m_fill = m_hop;
+    m_first = true;
+}
+
+void TimeStretcher::rewind(double frames)
+{
+    m_position -= frames;
+    m_previous -= frames;
+}
+
+void TimeStretcher::readResampled(Reader & reader, int channel, double position, double pitch, int count, float * destination)
+{
+    const int first = static_cast<int>(std::floor(position));
+    const double fraction = position - first;
+    const int needed = static_cast<int>(std::ceil(fraction + (count - 1) * pitch)) + 2;
+    float * span = m_span.data();
+    reader.read(channel, first, needed, span);
+
+    if (pitch == 1.0 && fraction == 0.0)
+    {
+        std::memcpy(destination, span, sizeof(float) * count);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        const double x = fraction + i * pitch;
+        const int k = static_cast<int>(x);
+        const float t = static_cast<float>(x - k);
+        destination[i] = span[k] + t * (span[k + 1] - span[k]);
+    }
+}
+
+void TimeStretcher::readMono(Reader & reader, double position, double pitch, int count, float * destination)
+{
+    std::fill(destination, destination + count, 0.f);
+    for (int c = 0; c < m_channels; ++c)
+    {
+        readResampled(reader, c, position, pitch, count, m_mono.data());
+        VectorMath::vadd(m_mono.data(), 1, destination, 1, destination, 1, count);
+    }
+}
+
+// The offset into region, of up to offsets, at which length frames best match reference, by
+// their correlation over the region's level there. Coarsely every four frames, then finely.
+int TimeStretcher::bestOffset(const float * reference, int length, const float * region, int offsets)
+{
+    const int step = 4;
+    // the decimated copies are made in buffers free until the grains are read
+    float * reference4 = m_mono.data();
+    float * region4 = m_grain.data();
+    const int length4 = length / step;
+    const int offsets4 = offsets / step;
+    decimate4(reference, length4, reference4);
+    decimate4(region, length4 + offsets4, region4);
+
+    int best = 0;
+    float bestScore = -1e30f;
+    float energy = dot(region4, region4, length4);
+    for (int o = 0; o <= offsets4; ++o)
+    {
+        const float score = dot(reference4, region4 + o, length4) / std::sqrt(energy + 1e-9f);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = o;
+        }
+        if (o < offsets4)
+            energy = std::max(0.f, energy - region4[o] * region4[o] + region4[o + length4] * region4[o + length4]);
+    }
+
+    const int coarse = best * step;
+    best = coarse;
+    bestScore = -1e30f;
+    for (int o = std::max(0, coarse - step + 1); o <= std::min(offsets, coarse + step - 1); ++o)
+    {
+        const float score = dot(reference, region + o, length) / std::sqrt(dot(region + o, region + o, length) + 1e-9f);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = o;
+        }
+    }
+    return best;
+}
+
+void TimeStretcher::overlapAdd(Channel & channel, const float * grain, const float * window)
+{
+    float * accumulated = channel.accumulated.data();
+    VectorMath::vmadd(grain, 1, window, 1, accumulated, 1, m_size);
+    std::memcpy(channel.ready.data(), accumulated, sizeof(float) * m_hop);
+    std::memmove(accumulated, accumulated + m_hop, sizeof(float) * (m_size - m_hop));
+    std::memset(accumulated + m_size - m_hop, 0, sizeof(float) * m_hop);
+}
+
+void TimeStretcher::synthesizeSpeech(Reader & reader, double tempo, double pitch)
+{
+    double take = m_position;
+    if (!m_first)
+    {
+        // how the last grain would have gone on, and where this one may come from around its place
+        readMono(reader, m_previous + m_hop * pitch, pitch, m_hop, m_reference.data());
+        readMono(reader, m_position - m_tolerance * pitch, pitch, m_hop + 2 * m_tolerance, m_region.data());
+        take = m_position + (bestOffset(m_reference.data(), m_hop, m_region.data(), 2 * m_tolerance) - m_tolerance) * pitch;
+    }
+
+    for (int c = 0; c < m_channels; ++c)
+    {
+        Channel & channel = *m_channelState[c];
+        readResampled(reader, c, take, pitch, m_size, m_grain.data());
+
+        // the first grain starts at full level, rather than fading in
+        if (m_first)
+        {
+            std::memcpy(channel.accumulated.data(), m_grain.data(), sizeof(float) * m_hop);
+            std::fill(m_grain.begin(), m_grain.begin() + m_hop, 0.f);
+        }
+        overlapAdd(channel, m_grain.data(), m_window.data());
+    }
+
+    m_previous = take;
+    m_position += m_hop * tempo;
+    m_first = false;
+}
+
+void TimeStretcher::synthesizeMusic(Reader & reader, double tempo, double pitch)
+{
+    // the analysis hop, in the resampled frames the frames are read as
+    const double analysisHop = std::max(m_hop * tempo / pitch, 1e-3);
+    const int bins = m_size / 2;
+    float * magnitude = m_magnitude.data();
+    float * phase = m_phase.data();
+    float * rotation = m_rotation.data();
+
+    for (int c = 0; c < m_channels; ++c)
+    {
+        Channel & channel = *m_channelState[c];
+        readResampled(reader, c, m_position, pitch, m_size, m_grain.data());
+        VectorMath::vmul(m_grain.data(), 1, m_window.data(), 1, m_grain.data(), 1, m_size);
+        channel.frame->computeForwardFFT(m_grain.data());
+
+        // DC and nyquist are left as they are, so that every FFT layout is handled alike
+        float * real = channel.frame->realData();
+        float * imag = channel.frame->imagData();
+        int k = 1;
+        for (; k + 4 <= bins; k += 4)
+        {
+            const Lanes4 re = Lanes4::load(real + k);
+            const Lanes4 im = Lanes4::load(imag + k);
+            sqrtOf(re * re + im * im).store(magnitude + k);
+            FastMath::atan2(im, re).store(phase + k);
+        }
+        for (; k < bins; ++k)
+        {
+            magnitude[k] = std::sqrt(real[k] * real[k] + imag[k] * imag[k]);
+            phase[k] = FastMath::atan2(imag[k], real[k]);
+        }
+
+        m_peaks.clear();
+        for (k = 1; k < bins; ++k)
+            if (magnitude[k] > magnitude[k - 1] && (k + 1 == bins || magnitude[k] >= magnitude[k + 1]))
+                m_peaks.push_back(k);
+
+        // Each peak's phase advances by its frequency, from how far its phase moved beyond
+        // what its bin's center would, and the bins nearer it than any other peak turn with it.
+        std::fill(rotation, rotation + bins, 0.f);
+        for (size_t p = 0; p < m_peaks.size(); ++p)
+        {
+            const int peak = m_peaks[p];
+            float synthesis = phase[peak];
+            if (!m_first)
+            {
+                const double omega = TwoPi * peak / m_size;
+                double deviation = phase[peak] - channel.analysisPhase[peak] - omega * analysisHop;
+                deviation -= TwoPi * std::floor(deviation / TwoPi + 0.5);
+                const double advanced = channel.synthesisPhase[peak] + (omega + deviation / analysisHop) * m_hop;
+                synthesis = static_cast<float>(advanced - TwoPi * std::floor(advanced / TwoPi + 0.5));
+            }
+
+            const int low = p == 0 ? 1 : (m_peaks[p - 1] + peak) / 2 + 1;
+            const int high = p + 1 == m_peaks.size() ? bins : (peak + m_peaks[p + 1]) / 2 + 1;
+            std::fill(rotation + low, rotation + high, synthesis - phase[peak]);
+        }
+
+        std::memcpy(channel.analysisPhase.data() + 1, phase + 1, sizeof(float) * (bins - 1));
+        float * synthesisPhase = channel.synthesisPhase.data();
+        for (k = 1; k + 4 <= bins; k += 4)
+        {
+            const Lanes4 synthesis = Lanes4::load(phase + k) + Lanes4::load(rotation + k);
+            const Lanes4 m = Lanes4::load(magnitude + k);
+            Lanes4 sine(0.f), cosine(0.f);
+            FastMath::sinCos(synthesis, sine, cosine);
+            synthesis.store(synthesisPhase + k);
+            (m * cosine).store(real + k);
+            (m * sine).store(imag + k);
+        }
+        for (; k < bins; ++k)
+        {
+            const float synthesis = phase[k] + rotation[k];
+            float sine, cosine;
+            FastMath::sinCos(synthesis, sine, cosine);
+            synthesisPhase[k] = synthesis;
+            real[k] = magnitude[k] * cosine;
+            imag[k] = magnitude[k] * sine;
+        }
+
+        channel.frame->computeInverseFFT(m_grain.data());
+        overlapAdd(channel, m_grain.data(), m_synthesis.data());
+    }
+
+    m_position += m_hop * tempo;
+    m_first = false;
+}
+
+void TimeStretcher::render(Reader & reader, float * const * out, int frames, double tempo, double pitch, float gain)
+{
+    tempo = std::min(std::max(tempo, 1.0 / 16), 8.0);
+    pitch = std::min(std::max(pitch, 1.0 / MaxPitch), static_cast<double>(MaxPitch));
+
+    // The phase vocoder starts the frames overlapping the first earlier, and discards what
+    // they play before it, so that the sound doesn't fade in. They are a hop of their own
+    // apart, with the tempo at the pitch, so that each is read where it plays at the start.
+    if (m_first && m_mode == Music)
+    {
+        const int earlier = m_size / m_hop - 1;
+        m_position -= earlier * m_hop * pitch;
+        for (int i = 0; i < earlier; ++i)
+            synthesizeMusic(reader, pitch, pitch);
+    }
+
+    for (int done = 0; done < frames;)
+    {
+        if (m_fill == m_hop)
+        {
+            if (m_mode == Music)
+                synthesizeMusic(reader, tempo, pitch);
+            else
+                synthesizeSpeech(reader, tempo, pitch);
+            m_fill = 0;
+        }
+
+        const int count = std::min(frames - done, m_hop - m_fill);
+        for (int c = 0; c < m_channels; ++c)
+            VectorMath::vsma(m_channelState[c]->ready.data() + m_fill, 1, &gain, out[c] + done, 1, count);
+        m_fill += count;
+        done += count;
+    }
+}
+
+}  // namespace lab
@@ -0,0 +1,206 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/UdpSocket.h"
+
+#include "LabSound/core/Macros.h"
+
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+#else
+  #include <errno.h>
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <poll.h>
+  #include <string.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+namespace lab
+{
+
+namespace
+{
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+    typedef SOCKET NativeSocket;
+    const NativeSocket InvalidSocket = INVALID_SOCKET;
+
+    void closeNative(NativeSocket s) { closesocket(s); }
+
+    // Winsock counts its startups, so each socket starts it and cleans it up
+    bool startNetworking(std::string & error)
+    {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) == 0)
+            return true;
+        error = "Winsock couldn't be started";
+        return false;
+    }
+    void stopNetworking() { WSACleanup(); }
+    std::string lastError() { return "socket error " + std::to_string(WSAGetLastError()); }
+#else
+    typedef int NativeSocket;
+    const NativeSocket InvalidSocket = -1;
+
+    void closeNative(NativeSocket s) { ::close(s); }
+    bool startNetworking(std::string &) { return true; }
+    void stopNetworking() {}
+    std::string lastError() { return strerror(errno); }
+#endif
+
+    // Resolves a datagram address. A null host with passive set is every local interface.
+    addrinfo * resolve(const char * host, uint16_t port, bool passive, std::string & error)
+    {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_protocol = IPPROTO_UDP;
+        if (passive)
+            hints.ai_flags = AI_PASSIVE;
+
+        addrinfo * result = nullptr;
+        const std::string service = std::to_string(port);
+        const int status = getaddrinfo(host, service.c_str(), &hints, &result);
+        if (status != 0 || !result)
+        {
+            error = std::string("couldn't resolve ") + (host ? host : "the local address") + ": " + gai_strerror(status);
+            return nullptr;
+        }
+        return result;
+    }
+}
+
+UdpSocket::~UdpSocket()
+{
+    if (_socket != -1)
+    {
+        closeNative(static_cast<NativeSocket>(_socket));
+        stopNetworking();
+    }
+}
+
+std::unique_ptr<UdpSocket> UdpSocket::connect(const std::string & host, uint16_t port, std::string & error)
+{
+    if (!startNetworking(error))
+        return nullptr;
+
+    addrinfo * addresses = resolve(host.c_str(), port, false, error);
+    NativeSocket s = InvalidSocket;
+    for (addrinfo * a = addresses; a && s == InvalidSocket; a = a->ai_next)
+    {
+        s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == InvalidSocket)
+            continue;
+        if (::connect(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0)
+        {
+            error = lastError();
+            closeNative(s);
+            s = InvalidSocket;
+            continue;
+        }
+
+        // DSCP expedited forwarding; not every network or platform honors it
+        const int tos = 0xb8;
+        if (a->ai_family == AF_INET)
+            setsockopt(s, IPPROTO_IP, IP_TOS, reinterpret_cast<const char *>(&tos), sizeof(tos));
+#if defined(IPV6_TCLASS)
+        else
+            setsockopt(s, IPPROTO_IPV6, IPV6_TCLASS, reinterpret_cast<const char *>(&tos), sizeof(tos));
+#endif
+    }
+    if (addresses)
+        freeaddrinfo(addresses);
+
+    if (s == InvalidSocket)
+    {
+        stopNetworking();
+        return nullptr;
+    }
+    std::unique_ptr<UdpSocket> result(new UdpSocket());
+    result->_socket = static_cast<intptr_t>(s);
+    return result;
+}
+
+std::unique_ptr<UdpSocket> UdpSocket::bind(const std::string & address, uint16_t port, std::string & error)
+{
+    if (!startNetworking(error))
+        return nullptr;
+
+    addrinfo * addresses = resolve(address.empty() ? nullptr : address.c_str(), port, true, error);
+    NativeSocket s = InvalidSocket;
+    for (addrinfo * a = addresses; a && s == InvalidSocket; a = a->ai_next)
+    {
+        s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == InvalidSocket)
+            continue;
+
+        // an IPv6 socket on every interface takes IPv4 as well, where the platform allows
+        if (a->ai_family == AF_INET6)
+        {
+            const int v6only = 0;
+            setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char *>(&v6only), sizeof(v6only));
+        }
+
+        // a larger receive buffer rides out a burst of packets while the receiver is descheduled
+        const int bufferBytes = 1 << 18;
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&bufferBytes), sizeof(bufferBytes));
+
+        if (::bind(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0)
+        {
+            error = lastError();
+            closeNative(s);
+            s = InvalidSocket;
+        }
+    }
+    if (addresses)
+        freeaddrinfo(addresses);
+
+    if (s == InvalidSocket)
+    {
+        stopNetworking();
+        return nullptr;
+    }
+    std::unique_ptr<UdpSocket> result(new UdpSocket());
+    result->_socket = static_cast<intptr_t>(s);
+    return result;
+}
+
+bool UdpSocket::send(const void * data, size_t bytes)
+{
+    const NativeSocket s = static_cast<NativeSocket>(_socket);
+    return ::send(s, reinterpret_cast<const char *>(data), static_cast<int>(bytes), 0) == static_cast<int>(bytes);
+}
+
+int UdpSocket::receive(void * data, size_t capacity, int timeoutMilliseconds)
+{
+    const NativeSocket s = static_cast<NativeSocket>(_socket);
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+    WSAPOLLFD descriptor = {};
+    descriptor.fd = s;
+    descriptor.events = POLLRDNORM;
+    const int ready = WSAPoll(&descriptor, 1, timeoutMilliseconds);
+#else
+    pollfd descriptor = {};
+    descriptor.fd = s;
+    descriptor.events = POLLIN;
+    const int ready = poll(&descriptor, 1, timeoutMilliseconds);
+#endif
+    if (ready < 0)
+        return -1;
+    if (ready == 0)
+        return 0;
+
+    const int bytes = ::recv(s, reinterpret_cast<char *>(data), static_cast<int>(capacity), 0);
+#if defined(LABSOUND_PLATFORM_WINDOWS)
+    // a truncated datagram is still delivered
+    if (bytes < 0 && WSAGetLastError() == WSAEMSGSIZE)
+        return static_cast<int>(capacity);
+#endif
+    return bytes;
+}
+
+}  // namespace lab
@@ -33,6 +33,9 @@
 #include "UpSampler.h"
 #include "internal/Assertions.h"
 #include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <string.h>
 //#include <wtf/MathExtras.h>
 
 namespace lab {
@@ -76,16 +79,6 @@ void UpSampler::initializeKernel()
 
 void UpSampler::process(const float* sourceP, float* destP, size_t sourceFramesToProcess)
 {
-    bool isInputBlockSizeGood = sourceFramesToProcess == m_inputBlockSize;
-    ASSERT(isInputBlockSizeGood);
-    if (!isInputBlockSizeGood)
-        return;
-
-    bool isTempBufferGood = sourceFramesToProcess == m_tempBuffer.size();
-    ASSERT(isTempBufferGood);
-    if (!isTempBufferGood)
-        return;
-
     bool isKernelGood = m_kernel.size() == DefaultKernelSize;
     ASSERT(isKernelGood);
     if (!isKernelGood)
@@ -93,28 +86,38 @@ void UpSampler::process(const float* sourceP, float* destP, size_t sourceFramesT
 
     size_t halfSize = m_kernel.size() / 2;
 
-    // Copy source samples to 2nd half of input buffer.
-    bool isInputBufferGood = m_inputBuffer.size() == sourceFramesToProcess * 2 && halfSize <= sourceFramesToProcess;
+    bool isInputBufferGood = m_inputBuffer.size() == m_inputBlockSize * 2 && halfSize <= m_inputBlockSize && m_tempBuffer.size() == m_inputBlockSize;
     ASSERT(isInputBufferGood);
     if (!isInputBufferGood)
         return;
 
-    float* inputP = m_inputBuffer.data() + sourceFramesToProcess;
-    memcpy(inputP, sourceP, sizeof(float) * sourceFramesToProcess);
+    // Blocks of any size are processed up to m_inputBlockSize frames at a time, after each
+    // of which the delay line slides along.
+    float* inputP = m_inputBuffer.data() + m_inputBlockSize;
+    float* oddSamplesP = m_tempBuffer.data();
+    while (sourceFramesToProcess) {
+        const size_t n = std::min(sourceFramesToProcess, m_inputBlockSize);
 
-    // Copy even sample-frames 0,2,4,6... (delayed by the linear phase delay) directly into destP.
-    for (unsigned i = 0; i < sourceFramesToProcess; ++i)
-        destP[i * 2] = *((inputP - halfSize) + i);
+        // Copy source samples to 2nd half of input buffer.
+        memcpy(inputP, sourceP, sizeof(float) * n);
 
-    // Compute odd sample-frames 1,3,5,7...
-    float* oddSamplesP = m_tempBuffer.data();
-    m_convolver.process(&m_kernel, sourceP, oddSamplesP, sourceFramesToProcess);
+        // Compute odd sample-frames 1,3,5,7...
+        m_convolver.process(&m_kernel, sourceP, oddSamplesP, n);
 
-    for (unsigned i = 0; i < sourceFramesToProcess - 1; ++i)
-        destP[i * 2 + 1] = oddSamplesP[i];
+        // Interleave them with the even sample-frames 0,2,4,6..., which are the source delayed
+        // by the linear phase delay.
+        const float* delayedP = inputP - halfSize;
+        for (size_t i = 0; i < n; ++i) {
+            destP[i * 2] = delayedP[i];
+            destP[i * 2 + 1] = oddSamplesP[i];
+        }
 
-    // Copy 2nd half of input buffer to 1st half.
-    memcpy(m_inputBuffer.data(), inputP, sizeof(float) * sourceFramesToProcess);
+        memmove(m_inputBuffer.data(), m_inputBuffer.data() + n, sizeof(float) * m_inputBlockSize);
+
+        sourceP += n;
+        destP += n * 2;
+        sourceFramesToProcess -= n;
+    }
 }
 
 void UpSampler::reset()
@@ -6,6 +6,7 @@
 #include "internal/Assertions.h"
 
 #include "LabSound/extended/VectorMath.h"
+#include "internal/VectorMathWide.h"
 
 #if defined(LABSOUND_PLATFORM_OSX)
 #include <Accelerate/Accelerate.h>
@@ -19,9 +20,14 @@
 #include <arm_neon.h>
 #endif
 
+#if defined(WASM_SIMD128_INTRINSICS)
+#include <wasm_simd128.h>
+#endif
+
 #include <cstdint>
 #include <algorithm>
 #include <math.h>
+#include <string.h>
 
 namespace lab
 {
@@ -79,11 +85,30 @@ namespace VectorMath
 #endif
     }
 
+    void zvmadd(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess)
+    {
+        DSPSplitComplex sc1;
+        DSPSplitComplex sc2;
+        DSPSplitComplex dest;
+        sc1.realp = const_cast<float *>(real1P);
+        sc1.imagp = const_cast<float *>(imag1P);
+        sc2.realp = const_cast<float *>(real2P);
+        sc2.imagp = const_cast<float *>(imag2P);
+        dest.realp = realDestP;
+        dest.imagp = imagDestP;
+        vDSP_zvma(&sc1, 1, &sc2, 1, &dest, 1, &dest, 1, framesToProcess);
+    }
+
     void vsma(const float * sourceP, int sourceStride, const float * scale, float * destP, int destStride, int framesToProcess)
     {
         vDSP_vsma(sourceP, sourceStride, scale, destP, destStride, destP, destStride, framesToProcess);
     }
 
+    void vmadd(const float * source1P, int sourceStride1, const float * source2P, int sourceStride2, float * destP, int destStride, int framesToProcess)
+    {
+        vDSP_vma(source1P, sourceStride1, source2P, sourceStride2, destP, destStride, destP, destStride, framesToProcess);
+    }
+
     void vmaxmgv(const float * sourceP, int sourceStride, float * maxP, int framesToProcess)
     {
         vDSP_maxmgv(sourceP, sourceStride, maxP, framesToProcess);
@@ -100,8 +125,25 @@ namespace VectorMath
     }
 #else
 
+#if defined(LABSOUND_VECTORMATH_WIDE)
+    // Chosen once, during static initialization. Anything that runs before
+    // then sees nullptr, and uses the SSE2 paths below.
+    static const WideKernels * const s_wideKernels = selectWideKernels();
+
+#define WIDE_DISPATCH(condition, call) \
+    if (s_wideKernels && (condition))  \
+    {                                  \
+        call;                          \
+        return;                        \
+    }
+#else
+#define WIDE_DISPATCH(condition, call)
+#endif
+
     void vsma(const float * sourceP, int sourceStride, const float * scale, float * destP, int destStride, int framesToProcess)
     {
+        WIDE_DISPATCH(sourceStride == 1 && destStride == 1, s_wideKernels->vsma(sourceP, *scale, destP, framesToProcess))
+
         int n = framesToProcess;
 
 #ifdef __SSE2__
@@ -168,6 +210,24 @@ namespace VectorMath
             }
             n = tailFrames;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if ((sourceStride == 1) && (destStride == 1))
+        {
+            int tailFrames = n % 4;
+            const float * endP = destP + n - tailFrames;
+
+            v128_t k = wasm_f32x4_splat(*scale);
+            while (destP < endP)
+            {
+                v128_t source = wasm_v128_load(sourceP);
+                v128_t dest = wasm_v128_load(destP);
+                wasm_v128_store(destP, wasm_f32x4_add(dest, wasm_f32x4_mul(source, k)));
+
+                sourceP += 4;
+                destP += 4;
+            }
+            n = tailFrames;
+        }
 #endif
         while (n)
         {
@@ -180,6 +240,8 @@ namespace VectorMath
 
     void vsmul(const float * sourceP, int sourceStride, const float * scale, float * destP, int destStride, int framesToProcess)
     {
+        WIDE_DISPATCH(sourceStride == 1 && destStride == 1, s_wideKernels->vsmul(sourceP, *scale, destP, framesToProcess))
+
         int n = framesToProcess;
 
 #ifdef __SSE2__
@@ -257,6 +319,22 @@ namespace VectorMath
             }
             n = tailFrames;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if ((sourceStride == 1) && (destStride == 1))
+        {
+            int tailFrames = n % 4;
+            const float * endP = destP + n - tailFrames;
+
+            v128_t k = wasm_f32x4_splat(*scale);
+            while (destP < endP)
+            {
+                wasm_v128_store(destP, wasm_f32x4_mul(wasm_v128_load(sourceP), k));
+
+                sourceP += 4;
+                destP += 4;
+            }
+            n = tailFrames;
+        }
 #endif
             float k = *scale;
             while (n--)
@@ -272,6 +350,8 @@ namespace VectorMath
 
     void vadd(const float * source1P, int sourceStride1, const float * source2P, int sourceStride2, float * destP, int destStride, int framesToProcess)
     {
+        WIDE_DISPATCH(sourceStride1 == 1 && sourceStride2 == 1 && destStride == 1, s_wideKernels->vadd(source1P, source2P, destP, framesToProcess))
+
         int n = framesToProcess;
 
 #ifdef __SSE2__
@@ -386,6 +466,24 @@ namespace VectorMath
             }
             n = tailFrames;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if ((sourceStride1 == 1) && (sourceStride2 == 1) && (destStride == 1))
+        {
+            int tailFrames = n % 4;
+            const float * endP = destP + n - tailFrames;
+
+            while (destP < endP)
+            {
+                v128_t source1 = wasm_v128_load(source1P);
+                v128_t source2 = wasm_v128_load(source2P);
+                wasm_v128_store(destP, wasm_f32x4_add(source1, source2));
+
+                source1P += 4;
+                source2P += 4;
+                destP += 4;
+            }
+            n = tailFrames;
+        }
 #endif
             while (n--)
             {
@@ -401,6 +499,8 @@ namespace VectorMath
 
     void vmul(const float * source1P, int sourceStride1, const float * source2P, int sourceStride2, float * destP, int destStride, int framesToProcess)
     {
+        WIDE_DISPATCH(sourceStride1 == 1 && sourceStride2 == 1 && destStride == 1, s_wideKernels->vmul(source1P, source2P, destP, framesToProcess))
+
 
         int n = framesToProcess;
 
@@ -468,6 +568,24 @@ namespace VectorMath
             }
             n = tailFrames;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if ((sourceStride1 == 1) && (sourceStride2 == 1) && (destStride == 1))
+        {
+            int tailFrames = n % 4;
+            const float * endP = destP + n - tailFrames;
+
+            while (destP < endP)
+            {
+                v128_t source1 = wasm_v128_load(source1P);
+                v128_t source2 = wasm_v128_load(source2P);
+                wasm_v128_store(destP, wasm_f32x4_mul(source1, source2));
+
+                source1P += 4;
+                source2P += 4;
+                destP += 4;
+            }
+            n = tailFrames;
+        }
 #endif
         while (n)
         {
@@ -479,8 +597,32 @@ namespace VectorMath
         }
     }
 
+    void vmadd(const float * source1P, int sourceStride1, const float * source2P, int sourceStride2, float * destP, int destStride, int framesToProcess)
+    {
+        WIDE_DISPATCH(sourceStride1 == 1 && sourceStride2 == 1 && destStride == 1, s_wideKernels->vmadd(source1P, source2P, destP, framesToProcess))
+
+        // Written so that the compiler can vectorize the unit stride case without intrinsics.
+        if ((sourceStride1 == 1) && (sourceStride2 == 1) && (destStride == 1))
+        {
+            for (int i = 0; i < framesToProcess; ++i)
+                destP[i] += source1P[i] * source2P[i];
+            return;
+        }
+
+        int n = framesToProcess;
+        while (n--)
+        {
+            *destP += *source1P * *source2P;
+            source1P += sourceStride1;
+            source2P += sourceStride2;
+            destP += destStride;
+        }
+    }
+
     void zvmul(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess)
     {
+        WIDE_DISPATCH(true, s_wideKernels->zvmul(real1P, imag1P, real2P, imag2P, realDestP, imagDestP, framesToProcess))
+
         int i = 0;
 #ifdef __SSE2__
         // Only use the SSE optimization in the very common case that all addresses are 16-byte aligned.
@@ -524,6 +666,23 @@ namespace VectorMath
             vst1q_f32(realDestP + i, realResult);
             vst1q_f32(imagDestP + i, imagResult);
 
+            i += 4;
+        }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            v128_t real1 = wasm_v128_load(real1P + i);
+            v128_t real2 = wasm_v128_load(real2P + i);
+            v128_t imag1 = wasm_v128_load(imag1P + i);
+            v128_t imag2 = wasm_v128_load(imag2P + i);
+
+            v128_t realResult = wasm_f32x4_sub(wasm_f32x4_mul(real1, real2), wasm_f32x4_mul(imag1, imag2));
+            v128_t imagResult = wasm_f32x4_add(wasm_f32x4_mul(real1, imag2), wasm_f32x4_mul(imag1, real2));
+
+            wasm_v128_store(realDestP + i, realResult);
+            wasm_v128_store(imagDestP + i, imagResult);
+
             i += 4;
         }
 #endif
@@ -539,8 +698,71 @@ namespace VectorMath
         }
     }
 
+    void zvmadd(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P, float * realDestP, float * imagDestP, int framesToProcess)
+    {
+        WIDE_DISPATCH(true, s_wideKernels->zvmadd(real1P, imag1P, real2P, imag2P, realDestP, imagDestP, framesToProcess))
+
+        int i = 0;
+#ifdef __SSE2__
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            __m128 real1 = _mm_loadu_ps(real1P + i);
+            __m128 real2 = _mm_loadu_ps(real2P + i);
+            __m128 imag1 = _mm_loadu_ps(imag1P + i);
+            __m128 imag2 = _mm_loadu_ps(imag2P + i);
+            __m128 real = _mm_sub_ps(_mm_mul_ps(real1, real2), _mm_mul_ps(imag1, imag2));
+            __m128 imag = _mm_add_ps(_mm_mul_ps(real1, imag2), _mm_mul_ps(imag1, real2));
+            _mm_storeu_ps(realDestP + i, _mm_add_ps(_mm_loadu_ps(realDestP + i), real));
+            _mm_storeu_ps(imagDestP + i, _mm_add_ps(_mm_loadu_ps(imagDestP + i), imag));
+            i += 4;
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            float32x4_t real1 = vld1q_f32(real1P + i);
+            float32x4_t real2 = vld1q_f32(real2P + i);
+            float32x4_t imag1 = vld1q_f32(imag1P + i);
+            float32x4_t imag2 = vld1q_f32(imag2P + i);
+
+            float32x4_t realResult = vmlsq_f32(vmlaq_f32(vld1q_f32(realDestP + i), real1, real2), imag1, imag2);
+            float32x4_t imagResult = vmlaq_f32(vmlaq_f32(vld1q_f32(imagDestP + i), real1, imag2), imag1, real2);
+
+            vst1q_f32(realDestP + i, realResult);
+            vst1q_f32(imagDestP + i, imagResult);
+
+            i += 4;
+        }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            v128_t real1 = wasm_v128_load(real1P + i);
+            v128_t real2 = wasm_v128_load(real2P + i);
+            v128_t imag1 = wasm_v128_load(imag1P + i);
+            v128_t imag2 = wasm_v128_load(imag2P + i);
+
+            v128_t real = wasm_f32x4_sub(wasm_f32x4_mul(real1, real2), wasm_f32x4_mul(imag1, imag2));
+            v128_t imag = wasm_f32x4_add(wasm_f32x4_mul(real1, imag2), wasm_f32x4_mul(imag1, real2));
+
+            wasm_v128_store(realDestP + i, wasm_f32x4_add(wasm_v128_load(realDestP + i), real));
+            wasm_v128_store(imagDestP + i, wasm_f32x4_add(wasm_v128_load(imagDestP + i), imag));
+
+            i += 4;
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            realDestP[i] += real1P[i] * real2P[i] - imag1P[i] * imag2P[i];
+            imagDestP[i] += real1P[i] * imag2P[i] + imag1P[i] * real2P[i];
+        }
+    }
+
     void vsvesq(const float * sourceP, int sourceStride, float * sumP, int framesToProcess)
     {
+        WIDE_DISPATCH(sourceStride == 1, *sumP = s_wideKernels->vsvesq(sourceP, framesToProcess))
+
         int n = framesToProcess;
         float sum = 0;
 
@@ -595,6 +817,24 @@ namespace VectorMath
             vst1_f32(groupSum, twoSum);
             sum += groupSum[0] + groupSum[1];
 
+            n = tailFrames;
+        }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if (sourceStride == 1)
+        {
+            int tailFrames = n % 4;
+            const float * endP = sourceP + n - tailFrames;
+
+            v128_t fourSum = wasm_f32x4_splat(0);
+            while (sourceP < endP)
+            {
+                v128_t source = wasm_v128_load(sourceP);
+                fourSum = wasm_f32x4_add(fourSum, wasm_f32x4_mul(source, source));
+                sourceP += 4;
+            }
+            v128_t twoSum = wasm_f32x4_add(fourSum, wasm_i32x4_shuffle(fourSum, fourSum, 2, 3, 0, 1));
+            sum += wasm_f32x4_extract_lane(twoSum, 0) + wasm_f32x4_extract_lane(twoSum, 1);
+
             n = tailFrames;
         }
 #endif
@@ -612,6 +852,8 @@ namespace VectorMath
 
     void vmaxmgv(const float * sourceP, int sourceStride, float * maxP, int framesToProcess)
     {
+        WIDE_DISPATCH(sourceStride == 1, *maxP = s_wideKernels->vmaxmgv(sourceP, framesToProcess))
+
         int n = framesToProcess;
         float max = 0;
 
@@ -671,6 +913,23 @@ namespace VectorMath
             vst1_f32(groupMax, twoMax);
             max = std::max(groupMax[0], groupMax[1]);
 
+            n = tailFrames;
+        }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if (sourceStride == 1)
+        {
+            int tailFrames = n % 4;
+            const float * endP = sourceP + n - tailFrames;
+
+            v128_t fourMax = wasm_f32x4_splat(0);
+            while (sourceP < endP)
+            {
+                fourMax = wasm_f32x4_pmax(fourMax, wasm_f32x4_abs(wasm_v128_load(sourceP)));
+                sourceP += 4;
+            }
+            v128_t twoMax = wasm_f32x4_pmax(fourMax, wasm_i32x4_shuffle(fourMax, fourMax, 2, 3, 0, 1));
+            max = std::max(wasm_f32x4_extract_lane(twoMax, 0), wasm_f32x4_extract_lane(twoMax, 1));
+
             n = tailFrames;
         }
 #endif
@@ -691,8 +950,24 @@ namespace VectorMath
         float lowThreshold = *lowThresholdP;
         float highThreshold = *highThresholdP;
 
-        // FIXME: Optimize for SSE2.
-#if defined(ARM_NEON_INTRINSICS)
+#ifdef __SSE2__
+        if ((sourceStride == 1) && (destStride == 1))
+        {
+            int tailFrames = n % 4;
+            const float * endP = destP + n - tailFrames;
+
+            __m128 low = _mm_set1_ps(lowThreshold);
+            __m128 high = _mm_set1_ps(highThreshold);
+            while (destP < endP)
+            {
+                __m128 source = _mm_loadu_ps(sourceP);
+                _mm_storeu_ps(destP, _mm_max_ps(_mm_min_ps(source, high), low));
+                sourceP += 4;
+                destP += 4;
+            }
+            n = tailFrames;
+        }
+#elif defined(ARM_NEON_INTRINSICS)
         if ((sourceStride == 1) && (destStride == 1))
         {
             int tailFrames = n % 4;
@@ -709,6 +984,23 @@ namespace VectorMath
             }
             n = tailFrames;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        if ((sourceStride == 1) && (destStride == 1))
+        {
+            int tailFrames = n % 4;
+            const float * endP = destP + n - tailFrames;
+
+            v128_t low = wasm_f32x4_splat(lowThreshold);
+            v128_t high = wasm_f32x4_splat(highThreshold);
+            while (destP < endP)
+            {
+                v128_t source = wasm_v128_load(sourceP);
+                wasm_v128_store(destP, wasm_f32x4_pmax(wasm_f32x4_pmin(source, high), low));
+                sourceP += 4;
+                destP += 4;
+            }
+            n = tailFrames;
+        }
 #endif
         while (n--)
         {
@@ -742,6 +1034,17 @@ namespace VectorMath
             i += 4;
             j += 8;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        int pairs = framesToProcess / 2;
+        int endPairs = pairs - pairs % 4;
+        while (i < endPairs)
+        {
+            v128_t real = wasm_v128_load(realSrcP + i);
+            v128_t imag = wasm_v128_load(imagSrcP + i);
+            wasm_v128_store(destP + 2 * i, wasm_i32x4_shuffle(real, imag, 0, 4, 1, 5));
+            wasm_v128_store(destP + 2 * i + 4, wasm_i32x4_shuffle(real, imag, 2, 6, 3, 7));
+            i += 4;
+        }
 #endif
         int lenTail = framesToProcess / 2;
         for (; i < lenTail; ++i)
@@ -774,6 +1077,17 @@ namespace VectorMath
             i += 8;
             j += 4;
         }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        int pairs = framesToProcess / 2;
+        int endPairs = pairs - pairs % 4;
+        while (i < endPairs)
+        {
+            v128_t source1 = wasm_v128_load(sourceP + 2 * i);
+            v128_t source2 = wasm_v128_load(sourceP + 2 * i + 4);
+            wasm_v128_store(realDestP + i, wasm_i32x4_shuffle(source1, source2, 0, 2, 4, 6));
+            wasm_v128_store(imagDestP + i, wasm_i32x4_shuffle(source1, source2, 1, 3, 5, 7));
+            i += 4;
+        }
 #endif
         int lenTail = framesToProcess / 2;
         for (; i < lenTail; ++i)
@@ -784,6 +1098,238 @@ namespace VectorMath
         }
     }
 
+    // Half precision values are widened by placing their exponent and mantissa in a float's
+    // and rescaling by the difference of the exponent biases, which handles their normals
+    // and subnormals alike. Infinities and NaNs are never stored, as conversion clamps.
+    static const float HalfRebias = 5.192296858534828e33f;  // 2^112
+
+    static inline float halfToFloat(uint16_t h)
+    {
+        const uint32_t magnitude = static_cast<uint32_t>(h & 0x7fff) << 13;
+        float f;
+        memcpy(&f, &magnitude, sizeof(f));
+        f *= HalfRebias;
+        return h & 0x8000 ? -f : f;
+    }
+
+    static inline uint16_t floatToHalf(float f)
+    {
+        uint32_t x;
+        memcpy(&x, &f, sizeof(x));
+        const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+        const uint32_t a = x & 0x7fffffff;
+        if (a >= 0x477fe000)  // 65504, the largest half, and beyond, including NaN
+            return sign | 0x7bff;
+        if (a < 0x38800000)  // below the smallest normal half, 2^-14
+        {
+            float v;
+            memcpy(&v, &a, sizeof(v));
+            return sign | static_cast<uint16_t>(lrintf(v * 16777216.f));  // in units of 2^-24
+        }
+        // rebias the exponent, and round the mantissa to nearest even
+        uint32_t h = a - 0x38000000;
+        h += 0xfff + ((h >> 13) & 1);
+        return sign | static_cast<uint16_t>(h >> 13);
+    }
+
+    void zvmaddh(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P, float scale2, float * realDestP, float * imagDestP, int framesToProcess)
+    {
+#if defined(LABSOUND_VECTORMATH_WIDE)
+        if (s_wideKernels)
+        {
+            s_wideKernels->zvmaddh(real1P, imag1P, real2P, imag2P, scale2, realDestP, imagDestP, framesToProcess);
+            return;
+        }
+#endif
+
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i signMask = _mm_set1_epi32(0x8000);
+        const __m128i magnitudeMask = _mm_set1_epi32(0x7fff);
+        const __m128 rebias = _mm_set1_ps(HalfRebias * scale2);
+        auto widen = [&](const uint16_t * p) -> __m128
+        {
+            __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128());
+            __m128 magnitude = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, magnitudeMask), 13)), rebias);
+            return _mm_or_ps(magnitude, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, signMask), 16)));
+        };
+
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            __m128 real1 = _mm_loadu_ps(real1P + i);
+            __m128 imag1 = _mm_loadu_ps(imag1P + i);
+            __m128 real2 = widen(real2P + i);
+            __m128 imag2 = widen(imag2P + i);
+            __m128 real = _mm_sub_ps(_mm_mul_ps(real1, real2), _mm_mul_ps(imag1, imag2));
+            __m128 imag = _mm_add_ps(_mm_mul_ps(real1, imag2), _mm_mul_ps(imag1, real2));
+            _mm_storeu_ps(realDestP + i, _mm_add_ps(_mm_loadu_ps(realDestP + i), real));
+            _mm_storeu_ps(imagDestP + i, _mm_add_ps(_mm_loadu_ps(imagDestP + i), imag));
+            i += 4;
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const uint32x4_t signMask = vdupq_n_u32(0x8000);
+        const uint32x4_t magnitudeMask = vdupq_n_u32(0x7fff);
+        const float32x4_t rebias = vdupq_n_f32(HalfRebias * scale2);
+        auto widen = [&](const uint16_t * p) -> float32x4_t
+        {
+            uint32x4_t h = vmovl_u16(vld1_u16(p));
+            float32x4_t magnitude = vmulq_f32(vreinterpretq_f32_u32(vshlq_n_u32(vandq_u32(h, magnitudeMask), 13)), rebias);
+            return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(magnitude), vshlq_n_u32(vandq_u32(h, signMask), 16)));
+        };
+
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            float32x4_t real1 = vld1q_f32(real1P + i);
+            float32x4_t imag1 = vld1q_f32(imag1P + i);
+            float32x4_t real2 = widen(real2P + i);
+            float32x4_t imag2 = widen(imag2P + i);
+
+            float32x4_t realResult = vmlsq_f32(vmlaq_f32(vld1q_f32(realDestP + i), real1, real2), imag1, imag2);
+            float32x4_t imagResult = vmlaq_f32(vmlaq_f32(vld1q_f32(imagDestP + i), real1, imag2), imag1, real2);
+
+            vst1q_f32(realDestP + i, realResult);
+            vst1q_f32(imagDestP + i, imagResult);
+            i += 4;
+        }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        const v128_t signMask = wasm_i32x4_splat(0x8000);
+        const v128_t magnitudeMask = wasm_i32x4_splat(0x7fff);
+        const v128_t rebias = wasm_f32x4_splat(HalfRebias * scale2);
+        auto widen = [&](const uint16_t * p) -> v128_t
+        {
+            v128_t h = wasm_u32x4_load16x4(p);
+            v128_t magnitude = wasm_f32x4_mul(wasm_i32x4_shl(wasm_v128_and(h, magnitudeMask), 13), rebias);
+            return wasm_v128_or(magnitude, wasm_i32x4_shl(wasm_v128_and(h, signMask), 16));
+        };
+
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            v128_t real1 = wasm_v128_load(real1P + i);
+            v128_t imag1 = wasm_v128_load(imag1P + i);
+            v128_t real2 = widen(real2P + i);
+            v128_t imag2 = widen(imag2P + i);
+            v128_t real = wasm_f32x4_sub(wasm_f32x4_mul(real1, real2), wasm_f32x4_mul(imag1, imag2));
+            v128_t imag = wasm_f32x4_add(wasm_f32x4_mul(real1, imag2), wasm_f32x4_mul(imag1, real2));
+            wasm_v128_store(realDestP + i, wasm_f32x4_add(wasm_v128_load(realDestP + i), real));
+            wasm_v128_store(imagDestP + i, wasm_f32x4_add(wasm_v128_load(imagDestP + i), imag));
+            i += 4;
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            const float real2 = halfToFloat(real2P[i]) * scale2;
+            const float imag2 = halfToFloat(imag2P[i]) * scale2;
+            realDestP[i] += real1P[i] * real2 - imag1P[i] * imag2;
+            imagDestP[i] += real1P[i] * imag2 + imag1P[i] * real2;
+        }
+    }
+
+    void vtohalf(const float * sourceP, float scale, uint16_t * destP, int framesToProcess)
+    {
+        for (int i = 0; i < framesToProcess; ++i)
+            destP[i] = floatToHalf(sourceP[i] * scale);
+    }
+
+    void vfromhalf(const uint16_t * sourceP, float scale, float * destP, int framesToProcess)
+    {
+        for (int i = 0; i < framesToProcess; ++i)
+            destP[i] = halfToFloat(sourceP[i]) * scale;
+    }
+
+    // tanh as a ratio of odd and even polynomials, fitted over the range in which tanh
+    // isn't yet 1 in single precision, and accurate to a few units in the last place there
+    static const float TanhClamp = 7.90531110763549805f;
+    static const float TanhNumerator[7] = {4.89352455891786e-03f, 6.37261928875436e-04f, 1.48572235717979e-05f,
+                                           5.12229709037114e-08f, -8.60467152213735e-11f, 2.00018790482477e-13f,
+                                           -2.76076847742355e-16f};
+    static const float TanhDenominator[4] = {4.89352518554385e-03f, 2.26843463243900e-03f, 1.18534705686654e-04f,
+                                             1.19825839466702e-06f};
+
+    static inline float tanhApproximation(float x)
+    {
+        x = std::max(-TanhClamp, std::min(TanhClamp, x));
+        const float x2 = x * x;
+        float p = TanhNumerator[6];
+        for (int i = 5; i >= 0; --i)
+            p = p * x2 + TanhNumerator[i];
+        float q = TanhDenominator[3];
+        for (int i = 2; i >= 0; --i)
+            q = q * x2 + TanhDenominator[i];
+        return x * p / q;
+    }
+
+    void vtanh(const float * sourceP, float scale, float * destP, int framesToProcess)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        const __m128 gain = _mm_set1_ps(scale);
+        const __m128 clampLow = _mm_set1_ps(-TanhClamp);
+        const __m128 clampHigh = _mm_set1_ps(TanhClamp);
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            __m128 x = _mm_mul_ps(_mm_loadu_ps(sourceP + i), gain);
+            x = _mm_max_ps(clampLow, _mm_min_ps(clampHigh, x));
+            const __m128 x2 = _mm_mul_ps(x, x);
+            __m128 p = _mm_set1_ps(TanhNumerator[6]);
+            for (int k = 5; k >= 0; --k)
+                p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(TanhNumerator[k]));
+            __m128 q = _mm_set1_ps(TanhDenominator[3]);
+            for (int k = 2; k >= 0; --k)
+                q = _mm_add_ps(_mm_mul_ps(q, x2), _mm_set1_ps(TanhDenominator[k]));
+            _mm_storeu_ps(destP + i, _mm_div_ps(_mm_mul_ps(x, p), q));
+            i += 4;
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const float32x4_t clampLow = vdupq_n_f32(-TanhClamp);
+        const float32x4_t clampHigh = vdupq_n_f32(TanhClamp);
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            float32x4_t x = vmulq_n_f32(vld1q_f32(sourceP + i), scale);
+            x = vmaxq_f32(clampLow, vminq_f32(clampHigh, x));
+            const float32x4_t x2 = vmulq_f32(x, x);
+            float32x4_t p = vdupq_n_f32(TanhNumerator[6]);
+            for (int k = 5; k >= 0; --k)
+                p = vmlaq_f32(vdupq_n_f32(TanhNumerator[k]), p, x2);
+            float32x4_t q = vdupq_n_f32(TanhDenominator[3]);
+            for (int k = 2; k >= 0; --k)
+                q = vmlaq_f32(vdupq_n_f32(TanhDenominator[k]), q, x2);
+
+            // a reciprocal estimate refined twice is as accurate as a division
+            float32x4_t r = vrecpeq_f32(q);
+            r = vmulq_f32(r, vrecpsq_f32(q, r));
+            r = vmulq_f32(r, vrecpsq_f32(q, r));
+            vst1q_f32(destP + i, vmulq_f32(vmulq_f32(x, p), r));
+            i += 4;
+        }
+#elif defined(WASM_SIMD128_INTRINSICS)
+        const v128_t gain = wasm_f32x4_splat(scale);
+        const v128_t clampLow = wasm_f32x4_splat(-TanhClamp);
+        const v128_t clampHigh = wasm_f32x4_splat(TanhClamp);
+        int endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize)
+        {
+            v128_t x = wasm_f32x4_mul(wasm_v128_load(sourceP + i), gain);
+            x = wasm_f32x4_pmax(clampLow, wasm_f32x4_pmin(clampHigh, x));
+            const v128_t x2 = wasm_f32x4_mul(x, x);
+            v128_t p = wasm_f32x4_splat(TanhNumerator[6]);
+            for (int k = 5; k >= 0; --k)
+                p = wasm_f32x4_add(wasm_f32x4_mul(p, x2), wasm_f32x4_splat(TanhNumerator[k]));
+            v128_t q = wasm_f32x4_splat(TanhDenominator[3]);
+            for (int k = 2; k >= 0; --k)
+                q = wasm_f32x4_add(wasm_f32x4_mul(q, x2), wasm_f32x4_splat(TanhDenominator[k]));
+            wasm_v128_store(destP + i, wasm_f32x4_div(wasm_f32x4_mul(x, p), q));
+            i += 4;
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+            destP[i] = tanhApproximation(sourceP[i] * scale);
+    }
+
 }  // namespace VectorMath
 
 }  // namespace lab
@@ -0,0 +1,483 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/VectorMathWide.h"
+
+#if defined(LABSOUND_VECTORMATH_WIDE)
+
+#include <immintrin.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC makes every intrinsic available without per function annotations
+#define LAB_TARGET_AVX2
+#define LAB_TARGET_AVX512
+#else
+#define LAB_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define LAB_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace lab
+{
+
+namespace VectorMath
+{
+
+namespace
+{
+    //
+    // AVX2 + FMA, eight lanes, with scalar tails
+    //
+
+    LAB_TARGET_AVX2 float hsum_avx2(__m256 v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+
+    LAB_TARGET_AVX2 float hmax_avx2(__m256 v)
+    {
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+        return _mm_cvtss_f32(m);
+    }
+
+    LAB_TARGET_AVX2 void vsma_avx2(const float * sourceP, float scale, float * destP, int n)
+    {
+        const __m256 k = _mm256_set1_ps(scale);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(destP + i, _mm256_fmadd_ps(_mm256_loadu_ps(sourceP + i), k, _mm256_loadu_ps(destP + i)));
+        for (; i < n; ++i)
+            destP[i] += sourceP[i] * scale;
+    }
+
+    LAB_TARGET_AVX2 void vsmul_avx2(const float * sourceP, float scale, float * destP, int n)
+    {
+        const __m256 k = _mm256_set1_ps(scale);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(destP + i, _mm256_mul_ps(_mm256_loadu_ps(sourceP + i), k));
+        for (; i < n; ++i)
+            destP[i] = scale * sourceP[i];
+    }
+
+    LAB_TARGET_AVX2 void vadd_avx2(const float * source1P, const float * source2P, float * destP, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(destP + i, _mm256_add_ps(_mm256_loadu_ps(source1P + i), _mm256_loadu_ps(source2P + i)));
+        for (; i < n; ++i)
+            destP[i] = source1P[i] + source2P[i];
+    }
+
+    LAB_TARGET_AVX2 void vmul_avx2(const float * source1P, const float * source2P, float * destP, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(destP + i, _mm256_mul_ps(_mm256_loadu_ps(source1P + i), _mm256_loadu_ps(source2P + i)));
+        for (; i < n; ++i)
+            destP[i] = source1P[i] * source2P[i];
+    }
+
+    LAB_TARGET_AVX2 void vmadd_avx2(const float * source1P, const float * source2P, float * destP, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(destP + i, _mm256_fmadd_ps(_mm256_loadu_ps(source1P + i), _mm256_loadu_ps(source2P + i), _mm256_loadu_ps(destP + i)));
+        for (; i < n; ++i)
+            destP[i] += source1P[i] * source2P[i];
+    }
+
+    LAB_TARGET_AVX2 void zvmul_avx2(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P,
+                                    float * realDestP, float * imagDestP, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 real1 = _mm256_loadu_ps(real1P + i);
+            __m256 real2 = _mm256_loadu_ps(real2P + i);
+            __m256 imag1 = _mm256_loadu_ps(imag1P + i);
+            __m256 imag2 = _mm256_loadu_ps(imag2P + i);
+            __m256 real = _mm256_fmsub_ps(real1, real2, _mm256_mul_ps(imag1, imag2));
+            __m256 imag = _mm256_fmadd_ps(real1, imag2, _mm256_mul_ps(imag1, real2));
+            _mm256_storeu_ps(realDestP + i, real);
+            _mm256_storeu_ps(imagDestP + i, imag);
+        }
+        for (; i < n; ++i)
+        {
+            // compute both before storing, in case the destination is also a source
+            float realResult = real1P[i] * real2P[i] - imag1P[i] * imag2P[i];
+            float imagResult = real1P[i] * imag2P[i] + imag1P[i] * real2P[i];
+            realDestP[i] = realResult;
+            imagDestP[i] = imagResult;
+        }
+    }
+
+    LAB_TARGET_AVX2 void zvmadd_avx2(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P,
+                                     float * realDestP, float * imagDestP, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 real1 = _mm256_loadu_ps(real1P + i);
+            __m256 real2 = _mm256_loadu_ps(real2P + i);
+            __m256 imag1 = _mm256_loadu_ps(imag1P + i);
+            __m256 imag2 = _mm256_loadu_ps(imag2P + i);
+            __m256 real = _mm256_fnmadd_ps(imag1, imag2, _mm256_fmadd_ps(real1, real2, _mm256_loadu_ps(realDestP + i)));
+            __m256 imag = _mm256_fmadd_ps(imag1, real2, _mm256_fmadd_ps(real1, imag2, _mm256_loadu_ps(imagDestP + i)));
+            _mm256_storeu_ps(realDestP + i, real);
+            _mm256_storeu_ps(imagDestP + i, imag);
+        }
+        for (; i < n; ++i)
+        {
+            realDestP[i] += real1P[i] * real2P[i] - imag1P[i] * imag2P[i];
+            imagDestP[i] += real1P[i] * imag2P[i] + imag1P[i] * real2P[i];
+        }
+    }
+
+    LAB_TARGET_AVX2 float vsvesq_avx2(const float * sourceP, int n)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 source = _mm256_loadu_ps(sourceP + i);
+            sum = _mm256_fmadd_ps(source, source, sum);
+        }
+        float result = hsum_avx2(sum);
+        for (; i < n; ++i)
+            result += sourceP[i] * sourceP[i];
+        return result;
+    }
+
+    LAB_TARGET_AVX2 float vmaxmgv_avx2(const float * sourceP, int n)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 max = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            max = _mm256_max_ps(max, _mm256_andnot_ps(signMask, _mm256_loadu_ps(sourceP + i)));
+        float result = hmax_avx2(max);
+        for (; i < n; ++i)
+            result = std::max(result, fabsf(sourceP[i]));
+        return result;
+    }
+
+    LAB_TARGET_AVX2 void biquad_avx2(double * data, int frames, const double * coefficients, double * state, int sections)
+    {
+        for (int section = 0; section < sections; ++section, coefficients += 5, state += 8)
+        {
+            const __m256d b0 = _mm256_set1_pd(coefficients[0]);
+            const __m256d b1 = _mm256_set1_pd(coefficients[1]);
+            const __m256d b2 = _mm256_set1_pd(coefficients[2]);
+            const __m256d a1 = _mm256_set1_pd(coefficients[3]);
+            const __m256d a2 = _mm256_set1_pd(coefficients[4]);
+            __m256d s1 = _mm256_loadu_pd(state);
+            __m256d s2 = _mm256_loadu_pd(state + 4);
+            double * p = data;
+            for (int i = 0; i < frames; ++i, p += 4)
+            {
+                const __m256d x = _mm256_loadu_pd(p);
+                const __m256d y = _mm256_fmadd_pd(b0, x, s1);
+                s1 = _mm256_fmadd_pd(b1, x, _mm256_fnmadd_pd(a1, y, s2));
+                s2 = _mm256_fnmadd_pd(a2, y, _mm256_mul_pd(b2, x));
+                _mm256_storeu_pd(p, y);
+            }
+            _mm256_storeu_pd(state, s1);
+            _mm256_storeu_pd(state + 4, s2);
+        }
+    }
+
+    //
+    // AVX-512F, sixteen lanes, with masked tails
+    //
+
+    LAB_TARGET_AVX512 __mmask16 tailMask(int remaining)
+    {
+        return static_cast<__mmask16>((1u << remaining) - 1u);
+    }
+
+    LAB_TARGET_AVX512 void vsma_avx512(const float * sourceP, float scale, float * destP, int n)
+    {
+        const __m512 k = _mm512_set1_ps(scale);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(destP + i, _mm512_fmadd_ps(_mm512_loadu_ps(sourceP + i), k, _mm512_loadu_ps(destP + i)));
+        if (i < n)
+        {
+            __mmask16 m = tailMask(n - i);
+            __m512 d = _mm512_maskz_loadu_ps(m, destP + i);
+            _mm512_mask_storeu_ps(destP + i, m, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, sourceP + i), k, d));
+        }
+    }
+
+    LAB_TARGET_AVX512 void vsmul_avx512(const float * sourceP, float scale, float * destP, int n)
+    {
+        const __m512 k = _mm512_set1_ps(scale);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(destP + i, _mm512_mul_ps(_mm512_loadu_ps(sourceP + i), k));
+        if (i < n)
+        {
+            __mmask16 m = tailMask(n - i);
+            _mm512_mask_storeu_ps(destP + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, sourceP + i), k));
+        }
+    }
+
+    LAB_TARGET_AVX512 void vadd_avx512(const float * source1P, const float * source2P, float * destP, int n)
+    {
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(destP + i, _mm512_add_ps(_mm512_loadu_ps(source1P + i), _mm512_loadu_ps(source2P + i)));
+        if (i < n)
+        {
+            __mmask16 m = tailMask(n - i);
+            _mm512_mask_storeu_ps(destP + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, source1P + i), _mm512_maskz_loadu_ps(m, source2P + i)));
+        }
+    }
+
+    LAB_TARGET_AVX512 void vmul_avx512(const float * source1P, const float * source2P, float * destP, int n)
+    {
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(destP + i, _mm512_mul_ps(_mm512_loadu_ps(source1P + i), _mm512_loadu_ps(source2P + i)));
+        if (i < n)
+        {
+            __mmask16 m = tailMask(n - i);
+            _mm512_mask_storeu_ps(destP + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, source1P + i), _mm512_maskz_loadu_ps(m, source2P + i)));
+        }
+    }
+
+    LAB_TARGET_AVX512 void vmadd_avx512(const float * source1P, const float * source2P, float * destP, int n)
+    {
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(destP + i, _mm512_fmadd_ps(_mm512_loadu_ps(source1P + i), _mm512_loadu_ps(source2P + i), _mm512_loadu_ps(destP + i)));
+        if (i < n)
+        {
+            __mmask16 m = tailMask(n - i);
+            __m512 d = _mm512_maskz_loadu_ps(m, destP + i);
+            _mm512_mask_storeu_ps(destP + i, m, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, source1P + i), _mm512_maskz_loadu_ps(m, source2P + i), d));
+        }
+    }
+
+    LAB_TARGET_AVX512 void zvmul_avx512(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P,
+                                        float * realDestP, float * imagDestP, int n)
+    {
+        for (int i = 0; i < n; i += 16)
+        {
+            __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xffff) : tailMask(n - i);
+            __m512 real1 = _mm512_maskz_loadu_ps(m, real1P + i);
+            __m512 real2 = _mm512_maskz_loadu_ps(m, real2P + i);
+            __m512 imag1 = _mm512_maskz_loadu_ps(m, imag1P + i);
+            __m512 imag2 = _mm512_maskz_loadu_ps(m, imag2P + i);
+            __m512 real = _mm512_fmsub_ps(real1, real2, _mm512_mul_ps(imag1, imag2));
+            __m512 imag = _mm512_fmadd_ps(real1, imag2, _mm512_mul_ps(imag1, real2));
+            _mm512_mask_storeu_ps(realDestP + i, m, real);
+            _mm512_mask_storeu_ps(imagDestP + i, m, imag);
+        }
+    }
+
+    LAB_TARGET_AVX2 void zvmaddh_avx2(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P,
+                                      float scale2, float * realDestP, float * imagDestP, int n)
+    {
+        const __m256 scale = _mm256_set1_ps(scale2);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 real1 = _mm256_loadu_ps(real1P + i);
+            __m256 imag1 = _mm256_loadu_ps(imag1P + i);
+            __m256 real2 = _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(real2P + i))), scale);
+            __m256 imag2 = _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(imag2P + i))), scale);
+            __m256 real = _mm256_fnmadd_ps(imag1, imag2, _mm256_fmadd_ps(real1, real2, _mm256_loadu_ps(realDestP + i)));
+            __m256 imag = _mm256_fmadd_ps(imag1, real2, _mm256_fmadd_ps(real1, imag2, _mm256_loadu_ps(imagDestP + i)));
+            _mm256_storeu_ps(realDestP + i, real);
+            _mm256_storeu_ps(imagDestP + i, imag);
+        }
+        for (; i < n; ++i)
+        {
+            float real2 = _cvtsh_ss(real2P[i]) * scale2;
+            float imag2 = _cvtsh_ss(imag2P[i]) * scale2;
+            realDestP[i] += real1P[i] * real2 - imag1P[i] * imag2;
+            imagDestP[i] += real1P[i] * imag2 + imag1P[i] * real2;
+        }
+    }
+
+    LAB_TARGET_AVX512 void zvmadd_avx512(const float * real1P, const float * imag1P, const float * real2P, const float * imag2P,
+                                         float * realDestP, float * imagDestP, int n)
+    {
+        for (int i = 0; i < n; i += 16)
+        {
+            __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xffff) : tailMask(n - i);
+            __m512 real1 = _mm512_maskz_loadu_ps(m, real1P + i);
+            __m512 real2 = _mm512_maskz_loadu_ps(m, real2P + i);
+            __m512 imag1 = _mm512_maskz_loadu_ps(m, imag1P + i);
+            __m512 imag2 = _mm512_maskz_loadu_ps(m, imag2P + i);
+            __m512 real = _mm512_fnmadd_ps(imag1, imag2, _mm512_fmadd_ps(real1, real2, _mm512_maskz_loadu_ps(m, realDestP + i)));
+            __m512 imag = _mm512_fmadd_ps(imag1, real2, _mm512_fmadd_ps(real1, imag2, _mm512_maskz_loadu_ps(m, imagDestP + i)));
+            _mm512_mask_storeu_ps(realDestP + i, m, real);
+            _mm512_mask_storeu_ps(imagDestP + i, m, imag);
+        }
+    }
+
+    // masked 16 bit loads need AVX-512BW, so the half precision operand's tail is copied out
+    LAB_TARGET_AVX512 void zvmaddh_avx512(const float * real1P, const float * imag1P, const uint16_t * real2P, const uint16_t * imag2P,
+                                          float scale2, float * realDestP, float * imagDestP, int n)
+    {
+        const __m512 scale = _mm512_set1_ps(scale2);
+        for (int i = 0; i < n; i += 16)
+        {
+            __mmask16 m = static_cast<__mmask16>(0xffff);
+            __m256i halfReal, halfImag;
+            if (n - i >= 16)
+            {
+                halfReal = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(real2P + i));
+                halfImag = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(imag2P + i));
+            }
+            else
+            {
+                uint16_t tailReal[16] = {};
+                uint16_t tailImag[16] = {};
+                std::copy(real2P + i, real2P + n, tailReal);
+                std::copy(imag2P + i, imag2P + n, tailImag);
+                halfReal = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tailReal));
+                halfImag = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tailImag));
+                m = tailMask(n - i);
+            }
+            __m512 real1 = _mm512_maskz_loadu_ps(m, real1P + i);
+            __m512 imag1 = _mm512_maskz_loadu_ps(m, imag1P + i);
+            __m512 real2 = _mm512_mul_ps(_mm512_cvtph_ps(halfReal), scale);
+            __m512 imag2 = _mm512_mul_ps(_mm512_cvtph_ps(halfImag), scale);
+            __m512 real = _mm512_fnmadd_ps(imag1, imag2, _mm512_fmadd_ps(real1, real2, _mm512_maskz_loadu_ps(m, realDestP + i)));
+            __m512 imag = _mm512_fmadd_ps(imag1, real2, _mm512_fmadd_ps(real1, imag2, _mm512_maskz_loadu_ps(m, imagDestP + i)));
+            _mm512_mask_storeu_ps(realDestP + i, m, real);
+            _mm512_mask_storeu_ps(imagDestP + i, m, imag);
+        }
+    }
+
+    LAB_TARGET_AVX512 float vsvesq_avx512(const float * sourceP, int n)
+    {
+        __m512 sum = _mm512_setzero_ps();
+        for (int i = 0; i < n; i += 16)
+        {
+            __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xffff) : tailMask(n - i);
+            __m512 source = _mm512_maskz_loadu_ps(m, sourceP + i);
+            sum = _mm512_fmadd_ps(source, source, sum);
+        }
+        return _mm512_reduce_add_ps(sum);
+    }
+
+    LAB_TARGET_AVX512 float vmaxmgv_avx512(const float * sourceP, int n)
+    {
+        __m512 max = _mm512_setzero_ps();
+        for (int i = 0; i < n; i += 16)
+        {
+            __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xffff) : tailMask(n - i);
+            max = _mm512_max_ps(max, _mm512_abs_ps(_mm512_maskz_loadu_ps(m, sourceP + i)));
+        }
+        return _mm512_reduce_max_ps(max);
+    }
+
+    LAB_TARGET_AVX512 void biquad_avx512(double * data, int frames, const double * coefficients, double * state, int sections)
+    {
+        for (int section = 0; section < sections; ++section, coefficients += 5, state += 16)
+        {
+            const __m512d b0 = _mm512_set1_pd(coefficients[0]);
+            const __m512d b1 = _mm512_set1_pd(coefficients[1]);
+            const __m512d b2 = _mm512_set1_pd(coefficients[2]);
+            const __m512d a1 = _mm512_set1_pd(coefficients[3]);
+            const __m512d a2 = _mm512_set1_pd(coefficients[4]);
+            __m512d s1 = _mm512_loadu_pd(state);
+            __m512d s2 = _mm512_loadu_pd(state + 8);
+            double * p = data;
+            for (int i = 0; i < frames; ++i, p += 8)
+            {
+                const __m512d x = _mm512_loadu_pd(p);
+                const __m512d y = _mm512_fmadd_pd(b0, x, s1);
+                s1 = _mm512_fmadd_pd(b1, x, _mm512_fnmadd_pd(a1, y, s2));
+                s2 = _mm512_fnmadd_pd(a2, y, _mm512_mul_pd(b2, x));
+                _mm512_storeu_pd(p, y);
+            }
+            _mm512_storeu_pd(state, s1);
+            _mm512_storeu_pd(state + 8, s2);
+        }
+    }
+
+    bool cpuSupportsAVX2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool fma = (info[2] & (1 << 12)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool f16c = (info[2] & (1 << 29)) != 0;
+        if (!fma || !osxsave || !f16c || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+#endif
+    }
+
+    bool cpuSupportsAVX512()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        // the OS must preserve the opmask and both halves of the zmm registers
+        if (!osxsave || (_xgetbv(0) & 0xe6) != 0xe6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 16)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+    }
+}
+
+const WideKernels & avx2Kernels()
+{
+    static const WideKernels kernels = {
+        "AVX2", vsma_avx2, vsmul_avx2, vadd_avx2, vmul_avx2, vmadd_avx2, zvmul_avx2, zvmadd_avx2, zvmaddh_avx2, vsvesq_avx2, vmaxmgv_avx2,
+        4, biquad_avx2};
+    return kernels;
+}
+
+const WideKernels & avx512Kernels()
+{
+    static const WideKernels kernels = {
+        "AVX-512", vsma_avx512, vsmul_avx512, vadd_avx512, vmul_avx512, vmadd_avx512, zvmul_avx512, zvmadd_avx512, zvmaddh_avx512, vsvesq_avx512, vmaxmgv_avx512,
+        8, biquad_avx512};
+    return kernels;
+}
+
+const WideKernels * selectWideKernels()
+{
+    if (cpuSupportsAVX512())
+        return &avx512Kernels();
+    if (cpuSupportsAVX2())
+        return &avx2Kernels();
+    return nullptr;
+}
+
+}  // namespace VectorMath
+
+}  // namespace lab
+
+#endif  // LABSOUND_VECTORMATH_WIDE